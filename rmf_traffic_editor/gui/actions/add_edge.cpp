@@ -29,8 +29,8 @@ AddEdgeCommand::AddEdgeCommand(
   _first_point_drawn = false;
   _second_point_not_exist = false;
   _second_point_drawn = false;
-  _edge_snapshot = _building->levels[_level_idx].edges;
-  _vert_snapshot = _building->levels[_level_idx].vertices;
+  _previous_num_edges = _building->levels[_level_idx].edges.size();
+  _previous_num_vertices = _building->levels[_level_idx].vertices.size();
 }
 
 AddEdgeCommand::~AddEdgeCommand()
@@ -40,7 +40,17 @@ AddEdgeCommand::~AddEdgeCommand()
 
 void AddEdgeCommand::redo()
 {
-  _building->levels[_level_idx].vertices = _final_snapshot;
+  // put back any vertices that undo() removed
+  std::vector<Vertex>& vertices = _building->levels[_level_idx].vertices;
+  for (std::size_t i = vertices.size() - _previous_num_vertices;
+    i < _added_vertices.size(); i++)
+  {
+    vertices.push_back(_added_vertices[i]);
+    _building->levels[_level_idx].mark_changed(
+      Level::VERTEX,
+      vertices.size() - 1);
+  }
+
   if (_type != Edge::LANE)
   {
     _building->add_edge(
@@ -61,9 +71,16 @@ void AddEdgeCommand::redo()
 
 void AddEdgeCommand::undo()
 {
-  //Just use snapshots to keep things simpler
-  _building->levels[_level_idx].edges = _edge_snapshot;
-  _building->levels[_level_idx].vertices = _vert_snapshot;
+  Level& level = _building->levels[_level_idx];
+  if (level.edges.size() > _previous_num_edges)
+    level.edges.erase(
+      level.edges.begin() + _previous_num_edges,
+      level.edges.end());
+  if (level.vertices.size() > _previous_num_vertices)
+    level.vertices.erase(
+      level.vertices.begin() + _previous_num_vertices,
+      level.vertices.end());
+  level.mark_all_changed();
 }
 
 int AddEdgeCommand::set_first_point(double x, double y)
@@ -88,9 +105,9 @@ int AddEdgeCommand::set_first_point(double x, double y)
     _first_point_not_exist = true;
     _building->add_vertex(_level_idx, x, y);
     clicked_idx = _building->levels[_level_idx].vertices.size()-1;
+    _added_vertices.push_back(_building->levels[_level_idx].vertices.back());
   }
   _vert_id_first = clicked_idx;
-  _final_snapshot = _building->levels[_level_idx].vertices;
   return clicked_idx;
 }
 
@@ -118,9 +135,9 @@ int AddEdgeCommand::set_second_point(double x, double y)
     _second_point_drawn = true;
     _building->add_vertex(_level_idx, x, y);
     clicked_idx = _building->levels[_level_idx].vertices.size()-1;
+    _added_vertices.push_back(_building->levels[_level_idx].vertices.back());
   }
   _vert_id_second = clicked_idx;
-  _final_snapshot = _building->levels[_level_idx].vertices;
   return clicked_idx;
 }
 
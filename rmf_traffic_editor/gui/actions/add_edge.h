@@ -45,8 +45,10 @@ private:
   bool _first_point_not_exist, _first_point_drawn;
   bool _second_point_not_exist, _second_point_drawn;
   int _level_idx;
-  std::vector<Edge> _edge_snapshot;
-  std::vector<Vertex> _vert_snapshot, _final_snapshot;
+  // this command only ever appends to the edge and vertex lists, so it
+  // just remembers their sizes and any vertices it created
+  std::size_t _previous_num_edges, _previous_num_vertices;
+  std::vector<Vertex> _added_vertices;
   int _vert_id_first, _vert_id_second;
   Edge::Type _type;
   const double _vertex_radius_meters = 0.1;
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "add_feature_matches.hpp"
+
+AddFeatureMatchesCommand::AddFeatureMatchesCommand(
+  Building* building,
+  int level_idx,
+  int layer_idx,
+  const std::vector<std::pair<QPointF, QPointF>>& points)
+: _building(building),
+  _level_idx(level_idx),
+  _layer_idx(layer_idx)
+{
+  setText("Add matched features");
+  for (const std::pair<QPointF, QPointF>& p : points)
+  {
+    _floorplan_features.push_back(Feature(p.first));
+    _layer_features.push_back(Feature(p.second));
+  }
+}
+
+void AddFeatureMatchesCommand::undo()
+{
+  Level& level = _building->levels[_level_idx];
+  for (std::size_t i = 0; i < _floorplan_features.size(); i++)
+  {
+    const QUuid& a = _floorplan_features[i].id();
+    const QUuid& b = _layer_features[i].id();
+    level.remove_constraint(a, b);
+    level.remove_feature(0, a);
+    level.remove_feature(_layer_idx + 1, b);
+  }
+}
+
+void AddFeatureMatchesCommand::redo()
+{
+  Level& level = _building->levels[_level_idx];
+  std::vector<Feature>& layer_features = level.layers[_layer_idx].features;
+  for (std::size_t i = 0; i < _floorplan_features.size(); i++)
+  {
+    level.floorplan_features.push_back(_floorplan_features[i]);
+    layer_features.push_back(_layer_features[i]);
+    level.add_constraint(
+      _floorplan_features[i].id(),
+      _layer_features[i].id());
+  }
+  level.mark_all_changed();  // features are drawn with their layers
+}
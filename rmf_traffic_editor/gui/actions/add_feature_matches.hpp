@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef ACTIONS__ADD_FEATURE_MATCHES_HPP_
+#define ACTIONS__ADD_FEATURE_MATCHES_HPP_
+
+#include <utility>
+#include <vector>
+
+#include <QPointF>
+#include <QUndoCommand>
+
+#include "building.h"
+
+/// Adds pairs of features, one on the floorplan and one on a layer, each
+/// pair joined by a constraint, as proposed by FeatureMatcher. The
+/// features keep their ids across undo and redo, so that the constraints
+/// (and anything added on top of them later) stay valid.
+class AddFeatureMatchesCommand : public QUndoCommand
+{
+public:
+  /// The points are (floorplan pixel, pixel of layer layer_idx)
+  AddFeatureMatchesCommand(
+    Building* building,
+    int level_idx,
+    int layer_idx,
+    const std::vector<std::pair<QPointF, QPointF>>& points);
+
+  void undo() override;
+  void redo() override;
+
+private:
+  Building* _building;
+  int _level_idx;
+  int _layer_idx;
+  std::vector<Feature> _floorplan_features;
+  std::vector<Feature> _layer_features;
+};
+
+#endif  // ACTIONS__ADD_FEATURE_MATCHES_HPP_
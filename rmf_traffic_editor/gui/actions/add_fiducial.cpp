@@ -36,13 +36,8 @@ AddFiducialCommand::~AddFiducialCommand()
 
 void AddFiducialCommand::undo()
 {
-  int index_to_remove = -1;
-
-  for (size_t i = 0; i < _building->levels[_level_idx].fiducials.size(); i++)
-  {
-    if (_uuid == _building->levels[_level_idx].fiducials[i].uuid)
-      index_to_remove = i;
-  }
+  const int index_to_remove =
+    _building->levels[_level_idx].find_fiducial_index(_uuid);
 
   if (index_to_remove < 0)
   {
@@ -53,6 +48,7 @@ void AddFiducialCommand::undo()
   _building->levels[_level_idx].fiducials.erase(
     _building->levels[_level_idx].fiducials.begin() + index_to_remove
   );
+  _building->levels[_level_idx].mark_all_changed();
 }
 
 void AddFiducialCommand::redo()
@@ -39,16 +39,12 @@ AddModelCommand::~AddModelCommand()
 
 void AddModelCommand::undo()
 {
-  for (size_t i = 0; i < _building->levels[_level_idx].models.size();
-    i++)
+  Level& level = _building->levels[_level_idx];
+  const int model_idx = level.find_model_index(_uuid);
+  if (model_idx >= 0)
   {
-    if (_building->levels[_level_idx].models[i].uuid == _uuid)
-    {
-      _building->levels[_level_idx].models.erase(
-        _building->levels[_level_idx].models.begin() + i
-      );
-      return;
-    }
+    level.models.erase(level.models.begin() + model_idx);
+    level.mark_all_changed();
   }
 }
 
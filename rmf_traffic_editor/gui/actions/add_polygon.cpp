@@ -21,11 +21,11 @@ AddPolygonCommand::AddPolygonCommand(
   Polygon polygon,
   int level_idx)
 {
-  // In this case to keep polygon undoing simple, we use simple snapshots.
+  // redo() appends the polygon, so undo() only has to trim it off again
   _building = building;
   _to_add = polygon;
   _level_idx = level_idx;
-  _previous_polygons = _building->levels[level_idx].polygons;
+  _previous_num_polygons = _building->levels[level_idx].polygons.size();
 }
 
 AddPolygonCommand::~AddPolygonCommand()
@@ -34,10 +34,15 @@ AddPolygonCommand::~AddPolygonCommand()
 
 void AddPolygonCommand::undo()
 {
-  _building->levels[_level_idx].polygons = _previous_polygons;
+  std::vector<Polygon>& polygons = _building->levels[_level_idx].polygons;
+  if (polygons.size() > _previous_num_polygons)
+    polygons.erase(polygons.begin() + _previous_num_polygons, polygons.end());
+  _building->levels[_level_idx].mark_all_changed();
 }
 
 void AddPolygonCommand::redo()
 {
-  _building->levels[_level_idx].polygons.push_back(_to_add);
+  Level& level = _building->levels[_level_idx];
+  level.polygons.push_back(_to_add);
+  level.mark_changed(Level::POLYGON, level.polygons.size() - 1);
 }
@@ -35,7 +35,7 @@ private:
   Building* _building;
   Polygon _to_add;
   int _level_idx;
-  std::vector<Polygon> _previous_polygons;
+  std::size_t _previous_num_polygons;
 };
 
 #endif
@@ -72,6 +72,7 @@ void AddPropertyCommand::redo()
       return;
 
     _building->levels[_level_idx].tags[_tag_id].params[_prop] = _val;
+    _building->levels[_level_idx].mark_changed(Level::TAG, _tag_id);
   }
   else
   {
@@ -79,6 +80,7 @@ void AddPropertyCommand::redo()
       return;
 
     _building->levels[_level_idx].vertices[_vert_id].params[_prop] = _val;
+    _building->levels[_level_idx].mark_changed(Level::VERTEX, _vert_id);
   }
 }
 
@@ -86,18 +88,20 @@ void AddPropertyCommand::undo()
 {
   if (_is_tag)
   {
-    auto t = _building->levels[_level_idx].tags[_tag_id];
+    const auto& t = _building->levels[_level_idx].tags[_tag_id];
     if (t.params.count(_prop) == 0)
       return;
 
     _building->levels[_level_idx].tags[_tag_id].params.erase(_prop);
+    _building->levels[_level_idx].mark_changed(Level::TAG, _tag_id);
   }
   else
   {
-    auto v = _building->levels[_level_idx].vertices[_vert_id];
+    const auto& v = _building->levels[_level_idx].vertices[_vert_id];
     if (v.params.count(_prop) == 0)
       return;
 
     _building->levels[_level_idx].vertices[_vert_id].params.erase(_prop);
+    _building->levels[_level_idx].mark_changed(Level::VERTEX, _vert_id);
   }
 }
@@ -36,16 +36,12 @@ AddTagCommand::~AddTagCommand()
 
 void AddTagCommand::undo()
 {
-  size_t length = _building->levels[_level_idx].tags.size();
-  //TODO: SLOW O(n) method... Need to rework datastructures.
-  for (size_t i = 0; i < length; i++)
+  Level& level = _building->levels[_level_idx];
+  const int tag_idx = level.find_tag_index(_tag_id);
+  if (tag_idx >= 0)
   {
-    if (_building->levels[_level_idx].tags[i].uuid == _tag_id)
-    {
-      _building->levels[_level_idx].tags.erase(
-        _building->levels[_level_idx].tags.begin() + i);
-      break;
-    }
+    level.tags.erase(level.tags.begin() + tag_idx);
+    level.mark_all_changed();
   }
 }
 
@@ -36,16 +36,12 @@ AddVertexCommand::~AddVertexCommand()
 
 void AddVertexCommand::undo()
 {
-  size_t length = _building->levels[_level_idx].vertices.size();
-  //TODO: SLOW O(n) method... Need to rework datastructures.
-  for (size_t i = 0; i < length; i++)
+  Level& level = _building->levels[_level_idx];
+  const int vertex_idx = level.find_vertex_index(_vert_id);
+  if (vertex_idx >= 0)
   {
-    if (_building->levels[_level_idx].vertices[i].uuid == _vert_id)
-    {
-      _building->levels[_level_idx].vertices.erase(
-        _building->levels[_level_idx].vertices.begin() + i);
-      break;
-    }
+    level.vertices.erase(level.vertices.begin() + vertex_idx);
+    level.mark_all_changed();
   }
 }
 
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include "batch_edit.hpp"
+
+BatchEditCommand::BatchEditCommand(
+  const std::string& name,
+  std::unique_ptr<BatchEditTransaction> transaction)
+: _transaction(std::move(transaction))
+{
+  setText(QString::fromStdString(name));
+}
+
+void BatchEditCommand::undo()
+{
+  if (!_applied)
+    return;
+  _transaction->undo();
+  _applied = false;
+}
+
+void BatchEditCommand::redo()
+{
+  if (_applied)
+    return;
+  _transaction->redo();
+  _applied = true;
+}
+
+std::size_t BatchEditCommand::memory_usage() const
+{
+  return _transaction->memory_usage();
+}
+
+void BatchEditCommand::retire()
+{
+  _transaction->clear();
+}
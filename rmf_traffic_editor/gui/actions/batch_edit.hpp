@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef ACTIONS__BATCH_EDIT_HPP_
+#define ACTIONS__BATCH_EDIT_HPP_
+
+#include <memory>
+#include <string>
+
+#include <QUndoCommand>
+
+#include "actions/compactable_command.hpp"
+#include "batch_edit_transaction.hpp"
+
+/// The undo step of one run of a BatchEdit plugin. The run has already
+/// changed the building when the command is pushed, so the first redo()
+/// does nothing.
+class BatchEditCommand : public QUndoCommand, public CompactableCommand
+{
+public:
+  BatchEditCommand(
+    const std::string& name,
+    std::unique_ptr<BatchEditTransaction> transaction);
+
+  void undo() override;
+  void redo() override;
+
+  std::size_t memory_usage() const override;
+  void retire() override;
+
+private:
+  std::unique_ptr<BatchEditTransaction> _transaction;
+  bool _applied = true;
+};
+
+#endif  // ACTIONS__BATCH_EDIT_HPP_
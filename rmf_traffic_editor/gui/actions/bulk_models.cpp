@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include <cmath>
+
+#include <QtConcurrent/QtConcurrent>
+
+#include "bulk_models.hpp"
+
+BulkModelsCommand::BulkModelsCommand(
+  Building* building,
+  const Operation& operation,
+  const std::vector<std::vector<int>>& models)
+: _building(building),
+  _operation(operation)
+{
+  switch (_operation.kind)
+  {
+    case Operation::ROTATE: setText("Rotate models"); break;
+    case Operation::TRANSLATE: setText("Move models"); break;
+    case Operation::RENAME: setText("Change model names"); break;
+    case Operation::SET_STATIC:
+      setText(_operation.is_static ?
+        "Make models static" : "Make models dynamic");
+      break;
+  }
+
+  for (std::size_t i = 0; i < _building->levels.size(); i++)
+  {
+    const Level& level = _building->levels[i];
+    if (!models.empty())
+    {
+      if (i < models.size())
+        add(static_cast<int>(i), models[i]);
+      continue;
+    }
+    std::vector<int> all(level.models.size());
+    for (std::size_t j = 0; j < all.size(); j++)
+      all[j] = static_cast<int>(j);
+    add(static_cast<int>(i), all);
+  }
+}
+
+void BulkModelsCommand::add(
+  const int level_idx,
+  const std::vector<int>& model_idxs)
+{
+  const Level& level = _building->levels[level_idx];
+  LevelModels level_models;
+  level_models.level_idx = level_idx;
+  for (const int idx : model_idxs)
+  {
+    if (idx < 0 || idx >= static_cast<int>(level.models.size()))
+      continue;
+    const Model& model = level.models[idx];
+    if (_operation.kind == Operation::RENAME &&
+      (model.model_name == _operation.to_name ||
+      (!_operation.from_name.empty() &&
+      model.model_name != _operation.from_name)))
+      continue;
+    if (_operation.kind == Operation::SET_STATIC &&
+      model.is_static == _operation.is_static)
+      continue;
+
+    Entry entry;
+    entry.uuid = model.uuid;
+    entry.idx = idx;
+    entry.x = model.state.x;
+    entry.y = model.state.y;
+    entry.yaw = model.state.yaw;
+    entry.model_name = model.model_name;
+    entry.is_static = model.is_static;
+    level_models.center += QPointF(entry.x, entry.y);
+    level_models.entries.push_back(entry);
+  }
+  if (level_models.entries.empty())
+    return;
+  level_models.center /= static_cast<double>(level_models.entries.size());
+  _levels.push_back(std::move(level_models));
+}
+
+std::size_t BulkModelsCommand::size() const
+{
+  std::size_t count = 0;
+  for (const LevelModels& level_models : _levels)
+    count += level_models.entries.size();
+  return count;
+}
+
+void BulkModelsCommand::undo()
+{
+  apply(true);
+}
+
+void BulkModelsCommand::redo()
+{
+  apply(false);
+}
+
+std::size_t BulkModelsCommand::memory_usage() const
+{
+  std::size_t bytes = _levels.capacity() * sizeof(LevelModels);
+  for (const LevelModels& level_models : _levels)
+  {
+    bytes += level_models.entries.capacity() * sizeof(Entry);
+    for (const Entry& entry : level_models.entries)
+      bytes += entry.model_name.capacity();
+  }
+  return bytes;
+}
+
+void BulkModelsCommand::retire()
+{
+  _levels = std::vector<LevelModels>();
+}
+
+int BulkModelsCommand::find(const Level& level, Entry& entry) const
+{
+  if (entry.idx < 0 || entry.idx >= static_cast<int>(level.models.size()) ||
+    level.models[entry.idx].uuid != entry.uuid)
+    entry.idx = level.find_model_index(entry.uuid);
+  return entry.idx;
+}
+
+void BulkModelsCommand::apply(const bool original)
+{
+  // each level only touches its own models, so they can go in parallel;
+  // the scene can't, so the pixmaps are updated afterwards
+  const Operation& op = _operation;
+  const double c = std::cos(op.rotation);
+  const double s = std::sin(op.rotation);
+  QtConcurrent::blockingMap(
+    _levels,
+    [this, &op, original, c, s](LevelModels& level_models)
+    {
+      Level& level = _building->levels[level_models.level_idx];
+      const double mpp = level.drawing_meters_per_pixel;
+      for (Entry& entry : level_models.entries)
+      {
+        const int idx = find(level, entry);
+        if (idx < 0)
+          continue;
+        Model& model = level.models[idx];
+        model.state.x = entry.x;
+        model.state.y = entry.y;
+        model.state.yaw = entry.yaw;
+        model.model_name = entry.model_name;
+        model.is_static = entry.is_static;
+        if (!original)
+        {
+          switch (op.kind)
+          {
+            case Operation::ROTATE:
+              model.state.yaw += op.rotation;
+              if (op.about_center)
+              {
+                // counter-clockwise on screen, where y points down
+                const QPointF d = QPointF(entry.x, entry.y) -
+                  level_models.center;
+                model.state.x =
+                  level_models.center.x() + c * d.x() + s * d.y();
+                model.state.y =
+                  level_models.center.y() - s * d.x() + c * d.y();
+              }
+              break;
+            case Operation::TRANSLATE:
+              if (mpp > 0.0)
+              {
+                // meters have y up, the level's pixels have it down
+                model.state.x += op.offset.x() / mpp;
+                model.state.y -= op.offset.y() / mpp;
+              }
+              break;
+            case Operation::RENAME:
+              model.model_name = op.to_name;
+              break;
+            case Operation::SET_STATIC:
+              model.is_static = op.is_static;
+              break;
+          }
+        }
+        level.mark_moved(Level::MODEL, idx);
+      }
+    });
+
+  for (LevelModels& level_models : _levels)
+  {
+    Level& level = _building->levels[level_models.level_idx];
+    for (const Entry& entry : level_models.entries)
+    {
+      if (entry.idx < 0)
+        continue;
+      Model& model = level.models[entry.idx];
+      if (op.kind == Operation::RENAME)
+      {
+        // another pixmap is needed; draw() will look it up again
+        model.clear_pixmap();
+        level.mark_changed(Level::MODEL, entry.idx);
+      }
+      else
+        model.update_pose();
+    }
+  }
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef ACTIONS__BULK_MODELS_HPP_
+#define ACTIONS__BULK_MODELS_HPP_
+
+#include <string>
+#include <vector>
+
+#include <QPointF>
+#include <QUndoCommand>
+#include <QUuid>
+
+#include "actions/compactable_command.hpp"
+#include "building.h"
+
+/// Changes many models at once, on any number of levels, as a single undo
+/// step: rotate them, move them, swap the model they show, or make them
+/// static or dynamic. Only the original state of each model is stored; the
+/// new state is computed from the operation, level by level in parallel.
+///
+/// The models which are already drawn are updated in place: their pixmaps
+/// are moved, and only those whose model_name changed are drawn again.
+class BulkModelsCommand : public QUndoCommand, public CompactableCommand
+{
+public:
+  struct Operation
+  {
+    enum Kind { ROTATE, TRANSLATE, RENAME, SET_STATIC };
+    Kind kind = ROTATE;
+
+    /// ROTATE: radians, counter-clockwise on screen, added to the yaw
+    double rotation = 0.0;
+
+    /// ROTATE: also turn the positions about the center of the models
+    /// (of each level, separately)
+    bool about_center = false;
+
+    /// TRANSLATE: in meters, so that it is the same on every level
+    QPointF offset;
+
+    /// RENAME: the models which show `from_name` (or all, if it is empty)
+    /// will show `to_name` instead
+    std::string from_name;
+    std::string to_name;
+
+    /// SET_STATIC
+    bool is_static = true;
+  };
+
+  /// The models to change are those of `models` (one list of model indices
+  /// per level), or if that is empty, every model of every level.
+  BulkModelsCommand(
+    Building* building,
+    const Operation& operation,
+    const std::vector<std::vector<int>>& models = {});
+
+  /// Number of models that the operation changes
+  std::size_t size() const;
+
+  void undo() override;
+  void redo() override;
+
+  std::size_t memory_usage() const override;
+  void retire() override;
+
+private:
+  struct Entry
+  {
+    QUuid uuid;
+    int idx = -1;  // where it was last seen; checked against the uuid
+    double x = 0.0;
+    double y = 0.0;
+    double yaw = 0.0;
+    std::string model_name;
+    bool is_static = true;
+  };
+
+  struct LevelModels
+  {
+    int level_idx = -1;
+    QPointF center;  // of the original positions, to rotate about
+    std::vector<Entry> entries;
+  };
+
+  Building* _building;
+  Operation _operation;
+  std::vector<LevelModels> _levels;
+
+  void add(const int level_idx, const std::vector<int>& model_idxs);
+
+  /// Index of the model, or -1 if it no longer exists
+  int find(const Level& level, Entry& entry) const;
+
+  void apply(const bool original);
+};
+
+#endif  // ACTIONS__BULK_MODELS_HPP_
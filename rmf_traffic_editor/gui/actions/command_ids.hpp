@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef ACTIONS__COMMAND_IDS_HPP_
+#define ACTIONS__COMMAND_IDS_HPP_
+
+/// Ids returned by QUndoCommand::id(). Commands with the same id are
+/// offered to each other's mergeWith() when pushed back to back, which the
+/// move commands use to coalesce repeated drags of one entity into a
+/// single undo step.
+enum CommandId
+{
+  MOVE_VERTEX_COMMAND_ID = 1,
+  MOVE_TAG_COMMAND_ID,
+  MOVE_MODEL_COMMAND_ID,
+  MOVE_FEATURE_COMMAND_ID,
+  MOVE_FIDUCIAL_COMMAND_ID,
+  ROTATE_MODEL_COMMAND_ID,
+  TRANSFORM_SELECTION_COMMAND_ID
+};
+
+#endif  // ACTIONS__COMMAND_IDS_HPP_
@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef ACTIONS__COMPACTABLE_COMMAND_HPP_
+#define ACTIONS__COMPACTABLE_COMMAND_HPP_
+
+#include <cstddef>
+
+/// Implemented (alongside QUndoCommand) by the undo commands which can
+/// hold a lot of memory, so that UndoBudget can measure the undo stack and
+/// shrink the old part of it
+class CompactableCommand
+{
+public:
+  virtual ~CompactableCommand() {}
+
+  /// Roughly how many bytes the command holds, beyond its own size
+  virtual std::size_t memory_usage() const = 0;
+
+  /// Re-encode what the command holds more compactly. It is decoded again,
+  /// transparently, if the command is undone.
+  virtual void compact() {}
+
+  /// Drop everything the command holds; it can't be undone after this.
+  /// Called on the oldest commands once the budget is exceeded.
+  virtual void retire() = 0;
+};
+
+#endif  // ACTIONS__COMPACTABLE_COMMAND_HPP_
@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include "convert_coordinates.hpp"
+
+ConvertCoordinatesCommand::ConvertCoordinatesCommand(
+  Building* building,
+  const CoordinateConversion::State& converted)
+: _building(building),
+  _original(CoordinateConversion::capture(*building)),
+  _converted(converted)
+{
+  setText(
+    QString("Convert to %1").arg(
+      QString::fromStdString(converted.coordinate_system.to_string())));
+}
+
+void ConvertCoordinatesCommand::undo()
+{
+  CoordinateConversion::apply(*_building, _original);
+}
+
+void ConvertCoordinatesCommand::redo()
+{
+  CoordinateConversion::apply(*_building, _converted);
+}
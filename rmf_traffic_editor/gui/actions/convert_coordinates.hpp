@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef ACTIONS__CONVERT_COORDINATES_HPP_
+#define ACTIONS__CONVERT_COORDINATES_HPP_
+
+#include <QUndoCommand>
+
+#include "building.h"
+#include "coordinate_conversion.hpp"
+
+/// Puts a building into the state of a CoordinateConversion, keeping the
+/// state from before for undo(), so that the whole reprojection is one
+/// step, whichever levels and lifts it moves
+class ConvertCoordinatesCommand : public QUndoCommand
+{
+public:
+  ConvertCoordinatesCommand(
+    Building* building,
+    const CoordinateConversion::State& converted);
+
+  void undo() override;
+  void redo() override;
+
+private:
+  Building* _building;
+  CoordinateConversion::State _original;
+  CoordinateConversion::State _converted;
+};
+
+#endif  // ACTIONS__CONVERT_COORDINATES_HPP_
@@ -15,7 +15,12 @@
  *
 */
 
+#include <functional>
+
+#include <QString>
+
 #include "delete.h"
+#include "logging.hpp"
 
 DeleteCommand::DeleteCommand(Building* building, int level_idx)
 {
@@ -28,76 +33,309 @@ DeleteCommand::~DeleteCommand()
 
 }
 
-void DeleteCommand::undo()
+namespace {
+
+// Put deleted items back at their original (ascending) indices with a
+// single merge, rather than one vector::insert() per item.
+template<typename T>
+void reinsert(
+  std::vector<T>& items,
+  const std::vector<int>& indices,
+  const std::vector<T>& deleted,
+  std::function<bool(std::size_t)> filter = nullptr)
 {
-  for (size_t i = 0; i < _vertices.size(); i++)
+  std::vector<T> merged;
+  merged.reserve(items.size() + deleted.size());
+  std::size_t next = 0;
+  auto take_deleted = [&]()
+    {
+      while (next < deleted.size() &&
+        (filter && !filter(next)))
+        next++;
+      return next < deleted.size() &&
+        indices[next] <= static_cast<int>(merged.size());
+    };
+  for (T& item : items)
   {
-    _building->levels[_level_idx].vertices.insert(
-      _building->levels[_level_idx].vertices.begin() + _vertex_idx[i],
-      _vertices[i]);
+    while (take_deleted())
+      merged.push_back(deleted[next++]);
+    merged.push_back(std::move(item));
   }
-
-  for (size_t i = 0; i < _tags.size(); i++)
+  while (next < deleted.size())
   {
-    _building->levels[_level_idx].tags.insert(
-      _building->levels[_level_idx].tags.begin() + _tag_idx[i],
-      _tags[i]);
+    if (!filter || filter(next))
+      merged.push_back(deleted[next]);
+    next++;
   }
+  items.swap(merged);
+}
+
+std::size_t params_bytes(const ParamMap& params)
+{
+  std::size_t bytes = 0;
+  for (const auto& param : params)
+    bytes += sizeof(ParamMap::Entry) + param.second.value_string.size();
+  return bytes;
+}
+
+std::string uuid_string(const QUuid& uuid)
+{
+  return uuid.toString().toStdString();
+}
+
+QUuid uuid_from(const YAML::Node& node)
+{
+  return QUuid(QString::fromStdString(node.as<std::string>()));
+}
+
+}  // namespace
+
+std::size_t DeleteCommand::memory_usage() const
+{
+  if (_retired)
+    return 0;
+  if (!_compacted.isEmpty())
+    return static_cast<std::size_t>(_compacted.size());
+
+  std::size_t bytes = 0;
+  for (const Vertex& v : _vertices)
+    bytes += sizeof(Vertex) + v.name.size() + params_bytes(v.params);
+  for (const Tag& t : _tags)
+    bytes += sizeof(Tag) + params_bytes(t.params);
+  for (const Edge& e : _edges)
+    bytes += sizeof(Edge) + params_bytes(e.params);
+  for (const Polygon& p : _polygons)
+    bytes += sizeof(Polygon) + p.vertices.size() * sizeof(int) +
+      params_bytes(p.params);
+  for (const Model& m : _models)
+    bytes += sizeof(Model) + m.model_name.size() + m.instance_name.size();
+  bytes += _fiducials.size() * sizeof(Fiducial);
+  bytes += _features.size() * sizeof(Feature);
+  for (const Constraint& c : _constraints)
+    bytes += sizeof(Constraint) + c.ids().size() * sizeof(QUuid);
 
-  for (size_t i = 0; i < _edges.size(); i++)
+  bytes += sizeof(int) * (_vertex_idx.size() + _tag_idx.size() +
+    _edge_idx.size() + _model_idx.size() + _fiducial_idx.size() +
+    _polygon_idx.size() + 2 * _feature_idx.size() + _constraint_idx.size());
+  bytes += _items.size() * sizeof(Level::SelectedItem);
+  return bytes;
+}
+
+void DeleteCommand::compact()
+{
+  if (_retired || !_compacted.isEmpty())
+    return;
+
+  YAML::Node node;
+  for (std::size_t i = 0; i < _vertices.size(); i++)
   {
-    _building->levels[_level_idx].edges.insert(
-      _building->levels[_level_idx].edges.begin() + _edge_idx[i],
-      _edges[i]);
+    YAML::Node y;
+    y["idx"] = _vertex_idx[i];
+    y["uuid"] = uuid_string(_vertices[i].uuid);
+    y["data"] = _vertices[i].to_yaml();
+    node["vertices"].push_back(y);
   }
-
-  for (size_t i = 0; i < _models.size(); i++)
+  for (std::size_t i = 0; i < _tags.size(); i++)
   {
-    _building->levels[_level_idx].models.insert(
-      _building->levels[_level_idx].models.begin() + _model_idx[i],
-      _models[i]);
+    YAML::Node y;
+    y["idx"] = _tag_idx[i];
+    y["uuid"] = uuid_string(_tags[i].uuid);
+    y["data"] = _tags[i].to_yaml();
+    node["tags"].push_back(y);
   }
-
-  for (size_t i = 0; i < _fiducials.size(); i++)
+  for (std::size_t i = 0; i < _edges.size(); i++)
   {
-    _building->levels[_level_idx].fiducials.insert(
-      _building->levels[_level_idx].fiducials.begin() + _fiducial_idx[i],
-      _fiducials[i]);
+    YAML::Node y;
+    y["idx"] = _edge_idx[i];
+    y["type"] = static_cast<int>(_edges[i].type);
+    y["data"] = _edges[i].to_yaml();
+    node["edges"].push_back(y);
   }
-
-  for (size_t i = 0; i < _polygons.size(); i++)
+  for (std::size_t i = 0; i < _models.size(); i++)
   {
-    _building->levels[_level_idx].polygons.insert(
-      _building->levels[_level_idx].polygons.begin() + _polygon_idx[i],
-      _polygons[i]);
+    YAML::Node y;
+    y["idx"] = _model_idx[i];
+    y["uuid"] = uuid_string(_models[i].uuid);
+    y["editor_model_idx"] = _models[i].editor_model_idx;
+    y["data"] = _models[i].to_yaml();
+    node["models"].push_back(y);
   }
+  for (std::size_t i = 0; i < _fiducials.size(); i++)
+  {
+    YAML::Node y;
+    y["idx"] = _fiducial_idx[i];
+    y["uuid"] = uuid_string(_fiducials[i].uuid);
+    y["data"] = _fiducials[i].to_yaml();
+    node["fiducials"].push_back(y);
+  }
+  for (std::size_t i = 0; i < _polygons.size(); i++)
+  {
+    YAML::Node y;
+    y["idx"] = _polygon_idx[i];
+    y["type"] = static_cast<int>(_polygons[i].type);
+    y["data"] = _polygons[i].to_yaml();
+    node["polygons"].push_back(y);
+  }
+  for (std::size_t i = 0; i < _features.size(); i++)
+  {
+    YAML::Node y;
+    y["idx"] = _feature_idx[i];
+    y["layer_idx"] = _feature_layer_idx[i];
+    y["data"] = _features[i].to_yaml();  // includes the id
+    node["features"].push_back(y);
+  }
+  for (std::size_t i = 0; i < _constraints.size(); i++)
+  {
+    YAML::Node y;
+    y["idx"] = _constraint_idx[i];
+    y["data"] = _constraints[i].to_yaml();
+    node["constraints"].push_back(y);
+  }
+
+  YAML::Emitter emitter;
+  emitter << node;
+  const std::size_t original_bytes = memory_usage();
+  _compacted = qCompress(
+    reinterpret_cast<const uchar*>(emitter.c_str()),
+    static_cast<int>(emitter.size()));
+  clear_deleted();
+  qCDebug(lc_edit, "compacted a deletion from %zu to %d bytes",
+    original_bytes,
+    _compacted.size());
+}
+
+void DeleteCommand::expand()
+{
+  const QByteArray text = qUncompress(_compacted);
+  _compacted.clear();
+  const YAML::Node node = YAML::Load(text.toStdString());
+  const std::string& level_name = _building->levels[_level_idx].name;
 
-  for (size_t i = 0; i < _features.size(); i++)
+  for (const YAML::Node& y : node["vertices"])
   {
-    Level& level = _building->levels[_level_idx];
-    if (_feature_layer_idx[i] == 0)
-    {
-      level.floorplan_features.insert(
-        level.floorplan_features.begin() + _feature_idx[i],
-        _features[i]);
-    }
-    else
-    {
-      Layer& layer = level.layers[_feature_layer_idx[i] - 1];
-      layer.features.insert(
-        layer.features.begin() + _feature_idx[i],
-        _features[i]);
-    }
+    Vertex v;
+    v.from_yaml(y["data"]);
+    v.uuid = uuid_from(y["uuid"]);
+    v.selected = true;  // as they were when deleted
+    _vertices.push_back(v);
+    _vertex_idx.push_back(y["idx"].as<int>());
+  }
+  for (const YAML::Node& y : node["tags"])
+  {
+    Tag t;
+    t.from_yaml(y["data"]);
+    t.uuid = uuid_from(y["uuid"]);
+    t.selected = true;
+    _tags.push_back(t);
+    _tag_idx.push_back(y["idx"].as<int>());
+  }
+  for (const YAML::Node& y : node["edges"])
+  {
+    Edge e;
+    e.from_yaml(y["data"], static_cast<Edge::Type>(y["type"].as<int>()));
+    e.selected = true;
+    _edges.push_back(e);
+    _edge_idx.push_back(y["idx"].as<int>());
+  }
+  for (const YAML::Node& y : node["models"])
+  {
+    Model m;
+    m.from_yaml(y["data"], level_name);
+    m.uuid = uuid_from(y["uuid"]);
+    m.editor_model_idx = y["editor_model_idx"].as<int>();
+    m.selected = true;
+    _models.push_back(m);
+    _model_idx.push_back(y["idx"].as<int>());
+  }
+  for (const YAML::Node& y : node["fiducials"])
+  {
+    Fiducial f;
+    f.from_yaml(y["data"]);
+    f.uuid = uuid_from(y["uuid"]);
+    f.selected = true;
+    _fiducials.push_back(f);
+    _fiducial_idx.push_back(y["idx"].as<int>());
+  }
+  for (const YAML::Node& y : node["polygons"])
+  {
+    Polygon p;
+    p.from_yaml(
+      y["data"],
+      static_cast<Polygon::Type>(y["type"].as<int>()));
+    p.selected = true;
+    _polygons.push_back(p);
+    _polygon_idx.push_back(y["idx"].as<int>());
+  }
+  for (const YAML::Node& y : node["features"])
+  {
+    Feature f;
+    f.from_yaml(y["data"]);
+    f.setSelected(true);
+    _features.push_back(f);
+    _feature_idx.push_back(y["idx"].as<int>());
+    _feature_layer_idx.push_back(y["layer_idx"].as<int>());
+  }
+  for (const YAML::Node& y : node["constraints"])
+  {
+    Constraint c;
+    c.from_yaml(y["data"]);
+    c.setSelected(true);
+    _constraints.push_back(c);
+    _constraint_idx.push_back(y["idx"].as<int>());
   }
+}
+
+void DeleteCommand::retire()
+{
+  _retired = true;
+  _compacted.clear();
+  clear_deleted();
+  _items.clear();
+}
+
+void DeleteCommand::undo()
+{
+  if (_retired)
+    return;
+  if (!_compacted.isEmpty())
+    expand();
+
+  Level& level = _building->levels[_level_idx];
 
-  for (size_t i = 0; i < _constraints.size(); i++)
+  // vertices first, so that the restored edges and polygons (which refer
+  // to the original vertex indices) aren't renumbered
+  level.restore_vertices(_vertex_idx, _vertices);
+  reinsert(level.tags, _tag_idx, _tags);
+  reinsert(level.edges, _edge_idx, _edges);
+  reinsert(level.models, _model_idx, _models);
+  reinsert(level.fiducials, _fiducial_idx, _fiducials);
+  reinsert(level.polygons, _polygon_idx, _polygons);
+
+  reinsert(
+    level.floorplan_features,
+    _feature_idx,
+    _features,
+    [this](std::size_t i) { return _feature_layer_idx[i] == 0; });
+  for (std::size_t layer_idx = 0; layer_idx < level.layers.size();
+    layer_idx++)
   {
-    Level& level = _building->levels[_level_idx];
-    level.constraints.insert(
-      level.constraints.begin() + _constraint_idx[i],
-      _constraints[i]);
+    reinsert(
+      level.layers[layer_idx].features,
+      _feature_idx,
+      _features,
+      [this, layer_idx](std::size_t i)
+      {
+        return _feature_layer_idx[i] == static_cast<int>(layer_idx) + 1;
+      });
   }
 
+  reinsert(level.constraints, _constraint_idx, _constraints);
+  level.mark_all_changed();
+  clear_deleted();
+}
+
+void DeleteCommand::clear_deleted()
+{
   _vertices.clear();
   _vertex_idx.clear();
   _tags.clear();
@@ -121,10 +359,24 @@ void DeleteCommand::undo()
 
 void DeleteCommand::redo()
 {
-  std::vector<Level::SelectedItem> selected_items;
-  _building->get_selected_items(_level_idx, selected_items);
+  if (_retired)
+    return;
+  if (!_items_recorded)
+  {
+    _building->get_selected_items(_level_idx, _items);
+    _items_recorded = true;
+  }
+  else
+  {
+    // select what was deleted the first time, since the selection may
+    // have changed (or been lost, by compact()) since the undo
+    Level& level = _building->levels[_level_idx];
+    level.clear_selection();
+    for (const Level::SelectedItem& item : _items)
+      level.select(item);
+  }
 
-  for (auto& item: selected_items)
+  for (const auto& item : _items)
   {
     if (item.model_idx >= 0)
     {
@@ -167,7 +419,7 @@ void DeleteCommand::redo()
       _polygons.push_back(
         _building->levels[_level_idx].polygons[item.polygon_idx]
       );
-      _polygon_idx.push_back(item.edge_idx); // (MQ) should be polygon_idx ?
+      _polygon_idx.push_back(item.polygon_idx);
     }
 
     if (item.feature_idx >= 0)
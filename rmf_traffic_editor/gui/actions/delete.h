@@ -1,10 +1,12 @@
 #ifndef _DELETE_H_
 #define _DELETE_H_
 
+#include <QByteArray>
 #include <QUndoCommand>
+#include "actions/compactable_command.hpp"
 #include "building.h"
 
-class DeleteCommand : public QUndoCommand
+class DeleteCommand : public QUndoCommand, public CompactableCommand
 {
 public:
   DeleteCommand(Building* building, int level_idx);
@@ -12,7 +14,26 @@ public:
   void undo() override;
   void redo() override;
 
+  std::size_t memory_usage() const override;
+
+  /// Serialize the deleted entities (as in the building file, plus their
+  /// uuids) into a compressed blob
+  void compact() override;
+  void retire() override;
+
 private:
+  /// The compact() form of the vectors below, if they were compacted
+  QByteArray _compacted;
+  bool _retired = false;
+
+  void clear_deleted();
+  void expand();
+
+  /// What the first redo() deleted. Later redos delete exactly these,
+  /// whatever was selected in the meantime.
+  std::vector<Level::SelectedItem> _items;
+  bool _items_recorded = false;
+
   std::vector<Vertex> _vertices;
   std::vector<int> _vertex_idx;
   std::vector<Tag> _tags;
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "merge_building.hpp"
+
+MergeBuildingCommand::MergeBuildingCommand(
+  Building* building,
+  const std::vector<BuildingMerger::LevelImport>& levels)
+: _building(building),
+  _levels(levels),
+  _sizes(levels.size())
+{
+  setText("Merge building");
+}
+
+void MergeBuildingCommand::undo()
+{
+  for (std::size_t i = _levels.size(); i-- > 0; )
+  {
+    const int level_idx = _levels[i].level_idx;
+    if (level_idx < 0 ||
+      level_idx >= static_cast<int>(_building->levels.size()))
+      continue;
+    Level& level = _building->levels[level_idx];
+    const Sizes& sizes = _sizes[i];
+    if (level.vertices.size() >= sizes.vertices)
+      level.vertices.erase(
+        level.vertices.begin() + sizes.vertices,
+        level.vertices.end());
+    if (level.edges.size() >= sizes.edges)
+      level.edges.erase(level.edges.begin() + sizes.edges, level.edges.end());
+    if (level.polygons.size() >= sizes.polygons)
+      level.polygons.erase(
+        level.polygons.begin() + sizes.polygons,
+        level.polygons.end());
+    if (level.models.size() >= sizes.models)
+      level.models.erase(
+        level.models.begin() + sizes.models,
+        level.models.end());
+    level.mark_all_changed();
+  }
+}
+
+void MergeBuildingCommand::redo()
+{
+  for (std::size_t i = 0; i < _levels.size(); i++)
+  {
+    const BuildingMerger::LevelImport& level_import = _levels[i];
+    if (level_import.level_idx < 0 ||
+      level_import.level_idx >= static_cast<int>(_building->levels.size()))
+      continue;
+    Level& level = _building->levels[level_import.level_idx];
+    Sizes& sizes = _sizes[i];
+    sizes.vertices = level.vertices.size();
+    sizes.edges = level.edges.size();
+    sizes.polygons = level.polygons.size();
+    sizes.models = level.models.size();
+
+    // the imported edges and polygons were numbered from these sizes
+    level.vertices.insert(
+      level.vertices.end(),
+      level_import.vertices.begin(),
+      level_import.vertices.end());
+    level.edges.insert(
+      level.edges.end(),
+      level_import.edges.begin(),
+      level_import.edges.end());
+    level.polygons.insert(
+      level.polygons.end(),
+      level_import.polygons.begin(),
+      level_import.polygons.end());
+    level.models.insert(
+      level.models.end(),
+      level_import.models.begin(),
+      level_import.models.end());
+    level.mark_all_changed();
+  }
+}
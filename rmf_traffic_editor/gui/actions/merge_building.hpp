@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef ACTIONS__MERGE_BUILDING_HPP_
+#define ACTIONS__MERGE_BUILDING_HPP_
+
+#include <vector>
+
+#include <QUndoCommand>
+
+#include "building.h"
+#include "building_merger.hpp"
+
+/// Appends what a BuildingMerger found to the levels of a building. Only
+/// appending means undo() just cuts the levels back to their sizes from
+/// before, however many entities were imported.
+class MergeBuildingCommand : public QUndoCommand
+{
+public:
+  MergeBuildingCommand(
+    Building* building,
+    const std::vector<BuildingMerger::LevelImport>& levels);
+
+  void undo() override;
+  void redo() override;
+
+private:
+  struct Sizes
+  {
+    std::size_t vertices = 0;
+    std::size_t edges = 0;
+    std::size_t polygons = 0;
+    std::size_t models = 0;
+  };
+
+  Building* _building;
+  std::vector<BuildingMerger::LevelImport> _levels;
+  std::vector<Sizes> _sizes;
+};
+
+#endif  // ACTIONS__MERGE_BUILDING_HPP_
@@ -25,53 +25,79 @@ MoveFeatureCommand::MoveFeatureCommand(
 : has_moved(false),
   _building(building),
   _level_idx(level_idx),
-  _layer_idx(layer_idx),
-  _feature_idx(feature_idx)
+  _layer_idx_hint(layer_idx),
+  _feature_idx_hint(feature_idx)
 {
-  Feature* f = nullptr;
-  if (layer_idx == 0)
-  {
-    f = &_building->levels[_level_idx].floorplan_features[_feature_idx];
-  }
-  else
+  const Level& level = _building->levels[_level_idx];
+  const Feature& f = layer_idx == 0 ?
+    level.floorplan_features[feature_idx] :
+    level.layers[layer_idx - 1].features[feature_idx];
+  _uuid = f.id();
+  _final_x = _original_x = f.x();
+  _final_y = _original_y = f.y();
+}
+
+Feature* MoveFeatureCommand::find_feature()
+{
+  Level& level = _building->levels[_level_idx];
+  std::vector<Feature>* features = nullptr;
+  if (_layer_idx_hint == 0)
+    features = &level.floorplan_features;
+  else if (_layer_idx_hint > 0 &&
+    _layer_idx_hint <= static_cast<int>(level.layers.size()))
+    features = &level.layers[_layer_idx_hint - 1].features;
+
+  if (!features ||
+    _feature_idx_hint < 0 ||
+    _feature_idx_hint >= static_cast<int>(features->size()) ||
+    (*features)[_feature_idx_hint].id() != _uuid)
   {
-    f = &_building->levels[_level_idx].
-      layers[_layer_idx-1].features[_feature_idx];
+    if (!level.find_feature_index(_uuid, _layer_idx_hint, _feature_idx_hint))
+      return nullptr;
+    features = _layer_idx_hint == 0 ?
+      &level.floorplan_features :
+      &level.layers[_layer_idx_hint - 1].features;
   }
-  _final_x = _original_x = f->x();
-  _final_y = _original_y = f->y();
+  return &(*features)[_feature_idx_hint];
+}
+
+void MoveFeatureCommand::mark_changed()
+{
+  Level::SelectedItem item;
+  item.feature_layer_idx = _layer_idx_hint;
+  item.feature_idx = _feature_idx_hint;
+  _building->levels[_level_idx].mark_changed(item);
 }
 
 void MoveFeatureCommand::undo()
 {
-  Feature* f = nullptr;
-  if (_layer_idx == 0)
-  {
-    f = &_building->levels[_level_idx].floorplan_features[_feature_idx];
-  }
-  else
-  {
-    f = &_building->levels[_level_idx].
-      layers[_layer_idx-1].features[_feature_idx];
-  }
+  Feature* f = find_feature();
+  if (!f)
+    return;
   f->set_x(_original_x);
   f->set_y(_original_y);
+  mark_changed();
 }
 
 void MoveFeatureCommand::redo()
 {
-  Feature* f = nullptr;
-  if (_layer_idx == 0)
-  {
-    f = &_building->levels[_level_idx].floorplan_features[_feature_idx];
-  }
-  else
-  {
-    f = &_building->levels[_level_idx].
-      layers[_layer_idx-1].features[_feature_idx];
-  }
+  Feature* f = find_feature();
+  if (!f)
+    return;
   f->set_x(_final_x);
   f->set_y(_final_y);
+  mark_changed();
+}
+
+bool MoveFeatureCommand::mergeWith(const QUndoCommand* other)
+{
+  const MoveFeatureCommand* move =
+    static_cast<const MoveFeatureCommand*>(other);
+  if (move->_level_idx != _level_idx || move->_uuid != _uuid)
+    return false;
+  _final_x = move->_final_x;
+  _final_y = move->_final_y;
+  return true;
 }
 
 void MoveFeatureCommand::set_final_destination(double x, double y)
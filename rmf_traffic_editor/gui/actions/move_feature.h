@@ -21,6 +21,7 @@
 #include <QUndoCommand>
 #include <QUuid>
 
+#include "actions/command_ids.hpp"
 #include "building.h"
 
 class MoveFeatureCommand : public QUndoCommand
@@ -35,13 +36,24 @@ public:
   void undo() override;
   void redo() override;
 
+  /// Successive moves of the same feature become one undo step
+  int id() const override { return MOVE_FEATURE_COMMAND_ID; }
+  bool mergeWith(const QUndoCommand* other) override;
+
   void set_final_destination(double x, double y);
 
   bool has_moved;
 
 private:
+  /// The feature is found by uuid, starting from where it was
+  Feature* find_feature();
+
+  /// Report the move of the feature just found, for a redraw
+  void mark_changed();
+
   Building* _building;
-  int _level_idx, _layer_idx, _feature_idx;
+  int _level_idx, _layer_idx_hint, _feature_idx_hint;
+  QUuid _uuid;
   double _original_x, _original_y;
   double _final_x, _final_y;
 };
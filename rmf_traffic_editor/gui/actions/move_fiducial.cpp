@@ -23,11 +23,15 @@ MoveFiducialCommand::MoveFiducialCommand(
   int fiducial_id)
 {
   _building = building;
-  Fiducial fiducial = _building->levels[level].fiducials[fiducial_id];
+  const Fiducial& fiducial =
+    _building->levels[level].fiducials[fiducial_id];
   _original_x = fiducial.x;
   _original_y = fiducial.y;
+  _final_x = _original_x;
+  _final_y = _original_y;
   _level_id = level;
-  _fiducial_id = fiducial_id;
+  _fiducial_idx_hint = fiducial_id;
+  _uuid = fiducial.uuid;
   has_moved = false;
 }
 
@@ -35,20 +39,46 @@ MoveFiducialCommand::~MoveFiducialCommand()
 {
 }
 
+int MoveFiducialCommand::find_fiducial()
+{
+  const Level& level = _building->levels[_level_id];
+  if (_fiducial_idx_hint < 0 ||
+    _fiducial_idx_hint >= static_cast<int>(level.fiducials.size()) ||
+    level.fiducials[_fiducial_idx_hint].uuid != _uuid)
+    _fiducial_idx_hint = level.find_fiducial_index(_uuid);
+  return _fiducial_idx_hint;
+}
+
+void MoveFiducialCommand::move_to(const double x, const double y)
+{
+  const int fiducial_idx = find_fiducial();
+  if (fiducial_idx < 0)
+    return;
+  Level& level = _building->levels[_level_id];
+  level.fiducials[fiducial_idx].x = x;
+  level.fiducials[fiducial_idx].y = y;
+  level.mark_changed(Level::FIDUCIAL, fiducial_idx);
+}
+
 void MoveFiducialCommand::undo()
 {
-  Fiducial& fiducial =
-    _building->levels[_level_id].fiducials[_fiducial_id];
-  fiducial.x = _original_x;
-  fiducial.y = _original_y;
+  move_to(_original_x, _original_y);
 }
 
 void MoveFiducialCommand::redo()
 {
-  Fiducial& fiducial =
-    _building->levels[_level_id].fiducials[_fiducial_id];
-  fiducial.x = _final_x;
-  fiducial.y = _final_y;
+  move_to(_final_x, _final_y);
+}
+
+bool MoveFiducialCommand::mergeWith(const QUndoCommand* other)
+{
+  const MoveFiducialCommand* move =
+    static_cast<const MoveFiducialCommand*>(other);
+  if (move->_level_id != _level_id || move->_uuid != _uuid)
+    return false;
+  _final_x = move->_final_x;
+  _final_y = move->_final_y;
+  return true;
 }
 
 void MoveFiducialCommand::set_final_destination(double x, double y)
@@ -19,6 +19,8 @@
 #define _MOVE_FIDUCIAL_H_
 
 #include <QUndoCommand>
+#include <QUuid>
+#include "actions/command_ids.hpp"
 #include "building.h"
 
 class MoveFiducialCommand : public QUndoCommand
@@ -34,13 +36,22 @@ public:
   void undo() override;
   void redo() override;
 
+  /// Successive moves of the same fiducial become one undo step
+  int id() const override { return MOVE_FIDUCIAL_COMMAND_ID; }
+  bool mergeWith(const QUndoCommand* other) override;
+
   void set_final_destination(double x, double y);
 
   bool has_moved;
 private:
+  /// Index of the fiducial, found by uuid starting from where it was, or -1
+  int find_fiducial();
+  void move_to(const double x, const double y);
+
   double _original_x, _original_y;
   double _final_x, _final_y;
-  int _level_id, _fiducial_id;
+  int _level_id, _fiducial_idx_hint;
+  QUuid _uuid;
   Building* _building;
 };
 
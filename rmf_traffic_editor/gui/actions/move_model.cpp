@@ -24,11 +24,14 @@ MoveModelCommand::MoveModelCommand(
 )
 {
   _building = building;
-  Model model = _building->levels[level].models[model_id];
+  const Model& model = _building->levels[level].models[model_id];
   _original_x = model.state.x;
   _original_y = model.state.y;
+  _final_x = _original_x;
+  _final_y = _original_y;
   _level_id = level;
-  _model_id = model_id;
+  _model_idx_hint = model_id;
+  _uuid = model.uuid;
   has_moved = false;
 }
 
@@ -37,18 +40,46 @@ MoveModelCommand::~MoveModelCommand()
 
 }
 
+Model* MoveModelCommand::find_model()
+{
+  Level& level = _building->levels[_level_id];
+  if (_model_idx_hint < 0 ||
+    _model_idx_hint >= static_cast<int>(level.models.size()) ||
+    level.models[_model_idx_hint].uuid != _uuid)
+    _model_idx_hint = level.find_model_index(_uuid);
+  if (_model_idx_hint < 0)
+    return nullptr;
+  return &level.models[_model_idx_hint];
+}
+
 void MoveModelCommand::undo()
 {
-  Model& model = _building->levels[_level_id].models[_model_id];
-  model.state.x = _original_x;
-  model.state.y = _original_y;
+  Model* model = find_model();
+  if (!model)
+    return;
+  model->state.x = _original_x;
+  model->state.y = _original_y;
+  _building->levels[_level_id].mark_changed(Level::MODEL, _model_idx_hint);
 }
 
 void MoveModelCommand::redo()
 {
-  Model& model = _building->levels[_level_id].models[_model_id];
-  model.state.x = _final_x;
-  model.state.y = _final_y;
+  Model* model = find_model();
+  if (!model)
+    return;
+  model->state.x = _final_x;
+  model->state.y = _final_y;
+  _building->levels[_level_id].mark_changed(Level::MODEL, _model_idx_hint);
+}
+
+bool MoveModelCommand::mergeWith(const QUndoCommand* other)
+{
+  const MoveModelCommand* move = static_cast<const MoveModelCommand*>(other);
+  if (move->_level_id != _level_id || move->_uuid != _uuid)
+    return false;
+  _final_x = move->_final_x;
+  _final_y = move->_final_y;
+  return true;
 }
 
 void MoveModelCommand::set_final_destination(double x, double y)
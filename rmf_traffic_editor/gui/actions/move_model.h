@@ -19,6 +19,8 @@
 #define _MOVE_MODEL_H_
 
 #include <QUndoCommand>
+#include <QUuid>
+#include "actions/command_ids.hpp"
 #include "building.h"
 
 class MoveModelCommand : public QUndoCommand
@@ -34,13 +36,21 @@ public:
   void undo() override;
   void redo() override;
 
+  /// Successive moves of the same model become one undo step
+  int id() const override { return MOVE_MODEL_COMMAND_ID; }
+  bool mergeWith(const QUndoCommand* other) override;
+
   void set_final_destination(double x, double y);
 
   bool has_moved;
 private:
+  /// The model is found by uuid, starting from where it was
+  Model* find_model();
+
   double _original_x, _original_y;
   double _final_x, _final_y;
-  int _level_id, _model_id;
+  int _level_id, _model_idx_hint;
+  QUuid _uuid;
   Building* _building;
 };
 
@@ -23,7 +23,10 @@ MoveTagCommand::MoveTagCommand(
   int mouse_tag_idx)
 {
   _building = building;
-  _to_move = _building->levels[level_idx].tags[mouse_tag_idx];
+  const Tag& t = _building->levels[level_idx].tags[mouse_tag_idx];
+  _uuid = t.uuid;
+  _original_x = t.x;
+  _original_y = t.y;
   _level_idx = level_idx;
   has_moved = false;
 }
@@ -40,17 +43,27 @@ void MoveTagCommand::set_final_destination(double x, double y)
   has_moved = true;
 }
 
+bool MoveTagCommand::mergeWith(const QUndoCommand* other)
+{
+  const MoveTagCommand* move = static_cast<const MoveTagCommand*>(other);
+  if (move->_level_idx != _level_idx || move->_uuid != _uuid)
+    return false;
+  _x = move->_x;
+  _y = move->_y;
+  return true;
+}
+
 void MoveTagCommand::undo()
 {
   //Use ID because in future if we want to support photoshop style selective
   //undo-redos it will be consistent even after deletion of intermediate vertices.
-  for (Tag& tag: _building->levels[_level_idx].tags)
+  Level& level = _building->levels[_level_idx];
+  const int tag_idx = level.find_tag_index(_uuid);
+  if (tag_idx >= 0)
   {
-    if (tag.uuid == _to_move.uuid)
-    {
-      tag.x = _to_move.x;
-      tag.y = _to_move.y;
-    }
+    level.tags[tag_idx].x = _original_x;
+    level.tags[tag_idx].y = _original_y;
+    level.mark_changed(Level::TAG, tag_idx);
   }
 }
 
@@ -58,12 +71,12 @@ void MoveTagCommand::redo()
 {
   //Use ID because in future if we want to support photoshop style selective
   //undo-redos it will be consistent even after deletion of intermediate vertices.
-  for (Tag& tag: _building->levels[_level_idx].tags)
+  Level& level = _building->levels[_level_idx];
+  const int tag_idx = level.find_tag_index(_uuid);
+  if (tag_idx >= 0)
   {
-    if (tag.uuid == _to_move.uuid)
-    {
-      tag.x = _x;
-      tag.y = _y;
-    }
+    level.tags[tag_idx].x = _x;
+    level.tags[tag_idx].y = _y;
+    level.mark_changed(Level::TAG, tag_idx);
   }
 }
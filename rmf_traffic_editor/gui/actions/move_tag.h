@@ -19,6 +19,7 @@
 #define MOVE_TAG_H
 
 #include <QUndoCommand>
+#include "actions/command_ids.hpp"
 #include "building.h"
 #include "tag.h"
 
@@ -33,10 +34,15 @@ public:
   void undo() override;
   void redo() override;
 
+  /// Successive moves of the same tag become one undo step
+  int id() const override { return MOVE_TAG_COMMAND_ID; }
+  bool mergeWith(const QUndoCommand* other) override;
+
 private:
   Building* _building;
   int _level_idx;
-  Tag _to_move;
+  QUuid _uuid;
+  double _original_x, _original_y;
   double _x, _y;
 };
 
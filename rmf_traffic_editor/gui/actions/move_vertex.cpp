@@ -23,7 +23,10 @@ MoveVertexCommand::MoveVertexCommand(
   int mouse_vertex_idx)
 {
   _building = building;
-  _to_move = _building->levels[level_idx].vertices[mouse_vertex_idx];
+  const Vertex& v = _building->levels[level_idx].vertices[mouse_vertex_idx];
+  _uuid = v.uuid;
+  _original_x = v.x;
+  _original_y = v.y;
   _level_idx = level_idx;
   has_moved = false;
 }
@@ -40,17 +43,28 @@ void MoveVertexCommand::set_final_destination(double x, double y)
   has_moved = true;
 }
 
+bool MoveVertexCommand::mergeWith(const QUndoCommand* other)
+{
+  const MoveVertexCommand* move =
+    static_cast<const MoveVertexCommand*>(other);
+  if (move->_level_idx != _level_idx || move->_uuid != _uuid)
+    return false;
+  _x = move->_x;
+  _y = move->_y;
+  return true;
+}
+
 void MoveVertexCommand::undo()
 {
   //Use ID because in future if we want to support photoshop style selective
   //undo-redos it will be consistent even after deletion of intermediate vertices.
-  for (Vertex& vert: _building->levels[_level_idx].vertices)
+  Level& level = _building->levels[_level_idx];
+  const int vertex_idx = level.find_vertex_index(_uuid);
+  if (vertex_idx >= 0)
   {
-    if (vert.uuid == _to_move.uuid)
-    {
-      vert.x = _to_move.x;
-      vert.y = _to_move.y;
-    }
+    level.vertices[vertex_idx].x = _original_x;
+    level.vertices[vertex_idx].y = _original_y;
+    level.mark_changed(Level::VERTEX, vertex_idx);
   }
 }
 
@@ -58,12 +72,12 @@ void MoveVertexCommand::redo()
 {
   //Use ID because in future if we want to support photoshop style selective
   //undo-redos it will be consistent even after deletion of intermediate vertices.
-  for (Vertex& vert: _building->levels[_level_idx].vertices)
+  Level& level = _building->levels[_level_idx];
+  const int vertex_idx = level.find_vertex_index(_uuid);
+  if (vertex_idx >= 0)
   {
-    if (vert.uuid == _to_move.uuid)
-    {
-      vert.x = _x;
-      vert.y = _y;
-    }
+    level.vertices[vertex_idx].x = _x;
+    level.vertices[vertex_idx].y = _y;
+    level.mark_changed(Level::VERTEX, vertex_idx);
   }
 }
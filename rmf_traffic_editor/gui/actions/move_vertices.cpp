@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "move_vertices.hpp"
+
+MoveVerticesCommand::MoveVerticesCommand(
+  Building* building,
+  int level_idx,
+  const std::vector<ColinearAlignment::Move>& moves)
+: _building(building),
+  _level_idx(level_idx)
+{
+  setText("Align colinear vertices");
+  const Level& level = _building->levels[_level_idx];
+  for (const ColinearAlignment::Move& move : moves)
+  {
+    const Vertex& v = level.vertices[move.idx];
+    _uuids.push_back(v.uuid);
+    _original_positions.push_back(QPointF(v.x, v.y));
+    _final_positions.push_back(QPointF(move.x, move.y));
+  }
+}
+
+std::size_t MoveVerticesCommand::memory_usage() const
+{
+  return _uuids.size() * (sizeof(QUuid) + 2 * sizeof(QPointF));
+}
+
+void MoveVerticesCommand::retire()
+{
+  _uuids = std::vector<QUuid>();
+  _original_positions = std::vector<QPointF>();
+  _final_positions = std::vector<QPointF>();
+}
+
+void MoveVerticesCommand::undo()
+{
+  apply(_original_positions);
+}
+
+void MoveVerticesCommand::redo()
+{
+  apply(_final_positions);
+}
+
+void MoveVerticesCommand::apply(const std::vector<QPointF>& positions)
+{
+  // by uuid, like MoveVertexCommand
+  Level& level = _building->levels[_level_idx];
+  for (std::size_t i = 0; i < _uuids.size(); i++)
+  {
+    const int vertex_idx = level.find_vertex_index(_uuids[i]);
+    if (vertex_idx < 0)
+      continue;
+    level.vertices[vertex_idx].x = positions[i].x();
+    level.vertices[vertex_idx].y = positions[i].y();
+  }
+  level.mark_all_changed();
+}
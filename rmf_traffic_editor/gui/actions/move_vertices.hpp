@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef ACTIONS__MOVE_VERTICES_HPP_
+#define ACTIONS__MOVE_VERTICES_HPP_
+
+#include <vector>
+
+#include <QUndoCommand>
+#include <QUuid>
+
+#include "actions/compactable_command.hpp"
+#include "building.h"
+#include "colinear_alignment.hpp"
+
+/// Moves many vertices of a level at once, such as everything which
+/// Level::colinear_alignment() straightens, as a single undo step
+class MoveVerticesCommand : public QUndoCommand, public CompactableCommand
+{
+public:
+  MoveVerticesCommand(
+    Building* building,
+    int level_idx,
+    const std::vector<ColinearAlignment::Move>& moves);
+
+  std::size_t size() const { return _uuids.size(); }
+
+  void undo() override;
+  void redo() override;
+
+  std::size_t memory_usage() const override;
+  void retire() override;
+
+private:
+  Building* _building;
+  int _level_idx;
+  std::vector<QUuid> _uuids;
+  std::vector<QPointF> _original_positions;
+  std::vector<QPointF> _final_positions;
+
+  void apply(const std::vector<QPointF>& positions);
+};
+
+#endif  // ACTIONS__MOVE_VERTICES_HPP_
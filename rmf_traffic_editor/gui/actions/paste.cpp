@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include "paste.hpp"
+
+PasteCommand::PasteCommand(
+  Building* building,
+  const int level_idx,
+  const SelectionClipboard& clip)
+: _building(building),
+  _level_idx(level_idx),
+  _clip(clip)
+{
+  setText(QString("Paste %1 items").arg(static_cast<int>(clip.size())));
+}
+
+void PasteCommand::undo()
+{
+  if (_level_idx < 0 ||
+    _level_idx >= static_cast<int>(_building->levels.size()))
+    return;
+  Level& level = _building->levels[_level_idx];
+  if (level.vertices.size() >= _sizes.vertices)
+    level.vertices.erase(
+      level.vertices.begin() + _sizes.vertices,
+      level.vertices.end());
+  if (level.edges.size() >= _sizes.edges)
+    level.edges.erase(level.edges.begin() + _sizes.edges, level.edges.end());
+  if (level.polygons.size() >= _sizes.polygons)
+    level.polygons.erase(
+      level.polygons.begin() + _sizes.polygons,
+      level.polygons.end());
+  if (level.models.size() >= _sizes.models)
+    level.models.erase(
+      level.models.begin() + _sizes.models,
+      level.models.end());
+  level.mark_all_changed();
+}
+
+void PasteCommand::redo()
+{
+  if (_level_idx < 0 ||
+    _level_idx >= static_cast<int>(_building->levels.size()))
+    return;
+  Level& level = _building->levels[_level_idx];
+  _sizes.vertices = level.vertices.size();
+  _sizes.edges = level.edges.size();
+  _sizes.polygons = level.polygons.size();
+  _sizes.models = level.models.size();
+
+  // the clip numbers its vertices from zero
+  const int offset = static_cast<int>(_sizes.vertices);
+  level.vertices.insert(
+    level.vertices.end(),
+    _clip.vertices.begin(),
+    _clip.vertices.end());
+  for (const Edge& edge : _clip.edges)
+  {
+    level.edges.push_back(edge);
+    level.edges.back().start_idx += offset;
+    level.edges.back().end_idx += offset;
+  }
+  for (const Polygon& polygon : _clip.polygons)
+  {
+    level.polygons.push_back(polygon);
+    for (int& v_idx : level.polygons.back().vertices)
+      v_idx += offset;
+  }
+  for (const Model& model : _clip.models)
+  {
+    level.models.push_back(model);
+    level.models.back().state.level_name = level.name;
+  }
+
+  auto add = [&level](const Level::ItemType type, const std::size_t idx)
+    {
+      const Level::SelectedItem item =
+        Level::make_selected_item(type, static_cast<int>(idx));
+      level.select(item);
+      level.mark_changed(item);
+    };
+  for (std::size_t i = _sizes.vertices; i < level.vertices.size(); i++)
+    add(Level::VERTEX, i);
+  for (std::size_t i = _sizes.edges; i < level.edges.size(); i++)
+    add(Level::EDGE, i);
+  for (std::size_t i = _sizes.polygons; i < level.polygons.size(); i++)
+    add(Level::POLYGON, i);
+  for (std::size_t i = _sizes.models; i < level.models.size(); i++)
+    add(Level::MODEL, i);
+}
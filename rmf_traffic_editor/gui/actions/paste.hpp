@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef ACTIONS__PASTE_HPP_
+#define ACTIONS__PASTE_HPP_
+
+#include <QUndoCommand>
+
+#include "building.h"
+#include "selection_clipboard.hpp"
+
+/// Appends a clip to a level, already placed where it should go, and
+/// selects what it added. Like MergeBuildingCommand it only appends, so
+/// undo() cuts the level back to its sizes from before, and the scene and
+/// picking index follow the new entities one by one.
+class PasteCommand : public QUndoCommand
+{
+public:
+  PasteCommand(
+    Building* building,
+    const int level_idx,
+    const SelectionClipboard& clip);
+
+  void undo() override;
+  void redo() override;
+
+private:
+  struct Sizes
+  {
+    std::size_t vertices = 0;
+    std::size_t edges = 0;
+    std::size_t polygons = 0;
+    std::size_t models = 0;
+  };
+
+  Building* _building;
+  int _level_idx;
+  SelectionClipboard _clip;
+  Sizes _sizes;
+};
+
+#endif  // ACTIONS__PASTE_HPP_
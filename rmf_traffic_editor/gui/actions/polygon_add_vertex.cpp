@@ -18,10 +18,12 @@
 #include "polygon_add_vertex.h"
 
 PolygonAddVertCommand::PolygonAddVertCommand(
+  Level* level,
   Polygon* polygon,
   int position,
   int vert_id)
 {
+  _level = level;
   _polygon = polygon;
   _old_vertices = polygon->vertices;
   _position = position;
@@ -36,6 +38,7 @@ PolygonAddVertCommand::~PolygonAddVertCommand()
 void PolygonAddVertCommand::undo()
 {
   _polygon->vertices.erase(_polygon->vertices.begin() + _position);
+  _level->mark_all_changed();
 }
 
 void PolygonAddVertCommand::redo()
@@ -43,4 +46,5 @@ void PolygonAddVertCommand::redo()
   _polygon->vertices.insert(
     _polygon->vertices.begin() + _position,
     _vert_id);
+  _level->mark_all_changed();
 }
\ No newline at end of file
@@ -19,13 +19,16 @@
 #define _POLYGON_ADD_H_
 
 #include <QUndoCommand>
+#include "level.h"
 #include "polygon.h"
 
 class PolygonAddVertCommand : public QUndoCommand
 {
 
 public:
+  /// The polygon belongs to the level, which is told of the change
   PolygonAddVertCommand(
+    Level* level,
     Polygon* polygon,
     int position,
     int vert_id);
@@ -33,6 +36,7 @@ public:
   void undo() override;
   void redo() override;
 private:
+  Level* _level;
   Polygon* _polygon;
   int _vert_id;
   int _position;
@@ -17,9 +17,11 @@
 
 #include "polygon_remove_vertices.h"
 PolygonRemoveVertCommand::PolygonRemoveVertCommand(
+  Level* level,
   Polygon* polygon,
   int vert_id)
 {
+  _level = level;
   _polygon = polygon;
   _vert_id = vert_id;
   _old_vertices = polygon->vertices;
@@ -32,9 +34,11 @@ PolygonRemoveVertCommand::~PolygonRemoveVertCommand()
 void PolygonRemoveVertCommand::undo()
 {
   _polygon->vertices = _old_vertices;
+  _level->mark_all_changed();
 }
 
 void PolygonRemoveVertCommand::redo()
 {
   _polygon->remove_vertex(_vert_id);
+  _level->mark_all_changed();
 }
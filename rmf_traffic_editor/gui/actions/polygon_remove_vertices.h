@@ -19,19 +19,23 @@
 #define _POLYGON_REMOVE_H_
 
 #include <QUndoCommand>
+#include "level.h"
 #include "polygon.h"
 
 class PolygonRemoveVertCommand : public QUndoCommand
 {
 
 public:
+  /// The polygon belongs to the level, which is told of the change
   PolygonRemoveVertCommand(
+    Level* level,
     Polygon* polygon,
     int vert_id);
   virtual ~PolygonRemoveVertCommand();
   void undo() override;
   void redo() override;
 private:
+  Level* _level;
   Polygon* _polygon;
   int _vert_id;
   std::vector<int> _old_vertices;
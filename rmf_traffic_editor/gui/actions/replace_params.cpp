@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "replace_params.hpp"
+#include "set_params.hpp"
+
+ReplaceParamsCommand::ReplaceParamsCommand(
+  Building* building,
+  const std::vector<ParamIndex::Match>& matches)
+: _building(building)
+{
+  for (const ParamIndex::Match& match : matches)
+  {
+    if (match.level_idx < 0 ||
+      match.level_idx >= static_cast<int>(_building->levels.size()))
+      continue;
+    Change change;
+    change.level_idx = match.level_idx;
+    change.item = match.item();
+    const ParamMap* params = SetParamsCommand::params_of(
+      _building->levels[match.level_idx],
+      change.item);
+    if (params == nullptr)
+      continue;
+    const auto it = params->find(*match.key);
+    if (it == params->end())
+      continue;
+    change.key = match.key;
+    change.before = it->second;
+    change.after = match.after;
+    _changes.push_back(std::move(change));
+  }
+  setText(QString("Replace %1 params").arg(static_cast<int>(_changes.size())));
+}
+
+std::size_t ReplaceParamsCommand::memory_usage() const
+{
+  std::size_t bytes = _changes.capacity() * sizeof(Change);
+  for (const Change& change : _changes)
+    bytes += change.before.value_string.capacity() + change.after.capacity();
+  return bytes;
+}
+
+void ReplaceParamsCommand::retire()
+{
+  _changes = std::vector<Change>();
+}
+
+void ReplaceParamsCommand::apply(const bool forwards)
+{
+  for (const Change& change : _changes)
+  {
+    Level& level = _building->levels[change.level_idx];
+    ParamMap* params = SetParamsCommand::params_of(level, change.item);
+    if (params == nullptr)
+      continue;
+    auto it = params->find(*change.key);
+    if (it == params->end())
+      continue;
+    if (forwards)
+      it->second.set(change.after);
+    else
+      it->second = change.before;
+    level.mark_changed(change.item);
+  }
+}
+
+void ReplaceParamsCommand::undo()
+{
+  apply(false);
+}
+
+void ReplaceParamsCommand::redo()
+{
+  apply(true);
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef ACTIONS__REPLACE_PARAMS_HPP_
+#define ACTIONS__REPLACE_PARAMS_HPP_
+
+#include <string>
+#include <vector>
+
+#include <QUndoCommand>
+
+#include "actions/compactable_command.hpp"
+#include "building.h"
+#include "param_index.hpp"
+
+/// Gives params of entities on any number of levels new values, as found
+/// by ParamIndex::find(), as a single undo step. The original values are
+/// stored, so that undo restores their types and formatting exactly.
+class ReplaceParamsCommand : public QUndoCommand, public CompactableCommand
+{
+public:
+  ReplaceParamsCommand(
+    Building* building,
+    const std::vector<ParamIndex::Match>& matches);
+
+  std::size_t size() const { return _changes.size(); }
+
+  void undo() override;
+  void redo() override;
+
+  std::size_t memory_usage() const override;
+  void retire() override;
+
+private:
+  struct Change
+  {
+    int level_idx;
+    Level::SelectedItem item;
+    const std::string* key;  // interned
+    Param before;
+    std::string after;
+  };
+
+  Building* _building;
+  std::vector<Change> _changes;
+
+  void apply(const bool forwards);
+};
+
+#endif  // ACTIONS__REPLACE_PARAMS_HPP_
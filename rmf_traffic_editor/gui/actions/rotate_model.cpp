@@ -25,23 +25,49 @@ RotateModelCommand::RotateModelCommand(
   has_moved = false;
   _building = building;
   _level_id = level;
-  _model_id = model_id;
-  _original_yaw =
-    _building->levels[_level_id].models[_model_id].state.yaw;
+  _model_idx_hint = model_id;
+  const Model& model = _building->levels[_level_id].models[model_id];
+  _uuid = model.uuid;
+  _original_yaw = model.state.yaw;
+  _final_yaw = _original_yaw;
 }
 
 RotateModelCommand::~RotateModelCommand()
 {
 }
 
+int RotateModelCommand::find_model()
+{
+  const Level& level = _building->levels[_level_id];
+  if (_model_idx_hint < 0 ||
+    _model_idx_hint >= static_cast<int>(level.models.size()) ||
+    level.models[_model_idx_hint].uuid != _uuid)
+    _model_idx_hint = level.find_model_index(_uuid);
+  return _model_idx_hint;
+}
+
 void RotateModelCommand::undo()
 {
-  _building->set_model_yaw(_level_id, _model_id, _original_yaw);
+  const int model_idx = find_model();
+  if (model_idx >= 0)
+    _building->set_model_yaw(_level_id, model_idx, _original_yaw);
 }
 
 void RotateModelCommand::redo()
 {
-  _building->set_model_yaw(_level_id, _model_id, _final_yaw);
+  const int model_idx = find_model();
+  if (model_idx >= 0)
+    _building->set_model_yaw(_level_id, model_idx, _final_yaw);
+}
+
+bool RotateModelCommand::mergeWith(const QUndoCommand* other)
+{
+  const RotateModelCommand* rotate =
+    static_cast<const RotateModelCommand*>(other);
+  if (rotate->_level_id != _level_id || rotate->_uuid != _uuid)
+    return false;
+  _final_yaw = rotate->_final_yaw;
+  return true;
 }
 
 void RotateModelCommand::set_final_destination(double yaw)
@@ -19,6 +19,8 @@
 #define _ROTATE_MODEL_H_
 
 #include <QUndoCommand>
+#include <QUuid>
+#include "actions/command_ids.hpp"
 #include "building.h"
 
 class RotateModelCommand : public QUndoCommand
@@ -34,13 +36,21 @@ public:
   void undo() override;
   void redo() override;
 
+  /// Successive rotations of the same model become one undo step
+  int id() const override { return ROTATE_MODEL_COMMAND_ID; }
+  bool mergeWith(const QUndoCommand* other) override;
+
   void set_final_destination(double yaw);
 
   bool has_moved;
 private:
+  /// Index of the model, found by uuid starting from where it was, or -1
+  int find_model();
+
   double _original_yaw;
   double _final_yaw;
-  int _level_id, _model_id;
+  int _level_id, _model_idx_hint;
+  QUuid _uuid;
   Building* _building;
 };
 
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "set_fiducials.hpp"
+
+SetFiducialsCommand::SetFiducialsCommand(
+  Building* building,
+  const QString& text)
+: _building(building)
+{
+  setText(text);
+}
+
+void SetFiducialsCommand::set_fiducials(
+  int level_idx,
+  const std::vector<Fiducial>& fiducials)
+{
+  _level_idxs.push_back(level_idx);
+  _original_fiducials.push_back(_building->levels[level_idx].fiducials);
+  _final_fiducials.push_back(fiducials);
+}
+
+void SetFiducialsCommand::undo()
+{
+  for (std::size_t i = 0; i < _level_idxs.size(); i++)
+  {
+    Level& level = _building->levels[_level_idxs[i]];
+    level.fiducials = _original_fiducials[i];
+    level.mark_all_changed();
+  }
+}
+
+void SetFiducialsCommand::redo()
+{
+  for (std::size_t i = 0; i < _level_idxs.size(); i++)
+  {
+    Level& level = _building->levels[_level_idxs[i]];
+    level.fiducials = _final_fiducials[i];
+    level.mark_all_changed();
+  }
+}
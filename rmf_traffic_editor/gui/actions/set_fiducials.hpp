@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef ACTIONS__SET_FIDUCIALS_HPP_
+#define ACTIONS__SET_FIDUCIALS_HPP_
+
+#include <vector>
+
+#include <QString>
+#include <QUndoCommand>
+
+#include "building.h"
+
+/// Replaces all of the fiducials of some levels at once, as registering
+/// the levels to each other does, so that one undo puts all of them back
+class SetFiducialsCommand : public QUndoCommand
+{
+public:
+  SetFiducialsCommand(Building* building, const QString& text);
+
+  /// Record the new fiducials of a level; its current ones are kept for
+  /// undo()
+  void set_fiducials(int level_idx, const std::vector<Fiducial>& fiducials);
+
+  bool is_empty() const { return _level_idxs.empty(); }
+
+  void undo() override;
+  void redo() override;
+
+private:
+  Building* _building;
+  std::vector<int> _level_idxs;
+  std::vector<std::vector<Fiducial>> _original_fiducials;
+  std::vector<std::vector<Fiducial>> _final_fiducials;
+};
+
+#endif  // ACTIONS__SET_FIDUCIALS_HPP_
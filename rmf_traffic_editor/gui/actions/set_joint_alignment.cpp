@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "set_joint_alignment.hpp"
+
+SetJointAlignmentCommand::SetJointAlignmentCommand(
+  Building* building,
+  bool enabled,
+  QUndoCommand* parent)
+: QUndoCommand(parent),
+  _building(building),
+  _original_enabled(building->joint_alignment()),
+  _final_enabled(enabled)
+{
+  setText(enabled ? "Align levels jointly" : "Align levels one by one");
+}
+
+void SetJointAlignmentCommand::undo()
+{
+  set(_original_enabled);
+}
+
+void SetJointAlignmentCommand::redo()
+{
+  set(_final_enabled);
+}
+
+void SetJointAlignmentCommand::set(bool enabled)
+{
+  _building->set_joint_alignment(enabled);
+
+  // every level is drawn where its transform puts the others
+  for (Level& level : _building->levels)
+    level.mark_all_changed();
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef ACTIONS__SET_JOINT_ALIGNMENT_HPP_
+#define ACTIONS__SET_JOINT_ALIGNMENT_HPP_
+
+#include <QUndoCommand>
+
+#include "building.h"
+
+/// Turns the joint fit of the levels to each other (see
+/// Building::joint_alignment()) on or off, refitting every level
+class SetJointAlignmentCommand : public QUndoCommand
+{
+public:
+  SetJointAlignmentCommand(
+    Building* building,
+    bool enabled,
+    QUndoCommand* parent = nullptr);
+
+  void undo() override;
+  void redo() override;
+
+private:
+  Building* _building;
+  bool _original_enabled;
+  bool _final_enabled;
+
+  void set(bool enabled);
+};
+
+#endif  // ACTIONS__SET_JOINT_ALIGNMENT_HPP_
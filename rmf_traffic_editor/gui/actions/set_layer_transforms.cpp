@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "set_layer_transforms.hpp"
+
+SetLayerTransformsCommand::SetLayerTransformsCommand(
+  Building* building,
+  int level_idx,
+  QUndoCommand* parent)
+: QUndoCommand(parent),
+  _building(building),
+  _level_idx(level_idx)
+{
+  setText("Optimize layer transforms");
+}
+
+void SetLayerTransformsCommand::set_transform(
+  int layer_idx,
+  const Transform& transform)
+{
+  _layer_idxs.push_back(layer_idx);
+  _original_transforms.push_back(
+    _building->levels[_level_idx].layers[layer_idx].transform);
+  _final_transforms.push_back(transform);
+}
+
+void SetLayerTransformsCommand::undo()
+{
+  Level& level = _building->levels[_level_idx];
+  for (std::size_t i = 0; i < _layer_idxs.size(); i++)
+  {
+    level.layers[_layer_idxs[i]].transform = _original_transforms[i];
+    level.mark_layer_transform_changed(_layer_idxs[i]);
+  }
+}
+
+void SetLayerTransformsCommand::redo()
+{
+  Level& level = _building->levels[_level_idx];
+  for (std::size_t i = 0; i < _layer_idxs.size(); i++)
+  {
+    level.layers[_layer_idxs[i]].transform = _final_transforms[i];
+    level.mark_layer_transform_changed(_layer_idxs[i]);
+  }
+}
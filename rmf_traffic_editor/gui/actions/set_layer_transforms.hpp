@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef ACTIONS__SET_LAYER_TRANSFORMS_HPP_
+#define ACTIONS__SET_LAYER_TRANSFORMS_HPP_
+
+#include <vector>
+
+#include <QUndoCommand>
+
+#include "building.h"
+
+/// Replaces the transforms of some layers of a level at once, as the
+/// optimizer does, so that one undo puts all of them back
+class SetLayerTransformsCommand : public QUndoCommand
+{
+public:
+  SetLayerTransformsCommand(
+    Building* building,
+    int level_idx,
+    QUndoCommand* parent = nullptr);
+
+  /// Record a new transform for a layer; its current one is kept for undo()
+  void set_transform(int layer_idx, const Transform& transform);
+
+  bool is_empty() const { return _layer_idxs.empty(); }
+
+  void undo() override;
+  void redo() override;
+
+private:
+  Building* _building;
+  int _level_idx;
+  std::vector<int> _layer_idxs;
+  std::vector<Transform> _original_transforms;
+  std::vector<Transform> _final_transforms;
+};
+
+#endif  // ACTIONS__SET_LAYER_TRANSFORMS_HPP_
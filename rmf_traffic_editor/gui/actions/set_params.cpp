@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "set_params.hpp"
+
+SetParamsCommand::SetParamsCommand(
+  Building* building,
+  int level_idx,
+  const std::vector<Level::SelectedItem>& items,
+  const std::string& name,
+  const std::string& value)
+: _building(building),
+  _level_idx(level_idx),
+  _name(name),
+  _value(value)
+{
+  setText(QString("Set %1 of %2 entities")
+    .arg(QString::fromStdString(name))
+    .arg(static_cast<int>(items.size())));
+  Level& level = _building->levels[_level_idx];
+  for (const Level::SelectedItem& item : items)
+  {
+    ParamMap* params = params_of(level, item);
+    if (params == nullptr)
+      continue;
+    auto it = params->find(_name);
+    if (it == params->end())
+      continue;
+    _items.push_back(item);
+    _original_values.push_back(it->second);
+  }
+}
+
+ParamMap* SetParamsCommand::params_of(
+  Level& level,
+  const Level::SelectedItem& item)
+{
+  if (item.vertex_idx >= 0 &&
+    item.vertex_idx < static_cast<int>(level.vertices.size()))
+    return &level.vertices[item.vertex_idx].params;
+  if (item.edge_idx >= 0 &&
+    item.edge_idx < static_cast<int>(level.edges.size()))
+    return &level.edges[item.edge_idx].params;
+  if (item.polygon_idx >= 0 &&
+    item.polygon_idx < static_cast<int>(level.polygons.size()))
+    return &level.polygons[item.polygon_idx].params;
+  if (item.tag_idx >= 0 &&
+    item.tag_idx < static_cast<int>(level.tags.size()))
+    return &level.tags[item.tag_idx].params;
+  return nullptr;
+}
+
+std::size_t SetParamsCommand::memory_usage() const
+{
+  return _items.size() * (sizeof(Level::SelectedItem) + sizeof(Param));
+}
+
+void SetParamsCommand::retire()
+{
+  _items = std::vector<Level::SelectedItem>();
+  _original_values = std::vector<Param>();
+}
+
+void SetParamsCommand::undo()
+{
+  Level& level = _building->levels[_level_idx];
+  for (std::size_t i = 0; i < _items.size(); i++)
+  {
+    ParamMap* params = params_of(level, _items[i]);
+    if (params == nullptr)
+      continue;
+    auto it = params->find(_name);
+    if (it == params->end())
+      continue;
+    it->second = _original_values[i];
+    level.mark_changed(_items[i]);
+  }
+}
+
+void SetParamsCommand::redo()
+{
+  Level& level = _building->levels[_level_idx];
+  for (const Level::SelectedItem& item : _items)
+  {
+    ParamMap* params = params_of(level, item);
+    if (params == nullptr)
+      continue;
+    auto it = params->find(_name);
+    if (it == params->end())
+      continue;
+    it->second.set(_value);
+    level.mark_changed(item);
+  }
+}
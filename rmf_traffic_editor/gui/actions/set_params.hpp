@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef ACTIONS__SET_PARAMS_HPP_
+#define ACTIONS__SET_PARAMS_HPP_
+
+#include <string>
+#include <vector>
+
+#include <QUndoCommand>
+
+#include "actions/compactable_command.hpp"
+#include "building.h"
+
+/// Sets one parameter of many entities of a level (vertices, edges,
+/// polygons and tags) to the same value, as a single undo step. Entities
+/// which don't have the parameter are left alone, as by set_param().
+class SetParamsCommand : public QUndoCommand, public CompactableCommand
+{
+public:
+  SetParamsCommand(
+    Building* building,
+    int level_idx,
+    const std::vector<Level::SelectedItem>& items,
+    const std::string& name,
+    const std::string& value);
+
+  std::size_t size() const { return _items.size(); }
+
+  /// The parameters of an entity, or nullptr if it doesn't have any
+  static ParamMap* params_of(Level& level, const Level::SelectedItem& item);
+
+  void undo() override;
+  void redo() override;
+
+  std::size_t memory_usage() const override;
+  void retire() override;
+
+private:
+  Building* _building;
+  int _level_idx;
+  std::string _name;
+  std::string _value;
+  std::vector<Level::SelectedItem> _items;
+  std::vector<Param> _original_values;
+};
+
+#endif  // ACTIONS__SET_PARAMS_HPP_
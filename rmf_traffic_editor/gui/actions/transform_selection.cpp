@@ -0,0 +1,334 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <cmath>
+#include <set>
+
+#include "transform_selection.hpp"
+
+QPointF TransformSelectionCommand::Similarity::apply(const QPointF& p) const
+{
+  // counter-clockwise on screen, where y points down
+  const double c = scale * std::cos(rotation);
+  const double s = scale * std::sin(rotation);
+  return QPointF(
+    c * p.x() + s * p.y() + offset.x(),
+    -s * p.x() + c * p.y() + offset.y());
+}
+
+TransformSelectionCommand::Similarity
+TransformSelectionCommand::Similarity::then(const Similarity& next) const
+{
+  Similarity result;
+  result.scale = scale * next.scale;
+  result.rotation = rotation + next.rotation;
+  result.offset = next.apply(offset);
+  return result;
+}
+
+TransformSelectionCommand::Similarity
+TransformSelectionCommand::Similarity::translation(const QPointF& offset)
+{
+  Similarity result;
+  result.offset = offset;
+  return result;
+}
+
+TransformSelectionCommand::Similarity
+TransformSelectionCommand::Similarity::about(
+  const QPointF& pivot,
+  const double rotation,
+  const double scale)
+{
+  Similarity result;
+  result.scale = scale;
+  result.rotation = rotation;
+  result.offset = pivot - result.apply(pivot);
+  return result;
+}
+
+TransformSelectionCommand::TransformSelectionCommand(
+  Building* building,
+  int level_idx,
+  const std::vector<Level::SelectedItem>& items)
+: _building(building),
+  _level_idx(level_idx)
+{
+  setText("Transform selection");
+  const Level& level = _building->levels[_level_idx];
+
+  // the vertices of selected edges and polygons move with them, once
+  std::set<int> vertex_idxs;
+  for (const Level::SelectedItem& item : items)
+  {
+    if (item.vertex_idx >= 0)
+      vertex_idxs.insert(item.vertex_idx);
+    if (item.edge_idx >= 0 &&
+      item.edge_idx < static_cast<int>(level.edges.size()))
+    {
+      vertex_idxs.insert(level.edges[item.edge_idx].start_idx);
+      vertex_idxs.insert(level.edges[item.edge_idx].end_idx);
+    }
+    if (item.polygon_idx >= 0 &&
+      item.polygon_idx < static_cast<int>(level.polygons.size()))
+    {
+      for (const int idx : level.polygons[item.polygon_idx].vertices)
+        vertex_idxs.insert(idx);
+    }
+  }
+  for (const int idx : vertex_idxs)
+    add(level, VERTEX, idx);
+
+  for (const Level::SelectedItem& item : items)
+  {
+    if (item.tag_idx >= 0)
+      add(level, TAG, item.tag_idx);
+    if (item.model_idx >= 0)
+      add(level, MODEL, item.model_idx);
+    if (item.fiducial_idx >= 0)
+      add(level, FIDUCIAL, item.fiducial_idx);
+    if (item.feature_idx >= 0 && item.feature_layer_idx >= 0)
+    {
+      const int layer_idx = item.feature_layer_idx;
+      if (layer_idx > static_cast<int>(level.layers.size()))
+        continue;
+      const std::vector<Feature>& features = layer_idx == 0 ?
+        level.floorplan_features : level.layers[layer_idx - 1].features;
+      if (item.feature_idx >= static_cast<int>(features.size()))
+        continue;
+      const Feature& feature = features[item.feature_idx];
+
+      Entity entity;
+      entity.kind = FEATURE;
+      entity.uuid = feature.id();
+      entity.layer_idx = layer_idx;
+      entity.idx = item.feature_idx;
+      entity.original = QPointF(feature.x(), feature.y());
+      entity.position = entity.original;
+      if (layer_idx > 0)
+      {
+        // layer pixels -> meters -> level pixels
+        const double mpp = level.drawing_meters_per_pixel;
+        const QPointF p_meters =
+          level.layers[layer_idx - 1].transform.forwards(entity.original);
+        entity.position = QPointF(p_meters.x() / mpp, p_meters.y() / mpp);
+      }
+      _entities.push_back(entity);
+    }
+  }
+}
+
+void TransformSelectionCommand::add(
+  const Level& level,
+  const Kind kind,
+  const int idx)
+{
+  Entity entity;
+  entity.kind = kind;
+  entity.idx = idx;
+  switch (kind)
+  {
+    case VERTEX:
+      if (idx < 0 || idx >= static_cast<int>(level.vertices.size()))
+        return;
+      entity.uuid = level.vertices[idx].uuid;
+      entity.original = QPointF(level.vertices[idx].x, level.vertices[idx].y);
+      break;
+    case TAG:
+      if (idx >= static_cast<int>(level.tags.size()))
+        return;
+      entity.uuid = level.tags[idx].uuid;
+      entity.original = QPointF(level.tags[idx].x, level.tags[idx].y);
+      break;
+    case MODEL:
+      if (idx >= static_cast<int>(level.models.size()))
+        return;
+      entity.uuid = level.models[idx].uuid;
+      entity.original =
+        QPointF(level.models[idx].state.x, level.models[idx].state.y);
+      entity.yaw = level.models[idx].state.yaw;
+      break;
+    case FIDUCIAL:
+      if (idx >= static_cast<int>(level.fiducials.size()))
+        return;
+      entity.uuid = level.fiducials[idx].uuid;
+      entity.original =
+        QPointF(level.fiducials[idx].x, level.fiducials[idx].y);
+      break;
+    default:
+      return;
+  }
+  entity.position = entity.original;
+  _entities.push_back(entity);
+}
+
+QPointF TransformSelectionCommand::centroid() const
+{
+  if (_entities.empty())
+    return QPointF();
+  QPointF sum;
+  for (const Entity& entity : _entities)
+    sum += entity.position;
+  return sum / static_cast<double>(_entities.size());
+}
+
+void TransformSelectionCommand::set_transform(const Similarity& transform)
+{
+  _transform = transform;
+}
+
+void TransformSelectionCommand::undo()
+{
+  apply(true);
+}
+
+void TransformSelectionCommand::redo()
+{
+  apply(false);
+}
+
+bool TransformSelectionCommand::mergeWith(const QUndoCommand* other)
+{
+  // only if the other one picked up exactly where this one left off
+  const TransformSelectionCommand* next =
+    static_cast<const TransformSelectionCommand*>(other);
+  if (next->_level_idx != _level_idx ||
+    next->_entities.size() != _entities.size())
+    return false;
+  for (std::size_t i = 0; i < _entities.size(); i++)
+  {
+    if (next->_entities[i].uuid != _entities[i].uuid)
+      return false;
+  }
+  _transform = _transform.then(next->_transform);
+  return true;
+}
+
+std::size_t TransformSelectionCommand::memory_usage() const
+{
+  return _entities.capacity() * sizeof(Entity);
+}
+
+void TransformSelectionCommand::retire()
+{
+  _entities = std::vector<Entity>();
+}
+
+int TransformSelectionCommand::find(Entity& entity) const
+{
+  const Level& level = _building->levels[_level_idx];
+  const int idx = entity.idx;
+  switch (entity.kind)
+  {
+    case VERTEX:
+      if (idx < 0 || idx >= static_cast<int>(level.vertices.size()) ||
+        level.vertices[idx].uuid != entity.uuid)
+        entity.idx = level.find_vertex_index(entity.uuid);
+      break;
+    case TAG:
+      if (idx < 0 || idx >= static_cast<int>(level.tags.size()) ||
+        level.tags[idx].uuid != entity.uuid)
+        entity.idx = level.find_tag_index(entity.uuid);
+      break;
+    case MODEL:
+      if (idx < 0 || idx >= static_cast<int>(level.models.size()) ||
+        level.models[idx].uuid != entity.uuid)
+        entity.idx = level.find_model_index(entity.uuid);
+      break;
+    case FIDUCIAL:
+      if (idx < 0 || idx >= static_cast<int>(level.fiducials.size()) ||
+        level.fiducials[idx].uuid != entity.uuid)
+        entity.idx = level.find_fiducial_index(entity.uuid);
+      break;
+    case FEATURE:
+    {
+      const Feature* feature = nullptr;
+      if (entity.layer_idx == 0 &&
+        idx >= 0 && idx < static_cast<int>(level.floorplan_features.size()))
+        feature = &level.floorplan_features[idx];
+      else if (entity.layer_idx > 0 &&
+        entity.layer_idx <= static_cast<int>(level.layers.size()) &&
+        idx >= 0 &&
+        idx < static_cast<int>(
+          level.layers[entity.layer_idx - 1].features.size()))
+        feature = &level.layers[entity.layer_idx - 1].features[idx];
+      if ((!feature || feature->id() != entity.uuid) &&
+        !level.find_feature_index(entity.uuid, entity.layer_idx, entity.idx))
+        entity.idx = -1;
+      break;
+    }
+  }
+  return entity.idx;
+}
+
+void TransformSelectionCommand::apply(const bool original)
+{
+  Level& level = _building->levels[_level_idx];
+  const double mpp = level.drawing_meters_per_pixel;
+  for (Entity& entity : _entities)
+  {
+    const int idx = find(entity);
+    if (idx < 0)
+      continue;
+    const QPointF p =
+      original ? entity.original : _transform.apply(entity.position);
+
+    switch (entity.kind)
+    {
+      case VERTEX:
+        level.vertices[idx].x = p.x();
+        level.vertices[idx].y = p.y();
+        level.mark_changed(Level::VERTEX, idx);
+        break;
+      case TAG:
+        level.tags[idx].x = p.x();
+        level.tags[idx].y = p.y();
+        level.mark_changed(Level::TAG, idx);
+        break;
+      case MODEL:
+        level.models[idx].state.x = p.x();
+        level.models[idx].state.y = p.y();
+        level.models[idx].state.yaw =
+          original ? entity.yaw : entity.yaw + _transform.rotation;
+        level.mark_changed(Level::MODEL, idx);
+        break;
+      case FIDUCIAL:
+        level.fiducials[idx].x = p.x();
+        level.fiducials[idx].y = p.y();
+        level.mark_changed(Level::FIDUCIAL, idx);
+        break;
+      case FEATURE:
+      {
+        Feature& feature = entity.layer_idx == 0 ?
+          level.floorplan_features[idx] :
+          level.layers[entity.layer_idx - 1].features[idx];
+        QPointF q(p);
+        if (!original && entity.layer_idx > 0)
+          q = level.layers[entity.layer_idx - 1].transform.backwards(
+            QPointF(p.x() * mpp, p.y() * mpp));
+        feature.set_x(q.x());
+        feature.set_y(q.y());
+
+        Level::SelectedItem item;
+        item.feature_layer_idx = entity.layer_idx;
+        item.feature_idx = idx;
+        level.mark_changed(item);
+        break;
+      }
+    }
+  }
+}
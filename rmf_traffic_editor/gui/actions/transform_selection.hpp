@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef ACTIONS__TRANSFORM_SELECTION_HPP_
+#define ACTIONS__TRANSFORM_SELECTION_HPP_
+
+#include <vector>
+
+#include <QPointF>
+#include <QUndoCommand>
+#include <QUuid>
+
+#include "actions/command_ids.hpp"
+#include "actions/compactable_command.hpp"
+#include "building.h"
+
+/// Translates, rotates and scales every selected vertex, tag, model,
+/// fiducial and feature of a level as a single undo step. Edges and
+/// polygons come along through their vertices.
+///
+/// Only the original positions and one transform are stored, so the
+/// command stays small however large the selection is, and successive
+/// transforms of the same entities merge into one.
+class TransformSelectionCommand
+  : public QUndoCommand, public CompactableCommand
+{
+public:
+  /// p' = scale * R(rotation) * p + offset, in the level's coordinates.
+  /// The rotation is counter-clockwise on screen, like a model's yaw.
+  struct Similarity
+  {
+    double scale = 1.0;
+    double rotation = 0.0;  // radians
+    QPointF offset;
+
+    QPointF apply(const QPointF& p) const;
+
+    /// This transform followed by `next`
+    Similarity then(const Similarity& next) const;
+
+    static Similarity translation(const QPointF& offset);
+
+    /// Rotate and scale about `pivot`
+    static Similarity about(
+      const QPointF& pivot,
+      const double rotation,
+      const double scale);
+  };
+
+  TransformSelectionCommand(
+    Building* building,
+    int level_idx,
+    const std::vector<Level::SelectedItem>& items);
+
+  std::size_t size() const { return _entities.size(); }
+
+  /// The mean position of the entities, e.g. to rotate the selection about
+  QPointF centroid() const;
+
+  void set_transform(const Similarity& transform);
+  const Similarity& transform() const { return _transform; }
+
+  void undo() override;
+  void redo() override;
+
+  int id() const override { return TRANSFORM_SELECTION_COMMAND_ID; }
+  bool mergeWith(const QUndoCommand* other) override;
+
+  std::size_t memory_usage() const override;
+  void retire() override;
+
+private:
+  enum Kind { VERTEX, TAG, MODEL, FIDUCIAL, FEATURE };
+
+  struct Entity
+  {
+    Kind kind;
+    QUuid uuid;
+    int layer_idx = 0;  // of a feature: 0 for the floorplan, else layer + 1
+    int idx = -1;  // where it was last seen; checked against the uuid
+    QPointF original;  // in its own coordinates (layer pixels, for features)
+    QPointF position;  // the original, in the level's coordinates
+    double yaw = 0.0;
+  };
+
+  Building* _building;
+  int _level_idx;
+  std::vector<Entity> _entities;
+  Similarity _transform;
+
+  void add(const Level& level, const Kind kind, const int idx);
+
+  /// Index of the entity, or -1 if it no longer exists
+  int find(Entity& entity) const;
+
+  void apply(const bool original);
+};
+
+#endif  // ACTIONS__TRANSFORM_SELECTION_HPP_
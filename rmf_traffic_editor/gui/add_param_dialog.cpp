@@ -19,11 +19,9 @@
 #include <QtWidgets>
 
 
-AddParamDialog::AddParamDialog(
-  QWidget* parent,
-  const std::vector<std::pair<std::string, Param::Type>>& _param_names)
+AddParamDialog::AddParamDialog(QWidget* parent, const ParamSchema& _schema)
 : QDialog(parent),
-  param_names(_param_names)
+  schema(_schema)
 {
   ok_button = new QPushButton("OK", this);  // first button = [enter] button
   cancel_button = new QPushButton("Cancel", this);
@@ -31,8 +29,8 @@ AddParamDialog::AddParamDialog(
   QHBoxLayout* name_hbox_layout = new QHBoxLayout;
   name_hbox_layout->addWidget(new QLabel("name:"));
   name_combo_box = new QComboBox;
-  for (const auto& param_name : param_names)
-    name_combo_box->addItem(QString::fromStdString(param_name.first));
+  for (int i = 0; i < schema.size(); i++)
+    name_combo_box->addItem(schema.field(i).name);
   name_hbox_layout->addWidget(name_combo_box);
 
   QHBoxLayout* bottom_buttons_layout = new QHBoxLayout;
@@ -70,13 +68,6 @@ std::string AddParamDialog::get_param_name() const
 
 Param::Type AddParamDialog::get_param_type() const
 {
-  // loop through the allowed_params to find the name that is selected
-  // then return the type
-  for (const auto& param_name : param_names)
-  {
-    if (name_combo_box->currentText().toStdString() != param_name.first)
-      continue;
-    return param_name.second;
-  }
-  return Param::Type::UNDEFINED;
+  const ParamField* field = schema.lookup(get_param_name());
+  return field ? field->type : Param::Type::UNDEFINED;
 }
@@ -20,16 +20,14 @@
 
 #include <vector>
 #include <QDialog>
-#include "param.h"
+#include "param_schema.hpp"
 class QComboBox;
 
 
 class AddParamDialog : public QDialog
 {
 public:
-  AddParamDialog(
-    QWidget* parent,
-    const std::vector<std::pair<std::string, Param::Type>>& param_names);
+  AddParamDialog(QWidget* parent, const ParamSchema& schema);
   ~AddParamDialog();
 
   std::string get_param_name() const;
@@ -38,7 +36,7 @@ public:
 private:
   QComboBox* name_combo_box;
   QPushButton* ok_button, * cancel_button;
-  const std::vector<std::pair<std::string, Param::Type>>& param_names;
+  const ParamSchema& schema;
 
 private slots:
   void ok_button_clicked();
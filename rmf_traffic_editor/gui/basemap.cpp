@@ -0,0 +1,478 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QPainter>
+#include <QSaveFile>
+#include <QStyleOptionGraphicsItem>
+#include <QUrl>
+#include <QtConcurrent/QtConcurrent>
+
+#include "basemap.hpp"
+#include "logging.hpp"
+
+namespace {
+
+/// Half the circumference of the earth, in EPSG:3857 meters: the tiles
+/// cover [-HALF_EXTENT, HALF_EXTENT] in both directions
+const double HALF_EXTENT = 20037508.342789244;
+
+}  // namespace
+
+
+TileCache::TileCache(QObject* parent)
+: QObject(parent),
+  _network(new QNetworkAccessManager(this))
+{
+  set_memory_budget_mb(128);
+  set_disk_budget_mb(512);
+}
+
+void TileCache::set_url_template(const QString& url_template)
+{
+  _url_template = url_template;
+  _failed.clear();  // they may be there now
+}
+
+void TileCache::set_disk_dir(const QString& dir)
+{
+  _disk_dir = dir;
+  _disk_scanned = false;
+  _disk_bytes = 0;
+  _disk_lru.clear();
+  _disk_entries.clear();
+}
+
+void TileCache::set_memory_budget_mb(const int mb)
+{
+  _memory.setMaxCost(std::max(mb, 1) * 1024);
+}
+
+void TileCache::set_disk_budget_mb(const int mb)
+{
+  _disk_budget = static_cast<qint64>(std::max(mb, 0)) * 1024 * 1024;
+  if (_disk_scanned)
+    evict_disk();
+}
+
+QPixmap TileCache::find(const int z, const int x, const int y)
+{
+  QPixmap* pixmap = _memory.object(key(z, x, y));
+  if (!pixmap)
+  {
+    _misses++;
+    return QPixmap();
+  }
+  _hits++;
+  return *pixmap;
+}
+
+TileCache::Statistics TileCache::statistics() const
+{
+  Statistics statistics;
+  statistics.hits = _hits;
+  statistics.misses = _misses;
+  statistics.memory_bytes = static_cast<qint64>(_memory.totalCost()) * 1024;
+  statistics.memory_budget_bytes =
+    static_cast<qint64>(_memory.maxCost()) * 1024;
+  statistics.disk_bytes = _disk_bytes;
+  statistics.disk_budget_bytes = _disk_budget;
+  statistics.queued = static_cast<int>(_queue.size());
+  statistics.in_flight = _in_flight;
+  return statistics;
+}
+
+void TileCache::request(const int z, const int x, const int y)
+{
+  if (z < 0 || z > MAX_ZOOM || x < 0 || y < 0 || x >= (1 << z) ||
+    y >= (1 << z))
+    return;
+  const quint64 k = key(z, x, y);
+  if (_memory.contains(k) || _failed.count(k))
+    return;
+
+  if (_pending.count(k))
+  {
+    // bring it to the front, unless it is being loaded already
+    auto it = std::find(_queue.begin(), _queue.end(), k);
+    if (it == _queue.end())
+      return;
+    _queue.erase(it);
+  }
+  _queue.push_front(k);
+  _pending.insert(k);
+
+  while (_queue.size() > static_cast<std::size_t>(MAX_QUEUED))
+  {
+    _pending.erase(_queue.back());
+    _queue.pop_back();
+  }
+  start_requests();
+}
+
+QRectF TileCache::tile_rect(const int z, const int x, const int y)
+{
+  const double extent = tile_extent(z);
+  const double top = HALF_EXTENT - y * extent;
+  return QRectF(-HALF_EXTENT + x * extent, top - extent, extent, extent);
+}
+
+double TileCache::tile_extent(const int z)
+{
+  return 2.0 * HALF_EXTENT / static_cast<double>(1 << z);
+}
+
+int TileCache::zoom_for_detail(const double level_of_detail)
+{
+  // a tile pixel of zoom z is tile_extent(z) / TILE_SIZE meters
+  if (level_of_detail <= 0.0)
+    return 0;
+  const double zoom = std::log2(
+    2.0 * HALF_EXTENT * level_of_detail / static_cast<double>(TILE_SIZE));
+  return std::max(0, std::min(MAX_ZOOM, static_cast<int>(std::ceil(zoom))));
+}
+
+quint64 TileCache::key(const int z, const int x, const int y)
+{
+  return (static_cast<quint64>(z) << 58) |
+    (static_cast<quint64>(x) << 29) |
+    static_cast<quint64>(y);
+}
+
+void TileCache::split_key(const quint64 key, int& z, int& x, int& y)
+{
+  const quint64 mask = (1ULL << 29) - 1;
+  z = static_cast<int>(key >> 58);
+  x = static_cast<int>((key >> 29) & mask);
+  y = static_cast<int>(key & mask);
+}
+
+QString TileCache::disk_filename(const quint64 key) const
+{
+  int z, x, y;
+  split_key(key, z, x, y);
+  return QString("%1/%2/%3/%4.png").arg(_disk_dir).arg(z).arg(x).arg(y);
+}
+
+void TileCache::scan_disk()
+{
+  _disk_scanned = true;
+  if (_disk_dir.isEmpty())
+    return;
+
+  // the files of the tiles used most recently were touched last
+  struct File
+  {
+    quint64 key;
+    qint64 bytes;
+    QDateTime modified;
+  };
+  std::vector<File> files;
+  const QDir root(_disk_dir);
+  QDirIterator it(
+    _disk_dir,
+    QStringList() << "*.png",
+    QDir::Files,
+    QDirIterator::Subdirectories);
+  while (it.hasNext())
+  {
+    it.next();
+    const QStringList parts =
+      root.relativeFilePath(it.filePath()).split('/');
+    if (parts.size() != 3)
+      continue;
+    bool z_ok = false, x_ok = false, y_ok = false;
+    const int z = parts[0].toInt(&z_ok);
+    const int x = parts[1].toInt(&x_ok);
+    const int y = QFileInfo(parts[2]).baseName().toInt(&y_ok);
+    if (!z_ok || !x_ok || !y_ok || z < 0 || z > MAX_ZOOM)
+      continue;
+    const QFileInfo info = it.fileInfo();
+    files.push_back(File{key(z, x, y), info.size(), info.lastModified()});
+  }
+  std::sort(
+    files.begin(),
+    files.end(),
+    [](const File& a, const File& b) { return a.modified < b.modified; });
+  for (const File& file : files)
+    add_disk_entry(file.key, file.bytes);
+  evict_disk();
+
+  qCDebug(lc_io, "%d basemap tiles (%.1f MB) are cached in %s",
+    static_cast<int>(_disk_entries.size()),
+    _disk_bytes / (1024.0 * 1024.0),
+    qUtf8Printable(_disk_dir));
+}
+
+void TileCache::add_disk_entry(const quint64 key, const qint64 bytes)
+{
+  remove_disk_entry(key);
+  _disk_lru.push_front(key);
+  DiskEntry& entry = _disk_entries[key];
+  entry.bytes = bytes;
+  entry.lru = _disk_lru.begin();
+  _disk_bytes += bytes;
+}
+
+void TileCache::remove_disk_entry(const quint64 key)
+{
+  auto it = _disk_entries.find(key);
+  if (it == _disk_entries.end())
+    return;
+  _disk_bytes -= it->second.bytes;
+  _disk_lru.erase(it->second.lru);
+  _disk_entries.erase(it);
+}
+
+void TileCache::evict_disk()
+{
+  while (_disk_bytes > _disk_budget && !_disk_lru.empty())
+  {
+    const quint64 k = _disk_lru.back();
+    QFile::remove(disk_filename(k));
+    remove_disk_entry(k);
+  }
+}
+
+void TileCache::start_requests()
+{
+  if (!_disk_scanned)
+    scan_disk();
+
+  while (_in_flight < MAX_IN_FLIGHT && !_queue.empty())
+  {
+    const quint64 k = _queue.front();
+    _queue.pop_front();
+    _in_flight++;
+    auto it = _disk_entries.find(k);
+    if (it != _disk_entries.end())
+    {
+      // it is the most recently used one now
+      _disk_lru.splice(_disk_lru.begin(), _disk_lru, it->second.lru);
+      load_from_disk(k);
+    }
+    else
+      fetch(k);
+  }
+}
+
+void TileCache::load_from_disk(const quint64 key)
+{
+  // the tiles are decoded on the thread pool, and only turned into
+  // QPixmaps, which has to happen on this thread, in finish()
+  const QString filename = disk_filename(key);
+  QFutureWatcher<QImage>* watcher = new QFutureWatcher<QImage>(this);
+  connect(
+    watcher,
+    &QFutureWatcher<QImage>::finished,
+    this,
+    [this, watcher, key]()
+    {
+      const QImage image = watcher->result();
+      watcher->deleteLater();
+      if (!image.isNull())
+      {
+        finish(key, image);
+        return;
+      }
+      remove_disk_entry(key);
+      fetch(key);  // still in flight
+    });
+  watcher->setFuture(
+    QtConcurrent::run(
+      [filename]()
+      {
+        QFile file(filename);
+        if (!file.open(QIODevice::ReadOnly))
+          return QImage();
+        const QByteArray data = file.readAll();
+
+        // so that the next session knows it was used recently
+        file.setFileTime(
+          QDateTime::currentDateTime(),
+          QFileDevice::FileModificationTime);
+        return QImage::fromData(data);
+      }));
+}
+
+void TileCache::fetch(const quint64 key)
+{
+  if (_url_template.isEmpty())
+  {
+    finish(key, QImage());
+    return;
+  }
+  int z, x, y;
+  split_key(key, z, x, y);
+  QString url = _url_template;
+  url.replace("{z}", QString::number(z));
+  url.replace("{x}", QString::number(x));
+  url.replace("{y}", QString::number(y));
+
+  // tile servers ask for a user agent which identifies the application
+  QNetworkRequest request{QUrl(url)};
+  request.setRawHeader("User-Agent", "traffic-editor");
+  request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+  QNetworkReply* reply = _network->get(request);
+  connect(
+    reply,
+    &QNetworkReply::finished,
+    this,
+    [this, key, reply]() { fetched(key, reply); });
+}
+
+void TileCache::fetched(const quint64 key, QNetworkReply* reply)
+{
+  reply->deleteLater();
+  if (reply->error() != QNetworkReply::NoError)
+  {
+    qCWarning(lc_io, "unable to fetch basemap tile %s: %s",
+      qUtf8Printable(reply->url().toString()),
+      qUtf8Printable(reply->errorString()));
+    finish(key, QImage());
+    return;
+  }
+
+  const QByteArray data = reply->readAll();
+  const QImage image = QImage::fromData(data);
+  if (!image.isNull() && !_disk_dir.isEmpty() && _disk_budget > 0)
+  {
+    const QString filename = disk_filename(key);
+    QDir().mkpath(QFileInfo(filename).path());
+    QSaveFile file(filename);
+    if (file.open(QIODevice::WriteOnly) &&
+      file.write(data) == data.size() &&
+      file.commit())
+    {
+      add_disk_entry(key, data.size());
+      evict_disk();
+    }
+  }
+  finish(key, image);
+}
+
+void TileCache::finish(const quint64 key, const QImage& image)
+{
+  _in_flight--;
+  _pending.erase(key);
+  if (image.isNull())
+    _failed.insert(key);
+  else
+  {
+    QPixmap* pixmap = new QPixmap(QPixmap::fromImage(image));
+    const int cost_kb = std::max(
+      1,
+      pixmap->width() * pixmap->height() * pixmap->depth() / 8 / 1024);
+    _memory.insert(key, pixmap, cost_kb);  // the cache now owns pixmap
+
+    int z, x, y;
+    split_key(key, z, x, y);
+    emit tile_ready(z, x, y);
+  }
+  start_requests();
+}
+
+//=============================================================================
+BasemapItem::BasemapItem(TileCache* tile_cache, QGraphicsItem* parent)
+: QGraphicsObject(parent),
+  _tile_cache(tile_cache)
+{
+  // we need option->exposedRect to know which tiles to paint
+  setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+  connect(
+    _tile_cache,
+    &TileCache::tile_ready,
+    this,
+    [this](int z, int x, int y) { update(TileCache::tile_rect(z, x, y)); });
+}
+
+QRectF BasemapItem::boundingRect() const
+{
+  return QRectF(-HALF_EXTENT, -HALF_EXTENT, 2 * HALF_EXTENT, 2 * HALF_EXTENT);
+}
+
+void BasemapItem::paint(
+  QPainter* painter,
+  const QStyleOptionGraphicsItem* option,
+  QWidget*)
+{
+  const double lod =
+    QStyleOptionGraphicsItem::levelOfDetailFromTransform(
+      painter->worldTransform());
+  const int zoom = TileCache::zoom_for_detail(lod);
+  const double extent = TileCache::tile_extent(zoom);
+  const int num_tiles = 1 << zoom;
+
+  const QRectF exposed = option->exposedRect.intersected(boundingRect());
+  if (exposed.isEmpty())
+    return;
+
+  // tile rows are numbered from the north, where the scene y is largest
+  auto clamp = [num_tiles](const double v)
+    {
+      return std::max(0, std::min(num_tiles - 1, static_cast<int>(v)));
+    };
+  const int x_min = clamp((exposed.left() + HALF_EXTENT) / extent);
+  const int x_max = clamp((exposed.right() + HALF_EXTENT) / extent);
+  const int y_min = clamp((HALF_EXTENT - exposed.bottom()) / extent);
+  const int y_max = clamp((HALF_EXTENT - exposed.top()) / extent);
+
+  const int tile_size = TileCache::TILE_SIZE;
+  painter->setRenderHint(QPainter::SmoothPixmapTransform, true);
+  for (int ty = y_min; ty <= y_max; ty++)
+  {
+    for (int tx = x_min; tx <= x_max; tx++)
+    {
+      QPixmap pixmap = _tile_cache->find(zoom, tx, ty);
+      QRectF source(0, 0, tile_size, tile_size);
+      if (pixmap.isNull())
+      {
+        _tile_cache->request(zoom, tx, ty);
+        for (int up = 1;
+          pixmap.isNull() && up <= std::min(zoom, MAX_FALLBACK_ZOOMS); up++)
+        {
+          pixmap = _tile_cache->find(zoom - up, tx >> up, ty >> up);
+          const double size = static_cast<double>(tile_size >> up);
+          const int mask = (1 << up) - 1;
+          source = QRectF((tx & mask) * size, (ty & mask) * size, size, size);
+        }
+        if (pixmap.isNull())
+          continue;
+      }
+
+      // the rows of the image go south, which is down the scene y axis
+      const QRectF rect = TileCache::tile_rect(zoom, tx, ty);
+      painter->save();
+      painter->translate(rect.left(), rect.bottom());
+      painter->scale(extent / tile_size, -extent / tile_size);
+      painter->drawPixmap(QRectF(0, 0, tile_size, tile_size), pixmap, source);
+      painter->restore();
+    }
+  }
+}
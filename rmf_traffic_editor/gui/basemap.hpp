@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__BASEMAP_HPP
+#define TRAFFIC_EDITOR__BASEMAP_HPP
+
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <QCache>
+#include <QGraphicsObject>
+#include <QImage>
+#include <QObject>
+#include <QPixmap>
+#include <QString>
+
+class QNetworkAccessManager;
+class QNetworkReply;
+
+//=============================================================================
+/// Slippy-map tiles for the basemap of WebMercator buildings, whose scene
+/// coordinates are EPSG:3857 meters with y pointing north. Tiles are looked
+/// up in an LRU cache in memory, then in an LRU cache on disk, and only
+/// then fetched from the tile server, all asynchronously: tile_ready() is
+/// emitted as each one arrives.
+class TileCache : public QObject
+{
+  Q_OBJECT
+
+public:
+  static const int TILE_SIZE = 256;
+  static const int MAX_ZOOM = 19;
+
+  explicit TileCache(QObject* parent = nullptr);
+
+  /// Where the tiles are fetched from, with {z}, {x} and {y} in it. When
+  /// empty, only the tiles already cached on disk are shown.
+  void set_url_template(const QString& url_template);
+
+  /// The directory of the disk cache; it is scanned when first needed
+  void set_disk_dir(const QString& dir);
+
+  void set_memory_budget_mb(const int mb);
+  void set_disk_budget_mb(const int mb);
+
+  /// The tile, if it is in memory; a null pixmap otherwise
+  QPixmap find(const int z, const int x, const int y);
+
+  /// Load the tile from disk or fetch it, unless that is already under
+  /// way. The latest requests are served first and the oldest queued ones
+  /// are dropped, so that after a long pan or zoom the tiles in view come
+  /// first.
+  void request(const int z, const int x, const int y);
+
+  /// The area covered by a tile, in scene coordinates
+  static QRectF tile_rect(const int z, const int x, const int y);
+
+  /// Side of the tiles of this zoom, in meters
+  static double tile_extent(const int z);
+
+  /// The coarsest zoom which still has at least one tile pixel per screen
+  /// pixel at this level of detail (screen pixels per meter)
+  static int zoom_for_detail(const double level_of_detail);
+
+  /// How well the caches do, for the runtime statistics
+  struct Statistics
+  {
+    std::uint64_t hits = 0;  // find() calls which had the tile in memory
+    std::uint64_t misses = 0;
+    qint64 memory_bytes = 0;
+    qint64 memory_budget_bytes = 0;
+    qint64 disk_bytes = 0;
+    qint64 disk_budget_bytes = 0;
+    int queued = 0;
+    int in_flight = 0;
+    int max_in_flight = MAX_IN_FLIGHT;
+  };
+  Statistics statistics() const;
+
+signals:
+  void tile_ready(int z, int x, int y);
+
+private:
+  static const int MAX_IN_FLIGHT = 6;
+  static const int MAX_QUEUED = 256;
+
+  QNetworkAccessManager* _network = nullptr;
+  QString _url_template;
+
+  QCache<quint64, QPixmap> _memory;  // cost in KB
+  std::uint64_t _hits = 0;
+  std::uint64_t _misses = 0;
+
+  /// Requested tiles, the latest first, and all those not done yet
+  std::deque<quint64> _queue;
+  std::unordered_set<quint64> _pending;
+  int _in_flight = 0;
+
+  /// Not retried until the next session
+  std::unordered_set<quint64> _failed;
+
+  /// The disk cache, the most recently used first
+  struct DiskEntry
+  {
+    qint64 bytes = 0;
+    std::list<quint64>::iterator lru;
+  };
+  QString _disk_dir;
+  bool _disk_scanned = false;
+  qint64 _disk_budget = 0;
+  qint64 _disk_bytes = 0;
+  std::list<quint64> _disk_lru;
+  std::unordered_map<quint64, DiskEntry> _disk_entries;
+
+  static quint64 key(const int z, const int x, const int y);
+  static void split_key(const quint64 key, int& z, int& x, int& y);
+  QString disk_filename(const quint64 key) const;
+
+  void scan_disk();
+  void add_disk_entry(const quint64 key, const qint64 bytes);
+  void remove_disk_entry(const quint64 key);
+  void evict_disk();
+
+  void start_requests();
+  void load_from_disk(const quint64 key);
+  void fetch(const quint64 key);
+  void fetched(const quint64 key, QNetworkReply* reply);
+  void finish(const quint64 key, const QImage& image);
+};
+
+//=============================================================================
+/// Scene item that paints the tiles of a TileCache which are exposed, at
+/// the zoom matching the view, like TiledPixmapItem. Missing tiles are
+/// requested, and the part of a coarser tile in memory is stretched over
+/// them until they arrive.
+class BasemapItem : public QGraphicsObject
+{
+public:
+  explicit BasemapItem(TileCache* tile_cache, QGraphicsItem* parent = nullptr);
+
+  QRectF boundingRect() const override;
+
+  void paint(
+    QPainter* painter,
+    const QStyleOptionGraphicsItem* option,
+    QWidget* widget = nullptr) override;
+
+private:
+  /// How many zooms up a missing tile is looked for
+  static const int MAX_FALLBACK_ZOOMS = 6;
+
+  TileCache* _tile_cache;
+};
+
+#endif
@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include <algorithm>
+
+#include <QtConcurrent/QtConcurrent>
+
+#include "batch_edit_transaction.hpp"
+
+namespace {
+
+/// Exchange the data of two models, but leave the scene item with the one
+/// in the level. Returns true if the model names differ, in which case the
+/// item shows the wrong model and has to be drawn again.
+bool swap_model_data(Model& in_level, Model& other)
+{
+  std::swap(in_level, other);
+  std::swap(in_level.pixmap_item, other.pixmap_item);
+  std::swap(in_level.thumbnail_placeholder, other.thumbnail_placeholder);
+  return in_level.model_name != other.model_name;
+}
+
+}  // namespace
+
+template<typename T>
+bool BatchEditTransaction::Saved<T>::touch(
+  const int idx,
+  const std::size_t size)
+{
+  if (touched.size() < size)
+    touched.resize(size, 0);
+  if (touched[idx])
+    return false;
+  touched[idx] = 1;
+  return true;
+}
+
+BatchEditTransaction::BatchEditTransaction(Building& building)
+: _building(building),
+  _levels(building.levels.size())
+{
+}
+
+Vertex& BatchEditTransaction::vertex(const int level_idx, const int vertex_idx)
+{
+  Level& level = _building.levels[level_idx];
+  LevelChanges& changes = _levels[level_idx];
+  if (!changes.has_lists &&
+    changes.vertices.touch(vertex_idx, level.vertices.size()))
+  {
+    changes.vertices.entities.emplace_back(
+      vertex_idx,
+      level.vertices[vertex_idx]);
+    level.mark_changed(Level::VERTEX, vertex_idx);
+  }
+  return level.vertices[vertex_idx];
+}
+
+Edge& BatchEditTransaction::edge(const int level_idx, const int edge_idx)
+{
+  Level& level = _building.levels[level_idx];
+  LevelChanges& changes = _levels[level_idx];
+  if (!changes.has_lists && changes.edges.touch(edge_idx, level.edges.size()))
+  {
+    changes.edges.entities.emplace_back(edge_idx, level.edges[edge_idx]);
+    level.mark_changed(Level::EDGE, edge_idx);
+  }
+  return level.edges[edge_idx];
+}
+
+Polygon& BatchEditTransaction::polygon(
+  const int level_idx,
+  const int polygon_idx)
+{
+  Level& level = _building.levels[level_idx];
+  LevelChanges& changes = _levels[level_idx];
+  if (!changes.has_lists &&
+    changes.polygons.touch(polygon_idx, level.polygons.size()))
+  {
+    changes.polygons.entities.emplace_back(
+      polygon_idx,
+      level.polygons[polygon_idx]);
+    level.mark_changed(Level::POLYGON, polygon_idx);
+  }
+  return level.polygons[polygon_idx];
+}
+
+Model& BatchEditTransaction::model(const int level_idx, const int model_idx)
+{
+  Level& level = _building.levels[level_idx];
+  LevelChanges& changes = _levels[level_idx];
+  if (!changes.has_lists &&
+    changes.models.touch(model_idx, level.models.size()))
+  {
+    changes.models.entities.emplace_back(model_idx, level.models[model_idx]);
+    level.mark_changed(Level::MODEL, model_idx);
+  }
+  return level.models[model_idx];
+}
+
+BatchEditTransaction::Lists BatchEditTransaction::lists(const int level_idx)
+{
+  Level& level = _building.levels[level_idx];
+  LevelChanges& changes = _levels[level_idx];
+  if (!changes.has_lists)
+  {
+    // the entities edited in place so far are put back by undo() after
+    // these lists, so they stay as they are
+    changes.has_lists = true;
+    changes.list_vertices = level.vertices;
+    changes.list_edges = level.edges;
+    changes.list_polygons = level.polygons;
+    changes.list_models = level.models;
+    level.mark_all_changed();
+  }
+  return Lists{level.vertices, level.edges, level.polygons, level.models};
+}
+
+void BatchEditTransaction::for_each_level(const std::function<void(int)>& f)
+{
+  std::vector<int> level_indices(_levels.size());
+  for (std::size_t i = 0; i < level_indices.size(); i++)
+    level_indices[i] = static_cast<int>(i);
+  QtConcurrent::blockingMap(level_indices, [&f](const int i) { f(i); });
+}
+
+void BatchEditTransaction::finish()
+{
+  for (std::size_t i = 0; i < _levels.size(); i++)
+  {
+    const Level& level = _building.levels[i];
+    const LevelChanges& changes = _levels[i];
+    for (const auto& saved : changes.models.entities)
+    {
+      if (level.models[saved.first].model_name == saved.second.model_name)
+        continue;
+      // the pixmap of another model is needed
+      _building.levels[i].mark_all_changed();
+      break;
+    }
+  }
+}
+
+std::size_t BatchEditTransaction::num_changed() const
+{
+  std::size_t count = 0;
+  for (std::size_t i = 0; i < _levels.size(); i++)
+  {
+    const LevelChanges& changes = _levels[i];
+    if (changes.has_lists)
+    {
+      const Level& level = _building.levels[i];
+      count += level.vertices.size() + level.edges.size() +
+        level.polygons.size() + level.models.size();
+    }
+    else
+      count += changes.vertices.entities.size() +
+        changes.edges.entities.size() +
+        changes.polygons.entities.size() +
+        changes.models.entities.size();
+  }
+  return count;
+}
+
+std::size_t BatchEditTransaction::memory_usage() const
+{
+  std::size_t bytes = 0;
+  for (const LevelChanges& changes : _levels)
+  {
+    bytes += changes.vertices.entities.size() * sizeof(Vertex) +
+      changes.edges.entities.size() * sizeof(Edge) +
+      changes.polygons.entities.size() * sizeof(Polygon) +
+      changes.models.entities.size() * sizeof(Model) +
+      changes.list_vertices.size() * sizeof(Vertex) +
+      changes.list_edges.size() * sizeof(Edge) +
+      changes.list_polygons.size() * sizeof(Polygon) +
+      changes.list_models.size() * sizeof(Model);
+  }
+  return bytes;
+}
+
+void BatchEditTransaction::undo()
+{
+  // in the reverse order of the run: the lists were taken after the
+  // entities saved before them were edited
+  for (std::size_t i = 0; i < _levels.size(); i++)
+  {
+    swap_lists(static_cast<int>(i));
+    swap_entities(static_cast<int>(i));
+  }
+}
+
+void BatchEditTransaction::redo()
+{
+  for (std::size_t i = 0; i < _levels.size(); i++)
+  {
+    swap_entities(static_cast<int>(i));
+    swap_lists(static_cast<int>(i));
+  }
+}
+
+void BatchEditTransaction::clear()
+{
+  _levels = std::vector<LevelChanges>(_levels.size());
+}
+
+void BatchEditTransaction::swap_entities(const int level_idx)
+{
+  if (level_idx >= static_cast<int>(_building.levels.size()))
+    return;
+  Level& level = _building.levels[level_idx];
+  LevelChanges& changes = _levels[level_idx];
+
+  for (auto& saved : changes.vertices.entities)
+  {
+    std::swap(level.vertices[saved.first], saved.second);
+    level.mark_changed(Level::VERTEX, saved.first);
+  }
+  for (auto& saved : changes.edges.entities)
+  {
+    std::swap(level.edges[saved.first], saved.second);
+    level.mark_changed(Level::EDGE, saved.first);
+  }
+  for (auto& saved : changes.polygons.entities)
+  {
+    std::swap(level.polygons[saved.first], saved.second);
+    level.mark_changed(Level::POLYGON, saved.first);
+  }
+  bool redraw_models = false;
+  for (auto& saved : changes.models.entities)
+  {
+    if (swap_model_data(level.models[saved.first], saved.second))
+      redraw_models = true;
+    level.mark_changed(Level::MODEL, saved.first);
+  }
+  if (redraw_models)
+    level.mark_all_changed();
+}
+
+void BatchEditTransaction::swap_lists(const int level_idx)
+{
+  if (level_idx >= static_cast<int>(_building.levels.size()))
+    return;
+  Level& level = _building.levels[level_idx];
+  LevelChanges& changes = _levels[level_idx];
+  if (!changes.has_lists)
+    return;
+  level.vertices.swap(changes.list_vertices);
+  level.edges.swap(changes.list_edges);
+  level.polygons.swap(changes.list_polygons);
+  level.models.swap(changes.list_models);
+  level.mark_all_changed();
+}
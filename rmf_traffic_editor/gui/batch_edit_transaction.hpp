@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef TRAFFIC_EDITOR__BATCH_EDIT_TRANSACTION_HPP
+#define TRAFFIC_EDITOR__BATCH_EDIT_TRANSACTION_HPP
+
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "building.h"
+
+//=============================================================================
+/// The way a BatchEdit plugin changes a building. Every entity it gets
+/// mutable access to is remembered as it was, and marked as changed in its
+/// level, so that the whole run can be undone (and redone) in one step
+/// and the editor only redraws what was touched.
+///
+/// Vertices, edges, polygons and models can be edited in place, through
+/// vertex(), edge() etc., or a level's lists of them can be taken as a
+/// whole with lists(), to add, remove or reorder entities; that level is
+/// then copied once and redrawn completely. Anything else about the
+/// building is read-only here.
+class BatchEditTransaction
+{
+public:
+  explicit BatchEditTransaction(Building& building);
+
+  const Building& building() const { return _building; }
+  int num_levels() const { return static_cast<int>(_levels.size()); }
+  const Level& level(const int level_idx) const
+  {
+    return _building.levels[level_idx];
+  }
+
+  /// Mutable access to one entity. The indices must be valid.
+  Vertex& vertex(const int level_idx, const int vertex_idx);
+  Edge& edge(const int level_idx, const int edge_idx);
+  Polygon& polygon(const int level_idx, const int polygon_idx);
+  Model& model(const int level_idx, const int model_idx);
+
+  struct Lists
+  {
+    std::vector<Vertex>& vertices;
+    std::vector<Edge>& edges;
+    std::vector<Polygon>& polygons;
+    std::vector<Model>& models;
+  };
+
+  /// The entity lists of a level, to be changed freely. Edges and polygons
+  /// must still refer to valid vertices when the run ends.
+  Lists lists(const int level_idx);
+
+  /// Call f(level_idx) for every level, in parallel on the global thread
+  /// pool. f may only touch the level it is given, through this
+  /// transaction.
+  void for_each_level(const std::function<void(int)>& f);
+
+  /// Called by the editor once the run is over, before it redraws
+  void finish();
+
+  /// Whether anything was touched, and how many entities (a level taken
+  /// with lists() counts all of its entities)
+  bool empty() const { return num_changed() == 0; }
+  std::size_t num_changed() const;
+
+  /// Roughly how many bytes are kept for undo
+  std::size_t memory_usage() const;
+
+  /// Put back what was changed, or change it again after undo(). The
+  /// changed entities are marked in their levels.
+  void undo();
+  void redo();
+
+  /// Forget what was kept; neither undo() nor redo() will do anything
+  void clear();
+
+private:
+  template<typename T>
+  struct Saved
+  {
+    std::vector<std::pair<int, T>> entities;  // (index, other value)
+    std::vector<char> touched;  // by index
+
+    bool touch(const int idx, const std::size_t size);
+  };
+
+  struct LevelChanges
+  {
+    Saved<Vertex> vertices;
+    Saved<Edge> edges;
+    Saved<Polygon> polygons;
+    Saved<Model> models;
+
+    // the other lists of a level taken with lists()
+    bool has_lists = false;
+    std::vector<Vertex> list_vertices;
+    std::vector<Edge> list_edges;
+    std::vector<Polygon> list_polygons;
+    std::vector<Model> list_models;
+  };
+
+  Building& _building;
+  std::vector<LevelChanges> _levels;
+
+  void swap_entities(const int level_idx);
+  void swap_lists(const int level_idx);
+};
+
+#endif
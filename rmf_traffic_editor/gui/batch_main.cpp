@@ -0,0 +1,549 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QThread>
+
+#include "building.h"
+#include "building_diff.hpp"
+#include "building_statistics.hpp"
+#include "content_hash.hpp"
+#include "logging.hpp"
+#include "memory_report.hpp"
+
+// Headless batch processing of building files: load, sanity-check,
+// re-save normalized and export the features and nav graphs of each,
+// writing one JSON object per building (and a summary at the end) to
+// stdout. Buildings are processed by worker processes of this program,
+// several at a time, because Building::load() changes the working
+// directory of the process.
+
+namespace {
+
+struct Options
+{
+  QString normalize_dir;
+  QString export_dir;
+  QString features_format = "yaml";
+  QString nav_graph_dir;
+  QString occupancy_dir;
+  double occupancy_resolution = 0.05;
+  QString diff_against;
+  bool verbose = false;
+  bool stream_parser = false;
+};
+
+QJsonObject process_building(const QString& path, const Options& options)
+{
+  QElapsedTimer total_timer;
+  total_timer.start();
+
+  QJsonObject result;
+  result["file"] = path;
+  bool ok = true;
+
+  Building building;
+  building.lazy_images = true;  // nothing is drawn, so only read the sizes
+  building.stream_parser = options.stream_parser;
+
+  QElapsedTimer timer;
+  timer.start();
+  if (!building.load(QFileInfo(path).absoluteFilePath().toStdString()))
+  {
+    result["ok"] = false;
+    result["error"] = "unable to load";
+    result["load_ms"] = timer.elapsed();
+    return result;
+  }
+  result["load_ms"] = timer.elapsed();
+  result["levels"] = static_cast<int>(building.levels.size());
+  result["load_profile"] = building.load_profile.to_json();
+
+  // lets two runs (or two files) be compared a level and a section at a
+  // time without diffing the files
+  result["content_hash"] = ContentHash::to_hex(building.saved_content_hash());
+  QJsonObject level_hashes;
+  for (const auto& level : building.levels)
+  {
+    const ContentHash::LevelHashes& hashes = level.content_hashes();
+    QJsonObject sections;
+    for (int i = 0; i < ContentHash::NUM_SECTIONS; i++)
+      sections[ContentHash::section_name(ContentHash::Section(i))] =
+        ContentHash::to_hex(hashes.sections[i]);
+    QJsonObject level_result;
+    level_result["hash"] = ContentHash::to_hex(hashes.level);
+    level_result["sections"] = sections;
+    level_hashes[QString::fromStdString(level.name)] = level_result;
+  }
+  result["level_hashes"] = level_hashes;
+
+  MemoryReport memory;
+  memory.measure(building);
+  result["memory"] = memory.to_json();
+
+  BuildingStatistics statistics;
+  statistics.gather(building);
+  result["statistics"] = statistics.to_json();
+
+  timer.restart();
+  QJsonArray problems;
+  for (const std::string& problem : building.sanity_check())
+    problems.append(QString::fromStdString(problem));
+  result["check_ms"] = timer.elapsed();
+  result["problems"] = problems;
+  if (!problems.isEmpty())
+    ok = false;
+
+  if (!options.normalize_dir.isEmpty())
+  {
+    timer.restart();
+    const QString normalized =
+      QDir(options.normalize_dir).filePath(QFileInfo(path).fileName());
+    if (building.save_to(normalized.toStdString()))
+    {
+      result["normalized"] = normalized;
+      result["save_profile"] = building.save_profile.to_json();
+    }
+    else
+    {
+      result["error"] = "unable to write " + normalized;
+      ok = false;
+    }
+    result["save_ms"] = timer.elapsed();
+  }
+
+  if (!options.export_dir.isEmpty())
+  {
+    timer.restart();
+    const QString prefix =
+      QDir(options.export_dir).filePath(QFileInfo(path).baseName() + "_");
+    std::vector<std::string> written;
+    if (!building.export_all_features(
+        prefix.toStdString(),
+        "." + options.features_format.toStdString(),
+        &written))
+    {
+      result["error"] = "unable to export all of the features";
+      ok = false;
+    }
+    QJsonArray exported;
+    for (const std::string& file : written)
+      exported.append(QString::fromStdString(file));
+    result["features"] = exported;
+    result["export_ms"] = timer.elapsed();
+  }
+
+  if (!options.nav_graph_dir.isEmpty())
+  {
+    timer.restart();
+    const QString dir = QDir(options.nav_graph_dir).filePath(
+      QFileInfo(path).baseName());
+    std::vector<std::string> written;
+    if (!QDir().mkpath(dir) ||
+      !building.export_nav_graphs(dir.toStdString(), &written))
+    {
+      result["error"] = "unable to export the nav graphs into " + dir;
+      ok = false;
+    }
+    QJsonArray nav_graphs;
+    for (const std::string& file : written)
+      nav_graphs.append(QString::fromStdString(file));
+    result["nav_graphs"] = nav_graphs;
+    result["nav_graph_ms"] = timer.elapsed();
+  }
+
+  if (!options.occupancy_dir.isEmpty())
+  {
+    timer.restart();
+    const QString dir = QDir(options.occupancy_dir).filePath(
+      QFileInfo(path).baseName());
+    std::vector<std::string> written;
+    if (!QDir().mkpath(dir) ||
+      !building.export_occupancy_grids(
+        dir.toStdString(),
+        options.occupancy_resolution,
+        &written))
+    {
+      result["error"] = "unable to export the occupancy grids into " + dir;
+      ok = false;
+    }
+    QJsonArray grids;
+    for (const std::string& file : written)
+      grids.append(QString::fromStdString(file));
+    result["occupancy_grids"] = grids;
+    result["occupancy_ms"] = timer.elapsed();
+  }
+
+  if (!options.diff_against.isEmpty())
+  {
+    timer.restart();
+    Building base;
+    base.lazy_images = true;
+    base.stream_parser = options.stream_parser;
+    if (base.load(options.diff_against.toStdString()))
+    {
+      BuildingDiff diff;
+      diff.compute(base, building);
+      result["diff"] = diff.to_json();
+    }
+    else
+    {
+      result["error"] = "unable to load " + options.diff_against;
+      ok = false;
+    }
+    result["diff_ms"] = timer.elapsed();
+  }
+
+  result["ok"] = ok;
+  result["total_ms"] = total_timer.elapsed();
+  return result;
+}
+
+void write_json(FILE* report, const QJsonObject& object)
+{
+  fprintf(report, "%s\n",
+    QJsonDocument(object).toJson(QJsonDocument::Compact).constData());
+  fflush(report);
+}
+
+/// Process the buildings one after another in this process. Returns the
+/// number which failed.
+int process_here(const QStringList& paths, const Options& options)
+{
+  // everything the library prints goes to stdout, which is the report;
+  // move it out of the way
+  fflush(stdout);
+  FILE* report = fdopen(dup(STDOUT_FILENO), "w");
+  const int log_fd = options.verbose ?
+    STDERR_FILENO : open("/dev/null", O_WRONLY);
+  dup2(log_fd, STDOUT_FILENO);
+
+  int failed = 0;
+  for (const QString& path : paths)
+  {
+    const QJsonObject result = process_building(path, options);
+    if (!result["ok"].toBool())
+      failed++;
+    write_json(report, result);
+  }
+
+  fflush(stdout);
+  fclose(report);
+  return failed;
+}
+
+/// Process each building in a worker process, up to jobs at a time.
+/// Returns the number which failed.
+int process_in_workers(
+  const QStringList& paths,
+  const QStringList& worker_args,
+  const int jobs,
+  const bool verbose)
+{
+  int failed = 0;
+  int running = 0;
+  int next = 0;
+  QEventLoop loop;
+
+  std::function<void()> start_workers;
+  auto worker_finished =
+    [&](QProcess* process, const QString& path, const bool started)
+    {
+      const QByteArray output =
+        started ? process->readAllStandardOutput() : QByteArray();
+      const bool ok = started &&
+        process->exitStatus() == QProcess::NormalExit &&
+        process->exitCode() == 0;
+      if (!ok)
+        failed++;
+
+      if (output.trimmed().isEmpty())
+      {
+        // it crashed, or couldn't be started, before reporting anything
+        QJsonObject result;
+        result["file"] = path;
+        result["ok"] = false;
+        result["error"] = started ?
+          QString("worker exited with code %1").arg(process->exitCode()) :
+          QString("unable to start a worker: ") + process->errorString();
+        write_json(stdout, result);
+      }
+      else
+      {
+        fwrite(output.constData(), 1, output.size(), stdout);
+        fflush(stdout);
+      }
+
+      process->deleteLater();
+      running--;
+      start_workers();
+    };
+
+  start_workers = [&]()
+    {
+      while (running < jobs && next < paths.size())
+      {
+        const QString path = paths[next++];
+        QProcess* process = new QProcess;
+        if (verbose)
+          process->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        else
+          process->setStandardErrorFile(QProcess::nullDevice());
+        QObject::connect(
+          process,
+          QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+          [&worker_finished, process, path](int, QProcess::ExitStatus)
+          {
+            worker_finished(process, path, true);
+          });
+
+        running++;
+        process->start(
+          QCoreApplication::applicationFilePath(),
+          worker_args + QStringList(path));
+        if (!process->waitForStarted())
+          worker_finished(process, path, false);
+      }
+      if (running == 0)
+        loop.quit();
+    };
+
+  start_workers();
+  if (running > 0)
+    loop.exec();
+  return failed;
+}
+
+}  // namespace
+
+
+int main(int argc, char* argv[])
+{
+  QCoreApplication app(argc, argv);
+  app.setOrganizationName("open-robotics");
+  app.setOrganizationDomain("openrobotics.org");
+  app.setApplicationName("traffic-editor-batch");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+    "Load and check building files without a display, optionally writing "
+    "them back normalized and exporting their features and nav graphs. "
+    "Prints a JSON object for each building, then a summary.");
+  parser.addHelpOption();
+  parser.addPositionalArgument(
+    "buildings",
+    "Building YAML files to process",
+    "[buildings...]");
+
+  const QCommandLineOption jobs_option(
+    QStringList() << "j" << "jobs",
+    "Number of buildings to process at once (default: one per core)",
+    "n",
+    QString::number(QThread::idealThreadCount()));
+  parser.addOption(jobs_option);
+
+  const QCommandLineOption normalize_option(
+    "normalize",
+    "Write each building, re-serialized, into this directory",
+    "dir");
+  parser.addOption(normalize_option);
+
+  const QCommandLineOption export_option(
+    "export-features",
+    "Export the features of each level into this directory",
+    "dir");
+  parser.addOption(export_option);
+
+  const QCommandLineOption features_format_option(
+    "features-format",
+    "Format of the exported features: yaml, or csv for one row per feature "
+    "(default: yaml)",
+    "format",
+    "yaml");
+  parser.addOption(features_format_option);
+
+  const QCommandLineOption nav_graph_option(
+    "export-nav-graphs",
+    "Export the nav graphs of each building, as YAML and binary, into a "
+    "directory of its name in this directory",
+    "dir");
+  parser.addOption(nav_graph_option);
+
+  const QCommandLineOption occupancy_option(
+    "export-occupancy-grids",
+    "Export a PGM and YAML occupancy grid of each level of each building "
+    "into a directory of its name in this directory",
+    "dir");
+  parser.addOption(occupancy_option);
+
+  const QCommandLineOption occupancy_resolution_option(
+    "occupancy-resolution",
+    "Size of a cell of the occupancy grids, in meters (default: 0.05)",
+    "meters",
+    "0.05");
+  parser.addOption(occupancy_resolution_option);
+
+  const QCommandLineOption diff_option(
+    "diff-against",
+    "Report what was added, removed, moved or changed in each building "
+    "since this version of it",
+    "building");
+  parser.addOption(diff_option);
+
+  const QCommandLineOption verbose_option(
+    QStringList() << "v" << "verbose",
+    "Pass the log of loading and saving through to stderr");
+  parser.addOption(verbose_option);
+
+  const QCommandLineOption stream_parser_option(
+    "stream-parser",
+    "Parse the entities of the levels with the streaming parser, falling "
+    "back to yaml-cpp for files it doesn't understand");
+  parser.addOption(stream_parser_option);
+
+  // used by the workers which this program starts for itself
+  QCommandLineOption worker_option(
+    "worker",
+    "Process the buildings in this process, one after another");
+  worker_option.setFlags(QCommandLineOption::HiddenFromHelp);
+  parser.addOption(worker_option);
+
+  parser.process(app);
+
+  const QStringList paths = parser.positionalArguments();
+  if (paths.isEmpty())
+    parser.showHelp(1);
+
+  // Building::load() changes the working directory, so this must be done
+  // before the first one
+  Options options;
+  if (parser.isSet(normalize_option))
+    options.normalize_dir =
+      QDir(parser.value(normalize_option)).absolutePath();
+  if (parser.isSet(export_option))
+    options.export_dir = QDir(parser.value(export_option)).absolutePath();
+  options.features_format = parser.value(features_format_option).toLower();
+  if (options.features_format != "yaml" && options.features_format != "csv")
+  {
+    fprintf(stderr, "unknown features format %s\n",
+      qUtf8Printable(options.features_format));
+    return 1;
+  }
+  if (parser.isSet(nav_graph_option))
+    options.nav_graph_dir =
+      QDir(parser.value(nav_graph_option)).absolutePath();
+  if (parser.isSet(occupancy_option))
+    options.occupancy_dir =
+      QDir(parser.value(occupancy_option)).absolutePath();
+  options.occupancy_resolution =
+    parser.value(occupancy_resolution_option).toDouble();
+  if (options.occupancy_resolution <= 0.0)
+  {
+    fprintf(stderr, "invalid occupancy resolution %s\n",
+      qUtf8Printable(parser.value(occupancy_resolution_option)));
+    return 1;
+  }
+  if (parser.isSet(diff_option))
+    options.diff_against =
+      QFileInfo(parser.value(diff_option)).absoluteFilePath();
+  options.verbose = parser.isSet(verbose_option);
+  options.stream_parser = parser.isSet(stream_parser_option);
+  if (!options.verbose)
+    QLoggingCategory::setFilterRules("traffic_editor.*=false");
+
+  for (const QString& dir :
+    {options.normalize_dir, options.export_dir, options.nav_graph_dir,
+      options.occupancy_dir})
+  {
+    if (!dir.isEmpty() && !QDir().mkpath(dir))
+    {
+      fprintf(stderr, "unable to create %s\n", qUtf8Printable(dir));
+      return 1;
+    }
+  }
+
+  QStringList absolute_paths;
+  for (const QString& path : paths)
+    absolute_paths.append(QFileInfo(path).absoluteFilePath());
+
+  const int jobs = std::max(1, parser.value(jobs_option).toInt());
+
+  QElapsedTimer timer;
+  timer.start();
+  int failed = 0;
+  if (parser.isSet(worker_option) || jobs == 1 || paths.size() == 1)
+    failed = process_here(absolute_paths, options);
+  else
+  {
+    QStringList worker_args;
+    worker_args << "--worker";
+    if (!options.normalize_dir.isEmpty())
+      worker_args << "--normalize" << options.normalize_dir;
+    if (!options.export_dir.isEmpty())
+      worker_args << "--export-features" << options.export_dir
+                  << "--features-format" << options.features_format;
+    if (!options.nav_graph_dir.isEmpty())
+      worker_args << "--export-nav-graphs" << options.nav_graph_dir;
+    if (!options.occupancy_dir.isEmpty())
+      worker_args << "--export-occupancy-grids" << options.occupancy_dir
+                  << "--occupancy-resolution"
+                  << QString::number(options.occupancy_resolution);
+    if (!options.diff_against.isEmpty())
+      worker_args << "--diff-against" << options.diff_against;
+    if (options.verbose)
+      worker_args << "--verbose";
+    if (options.stream_parser)
+      worker_args << "--stream-parser";
+    failed = process_in_workers(
+      absolute_paths,
+      worker_args,
+      jobs,
+      options.verbose);
+  }
+
+  if (!parser.isSet(worker_option))
+  {
+    QJsonObject summary;
+    summary["summary"] = true;
+    summary["files"] = paths.size();
+    summary["failed"] = failed;
+    summary["jobs"] = jobs;
+    summary["total_ms"] = timer.elapsed();
+    write_json(stdout, summary);
+  }
+
+  return failed > 0 ? 1 : 0;
+}
@@ -16,18 +16,37 @@
 */
 
 #include <algorithm>
-#include <fstream>
+#include <streambuf>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <set>
 #include <yaml-cpp/yaml.h>
 
+#include <QFile>
 #include <QFileInfo>
+#include <QGraphicsItemGroup>
+#include <QCryptographicHash>
 #include <QDir>
+#include <QSaveFile>
 #include <QThread>
-#include <QtConcurrent/QtConcurrent>
 #include <QElapsedTimer>
 
 #include "building.h"
+#include "building_stream_parser.hpp"
+#include "building_cache.hpp"
+#include "building_validator.hpp"
+#include "compressed_stream.hpp"
+#include "content_hash.hpp"
+#include "fiducial_alignment.hpp"
+#include "heap.hpp"
+#include "io_profile.hpp"
+#include "joint_alignment.hpp"
+#include "logging.hpp"
+#include "nav_graph_exporter.hpp"
+#include "occupancy_grid_exporter.hpp"
+#include "task_pool.hpp"
+#include "trace.hpp"
 #include "yaml_utils.h"
 
 using std::string;
@@ -37,6 +56,96 @@ using std::unique_ptr;
 using std::shared_ptr;
 
 
+namespace {
+
+/// Fiducials further than this from where the fit of the others puts them
+/// are left out of the fit of a level
+const double ALIGNMENT_INLIER_METERS = 0.5;
+
+/// A top-level section of the building file. In a split building (see
+/// Building::split_files) its value is the name of a file holding it,
+/// which is read instead, and split is set.
+bool load_section(
+  const YAML::Node& y,
+  const string& key,
+  YAML::Node& section,
+  bool& split)
+{
+  const YAML::Node value = y[key];
+  if (!value)
+    return true;
+  if (!value.IsScalar())
+  {
+    section = value;
+    return true;
+  }
+
+  const string part_filename = value.as<string>();
+  try
+  {
+    const YAML::Node part = YAML::LoadFile(part_filename);
+    const YAML::Node part_section = part[key];
+    if (!part_section)
+    {
+      qCWarning(lc_io,
+        "%s has no %s section", part_filename.c_str(), key.c_str());
+      return false;
+    }
+    section = part_section;
+  }
+  catch (const std::exception& e)
+  {
+    qCWarning(lc_io, "couldn't parse %s: %s", part_filename.c_str(), e.what());
+    return false;
+  }
+  split = true;
+  return true;
+}
+
+/// The data of a level of a split building, from its own file
+YAML::Node load_level_file(
+  const string& level_filename,
+  const string& level_name)
+{
+  const YAML::Node part = YAML::LoadFile(level_filename);
+  const YAML::Node level_data = part[level_name];
+  if (!level_data)
+    throw std::runtime_error(level_filename + " has no level " + level_name);
+  return level_data;
+}
+
+/// The data of a level of a split building, with its entities built by
+/// BuildingStreamParser. Returns false if the entities are in level_data
+/// after all, when the file had to be parsed by yaml-cpp.
+bool stream_level_file(
+  const string& level_filename,
+  const string& level_name,
+  YAML::Node& level_data,
+  BuildingStreamParser::LevelEntities& entities)
+{
+  BuildingStreamParser::Result parsed;
+  string error;
+  if (!BuildingStreamParser::parse_file(level_filename, "", parsed, error))
+  {
+    qCInfo(lc_io, "falling back to yaml-cpp for %s: %s",
+      level_filename.c_str(),
+      error.c_str());
+    level_data = load_level_file(level_filename, level_name);
+    return false;
+  }
+  level_data = parsed.rest[level_name];
+  if (!level_data)
+    throw std::runtime_error(level_filename + " has no level " + level_name);
+  auto it = parsed.levels.find(level_name);
+  if (it == parsed.levels.end())
+    return false;
+  entities = std::move(it->second);
+  return true;
+}
+
+}  // namespace
+
+
 Building::Building()
 : name("building"),
   coordinate_system(CoordinateSystem::ReferenceImage)
@@ -45,6 +154,7 @@ Building::Building()
 
 Building::~Building()
 {
+  invalidate_lift_graphics();
 }
 
 /// Load a YAML file description of a building map
@@ -53,29 +163,109 @@ Building::~Building()
 /// in the YAML file.
 bool Building::load(const string& _filename)
 {
-  printf("Building::load(%s)\n", _filename.c_str());
+  TRACE_ZONE("Building::load");
+  qCInfo(lc_io, "Building::load(%s)", _filename.c_str());
   filename = _filename;
 
   if (filename.find(".project.yaml") != string::npos)
   {
-    printf(
-      "\nIt looks like this is a previous traffic-editor project file. "
+    qCWarning(lc_io,
+      "It looks like this is a previous traffic-editor project file. "
       "This file is no longer used. Please load the .building.yaml "
-      "file instead.\n\n");
+      "file instead.");
     return false;
   }
 
+  load_profile.clear();
+  IoProfile::PhaseTimer phase(&load_profile);
+  load_profile.add_count(
+    "bytes read",
+    QFileInfo(QString::fromStdString(filename)).size());
+
   YAML::Node y;
-  try
+  QByteArray yaml_hash;
+  if (use_cache)
   {
-    y = YAML::LoadFile(filename.c_str());
+    phase.start("read cache");
+    yaml_hash = BuildingCache::file_hash(filename);
+    if (BuildingCache::load(filename, yaml_hash, y))
+      qCInfo(lc_io, "loaded %s from its cache", filename.c_str());
   }
-  catch (const std::exception& e)
+
+  // compressed files are decompressed as they are parsed; the stream
+  // parser needs the whole text, so they always go through yaml-cpp
+  const CompressedStream::Format compression =
+    CompressedStream::format_for(filename);
+  if (!CompressedStream::is_supported(compression))
   {
-    printf("couldn't parse %s: %s\n", filename.c_str(), e.what());
+    qCWarning(lc_io, "couldn't read %s: built without %s support",
+      filename.c_str(),
+      CompressedStream::format_name(compression));
     return false;
   }
 
+  // the entities of the levels, when they were stream-parsed
+  BuildingStreamParser::Result parsed;
+  bool streamed = false;
+  if (!y && stream_parser && !use_cache &&
+    compression == CompressedStream::NONE)
+  {
+    phase.start("stream parse");
+    string error;
+    streamed =
+      BuildingStreamParser::parse_file(filename, "levels", parsed, error);
+    if (streamed)
+      y = parsed.rest;
+    else
+      qCInfo(lc_io, "falling back to yaml-cpp for %s: %s",
+        filename.c_str(),
+        error.c_str());
+  }
+
+  if (!y)
+  {
+    phase.start("parse YAML");
+    try
+    {
+      if (compression == CompressedStream::NONE)
+        y = YAML::LoadFile(filename.c_str());
+      else
+      {
+        QFile file(QString::fromStdString(filename));
+        if (!file.open(QIODevice::ReadOnly))
+        {
+          qCWarning(lc_io, "couldn't open %s: %s",
+            filename.c_str(),
+            qUtf8Printable(file.errorString()));
+          return false;
+        }
+        DecompressingStreamBuf stream_buf(&file, compression);
+        std::istream fin(&stream_buf);
+        y = YAML::Load(fin);
+        if (!stream_buf.error().empty())
+        {
+          qCWarning(lc_io, "couldn't decompress %s: %s",
+            filename.c_str(),
+            stream_buf.error().c_str());
+          return false;
+        }
+        load_profile.add_count(
+          "bytes decompressed",
+          static_cast<qint64>(stream_buf.bytes_out()));
+      }
+    }
+    catch (const std::exception& e)
+    {
+      qCWarning(lc_io, "couldn't parse %s: %s", filename.c_str(), e.what());
+      return false;
+    }
+
+    phase.start("write cache");
+    if (use_cache && !BuildingCache::save(filename, yaml_hash, y))
+      qCWarning(lc_io, "couldn't write the cache of %s", filename.c_str());
+  }
+  phase.start("sections");
+
   // change directory to the path of the file, so that we can correctly open
   // relative paths recorded in the file
 
@@ -83,10 +273,19 @@ bool Building::load(const string& _filename)
   qDebug("changing directory to [%s]", qUtf8Printable(dir));
   if (!QDir::setCurrent(dir))
   {
-    printf("couldn't change directory\n");
+    qCWarning(lc_io, "couldn't change directory");
     return false;
   }
 
+  split_files = false;
+  YAML::Node crowd_sim_data;
+  YAML::Node graphs_data;
+  YAML::Node lifts_data;
+  if (!load_section(y, "crowd_sim", crowd_sim_data, split_files) ||
+    !load_section(y, "graphs", graphs_data, split_files) ||
+    !load_section(y, "lifts", lifts_data, split_files))
+    return false;
+
   if (y["name"])
     name = y["name"].as<string>();
 
@@ -97,16 +296,17 @@ bool Building::load(const string& _filename)
   if (y["reference_level_name"])
     reference_level_name = y["reference_level_name"].as<string>();
 
-  // crowd_sim_impl is initialized when creating crowd_sim_table in editor.cpp
+  // crowd_sim_impl is initialized by the Editor constructor in editor.cpp
   // just in case the pointer is not initialized
   if (crowd_sim_impl == nullptr)
     crowd_sim_impl = std::make_shared<crowd_sim::CrowdSimImplementation>();
-  if (y["crowd_sim"] && y["crowd_sim"].IsMap())
+  if (crowd_sim_data.IsMap())
   {
-    if (!crowd_sim_impl->from_yaml(y["crowd_sim"]))
+    if (!crowd_sim_impl->from_yaml(crowd_sim_data))
     {
-      printf(
-        "Error in loading crowd_sim configuration from yaml, re-initialize crowd_sim");
+      qCWarning(lc_io,
+        "Error in loading crowd_sim configuration from yaml, "
+        "re-initialize crowd_sim");
       crowd_sim_impl->clear();
       crowd_sim_impl->init_default_configure();
     }
@@ -114,51 +314,183 @@ bool Building::load(const string& _filename)
 
   if (!y["levels"] || !y["levels"].IsMap())
   {
-    printf("expected top-level dictionary named 'levels'");
+    qCWarning(lc_io, "expected top-level dictionary named 'levels'");
     return false;
   }
 
-  levels.clear();
+  // Parse the levels concurrently, each straight into its own slot. The
+  // YAML tree is only read from here on, so the workers can share it.
+  struct LevelSource
+  {
+    string name;
+    YAML::Node data;
+    std::size_t idx;
+    string error;
+    qint64 parse_nsec = 0;
+    bool own_file = false;
+    bool streamed = false;
+    BuildingStreamParser::LevelEntities entities;
+  };
+  vector<LevelSource> level_sources;
   const YAML::Node yl = y["levels"];
   for (YAML::const_iterator it = yl.begin(); it != yl.end(); ++it)
   {
-    Level level;
-    level.from_yaml(it->first.as<string>(), it->second, coordinate_system);
-    levels.push_back(level);
+    LevelSource source;
+    source.name = it->first.as<string>();
+    source.data = it->second;
+    source.idx = level_sources.size();
+    auto entities = parsed.levels.find(source.name);
+    if (streamed && entities != parsed.levels.end())
+    {
+      source.streamed = true;
+      source.entities = std::move(entities->second);
+    }
+    level_sources.push_back(std::move(source));
+  }
+
+  phase.start("parse levels");
+  levels.clear();
+  levels.resize(level_sources.size());
+  TaskPool::instance().parallel_for(
+    static_cast<int>(level_sources.size()),
+    [&](int i)
+    {
+      LevelSource& source = level_sources[i];
+      QElapsedTimer timer;
+      timer.start();
+      try
+      {
+        // in a split building, each level is in a file of its own
+        source.own_file = source.data.IsScalar();
+        if (source.own_file)
+          load_profile.add_count(
+            "bytes read",
+            QFileInfo(QString::fromStdString(source.data.as<string>())).size());
+        YAML::Node level_data = source.data;
+        if (source.own_file && stream_parser && !use_cache)
+          source.streamed = stream_level_file(
+            source.data.as<string>(),
+            source.name,
+            level_data,
+            source.entities);
+        else if (source.own_file)
+          level_data = load_level_file(source.data.as<string>(), source.name);
+        Level& level = levels[source.idx];
+        level.from_yaml(
+          source.name,
+          level_data,
+          coordinate_system,
+          !lazy_images);
+        if (source.streamed)
+        {
+          level.vertices = std::move(source.entities.vertices);
+          level.edges = std::move(source.entities.edges);
+          level.polygons = std::move(source.entities.polygons);
+        }
+      }
+      catch (const std::exception& e)
+      {
+        source.error = e.what();
+      }
+      source.parse_nsec = timer.nsecsElapsed();
+    });
+  phase.stop();
+
+  for (const LevelSource& source : level_sources)
+  {
+    qCDebug(lc_io, "parsed level [%s] in %lld ms",
+      source.name.c_str(),
+      static_cast<long long>(source.parse_nsec / 1000000));
+    load_profile.add_phase_time(
+      "Level::from_yaml (all threads)",
+      source.parse_nsec);
+    if (!source.error.empty())
+    {
+      qCWarning(lc_io, "couldn't parse level [%s]: %s",
+        source.name.c_str(),
+        source.error.c_str());
+      levels.clear();
+      return false;
+    }
+    if (source.own_file)
+      split_files = true;
+    if (source.streamed)
+      load_profile.add_count("levels streamed", 1);
   }
 
-  QtConcurrent::blockingMap(
-    levels,
-    [&](auto& level) { level.load_drawing(); });
+  for (const Level& level : levels)
+  {
+    load_profile.add_count("levels", 1);
+    load_profile.add_count("vertices", level.vertices.size());
+    load_profile.add_count("edges", level.edges.size());
+    load_profile.add_count("polygons", level.polygons.size());
+    load_profile.add_count("models", level.models.size());
+    load_profile.add_count("fiducials", level.fiducials.size());
+    load_profile.add_count("layers", level.layers.size());
+  }
 
-  // now that all images are loaded, we can calculate scale for annotated
-  // measurement lanes
+  phase.start(lazy_images ? "read drawing sizes" : "decode images");
+  if (lazy_images)
+    TaskPool::instance().parallel_for(
+      static_cast<int>(levels.size()),
+      [&](int i) { levels[i].read_drawing_size(); });
+  else
+    TaskPool::instance().parallel_for(
+      static_cast<int>(levels.size()),
+      [&](int i)
+      {
+        levels[i].load_images(drawing_preview_size, &load_profile);
+      });
+
+  // now that all image sizes are known, we can calculate scale for
+  // annotated measurement lanes
+  phase.start("calculate_scale");
   for (auto& level : levels)
     level.calculate_scale(coordinate_system);
 
+  phase.start("lifts");
   lifts.clear();
-  if (y["lifts"] && y["lifts"].IsMap())
+  invalidate_lift_graphics();
+  if (lifts_data.IsMap())
   {
-    const YAML::Node& y_lifts = y["lifts"];
+    const YAML::Node& y_lifts = lifts_data;
     for (YAML::const_iterator it = y_lifts.begin(); it != y_lifts.end(); ++it)
     {
       Lift lift;
       lift.from_yaml(it->first.as<string>(), it->second, levels);
-      lifts.push_back(lift);
+      lifts.push_back(std::move(lift));
     }
   }
+  compile_lifts();
+
+  load_profile.add_count("lifts", lifts.size());
 
-  if (y["graphs"] && y["graphs"].IsMap())
+  phase.start("graphs");
+  if (graphs_data.IsMap())
   {
-    const YAML::Node& g_map = y["graphs"];
+    const YAML::Node& g_map = graphs_data;
     for (YAML::const_iterator it = g_map.begin(); it != g_map.end(); ++it)
     {
       Graph graph;
       graph.from_yaml(it->first.as<int>(), it->second);
-      graphs.push_back(graph);
+      graphs.push_back(std::move(graph));
     }
   }
 
+  // only their names and files: each is parsed when first shown
+  traffic_maps.clear();
+  if (y["traffic_maps"] && y["traffic_maps"].IsMap())
+  {
+    const YAML::Node& t_map = y["traffic_maps"];
+    for (YAML::const_iterator it = t_map.begin(); it != t_map.end(); ++it)
+    {
+      TrafficMap traffic_map;
+      traffic_map.from_project_yaml(it->first.as<string>(), it->second);
+      traffic_maps.push_back(std::move(traffic_map));
+    }
+  }
+
+  phase.start("parameters");
   if (y["parameters"] && y["parameters"].IsMap())
   {
     const YAML::Node& gp = y["parameters"];
@@ -170,60 +502,534 @@ bool Building::load(const string& _filename)
     }
   }
 
+  phase.start("calculate_all_transforms");
   calculate_all_transforms();
+
+  phase.start("content_hash");
+  _saved_content_hash = content_hash();
   return true;
 }
 
+namespace {
+
+/// Lets the YAML emitter stream straight into a QSaveFile, hashing what
+/// it writes for the sidecar cache
+class DeviceStreamBuf : public std::streambuf
+{
+public:
+  explicit DeviceStreamBuf(QIODevice* device)
+  : _device(device), _hash(QCryptographicHash::Sha1)
+  {
+  }
+
+  QByteArray hash() const { return _hash.result(); }
+
+  qint64 bytes_written() const { return _bytes_written; }
+
+protected:
+  int_type overflow(int_type c) override
+  {
+    if (traits_type::eq_int_type(c, traits_type::eof()))
+      return traits_type::not_eof(c);
+    const char ch = traits_type::to_char_type(c);
+    return xsputn(&ch, 1) == 1 ? c : traits_type::eof();
+  }
+
+  std::streamsize xsputn(const char* s, std::streamsize n) override
+  {
+    const qint64 written = _device->write(s, n);
+    if (written <= 0)
+      return 0;
+    _hash.addData(s, static_cast<int>(written));
+    _bytes_written += written;
+    return written;
+  }
+
+private:
+  QIODevice* _device;
+  QCryptographicHash _hash;
+  qint64 _bytes_written = 0;
+};
+
+/// Replace a file atomically with this text
+bool write_text_file(
+  const QString& path,
+  const string& text,
+  IoProfile& profile)
+{
+  QSaveFile file(path);
+  if (!file.open(QIODevice::WriteOnly) ||
+    file.write(text.data(), static_cast<qint64>(text.size())) !=
+    static_cast<qint64>(text.size()) ||
+    !file.commit())
+  {
+    qCWarning(lc_io, "unable to save %s: %s",
+      qUtf8Printable(path),
+      qUtf8Printable(file.errorString()));
+    return false;
+  }
+  profile.add_count("bytes written", static_cast<qint64>(text.size()));
+  return true;
+}
+
+/// The start of the file name of a level of a split building: the level
+/// name, with anything that can't go in a file name replaced
+QString level_file_base(const string& level_name)
+{
+  QString base = "level_";
+  for (const QChar c : QString::fromStdString(level_name))
+    base += c.isLetterOrNumber() || c == '-' || c == '_' ? c : QChar('_');
+  return base;
+}
+
+/// A name for a file which a save of a split building is about to write:
+/// base.yaml, or else base.2.yaml, base.3.yaml and so on, whichever isn't
+/// in the directory already. The files the manifest on disk refers to are
+/// never overwritten, so it can still be loaded if the save fails.
+QString fresh_part_name(
+  const QDir& dir,
+  const QString& base,
+  std::set<QString>& used)
+{
+  QString file_name = base + ".yaml";
+  for (int i = 2; used.count(file_name) || dir.exists(file_name); i++)
+    file_name = base + "." + QString::number(i) + ".yaml";
+  used.insert(file_name);
+  return file_name;
+}
+
+/// Remove the files of a split building which its manifest no longer
+/// refers to: those of levels which were renamed or deleted, and the
+/// previous versions of the sections which were written again
+void remove_stale_parts(QDir& dir, const std::set<QString>& used)
+{
+  const QStringList stale = dir.entryList(
+    QStringList() << "level_*.yaml" << "crowd_sim*.yaml" << "graphs*.yaml" <<
+      "lifts*.yaml",
+    QDir::Files);
+  for (const QString& file_name : stale)
+  {
+    if (!used.count(file_name))
+      dir.remove(file_name);
+  }
+}
+
+}  // namespace
+
+QString Building::split_dir(const std::string& path)
+{
+  // the same directory whether the manifest is compressed or not
+  const QFileInfo file_info(
+    QString::fromStdString(CompressedStream::without_extension(path)));
+  return file_info.dir().filePath(file_info.completeBaseName() + ".d");
+}
+
 bool Building::save()
 {
-  printf("Building::save_yaml(%s)\n", filename.c_str());
+  qCInfo(lc_io, "Building::save_yaml(%s)", filename.c_str());
+  return save_to(filename, use_cache);
+}
 
-  YAML::Node y;
-  y["name"] = name;
+std::shared_ptr<Building> Building::snapshot() const
+{
+  // copy the data members one by one, leaving out the cached graphics
+  auto copy = std::make_shared<Building>();
+  copy->name = name;
+  copy->reference_level_name = reference_level_name;
+  copy->levels = levels;
+  copy->lifts = lifts;
+  copy->graphs = graphs;
+  copy->params = params;
+  copy->coordinate_system = coordinate_system;
+  copy->filename = filename;
+  copy->split_files = split_files;
+  if (crowd_sim_impl)
+    copy->crowd_sim_impl =
+      std::make_shared<crowd_sim::CrowdSimImplementation>(*crowd_sim_impl);
+  return copy;
+}
 
-  y["coordinate_system"] = coordinate_system.to_string();
+bool Building::save_to(const std::string& path, const bool write_cache) const
+{
+  save_profile.clear();
+  IoProfile::PhaseTimer phase(&save_profile);
+  phase.start("sections");
+
+  // QSaveFile writes to a temporary file, and only renames it over the
+  // destination once it has been completely written and flushed to disk,
+  // so a crash or a full disk never leaves a half-written building file
+  QSaveFile file(QString::fromStdString(path));
+  if (!file.open(QIODevice::WriteOnly))
+  {
+    qCWarning(lc_io, "unable to open %s: %s",
+      path.c_str(),
+      qUtf8Printable(file.errorString()));
+    return false;
+  }
+  DeviceStreamBuf stream_buf(&file);
 
-  if (!reference_level_name.empty())
-    y["reference_level_name"] = reference_level_name;
+  // compressed on the way to the file, on several threads with zstd
+  const CompressedStream::Format compression =
+    CompressedStream::format_for(path);
+  if (!CompressedStream::is_supported(compression))
+  {
+    qCWarning(lc_io, "unable to save %s: built without %s support",
+      path.c_str(),
+      CompressedStream::format_name(compression));
+    return false;
+  }
+  CompressingStreamBuf compressing_buf(&stream_buf, compression);
+  std::ostream fout(
+    compression == CompressedStream::NONE ?
+    static_cast<std::streambuf*>(&stream_buf) : &compressing_buf);
+
+  // A split building keeps its big sections in a directory beside it;
+  // the cache of its manifest is left for load() to write
+  QDir part_dir(split_dir(path));
+  const QString part_dir_name = QFileInfo(part_dir.path()).fileName();
+  if (split_files && !QDir().mkpath(part_dir.path()))
+  {
+    qCWarning(lc_io, "unable to create %s", qUtf8Printable(part_dir.path()));
+    return false;
+  }
 
-  y["levels"] = YAML::Node(YAML::NodeType::Map);
-  for (const auto& level : levels)
-    y["levels"][level.name] = level.to_yaml();
+  BuildingCache::Writer cache;
+  const bool caching = write_cache && !split_files && cache.open(path);
 
-  y["lifts"] = YAML::Node(YAML::NodeType::Map);
-  for (const auto& lift : lifts)
-    y["lifts"][lift.name] = lift.to_yaml();
-  if (lifts.empty())
-    y["lifts"].SetStyle(YAML::EmitterStyle::Flow);
+  // the files of a split building the new manifest refers to, and those
+  // of them which this save wrote, which go again if it fails
+  std::set<QString> part_names;
+  std::vector<QString> new_parts;
+  std::vector<Level::SavedYaml*> new_level_files;
+  auto discard_new_parts = [&]()
+    {
+      for (const QString& part_name : new_parts)
+        part_dir.remove(part_name);
+      for (Level::SavedYaml* saved : new_level_files)
+        saved->file.clear();
+    };
+
+  // The document is written one top-level key at a time, in the sorted
+  // order that yaml_utils::write_node would use, each emitted on its own
+  // as a one-entry map. That gives the same text as emitting the whole
+  // tree, but only one section's nodes exist at a time, and the text of
+  // each level can be kept and spliced back in until it changes.
+  bool ok = true;
+  auto write_section = [&](
+    const string& key,
+    const YAML::Node& value,
+    const bool own_file)
+    {
+      string text;
+      ok = emit_entry(key, value, text) && ok;
+      if (own_file && split_files)
+      {
+        const QString part_name = fresh_part_name(
+          part_dir,
+          QString::fromStdString(key),
+          part_names);
+        const bool written = write_text_file(
+          part_dir.filePath(part_name),
+          text + "\n",
+          save_profile);
+        if (written)
+          new_parts.push_back(part_name);
+        ok = written && ok;
+        const string relative = (part_dir_name + "/" + part_name).toStdString();
+        ok = emit_entry(key, YAML::Node(relative), text) && ok;
+      }
+      fout << text << "\n";
+      if (caching)
+      {
+        cache.key(key);
+        cache.node(value);
+      }
+    };
+
+  const std::size_t num_keys = 5 +
+    (crowd_sim_impl ? 1 : 0) +
+    (params.empty() ? 0 : 1) +
+    (reference_level_name.empty() ? 0 : 1) +
+    (traffic_maps.empty() ? 0 : 1);
+  if (caching)
+    cache.begin_map(num_keys);
+
+  write_section(
+    "coordinate_system",
+    YAML::Node(coordinate_system.to_string()),
+    false);
 
   if (crowd_sim_impl)
-    y["crowd_sim"] = crowd_sim_impl->to_yaml();
+    write_section("crowd_sim", crowd_sim_impl->to_yaml(), true);
 
-  y["graphs"] = YAML::Node(YAML::NodeType::Map);
+  YAML::Node graphs_node(YAML::NodeType::Map);
   for (const auto& graph : graphs)
-    y["graphs"][graph.idx] = graph.to_yaml();
+    graphs_node[graph.idx] = graph.to_yaml();
+  write_section("graphs", graphs_node, true);
+
+  // keys are sorted as strings, and later duplicates replace earlier ones
+  std::map<string, const Level*> sorted_levels;
+  for (const auto& level : levels)
+    sorted_levels[level.name] = &level;
+  if (sorted_levels.empty())
+    write_section("levels", YAML::Node(YAML::NodeType::Map), false);
+  else
+  {
+    phase.start("levels");
+    fout << "levels:";
+    if (caching)
+    {
+      cache.key("levels");
+      cache.begin_map(sorted_levels.size());
+    }
+
+    int num_serialized = 0;
+    int num_files_written = 0;
+    for (const auto& it : sorted_levels)
+    {
+      Level::SavedYaml& saved = it.second->saved_yaml;
+      if (!saved.valid ||
+        saved.name != it.first ||
+        (caching && saved.cache.isEmpty()))
+      {
+        const YAML::Node level_node = it.second->to_yaml();
+        saved.valid = emit_entry(it.first, level_node, saved.text);
+        saved.name = it.first;
+        saved.cache = caching ?
+          BuildingCache::encode(level_node) : QByteArray();
+        saved.file.clear();
+        ok = saved.valid && ok;
+        num_serialized++;
+      }
+
+      if (split_files)
+      {
+        // the file is only written again if the level has changed since,
+        // and then under a new name
+        const QFileInfo saved_file(QString::fromStdString(saved.file));
+        QString file_name = saved_file.fileName();
+        if (saved.file.empty() ||
+          !saved_file.exists() ||
+          saved_file.absolutePath() != part_dir.absolutePath() ||
+          part_names.count(file_name))
+        {
+          file_name = fresh_part_name(
+            part_dir,
+            level_file_base(it.first),
+            part_names);
+          const QString level_path = part_dir.filePath(file_name);
+          const bool written =
+            write_text_file(level_path, saved.text + "\n", save_profile);
+          saved.file = written ? level_path.toStdString() : string();
+          if (written)
+          {
+            new_parts.push_back(file_name);
+            new_level_files.push_back(&saved);
+          }
+          ok = written && ok;
+          num_files_written++;
+        }
+        else
+          part_names.insert(file_name);
+
+        string entry;
+        ok = emit_entry(
+          it.first,
+          YAML::Node((part_dir_name + "/" + file_name).toStdString()),
+          entry) && ok;
+        fout << "\n  " << entry;
+        continue;
+      }
+
+      // nest the one-entry map of the level in the levels map
+      fout << "\n  ";
+      for (const char c : saved.text)
+      {
+        fout << c;
+        if (c == '\n')
+          fout << "  ";
+      }
+      if (caching)
+        cache.append_encoded(saved.cache);
+    }
+    fout << "\n";
+    qCDebug(lc_io, "serialized %d of %zu levels",
+      num_serialized,
+      sorted_levels.size());
+    save_profile.add_count("levels", sorted_levels.size());
+    save_profile.add_count("levels serialized", num_serialized);
+
+    if (split_files)
+    {
+      qCDebug(lc_io, "wrote %d level files", num_files_written);
+      save_profile.add_count("level files written", num_files_written);
+    }
+  }
+
+  phase.start("sections");
+  YAML::Node lifts_node(YAML::NodeType::Map);
+  for (const auto& lift : lifts)
+    lifts_node[lift.name] = lift.to_yaml();
+  if (lifts.empty())
+    lifts_node.SetStyle(YAML::EmitterStyle::Flow);
+  write_section("lifts", lifts_node, true);
+
+  write_section("name", YAML::Node(name), false);
 
   if (!params.empty())
   {
     YAML::Node params_node(YAML::NodeType::Map);
     for (const auto& param : params)
       params_node[param.first] = param.second.to_yaml();
-    y["parameters"] = params_node;
+    write_section("parameters", params_node, false);
   }
 
-  YAML::Emitter emitter;
-  yaml_utils::write_node(y, emitter);
-  std::ofstream fout(filename);
-  if (!fout)
+  if (!reference_level_name.empty())
+    write_section(
+      "reference_level_name",
+      YAML::Node(reference_level_name),
+      false);
+
+  if (!traffic_maps.empty())
+  {
+    YAML::Node traffic_maps_node(YAML::NodeType::Map);
+    for (const auto& traffic_map : traffic_maps)
+      traffic_maps_node[traffic_map.name] = traffic_map.to_project_yaml();
+    write_section("traffic_maps", traffic_maps_node, false);
+  }
+
+  phase.start("commit");
+  fout.flush();
+  if (compression != CompressedStream::NONE && ok && fout &&
+    !compressing_buf.finish())
+  {
+    qCWarning(lc_io, "error compressing %s: %s",
+      path.c_str(),
+      compressing_buf.error().c_str());
+    file.cancelWriting();
+    discard_new_parts();
+    return false;
+  }
+  save_profile.add_count("bytes written", stream_buf.bytes_written());
+  if (compression != CompressedStream::NONE)
+    save_profile.add_count(
+      "bytes compressed",
+      static_cast<qint64>(compressing_buf.bytes_in()));
+  if (!ok || !fout)
   {
-    printf("unable to open %s\n", filename.c_str());
+    qCWarning(lc_io, "error writing %s: %s",
+      path.c_str(),
+      ok ? qUtf8Printable(file.errorString()) : "couldn't emit YAML");
+    file.cancelWriting();
+    discard_new_parts();
     return false;
   }
-  fout << emitter.c_str() << std::endl;
 
+  if (!file.commit())
+  {
+    qCWarning(lc_io, "unable to save %s: %s",
+      path.c_str(),
+      qUtf8Printable(file.errorString()));
+    discard_new_parts();
+    return false;
+  }
+
+  // the old files are only removed once the manifest which no longer
+  // refers to them is in place
+  if (split_files)
+    remove_stale_parts(part_dir, part_names);
+
+  // only write the cache once the file it describes is in place
+  if (caching)
+    cache.commit(stream_buf.hash());
+
+  _saved_content_hash = content_hash();
+  return true;
+}
+
+std::uint64_t Building::content_hash() const
+{
+  // only the levels edited since they were last hashed are hashed again;
+  // each one only writes its own cache, so they can be hashed in parallel
+  std::vector<const Level*> stale;
+  for (const auto& level : levels)
+  {
+    if (level.content_hashes_stale())
+      stale.push_back(&level);
+  }
+  if (stale.size() > 1)
+    TaskPool::instance().parallel_for(
+      static_cast<int>(stale.size()),
+      [&stale](int i) { stale[i]->content_hashes(); });
+
+  ContentHash::Builder hash;
+  hash.add(name);
+  hash.add(coordinate_system.to_string());
+  hash.add(reference_level_name);
+
+  // in the order save_to() writes them in
+  std::map<string, const Level*> sorted_levels;
+  for (const auto& level : levels)
+    sorted_levels[level.name] = &level;
+  hash.add(static_cast<std::uint64_t>(sorted_levels.size()));
+  for (const auto& it : sorted_levels)
+    hash.add(it.second->content_hashes().level);
+
+  hash.add(static_cast<std::uint64_t>(lifts.size()));
+  for (const auto& lift : lifts)
+  {
+    hash.add(lift.name);
+    hash.add(ContentHash::of(lift.to_yaml()));
+  }
+
+  hash.add(static_cast<std::uint64_t>(graphs.size()));
+  for (const auto& graph : graphs)
+  {
+    hash.add(graph.idx);
+    hash.add(ContentHash::of(graph.to_yaml()));
+  }
+
+  hash.add(static_cast<std::uint64_t>(traffic_maps.size()));
+  for (const auto& traffic_map : traffic_maps)
+  {
+    hash.add(traffic_map.name);
+    hash.add(ContentHash::of(traffic_map.to_project_yaml()));
+  }
+
+  hash.add(params);
+  hash.add(crowd_sim_impl != nullptr);
+  if (crowd_sim_impl)
+    hash.add(ContentHash::of(crowd_sim_impl->to_yaml()));
+  return hash.value();
+}
+
+bool Building::emit_entry(
+  const std::string& key,
+  const YAML::Node& value,
+  std::string& text)
+{
+  YAML::Emitter emitter;
+  emitter << YAML::BeginMap << YAML::Key << key << YAML::Value;
+  yaml_utils::write_node(value, emitter);
+  emitter << YAML::EndMap;
+  if (!emitter.good())
+  {
+    qCWarning(lc_io, "couldn't emit %s: %s",
+      key.c_str(),
+      emitter.GetLastError().c_str());
+    text.clear();
+    return false;
+  }
+  text = emitter.c_str();
   return true;
 }
 
+void Building::invalidate_saved_yaml()
+{
+  for (Level& level : levels)
+    level.invalidate_saved_yaml();
+}
+
 bool Building::export_features(
   int level_index,
   const std::string& dest_filename) const
@@ -231,6 +1037,76 @@ bool Building::export_features(
   return levels[level_index].export_features(dest_filename);
 }
 
+bool Building::export_all_features(
+  const std::string& path_prefix,
+  const std::string& suffix,
+  std::vector<std::string>* written,
+  TaskProgress* progress) const
+{
+  struct Job
+  {
+    const Level* level = nullptr;
+    string path;
+    bool ok = false;
+  };
+  vector<Job> jobs(levels.size());
+  for (std::size_t i = 0; i < levels.size(); i++)
+  {
+    jobs[i].level = &levels[i];
+    jobs[i].path = path_prefix + levels[i].name + "_features" + suffix;
+  }
+
+  TaskPool::instance().parallel_for(
+    static_cast<int>(jobs.size()),
+    [&jobs](int i)
+    {
+      jobs[i].ok = jobs[i].level->export_features(jobs[i].path);
+    },
+    TaskPool::INHERIT,
+    progress);
+  if (progress && progress->canceled())
+    return false;
+
+  bool ok = true;
+  for (const Job& job : jobs)
+  {
+    if (!job.ok)
+      ok = false;
+    else if (written)
+      written->push_back(job.path);
+  }
+  return ok;
+}
+
+bool Building::export_nav_graphs(
+  const std::string& dir,
+  std::vector<std::string>* written)
+{
+  return NavGraphExporter::export_graphs(*this, dir, written);
+}
+
+bool Building::export_occupancy_grids(
+  const std::string& dir,
+  const double resolution,
+  std::vector<std::string>* written)
+{
+  OccupancyGridExporter::Options options;
+  options.resolution = resolution;
+  return OccupancyGridExporter::export_grids(*this, dir, options, written);
+}
+
+std::vector<std::string> Building::sanity_check() const
+{
+  BuildingValidator validator;
+  std::vector<std::string> problems;
+  for (const BuildingValidator::Issue& issue : validator.run(*this))
+  {
+    if (issue.severity == BuildingValidator::ERROR)
+      problems.push_back(issue.message);
+  }
+  return problems;
+}
+
 void Building::add_vertex(int level_index, double x, double y)
 {
   if (level_index >= static_cast<int>(levels.size()))
@@ -249,8 +1125,10 @@ QUuid Building::add_fiducial(int level_index, double x, double y)
 {
   if (level_index >= static_cast<int>(levels.size()))
     return NULL;
-  levels[level_index].fiducials.push_back(Fiducial(x, y));
-  return levels[level_index].fiducials.rbegin()->uuid;
+  Level& level = levels[level_index];
+  level.fiducials.push_back(Fiducial(x, y));
+  level.mark_changed(Level::FIDUCIAL, level.fiducials.size() - 1);
+  return level.fiducials.rbegin()->uuid;
 }
 
 QUuid Building::add_feature(
@@ -281,22 +1159,7 @@ int Building::find_nearest_vertex_index(
   double y,
   double& distance)
 {
-  double min_dist = 1e100;
-  int min_index = -1;
-  for (std::size_t i = 0; i < levels[level_index].vertices.size(); i++)
-  {
-    const Vertex& v = levels[level_index].vertices[i];
-    const double dx = x - v.x;
-    const double dy = y - v.y;
-    const double dist2 = dx*dx + dy*dy;  // no need for sqrt each time
-    if (dist2 < min_dist)
-    {
-      min_dist = dist2;
-      min_index = i;
-    }
-  }
-  distance = sqrt(min_dist);
-  return min_index;  // will be -1 if vertices vector is empty
+  return levels[level_index].nearest_vertex_index(x, y, distance);
 }
 
 void Building::add_edge(
@@ -308,14 +1171,15 @@ void Building::add_edge(
   if (level_index >= static_cast<int>(levels.size()))
     return;
 
-  printf("Building::add_edge(%d, %d, %d, %d)\n",
+  qCDebug(lc_edit, "Building::add_edge(%d, %d, %d, %d)",
     level_index,
     start_vertex_index,
     end_vertex_index,
     static_cast<int>(edge_type));
 
-  levels[level_index].edges.push_back(
-    Edge(start_vertex_index, end_vertex_index, edge_type));
+  Level& level = levels[level_index];
+  level.edges.push_back(Edge(start_vertex_index, end_vertex_index, edge_type));
+  level.mark_changed(Level::EDGE, level.edges.size() - 1);
 }
 
 void Building::add_lane(
@@ -327,14 +1191,16 @@ void Building::add_lane(
   if (level_index >= static_cast<int>(levels.size()))
     return;
 
-  printf("Building::add_lane(%d, %d, %d, graph=%d)\n",
+  qCDebug(lc_edit, "Building::add_lane(%d, %d, %d, graph=%d)",
     level_index,
     start_vertex_index,
     end_vertex_index,
     graph_idx);
   Edge e(start_vertex_index, end_vertex_index, Edge::LANE);
   e.set_graph_idx(graph_idx);
-  levels[level_index].edges.push_back(e);
+  Level& level = levels[level_index];
+  level.edges.push_back(std::move(e));
+  level.mark_changed(Level::EDGE, level.edges.size() - 1);
 }
 
 bool Building::delete_selected(const int level_index)
@@ -359,7 +1225,7 @@ QUuid Building::add_model(
   if (level_idx >= static_cast<int>(levels.size()))
     return NULL;
 
-  printf("Building::add_model(%d, %.1f, %.1f, %.1f, %.2f, %s)\n",
+  qCDebug(lc_edit, "Building::add_model(%d, %.1f, %.1f, %.1f, %.2f, %s)",
     level_idx, x, y, z, yaw, model_name.c_str());
   Model m;
   m.state.x = x;
@@ -369,8 +1235,10 @@ QUuid Building::add_model(
   m.model_name = model_name;
   m.instance_name = model_name;  // todo: add unique numeric suffix?
   m.is_static = true;
-  levels[level_idx].models.push_back(m);
-  return levels[level_idx].models.rbegin()->uuid;
+  Level& level = levels[level_idx];
+  level.models.push_back(m);
+  level.mark_changed(Level::MODEL, level.models.size() - 1);
+  return level.models.rbegin()->uuid;
 }
 
 void Building::set_model_yaw(
@@ -382,6 +1250,7 @@ void Building::set_model_yaw(
     return;
 
   levels[level_idx].models[model_idx].state.yaw = yaw;
+  levels[level_idx].mark_changed(Level::MODEL, model_idx);
 }
 
 void Building::clear()
@@ -389,69 +1258,255 @@ void Building::clear()
   name.clear();
   filename.clear();
   reference_level_name.clear();
+  _saved_content_hash = 0;
   levels.clear();
+  level_idxs.clear();
   lifts.clear();
+  traffic_maps.clear();
+  invalidate_lift_graphics();
   clear_transform_cache();
+  Heap::release_free_memory();
 }
 
-void Building::add_level(const Level& new_level)
+void Building::swap(Building& other)
+{
+  using std::swap;
+  swap(name, other.name);
+  swap(reference_level_name, other.reference_level_name);
+  swap(levels, other.levels);
+  swap(lifts, other.lifts);
+  swap(graphs, other.graphs);
+  swap(traffic_maps, other.traffic_maps);
+  swap(params, other.params);
+  swap(coordinate_system, other.coordinate_system);
+  swap(crowd_sim_impl, other.crowd_sim_impl);
+  swap(split_files, other.split_files);
+  swap(use_cache, other.use_cache);
+  swap(stream_parser, other.stream_parser);
+  swap(lazy_images, other.lazy_images);
+  swap(drawing_preview_size, other.drawing_preview_size);
+  swap(load_profile, other.load_profile);
+  swap(save_profile, other.save_profile);
+  swap(filename, other.filename);
+  swap(level_transforms, other.level_transforms);
+  swap(level_idxs, other.level_idxs);
+  swap(reference_fiducials, other.reference_fiducials);
+  swap(reference_fiducials_level_idx, other.reference_fiducials_level_idx);
+  swap(reference_fiducials_version, other.reference_fiducials_version);
+  swap(lift_graphics, other.lift_graphics);
+  swap(lift_tables_valid, other.lift_tables_valid);
+  swap(_lifts_revision, other._lifts_revision);
+  swap(_saved_content_hash, other._saved_content_hash);
+  swap(lift_tables_levels, other.lift_tables_levels);
+}
+
+void Building::add_level(Level new_level)
 {
   // make sure we don't have this level already
-  for (const auto& level : levels)
+  if (find_level_idx(new_level.name) >= 0)
+    return;
+  levels.push_back(std::move(new_level));
+  level_idxs[levels.back().name] = static_cast<int>(levels.size()) - 1;
+}
+
+int Building::duplicate_level(
+  const int level_idx,
+  const std::string& new_name)
+{
+  if (level_idx < 0 || level_idx >= static_cast<int>(levels.size()) ||
+    new_name.empty() || find_level_idx(new_name) >= 0)
+    return -1;
+
+  Level copy(levels[level_idx]);
+  copy.name = new_name;
+  copy.clear_scene();  // the items belong to the original's scene
+  copy.clear_selection();
+  for (Vertex& v : copy.vertices)
+    v.uuid = QUuid::createUuid();
+  for (Model& model : copy.models)
   {
-    if (level.name == new_level.name)
-      return;
+    model.uuid = QUuid::createUuid();
+    model.state.level_name = new_name;
+    model.starting_level = new_name;
   }
-  levels.push_back(new_level);
+  copy.mark_all_changed();
+
+  add_level(std::move(copy));
+  return static_cast<int>(levels.size()) - 1;
+}
+
+int Building::find_level_idx(const std::string& level_name) const
+{
+  auto it = level_idxs.find(level_name);
+  if (it != level_idxs.end() &&
+    it->second < static_cast<int>(levels.size()) &&
+    levels[it->second].name == level_name)
+    return it->second;
+
+  // stale or missing: rebuild. The first level of each name wins, as the
+  // linear searches this replaces did.
+  level_idxs.clear();
+  for (int i = static_cast<int>(levels.size()) - 1; i >= 0; i--)
+    level_idxs[levels[i].name] = i;
+  it = level_idxs.find(level_name);
+  return it == level_idxs.end() ? -1 : it->second;
+}
+
+int Building::find_level_idx(
+  const std::string& level_name,
+  int& resolved_idx) const
+{
+  if (resolved_idx < 0 ||
+    resolved_idx >= static_cast<int>(levels.size()) ||
+    levels[resolved_idx].name != level_name)
+    resolved_idx = find_level_idx(level_name);
+  return resolved_idx;
 }
 
 void Building::draw_lifts(QGraphicsScene* scene, const int level_idx)
+{
+  compile_lifts();
+  for (std::size_t lift_idx = 0; lift_idx < lifts.size(); lift_idx++)
+    draw_lift(scene, lift_idx, level_idx);
+}
+
+void Building::draw_lift(
+  QGraphicsScene* scene,
+  const std::size_t lift_idx,
+  const int level_idx)
 {
   const Level& level = levels[level_idx];
-  for (const auto& lift : lifts)
+  Lift& lift = lifts[lift_idx];
+  const int reference_floor_idx =
+    find_level_idx(lift.reference_floor_name, lift.reference_floor_idx);
+
+  Transform t;
+  if (reference_floor_idx >= 0)
+    t = get_transform(reference_floor_idx, level_idx);
+
+  // lifts rarely change, so reuse the items from the last draw unless
+  // the level itself has changed since
+  LiftGraphics& graphics = lift_graphics[std::make_pair(lift_idx, level_idx)];
+  if (graphics.group && !graphics.in_scene &&
+    graphics.level_name == level.name &&
+    graphics.elevation == level.elevation &&
+    graphics.meters_per_pixel == level.drawing_meters_per_pixel &&
+    graphics.transform.scale == t.scale &&
+    graphics.transform.dx == t.dx &&
+    graphics.transform.dy == t.dy)
+  {
+    scene->addItem(graphics.group);
+    graphics.in_scene = true;
+    return;
+  }
+
+  if (!graphics.in_scene)
+    delete graphics.group;
+  graphics.group = lift.draw(
+    scene,
+    level.drawing_meters_per_pixel,
+    level_idx,
+    level.elevation,
+    true,
+    t.scale,
+    t.dx,
+    t.dy);
+  graphics.in_scene = graphics.group != nullptr;
+  graphics.level_name = level.name;
+  graphics.elevation = level.elevation;
+  graphics.meters_per_pixel = level.drawing_meters_per_pixel;
+  graphics.transform = t;
+}
+
+void Building::redraw_lift(
+  QGraphicsScene* scene,
+  const std::size_t lift_idx,
+  const int level_idx)
+{
+  if (lift_idx >= lifts.size())
+    return;
+  _lifts_revision++;
+
+  // the other lifts keep their cached graphics
+  for (auto it = lift_graphics.begin(); it != lift_graphics.end(); )
   {
-    // find the level index referenced by the lift
-    int reference_floor_idx = -1;
-    for (std::size_t i = 0; i < levels.size(); i++)
+    if (it->first.first != lift_idx)
     {
-      if (levels[i].name == lift.reference_floor_name)
-      {
-        reference_floor_idx = static_cast<int>(i);
-        break;
-      }
+      ++it;
+      continue;
     }
+    LiftGraphics& graphics = it->second;
+    if (graphics.group && graphics.in_scene)
+      graphics.group->scene()->removeItem(graphics.group);
+    delete graphics.group;
+    it = lift_graphics.erase(it);
+  }
+
+  compile_lifts();
+  lifts[lift_idx].compile(levels);
+  if (level_idx >= 0 && level_idx < static_cast<int>(levels.size()))
+    draw_lift(scene, lift_idx, level_idx);
+}
 
-    Transform t;
-    if (reference_floor_idx >= 0)
-      t = get_transform(reference_floor_idx, level_idx);
+void Building::detach_cached_items(QGraphicsScene* scene)
+{
+  // the retained level items go to the pool, for the next draw to reuse
+  for (Level& level : levels)
+    level.recycle_scene_items(scene);
 
-    lift.draw(
-      scene,
-      level.drawing_meters_per_pixel,
-      level.name,
-      level.elevation,
-      true,
-      t.scale,
-      t.dx,
-      t.dy);
+  for (auto& it : lift_graphics)
+  {
+    LiftGraphics& graphics = it.second;
+    if (graphics.group && graphics.in_scene &&
+      graphics.group->scene() == scene)
+    {
+      scene->removeItem(graphics.group);
+      graphics.in_scene = false;
+    }
   }
 }
 
+void Building::compile_lifts()
+{
+  bool valid = lift_tables_valid && lift_tables_levels.size() == levels.size();
+  for (std::size_t i = 0; valid && i < levels.size(); i++)
+  {
+    valid = lift_tables_levels[i].first == levels[i].name &&
+      lift_tables_levels[i].second == levels[i].elevation;
+  }
+  if (valid)
+    return;
+
+  for (Lift& lift : lifts)
+    lift.compile(levels);
+  lift_tables_levels.clear();
+  for (const Level& level : levels)
+    lift_tables_levels.push_back(std::make_pair(level.name, level.elevation));
+  lift_tables_valid = true;
+}
+
+void Building::invalidate_lift_graphics()
+{
+  lift_tables_valid = false;
+  _lifts_revision++;
+
+  // groups still in a scene will be deleted by it
+  for (auto& it : lift_graphics)
+  {
+    if (!it.second.in_scene)
+      delete it.second.group;
+  }
+  lift_graphics.clear();
+}
+
 bool Building::transform_between_levels(
   const std::string& from_level_name,
   const QPointF& from_point,
   const std::string& to_level_name,
   QPointF& to_point)
 {
-  int from_level_idx = -1;
-  int to_level_idx = -1;
-  for (std::size_t i = 0; i < levels.size(); i++)
-  {
-    if (levels[i].name == from_level_name)
-      from_level_idx = i;
-    if (levels[i].name == to_level_name)
-      to_level_idx = i;
-  }
+  const int from_level_idx = find_level_idx(from_level_name);
+  const int to_level_idx = find_level_idx(to_level_name);
   if (from_level_idx < 0 || to_level_idx < 0)
   {
     to_point = from_point;
@@ -489,84 +1544,224 @@ bool Building::transform_between_levels(
 
 void Building::clear_transform_cache()
 {
-  transforms.clear();
+  level_transforms.clear();
+  reference_fiducials.clear();
+  reference_fiducials_level_idx = -1;
 }
 
-Building::Transform Building::compute_transform(
-  const int from_level_idx,
-  const int to_level_idx)
+Building::FiducialsVersion Building::fiducials_version(const Level& level)
 {
-  // short-circuit if it's the same level
-  if (from_level_idx == to_level_idx)
+  FiducialsVersion version;
+  version.revision = level.fiducials_revision();
+  version.count = level.fiducials.size();
+  return version;
+}
+
+Building::Transform Building::get_transform_to_reference(const int level_idx)
+{
+  const int ref_idx = get_reference_level_idx();
+  if (level_idx == ref_idx ||
+    level_idx < 0 ||
+    level_idx >= static_cast<int>(levels.size()))
+    return Transform();
+
+  if (!joint_alignment())
+    return fit_to_reference(level_idx);
+  fit_levels_jointly();
+  return level_transforms[level_idx].to_reference;
+}
+
+bool Building::joint_alignment() const
+{
+  auto it = params.find("joint_alignment");
+  return it != params.end() &&
+    it->second.type == Param::BOOL &&
+    it->second.value_bool;
+}
+
+void Building::set_joint_alignment(const bool enabled)
+{
+  if (enabled == joint_alignment())
+    return;
+  if (enabled)
+    params["joint_alignment"] = Param(true);
+  else
+    params.erase("joint_alignment");
+  level_transforms.clear();
+}
+
+void Building::fit_levels_jointly()
+{
+  const int ref_idx = get_reference_level_idx();
+  if (level_transforms.size() != levels.size())
+    level_transforms.resize(levels.size());
+  const Level& ref_level = levels[ref_idx];
+  const FiducialsVersion ref_version = fiducials_version(ref_level);
+  bool stale = false;
+  for (std::size_t i = 0; i < levels.size() && !stale; i++)
   {
-    Building::Transform t;
-    t.scale = 1.0;
-    t.dx = 0.0;
-    t.dy = 0.0;
-    return t;
+    const LevelTransform& cached = level_transforms[i];
+    stale = static_cast<int>(i) != ref_idx &&
+      (!cached.valid ||
+      !cached.joint ||
+      !(cached.level_version == fiducials_version(levels[i])) ||
+      !(cached.reference_version == ref_version) ||
+      cached.reference_meters_per_pixel != ref_level.drawing_meters_per_pixel);
   }
+  if (!stale)
+    return;
 
-  // this internal function assumes that bounds checking has already happened
-  const Level& from_level = levels[from_level_idx];
-  const Level& to_level = levels[to_level_idx];
-
-  // assemble a vector of fudicials in common to these levels
-  vector<std::pair<Fiducial, Fiducial>> fiducials;
-  for (const Fiducial& f0 : from_level.fiducials)
+  // each level's own fit is where the joint fit starts
+  std::vector<Transform> initial(levels.size());
+  for (std::size_t i = 0; i < levels.size(); i++)
+  {
+    if (static_cast<int>(i) != ref_idx)
+      initial[i] = fit_to_reference(static_cast<int>(i));
+  }
+  JointAlignment::Problem problem =
+    JointAlignment::make_problem(*this, initial, false);
+  problem.inlier_meters = ALIGNMENT_INLIER_METERS;
+  // only the levels: a few parameters each, which one thread solves
+  const JointAlignment::Solution solution = JointAlignment::solve(problem);
+  qCDebug(lc_transform, "joint alignment: %s", solution.summary.c_str());
+
+  // the report of each level is the furthest its fiducials are from
+  // those of the same name on any other level
+  std::vector<std::map<std::string, double>> furthest(levels.size());
+  for (const JointAlignment::Residual& residual : solution.residuals)
   {
-    for (const Fiducial& f1 : to_level.fiducials)
+    for (const int i : {residual.level_idx, residual.other_idx})
     {
-      if (f0.name == f1.name)
-      {
-        fiducials.push_back(make_pair(f0, f1));
-        break;
-      }
+      double& meters = furthest[i][residual.name];
+      meters = std::max(meters, residual.meters);
     }
   }
-
-  // calculate the distances between each fiducial on their levels
-  vector<std::pair<double, double>> distances;
-  for (std::size_t f0_idx = 0; f0_idx < fiducials.size(); f0_idx++)
+  for (std::size_t i = 0; i < levels.size(); i++)
   {
-    for (std::size_t f1_idx = f0_idx + 1; f1_idx < fiducials.size(); f1_idx++)
+    if (static_cast<int>(i) == ref_idx)
+      continue;
+    LevelTransform& cached = level_transforms[i];
+    cached.joint = true;
+    if (!solution.solved)
+      continue;
+    cached.to_reference = solution.level_transforms[i];
+    cached.report.residuals.clear();
+    for (const Fiducial& f : levels[i].fiducials)
     {
-      distances.push_back(
-        make_pair(
-          fiducials[f0_idx].first.distance(fiducials[f1_idx].first),
-          fiducials[f0_idx].second.distance(fiducials[f1_idx].second)));
+      auto it = furthest[i].find(f.name);
+      if (it == furthest[i].end())
+        continue;
+      AlignmentReport::Residual residual;
+      residual.name = f.name;
+      residual.meters = it->second;
+      residual.inlier = it->second <= ALIGNMENT_INLIER_METERS;
+      cached.report.residuals.push_back(residual);
+      furthest[i].erase(it);  // only the first of each name
     }
   }
+}
 
-  if (distances.empty())
-    return Building::Transform();
+Building::Transform Building::fit_to_reference(const int level_idx)
+{
+  const int ref_idx = get_reference_level_idx();
+  const Level& ref_level = levels[ref_idx];
+  const FiducialsVersion ref_version = fiducials_version(ref_level);
+  if (reference_fiducials_level_idx != ref_idx ||
+    !(reference_fiducials_version == ref_version))
+  {
+    // the first fiducial of each name is the one which is matched
+    reference_fiducials.clear();
+    for (std::size_t i = 0; i < ref_level.fiducials.size(); i++)
+      reference_fiducials.emplace(ref_level.fiducials[i].name, i);
+    reference_fiducials_level_idx = ref_idx;
+    reference_fiducials_version = ref_version;
+  }
 
-  // for now, we'll just compute the mean of the relative scale estimates.
-  // we can do fancier statistics later, if needed.
-  double relative_scale_sum = 0;
-  for (std::size_t i = 0; i < distances.size(); i++)
-    relative_scale_sum += distances[i].second / distances[i].first;
-  const double scale = relative_scale_sum / distances.size();
+  if (level_transforms.size() != levels.size())
+    level_transforms.resize(levels.size());
+  LevelTransform& cached = level_transforms[level_idx];
+  const Level& level = levels[level_idx];
+  const FiducialsVersion level_version = fiducials_version(level);
+  if (cached.valid &&
+    !cached.joint &&
+    cached.level_version == level_version &&
+    cached.reference_version == ref_version &&
+    cached.reference_meters_per_pixel == ref_level.drawing_meters_per_pixel)
+    return cached.to_reference;
+
+  cached.valid = true;
+  cached.level_version = level_version;
+  cached.reference_version = ref_version;
+  cached.reference_meters_per_pixel = ref_level.drawing_meters_per_pixel;
+  cached.joint = false;
+  cached.to_reference = Transform();
+  cached.report = AlignmentReport();
+
+  // the fiducials in common with the reference level
+  vector<QPointF> from;
+  vector<QPointF> to;
+  for (const Fiducial& f : level.fiducials)
+  {
+    const auto it = reference_fiducials.find(f.name);
+    if (it == reference_fiducials.end())
+      continue;
+    const Fiducial& ref_f = ref_level.fiducials[it->second];
+    from.push_back(QPointF(f.x, f.y));
+    to.push_back(QPointF(ref_f.x, ref_f.y));
+    AlignmentReport::Residual residual;
+    residual.name = f.name;
+    cached.report.residuals.push_back(residual);
+  }
 
-  // scale the fiducials and estimate the "optimal" translation.
-  // for now, we'll just use the mean of the translation estimates.
-  double trans_x_sum = 0;
-  double trans_y_sum = 0;
-  for (const auto& fiducial : fiducials)
+  const double ref_meters_per_pixel =
+    ref_level.drawing_meters_per_pixel > 0.0 ?
+    ref_level.drawing_meters_per_pixel : 1.0;
+  const FiducialAlignment::Fit fit = FiducialAlignment::fit_robust(
+    from,
+    to,
+    false,
+    ALIGNMENT_INLIER_METERS / ref_meters_per_pixel);
+  if (!fit.valid)
   {
-    trans_x_sum += fiducial.second.x - fiducial.first.x * scale;
-    trans_y_sum += fiducial.second.y - fiducial.first.y * scale;
+    cached.report.residuals.clear();
+    return cached.to_reference;
   }
-  const double trans_x = trans_x_sum / fiducials.size();
-  const double trans_y = trans_y_sum / fiducials.size();
 
-  Building::Transform t;
-  t.scale = scale;
-  t.dx = trans_x;
-  t.dy = trans_y;
+  for (std::size_t i = 0; i < cached.report.residuals.size(); i++)
+  {
+    AlignmentReport::Residual& residual = cached.report.residuals[i];
+    residual.meters = fit.residuals[i] * ref_meters_per_pixel;
+    residual.inlier = fit.inliers[i];
+    if (!residual.inlier)
+      qCWarning(lc_transform, "level %s fiducial %s is %.2f m off; ignoring it",
+        level.name.c_str(),
+        residual.name.c_str(),
+        residual.meters);
+  }
 
-  printf("transform %d->%d: scale = %.5f translation = (%.2f, %.2f)\n",
-    from_level_idx,
-    to_level_idx,
+  // the same inliers, allowed to rotate
+  vector<QPointF> from_inliers;
+  vector<QPointF> to_inliers;
+  for (std::size_t i = 0; i < from.size(); i++)
+  {
+    if (fit.inliers[i])
+    {
+      from_inliers.push_back(from[i]);
+      to_inliers.push_back(to[i]);
+    }
+  }
+  cached.report.yaw =
+    FiducialAlignment::fit(from_inliers, to_inliers, true).yaw;
+
+  Transform& t = cached.to_reference;
+  t.scale = fit.scale;
+  t.dx = fit.dx;
+  t.dy = fit.dy;
+
+  qCDebug(lc_transform,
+    "transform %d->%d: scale = %.5f translation = (%.2f, %.2f)",
+    level_idx,
+    ref_idx,
     t.scale,
     t.dx,
     t.dy);
@@ -574,28 +1769,33 @@ Building::Transform Building::compute_transform(
   return t;
 }
 
+const Building::AlignmentReport& Building::get_alignment_report(
+  const int level_idx)
+{
+  static const AlignmentReport empty;
+  get_transform_to_reference(level_idx);  // brings the cache up to date
+  if (level_idx == get_reference_level_idx() ||
+    level_idx < 0 ||
+    level_idx >= static_cast<int>(level_transforms.size()))
+    return empty;
+  return level_transforms[level_idx].report;
+}
+
 Building::Transform Building::get_transform(
   const int from_level_idx,
   const int to_level_idx)
 {
-  // this operation is a bit "heavy" so we'll cache the transformations
-  // as they are computed
-  LevelPair level_pair;
-  level_pair.from_idx = from_level_idx;
-  level_pair.to_idx = to_level_idx;
+  // short-circuit if it's the same level
+  if (from_level_idx == to_level_idx)
+    return Transform();
 
-  TransformMap::iterator transform_it = transforms.find(level_pair);
+  // p_ref = from.scale * p + from.d, and p_ref = to.scale * p_to + to.d
+  const Transform from = get_transform_to_reference(from_level_idx);
+  const Transform to = get_transform_to_reference(to_level_idx);
   Transform t;
-
-  if (transform_it == transforms.end())
-  {
-    // the transform wasn't in the cache, so we need to compute it
-    t = compute_transform(from_level_idx, to_level_idx);
-    transforms[level_pair] = t;
-  }
-  else
-    t = transform_it->second;
-
+  t.scale = from.scale / to.scale;
+  t.dx = (from.dx - to.dx) / to.scale;
+  t.dy = (from.dy - to.dy) / to.scale;
   return t;
 }
 
@@ -604,25 +1804,16 @@ void Building::calculate_all_transforms()
   if (levels.empty())
     return;// let's not crash
 
-  clear_transform_cache();
-  for (std::size_t i = 0; i < levels.size(); i++)
-  {
-    for (std::size_t j = 0; j < levels.size(); j++)
-    {
-      get_transform(i, j);
-    }
-  }
-
   // set drawing scale using this data
   const int ref_idx = get_reference_level_idx();
   const double ref_scale = levels[ref_idx].drawing_meters_per_pixel;
   for (int i = 0; i < static_cast<int>(levels.size()); i++)
   {
-    if (i != get_reference_level_idx())
+    if (i != ref_idx)
     {
-      Transform t = get_transform(ref_idx, i);
+      const Transform t = get_transform_to_reference(i);
       if (levels[i].fiducials.size() >= 2)
-        levels[i].drawing_meters_per_pixel = ref_scale / t.scale;
+        levels[i].drawing_meters_per_pixel = ref_scale * t.scale;
     }
   }
 }
@@ -631,63 +1822,75 @@ int Building::get_reference_level_idx()
 {
   if (reference_level_name.empty())
     return 0;
-  for (std::size_t i = 0; i < levels.size(); i++)
-  {
-    if (levels[i].name == reference_level_name)
-      return static_cast<int>(i);
-  }
-  return 0;
+  const int idx = find_level_idx(reference_level_name);
+  return idx >= 0 ? idx : 0;
 }
 
 void Building::clear_scene()
 {
   for (auto& level : levels)
     level.clear_scene();
-}
 
-double Building::level_meters_per_pixel(const string& level_name) const
-{
-  for (const auto& level : levels)
+  // whatever wasn't detached before the scene was cleared is gone now
+  for (auto it = lift_graphics.begin(); it != lift_graphics.end(); )
   {
-    if (level.name == level_name)
-      return level.drawing_meters_per_pixel;
+    if (it->second.in_scene)
+      it = lift_graphics.erase(it);
+    else
+      ++it;
   }
-  return 0.05;  // just a somewhat sane default
 }
 
-void Building::rotate_all_models(const double rotation)
+void Building::clear_scene(const int level_idx)
 {
-  for (auto& level : levels)
+  if (level_idx < 0 || level_idx >= static_cast<int>(levels.size()))
+    return;
+  levels[level_idx].clear_scene();
+
+  for (auto it = lift_graphics.begin(); it != lift_graphics.end(); )
   {
-    for (auto& model : level.models)
-    {
-      model.state.yaw += rotation;
-    }
+    if (it->second.in_scene && it->first.second == level_idx)
+      it = lift_graphics.erase(it);
+    else
+      ++it;
   }
 }
 
+double Building::level_meters_per_pixel(const string& level_name) const
+{
+  const int idx = find_level_idx(level_name);
+  if (idx >= 0)
+    return levels[idx].drawing_meters_per_pixel;
+  return 0.05;  // just a somewhat sane default
+}
+
 bool Building::set_filename(const std::string& _fn)
 {
   const string suffix(".building.yaml");
+  const string uncompressed = CompressedStream::without_extension(_fn);
 
   // ensure there is at least one character in addition to the suffix length
-  if (_fn.size() <= suffix.size())
+  if (uncompressed.size() <= suffix.size())
   {
-    printf("Building::set_filename() too short: [%s]\n", _fn.c_str());
+    qCWarning(lc_io, "Building::set_filename() too short: [%s]", _fn.c_str());
     return false;
   }
 
-  // ensure the filename ends in .building.yaml
-  // it should, because the "save as" dialog appends it, but...
-  if (_fn.compare(_fn.size() - suffix.size(), suffix.size(), suffix))
+  // ensure the filename ends in .building.yaml, maybe followed by .gz or
+  // .zst; it should, because the "save as" dialog appends it, but...
+  if (uncompressed.compare(
+      uncompressed.size() - suffix.size(),
+      suffix.size(),
+      suffix))
   {
-    printf(
-      "Building::set_filename() filename had unexpected suffix: [%s]\n",
+    qCWarning(lc_io,
+      "Building::set_filename() filename had unexpected suffix: [%s]",
       _fn.c_str());
     return false;
   }
 
-  const string no_suffix(_fn.substr(0, _fn.size() - suffix.size()));
+  const string no_suffix(
+    uncompressed.substr(0, uncompressed.size() - suffix.size()));
 
   const std::size_t last_slash_pos = no_suffix.rfind('/', no_suffix.size());
 
@@ -701,8 +1904,8 @@ bool Building::set_filename(const std::string& _fn)
   if (name.empty())
     name = stem;
 
-  printf(
-    "set building filename to [%s]\n",
+  qCDebug(lc_io,
+    "set building filename to [%s]",
     filename.c_str());
   return true;
 }
@@ -736,9 +1939,10 @@ void Building::draw(
   std::vector<EditorModel>& editor_models,
   const RenderingOptions& rendering_options)
 {
+  TRACE_ZONE("Building::draw");
   if (levels.empty())
   {
-    printf("nothing to draw!\n");
+    qCDebug(lc_draw, "nothing to draw!");
     return;
   }
 
@@ -752,6 +1956,42 @@ void Building::draw(
   draw_lifts(scene, level_idx);
 }
 
+bool Building::redraw_items(
+  QGraphicsScene* scene,
+  const int level_idx,
+  const std::vector<Level::SelectedItem>& items,
+  std::vector<EditorModel>& editor_models,
+  const RenderingOptions& rendering_options)
+{
+  if (level_idx < 0 || level_idx >= static_cast<int>(levels.size()))
+    return false;
+
+  return levels[level_idx].redraw_items(
+    scene,
+    items,
+    editor_models,
+    rendering_options,
+    graphs,
+    coordinate_system);
+}
+
+bool Building::stream_items(
+  QGraphicsScene* scene,
+  const int level_idx,
+  std::vector<EditorModel>& editor_models,
+  const RenderingOptions& rendering_options)
+{
+  if (level_idx < 0 || level_idx >= static_cast<int>(levels.size()))
+    return false;
+
+  return levels[level_idx].stream_items(
+    scene,
+    editor_models,
+    rendering_options,
+    graphs,
+    coordinate_system);
+}
+
 Polygon* Building::get_selected_polygon(const int level_idx)
 {
   for (std::size_t i = 0; i < levels[level_idx].polygons.size(); i++)
@@ -20,22 +20,27 @@
 
 
 class QGraphicsScene;
+class TaskProgress;
 
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <yaml-cpp/yaml.h>
 
 #include <QGraphicsLineItem>
 #include <QPointF>
+#include <QString>
 
 #include "coordinate_system.h"
 #include "graph.h"
+#include "io_profile.hpp"
 #include "level.h"
 #include "lift.h"
 #include "param.h"
 #include <traffic_editor/crowd_sim/crowd_sim_impl.h>
 #include "rendering_options.h"
+#include "traffic_map.h"
 
 class Building
 {
@@ -48,26 +53,120 @@ public:
   std::vector<Level> levels;
   std::vector<Lift> lifts;
   std::vector<Graph> graphs;
-  std::map<std::string, Param> params;
+  std::vector<TrafficMap> traffic_maps;  // external overlays
+  ParamMap params;
   CoordinateSystem coordinate_system;
 
   mutable crowd_sim::CrowdSimImplPtr crowd_sim_impl;
 
   bool set_filename(const std::string& _filename);
-  std::string get_filename() { return filename; }
+  std::string get_filename() const { return filename; }
 
   bool load(const std::string& filename);
   bool save();
+
+  /// Write the building to a file. The file is replaced atomically, so
+  /// it is either left as it was or completely written. With write_cache,
+  /// the BuildingCache sidecar of the file is written too.
+  bool save_to(const std::string& path, const bool write_cache = false) const;
+
+  /// Forget the serialized text of every level, after a change that
+  /// affects all of them (or that can't tell which one it affected)
+  void invalidate_saved_yaml();
+
+  /// Save the levels, lifts, graphs and crowd_sim sections each into a
+  /// file of its own, in a directory named after the building file
+  /// (foo.building.yaml keeps them in foo.building.d), and write only their
+  /// file names into the building file. Only the files of the levels which
+  /// changed are rewritten, and then under new names, so that the building
+  /// file on disk stays loadable until the new one is in place; only then
+  /// are the files it no longer refers to removed. load() reads either
+  /// layout, and sets this if the building was split.
+  bool split_files = false;
+
+  /// The directory of the sections of a split building saved to this path
+  static QString split_dir(const std::string& path);
+
+  /// Keep a BuildingCache sidecar beside the building file, which load()
+  /// reads instead of parsing the YAML whenever it is up to date
+  bool use_cache = false;
+
+  /// Have load() build the vertices, edges and polygons of the levels with
+  /// BuildingStreamParser rather than through a YAML::Node tree, falling
+  /// back to yaml-cpp for files it doesn't understand. Ignored if
+  /// use_cache is set, since the cache keeps the whole YAML tree.
+  bool stream_parser = false;
+
+  /// Have load() read only the size of each drawing, leaving the decoding
+  /// of the drawing and layer images to Level::load_images() when the
+  /// level is first shown
+  bool lazy_images = false;
+
+  /// Passed to Level::load_drawing(): drawings bigger than this are
+  /// decoded as downscaled previews, if nonzero
+  int drawing_preview_size = 0;
+
+  /// Where the time of the last load() and save_to() went
+  IoProfile load_profile;
+  mutable IoProfile save_profile;
+
+  /// A copy of the building's data, but not its graphics, which can be
+  /// written by save_to() on another thread while editing continues.
+  std::shared_ptr<Building> snapshot() const;
   void clear();  // clear all internal data structures
 
+  /// Exchange everything, including the cached graphics, with another
+  /// building. Cheap: nothing is copied. The cached graphics must not be
+  /// in a scene, so detach_cached_items() and clear_scene() come first.
+  void swap(Building& other);
+
   bool export_features(
     int level_index,
     const std::string& dest_filename) const;
 
+  /// Export the features of every level at once, one level per thread,
+  /// each into <path_prefix><level name>_features<suffix>. The suffix,
+  /// ".yaml" or ".csv", picks the format (see Level::export_features()).
+  /// Returns false if any of the files couldn't be written; the paths of
+  /// those which were are appended to written, if given. The levels
+  /// left when progress is canceled are skipped, and false is returned.
+  bool export_all_features(
+    const std::string& path_prefix,
+    const std::string& suffix,
+    std::vector<std::string>* written = nullptr,
+    TaskProgress* progress = nullptr) const;
+
+  /// Write the YAML and binary nav graph files of every graph with lanes
+  /// into dir; see NavGraphExporter
+  bool export_nav_graphs(
+    const std::string& dir,
+    std::vector<std::string>* written = nullptr);
+
+  /// Write a PGM and YAML occupancy grid of every level with walls, doors
+  /// or floors into dir, at this many meters per cell; see
+  /// OccupancyGridExporter
+  bool export_occupancy_grids(
+    const std::string& dir,
+    const double resolution,
+    std::vector<std::string>* written = nullptr);
+
+  /// Problems which would lose data on a save and reload, or which make
+  /// the building unusable downstream, as human-readable messages. Empty
+  /// if everything is fine. These are the errors of BuildingValidator,
+  /// which also reports the warnings.
+  std::vector<std::string> sanity_check() const;
+
   void clear_selection(const int level_idx);
   bool can_delete_current_selection(const int level_idx);
 
-  void add_level(const Level& level);
+  /// Taken by value, so that a level which is no longer needed can be
+  /// moved in rather than copied
+  void add_level(Level level);
+
+  /// Append a copy of a level under a new name, with nothing selected and
+  /// new uuids for its vertices and models. Returns the index of the copy,
+  /// or -1 if there is no such level or the name is taken.
+  int duplicate_level(const int level_idx, const std::string& new_name);
 
   void add_vertex(int level_index, double x, double y);
   void add_tag(int level_index, double x, double y);
@@ -117,6 +216,50 @@ public:
 
   void draw_lifts(QGraphicsScene* scene, const int level_idx);
 
+  /// Take the cached lift graphics out of the scene before it is cleared,
+  /// so that the next draw_lifts() can put them back instead of rebuilding.
+  /// Those in the scenes of other levels stay where they are. The items
+  /// of the levels drawn in the scene are given to the SceneItemPool, so
+  /// their next draw reuses them instead of allocating them again.
+  void detach_cached_items(QGraphicsScene* scene);
+
+  /// The lifts were edited; rebuild their graphics in the next draw
+  void invalidate_lift_graphics();
+
+  /// Only this lift was edited: rebuild its graphics on the level in the
+  /// scene, and forget them on the others, leaving the other lifts as
+  /// they are
+  void redraw_lift(
+    QGraphicsScene* scene,
+    const std::size_t lift_idx,
+    const int level_idx);
+
+  /// Bumped by invalidate_lift_graphics()
+  std::size_t lifts_revision() const { return _lifts_revision; }
+
+  /// The hash of what save_to() would write (see ContentHash): of the
+  /// hashes of the levels, in the order they are saved in, and of the
+  /// rest. Only the levels edited since they were last hashed are hashed
+  /// again, in parallel.
+  std::uint64_t content_hash() const;
+
+  /// content_hash() as of the last load() or save_to(), or 0
+  std::uint64_t saved_content_hash() const { return _saved_content_hash; }
+
+  /// Bring the tables of every lift (see Lift::compile()) up to date, if
+  /// the lifts were invalidated or the levels renamed, moved or added
+  void compile_lifts();
+
+  /// Index of the level with this name, or -1. The name index behind it is
+  /// rebuilt whenever it turns out to be stale (a level was added or
+  /// renamed), so nothing else has to keep it current.
+  int find_level_idx(const std::string& level_name) const;
+
+  /// Like find_level_idx(), for callers which keep the index they resolved
+  /// last time, such as Lift::reference_floor_idx. That is checked first,
+  /// and updated if it no longer names the level.
+  int find_level_idx(const std::string& level_name, int& resolved_idx) const;
+
   bool transform_between_levels(
     const std::string& from_level_name,
     const QPointF& from_point,
@@ -131,17 +274,6 @@ public:
 
   void clear_transform_cache();
 
-  struct LevelPair
-  {
-    int from_idx = -1;
-    int to_idx = -1;
-
-    bool operator<(const LevelPair& rhs) const
-    {
-      return std::tie(from_idx, to_idx) < std::tie(rhs.from_idx, rhs.to_idx);
-    }
-  };
-
   // to apply transform: first scale, then translate
   struct Transform
   {
@@ -149,26 +281,56 @@ public:
     double dx = 0.0;
     double dy = 0.0;
   };
-  typedef std::map<LevelPair, Transform> TransformMap;
-  TransformMap transforms;
-
-  Transform compute_transform(
-    const int from_level_idx,
-    const int to_level_idx);
 
+  /// From pixels of one level to pixels of another, through the reference
+  /// level: each level is fitted to the reference level's fiducials once,
+  /// and refitted only when its fiducials (or the reference's) change
   Transform get_transform(
     const int from_level_idx,
     const int to_level_idx);
 
+  /// From pixels of this level to pixels of the reference level. It is a
+  /// least-squares fit to the fiducials which they have in common, after
+  /// rejecting any which disagree with the others (see FiducialAlignment),
+  /// or with joint_alignment(), the fit of every level at once
+  Transform get_transform_to_reference(const int level_idx);
+
+  /// Whether the levels are fitted to the fiducials of all the other
+  /// levels together (see JointAlignment), rather than each to those of the
+  /// reference level alone. It is kept in the building params, and
+  /// changing it refits every level.
+  bool joint_alignment() const;
+  void set_joint_alignment(const bool enabled);
+
+  /// How well the fiducials of a level agree with its transform to the
+  /// reference level
+  struct AlignmentReport
+  {
+    struct Residual
+    {
+      std::string name;
+      double meters = 0.0;
+      bool inlier = true;
+    };
+    std::vector<Residual> residuals;
+
+    /// Rotation of a fit which is allowed to rotate. Transform has none, so
+    /// this only tells whether the drawings are rotated against each other.
+    double yaw = 0.0;
+  };
+  const AlignmentReport& get_alignment_report(const int level_idx);
+
   void calculate_all_transforms();
 
   int get_reference_level_idx();
 
   void clear_scene();
 
-  double level_meters_per_pixel(const std::string& level_name) const;
+  /// Forget the graphics items of this level only, after its scene was
+  /// cleared or deleted; the scenes of the other levels are untouched
+  void clear_scene(const int level_idx);
 
-  void rotate_all_models(const double rotation);
+  double level_meters_per_pixel(const std::string& level_name) const;
 
   void get_selected_items(const int level_idx,
     std::vector<Level::SelectedItem>& selected);
@@ -179,6 +341,19 @@ public:
     std::vector<EditorModel>& editor_models,
     const RenderingOptions& rendering_options);
 
+  bool redraw_items(
+    QGraphicsScene* scene,
+    const int level_idx,
+    const std::vector<Level::SelectedItem>& items,
+    std::vector<EditorModel>& editor_models,
+    const RenderingOptions& rendering_options);
+
+  bool stream_items(
+    QGraphicsScene* scene,
+    const int level_idx,
+    std::vector<EditorModel>& editor_models,
+    const RenderingOptions& rendering_options);
+
   /*
   void mouse_select_press(
     const int level_idx,
@@ -198,6 +373,82 @@ public:
 
 private:
   std::string filename;
+
+  /// Which revision of a level's fiducials (see Level::fiducials_revision())
+  /// a cached result was computed from
+  struct FiducialsVersion
+  {
+    std::size_t revision = 0;
+    std::size_t count = 0;
+
+    bool operator==(const FiducialsVersion& other) const
+    {
+      return revision == other.revision && count == other.count;
+    }
+  };
+  static FiducialsVersion fiducials_version(const Level& level);
+
+  /// The fit of a level to the reference level, from get_transform_to_
+  /// reference(). It depends on nothing but the fiducials of the two, so
+  /// it is kept until one of them is marked changed; editing a level only
+  /// refits that level, unless it is the reference level.
+  struct LevelTransform
+  {
+    bool valid = false;
+    FiducialsVersion level_version;
+    FiducialsVersion reference_version;
+    double reference_meters_per_pixel = 0.0;  // for the inlier threshold
+    bool joint = false;  // part of a joint fit of all levels
+    Transform to_reference;
+    AlignmentReport report;
+  };
+  std::vector<LevelTransform> level_transforms;
+
+  /// The fit of one level to the reference level alone, through the cache
+  Transform fit_to_reference(const int level_idx);
+
+  /// Refit all levels together if the fiducials of any have changed
+  void fit_levels_jointly();
+
+  mutable std::unordered_map<std::string, int> level_idxs;
+
+  /// Index of each fiducial name of the reference level, for matching
+  std::unordered_map<std::string, std::size_t> reference_fiducials;
+  int reference_fiducials_level_idx = -1;
+  FiducialsVersion reference_fiducials_version;
+
+  /// Emit a one-entry map, as a top-level section of the building file
+  static bool emit_entry(
+    const std::string& key,
+    const YAML::Node& value,
+    std::string& text);
+
+  /// The graphics of one lift on one level, built by Lift::draw(). While
+  /// in_scene, the group is owned by the scene; otherwise by us.
+  struct LiftGraphics
+  {
+    QGraphicsItemGroup* group = nullptr;
+    bool in_scene = false;
+    std::string level_name;
+    double elevation = 0.0;
+    double meters_per_pixel = 0.0;
+    Transform transform;
+  };
+  /// Keyed by (lift index, level index)
+  std::map<std::pair<std::size_t, int>, LiftGraphics> lift_graphics;
+
+  /// Put the graphics of one lift into the scene, from the cache if they
+  /// are still good; the lifts must be compiled
+  void draw_lift(
+    QGraphicsScene* scene,
+    const std::size_t lift_idx,
+    const int level_idx);
+
+  /// The (name, elevation) of each level when the lifts were compiled
+  bool lift_tables_valid = false;
+  std::size_t _lifts_revision = 0;
+  mutable std::uint64_t _saved_content_hash = 0;
+  std::vector<std::pair<std::string, double>> lift_tables_levels;
 };
 
 #endif
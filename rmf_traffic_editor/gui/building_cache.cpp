@@ -0,0 +1,358 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include <cstddef>
+#include <cstring>
+
+#include <QCryptographicHash>
+#include <QFile>
+#include <QtEndian>
+
+#include "building_cache.hpp"
+#include "logging.hpp"
+
+namespace {
+
+// bump this whenever the layout of the sidecar changes
+const uint32_t CACHE_MAGIC = 0x54454231;  // "TEB1"
+
+const int HASH_SIZE = 20;  // SHA1
+
+struct CacheHeader
+{
+  uint32_t magic;
+  uint32_t reserved;
+  char yaml_hash[HASH_SIZE];
+};
+
+enum NodeCode : uint8_t
+{
+  CODE_NULL = 0,
+  CODE_SCALAR,
+  CODE_SEQUENCE,
+  CODE_MAP
+};
+
+void put_u32(QByteArray& buffer, const uint32_t value)
+{
+  const uint32_t le = qToLittleEndian(value);
+  buffer.append(reinterpret_cast<const char*>(&le), sizeof(le));
+}
+
+void put_string(QByteArray& buffer, const std::string& s)
+{
+  put_u32(buffer, static_cast<uint32_t>(s.size()));
+  buffer.append(s.data(), static_cast<int>(s.size()));
+}
+
+void put_node(QByteArray& buffer, const YAML::Node& node)
+{
+  switch (node.Type())
+  {
+    case YAML::NodeType::Scalar:
+      buffer.append(static_cast<char>(CODE_SCALAR));
+      buffer.append(static_cast<char>(node.Style()));
+      put_string(buffer, node.Scalar());
+      break;
+    case YAML::NodeType::Sequence:
+      buffer.append(static_cast<char>(CODE_SEQUENCE));
+      buffer.append(static_cast<char>(node.Style()));
+      put_u32(buffer, static_cast<uint32_t>(node.size()));
+      for (YAML::const_iterator it = node.begin(); it != node.end(); ++it)
+        put_node(buffer, *it);
+      break;
+    case YAML::NodeType::Map:
+      buffer.append(static_cast<char>(CODE_MAP));
+      buffer.append(static_cast<char>(node.Style()));
+      put_u32(buffer, static_cast<uint32_t>(node.size()));
+      for (YAML::const_iterator it = node.begin(); it != node.end(); ++it)
+      {
+        put_string(buffer, it->first.as<std::string>());
+        put_node(buffer, it->second);
+      }
+      break;
+    default:
+      buffer.append(static_cast<char>(CODE_NULL));
+      buffer.append(static_cast<char>(YAML::EmitterStyle::Default));
+      break;
+  }
+}
+
+/// Reads a node tree back out of the mapped sidecar, checking every read
+/// against the end of the data
+class Reader
+{
+public:
+  Reader(const uchar* data, const uchar* end) : _p(data), _end(end) {}
+
+  bool at_end() const { return _p == _end; }
+
+  bool node(YAML::Node& out, const int depth = 0)
+  {
+    uint8_t code = 0, style = 0;
+    if (depth > MAX_DEPTH || !u8(code) || !u8(style))
+      return false;
+
+    switch (code)
+    {
+      case CODE_NULL:
+        out = YAML::Node(YAML::NodeType::Null);
+        return true;
+      case CODE_SCALAR:
+      {
+        std::string s;
+        if (!string(s))
+          return false;
+        out = YAML::Node(s);
+        break;
+      }
+      case CODE_SEQUENCE:
+      {
+        uint32_t size = 0;
+        if (!u32(size))
+          return false;
+        out = YAML::Node(YAML::NodeType::Sequence);
+        for (uint32_t i = 0; i < size; i++)
+        {
+          YAML::Node child;
+          if (!this->node(child, depth + 1))
+            return false;
+          out.push_back(child);
+        }
+        break;
+      }
+      case CODE_MAP:
+      {
+        uint32_t size = 0;
+        if (!u32(size))
+          return false;
+        out = YAML::Node(YAML::NodeType::Map);
+        for (uint32_t i = 0; i < size; i++)
+        {
+          std::string key;
+          YAML::Node child;
+          if (!string(key) || !this->node(child, depth + 1))
+            return false;
+          // the keys were unique when the sidecar was written, so skip
+          // the linear search that operator[] would do
+          out.force_insert(key, child);
+        }
+        break;
+      }
+      default:
+        return false;
+    }
+    out.SetStyle(static_cast<YAML::EmitterStyle::value>(style));
+    return true;
+  }
+
+private:
+  static const int MAX_DEPTH = 256;
+  const uchar* _p;
+  const uchar* _end;
+
+  bool u8(uint8_t& value)
+  {
+    if (_end - _p < 1)
+      return false;
+    value = *_p++;
+    return true;
+  }
+
+  bool u32(uint32_t& value)
+  {
+    if (_end - _p < static_cast<std::ptrdiff_t>(sizeof(value)))
+      return false;
+    value = qFromLittleEndian<uint32_t>(_p);
+    _p += sizeof(value);
+    return true;
+  }
+
+  bool string(std::string& s)
+  {
+    uint32_t size = 0;
+    if (!u32(size) || _end - _p < static_cast<std::ptrdiff_t>(size))
+      return false;
+    s.assign(reinterpret_cast<const char*>(_p), size);
+    _p += size;
+    return true;
+  }
+};
+
+}  // namespace
+
+std::string BuildingCache::cache_filename(const std::string& yaml_filename)
+{
+  return yaml_filename + ".cache";
+}
+
+QByteArray BuildingCache::file_hash(const std::string& filename)
+{
+  QFile file(QString::fromStdString(filename));
+  if (!file.open(QIODevice::ReadOnly))
+    return QByteArray();
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  if (!hash.addData(&file))
+    return QByteArray();
+  return hash.result();
+}
+
+bool BuildingCache::load(
+  const std::string& yaml_filename,
+  const QByteArray& yaml_hash,
+  YAML::Node& node)
+{
+  if (yaml_hash.size() != HASH_SIZE)
+    return false;
+
+  const QString path = QString::fromStdString(cache_filename(yaml_filename));
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly) ||
+    file.size() < static_cast<qint64>(sizeof(CacheHeader)))
+    return false;
+
+  // the mapping goes away with the file, after the tree has been rebuilt
+  const uchar* data = file.map(0, file.size());
+  if (!data)
+    return false;
+
+  CacheHeader header;
+  memcpy(&header, data, sizeof(header));
+  if (qFromLittleEndian(header.magic) != CACHE_MAGIC)
+  {
+    qCWarning(lc_io,
+      "ignoring unknown building cache %s", qUtf8Printable(path));
+    return false;
+  }
+  if (memcmp(header.yaml_hash, yaml_hash.constData(), HASH_SIZE) != 0)
+  {
+    qCDebug(lc_io, "building cache %s is stale", qUtf8Printable(path));
+    return false;
+  }
+
+  Reader reader(data + sizeof(header), data + file.size());
+  YAML::Node tree;
+  if (!reader.node(tree) || !reader.at_end())
+  {
+    qCWarning(lc_io,
+      "ignoring corrupt building cache %s", qUtf8Printable(path));
+    return false;
+  }
+  node = tree;
+  return true;
+}
+
+bool BuildingCache::save(
+  const std::string& yaml_filename,
+  const QByteArray& yaml_hash,
+  const YAML::Node& node)
+{
+  Writer writer;
+  if (!writer.open(yaml_filename))
+    return false;
+  writer.node(node);
+  return writer.commit(yaml_hash);
+}
+
+QByteArray BuildingCache::encode(const YAML::Node& node)
+{
+  QByteArray buffer;
+  put_node(buffer, node);
+  return buffer;
+}
+
+bool BuildingCache::decode(const QByteArray& encoded, YAML::Node& node)
+{
+  const uchar* data = reinterpret_cast<const uchar*>(encoded.constData());
+  Reader reader(data, data + encoded.size());
+  YAML::Node tree;
+  if (!reader.node(tree) || !reader.at_end())
+    return false;
+  node = tree;
+  return true;
+}
+
+bool BuildingCache::Writer::open(const std::string& yaml_filename)
+{
+  _file.setFileName(QString::fromStdString(cache_filename(yaml_filename)));
+  if (!_file.open(QIODevice::WriteOnly))
+    return false;
+
+  // the hash is filled in by commit()
+  CacheHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = qToLittleEndian(CACHE_MAGIC);
+  _file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  return true;
+}
+
+void BuildingCache::Writer::begin_map(
+  const std::size_t num_entries,
+  const YAML::EmitterStyle::value style)
+{
+  _buffer.append(static_cast<char>(CODE_MAP));
+  _buffer.append(static_cast<char>(style));
+  put_u32(_buffer, static_cast<uint32_t>(num_entries));
+}
+
+void BuildingCache::Writer::key(const std::string& k)
+{
+  put_string(_buffer, k);
+}
+
+void BuildingCache::Writer::node(const YAML::Node& n)
+{
+  put_node(_buffer, n);
+  flush_buffer();
+}
+
+void BuildingCache::Writer::append_encoded(const QByteArray& encoded)
+{
+  flush_buffer();
+  if (_file.isOpen())
+    _file.write(encoded);
+}
+
+void BuildingCache::Writer::flush_buffer()
+{
+  if (!_file.isOpen())
+    return;
+  _file.write(_buffer);
+  _buffer.clear();
+}
+
+bool BuildingCache::Writer::commit(const QByteArray& yaml_hash)
+{
+  flush_buffer();
+  if (!_file.isOpen() ||
+    yaml_hash.size() != HASH_SIZE ||
+    !_file.seek(offsetof(CacheHeader, yaml_hash)))
+  {
+    _file.cancelWriting();
+    _file.commit();
+    return false;
+  }
+  _file.write(yaml_hash.constData(), HASH_SIZE);
+  if (!_file.commit())
+  {
+    qCWarning(lc_io, "unable to write building cache %s",
+      qUtf8Printable(_file.fileName()));
+    return false;
+  }
+  return true;
+}
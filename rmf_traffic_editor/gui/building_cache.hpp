@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef TRAFFIC_EDITOR__BUILDING_CACHE_HPP
+#define TRAFFIC_EDITOR__BUILDING_CACHE_HPP
+
+#include <cstdint>
+#include <string>
+
+#include <QByteArray>
+#include <QSaveFile>
+#include <yaml-cpp/yaml.h>
+
+//=============================================================================
+/// Optional binary sidecar of a .building.yaml file, so that reopening a
+/// big building doesn't have to run the YAML parser. It holds the parsed
+/// YAML tree in a compact form (node types, styles and scalar strings),
+/// behind a header with the SHA1 of the YAML file it was made from. The
+/// YAML file stays the source of truth: a sidecar that doesn't match it
+/// is ignored, and the tree is read with the same from_yaml() code.
+class BuildingCache
+{
+public:
+  /// The sidecar beside this building file
+  static std::string cache_filename(const std::string& yaml_filename);
+
+  /// SHA1 of the contents of a file, or an empty array if it can't be read
+  static QByteArray file_hash(const std::string& filename);
+
+  /// Memory-map the sidecar and rebuild the YAML tree from it, if it was
+  /// made from a file with this hash
+  static bool load(
+    const std::string& yaml_filename,
+    const QByteArray& yaml_hash,
+    YAML::Node& node);
+
+  /// Write the sidecar of a whole tree in one go
+  static bool save(
+    const std::string& yaml_filename,
+    const QByteArray& yaml_hash,
+    const YAML::Node& node);
+
+  /// The sidecar encoding of a tree, for Writer::append_encoded()
+  static QByteArray encode(const YAML::Node& node);
+
+  /// The tree of an encode(), false if the data isn't one
+  static bool decode(const QByteArray& encoded, YAML::Node& node);
+
+  /// Writes the sidecar piece by piece, alongside a streaming emitter. The
+  /// hash goes in last, once the YAML file is complete.
+  class Writer
+  {
+  public:
+    bool open(const std::string& yaml_filename);
+
+    /// Start a map of this many entries; each is a key() and a node()
+    /// or another begin_map()
+    void begin_map(
+      const std::size_t num_entries,
+      const YAML::EmitterStyle::value style = YAML::EmitterStyle::Default);
+    void key(const std::string& k);
+    void node(const YAML::Node& n);
+
+    /// Like node(), for a tree that was encoded earlier
+    void append_encoded(const QByteArray& encoded);
+
+    bool commit(const QByteArray& yaml_hash);
+
+  private:
+    QSaveFile _file;
+    QByteArray _buffer;
+
+    void flush_buffer();
+  };
+};
+
+#endif
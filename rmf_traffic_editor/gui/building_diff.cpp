@@ -0,0 +1,885 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include <utility>
+
+#include <QJsonArray>
+#include <QUuid>
+
+#include "building.h"
+#include "building_diff.hpp"
+#include "content_hash.hpp"
+#include "level.h"
+
+namespace {
+
+/// What a vertex, model, etc. is matched by
+struct Point
+{
+  QUuid id;
+  std::uint64_t identity = 0;  // its ContentHash
+  std::uint64_t attributes = 0;  // the hash of all but its pose
+  std::string name;
+  double x = 0.0;
+  double y = 0.0;
+  double yaw = 0.0;
+};
+
+/// The index of the entity each entity is matched to, or -1
+struct Matching
+{
+  std::vector<int> before;
+  std::vector<int> after;
+
+  Matching(const std::size_t num_before, const std::size_t num_after)
+  : before(num_before, -1), after(num_after, -1)
+  {
+  }
+
+  void match(const int before_idx, const int after_idx)
+  {
+    before[before_idx] = after_idx;
+    after[after_idx] = before_idx;
+  }
+};
+
+/// Sort both lists of (key, index) and match the entities with equal
+/// keys, pairing duplicates in the order of their indices
+template<typename Key>
+void match_keys(
+  std::vector<std::pair<Key, int>>& before_keys,
+  std::vector<std::pair<Key, int>>& after_keys,
+  Matching& matching)
+{
+  std::sort(before_keys.begin(), before_keys.end());
+  std::sort(after_keys.begin(), after_keys.end());
+  auto b = before_keys.begin();
+  auto a = after_keys.begin();
+  while (b != before_keys.end() && a != after_keys.end())
+  {
+    if (b->first < a->first)
+      ++b;
+    else if (a->first < b->first)
+      ++a;
+    else
+      matching.match((b++)->second, (a++)->second);
+  }
+}
+
+/// The keys of the entities which aren't matched yet
+template<typename Key, typename GetKey>
+std::vector<std::pair<Key, int>> unmatched_keys(
+  const std::vector<Point>& points,
+  const std::vector<int>& matches,
+  GetKey get_key)
+{
+  std::vector<std::pair<Key, int>> keys;
+  keys.reserve(points.size());
+  Key key;
+  for (std::size_t i = 0; i < points.size(); i++)
+  {
+    if (matches[i] < 0 && get_key(points[i], key))
+      keys.emplace_back(key, static_cast<int>(i));
+  }
+  return keys;
+}
+
+void match_points(
+  const std::vector<Point>& before,
+  const std::vector<Point>& after,
+  const double radius,
+  Matching& matching)
+{
+  using Cell = std::pair<std::int64_t, std::int64_t>;
+
+  auto by_id = [](const Point& p, QUuid& key)
+    {
+      key = p.id;
+      return !key.isNull();
+    };
+  auto by_identity = [](const Point& p, std::uint64_t& key)
+    {
+      key = p.identity;
+      return true;
+    };
+  auto by_name = [](const Point& p, std::string& key)
+    {
+      key = p.name;
+      return !key.empty();
+    };
+
+  {
+    auto b = unmatched_keys<QUuid>(before, matching.before, by_id);
+    auto a = unmatched_keys<QUuid>(after, matching.after, by_id);
+    match_keys(b, a, matching);
+  }
+  {
+    auto b = unmatched_keys<std::uint64_t>(
+      before, matching.before, by_identity);
+    auto a = unmatched_keys<std::uint64_t>(
+      after, matching.after, by_identity);
+    match_keys(b, a, matching);
+  }
+  {
+    auto b = unmatched_keys<std::string>(before, matching.before, by_name);
+    auto a = unmatched_keys<std::string>(after, matching.after, by_name);
+    match_keys(b, a, matching);
+  }
+
+  // what is left is matched to the closest unmatched entity within the
+  // radius, looked up by the cells of that size around it
+  if (radius <= 0.0)
+    return;
+  auto cell_of = [radius](const Point& p)
+    {
+      return Cell(
+        static_cast<std::int64_t>(std::floor(p.x / radius)),
+        static_cast<std::int64_t>(std::floor(p.y / radius)));
+    };
+  std::vector<std::pair<Cell, int>> cells;
+  for (std::size_t i = 0; i < after.size(); i++)
+  {
+    if (matching.after[i] < 0)
+      cells.emplace_back(cell_of(after[i]), static_cast<int>(i));
+  }
+  std::sort(cells.begin(), cells.end());
+
+  for (std::size_t i = 0; i < before.size(); i++)
+  {
+    if (matching.before[i] >= 0)
+      continue;
+    const Cell center = cell_of(before[i]);
+    int closest = -1;
+    double closest_distance = radius;
+    for (std::int64_t dx = -1; dx <= 1; dx++)
+    {
+      for (std::int64_t dy = -1; dy <= 1; dy++)
+      {
+        const Cell cell(center.first + dx, center.second + dy);
+        auto it = std::lower_bound(
+          cells.begin(),
+          cells.end(),
+          std::make_pair(cell, -1));
+        for (; it != cells.end() && it->first == cell; ++it)
+        {
+          if (matching.after[it->second] >= 0)
+            continue;
+          const Point& p = after[it->second];
+          const double distance =
+            std::hypot(p.x - before[i].x, p.y - before[i].y);
+          if (distance <= closest_distance)
+          {
+            closest = it->second;
+            closest_distance = distance;
+          }
+        }
+      }
+    }
+    if (closest >= 0)
+      matching.match(static_cast<int>(i), closest);
+  }
+}
+
+/// As to_yaml() rounds positions
+bool same_position(const double a, const double b, const double scale)
+{
+  return std::round(a * scale) == std::round(b * scale);
+}
+
+BuildingDiff::Entry make_entry(
+  const BuildingDiff::Kind kind,
+  const int changes,
+  const int before_idx,
+  const int after_idx)
+{
+  BuildingDiff::Entry entry;
+  entry.kind = kind;
+  entry.changes = changes;
+  entry.before_idx = before_idx;
+  entry.after_idx = after_idx;
+  return entry;
+}
+
+/// The entries of a matching of points
+void add_point_entries(
+  const BuildingDiff::Kind kind,
+  const std::vector<Point>& before,
+  const std::vector<Point>& after,
+  const Matching& matching,
+  std::vector<BuildingDiff::Entry>& entries)
+{
+  for (std::size_t i = 0; i < before.size(); i++)
+  {
+    const int j = matching.before[i];
+    int changes = 0;
+    if (j < 0)
+      changes = BuildingDiff::REMOVED;
+    else
+    {
+      const Point& b = before[i];
+      const Point& a = after[j];
+      if (!same_position(b.x, a.x, 1000.0) ||
+        !same_position(b.y, a.y, 1000.0) ||
+        !same_position(b.yaw, a.yaw, 10000.0))
+        changes |= BuildingDiff::MOVED;
+      if (b.attributes != a.attributes)
+        changes |= BuildingDiff::CHANGED;
+    }
+    if (!changes)
+      continue;
+
+    BuildingDiff::Entry entry =
+      make_entry(kind, changes, static_cast<int>(i), j);
+    entry.name = j < 0 ? before[i].name : after[j].name;
+    entry.before_x = before[i].x;
+    entry.before_y = before[i].y;
+    if (j >= 0)
+    {
+      entry.after_x = after[j].x;
+      entry.after_y = after[j].y;
+    }
+    entries.push_back(entry);
+  }
+
+  for (std::size_t j = 0; j < after.size(); j++)
+  {
+    if (matching.after[j] >= 0)
+      continue;
+    BuildingDiff::Entry entry = make_entry(
+      kind,
+      BuildingDiff::ADDED,
+      -1,
+      static_cast<int>(j));
+    entry.name = after[j].name;
+    entry.after_x = after[j].x;
+    entry.after_y = after[j].y;
+    entries.push_back(entry);
+  }
+}
+
+/// Match and diff the points of one kind
+template<typename T, typename MakePoint>
+void diff_points(
+  const BuildingDiff::Kind kind,
+  const std::vector<T>& before,
+  const std::vector<T>& after,
+  const double radius,
+  MakePoint make_point,
+  Matching& matching,
+  std::vector<BuildingDiff::Entry>& entries)
+{
+  std::vector<Point> before_points;
+  before_points.reserve(before.size());
+  for (std::size_t i = 0; i < before.size(); i++)
+    before_points.push_back(make_point(before[i], i, true));
+  std::vector<Point> after_points;
+  after_points.reserve(after.size());
+  for (std::size_t i = 0; i < after.size(); i++)
+    after_points.push_back(make_point(after[i], i, false));
+  match_points(before_points, after_points, radius, matching);
+  add_point_entries(kind, before_points, after_points, matching, entries);
+}
+
+std::uint64_t params_hash(const ParamMap& params)
+{
+  return ContentHash::Builder().add(params).value();
+}
+
+/// Where an edge or a polygon is, in the pixels of its level
+void midpoint(
+  const Level& level,
+  const std::vector<int>& vertex_idxs,
+  double& x,
+  double& y)
+{
+  x = 0.0;
+  y = 0.0;
+  int num_vertices = 0;
+  for (const int idx : vertex_idxs)
+  {
+    if (idx < 0 || idx >= static_cast<int>(level.vertices.size()))
+      continue;
+    x += level.vertices[idx].x;
+    y += level.vertices[idx].y;
+    num_vertices++;
+  }
+  if (num_vertices > 0)
+  {
+    x /= num_vertices;
+    y /= num_vertices;
+  }
+}
+
+std::string edge_name(const Edge& edge)
+{
+  const auto it = edge.params.find("name");
+  return it != edge.params.end() ? it->second.value_string : std::string();
+}
+
+/// Edges are the same edge if they are of the same type and join the same
+/// (matched) vertices
+void diff_edges(
+  const Level& before,
+  const Level& after,
+  const Matching& vertices,
+  std::vector<BuildingDiff::Entry>& entries)
+{
+  using Key = std::tuple<int, int, int>;
+  const int num_before_vertices = static_cast<int>(vertices.before.size());
+
+  std::vector<std::pair<Key, int>> before_keys;
+  before_keys.reserve(before.edges.size());
+  for (std::size_t i = 0; i < before.edges.size(); i++)
+  {
+    const Edge& edge = before.edges[i];
+    if (edge.start_idx < 0 || edge.start_idx >= num_before_vertices ||
+      edge.end_idx < 0 || edge.end_idx >= num_before_vertices)
+      continue;
+    const int start = vertices.before[edge.start_idx];
+    const int end = vertices.before[edge.end_idx];
+    if (start >= 0 && end >= 0)
+      before_keys.emplace_back(
+        Key(static_cast<int>(edge.type), start, end),
+        static_cast<int>(i));
+  }
+  std::vector<std::pair<Key, int>> after_keys;
+  after_keys.reserve(after.edges.size());
+  for (std::size_t i = 0; i < after.edges.size(); i++)
+  {
+    const Edge& edge = after.edges[i];
+    after_keys.emplace_back(
+      Key(static_cast<int>(edge.type), edge.start_idx, edge.end_idx),
+      static_cast<int>(i));
+  }
+
+  Matching matching(before.edges.size(), after.edges.size());
+  match_keys(before_keys, after_keys, matching);
+
+  for (std::size_t i = 0; i < before.edges.size(); i++)
+  {
+    const Edge& edge = before.edges[i];
+    const int j = matching.before[i];
+    if (j >= 0 &&
+      params_hash(edge.params) == params_hash(after.edges[j].params))
+      continue;
+
+    BuildingDiff::Entry entry = make_entry(
+      BuildingDiff::EDGE,
+      j < 0 ? BuildingDiff::REMOVED : BuildingDiff::CHANGED,
+      static_cast<int>(i),
+      j);
+    entry.name = edge_name(j < 0 ? edge : after.edges[j]);
+    midpoint(
+      before,
+      {edge.start_idx, edge.end_idx},
+      entry.before_x,
+      entry.before_y);
+    if (j >= 0)
+      midpoint(
+        after,
+        {after.edges[j].start_idx, after.edges[j].end_idx},
+        entry.after_x,
+        entry.after_y);
+    entries.push_back(entry);
+  }
+  for (std::size_t j = 0; j < after.edges.size(); j++)
+  {
+    if (matching.after[j] >= 0)
+      continue;
+    const Edge& edge = after.edges[j];
+    BuildingDiff::Entry entry = make_entry(
+      BuildingDiff::EDGE,
+      BuildingDiff::ADDED,
+      -1,
+      static_cast<int>(j));
+    entry.name = edge_name(edge);
+    midpoint(
+      after,
+      {edge.start_idx, edge.end_idx},
+      entry.after_x,
+      entry.after_y);
+    entries.push_back(entry);
+  }
+}
+
+/// Polygons are the same polygon if they are of the same type and have
+/// the same (matched) vertices, in the same order
+void diff_polygons(
+  const Level& before,
+  const Level& after,
+  const Matching& vertices,
+  std::vector<BuildingDiff::Entry>& entries)
+{
+  const int num_before_vertices = static_cast<int>(vertices.before.size());
+  std::vector<std::pair<std::uint64_t, int>> before_keys;
+  for (std::size_t i = 0; i < before.polygons.size(); i++)
+  {
+    const Polygon& polygon = before.polygons[i];
+    ContentHash::Builder key;
+    key.add(static_cast<int>(polygon.type));
+    bool all_matched = true;
+    for (const int idx : polygon.vertices)
+    {
+      const int matched = idx >= 0 && idx < num_before_vertices ?
+        vertices.before[idx] : -1;
+      all_matched = all_matched && matched >= 0;
+      key.add(matched);
+    }
+    if (all_matched)
+      before_keys.emplace_back(key.value(), static_cast<int>(i));
+  }
+  std::vector<std::pair<std::uint64_t, int>> after_keys;
+  for (std::size_t i = 0; i < after.polygons.size(); i++)
+  {
+    const Polygon& polygon = after.polygons[i];
+    ContentHash::Builder key;
+    key.add(static_cast<int>(polygon.type));
+    for (const int idx : polygon.vertices)
+      key.add(idx);
+    after_keys.emplace_back(key.value(), static_cast<int>(i));
+  }
+
+  Matching matching(before.polygons.size(), after.polygons.size());
+  match_keys(before_keys, after_keys, matching);
+
+  for (std::size_t i = 0; i < before.polygons.size(); i++)
+  {
+    const Polygon& polygon = before.polygons[i];
+    const int j = matching.before[i];
+    if (j >= 0 &&
+      params_hash(polygon.params) == params_hash(after.polygons[j].params))
+      continue;
+
+    BuildingDiff::Entry entry = make_entry(
+      BuildingDiff::POLYGON,
+      j < 0 ? BuildingDiff::REMOVED : BuildingDiff::CHANGED,
+      static_cast<int>(i),
+      j);
+    midpoint(before, polygon.vertices, entry.before_x, entry.before_y);
+    if (j >= 0)
+      midpoint(
+        after,
+        after.polygons[j].vertices,
+        entry.after_x,
+        entry.after_y);
+    entries.push_back(entry);
+  }
+  for (std::size_t j = 0; j < after.polygons.size(); j++)
+  {
+    if (matching.after[j] >= 0)
+      continue;
+    BuildingDiff::Entry entry = make_entry(
+      BuildingDiff::POLYGON,
+      BuildingDiff::ADDED,
+      -1,
+      static_cast<int>(j));
+    midpoint(
+      after,
+      after.polygons[j].vertices,
+      entry.after_x,
+      entry.after_y);
+    entries.push_back(entry);
+  }
+}
+
+/// Match by name, as levels, lifts and layers are; hash_of hashes all of
+/// one but its pose, pose_of gives its (x, y, yaw)
+template<typename T, typename HashOf, typename PoseOf>
+void diff_named(
+  const BuildingDiff::Kind kind,
+  const std::vector<T>& before,
+  const std::vector<T>& after,
+  HashOf hash_of,
+  PoseOf pose_of,
+  std::vector<BuildingDiff::Entry>& entries)
+{
+  std::vector<std::pair<std::string, int>> before_keys;
+  for (std::size_t i = 0; i < before.size(); i++)
+    before_keys.emplace_back(before[i].name, static_cast<int>(i));
+  std::vector<std::pair<std::string, int>> after_keys;
+  for (std::size_t i = 0; i < after.size(); i++)
+    after_keys.emplace_back(after[i].name, static_cast<int>(i));
+  Matching matching(before.size(), after.size());
+  match_keys(before_keys, after_keys, matching);
+
+  for (std::size_t i = 0; i < before.size(); i++)
+  {
+    const int j = matching.before[i];
+    double bx, by, byaw;
+    pose_of(before[i], bx, by, byaw);
+    double ax = 0.0, ay = 0.0, ayaw = 0.0;
+    int changes = BuildingDiff::REMOVED;
+    if (j >= 0)
+    {
+      pose_of(after[j], ax, ay, ayaw);
+      changes = 0;
+      if (!same_position(bx, ax, 1000.0) ||
+        !same_position(by, ay, 1000.0) ||
+        !same_position(byaw, ayaw, 10000.0))
+        changes |= BuildingDiff::MOVED;
+      if (hash_of(before[i]) != hash_of(after[j]))
+        changes |= BuildingDiff::CHANGED;
+    }
+    if (!changes)
+      continue;
+    BuildingDiff::Entry entry =
+      make_entry(kind, changes, static_cast<int>(i), j);
+    entry.name = before[i].name;
+    entry.before_x = bx;
+    entry.before_y = by;
+    entry.after_x = ax;
+    entry.after_y = ay;
+    entries.push_back(entry);
+  }
+  for (std::size_t j = 0; j < after.size(); j++)
+  {
+    if (matching.after[j] >= 0)
+      continue;
+    BuildingDiff::Entry entry = make_entry(
+      kind,
+      BuildingDiff::ADDED,
+      -1,
+      static_cast<int>(j));
+    double yaw;
+    pose_of(after[j], entry.after_x, entry.after_y, yaw);
+    entry.name = after[j].name;
+    entries.push_back(entry);
+  }
+}
+
+QJsonArray changes_json(const int changes)
+{
+  QJsonArray json;
+  if (changes & BuildingDiff::ADDED)
+    json.append("added");
+  if (changes & BuildingDiff::REMOVED)
+    json.append("removed");
+  if (changes & BuildingDiff::MOVED)
+    json.append("moved");
+  if (changes & BuildingDiff::CHANGED)
+    json.append("changed");
+  return json;
+}
+
+QJsonArray entries_json(const std::vector<BuildingDiff::Entry>& entries)
+{
+  QJsonArray json;
+  for (const BuildingDiff::Entry& entry : entries)
+  {
+    QJsonObject entry_json;
+    entry_json["kind"] = BuildingDiff::kind_name(entry.kind);
+    entry_json["changes"] = changes_json(entry.changes);
+    if (!entry.name.empty())
+      entry_json["name"] = QString::fromStdString(entry.name);
+    if (entry.before_idx >= 0)
+    {
+      entry_json["before_idx"] = entry.before_idx;
+      entry_json["before"] = QJsonArray{entry.before_x, entry.before_y};
+    }
+    if (entry.after_idx >= 0)
+    {
+      entry_json["after_idx"] = entry.after_idx;
+      entry_json["after"] = QJsonArray{entry.after_x, entry.after_y};
+    }
+    json.append(entry_json);
+  }
+  return json;
+}
+
+}  // namespace
+
+const char* BuildingDiff::kind_name(const Kind kind)
+{
+  switch (kind)
+  {
+    case VERTEX: return "vertex";
+    case EDGE: return "edge";
+    case POLYGON: return "polygon";
+    case MODEL: return "model";
+    case FIDUCIAL: return "fiducial";
+    case FEATURE: return "feature";
+    case TAG: return "tag";
+    case LAYER: return "layer";
+    case LIFT: return "lift";
+    default: return "";
+  }
+}
+
+int BuildingDiff::LevelDiff::count(const Change change) const
+{
+  return static_cast<int>(std::count_if(
+      entries.begin(),
+      entries.end(),
+      [change](const Entry& entry) { return entry.changes & change; }));
+}
+
+void BuildingDiff::diff_level(
+  const Level& before,
+  const Level& after,
+  LevelDiff& diff,
+  const double match_radius)
+{
+  const ContentHash::LevelHashes& before_hashes = before.content_hashes();
+  const ContentHash::LevelHashes& after_hashes = after.content_hashes();
+  if (before_hashes.level == after_hashes.level)
+    return;
+
+  const double radius = after.drawing_meters_per_pixel > 0.0 ?
+    match_radius / after.drawing_meters_per_pixel : match_radius;
+
+  // the identity of each is the hash of everything it saves, and its
+  // attributes that of everything but its pose
+  Matching vertices(before.vertices.size(), after.vertices.size());
+  diff_points(
+    VERTEX,
+    before.vertices,
+    after.vertices,
+    radius,
+    [&](const Vertex& v, const std::size_t i, const bool is_before)
+    {
+      Point p;
+      p.id = v.uuid;
+      p.identity = (is_before ? before_hashes : after_hashes)
+      .entities[ContentHash::VERTICES][i];
+      p.attributes =
+        ContentHash::Builder().add(v.name).add(v.params).value();
+      p.name = v.name;
+      p.x = v.x;
+      p.y = v.y;
+      return p;
+    },
+    vertices,
+    diff.entries);
+
+  diff_edges(before, after, vertices, diff.entries);
+  diff_polygons(before, after, vertices, diff.entries);
+
+  Matching models(before.models.size(), after.models.size());
+  diff_points(
+    MODEL,
+    before.models,
+    after.models,
+    radius,
+    [&](const Model& m, const std::size_t i, const bool is_before)
+    {
+      Point p;
+      p.id = m.uuid;
+      p.identity = (is_before ? before_hashes : after_hashes)
+      .entities[ContentHash::MODELS][i];
+      p.attributes = ContentHash::Builder()
+      .add(m.instance_name)
+      .add(m.model_name)
+      .add(m.is_static)
+      .add(std::round(m.state.z * 1000.0))
+      .value();
+      p.name = m.instance_name;
+      p.x = m.state.x;
+      p.y = m.state.y;
+      p.yaw = m.state.yaw;
+      return p;
+    },
+    models,
+    diff.entries);
+
+  Matching fiducials(before.fiducials.size(), after.fiducials.size());
+  diff_points(
+    FIDUCIAL,
+    before.fiducials,
+    after.fiducials,
+    radius,
+    [&](const Fiducial& f, const std::size_t i, const bool is_before)
+    {
+      Point p;
+      p.id = f.uuid;
+      p.identity = (is_before ? before_hashes : after_hashes)
+      .entities[ContentHash::FIDUCIALS][i];
+      p.attributes = ContentHash::Builder().add(f.name).value();
+      p.name = f.name;
+      p.x = f.x;
+      p.y = f.y;
+      return p;
+    },
+    fiducials,
+    diff.entries);
+
+  Matching features(
+    before.floorplan_features.size(),
+    after.floorplan_features.size());
+  diff_points(
+    FEATURE,
+    before.floorplan_features,
+    after.floorplan_features,
+    radius,
+    [&](const Feature& f, const std::size_t i, const bool is_before)
+    {
+      Point p;
+      p.id = f.id();
+      p.identity = (is_before ? before_hashes : after_hashes)
+      .entities[ContentHash::FEATURES][i];
+      p.attributes = ContentHash::Builder().add(f.name()).value();
+      p.name = f.name();
+      p.x = f.x();
+      p.y = f.y();
+      return p;
+    },
+    features,
+    diff.entries);
+
+  Matching tags(before.tags.size(), after.tags.size());
+  diff_points(
+    TAG,
+    before.tags,
+    after.tags,
+    radius,
+    [&](const Tag& t, const std::size_t i, const bool is_before)
+    {
+      Point p;
+      p.id = t.uuid;
+      p.identity = (is_before ? before_hashes : after_hashes)
+      .entities[ContentHash::TAGS][i];
+      p.attributes =
+        ContentHash::Builder().add(t.name).add(t.params).value();
+      p.name = t.name;
+      p.x = t.x;
+      p.y = t.y;
+      return p;
+    },
+    tags,
+    diff.entries);
+
+  diff_named(
+    LAYER,
+    before.layers,
+    after.layers,
+    [](const Layer& layer) { return ContentHash::of(layer); },
+    [](const Layer&, double& x, double& y, double& yaw)
+    {
+      x = 0.0;
+      y = 0.0;
+      yaw = 0.0;
+    },
+    diff.entries);
+}
+
+void BuildingDiff::compute(
+  const Building& before,
+  const Building& after,
+  const double match_radius)
+{
+  clear();
+
+  std::map<std::string, const Level*> before_levels;
+  for (const Level& level : before.levels)
+    before_levels[level.name] = &level;
+  std::map<std::string, const Level*> after_levels;
+  for (const Level& level : after.levels)
+    after_levels[level.name] = &level;
+
+  for (const auto& it : after_levels)
+  {
+    LevelDiff diff;
+    diff.name = it.first;
+    const auto before_it = before_levels.find(it.first);
+    if (before_it == before_levels.end())
+      diff.added = true;
+    else
+      diff_level(*before_it->second, *it.second, diff, match_radius);
+    if (diff.added || !diff.entries.empty())
+      levels.push_back(std::move(diff));
+  }
+  for (const auto& it : before_levels)
+  {
+    if (after_levels.count(it.first))
+      continue;
+    LevelDiff diff;
+    diff.name = it.first;
+    diff.removed = true;
+    levels.push_back(std::move(diff));
+  }
+
+  // a lift is moved if its cabin is, and changed if anything else is
+  diff_named(
+    LIFT,
+    before.lifts,
+    after.lifts,
+    [](const Lift& lift)
+    {
+      Lift unposed = lift;
+      unposed.x = 0.0;
+      unposed.y = 0.0;
+      unposed.yaw = 0.0;
+      return ContentHash::of(unposed.to_yaml());
+    },
+    [](const Lift& lift, double& x, double& y, double& yaw)
+    {
+      x = lift.x;
+      y = lift.y;
+      yaw = lift.yaw;
+    },
+    lifts);
+}
+
+void BuildingDiff::clear()
+{
+  levels.clear();
+  lifts.clear();
+}
+
+const BuildingDiff::LevelDiff* BuildingDiff::find_level(
+  const std::string& name) const
+{
+  for (const LevelDiff& level : levels)
+  {
+    if (level.name == name)
+      return &level;
+  }
+  return nullptr;
+}
+
+QJsonObject BuildingDiff::to_json() const
+{
+  QJsonArray levels_json;
+  for (const LevelDiff& level : levels)
+  {
+    QJsonObject level_json;
+    level_json["name"] = QString::fromStdString(level.name);
+    if (level.added || level.removed)
+    {
+      level_json["status"] = level.added ? "added" : "removed";
+      levels_json.append(level_json);
+      continue;
+    }
+    level_json["status"] = "changed";
+    level_json["added"] = level.count(ADDED);
+    level_json["removed"] = level.count(REMOVED);
+    level_json["moved"] = level.count(MOVED);
+    level_json["changed"] = level.count(CHANGED);
+    level_json["entities"] = entries_json(level.entries);
+    levels_json.append(level_json);
+  }
+
+  QJsonObject json;
+  json["identical"] = empty();
+  json["levels"] = levels_json;
+  json["lifts"] = entries_json(lifts);
+  return json;
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__BUILDING_DIFF_HPP
+#define TRAFFIC_EDITOR__BUILDING_DIFF_HPP
+
+#include <string>
+#include <vector>
+
+#include <QJsonObject>
+
+class Building;
+class Level;
+
+//=============================================================================
+/// The structural differences between two versions of a building: per
+/// level, which entities were added, removed, moved or had their other
+/// attributes (names, params, ...) changed. Levels, lifts and layers are
+/// matched by name. Vertices, models, fiducials, tags and features are
+/// matched first by uuid (which only survives within a session, except
+/// for the saved ids of features), then by identical content, then by
+/// name, then to the closest unmatched one within a radius. Edges and
+/// polygons are matched by their types and the matched vertices they
+/// join. Everything is matched by sorting and searching, so diffing two
+/// versions of n entities takes O(n log n), and levels whose content
+/// hashes are equal are not looked at at all (see ContentHash).
+class BuildingDiff
+{
+public:
+  enum Kind
+  {
+    VERTEX = 0,
+    EDGE,
+    POLYGON,
+    MODEL,
+    FIDUCIAL,
+    FEATURE,  // of the floorplan
+    TAG,
+    LAYER,
+    LIFT,
+    NUM_KINDS
+  };
+
+  static const char* kind_name(const Kind kind);
+
+  /// Flags of an Entry; MOVED and CHANGED can both be set
+  enum Change
+  {
+    ADDED = 1,
+    REMOVED = 2,
+    MOVED = 4,
+    CHANGED = 8
+  };
+
+  struct Entry
+  {
+    Kind kind = VERTEX;
+    int changes = 0;
+
+    /// The indices of the entity in the vectors of the two versions of
+    /// its level (or of the lifts), -1 on the side it is missing from
+    int before_idx = -1;
+    int after_idx = -1;
+
+    std::string name;
+
+    /// Where it is in the pixels of each version of its level: the
+    /// midpoint of an edge, the centroid of a polygon
+    double before_x = 0.0;
+    double before_y = 0.0;
+    double after_x = 0.0;
+    double after_y = 0.0;
+  };
+
+  struct LevelDiff
+  {
+    std::string name;
+    bool added = false;
+    bool removed = false;
+    std::vector<Entry> entries;
+
+    /// The number of entries with this change
+    int count(const Change change) const;
+  };
+
+  std::vector<LevelDiff> levels;  // only those which differ
+  std::vector<Entry> lifts;
+
+  /// Matches entities which moved up to match_radius meters
+  void compute(
+    const Building& before,
+    const Building& after,
+    const double match_radius = 0.5);
+
+  /// Appends the differences of two versions of a level to diff.entries
+  static void diff_level(
+    const Level& before,
+    const Level& after,
+    LevelDiff& diff,
+    const double match_radius = 0.5);
+
+  bool empty() const { return levels.empty() && lifts.empty(); }
+
+  void clear();
+
+  const LevelDiff* find_level(const std::string& name) const;
+
+  /// Counts of the changes of each level, and what changed
+  QJsonObject to_json() const;
+};
+
+#endif
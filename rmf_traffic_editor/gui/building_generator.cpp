@@ -0,0 +1,593 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+
+#include <QImage>
+#include <QPointF>
+
+#include "building.h"
+#include "building_generator.hpp"
+
+namespace {
+
+// meters
+const double DOOR_WIDTH = 1.0;
+const double WALL_THICKNESS = 0.15;
+const double MARGIN = 2.0;  // around the rooms, in the floorplan image
+const double MODEL_CLEARANCE = 1.0;  // from the walls of the room
+
+const char* const DEFAULT_MODEL_NAMES[] =
+{
+  "OpenRobotics/OfficeChairGrey",
+  "OpenRobotics/Table",
+  "OpenRobotics/Shelf",
+  "OpenRobotics/SmallCubicle",
+};
+
+void fill_rect(QImage& image, int x0, int y0, int x1, int y1, uchar value)
+{
+  x0 = std::max(x0, 0);
+  y0 = std::max(y0, 0);
+  x1 = std::min(x1, image.width() - 1);
+  y1 = std::min(y1, image.height() - 1);
+  for (int y = y0; y <= y1; y++)
+  {
+    uchar* line = image.scanLine(y);
+    for (int x = x0; x <= x1; x++)
+      line[x] = value;
+  }
+}
+
+}  // namespace
+
+BuildingGenerator::BuildingGenerator(const Options& options)
+: _options(options),
+  _rng(options.seed)
+{
+  if (_options.model_names.empty())
+  {
+    for (const char* name : DEFAULT_MODEL_NAMES)
+      _options.model_names.push_back(name);
+  }
+  _options.num_levels = std::max(_options.num_levels, 1);
+  _options.num_graphs = std::max(_options.num_graphs, 1);
+  _options.width = std::max(_options.width, 2.0 * DOOR_WIDTH);
+  _options.depth = std::max(_options.depth, 2.0 * DOOR_WIDTH);
+}
+
+double BuildingGenerator::uniform(const double lo, const double hi)
+{
+  return std::uniform_real_distribution<double>(lo, hi)(_rng);
+}
+
+double BuildingGenerator::lane_x(const int i) const
+{
+  return (i + 0.5) * _options.width / _lanes_x;
+}
+
+double BuildingGenerator::lane_y(const int i) const
+{
+  return (i + 0.5) * _options.depth / _lanes_y;
+}
+
+double BuildingGenerator::to_pixels(const double meters) const
+{
+  return (meters + MARGIN) / _options.meters_per_pixel;
+}
+
+bool BuildingGenerator::generate(Building& building)
+{
+  building.clear();
+  _rng.seed(_options.seed);
+
+  _rooms_x = std::max(1, static_cast<int>(
+      std::round(_options.width / _options.room_size)));
+  _rooms_y = std::max(1, static_cast<int>(
+      std::round(_options.depth / _options.room_size)));
+  _lanes_x = std::max(1, static_cast<int>(
+      std::round(_options.width / _options.lane_spacing)));
+  _lanes_y = std::max(1, static_cast<int>(
+      std::round(_options.depth / _options.lane_spacing)));
+
+  // the lifts stay in the same rooms on every level
+  std::vector<int> rooms(_rooms_x * _rooms_y);
+  std::iota(rooms.begin(), rooms.end(), 0);
+  std::shuffle(rooms.begin(), rooms.end(), _rng);
+  const int num_lifts =
+    std::min(std::max(_options.num_lifts, 0), static_cast<int>(rooms.size()));
+  _lift_rooms.assign(rooms.begin(), rooms.begin() + num_lifts);
+  _lane_base.clear();
+
+  building.name = _options.name;
+  bool ok = true;
+  for (int level_idx = 0; level_idx < _options.num_levels; level_idx++)
+  {
+    Level new_level;
+    new_level.name = "L" + std::to_string(level_idx + 1);
+    new_level.elevation = level_idx * _options.level_height;
+    new_level.drawing_meters_per_pixel = _options.meters_per_pixel;
+    new_level.x_meters = _options.width + 2.0 * MARGIN;
+    new_level.y_meters = _options.depth + 2.0 * MARGIN;
+    building.add_level(std::move(new_level));
+    Level& level = building.levels.back();
+
+    generate_borders();
+    add_walls(building, level_idx);
+    add_lanes(building, level_idx);
+    add_floors(level);
+    add_models(level);
+    add_fiducials(level);
+    if (!_options.image_dir.empty())
+      ok = add_images(level) && ok;
+  }
+  building.reference_level_name = building.levels[0].name;
+
+  add_lifts(building);
+  building.calculate_all_transforms();
+  return ok;
+}
+
+void BuildingGenerator::generate_borders()
+{
+  _vertical.assign((_rooms_x + 1) * _rooms_y, WALL);
+  _horizontal.assign((_rooms_y + 1) * _rooms_x, WALL);
+  _vertical_door_at.assign(_vertical.size(), 0.0);
+  _horizontal_door_at.assign(_horizontal.size(), 0.0);
+
+  // a door is centered on the lane nearest to the middle of its wall, if
+  // that leaves some wall on either side of it
+  auto door_at = [](
+    const double from,
+    const double to,
+    const double lane_step)
+    {
+      const double middle = 0.5 * (from + to);
+      const double lane = (std::floor(middle / lane_step) + 0.5) * lane_step;
+      if (lane - 0.5 * DOOR_WIDTH > from && lane + 0.5 * DOOR_WIDTH < to)
+        return lane;
+      return middle;
+    };
+
+  auto pick = [this]()
+    {
+      if (uniform(0.0, 1.0) >= _options.wall_fraction)
+        return OPEN;
+      return uniform(0.0, 1.0) < _options.door_fraction ? DOOR : WALL;
+    };
+
+  for (int x = 1; x < _rooms_x; x++)
+  {
+    for (int y = 0; y < _rooms_y; y++)
+    {
+      const int i = x * _rooms_y + y;
+      _vertical[i] = pick();
+      _vertical_door_at[i] = door_at(
+        y * room_depth(),
+        (y + 1) * room_depth(),
+        _options.depth / _lanes_y);
+    }
+  }
+  for (int y = 1; y < _rooms_y; y++)
+  {
+    for (int x = 0; x < _rooms_x; x++)
+    {
+      const int i = y * _rooms_x + x;
+      _horizontal[i] = pick();
+      _horizontal_door_at[i] = door_at(
+        x * room_width(),
+        (x + 1) * room_width(),
+        _options.width / _lanes_x);
+    }
+  }
+}
+
+bool BuildingGenerator::lane_blocked(
+  const bool horizontal,
+  const double from,
+  const double to,
+  const double at) const
+{
+  // a horizontal lane crosses the vertical borders, and the other way round
+  const double room_step = horizontal ? room_width() : room_depth();
+  const int num_steps = horizontal ? _rooms_x : _rooms_y;
+  const int row = std::min(
+    static_cast<int>(at / (horizontal ? room_depth() : room_width())),
+    (horizontal ? _rooms_y : _rooms_x) - 1);
+
+  for (int k = 1; k < num_steps; k++)
+  {
+    const double border = k * room_step;
+    if (border <= from || border >= to)
+      continue;
+
+    const int i = horizontal ? k * _rooms_y + row : k * _rooms_x + row;
+    const Border b = horizontal ? _vertical[i] : _horizontal[i];
+    const double door = horizontal ? _vertical_door_at[i] :
+      _horizontal_door_at[i];
+    if (b == WALL)
+      return true;
+    if (b == DOOR && std::abs(at - door) > 0.5 * DOOR_WIDTH)
+      return true;
+  }
+  return false;
+}
+
+void BuildingGenerator::add_walls(Building& building, const int level_idx)
+{
+  Level& level = building.levels[level_idx];
+
+  // the room corners come first, so they are the first vertices
+  for (int y = 0; y <= _rooms_y; y++)
+  {
+    for (int x = 0; x <= _rooms_x; x++)
+      building.add_vertex(
+        level_idx,
+        to_pixels(x * room_width()),
+        to_pixels(y * room_depth()));
+  }
+  auto corner = [this](const int x, const int y)
+    {
+      return y * (_rooms_x + 1) + x;
+    };
+
+  int num_doors = 0;
+  auto add_border = [&](
+    const Border border,
+    const int start,
+    const int end,
+    const bool vertical,
+    const double door_at)
+    {
+      if (border == OPEN)
+        return;
+      if (border == WALL)
+      {
+        building.add_edge(level_idx, start, end, Edge::WALL);
+        return;
+      }
+
+      // split the wall around the doorway
+      const double x = level.vertices[start].x;
+      const double y = level.vertices[start].y;
+      const double a = to_pixels(door_at - 0.5 * DOOR_WIDTH);
+      const double b = to_pixels(door_at + 0.5 * DOOR_WIDTH);
+      const int door_start = static_cast<int>(level.vertices.size());
+      building.add_vertex(level_idx, vertical ? x : a, vertical ? a : y);
+      building.add_vertex(level_idx, vertical ? x : b, vertical ? b : y);
+      building.add_edge(level_idx, start, door_start, Edge::WALL);
+      building.add_edge(level_idx, door_start, door_start + 1, Edge::DOOR);
+      level.edges.back().params["name"] = Param(
+        level.name + "_door_" + std::to_string(++num_doors));
+      building.add_edge(level_idx, door_start + 1, end, Edge::WALL);
+    };
+
+  for (int x = 0; x <= _rooms_x; x++)
+  {
+    for (int y = 0; y < _rooms_y; y++)
+    {
+      const int i = x * _rooms_y + y;
+      add_border(
+        _vertical[i],
+        corner(x, y),
+        corner(x, y + 1),
+        true,
+        _vertical_door_at[i]);
+    }
+  }
+  for (int y = 0; y <= _rooms_y; y++)
+  {
+    for (int x = 0; x < _rooms_x; x++)
+    {
+      const int i = y * _rooms_x + x;
+      add_border(
+        _horizontal[i],
+        corner(x, y),
+        corner(x + 1, y),
+        false,
+        _horizontal_door_at[i]);
+    }
+  }
+
+  // the scale of the level comes from a measurement along its top wall
+  building.add_edge(level_idx, corner(0, 0), corner(_rooms_x, 0), Edge::MEAS);
+  level.edges.back().params["distance"] = Param(_options.width);
+}
+
+void BuildingGenerator::add_lanes(Building& building, const int level_idx)
+{
+  Level& level = building.levels[level_idx];
+  const int base = static_cast<int>(level.vertices.size());
+  _lane_base.push_back(base);
+
+  for (int y = 0; y < _lanes_y; y++)
+  {
+    for (int x = 0; x < _lanes_x; x++)
+      building.add_vertex(
+        level_idx,
+        to_pixels(lane_x(x)),
+        to_pixels(lane_y(y)));
+  }
+
+  for (int graph_idx = 0; graph_idx < _options.num_graphs; graph_idx++)
+  {
+    auto add_lane = [&](const int start, const int end)
+      {
+        if (uniform(0.0, 1.0) >= _options.lane_fraction)
+          return;
+        building.add_edge(level_idx, base + start, base + end, Edge::LANE);
+        level.edges.back().set_graph_idx(graph_idx);
+      };
+
+    for (int y = 0; y < _lanes_y; y++)
+    {
+      for (int x = 0; x < _lanes_x; x++)
+      {
+        const int v = y * _lanes_x + x;
+        if (x + 1 < _lanes_x &&
+          !lane_blocked(true, lane_x(x), lane_x(x + 1), lane_y(y)))
+          add_lane(v, v + 1);
+        if (y + 1 < _lanes_y &&
+          !lane_blocked(false, lane_y(y), lane_y(y + 1), lane_x(x)))
+          add_lane(v, v + _lanes_x);
+      }
+    }
+  }
+}
+
+void BuildingGenerator::add_floors(Level& level)
+{
+  std::vector<int> rooms(_rooms_x * _rooms_y);
+  std::iota(rooms.begin(), rooms.end(), 0);
+  std::shuffle(rooms.begin(), rooms.end(), _rng);
+  if (_options.num_floor_polygons >= 0 &&
+    _options.num_floor_polygons < static_cast<int>(rooms.size()))
+    rooms.resize(_options.num_floor_polygons);
+
+  for (const int room : rooms)
+  {
+    const int x = room % _rooms_x;
+    const int y = room / _rooms_x;
+    const int top_left = y * (_rooms_x + 1) + x;
+    const int bottom_left = top_left + _rooms_x + 1;
+
+    Polygon polygon;
+    polygon.type = Polygon::FLOOR;
+    polygon.vertices =
+    {top_left, top_left + 1, bottom_left + 1, bottom_left};
+    level.polygons.push_back(std::move(polygon));
+  }
+}
+
+void BuildingGenerator::add_models(Level& level)
+{
+  const double margin = std::min(
+    MODEL_CLEARANCE,
+    0.25 * std::min(room_width(), room_depth()));
+
+  for (int i = 0; i < _options.num_models; i++)
+  {
+    const int room = std::uniform_int_distribution<int>(
+      0, _rooms_x * _rooms_y - 1)(_rng);
+    const double x0 = (room % _rooms_x) * room_width();
+    const double y0 = (room / _rooms_x) * room_depth();
+    const std::string& model_name = _options.model_names[
+      std::uniform_int_distribution<std::size_t>(
+        0, _options.model_names.size() - 1)(_rng)];
+
+    Model model;
+    model.model_name = model_name;
+    model.instance_name =
+      model_name.substr(model_name.find_last_of('/') + 1) + "_" +
+      std::to_string(i + 1);
+    model.state.x = to_pixels(uniform(x0 + margin, x0 + room_width() - margin));
+    model.state.y =
+      to_pixels(uniform(y0 + margin, y0 + room_depth() - margin));
+    model.state.yaw = uniform(-M_PI, M_PI);
+    model.starting_level = level.name;
+    level.models.push_back(model);
+  }
+}
+
+void BuildingGenerator::add_fiducials(Level& level)
+{
+  // at the same room corners on every level, so that they align the levels
+  std::mt19937 rng(_options.seed);
+  std::uniform_int_distribution<int> corner_x(0, _rooms_x);
+  std::uniform_int_distribution<int> corner_y(0, _rooms_y);
+
+  for (int i = 0; i < _options.num_fiducials; i++)
+  {
+    int x = 0;
+    int y = 0;
+    if (i < 4)
+    {
+      // the corners of the building first
+      x = (i & 1) ? _rooms_x : 0;
+      y = (i & 2) ? _rooms_y : 0;
+    }
+    else
+    {
+      x = corner_x(rng);
+      y = corner_y(rng);
+    }
+    level.fiducials.push_back(
+      Fiducial(
+        to_pixels(x * room_width()),
+        to_pixels(y * room_depth()),
+        "fiducial_" + std::to_string(i + 1)));
+  }
+}
+
+void BuildingGenerator::add_lifts(Building& building)
+{
+  const double size = std::min(2.0, 0.5 * std::min(room_width(), room_depth()));
+  const double lane_step_x = _options.width / _lanes_x;
+  const double lane_step_y = _options.depth / _lanes_y;
+
+  for (std::size_t lift_idx = 0; lift_idx < _lift_rooms.size(); lift_idx++)
+  {
+    const int room = _lift_rooms[lift_idx];
+    const double cx = ((room % _rooms_x) + 0.5) * room_width();
+    const double cy = ((room / _rooms_x) + 0.5) * room_depth();
+
+    Lift lift;
+    lift.name = "lift_" + std::to_string(lift_idx + 1);
+    lift.reference_floor_name = building.levels.front().name;
+    lift.initial_floor_name = lift.reference_floor_name;
+    lift.x = to_pixels(cx);
+    lift.y = to_pixels(cy);
+    lift.width = size;
+    lift.depth = size;
+    lift.lowest_floor = building.levels.front().name;
+    lift.highest_floor = building.levels.back().name;
+
+    LiftDoor door;
+    door.name = "door";
+    door.y = 0.5 * size;
+    door.width = std::min(DOOR_WIDTH, size);
+    lift.doors.push_back(door);
+
+    // the cabin is joined to the nearest lane vertex, which is in the same
+    // room, in each graph
+    const int nearest_x = std::min(
+      static_cast<int>(cx / lane_step_x), _lanes_x - 1);
+    const int nearest_y = std::min(
+      static_cast<int>(cy / lane_step_y), _lanes_y - 1);
+
+    for (std::size_t level_idx = 0; level_idx < building.levels.size();
+      level_idx++)
+    {
+      Level& level = building.levels[level_idx];
+      lift.level_doors[level.name].push_back(door.name);
+
+      const int cabin = static_cast<int>(level.vertices.size());
+      building.add_vertex(level_idx, lift.x, lift.y);
+      level.vertices.back().params["lift_cabin"] = Param(lift.name);
+
+      const int nearest =
+        _lane_base[level_idx] + nearest_y * _lanes_x + nearest_x;
+      for (int graph_idx = 0; graph_idx < _options.num_graphs; graph_idx++)
+      {
+        building.add_edge(level_idx, cabin, nearest, Edge::LANE);
+        level.edges.back().set_graph_idx(graph_idx);
+      }
+    }
+    building.lifts.push_back(std::move(lift));
+  }
+}
+
+bool BuildingGenerator::add_images(Level& level)
+{
+  const double mpp = _options.meters_per_pixel;
+  QImage image(
+    static_cast<int>(std::ceil(level.x_meters / mpp)),
+    static_cast<int>(std::ceil(level.y_meters / mpp)),
+    QImage::Format_Grayscale8);
+  if (image.isNull())
+  {
+    printf("unable to allocate a %.1f x %.1f m floorplan at %.3f m/pixel\n",
+      level.x_meters, level.y_meters, mpp);
+    return false;
+  }
+  image.fill(255);
+
+  const int half = std::max(1, static_cast<int>(0.5 * WALL_THICKNESS / mpp));
+  for (const Edge& edge : level.edges)
+  {
+    if (edge.type != Edge::WALL)
+      continue;
+    const Vertex& a = level.vertices[edge.start_idx];
+    const Vertex& b = level.vertices[edge.end_idx];
+    fill_rect(
+      image,
+      static_cast<int>(std::min(a.x, b.x)) - half,
+      static_cast<int>(std::min(a.y, b.y)) - half,
+      static_cast<int>(std::max(a.x, b.x)) + half,
+      static_cast<int>(std::max(a.y, b.y)) + half,
+      0);
+  }
+
+  const std::string prefix = _options.name + "_" + level.name;
+  level.drawing_filename = prefix + ".png";
+  level.drawing_width = image.width();
+  level.drawing_height = image.height();
+  const std::string path = _options.image_dir + "/" + level.drawing_filename;
+  if (!image.save(QString::fromStdString(path)))
+  {
+    printf("unable to write %s\n", path.c_str());
+    return false;
+  }
+
+  // Each layer is the floorplan at half the resolution, moved a little.
+  // Its features are room corners, constrained to the same corners in the
+  // floorplan, so that the layer transform can be solved from them.
+  const int num_corners = (_rooms_x + 1) * (_rooms_y + 1);
+  for (int layer_idx = 0; layer_idx < _options.num_layers; layer_idx++)
+  {
+    Layer layer;
+    layer.name = "layer_" + std::to_string(layer_idx + 1);
+    layer.filename = prefix + "_" + layer.name + ".png";
+    layer.transform.setScale(2.0 * mpp);
+    layer.transform.setYaw(uniform(-0.2, 0.2));
+    layer.transform.setTranslation(
+      QPointF(uniform(-MARGIN, MARGIN), uniform(-MARGIN, MARGIN)));
+
+    QImage layer_image(
+      image.width() / 2,
+      image.height() / 2,
+      QImage::Format_Grayscale8);
+    for (int v = 0; v < layer_image.height(); v++)
+    {
+      uchar* line = layer_image.scanLine(v);
+      for (int u = 0; u < layer_image.width(); u++)
+      {
+        const QPointF p = layer.transform.forwards(QPointF(u, v)) / mpp;
+        const int x = static_cast<int>(p.x());
+        const int y = static_cast<int>(p.y());
+        line[u] = image.valid(x, y) ? image.constScanLine(y)[x] : 255;
+      }
+    }
+    const std::string layer_path = _options.image_dir + "/" + layer.filename;
+    if (!layer_image.save(QString::fromStdString(layer_path)))
+    {
+      printf("unable to write %s\n", layer_path.c_str());
+      return false;
+    }
+
+    for (int i = 0; i < _options.features_per_layer; i++)
+    {
+      const Vertex& corner = level.vertices[
+        std::uniform_int_distribution<int>(0, num_corners - 1)(_rng)];
+      level.floorplan_features.push_back(Feature(corner.x, corner.y));
+      layer.features.push_back(
+        Feature(
+          layer.transform.backwards(
+            QPointF(corner.x * mpp, corner.y * mpp))));
+      level.constraints.push_back(
+        Constraint(
+          level.floorplan_features.back().id(),
+          layer.features.back().id()));
+    }
+    level.layers.push_back(std::move(layer));
+  }
+  return true;
+}
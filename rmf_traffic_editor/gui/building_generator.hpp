@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef TRAFFIC_EDITOR__BUILDING_GENERATOR_HPP
+#define TRAFFIC_EDITOR__BUILDING_GENERATOR_HPP
+
+#include <random>
+#include <string>
+#include <vector>
+
+class Building;
+class Level;
+
+//=============================================================================
+/// Fills a Building with a synthetic, but valid, multi-level site of a
+/// chosen size, for stress-testing the editor and the tools built on it.
+/// Each level is a grid of rooms bounded by walls with doors in some of
+/// them, covered by lane graphs which only pass through the doorways, with
+/// floor polygons, models, fiducials and the cabin vertices of the lifts.
+/// The same seed always produces the same building.
+class BuildingGenerator
+{
+public:
+  struct Options
+  {
+    std::string name = "generated";
+    int num_levels = 3;
+    double level_height = 4.0;  // meters between the levels
+    double width = 100.0;  // meters
+    double depth = 60.0;  // meters
+    double room_size = 10.0;  // meters
+    double lane_spacing = 2.0;  // meters between lane graph vertices
+    int num_graphs = 2;
+    double lane_fraction = 0.6;  // of the lane grid edges, in each graph
+    double wall_fraction = 0.5;  // of the borders between rooms
+    double door_fraction = 0.3;  // of those walls, which have a door
+    int num_floor_polygons = -1;  // rooms with a floor polygon, -1 for all
+    int num_models = 50;  // per level
+    std::vector<std::string> model_names;  // empty for a few common ones
+    int num_lifts = 2;
+    int num_fiducials = 4;  // per level, at the same places on each
+    double meters_per_pixel = 0.05;
+
+    /// Write a floorplan image for each level into this directory, and
+    /// layers which are rotated, shifted and scaled copies of it. The
+    /// images are referenced by file name, so this must be the directory
+    /// the building is saved into. Layers need their image, so without
+    /// this there are no layers.
+    std::string image_dir;
+    int num_layers = 1;  // per level
+    int features_per_layer = 6;  // each constrained to a floorplan feature
+
+    unsigned int seed = 1;
+  };
+
+  explicit BuildingGenerator(const Options& options);
+
+  /// Replace the contents of the building with a generated one. Returns
+  /// false if an image could not be written.
+  bool generate(Building& building);
+
+private:
+  enum Border
+  {
+    OPEN = 0,
+    WALL,
+    DOOR
+  };
+
+  Options _options;
+  std::mt19937 _rng;
+
+  int _rooms_x = 1;
+  int _rooms_y = 1;
+  int _lanes_x = 1;
+  int _lanes_y = 1;
+
+  // walls between rooms: _vertical[x * _rooms_y + y] is the border on the
+  // left of room (x, y), _horizontal[y * _rooms_x + x] the one above it,
+  // and the door of a DOOR border is centered on the lane in _door_at
+  std::vector<Border> _vertical, _horizontal;
+  std::vector<double> _vertical_door_at, _horizontal_door_at;
+
+  // the rooms holding the lift cabins, and the first lane vertex of
+  // each level
+  std::vector<int> _lift_rooms;
+  std::vector<int> _lane_base;
+
+  double room_width() const { return _options.width / _rooms_x; }
+  double room_depth() const { return _options.depth / _rooms_y; }
+  double lane_x(const int i) const;
+  double lane_y(const int i) const;
+  double to_pixels(const double meters) const;
+
+  void generate_borders();
+  bool lane_blocked(
+    const bool horizontal,
+    const double from,
+    const double to,
+    const double at) const;
+
+  void add_walls(Building& building, const int level_idx);
+  void add_lanes(Building& building, const int level_idx);
+  void add_floors(Level& level);
+  void add_models(Level& level);
+  void add_fiducials(Level& level);
+  void add_lifts(Building& building);
+  bool add_images(Level& level);
+  double uniform(const double lo, const double hi);
+};
+
+#endif
@@ -0,0 +1,327 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_set>
+
+#include <QDir>
+
+#include "building_merger.hpp"
+#include "spatial_grid.hpp"
+
+namespace {
+
+/// Identifies an edge, to find the ones the target already has. Walls,
+/// doors etc. are the same either way round, but a lane may be one of a
+/// pair of one-way lanes.
+uint64_t edge_key(const Edge& edge)
+{
+  int a = edge.start_idx;
+  int b = edge.end_idx;
+  if (edge.type != Edge::LANE && a > b)
+    std::swap(a, b);
+  return (static_cast<uint64_t>(a) << 36) |
+    (static_cast<uint64_t>(b) << 8) |
+    static_cast<uint64_t>(edge.type);
+}
+
+std::string absolute_path(const QDir& dir, const std::string& path)
+{
+  if (path.empty())
+    return path;
+  return dir.absoluteFilePath(QString::fromStdString(path)).toStdString();
+}
+
+}  // namespace
+
+
+BuildingMerger::BuildingMerger()
+{
+}
+
+BuildingMerger::BuildingMerger(const Options& options)
+: _options(options)
+{
+}
+
+bool BuildingMerger::prepare(
+  const Building& target,
+  const Building& source,
+  const QString& source_dir,
+  Result& result) const
+{
+  result = Result();
+  if (source.levels.empty())
+    return false;
+
+  const QDir dir(source_dir);
+  for (const Level& source_level : source.levels)
+  {
+    const int level_idx = target.find_level_idx(source_level.name);
+    if (level_idx >= 0)
+    {
+      result.levels.push_back(LevelImport());
+      LevelImport& level_import = result.levels.back();
+      level_import.level_idx = level_idx;
+      level_import.name = source_level.name;
+      prepare_level(
+        target.levels[level_idx],
+        source_level,
+        level_import,
+        result.num_skipped_meas);
+      continue;
+    }
+
+    // its images are found relative to the source, not the target
+    result.new_levels.push_back(source_level);
+    Level& level = result.new_levels.back();
+    level.drawing_filename = absolute_path(dir, level.drawing_filename);
+    for (Layer& layer : level.layers)
+      layer.filename = absolute_path(dir, layer.filename);
+  }
+  return true;
+}
+
+void BuildingMerger::prepare_level(
+  const Level& target,
+  const Level& source,
+  LevelImport& level_import,
+  int& num_skipped_meas) const
+{
+  const double target_meters_per_pixel =
+    target.drawing_meters_per_pixel > 0.0 ?
+    target.drawing_meters_per_pixel : 1.0;
+  const double source_meters_per_pixel =
+    source.drawing_meters_per_pixel > 0.0 ?
+    source.drawing_meters_per_pixel : 1.0;
+
+  // the fiducials of the two levels are matched by name
+  std::vector<QPointF> from;
+  std::vector<QPointF> to;
+  for (const Fiducial& source_fiducial : source.fiducials)
+  {
+    if (source_fiducial.name.empty())
+      continue;
+    for (const Fiducial& target_fiducial : target.fiducials)
+    {
+      if (target_fiducial.name == source_fiducial.name)
+      {
+        from.push_back(QPointF(source_fiducial.x, source_fiducial.y));
+        to.push_back(QPointF(target_fiducial.x, target_fiducial.y));
+        break;
+      }
+    }
+  }
+  if (from.size() >= 2)
+    level_import.fit = FiducialAlignment::fit_robust(
+      from,
+      to,
+      true,
+      _options.inlier_threshold / target_meters_per_pixel);
+  level_import.scale = source_meters_per_pixel / target_meters_per_pixel;
+
+  const FiducialAlignment::Fit& fit = level_import.fit;
+  const double scale = level_import.scale;
+  auto map_point = [&fit, scale](const double x, const double y)
+    {
+      if (fit.valid)
+        return fit.apply(QPointF(x, y));
+      return QPointF(scale * x, scale * y);
+    };
+
+  // every vertex of the target and of the import so far is in the grid,
+  // by its index in the level once the import has been appended
+  const double tolerance = _options.tolerance / target_meters_per_pixel;
+  const bool deduplicate = tolerance > 0.0;
+  const int num_target_vertices = static_cast<int>(target.vertices.size());
+  SpatialGrid grid(deduplicate ? tolerance : 1.0);
+  if (deduplicate)
+  {
+    for (int i = 0; i < num_target_vertices; i++)
+      grid.set(i, target.vertices[i].x, target.vertices[i].y);
+  }
+
+  std::vector<int> vertex_map(source.vertices.size(), -1);
+  std::vector<int> nearby;
+  level_import.vertices.reserve(source.vertices.size());
+  for (std::size_t i = 0; i < source.vertices.size(); i++)
+  {
+    const Vertex& source_vertex = source.vertices[i];
+    const QPointF p = map_point(source_vertex.x, source_vertex.y);
+
+    int match = -1;
+    if (deduplicate)
+    {
+      nearby.clear();
+      grid.within(
+        p.x() - tolerance,
+        p.y() - tolerance,
+        p.x() + tolerance,
+        p.y() + tolerance,
+        nearby);
+      double best_distance = tolerance;
+      for (const int id : nearby)
+      {
+        const Vertex& v = id < num_target_vertices ?
+          target.vertices[id] :
+          level_import.vertices[id - num_target_vertices];
+
+        // differently named waypoints stay apart, however close they are
+        if (!v.name.empty() && !source_vertex.name.empty() &&
+          v.name != source_vertex.name)
+          continue;
+        const double distance = std::hypot(v.x - p.x(), v.y - p.y());
+        if (distance <= best_distance)
+        {
+          best_distance = distance;
+          match = id;
+        }
+      }
+    }
+    if (match >= 0)
+    {
+      vertex_map[i] = match;
+      level_import.num_merged_vertices++;
+      continue;
+    }
+
+    const int idx =
+      num_target_vertices + static_cast<int>(level_import.vertices.size());
+    vertex_map[i] = idx;
+    if (deduplicate)
+      grid.set(idx, p.x(), p.y());
+    level_import.vertices.push_back(source_vertex);
+    Vertex& vertex = level_import.vertices.back();
+    vertex.x = p.x();
+    vertex.y = p.y();
+    vertex.selected = false;
+  }
+
+  // one pass over the edges, remapped through vertex_map; those which
+  // collapsed to a point or are already in the target are dropped
+  const int num_source_vertices = static_cast<int>(source.vertices.size());
+  std::unordered_set<uint64_t> edge_keys;
+  edge_keys.reserve(target.edges.size() + source.edges.size());
+  for (const Edge& edge : target.edges)
+    edge_keys.insert(edge_key(edge));
+
+  level_import.edges.reserve(source.edges.size());
+  for (const Edge& source_edge : source.edges)
+  {
+    // the scale of the target comes from its own measurements
+    if (source_edge.type == Edge::MEAS)
+    {
+      num_skipped_meas++;
+      continue;
+    }
+    if (source_edge.start_idx < 0 ||
+      source_edge.start_idx >= num_source_vertices ||
+      source_edge.end_idx < 0 ||
+      source_edge.end_idx >= num_source_vertices)
+    {
+      level_import.num_dropped_edges++;
+      continue;
+    }
+
+    Edge edge = source_edge;
+    edge.start_idx = vertex_map[source_edge.start_idx];
+    edge.end_idx = vertex_map[source_edge.end_idx];
+    edge.selected = false;
+    if (edge.start_idx == edge.end_idx ||
+      !edge_keys.insert(edge_key(edge)).second)
+    {
+      level_import.num_dropped_edges++;
+      continue;
+    }
+    level_import.edges.push_back(std::move(edge));
+  }
+
+  level_import.polygons.reserve(source.polygons.size());
+  for (const Polygon& source_polygon : source.polygons)
+  {
+    Polygon polygon = source_polygon;
+    polygon.selected = false;
+    polygon.vertices.clear();
+    for (const int v : source_polygon.vertices)
+    {
+      if (v < 0 || v >= num_source_vertices)
+        continue;
+      const int idx = vertex_map[v];
+      if (polygon.vertices.empty() || polygon.vertices.back() != idx)
+        polygon.vertices.push_back(idx);
+    }
+    if (polygon.vertices.size() > 1 &&
+      polygon.vertices.front() == polygon.vertices.back())
+      polygon.vertices.pop_back();
+    if (polygon.vertices.size() < 3)
+    {
+      level_import.num_dropped_polygons++;
+      continue;
+    }
+    level_import.polygons.push_back(std::move(polygon));
+  }
+
+  const double yaw = fit.valid ? fit.yaw : 0.0;
+  level_import.models.reserve(source.models.size());
+  for (const Model& source_model : source.models)
+  {
+    level_import.models.push_back(source_model);
+    Model& model = level_import.models.back();
+    const QPointF p = map_point(source_model.state.x, source_model.state.y);
+    model.state.x = p.x();
+    model.state.y = p.y();
+    model.state.yaw += yaw;
+    model.state.level_name = target.name;
+    model.selected = false;
+    model.pixmap_item = nullptr;
+  }
+}
+
+QString BuildingMerger::Result::summary() const
+{
+  QString text;
+  for (const LevelImport& level : levels)
+  {
+    text += QString(
+      "level %1: %2 vertices added, %3 merged; %4 edges added, %5 dropped; "
+      "%6 polygons added, %7 dropped; %8 models added\n")
+      .arg(QString::fromStdString(level.name))
+      .arg(level.vertices.size())
+      .arg(level.num_merged_vertices)
+      .arg(level.edges.size())
+      .arg(level.num_dropped_edges)
+      .arg(level.polygons.size())
+      .arg(level.num_dropped_polygons)
+      .arg(level.models.size());
+    if (level.fit.valid)
+      text += QString("  aligned by %1 of %2 fiducials\n")
+        .arg(level.fit.num_inliers)
+        .arg(level.fit.inliers.size());
+    else
+      text += QString(
+        "  only scaled by %1: less than two fiducials in common\n")
+        .arg(level.scale);
+  }
+  for (const Level& level : new_levels)
+    text += QString("new level %1\n").arg(QString::fromStdString(level.name));
+  if (num_skipped_meas > 0)
+    text += QString("%1 measurements were not imported\n")
+      .arg(num_skipped_meas);
+  return text;
+}
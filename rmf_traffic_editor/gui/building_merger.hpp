@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__BUILDING_MERGER_HPP
+#define TRAFFIC_EDITOR__BUILDING_MERGER_HPP
+
+#include <string>
+#include <vector>
+
+#include <QString>
+
+#include "building.h"
+#include "fiducial_alignment.hpp"
+
+//=============================================================================
+/// Works out what importing the levels, lanes and models of one building
+/// into another adds to it, without changing either of them, so that the
+/// additions can be applied (and undone) by a MergeBuildingCommand.
+///
+/// A level of the source with the name of a level of the target is mapped
+/// onto it through the fiducials they have in common, or only scaled by
+/// their drawing scales if they have less than two. Imported vertices
+/// within the tolerance of a vertex of the target (or of one imported
+/// before) are merged into it, which is found in a SpatialGrid, and the
+/// edges and polygons are remapped in one pass over them. Other levels are
+/// copied as they are.
+class BuildingMerger
+{
+public:
+  struct Options
+  {
+    /// Vertices closer than this are merged, in meters
+    double tolerance = 0.01;
+
+    /// Fiducials further than this from the fit are left out of it, in
+    /// meters
+    double inlier_threshold = 0.5;
+  };
+
+  /// What is appended to one level of the target
+  struct LevelImport
+  {
+    int level_idx = -1;  // of the target
+    std::string name;
+
+    /// How the source level maps onto it; not valid if it is only scaled
+    FiducialAlignment::Fit fit;
+    double scale = 1.0;  // of the fallback, if the fit isn't valid
+
+    std::vector<Vertex> vertices;
+    std::vector<Edge> edges;
+    std::vector<Polygon> polygons;
+    std::vector<Model> models;
+
+    int num_merged_vertices = 0;  // found in the target or the import
+    int num_dropped_edges = 0;  // degenerate or already there
+    int num_dropped_polygons = 0;  // less than three vertices left
+  };
+
+  struct Result
+  {
+    std::vector<LevelImport> levels;
+
+    /// Levels of the source without a match, with absolute image paths
+    std::vector<Level> new_levels;
+
+    int num_skipped_meas = 0;  // the scale of the target is kept
+
+    QString summary() const;
+  };
+
+  BuildingMerger();
+  explicit BuildingMerger(const Options& options);
+
+  /// Fill in the result; the directory of the source is needed to make
+  /// the image paths of its new levels absolute. Returns false if the
+  /// source has no levels.
+  bool prepare(
+    const Building& target,
+    const Building& source,
+    const QString& source_dir,
+    Result& result) const;
+
+private:
+  Options _options;
+
+  void prepare_level(
+    const Level& target,
+    const Level& source,
+    LevelImport& level_import,
+    int& num_skipped_meas) const;
+};
+
+#endif
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <map>
+
+#include "building.h"
+#include "building_snapshot.hpp"
+
+
+const Level* BuildingSnapshot::find_level(const std::string& level_name) const
+{
+  for (const auto& level : levels)
+  {
+    if (level->name == level_name)
+      return level.get();
+  }
+  return nullptr;
+}
+
+std::shared_ptr<Building> BuildingSnapshot::to_building() const
+{
+  auto building = std::make_shared<Building>();
+  building->name = name;
+  building->reference_level_name = reference_level_name;
+  building->levels.reserve(levels.size());
+  for (const auto& level : levels)
+    building->levels.push_back(*level);
+  building->lifts = lifts;
+  building->graphs = graphs;
+  building->params = params;
+  building->coordinate_system = coordinate_system;
+  building->split_files = split_files;
+  if (!filename.empty())
+    building->set_filename(filename);
+  if (crowd_sim_impl)
+    building->crowd_sim_impl =
+      std::make_shared<crowd_sim::CrowdSimImplementation>(*crowd_sim_impl);
+  return building;
+}
+
+std::shared_ptr<const BuildingSnapshot> SnapshotPublisher::publish(
+  const Building& building)
+{
+  // also brings the content hashes of the edited levels up to date
+  const std::uint64_t content_hash = building.content_hash();
+
+  std::shared_ptr<const BuildingSnapshot> previous = latest();
+  if (previous &&
+    previous->content_hash == content_hash &&
+    previous->levels.size() == building.levels.size())
+  {
+    _num_copied = 0;
+    return previous;
+  }
+
+  std::map<std::string, std::size_t> previous_idxs;
+  for (std::size_t i = 0; i < _sources.size(); i++)
+    previous_idxs[_sources[i].name] = i;
+
+  auto snapshot = std::make_shared<BuildingSnapshot>();
+  snapshot->version = ++_version;
+  snapshot->content_hash = content_hash;
+  snapshot->name = building.name;
+  snapshot->reference_level_name = building.reference_level_name;
+  snapshot->filename = building.get_filename();
+  snapshot->split_files = building.split_files;
+  snapshot->coordinate_system = building.coordinate_system;
+  snapshot->lifts = building.lifts;
+  snapshot->graphs = building.graphs;
+  snapshot->params = building.params;
+  if (building.crowd_sim_impl)
+    snapshot->crowd_sim_impl =
+      std::make_shared<crowd_sim::CrowdSimImplementation>(
+      *building.crowd_sim_impl);
+
+  std::vector<Source> sources;
+  sources.reserve(building.levels.size());
+  snapshot->levels.reserve(building.levels.size());
+  _num_copied = 0;
+  for (const Level& level : building.levels)
+  {
+    Source source;
+    source.name = level.name;
+    source.revision = level.revision();
+    source.hash = level.content_hashes().level;
+
+    const auto it = previous_idxs.find(level.name);
+    if (previous && it != previous_idxs.end() &&
+      _sources[it->second].revision == source.revision &&
+      _sources[it->second].hash == source.hash)
+      snapshot->levels.push_back(previous->levels[it->second]);
+    else
+    {
+      auto copy = std::make_shared<Level>(level);
+      copy->unload_images();
+      copy->content_hashes();  // so that no reader has to fill the cache
+      copy->lane_buckets();
+      snapshot->levels.push_back(copy);
+      _num_copied++;
+    }
+    sources.push_back(source);
+  }
+  _sources.swap(sources);
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  _latest = snapshot;
+  return _latest;
+}
+
+std::shared_ptr<const BuildingSnapshot> SnapshotPublisher::latest() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _latest;
+}
+
+void SnapshotPublisher::clear()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _latest.reset();
+  _sources.clear();
+  _num_copied = 0;
+}
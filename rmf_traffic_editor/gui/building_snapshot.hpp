@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__BUILDING_SNAPSHOT_HPP
+#define TRAFFIC_EDITOR__BUILDING_SNAPSHOT_HPP
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "coordinate_system.h"
+#include "graph.h"
+#include "level.h"
+#include "lift.h"
+#include "param.h"
+#include <traffic_editor/crowd_sim/crowd_sim_impl.h>
+
+class Building;
+
+//=============================================================================
+/// What a building saves, as of one moment, for background jobs to read
+/// while it goes on being edited. It is never changed once published, so
+/// any number of threads can read it at once. Its levels are shared with
+/// the previous and next snapshots for as long as they aren't edited, and
+/// are copied without their images, which belong to the GUI thread. Their
+/// content hashes are computed before publishing; only const methods of
+/// Level which fill no other caches (saved_yaml, the uuid lookups) may be
+/// called on them.
+class BuildingSnapshot
+{
+public:
+  std::uint64_t version = 0;  // bumped on each publish that changed it
+  std::uint64_t content_hash = 0;  // see Building::content_hash()
+
+  std::string name;
+  std::string reference_level_name;
+  std::string filename;
+  bool split_files = false;
+  CoordinateSystem coordinate_system;
+  std::vector<std::shared_ptr<const Level>> levels;
+  std::vector<Lift> lifts;
+  std::vector<Graph> graphs;
+  ParamMap params;
+  std::shared_ptr<const crowd_sim::CrowdSimImplementation> crowd_sim_impl;
+
+  /// nullptr if there is no level of this name
+  const Level* find_level(const std::string& level_name) const;
+
+  /// A Building of its own with copies of the levels, for the jobs written
+  /// against Building (saving, simulations, ...): the copying can happen
+  /// on the thread of the job, rather than while the editor waits
+  std::shared_ptr<Building> to_building() const;
+};
+
+//=============================================================================
+/// Publishes the snapshots of a building, copying only the levels which
+/// changed since the last one (as told by Level::revision() and their
+/// content hashes). publish() is for the GUI thread, which owns the
+/// building; latest() can be called from anywhere.
+class SnapshotPublisher
+{
+public:
+  /// The snapshot of the building as it is now, which is the previous one
+  /// if nothing has changed since. Publishing after every command costs
+  /// a copy of the level that the command edited.
+  std::shared_ptr<const BuildingSnapshot> publish(const Building& building);
+
+  std::shared_ptr<const BuildingSnapshot> latest() const;
+
+  /// Forget the previous snapshot, e.g. because another building is being
+  /// edited now
+  void clear();
+
+  /// Levels copied by the last publish(); the others were shared
+  int num_copied() const { return _num_copied; }
+
+private:
+  mutable std::mutex _mutex;
+  std::shared_ptr<const BuildingSnapshot> _latest;
+  std::uint64_t _version = 0;
+  int _num_copied = 0;
+
+  /// What each level of _latest was copied from
+  struct Source
+  {
+    std::string name;
+    std::size_t revision = 0;
+    std::uint64_t hash = 0;
+  };
+  std::vector<Source> _sources;
+};
+
+#endif
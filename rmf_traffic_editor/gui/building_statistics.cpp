@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include <QJsonArray>
+
+#include "building.h"
+#include "building_statistics.hpp"
+
+namespace {
+
+BuildingStatistics::Length& operator+=(
+  BuildingStatistics::Length& a,
+  const BuildingStatistics::Length& b)
+{
+  a.count += b.count;
+  a.meters += b.meters;
+  return a;
+}
+
+BuildingStatistics::Length meters(
+  const LevelStatistics::Sum& sum,
+  const double meters_per_pixel)
+{
+  BuildingStatistics::Length length;
+  length.count = sum.count;
+  length.meters = sum.length * meters_per_pixel;
+  return length;
+}
+
+QJsonObject length_json(const BuildingStatistics::Length& length)
+{
+  QJsonObject o;
+  o["count"] = length.count;
+  o["meters"] = length.meters;
+  return o;
+}
+
+}  // namespace
+
+BuildingStatistics::Length BuildingStatistics::Level::all_lanes() const
+{
+  Length length;
+  for (const auto& it : lanes)
+    length += it.second;
+  return length;
+}
+
+BuildingStatistics::Level& BuildingStatistics::Level::operator+=(
+  const Level& other)
+{
+  vertices += other.vertices;
+  chargers += other.chargers;
+  for (const auto& it : other.lanes)
+    lanes[it.first] += it.second;
+  human_lanes += other.human_lanes;
+  walls += other.walls;
+  doors += other.doors;
+  measurements += other.measurements;
+  floors += other.floors;
+  floor_area += other.floor_area;
+  for (const auto& it : other.models)
+    models[it.first] += it.second;
+  return *this;
+}
+
+void BuildingStatistics::gather(Building& building)
+{
+  levels.clear();
+  for (::Level& level : building.levels)
+  {
+    const LevelStatistics& s = level.statistics();
+    const double mpp = level.drawing_meters_per_pixel;
+
+    Level l;
+    l.name = level.name;
+    l.vertices = s.vertex_count();
+    l.chargers = s.chargers;
+    for (const auto& it : s.lanes)
+      l.lanes[it.first] = meters(it.second, mpp);
+    l.human_lanes = meters(s.human_lanes, mpp);
+    l.walls = meters(s.walls, mpp);
+    l.doors = s.doors;
+    l.measurements = s.measurements;
+    l.floors = s.floors.count;
+    l.floor_area = (s.floors.length - s.holes.length) * mpp * mpp;
+    l.models = s.models;
+    levels.push_back(l);
+  }
+
+  lifts = static_cast<int>(building.lifts.size());
+  lift_doors = 0;
+  for (const Lift& lift : building.lifts)
+    lift_doors += static_cast<int>(lift.doors.size());
+
+  graph_names.clear();
+  for (const Graph& graph : building.graphs)
+  {
+    if (!graph.name.empty())
+      graph_names[graph.idx] = graph.name;
+  }
+}
+
+BuildingStatistics::Level BuildingStatistics::total() const
+{
+  Level total;
+  total.name = "all levels";
+  for (const Level& level : levels)
+    total += level;
+  return total;
+}
+
+QString BuildingStatistics::summary() const
+{
+  QString s;
+  auto add_level = [this, &s](const Level& level)
+    {
+      s += QString::fromStdString(level.name) + ":\n";
+      s += QString::asprintf("  %-28s %10d\n", "vertices", level.vertices);
+      s += QString::asprintf("  %-28s %10d\n", "chargers", level.chargers);
+      for (const auto& it : level.lanes)
+      {
+        QString title = QString::asprintf("lanes of graph %d", it.first);
+        const auto name_it = graph_names.find(it.first);
+        if (name_it != graph_names.end())
+          title += " (" + QString::fromStdString(name_it->second) + ")";
+        s += QString::asprintf("  %-28s %10d %10.3f km\n",
+            qUtf8Printable(title),
+            it.second.count,
+            it.second.meters / 1000.0);
+      }
+      s += QString::asprintf("  %-28s %10d %10.3f km\n",
+          "human lanes",
+          level.human_lanes.count,
+          level.human_lanes.meters / 1000.0);
+      s += QString::asprintf("  %-28s %10d %10.1f m\n",
+          "walls",
+          level.walls.count,
+          level.walls.meters);
+      s += QString::asprintf("  %-28s %10d\n", "doors", level.doors);
+      s += QString::asprintf("  %-28s %10d\n",
+          "measurements",
+          level.measurements);
+      s += QString::asprintf("  %-28s %10d %10.1f m2\n",
+          "floors",
+          level.floors,
+          level.floor_area);
+      for (const auto& it : level.models)
+        s += QString::asprintf("  %-28s %10d\n",
+            qUtf8Printable("model " + QString::fromStdString(it.first)),
+            it.second);
+    };
+
+  for (const Level& level : levels)
+    add_level(level);
+  if (levels.size() > 1)
+    add_level(total());
+  s += QString::asprintf("%-30s %10d\n", "lifts", lifts);
+  s += QString::asprintf("%-30s %10d\n", "lift doors", lift_doors);
+  return s;
+}
+
+QJsonObject BuildingStatistics::to_json() const
+{
+  auto level_json = [this](const Level& level)
+    {
+      QJsonArray lanes;
+      for (const auto& it : level.lanes)
+      {
+        QJsonObject o = length_json(it.second);
+        o["graph"] = it.first;
+        const auto name_it = graph_names.find(it.first);
+        if (name_it != graph_names.end())
+          o["name"] = QString::fromStdString(name_it->second);
+        lanes.append(o);
+      }
+
+      QJsonObject models;
+      for (const auto& it : level.models)
+        models[QString::fromStdString(it.first)] = it.second;
+
+      QJsonObject o;
+      o["name"] = QString::fromStdString(level.name);
+      o["vertices"] = level.vertices;
+      o["chargers"] = level.chargers;
+      o["lanes"] = lanes;
+      o["human_lanes"] = length_json(level.human_lanes);
+      o["walls"] = length_json(level.walls);
+      o["doors"] = level.doors;
+      o["measurements"] = level.measurements;
+      o["floors"] = level.floors;
+      o["floor_area"] = level.floor_area;
+      o["models"] = models;
+      return o;
+    };
+
+  QJsonArray levels_json;
+  for (const Level& level : levels)
+    levels_json.append(level_json(level));
+
+  QJsonObject json;
+  json["levels"] = levels_json;
+  json["total"] = level_json(total());
+  json["lifts"] = lifts;
+  json["lift_doors"] = lift_doors;
+  return json;
+}
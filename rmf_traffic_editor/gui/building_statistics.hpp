@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef TRAFFIC_EDITOR__BUILDING_STATISTICS_HPP
+#define TRAFFIC_EDITOR__BUILDING_STATISTICS_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <QJsonObject>
+#include <QString>
+
+class Building;
+
+//=============================================================================
+/// The figures which site reviews ask for: lane lengths per graph, vertex,
+/// charger, door and lift counts, floor areas and models per type, for each
+/// level and the whole building. Gathered from the statistics that every
+/// Level keeps up to date as it is edited (see LevelStatistics), so
+/// gathering them again after an edit is cheap on any size of map.
+class BuildingStatistics
+{
+public:
+  struct Length
+  {
+    int count = 0;
+    double meters = 0.0;
+  };
+
+  struct Level
+  {
+    std::string name;
+    int vertices = 0;
+    int chargers = 0;
+    std::map<int, Length> lanes;  // by graph index
+    Length human_lanes;
+    Length walls;
+    int doors = 0;
+    int measurements = 0;
+    int floors = 0;
+    double floor_area = 0.0;  // square meters, without the holes
+    std::map<std::string, int> models;  // by model name
+
+    Length all_lanes() const;
+    Level& operator+=(const Level& other);
+  };
+
+  /// Gather the statistics of every level (counting the edits since they
+  /// were last gathered) and of the lifts, replacing what was gathered
+  void gather(Building& building);
+
+  std::vector<Level> levels;
+  int lifts = 0;
+  int lift_doors = 0;
+  std::map<int, std::string> graph_names;  // of the graphs with a name
+
+  /// All levels added up
+  Level total() const;
+
+  /// Human-readable table, one line per figure of each level
+  QString summary() const;
+
+  /// Everything, as {"levels": [{"name", "vertices", "chargers", "lanes":
+  /// [{"graph", "name", "count", "meters"}], "human_lanes", "walls",
+  /// "doors", "measurements", "floors", "floor_area", "models": {name:
+  /// count}}, ...], "total": {as a level}, "lifts", "lift_doors"}
+  QJsonObject to_json() const;
+};
+
+#endif
@@ -0,0 +1,1433 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iterator>
+#include <locale>
+#include <set>
+#include <sstream>
+
+#include <QFile>
+#include <QtConcurrent/QtConcurrent>
+
+#include "building_stream_parser.hpp"
+
+using std::string;
+
+namespace {
+
+enum SectionKind
+{
+  VERTICES = 0,  // in the order Level::from_yaml() reads them
+  LANES,
+  WALLS,
+  MEASUREMENTS,
+  DOORS,
+  HUMAN_LANES,
+  FLOORS,
+  HOLES,
+  NUM_SECTION_KINDS
+};
+
+const char* const section_keys[NUM_SECTION_KINDS] =
+{
+  "vertices",
+  "lanes",
+  "walls",
+  "measurements",
+  "doors",
+  "human_lanes",
+  "floors",
+  "holes"
+};
+
+int section_kind(const string& key)
+{
+  for (int i = 0; i < NUM_SECTION_KINDS; i++)
+  {
+    if (key == section_keys[i])
+      return i;
+  }
+  return -1;
+}
+
+Edge::Type edge_type(const int kind)
+{
+  switch (kind)
+  {
+    case LANES: return Edge::LANE;
+    case WALLS: return Edge::WALL;
+    case MEASUREMENTS: return Edge::MEAS;
+    case DOORS: return Edge::DOOR;
+    case HUMAN_LANES: return Edge::HUMAN_LANE;
+    default: return Edge::UNDEFINED;
+  }
+}
+
+/// Block sequences are parsed in chunks of about this size, split between
+/// their items, so that a single huge level still keeps every core busy
+const std::ptrdiff_t CHUNK_BYTES = 1 << 20;
+
+bool is_space(const char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+bool is_digit(const char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+//-----------------------------------------------------------------------------
+struct Line
+{
+  const char* begin = nullptr;
+  const char* content = nullptr;  // the first character after the indent
+  const char* end = nullptr;  // before the line break
+  const char* next = nullptr;  // the start of the next line
+
+  int indent() const { return static_cast<int>(content - begin); }
+};
+
+Line read_line(const char* p, const char* end)
+{
+  Line line;
+  line.begin = p;
+  while (p < end && *p == ' ')
+    p++;
+  line.content = p;
+  const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+  line.next = newline ? newline + 1 : end;
+  line.end = newline ? newline : end;
+  if (line.end > line.content && line.end[-1] == '\r')
+    line.end--;
+  return line;
+}
+
+/// Empty, or only a comment
+bool is_blank(const Line& line)
+{
+  const char* p = line.content;
+  while (p < line.end && (*p == ' ' || *p == '\t'))
+    p++;
+  return p == line.end || *p == '#';
+}
+
+/// Starts with an item of a block sequence
+bool is_item(const Line& line)
+{
+  return line.content < line.end && *line.content == '-' &&
+    (line.content + 1 == line.end ||
+    line.content[1] == ' ' || line.content[1] == '\t');
+}
+
+bool is_document_marker(const Line& line)
+{
+  if (line.indent() != 0 || line.end - line.content < 3)
+    return false;
+  if (memcmp(line.content, "---", 3) != 0 &&
+    memcmp(line.content, "...", 3) != 0)
+    return false;
+  return line.end - line.content == 3 || is_space(line.content[3]);
+}
+
+/// The start of the first line from p on which isn't part of the value of
+/// a key at this indent: one which is less indented, or as indented and
+/// not an item of a sequence
+const char* end_of_value(const char* p, const char* end, const int indent)
+{
+  while (p < end)
+  {
+    const Line line = read_line(p, end);
+    if (!is_blank(line) &&
+      (line.indent() < indent || (line.indent() == indent && !is_item(line))))
+      return p;
+    p = line.next;
+  }
+  return end;
+}
+
+/// yaml-cpp reads these plain scalars as null
+bool is_null(const char* begin, const char* end)
+{
+  const std::size_t n = end - begin;
+  return n == 0 || (n == 1 && *begin == '~') ||
+    (n == 4 && (!memcmp(begin, "null", 4) || !memcmp(begin, "Null", 4) ||
+    !memcmp(begin, "NULL", 4)));
+}
+
+void append_utf8(string& out, const uint32_t code_point)
+{
+  if (code_point < 0x80)
+    out += static_cast<char>(code_point);
+  else if (code_point < 0x800)
+  {
+    out += static_cast<char>(0xc0 | (code_point >> 6));
+    out += static_cast<char>(0x80 | (code_point & 0x3f));
+  }
+  else if (code_point < 0x10000)
+  {
+    out += static_cast<char>(0xe0 | (code_point >> 12));
+    out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3f));
+    out += static_cast<char>(0x80 | (code_point & 0x3f));
+  }
+  else
+  {
+    out += static_cast<char>(0xf0 | (code_point >> 18));
+    out += static_cast<char>(0x80 | ((code_point >> 12) & 0x3f));
+    out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3f));
+    out += static_cast<char>(0x80 | (code_point & 0x3f));
+  }
+}
+
+/// Which yaml-cpp accepts for booleans: all lowercase, all uppercase, or
+/// capitalized
+bool is_flexible_case(const string& s)
+{
+  auto all = [](const char* p, const char* end, int (*f)(int))
+    {
+      for (; p < end; p++)
+      {
+        if (!f(static_cast<unsigned char>(*p)))
+          return false;
+      }
+      return true;
+    };
+  const char* begin = s.data();
+  const char* end = begin + s.size();
+  if (s.empty() || all(begin, end, islower))
+    return true;
+  return isupper(static_cast<unsigned char>(s[0])) &&
+    (all(begin + 1, end, islower) || all(begin + 1, end, isupper));
+}
+
+//-----------------------------------------------------------------------------
+struct Scalar
+{
+  const char* begin = nullptr;  // inside the quotes, if any
+  const char* end = nullptr;
+  char quote = 0;
+};
+
+/// Reads tokens from [begin, end) of the text which starts at origin. The
+/// first failure is kept in error, with its line number.
+class Reader
+{
+public:
+  Reader(const char* origin, const char* begin, const char* end)
+  : p(begin), _origin(origin), _end(end)
+  {
+  }
+
+  const char* p;
+  string error;
+
+  const char* end() const { return _end; }
+  bool at_end() const { return p >= _end; }
+
+  bool fail(const string& message)
+  {
+    if (error.empty())
+    {
+      const long line_idx = std::count(_origin, std::min(p, _end), '\n') + 1;
+      error = "line " + std::to_string(line_idx) + ": " + message;
+    }
+    return false;
+  }
+
+  void skip_inline_space()
+  {
+    while (p < _end && (*p == ' ' || *p == '\t'))
+      p++;
+  }
+
+  /// Only a comment or nothing is left of this line. Doesn't consume it.
+  bool rest_of_line_blank()
+  {
+    skip_inline_space();
+    return p >= _end || *p == '\r' || *p == '\n' || *p == '#';
+  }
+
+  /// Skip to the start of the next line, of which only a comment is left
+  bool finish_line()
+  {
+    const char* const start = p;
+    skip_inline_space();
+    if (p < _end && *p == '#')
+    {
+      if (p == start && p > _origin && !is_space(p[-1]))
+        return fail("a comment needs a space before it");
+      const char* newline =
+        static_cast<const char*>(memchr(p, '\n', _end - p));
+      p = newline ? newline : _end;
+    }
+    if (p < _end && *p == '\r')
+      p++;
+    if (p < _end && *p != '\n')
+      return fail("unexpected text after the item");
+    if (p < _end)
+      p++;
+    return true;
+  }
+
+  /// Between flow tokens, line breaks and comments are white space
+  void skip_flow_space()
+  {
+    while (p < _end)
+    {
+      if (is_space(*p))
+        p++;
+      else if (*p == '#' && (p == _origin || is_space(p[-1])))
+      {
+        const char* newline =
+          static_cast<const char*>(memchr(p, '\n', _end - p));
+        p = newline ? newline : _end;
+      }
+      else
+        break;
+    }
+  }
+
+  char peek()
+  {
+    skip_flow_space();
+    return p < _end ? *p : 0;
+  }
+
+  /// Consume the next token if it's c
+  bool accept(const char c)
+  {
+    if (peek() != c)
+      return false;
+    p++;
+    return true;
+  }
+
+  bool expect(const char c)
+  {
+    if (accept(c))
+      return true;
+    return fail(string("expected '") + c + "'");
+  }
+
+  bool scalar(Scalar& s)
+  {
+    skip_flow_space();
+    if (p >= _end)
+      return fail("expected a scalar");
+    const char c = *p;
+    if (c == '"' || c == '\'')
+      return quoted(s);
+    if (c == 0 || strchr(",[]{}#&*!|>%@`?:", c) ||
+      (c == '-' && (p + 1 == _end || is_space(p[1]))))
+      return fail("expected a plain scalar, without anchor, alias or tag");
+
+    s.quote = 0;
+    s.begin = p;
+    while (p < _end)
+    {
+      const char ch = *p;
+      if (ch == ',' || ch == '[' || ch == ']' || ch == '{' || ch == '}' ||
+        ch == '\r' || ch == '\n')
+        break;
+      if (ch == ':' &&
+        (p + 1 == _end || is_space(p[1]) || strchr(",[]{}", p[1])))
+        break;
+      if (ch == '#' && is_space(p[-1]))
+        break;
+      p++;
+    }
+    s.end = p;
+    while (s.end > s.begin && (s.end[-1] == ' ' || s.end[-1] == '\t'))
+      s.end--;
+    return true;
+  }
+
+  /// A key of a block map, up to and including its colon
+  bool block_key(string& key)
+  {
+    skip_inline_space();
+    Scalar s;
+    if (p < _end && (*p == '"' || *p == '\''))
+    {
+      if (!quoted(s))
+        return false;
+      skip_inline_space();
+      if (p >= _end || *p != ':')
+        return fail("expected ':'");
+      p++;
+    }
+    else
+    {
+      if (p >= _end || *p == 0 || strchr("-?:,[]{}#&*!|>'\"%@`", *p))
+        return fail("expected a plain or quoted key");
+      s.begin = p;
+      while (!(*p == ':' && (p + 1 == _end || is_space(p[1]))))
+      {
+        if (*p == '\r' || *p == '\n' || (*p == '#' && is_space(p[-1])))
+          return fail("expected a key");
+        if (++p >= _end)
+          return fail("expected a key");
+      }
+      s.end = p++;
+      while (s.end > s.begin && (s.end[-1] == ' ' || s.end[-1] == '\t'))
+        s.end--;
+    }
+    if (p < _end && !is_space(*p))
+      return fail("expected a space after ':'");
+    return to_string(s, key);
+  }
+
+  bool to_string(const Scalar& s, string& out)
+  {
+    if (!s.quote)
+    {
+      if (is_null(s.begin, s.end))
+        return fail("null where a string was expected");
+      out.assign(s.begin, s.end);
+      return true;
+    }
+    out.clear();
+    if (s.quote == '\'')
+    {
+      for (const char* q = s.begin; q < s.end; q++)
+      {
+        out += *q;
+        if (*q == '\'')
+          q++;  // the second of ''
+      }
+      return true;
+    }
+    return unescape(s, out);
+  }
+
+  bool to_double(const Scalar& s, double& value)
+  {
+    if (s.quote)
+    {
+      string text;
+      if (!to_string(s, text))
+        return false;
+      Scalar unquoted;
+      unquoted.begin = text.data();
+      unquoted.end = text.data() + text.size();
+      return to_double(unquoted, value);
+    }
+
+    // up to 15 digits and a power of ten of up to 22 are exact in a
+    // double, so one multiplication or division rounds correctly
+    static const double powers_of_ten[] =
+    {
+      1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const char* q = s.begin;
+    bool negative = false;
+    if (q < s.end && (*q == '+' || *q == '-'))
+      negative = *q++ == '-';
+    uint64_t mantissa = 0;
+    int significant_digits = 0;
+    int exponent = 0;
+    bool any_digits = false;
+    auto add_digit = [&](const char c)
+      {
+        any_digits = true;
+        if (mantissa == 0 && c == '0')
+          return;
+        if (++significant_digits <= 15)
+          mantissa = mantissa * 10 + (c - '0');
+      };
+    for (; q < s.end && is_digit(*q); q++)
+      add_digit(*q);
+    if (q < s.end && *q == '.')
+    {
+      for (q++; q < s.end && is_digit(*q); q++)
+      {
+        add_digit(*q);
+        exponent--;
+      }
+    }
+    if (!any_digits)
+      return fail("expected a number");
+    if (q < s.end && (*q == 'e' || *q == 'E'))
+    {
+      q++;
+      bool negative_exponent = false;
+      if (q < s.end && (*q == '+' || *q == '-'))
+        negative_exponent = *q++ == '-';
+      if (q == s.end || !is_digit(*q))
+        return fail("expected a number");
+      int e = 0;
+      for (; q < s.end && is_digit(*q); q++)
+        e = std::min(e * 10 + (*q - '0'), 100000);
+      exponent += negative_exponent ? -e : e;
+    }
+    if (q != s.end)
+      return fail("expected a number");
+
+    if (significant_digits <= 15 && exponent >= -22 && exponent <= 22)
+    {
+      const double m = static_cast<double>(mantissa);
+      value = exponent >= 0 ?
+        m * powers_of_ten[exponent] : m / powers_of_ten[-exponent];
+      if (negative)
+        value = -value;
+      return true;
+    }
+
+    // the rest are read as yaml-cpp reads them
+    std::istringstream stream(string(s.begin, s.end));
+    stream.imbue(std::locale::classic());
+    stream >> std::noskipws >> value;
+    if (stream.fail() || !(stream >> std::ws).eof())
+      return fail("expected a number");
+    return true;
+  }
+
+  bool to_int(const Scalar& s, int& value)
+  {
+    string text;
+    if (s.quote && !to_string(s, text))
+      return false;
+    const char* q = s.quote ? text.data() : s.begin;
+    const char* const end = s.quote ? text.data() + text.size() : s.end;
+
+    // leading zeros are octal to some versions of yaml-cpp
+    bool negative = false;
+    if (q < end && (*q == '+' || *q == '-'))
+      negative = *q++ == '-';
+    if (q == end || end - q > 9 || (*q == '0' && end - q > 1))
+      return fail("expected an integer");
+    int magnitude = 0;
+    for (; q < end; q++)
+    {
+      if (!is_digit(*q))
+        return fail("expected an integer");
+      magnitude = magnitude * 10 + (*q - '0');
+    }
+    value = negative ? -magnitude : magnitude;
+    return true;
+  }
+
+  bool to_bool(const Scalar& s, bool& value)
+  {
+    string text;
+    if (!to_string(s, text))
+      return false;
+    if (is_flexible_case(text))
+    {
+      std::transform(text.begin(), text.end(), text.begin(), ::tolower);
+      if (text == "y" || text == "yes" || text == "true" || text == "on")
+      {
+        value = true;
+        return true;
+      }
+      if (text == "n" || text == "no" || text == "false" || text == "off")
+      {
+        value = false;
+        return true;
+      }
+    }
+    return fail("expected a boolean");
+  }
+
+  /// A flow sequence, calling element(idx) for each element
+  template<typename F>
+  bool sequence(F element)
+  {
+    if (!expect('['))
+      return false;
+    for (int idx = 0; ; idx++)
+    {
+      if (accept(']'))
+        return true;
+      if (!element(idx))
+        return false;
+      if (!accept(','))
+        return expect(']');
+    }
+  }
+
+  /// A flow map, calling entry(key) to read the value of each key
+  template<typename F>
+  bool mapping(F entry)
+  {
+    if (!expect('{'))
+      return false;
+    while (true)
+    {
+      if (accept('}'))
+        return true;
+      Scalar key;
+      string key_string;
+      if (!scalar(key) || !to_string(key, key_string) || !expect(':'))
+        return false;
+      if (p < _end && !is_space(*p))
+        return fail("expected a space after ':'");
+      if (!entry(key_string))
+        return false;
+      if (!accept(','))
+        return expect('}');
+    }
+  }
+
+  bool skip_node(const int depth = 0)
+  {
+    if (depth > 32)
+      return fail("nested too deeply");
+    const char c = peek();
+    if (c == '[')
+      return sequence([&](int) { return skip_node(depth + 1); });
+    if (c == '{')
+      return mapping([&](const string&) { return skip_node(depth + 1); });
+    Scalar s;
+    return scalar(s);
+  }
+
+  /// As Param::from_yaml() reads it
+  bool param(Param& param)
+  {
+    int size = 0;
+    const bool ok = sequence(
+      [&](const int idx)
+      {
+        size = idx + 1;
+        Scalar s;
+        if (idx > 1)
+          return skip_node();
+        if (!scalar(s))
+          return false;
+        if (idx == 0)
+        {
+          int type = 0;
+          if (!to_int(s, type))
+            return false;
+          param.type = static_cast<Param::Type>(type);
+          return true;
+        }
+        switch (param.type)
+        {
+          case Param::STRING: return to_string(s, param.value_string);
+          case Param::INT: return to_int(s, param.value_int);
+          case Param::DOUBLE: return to_double(s, param.value_double);
+          case Param::BOOL: return to_bool(s, param.value_bool);
+          default: return fail("unknown param type");
+        }
+      });
+    return ok && (size >= 2 || fail("expected a type and a value"));
+  }
+
+  /// What the from_yaml() functions find when they iterate over a params
+  /// node: nothing in a scalar or an empty sequence
+  bool params(ParamMap& params)
+  {
+    const char c = peek();
+    if (c == '{')
+    {
+      return mapping(
+        [&](const string& key)
+        {
+          Param value;
+          if (!param(value))
+            return fail("expected a param");
+          params[key] = value;
+          return true;
+        });
+    }
+    if (c == '[')
+    {
+      p++;
+      return accept(']') || fail("expected a map of params");
+    }
+    Scalar s;
+    return scalar(s);
+  }
+
+  bool vertex(Vertex& v)
+  {
+    int size = 0;
+    const bool ok = sequence(
+      [&](const int idx)
+      {
+        size = idx + 1;
+        Scalar s;
+        switch (idx)
+        {
+          case 0: return scalar(s) && to_double(s, v.x);
+          case 1: return scalar(s) && to_double(s, v.y);
+          case 3: return scalar(s) && to_string(s, v.name);
+          case 4: return params(v.params);
+          default: return skip_node();  // the z offset is unused
+        }
+      });
+    return ok && (size >= 2 || fail("expected a vertex"));
+  }
+
+  bool edge(Edge& e)
+  {
+    int size = 0;
+    const bool ok = sequence(
+      [&](const int idx)
+      {
+        size = idx + 1;
+        Scalar s;
+        double value = 0;
+        switch (idx)
+        {
+          case 0:
+          case 1:
+            // Edge::from_yaml() reads the indices as doubles
+            if (!scalar(s) || !to_double(s, value))
+              return false;
+            if (!(value > -2147483648.0 && value < 2147483648.0))
+              return fail("vertex index out of range");
+            (idx == 0 ? e.start_idx : e.end_idx) = static_cast<int>(value);
+            return true;
+          case 2:
+            return params(e.params);
+          default:
+            return skip_node();
+        }
+      });
+    return ok && (size >= 2 || fail("expected an edge"));
+  }
+
+  /// The value of one key of a polygon map
+  bool polygon_entry(
+    const string& key,
+    Polygon& polygon,
+    bool& seen_vertices,
+    bool& seen_params)
+  {
+    if (key == "vertices")
+    {
+      if (seen_vertices)
+        return fail("vertices appears twice");
+      seen_vertices = true;
+      const char c = peek();
+      if (c == '{')
+        return fail("expected a sequence of vertices");
+      if (c != '[')
+      {
+        Scalar s;
+        return scalar(s);
+      }
+      return sequence(
+        [&](int)
+        {
+          Scalar s;
+          int idx = 0;
+          if (!scalar(s) || !to_int(s, idx))
+            return false;
+          polygon.vertices.push_back(idx);
+          return true;
+        });
+    }
+    if (key == "parameters")
+    {
+      if (seen_params)
+        return fail("parameters appears twice");
+      seen_params = true;
+      return params(polygon.params);
+    }
+    return skip_node();
+  }
+
+  bool flow_polygon(Polygon& polygon)
+  {
+    bool seen_vertices = false;
+    bool seen_params = false;
+    return mapping(
+      [&](const string& key)
+      {
+        return polygon_entry(key, polygon, seen_vertices, seen_params);
+      });
+  }
+
+  /// "- key: value", with any further keys on lines of their own at the
+  /// same column and their values on the same line
+  bool block_polygon(Polygon& polygon, const int column)
+  {
+    bool seen_vertices = false;
+    bool seen_params = false;
+    while (true)
+    {
+      string key;
+      if (!block_key(key))
+        return false;
+      if (rest_of_line_blank())
+        return fail("values on lines of their own aren't supported");
+      if (!polygon_entry(key, polygon, seen_vertices, seen_params) ||
+        !finish_line())
+        return false;
+
+      const char* q = p;
+      Line line;
+      bool more = false;
+      while (q < _end)
+      {
+        line = read_line(q, _end);
+        if (!is_blank(line))
+        {
+          more = line.indent() >= column;
+          break;
+        }
+        q = line.next;
+      }
+      if (!more)
+      {
+        p = q;
+        return true;
+      }
+      p = line.content;
+      if (line.indent() != column || *p == '\t')
+        return fail("unexpected indentation");
+    }
+  }
+
+  /// The items of a block sequence, up to the end. item(column) reads an
+  /// item which starts at this column of the current line, and the rest
+  /// of its lines.
+  template<typename F>
+  bool block_items(F item)
+  {
+    int indent = -1;
+    while (p < _end)
+    {
+      const Line line = read_line(p, _end);
+      if (is_blank(line))
+      {
+        p = line.next;
+        continue;
+      }
+      if (indent < 0)
+        indent = line.indent();
+      p = line.content;
+      if (line.indent() != indent || !is_item(line))
+        return fail("expected an item of the sequence");
+      while (++p < line.end && *p == ' ')
+        ;
+      if (p < line.end && *p == '\t')
+        return fail("tabs after '-' aren't supported");
+      if (rest_of_line_blank())
+        return fail("items on lines of their own aren't supported");
+      if (!item(static_cast<int>(p - line.begin)))
+        return false;
+    }
+    return true;
+  }
+
+private:
+  const char* _origin;
+  const char* _end;
+
+  bool quoted(Scalar& s)
+  {
+    s.quote = *p++;
+    s.begin = p;
+    while (p < _end)
+    {
+      const char ch = *p;
+      if (ch == '\r' || ch == '\n')
+        return fail("multi-line quoted scalars aren't supported");
+      if (s.quote == '"' && ch == '\\')
+      {
+        p += 2;
+        continue;
+      }
+      if (ch == s.quote)
+      {
+        if (s.quote == '\'' && p + 1 < _end && p[1] == '\'')
+        {
+          p += 2;
+          continue;
+        }
+        s.end = p++;
+        return true;
+      }
+      p++;
+    }
+    return fail("unterminated quoted scalar");
+  }
+
+  bool unescape(const Scalar& s, string& out)
+  {
+    for (const char* q = s.begin; q < s.end; q++)
+    {
+      if (*q != '\\')
+      {
+        out += *q;
+        continue;
+      }
+      if (++q >= s.end)
+        return fail("bad escape sequence");
+      int hex_digits = 0;
+      switch (*q)
+      {
+        case '0': out += '\0'; break;
+        case 'a': out += '\a'; break;
+        case 'b': out += '\b'; break;
+        case 't':
+        case '\t': out += '\t'; break;
+        case 'n': out += '\n'; break;
+        case 'v': out += '\v'; break;
+        case 'f': out += '\f'; break;
+        case 'r': out += '\r'; break;
+        case 'e': out += '\x1b'; break;
+        case ' ': out += ' '; break;
+        case '"': out += '"'; break;
+        case '/': out += '/'; break;
+        case '\\': out += '\\'; break;
+        case 'x': hex_digits = 2; break;
+        case 'u': hex_digits = 4; break;
+        case 'U': hex_digits = 8; break;
+        default: return fail("unsupported escape sequence");
+      }
+      if (!hex_digits)
+        continue;
+      if (s.end - q <= hex_digits)
+        return fail("bad escape sequence");
+      uint32_t code_point = 0;
+      for (int i = 0; i < hex_digits; i++)
+      {
+        const char c = *++q;
+        int digit = -1;
+        if (is_digit(c))
+          digit = c - '0';
+        else if (c >= 'a' && c <= 'f')
+          digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+          digit = c - 'A' + 10;
+        if (digit < 0)
+          return fail("bad escape sequence");
+        code_point = code_point * 16 + digit;
+      }
+      if (code_point > 0x10ffff ||
+        (code_point >= 0xd800 && code_point <= 0xdfff))
+        return fail("unsupported escape sequence");
+      append_utf8(out, code_point);
+    }
+    return true;
+  }
+};
+
+//-----------------------------------------------------------------------------
+/// An entity section of a level, or a part of one, which is parsed on the
+/// thread pool
+struct Chunk
+{
+  string level_name;
+  int kind = VERTICES;
+  const char* begin = nullptr;
+  const char* end = nullptr;
+  bool flow = false;  // a flow sequence, rather than block sequence items
+
+  std::vector<Vertex> vertices;
+  std::vector<Edge> edges;
+  std::vector<Polygon> polygons;
+  string error;
+};
+
+/// Finds the entity sections of the levels, and cuts them out of the rest
+class Index
+{
+public:
+  Index(const char* begin, const char* end)
+  : _reader(begin, begin, end), _copied(begin)
+  {
+  }
+
+  std::vector<Chunk> chunks;
+  string rest;
+
+  const string& error() const { return _reader.error; }
+
+  bool find_sections(const string& levels_key)
+  {
+    if (levels_key.empty())
+      return find_levels(-1);
+
+    bool seen_levels = false;
+    while (!_reader.at_end())
+    {
+      const Line line = read_line(_reader.p, _reader.end());
+      if (is_blank(line))
+      {
+        _reader.p = line.next;
+        continue;
+      }
+      if (!document_marker_ok(line))
+      {
+        if (!_reader.error.empty())
+          return false;
+        _reader.p = line.next;
+        continue;
+      }
+      _seen_content = true;
+
+      // the levels are found if they're a block map of a plain key
+      if (!is_block_map_key(line, levels_key))
+      {
+        const char* const value_end =
+          end_of_value(line.next, _reader.end(), line.indent());
+        if (!skip(line.content, value_end))
+          return false;
+        continue;
+      }
+      if (seen_levels)
+        return _reader.fail(levels_key + " appears twice");
+      seen_levels = true;
+      _reader.p = line.next;
+      if (!find_levels(0))
+        return false;
+    }
+    return true;
+  }
+
+  void finish()
+  {
+    rest.append(_copied, _reader.end() - _copied);
+  }
+
+private:
+  Reader _reader;
+  const char* _copied;  // the rest is copied up to here
+  bool _seen_content = false;
+  std::set<string> _level_names;
+
+  /// This top-level key, with its value on the following lines
+  bool is_block_map_key(const Line& line, const string& key)
+  {
+    if (line.indent() != 0 ||
+      line.end - line.content < static_cast<std::ptrdiff_t>(key.size()) ||
+      memcmp(line.content, key.data(), key.size()) != 0)
+      return false;
+    Reader value(_reader);
+    value.p = line.content + key.size();
+    value.skip_inline_space();
+    if (value.p >= line.end || *value.p != ':')
+      return false;
+    value.p++;
+    if (value.p < line.end && !is_space(*value.p))
+      return false;
+    return value.rest_of_line_blank();
+  }
+
+  /// Pass over a value which is left to yaml-cpp. It's read as lines, so
+  /// this fails on a quoted scalar or flow collection which goes on over
+  /// lines that the rest of the index might take for keys or items.
+  bool skip(const char* begin, const char* end)
+  {
+    int depth = 0;
+    bool token_start = true;  // where a quoted scalar could start
+    for (const char* p = begin; p < end; )
+    {
+      const char c = *p;
+      if (c == '\n')
+      {
+        token_start = true;
+        p++;
+      }
+      else if (c == ' ' || c == '\t' || c == '\r')
+        p++;
+      else if (c == '#' && (p == begin || is_space(p[-1])))
+      {
+        const char* newline =
+          static_cast<const char*>(memchr(p, '\n', end - p));
+        p = newline ? newline : end;
+      }
+      else if ((c == '"' || c == '\'') && token_start)
+      {
+        for (p++; p < end && *p != c && *p != '\n'; p++)
+        {
+          if (c == '"' && *p == '\\')
+            p++;
+        }
+        if (p >= end || *p != c)
+        {
+          _reader.p = begin;
+          return _reader.fail("multi-line quoted scalars aren't supported");
+        }
+        token_start = false;
+        p++;
+      }
+      else
+      {
+        if (c == '[' || c == '{')
+          depth++;
+        else if ((c == ']' || c == '}') && --depth < 0)
+          break;
+        const bool indicator = c == '[' || c == '{' ||
+          (c == ',' && depth > 0) ||
+          ((c == ':' || c == '-' || c == '?') &&
+          (p + 1 == end || is_space(p[1])));
+        token_start = indicator;
+        p++;
+      }
+    }
+    if (depth != 0)
+    {
+      _reader.p = begin;
+      return _reader.fail("multi-line flow collections aren't supported");
+    }
+    _reader.p = end;
+    return true;
+  }
+
+  /// Whether this line isn't a document marker, or is one which starts
+  /// the (only) document. Otherwise fails.
+  bool document_marker_ok(const Line& line)
+  {
+    if (!is_document_marker(line))
+      return true;
+    if (_seen_content || *line.content == '.')
+    {
+      _reader.p = line.content;
+      _reader.fail("only one YAML document is supported");
+    }
+    return false;
+  }
+
+  /// The levels, at the lines indented more than parent_indent
+  bool find_levels(const int parent_indent)
+  {
+    int indent = -1;
+    while (!_reader.at_end())
+    {
+      const Line line = read_line(_reader.p, _reader.end());
+      if (is_blank(line))
+      {
+        _reader.p = line.next;
+        continue;
+      }
+      if (line.indent() <= parent_indent)
+        return true;
+      if (!document_marker_ok(line))
+      {
+        if (!_reader.error.empty())
+          return false;
+        _reader.p = line.next;
+        continue;
+      }
+      _seen_content = true;
+      if (indent < 0)
+        indent = line.indent();
+      _reader.p = line.content;
+      if (line.indent() != indent || *line.content == '\t')
+        return _reader.fail("unexpected indentation");
+
+      string name;
+      if (!_reader.block_key(name))
+        return false;
+      if (!_reader.rest_of_line_blank())
+      {
+        // a split level's file, or a flow map: left to yaml-cpp
+        const char* const value_end =
+          end_of_value(line.next, _reader.end(), indent);
+        if (!skip(line.content, value_end))
+          return false;
+        continue;
+      }
+      if (!_level_names.insert(name).second)
+        return _reader.fail("level " + name + " appears twice");
+      _reader.p = line.next;
+      if (!find_level_sections(indent, name))
+        return false;
+    }
+    return true;
+  }
+
+  bool find_level_sections(const int parent_indent, const string& level_name)
+  {
+    int indent = -1;
+    bool seen[NUM_SECTION_KINDS] = {};
+    while (!_reader.at_end())
+    {
+      const Line line = read_line(_reader.p, _reader.end());
+      if (is_blank(line))
+      {
+        _reader.p = line.next;
+        continue;
+      }
+      if (line.indent() <= parent_indent)
+        return true;
+      if (indent < 0)
+        indent = line.indent();
+      _reader.p = line.content;
+      if (line.indent() != indent || *line.content == '\t')
+        return _reader.fail("unexpected indentation");
+
+      string key;
+      if (!_reader.block_key(key))
+        return false;
+      const int kind = section_kind(key);
+      const bool block = _reader.rest_of_line_blank();
+      const char* const value = _reader.p;
+      const char* const value_end =
+        end_of_value(line.next, _reader.end(), indent);
+      if (kind < 0)
+      {
+        if (!skip(line.content, value_end))
+          return false;
+        continue;
+      }
+      _reader.p = value_end;
+
+      // the entities of a level are all streamed, or all left to yaml-cpp
+      if (!block && *value != '[')
+      {
+        _reader.p = value;
+        return _reader.fail(
+          key + " of level " + level_name + " isn't a sequence");
+      }
+      if (seen[kind])
+        return _reader.fail(key + " appears twice in level " + level_name);
+      seen[kind] = true;
+
+      // Level::from_yaml() finds an empty sequence in the rest
+      rest.append(_copied, line.begin - _copied);
+      rest += string(indent, ' ') + section_keys[kind] + ": []\n";
+      _copied = value_end;
+
+      if (block)
+        add_block_chunks(level_name, kind, line.next, value_end);
+      else
+        add_chunk(level_name, kind, value, value_end, true);
+    }
+    return true;
+  }
+
+  void add_chunk(
+    const string& level_name,
+    const int kind,
+    const char* begin,
+    const char* end,
+    const bool flow)
+  {
+    Chunk chunk;
+    chunk.level_name = level_name;
+    chunk.kind = kind;
+    chunk.begin = begin;
+    chunk.end = end;
+    chunk.flow = flow;
+    chunks.push_back(std::move(chunk));
+  }
+
+  void add_block_chunks(
+    const string& level_name,
+    const int kind,
+    const char* begin,
+    const char* end)
+  {
+    int item_indent = -1;
+    for (const char* p = begin; p < end && item_indent < 0; )
+    {
+      const Line line = read_line(p, end);
+      if (!is_blank(line))
+        item_indent = line.indent();
+      p = line.next;
+    }
+
+    // split at the first item of the same indent at least CHUNK_BYTES on
+    const char* chunk_begin = begin;
+    while (end - chunk_begin > 2 * CHUNK_BYTES)
+    {
+      const char* p = chunk_begin + CHUNK_BYTES;
+      const char* newline =
+        static_cast<const char*>(memchr(p, '\n', end - p));
+      p = newline ? newline + 1 : end;
+      while (p < end)
+      {
+        const Line line = read_line(p, end);
+        if (!is_blank(line) && line.indent() == item_indent && is_item(line))
+          break;
+        p = line.next;
+      }
+      if (p >= end)
+        break;
+      add_chunk(level_name, kind, chunk_begin, p, false);
+      chunk_begin = p;
+    }
+    add_chunk(level_name, kind, chunk_begin, end, false);
+  }
+};
+
+void parse_chunk(const char* origin, Chunk& chunk)
+{
+  Reader reader(origin, chunk.begin, chunk.end);
+
+  // column is where a block sequence item starts; flow items have none
+  auto read_item = [&](const int column)
+    {
+      const bool block = column >= 0;
+      if (chunk.kind == VERTICES)
+      {
+        Vertex v;
+        if (!reader.vertex(v) || (block && !reader.finish_line()))
+          return false;
+        chunk.vertices.push_back(std::move(v));
+      }
+      else if (chunk.kind == FLOORS || chunk.kind == HOLES)
+      {
+        Polygon polygon;
+        polygon.type = chunk.kind == FLOORS ? Polygon::FLOOR : Polygon::HOLE;
+        const bool ok = reader.peek() == '{' ?
+          reader.flow_polygon(polygon) && (!block || reader.finish_line()) :
+          block && reader.block_polygon(polygon, column);
+        if (!ok)
+          return reader.fail("expected a polygon");
+        polygon.create_required_parameters();
+        chunk.polygons.push_back(std::move(polygon));
+      }
+      else
+      {
+        Edge e;
+        e.type = edge_type(chunk.kind);
+        if (!reader.edge(e) || (block && !reader.finish_line()))
+          return false;
+        e.create_required_parameters();
+        chunk.edges.push_back(std::move(e));
+      }
+      return true;
+    };
+
+  bool ok = false;
+  if (chunk.flow)
+  {
+    ok = reader.sequence([&](int) { return read_item(-1); });
+    if (ok && reader.peek() != 0)
+      ok = reader.fail("unexpected text after the sequence");
+  }
+  else
+    ok = reader.block_items(read_item);
+  if (!ok)
+    chunk.error = reader.error;
+}
+
+template<typename T>
+void append(std::vector<T>& to, std::vector<T>& from)
+{
+  if (to.empty())
+    to.swap(from);
+  else
+    to.insert(
+      to.end(),
+      std::make_move_iterator(from.begin()),
+      std::make_move_iterator(from.end()));
+}
+
+}  // namespace
+
+bool BuildingStreamParser::parse_file(
+  const std::string& filename,
+  const std::string& levels_key,
+  Result& result,
+  std::string& error)
+{
+  QFile file(QString::fromStdString(filename));
+  if (!file.open(QIODevice::ReadOnly))
+  {
+    error = "couldn't open " + filename;
+    return false;
+  }
+  if (file.size() == 0)
+  {
+    error = filename + " is empty";
+    return false;
+  }
+
+  // everything is copied out of the mapping before it goes with the file
+  const uchar* data = file.map(0, file.size());
+  QByteArray contents;
+  qint64 size = file.size();
+  if (!data)
+  {
+    contents = file.readAll();
+    data = reinterpret_cast<const uchar*>(contents.constData());
+    size = contents.size();
+  }
+  const char* begin = reinterpret_cast<const char*>(data);
+  return parse(begin, begin + size, levels_key, result, error);
+}
+
+bool BuildingStreamParser::parse(
+  const char* begin,
+  const char* end,
+  const std::string& levels_key,
+  Result& result,
+  std::string& error)
+{
+  if (end - begin >= 3 && memcmp(begin, "\xef\xbb\xbf", 3) == 0)
+    begin += 3;  // a UTF-8 byte order mark
+
+  // the lines end in \n or \r\n; yaml-cpp breaks lines at a lone \r too
+  for (const char* p = begin; p < end; p++)
+  {
+    p = static_cast<const char*>(memchr(p, '\r', end - p));
+    if (!p)
+      break;
+    if (p + 1 == end || p[1] != '\n')
+    {
+      error = "lines which end in a lone carriage return aren't supported";
+      return false;
+    }
+  }
+
+  Index index(begin, end);
+  if (!index.find_sections(levels_key))
+  {
+    error = index.error();
+    return false;
+  }
+  index.finish();
+
+  QtConcurrent::blockingMap(
+    index.chunks,
+    [begin](Chunk& chunk) { parse_chunk(begin, chunk); });
+
+  result.levels.clear();
+  for (int kind = 0; kind < NUM_SECTION_KINDS; kind++)
+  {
+    for (Chunk& chunk : index.chunks)
+    {
+      if (chunk.kind != kind)
+        continue;
+      if (!chunk.error.empty())
+      {
+        error = chunk.error;
+        return false;
+      }
+      LevelEntities& level = result.levels[chunk.level_name];
+      append(level.vertices, chunk.vertices);
+      append(level.edges, chunk.edges);
+      append(level.polygons, chunk.polygons);
+    }
+  }
+
+  try
+  {
+    result.rest = YAML::Load(index.rest);
+  }
+  catch (const std::exception& e)
+  {
+    error = string("in the rest of the file: ") + e.what();
+    return false;
+  }
+  return true;
+}
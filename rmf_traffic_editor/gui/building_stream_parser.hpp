@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__BUILDING_STREAM_PARSER_HPP
+#define TRAFFIC_EDITOR__BUILDING_STREAM_PARSER_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <yaml-cpp/yaml.h>
+
+#include "edge.h"
+#include "polygon.h"
+#include "vertex.h"
+
+//=============================================================================
+/// A faster way to read a big building file. The vertices, edges and
+/// polygons of the levels, which are most of such a file, are built
+/// straight from the text of the memory-mapped file, on the thread pool,
+/// without a YAML::Node tree. Everything else is cut out of the text as
+/// it is and given to yaml-cpp, which is cheap because it is small.
+///
+/// Only the subset of YAML which the editor writes is read in the entity
+/// sections: block sequences of flow sequences and maps (or block maps of
+/// them, for polygons) of plain or quoted scalars, and comments. Anything
+/// else there, such as anchors, tags or a multi-line scalar, makes parse()
+/// fail, and the caller is to fall back to YAML::LoadFile(). So is any
+/// number or name which yaml-cpp might read differently.
+class BuildingStreamParser
+{
+public:
+  /// What was built for the entity sections of one level
+  struct LevelEntities
+  {
+    std::vector<Vertex> vertices;
+
+    /// In the order of Level::from_yaml(): lanes, walls, measurements,
+    /// doors, then human lanes; floors, then holes
+    std::vector<Edge> edges;
+    std::vector<Polygon> polygons;
+  };
+
+  struct Result
+  {
+    /// The rest of the file, in which the entity sections of the levels
+    /// that were read are empty sequences
+    YAML::Node rest;
+
+    std::map<std::string, LevelEntities> levels;
+  };
+
+  /// Parse a building file, whose levels are in the map of this top-level
+  /// key, or if it's empty, a level file of a split building, whose
+  /// top-level keys are the levels. On failure, error says why.
+  static bool parse_file(
+    const std::string& filename,
+    const std::string& levels_key,
+    Result& result,
+    std::string& error);
+
+  static bool parse(
+    const char* begin,
+    const char* end,
+    const std::string& levels_key,
+    Result& result,
+    std::string& error);
+};
+
+#endif
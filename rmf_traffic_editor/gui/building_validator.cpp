@@ -0,0 +1,383 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <functional>
+#include <map>
+
+#include "building_validator.hpp"
+#include "logging.hpp"
+#include "param_schema.hpp"
+#include "task_pool.hpp"
+
+namespace {
+
+std::string level_prefix(const Level& level)
+{
+  return "level " + level.name + ": ";
+}
+
+/// Every index of a name that occurs more than once, skipping empty names
+template<typename T, typename NameFn>
+std::map<std::string, std::vector<int>> duplicate_names(
+  const std::vector<T>& items,
+  NameFn name_of)
+{
+  std::map<std::string, std::vector<int>> names;
+  for (std::size_t i = 0; i < items.size(); i++)
+  {
+    const std::string& name = name_of(items[i]);
+    if (!name.empty())
+      names[name].push_back(static_cast<int>(i));
+  }
+  for (auto it = names.begin(); it != names.end(); )
+  {
+    if (it->second.size() < 2)
+      it = names.erase(it);
+    else
+      ++it;
+  }
+  return names;
+}
+
+}  // anonymous namespace
+
+const std::vector<BuildingValidator::Issue>& BuildingValidator::run(
+  const Building& building)
+{
+  Context context;
+  if (!building.reference_level_name.empty())
+    context.reference_level_idx = std::max(
+      building.find_level_idx(building.reference_level_name), 0);
+  if (context.reference_level_idx < static_cast<int>(building.levels.size()))
+  {
+    const Level& ref = building.levels[context.reference_level_idx];
+    for (const Fiducial& fiducial : ref.fiducials)
+      context.reference_fiducial_names.insert(fiducial.name);
+  }
+  for (const Lift& lift : building.lifts)
+  {
+    LiftContext lift_context;
+    lift_context.name = lift.name;
+    lift_context.lowest_elevation = lift.lowest_elevation;
+    lift_context.highest_elevation = lift.highest_elevation;
+    for (const LiftDoor& door : lift.doors)
+      lift_context.door_names.insert(door.name);
+    for (const auto& level_doors : lift.level_doors)
+    {
+      if (!level_doors.second.empty())
+        lift_context.levels_with_doors.insert(level_doors.first);
+    }
+    context.lifts.push_back(lift_context);
+  }
+
+  const std::size_t context_rev = context_revision(building);
+  _level_results.resize(building.levels.size());
+
+  struct Job
+  {
+    const Level* level;
+    int level_idx;
+    LevelResult* result;
+  };
+  std::vector<Job> jobs;
+  for (std::size_t i = 0; i < building.levels.size(); i++)
+  {
+    LevelResult& result = _level_results[i];
+    if (result.valid &&
+      result.level_revision == building.levels[i].revision() &&
+      result.context_revision == context_rev)
+      continue;
+    Job job;
+    job.level = &building.levels[i];
+    job.level_idx = static_cast<int>(i);
+    job.result = &result;
+    jobs.push_back(job);
+  }
+
+  std::function<void(Job&)> check =
+    [&context, context_rev](Job& job)
+    {
+      job.result->issues = check_level(*job.level, job.level_idx, context);
+      job.result->level_revision = job.level->revision();
+      job.result->context_revision = context_rev;
+      job.result->valid = true;
+    };
+  // a single level is checked on this thread
+  TaskPool::instance().parallel_for(
+    static_cast<int>(jobs.size()),
+    [&jobs, &check](int i) { check(jobs[i]); });
+
+  _issues.clear();
+  check_building(building, _issues);
+  for (const LevelResult& result : _level_results)
+    _issues.insert(_issues.end(), result.issues.begin(), result.issues.end());
+
+  qCInfo(lc_edit, "building check: %d of %d levels checked, %d issues",
+    static_cast<int>(jobs.size()),
+    static_cast<int>(building.levels.size()),
+    static_cast<int>(_issues.size()));
+  return _issues;
+}
+
+int BuildingValidator::num_errors() const
+{
+  return static_cast<int>(std::count_if(
+      _issues.begin(),
+      _issues.end(),
+      [](const Issue& issue) { return issue.severity == ERROR; }));
+}
+
+void BuildingValidator::clear()
+{
+  _level_results.clear();
+  _issues.clear();
+}
+
+std::size_t BuildingValidator::context_revision(const Building& building)
+{
+  // anything a level is checked against besides itself
+  std::size_t revision = building.lifts_revision();
+  revision = revision * 31 + building.levels.size();
+  const int ref_idx = building.reference_level_name.empty() ?
+    0 : std::max(building.find_level_idx(building.reference_level_name), 0);
+  revision = revision * 31 + static_cast<std::size_t>(ref_idx);
+  if (ref_idx < static_cast<int>(building.levels.size()))
+    revision = revision * 31 + building.levels[ref_idx].fiducials_revision();
+  return revision;
+}
+
+std::vector<BuildingValidator::Issue> BuildingValidator::check_level(
+  const Level& level,
+  const int level_idx,
+  const Context& context)
+{
+  std::vector<Issue> issues;
+  auto add = [&issues, &level, level_idx](
+    const Severity severity,
+    const Level::SelectedItem& item,
+    const std::string& message)
+    {
+      Issue issue;
+      issue.severity = severity;
+      issue.level_idx = level_idx;
+      issue.item = item;
+      issue.message = level_prefix(level) + message;
+      issues.push_back(issue);
+    };
+
+  if (!level.are_layer_names_unique())
+    add(ERROR, Level::SelectedItem(),
+      "duplicate layer name. Layers must have unique names within a level.");
+
+  const int num_vertices = static_cast<int>(level.vertices.size());
+  for (std::size_t i = 0; i < level.edges.size(); i++)
+  {
+    const Edge& edge = level.edges[i];
+    if (edge.start_idx < 0 || edge.start_idx >= num_vertices ||
+      edge.end_idx < 0 || edge.end_idx >= num_vertices)
+      add(ERROR, Level::SelectedItem(),
+        "edge " + std::to_string(i) +
+        " refers to a vertex which doesn't exist");
+  }
+
+  for (std::size_t i = 0; i < level.polygons.size(); i++)
+  {
+    for (const int vertex_idx : level.polygons[i].vertices)
+    {
+      if (vertex_idx < 0 || vertex_idx >= num_vertices)
+      {
+        add(ERROR, Level::SelectedItem(),
+          "polygon " + std::to_string(i) +
+          " refers to a vertex which doesn't exist");
+        break;
+      }
+    }
+  }
+
+  // a param of the wrong type is ignored by the editor and the generators
+  auto check_params = [&add](
+    const ParamSchema* schema,
+    const ParamMap& params,
+    const Level::ItemType item_type,
+    const std::size_t idx)
+    {
+      if (!schema)
+        return;
+      for (const auto& param : params)
+      {
+        const ParamField* field = schema->lookup(param.first);
+        if (!field || field->type == param.second.type)
+          continue;
+        add(WARNING,
+          Level::make_selected_item(item_type, static_cast<int>(idx)),
+          std::string(schema->kind()) + " " + std::to_string(idx) +
+          " has param " + param.first + " as a " +
+          ParamSchema::type_name(param.second.type) + ", not a " +
+          ParamSchema::type_name(field->type));
+      }
+    };
+  for (std::size_t i = 0; i < level.vertices.size(); i++)
+  {
+    check_params(
+      &param_schemas::vertex, level.vertices[i].params, Level::VERTEX, i);
+  }
+  for (std::size_t i = 0; i < level.edges.size(); i++)
+  {
+    check_params(
+      Edge::param_schema(level.edges[i].type),
+      level.edges[i].params,
+      Level::EDGE,
+      i);
+  }
+  for (std::size_t i = 0; i < level.polygons.size(); i++)
+  {
+    check_params(
+      Polygon::param_schema(level.polygons[i].type),
+      level.polygons[i].params,
+      Level::POLYGON,
+      i);
+  }
+
+  const auto vertex_names = duplicate_names(
+    level.vertices,
+    [](const Vertex& v) -> const std::string& { return v.name; });
+  for (const auto& it : vertex_names)
+    add(WARNING,
+      Level::make_selected_item(Level::VERTEX, it.second[1]),
+      std::to_string(it.second.size()) + " vertices are named " + it.first);
+
+  const auto fiducial_names = duplicate_names(
+    level.fiducials,
+    [](const Fiducial& f) -> const std::string& { return f.name; });
+  for (const auto& it : fiducial_names)
+    add(WARNING,
+      Level::make_selected_item(Level::FIDUCIAL, it.second[1]),
+      std::to_string(it.second.size()) + " fiducials are named " + it.first);
+
+  if (level_idx != context.reference_level_idx)
+  {
+    for (std::size_t i = 0; i < level.fiducials.size(); i++)
+    {
+      const Fiducial& fiducial = level.fiducials[i];
+      if (!fiducial.name.empty() &&
+        context.reference_fiducial_names.count(fiducial.name) == 0)
+        add(WARNING,
+          Level::make_selected_item(Level::FIDUCIAL, static_cast<int>(i)),
+          "fiducial " + fiducial.name +
+          " has no match on the reference level, so it aligns nothing");
+    }
+  }
+
+  // lift cabin vertices, by the name of their lift
+  std::map<std::string, std::vector<int>> cabins;
+  for (std::size_t i = 0; i < level.vertices.size(); i++)
+  {
+    const std::string lift_name = level.vertices[i].lift_cabin();
+    if (!lift_name.empty())
+      cabins[lift_name].push_back(static_cast<int>(i));
+  }
+
+  for (const auto& it : cabins)
+  {
+    const Level::SelectedItem item =
+      Level::make_selected_item(Level::VERTEX, it.second[0]);
+    if (std::none_of(
+        context.lifts.begin(),
+        context.lifts.end(),
+        [&it](const LiftContext& lift) { return lift.name == it.first; }))
+      add(WARNING, item,
+        "lift cabin vertex refers to lift " + it.first +
+        " which doesn't exist");
+    else if (it.second.size() > 1)
+      add(WARNING,
+        Level::make_selected_item(Level::VERTEX, it.second[1]),
+        "lift " + it.first + " has " + std::to_string(it.second.size()) +
+        " cabin vertices");
+  }
+
+  for (const LiftContext& lift : context.lifts)
+  {
+    if (lift.levels_with_doors.count(level.name) == 0)
+      continue;
+    if (level.elevation < lift.lowest_elevation ||
+      level.elevation > lift.highest_elevation)
+      add(ERROR, Level::SelectedItem(),
+        "lift " + lift.name + " has doors on this level, but its range "
+        "doesn't reach its elevation");
+    if (cabins.count(lift.name) == 0)
+      add(WARNING, Level::SelectedItem(),
+        "lift " + lift.name + " has doors on this level, but no cabin "
+        "vertex. Open the lift dialog and press OK to add one.");
+  }
+
+  return issues;
+}
+
+void BuildingValidator::check_building(
+  const Building& building,
+  std::vector<Issue>& issues)
+{
+  auto add = [&issues](const std::string& message)
+    {
+      Issue issue;
+      issue.severity = ERROR;
+      issue.message = message;
+      issues.push_back(issue);
+    };
+
+  for (const Lift& lift : building.lifts)
+  {
+    if (!lift.reference_floor_name.empty() &&
+      building.find_level_idx(lift.reference_floor_name) < 0)
+      add(
+        "lift " + lift.name + " refers to level " +
+        lift.reference_floor_name + " which doesn't exist");
+
+    for (const auto& level_doors : lift.level_doors)
+    {
+      if (level_doors.first.empty() ||
+        building.find_level_idx(level_doors.first) < 0)
+      {
+        add(
+          "lift " + lift.name + " has doors on level " + level_doors.first +
+          " which doesn't exist");
+        continue;
+      }
+      for (const std::string& door_name : level_doors.second)
+      {
+        if (door_name.empty() ||
+          std::none_of(
+            lift.doors.begin(),
+            lift.doors.end(),
+            [&door_name](const LiftDoor& door)
+            {
+              return door.name == door_name;
+            }))
+          add(
+            "lift " + lift.name + " opens door " + door_name + " on level " +
+            level_doors.first + ", but has no door of that name");
+      }
+    }
+  }
+
+  const auto level_names = duplicate_names(
+    building.levels,
+    [](const Level& level) -> const std::string& { return level.name; });
+  for (const auto& it : level_names)
+    add(std::to_string(it.second.size()) + " levels are named " + it.first);
+}
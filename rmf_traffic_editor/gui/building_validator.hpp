@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__BUILDING_VALIDATOR_HPP
+#define TRAFFIC_EDITOR__BUILDING_VALIDATOR_HPP
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "building.h"
+
+//=============================================================================
+/// Checks a building for mistakes which are easy to make and hard to see:
+/// dangling vertex indices, duplicate names, fiducials which align nothing,
+/// and lifts whose doors, elevations and cabin vertices disagree.
+///
+/// The rules of each level only read that level plus a small context
+/// (the lifts and the reference level's fiducials), so the levels are
+/// checked in parallel. Their results are kept, and on the next run only
+/// the levels which changed (see Level::revision()), or whose context
+/// did, are checked again.
+class BuildingValidator
+{
+public:
+  enum Severity
+  {
+    WARNING = 0,
+    ERROR
+  };
+
+  struct Issue
+  {
+    Severity severity = ERROR;
+    int level_idx = -1;  // -1 for the building as a whole
+    Level::SelectedItem item;  // what to select to show it, if anything
+    std::string message;
+  };
+
+  /// Check the building and return every issue, building-wide ones first
+  const std::vector<Issue>& run(const Building& building);
+
+  const std::vector<Issue>& issues() const { return _issues; }
+  int num_errors() const;
+
+  /// Forget the results, so that the next run() checks every level
+  void clear();
+
+private:
+  /// What a level is checked against besides itself. Built on the calling
+  /// thread, since Building lookups aren't thread-safe.
+  struct LiftContext
+  {
+    std::string name;
+    double lowest_elevation = 0.0;
+    double highest_elevation = 0.0;
+    std::set<std::string> door_names;
+    std::set<std::string> levels_with_doors;
+  };
+
+  struct Context
+  {
+    int reference_level_idx = 0;
+    std::set<std::string> reference_fiducial_names;
+    std::vector<LiftContext> lifts;
+  };
+
+  struct LevelResult
+  {
+    bool valid = false;
+    std::size_t level_revision = 0;
+    std::size_t context_revision = 0;
+    std::vector<Issue> issues;
+  };
+
+  std::vector<LevelResult> _level_results;
+  std::vector<Issue> _issues;
+
+  static std::size_t context_revision(const Building& building);
+
+  static std::vector<Issue> check_level(
+    const Level& level,
+    const int level_idx,
+    const Context& context);
+
+  static void check_building(
+    const Building& building,
+    std::vector<Issue>& issues);
+};
+
+#endif
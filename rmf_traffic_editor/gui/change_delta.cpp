@@ -0,0 +1,377 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <map>
+
+#include <QJsonArray>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QSaveFile>
+#include <yaml-cpp/yaml.h>
+
+#include "building_diff.hpp"
+#include "building_snapshot.hpp"
+#include "change_delta.hpp"
+#include "content_hash.hpp"
+#include "logging.hpp"
+
+namespace {
+
+QString yaml_text(const YAML::Node& node)
+{
+  YAML::Emitter emitter;
+  emitter.SetMapFormat(YAML::Flow);
+  emitter.SetSeqFormat(YAML::Flow);
+  emitter << node;
+  return QString::fromUtf8(emitter.c_str(), static_cast<int>(emitter.size()));
+}
+
+/// The ContentHash section of the entities of this kind
+ContentHash::Section section_of(const BuildingDiff::Kind kind)
+{
+  switch (kind)
+  {
+    case BuildingDiff::VERTEX: return ContentHash::VERTICES;
+    case BuildingDiff::EDGE: return ContentHash::EDGES;
+    case BuildingDiff::POLYGON: return ContentHash::POLYGONS;
+    case BuildingDiff::MODEL: return ContentHash::MODELS;
+    case BuildingDiff::FIDUCIAL: return ContentHash::FIDUCIALS;
+    case BuildingDiff::FEATURE: return ContentHash::FEATURES;
+    case BuildingDiff::TAG: return ContentHash::TAGS;
+    default: return ContentHash::LAYERS;
+  }
+}
+
+/// The saved form of entity idx of this kind, and its uuid if it has one
+YAML::Node entity_yaml(
+  const Level& level,
+  const BuildingDiff::Kind kind,
+  const int idx,
+  QUuid& uuid)
+{
+  uuid = QUuid();
+  switch (kind)
+  {
+    case BuildingDiff::VERTEX:
+      uuid = level.vertices[idx].uuid;
+      return level.vertices[idx].to_yaml();
+    case BuildingDiff::EDGE:
+      return level.edges[idx].to_yaml();
+    case BuildingDiff::POLYGON:
+      return level.polygons[idx].to_yaml();
+    case BuildingDiff::MODEL:
+      uuid = level.models[idx].uuid;
+      return level.models[idx].to_yaml();
+    case BuildingDiff::FIDUCIAL:
+      uuid = level.fiducials[idx].uuid;
+      return level.fiducials[idx].to_yaml();
+    case BuildingDiff::FEATURE:
+      uuid = level.floorplan_features[idx].id();
+      return level.floorplan_features[idx].to_yaml();
+    case BuildingDiff::TAG:
+      uuid = level.tags[idx].uuid;
+      return level.tags[idx].to_yaml();
+    case BuildingDiff::LAYER:
+    {
+      YAML::Node node;
+      node[level.layers[idx].name] = level.layers[idx].to_yaml();
+      return node;
+    }
+    default:
+      return YAML::Node();
+  }
+}
+
+const char* change_name(const int changes)
+{
+  if (changes & BuildingDiff::ADDED)
+    return "added";
+  if (changes & BuildingDiff::REMOVED)
+    return "removed";
+  return "modified";
+}
+
+QJsonArray entities_json(
+  const Level& before,
+  const Level& after,
+  const std::vector<BuildingDiff::Entry>& entries)
+{
+  const ContentHash::LevelHashes& before_hashes = before.content_hashes();
+  const ContentHash::LevelHashes& after_hashes = after.content_hashes();
+
+  QJsonArray json;
+  for (const BuildingDiff::Entry& entry : entries)
+  {
+    const ContentHash::Section section = section_of(entry.kind);
+    QJsonObject o;
+    o["kind"] = BuildingDiff::kind_name(entry.kind);
+    o["change"] = change_name(entry.changes);
+
+    QUuid uuid;
+    if (entry.before_idx >= 0)
+    {
+      o["before_index"] = entry.before_idx;
+      o["before_hash"] = ContentHash::to_hex(
+        before_hashes.entities[section][entry.before_idx]);
+      entity_yaml(before, entry.kind, entry.before_idx, uuid);
+    }
+    if (entry.after_idx >= 0)
+    {
+      o["index"] = entry.after_idx;
+      o["hash"] = ContentHash::to_hex(
+        after_hashes.entities[section][entry.after_idx]);
+      o["yaml"] = yaml_text(
+        entity_yaml(after, entry.kind, entry.after_idx, uuid));
+    }
+    if (!uuid.isNull())
+      o["uuid"] = uuid.toString(QUuid::WithoutBraces);
+    json.append(o);
+  }
+  return json;
+}
+
+QJsonObject lift_json(
+  const char* change,
+  const int before_idx,
+  const Lift* before,
+  const int after_idx,
+  const Lift* after)
+{
+  QJsonObject o;
+  o["kind"] = "lift";
+  o["change"] = change;
+  if (before)
+  {
+    o["name"] = QString::fromStdString(before->name);
+    o["before_index"] = before_idx;
+    o["before_hash"] = ContentHash::to_hex(ContentHash::of(before->to_yaml()));
+  }
+  if (after)
+  {
+    const YAML::Node yaml = after->to_yaml();
+    o["name"] = QString::fromStdString(after->name);
+    o["index"] = after_idx;
+    o["hash"] = ContentHash::to_hex(ContentHash::of(yaml));
+    o["yaml"] = yaml_text(yaml);
+  }
+  return o;
+}
+
+}  // namespace
+
+QJsonObject ChangeDelta::compute(
+  const BuildingSnapshot& before,
+  const BuildingSnapshot& after,
+  const std::uint64_t sequence)
+{
+  QJsonArray levels;
+  std::map<std::string, const Level*> before_levels;
+  for (const std::shared_ptr<const Level>& level : before.levels)
+    before_levels[level->name] = level.get();
+
+  for (const std::shared_ptr<const Level>& level : after.levels)
+  {
+    QJsonObject level_json;
+    level_json["name"] = QString::fromStdString(level->name);
+    level_json["hash"] =
+      ContentHash::to_hex(level->content_hashes().level);
+
+    const auto it = before_levels.find(level->name);
+    if (it == before_levels.end())
+    {
+      level_json["status"] = "added";
+      level_json["yaml"] = yaml_text(level->to_yaml());
+      levels.append(level_json);
+      continue;
+    }
+    const Level& before_level = *it->second;
+    before_levels.erase(it);
+
+    // unedited levels are shared between the snapshots
+    const ContentHash::LevelHashes& before_hashes =
+      before_level.content_hashes();
+    const ContentHash::LevelHashes& after_hashes = level->content_hashes();
+    if (&before_level == level.get() ||
+      before_hashes.level == after_hashes.level)
+      continue;
+
+    BuildingDiff::LevelDiff diff;
+    BuildingDiff::diff_level(before_level, *level, diff);
+    level_json["status"] = "changed";
+    level_json["before_hash"] = ContentHash::to_hex(before_hashes.level);
+    level_json["entities"] = entities_json(before_level, *level, diff.entries);
+    if (before_hashes.sections[ContentHash::CONSTRAINTS] !=
+      after_hashes.sections[ContentHash::CONSTRAINTS])
+    {
+      YAML::Node constraints(YAML::NodeType::Sequence);
+      for (const Constraint& constraint : level->constraints)
+        constraints.push_back(constraint.to_yaml());
+      level_json["constraints"] = yaml_text(constraints);
+    }
+    levels.append(level_json);
+  }
+  for (const auto& it : before_levels)
+  {
+    QJsonObject level_json;
+    level_json["name"] = QString::fromStdString(it.first);
+    level_json["status"] = "removed";
+    level_json["before_hash"] =
+      ContentHash::to_hex(it.second->content_hashes().level);
+    levels.append(level_json);
+  }
+
+  // lifts are matched by name
+  QJsonArray lifts;
+  std::map<std::string, int> before_lifts;
+  for (std::size_t i = 0; i < before.lifts.size(); i++)
+    before_lifts[before.lifts[i].name] = static_cast<int>(i);
+  for (std::size_t i = 0; i < after.lifts.size(); i++)
+  {
+    const Lift& lift = after.lifts[i];
+    const auto it = before_lifts.find(lift.name);
+    if (it == before_lifts.end())
+    {
+      lifts.append(lift_json("added", -1, nullptr, static_cast<int>(i), &lift));
+      continue;
+    }
+    const Lift& before_lift = before.lifts[it->second];
+    if (ContentHash::of(before_lift.to_yaml()) !=
+      ContentHash::of(lift.to_yaml()))
+      lifts.append(
+        lift_json(
+          "modified",
+          it->second,
+          &before_lift,
+          static_cast<int>(i),
+          &lift));
+    before_lifts.erase(it);
+  }
+  for (const auto& it : before_lifts)
+    lifts.append(
+      lift_json("removed", it.second, &before.lifts[it.second], -1, nullptr));
+
+  QJsonObject json;
+  json["version"] = FORMAT_VERSION;
+  json["building"] = QString::fromStdString(after.filename);
+  json["sequence"] = static_cast<double>(sequence);
+  json["base_hash"] = ContentHash::to_hex(before.content_hash);
+  json["hash"] = ContentHash::to_hex(after.content_hash);
+  json["levels"] = levels;
+  json["lifts"] = lifts;
+  return json;
+}
+
+QString ChangeDelta::filename(const std::string& building_filename)
+{
+  return QString::fromStdString(building_filename) + ".delta.json";
+}
+
+bool ChangeDelta::save(const QString& filename, const QByteArray& json)
+{
+  QSaveFile file(filename);
+  if (!file.open(QIODevice::WriteOnly))
+    return false;
+  file.write(json);
+  return file.commit();
+}
+
+//=============================================================================
+ChangeDelta::Server::Server(QObject* parent)
+: _server(new QLocalServer(parent))
+{
+  QObject::connect(
+    _server,
+    &QLocalServer::newConnection,
+    [this]()
+    {
+      while (_server->hasPendingConnections())
+      {
+        QLocalSocket* client = _server->nextPendingConnection();
+        _clients.push_back(client);
+        QObject::connect(
+          client,
+          &QLocalSocket::disconnected,
+          [this, client]()
+          {
+            _clients.erase(
+              std::remove(_clients.begin(), _clients.end(), client),
+              _clients.end());
+            client->deleteLater();
+          });
+      }
+    });
+}
+
+ChangeDelta::Server::~Server()
+{
+  listen(QString());
+}
+
+bool ChangeDelta::Server::listen(const QString& name)
+{
+  if (_server->isListening())
+  {
+    if (name == _server->serverName())
+      return true;
+    _server->close();
+  }
+  for (QLocalSocket* client : _clients)
+  {
+    QObject::disconnect(client, nullptr, nullptr, nullptr);
+    client->abort();
+    client->deleteLater();
+  }
+  _clients.clear();
+  if (name.isEmpty())
+    return true;
+
+  if (!_server->listen(name))
+  {
+    // left behind by an editor that didn't get to close it
+    QLocalServer::removeServer(name);
+    if (!_server->listen(name))
+    {
+      qCWarning(lc_io, "unable to listen on %s for change deltas: %s",
+        qUtf8Printable(name),
+        qUtf8Printable(_server->errorString()));
+      return false;
+    }
+  }
+  qCInfo(lc_io, "sending change deltas to %s",
+    qUtf8Printable(_server->fullServerName()));
+  return true;
+}
+
+bool ChangeDelta::Server::is_listening() const
+{
+  return _server->isListening();
+}
+
+QString ChangeDelta::Server::name() const
+{
+  return _server->serverName();
+}
+
+void ChangeDelta::Server::send(const QByteArray& json)
+{
+  for (QLocalSocket* client : _clients)
+  {
+    client->write(json);
+    client->write("\n");
+  }
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__CHANGE_DELTA_HPP
+#define TRAFFIC_EDITOR__CHANGE_DELTA_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QString>
+
+class BuildingSnapshot;
+class QLocalServer;
+class QLocalSocket;
+class QObject;
+
+//=============================================================================
+/// What changed from one save of a building to the next, for programs
+/// which keep the building loaded (map servers, fleet adapters) to update
+/// what they have instead of parsing the whole file again. As compact
+/// JSON:
+///
+///   {"version": 1, "building": path, "sequence": n,
+///    "base_hash": hex, "hash": hex,
+///    "levels": [{"name", "status": "added" | "removed" | "changed",
+///      "before_hash", "hash", "yaml" (of an added level),
+///      "entities": [{"kind", "change": "added" | "removed" | "modified",
+///        "before_index", "index", "uuid", "before_hash", "hash",
+///        "yaml"}],
+///      "constraints" (the yaml of all of them, if any changed)}],
+///    "lifts": [... as the entities]}
+///
+/// Entities keep their order: a consumer removes those at the
+/// before_index of the removed and modified ones, then inserts the added
+/// and modified ones at their index, renumbering the vertex indices of
+/// the edges and polygons it already had the same way. An entity is only
+/// in the delta if it changed, so an edge isn't listed just because a
+/// vertex before its own was removed. The hashes are ContentHash values
+/// (of the whole building, a level, or one entity as saved). A consumer
+/// that finds a gap in the sequence, or a before_hash that isn't what it
+/// has, should reload the building. Only the ids of features are saved,
+/// so the other uuids only identify an entity within one editing session.
+class ChangeDelta
+{
+public:
+  static constexpr int FORMAT_VERSION = 1;
+
+  /// Thread-safe: snapshots are immutable
+  static QJsonObject compute(
+    const BuildingSnapshot& before,
+    const BuildingSnapshot& after,
+    const std::uint64_t sequence);
+
+  /// The file the delta of a building is written to, next to it
+  static QString filename(const std::string& building_filename);
+
+  /// Write the delta (atomically, so that nothing reads half of it)
+  static bool save(const QString& filename, const QByteArray& json);
+
+  //===========================================================================
+  /// Sends each delta, as one line of compact JSON, to every program
+  /// connected to a local socket (a Unix domain socket or a named pipe).
+  /// Lives on the GUI thread.
+  class Server
+  {
+  public:
+    explicit Server(QObject* parent);
+    ~Server();
+
+    /// Listen on this name, replacing a stale socket of a crashed editor;
+    /// an empty name stops listening
+    bool listen(const QString& name);
+    bool is_listening() const;
+    QString name() const;
+
+    void send(const QByteArray& json);
+
+  private:
+    QLocalServer* _server = nullptr;
+    std::vector<QLocalSocket*> _clients;
+  };
+};
+
+#endif
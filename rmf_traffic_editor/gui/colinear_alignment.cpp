@@ -0,0 +1,289 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+
+#include <QtConcurrent/QtConcurrent>
+
+#include "colinear_alignment.hpp"
+#include "spatial_grid.hpp"
+
+std::vector<ColinearAlignment::Move> ColinearAlignment::align(
+  const std::vector<QPointF>& points,
+  const std::vector<std::pair<int, int>>& segments,
+  const double distance_tolerance,
+  const double angle_tolerance)
+{
+  std::vector<Move> moves;
+  if (distance_tolerance <= 0.0 || angle_tolerance <= 0.0)
+    return moves;
+
+  const int num_points = static_cast<int>(points.size());
+  const double max_cross = std::sin(angle_tolerance);
+
+  // segments too short to have a meaningful direction are left out
+  std::vector<int> order;
+  std::vector<std::vector<int>> point_segments(points.size());
+  for (std::size_t i = 0; i < segments.size(); i++)
+  {
+    const int a = segments[i].first;
+    const int b = segments[i].second;
+    if (a < 0 || a >= num_points || b < 0 || b >= num_points || a == b)
+      continue;
+    const QPointF d = points[b] - points[a];
+    if (std::hypot(d.x(), d.y()) < 2.0 * distance_tolerance)
+      continue;
+    order.push_back(static_cast<int>(i));
+    point_segments[a].push_back(static_cast<int>(i));
+    point_segments[b].push_back(static_cast<int>(i));
+  }
+
+  // longest first, since their directions are the most accurate
+  std::sort(
+    order.begin(),
+    order.end(),
+    [&points, &segments](const int i, const int j)
+    {
+      const QPointF di = points[segments[i].second] - points[segments[i].first];
+      const QPointF dj = points[segments[j].second] - points[segments[j].first];
+      return std::hypot(di.x(), di.y()) > std::hypot(dj.x(), dj.y());
+    });
+
+  // near-duplicate points, which imported drawings are full of, link
+  // segments as well as shared points do
+  SpatialGrid grid(distance_tolerance);
+  for (int i = 0; i < num_points; i++)
+    grid.set(i, points[i].x(), points[i].y());
+
+  // grow a group along the segments which are on the line of the longest
+  // unclaimed segment. Each is tested against the line of the whole group
+  // so far, not its neighbour, so that a gentle curve can't creep in; the
+  // line is refitted as points join, and once it is long, whenever the
+  // group has doubled.
+  std::vector<bool> claimed(segments.size(), false);
+  std::vector<int> visited(points.size(), -1);
+  std::vector<Line> lines;
+  std::vector<std::vector<int>> point_lines(points.size());
+  std::vector<int> nearby;
+  for (const int seed : order)
+  {
+    if (claimed[seed])
+      continue;
+    claimed[seed] = true;
+
+    const QPointF& a = points[segments[seed].first];
+    const QPointF& b = points[segments[seed].second];
+    Line group_line;
+    group_line.point = a;
+    const double length = std::hypot(b.x() - a.x(), b.y() - a.y());
+    group_line.ux = (b.x() - a.x()) / length;
+    group_line.uy = (b.y() - a.y()) / length;
+    std::size_t fitted_size = 0;
+
+    std::vector<int> idxs;
+    std::vector<int> frontier = {segments[seed].first, segments[seed].second};
+    while (!frontier.empty())
+    {
+      const int v = frontier.back();
+      frontier.pop_back();
+      if (visited[v] == seed)
+        continue;
+      visited[v] = seed;
+      idxs.push_back(v);
+      if (idxs.size() >= 3 &&
+        (idxs.size() < 16 || idxs.size() >= 2 * fitted_size))
+      {
+        group_line = fit_line(points, idxs);
+        fitted_size = idxs.size();
+      }
+
+      nearby.clear();
+      grid.within(
+        points[v].x() - distance_tolerance,
+        points[v].y() - distance_tolerance,
+        points[v].x() + distance_tolerance,
+        points[v].y() + distance_tolerance,
+        nearby);
+      for (const int u : nearby)
+      {
+        for (const int s : point_segments[u])
+        {
+          if (claimed[s])
+            continue;
+          const QPointF& p = points[segments[s].first];
+          const QPointF& q = points[segments[s].second];
+          const double l = std::hypot(q.x() - p.x(), q.y() - p.y());
+          const double cross = std::abs(
+            group_line.ux * (q.y() - p.y()) - group_line.uy * (q.x() - p.x()));
+          if (cross > max_cross * l ||
+            distance(group_line, p) > 2.0 * distance_tolerance ||
+            distance(group_line, q) > 2.0 * distance_tolerance)
+            continue;
+          claimed[s] = true;
+          frontier.push_back(segments[s].first);
+          frontier.push_back(segments[s].second);
+        }
+      }
+    }
+
+    if (idxs.size() < 3)
+      continue;
+
+    // note which lines each point is on
+    const Line line = fit_line(points, idxs);
+    bool straight = true;
+    for (const int idx : idxs)
+    {
+      if (distance(line, points[idx]) > distance_tolerance)
+        straight = false;
+    }
+    if (!straight)
+      continue;
+
+    const int line_idx = static_cast<int>(lines.size());
+    lines.push_back(line);
+    for (const int idx : idxs)
+      point_lines[idx].push_back(line_idx);
+  }
+
+  for (int i = 0; i < num_points; i++)
+  {
+    if (point_lines[i].empty())
+      continue;
+    Move move;
+    move.idx = i;
+    moves.push_back(move);
+  }
+
+  QtConcurrent::blockingMap(
+    moves,
+    [&points, &lines, &point_lines, distance_tolerance, angle_tolerance](
+      Move& move)
+    {
+      const QPointF& p = points[move.idx];
+      const std::vector<int>& on = point_lines[move.idx];
+      QPointF q = project(lines[on[0]], p);
+
+      // a corner: the two lines furthest from parallel meet here
+      double best_cross = 0.0;
+      int best_a = -1;
+      int best_b = -1;
+      for (std::size_t a = 0; a < on.size(); a++)
+      {
+        for (std::size_t b = a + 1; b < on.size(); b++)
+        {
+          const Line& la = lines[on[a]];
+          const Line& lb = lines[on[b]];
+          const double cross = std::abs(la.ux * lb.uy - la.uy * lb.ux);
+          if (cross > best_cross)
+          {
+            best_cross = cross;
+            best_a = on[a];
+            best_b = on[b];
+          }
+        }
+      }
+      QPointF corner;
+      if (best_a >= 0 &&
+        best_cross > std::sin(angle_tolerance) &&
+        intersect(lines[best_a], lines[best_b], corner) &&
+        std::hypot(corner.x() - p.x(), corner.y() - p.y()) <=
+        2.0 * distance_tolerance)
+        q = corner;
+
+      move.x = q.x();
+      move.y = q.y();
+    });
+
+  // drop the points which are already where they should be
+  moves.erase(
+    std::remove_if(
+      moves.begin(),
+      moves.end(),
+      [&points](const Move& move)
+      {
+        const QPointF& p = points[move.idx];
+        return std::abs(move.x - p.x()) < 1e-9 &&
+        std::abs(move.y - p.y()) < 1e-9;
+      }),
+    moves.end());
+  return moves;
+}
+
+ColinearAlignment::Line ColinearAlignment::fit_line(
+  const std::vector<QPointF>& points,
+  const std::vector<int>& idxs)
+{
+  double cx = 0.0;
+  double cy = 0.0;
+  for (const int idx : idxs)
+  {
+    cx += points[idx].x();
+    cy += points[idx].y();
+  }
+  cx /= idxs.size();
+  cy /= idxs.size();
+
+  double sxx = 0.0;
+  double sxy = 0.0;
+  double syy = 0.0;
+  for (const int idx : idxs)
+  {
+    const double dx = points[idx].x() - cx;
+    const double dy = points[idx].y() - cy;
+    sxx += dx * dx;
+    sxy += dx * dy;
+    syy += dy * dy;
+  }
+
+  // direction of greatest spread, the principal axis of the covariance
+  const double phi = 0.5 * std::atan2(2.0 * sxy, sxx - syy);
+  Line line;
+  line.point = QPointF(cx, cy);
+  line.ux = std::cos(phi);
+  line.uy = std::sin(phi);
+  return line;
+}
+
+double ColinearAlignment::distance(const Line& line, const QPointF& p)
+{
+  const double dx = p.x() - line.point.x();
+  const double dy = p.y() - line.point.y();
+  return std::abs(dx * line.uy - dy * line.ux);
+}
+
+QPointF ColinearAlignment::project(const Line& line, const QPointF& p)
+{
+  const double t =
+    (p.x() - line.point.x()) * line.ux + (p.y() - line.point.y()) * line.uy;
+  return QPointF(
+    line.point.x() + t * line.ux,
+    line.point.y() + t * line.uy);
+}
+
+bool ColinearAlignment::intersect(const Line& a, const Line& b, QPointF& p)
+{
+  const double cross = a.ux * b.uy - a.uy * b.ux;
+  if (std::abs(cross) < 1e-12)
+    return false;
+  const double dx = b.point.x() - a.point.x();
+  const double dy = b.point.y() - a.point.y();
+  const double t = (dx * b.uy - dy * b.ux) / cross;
+  p = QPointF(a.point.x() + t * a.ux, a.point.y() + t * a.uy);
+  return true;
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__COLINEAR_ALIGNMENT_HPP
+#define TRAFFIC_EDITOR__COLINEAR_ALIGNMENT_HPP
+
+#include <utility>
+#include <vector>
+
+#include <QPointF>
+
+//=============================================================================
+/// Straightens whole drawings at once: finds the points which lie along a
+/// common line, within a tolerance, and moves them exactly onto it.
+///
+/// Starting from the longest segment (edge), a group grows through the
+/// segments which touch it, or touch a point within distance_tolerance of
+/// it (found with a SpatialGrid), and which lie on its line. A
+/// total-least-squares line is fitted to the points of each group. Each
+/// point is then projected onto its line in parallel, or moved to the
+/// intersection of its lines if it is the corner of two.
+class ColinearAlignment
+{
+public:
+  struct Move
+  {
+    int idx = -1;
+    double x = 0.0;
+    double y = 0.0;
+  };
+
+  /// Points which should move, and where to. Segments are pairs of indices
+  /// into points. Groups of less than three points are left alone, as are
+  /// groups with a point further than distance_tolerance from their line.
+  static std::vector<Move> align(
+    const std::vector<QPointF>& points,
+    const std::vector<std::pair<int, int>>& segments,
+    const double distance_tolerance,
+    const double angle_tolerance);
+
+private:
+  struct Line
+  {
+    QPointF point;  // on the line
+    double ux = 1.0;  // unit direction
+    double uy = 0.0;
+  };
+
+  static Line fit_line(
+    const std::vector<QPointF>& points,
+    const std::vector<int>& idxs);
+
+  static double distance(const Line& line, const QPointF& p);
+  static QPointF project(const Line& line, const QPointF& p);
+  static bool intersect(const Line& a, const Line& b, QPointF& p);
+};
+
+#endif
@@ -0,0 +1,412 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <stdexcept>
+#include <istream>
+#include <unordered_map>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <yaml-cpp/yaml.h>
+
+#include "building_cache.hpp"
+#include "compact_building.hpp"
+#include "compressed_stream.hpp"
+#include "coordinate_system.h"
+#include "logging.hpp"
+#include "task_pool.hpp"
+
+using std::string;
+
+namespace {
+
+/// The value of a parameter in the [type, value] form of Param::to_yaml()
+template<typename T>
+T param_value(const YAML::Node& params, const char* key, const T& fallback)
+{
+  if (!params || !params.IsMap())
+    return fallback;
+  const YAML::Node param = params[key];
+  if (!param || !param.IsSequence() || param.size() < 2)
+    return fallback;
+  return param[1].as<T>();
+}
+
+/// Grow the rect to take in p; QRectF::operator|() skips empty rects, so
+/// it can't start from a single point
+void extend(QRectF& rect, const CompactBuilding::Point& p)
+{
+  if (rect.isNull())
+  {
+    rect = QRectF(p.x, p.y, 0.0, 0.0);
+    return;
+  }
+  rect.setLeft(std::min<qreal>(rect.left(), p.x));
+  rect.setRight(std::max<qreal>(rect.right(), p.x));
+  rect.setTop(std::min<qreal>(rect.top(), p.y));
+  rect.setBottom(std::max<qreal>(rect.bottom(), p.y));
+}
+
+void read_edges(
+  const YAML::Node& data,
+  const char* key,
+  const CompactBuilding::EdgeKind kind,
+  std::vector<double>& distances,
+  CompactBuilding::Level& level)
+{
+  const YAML::Node edges = data[key];
+  if (!edges || !edges.IsSequence())
+    return;
+
+  const std::size_t num_vertices = level.vertices.size();
+  for (const YAML::Node& e : edges)
+  {
+    if (!e.IsSequence() || e.size() < 2)
+      continue;
+    const int start = e[0].as<int>();
+    const int end = e[1].as<int>();
+    if (start < 0 || end < 0 ||
+      static_cast<std::size_t>(start) >= num_vertices ||
+      static_cast<std::size_t>(end) >= num_vertices)
+      continue;
+
+    CompactBuilding::Edge edge;
+    edge.start = static_cast<uint32_t>(start);
+    edge.end = static_cast<uint32_t>(end);
+    edge.kind = kind;
+    const YAML::Node params = e.size() > 2 ? e[2] : YAML::Node();
+    if (kind == CompactBuilding::LANE || kind == CompactBuilding::HUMAN_LANE)
+      edge.graph_idx =
+        static_cast<uint8_t>(param_value<int>(params, "graph_idx", 0));
+    if (kind == CompactBuilding::HUMAN_LANE)
+      edge.width = param_value<float>(params, "width", -1.0f);
+    if (kind == CompactBuilding::MEASUREMENT)
+    {
+      // the scale is estimated as in Level::calculate_scale()
+      const double meters = param_value<double>(params, "distance", -1.0);
+      const CompactBuilding::Point& a = level.vertices[edge.start];
+      const CompactBuilding::Point& b = level.vertices[edge.end];
+      const double pixels = std::hypot(b.x - a.x, b.y - a.y);
+      if (meters >= 0.0 && pixels > 0.0)
+        distances.push_back(meters / pixels);
+    }
+    level.edges.push_back(edge);
+  }
+}
+
+void read_polygons(
+  const YAML::Node& data,
+  const char* key,
+  CompactBuilding::Level& level)
+{
+  const YAML::Node polygons = data[key];
+  if (!polygons || !polygons.IsSequence())
+    return;
+
+  for (const YAML::Node& p : polygons)
+  {
+    if (!p.IsMap() || !p["vertices"])
+      continue;
+    const std::size_t start = level.polygon_vertices.size();
+    for (const YAML::Node& v : p["vertices"])
+    {
+      const int idx = v.as<int>();
+      if (idx >= 0 && static_cast<std::size_t>(idx) < level.vertices.size())
+        level.polygon_vertices.push_back(static_cast<uint32_t>(idx));
+    }
+    if (level.polygon_vertices.size() - start < 3)
+    {
+      level.polygon_vertices.resize(start);
+      continue;
+    }
+    level.polygon_starts.push_back(
+      static_cast<uint32_t>(level.polygon_vertices.size()));
+  }
+}
+
+void read_level(
+  const YAML::Node& data,
+  const double default_scale,
+  CompactBuilding::Level& level)
+{
+  if (!data.IsMap())
+    throw std::runtime_error("expected a map");
+
+  if (data["elevation"])
+    level.elevation = data["elevation"].as<double>();
+  if (data["drawing"] && data["drawing"].IsMap() &&
+    data["drawing"]["filename"])
+    level.drawing_filename = data["drawing"]["filename"].as<string>();
+
+  std::unordered_map<string, uint32_t> name_indices;
+  level.names.push_back(string());
+  name_indices[string()] = 0;
+  const YAML::Node vertices = data["vertices"];
+  if (vertices && vertices.IsSequence())
+  {
+    level.vertices.reserve(vertices.size());
+    level.vertex_names.reserve(vertices.size());
+    for (const YAML::Node& v : vertices)
+    {
+      if (!v.IsSequence() || v.size() < 2)
+        throw std::runtime_error("expected a sequence for a vertex");
+      CompactBuilding::Point p;
+      p.x = v[0].as<float>();
+      p.y = v[1].as<float>();
+      level.vertices.push_back(p);
+      extend(level.bounds, p);
+
+      const string vertex_name = v.size() >= 4 ? v[3].as<string>() : string();
+      auto it = name_indices.find(vertex_name);
+      if (it == name_indices.end())
+      {
+        it = name_indices.emplace(
+          vertex_name,
+          static_cast<uint32_t>(level.names.size())).first;
+        level.names.push_back(vertex_name);
+      }
+      level.vertex_names.push_back(it->second);
+    }
+  }
+
+  std::vector<double> scales;
+  read_edges(data, "lanes", CompactBuilding::LANE, scales, level);
+  read_edges(data, "walls", CompactBuilding::WALL, scales, level);
+  read_edges(data, "measurements", CompactBuilding::MEASUREMENT, scales, level);
+  read_edges(data, "doors", CompactBuilding::DOOR, scales, level);
+  read_edges(data, "human_lanes", CompactBuilding::HUMAN_LANE, scales, level);
+  if (scales.empty())
+    level.meters_per_pixel = default_scale;
+  else
+  {
+    double sum = 0.0;
+    for (const double s : scales)
+      sum += s;
+    level.meters_per_pixel = sum / scales.size();
+  }
+
+  level.polygon_starts.push_back(0);
+  read_polygons(data, "floors", level);
+  level.num_floors = level.num_polygons();
+  read_polygons(data, "holes", level);
+
+  const YAML::Node models = data["models"];
+  if (models && models.IsSequence())
+  {
+    level.models.reserve(models.size());
+    for (const YAML::Node& m : models)
+    {
+      if (!m.IsMap())
+        continue;
+      CompactBuilding::Model model;
+      model.position.x = m["x"].as<float>();
+      model.position.y = m["y"].as<float>();
+      model.yaw = m["yaw"] ? m["yaw"].as<float>() : 0.0f;
+      level.models.push_back(model);
+      extend(level.bounds, model.position);
+    }
+  }
+
+  // the vectors were grown piece by piece; the viewer keeps them for good
+  level.vertices.shrink_to_fit();
+  level.vertex_names.shrink_to_fit();
+  level.names.shrink_to_fit();
+  level.edges.shrink_to_fit();
+  level.polygon_starts.shrink_to_fit();
+  level.polygon_vertices.shrink_to_fit();
+}
+
+template<typename T>
+std::size_t vector_bytes(const std::vector<T>& v)
+{
+  return v.capacity() * sizeof(T);
+}
+
+}  // namespace
+
+bool CompactBuilding::load(const string& _filename)
+{
+  *this = CompactBuilding();
+  filename = _filename;
+
+  // the sidecar is only worth hashing the file for when there is one
+  YAML::Node y;
+  if (QFileInfo::exists(
+      QString::fromStdString(BuildingCache::cache_filename(filename))) &&
+    BuildingCache::load(filename, BuildingCache::file_hash(filename), y))
+    qCInfo(lc_io, "viewing %s from its cache", filename.c_str());
+
+  if (!y)
+  {
+    const CompressedStream::Format compression =
+      CompressedStream::format_for(filename);
+    if (!CompressedStream::is_supported(compression))
+    {
+      qCWarning(lc_io, "couldn't read %s: built without %s support",
+        filename.c_str(),
+        CompressedStream::format_name(compression));
+      return false;
+    }
+    try
+    {
+      if (compression == CompressedStream::NONE)
+        y = YAML::LoadFile(filename);
+      else
+      {
+        QFile file(QString::fromStdString(filename));
+        if (!file.open(QIODevice::ReadOnly))
+        {
+          qCWarning(lc_io, "couldn't open %s: %s",
+            filename.c_str(),
+            qUtf8Printable(file.errorString()));
+          return false;
+        }
+        DecompressingStreamBuf stream_buf(&file, compression);
+        std::istream fin(&stream_buf);
+        y = YAML::Load(fin);
+        if (!stream_buf.error().empty())
+        {
+          qCWarning(lc_io, "couldn't decompress %s: %s",
+            filename.c_str(),
+            stream_buf.error().c_str());
+          return false;
+        }
+      }
+    }
+    catch (const std::exception& e)
+    {
+      qCWarning(lc_io, "couldn't parse %s: %s", filename.c_str(), e.what());
+      return false;
+    }
+  }
+
+  if (y["name"])
+    name = y["name"].as<string>();
+  CoordinateSystem coordinate_system(CoordinateSystem::ReferenceImage);
+  if (y["coordinate_system"])
+    coordinate_system =
+      CoordinateSystem::from_string(y["coordinate_system"].as<string>());
+  y_flipped = coordinate_system.is_y_flipped();
+
+  // the sections of a split building are in files of their own, which are
+  // named relative to the building file
+  const QDir dir(QFileInfo(QString::fromStdString(filename)).absolutePath());
+  YAML::Node graphs = y["graphs"];
+  try
+  {
+    if (graphs && graphs.IsScalar())
+      graphs = YAML::LoadFile(
+        dir.filePath(QString::fromStdString(graphs.as<string>()))
+        .toStdString())["graphs"];
+    if (graphs && graphs.IsMap())
+    {
+      for (YAML::const_iterator it = graphs.begin(); it != graphs.end(); ++it)
+      {
+        if (it->second.IsMap() && it->second["default_lane_width"])
+          default_lane_widths[it->first.as<int>()] =
+            it->second["default_lane_width"].as<double>();
+      }
+    }
+  }
+  catch (const std::exception& e)
+  {
+    qCWarning(lc_io, "ignoring the graphs of %s: %s",
+      filename.c_str(),
+      e.what());
+  }
+
+  const YAML::Node yl = y["levels"];
+  if (!yl || !yl.IsMap())
+  {
+    qCWarning(lc_io, "expected top-level dictionary named 'levels'");
+    return false;
+  }
+  std::vector<YAML::Node> level_data;
+  for (YAML::const_iterator it = yl.begin(); it != yl.end(); ++it)
+  {
+    Level level;
+    level.name = it->first.as<string>();
+    levels.push_back(level);
+    level_data.push_back(it->second);
+  }
+
+  // as in Building::load(), the levels are read concurrently from the
+  // shared (read-only) tree
+  std::vector<string> errors(levels.size());
+  const double default_scale = coordinate_system.default_scale();
+  TaskPool::instance().parallel_for(
+    static_cast<int>(levels.size()),
+    [&](int i)
+    {
+      try
+      {
+        YAML::Node data = level_data[i];
+        if (data.IsScalar())
+        {
+          const string level_filename =
+            dir.filePath(QString::fromStdString(data.as<string>()))
+            .toStdString();
+          data = YAML::LoadFile(level_filename)[levels[i].name];
+          if (!data)
+            throw std::runtime_error(
+              level_filename + " has no level " + levels[i].name);
+        }
+        read_level(data, default_scale, levels[i]);
+      }
+      catch (const std::exception& e)
+      {
+        errors[i] = e.what();
+      }
+    });
+
+  for (std::size_t i = 0; i < levels.size(); i++)
+  {
+    if (!errors[i].empty())
+    {
+      qCWarning(lc_io, "couldn't read level %s of %s: %s",
+        levels[i].name.c_str(),
+        filename.c_str(),
+        errors[i].c_str());
+      levels.clear();
+      return false;
+    }
+  }
+  return true;
+}
+
+std::size_t CompactBuilding::memory_usage() const
+{
+  std::size_t bytes = vector_bytes(levels);
+  for (const Level& level : levels)
+  {
+    bytes += vector_bytes(level.vertices);
+    bytes += vector_bytes(level.vertex_names);
+    bytes += vector_bytes(level.names);
+    for (const string& s : level.names)
+      bytes += s.capacity();
+    bytes += vector_bytes(level.edges);
+    bytes += vector_bytes(level.polygon_starts);
+    bytes += vector_bytes(level.polygon_vertices);
+    bytes += vector_bytes(level.models);
+  }
+  return bytes;
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef TRAFFIC_EDITOR__COMPACT_BUILDING_HPP
+#define TRAFFIC_EDITOR__COMPACT_BUILDING_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <QRectF>
+
+//=============================================================================
+/// What the read-only viewer needs of a building, in flat arrays which are
+/// filled once by load() and not changed after. There are no per-entity
+/// objects, parameter maps, undo history or crowd_sim configuration, so a
+/// big building takes a fraction of the memory (and time) of a Building.
+/// The YAML tree is read from the BuildingCache sidecar when it matches
+/// the file, and dropped as soon as the arrays are filled.
+class CompactBuilding
+{
+public:
+  struct Point
+  {
+    float x = 0.0f;
+    float y = 0.0f;
+  };
+
+  enum EdgeKind : uint8_t
+  {
+    LANE = 0,
+    HUMAN_LANE,
+    WALL,
+    DOOR,
+    MEASUREMENT,
+    NUM_EDGE_KINDS
+  };
+
+  struct Edge
+  {
+    uint32_t start = 0;
+    uint32_t end = 0;
+    float width = -1.0f;  // meters, of human lanes which have their own
+    uint8_t kind = LANE;
+    uint8_t graph_idx = 0;
+  };
+
+  struct Model
+  {
+    Point position;
+    float yaw = 0.0f;
+  };
+
+  struct Level
+  {
+    std::string name;
+    double elevation = 0.0;
+    double meters_per_pixel = 0.05;
+    std::string drawing_filename;  // relative to the building file
+
+    std::vector<Point> vertices;
+    std::vector<uint32_t> vertex_names;  // into names; 0 if it has none
+    std::vector<std::string> names;  // each once, starting with ""
+    std::vector<Edge> edges;
+
+    /// The vertices of floor (and then hole) i are polygon_vertices
+    /// [polygon_starts[i], polygon_starts[i + 1])
+    std::vector<uint32_t> polygon_starts;
+    std::vector<uint32_t> polygon_vertices;
+    std::size_t num_floors = 0;
+
+    std::vector<Model> models;
+
+    /// Around the vertices and models, in pixels
+    QRectF bounds;
+
+    std::size_t num_polygons() const
+    {
+      return polygon_starts.empty() ? 0 : polygon_starts.size() - 1;
+    }
+  };
+
+  std::string filename;
+  std::string name;
+  bool y_flipped = true;
+  std::map<int, double> default_lane_widths;  // meters, by graph index
+  std::vector<Level> levels;
+
+  /// Replace the contents with the building in this file. Returns false,
+  /// with a warning logged, if it can't be read.
+  bool load(const std::string& filename);
+
+  /// Bytes held by the arrays
+  std::size_t memory_usage() const;
+};
+
+#endif
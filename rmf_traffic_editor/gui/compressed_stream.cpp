@@ -0,0 +1,491 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <vector>
+
+#include <QIODevice>
+#include <QThread>
+
+#include <zlib.h>
+#ifdef HAS_ZSTD
+#include <zstd.h>
+#endif
+
+#include "compressed_stream.hpp"
+
+using std::string;
+
+namespace {
+
+const std::size_t CHUNK_SIZE = 256 * 1024;
+
+bool ends_with(const string& s, const string& suffix)
+{
+  return s.size() >= suffix.size() &&
+    s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+}  // namespace
+
+//=============================================================================
+CompressedStream::Format CompressedStream::format_for(const string& filename)
+{
+  if (ends_with(filename, ".gz"))
+    return GZIP;
+  if (ends_with(filename, ".zst"))
+    return ZSTD;
+  return NONE;
+}
+
+string CompressedStream::without_extension(const string& filename)
+{
+  switch (format_for(filename))
+  {
+    case GZIP: return filename.substr(0, filename.size() - 3);
+    case ZSTD: return filename.substr(0, filename.size() - 4);
+    default: return filename;
+  }
+}
+
+bool CompressedStream::is_supported(const Format format)
+{
+#ifdef HAS_ZSTD
+  (void)format;
+  return true;
+#else
+  return format != ZSTD;
+#endif
+}
+
+const char* CompressedStream::format_name(const Format format)
+{
+  switch (format)
+  {
+    case GZIP: return "gzip";
+    case ZSTD: return "zstd";
+    default: return "none";
+  }
+}
+
+//=============================================================================
+struct DecompressingStreamBuf::Impl
+{
+  QIODevice* source = nullptr;
+  CompressedStream::Format format = CompressedStream::NONE;
+  std::vector<char> in;
+  std::vector<char> out;
+  bool input_done = false;
+  bool stream_done = false;  // at the end of a gzip member or zstd frame
+  std::uint64_t bytes_out = 0;
+  string error;
+
+  z_stream z;
+  bool z_open = false;
+#ifdef HAS_ZSTD
+  ZSTD_DStream* zstd = nullptr;
+  ZSTD_inBuffer zstd_in {nullptr, 0, 0};
+#endif
+
+  /// More input into in, if in is used up; false if the device failed
+  bool read(const bool used_up, const char*& data, std::size_t& size);
+
+  /// The next decompressed bytes into out; 0 at the end or on an error
+  std::size_t fill();
+  std::size_t fill_gzip();
+  std::size_t fill_zstd();
+};
+
+bool DecompressingStreamBuf::Impl::read(
+  const bool used_up,
+  const char*& data,
+  std::size_t& size)
+{
+  if (!used_up || input_done)
+    return true;
+  const qint64 n = source->read(in.data(), static_cast<qint64>(in.size()));
+  if (n < 0)
+  {
+    error = source->errorString().toStdString();
+    return false;
+  }
+  input_done = n == 0;
+  data = in.data();
+  size = static_cast<std::size_t>(n);
+  return true;
+}
+
+std::size_t DecompressingStreamBuf::Impl::fill()
+{
+  if (!error.empty())
+    return 0;
+  if (format == CompressedStream::GZIP)
+    return fill_gzip();
+  if (format == CompressedStream::ZSTD)
+    return fill_zstd();
+
+  const qint64 n = source->read(out.data(), static_cast<qint64>(out.size()));
+  if (n < 0)
+    error = source->errorString().toStdString();
+  return n > 0 ? static_cast<std::size_t>(n) : 0;
+}
+
+std::size_t DecompressingStreamBuf::Impl::fill_gzip()
+{
+  for (;;)
+  {
+    const char* data = nullptr;
+    std::size_t size = 0;
+    if (!read(z.avail_in == 0, data, size))
+      return 0;
+    if (data)
+    {
+      z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+      z.avail_in = static_cast<uInt>(size);
+    }
+
+    // gzip files may hold several members, one after the other
+    if (stream_done && z.avail_in > 0)
+    {
+      inflateReset(&z);
+      stream_done = false;
+    }
+    if (!stream_done)
+    {
+      z.next_out = reinterpret_cast<Bytef*>(out.data());
+      z.avail_out = static_cast<uInt>(out.size());
+      const int result = inflate(&z, Z_NO_FLUSH);
+      if (result == Z_STREAM_END)
+        stream_done = true;
+      else if (result != Z_OK && result != Z_BUF_ERROR)
+      {
+        error = z.msg ? z.msg : "corrupt gzip data";
+        return 0;
+      }
+      const std::size_t produced = out.size() - z.avail_out;
+      if (produced > 0)
+        return produced;
+    }
+    if (z.avail_in == 0 && input_done)
+    {
+      if (!stream_done)
+        error = "truncated gzip data";
+      return 0;
+    }
+  }
+}
+
+std::size_t DecompressingStreamBuf::Impl::fill_zstd()
+{
+#ifdef HAS_ZSTD
+  for (;;)
+  {
+    const char* data = nullptr;
+    std::size_t size = 0;
+    if (!read(zstd_in.pos == zstd_in.size, data, size))
+      return 0;
+    if (data)
+      zstd_in = ZSTD_inBuffer {data, size, 0};
+
+    ZSTD_outBuffer zstd_out {out.data(), out.size(), 0};
+    const std::size_t result =
+      ZSTD_decompressStream(zstd, &zstd_out, &zstd_in);
+    if (ZSTD_isError(result))
+    {
+      error = ZSTD_getErrorName(result);
+      return 0;
+    }
+    stream_done = result == 0;
+    if (zstd_out.pos > 0)
+      return zstd_out.pos;
+    if (zstd_in.pos == zstd_in.size && input_done)
+    {
+      if (!stream_done)
+        error = "truncated zstd data";
+      return 0;
+    }
+  }
+#else
+  error = "built without zstd";
+  return 0;
+#endif
+}
+
+DecompressingStreamBuf::DecompressingStreamBuf(
+  QIODevice* source,
+  const CompressedStream::Format format)
+: _impl(new Impl)
+{
+  _impl->source = source;
+  _impl->format = format;
+  _impl->in.resize(format == CompressedStream::NONE ? 0 : CHUNK_SIZE);
+  _impl->out.resize(CHUNK_SIZE);
+  if (format == CompressedStream::GZIP)
+  {
+    Impl& impl = *_impl;
+    impl.z.zalloc = Z_NULL;
+    impl.z.zfree = Z_NULL;
+    impl.z.opaque = Z_NULL;
+    impl.z.next_in = Z_NULL;
+    impl.z.avail_in = 0;
+    // 32 more window bits detects the gzip (or zlib) header
+    impl.z_open = inflateInit2(&impl.z, 15 + 32) == Z_OK;
+    if (!impl.z_open)
+      impl.error = "couldn't start zlib";
+  }
+#ifdef HAS_ZSTD
+  if (format == CompressedStream::ZSTD)
+    _impl->zstd = ZSTD_createDStream();
+#endif
+}
+
+DecompressingStreamBuf::~DecompressingStreamBuf()
+{
+  if (_impl->z_open)
+    inflateEnd(&_impl->z);
+#ifdef HAS_ZSTD
+  if (_impl->zstd)
+    ZSTD_freeDStream(_impl->zstd);
+#endif
+}
+
+const string& DecompressingStreamBuf::error() const
+{
+  return _impl->error;
+}
+
+std::uint64_t DecompressingStreamBuf::bytes_out() const
+{
+  return _impl->bytes_out;
+}
+
+DecompressingStreamBuf::int_type DecompressingStreamBuf::underflow()
+{
+  if (gptr() < egptr())
+    return traits_type::to_int_type(*gptr());
+  const std::size_t n = _impl->fill();
+  if (n == 0)
+    return traits_type::eof();
+  _impl->bytes_out += n;
+  char* begin = _impl->out.data();
+  setg(begin, begin, begin + n);
+  return traits_type::to_int_type(*gptr());
+}
+
+//=============================================================================
+struct CompressingStreamBuf::Impl
+{
+  std::streambuf* sink = nullptr;
+  CompressedStream::Format format = CompressedStream::NONE;
+  std::vector<char> in;
+  std::vector<char> out;
+  std::uint64_t bytes_in = 0;
+  bool finished = false;
+  string error;
+
+  z_stream z;
+  bool z_open = false;
+#ifdef HAS_ZSTD
+  ZSTD_CCtx* zstd = nullptr;
+#endif
+
+  bool write_out(const std::size_t n)
+  {
+    if (n == 0 ||
+      sink->sputn(out.data(), static_cast<std::streamsize>(n)) ==
+      static_cast<std::streamsize>(n))
+      return true;
+    error = "couldn't write the compressed data";
+    return false;
+  }
+
+  bool compress(const char* data, const std::size_t size, const bool end);
+};
+
+bool CompressingStreamBuf::Impl::compress(
+  const char* data,
+  const std::size_t size,
+  const bool end)
+{
+  if (!error.empty())
+    return false;
+  bytes_in += size;
+
+  if (format == CompressedStream::NONE)
+  {
+    if (sink->sputn(data, static_cast<std::streamsize>(size)) ==
+      static_cast<std::streamsize>(size))
+      return true;
+    error = "couldn't write the data";
+    return false;
+  }
+
+  if (format == CompressedStream::GZIP)
+  {
+    if (!z_open)
+      return false;
+    z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    z.avail_in = static_cast<uInt>(size);
+    int result = Z_OK;
+    do
+    {
+      z.next_out = reinterpret_cast<Bytef*>(out.data());
+      z.avail_out = static_cast<uInt>(out.size());
+      result = deflate(&z, end ? Z_FINISH : Z_NO_FLUSH);
+      if (result == Z_STREAM_ERROR)
+      {
+        error = "gzip compression failed";
+        return false;
+      }
+      if (!write_out(out.size() - z.avail_out))
+        return false;
+    } while (z.avail_out == 0 || (end && result != Z_STREAM_END));
+    return true;
+  }
+
+#ifdef HAS_ZSTD
+  if (!zstd)
+    return false;
+  ZSTD_inBuffer zstd_in {data, size, 0};
+  for (;;)
+  {
+    ZSTD_outBuffer zstd_out {out.data(), out.size(), 0};
+    const std::size_t remaining = ZSTD_compressStream2(
+      zstd,
+      &zstd_out,
+      &zstd_in,
+      end ? ZSTD_e_end : ZSTD_e_continue);
+    if (ZSTD_isError(remaining))
+    {
+      error = ZSTD_getErrorName(remaining);
+      return false;
+    }
+    if (!write_out(zstd_out.pos))
+      return false;
+    if (end ? remaining == 0 : zstd_in.pos == zstd_in.size)
+      return true;
+  }
+#else
+  error = "built without zstd";
+  return false;
+#endif
+}
+
+CompressingStreamBuf::CompressingStreamBuf(
+  std::streambuf* sink,
+  const CompressedStream::Format format,
+  const int threads)
+: _impl(new Impl)
+{
+  _impl->sink = sink;
+  _impl->format = format;
+  _impl->in.resize(CHUNK_SIZE);
+  _impl->out.resize(format == CompressedStream::NONE ? 0 : CHUNK_SIZE);
+  setp(_impl->in.data(), _impl->in.data() + _impl->in.size());
+
+  if (format == CompressedStream::GZIP)
+  {
+    Impl& impl = *_impl;
+    impl.z.zalloc = Z_NULL;
+    impl.z.zfree = Z_NULL;
+    impl.z.opaque = Z_NULL;
+    // 16 more window bits writes a gzip header and trailer
+    impl.z_open = deflateInit2(
+      &impl.z,
+      Z_DEFAULT_COMPRESSION,
+      Z_DEFLATED,
+      15 + 16,
+      8,
+      Z_DEFAULT_STRATEGY) == Z_OK;
+    if (!impl.z_open)
+      impl.error = "couldn't start zlib";
+  }
+#ifdef HAS_ZSTD
+  if (format == CompressedStream::ZSTD)
+  {
+    _impl->zstd = ZSTD_createCCtx();
+    if (_impl->zstd)
+    {
+      ZSTD_CCtx_setParameter(_impl->zstd, ZSTD_c_compressionLevel, 3);
+      // ignored if libzstd was built without multithreading
+      ZSTD_CCtx_setParameter(
+        _impl->zstd,
+        ZSTD_c_nbWorkers,
+        threads > 0 ? threads : QThread::idealThreadCount());
+    }
+    else
+      _impl->error = "couldn't start zstd";
+  }
+#else
+  (void)threads;
+#endif
+}
+
+CompressingStreamBuf::~CompressingStreamBuf()
+{
+  if (_impl->z_open)
+    deflateEnd(&_impl->z);
+#ifdef HAS_ZSTD
+  if (_impl->zstd)
+    ZSTD_freeCCtx(_impl->zstd);
+#endif
+}
+
+bool CompressingStreamBuf::compress_buffer(const bool end)
+{
+  const std::size_t n = static_cast<std::size_t>(pptr() - pbase());
+  const bool ok = _impl->compress(pbase(), n, end);
+  setp(_impl->in.data(), _impl->in.data() + _impl->in.size());
+  return ok;
+}
+
+bool CompressingStreamBuf::finish()
+{
+  if (_impl->finished)
+    return _impl->error.empty();
+  _impl->finished = true;
+  return compress_buffer(true);
+}
+
+const string& CompressingStreamBuf::error() const
+{
+  return _impl->error;
+}
+
+std::uint64_t CompressingStreamBuf::bytes_in() const
+{
+  return _impl->bytes_in + static_cast<std::uint64_t>(pptr() - pbase());
+}
+
+CompressingStreamBuf::int_type CompressingStreamBuf::overflow(int_type c)
+{
+  if (_impl->finished || !compress_buffer(false))
+    return traits_type::eof();
+  if (traits_type::eq_int_type(c, traits_type::eof()))
+    return traits_type::not_eof(c);
+  *pptr() = traits_type::to_char_type(c);
+  pbump(1);
+  return c;
+}
+
+int CompressingStreamBuf::sync()
+{
+  // only hands on what is buffered; the compressor keeps what it needs
+  if (_impl->finished)
+    return _impl->error.empty() ? 0 : -1;
+  return compress_buffer(false) ? 0 : -1;
+}
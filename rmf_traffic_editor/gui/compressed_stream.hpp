@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__COMPRESSED_STREAM_HPP
+#define TRAFFIC_EDITOR__COMPRESSED_STREAM_HPP
+
+#include <cstdint>
+#include <memory>
+#include <streambuf>
+#include <string>
+
+class QIODevice;
+
+//=============================================================================
+/// The compressions a building file may be saved with, told apart by the
+/// extension after .building.yaml. gzip goes through zlib, which is always
+/// there; zstd only when libzstd was found at build time (HAS_ZSTD).
+class CompressedStream
+{
+public:
+  enum Format
+  {
+    NONE = 0,
+    GZIP,  // .gz
+    ZSTD   // .zst
+  };
+
+  static Format format_for(const std::string& filename);
+
+  /// The filename without its .gz or .zst, if it has one
+  static std::string without_extension(const std::string& filename);
+
+  static bool is_supported(const Format format);
+
+  static const char* format_name(const Format format);
+};
+
+//=============================================================================
+/// Decompresses a device a chunk at a time for a std::istream, so that a
+/// compressed file can be parsed without holding either the compressed or
+/// the decompressed text in memory as a whole.
+class DecompressingStreamBuf : public std::streambuf
+{
+public:
+  DecompressingStreamBuf(
+    QIODevice* source,
+    const CompressedStream::Format format);
+  ~DecompressingStreamBuf();
+
+  /// Empty unless the data was truncated or corrupt, which only shows up
+  /// to the reader as the end of the stream
+  const std::string& error() const;
+
+  std::uint64_t bytes_out() const;
+
+protected:
+  int_type underflow() override;
+
+private:
+  struct Impl;
+  std::unique_ptr<Impl> _impl;
+};
+
+//=============================================================================
+/// Compresses what is written to it into another streambuf. finish() must
+/// be called once everything is written, to end the compressed stream.
+class CompressingStreamBuf : public std::streambuf
+{
+public:
+  /// threads is only used by zstd; 0 is one per core
+  CompressingStreamBuf(
+    std::streambuf* sink,
+    const CompressedStream::Format format,
+    const int threads = 0);
+  ~CompressingStreamBuf();
+
+  /// Compress what is left and end the stream. False if compressing or
+  /// writing to the sink failed at any point.
+  bool finish();
+
+  const std::string& error() const;
+
+  std::uint64_t bytes_in() const;
+
+protected:
+  int_type overflow(int_type c) override;
+  int sync() override;
+
+private:
+  struct Impl;
+  std::unique_ptr<Impl> _impl;
+
+  bool compress_buffer(const bool end);
+};
+
+#endif
@@ -0,0 +1,312 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <cmath>
+#include <cstring>
+
+#include <QUuid>
+#include <yaml-cpp/yaml.h>
+
+#include "content_hash.hpp"
+#include "level.h"
+
+namespace {
+
+/// The finalizer of MurmurHash3
+std::uint64_t mix(std::uint64_t x)
+{
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdull;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ull;
+  x ^= x >> 33;
+  return x;
+}
+
+/// As to_yaml() rounds positions
+double round_to(const double value, const double scale)
+{
+  return std::round(value * scale) / scale;
+}
+
+template<typename T>
+std::uint64_t hash_section(
+  const std::vector<T>& elements,
+  std::vector<std::uint64_t>& hashes)
+{
+  hashes.resize(elements.size());
+  ContentHash::Builder builder;
+  builder.add(static_cast<std::uint64_t>(elements.size()));
+  for (std::size_t i = 0; i < elements.size(); i++)
+  {
+    hashes[i] = ContentHash::of(elements[i]);
+    builder.add(hashes[i]);
+  }
+  return builder.value();
+}
+
+}  // namespace
+
+ContentHash::Builder& ContentHash::Builder::add(const std::uint64_t value)
+{
+  _h = mix(_h ^ (value + 0x9e3779b97f4a7c15ull * ++_count));
+  return *this;
+}
+
+ContentHash::Builder& ContentHash::Builder::add(const int value)
+{
+  return add(static_cast<std::uint64_t>(static_cast<std::int64_t>(value)));
+}
+
+ContentHash::Builder& ContentHash::Builder::add(const bool value)
+{
+  return add(static_cast<std::uint64_t>(value ? 1 : 0));
+}
+
+ContentHash::Builder& ContentHash::Builder::add(const double value)
+{
+  // -0.0 saves as 0, and all NaNs alike
+  double canonical = value == 0.0 ? 0.0 : value;
+  if (std::isnan(canonical))
+    canonical = std::nan("");
+  std::uint64_t bits;
+  std::memcpy(&bits, &canonical, sizeof(bits));
+  return add(bits);
+}
+
+ContentHash::Builder& ContentHash::Builder::add(const std::string& value)
+{
+  add(static_cast<std::uint64_t>(value.size()));
+  std::size_t i = 0;
+  for (; i + 8 <= value.size(); i += 8)
+  {
+    std::uint64_t word;
+    std::memcpy(&word, value.data() + i, 8);
+    add(word);
+  }
+  if (i < value.size())
+  {
+    std::uint64_t word = 0;
+    std::memcpy(&word, value.data() + i, value.size() - i);
+    add(word);
+  }
+  return *this;
+}
+
+ContentHash::Builder& ContentHash::Builder::add(const QUuid& id)
+{
+  std::uint64_t data4;
+  std::memcpy(&data4, id.data4, sizeof(data4));
+  add(
+    (static_cast<std::uint64_t>(id.data1) << 32) |
+    (static_cast<std::uint64_t>(id.data2) << 16) |
+    id.data3);
+  return add(data4);
+}
+
+ContentHash::Builder& ContentHash::Builder::add(const ParamMap& params)
+{
+  add(static_cast<std::uint64_t>(params.size()));
+  for (const auto& param : params)
+  {
+    const Param& value = param.second;
+    add(param.first);
+    add(static_cast<int>(value.type));
+    if (value.type == Param::STRING)
+      add(value.value_string);
+    else if (value.type == Param::INT)
+      add(value.value_int);
+    else if (value.type == Param::DOUBLE)
+      add(value.value_double);
+    else if (value.type == Param::BOOL)
+      add(value.value_bool);
+  }
+  return *this;
+}
+
+std::uint64_t ContentHash::Builder::value() const
+{
+  return mix(_h ^ _count);
+}
+
+std::uint64_t ContentHash::of(const Vertex& vertex)
+{
+  return Builder()
+    .add(round_to(vertex.x, 1000.0))
+    .add(round_to(vertex.y, 1000.0))
+    .add(vertex.name)
+    .add(vertex.params)
+    .value();
+}
+
+std::uint64_t ContentHash::of(const Edge& edge)
+{
+  return Builder()
+    .add(static_cast<int>(edge.type))
+    .add(edge.start_idx)
+    .add(edge.end_idx)
+    .add(edge.params)
+    .value();
+}
+
+std::uint64_t ContentHash::of(const Polygon& polygon)
+{
+  Builder builder;
+  builder.add(static_cast<int>(polygon.type));
+  builder.add(static_cast<std::uint64_t>(polygon.vertices.size()));
+  for (const int vertex_idx : polygon.vertices)
+    builder.add(vertex_idx);
+  return builder.add(polygon.params).value();
+}
+
+std::uint64_t ContentHash::of(const Model& model)
+{
+  return Builder()
+    .add(round_to(model.state.x, 1000.0))
+    .add(round_to(model.state.y, 1000.0))
+    .add(round_to(model.state.z, 1000.0))
+    .add(round_to(model.state.yaw, 10000.0))
+    .add(model.instance_name)
+    .add(model.model_name)
+    .add(model.is_static)
+    .value();
+}
+
+std::uint64_t ContentHash::of(const Fiducial& fiducial)
+{
+  return Builder()
+    .add(round_to(fiducial.x, 1000.0))
+    .add(round_to(fiducial.y, 1000.0))
+    .add(fiducial.name)
+    .value();
+}
+
+std::uint64_t ContentHash::of(const Feature& feature)
+{
+  return Builder()
+    .add(round_to(feature.x(), 1000.0))
+    .add(round_to(feature.y(), 1000.0))
+    .add(feature.name())
+    .add(feature.id())
+    .value();
+}
+
+std::uint64_t ContentHash::of(const Constraint& constraint)
+{
+  Builder builder;
+  builder.add(static_cast<std::uint64_t>(constraint.ids().size()));
+  for (const QUuid& id : constraint.ids())
+    builder.add(id);
+  return builder.value();
+}
+
+std::uint64_t ContentHash::of(const Tag& tag)
+{
+  return Builder()
+    .add(round_to(tag.x, 1000.0))
+    .add(round_to(tag.y, 1000.0))
+    .add(tag.name)
+    .add(tag.params)
+    .value();
+}
+
+std::uint64_t ContentHash::of(const Layer& layer)
+{
+  Builder builder;
+  builder
+  .add(layer.name)
+  .add(layer.filename)
+  .add(layer.visible)
+  .add(round_to(layer.color.redF(), 1000.0))
+  .add(round_to(layer.color.greenF(), 1000.0))
+  .add(round_to(layer.color.blueF(), 1000.0))
+  .add(round_to(layer.color.alphaF(), 1000.0))
+  .add(layer.transform.yaw())
+  .add(layer.transform.translation().x())
+  .add(layer.transform.translation().y())
+  .add(layer.transform.scale());
+  builder.add(static_cast<std::uint64_t>(layer.features.size()));
+  for (const Feature& feature : layer.features)
+    builder.add(of(feature));
+  return builder.value();
+}
+
+std::uint64_t ContentHash::of(const YAML::Node& node)
+{
+  YAML::Emitter emitter;
+  emitter << node;
+  return Builder().add(std::string(emitter.c_str(), emitter.size())).value();
+}
+
+const char* ContentHash::section_name(const Section section)
+{
+  switch (section)
+  {
+    case VERTICES: return "vertices";
+    case EDGES: return "edges";
+    case POLYGONS: return "polygons";
+    case MODELS: return "models";
+    case FIDUCIALS: return "fiducials";
+    case FEATURES: return "features";
+    case CONSTRAINTS: return "constraints";
+    case TAGS: return "tags";
+    case LAYERS: return "layers";
+    default: return "";
+  }
+}
+
+void ContentHash::hash_level(const Level& level, LevelHashes& hashes)
+{
+  hashes.sections[VERTICES] =
+    hash_section(level.vertices, hashes.entities[VERTICES]);
+  hashes.sections[EDGES] = hash_section(level.edges, hashes.entities[EDGES]);
+  hashes.sections[POLYGONS] =
+    hash_section(level.polygons, hashes.entities[POLYGONS]);
+  hashes.sections[MODELS] =
+    hash_section(level.models, hashes.entities[MODELS]);
+  hashes.sections[FIDUCIALS] =
+    hash_section(level.fiducials, hashes.entities[FIDUCIALS]);
+  hashes.sections[FEATURES] =
+    hash_section(level.floorplan_features, hashes.entities[FEATURES]);
+  hashes.sections[CONSTRAINTS] =
+    hash_section(level.constraints, hashes.entities[CONSTRAINTS]);
+  hashes.sections[TAGS] = hash_section(level.tags, hashes.entities[TAGS]);
+  hashes.sections[LAYERS] =
+    hash_section(level.layers, hashes.entities[LAYERS]);
+
+  Builder builder;
+  builder
+  .add(level.name)
+  .add(level.drawing_filename)
+  .add(level.drawing_filename.empty() ? level.x_meters : 0.0)
+  .add(level.drawing_filename.empty() ? level.y_meters : 0.0)
+  .add(level.elevation)
+  .add(level.flattened_x_offset)
+  .add(level.flattened_y_offset);
+  if (!level.vector_underlay.empty())
+    builder.add(of(level.vector_underlay.to_yaml()));
+  for (int i = 0; i < NUM_SECTIONS; i++)
+    builder.add(hashes.sections[i]);
+  hashes.level = builder.value();
+  hashes.revision = level.revision();
+  hashes.valid = true;
+}
+
+QString ContentHash::to_hex(const std::uint64_t hash)
+{
+  return QString("%1").arg(hash, 16, 16, QChar('0'));
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__CONTENT_HASH_HPP
+#define TRAFFIC_EDITOR__CONTENT_HASH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <QString>
+
+class Constraint;
+class Edge;
+class Feature;
+class Fiducial;
+class Layer;
+class Level;
+class Model;
+class ParamMap;
+class Polygon;
+class QUuid;
+class Tag;
+class Vertex;
+
+namespace YAML {
+class Node;
+}
+
+//=============================================================================
+/// 64-bit hashes of what a building saves, for telling cheaply whether
+/// something changed. Each entity is hashed from the values its to_yaml()
+/// writes, rounded the same way, so two entities which save alike hash
+/// alike, from one run to the next. The hashes of the entities of a
+/// section of a level (its vertices, its edges, ...) are hashed in order
+/// into the hash of the section, those of the sections into the hash of
+/// the level, and those of the levels into the hash of the building.
+class ContentHash
+{
+public:
+  /// Mixes values into a hash, each with its length where it has one, so
+  /// that ("ab", "c") and ("a", "bc") differ
+  class Builder
+  {
+  public:
+    Builder& add(const std::uint64_t value);
+    Builder& add(const int value);
+    Builder& add(const bool value);
+    Builder& add(const double value);
+    Builder& add(const std::string& value);
+    Builder& add(const QUuid& id);
+    Builder& add(const ParamMap& params);
+
+    std::uint64_t value() const;
+
+  private:
+    std::uint64_t _h = 0x243f6a8885a308d3ull;
+    std::uint64_t _count = 0;
+  };
+
+  static std::uint64_t of(const Vertex& vertex);
+  static std::uint64_t of(const Edge& edge);
+  static std::uint64_t of(const Polygon& polygon);
+  static std::uint64_t of(const Model& model);
+  static std::uint64_t of(const Fiducial& fiducial);
+  static std::uint64_t of(const Feature& feature);
+  static std::uint64_t of(const Constraint& constraint);
+  static std::uint64_t of(const Tag& tag);
+  static std::uint64_t of(const Layer& layer);
+
+  /// Of the emitted text of the node, for the small sections of a building
+  static std::uint64_t of(const YAML::Node& node);
+
+  enum Section
+  {
+    VERTICES = 0,
+    EDGES,
+    POLYGONS,
+    MODELS,
+    FIDUCIALS,
+    FEATURES,  // of the floorplan; those of the layers are in LAYERS
+    CONSTRAINTS,
+    TAGS,
+    LAYERS,
+    NUM_SECTIONS
+  };
+
+  static const char* section_name(const Section section);
+
+  /// Everything hashed of one level. entities[section][i] is the hash of
+  /// element i of the vector of that section of the level.
+  struct LevelHashes
+  {
+    bool valid = false;
+    std::size_t revision = 0;  // of the level, see Level::revision()
+    std::uint64_t level = 0;
+    std::uint64_t sections[NUM_SECTIONS] = {};
+    std::vector<std::uint64_t> entities[NUM_SECTIONS];
+  };
+
+  static void hash_level(const Level& level, LevelHashes& hashes);
+
+  /// 16 lowercase hex digits
+  static QString to_hex(const std::uint64_t hash);
+};
+
+#endif
@@ -0,0 +1,511 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "building.h"
+#include "coordinate_conversion.hpp"
+#include "task_pool.hpp"
+
+namespace {
+
+const double EARTH_RADIUS = 6378137.0;  // of EPSG:3857
+
+/// x' = sx * x + tx, y' = sy * y + ty: the maps between the coordinate
+/// systems only scale, flip y and shift
+struct AxisMap
+{
+  double sx = 1.0;
+  double sy = 1.0;
+  double tx = 0.0;
+  double ty = 0.0;
+
+  QPointF apply(const QPointF& p) const
+  {
+    return QPointF(sx * p.x() + tx, sy * p.y() + ty);
+  }
+
+  /// This map, then next
+  AxisMap then(const AxisMap& next) const
+  {
+    AxisMap m;
+    m.sx = next.sx * sx;
+    m.sy = next.sy * sy;
+    m.tx = next.sx * tx + next.tx;
+    m.ty = next.sy * ty + next.ty;
+    return m;
+  }
+
+  bool flips() const { return (sx < 0.0) != (sy < 0.0); }
+};
+
+void map_points(const AxisMap& m, std::vector<QPointF>& points)
+{
+  QPointF* p = points.data();
+  const std::size_t count = points.size();
+  for (std::size_t i = 0; i < count; i++)
+    p[i] = QPointF(m.sx * p[i].x() + m.tx, m.sy * p[i].y() + m.ty);
+}
+
+struct Bounds
+{
+  double min_x = std::numeric_limits<double>::infinity();
+  double min_y = std::numeric_limits<double>::infinity();
+  double max_x = -std::numeric_limits<double>::infinity();
+  double max_y = -std::numeric_limits<double>::infinity();
+
+  bool empty() const { return min_x > max_x; }
+
+  void add(const QPointF& p)
+  {
+    min_x = std::min(min_x, p.x());
+    min_y = std::min(min_y, p.y());
+    max_x = std::max(max_x, p.x());
+    max_y = std::max(max_y, p.y());
+  }
+
+  void add(const std::vector<QPointF>& points)
+  {
+    for (const QPointF& p : points)
+      add(p);
+  }
+
+  void add(const Bounds& other)
+  {
+    if (other.empty())
+      return;
+    add(QPointF(other.min_x, other.min_y));
+    add(QPointF(other.max_x, other.max_y));
+  }
+
+  /// As a map which only scales and shifts takes them
+  Bounds mapped(const AxisMap& m) const
+  {
+    Bounds b;
+    if (!empty())
+    {
+      b.add(m.apply(QPointF(min_x, min_y)));
+      b.add(m.apply(QPointF(max_x, max_y)));
+    }
+    return b;
+  }
+};
+
+/// Scale of EPSG:3857 at this northing, in meters on the ground per meter
+double mercator_scale(const double northing)
+{
+  const double latitude =
+    2.0 * std::atan(std::exp(northing / EARTH_RADIUS)) - M_PI / 2.0;
+  return std::cos(latitude);
+}
+
+/// The frame which is drawn of a level, in its own units
+Bounds level_frame(const Level& level, const CoordinateSystem& crs)
+{
+  Bounds b;
+  if (level.drawing_width > 0 && level.drawing_height > 0)
+  {
+    b.add(QPointF(0.0, 0.0));
+    b.add(QPointF(level.drawing_width, level.drawing_height));
+  }
+  else if (crs.value == CoordinateSystem::CartesianMeters)
+  {
+    b.add(QPointF(0.0, 0.0));
+    b.add(QPointF(level.x_meters, level.y_meters));
+  }
+  return b;
+}
+
+std::string unique_layer_name(const Level& level)
+{
+  std::string name = "floorplan";
+  for (int i = 2; ; i++)
+  {
+    const bool taken = std::any_of(
+      level.layers.begin(),
+      level.layers.end(),
+      [&name](const Layer& layer) { return layer.name == name; });
+    if (!taken)
+      return name;
+    name = "floorplan_" + std::to_string(i);
+  }
+}
+
+}  // namespace
+
+//=============================================================================
+CoordinateConversion::State CoordinateConversion::capture(
+  const Building& building)
+{
+  State state;
+  state.coordinate_system = building.coordinate_system;
+  state.levels.resize(building.levels.size());
+  TaskPool::instance().parallel_for(
+    static_cast<int>(building.levels.size()),
+    [&building, &state](const int i)
+    {
+      const Level& level = building.levels[i];
+      LevelState& s = state.levels[i];
+      s.meters_per_pixel = level.drawing_meters_per_pixel;
+      s.x_meters = level.x_meters;
+      s.y_meters = level.y_meters;
+      s.drawing_filename = level.drawing_filename;
+      s.drawing_width = level.drawing_width;
+      s.drawing_height = level.drawing_height;
+
+      s.vertices.reserve(level.vertices.size());
+      for (const Vertex& v : level.vertices)
+        s.vertices.push_back(QPointF(v.x, v.y));
+      s.tags.reserve(level.tags.size());
+      for (const Tag& tag : level.tags)
+        s.tags.push_back(QPointF(tag.x, tag.y));
+      s.models.reserve(level.models.size());
+      for (const Model& model : level.models)
+        s.models.push_back(QPointF(model.state.x, model.state.y));
+      s.fiducials.reserve(level.fiducials.size());
+      for (const Fiducial& fiducial : level.fiducials)
+        s.fiducials.push_back(QPointF(fiducial.x, fiducial.y));
+      s.floorplan_features.reserve(level.floorplan_features.size());
+      for (const Feature& feature : level.floorplan_features)
+        s.floorplan_features.push_back(QPointF(feature.x(), feature.y()));
+
+      s.layer_features.resize(level.layers.size());
+      for (std::size_t j = 0; j < level.layers.size(); j++)
+      {
+        const Layer& layer = level.layers[j];
+        s.layer_transforms.push_back(layer.transform);
+        for (const Feature& feature : layer.features)
+          s.layer_features[j].push_back(QPointF(feature.x(), feature.y()));
+      }
+    });
+
+  state.lifts.reserve(building.lifts.size());
+  for (const Lift& lift : building.lifts)
+    state.lifts.push_back(QPointF(lift.x, lift.y));
+  return state;
+}
+
+bool CoordinateConversion::convert(
+  Building& building,
+  const Options& options,
+  State& result,
+  std::string& error)
+{
+  const CoordinateSystem source = building.coordinate_system;
+  const CoordinateSystem target = options.target;
+  if (target.value == CoordinateSystem::Undefined ||
+    source.value == CoordinateSystem::Undefined)
+  {
+    error = "the coordinate system is undefined";
+    return false;
+  }
+  if (target.value == source.value)
+  {
+    error = "the building is already in " + source.to_string();
+    return false;
+  }
+  if (target.value == CoordinateSystem::ReferenceImage &&
+    !(options.meters_per_pixel > 0.0))
+  {
+    error = "the meters per pixel must be positive";
+    return false;
+  }
+  if (target.value == CoordinateSystem::WebMercator && !options.has_origin)
+  {
+    error = "a WebMercator target needs an origin";
+    return false;
+  }
+  if (building.levels.empty())
+  {
+    error = "the building has no levels";
+    return false;
+  }
+
+  result = capture(building);
+  result.coordinate_system = target;
+  const int num_levels = static_cast<int>(building.levels.size());
+
+  // the lifts are in the units of their reference floors
+  const int ref_idx = building.get_reference_level_idx();
+  std::vector<int> lift_levels(building.lifts.size(), ref_idx);
+  for (std::size_t i = 0; i < building.lifts.size(); i++)
+  {
+    const int idx =
+      building.find_level_idx(building.lifts[i].reference_floor_name);
+    if (idx >= 0)
+      lift_levels[i] = idx;
+  }
+
+  // the extent of each level in its own units, in parallel
+  std::vector<Bounds> level_bounds(num_levels);
+  TaskPool::instance().parallel_for(
+    num_levels,
+    [&](const int i)
+    {
+      const LevelState& s = result.levels[i];
+      Bounds& b = level_bounds[i];
+      b.add(level_frame(building.levels[i], source));
+      b.add(s.vertices);
+      b.add(s.tags);
+      b.add(s.models);
+      b.add(s.fiducials);
+      b.add(s.floorplan_features);
+    });
+  for (std::size_t i = 0; i < result.lifts.size(); i++)
+    level_bounds[lift_levels[i]].add(result.lifts[i]);
+
+  // from the units of each level to local meters, x east and y north
+  std::vector<AxisMap> to_local(num_levels);
+  if (source.value == CoordinateSystem::ReferenceImage)
+  {
+    // the bottom of the reference drawing is the origin, as it is the y
+    // of the other systems which points up
+    const Level& ref_level = building.levels[ref_idx];
+    const double mpp = ref_level.drawing_meters_per_pixel;
+    const double height = ref_level.drawing_height > 0 ?
+      ref_level.drawing_height : ref_level.y_meters / mpp;
+    for (int i = 0; i < num_levels; i++)
+    {
+      const Building::Transform t = building.get_transform_to_reference(i);
+      AxisMap& m = to_local[i];
+      m.sx = mpp * t.scale;
+      m.sy = -mpp * t.scale;
+      m.tx = mpp * t.dx;
+      m.ty = mpp * (height - t.dy);
+    }
+  }
+  else if (source.value == CoordinateSystem::WebMercator)
+  {
+    QPointF origin = options.origin;
+    if (!options.has_origin)
+    {
+      Bounds all;
+      for (const Bounds& b : level_bounds)
+        all.add(b);
+      if (!all.empty())
+        origin = QPointF(
+          0.5 * (all.min_x + all.max_x),
+          0.5 * (all.min_y + all.max_y));
+    }
+    const double k = mercator_scale(origin.y());
+    for (AxisMap& m : to_local)
+    {
+      m.sx = m.sy = k;
+      m.tx = -k * origin.x();
+      m.ty = -k * origin.y();
+    }
+  }
+  // CartesianMeters already is local meters
+
+  Bounds local;
+  for (int i = 0; i < num_levels; i++)
+    local.add(level_bounds[i].mapped(to_local[i]));
+  if (local.empty())
+    local.add(QPointF(0.0, 0.0));
+
+  // and from there to the target, which is the same for every level. The
+  // systems with a frame keep everything in it at positive coordinates
+  const double x0 = std::min(0.0, local.min_x);
+  const double y0 = std::min(0.0, local.min_y);
+  const double x1 = std::max(x0, local.max_x);
+  const double y1 = std::max(y0, local.max_y);
+  AxisMap to_target;
+  double target_mpp = 1.0;
+  switch (target.value)
+  {
+    case CoordinateSystem::ReferenceImage:
+      target_mpp = options.meters_per_pixel;
+      to_target.sx = 1.0 / target_mpp;
+      to_target.sy = -1.0 / target_mpp;
+      to_target.tx = -x0 / target_mpp;
+      to_target.ty = y1 / target_mpp;
+      break;
+    case CoordinateSystem::WebMercator:
+    {
+      const double k = mercator_scale(options.origin.y());
+      to_target.sx = to_target.sy = 1.0 / k;
+      to_target.tx = options.origin.x();
+      to_target.ty = options.origin.y();
+      break;
+    }
+    default:
+      to_target.tx = -x0;
+      to_target.ty = -y0;
+      break;
+  }
+
+  // everything of a level goes through one map, in one pass, in parallel
+  TaskPool::instance().parallel_for(
+    num_levels,
+    [&](const int i)
+    {
+      const Level& level = building.levels[i];
+      LevelState& s = result.levels[i];
+      const AxisMap m = to_local[i].then(to_target);
+      map_points(m, s.vertices);
+      map_points(m, s.tags);
+      map_points(m, s.models);
+      map_points(m, s.fiducials);
+      map_points(m, s.floorplan_features);
+
+      // the drawing becomes a layer, which is to level meters what the
+      // drawing is to the level
+      const double level_mpp = level.drawing_meters_per_pixel;
+      if (source.value == CoordinateSystem::ReferenceImage &&
+        !level.drawing_filename.empty())
+      {
+        Transform drawing_transform;
+        drawing_transform.setScale(level_mpp);
+        s.layer_transforms.push_back(drawing_transform);
+        s.layer_features.push_back(std::vector<QPointF>());
+        s.drawing_layer_name = unique_layer_name(level);
+        s.drawing_layer_filename = level.drawing_filename;
+        s.drawing_filename.clear();
+        s.drawing_width = 0;
+        s.drawing_height = 0;
+      }
+
+      // the layer pixels are in the frame of the level, so if its y axis
+      // turns over, so do they, and their yaw
+      const double flip = m.flips() ? -1.0 : 1.0;
+      for (std::size_t j = 0; j < s.layer_transforms.size(); j++)
+      {
+        Transform& t = s.layer_transforms[j];
+        const QPointF origin = m.apply(t.translation() / level_mpp);
+        t.setScale(std::abs(m.sx) * t.scale() * target_mpp / level_mpp);
+        t.setYaw(flip * t.yaw());
+        t.setTranslation(origin * target_mpp);
+        for (QPointF& p : s.layer_features[j])
+          p.setY(flip * p.y());
+      }
+
+      s.meters_per_pixel = target_mpp;
+      s.x_meters = x1 - x0;
+      s.y_meters = y1 - y0;
+    });
+
+  for (std::size_t i = 0; i < result.lifts.size(); i++)
+    result.lifts[i] = to_local[lift_levels[i]].then(to_target).apply(
+      result.lifts[i]);
+  return true;
+}
+
+void CoordinateConversion::apply(Building& building, const State& state)
+{
+  building.coordinate_system = state.coordinate_system;
+  const std::size_t num_levels =
+    std::min(state.levels.size(), building.levels.size());
+  for (std::size_t i = 0; i < num_levels; i++)
+  {
+    Level& level = building.levels[i];
+    const LevelState& s = state.levels[i];
+    level.drawing_meters_per_pixel = s.meters_per_pixel;
+    level.x_meters = s.x_meters;
+    level.y_meters = s.y_meters;
+    if (level.drawing_filename != s.drawing_filename)
+    {
+      // load_images() decodes it again, if there is one
+      level.drawing_filename = s.drawing_filename;
+      level.unload_image(-1);
+    }
+    level.drawing_width = s.drawing_width;
+    level.drawing_height = s.drawing_height;
+
+    for (std::size_t j = 0; j < level.vertices.size() &&
+      j < s.vertices.size(); j++)
+    {
+      level.vertices[j].x = s.vertices[j].x();
+      level.vertices[j].y = s.vertices[j].y();
+    }
+    for (std::size_t j = 0; j < level.tags.size() && j < s.tags.size(); j++)
+    {
+      level.tags[j].x = s.tags[j].x();
+      level.tags[j].y = s.tags[j].y();
+    }
+    for (std::size_t j = 0; j < level.models.size() &&
+      j < s.models.size(); j++)
+    {
+      level.models[j].state.x = s.models[j].x();
+      level.models[j].state.y = s.models[j].y();
+    }
+    for (std::size_t j = 0; j < level.fiducials.size() &&
+      j < s.fiducials.size(); j++)
+    {
+      level.fiducials[j].x = s.fiducials[j].x();
+      level.fiducials[j].y = s.fiducials[j].y();
+    }
+    for (std::size_t j = 0; j < level.floorplan_features.size() &&
+      j < s.floorplan_features.size(); j++)
+    {
+      level.floorplan_features[j].set_x(s.floorplan_features[j].x());
+      level.floorplan_features[j].set_y(s.floorplan_features[j].y());
+    }
+
+    // the layer made of the drawing comes and goes with the conversion;
+    // its image is decoded by load_images() as the level is next drawn
+    if (!s.drawing_layer_name.empty() &&
+      level.layers.size() + 1 == s.layer_transforms.size())
+    {
+      Layer layer;
+      layer.name = s.drawing_layer_name;
+      layer.filename = s.drawing_layer_filename;
+      layer.color = Layer::default_color(level.layers.size());
+      level.layers.push_back(std::move(layer));
+      level.unload_image(static_cast<int>(level.layers.size()) - 1);
+    }
+    else if (level.layers.size() == s.layer_transforms.size() + 1)
+      level.layers.pop_back();
+
+    for (std::size_t j = 0; j < level.layers.size() &&
+      j < s.layer_transforms.size(); j++)
+    {
+      Layer& layer = level.layers[j];
+      layer.transform = s.layer_transforms[j];
+      const std::vector<QPointF>& features = s.layer_features[j];
+      for (std::size_t k = 0; k < layer.features.size() &&
+        k < features.size(); k++)
+      {
+        layer.features[k].set_x(features[k].x());
+        layer.features[k].set_y(features[k].y());
+      }
+      level.mark_layer_transform_changed(static_cast<int>(j));
+    }
+    level.mark_all_changed();
+  }
+
+  for (std::size_t i = 0; i < building.lifts.size() &&
+    i < state.lifts.size(); i++)
+  {
+    building.lifts[i].x = state.lifts[i].x();
+    building.lifts[i].y = state.lifts[i].y();
+  }
+  building.invalidate_lift_graphics();
+  building.clear_transform_cache();
+}
+
+QPointF CoordinateConversion::web_mercator(
+  const double latitude,
+  const double longitude)
+{
+  const double lat = latitude * M_PI / 180.0;
+  return QPointF(
+    EARTH_RADIUS * longitude * M_PI / 180.0,
+    EARTH_RADIUS * std::log(std::tan(M_PI / 4.0 + lat / 2.0)));
+}
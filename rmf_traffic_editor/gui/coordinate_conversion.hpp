@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef TRAFFIC_EDITOR__COORDINATE_CONVERSION_HPP
+#define TRAFFIC_EDITOR__COORDINATE_CONVERSION_HPP
+
+#include <string>
+#include <vector>
+
+#include <QPointF>
+
+#include "coordinate_system.h"
+#include "transform.hpp"
+
+class Building;
+
+//=============================================================================
+/// Reprojects a whole building into another coordinate system: the
+/// vertices, tags, models, fiducials and features of every level, the
+/// layer transforms and the lifts. Each level is first taken to local
+/// meters, x east and y north, through its transform to the reference
+/// level and the reference's drawing_meters_per_pixel (of a ReferenceImage
+/// building) or by flattening EPSG:3857 around an origin (of a WebMercator
+/// one), and from there into the target. Both steps only scale, flip y
+/// and shift, so each level is one such map, which is applied to its
+/// points in one pass, the levels in parallel.
+///
+/// Yaws are of the world (y up) in every coordinate system, so those of
+/// models and lifts stay as they are; only a layer, whose pixels are in
+/// the frame of its level, is mirrored along with the level. The drawing
+/// of a ReferenceImage level becomes a layer of the same image. A vector
+/// underlay (DXF) is left as it is.
+class CoordinateConversion
+{
+public:
+  struct Options
+  {
+    CoordinateSystem target = CoordinateSystem::CartesianMeters;
+
+    /// Of the levels of a ReferenceImage target
+    double meters_per_pixel = 0.05;
+
+    /// In EPSG:3857 meters: where the origin of the local meters lands in
+    /// a WebMercator target, and of a WebMercator building, the point
+    /// which becomes that origin. Without one, the center of a WebMercator
+    /// building is used (a WebMercator target needs one).
+    bool has_origin = false;
+    QPointF origin;
+  };
+
+  /// Where everything of a level is, in the order of its vectors
+  struct LevelState
+  {
+    double meters_per_pixel = 0.05;
+    double x_meters = 10.0;
+    double y_meters = 10.0;
+    std::string drawing_filename;
+    int drawing_width = 0;
+    int drawing_height = 0;
+
+    std::vector<QPointF> vertices;
+    std::vector<QPointF> tags;
+    std::vector<QPointF> models;
+    std::vector<QPointF> fiducials;
+    std::vector<QPointF> floorplan_features;
+    std::vector<Transform> layer_transforms;
+    std::vector<std::vector<QPointF>> layer_features;
+
+    /// If not empty, the drawing of this file was made the last layer,
+    /// of this name, which the level doesn't have before the conversion
+    std::string drawing_layer_name;
+    std::string drawing_layer_filename;
+  };
+
+  struct State
+  {
+    CoordinateSystem coordinate_system;
+    std::vector<LevelState> levels;
+    std::vector<QPointF> lifts;
+  };
+
+  /// The building as it is
+  static State capture(const Building& building);
+
+  /// The building as it would be in options.target, or false with the
+  /// reason in error. The building is only modified by fitting its level
+  /// transforms, if they weren't already.
+  static bool convert(
+    Building& building,
+    const Options& options,
+    State& result,
+    std::string& error);
+
+  /// Put the building in this state, of capture() or convert()
+  static void apply(Building& building, const State& state);
+
+  /// EPSG:3857 meters of a latitude and longitude in degrees
+  static QPointF web_mercator(const double latitude, const double longitude);
+};
+
+#endif
@@ -27,11 +27,7 @@ CoordinateSystem::CoordinateSystem(const CoordinateSystem::Value& _value)
 {
 }
 
-CoordinateSystem::~CoordinateSystem()
-{
-}
-
-std::string CoordinateSystem::to_string()
+std::string CoordinateSystem::to_string() const
 {
   switch (value)
   {
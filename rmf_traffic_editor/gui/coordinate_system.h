@@ -33,9 +33,8 @@ public:
 
   CoordinateSystem();
   CoordinateSystem(const CoordinateSystem::Value& _value);
-  ~CoordinateSystem();
 
-  std::string to_string();
+  std::string to_string() const;
   static CoordinateSystem from_string(const std::string& s);
   bool is_y_flipped() const;
   double default_scale() const;
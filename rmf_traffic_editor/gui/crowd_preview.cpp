@@ -0,0 +1,603 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <queue>
+#include <set>
+
+#include <QtConcurrent/QtConcurrent>
+
+#include "building.h"
+#include "crowd_preview.hpp"
+
+using std::vector;
+
+namespace {
+
+/// How quickly agents take up their preferred velocity, in seconds
+const double RELAXATION_TIME = 0.5;
+
+/// Strength (m/s^2) and range (m) of the push between agents, and the
+/// stiffness (1/s^2) of the body force once they overlap
+const double REPULSION = 2.0;
+const double REPULSION_RANGE = 0.3;
+const double BODY_STIFFNESS = 25.0;
+
+/// Agents are stepped in blocks of this many per task
+const std::size_t BLOCK_SIZE = 256;
+
+}  // anonymous namespace
+
+//=============================================================================
+void CrowdPreview::clear()
+{
+  _level_idx = -1;
+  _profiles.clear();
+  _states.clear();
+  _vertices.clear();
+  _neighbors.clear();
+  _next_hops.clear();
+  _vertex_grid.clear(1.0);
+  _agents.clear();
+  _accelerations.clear();
+  _agent_grid.clear(1.0);
+  _stats = Stats();
+}
+
+bool CrowdPreview::reset(
+  const Building& building,
+  const int level_idx,
+  const Options& options)
+{
+  clear();
+  const crowd_sim::CrowdSimImplPtr impl = building.crowd_sim_impl;
+  if (!impl ||
+    level_idx < 0 ||
+    level_idx >= static_cast<int>(building.levels.size()))
+    return false;
+
+  const Level& level = building.levels[level_idx];
+  _options = options;
+  _level_idx = level_idx;
+  _meters_per_pixel = level.drawing_meters_per_pixel;
+  _rng.seed(options.seed);
+
+  // the human lanes, and the goal areas at their vertices
+  std::map<std::string, vector<int>> area_vertices;
+  _vertices.resize(level.vertices.size());
+  _neighbors.resize(level.vertices.size());
+  for (std::size_t i = 0; i < level.vertices.size(); i++)
+  {
+    const Vertex& v = level.vertices[i];
+    _vertices[i].x = v.x * _meters_per_pixel;
+    _vertices[i].y = -v.y * _meters_per_pixel;
+    const auto it = v.params.find("human_goal_set_name");
+    if (it != v.params.end() && it->second.type == Param::STRING)
+      area_vertices[it->second.value_string].push_back(i);
+  }
+  for (const Edge& edge : level.edges)
+  {
+    if (edge.type != Edge::HUMAN_LANE ||
+      edge.start_idx < 0 || edge.end_idx < 0 ||
+      edge.start_idx >= static_cast<int>(_vertices.size()) ||
+      edge.end_idx >= static_cast<int>(_vertices.size()))
+      continue;
+    _neighbors[edge.start_idx].push_back(edge.end_idx);
+    _neighbors[edge.end_idx].push_back(edge.start_idx);
+  }
+  _vertex_grid.clear(5.0);
+  for (std::size_t i = 0; i < _vertices.size(); i++)
+  {
+    if (!_neighbors[i].empty())
+      _vertex_grid.set(i, _vertices[i].x, _vertices[i].y);
+  }
+
+  std::map<std::string, int> profile_ids;
+  for (const crowd_sim::AgentProfile& agent_profile :
+    impl->get_agent_profiles())
+  {
+    // zero means "unset" in the tables; walk at a normal pace then
+    Profile profile;
+    if (agent_profile.r > 0.0)
+      profile.radius = agent_profile.r;
+    if (agent_profile.pref_speed > 0.0)
+      profile.pref_speed = agent_profile.pref_speed;
+    profile.max_speed = agent_profile.max_speed > 0.0 ?
+      agent_profile.max_speed : 2.0 * profile.pref_speed;
+    if (agent_profile.max_accel > 0.0)
+      profile.max_accel = agent_profile.max_accel;
+    if (agent_profile.neighbor_dist > 0.0)
+      profile.neighbor_dist = agent_profile.neighbor_dist;
+    profile.max_neighbors = agent_profile.max_neighbors;
+    profile_ids[agent_profile.profile_name] = _profiles.size();
+    _profiles.push_back(profile);
+  }
+  if (_profiles.empty())
+    _profiles.push_back(Profile());
+
+  std::map<std::size_t, std::set<std::string>> goal_set_areas;
+  for (const crowd_sim::GoalSet& goal_set : impl->get_goal_sets())
+    goal_set_areas[goal_set.get_goal_set_id()] = goal_set.get_goal_areas();
+
+  std::map<std::string, int> state_ids;
+  for (const crowd_sim::State& state : impl->get_states())
+  {
+    State s;
+    s.final_state = state.get_final_state();
+    const auto areas_it = goal_set_areas.find(state.get_goal_set_id());
+    if (areas_it != goal_set_areas.end())
+    {
+      for (const std::string& area : areas_it->second)
+      {
+        const auto it = area_vertices.find(area);
+        if (it != area_vertices.end())
+          s.goals.insert(s.goals.end(), it->second.begin(), it->second.end());
+      }
+    }
+    state_ids[state.get_name()] = _states.size();
+    _states.push_back(s);
+  }
+
+  for (const crowd_sim::Transition& transition : impl->get_transitions())
+  {
+    const auto from_it = state_ids.find(transition.get_from_state());
+    if (from_it == state_ids.end())
+      continue;
+
+    Transition t;
+    if (!t.condition.compile(transition.get_condition()))
+    {
+      printf(
+        "crowd preview: skipping the transition from [%s], its condition "
+        "is incomplete\n",
+        transition.get_from_state().c_str());
+      continue;
+    }
+    for (const auto& to_state : transition.get_to_state())
+    {
+      const auto to_it = state_ids.find(to_state.first);
+      if (to_it == state_ids.end() || to_state.second <= 0.0)
+        continue;
+      t.to_states.emplace_back(to_it->second, to_state.second);
+      t.total_weight += to_state.second;
+    }
+    if (!t.to_states.empty())
+      _states[from_it->second].transitions.push_back(std::move(t));
+  }
+
+  for (const State& state : _states)
+  {
+    for (const int goal : state.goals)
+    {
+      if (!_next_hops.count(goal))
+        add_next_hops(goal);
+    }
+  }
+
+  // each group starts out packed around its spawn point, in a sunflower
+  // pattern so that nobody starts on top of anybody else
+  const double golden_angle = M_PI * (3.0 - std::sqrt(5.0));
+  double max_neighbor_dist = 1.0;
+  for (const crowd_sim::AgentGroup& group : impl->get_agent_groups())
+  {
+    if (group.is_external_group())
+      continue;
+    const auto state_it = state_ids.find(group.get_initial_state());
+    if (state_it == state_ids.end())
+    {
+      printf(
+        "crowd preview: agent group %d has no initial state, skipping it\n",
+        static_cast<int>(group.get_group_id()));
+      continue;
+    }
+    const auto profile_it = profile_ids.find(group.get_agent_profile());
+    const int profile_idx =
+      profile_it == profile_ids.end() ? 0 : profile_it->second;
+    const Profile& profile = _profiles[profile_idx];
+    max_neighbor_dist = std::max(max_neighbor_dist, profile.neighbor_dist);
+
+    const int count = options.agents_per_group > 0 ?
+      options.agents_per_group : group.get_spawn_number();
+    const std::pair<double, double> spawn_point = group.get_spawn_point();
+    const double spacing = 2.2 * profile.radius;
+    for (int k = 0; k < count; k++)
+    {
+      Agent agent;
+      const double rho = spacing * std::sqrt(static_cast<double>(k));
+      agent.x = spawn_point.first + rho * std::cos(k * golden_angle);
+      agent.y = spawn_point.second + rho * std::sin(k * golden_angle);
+      agent.profile_idx = profile_idx;
+      _agents.push_back(agent);
+      enter_state(_agents.back(), state_it->second);
+    }
+  }
+
+  // queries reach out by neighbor_dist, i.e. mostly into the 3x3 cells
+  // around an agent
+  _agent_grid.clear(max_neighbor_dist);
+  for (std::size_t i = 0; i < _agents.size(); i++)
+    _agent_grid.set(i, _agents[i].x, _agents[i].y);
+  _accelerations.resize(_agents.size());
+
+  _stats.num_agents = static_cast<int>(_agents.size());
+  printf(
+    "crowd preview: %d agents, %d states, %d goal vertices on level [%s]\n",
+    _stats.num_agents,
+    static_cast<int>(_states.size()),
+    static_cast<int>(_next_hops.size()),
+    level.name.c_str());
+  return !_agents.empty();
+}
+
+void CrowdPreview::add_next_hops(const int goal_vertex)
+{
+  // Dijkstra outwards from the goal; each vertex reached points back at
+  // the vertex it was reached from
+  vector<int>& hops = _next_hops[goal_vertex];
+  hops.assign(_vertices.size(), -1);
+  vector<double> cost(_vertices.size(), std::numeric_limits<double>::max());
+  typedef std::pair<double, int> Entry;
+  std::priority_queue<Entry, vector<Entry>, std::greater<Entry>> queue;
+  cost[goal_vertex] = 0.0;
+  hops[goal_vertex] = goal_vertex;
+  queue.push(Entry(0.0, goal_vertex));
+  while (!queue.empty())
+  {
+    const Entry entry = queue.top();
+    queue.pop();
+    const int v = entry.second;
+    if (entry.first > cost[v])
+      continue;
+    for (const int n : _neighbors[v])
+    {
+      const double c = entry.first + std::hypot(
+        _vertices[n].x - _vertices[v].x,
+        _vertices[n].y - _vertices[v].y);
+      if (c < cost[n])
+      {
+        cost[n] = c;
+        hops[n] = v;
+        queue.push(Entry(c, n));
+      }
+    }
+  }
+}
+
+void CrowdPreview::enter_state(Agent& agent, const int state_idx)
+{
+  const State& state = _states[state_idx];
+  agent.state_idx = state_idx;
+  agent.state_time = 0.0f;
+  agent.stopped_time = 0.0f;
+  agent.finished = state.final_state;
+  agent.goal_vertex = -1;
+  agent.waypoint = -1;
+  if (state.goals.empty())
+    return;
+
+  std::uniform_int_distribution<std::size_t> pick(0, state.goals.size() - 1);
+  agent.goal_vertex = state.goals[pick(_rng)];
+
+  // join the lanes at the closest vertex that leads to the goal; if there
+  // is none, head straight for it
+  double distance = 0.0;
+  const int nearest = _vertex_grid.nearest(agent.x, agent.y, distance);
+  const auto hops_it = _next_hops.find(agent.goal_vertex);
+  if (nearest >= 0 && hops_it != _next_hops.end() &&
+    hops_it->second[nearest] >= 0)
+    agent.waypoint = nearest;
+}
+
+CrowdPreview::Point CrowdPreview::target(const Agent& agent) const
+{
+  Point p;
+  if (agent.waypoint >= 0)
+    return _vertices[agent.waypoint];
+  if (agent.goal_vertex >= 0)
+    return _vertices[agent.goal_vertex];
+  p.x = agent.x;
+  p.y = agent.y;
+  return p;
+}
+
+double CrowdPreview::goal_distance(const Agent& agent) const
+{
+  if (agent.goal_vertex < 0)
+    return 0.0;
+  const Point& goal = _vertices[agent.goal_vertex];
+  return std::hypot(goal.x - agent.x, goal.y - agent.y);
+}
+
+void CrowdPreview::step(const double dt)
+{
+  if (_agents.empty() || dt <= 0.0)
+    return;
+  const auto start_time = std::chrono::steady_clock::now();
+
+  // work out every acceleration from the same positions, in parallel
+  vector<std::size_t> blocks;
+  for (std::size_t begin = 0; begin < _agents.size(); begin += BLOCK_SIZE)
+    blocks.push_back(begin);
+  QtConcurrent::blockingMap(
+    blocks,
+    [this](const std::size_t begin)
+    {
+      const std::size_t end = std::min(begin + BLOCK_SIZE, _agents.size());
+      vector<int> ids;
+      vector<std::pair<double, int>> neighbors;
+      for (std::size_t i = begin; i < end; i++)
+      {
+        const Agent& agent = _agents[i];
+        const Profile& profile = _profiles[agent.profile_idx];
+        Point& a = _accelerations[i];
+
+        // towards the target at the preferred speed, slowing down at the
+        // goal itself
+        double desired_vx = 0.0;
+        double desired_vy = 0.0;
+        if (!agent.finished)
+        {
+          const Point t = target(agent);
+          const double dx = t.x - agent.x;
+          const double dy = t.y - agent.y;
+          const double distance = std::hypot(dx, dy);
+          if (distance > 1e-6)
+          {
+            double speed = profile.pref_speed;
+            if (agent.waypoint < 0)
+              speed *= std::min(1.0, distance / (4.0 * profile.radius));
+            desired_vx = dx / distance * speed;
+            desired_vy = dy / distance * speed;
+          }
+        }
+        a.x = (desired_vx - agent.vx) / RELAXATION_TIME;
+        a.y = (desired_vy - agent.vy) / RELAXATION_TIME;
+
+        // pushed away by the closest neighbours
+        const double range = profile.neighbor_dist;
+        ids.clear();
+        _agent_grid.within(
+          agent.x - range, agent.y - range,
+          agent.x + range, agent.y + range,
+          ids);
+        neighbors.clear();
+        for (const int j : ids)
+        {
+          if (j == static_cast<int>(i))
+            continue;
+          const Agent& other = _agents[j];
+          const double d = std::hypot(other.x - agent.x, other.y - agent.y);
+          if (d < range)
+            neighbors.emplace_back(d, j);
+        }
+        if (neighbors.size() > profile.max_neighbors)
+        {
+          std::nth_element(
+            neighbors.begin(),
+            neighbors.begin() + profile.max_neighbors,
+            neighbors.end());
+          neighbors.resize(profile.max_neighbors);
+        }
+        for (const auto& neighbor : neighbors)
+        {
+          const Agent& other = _agents[neighbor.second];
+          const double d = neighbor.first;
+          double nx = 1.0;
+          double ny = 0.0;
+          if (d > 1e-6)
+          {
+            nx = (agent.x - other.x) / d;
+            ny = (agent.y - other.y) / d;
+          }
+          else if (neighbor.second > static_cast<int>(i))
+            nx = -1.0;  // on top of each other; split them up somehow
+          const double overlap =
+            profile.radius + _profiles[other.profile_idx].radius - d;
+          double f = REPULSION * std::exp(overlap / REPULSION_RANGE);
+          if (overlap > 0.0)
+            f += BODY_STIFFNESS * overlap;
+          a.x += f * nx;
+          a.y += f * ny;
+        }
+
+        const double magnitude = std::hypot(a.x, a.y);
+        if (magnitude > profile.max_accel)
+        {
+          a.x *= profile.max_accel / magnitude;
+          a.y *= profile.max_accel / magnitude;
+        }
+      }
+    });
+
+  // then move everybody, which has to be done in one go for the grid
+  _stats.num_stuck = 0;
+  for (std::size_t i = 0; i < _agents.size(); i++)
+  {
+    Agent& agent = _agents[i];
+    const Profile& profile = _profiles[agent.profile_idx];
+    agent.vx += _accelerations[i].x * dt;
+    agent.vy += _accelerations[i].y * dt;
+    const double speed = std::hypot(agent.vx, agent.vy);
+    if (speed > profile.max_speed)
+    {
+      agent.vx *= profile.max_speed / speed;
+      agent.vy *= profile.max_speed / speed;
+    }
+    agent.x += agent.vx * dt;
+    agent.y += agent.vy * dt;
+    _agent_grid.set(i, agent.x, agent.y);
+    agent.state_time += dt;
+
+    if (agent.waypoint >= 0)
+    {
+      const Point& w = _vertices[agent.waypoint];
+      const double reach = std::max(2.0 * profile.radius, 0.5);
+      if (std::hypot(w.x - agent.x, w.y - agent.y) < reach)
+      {
+        if (agent.waypoint == agent.goal_vertex)
+          agent.waypoint = -1;
+        else
+          agent.waypoint = _next_hops[agent.goal_vertex][agent.waypoint];
+      }
+    }
+
+    if (!agent.finished &&
+      std::min(speed, profile.max_speed) < _options.stuck_speed &&
+      goal_distance(agent) > 2.0 * profile.radius)
+      agent.stopped_time += dt;
+    else
+      agent.stopped_time = 0.0f;
+    if (agent.stopped_time >= _options.stuck_time)
+      _stats.num_stuck++;
+  }
+
+  take_transitions();
+
+  _stats.num_finished = 0;
+  for (const Agent& agent : _agents)
+  {
+    if (agent.finished)
+      _stats.num_finished++;
+  }
+  _stats.time += dt;
+  _stats.step_ms = std::chrono::duration<double, std::milli>(
+    std::chrono::steady_clock::now() - start_time).count();
+}
+
+void CrowdPreview::take_transitions()
+{
+  _stats.num_transitions = 0;
+
+  vector<vector<int>> state_agents(_states.size());
+  for (std::size_t i = 0; i < _agents.size(); i++)
+  {
+    const Agent& agent = _agents[i];
+    if (!agent.finished && !_states[agent.state_idx].transitions.empty())
+      state_agents[agent.state_idx].push_back(i);
+  }
+
+  // the conditions of each state are evaluated for all of its agents at
+  // once; the first transition which holds is taken
+  vector<float> goal_distances;
+  vector<float> state_times;
+  vector<uint8_t> holds;
+  vector<uint8_t> taken;
+  for (std::size_t s = 0; s < _states.size(); s++)
+  {
+    const vector<int>& agents = state_agents[s];
+    if (agents.empty())
+      continue;
+
+    goal_distances.resize(agents.size());
+    state_times.resize(agents.size());
+    for (std::size_t k = 0; k < agents.size(); k++)
+    {
+      goal_distances[k] = goal_distance(_agents[agents[k]]);
+      state_times[k] = _agents[agents[k]].state_time;
+    }
+    holds.resize(agents.size());
+    taken.assign(agents.size(), 0);
+
+    for (const Transition& transition : _states[s].transitions)
+    {
+      transition.condition.evaluate(
+        goal_distances.data(),
+        state_times.data(),
+        agents.size(),
+        holds.data());
+      for (std::size_t k = 0; k < agents.size(); k++)
+      {
+        if (!holds[k] || taken[k])
+          continue;
+        taken[k] = 1;
+
+        std::uniform_real_distribution<double> pick(
+          0.0, transition.total_weight);
+        double weight = pick(_rng);
+        int to_state = transition.to_states.back().first;
+        for (const auto& candidate : transition.to_states)
+        {
+          weight -= candidate.second;
+          if (weight <= 0.0)
+          {
+            to_state = candidate.first;
+            break;
+          }
+        }
+        enter_state(_agents[agents[k]], to_state);
+        _stats.num_transitions++;
+      }
+    }
+  }
+}
+
+void CrowdPreview::density(const double cell_size, Density& density) const
+{
+  density = Density();
+  density.cell_size = cell_size;
+  if (_agents.empty() || cell_size <= 0.0)
+    return;
+
+  double x_min = _agents[0].x;
+  double x_max = x_min;
+  double y_min = _agents[0].y;
+  double y_max = y_min;
+  for (const Agent& agent : _agents)
+  {
+    x_min = std::min(x_min, agent.x);
+    x_max = std::max(x_max, agent.x);
+    y_min = std::min(y_min, agent.y);
+    y_max = std::max(y_max, agent.y);
+  }
+  density.x_min = std::floor(x_min / cell_size) * cell_size;
+  density.y_max = std::ceil(y_max / cell_size) * cell_size;
+  density.width =
+    static_cast<int>((x_max - density.x_min) / cell_size) + 1;
+  density.height =
+    static_cast<int>((density.y_max - y_min) / cell_size) + 1;
+  density.values.assign(
+    static_cast<std::size_t>(density.width) * density.height, 0.0f);
+
+  const float per_agent = static_cast<float>(1.0 / (cell_size * cell_size));
+  for (const Agent& agent : _agents)
+  {
+    const int col = std::min(
+      static_cast<int>((agent.x - density.x_min) / cell_size),
+      density.width - 1);
+    const int row = std::min(
+      static_cast<int>((density.y_max - agent.y) / cell_size),
+      density.height - 1);
+    float& value =
+      density.values[static_cast<std::size_t>(row) * density.width + col];
+    value += per_agent;
+    density.max_value = std::max(density.max_value, value);
+  }
+}
+
+void CrowdPreview::to_pixels(
+  const double x,
+  const double y,
+  double& px,
+  double& py) const
+{
+  px = x / _meters_per_pixel;
+  py = -y / _meters_per_pixel;
+}
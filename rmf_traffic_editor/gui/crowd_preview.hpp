@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__CROWD_PREVIEW_HPP
+#define TRAFFIC_EDITOR__CROWD_PREVIEW_HPP
+
+#include <cstdint>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <traffic_editor/crowd_sim/compiled_condition.h>
+
+#include "spatial_grid.hpp"
+
+class Building;
+
+//=============================================================================
+/// A quick look at how a crowd_sim configuration copes with its numbers of
+/// agents, without Gazebo: the agent groups are spawned on one level and
+/// walk the human lanes of that level towards the goal areas of their
+/// states, taking the transitions of the configuration. Agents push each
+/// other apart with a simple social force, found through a spatial grid,
+/// and are stepped in parallel blocks. Agents which stop short of their
+/// goals for a while are counted as stuck, which is how crowding shows up.
+/// Everything is in meters, in the frame the building is exported in
+/// (x to the right, y up).
+class CrowdPreview
+{
+public:
+  struct Options
+  {
+    int agents_per_group = 0;  // 0 for the spawn number of each group
+    unsigned int seed = 0;
+    double stuck_speed = 0.05;  // m/s; slower than this counts as stopped
+    double stuck_time = 5.0;  // seconds stopped before an agent is stuck
+  };
+
+  struct Agent
+  {
+    double x = 0.0;
+    double y = 0.0;
+    double vx = 0.0;
+    double vy = 0.0;
+    int profile_idx = 0;
+    int state_idx = -1;
+    int goal_vertex = -1;  // -1 if the state has no goal
+    int waypoint = -1;  // the next lane vertex on the way to the goal
+    float state_time = 0.0f;  // seconds in the current state
+    float stopped_time = 0.0f;  // seconds stopped short of the goal
+    bool finished = false;  // reached a final state
+  };
+
+  struct Stats
+  {
+    int num_agents = 0;
+    int num_finished = 0;
+    int num_stuck = 0;
+    int num_transitions = 0;  // taken in the last step
+    double time = 0.0;  // simulated seconds since reset()
+    double step_ms = 0.0;  // wall clock time of the last step
+  };
+
+  /// Agents per square meter, in cells of a grid; row 0 is the top (the
+  /// largest y), to match the way levels are drawn
+  struct Density
+  {
+    double x_min = 0.0;
+    double y_max = 0.0;
+    double cell_size = 1.0;
+    int width = 0;
+    int height = 0;
+    std::vector<float> values;
+    float max_value = 0.0f;
+  };
+
+  /// Spawn the agents of the building's crowd_sim configuration on a
+  /// level. Returns false if there is nothing to spawn.
+  bool reset(
+    const Building& building,
+    const int level_idx,
+    const Options& options);
+
+  void clear();
+
+  /// Advance the crowd by dt seconds
+  void step(const double dt);
+
+  bool empty() const { return _agents.empty(); }
+  int level_idx() const { return _level_idx; }
+  const std::vector<Agent>& agents() const { return _agents; }
+  const Stats& stats() const { return _stats; }
+
+  /// Count the agents into cells of this size
+  void density(const double cell_size, Density& density) const;
+
+  /// Convert a point back to the pixel coordinates of the level
+  void to_pixels(const double x, const double y, double& px, double& py)
+  const;
+
+private:
+  struct Point
+  {
+    double x = 0.0;
+    double y = 0.0;
+  };
+
+  struct Profile
+  {
+    double radius = 0.25;
+    double pref_speed = 1.2;
+    double max_speed = 2.0;
+    double max_accel = 5.0;
+    double neighbor_dist = 5.0;
+    std::size_t max_neighbors = 10;
+  };
+
+  struct Transition
+  {
+    crowd_sim::CompiledCondition condition;
+    std::vector<std::pair<int, double>> to_states;  // state, weight
+    double total_weight = 0.0;
+  };
+
+  struct State
+  {
+    bool final_state = false;
+    std::vector<int> goals;  // lane vertices in the goal areas of the state
+    std::vector<Transition> transitions;
+  };
+
+  Options _options;
+  int _level_idx = -1;
+  double _meters_per_pixel = 0.05;
+  std::vector<Profile> _profiles;
+  std::vector<State> _states;
+
+  /// The human lane graph of the level, and for each goal vertex the
+  /// neighbour to head for from every vertex which leads to it
+  std::vector<Point> _vertices;
+  std::vector<std::vector<int>> _neighbors;
+  std::map<int, std::vector<int>> _next_hops;
+  SpatialGrid _vertex_grid;
+
+  std::vector<Agent> _agents;
+  std::vector<Point> _accelerations;  // worked out by the parallel pass
+  SpatialGrid _agent_grid;
+  std::mt19937 _rng;
+  Stats _stats;
+
+  void add_next_hops(const int goal_vertex);
+  void enter_state(Agent& agent, const int state_idx);
+  void take_transitions();
+  Point target(const Agent& agent) const;
+  double goal_distance(const Agent& agent) const;
+};
+
+#endif
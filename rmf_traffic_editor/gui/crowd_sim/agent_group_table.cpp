@@ -60,65 +60,72 @@ void AgentGroupTab::delete_button_click(size_t row_number)
 }
 
 //=======================================
-void AgentGroupTab::list_item_in_cache()
+void AgentGroupTab::list_choices()
 {
-  auto cache_count = get_cache_size();
+  _profile_names.clear();
+  for (const auto& profile : get_impl()->get_agent_profiles())
+    _profile_names.append(QString::fromStdString(profile.profile_name));
 
-  for (auto i = 0; i < cache_count; i++)
-  {
-    auto current_group = _cache[i];
+  _state_names.clear();
+  for (const auto& state : get_impl()->get_states())
+    _state_names.append(QString::fromStdString(state.get_name()));
+}
 
-    setItem(i, 0,
-      new QTableWidgetItem(QString::number(
-        static_cast<int>(current_group.get_group_id()))));
+//=======================================
+void AgentGroupTab::list_item_in_row(int row)
+{
+  const auto& current_group = _cache.at(row);
 
-    auto current_profile = current_group.get_agent_profile();
-    if (i == 0)
-    {
-      setItem(i, 1,
-        new QTableWidgetItem(QString::fromStdString(current_profile) ) );
-    }
-    else
-    {
-      QComboBox* profile_combo = new QComboBox;
-      _add_profiles_in_combobox(profile_combo, current_profile);
-      setCellWidget(i, 1, profile_combo);
-    }
+  setItem(row, 0,
+    new QTableWidgetItem(QString::number(
+      static_cast<int>(current_group.get_group_id()))));
 
-    auto current_state = current_group.get_initial_state();
-    if (i == 0)
-    {
-      setItem(i, 2,
-        new QTableWidgetItem(QString::fromStdString(current_state) ) );
-    }
-    else
-    {
-      QComboBox* state_combo = new QComboBox;
-      _add_states_in_combobox(state_combo, current_state);
-      setCellWidget(i, 2, state_combo);
-    }
+  const auto& current_profile = current_group.get_agent_profile();
+  if (row == 0)
+  {
+    setItem(row, 1,
+      new QTableWidgetItem(QString::fromStdString(current_profile) ) );
+  }
+  else
+  {
+    QComboBox* profile_combo = new QComboBox;
+    _add_profiles_in_combobox(profile_combo, current_profile);
+    setCellWidget(row, 1, profile_combo);
+  }
+
+  const auto& current_state = current_group.get_initial_state();
+  if (row == 0)
+  {
+    setItem(row, 2,
+      new QTableWidgetItem(QString::fromStdString(current_state) ) );
+  }
+  else
+  {
+    QComboBox* state_combo = new QComboBox;
+    _add_states_in_combobox(state_combo, current_state);
+    setCellWidget(row, 2, state_combo);
+  }
 
-    setItem(i, 3,
-      new QTableWidgetItem(QString::number(current_group.get_spawn_number())));
+  setItem(row, 3,
+    new QTableWidgetItem(QString::number(current_group.get_spawn_number())));
 
-    std::string external_agent_name = "";
-    if (current_group.is_external_group())
+  std::string external_agent_name = "";
+  if (current_group.is_external_group())
+  {
+    for (const auto& name : current_group.get_external_agent_name())
     {
-      for (auto name : current_group.get_external_agent_name())
-      {
-        external_agent_name += name + ";";
-      }
+      external_agent_name += name + ";";
     }
-    setItem(i, 4,
-      new QTableWidgetItem(QString::fromStdString(external_agent_name) ));
+  }
+  setItem(row, 4,
+    new QTableWidgetItem(QString::fromStdString(external_agent_name) ));
 
-    auto spawn_point = current_group.get_spawn_point();
-    setItem(i, 5,
-      new QTableWidgetItem(QString::number(spawn_point.first)));
+  auto spawn_point = current_group.get_spawn_point();
+  setItem(row, 5,
+    new QTableWidgetItem(QString::number(spawn_point.first)));
 
-    setItem(i, 6,
-      new QTableWidgetItem(QString::number(spawn_point.second)));
-  }
+  setItem(row, 6,
+    new QTableWidgetItem(QString::number(spawn_point.second)));
 }
 
 //=======================================
@@ -185,12 +192,9 @@ void AgentGroupTab::save_to_impl()
 //=======================================
 void AgentGroupTab::_add_profiles_in_combobox(
   QComboBox* profile_combo,
-  std::string current_profile)
+  const std::string& current_profile)
 {
-  for (auto profile : get_impl()->get_agent_profiles())
-  {
-    profile_combo->addItem(QString::fromStdString(profile.profile_name));
-  }
+  profile_combo->addItems(_profile_names);
   int current_index =
     profile_combo->findText(QString::fromStdString(current_profile));
   profile_combo->setCurrentIndex(current_index >= 0 ? current_index : 0);
@@ -199,12 +203,9 @@ void AgentGroupTab::_add_profiles_in_combobox(
 //=======================================
 void AgentGroupTab::_add_states_in_combobox(
   QComboBox* state_combo,
-  std::string current_state)
+  const std::string& current_state)
 {
-  for (auto state : get_impl()->get_states())
-  {
-    state_combo->addItem(QString::fromStdString(state.get_name()));
-  }
+  state_combo->addItems(_state_names);
   int current_index = state_combo->findText(QString::fromStdString(
         current_state));
   state_combo->setCurrentIndex(current_index >= 0 ? current_index : 0);
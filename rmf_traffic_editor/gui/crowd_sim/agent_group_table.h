@@ -45,7 +45,8 @@ public:
   {
     return static_cast<int>(_cache.size());
   }
-  void list_item_in_cache() override;
+  void list_item_in_row(int row) override;
+  void list_choices() override;
   void save() override;
   void save_to_impl() override;
   void add_button_click() override;
@@ -53,10 +54,13 @@ public:
 
 private:
   std::vector<AgentGroup> _cache;
+  QStringList _profile_names;
+  QStringList _state_names;
+
   void _add_profiles_in_combobox(QComboBox* profile_combo,
-    std::string current_profile);
+    const std::string& current_profile);
   void _add_states_in_combobox(QComboBox* states_combo,
-    std::string current_state);
+    const std::string& current_state);
 };
 
 #endif
\ No newline at end of file
@@ -43,40 +43,36 @@ std::shared_ptr<AgentProfileTab> AgentProfileTab::init_and_make(
 }
 
 //===================================================
-void AgentProfileTab::list_item_in_cache()
+void AgentProfileTab::list_item_in_row(int row)
 {
-  auto cache_count = get_cache_size();
-  for (auto i = 0; i < cache_count; i++)
-  {
-    auto current_profile = _cache[i];
-    setItem(i, 0,
-      new QTableWidgetItem(QString::fromStdString(current_profile.profile_name)));
-    setItem(i, 1,
-      new QTableWidgetItem(QString::number(
-        static_cast<uint>(current_profile.profile_class))));
-    setItem(i, 2,
-      new QTableWidgetItem(QString::number(current_profile.max_accel)));
-    setItem(i, 3,
-      new QTableWidgetItem(QString::number(current_profile.max_angle_vel)));
-    setItem(i, 4,
-      new QTableWidgetItem(QString::number(
-        static_cast<uint>(current_profile.max_neighbors))));
-    setItem(i, 5,
-      new QTableWidgetItem(QString::number(current_profile.max_speed)));
-    setItem(i, 6,
-      new QTableWidgetItem(QString::number(current_profile.neighbor_dist)));
-    setItem(i, 7,
-      new QTableWidgetItem(QString::number(
-        static_cast<uint>(current_profile.obstacle_set))));
-    setItem(i, 8,
-      new QTableWidgetItem(QString::number(current_profile.pref_speed)));
-    setItem(i, 9,
-      new QTableWidgetItem(QString::number(current_profile.r)));
-    setItem(i, 10,
-      new QTableWidgetItem(QString::number(current_profile.ORCA_tau)));
-    setItem(i, 11,
-      new QTableWidgetItem(QString::number(current_profile.ORCA_tauObst)));
-  }
+  const auto& current_profile = _cache.at(row);
+  setItem(row, 0,
+    new QTableWidgetItem(QString::fromStdString(current_profile.profile_name)));
+  setItem(row, 1,
+    new QTableWidgetItem(QString::number(
+      static_cast<uint>(current_profile.profile_class))));
+  setItem(row, 2,
+    new QTableWidgetItem(QString::number(current_profile.max_accel)));
+  setItem(row, 3,
+    new QTableWidgetItem(QString::number(current_profile.max_angle_vel)));
+  setItem(row, 4,
+    new QTableWidgetItem(QString::number(
+      static_cast<uint>(current_profile.max_neighbors))));
+  setItem(row, 5,
+    new QTableWidgetItem(QString::number(current_profile.max_speed)));
+  setItem(row, 6,
+    new QTableWidgetItem(QString::number(current_profile.neighbor_dist)));
+  setItem(row, 7,
+    new QTableWidgetItem(QString::number(
+      static_cast<uint>(current_profile.obstacle_set))));
+  setItem(row, 8,
+    new QTableWidgetItem(QString::number(current_profile.pref_speed)));
+  setItem(row, 9,
+    new QTableWidgetItem(QString::number(current_profile.r)));
+  setItem(row, 10,
+    new QTableWidgetItem(QString::number(current_profile.ORCA_tau)));
+  setItem(row, 11,
+    new QTableWidgetItem(QString::number(current_profile.ORCA_tauObst)));
 }
 
 //===================================================
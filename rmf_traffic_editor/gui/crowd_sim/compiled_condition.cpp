@@ -0,0 +1,314 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <traffic_editor/crowd_sim/compiled_condition.h>
+
+#include <algorithm>
+#include <iostream>
+
+using namespace crowd_sim;
+
+//===========================================================
+void CompiledCondition::clear()
+{
+  _ops.clear();
+  _values.clear();
+  _thresholds.clear();
+}
+
+//===========================================================
+void CompiledCondition::add_leaf(const OpCode code, const double value)
+{
+  _ops.push_back({code, static_cast<uint16_t>(_values.size())});
+  _values.push_back(value);
+  _thresholds.push_back(static_cast<float>(value));
+}
+
+//===========================================================
+void CompiledCondition::set_value(const std::size_t slot, const double value)
+{
+  if (slot >= _values.size())
+    return;
+  _values[slot] = value;
+  _thresholds[slot] = static_cast<float>(value);
+}
+
+//===========================================================
+bool CompiledCondition::check_depth() const
+{
+  std::size_t depth = 0;
+  for (const Op& op : _ops)
+  {
+    if (op.code == GOAL || op.code == TIMER)
+      depth++;
+    else if (op.code == AND || op.code == OR)
+      depth--;
+    if (depth > MAX_DEPTH)
+      return false;
+  }
+  return depth == 1;
+}
+
+//===========================================================
+bool CompiledCondition::compile(const ConditionPtr& condition)
+{
+  clear();
+  if (!compile_node(condition) || !check_depth() ||
+    _values.size() > UINT16_MAX)
+  {
+    std::cout << "Unable to compile condition" << std::endl;
+    clear();
+    return false;
+  }
+  return true;
+}
+
+//===========================================================
+bool CompiledCondition::compile_node(const ConditionPtr& condition)
+{
+  if (!condition)
+    return false;
+  switch (condition->get_type())
+  {
+    case Condition::GOAL:
+    case Condition::TIMER:
+    {
+      auto leaf = std::static_pointer_cast<LeafCondition>(condition);
+      add_leaf(
+        condition->get_type() == Condition::GOAL ? GOAL : TIMER,
+        leaf->get_value());
+      return true;
+    }
+    case Condition::AND:
+    case Condition::OR:
+    {
+      auto node = std::static_pointer_cast<BoolCondition>(condition);
+      if (!compile_node(node->get_condition(1)) ||
+        !compile_node(node->get_condition(2)))
+        return false;
+      _ops.push_back({condition->get_type() == Condition::AND ? AND : OR, 0});
+      return true;
+    }
+    case Condition::NOT:
+    {
+      auto node = std::static_pointer_cast<BoolCondition>(condition);
+      if (!compile_node(node->get_condition(1)))
+        return false;
+      _ops.push_back({NOT, 0});
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+//===========================================================
+bool CompiledCondition::compile(const YAML::Node& condition_node)
+{
+  clear();
+  if (!compile_yaml(condition_node) || !check_depth() ||
+    _values.size() > UINT16_MAX)
+  {
+    std::cout << "Unable to compile condition" << std::endl;
+    clear();
+    return false;
+  }
+  return true;
+}
+
+//===========================================================
+bool CompiledCondition::compile_yaml(const YAML::Node& node)
+{
+  // the same defaults and checks as the from_yaml() of the Conditions
+  if (!node || !node.IsMap() || !node["type"])
+    return false;
+  const std::string type = node["type"].as<std::string>();
+  if (type == "goal_reached")
+  {
+    double distance = 0.1;
+    if (node["distance"] && node["distance"].as<double>() > 0)
+      distance = node["distance"].as<double>();
+    add_leaf(GOAL, distance);
+    return true;
+  }
+  if (type == "timer")
+  {
+    double value = 30.0;
+    if (node["value"] && node["value"].as<double>() > 0)
+      value = node["value"].as<double>();
+    add_leaf(TIMER, value);
+    return true;
+  }
+  if (type == "and" || type == "or")
+  {
+    if (!compile_yaml(node["condition1"]) ||
+      !compile_yaml(node["condition2"]))
+      return false;
+    _ops.push_back({type == "and" ? AND : OR, 0});
+    return true;
+  }
+  if (type == "not")
+  {
+    if (!compile_yaml(node["condition1"]))
+      return false;
+    _ops.push_back({NOT, 0});
+    return true;
+  }
+  return false;
+}
+
+//===========================================================
+bool CompiledCondition::evaluate(
+  const float goal_distance,
+  const float state_time) const
+{
+  uint8_t result = 0;
+  evaluate(&goal_distance, &state_time, 1, &result);
+  return result != 0;
+}
+
+//===========================================================
+void CompiledCondition::evaluate(
+  const float* goal_distance,
+  const float* state_time,
+  const std::size_t n,
+  uint8_t* result) const
+{
+  if (_ops.empty())
+  {
+    std::fill(result, result + n, 0);
+    return;
+  }
+
+  // one row of results per stack entry; every instruction runs over the
+  // whole block before the next one
+  uint8_t stack[MAX_DEPTH][BLOCK_SIZE];
+  for (std::size_t begin = 0; begin < n; begin += BLOCK_SIZE)
+  {
+    const std::size_t count = std::min<std::size_t>(n - begin, +BLOCK_SIZE);
+    const float* distance = goal_distance + begin;
+    const float* time = state_time + begin;
+    std::size_t top = 0;
+    for (const Op& op : _ops)
+    {
+      switch (op.code)
+      {
+        case GOAL:
+        {
+          const float threshold = _thresholds[op.slot];
+          uint8_t* row = stack[top++];
+          for (std::size_t i = 0; i < count; i++)
+            row[i] = distance[i] <= threshold;
+          break;
+        }
+        case TIMER:
+        {
+          const float threshold = _thresholds[op.slot];
+          uint8_t* row = stack[top++];
+          for (std::size_t i = 0; i < count; i++)
+            row[i] = time[i] >= threshold;
+          break;
+        }
+        case AND:
+        {
+          top--;
+          uint8_t* a = stack[top - 1];
+          const uint8_t* b = stack[top];
+          for (std::size_t i = 0; i < count; i++)
+            a[i] &= b[i];
+          break;
+        }
+        case OR:
+        {
+          top--;
+          uint8_t* a = stack[top - 1];
+          const uint8_t* b = stack[top];
+          for (std::size_t i = 0; i < count; i++)
+            a[i] |= b[i];
+          break;
+        }
+        case NOT:
+        {
+          uint8_t* a = stack[top - 1];
+          for (std::size_t i = 0; i < count; i++)
+            a[i] ^= 1;
+          break;
+        }
+      }
+    }
+    std::copy(stack[0], stack[0] + count, result + begin);
+  }
+}
+
+//===========================================================
+ConditionPtr CompiledCondition::to_condition() const
+{
+  std::vector<ConditionPtr> stack;
+  for (const Op& op : _ops)
+  {
+    switch (op.code)
+    {
+      case GOAL:
+      {
+        auto goal = std::make_shared<ConditionGOAL>();
+        goal->set_value(_values[op.slot]);
+        stack.push_back(goal);
+        break;
+      }
+      case TIMER:
+      {
+        auto timer = std::make_shared<ConditionTIMER>();
+        timer->set_value(_values[op.slot]);
+        stack.push_back(timer);
+        break;
+      }
+      case AND:
+      case OR:
+      {
+        ConditionPtr second = stack.back();
+        stack.pop_back();
+        ConditionPtr first = stack.back();
+        stack.pop_back();
+        std::shared_ptr<BoolCondition> node;
+        if (op.code == AND)
+          node = std::make_shared<ConditionAND>();
+        else
+          node = std::make_shared<ConditionOR>();
+        node->set_condition(first, 1);
+        node->set_condition(second, 2);
+        stack.push_back(node);
+        break;
+      }
+      case NOT:
+      {
+        auto node = std::make_shared<ConditionNOT>();
+        node->set_condition(stack.back(), 1);
+        stack.back() = node;
+        break;
+      }
+    }
+  }
+  if (stack.size() != 1)
+    return std::make_shared<Condition>();
+  return stack.front();
+}
+
+//===========================================================
+YAML::Node CompiledCondition::to_yaml() const
+{
+  return to_condition()->to_yaml();
+}
@@ -0,0 +1,403 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include <algorithm>
+
+#include <traffic_editor/crowd_sim/config_validator.h>
+
+using namespace crowd_sim;
+
+namespace {
+
+using Part = CrowdSimImplementation::Part;
+
+std::string quoted(const std::string& name)
+{
+  return "\"" + name + "\"";
+}
+
+}  // namespace
+
+//=================================================
+const ConfigValidator::Index& ConfigValidator::_index(
+  const CrowdSimImplementation& impl,
+  const Part part)
+{
+  Index& index = _indices[part];
+  if (index.built && index.revision == impl.revision(part))
+    return index;
+  index.names.clear();
+  auto add = [&index](const std::string& name, const std::size_t i)
+    {
+      index.names.emplace(name, i);
+    };
+  switch (part)
+  {
+    case Part::SETTINGS:
+      for (std::size_t i = 0; i < impl.get_navmesh_file_name().size(); ++i)
+        add(impl.get_navmesh_file_name()[i], i);
+      break;
+    case Part::GOAL_AREAS:
+      for (std::size_t i = 0; i < impl.get_goal_areas().size(); ++i)
+        add(impl.get_goal_areas()[i], i);
+      break;
+    case Part::STATES:
+      for (std::size_t i = 0; i < impl.get_states().size(); ++i)
+        add(impl.get_states()[i].get_name(), i);
+      break;
+    case Part::GOAL_SETS:
+      for (std::size_t i = 0; i < impl.get_goal_sets().size(); ++i)
+        add(std::to_string(impl.get_goal_sets()[i].get_goal_set_id()), i);
+      break;
+    case Part::AGENT_PROFILES:
+      for (std::size_t i = 0; i < impl.get_agent_profiles().size(); ++i)
+        add(impl.get_agent_profiles()[i].profile_name, i);
+      break;
+    case Part::MODEL_TYPES:
+      for (std::size_t i = 0; i < impl.get_model_types().size(); ++i)
+        add(impl.get_model_types()[i].get_name(), i);
+      break;
+    default:
+      // transitions and agent groups aren't referred to by name
+      break;
+  }
+  index.revision = impl.revision(part);
+  index.built = true;
+  return index;
+}
+
+//=================================================
+bool ConfigValidator::update(const CrowdSimImplementation& impl)
+{
+  static const std::vector<Part> reads[NUM_CHECKS] = {
+    {Part::STATES, Part::GOAL_SETS, Part::SETTINGS},
+    {Part::GOAL_SETS, Part::GOAL_AREAS},
+    {Part::TRANSITIONS, Part::STATES},
+    {Part::AGENT_PROFILES},
+    {Part::AGENT_GROUPS, Part::AGENT_PROFILES, Part::STATES},
+    {Part::MODEL_TYPES, Part::AGENT_PROFILES, Part::AGENT_GROUPS},
+    {Part::STATES, Part::TRANSITIONS, Part::AGENT_GROUPS}
+  };
+
+  bool changed = false;
+  for (int i = 0; i < NUM_CHECKS; ++i)
+  {
+    CheckResult& result = _checks[i];
+    std::vector<std::size_t> revisions;
+    for (const Part part : reads[i])
+      revisions.push_back(impl.revision(part));
+    if (result.done && result.revisions == revisions)
+      continue;
+
+    result.problems.clear();
+    switch (static_cast<Check>(i))
+    {
+      case STATE_CHECK:
+        _check_states(impl, result.problems);
+        break;
+      case GOAL_SET_CHECK:
+        _check_goal_sets(impl, result.problems);
+        break;
+      case TRANSITION_CHECK:
+        _check_transitions(impl, result.problems);
+        break;
+      case AGENT_PROFILE_CHECK:
+        _check_agent_profiles(impl, result.problems);
+        break;
+      case AGENT_GROUP_CHECK:
+        _check_agent_groups(impl, result.problems);
+        break;
+      case MODEL_TYPE_CHECK:
+        _check_model_types(impl, result.problems);
+        break;
+      case REACHABILITY_CHECK:
+        _check_reachability(impl, result.problems);
+        break;
+      default:
+        break;
+    }
+    result.revisions = std::move(revisions);
+    result.done = true;
+    changed = true;
+  }
+  return changed;
+}
+
+//=================================================
+std::vector<std::string> ConfigValidator::problems(const Part part) const
+{
+  std::vector<std::string> messages;
+  for (const CheckResult& result : _checks)
+  {
+    for (const Problem& problem : result.problems)
+    {
+      if (problem.part == part)
+        messages.push_back(problem.message);
+    }
+  }
+  return messages;
+}
+
+//=================================================
+std::size_t ConfigValidator::num_problems() const
+{
+  std::size_t count = 0;
+  for (const CheckResult& result : _checks)
+    count += result.problems.size();
+  return count;
+}
+
+//=================================================
+void ConfigValidator::_check_states(
+  const CrowdSimImplementation& impl,
+  std::vector<Problem>& problems)
+{
+  const auto& states = _index(impl, Part::STATES).names;
+  const auto& goal_sets = _index(impl, Part::GOAL_SETS).names;
+  const auto& navmeshes = _index(impl, Part::SETTINGS).names;
+  for (std::size_t i = 0; i < impl.get_states().size(); ++i)
+  {
+    const State& state = impl.get_states()[i];
+    const std::string name = quoted(state.get_name());
+    if (state.get_name().empty())
+    {
+      problems.push_back({Part::STATES,
+          "state " + std::to_string(i + 1) + " has no name, so it is not "
+          "saved"});
+      continue;
+    }
+    if (states.at(state.get_name()) != i)
+      problems.push_back({Part::STATES, "state " + name + " is repeated"});
+    if (state.get_final_state())
+      continue;
+
+    const int goal_set_id = state.get_goal_set_id();
+    if (goal_set_id < 0)
+      problems.push_back({Part::STATES,
+          "state " + name + " has no goal set, so it is not saved"});
+    else if (!goal_sets.count(std::to_string(goal_set_id)))
+      problems.push_back({Part::STATES,
+          "state " + name + ": goal set " + std::to_string(goal_set_id) +
+          " doesn't exist"});
+
+    const std::string& navmesh = state.get_navmesh_file_name();
+    if (navmesh.empty())
+      problems.push_back({Part::STATES,
+          "state " + name + " has no navmesh, so it is not saved"});
+    else if (!navmeshes.count(navmesh))
+      problems.push_back({Part::STATES,
+          "state " + name + ": navmesh " + navmesh +
+          " isn't that of any level"});
+  }
+}
+
+//=================================================
+void ConfigValidator::_check_goal_sets(
+  const CrowdSimImplementation& impl,
+  std::vector<Problem>& problems)
+{
+  const auto& goal_sets = _index(impl, Part::GOAL_SETS).names;
+  const auto& goal_areas = _index(impl, Part::GOAL_AREAS).names;
+  for (std::size_t i = 0; i < impl.get_goal_sets().size(); ++i)
+  {
+    const GoalSet& goal_set = impl.get_goal_sets()[i];
+    const std::string id = std::to_string(goal_set.get_goal_set_id());
+    if (goal_sets.at(id) != i)
+      problems.push_back({Part::GOAL_SETS, "goal set " + id + " is repeated"});
+    const std::set<std::string> areas = goal_set.get_goal_areas();
+    if (areas.empty())
+      problems.push_back({Part::GOAL_SETS,
+          "goal set " + id + " has no goal areas"});
+    for (const std::string& area : areas)
+    {
+      if (!goal_areas.count(area))
+        problems.push_back({Part::GOAL_SETS,
+            "goal set " + id + ": no vertex has human_goal_set_name " +
+            quoted(area)});
+    }
+  }
+}
+
+//=================================================
+void ConfigValidator::_check_transitions(
+  const CrowdSimImplementation& impl,
+  std::vector<Problem>& problems)
+{
+  const auto& states = _index(impl, Part::STATES).names;
+  for (std::size_t i = 0; i < impl.get_transitions().size(); ++i)
+  {
+    const Transition& transition = impl.get_transitions()[i];
+    const std::string from = transition.get_from_state();
+    const std::string name =
+      "transition " + std::to_string(i + 1) + " (from " + quoted(from) + ")";
+    if (!states.count(from))
+      problems.push_back({Part::TRANSITIONS,
+          name + ": state " + quoted(from) + " doesn't exist"});
+    const Transition::ToStateType to_states = transition.get_to_state();
+    if (to_states.empty())
+      problems.push_back({Part::TRANSITIONS, name + " goes to no state"});
+    for (const auto& to_state : to_states)
+    {
+      if (!states.count(to_state.first))
+        problems.push_back({Part::TRANSITIONS,
+            name + ": state " + quoted(to_state.first) + " doesn't exist"});
+    }
+    const ConditionPtr condition = transition.get_condition();
+    if (!condition || !condition->is_valid())
+      problems.push_back({Part::TRANSITIONS,
+          name + " has an incomplete condition"});
+  }
+}
+
+//=================================================
+void ConfigValidator::_check_agent_profiles(
+  const CrowdSimImplementation& impl,
+  std::vector<Problem>& problems)
+{
+  const auto& profiles = _index(impl, Part::AGENT_PROFILES).names;
+  for (std::size_t i = 0; i < impl.get_agent_profiles().size(); ++i)
+  {
+    const std::string& name = impl.get_agent_profiles()[i].profile_name;
+    if (profiles.at(name) != i)
+      problems.push_back({Part::AGENT_PROFILES,
+          "agent profile " + quoted(name) + " is repeated"});
+  }
+}
+
+//=================================================
+void ConfigValidator::_check_agent_groups(
+  const CrowdSimImplementation& impl,
+  std::vector<Problem>& problems)
+{
+  const auto& profiles = _index(impl, Part::AGENT_PROFILES).names;
+  const auto& states = _index(impl, Part::STATES).names;
+  for (const AgentGroup& group : impl.get_agent_groups())
+  {
+    const std::string name =
+      "agent group " + std::to_string(group.get_group_id());
+    const std::string profile = group.get_agent_profile();
+    if (profile.empty())
+      problems.push_back({Part::AGENT_GROUPS, name + " has no profile"});
+    else if (!profiles.count(profile))
+      problems.push_back({Part::AGENT_GROUPS,
+          name + ": agent profile " + quoted(profile) + " doesn't exist"});
+    const std::string state = group.get_initial_state();
+    if (state.empty())
+      problems.push_back({Part::AGENT_GROUPS,
+          name + " has no initial state"});
+    else if (!states.count(state))
+      problems.push_back({Part::AGENT_GROUPS,
+          name + ": state " + quoted(state) + " doesn't exist"});
+  }
+}
+
+//=================================================
+void ConfigValidator::_check_model_types(
+  const CrowdSimImplementation& impl,
+  std::vector<Problem>& problems)
+{
+  const auto& model_types = _index(impl, Part::MODEL_TYPES).names;
+  for (std::size_t i = 0; i < impl.get_model_types().size(); ++i)
+  {
+    const ModelType& model_type = impl.get_model_types()[i];
+    const std::string name = quoted(model_type.get_name());
+    if (model_types.at(model_type.get_name()) != i)
+      problems.push_back({Part::MODEL_TYPES,
+          "model type " + name + " is repeated"});
+    // the same check as ModelType::is_valid()
+    if (model_type.get_model_uri().size() <= 8)
+      problems.push_back({Part::MODEL_TYPES,
+          "model type " + name + " has no model:// URI"});
+  }
+
+  // the simulated agents are drawn with the model type named after their
+  // profile; the external agents are drawn by their own models
+  std::set<std::string> checked;
+  for (const AgentGroup& group : impl.get_agent_groups())
+  {
+    const std::string profile = group.get_agent_profile();
+    if (group.is_external_group() || profile.empty() ||
+      !checked.insert(profile).second)
+      continue;
+    if (!model_types.count(profile))
+      problems.push_back({Part::MODEL_TYPES,
+          "agent profile " + quoted(profile) + " has no model type of "
+          "the same name"});
+  }
+}
+
+//=================================================
+void ConfigValidator::_check_reachability(
+  const CrowdSimImplementation& impl,
+  std::vector<Problem>& problems)
+{
+  const auto& states = _index(impl, Part::STATES).names;
+  const std::size_t num_states = impl.get_states().size();
+
+  // the transition graph, between the indices of the states
+  std::vector<std::vector<std::size_t>> next(num_states);
+  for (const Transition& transition : impl.get_transitions())
+  {
+    const auto from = states.find(transition.get_from_state());
+    if (from == states.end())
+      continue;
+    for (const auto& to_state : transition.get_to_state())
+    {
+      const auto to = states.find(to_state.first);
+      if (to != states.end())
+        next[from->second].push_back(to->second);
+    }
+  }
+
+  std::vector<char> reached(num_states, 0);
+  std::vector<std::size_t> queue;
+  for (const AgentGroup& group : impl.get_agent_groups())
+  {
+    const auto it = states.find(group.get_initial_state());
+    if (it != states.end() && !reached[it->second])
+    {
+      reached[it->second] = 1;
+      queue.push_back(it->second);
+    }
+  }
+  for (std::size_t i = 0; i < queue.size(); ++i)
+  {
+    for (const std::size_t to : next[queue[i]])
+    {
+      if (!reached[to])
+      {
+        reached[to] = 1;
+        queue.push_back(to);
+      }
+    }
+  }
+
+  for (std::size_t i = 0; i < num_states; ++i)
+  {
+    const State& state = impl.get_states()[i];
+    if (state.get_name().empty() || states.at(state.get_name()) != i)
+      continue;
+    const std::string name = quoted(state.get_name());
+    if (!reached[i])
+      problems.push_back({Part::STATES,
+          "no agent group starts in or reaches state " + name});
+    else if (!state.get_final_state() && next[i].empty())
+      problems.push_back({Part::TRANSITIONS,
+          "agents never leave state " + name + ", which isn't final"});
+  }
+}
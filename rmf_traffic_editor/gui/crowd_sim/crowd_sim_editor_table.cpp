@@ -80,8 +80,6 @@ CrowdSimEditorTable::CrowdSimEditorTable(const Building& building)
     }
   );
 
-  update();
-
   for (size_t i = 0; i < _required_components.size(); ++i)
   {
     int row_id = _reserved_rows + i;
@@ -89,6 +87,8 @@ CrowdSimEditorTable::CrowdSimEditorTable(const Building& building)
     QTableWidgetItem* name_item =
       new QTableWidgetItem(QString::fromStdString(_required_components[i]) );
     setItem(row_id, 0, name_item);
+    _status_items.push_back(new QTableWidgetItem);
+    setItem(row_id, 1, _status_items.back());
     QPushButton* edit_button = new QPushButton("Edit", this);
     setCellWidget(row_id, 2, edit_button);
     edit_button->setStyleSheet("QTableWidgetItem { background-color: red; }");
@@ -106,15 +106,32 @@ CrowdSimEditorTable::CrowdSimEditorTable(const Building& building)
     );
   }
 
+  update();
 }
 
 //=================================================
 void CrowdSimEditorTable::update()
 {
-  update_goal_area();
-  update_navmesh_level();
-  update_external_agent_from_spawn_point();
-  update_external_agent_state();
+  // this runs after every edit of the building; most of them don't touch
+  // anything the crowd simulation looks at
+  if (_levels_changed())
+  {
+    update_goal_area();
+    update_navmesh_level();
+    update_external_agent_from_spawn_point();
+    update_external_agent_state();
+
+    _scanned_levels.clear();
+    for (const auto& level : _building.levels)
+      _scanned_levels.emplace_back(level.name, level.revision());
+    _scanned_revision = _impl->revision();
+    _scanned = true;
+  }
+
+  if (_shown && _shown_revision == _impl->revision())
+    return;
+  _shown_revision = _impl->revision();
+  _shown = true;
 
   blockSignals(true);
 
@@ -122,56 +139,92 @@ void CrowdSimEditorTable::update()
   _update_time_step_value_item->setText(QString::number(_impl->
     get_update_time_step() ));
 
+  _validator.update(*_impl);
+
   size_t status_number = 0;
   for (size_t i = 0; i < _required_components.size(); ++i)
   {
     status_number = 0;
+    ConfigValidator::Part part = CrowdSimImplementation::SETTINGS;
     if ("States" == _required_components[i])
     {
       status_number = _impl->get_states().size();
+      part = CrowdSimImplementation::STATES;
     }
     if ("GoalSets" == this->_required_components[i])
     {
       status_number = _impl->get_goal_sets().size();
+      part = CrowdSimImplementation::GOAL_SETS;
     }
     if ("AgentProfiles" == this->_required_components[i])
     {
       status_number = _impl->get_agent_profiles().size();
+      part = CrowdSimImplementation::AGENT_PROFILES;
     }
     if ("Transitions" == this->_required_components[i])
     {
       status_number = _impl->get_transitions().size();
+      part = CrowdSimImplementation::TRANSITIONS;
     }
     if ("AgentGroups" == this->_required_components[i])
     {
       status_number = _impl->get_agent_groups().size();
+      part = CrowdSimImplementation::AGENT_GROUPS;
     }
     if ("ModelTypes" == this->_required_components[i])
     {
       status_number = _impl->get_model_types().size();
+      part = CrowdSimImplementation::MODEL_TYPES;
     }
 
-    setItem(
-      _reserved_rows + i,
-      1,
-      new QTableWidgetItem(QString::number(status_number)));
+    const std::vector<std::string> problems = _validator.problems(part);
+    QString text = QString::number(status_number);
+    QStringList tooltip;
+    for (const std::string& problem : problems)
+      tooltip.append(QString::fromStdString(problem));
+    if (!problems.empty())
+    {
+      text += QString(problems.size() == 1 ? ", %1 problem" : ", %1 problems")
+        .arg(problems.size());
+    }
+    _status_items[i]->setText(text);
+    _status_items[i]->setToolTip(tooltip.join("\n"));
+    _status_items[i]->setForeground(
+      problems.empty() ? QBrush() : QBrush(Qt::red));
   }
 
   blockSignals(false);
 }
 
+//===================================================
+bool CrowdSimEditorTable::_levels_changed() const
+{
+  if (!_scanned ||
+    _scanned_revision != _impl->revision() ||
+    _scanned_levels.size() != _building.levels.size())
+    return true;
+  for (size_t i = 0; i < _scanned_levels.size(); ++i)
+  {
+    const auto& level = _building.levels[i];
+    if (_scanned_levels[i].second != level.revision() ||
+      _scanned_levels[i].first != level.name)
+      return true;
+  }
+  return false;
+}
+
 //===================================================
 void CrowdSimEditorTable::update_goal_area()
 {
   _goal_areas_cache.clear();
-  for (auto level : _building.levels)
+  for (const auto& level : _building.levels)
   {
-    auto vertex_list = level.vertices;
-    for (auto vertex : vertex_list)
+    for (const auto& vertex : level.vertices)
     {
-      if (vertex.params.find("human_goal_set_name") == vertex.params.end() )
+      const auto param_it = vertex.params.find("human_goal_set_name");
+      if (param_it == vertex.params.end())
         continue;
-      auto param = vertex.params["human_goal_set_name"];
+      const auto& param = param_it->second;
       if (param.type != param.STRING)
       {
         std::cout << "Error param type for human_goal_set_name." << std::endl;
@@ -187,7 +240,7 @@ void CrowdSimEditorTable::update_goal_area()
 void CrowdSimEditorTable::update_navmesh_level()
 {
   _navmesh_filename_cache.clear();
-  for (auto level : _building.levels)
+  for (const auto& level : _building.levels)
   {
     _navmesh_filename_cache.emplace_back(level.name + "_navmesh.nav");
   }
@@ -199,32 +252,42 @@ void CrowdSimEditorTable::update_external_agent_from_spawn_point()
 {
   std::vector<std::string> spawn_point_name;
 
-  for (auto level : _building.levels)
+  for (const auto& level : _building.levels)
   {
-    for (auto vertex : level.vertices)
+    for (const auto& vertex : level.vertices)
     {
-      if (vertex.params.find("spawn_robot_name") != vertex.params.end())
-      {
-        spawn_point_name.emplace_back(
-          vertex.params["spawn_robot_name"].value_string);
-      }
+      const auto param_it = vertex.params.find("spawn_robot_name");
+      if (param_it != vertex.params.end())
+        spawn_point_name.emplace_back(param_it->second.value_string);
     }
   }
 
-  auto agent_groups = _impl->get_agent_groups();
+  // only replace the groups (and bump their revision) if they would change
+  const auto& current_groups = _impl->get_agent_groups();
+  if (!current_groups.empty() &&
+    current_groups.at(0).get_external_agent_name() == spawn_point_name)
+    return;
+
+  auto agent_groups = current_groups;
   if (agent_groups.size() == 0)
   {
     agent_groups.emplace_back(0, true);
   }
   auto& external_group = agent_groups.at(0);
   external_group.set_external_agent_name(spawn_point_name);
-  _impl->save_agent_groups(agent_groups);
+  _impl->save_agent_groups(std::move(agent_groups));
 }
 
 //========================================================
 void CrowdSimEditorTable::update_external_agent_state()
 {
-  auto states = _impl->get_states();
+  const auto& current_states = _impl->get_states();
+  if (!current_states.empty() &&
+    current_states.at(0).get_name() == "external_static" &&
+    current_states.at(0).get_final_state())
+    return;
+
+  auto states = current_states;
   if (states.size() == 0)
   {
     states.emplace_back("external_static");
@@ -232,5 +295,5 @@ void CrowdSimEditorTable::update_external_agent_state()
   auto& external_state = states.at(0);
   external_state.set_name("external_static");
   external_state.set_final_state(true);
-  _impl->save_states(states);
+  _impl->save_states(std::move(states));
 }
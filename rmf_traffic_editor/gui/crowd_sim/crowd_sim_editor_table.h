@@ -27,6 +27,7 @@
 
 #include "table_list.h"
 #include "building.h"
+#include <traffic_editor/crowd_sim/config_validator.h>
 #include <traffic_editor/crowd_sim/crowd_sim_impl.h>
 
 using namespace crowd_sim;
@@ -61,10 +62,30 @@ private:
   std::set<std::string> _goal_areas_cache;
   std::vector<std::string> _navmesh_filename_cache;
 
+  /// What the vertex params were last read from: the name and revision of
+  /// each level (see Level::revision()) and the configuration revision
+  /// after they were applied. Editing the building bumps these, so update()
+  /// only scans the levels again when something could have changed.
+  std::vector<std::pair<std::string, std::size_t>> _scanned_levels;
+  std::size_t _scanned_revision = 0;
+  bool _scanned = false;
+
+  /// The configuration revision the widgets show
+  std::size_t _shown_revision = 0;
+  bool _shown = false;
+
+  bool _levels_changed() const;
+
   QTableWidgetItem* _enable_crowd_sim_name_item;
   QCheckBox* _enable_crowd_sim_checkbox;
   QTableWidgetItem* _update_time_step_name_item;
   QLineEdit* _update_time_step_value_item;
+  std::vector<QTableWidgetItem*> _status_items;
+
+  /// Checks the references between the components, and the states which
+  /// can't be reached, again for whatever part was edited; the problems
+  /// are shown against the component which has them
+  ConfigValidator _validator;
 };
 
 #endif
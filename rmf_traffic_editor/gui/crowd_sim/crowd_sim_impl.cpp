@@ -63,28 +63,70 @@ void CrowdSimImplementation::_initialize_model_type()
   );
 }
 
+//=================================================
+YAML::Node NavmeshLink::to_yaml() const
+{
+  YAML::Node link_node = YAML::Node(YAML::NodeType::Map);
+  link_node.SetStyle(YAML::EmitterStyle::Flow);
+  link_node["name"] = name;
+  link_node["from"] = from_file_name;
+  link_node["to"] = to_file_name;
+  YAML::Node from_point = YAML::Node(YAML::NodeType::Sequence);
+  from_point.push_back(from_x);
+  from_point.push_back(from_y);
+  link_node["from_point"] = from_point;
+  YAML::Node to_point = YAML::Node(YAML::NodeType::Sequence);
+  to_point.push_back(to_x);
+  to_point.push_back(to_y);
+  link_node["to_point"] = to_point;
+  return link_node;
+}
+
+//=================================================
+void NavmeshLink::from_yaml(const YAML::Node& input)
+{
+  name = input["name"].as<std::string>();
+  from_file_name = input["from"].as<std::string>();
+  to_file_name = input["to"].as<std::string>();
+  from_x = input["from_point"][0].as<double>();
+  from_y = input["from_point"][1].as<double>();
+  to_x = input["to_point"][0].as<double>();
+  to_y = input["to_point"][1].as<double>();
+}
+
 //=================================================
 YAML::Node CrowdSimImplementation::_output_obstacle_node() const
 {
-  // Currently only have one level navmesh
   YAML::Node obstacle_node = YAML::Node(YAML::NodeType::Map);
   obstacle_node.SetStyle(YAML::EmitterStyle::Flow);
   obstacle_node["class"] = 1;
   obstacle_node["type"] = "nav_mesh";
-  if (!_navmesh_filename_list.empty())
-    obstacle_node["file_name"] = this->_navmesh_filename_list[0];
+  if (_navmesh_filename_list.empty())
+    return obstacle_node;
+
+  // file_name is what a single level simulation reads; file_names and
+  // links describe the navmeshes of all the levels and how they join
+  obstacle_node["file_name"] = this->_navmesh_filename_list[0];
+  YAML::Node file_names = YAML::Node(YAML::NodeType::Sequence);
+  for (const auto& file_name : _navmesh_filename_list)
+    file_names.push_back(file_name);
+  obstacle_node["file_names"] = file_names;
+  YAML::Node links = YAML::Node(YAML::NodeType::Sequence);
+  for (const auto& link : _navmesh_links)
+    links.push_back(link.to_yaml());
+  obstacle_node["links"] = links;
   return obstacle_node;
 }
 
 //=================================================
-YAML::Node CrowdSimImplementation::to_yaml()
+YAML::Node CrowdSimImplementation::to_yaml() const
 {
   YAML::Node top_node = YAML::Node(YAML::NodeType::Map);
   top_node["enable"] = _enable_crowd_sim ? 1 : 0;
   top_node["update_time_step"] = _update_time_step;
 
   top_node["states"] = YAML::Node(YAML::NodeType::Sequence);
-  for (auto state : _states)
+  for (const auto& state : _states)
   {
     if (!state.is_valid())
       continue;
@@ -92,7 +134,7 @@ YAML::Node CrowdSimImplementation::to_yaml()
   }
 
   top_node["goal_sets"] = YAML::Node(YAML::NodeType::Sequence);
-  for (auto goal_set : _goal_sets)
+  for (const auto& goal_set : _goal_sets)
   {
     top_node["goal_sets"].push_back(goal_set.to_yaml());
   }
@@ -100,13 +142,13 @@ YAML::Node CrowdSimImplementation::to_yaml()
     top_node["goal_sets"].SetStyle(YAML::EmitterStyle::Flow);
 
   top_node["agent_profiles"] = YAML::Node(YAML::NodeType::Sequence);
-  for (auto profile : _agent_profiles)
+  for (const auto& profile : _agent_profiles)
   {
     top_node["agent_profiles"].push_back(profile.to_yaml());
   }
 
   top_node["transitions"] = YAML::Node(YAML::NodeType::Sequence);
-  for (auto transition : _transitions)
+  for (const auto& transition : _transitions)
   {
     top_node["transitions"].push_back(transition.to_yaml());
   }
@@ -116,13 +158,13 @@ YAML::Node CrowdSimImplementation::to_yaml()
   top_node["obstacle_set"] = _output_obstacle_node();
 
   top_node["agent_groups"] = YAML::Node(YAML::NodeType::Sequence);
-  for (auto group : _agent_groups)
+  for (const auto& group : _agent_groups)
   {
     top_node["agent_groups"].push_back(group.to_yaml());
   }
 
   top_node["model_types"] = YAML::Node(YAML::NodeType::Sequence);
-  for (auto model_type : _model_types)
+  for (const auto& model_type : _model_types)
   {
     top_node["model_types"].push_back(model_type.to_yaml());
   }
@@ -186,8 +228,7 @@ bool CrowdSimImplementation::from_yaml(const YAML::Node& input)
   for (YAML::const_iterator it = goal_set_node.begin();
     it != goal_set_node.end(); it++)
   {
-    GoalSet goalset_temp(*it);
-    this->_goal_sets.emplace_back(goalset_temp);
+    this->_goal_sets.emplace_back(*it);
   }
   printf("crowd_sim loaded %lu goal_sets\n", this->_goal_sets.size());
 
@@ -196,8 +237,7 @@ bool CrowdSimImplementation::from_yaml(const YAML::Node& input)
     it != state_node.end();
     it++)
   {
-    State state_temp(*it);
-    this->_states.emplace_back(state_temp);
+    this->_states.emplace_back(*it);
   }
   printf("crowd_sim loaded %lu states\n", this->_states.size());
 
@@ -205,8 +245,7 @@ bool CrowdSimImplementation::from_yaml(const YAML::Node& input)
   for (YAML::const_iterator it = transition_node.begin();
     it != transition_node.end(); it++)
   {
-    Transition transition_temp(*it);
-    this->_transitions.emplace_back(transition_temp);
+    this->_transitions.emplace_back(*it);
   }
   printf("crowd_sim loaded %lu transitions\n", this->_transitions.size());
 
@@ -214,8 +253,7 @@ bool CrowdSimImplementation::from_yaml(const YAML::Node& input)
   for (YAML::const_iterator it = agent_profile_node.begin();
     it != agent_profile_node.end(); it++)
   {
-    AgentProfile agent_profile_temp(*it);
-    this->_agent_profiles.emplace_back(agent_profile_temp);
+    this->_agent_profiles.emplace_back(*it);
   }
   printf("crowd_sim loaded %lu agent_profiles\n", this->_agent_profiles.size());
 
@@ -223,17 +261,28 @@ bool CrowdSimImplementation::from_yaml(const YAML::Node& input)
   for (YAML::const_iterator it = agent_group_node.begin();
     it != agent_group_node.end(); it++)
   {
-    AgentGroup agent_group_temp(*it);
-    this->_agent_groups.emplace_back(agent_group_temp);
+    this->_agent_groups.emplace_back(*it);
   }
   printf("crowd_sim loaded %lu agent_groups\n", this->_agent_profiles.size());
 
+  const YAML::Node& obstacle_node = input["obstacle_set"];
+  if (obstacle_node && obstacle_node["links"] &&
+    obstacle_node["links"].IsSequence())
+  {
+    const YAML::Node& link_node = obstacle_node["links"];
+    for (YAML::const_iterator it = link_node.begin();
+      it != link_node.end(); it++)
+    {
+      this->_navmesh_links.emplace_back();
+      this->_navmesh_links.back().from_yaml(*it);
+    }
+  }
+
   const YAML::Node& model_type_node = input["model_types"];
   for (YAML::const_iterator it = model_type_node.begin();
     it != model_type_node.end(); it++)
   {
-    ModelType model_type_temp(*it);
-    this->_model_types.emplace_back(model_type_temp);
+    this->_model_types.emplace_back(*it);
   }
   printf("crowd_sim loaded %lu model_types\n", this->_agent_profiles.size());
 
@@ -245,7 +294,9 @@ bool CrowdSimImplementation::from_yaml(const YAML::Node& input)
 void CrowdSimImplementation::clear()
 {
   _goal_areas.clear();
+  _goal_area_list.clear();
   _navmesh_filename_list.clear();
+  _navmesh_links.clear();
 
   _enable_crowd_sim = false;
   _update_time_step = 0.1;
@@ -255,6 +306,7 @@ void CrowdSimImplementation::clear()
   _agent_profiles.clear();
   _agent_groups.clear();
   _model_types.clear();
+  _changed_all();
 }
 
 //=================================================
@@ -263,53 +315,71 @@ void CrowdSimImplementation::init_default_configure()
   _initialize_state();
   _initialize_agent_profile();
   _initialize_agent_group();
+  _changed_all();
 }
 
 //=================================================
-void CrowdSimImplementation::save_goal_sets(
-  const std::vector<GoalSet>& goal_sets)
+void CrowdSimImplementation::_changed_all()
 {
-  _goal_sets.clear();
-  _goal_sets = goal_sets;
+  for (int i = 0; i < NUM_PARTS; i++)
+    _revisions[i]++;
+  _revision++;
+}
+
+//=================================================
+void CrowdSimImplementation::set_goal_areas(std::set<std::string> goal_areas)
+{
+  if (goal_areas == _goal_areas)
+    return;
+  _goal_areas = std::move(goal_areas);
+  _goal_area_list.assign(_goal_areas.begin(), _goal_areas.end());
+  _changed(GOAL_AREAS);
+}
+
+//=================================================
+void CrowdSimImplementation::save_goal_sets(std::vector<GoalSet> goal_sets)
+{
+  _goal_sets = std::move(goal_sets);
+  _changed(GOAL_SETS);
 }
 
 //===================================================
-void CrowdSimImplementation::save_states(const std::vector<State>& states)
+void CrowdSimImplementation::save_states(std::vector<State> states)
 {
-  _states.clear();
-  _states = states;
+  _states = std::move(states);
   _initialize_state();
+  _changed(STATES);
 }
 
 //===================================================
 void CrowdSimImplementation::save_transitions(
-  const std::vector<Transition>& transitions)
+  std::vector<Transition> transitions)
 {
-  _transitions.clear();
-  _transitions = transitions;
+  _transitions = std::move(transitions);
+  _changed(TRANSITIONS);
 }
 
 //=================================================
 void CrowdSimImplementation::save_agent_profiles(
-  const std::vector<AgentProfile>& agent_profiles)
+  std::vector<AgentProfile> agent_profiles)
 {
-  _agent_profiles.clear();
-  _agent_profiles = agent_profiles;
+  _agent_profiles = std::move(agent_profiles);
   _initialize_agent_profile();
+  _changed(AGENT_PROFILES);
 }
 
 //=================================================
 void CrowdSimImplementation::save_agent_groups(
-  const std::vector<AgentGroup>& agent_groups)
+  std::vector<AgentGroup> agent_groups)
 {
-  _agent_groups.clear();
-  _agent_groups = agent_groups;
+  _agent_groups = std::move(agent_groups);
+  _changed(AGENT_GROUPS);
 }
 
 //=================================================
 void CrowdSimImplementation::save_model_types(
-  const std::vector<ModelType>& model_types)
+  std::vector<ModelType> model_types)
 {
-  _model_types.clear();
-  _model_types = model_types;
+  _model_types = std::move(model_types);
+  _changed(MODEL_TYPES);
 }
@@ -40,6 +40,7 @@ CrowdSimTableBase::CrowdSimTableBase(CrowdSimImplPtr impl,
 void CrowdSimTableBase::update()
 {
   blockSignals(true);
+  setUpdatesEnabled(false);
   clearContents();
 
   int cache_item_size = get_cache_size();
@@ -48,22 +49,11 @@ void CrowdSimTableBase::update()
     cache_item_size +
     1   // put add button in this row
   );
-  list_item_in_cache();
-
+  list_choices();
   for (auto i = 0; i < cache_item_size; i++)
   {
-    QPushButton* delete_button = new QPushButton("Del");
-    setCellWidget(i, get_label_size() - 1, delete_button);
-    connect(
-      delete_button,
-      &QAbstractButton::clicked,
-      [i, this]()
-      {
-        save();
-        delete_button_click(i);
-        update();
-      }
-    );
+    list_item_in_row(i);
+    _add_delete_button(i);
   }
 
   QPushButton* add_button = new QPushButton("Add");
@@ -73,11 +63,79 @@ void CrowdSimTableBase::update()
     &QAbstractButton::clicked,
     [this]()
     {
-      save();
-      add_button_click();
-      update();
+      _add_row();
     }
   );
 
+  setUpdatesEnabled(true);
   blockSignals(false);
 }
+
+//======================================
+int CrowdSimTableBase::row_of(const QWidget* widget, int column) const
+{
+  for (auto i = 0; i < rowCount(); i++)
+  {
+    if (cellWidget(i, column) == widget)
+      return i;
+  }
+  return -1;
+}
+
+//======================================
+void CrowdSimTableBase::_add_delete_button(int row)
+{
+  QPushButton* delete_button = new QPushButton("Del");
+  setCellWidget(row, get_label_size() - 1, delete_button);
+  connect(
+    delete_button,
+    &QAbstractButton::clicked,
+    [delete_button, this]()
+    {
+      _delete_row(row_of(delete_button, get_label_size() - 1));
+    }
+  );
+}
+
+//======================================
+void CrowdSimTableBase::_add_row()
+{
+  save();
+  const int row = rowCount() - 1;
+  const bool in_step = get_cache_size() == row;
+  add_button_click();
+  if (!in_step || get_cache_size() != row + 1)
+  {
+    update();
+    return;
+  }
+
+  blockSignals(true);
+  insertRow(row);  // just above the add button
+  list_choices();
+  list_item_in_row(row);
+  _add_delete_button(row);
+  blockSignals(false);
+}
+
+//======================================
+void CrowdSimTableBase::_delete_row(int row)
+{
+  if (row < 0)
+    return;
+  save();
+  const int num_rows = rowCount() - 1;
+  const bool in_step = get_cache_size() == num_rows;
+  delete_button_click(row);
+  if (!in_step)
+  {
+    update();
+    return;
+  }
+  if (get_cache_size() == num_rows - 1)
+  {
+    blockSignals(true);
+    removeRow(row);
+    blockSignals(false);
+  }
+}
@@ -37,17 +37,31 @@ public:
   void set_label_size(size_t label_size) { _label_size = label_size; }
 
   virtual int get_cache_size() const = 0;
-  virtual void list_item_in_cache() = 0;
+  /// Fill in the cells of one row, all but the delete button, from the cache
+  virtual void list_item_in_row(int row) = 0;
+  /// Work out what the combo boxes of the rows offer; called once before
+  /// the rows are listed, rather than by each row
+  virtual void list_choices() {}
   virtual void save() = 0;
   virtual void save_to_impl() = 0;
   virtual void add_button_click() = 0;
   virtual void delete_button_click(size_t row_num) = 0;
 
+  /// Rebuild every row from the cache. Adding or deleting a row only
+  /// touches that row, unless save() dropped rows which it couldn't save.
   virtual void update();
 
+protected:
+  /// The row which a cell widget is in now, or -1
+  int row_of(const QWidget* widget, int column) const;
+
 private:
   CrowdSimImplPtr _crowd_sim_impl;
   size_t _label_size;
+
+  void _add_delete_button(int row);
+  void _add_row();
+  void _delete_row(int row);
 };
 
 using CrowdSimTablePtr = std::shared_ptr<CrowdSimTableBase>;
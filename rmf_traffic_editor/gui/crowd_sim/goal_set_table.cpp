@@ -40,32 +40,28 @@ std::shared_ptr<GoalSetTab> GoalSetTab::init_and_make(
 }
 
 //======================================================
-void GoalSetTab::list_item_in_cache()
+void GoalSetTab::list_item_in_row(int row)
 {
-  auto cache_count = _cache.size();
-  for (size_t i = 0; i < cache_count; i++)
-  {
-    auto& goal_set = _cache[i];
-    QTableWidget::setItem(
-      i,
-      0,
-      new QTableWidgetItem(
-        QString::number(static_cast<int>(goal_set.get_goal_set_id() ))));
-
-    MultiSelectComboBox* multi_combo_box =
-      new MultiSelectComboBox(get_impl()->get_goal_areas());
-    multi_combo_box->showCheckedItem(goal_set.get_goal_areas());
-    QTableWidget::setCellWidget(
-      i,
-      1,
-      multi_combo_box);
-
-    QTableWidget::setItem(
-      i,
-      2,
-      new QTableWidgetItem(
-        QString::number(static_cast<int>(goal_set.get_capacity() ))));
-  }
+  const auto& goal_set = _cache.at(row);
+  QTableWidget::setItem(
+    row,
+    0,
+    new QTableWidgetItem(
+      QString::number(static_cast<int>(goal_set.get_goal_set_id() ))));
+
+  MultiSelectComboBox* multi_combo_box =
+    new MultiSelectComboBox(get_impl()->get_goal_areas());
+  multi_combo_box->showCheckedItem(goal_set.get_goal_areas());
+  QTableWidget::setCellWidget(
+    row,
+    1,
+    multi_combo_box);
+
+  QTableWidget::setItem(
+    row,
+    2,
+    new QTableWidgetItem(
+      QString::number(static_cast<int>(goal_set.get_capacity() ))));
 }
 
 //======================================================
@@ -39,43 +39,39 @@ std::shared_ptr<ModelTypeTab> ModelTypeTab::init_and_make(
 }
 
 //===================================================
-void ModelTypeTab::list_item_in_cache()
+void ModelTypeTab::list_item_in_row(int row)
 {
-  auto cache_count = get_cache_size();
-  for (auto i = 0; i < cache_count; i++)
-  {
-    auto current_model_type = _cache[i];
-    setItem(i, 0,
-      new QTableWidgetItem(QString::fromStdString(
-        current_model_type.get_name() )));
-    setItem(i, 1,
-      new QTableWidgetItem(QString::fromStdString(
-        current_model_type.get_animation() )));
-    setItem(i, 2,
-      new QTableWidgetItem(QString::number(
-        current_model_type.get_animation_speed() )));
-    setItem(i, 3,
-      new QTableWidgetItem(QString::fromStdString(
-        current_model_type.get_model_uri() )));
-    setItem(i, 4,
-      new QTableWidgetItem(QString::number(
-        current_model_type.get_init_pose()[0])));
-    setItem(i, 5,
-      new QTableWidgetItem(QString::number(
-        current_model_type.get_init_pose()[1])));
-    setItem(i, 6,
-      new QTableWidgetItem(QString::number(
-        current_model_type.get_init_pose()[2])));
-    setItem(i, 7,
-      new QTableWidgetItem(QString::number(
-        current_model_type.get_init_pose()[3])));
-    setItem(i, 8,
-      new QTableWidgetItem(QString::number(
-        current_model_type.get_init_pose()[4])));
-    setItem(i, 9,
-      new QTableWidgetItem(QString::number(
-        current_model_type.get_init_pose()[5])));
-  }
+  const auto& current_model_type = _cache.at(row);
+  setItem(row, 0,
+    new QTableWidgetItem(QString::fromStdString(
+      current_model_type.get_name() )));
+  setItem(row, 1,
+    new QTableWidgetItem(QString::fromStdString(
+      current_model_type.get_animation() )));
+  setItem(row, 2,
+    new QTableWidgetItem(QString::number(
+      current_model_type.get_animation_speed() )));
+  setItem(row, 3,
+    new QTableWidgetItem(QString::fromStdString(
+      current_model_type.get_model_uri() )));
+  setItem(row, 4,
+    new QTableWidgetItem(QString::number(
+      current_model_type.get_init_pose()[0])));
+  setItem(row, 5,
+    new QTableWidgetItem(QString::number(
+      current_model_type.get_init_pose()[1])));
+  setItem(row, 6,
+    new QTableWidgetItem(QString::number(
+      current_model_type.get_init_pose()[2])));
+  setItem(row, 7,
+    new QTableWidgetItem(QString::number(
+      current_model_type.get_init_pose()[3])));
+  setItem(row, 8,
+    new QTableWidgetItem(QString::number(
+      current_model_type.get_init_pose()[4])));
+  setItem(row, 9,
+    new QTableWidgetItem(QString::number(
+      current_model_type.get_init_pose()[5])));
 }
 
 //===================================================
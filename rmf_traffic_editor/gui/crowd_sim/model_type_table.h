@@ -43,7 +43,7 @@ public:
   {
     return static_cast<int>(_cache.size());
   }
-  void list_item_in_cache() override;
+  void list_item_in_row(int row) override;
   void save() override;
   void save_to_impl() override;
   void add_button_click() override;
@@ -39,38 +39,49 @@ std::shared_ptr<StatesTab> StatesTab::init_and_make(
 }
 
 //========================================
-void StatesTab::list_item_in_cache()
+void StatesTab::list_choices()
 {
-  auto cache_count = _cache.size();
+  _goal_set_ids.clear();
+  for (const auto& goal_set : get_impl()->get_goal_sets())
+  {
+    _goal_set_ids.append(QString::number(
+        static_cast<int>(goal_set.get_goal_set_id())));
+  }
+
+  _navmesh_file_names.clear();
+  for (const auto& navmesh_file_name : get_impl()->get_navmesh_file_name())
+    _navmesh_file_names.append(QString::fromStdString(navmesh_file_name));
+}
+
+//========================================
+void StatesTab::list_item_in_row(int row)
+{
+  const auto& current_state = _cache.at(row);
+  setItem(row, 0,
+    new QTableWidgetItem(QString::fromStdString(current_state.get_name()) ) );
 
   //row 0 for external_state
-  auto external_state = _cache[0];
-  setItem(0, 0,
-    new QTableWidgetItem(QString::fromStdString(external_state.get_name() )));
-  setItem(0, 1,
-    new QTableWidgetItem(QString::number(
-      external_state.get_final_state() ? 1 : 0)));
-
-  for (size_t i = 1; i < cache_count; i++)
+  if (row == 0)
   {
-    auto& current_state = _cache.at(i);
-    setItem(i, 0,
-      new QTableWidgetItem(QString::fromStdString(current_state.get_name()) ) );
-
-    QComboBox* final_state_combo = new QComboBox;
-    _list_final_states_in_combo(final_state_combo,
-      current_state.get_final_state());
-    setCellWidget(i, 1, final_state_combo);
-
-    QComboBox* navmesh_list_combo = new QComboBox;
-    _list_navmesh_file_in_combo(navmesh_list_combo,
-      current_state.get_navmesh_file_name() );
-    setCellWidget(i, 2, navmesh_list_combo);
-
-    QComboBox* goal_set_combo = new QComboBox;
-    _list_goal_sets_in_combo(goal_set_combo, current_state.get_goal_set_id());
-    setCellWidget(i, 3, goal_set_combo);
+    setItem(0, 1,
+      new QTableWidgetItem(QString::number(
+        current_state.get_final_state() ? 1 : 0)));
+    return;
   }
+
+  QComboBox* final_state_combo = new QComboBox;
+  _list_final_states_in_combo(final_state_combo,
+    current_state.get_final_state());
+  setCellWidget(row, 1, final_state_combo);
+
+  QComboBox* navmesh_list_combo = new QComboBox;
+  _list_navmesh_file_in_combo(navmesh_list_combo,
+    current_state.get_navmesh_file_name() );
+  setCellWidget(row, 2, navmesh_list_combo);
+
+  QComboBox* goal_set_combo = new QComboBox;
+  _list_goal_sets_in_combo(goal_set_combo, current_state.get_goal_set_id());
+  setCellWidget(row, 3, goal_set_combo);
 }
 
 //========================================
@@ -151,11 +162,7 @@ void StatesTab::_list_goal_sets_in_combo(
   QComboBox* comboBox,
   size_t current_goal_set_id)
 {
-  for (auto goal_set : get_impl()->get_goal_sets())
-  {
-    comboBox->addItem(QString::number(
-        static_cast<int>(goal_set.get_goal_set_id())));
-  }
+  comboBox->addItems(_goal_set_ids);
   auto index =
     comboBox->findText(QString::number(static_cast<int>(current_goal_set_id) ));
   if (index >= 0)
@@ -184,15 +191,13 @@ void StatesTab::_list_final_states_in_combo(
 //========================================
 void StatesTab::_list_navmesh_file_in_combo(
   QComboBox* comboBox,
-  std::string navmesh_filename)
+  const std::string& navmesh_filename)
 {
-  auto navmesh_list = get_impl()->get_navmesh_file_name();
-  for (size_t i = 0; i < navmesh_list.size(); i++)
+  comboBox->addItems(_navmesh_file_names);
+  auto index =
+    comboBox->findText(QString::fromStdString(navmesh_filename));
+  if (index >= 0)
   {
-    comboBox->addItem(QString::fromStdString(navmesh_list[i]));
-    if (navmesh_list[i] == navmesh_filename)
-    {
-      comboBox->setCurrentIndex(i);
-    }
+    comboBox->setCurrentIndex(index);
   }
 }
\ No newline at end of file
@@ -40,7 +40,8 @@ public:
   {
     return static_cast<int>(_cache.size());
   }
-  void list_item_in_cache() override;
+  void list_item_in_row(int row) override;
+  void list_choices() override;
   void save() override;
   void save_to_impl() override;
   void add_button_click() override;
@@ -48,12 +49,14 @@ public:
 
 private:
   std::vector<crowd_sim::State> _cache;
+  QStringList _goal_set_ids;
+  QStringList _navmesh_file_names;
 
   void _list_goal_sets_in_combo(QComboBox* comboBox,
     size_t current_goal_set_id);
   void _list_final_states_in_combo(QComboBox* comboBox, bool current_state);
   void _list_navmesh_file_in_combo(QComboBox* comboBox,
-    std::string navmesh_filename);
+    const std::string& navmesh_filename);
 };
 
 #endif
\ No newline at end of file
@@ -40,28 +40,27 @@ std::shared_ptr<ToStateTab> ToStateTab::init_and_make(
 }
 
 //=====================================================
-void ToStateTab::list_item_in_cache()
+void ToStateTab::list_choices()
 {
-  auto cache_count = get_cache_size();
-  for (auto i = 0; i < cache_count; i++)
-  {
-    auto to_state = _cache.at(i);
-    auto to_state_name = to_state.first;
-    auto to_state_weight = to_state.second;
+  _state_names.clear();
+  for (const auto& state : get_impl()->get_states())
+    _state_names.append(QString::fromStdString(state.get_name() ));
+}
 
-    QComboBox* state_comboBox = new QComboBox;
-    for (auto state : get_impl()->get_states())
-    {
-      state_comboBox->addItem(QString::fromStdString(state.get_name() ));
-    }
-    auto index =
-      state_comboBox->findText(QString::fromStdString(to_state_name) );
-    state_comboBox->setCurrentIndex(index >= 0 ? index : 0);
-    setCellWidget(i, 0, state_comboBox);
+//=====================================================
+void ToStateTab::list_item_in_row(int row)
+{
+  const auto& to_state = _cache.at(row);
 
-    setItem(
-      i, 1, new QTableWidgetItem(QString::number(to_state_weight)));
-  }
+  QComboBox* state_comboBox = new QComboBox;
+  state_comboBox->addItems(_state_names);
+  auto index =
+    state_comboBox->findText(QString::fromStdString(to_state.first) );
+  state_comboBox->setCurrentIndex(index >= 0 ? index : 0);
+  setCellWidget(row, 0, state_comboBox);
+
+  setItem(
+    row, 1, new QTableWidgetItem(QString::number(to_state.second)));
 }
 
 //=====================================================
@@ -47,7 +47,8 @@ public:
   {
     return static_cast<int>(_cache.size());
   }
-  void list_item_in_cache() override;
+  void list_item_in_row(int row) override;
+  void list_choices() override;
   void save() override;
   void save_to_impl() override;
   void add_button_click() override;
@@ -57,6 +58,7 @@ private:
   //to_state_cache<to_state_name, weight>
   std::vector<std::pair<std::string, double>> _cache;
   Transition& _current_transition;
+  QStringList _state_names;
 
 };
 
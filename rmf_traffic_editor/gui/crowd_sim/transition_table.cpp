@@ -42,69 +42,83 @@ std::shared_ptr<TransitionTab> TransitionTab::init_and_make(
 }
 
 //==================================================
-void TransitionTab::list_item_in_cache()
+void TransitionTab::list_choices()
 {
-  auto cache_count = _cache.size();
-  for (size_t i = 0; i < cache_count; i++)
+  _from_state_names.clear();
+  for (const auto& state : get_impl()->get_states())
   {
-    auto& transition = _cache.at(i);
-
-    QComboBox* from_state_comboBox = new QComboBox;
-    _list_from_states_in_combo(from_state_comboBox, transition);
-    setCellWidget(i, 0, from_state_comboBox);
-
-    auto to_state = transition.get_to_state();
-    std::string to_state_name = "";
-    for (auto state : to_state)
+    if (state.get_final_state())
     {
-      to_state_name += state.first + ";";
+      continue;
     }
-    setItem(i, 1, new QTableWidgetItem(QString::fromStdString(to_state_name)));
-
-    QPushButton* to_state_edit = new QPushButton("Edit", this);
-    setCellWidget(i, 2, to_state_edit);
-    connect(
-      to_state_edit,
-      &QAbstractButton::clicked,
-      [this, &transition]()
-      {
-        ToStateDialog to_state_dialog(get_impl(), "To_State", transition);
-        to_state_dialog.exec();
-        update();
-      }
-    );
-
-    auto condition_name = transition.get_condition()->get_condition_name();
-    setItem(i, 3, new QTableWidgetItem(QString::fromStdString(condition_name)));
-
-    QPushButton* condition_edit = new QPushButton("Edit", this);
-    setCellWidget(i, 4, condition_edit);
-    connect(
-      condition_edit,
-      &QAbstractButton::clicked,
-      [this, &transition]()
-      {
-        ConditionDialog condition_dialog(get_impl(), "Condition", transition);
-        condition_dialog.exec();
-        update();
-      }
-    );
+    _from_state_names.append(QString::fromStdString(state.get_name() ) );
   }
 }
 
 //==================================================
-void TransitionTab::_list_from_states_in_combo(
-  QComboBox* comboBox,
-  crowd_sim::Transition& transition)
+void TransitionTab::list_item_in_row(int row)
 {
-  for (auto state : get_impl()->get_states())
+  const auto& transition = _cache.at(row);
+
+  QComboBox* from_state_comboBox = new QComboBox;
+  _list_from_states_in_combo(from_state_comboBox, transition);
+  setCellWidget(row, 0, from_state_comboBox);
+
+  std::string to_state_name = "";
+  for (const auto& state : transition.get_to_state())
   {
-    if (state.get_final_state())
+    to_state_name += state.first + ";";
+  }
+  setItem(row, 1,
+    new QTableWidgetItem(QString::fromStdString(to_state_name)));
+
+  // the rows above may have been added or deleted by the time the buttons
+  // are clicked, so they look up which transition they are for then
+  QPushButton* to_state_edit = new QPushButton("Edit", this);
+  setCellWidget(row, 2, to_state_edit);
+  connect(
+    to_state_edit,
+    &QAbstractButton::clicked,
+    [this, to_state_edit]()
     {
-      continue;
+      const int current_row = row_of(to_state_edit, 2);
+      if (current_row < 0)
+        return;
+      ToStateDialog to_state_dialog(
+        get_impl(), "To_State", _cache.at(current_row));
+      to_state_dialog.exec();
+      list_item_in_row(current_row);
     }
-    comboBox->addItem(QString::fromStdString(state.get_name() ) );
-  }
+  );
+
+  auto condition_name = transition.get_condition()->get_condition_name();
+  setItem(row, 3,
+    new QTableWidgetItem(QString::fromStdString(condition_name)));
+
+  QPushButton* condition_edit = new QPushButton("Edit", this);
+  setCellWidget(row, 4, condition_edit);
+  connect(
+    condition_edit,
+    &QAbstractButton::clicked,
+    [this, condition_edit]()
+    {
+      const int current_row = row_of(condition_edit, 4);
+      if (current_row < 0)
+        return;
+      ConditionDialog condition_dialog(
+        get_impl(), "Condition", _cache.at(current_row));
+      condition_dialog.exec();
+      list_item_in_row(current_row);
+    }
+  );
+}
+
+//==================================================
+void TransitionTab::_list_from_states_in_combo(
+  QComboBox* comboBox,
+  const crowd_sim::Transition& transition)
+{
+  comboBox->addItems(_from_state_names);
   auto index =
     comboBox->findText(QString::fromStdString(transition.get_from_state()) );
   comboBox->setCurrentIndex(index >= 0 ? index : 0);
@@ -132,7 +146,6 @@ void TransitionTab::save()
       pItem_from_state->currentText().toStdString());
   }
   _cache = tmp_cache;
-  update();
 }
 
 //==================================================
@@ -41,7 +41,8 @@ public:
   {
     return static_cast<int>(_cache.size());
   }
-  void list_item_in_cache() override;
+  void list_item_in_row(int row) override;
+  void list_choices() override;
   void save() override;
   void save_to_impl() override;
   void add_button_click() override;
@@ -49,10 +50,11 @@ public:
 
 private:
   std::vector<crowd_sim::Transition> _cache;
+  QStringList _from_state_names;
 
   void _list_from_states_in_combo(
     QComboBox* comboBox,
-    crowd_sim::Transition& transition);
+    const crowd_sim::Transition& transition);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include "decoded_image_cache.hpp"
+#include "logging.hpp"
+
+namespace {
+
+// bump this whenever the layout of the entries changes
+const uint32_t ENTRY_MAGIC = 0x54454431;  // "TED1"
+
+struct EntryHeader
+{
+  uint32_t magic;
+  int32_t width;
+  int32_t height;
+  int32_t format;
+  int32_t bytes_per_line;
+  int32_t reserved;  // keeps the pixels 8-byte aligned
+};
+
+std::atomic<std::uint64_t> num_hits {0};
+std::atomic<std::uint64_t> num_misses {0};
+
+void unmap_entry(void* info)
+{
+  delete static_cast<QFile*>(info);  // this also unmaps the pixels
+}
+
+}  // namespace
+
+QString DecodedImageCache::cache_dir()
+{
+  return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+    "/decoded_images";
+}
+
+QString DecodedImageCache::entry_path(
+  const QString& filename,
+  const QImage::Format format)
+{
+  const QFileInfo file_info(filename);
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(file_info.absoluteFilePath().toUtf8());
+  hash.addData(QByteArray::number(file_info.size()));
+  hash.addData(
+    QByteArray::number(file_info.lastModified().toMSecsSinceEpoch()));
+  hash.addData(QByteArray::number(static_cast<int>(format)));
+  return cache_dir() + "/" + QString::fromLatin1(hash.result().toHex()) +
+    ".img";
+}
+
+QImage DecodedImageCache::load(
+  const QString& filename,
+  const QImage::Format format,
+  QString* error_string)
+{
+  const QString path = entry_path(filename, format);
+  QImage image = read_entry(path);
+  if (!image.isNull())
+  {
+    num_hits++;
+    return image;
+  }
+  num_misses++;
+
+  QImageReader image_reader(filename);
+  image_reader.setAutoTransform(true);
+  image = image_reader.read();
+  if (image.isNull())
+  {
+    if (error_string)
+      *error_string = image_reader.errorString();
+    return image;
+  }
+  image = image.convertToFormat(format);
+  write_entry(path, image);
+  return image;
+}
+
+std::uint64_t DecodedImageCache::hits()
+{
+  return num_hits;
+}
+
+std::uint64_t DecodedImageCache::misses()
+{
+  return num_misses;
+}
+
+bool DecodedImageCache::contains(
+  const QString& filename,
+  const QImage::Format format)
+{
+  return QFile::exists(entry_path(filename, format));
+}
+
+QImage DecodedImageCache::read_entry(const QString& path)
+{
+  QFile* file = new QFile(path);
+  if (!file->open(QIODevice::ReadOnly) ||
+    file->size() < static_cast<qint64>(sizeof(EntryHeader)))
+  {
+    delete file;
+    return QImage();
+  }
+
+  uchar* data = file->map(0, file->size());
+  if (!data)
+  {
+    delete file;
+    return QImage();
+  }
+
+  EntryHeader header;
+  memcpy(&header, data, sizeof(header));
+  const qint64 pixel_bytes =
+    static_cast<qint64>(header.bytes_per_line) * header.height;
+  if (header.magic != ENTRY_MAGIC ||
+    header.width <= 0 ||
+    header.height <= 0 ||
+    file->size() != static_cast<qint64>(sizeof(header)) + pixel_bytes)
+  {
+    qCWarning(lc_io,
+      "ignoring corrupt image cache entry %s", qUtf8Printable(path));
+    delete file;
+    return QImage();
+  }
+
+  // the QImage owns the mapping, and releases it with its last copy
+  // the mapping is read-only, so hand QImage a const pointer: it will
+  // make a copy of its own if anyone ever paints on it
+  const uchar* const pixels = data + sizeof(header);
+  return QImage(
+    pixels,
+    header.width,
+    header.height,
+    header.bytes_per_line,
+    static_cast<QImage::Format>(header.format),
+    unmap_entry,
+    file);
+}
+
+void DecodedImageCache::write_entry(const QString& path, const QImage& image)
+{
+  if (!QDir().mkpath(cache_dir()))
+    return;
+
+  EntryHeader header;
+  header.magic = ENTRY_MAGIC;
+  header.width = image.width();
+  header.height = image.height();
+  header.format = static_cast<int32_t>(image.format());
+  header.bytes_per_line = image.bytesPerLine();
+  header.reserved = 0;
+
+  // write to a temporary file and rename it, so that another thread or
+  // process never sees a partial entry
+  QSaveFile file(path);
+  if (!file.open(QIODevice::WriteOnly))
+    return;
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(
+    reinterpret_cast<const char*>(image.constBits()),
+    static_cast<qint64>(header.bytes_per_line) * header.height);
+  if (!file.commit())
+    qCWarning(lc_io,
+      "unable to write image cache entry %s", qUtf8Printable(path));
+}
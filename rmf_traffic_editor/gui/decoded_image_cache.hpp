@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__DECODED_IMAGE_CACHE_HPP
+#define TRAFFIC_EDITOR__DECODED_IMAGE_CACHE_HPP
+
+#include <cstdint>
+
+#include <QImage>
+#include <QString>
+
+//=============================================================================
+/// On-disk cache of decoded images, so that reopening a building doesn't
+/// have to decode every floorplan and layer PNG again. Each entry is a raw
+/// pixel buffer behind a small header, named by a hash of the source path,
+/// its size and modification time, and the pixel format. Entries are
+/// memory-mapped and wrapped in a QImage without copying or decoding.
+class DecodedImageCache
+{
+public:
+  /// Read the image at this path converted to this format, from the cache
+  /// if possible. On a cache miss the image is decoded with QImageReader
+  /// and written to the cache. Returns a null image (and sets error_string)
+  /// if the file can't be read. Safe to call from several threads.
+  static QImage load(
+    const QString& filename,
+    const QImage::Format format,
+    QString* error_string = nullptr);
+
+  /// Whether there is an entry for this image, so that load() won't have
+  /// to decode it
+  static bool contains(const QString& filename, const QImage::Format format);
+
+  /// How many load() calls were served from the cache, and how many
+  /// decoded the image, since the editor started
+  static std::uint64_t hits();
+  static std::uint64_t misses();
+
+  /// The directory holding the cache entries
+  static QString cache_dir();
+
+private:
+  static QString entry_path(
+    const QString& filename,
+    const QImage::Format format);
+
+  static QImage read_entry(const QString& path);
+
+  static void write_entry(const QString& path, const QImage& image);
+};
+
+#endif
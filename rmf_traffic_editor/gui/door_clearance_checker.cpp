@@ -0,0 +1,399 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+
+#include <QPainterPath>
+#include <QtConcurrent/QtConcurrent>
+
+#include "door_clearance_checker.hpp"
+#include "level.h"
+#include "model_overlap_checker.hpp"
+#include "polygon_geometry.hpp"
+#include "scene_geometry.hpp"
+
+using std::vector;
+typedef SegmentRTree::Segment Segment;
+
+namespace {
+
+/// What the doors are checked against, indexed before the doors are
+/// checked in parallel, and only read while they are
+struct Obstacles
+{
+  SegmentRTree walls;
+  SegmentRTree doors;  // the bounding boxes of their envelopes
+  SegmentRTree models;  // the bounding boxes of their footprints
+  SegmentRTree robots;  // points
+  vector<QPolygonF> model_outlines;  // by model index
+  double robot_radius = 0.0;  // scene pixels
+  double min_overlap_area = 0.0;  // scene pixels squared
+};
+
+Segment box_of(const QRectF& r)
+{
+  Segment box;
+  box.x0 = r.left();
+  box.y0 = r.top();
+  box.x1 = r.right();
+  box.y1 = r.bottom();
+  return box;
+}
+
+/// Whether the segments cross, and where
+bool segments_cross(
+  const Segment& a,
+  const QPointF& b0,
+  const QPointF& b1,
+  QPointF& p)
+{
+  const double ax = a.x1 - a.x0;
+  const double ay = a.y1 - a.y0;
+  const double bx = b1.x() - b0.x();
+  const double by = b1.y() - b0.y();
+  const double denominator = ax * by - ay * bx;
+  if (denominator == 0.0)
+    return false;  // parallel; an end inside is found by segment_enters()
+  const double dx = b0.x() - a.x0;
+  const double dy = b0.y() - a.y0;
+  const double t = (dx * by - dy * bx) / denominator;
+  const double u = (dx * ay - dy * ax) / denominator;
+  if (t < 0.0 || t > 1.0 || u < 0.0 || u > 1.0)
+    return false;
+  p = QPointF(a.x0 + t * ax, a.y0 + t * ay);
+  return true;
+}
+
+/// Whether the segment has a point inside the polygon, and one such point
+bool segment_enters(const QPolygonF& polygon, const Segment& s, QPointF& p)
+{
+  for (const QPointF& end : {QPointF(s.x0, s.y0), QPointF(s.x1, s.y1)})
+  {
+    if (polygon.containsPoint(end, Qt::OddEvenFill))
+    {
+      p = end;
+      return true;
+    }
+  }
+  for (int i = 0; i < polygon.size(); i++)
+  {
+    if (segments_cross(s, polygon[i], polygon[(i + 1) % polygon.size()], p))
+      return true;
+  }
+  return false;
+}
+
+/// Whether the polygons overlap by more than min_area, and the middle of
+/// where they do
+bool polygons_overlap(
+  const QPolygonF& a,
+  const QPolygonF& b,
+  const double min_area,
+  QPointF& p)
+{
+  if (!a.boundingRect().intersects(b.boundingRect()))
+    return false;
+  const QPolygonF overlap = a.intersected(b);
+  if (std::abs(PolygonGeometry::signed_area(overlap)) <= min_area)
+    return false;
+  p = overlap.boundingRect().center();
+  return true;
+}
+
+double distance_to_outline(const QPolygonF& polygon, const QPointF& p)
+{
+  double distance = 1e100;
+  for (int i = 0; i < polygon.size(); i++)
+  {
+    const QPointF& a = polygon[i];
+    const QPointF& b = polygon[(i + 1) % polygon.size()];
+    distance = std::min(
+      distance,
+      SegmentRTree::distance_to_segment(
+        p.x(), p.y(), {a.x(), a.y(), b.x(), b.y()}));
+  }
+  return distance;
+}
+
+struct DoorCheck
+{
+  int edge_idx = -1;
+  bool sliding = false;
+  vector<DoorClearanceChecker::Violation> violations;
+};
+
+void check_door(
+  const Level& level,
+  const vector<vector<QPolygonF>>& envelopes,
+  const Obstacles& obstacles,
+  DoorCheck& check)
+{
+  typedef DoorClearanceChecker::Violation Violation;
+  const Edge& door = level.edges[check.edge_idx];
+  const double door_dx =
+    level.vertices[door.end_idx].x - level.vertices[door.start_idx].x;
+  const double door_dy =
+    level.vertices[door.end_idx].y - level.vertices[door.start_idx].y;
+  const double door_length = std::hypot(door_dx, door_dy);
+  auto add = [&check](
+    const DoorClearanceChecker::Kind kind,
+    const int other_idx,
+    const QPointF& p)
+    {
+      Violation violation;
+      violation.kind = kind;
+      violation.door_idx = check.edge_idx;
+      violation.other_idx = other_idx;
+      violation.x = p.x();
+      violation.y = p.y();
+      check.violations.push_back(violation);
+    };
+
+  // an obstacle in the way of both leaves of a door is reported once
+  vector<int> ids;
+  std::set<std::pair<int, int>> found;
+  for (const QPolygonF& envelope : envelopes[check.edge_idx])
+  {
+    const QRectF bounds = envelope.boundingRect();
+    QPointF p;
+
+    ids.clear();
+    obstacles.walls.intersecting(
+      bounds.left(), bounds.top(), bounds.right(), bounds.bottom(), ids);
+    for (const int wall_idx : ids)
+    {
+      const Edge& wall = level.edges[wall_idx];
+      if (wall.start_idx == door.start_idx || wall.start_idx == door.end_idx ||
+        wall.end_idx == door.start_idx || wall.end_idx == door.end_idx)
+        continue;  // a jamb
+      const Segment s = {
+        level.vertices[wall.start_idx].x,
+        level.vertices[wall.start_idx].y,
+        level.vertices[wall.end_idx].x,
+        level.vertices[wall.end_idx].y
+      };
+      if (check.sliding)
+      {
+        // the pocket a sliding door disappears into is along the door:
+        // skip walls within about 6 degrees of parallel to it
+        const double wall_dx = s.x1 - s.x0;
+        const double wall_dy = s.y1 - s.y0;
+        const double sine = std::abs(wall_dx * door_dy - wall_dy * door_dx) /
+          (std::hypot(wall_dx, wall_dy) * door_length);
+        if (sine < 0.1)
+          continue;
+      }
+      if (segment_enters(envelope, s, p) &&
+        found.insert({DoorClearanceChecker::WALL, wall_idx}).second)
+        add(DoorClearanceChecker::WALL, wall_idx, p);
+    }
+
+    ids.clear();
+    obstacles.doors.intersecting(
+      bounds.left(), bounds.top(), bounds.right(), bounds.bottom(), ids);
+    for (const int other_idx : ids)
+    {
+      if (other_idx == check.edge_idx)
+        continue;
+      for (const QPolygonF& other : envelopes[other_idx])
+      {
+        if (polygons_overlap(
+            envelope, other, obstacles.min_overlap_area, p) &&
+          found.insert({DoorClearanceChecker::DOOR, other_idx}).second)
+          add(DoorClearanceChecker::DOOR, other_idx, p);
+      }
+    }
+
+    ids.clear();
+    obstacles.models.intersecting(
+      bounds.left(), bounds.top(), bounds.right(), bounds.bottom(), ids);
+    for (const int model_idx : ids)
+    {
+      if (polygons_overlap(
+          envelope,
+          obstacles.model_outlines[model_idx],
+          obstacles.min_overlap_area,
+          p) &&
+        found.insert({DoorClearanceChecker::MODEL, model_idx}).second)
+        add(DoorClearanceChecker::MODEL, model_idx, p);
+    }
+
+    ids.clear();
+    const double r = obstacles.robot_radius;
+    obstacles.robots.intersecting(
+      bounds.left() - r, bounds.top() - r,
+      bounds.right() + r, bounds.bottom() + r,
+      ids);
+    for (const int vertex_idx : ids)
+    {
+      const QPointF robot(
+        level.vertices[vertex_idx].x,
+        level.vertices[vertex_idx].y);
+      if ((envelope.containsPoint(robot, Qt::OddEvenFill) ||
+        distance_to_outline(envelope, robot) < r) &&
+        found.insert({DoorClearanceChecker::ROBOT, vertex_idx}).second)
+        add(DoorClearanceChecker::ROBOT, vertex_idx, robot);
+    }
+  }
+}
+
+}  // anonymous namespace
+
+//=============================================================================
+vector<QPolygonF> DoorClearanceChecker::door_envelopes(
+  const Level& level,
+  const int edge_idx)
+{
+  const Edge& edge = level.edges[edge_idx];
+  const QPainterPath path = SceneGeometry::door_motion_path(
+    edge,
+    level.vertices[edge.start_idx],
+    level.vertices[edge.end_idx],
+    level.drawing_meters_per_pixel);
+
+  // the path also has the door itself as a line, which encloses nothing
+  vector<QPolygonF> envelopes;
+  for (const QPolygonF& polygon : path.toSubpathPolygons())
+  {
+    if (std::abs(PolygonGeometry::signed_area(polygon)) > 0.0)
+      envelopes.push_back(polygon);
+  }
+  return envelopes;
+}
+
+void DoorClearanceChecker::clear()
+{
+  _valid = false;
+  _num_doors = 0;
+  _num_unknown_models = 0;
+  _envelopes.clear();
+  _violations.clear();
+}
+
+void DoorClearanceChecker::update(
+  const Level& level,
+  const vector<EditorModel>& editor_models)
+{
+  // a thumbnail which has arrived since gives its model a footprint
+  if (_valid && _revision == level.revision() && _num_unknown_models == 0)
+    return;
+
+  // edges and vertices cache what their params say on first use, so
+  // everything that reads params is done here, before the parallel part
+  const int num_vertices = static_cast<int>(level.vertices.size());
+  auto is_valid_edge = [num_vertices](const Edge& edge)
+    {
+      return edge.start_idx >= 0 && edge.start_idx < num_vertices &&
+        edge.end_idx >= 0 && edge.end_idx < num_vertices &&
+        edge.start_idx != edge.end_idx;
+    };
+
+  Obstacles obstacles;
+  const double mpp = level.drawing_meters_per_pixel;
+  obstacles.robot_radius = mpp > 0.0 ? ROBOT_RADIUS / mpp : 0.0;
+  const double min_overlap = mpp > 0.0 ? 0.01 / mpp : 0.0;  // 1 cm
+  obstacles.min_overlap_area = min_overlap * min_overlap;
+
+  _envelopes.assign(level.edges.size(), vector<QPolygonF>());
+  QVector<DoorCheck> checks;
+  vector<std::pair<int, Segment>> walls;
+  vector<std::pair<int, Segment>> door_boxes;
+  for (std::size_t i = 0; i < level.edges.size(); i++)
+  {
+    const Edge& edge = level.edges[i];
+    if (!is_valid_edge(edge))
+      continue;
+    const int id = static_cast<int>(i);
+    const Vertex& start = level.vertices[edge.start_idx];
+    const Vertex& end = level.vertices[edge.end_idx];
+    if (edge.type == Edge::WALL)
+      walls.push_back({id, {start.x, start.y, end.x, end.y}});
+    else if (edge.type == Edge::DOOR)
+    {
+      _envelopes[i] = door_envelopes(level, id);
+      if (_envelopes[i].empty())
+        continue;
+      QRectF bounds;
+      for (const QPolygonF& envelope : _envelopes[i])
+        bounds = bounds.united(envelope.boundingRect());
+      door_boxes.push_back({id, box_of(bounds)});
+      DoorCheck check;
+      check.edge_idx = id;
+      const std::string& door_type = edge.get_door_type();
+      check.sliding = door_type == "sliding" || door_type == "double_sliding";
+      checks.append(check);
+    }
+  }
+  obstacles.walls.build(walls);
+  obstacles.doors.build(door_boxes);
+
+  int num_unknown_models = 0;
+  vector<std::pair<int, Segment>> model_boxes;
+  obstacles.model_outlines.resize(level.models.size());
+  for (std::size_t i = 0; i < level.models.size(); i++)
+  {
+    const ModelOverlapChecker::Footprint footprint =
+      ModelOverlapChecker::footprint(level.models[i], editor_models, mpp);
+    if (!footprint.valid)
+    {
+      num_unknown_models++;
+      continue;
+    }
+    double xs[4];
+    double ys[4];
+    footprint.corners(xs, ys);
+    QPolygonF& outline = obstacles.model_outlines[i];
+    for (int j = 0; j < 4; j++)
+      outline.append(QPointF(xs[j], ys[j]));
+    model_boxes.push_back(
+      {static_cast<int>(i), footprint.bounding_box()});
+  }
+  obstacles.models.build(model_boxes);
+
+  vector<std::pair<int, Segment>> robots;
+  for (int i = 0; i < num_vertices; i++)
+  {
+    const Vertex& v = level.vertices[i];
+    const auto spawn_it = v.params.find("spawn_robot_type");
+    if (v.is_parking_point() || v.is_charger() ||
+      (spawn_it != v.params.end() && !spawn_it->second.value_string.empty()))
+      robots.push_back({i, {v.x, v.y, v.x, v.y}});
+  }
+  obstacles.robots.build(robots);
+
+  QtConcurrent::blockingMap(
+    checks,
+    [&level, &obstacles, this](DoorCheck& check)
+    {
+      check_door(level, _envelopes, obstacles, check);
+    });
+
+  _violations.clear();
+  for (const DoorCheck& check : checks)
+  {
+    _violations.insert(
+      _violations.end(),
+      check.violations.begin(),
+      check.violations.end());
+  }
+  _num_doors = checks.size();
+  _num_unknown_models = num_unknown_models;
+  _revision = level.revision();
+  _valid = true;
+}
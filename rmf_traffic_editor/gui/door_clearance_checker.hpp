@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__DOOR_CLEARANCE_CHECKER_HPP
+#define TRAFFIC_EDITOR__DOOR_CLEARANCE_CHECKER_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include <QPolygonF>
+
+#include "segment_rtree.hpp"
+
+class EditorModel;
+class Level;
+
+//=============================================================================
+/// Finds the doors of a level which can't open as drawn: the area a door
+/// sweeps (its swing, or the box it slides into, as the editor draws them
+/// from SceneGeometry::door_motion_path()) must be clear of walls, other
+/// doors' envelopes, model footprints (see ModelOverlapChecker) and robots
+/// parked on vertices (parking spots, chargers and robot spawn points).
+///
+/// Walls ending at a vertex of the door are its jambs and don't count, nor
+/// do walls along a sliding door, which are what it slides into. The
+/// obstacles are indexed in R-trees, and the doors are then checked in
+/// parallel. An update does nothing unless the level changed.
+class DoorClearanceChecker
+{
+public:
+  enum Kind
+  {
+    WALL = 0,
+    DOOR,
+    MODEL,
+    ROBOT
+  };
+
+  struct Violation
+  {
+    Kind kind = WALL;
+    int door_idx = -1;  // the edge of the door
+    int other_idx = -1;  // the wall or door edge, model, or vertex
+    double x = 0.0;  // where, in scene pixels
+    double y = 0.0;
+  };
+
+  /// Radius of a robot parked on a vertex, in meters
+  static constexpr double ROBOT_RADIUS = 0.3;
+
+  /// The swing or slide envelopes of a door, in scene pixels: one polygon
+  /// per leaf
+  static std::vector<QPolygonF> door_envelopes(
+    const Level& level,
+    const int edge_idx);
+
+  /// Bring the violations up to date with the level
+  void update(
+    const Level& level,
+    const std::vector<EditorModel>& editor_models);
+
+  void clear();
+
+  /// Every violation; two doors in each other's way are both reported
+  const std::vector<Violation>& violations() const { return _violations; }
+
+  /// The envelopes of each door as last checked, by edge index (empty for
+  /// the other edges)
+  const std::vector<std::vector<QPolygonF>>& envelopes() const
+  {
+    return _envelopes;
+  }
+
+  int num_doors() const { return _num_doors; }
+
+private:
+  bool _valid = false;
+  std::size_t _revision = 0;
+  int _num_doors = 0;
+  int _num_unknown_models = 0;  // without a footprint yet
+
+  std::vector<std::vector<QPolygonF>> _envelopes;
+  std::vector<Violation> _violations;
+};
+
+#endif
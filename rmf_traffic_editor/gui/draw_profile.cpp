@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "draw_profile.hpp"
+#include "trace.hpp"
+
+
+void DrawProfile::clear()
+{
+  _phases.clear();
+  _item_counts.clear();
+}
+
+void DrawProfile::add_phase_time(const std::string& phase, const qint64 nsec)
+{
+  // there are only a dozen or so phases; a linear search is plenty
+  for (auto& it : _phases)
+  {
+    if (it.first == phase)
+    {
+      it.second += nsec;
+      return;
+    }
+  }
+  _phases.push_back(std::make_pair(phase, nsec));
+}
+
+void DrawProfile::set_item_count(const std::string& category, const int count)
+{
+  for (auto& it : _item_counts)
+  {
+    if (it.first == category)
+    {
+      it.second = count;
+      return;
+    }
+  }
+  _item_counts.push_back(std::make_pair(category, count));
+}
+
+QString DrawProfile::summary() const
+{
+  QString s("last scene build:\n");
+  for (const auto& it : _phases)
+    s += QString::asprintf(
+      "  %-16s %8.2f ms\n",
+      it.first.c_str(),
+      it.second / 1e6);
+
+  s += "scene items:\n";
+  for (const auto& it : _item_counts)
+    s += QString::asprintf("  %-16s %8d\n", it.first.c_str(), it.second);
+
+  s += QString::asprintf("last paint:        %8.2f ms", _paint_nsec / 1e6);
+  return s;
+}
+
+DrawProfile::PhaseTimer::PhaseTimer(DrawProfile* profile)
+: _profile(profile)
+{
+}
+
+DrawProfile::PhaseTimer::~PhaseTimer()
+{
+  stop();
+}
+
+void DrawProfile::PhaseTimer::start(const char* phase)
+{
+  stop();
+#ifdef TRAFFIC_EDITOR_TRACING
+  if (Trace::is_recording())
+  {
+    _phase = phase;
+    _trace_begin = Trace::now();
+  }
+#endif
+  if (!_profile)
+    return;
+  _phase = phase;
+  _timer.start();
+}
+
+void DrawProfile::PhaseTimer::stop()
+{
+#ifdef TRAFFIC_EDITOR_TRACING
+  if (_phase && _trace_begin >= 0)
+    Trace::add_zone(_phase, _trace_begin);
+  _trace_begin = -1;
+#endif
+  if (_profile && _phase)
+    _profile->add_phase_time(_phase, _timer.nsecsElapsed());
+  _phase = nullptr;
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__DRAW_PROFILE_HPP
+#define TRAFFIC_EDITOR__DRAW_PROFILE_HPP
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <QElapsedTimer>
+#include <QString>
+
+//=============================================================================
+/// Timings and item counts of the last scene build, shown by the profiling
+/// overlay of the editor. Drawing code records into it only while a
+/// profile is attached to the RenderingOptions, so it costs nothing the
+/// rest of the time.
+class DrawProfile
+{
+public:
+  void clear();
+
+  /// Add to the time of a phase; phases are listed in first-recorded order
+  void add_phase_time(const std::string& phase, const qint64 nsec);
+
+  void set_item_count(const std::string& category, const int count);
+
+  void set_paint_time(const qint64 nsec) { _paint_nsec = nsec; }
+
+  /// Human-readable table of everything recorded, one line per entry
+  QString summary() const;
+
+  /// Times consecutive phases of a draw, if profile isn't nullptr.
+  /// Each start() ends the current phase; so does going out of scope.
+  class PhaseTimer
+  {
+  public:
+    PhaseTimer(DrawProfile* profile);
+    ~PhaseTimer();
+
+    void start(const char* phase);
+    void stop();
+
+  private:
+    DrawProfile* _profile;
+    const char* _phase = nullptr;
+    QElapsedTimer _timer;
+    int64_t _trace_begin = -1;  // the phase is also a zone of the Trace
+  };
+
+private:
+  std::vector<std::pair<std::string, qint64>> _phases;
+  std::vector<std::pair<std::string, int>> _item_counts;
+  qint64 _paint_nsec = 0;
+};
+
+#endif
@@ -0,0 +1,656 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <unordered_map>
+
+#include <QFile>
+#include <QPointF>
+
+#include "dxf_importer.hpp"
+#include "logging.hpp"
+#include "task_pool.hpp"
+
+namespace {
+
+/// Group codes and values, one pair after the other, without ever holding
+/// more of the file than the longest line
+class Reader
+{
+public:
+  explicit Reader(QFile& file) : _file(file) {}
+
+  int code = 0;
+  std::string value;
+
+  /// False at the end of the file, or if it isn't pairs of lines
+  bool next()
+  {
+    if (!read_line(_line))
+      return false;
+    char* end = nullptr;
+    const long c = std::strtol(_line.c_str(), &end, 10);
+    if (end == _line.c_str())
+      return false;
+    code = static_cast<int>(c);
+    return read_line(value);
+  }
+
+  double number() const { return std::strtod(value.c_str(), nullptr); }
+  int integer() const { return std::atoi(value.c_str()); }
+
+private:
+  QFile& _file;
+  std::string _line;
+  char _buffer[4096];
+
+  bool read_line(std::string& line)
+  {
+    line.clear();
+    while (true)
+    {
+      const qint64 n = _file.readLine(_buffer, sizeof(_buffer));
+      if (n < 0)
+        return !line.empty();
+      line.append(_buffer, static_cast<std::size_t>(n));
+      if (n == 0 || _buffer[n - 1] == '\n')
+        break;
+    }
+    // the codes are right-aligned, and the file may have DOS line ends
+    const std::size_t first = line.find_first_not_of(" \t");
+    const std::size_t last = line.find_last_not_of(" \t\r\n");
+    if (first == std::string::npos)
+      line.clear();
+    else
+      line = line.substr(first, last - first + 1);
+    return true;
+  }
+};
+
+/// The entity being read, reused for the next one
+struct Entity
+{
+  std::string type;
+  std::string layer;
+  std::vector<QPointF> points;
+  std::vector<double> bulges;  // of the segment from each point
+  int flags = 0;
+  double radius = 0.0;
+  double start_angle = 0.0;  // degrees
+  double end_angle = 360.0;
+
+  void clear(const std::string& entity_type)
+  {
+    type = entity_type;
+    layer.clear();
+    points.clear();
+    bulges.clear();
+    flags = 0;
+    radius = 0.0;
+    start_angle = 0.0;
+    end_angle = 360.0;
+  }
+
+  void add(const Reader& reader)
+  {
+    switch (reader.code)
+    {
+      case 8: layer = reader.value; break;
+      case 10:
+      case 11:
+        points.push_back(QPointF(reader.number(), 0.0));
+        bulges.push_back(0.0);
+        break;
+      case 20:
+      case 21:
+        if (!points.empty())
+          points.back().setY(reader.number());
+        break;
+      case 40: radius = reader.number(); break;
+      case 42:
+        if (!bulges.empty())
+          bulges.back() = reader.number();
+        break;
+      case 50: start_angle = reader.number(); break;
+      case 51: end_angle = reader.number(); break;
+      case 70: flags = reader.integer(); break;
+      default: break;
+    }
+  }
+};
+
+/// Chords of the arc around center from angle a0, turning by sweep
+/// (radians, counterclockwise if positive), without its first point
+void add_arc(
+  const QPointF& center,
+  const double radius,
+  const double a0,
+  const double sweep,
+  const double tolerance,
+  std::vector<QPointF>& points)
+{
+  double step = M_PI / 4.0;
+  if (radius > tolerance)
+    step = std::min(step, 2.0 * std::acos(1.0 - tolerance / radius));
+  const int n = std::max(
+    1,
+    std::min(1024, static_cast<int>(std::ceil(std::abs(sweep) / step))));
+  for (int i = 1; i <= n; i++)
+  {
+    const double a = a0 + sweep * i / n;
+    points.push_back(
+      center + QPointF(radius * std::cos(a), radius * std::sin(a)));
+  }
+}
+
+/// The points of a polyline with bulges, with its arcs split into chords
+void tessellate(
+  const Entity& entity,
+  const bool closed,
+  const double tolerance,
+  std::vector<QPointF>& points)
+{
+  points.clear();
+  const std::size_t n = entity.points.size();
+  for (std::size_t i = 0; i < n; i++)
+  {
+    if (i == 0)
+      points.push_back(entity.points[0]);
+    if (i + 1 == n && !closed)
+      break;
+    const QPointF& p0 = entity.points[i];
+    const QPointF& p1 = entity.points[(i + 1) % n];
+    const double b = entity.bulges[i];
+    if (b == 0.0)
+    {
+      if (i + 1 < n)
+        points.push_back(p1);
+      continue;
+    }
+
+    // the bulge is the tangent of a quarter of the angle of the arc
+    const QPointF d = p1 - p0;
+    const QPointF center =
+      (p0 + p1) / 2.0 + QPointF(-d.y(), d.x()) * ((1.0 - b * b) / (4.0 * b));
+    const QPointF r = p0 - center;
+    add_arc(
+      center,
+      std::hypot(r.x(), r.y()),
+      std::atan2(r.y(), r.x()),
+      4.0 * std::atan(b),
+      tolerance,
+      points);
+    if (i + 1 == n)
+      points.pop_back();  // back at the first point
+  }
+}
+
+using Callback = std::function<void (
+      const std::string& layer,
+      const std::vector<QPointF>& points,
+      const bool closed)>;
+
+struct Parse
+{
+  double meters_per_unit = 0.0;
+  std::map<std::string, int> unsupported;
+};
+
+/// $INSUNITS, as meters
+double insunits_meters(const int units)
+{
+  switch (units)
+  {
+    case 1: return 0.0254;
+    case 2: return 0.3048;
+    case 4: return 0.001;
+    case 5: return 0.01;
+    case 6: return 1.0;
+    case 7: return 1000.0;
+    case 14: return 0.1;
+    default: return 0.0;
+  }
+}
+
+/// Streams the entities of the file to the callback, as points in the
+/// units of the drawing. tolerance is for the chords of arcs, in those
+/// units too.
+bool parse(
+  const QString& filename,
+  const double tolerance,
+  const Callback& callback,
+  Parse& parse,
+  QString& error,
+  TaskProgress* progress)
+{
+  QFile file(filename);
+  if (!file.open(QIODevice::ReadOnly))
+  {
+    error = QString("Unable to open %1").arg(filename);
+    return false;
+  }
+  if (file.peek(18) == "AutoCAD Binary DXF")
+  {
+    error = "Binary DXF isn't supported; save the drawing as ASCII DXF.";
+    return false;
+  }
+  if (progress)
+    progress->set_total(static_cast<int>(file.size() / 1024) + 1);
+
+  Reader reader(file);
+  Entity entity;
+  Entity polyline;  // the POLYLINE whose VERTEX entities are being read
+  bool in_polyline = false;
+  std::vector<QPointF> points;
+  std::string section;
+  std::string variable;
+  bool expect_section_name = false;
+  qint64 reported = 0;
+  int count = 0;
+
+  auto finish_entity = [&]()
+    {
+      const std::string& type = entity.type;
+      if (type.empty())
+        return;
+      if (type == "LINE")
+      {
+        if (entity.points.size() == 2)
+          callback(entity.layer, entity.points, false);
+      }
+      else if (type == "LWPOLYLINE")
+      {
+        tessellate(entity, entity.flags & 1, tolerance, points);
+        if (points.size() >= 2)
+          callback(entity.layer, points, entity.flags & 1);
+      }
+      else if (type == "POLYLINE")
+      {
+        polyline = entity;
+        polyline.points.clear();
+        polyline.bulges.clear();
+        in_polyline = true;
+      }
+      else if (type == "VERTEX")
+      {
+        if (in_polyline && !entity.points.empty())
+        {
+          polyline.points.push_back(entity.points.front());
+          polyline.bulges.push_back(entity.bulges.front());
+        }
+      }
+      else if (type == "SEQEND")
+      {
+        if (in_polyline)
+        {
+          tessellate(polyline, polyline.flags & 1, tolerance, points);
+          if (points.size() >= 2)
+            callback(polyline.layer, points, polyline.flags & 1);
+        }
+        in_polyline = false;
+      }
+      else if (type == "ARC" || type == "CIRCLE")
+      {
+        if (entity.points.empty() || entity.radius <= 0.0)
+          return;
+        const bool circle = type == "CIRCLE";
+        const double a0 = circle ? 0.0 : entity.start_angle * M_PI / 180.0;
+        double sweep = 2.0 * M_PI;
+        if (!circle)
+        {
+          sweep = (entity.end_angle - entity.start_angle) * M_PI / 180.0;
+          while (sweep <= 0.0)
+            sweep += 2.0 * M_PI;
+        }
+        const QPointF& center = entity.points.front();
+        points.clear();
+        points.push_back(
+          center +
+          QPointF(entity.radius * std::cos(a0), entity.radius * std::sin(a0)));
+        add_arc(center, entity.radius, a0, sweep, tolerance, points);
+        if (circle)
+          points.pop_back();
+        callback(entity.layer, points, circle);
+      }
+      else
+        parse.unsupported[type]++;
+    };
+
+  while (reader.next())
+  {
+    if (progress && (++count & 4095) == 0)
+    {
+      if (progress->canceled())
+        return false;
+      const qint64 kb = file.pos() / 1024;
+      progress->advance(static_cast<int>(kb - reported));
+      reported = kb;
+    }
+
+    if (reader.code == 0)
+    {
+      if (section == "ENTITIES")
+        finish_entity();
+      entity.clear(std::string());
+      if (reader.value == "SECTION")
+        expect_section_name = true;
+      else if (reader.value == "ENDSEC")
+        section.clear();
+      else if (reader.value == "EOF")
+        break;
+      else if (section == "ENTITIES")
+        entity.clear(reader.value);
+      continue;
+    }
+    if (expect_section_name && reader.code == 2)
+    {
+      section = reader.value;
+      expect_section_name = false;
+      continue;
+    }
+
+    if (section == "HEADER")
+    {
+      if (reader.code == 9)
+        variable = reader.value;
+      else if (variable == "$INSUNITS" && reader.code == 70)
+        parse.meters_per_unit = insunits_meters(reader.integer());
+    }
+    else if (!entity.type.empty())
+      entity.add(reader);
+  }
+
+  if (section == "ENTITIES")
+    finish_entity();
+  return true;
+}
+
+/// Finds the vertex within the tolerance of a point, through cells of the
+/// size of the tolerance, or adds one. A cell keeps the first vertex in
+/// it, which is close enough for the ends of lines drawn to meet.
+class VertexHash
+{
+public:
+  VertexHash(std::vector<Vertex>& vertices, const double tolerance)
+  : _vertices(vertices),
+    _tolerance(std::max(tolerance, 1e-6))
+  {
+  }
+
+  int num_welded = 0;
+
+  int find_or_add(const QPointF& p)
+  {
+    const std::int64_t cx =
+      static_cast<std::int64_t>(std::floor(p.x() / _tolerance));
+    const std::int64_t cy =
+      static_cast<std::int64_t>(std::floor(p.y() / _tolerance));
+    for (std::int64_t dy = -1; dy <= 1; dy++)
+    {
+      for (std::int64_t dx = -1; dx <= 1; dx++)
+      {
+        auto it = _cells.find(key(cx + dx, cy + dy));
+        if (it == _cells.end())
+          continue;
+        const Vertex& v = _vertices[it->second];
+        if (std::hypot(v.x - p.x(), v.y - p.y()) <= _tolerance)
+        {
+          num_welded++;
+          return it->second;
+        }
+      }
+    }
+    const int idx = static_cast<int>(_vertices.size());
+    _vertices.push_back(Vertex(p.x(), p.y()));
+    _cells.emplace(key(cx, cy), idx);
+    return idx;
+  }
+
+private:
+  std::vector<Vertex>& _vertices;
+  const double _tolerance;
+  std::unordered_map<std::uint64_t, int> _cells;
+
+  // cells far apart may share a key, which only costs a distance check
+  static std::uint64_t key(const std::int64_t cx, const std::int64_t cy)
+  {
+    return static_cast<std::uint64_t>(cx) * 0x9e3779b97f4a7c15ull ^
+      static_cast<std::uint64_t>(cy);
+  }
+};
+
+}  // namespace
+
+//=============================================================================
+const char* DxfImporter::target_name(const Target target)
+{
+  switch (target)
+  {
+    case WALL: return "Walls";
+    case DOOR: return "Doors";
+    case MEAS: return "Measurements";
+    case FLOOR: return "Floors";
+    case HOLE: return "Holes";
+    case UNDERLAY: return "Underlay";
+    default: return "Ignore";
+  }
+}
+
+DxfImporter::Target DxfImporter::guess_target(const std::string& layer_name)
+{
+  const QString name = QString::fromStdString(layer_name).toUpper();
+  if (name.contains("WALL"))
+    return WALL;
+  if (name.contains("DOOR"))
+    return DOOR;
+  if (name.contains("DIM") || name.contains("MEAS"))
+    return MEAS;
+  if (name.contains("FLOR") || name.contains("FLOOR"))
+    return FLOOR;
+  if (name.contains("DEFPOINTS"))
+    return IGNORE;
+  return UNDERLAY;
+}
+
+bool DxfImporter::scan(
+  const QString& filename,
+  Scan& scan,
+  QString& error,
+  TaskProgress* progress)
+{
+  scan = Scan();
+  std::map<std::string, int> layer_idxs;
+  double x_min = std::numeric_limits<double>::max();
+  double y_min = x_min;
+  double x_max = -x_min;
+  double y_max = -x_min;
+  Parse state;
+  const bool ok = parse(
+    filename,
+    std::numeric_limits<double>::max(),  // the extents need no more
+    [&](
+      const std::string& layer,
+      const std::vector<QPointF>& points,
+      const bool)
+    {
+      auto it = layer_idxs.find(layer);
+      if (it == layer_idxs.end())
+      {
+        it = layer_idxs.emplace(
+          layer, static_cast<int>(scan.layers.size())).first;
+        LayerInfo info;
+        info.name = layer;
+        scan.layers.push_back(info);
+      }
+      scan.layers[it->second].num_entities++;
+      scan.num_entities++;
+      for (const QPointF& p : points)
+      {
+        x_min = std::min(x_min, p.x());
+        y_min = std::min(y_min, p.y());
+        x_max = std::max(x_max, p.x());
+        y_max = std::max(y_max, p.y());
+      }
+    },
+    state,
+    error,
+    progress);
+  if (!ok)
+    return false;
+
+  scan.meters_per_unit = state.meters_per_unit;
+  scan.unsupported = state.unsupported;
+  if (scan.num_entities == 0)
+  {
+    error = "The drawing has no lines, polylines, arcs or circles.";
+    return false;
+  }
+  scan.x_min = x_min;
+  scan.y_min = y_min;
+  scan.x_max = x_max;
+  scan.y_max = y_max;
+  return true;
+}
+
+DxfImporter::Result DxfImporter::import(
+  const QString& filename,
+  const Options& options,
+  TaskProgress* progress)
+{
+  Result result;
+  result.underlay = std::make_shared<VectorUnderlay::Lines>();
+  const double mpu = options.meters_per_unit;
+  const double pixels_per_unit = mpu / options.meters_per_pixel;
+  VertexHash hash(
+    result.vertices,
+    options.weld_tolerance / options.meters_per_pixel);
+
+  // the layers are looked up once, when first seen
+  std::unordered_map<std::string, Target> targets;
+  std::vector<int> idxs;
+
+  auto to_level = [&](const QPointF& p)
+    {
+      return QPointF(
+        (p.x() - options.origin_x) * pixels_per_unit,
+        (options.origin_y - p.y()) * pixels_per_unit);
+    };
+
+  Parse state;
+  const bool ok = parse(
+    filename,
+    options.arc_tolerance / mpu,
+    [&](
+      const std::string& layer,
+      const std::vector<QPointF>& points,
+      bool closed)
+    {
+      auto it = targets.find(layer);
+      if (it == targets.end())
+      {
+        const auto option = options.targets.find(layer);
+        it = targets.emplace(
+          layer,
+          option == options.targets.end() ? IGNORE : option->second).first;
+      }
+      const Target target = it->second;
+      if (target == IGNORE)
+        return;
+      result.num_entities++;
+
+      if (target == UNDERLAY)
+      {
+        std::vector<float>& coords = result.underlay->coords;
+        const std::size_t n = points.size();
+        for (std::size_t i = 0; i + 1 < n + (closed ? 1 : 0); i++)
+        {
+          const QPointF& a = points[i];
+          const QPointF& b = points[(i + 1) % n];
+          coords.push_back((a.x() - options.origin_x) * mpu);
+          coords.push_back((options.origin_y - a.y()) * mpu);
+          coords.push_back((b.x() - options.origin_x) * mpu);
+          coords.push_back((options.origin_y - b.y()) * mpu);
+        }
+        return;
+      }
+
+      idxs.clear();
+      for (const QPointF& p : points)
+      {
+        const int idx = hash.find_or_add(to_level(p));
+        if (idxs.empty() || idxs.back() != idx)
+          idxs.push_back(idx);
+      }
+      // a polyline may end where it started without being marked closed
+      if (idxs.size() > 2 && idxs.front() == idxs.back())
+      {
+        idxs.pop_back();
+        closed = true;
+      }
+
+      if (target == FLOOR || target == HOLE)
+      {
+        if (!closed || idxs.size() < 3)
+        {
+          result.num_open_polygons++;
+          return;
+        }
+        Polygon polygon;
+        polygon.type = target == FLOOR ? Polygon::FLOOR : Polygon::HOLE;
+        polygon.vertices = idxs;
+        result.polygons.push_back(polygon);
+        return;
+      }
+
+      const Edge::Type type =
+        target == WALL ? Edge::WALL : target == DOOR ? Edge::DOOR : Edge::MEAS;
+      const std::size_t n = idxs.size();
+      for (std::size_t i = 0; i + 1 < n + (closed && n > 2 ? 1 : 0); i++)
+        result.edges.push_back(Edge(idxs[i], idxs[(i + 1) % n], type));
+    },
+    state,
+    result.error,
+    progress);
+
+  result.num_welded = hash.num_welded;
+  if (!ok)
+  {
+    result.vertices.clear();
+    result.edges.clear();
+    result.polygons.clear();
+    result.underlay.reset();
+  }
+  else
+  {
+    qCInfo(lc_io,
+      "imported %d entities of %s: %zu vertices (%d points welded), %zu "
+      "edges, %zu polygons, %zu underlay lines",
+      result.num_entities,
+      qUtf8Printable(filename),
+      result.vertices.size(),
+      result.num_welded,
+      result.edges.size(),
+      result.polygons.size(),
+      result.underlay->num_segments());
+  }
+  return result;
+}
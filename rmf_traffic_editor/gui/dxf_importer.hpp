@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__DXF_IMPORTER_HPP
+#define TRAFFIC_EDITOR__DXF_IMPORTER_HPP
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <QString>
+
+#include "edge.h"
+#include "polygon.h"
+#include "vector_underlay.hpp"
+#include "vertex.h"
+
+class TaskProgress;
+
+//=============================================================================
+/// Reads the geometry of an ASCII DXF drawing, as delivered by architects,
+/// onto a level: the LINE, LWPOLYLINE, POLYLINE, ARC and CIRCLE entities of
+/// each layer become walls, doors or measurements, floor or hole polygons
+/// (of the closed ones), or the lines of a VectorUnderlay, as chosen for the
+/// layer. Arcs are split into chords within a tolerance.
+///
+/// The file is streamed, one group code and value at a time, and only the
+/// entity being read is held, so the memory used is that of what is
+/// imported, whatever the size of the drawing. Each point is looked up in
+/// a spatial hash of cells of the weld tolerance, so the ends of lines
+/// which meet become the same vertex as they are read. Blocks (INSERT),
+/// text, hatches, splines and dimensions aren't imported, only counted.
+class DxfImporter
+{
+public:
+  enum Target
+  {
+    IGNORE = 0,
+    WALL,
+    DOOR,
+    MEAS,
+    FLOOR,
+    HOLE,
+    UNDERLAY,
+    NUM_TARGETS
+  };
+
+  static const char* target_name(const Target target);
+
+  /// From the usual names of layers (A-WALL, A-DOOR, A-FLOR, ...)
+  static Target guess_target(const std::string& layer_name);
+
+  struct LayerInfo
+  {
+    std::string name;
+    int num_entities = 0;
+  };
+
+  /// What a drawing holds, to choose what to import from it
+  struct Scan
+  {
+    std::vector<LayerInfo> layers;  // in the order first seen
+    double meters_per_unit = 0.0;  // from $INSUNITS, 0 if it isn't given
+    double x_min = 0.0;
+    double y_min = 0.0;
+    double x_max = 0.0;
+    double y_max = 0.0;
+    int num_entities = 0;
+    std::map<std::string, int> unsupported;  // of each type of entity
+  };
+
+  /// False, with the error, if it isn't a drawing that can be read. Stops
+  /// early, returning false with no error, if progress is canceled.
+  static bool scan(
+    const QString& filename,
+    Scan& scan,
+    QString& error,
+    TaskProgress* progress = nullptr);
+
+  struct Options
+  {
+    std::map<std::string, Target> targets;  // IGNORE for the layers not in it
+    double meters_per_unit = 1.0;
+
+    /// The point of the drawing, in its units, at (0, 0) of the level
+    double origin_x = 0.0;
+    double origin_y = 0.0;
+
+    double meters_per_pixel = 0.05;  // of the level
+
+    double weld_tolerance = 0.01;  // meters
+    double arc_tolerance = 0.01;  // most a chord may be off its arc, meters
+  };
+
+  struct Result
+  {
+    QString error;
+
+    /// In pixels of the level, the edges and polygons indexing vertices
+    std::vector<Vertex> vertices;
+    std::vector<Edge> edges;
+    std::vector<Polygon> polygons;
+
+    /// Of the UNDERLAY layers
+    std::shared_ptr<VectorUnderlay::Lines> underlay;
+
+    int num_entities = 0;  // which were imported
+    int num_welded = 0;  // points which were an existing vertex
+    int num_open_polygons = 0;  // open polylines of FLOOR or HOLE layers
+  };
+
+  static Result import(
+    const QString& filename,
+    const Options& options,
+    TaskProgress* progress = nullptr);
+};
+
+#endif
@@ -16,6 +16,7 @@
 */
 
 #include "edge.h"
+#include "logging.hpp"
 using std::string;
 
 
@@ -36,10 +37,6 @@ Edge::Edge(const int _start_idx, const int _end_idx, const Type _type)
   create_required_parameters();
 }
 
-Edge::~Edge()
-{
-}
-
 void Edge::from_yaml(const YAML::Node& data, const Type edge_type)
 {
   if (!data.IsSequence())
@@ -59,6 +56,7 @@ void Edge::from_yaml(const YAML::Node& data, const Type edge_type)
   }
 
   create_required_parameters();
+  update_attributes();
 }
 
 YAML::Node Edge::to_yaml() const
@@ -77,10 +75,7 @@ YAML::Node Edge::to_yaml() const
 
 bool Edge::is_bidirectional() const
 {
-  auto it = params.find("bidirectional");
-  if (it == params.end() || it->second.type != Param::BOOL)
-    return false;
-  return it->second.value_bool;
+  return attributes().bidirectional;
 }
 
 void Edge::set_param(const std::string& name, const std::string& value)
@@ -88,70 +83,30 @@ void Edge::set_param(const std::string& name, const std::string& value)
   auto it = params.find(name);
   if (it == params.end())
   {
-    printf("tried to set unknown parameter [%s]\n", name.c_str());
+    qCWarning(lc_edit, "tried to set unknown parameter [%s]", name.c_str());
     return;  // unknown parameter
   }
   it->second.set(value);
+  update_attributes();
 }
 
-template<typename T>
-void Edge::create_param_if_needed(
-  const std::string& name,
-  const Param::Type& param_type,
-  const T& param_value)
+void Edge::create_required_parameters()
 {
-  auto it = params.find(name);
-  if (it == params.end() || it->second.type != param_type)
-    params[name] = param_value;
+  // create required parameters if they don't exist yet on this edge
+  if (const ParamSchema* schema = param_schema(type))
+    schema->create_required(params);
 }
 
-void Edge::create_required_parameters()
+const ParamSchema* Edge::param_schema(const Type type)
 {
-  // create required parameters if they don't exist yet on this edge
-  if (type == MEAS)
-  {
-    auto it = params.find("distance");
-    if (it == params.end() || it->second.type != Param::DOUBLE)
-      params["distance"] = Param(1.0);
-  }
-  else if (type == WALL)
+  switch (type)
   {
-    create_param_if_needed("texture_name", Param::STRING,
-      std::string("default"));
-    create_param_if_needed("alpha", Param::DOUBLE, 1.0);
-    create_param_if_needed("texture_height", Param::DOUBLE, 2.5);
-    create_param_if_needed("texture_width", Param::DOUBLE, 1.0);
-    create_param_if_needed("texture_scale", Param::DOUBLE, 1.0);
-  }
-  else if (type == LANE)
-  {
-    create_param_if_needed("bidirectional", Param::BOOL, true);
-    create_param_if_needed("orientation", Param::STRING, std::string());
-    create_param_if_needed("graph_idx", Param::INT, 0);
-    create_param_if_needed("demo_mock_floor_name", Param::STRING,
-      std::string());
-    create_param_if_needed("demo_mock_lift_name", Param::STRING, std::string());
-    create_param_if_needed("speed_limit", Param::DOUBLE, 0.0);
-  }
-  else if (type == DOOR)
-  {
-    create_param_if_needed("name", Param::STRING, std::string("null")); // default door name
-    create_param_if_needed("type", Param::STRING, std::string("hinged"));
-    create_param_if_needed("motion_axis", Param::STRING, std::string("start"));
-    create_param_if_needed("motion_direction", Param::INT, 1);
-    create_param_if_needed("motion_degrees", Param::DOUBLE, 90.0);  // hinged
-    create_param_if_needed("right_left_ratio", Param::DOUBLE, 1.0); // doubles
-    create_param_if_needed("plugin", Param::STRING, std::string("normal"));
-  }
-  else if (type == HUMAN_LANE)
-  {
-    create_param_if_needed("width", Param::DOUBLE, 1.0);
-    create_param_if_needed("bidirectional", Param::BOOL, true);
-    create_param_if_needed("orientation", Param::STRING, std::string());
-    create_param_if_needed("graph_idx", Param::INT, 9);
-    create_param_if_needed("demo_mock_floor_name", Param::STRING,
-      std::string());
-    create_param_if_needed("demo_mock_lift_name", Param::STRING, std::string());
+    case LANE: return &param_schemas::lane;
+    case WALL: return &param_schemas::wall;
+    case MEAS: return &param_schemas::measurement;
+    case DOOR: return &param_schemas::door;
+    case HUMAN_LANE: return &param_schemas::human_lane;
+    default: return nullptr;
   }
 }
 
@@ -186,18 +141,120 @@ int Edge::get_graph_idx() const
 {
   if (type != LANE && type != HUMAN_LANE)
     return 0;// for now, only lanes have indices defined
-  auto it = params.find("graph_idx");
-  if (it == params.end() || it->second.type != Param::INT)
-    return 0;// shouldn't get here
-  return it->second.value_int;
+  return attributes().graph_idx;
 }
 
 double Edge::get_width() const
 {
   if (type != HUMAN_LANE)
     return -1.0;
-  auto it = params.find("width");
-  if (it == params.end() || it->second.type != Param::DOUBLE)
-    return -1.0;// shouldn't get here
-  return it->second.value_double;
+  return attributes().width;
+}
+
+double Edge::get_distance() const
+{
+  if (type != MEAS)
+    return -1.0;
+  return attributes().distance;
+}
+
+double Edge::get_speed_limit() const
+{
+  return attributes().speed_limit;
+}
+
+bool Edge::has_orientation() const
+{
+  return attributes().orientation != nullptr;
+}
+
+const std::string& Edge::get_orientation() const
+{
+  static const std::string none;
+  const std::string* orientation = attributes().orientation;
+  return orientation ? *orientation : none;
+}
+
+const std::string& Edge::get_door_type() const
+{
+  static const std::string none;
+  const std::string* door_type = attributes().door_type;
+  return door_type ? *door_type : none;
+}
+
+bool Edge::door_moves_about_start() const
+{
+  return attributes().door_moves_about_start;
+}
+
+int Edge::get_motion_direction() const
+{
+  return attributes().motion_direction;
+}
+
+double Edge::get_motion_degrees() const
+{
+  return attributes().motion_degrees;
+}
+
+double Edge::get_right_left_ratio() const
+{
+  return attributes().right_left_ratio;
+}
+
+void Edge::update_attributes() const
+{
+  // the keys are interned, so they can be told apart by address
+  static const std::string* const bidirectional_key =
+    &ParamMap::intern("bidirectional");
+  static const std::string* const graph_idx_key =
+    &ParamMap::intern("graph_idx");
+  static const std::string* const width_key = &ParamMap::intern("width");
+  static const std::string* const distance_key =
+    &ParamMap::intern("distance");
+  static const std::string* const speed_limit_key =
+    &ParamMap::intern("speed_limit");
+  static const std::string* const orientation_key =
+    &ParamMap::intern("orientation");
+  static const std::string* const type_key = &ParamMap::intern("type");
+  static const std::string* const motion_axis_key =
+    &ParamMap::intern("motion_axis");
+  static const std::string* const motion_direction_key =
+    &ParamMap::intern("motion_direction");
+  static const std::string* const motion_degrees_key =
+    &ParamMap::intern("motion_degrees");
+  static const std::string* const right_left_ratio_key =
+    &ParamMap::intern("right_left_ratio");
+
+  // the same checks of the param types as when these were looked up
+  Attributes attributes;
+  attributes.params_revision = params.revision();
+  for (const auto& param : params)
+  {
+    const std::string* key = &param.first;
+    const Param& value = param.second;
+    if (key == bidirectional_key && value.type == Param::BOOL)
+      attributes.bidirectional = value.value_bool;
+    else if (key == graph_idx_key && value.type == Param::INT)
+      attributes.graph_idx = value.value_int;
+    else if (key == width_key && value.type == Param::DOUBLE)
+      attributes.width = value.value_double;
+    else if (key == distance_key && value.type == Param::DOUBLE)
+      attributes.distance = value.value_double;
+    else if (key == speed_limit_key && value.type == Param::DOUBLE)
+      attributes.speed_limit = value.value_double;
+    else if (key == orientation_key)
+      attributes.orientation = &ParamMap::intern(value.value_string);
+    else if (key == type_key)
+      attributes.door_type = &ParamMap::intern(value.value_string);
+    else if (key == motion_axis_key)
+      attributes.door_moves_about_start = value.value_string == "start";
+    else if (key == motion_direction_key)
+      attributes.motion_direction = value.value_int;
+    else if (key == motion_degrees_key)
+      attributes.motion_degrees = value.value_double;
+    else if (key == right_left_ratio_key)
+      attributes.right_left_ratio = value.value_double;
+  }
+  _attributes = attributes;
 }
@@ -18,12 +18,14 @@
 #ifndef EDGE_H
 #define EDGE_H
 
+#include <cstdint>
 #include <string>
 #include <map>
 
 #include <yaml-cpp/yaml.h>
 
 #include "param.h"
+#include "param_schema.hpp"
 #include <QString>
 
 
@@ -46,24 +48,24 @@ public:
 
   Edge();
   Edge(const int _start_idx, const int _end_idx, const Type _type);
-  ~Edge();
 
-  std::map<std::string, Param> params;
+  ParamMap params;
 
   void from_yaml(const YAML::Node& data, const Type edge_type);
   YAML::Node to_yaml() const;
 
   void set_param(const std::string& name, const std::string& value);
 
+  /// The params which the editor itself reads are also kept in fixed
+  /// fields, derived from the map whenever it changes, so these typed
+  /// accessors are a revision check and a read. The map remains what is
+  /// edited and saved, along with any params the editor doesn't know.
   bool is_bidirectional() const;
 
   void create_required_parameters();
 
-  template<typename T>
-  void create_param_if_needed(
-    const std::string& name,
-    const Param::Type& param_type,
-    const T& param_value);
+  /// The params of edges of this type, nullptr if it has none
+  static const ParamSchema* param_schema(const Type type);
 
   std::string type_to_string() const;
   QString type_to_qstring() const;
@@ -71,6 +73,55 @@ public:
   int get_graph_idx() const;
 
   double get_width() const;
+
+  /// Real-world length of a measurement, in meters, or -1 if this isn't
+  /// a measurement or it has no distance
+  double get_distance() const;
+
+  /// Of a lane, in m/s; 0 if it has none
+  double get_speed_limit() const;
+
+  /// Whether a lane has an orientation constraint (even an empty one), and
+  /// what it is: "forward", "backward" or empty. Interned.
+  bool has_orientation() const;
+  const std::string& get_orientation() const;
+
+  /// Door params, with the defaults the door is drawn with when a param is
+  /// missing. The door type is interned (see ParamMap::intern) and empty
+  /// if it isn't set.
+  const std::string& get_door_type() const;
+  bool door_moves_about_start() const;  // its "motion_axis"
+  int get_motion_direction() const;
+  double get_motion_degrees() const;
+  double get_right_left_ratio() const;
+
+private:
+  struct Attributes
+  {
+    std::uint64_t params_revision = 0;  // that these were derived from
+    bool bidirectional = false;
+    int graph_idx = 0;
+    double width = -1.0;
+    double distance = -1.0;
+    double speed_limit = 0.0;
+    const std::string* orientation = nullptr;
+    const std::string* door_type = nullptr;
+    bool door_moves_about_start = true;
+    int motion_direction = 1;
+    double motion_degrees = 90.0;
+    double right_left_ratio = 1.0;
+  };
+  mutable Attributes _attributes;
+
+  /// Brought up to date by set_param() and from_yaml(), and lazily after
+  /// the params map was edited directly
+  const Attributes& attributes() const
+  {
+    if (_attributes.params_revision != params.revision())
+      update_attributes();
+    return _attributes;
+  }
+  void update_attributes() const;
 };
 
 #endif
@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include <algorithm>
+#include <cmath>
+
+#include <QPainter>
+#include <QPainterPathStroker>
+#include <QStyleOptionGraphicsItem>
+
+#include "edge_layer_item.hpp"
+#include "level_of_detail.hpp"
+
+namespace {
+
+/// Distance from p to the segment
+double segment_distance(const QPointF& p, const QLineF& line)
+{
+  const QPointF d = line.p2() - line.p1();
+  const double length_squared = d.x() * d.x() + d.y() * d.y();
+  double t = 0.0;
+  if (length_squared > 0.0)
+  {
+    const QPointF v = p - line.p1();
+    t = (v.x() * d.x() + v.y() * d.y()) / length_squared;
+    t = std::max(0.0, std::min(1.0, t));
+  }
+  const QPointF nearest = line.p1() + t * d;
+  return std::hypot(p.x() - nearest.x(), p.y() - nearest.y());
+}
+
+}  // namespace
+
+//=============================================================================
+EdgeLayerItem::EdgeLayerItem(
+  const Kind kind,
+  const double meters_per_pixel,
+  QGraphicsItem* parent)
+: QGraphicsItem(parent),
+  _kind(kind),
+  _cell_size(CELL_METERS / meters_per_pixel)
+{
+  setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+
+  // same pens as Level::draw_wall(), draw_meas() and draw_door()
+  double width = 0.2;
+  QColor color = QColor::fromRgbF(0.0, 0.0, 0.5, 0.5);
+  QColor selected_color = QColor::fromRgbF(0.5, 0.0, 0.0, 0.5);
+  if (_kind == MEASUREMENTS)
+  {
+    width = 0.5;
+    color = QColor::fromRgbF(0.5, 0.0, 0.5, 0.5);
+  }
+  else if (_kind == DOORS)
+  {
+    color = QColor::fromRgbF(1.0, 0.0, 0.0, 0.5);
+    selected_color = QColor::fromRgbF(1.0, 1.0, 0.0, 0.5);
+  }
+  _pen = QPen(
+    QBrush(color),
+    width / meters_per_pixel,
+    Qt::SolidLine,
+    Qt::RoundCap);
+  _selected_pen = _pen;
+  _selected_pen.setColor(selected_color);
+  _motion_pen = QPen(Qt::black, 0.05 / meters_per_pixel);
+}
+
+qint64 EdgeLayerItem::cell_key(const QPointF& p) const
+{
+  const qint64 x = static_cast<qint64>(std::floor(p.x() / _cell_size));
+  const qint64 y = static_cast<qint64>(std::floor(p.y() / _cell_size));
+  return static_cast<qint64>(
+    (static_cast<quint64>(x) << 32) ^ static_cast<quint32>(y));
+}
+
+void EdgeLayerItem::resize(const std::size_t size)
+{
+  for (std::size_t i = size; i < _entries.size(); i++)
+    take_out(i);
+  _entries.resize(size);
+}
+
+void EdgeLayerItem::mark_dirty(const qint64 key, Cell& cell)
+{
+  if (cell.dirty)
+    return;
+  cell.dirty = true;
+  _dirty_cells.push_back(key);
+}
+
+void EdgeLayerItem::take_out(const std::size_t idx)
+{
+  Entry& entry = _entries[idx];
+  if (!entry.present)
+    return;
+  entry.present = false;
+  const auto it = _cells.find(entry.cell);
+  if (it == _cells.end())
+    return;
+  std::vector<int>& edges = it->second.edges;
+  edges.erase(
+    std::remove(edges.begin(), edges.end(), static_cast<int>(idx)),
+    edges.end());
+  mark_dirty(it->first, it->second);
+}
+
+void EdgeLayerItem::set_edge(
+  const std::size_t idx,
+  const QLineF& line,
+  const bool selected,
+  const QPainterPath& motion)
+{
+  if (idx >= _entries.size())
+    _entries.resize(idx + 1);
+  take_out(idx);
+
+  Entry& entry = _entries[idx];
+  entry.line = line;
+  entry.motion = motion;
+  entry.selected = selected;
+  entry.present = true;
+  entry.cell = cell_key(line.center());
+  Cell& cell = _cells[entry.cell];
+  cell.edges.push_back(static_cast<int>(idx));
+  mark_dirty(entry.cell, cell);
+}
+
+void EdgeLayerItem::remove_edge(const std::size_t idx)
+{
+  if (idx < _entries.size())
+    take_out(idx);
+}
+
+void EdgeLayerItem::rebuild(Cell& cell) const
+{
+  cell.path = QPainterPath();
+  cell.selected_path = QPainterPath();
+  cell.motion_path = QPainterPath();
+  QRectF extent;
+  for (const int idx : cell.edges)
+  {
+    const Entry& entry = _entries[idx];
+    QPainterPath& path = entry.selected ? cell.selected_path : cell.path;
+    path.moveTo(entry.line.p1());
+    path.lineTo(entry.line.p2());
+    extent |= QRectF(entry.line.p1(), entry.line.p2()).normalized();
+    if (!entry.motion.isEmpty())
+    {
+      cell.motion_path.addPath(entry.motion);
+      extent |= entry.motion.boundingRect();
+    }
+  }
+  const double r = 0.5 * _pen.widthF();
+  cell.extent = extent.adjusted(-r, -r, r, r);
+  cell.dirty = false;
+}
+
+void EdgeLayerItem::flush()
+{
+  if (_dirty_cells.empty())
+    return;
+  for (const qint64 key : _dirty_cells)
+  {
+    const auto it = _cells.find(key);
+    if (it == _cells.end())
+      continue;
+    update(it->second.extent);
+    if (it->second.edges.empty())
+    {
+      _cells.erase(it);
+      continue;
+    }
+    rebuild(it->second);
+    update(it->second.extent);
+  }
+  _dirty_cells.clear();
+
+  QRectF bounds;
+  for (const auto& it : _cells)
+    bounds |= it.second.extent;
+  if (bounds != _bounds)
+  {
+    prepareGeometryChange();
+    _bounds = bounds;
+  }
+  _shape_valid = false;
+}
+
+QRectF EdgeLayerItem::boundingRect() const
+{
+  return _bounds;
+}
+
+QPainterPath EdgeLayerItem::shape() const
+{
+  if (!_shape_valid)
+  {
+    QPainterPath lines;
+    for (const auto& it : _cells)
+    {
+      lines.addPath(it.second.path);
+      lines.addPath(it.second.selected_path);
+    }
+    QPainterPathStroker stroker;
+    stroker.setWidth(_pen.widthF());
+    stroker.setCapStyle(Qt::RoundCap);
+    _shape = stroker.createStroke(lines);
+    _shape_valid = true;
+  }
+  return _shape;
+}
+
+bool EdgeLayerItem::contains(const QPointF& p) const
+{
+  const double r = 0.5 * _pen.widthF();
+  for (const auto& it : _cells)
+  {
+    if (!it.second.extent.contains(p))
+      continue;
+    for (const int idx : it.second.edges)
+    {
+      if (segment_distance(p, _entries[idx].line) <= r)
+        return true;
+    }
+  }
+  return false;
+}
+
+void EdgeLayerItem::paint(
+  QPainter* painter,
+  const QStyleOptionGraphicsItem* option,
+  QWidget*)
+{
+  painter->setBrush(Qt::NoBrush);
+
+  // the door leaves' motion is only drawn up close, as Level::draw_door()
+  // tags it, and below all of the door jambs
+  if (_kind == DOORS &&
+    LevelOfDetail::tier_for_scale(
+      QStyleOptionGraphicsItem::levelOfDetailFromTransform(
+        painter->worldTransform())) != LevelOfDetail::COARSE)
+  {
+    painter->setPen(_motion_pen);
+    for (const auto& it : _cells)
+    {
+      if (option->exposedRect.intersects(it.second.extent))
+        painter->drawPath(it.second.motion_path);
+    }
+  }
+
+  for (const auto& it : _cells)
+  {
+    const Cell& cell = it.second;
+    if (!option->exposedRect.intersects(cell.extent))
+      continue;
+    if (!cell.path.isEmpty())
+    {
+      painter->setPen(_pen);
+      painter->drawPath(cell.path);
+    }
+    if (!cell.selected_path.isEmpty())
+    {
+      painter->setPen(_selected_pen);
+      painter->drawPath(cell.selected_path);
+    }
+  }
+}
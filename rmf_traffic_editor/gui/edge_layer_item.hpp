@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef TRAFFIC_EDITOR__EDGE_LAYER_ITEM_HPP
+#define TRAFFIC_EDITOR__EDGE_LAYER_ITEM_HPP
+
+#include <unordered_map>
+#include <vector>
+
+#include <QGraphicsItem>
+#include <QLineF>
+#include <QPainterPath>
+#include <QPen>
+
+//=============================================================================
+/// Paints all the walls, measurements or doors of a level in a single item,
+/// instead of a line item (and for doors, a path item) per edge. The edges
+/// are bucketed into square cells of the level by their midpoints, and each
+/// cell keeps one path of its edges, so that painting only strokes the
+/// cells which are exposed, and editing an edge only rebuilds the paths of
+/// the cells it left and entered, in flush(). Like VertexLayerItem, it
+/// answers hit-tests itself, so clicks which miss every edge fall through;
+/// which edge was hit is for the level to find in its edge R-tree.
+class EdgeLayerItem : public QGraphicsItem
+{
+public:
+  enum { Type = UserType + 2 };
+
+  enum Kind
+  {
+    WALLS = 0,
+    MEASUREMENTS,
+    DOORS,
+    NUM_KINDS
+  };
+
+  static constexpr double CELL_METERS = 25.0;
+
+  EdgeLayerItem(
+    const Kind kind,
+    const double meters_per_pixel,
+    QGraphicsItem* parent = nullptr);
+
+  int type() const override { return Type; }
+  Kind kind() const { return _kind; }
+
+  /// Number of edges of the level, of any kind, as the item is indexed
+  /// like Level::edges
+  std::size_t size() const { return _entries.size(); }
+  void resize(const std::size_t size);
+
+  /// Add or move an edge, and with it the path of its door leaf's motion
+  void set_edge(
+    const std::size_t idx,
+    const QLineF& line,
+    const bool selected,
+    const QPainterPath& motion = QPainterPath());
+
+  /// Take an edge out, e.g. because it is now of another kind
+  void remove_edge(const std::size_t idx);
+
+  bool has_edge(const std::size_t idx) const
+  {
+    return idx < _entries.size() && _entries[idx].present;
+  }
+
+  /// Rebuild the paths of the cells changed by set_edge() and
+  /// remove_edge() since the last flush(), and repaint them
+  void flush();
+
+  std::size_t num_cells() const { return _cells.size(); }
+
+  QRectF boundingRect() const override;
+  QPainterPath shape() const override;
+  bool contains(const QPointF& p) const override;
+
+  void paint(
+    QPainter* painter,
+    const QStyleOptionGraphicsItem* option,
+    QWidget* widget = nullptr) override;
+
+private:
+  struct Entry
+  {
+    QLineF line;
+    QPainterPath motion;
+    bool selected = false;
+    bool present = false;
+    qint64 cell = 0;
+  };
+
+  struct Cell
+  {
+    std::vector<int> edges;
+    QPainterPath path;
+    QPainterPath selected_path;
+    QPainterPath motion_path;
+    QRectF extent;
+    bool dirty = false;
+  };
+
+  Kind _kind;
+  double _cell_size;
+  QPen _pen;
+  QPen _selected_pen;
+  QPen _motion_pen;
+
+  std::vector<Entry> _entries;
+  std::unordered_map<qint64, Cell> _cells;
+  std::vector<qint64> _dirty_cells;
+  QRectF _bounds;
+  mutable QPainterPath _shape;
+  mutable bool _shape_valid = false;
+
+  qint64 cell_key(const QPointF& p) const;
+  void take_out(const std::size_t idx);
+  void mark_dirty(const qint64 key, Cell& cell);
+  void rebuild(Cell& cell) const;
+};
+
+#endif
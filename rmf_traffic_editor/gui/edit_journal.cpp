@@ -0,0 +1,519 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <map>
+
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QtEndian>
+
+#include "building.h"
+#include "building_cache.hpp"
+#include "building_snapshot.hpp"
+#include "content_hash.hpp"
+#include "edit_journal.hpp"
+#include "edit_sync.hpp"
+#include "logging.hpp"
+
+namespace {
+
+constexpr std::uint32_t COMPRESSED = 0x80000000u;
+constexpr int MIN_COMPRESSED_SIZE = 512;
+constexpr int UUID_SIZE = 16;
+
+// the first version kept its records as JSON
+constexpr std::uint32_t JSON_VERSION = 1;
+
+void put_u32(QByteArray& buffer, const std::uint32_t value)
+{
+  const std::uint32_t le = qToLittleEndian(value);
+  buffer.append(reinterpret_cast<const char*>(&le), sizeof(le));
+}
+
+void put_u64(QByteArray& buffer, const std::uint64_t value)
+{
+  const std::uint64_t le = qToLittleEndian(value);
+  buffer.append(reinterpret_cast<const char*>(&le), sizeof(le));
+}
+
+void put_bytes(QByteArray& buffer, const QByteArray& bytes)
+{
+  put_u32(buffer, static_cast<std::uint32_t>(bytes.size()));
+  buffer.append(bytes);
+}
+
+/// u8 kind | u8 change | uuid | i32 type | i32 before type | u32 count |
+/// uuids of the before key | u64 before hash | u32 size | yaml, in the
+/// encoding of BuildingCache
+void put_entity(QByteArray& buffer, const EditSync::Entity& entity)
+{
+  buffer.append(static_cast<char>(entity.kind));
+  buffer.append(static_cast<char>(entity.change));
+  buffer.append(entity.uuid.toRfc4122());
+  put_u32(buffer, static_cast<std::uint32_t>(entity.type));
+  put_u32(buffer, static_cast<std::uint32_t>(entity.before_type));
+  put_u32(buffer, static_cast<std::uint32_t>(entity.before_key.size()));
+  for (const QUuid& id : entity.before_key)
+    buffer.append(id.toRfc4122());
+  put_u64(buffer, entity.before_hash);
+  put_bytes(
+    buffer,
+    entity.change == EditSync::Entity::REMOVED ?
+    QByteArray() : BuildingCache::encode(entity.yaml));
+}
+
+std::uint64_t checksum(const QByteArray& payload)
+{
+  return ContentHash::Builder().add(
+    std::string(payload.constData(), payload.size())).value();
+}
+
+/// The changes between the snapshots which the records can't hold
+int num_unrecorded(
+  const BuildingSnapshot& before,
+  const BuildingSnapshot& after)
+{
+  int count = 0;
+  if (before.levels.size() != after.levels.size())
+    count++;
+  for (const std::shared_ptr<const Level>& level : after.levels)
+  {
+    const Level* before_level = before.find_level(level->name);
+    if (!before_level)
+    {
+      count++;
+      continue;
+    }
+    if (before_level == level.get())
+      continue;
+    const ContentHash::LevelHashes& a = before_level->content_hashes();
+    const ContentHash::LevelHashes& b = level->content_hashes();
+    for (const ContentHash::Section section :
+      {ContentHash::CONSTRAINTS, ContentHash::LAYERS})
+    {
+      if (a.sections[section] != b.sections[section])
+        count++;
+    }
+  }
+
+  if (before.lifts.size() != after.lifts.size())
+    count++;
+  else
+  {
+    for (std::size_t i = 0; i < after.lifts.size(); i++)
+    {
+      if (ContentHash::of(before.lifts[i].to_yaml()) !=
+        ContentHash::of(after.lifts[i].to_yaml()))
+        count++;
+    }
+  }
+  return count;
+}
+
+/// Reads a field at offset, false if it isn't all there
+bool read_u8(const QByteArray& data, qint64& offset, std::uint8_t& value)
+{
+  if (data.size() - offset < 1)
+    return false;
+  value = static_cast<std::uint8_t>(*(data.constData() + offset));
+  offset++;
+  return true;
+}
+
+bool read_u32(const QByteArray& data, qint64& offset, std::uint32_t& value)
+{
+  if (data.size() - offset < static_cast<qint64>(sizeof(value)))
+    return false;
+  value = qFromLittleEndian<std::uint32_t>(data.constData() + offset);
+  offset += sizeof(value);
+  return true;
+}
+
+bool read_u64(const QByteArray& data, qint64& offset, std::uint64_t& value)
+{
+  if (data.size() - offset < static_cast<qint64>(sizeof(value)))
+    return false;
+  value = qFromLittleEndian<std::uint64_t>(data.constData() + offset);
+  offset += sizeof(value);
+  return true;
+}
+
+bool read_fixed(
+  const QByteArray& data,
+  qint64& offset,
+  const qint64 size,
+  QByteArray& bytes)
+{
+  if (data.size() - offset < size)
+    return false;
+  bytes = data.mid(static_cast<int>(offset), static_cast<int>(size));
+  offset += size;
+  return true;
+}
+
+bool read_bytes(const QByteArray& data, qint64& offset, QByteArray& bytes)
+{
+  std::uint32_t size = 0;
+  return read_u32(data, offset, size) &&
+    read_fixed(data, offset, size, bytes);
+}
+
+bool read_uuid(const QByteArray& data, qint64& offset, QUuid& id)
+{
+  QByteArray bytes;
+  if (!read_fixed(data, offset, UUID_SIZE, bytes))
+    return false;
+  id = QUuid::fromRfc4122(bytes);
+  return true;
+}
+
+bool read_entity(
+  const QByteArray& data,
+  qint64& offset,
+  EditSync::Entity& entity)
+{
+  std::uint8_t kind = 0;
+  std::uint8_t change = 0;
+  std::uint32_t type = 0;
+  std::uint32_t before_type = 0;
+  std::uint32_t key_size = 0;
+  if (!read_u8(data, offset, kind) || kind >= BuildingDiff::NUM_KINDS ||
+    !read_u8(data, offset, change) || change > EditSync::Entity::MODIFIED ||
+    !read_uuid(data, offset, entity.uuid) ||
+    !read_u32(data, offset, type) ||
+    !read_u32(data, offset, before_type) ||
+    !read_u32(data, offset, key_size) ||
+    data.size() - offset < static_cast<qint64>(key_size) * UUID_SIZE)
+    return false;
+  entity.kind = static_cast<BuildingDiff::Kind>(kind);
+  entity.change = static_cast<EditSync::Entity::Change>(change);
+  entity.type = static_cast<int>(type);
+  entity.before_type = static_cast<int>(before_type);
+  entity.before_key.resize(key_size);
+  for (QUuid& id : entity.before_key)
+    read_uuid(data, offset, id);
+
+  QByteArray yaml;
+  if (!read_u64(data, offset, entity.before_hash) ||
+    !read_bytes(data, offset, yaml))
+    return false;
+  return entity.change == EditSync::Entity::REMOVED ||
+    BuildingCache::decode(yaml, entity.yaml);
+}
+
+/// A record, as {"levels": [...as EditSync::operations()], "unrecorded"}
+bool read_record(const QByteArray& payload, QJsonObject& record)
+{
+  qint64 offset = 0;
+  std::uint32_t unrecorded = 0;
+  std::uint32_t num_levels = 0;
+  if (!read_u32(payload, offset, unrecorded) ||
+    !read_u32(payload, offset, num_levels))
+    return false;
+
+  QJsonArray levels;
+  for (std::uint32_t i = 0; i < num_levels; i++)
+  {
+    QByteArray name;
+    std::uint32_t num_entities = 0;
+    if (!read_bytes(payload, offset, name) ||
+      !read_u32(payload, offset, num_entities))
+      return false;
+    QJsonArray entities;
+    for (std::uint32_t j = 0; j < num_entities; j++)
+    {
+      EditSync::Entity entity;
+      if (!read_entity(payload, offset, entity))
+        return false;
+      entities.append(EditSync::to_json(entity));
+    }
+    QJsonObject o;
+    o["level"] = QString::fromUtf8(name);
+    o["entities"] = entities;
+    levels.append(o);
+  }
+  if (offset != payload.size())
+    return false;
+
+  record["levels"] = levels;
+  record["unrecorded"] = static_cast<int>(unrecorded);
+  return true;
+}
+
+}  // namespace
+
+//=============================================================================
+EditJournal::~EditJournal()
+{
+  close();
+}
+
+QString EditJournal::filename(const std::string& building_filename)
+{
+  return QString::fromStdString(building_filename) + ".journal";
+}
+
+bool EditJournal::start(
+  Building& building,
+  const std::shared_ptr<const BuildingSnapshot>& snapshot)
+{
+  close();
+  if (building.get_filename().empty() || !snapshot)
+    return false;
+
+  // what was reported before now is in the snapshot already
+  for (Level& level : building.levels)
+    level.take_journal_changes();
+
+  _file.setFileName(filename(building.get_filename()));
+  if (!_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+  {
+    qCWarning(lc_io, "couldn't write the edit journal %s",
+      qUtf8Printable(_file.fileName()));
+    return false;
+  }
+
+  QByteArray header;
+  put_u32(header, MAGIC);
+  put_u32(header, VERSION);
+  put_u64(header, building.content_hash());
+  const QByteArray uuids = qCompress(
+    QJsonDocument(EditSync::uuids(building)).toJson(QJsonDocument::Compact));
+  put_u32(header, static_cast<std::uint32_t>(uuids.size()));
+  header.append(uuids);
+  if (_file.write(header) != header.size() || !_file.flush())
+  {
+    qCWarning(lc_io, "couldn't write the edit journal %s",
+      qUtf8Printable(_file.fileName()));
+    close();
+    return false;
+  }
+
+  _base = snapshot;
+  _num_records = 0;
+  return true;
+}
+
+bool EditJournal::resume(
+  Building& building,
+  const Contents& contents,
+  const std::shared_ptr<const BuildingSnapshot>& snapshot)
+{
+  close();
+  if (building.get_filename().empty() || !snapshot)
+    return false;
+
+  _file.setFileName(filename(building.get_filename()));
+  if (!_file.open(QIODevice::ReadWrite) ||
+    !_file.resize(contents.valid_size) ||
+    !_file.seek(contents.valid_size))
+  {
+    _file.close();
+    return start(building, snapshot);
+  }
+
+  for (Level& level : building.levels)
+    level.take_journal_changes();
+  _base = snapshot;
+  _num_records = static_cast<int>(contents.records.size());
+  return true;
+}
+
+void EditJournal::close()
+{
+  _base.reset();
+  _num_records = 0;
+  if (_file.isOpen())
+  {
+    _file.close();
+    _file.remove();
+  }
+}
+
+void EditJournal::record(
+  Building& building,
+  const std::shared_ptr<const BuildingSnapshot>& snapshot)
+{
+  // taken even if nothing is recorded, so that the next record has only
+  // what was reported after this one
+  std::map<std::string, Level::ChangeSet> reported;
+  for (Level& level : building.levels)
+    reported[level.name] = level.take_journal_changes();
+
+  if (!is_open() || !snapshot || snapshot == _base)
+    return;
+
+  QByteArray levels;
+  std::uint32_t num_levels = 0;
+  for (const std::shared_ptr<const Level>& level : snapshot->levels)
+  {
+    const Level* before = _base->find_level(level->name);
+    if (!before || before == level.get())
+      continue;
+
+    // the level is only diffed if the edits didn't say what they changed
+    std::vector<EditSync::Entity> entities;
+    const auto it = reported.find(level->name);
+    if (it == reported.end() ||
+      !EditSync::reported_entities(*before, *level, it->second, entities))
+      entities = EditSync::changed_entities(*before, *level);
+    if (entities.empty())
+      continue;
+
+    put_bytes(levels, QByteArray::fromStdString(level->name));
+    put_u32(levels, static_cast<std::uint32_t>(entities.size()));
+    for (const EditSync::Entity& entity : entities)
+      put_entity(levels, entity);
+    num_levels++;
+  }
+  const int unrecorded = num_unrecorded(*_base, *snapshot);
+  _base = snapshot;
+  if (num_levels == 0 && unrecorded == 0)
+    return;
+
+  QByteArray payload;
+  put_u32(payload, static_cast<std::uint32_t>(unrecorded));
+  put_u32(payload, num_levels);
+  payload.append(levels);
+  if (!append(payload))
+  {
+    qCWarning(lc_io, "couldn't append to the edit journal %s, stopping it",
+      qUtf8Printable(_file.fileName()));
+    _file.close();
+    _base.reset();
+  }
+}
+
+bool EditJournal::append(const QByteArray& encoded)
+{
+  const bool compress = encoded.size() > MIN_COMPRESSED_SIZE;
+  const QByteArray payload = compress ? qCompress(encoded) : encoded;
+  std::uint32_t size = static_cast<std::uint32_t>(payload.size());
+  if (compress)
+    size |= COMPRESSED;
+
+  QByteArray record;
+  put_u32(record, size);
+  put_u64(record, checksum(payload));
+  record.append(payload);
+
+  // one write, so that a crash tears at most this record
+  if (_file.write(record) != record.size() || !_file.flush())
+    return false;
+  _num_records++;
+  return true;
+}
+
+bool EditJournal::read(const QString& journal_filename, Contents& contents)
+{
+  contents = Contents();
+  QFile file(journal_filename);
+  if (!file.open(QIODevice::ReadOnly))
+    return false;
+  const QByteArray data = file.readAll();
+
+  qint64 offset = 0;
+  std::uint32_t magic = 0;
+  std::uint32_t version = 0;
+  std::uint32_t uuids_size = 0;
+  if (!read_u32(data, offset, magic) || magic != MAGIC ||
+    !read_u32(data, offset, version) ||
+    (version != VERSION && version != JSON_VERSION) ||
+    !read_u64(data, offset, contents.base_hash) ||
+    !read_u32(data, offset, uuids_size) ||
+    data.size() - offset < uuids_size)
+    return false;
+
+  contents.uuids = QJsonDocument::fromJson(
+    qUncompress(data.mid(static_cast<int>(offset), uuids_size))).object();
+  offset += uuids_size;
+  contents.valid_size = offset;
+
+  while (offset < data.size())
+  {
+    std::uint32_t size = 0;
+    std::uint64_t sum = 0;
+    if (!read_u32(data, offset, size) || !read_u64(data, offset, sum))
+      break;
+    const bool compressed = (size & COMPRESSED) != 0;
+    size &= ~COMPRESSED;
+    if (data.size() - offset < size)
+      break;
+    const QByteArray payload = data.mid(static_cast<int>(offset), size);
+    if (checksum(payload) != sum)
+      break;
+
+    const QByteArray encoded = compressed ? qUncompress(payload) : payload;
+    QJsonObject record;
+    if (version == JSON_VERSION)
+    {
+      QJsonParseError error;
+      const QJsonDocument doc = QJsonDocument::fromJson(encoded, &error);
+      if (error.error != QJsonParseError::NoError || !doc.isObject())
+        break;
+      record = doc.object();
+    }
+    else if (!read_record(encoded, record))
+      break;
+
+    offset += size;
+    contents.valid_size = offset;
+    contents.records.push_back(record);
+    contents.num_unrecorded += record["unrecorded"].toInt();
+  }
+
+  if (contents.valid_size < data.size())
+  {
+    qCInfo(lc_io, "edit journal %s: dropped a torn record of %lld bytes",
+      qUtf8Printable(journal_filename),
+      static_cast<long long>(data.size() - contents.valid_size));
+  }
+  return true;
+}
+
+int EditJournal::replay(const Contents& contents, Building& building)
+{
+  if (building.content_hash() != contents.base_hash ||
+    !EditSync::adopt_uuids(building, contents.uuids))
+    return -1;
+
+  int num_conflicts = 0;
+  for (const QJsonObject& record : contents.records)
+  {
+    for (const QJsonValue& value : record["levels"].toArray())
+    {
+      const QJsonObject& o = value.toObject();
+      const QJsonArray entities = o["entities"].toArray();
+      const std::string level_name = o["level"].toString().toStdString();
+      Level* level = nullptr;
+      for (Level& l : building.levels)
+      {
+        if (l.name == level_name)
+          level = &l;
+      }
+      if (!level)
+      {
+        num_conflicts += entities.size();
+        continue;
+      }
+      num_conflicts +=
+        EditSync::apply(*level, entities, false).num_conflicts;
+    }
+  }
+  return num_conflicts;
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__EDIT_JOURNAL_HPP
+#define TRAFFIC_EDITOR__EDIT_JOURNAL_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <QByteArray>
+#include <QFile>
+#include <QJsonObject>
+#include <QString>
+
+class Building;
+class BuildingSnapshot;
+
+//=============================================================================
+/// A write-ahead log of the edits made to a building since it was last
+/// loaded or saved, beside it, so that they survive a crash of the editor
+/// without the building having to be saved in full.
+///
+/// Every command, undo and redo appends the changes it made, as the
+/// entities of EditSync operations, and flushes them to the operating
+/// system. They are the entities which it reported touching through
+/// Level::mark_changed() and the like (see Level::take_journal_changes()),
+/// so a record costs about as much as the edit is large, rather than as
+/// large as the level; only the levels of an edit which reported nothing,
+/// the whole level or a removal are diffed, between the snapshots of
+/// before and after it. The file is a header, with the content hash of the
+/// building it starts from and the uuids of its entities (which the
+/// records refer to them by), and then the records, each as
+///
+///   u32 size (the top bit set if compressed) | u64 checksum | payload
+///
+/// where the payload is
+///
+///   u32 unrecorded | u32 count | levels, each as
+///     u32 size | name | u32 count | entities (see EditSync::Entity)
+///
+/// compressed only if it is big. Changes to layers, lifts, constraints
+/// and the levels themselves aren't recorded, only counted. A record cut
+/// short by the crash is dropped. The journal is started afresh by every
+/// save, and removed when the building is closed.
+class EditJournal
+{
+public:
+  static constexpr std::uint32_t MAGIC = 0x4c4e4a45;  // "EJNL"
+  static constexpr std::uint32_t VERSION = 2;
+
+  /// What a journal holds, as read back
+  struct Contents
+  {
+    std::uint64_t base_hash = 0;
+    QJsonObject uuids;  // as EditSync::uuids()
+    /// {"levels": [...as EditSync::operations()], "unrecorded": n}
+    std::vector<QJsonObject> records;
+    qint64 valid_size = 0;  // up to the end of the last whole record
+    int num_unrecorded = 0;
+  };
+
+  ~EditJournal();
+
+  /// The journal beside this building file
+  static QString filename(const std::string& building_filename);
+
+  /// Start an empty journal of the building as it is now, just loaded or
+  /// saved, whose snapshot this is. False if the building has no file.
+  bool start(
+    Building& building,
+    const std::shared_ptr<const BuildingSnapshot>& snapshot);
+
+  /// Go on with a journal that was replayed onto the building
+  bool resume(
+    Building& building,
+    const Contents& contents,
+    const std::shared_ptr<const BuildingSnapshot>& snapshot);
+
+  /// Stop, and remove the file
+  void close();
+
+  bool is_open() const { return _file.isOpen(); }
+
+  /// Append what changed since the previous snapshot recorded, taking
+  /// the journal changes of the levels of the building whose snapshot
+  /// this is
+  void record(
+    Building& building,
+    const std::shared_ptr<const BuildingSnapshot>& snapshot);
+
+  int num_records() const { return _num_records; }
+
+  /// Read the journal of a crashed editor. False if there is none, or it
+  /// isn't one.
+  static bool read(const QString& filename, Contents& contents);
+
+  /// Apply the records to the building, as loaded from the file they
+  /// start from. Returns the number of entities which couldn't be, or -1
+  /// if the journal isn't of this building.
+  static int replay(const Contents& contents, Building& building);
+
+private:
+  QFile _file;
+  std::shared_ptr<const BuildingSnapshot> _base;  // what was last recorded
+  int _num_records = 0;
+
+  bool append(const QByteArray& encoded);
+};
+
+#endif
@@ -0,0 +1,1240 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <set>
+
+#include <QJsonDocument>
+#include <QHostAddress>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <yaml-cpp/yaml.h>
+
+#include "building.h"
+#include "building_diff.hpp"
+#include "building_snapshot.hpp"
+#include "content_hash.hpp"
+#include "edit_sync.hpp"
+#include "logging.hpp"
+
+using std::vector;
+typedef BuildingDiff::Kind Kind;
+
+namespace {
+
+/// The kinds of entity which are shared
+const Kind KINDS[] = {
+  BuildingDiff::VERTEX,
+  BuildingDiff::EDGE,
+  BuildingDiff::POLYGON,
+  BuildingDiff::MODEL,
+  BuildingDiff::FIDUCIAL,
+  BuildingDiff::FEATURE,
+  BuildingDiff::TAG
+};
+
+bool is_shared(const Kind kind)
+{
+  return std::find(std::begin(KINDS), std::end(KINDS), kind) !=
+    std::end(KINDS);
+}
+
+bool parse_kind(const QString& name, Kind& kind)
+{
+  for (const Kind k : KINDS)
+  {
+    if (name == BuildingDiff::kind_name(k))
+    {
+      kind = k;
+      return true;
+    }
+  }
+  return false;
+}
+
+/// Edges and polygons are addressed by the vertices they join
+bool has_uuid(const Kind kind)
+{
+  return kind != BuildingDiff::EDGE && kind != BuildingDiff::POLYGON;
+}
+
+QString uuid_text(const QUuid& id)
+{
+  return id.toString(QUuid::WithoutBraces);
+}
+
+QString yaml_text(const YAML::Node& node)
+{
+  YAML::Emitter emitter;
+  emitter.SetMapFormat(YAML::Flow);
+  emitter.SetSeqFormat(YAML::Flow);
+  emitter << node;
+  return QString::fromUtf8(emitter.c_str(), static_cast<int>(emitter.size()));
+}
+
+int count_of(const Level& level, const Kind kind)
+{
+  switch (kind)
+  {
+    case BuildingDiff::VERTEX: return static_cast<int>(level.vertices.size());
+    case BuildingDiff::EDGE: return static_cast<int>(level.edges.size());
+    case BuildingDiff::POLYGON: return static_cast<int>(level.polygons.size());
+    case BuildingDiff::MODEL: return static_cast<int>(level.models.size());
+    case BuildingDiff::FIDUCIAL:
+      return static_cast<int>(level.fiducials.size());
+    case BuildingDiff::FEATURE:
+      return static_cast<int>(level.floorplan_features.size());
+    case BuildingDiff::TAG: return static_cast<int>(level.tags.size());
+    default: return 0;
+  }
+}
+
+QUuid uuid_of(const Level& level, const Kind kind, const int idx)
+{
+  switch (kind)
+  {
+    case BuildingDiff::VERTEX: return level.vertices[idx].uuid;
+    case BuildingDiff::MODEL: return level.models[idx].uuid;
+    case BuildingDiff::FIDUCIAL: return level.fiducials[idx].uuid;
+    case BuildingDiff::FEATURE: return level.floorplan_features[idx].id();
+    case BuildingDiff::TAG: return level.tags[idx].uuid;
+    default: return QUuid();
+  }
+}
+
+int type_of(const Level& level, const Kind kind, const int idx)
+{
+  if (kind == BuildingDiff::EDGE)
+    return static_cast<int>(level.edges[idx].type);
+  if (kind == BuildingDiff::POLYGON)
+    return static_cast<int>(level.polygons[idx].type);
+  return 0;
+}
+
+/// The uuids of the vertices an edge or polygon joins; empty if one of
+/// them is missing
+vector<QUuid> key_of(const Level& level, const Kind kind, const int idx)
+{
+  vector<int> vertex_indices;
+  if (kind == BuildingDiff::EDGE)
+    vertex_indices = {level.edges[idx].start_idx, level.edges[idx].end_idx};
+  else if (kind == BuildingDiff::POLYGON)
+    vertex_indices = level.polygons[idx].vertices;
+
+  vector<QUuid> key;
+  for (const int vertex_idx : vertex_indices)
+  {
+    if (vertex_idx < 0 ||
+      vertex_idx >= static_cast<int>(level.vertices.size()))
+      return vector<QUuid>();
+    key.push_back(level.vertices[vertex_idx].uuid);
+  }
+  return key;
+}
+
+QJsonArray key_json(const vector<QUuid>& key)
+{
+  QJsonArray json;
+  for (const QUuid& id : key)
+    json.append(uuid_text(id));
+  return json;
+}
+
+vector<QUuid> key_from_json(const QJsonArray& json)
+{
+  vector<QUuid> key;
+  for (const QJsonValue& value : json)
+    key.push_back(QUuid(value.toString()));
+  return key;
+}
+
+/// The vertices of the yaml of an edge or polygon, which refers to them by
+/// uuid, as a key
+vector<QUuid> key_from_yaml(const Kind kind, const YAML::Node& node)
+{
+  vector<QUuid> key;
+  if (kind == BuildingDiff::EDGE && node.IsSequence() && node.size() >= 2)
+  {
+    for (int i = 0; i < 2; i++)
+      key.push_back(QUuid(QString::fromStdString(node[i].as<std::string>())));
+  }
+  else if (kind == BuildingDiff::POLYGON && node.IsMap() && node["vertices"])
+  {
+    for (const YAML::Node& vertex : node["vertices"])
+      key.push_back(QUuid(QString::fromStdString(vertex.as<std::string>())));
+  }
+  return key;
+}
+
+/// Like ContentHash::of() the entity, but with the vertices of edges and
+/// polygons by uuid, as their indices differ between editors
+std::uint64_t entity_hash(const Level& level, const Kind kind, const int idx)
+{
+  switch (kind)
+  {
+    case BuildingDiff::VERTEX: return ContentHash::of(level.vertices[idx]);
+    case BuildingDiff::MODEL: return ContentHash::of(level.models[idx]);
+    case BuildingDiff::FIDUCIAL: return ContentHash::of(level.fiducials[idx]);
+    case BuildingDiff::FEATURE:
+      return ContentHash::of(level.floorplan_features[idx]);
+    case BuildingDiff::TAG: return ContentHash::of(level.tags[idx]);
+    case BuildingDiff::EDGE:
+    case BuildingDiff::POLYGON:
+    {
+      ContentHash::Builder builder;
+      builder.add(type_of(level, kind, idx));
+      for (const QUuid& id : key_of(level, kind, idx))
+        builder.add(id);
+      builder.add(
+        kind == BuildingDiff::EDGE ?
+        level.edges[idx].params : level.polygons[idx].params);
+      return builder.value();
+    }
+    default:
+      return 0;
+  }
+}
+
+/// The saved form of the entity, with the vertices of edges and polygons
+/// by uuid
+YAML::Node entity_yaml(const Level& level, const Kind kind, const int idx)
+{
+  switch (kind)
+  {
+    case BuildingDiff::VERTEX: return level.vertices[idx].to_yaml();
+    case BuildingDiff::MODEL: return level.models[idx].to_yaml();
+    case BuildingDiff::FIDUCIAL: return level.fiducials[idx].to_yaml();
+    case BuildingDiff::FEATURE: return level.floorplan_features[idx].to_yaml();
+    case BuildingDiff::TAG: return level.tags[idx].to_yaml();
+    case BuildingDiff::EDGE:
+    {
+      YAML::Node node = level.edges[idx].to_yaml();
+      const vector<QUuid> key = key_of(level, kind, idx);
+      for (std::size_t i = 0; i < key.size(); i++)
+        node[i] = uuid_text(key[i]).toStdString();
+      return node;
+    }
+    case BuildingDiff::POLYGON:
+    {
+      YAML::Node node = level.polygons[idx].to_yaml();
+      YAML::Node vertices(YAML::NodeType::Sequence);
+      for (const QUuid& id : key_of(level, kind, idx))
+        vertices.push_back(uuid_text(id).toStdString());
+      node["vertices"] = vertices;
+      return node;
+    }
+    default:
+      return YAML::Node();
+  }
+}
+
+/// Index of the entity, or -1 if the level doesn't have it
+int find(
+  const Level& level,
+  const Kind kind,
+  const QUuid& id,
+  const int type,
+  const vector<QUuid>& key)
+{
+  switch (kind)
+  {
+    case BuildingDiff::VERTEX: return level.find_vertex_index(id);
+    case BuildingDiff::MODEL: return level.find_model_index(id);
+    case BuildingDiff::FIDUCIAL: return level.find_fiducial_index(id);
+    case BuildingDiff::TAG: return level.find_tag_index(id);
+    case BuildingDiff::FEATURE:
+      for (std::size_t i = 0; i < level.floorplan_features.size(); i++)
+      {
+        if (level.floorplan_features[i].id() == id)
+          return static_cast<int>(i);
+      }
+      return -1;
+    case BuildingDiff::EDGE:
+    case BuildingDiff::POLYGON:
+      if (key.empty())
+        return -1;
+      for (int i = 0; i < count_of(level, kind); i++)
+      {
+        if (type_of(level, kind, i) == type && key_of(level, kind, i) == key)
+          return i;
+      }
+      return -1;
+    default:
+      return -1;
+  }
+}
+
+/// The yaml of an edge or polygon, with its vertices by index again.
+/// False if one of them isn't on the level.
+bool resolve_vertices(const Level& level, const Kind kind, YAML::Node& node)
+{
+  const vector<QUuid> key = key_from_yaml(kind, node);
+  vector<int> indices;
+  for (const QUuid& id : key)
+  {
+    const int vertex_idx = level.find_vertex_index(id);
+    if (vertex_idx < 0)
+      return false;
+    indices.push_back(vertex_idx);
+  }
+  if (kind == BuildingDiff::EDGE)
+  {
+    if (indices.size() != 2)
+      return false;
+    node[0] = indices[0];
+    node[1] = indices[1];
+  }
+  else
+  {
+    YAML::Node vertices(YAML::NodeType::Sequence);
+    for (const int vertex_idx : indices)
+      vertices.push_back(vertex_idx);
+    node["vertices"] = vertices;
+  }
+  return true;
+}
+
+template<typename T>
+void keep_selection(const T& from, T& to)
+{
+  to.selected = from.selected;
+}
+
+void keep_selection(const Feature& from, Feature& to)
+{
+  to.setSelected(from.selected());
+}
+
+/// Put the entity in place of the one at target, or at the end if that is
+/// -1; returns its index
+template<typename T>
+int put(vector<T>& items, const int target, T item)
+{
+  if (target < 0)
+  {
+    items.push_back(item);
+    return static_cast<int>(items.size()) - 1;
+  }
+  keep_selection(items[target], item);
+  items[target] = item;
+  return target;
+}
+
+/// Build the entity from the yaml and put it on the level
+int put_entity(
+  Level& level,
+  const Kind kind,
+  const int target,
+  const QUuid& id,
+  const int type,
+  const YAML::Node& node)
+{
+  switch (kind)
+  {
+    case BuildingDiff::VERTEX:
+    {
+      Vertex vertex;
+      vertex.from_yaml(node);
+      vertex.uuid = id;
+      return put(level.vertices, target, vertex);
+    }
+    case BuildingDiff::EDGE:
+    {
+      Edge edge;
+      edge.from_yaml(node, static_cast<Edge::Type>(type));
+      return put(level.edges, target, edge);
+    }
+    case BuildingDiff::POLYGON:
+    {
+      Polygon polygon;
+      polygon.from_yaml(node, static_cast<Polygon::Type>(type));
+      return put(level.polygons, target, polygon);
+    }
+    case BuildingDiff::MODEL:
+    {
+      Model model;
+      model.from_yaml(node, level.name);
+      model.uuid = id;
+      return put(level.models, target, model);
+    }
+    case BuildingDiff::FIDUCIAL:
+    {
+      Fiducial fiducial;
+      fiducial.from_yaml(node);
+      fiducial.uuid = id;
+      return put(level.fiducials, target, fiducial);
+    }
+    case BuildingDiff::FEATURE:
+    {
+      Feature feature;
+      feature.from_yaml(node);  // which has its id
+      return put(level.floorplan_features, target, feature);
+    }
+    case BuildingDiff::TAG:
+    {
+      Tag tag;
+      tag.from_yaml(node);
+      tag.uuid = id;
+      return put(level.tags, target, tag);
+    }
+    default:
+      return -1;
+  }
+}
+
+void mark_changed(Level& level, const Kind kind, const int idx)
+{
+  switch (kind)
+  {
+    case BuildingDiff::VERTEX: level.mark_changed(Level::VERTEX, idx); break;
+    case BuildingDiff::EDGE: level.mark_changed(Level::EDGE, idx); break;
+    case BuildingDiff::POLYGON: level.mark_changed(Level::POLYGON, idx); break;
+    case BuildingDiff::MODEL: level.mark_changed(Level::MODEL, idx); break;
+    case BuildingDiff::FIDUCIAL:
+      level.mark_changed(Level::FIDUCIAL, idx);
+      break;
+    case BuildingDiff::TAG: level.mark_changed(Level::TAG, idx); break;
+    default: level.mark_all_changed(); break;  // features are in layers
+  }
+}
+
+template<typename T>
+void erase_indices(vector<T>& items, const vector<int>& descending)
+{
+  for (const int idx : descending)
+    items.erase(items.begin() + idx);
+}
+
+/// Remove vertices (by descending index), with the edges joining them,
+/// renumbering the vertices of the other edges and polygons
+void erase_vertices(Level& level, const vector<int>& descending)
+{
+  if (descending.empty())
+    return;
+  vector<int> renumbered(level.vertices.size());
+  for (std::size_t i = 0, removed = descending.size(); i < renumbered.size();
+    i++)
+  {
+    // the first "removed" of descending are those at or after i
+    while (removed > 0 && descending[removed - 1] < static_cast<int>(i))
+      removed--;
+    if (removed > 0 && descending[removed - 1] == static_cast<int>(i))
+      renumbered[i] = -1;
+    else
+      renumbered[i] = static_cast<int>(i) -
+        static_cast<int>(descending.size() - removed);
+  }
+  erase_indices(level.vertices, descending);
+
+  auto renumber = [&renumbered](const int vertex_idx)
+    {
+      if (vertex_idx < 0 ||
+        vertex_idx >= static_cast<int>(renumbered.size()))
+        return -1;
+      return renumbered[vertex_idx];
+    };
+  vector<Edge> edges;
+  for (Edge& edge : level.edges)
+  {
+    edge.start_idx = renumber(edge.start_idx);
+    edge.end_idx = renumber(edge.end_idx);
+    if (edge.start_idx >= 0 && edge.end_idx >= 0)
+      edges.push_back(edge);
+  }
+  level.edges.swap(edges);
+  for (Polygon& polygon : level.polygons)
+  {
+    vector<int> vertices;
+    for (const int vertex_idx : polygon.vertices)
+    {
+      if (renumber(vertex_idx) >= 0)
+        vertices.push_back(renumber(vertex_idx));
+    }
+    polygon.vertices.swap(vertices);
+  }
+}
+
+/// How the entity at before_idx of before (or -1 if it was added) became
+/// the one at after_idx of after (or -1 if it was removed)
+EditSync::Entity make_entity(
+  const Kind kind,
+  const Level& before,
+  const int before_idx,
+  const Level& after,
+  const int after_idx)
+{
+  EditSync::Entity entity;
+  entity.kind = kind;
+  if (before_idx < 0)
+    entity.change = EditSync::Entity::ADDED;
+  else if (after_idx < 0)
+    entity.change = EditSync::Entity::REMOVED;
+  if (has_uuid(kind))
+    entity.uuid = after_idx >= 0 ?
+      uuid_of(after, kind, after_idx) : uuid_of(before, kind, before_idx);
+  else
+  {
+    entity.type = after_idx >= 0 ?
+      type_of(after, kind, after_idx) : type_of(before, kind, before_idx);
+    entity.before_type = before_idx >= 0 ?
+      type_of(before, kind, before_idx) : entity.type;
+    if (before_idx >= 0)
+      entity.before_key = key_of(before, kind, before_idx);
+  }
+  if (before_idx >= 0)
+    entity.before_hash = entity_hash(before, kind, before_idx);
+  if (after_idx >= 0)
+    entity.yaml = entity_yaml(after, kind, after_idx);
+  return entity;
+}
+
+}  // namespace
+
+//=============================================================================
+void EditSync::add_entity(
+  const Kind kind,
+  const Level& before,
+  const int before_idx,
+  const Level& after,
+  const int after_idx,
+  vector<Entity>& entities)
+{
+  if (!is_shared(kind))
+    return;
+  if (before_idx >= 0 && after_idx >= 0 && has_uuid(kind) &&
+    uuid_of(before, kind, before_idx) != uuid_of(after, kind, after_idx))
+  {
+    // matched by content, but it isn't the same entity to the others
+    entities.push_back(make_entity(kind, before, before_idx, after, -1));
+    entities.push_back(make_entity(kind, before, -1, after, after_idx));
+  }
+  else if (before_idx < 0 || after_idx < 0 ||
+    entity_hash(before, kind, before_idx) !=
+    entity_hash(after, kind, after_idx))
+    entities.push_back(
+      make_entity(kind, before, before_idx, after, after_idx));
+}
+
+bool EditSync::reported_entities(
+  const Level& before,
+  const Level& after,
+  const Level::ChangeSet& changes,
+  vector<Entity>& entities)
+{
+  if (changes.all || changes.empty())
+    return false;
+
+  // those appended are at the end, whether or not they were reported
+  std::set<int> indices[BuildingDiff::NUM_KINDS];
+  for (const Kind kind : KINDS)
+  {
+    const int before_count = count_of(before, kind);
+    const int after_count = count_of(after, kind);
+    if (after_count < before_count)
+      return false;  // removed, without saying which
+    for (int idx = before_count; idx < after_count; idx++)
+      indices[kind].insert(idx);
+  }
+  for (const Level::SelectedItem& item : changes.items)
+  {
+    indices[BuildingDiff::VERTEX].insert(item.vertex_idx);
+    indices[BuildingDiff::EDGE].insert(item.edge_idx);
+    indices[BuildingDiff::POLYGON].insert(item.polygon_idx);
+    indices[BuildingDiff::MODEL].insert(item.model_idx);
+    indices[BuildingDiff::FIDUCIAL].insert(item.fiducial_idx);
+    indices[BuildingDiff::TAG].insert(item.tag_idx);
+    if (item.feature_layer_idx == 0)  // of the floorplan
+      indices[BuildingDiff::FEATURE].insert(item.feature_idx);
+  }
+
+  for (const Kind kind : KINDS)
+  {
+    const int before_count = count_of(before, kind);
+    const int after_count = count_of(after, kind);
+    for (const int idx : indices[kind])
+    {
+      if (idx >= 0 && idx < after_count)
+        add_entity(
+          kind, before, idx < before_count ? idx : -1, after, idx, entities);
+    }
+  }
+  return true;
+}
+
+vector<EditSync::Entity> EditSync::changed_entities(
+  const Level& before,
+  const Level& after)
+{
+  BuildingDiff::LevelDiff diff;
+  BuildingDiff::diff_level(before, after, diff);
+
+  vector<Entity> entities;
+  for (const BuildingDiff::Entry& entry : diff.entries)
+  {
+    if (entry.changes & BuildingDiff::ADDED)
+      add_entity(entry.kind, before, -1, after, entry.after_idx, entities);
+    else if (entry.changes & BuildingDiff::REMOVED)
+      add_entity(entry.kind, before, entry.before_idx, after, -1, entities);
+    else
+      add_entity(
+        entry.kind,
+        before,
+        entry.before_idx,
+        after,
+        entry.after_idx,
+        entities);
+  }
+  return entities;
+}
+
+QJsonObject EditSync::to_json(const Entity& entity)
+{
+  static const char* const CHANGES[] = {"added", "removed", "modified"};
+  QJsonObject o;
+  o["kind"] = BuildingDiff::kind_name(entity.kind);
+  o["change"] = CHANGES[entity.change];
+  if (has_uuid(entity.kind))
+    o["uuid"] = uuid_text(entity.uuid);
+  else
+  {
+    o["type"] = entity.type;
+    if (entity.change != Entity::ADDED)
+    {
+      o["before_key"] = key_json(entity.before_key);
+      if (entity.before_type != entity.type)
+        o["before_type"] = entity.before_type;
+    }
+  }
+  if (entity.change != Entity::ADDED)
+    o["before_hash"] = ContentHash::to_hex(entity.before_hash);
+  if (entity.change != Entity::REMOVED)
+    o["yaml"] = yaml_text(entity.yaml);
+  return o;
+}
+
+QJsonArray EditSync::operation(const Level& before, const Level& after)
+{
+  QJsonArray json;
+  for (const Entity& entity : changed_entities(before, after))
+    json.append(to_json(entity));
+  return json;
+}
+
+QJsonArray EditSync::operations(
+  const BuildingSnapshot& before,
+  const BuildingSnapshot& after)
+{
+  QJsonArray json;
+  for (const std::shared_ptr<const Level>& level : after.levels)
+  {
+    const Level* before_level = before.find_level(level->name);
+    if (!before_level || before_level == level.get())
+      continue;
+    const QJsonArray entities = operation(*before_level, *level);
+    if (entities.isEmpty())
+      continue;
+    QJsonObject o;
+    o["level"] = QString::fromStdString(level->name);
+    o["entities"] = entities;
+    json.append(o);
+  }
+  return json;
+}
+
+EditSync::Applied EditSync::apply(
+  Level& level,
+  const QJsonArray& entities,
+  const bool force)
+{
+  struct Change
+  {
+    QJsonObject json;
+    Kind kind = BuildingDiff::VERTEX;
+    bool removed = false;
+    QUuid id;
+    int type = 0;
+    int target = -1;  // the index of the entity it changes, if any
+    YAML::Node yaml;
+  };
+
+  // find what each one changes, and whether it is as they expect, before
+  // changing anything; only appending keeps the indices found valid
+  Applied applied;
+  vector<Change> changes;
+  std::set<std::pair<int, int>> targets;
+  for (const QJsonValue& value : entities)
+  {
+    Change c;
+    c.json = value.toObject();
+    const QJsonObject& o = c.json;
+    const QString change = o["change"].toString();
+    c.removed = change == "removed";
+    c.id = QUuid(o["uuid"].toString());
+    c.type = o["type"].toInt();
+    const int before_type =
+      o.contains("before_type") ? o["before_type"].toInt() : c.type;
+    bool ok = parse_kind(o["kind"].toString(), c.kind) &&
+      (c.removed || change == "added" || change == "modified");
+    try
+    {
+      if (ok && !c.removed)
+        c.yaml = YAML::Load(o["yaml"].toString().toStdString());
+    }
+    catch (const std::exception&)
+    {
+      ok = false;
+    }
+
+    if (ok)
+    {
+      const vector<QUuid> before_key =
+        key_from_json(o["before_key"].toArray());
+      if (change != "added")
+        c.target = find(level, c.kind, c.id, before_type, before_key);
+      if (c.target < 0 && (change == "added" || force) && !c.removed)
+        c.target =
+          find(level, c.kind, c.id, c.type, key_from_yaml(c.kind, c.yaml));
+
+      if (force)
+        ok = !c.removed || c.target >= 0;  // already gone is fine
+      else if (change == "added")
+        ok = c.target < 0;
+      else
+        ok = c.target >= 0 &&
+          ContentHash::to_hex(entity_hash(level, c.kind, c.target)) ==
+          o["before_hash"].toString();
+      if (ok && c.target >= 0)
+        ok = targets.insert(std::make_pair(c.kind, c.target)).second;
+    }
+
+    if (ok)
+      changes.push_back(c);
+    else if (force && c.removed)
+      applied.accepted.append(c.json);
+    else
+    {
+      applied.rejected.append(c.json);
+      applied.num_conflicts++;
+    }
+  }
+
+  // the entities with uuids first, as edges and polygons refer to vertices
+  for (const bool uuids : {true, false})
+  {
+    for (const Change& c : changes)
+    {
+      if (c.removed || has_uuid(c.kind) != uuids)
+        continue;
+      YAML::Node node = YAML::Clone(c.yaml);
+      int idx = -1;
+      try
+      {
+        if (uuids || resolve_vertices(level, c.kind, node))
+          idx = put_entity(level, c.kind, c.target, c.id, c.type, node);
+      }
+      catch (const std::exception&)
+      {
+        idx = -1;
+      }
+      if (idx < 0)
+      {
+        applied.rejected.append(c.json);
+        applied.num_conflicts++;
+        continue;
+      }
+      mark_changed(level, c.kind, idx);
+      applied.accepted.append(c.json);
+      applied.num_applied++;
+    }
+  }
+
+  // and removing last, as it renumbers the rest
+  vector<int> removed[BuildingDiff::NUM_KINDS];
+  for (const Change& c : changes)
+  {
+    if (!c.removed)
+      continue;
+    removed[c.kind].push_back(c.target);
+    applied.accepted.append(c.json);
+    applied.num_applied++;
+  }
+  for (vector<int>& indices : removed)
+  {
+    std::sort(indices.rbegin(), indices.rend());
+    applied.removed = applied.removed || !indices.empty();
+  }
+  erase_indices(level.edges, removed[BuildingDiff::EDGE]);
+  erase_indices(level.polygons, removed[BuildingDiff::POLYGON]);
+  erase_indices(level.models, removed[BuildingDiff::MODEL]);
+  erase_indices(level.fiducials, removed[BuildingDiff::FIDUCIAL]);
+  erase_indices(level.floorplan_features, removed[BuildingDiff::FEATURE]);
+  erase_indices(level.tags, removed[BuildingDiff::TAG]);
+  erase_vertices(level, removed[BuildingDiff::VERTEX]);
+  if (applied.removed)
+    level.mark_all_changed();
+  return applied;
+}
+
+QJsonArray EditSync::current(const Level& level, const QJsonArray& rejected)
+{
+  QJsonArray entities;
+  auto add = [&entities, &level](
+    const Kind kind,
+    const QUuid& id,
+    const int type,
+    const vector<QUuid>& key)
+    {
+      const int idx = find(level, kind, id, type, key);
+      if (idx >= 0)
+      {
+        entities.append(to_json(make_entity(kind, level, idx, level, idx)));
+        return;
+      }
+      QJsonObject o;
+      o["kind"] = BuildingDiff::kind_name(kind);
+      o["change"] = "removed";
+      if (has_uuid(kind))
+        o["uuid"] = uuid_text(id);
+      else
+      {
+        o["type"] = type;
+        o["before_key"] = key_json(key);
+      }
+      entities.append(o);
+    };
+
+  for (const QJsonValue& value : rejected)
+  {
+    const QJsonObject o = value.toObject();
+    Kind kind = BuildingDiff::VERTEX;
+    if (!parse_kind(o["kind"].toString(), kind))
+      continue;
+    if (has_uuid(kind))
+    {
+      add(kind, QUuid(o["uuid"].toString()), 0, vector<QUuid>());
+      continue;
+    }
+
+    // an edge or polygon is wherever each editor thinks it is
+    const int type = o["type"].toInt();
+    if (o.contains("before_key"))
+      add(
+        kind,
+        QUuid(),
+        o.contains("before_type") ? o["before_type"].toInt() : type,
+        key_from_json(o["before_key"].toArray()));
+    if (o.contains("yaml"))
+    {
+      try
+      {
+        add(
+          kind,
+          QUuid(),
+          type,
+          key_from_yaml(kind, YAML::Load(o["yaml"].toString().toStdString())));
+      }
+      catch (const std::exception&)
+      {
+      }
+    }
+  }
+  return entities;
+}
+
+QJsonObject EditSync::uuids(const Building& building)
+{
+  QJsonObject json;
+  for (const Level& level : building.levels)
+  {
+    QJsonObject level_json;
+    for (const Kind kind :
+      {BuildingDiff::VERTEX, BuildingDiff::MODEL, BuildingDiff::FIDUCIAL,
+        BuildingDiff::TAG})
+    {
+      QJsonArray ids;
+      for (int i = 0; i < count_of(level, kind); i++)
+        ids.append(uuid_text(uuid_of(level, kind, i)));
+      level_json[BuildingDiff::kind_name(kind)] = ids;
+    }
+    json[QString::fromStdString(level.name)] = level_json;
+  }
+  return json;
+}
+
+bool EditSync::adopt_uuids(Building& building, const QJsonObject& uuids)
+{
+  const Kind kinds[] = {
+    BuildingDiff::VERTEX,
+    BuildingDiff::MODEL,
+    BuildingDiff::FIDUCIAL,
+    BuildingDiff::TAG
+  };
+  for (const Level& level : building.levels)
+  {
+    const QJsonObject level_json =
+      uuids[QString::fromStdString(level.name)].toObject();
+    for (const Kind kind : kinds)
+    {
+      if (level_json[BuildingDiff::kind_name(kind)].toArray().size() !=
+        count_of(level, kind))
+        return false;
+    }
+  }
+
+  for (Level& level : building.levels)
+  {
+    const QJsonObject level_json =
+      uuids[QString::fromStdString(level.name)].toObject();
+    for (const Kind kind : kinds)
+    {
+      const QJsonArray ids =
+        level_json[BuildingDiff::kind_name(kind)].toArray();
+      for (int i = 0; i < ids.size(); i++)
+      {
+        const QUuid id(ids[i].toString());
+        switch (kind)
+        {
+          case BuildingDiff::VERTEX: level.vertices[i].uuid = id; break;
+          case BuildingDiff::MODEL: level.models[i].uuid = id; break;
+          case BuildingDiff::FIDUCIAL: level.fiducials[i].uuid = id; break;
+          default: level.tags[i].uuid = id; break;
+        }
+      }
+    }
+    level.mark_all_changed();
+  }
+  return true;
+}
+
+//=============================================================================
+EditSync::EditSync(
+  QObject* parent,
+  Building& building,
+  SnapshotPublisher& publisher)
+: _building(building),
+  _publisher(publisher),
+  _parent(parent)
+{
+}
+
+EditSync::~EditSync()
+{
+  stop();
+}
+
+void EditSync::set_changed_callback(const ChangedCallback& callback)
+{
+  _changed_callback = callback;
+}
+
+void EditSync::set_status_callback(const StatusCallback& callback)
+{
+  _status_callback = callback;
+}
+
+bool EditSync::host(const int port)
+{
+  stop();
+  _server = new QTcpServer(_parent);
+  if (!_server->listen(QHostAddress::Any, static_cast<quint16>(port)))
+  {
+    status(
+      QString("Unable to share editing on port %1: %2").arg(port).arg(
+        _server->errorString()));
+    delete _server;
+    _server = nullptr;
+    return false;
+  }
+  QObject::connect(
+    _server,
+    &QTcpServer::newConnection,
+    [this]()
+    {
+      while (_server->hasPendingConnections())
+        add_peer(_server->nextPendingConnection());
+    });
+  _base = _publisher.publish(_building);
+  status(QString("Sharing editing on port %1").arg(port));
+  return true;
+}
+
+void EditSync::join(const QString& address, const int port)
+{
+  stop();
+  QTcpSocket* socket = new QTcpSocket(_parent);
+  add_peer(socket);
+  QObject::connect(
+    socket,
+    &QTcpSocket::connected,
+    [this, socket]()
+    {
+      QJsonObject hello;
+      hello["type"] = "hello";
+      hello["version"] = PROTOCOL_VERSION;
+      hello["hash"] = ContentHash::to_hex(_building.content_hash());
+      write(socket, hello);
+    });
+  socket->connectToHost(address, static_cast<quint16>(port));
+  status(QString("Joining %1:%2...").arg(address).arg(port));
+}
+
+void EditSync::stop()
+{
+  for (QTcpSocket* socket : _peers)
+  {
+    QObject::disconnect(socket, nullptr, nullptr, nullptr);
+    socket->abort();
+    socket->deleteLater();
+  }
+  for (QTcpSocket* socket : _joining)
+  {
+    QObject::disconnect(socket, nullptr, nullptr, nullptr);
+    socket->abort();
+    socket->deleteLater();
+  }
+  _peers.clear();
+  _joining.clear();
+  if (_server)
+  {
+    _server->close();
+    _server->deleteLater();
+    _server = nullptr;
+  }
+  _welcomed = false;
+  _base.reset();
+}
+
+bool EditSync::is_connected() const
+{
+  return is_host() || _welcomed;
+}
+
+int EditSync::num_peers() const
+{
+  return static_cast<int>(_peers.size());
+}
+
+void EditSync::send()
+{
+  if (!is_connected())
+    return;
+  const std::shared_ptr<const BuildingSnapshot> snapshot =
+    _publisher.publish(_building);
+  if (!_base || snapshot == _base)
+  {
+    _base = snapshot;
+    return;
+  }
+
+  for (const QJsonValue& value : operations(*_base, *snapshot))
+  {
+    QJsonObject message = value.toObject();
+    message["type"] = "operation";
+    for (QTcpSocket* socket : _peers)
+      write(socket, message);
+  }
+  _base = snapshot;
+}
+
+void EditSync::add_peer(QTcpSocket* socket)
+{
+  // the host is a peer as soon as it is connected to, but the others must
+  // say that they have the same building first
+  if (is_host())
+    _joining.push_back(socket);
+  else
+    _peers.push_back(socket);
+
+  QObject::connect(
+    socket,
+    &QTcpSocket::readyRead,
+    [this, socket]()
+    {
+      while (socket->canReadLine())
+      {
+        QJsonParseError error;
+        const QJsonDocument document =
+          QJsonDocument::fromJson(socket->readLine(), &error);
+        if (document.isObject())
+          receive(socket, document.object());
+        else
+          qCWarning(lc_io, "unable to parse a shared edit: %s",
+            qUtf8Printable(error.errorString()));
+
+        // receiving may have disconnected it
+        if (std::find(_peers.begin(), _peers.end(), socket) == _peers.end() &&
+          std::find(_joining.begin(), _joining.end(), socket) ==
+          _joining.end())
+          break;
+      }
+    });
+  QObject::connect(
+    socket,
+    &QTcpSocket::disconnected,
+    [this, socket]()
+    {
+      const bool was_host = !is_host();
+      remove_peer(socket);
+      status(
+        was_host ?
+        QString("Disconnected from the shared editing host") :
+        QString("%1 editors sharing this building").arg(num_peers() + 1));
+    });
+}
+
+void EditSync::remove_peer(QTcpSocket* socket)
+{
+  _peers.erase(
+    std::remove(_peers.begin(), _peers.end(), socket),
+    _peers.end());
+  _joining.erase(
+    std::remove(_joining.begin(), _joining.end(), socket),
+    _joining.end());
+  QObject::disconnect(socket, nullptr, nullptr, nullptr);
+  socket->deleteLater();
+  if (!is_host())
+  {
+    _welcomed = false;
+    _base.reset();
+  }
+}
+
+void EditSync::receive(QTcpSocket* socket, const QJsonObject& message)
+{
+  const QString type = message["type"].toString();
+  if (is_host() && type == "hello")
+  {
+    QString reason;
+    if (message["version"].toInt() != PROTOCOL_VERSION)
+      reason = "The host runs another version of the editor.";
+    else if (message["hash"].toString() !=
+      ContentHash::to_hex(_building.content_hash()))
+      reason =
+        "The building open here isn't the same as the host's. Save it "
+        "there, and open it again here.";
+    if (!reason.isEmpty())
+    {
+      QJsonObject refused;
+      refused["type"] = "refused";
+      refused["reason"] = reason;
+      write(socket, refused);
+      remove_peer(socket);
+      socket->disconnectFromHost();
+      return;
+    }
+
+    _joining.erase(
+      std::remove(_joining.begin(), _joining.end(), socket),
+      _joining.end());
+    _peers.push_back(socket);
+    QJsonObject welcome;
+    welcome["type"] = "welcome";
+    welcome["uuids"] = uuids(_building);
+    write(socket, welcome);
+    status(QString("%1 editors sharing this building").arg(num_peers() + 1));
+  }
+  else if (!is_host() && type == "welcome")
+  {
+    if (!adopt_uuids(_building, message["uuids"].toObject()))
+    {
+      status("The building open here isn't the same as the host's");
+      stop();
+      return;
+    }
+    _welcomed = true;
+    _base = _publisher.publish(_building);
+    status("Joined shared editing");
+    if (_changed_callback)
+      _changed_callback(true);
+  }
+  else if (!is_host() && type == "refused")
+  {
+    status(message["reason"].toString());
+    stop();
+  }
+  else if (type == "operation" &&
+    std::find(_peers.begin(), _peers.end(), socket) != _peers.end() &&
+    is_connected())
+    receive_operation(socket, message);
+}
+
+void EditSync::receive_operation(
+  QTcpSocket* socket,
+  const QJsonObject& message)
+{
+  const std::string level_name = message["level"].toString().toStdString();
+  Level* level = nullptr;
+  for (Level& l : _building.levels)
+  {
+    if (l.name == level_name)
+      level = &l;
+  }
+  if (!level)
+  {
+    qCWarning(lc_io, "unable to apply a shared edit of level %s",
+      level_name.c_str());
+    return;
+  }
+
+  // only the host's corrections are forced
+  const bool force = !is_host() && message["force"].toBool();
+  const Applied applied =
+    apply(*level, message["entities"].toArray(), force);
+
+  if (is_host())
+  {
+    if (!applied.accepted.isEmpty())
+    {
+      QJsonObject relayed(message);
+      relayed["entities"] = applied.accepted;
+      for (QTcpSocket* peer : _peers)
+      {
+        if (peer != socket)
+          write(peer, relayed);
+      }
+    }
+    if (!applied.rejected.isEmpty())
+    {
+      QJsonObject correction(message);
+      correction["entities"] = current(*level, applied.rejected);
+      correction["force"] = true;
+      write(socket, correction);
+    }
+  }
+  if (applied.num_conflicts > 0)
+    status(
+      QString("%1 edits of another editor conflicted with those here").arg(
+        applied.num_conflicts));
+
+  // what was applied isn't to be sent back
+  _base = _publisher.publish(_building);
+  if (applied.num_applied > 0 && _changed_callback)
+    _changed_callback(applied.removed);
+}
+
+void EditSync::write(QTcpSocket* socket, const QJsonObject& message)
+{
+  socket->write(QJsonDocument(message).toJson(QJsonDocument::Compact));
+  socket->write("\n");
+}
+
+void EditSync::status(const QString& message)
+{
+  qCInfo(lc_io, "%s", qUtf8Printable(message));
+  if (_status_callback)
+    _status_callback(message);
+}
@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__EDIT_SYNC_HPP
+#define TRAFFIC_EDITOR__EDIT_SYNC_HPP
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <QByteArray>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QString>
+#include <QUuid>
+#include <yaml-cpp/yaml.h>
+
+#include "building_diff.hpp"
+#include "level.h"
+
+class Building;
+class BuildingSnapshot;
+class QObject;
+class QTcpServer;
+class QTcpSocket;
+class SnapshotPublisher;
+
+//=============================================================================
+/// Shares the edits of several editors which have the same building open,
+/// so that several people can work on it at once instead of merging their
+/// copies by hand. One editor hosts, the others join it over TCP.
+///
+/// Each command (or undo, or redo) is sent as an operation: the entities
+/// of one level that it added, removed or modified, as found by diffing
+/// the snapshots from before and after it (see BuildingDiff), as one line
+/// of compact JSON:
+///
+///   {"type": "operation", "level": name, "force": bool,
+///    "entities": [{"kind", "change": "added" | "removed" | "modified",
+///      "uuid", "type" (of an edge or polygon), "before_key",
+///      "before_hash", "yaml"}]}
+///
+/// Entities are addressed by uuid, or, for edges and polygons, by their
+/// type and the uuids of their vertices (the "key", which is also what
+/// their yaml refers to them by), so that the entities of each editor can
+/// be in a different order. Uuids only last a session, so an editor
+/// joining adopts those of the host, which must have the same content (see
+/// Building::content_hash()).
+///
+/// An entity is only changed if it is as its before_hash says it was
+/// before; otherwise the edit conflicts with one made elsewhere at the
+/// same time. The host wins those: it passes on to the others what it
+/// could apply, and sends back what it has instead of the rest, with
+/// "force" set. Applying an operation changes only the entities in it,
+/// marking them for the editor to redraw. Layers, lifts, constraints and
+/// the properties of levels and of the building aren't shared.
+class EditSync
+{
+public:
+  static constexpr int PROTOCOL_VERSION = 1;
+  static constexpr int DEFAULT_PORT = 47400;
+
+  /// What applying an operation to a level did
+  struct Applied
+  {
+    int num_applied = 0;
+    int num_conflicts = 0;
+    bool removed = false;  // so the indices of the others changed
+    QJsonArray accepted;  // the entities which were applied
+    QJsonArray rejected;  // and those which conflicted
+  };
+
+  /// Called after the building was changed by another editor, with
+  /// whether the commands of the undo stack may no longer apply to it: if
+  /// entities were removed, which renumbers the others, or took on other
+  /// uuids
+  typedef std::function<void(bool reset_undo)> ChangedCallback;
+  typedef std::function<void(const QString& message)> StatusCallback;
+
+  EditSync(
+    QObject* parent,
+    Building& building,
+    SnapshotPublisher& publisher);
+  ~EditSync();
+
+  void set_changed_callback(const ChangedCallback& callback);
+  void set_status_callback(const StatusCallback& callback);
+
+  /// Accept editors joining on this port
+  bool host(const int port);
+
+  /// Join the editor hosting on this address
+  void join(const QString& address, const int port);
+
+  void stop();
+
+  bool is_host() const { return _server != nullptr; }
+  bool is_connected() const;
+  int num_peers() const;
+
+  /// Send the edits made since the last call or the last edit applied
+  void send();
+
+  //===========================================================================
+  /// One entity of an operation, as its fields rather than as JSON, for
+  /// EditJournal to keep in a layout of its own
+  struct Entity
+  {
+    enum Change { ADDED = 0, REMOVED, MODIFIED };
+
+    BuildingDiff::Kind kind = BuildingDiff::VERTEX;
+    Change change = MODIFIED;
+    QUuid uuid;  // of the kinds which have one
+    int type = 0;  // of an edge or polygon, and what it was before
+    int before_type = 0;
+    std::vector<QUuid> before_key;  // of an edge or polygon, unless added
+    std::uint64_t before_hash = 0;  // unless added
+    YAML::Node yaml;  // unless removed
+  };
+
+  /// Add how the entity at before_idx of before (or -1 if it was added)
+  /// became the one at after_idx of after (or -1 if it was removed).
+  /// Kinds which aren't shared, and entities which are as they were, are
+  /// left out.
+  static void add_entity(
+    const BuildingDiff::Kind kind,
+    const Level& before,
+    const int before_idx,
+    const Level& after,
+    const int after_idx,
+    std::vector<Entity>& entities);
+
+  /// The entities of after which were added, removed or modified since
+  /// before, found by diffing the levels
+  static std::vector<Entity> changed_entities(
+    const Level& before,
+    const Level& after);
+
+  /// The same, from the entities which the edits said they touched (see
+  /// Level::take_journal_changes()) and those appended, without diffing
+  /// the rest of the level. False if that can't tell what changed: the
+  /// edits reported nothing, or the whole level, or removed entities.
+  static bool reported_entities(
+    const Level& before,
+    const Level& after,
+    const Level::ChangeSet& changes,
+    std::vector<Entity>& entities);
+
+  static QJsonObject to_json(const Entity& entity);
+
+  /// The changed_entities() as in an operation
+  static QJsonArray operation(const Level& before, const Level& after);
+
+  /// The operations of every level edited from one snapshot to the next,
+  /// as {"level", "entities"} objects. The levels which weren't edited are
+  /// shared between the snapshots, and aren't looked at.
+  static QJsonArray operations(
+    const BuildingSnapshot& before,
+    const BuildingSnapshot& after);
+
+  /// Apply the entities of an operation; forced ones are applied whatever
+  /// the entity is now
+  static Applied apply(
+    Level& level,
+    const QJsonArray& entities,
+    const bool force);
+
+  /// The entities of the level as they are now, forced, in place of
+  /// these, which it rejected
+  static QJsonArray current(const Level& level, const QJsonArray& rejected);
+
+  /// The uuids of the vertices, models, fiducials and tags of each level
+  static QJsonObject uuids(const Building& building);
+
+  /// Take on those uuids, if the levels have as many of each
+  static bool adopt_uuids(Building& building, const QJsonObject& uuids);
+
+private:
+  Building& _building;
+  SnapshotPublisher& _publisher;
+  QObject* _parent = nullptr;
+  QTcpServer* _server = nullptr;
+  std::vector<QTcpSocket*> _peers;  // of the host, or the host
+  std::vector<QTcpSocket*> _joining;  // which haven't said hello yet
+  bool _welcomed = false;  // by the host, if this editor joined it
+  std::shared_ptr<const BuildingSnapshot> _base;  // what was last sent
+  ChangedCallback _changed_callback;
+  StatusCallback _status_callback;
+
+  void add_peer(QTcpSocket* socket);
+  void remove_peer(QTcpSocket* socket);
+  void receive(QTcpSocket* socket, const QJsonObject& message);
+  void receive_operation(QTcpSocket* socket, const QJsonObject& message);
+  void write(QTcpSocket* socket, const QJsonObject& message);
+  void status(const QString& message);
+};
+
+#endif
@@ -17,17 +17,25 @@
 
 #include <algorithm>
 #include <cmath>
+#include <functional>
+#include <set>
 #include <string>
+#include <tuple>
+#include <unordered_map>
 #include <unistd.h>
 #include <sys/types.h>
 #include <pwd.h>
 
 #include <QtWidgets>
 
+#include <QFutureWatcher>
 #include <QInputDialog>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QLabel>
 #include <QListWidget>
 #include <QToolBar>
+#include <QtConcurrent/QtConcurrent>
 
 #include <yaml-cpp/yaml.h>
 
@@ -37,30 +45,69 @@
 
 #include "actions/add_constraint.hpp"
 #include "actions/add_feature.h"
+#include "actions/add_feature_matches.hpp"
 #include "actions/add_fiducial.h"
 #include "actions/add_model.h"
 #include "actions/add_property.h"
 #include "actions/add_polygon.h"
 #include "actions/add_vertex.h"
 #include "actions/add_tag.h"
+#include "actions/batch_edit.hpp"
+#include "actions/bulk_models.hpp"
+#include "actions/convert_coordinates.hpp"
 #include "actions/delete.h"
+#include "actions/merge_building.hpp"
+#include "actions/move_vertices.hpp"
+#include "actions/paste.hpp"
 #include "actions/polygon_add_vertex.h"
 #include "actions/polygon_remove_vertices.h"
+#include "actions/replace_params.hpp"
+#include "actions/set_fiducials.hpp"
+#include "actions/set_joint_alignment.hpp"
+#include "actions/set_layer_transforms.hpp"
+#include "actions/set_params.hpp"
+#include "actions/transform_selection.hpp"
 
 #include "add_param_dialog.h"
+#include "basemap.hpp"
+#include "batch_edit_transaction.hpp"
 #include "building_dialog.h"
+#include "building_diff.hpp"
+#include "building_merger.hpp"
+#include "building_statistics.hpp"
+#include "coordinate_conversion.hpp"
+#include "decoded_image_cache.hpp"
+#include "fiducial_pairing.hpp"
 #include "editor.h"
+#include "geometry_cleanup.hpp"
+#include "geometry_simplifier.hpp"
+#include "heap.hpp"
+#include "lane_grid_generator.hpp"
 #include "layer_dialog.h"
 #include "layer_table.h"
 #include "level_dialog.h"
+#include "level_image_exporter.hpp"
 #include "level_table.h"
 #include "lift_table.h"
+#include "logging.hpp"
 #include "map_view.h"
+#include "memory_report.hpp"
+#include "model_catalog_cache.hpp"
 #include "model_dialog.h"
 #include "preferences_dialog.h"
 #include "preferences_keys.h"
+#include "scene_item_pool.hpp"
+#include "selection_clipboard.hpp"
+#include "thumbnail_loader.hpp"
+#include "tick_profile_chart.hpp"
+#include "tower_overview.hpp"
+#include "trace.hpp"
+#include "traffic_map_dialog.h"
 #include "traffic_table.h"
-#include "ui_transform_dialog.h"
+#include "world_preview.hpp"
+#include "world_preview_view.hpp"
+
+#include "plugins/batch_edit.h"
 
 
 using std::string;
@@ -83,11 +130,84 @@ Editor::Editor()
   scene = new QGraphicsScene(this);
 
   map_view = new MapView(this);
+  map_view->set_tick_profiler(&tick_profiler);
   map_view->setScene(scene);
+  map_view->set_opengl_viewport(
+    settings.value(preferences_keys::opengl_viewport).toBool());
   map_view->setStyleSheet(
     "QToolTip { color: #000000; background-color: #ffff88; border: 0px; }");
+  connect(
+    map_view,
+    &MapView::viewport_changed,
+    this,
+    &Editor::map_view_changed);
+  connect(
+    map_view,
+    &MapView::level_of_detail_changed,
+    [this](LevelOfDetail::Tier tier)
+    {
+      // only visibility changes; no need to rebuild the scene
+      rendering_options.lod_tier = tier;
+      LevelOfDetail::apply(scene, tier);
+    });
+
+  minimap = new Minimap;
+  connect(
+    minimap,
+    &Minimap::recenter,
+    [this](const QPointF& scene_point)
+    {
+      map_view->centerOn(scene_point);
+    });
+  minimap_dock = new QDockWidget("Minimap", this);
+  minimap_dock->setObjectName("minimap_dock");
+  minimap_dock->setWidget(minimap);
+  addDockWidget(Qt::LeftDockWidgetArea, minimap_dock);
+  minimap_dock->hide();
+  connect(
+    minimap_dock,
+    &QDockWidget::visibilityChanged,
+    [this](bool visible)
+    {
+      if (visible)
+        update_minimap();
+    });
+
+  statistics_text = new QPlainTextEdit;
+  statistics_text->setReadOnly(true);
+  statistics_text->setFont(
+    QFontDatabase::systemFont(QFontDatabase::FixedFont));
+  statistics_dock = new QDockWidget("Building statistics", this);
+  statistics_dock->setObjectName("statistics_dock");
+  statistics_dock->setWidget(statistics_text);
+  addDockWidget(Qt::LeftDockWidgetArea, statistics_dock);
+  statistics_dock->hide();
+  connect(
+    statistics_dock,
+    &QDockWidget::visibilityChanged,
+    [this](bool visible)
+    {
+      if (visible)
+        refresh_statistics();
+    });
+
+  workspace_tab_bar = new QTabBar;
+  workspace_tab_bar->setStyleSheet("QTabBar::tab { color: black; }");
+  workspace_tab_bar->setExpanding(false);
+  workspace_tab_bar->setDocumentMode(true);
+  connect(
+    workspace_tab_bar,
+    &QTabBar::currentChanged,
+    this,
+    &Editor::switch_document);
+  connect(
+    workspace_tab_bar,
+    &QTabBar::tabCloseRequested,
+    this,
+    &Editor::close_document);
 
   QVBoxLayout* left_layout = new QVBoxLayout;
+  left_layout->addWidget(workspace_tab_bar);
   left_layout->addWidget(map_view);
 
   layer_table = new LayerTable;
@@ -112,6 +232,16 @@ Editor::Editor()
     this,
     &Editor::layer_table_update_slot);
 
+  connect(
+    layer_table,
+    &LayerTable::visibility_changed,
+    [this]()
+    {
+      Level* level = active_level();
+      if (level)
+        level->update_visibility(rendering_options);
+    });
+
   connect(
     layer_table,
     &LayerTable::add_button_clicked,
@@ -124,6 +254,283 @@ Editor::Editor()
     this,
     &Editor::layer_edit_button_clicked);
 
+  undo_memory_label = new QLabel;
+  statusBar()->addPermanentWidget(undo_memory_label);
+
+  task_label = new QLabel;
+  task_label->hide();
+  statusBar()->addPermanentWidget(task_label);
+  task_cancel_button = new QToolButton;
+  task_cancel_button->setText("Cancel");
+  task_cancel_button->setToolTip("Cancel the tasks running in the background");
+  task_cancel_button->hide();
+  statusBar()->addPermanentWidget(task_cancel_button);
+  connect(
+    task_cancel_button,
+    &QToolButton::clicked,
+    this,
+    [this]()
+    {
+      for (const auto& progress : TaskPool::instance().active())
+        progress->cancel();
+      update_task_status();
+    });
+  // polled only while there are tasks to show
+  task_timer = new QTimer(this);
+  task_timer->setInterval(200);
+  connect(task_timer, &QTimer::timeout, this, &Editor::update_task_status);
+
+  // the first tab; Building > Open in new tab adds the others
+  workspace.set_active(add_document());
+  undo_stack = &workspace.document(workspace.active()).undo_stack;
+  undo_budget = &workspace.document(workspace.active()).undo_budget;
+
+  thumbnail_loader =
+    new ThumbnailLoader(editor_models, editor_model_index, this);
+  connect(
+    thumbnail_loader,
+    &ThumbnailLoader::thumbnail_loaded,
+    this,
+    &Editor::thumbnail_loaded);
+  connect(
+    thumbnail_loader,
+    &ThumbnailLoader::finished,
+    [this]()
+    {
+      // the models which were waiting for a thumbnail have a footprint now
+      if (view_model_overlaps_action->isChecked())
+        draw_model_overlaps();
+      if (view_door_clearance_action->isChecked())
+        draw_door_clearance();
+      if (view_lane_clearance_action->isChecked())
+        draw_lane_clearance();
+    });
+
+  tile_cache = new TileCache(this);
+  tile_cache->set_url_template(
+    settings.value(
+      preferences_keys::basemap_url,
+      "https://tile.openstreetmap.org/{z}/{x}/{y}.png").toString());
+  tile_cache->set_disk_dir(
+    QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+    "/basemap_tiles");
+  apply_performance_preferences();
+
+  geometry_watcher = new QFutureWatcher<SceneGeometry>(this);
+  connect(
+    geometry_watcher,
+    &QFutureWatcher<SceneGeometry>::finished,
+    this,
+    &Editor::scene_geometry_ready);
+
+  world_preview = new WorldPreview(this);
+  name_index = new NameIndex(this);
+  level_thumbnails = new LevelThumbnails(this);
+  connect(
+    level_thumbnails,
+    &LevelThumbnails::updated,
+    [this]()
+    {
+      level_table->set_thumbnails(building, *level_thumbnails);
+    });
+  snapshot_timer = new QTimer(this);
+  snapshot_timer->setSingleShot(true);
+  snapshot_timer->setInterval(0);  // after the rest of the command
+  connect(
+    snapshot_timer,
+    &QTimer::timeout,
+    this,
+    &Editor::publish_snapshot);
+  file_watcher = new FileWatcher(this);
+  connect(
+    file_watcher,
+    &FileWatcher::building_changed,
+    this,
+    &Editor::building_changed_on_disk);
+  connect(
+    file_watcher,
+    &FileWatcher::image_changed,
+    this,
+    &Editor::image_changed_on_disk);
+  world_preview_timer = new QTimer(this);
+  world_preview_timer->setSingleShot(true);
+  world_preview_timer->setInterval(250);
+  connect(
+    world_preview_timer,
+    &QTimer::timeout,
+    this,
+    [this]()
+    {
+      world_preview->update(building);
+    });
+
+  property_redraw_timer = new QTimer(this);
+  property_redraw_timer->setSingleShot(true);
+  property_redraw_timer->setInterval(150);
+  connect(
+    property_redraw_timer,
+    &QTimer::timeout,
+    this,
+    &Editor::apply_level_changes);
+
+  mouse_move_timer = new QTimer(this);
+  mouse_move_timer->setSingleShot(true);
+  mouse_move_timer->setTimerType(Qt::PreciseTimer);
+  connect(
+    mouse_move_timer,
+    &QTimer::timeout,
+    this,
+    &Editor::handle_pending_mouse_move);
+
+  minimap_timer = new QTimer(this);
+  minimap_timer->setSingleShot(true);
+  minimap_timer->setInterval(500);
+  connect(minimap_timer, &QTimer::timeout, this, &Editor::render_minimap);
+  statistics_timer = new QTimer(this);
+  statistics_timer->setSingleShot(true);
+  statistics_timer->setInterval(250);
+  connect(
+    statistics_timer,
+    &QTimer::timeout,
+    this,
+    &Editor::refresh_statistics);
+  tower_overview_timer = new QTimer(this);
+  tower_overview_timer->setSingleShot(true);
+  tower_overview_timer->setInterval(500);
+  connect(
+    tower_overview_timer,
+    &QTimer::timeout,
+    this,
+    &Editor::refresh_tower_overview);
+  minimap_watcher = new QFutureWatcher<Minimap::Raster>(this);
+  connect(
+    minimap_watcher,
+    &QFutureWatcher<Minimap::Raster>::finished,
+    this,
+    &Editor::minimap_rendered);
+
+  lane_usage_timer = new QTimer(this);
+  lane_usage_timer->setSingleShot(true);
+  lane_usage_timer->setInterval(300);
+  connect(
+    lane_usage_timer,
+    &QTimer::timeout,
+    this,
+    &Editor::compute_lane_usage);
+  lane_usage_watcher = new QFutureWatcher<LaneUsageAnalysis::Result>(this);
+  connect(
+    lane_usage_watcher,
+    &QFutureWatcher<LaneUsageAnalysis::Result>::finished,
+    this,
+    &Editor::lane_usage_computed);
+
+  traffic_preview_watcher = new QFutureWatcher<TrafficPreview::Result>(this);
+  connect(
+    traffic_preview_watcher,
+    &QFutureWatcher<TrafficPreview::Result>::finished,
+    this,
+    &Editor::traffic_preview_planned);
+  traffic_preview_timer = new QTimer(this);
+  traffic_preview_timer->setInterval(50);
+  connect(
+    traffic_preview_timer,
+    &QTimer::timeout,
+    [this]()
+    {
+      // ten times faster than real time
+      const double time = traffic_preview_time + 0.5;
+      if (time >= traffic_preview_result.end_time)
+        traffic_preview_play_action->setChecked(false);
+      traffic_preview_slider->setValue(static_cast<int>(time * 10.0));
+    });
+
+  drawing_watcher = new QFutureWatcher<QImage>(this);
+  connect(
+    drawing_watcher,
+    &QFutureWatcher<QImage>::finished,
+    this,
+    &Editor::drawing_decoded);
+
+  layer_solve_watcher = new QFutureWatcher<Level::LayerSolution>(this);
+  connect(
+    layer_solve_watcher,
+    &QFutureWatcher<Level::LayerSolution>::finished,
+    this,
+    &Editor::layer_transforms_optimized);
+
+  joint_solve_watcher = new QFutureWatcher<JointAlignment::Solution>(this);
+  connect(
+    joint_solve_watcher,
+    &QFutureWatcher<JointAlignment::Solution>::finished,
+    this,
+    &Editor::all_transforms_optimized);
+
+  building_load_watcher = new QFutureWatcher<bool>(this);
+  connect(
+    building_load_watcher,
+    &QFutureWatcher<bool>::finished,
+    this,
+    &Editor::building_loaded);
+
+  export_features_watcher = new QFutureWatcher<bool>(this);
+  connect(
+    export_features_watcher,
+    &QFutureWatcher<bool>::finished,
+    this,
+    &Editor::export_all_features_finished);
+
+  feature_match_watcher = new QFutureWatcher<FeatureMatcher::Result>(this);
+  connect(
+    feature_match_watcher,
+    &QFutureWatcher<FeatureMatcher::Result>::finished,
+    this,
+    &Editor::layer_features_matched);
+
+  level_registration_watcher =
+    new QFutureWatcher<std::vector<LevelRegistration::Result>>(this);
+  connect(
+    level_registration_watcher,
+    &QFutureWatcher<std::vector<LevelRegistration::Result>>::finished,
+    this,
+    &Editor::levels_registered);
+
+  wall_extract_watcher =
+    new QFutureWatcher<std::vector<std::vector<QPointF>>>(this);
+  connect(
+    wall_extract_watcher,
+    &QFutureWatcher<std::vector<std::vector<QPointF>>>::finished,
+    this,
+    &Editor::walls_extracted);
+
+  dxf_import_watcher = new QFutureWatcher<DxfImporter::Result>(this);
+  connect(
+    dxf_import_watcher,
+    &QFutureWatcher<DxfImporter::Result>::finished,
+    this,
+    &Editor::dxf_imported);
+
+  autosave_watcher = new QFutureWatcher<bool>(this);
+  connect(
+    autosave_watcher,
+    &QFutureWatcher<bool>::finished,
+    this,
+    &Editor::autosave_finished);
+
+  change_delta_watcher = new QFutureWatcher<QByteArray>(this);
+  connect(
+    change_delta_watcher,
+    &QFutureWatcher<QByteArray>::finished,
+    this,
+    &Editor::change_delta_written);
+
+  // autosave every couple of minutes, unless the preferences say otherwise
+  const int autosave_seconds =
+    settings.value(preferences_keys::autosave_seconds, 120).toInt();
+  autosave_timer = new QTimer(this);
+  connect(autosave_timer, &QTimer::timeout, this, &Editor::autosave);
+  if (autosave_seconds > 0)
+    autosave_timer->start(autosave_seconds * 1000);
+
   level_table = new LevelTable;
   connect(
     level_table, &QTableWidget::cellClicked,
@@ -155,14 +562,14 @@ Editor::Editor()
           p_transformed = QPointF(0.0, 0.0);
         }
 
-        level_idx = row;
-        create_scene();
+        switch_level(row);
 
         QTransform t;
         double y_flip = building.coordinate_system.is_y_flipped() ? 1 : -1;
         t.scale(scale, y_flip * scale);
         map_view->setTransform(t);
         map_view->centerOn(p_transformed);
+        map_view->update_level_of_detail();
       }
     });
 
@@ -176,13 +583,41 @@ Editor::Editor()
   connect(
     lift_table,
     &TableList::redraw,
-    [this]() { this->create_scene(); });
+    [this]()
+    {
+      // lift cabins have waypoints on every level they serve
+      building.invalidate_lift_graphics();
+      building.invalidate_saved_yaml();
+      create_scene();
+    });
+  connect(
+    lift_table,
+    &LiftTable::lift_changed,
+    [this](int lift_idx)
+    {
+      // the dialog has already moved its cabin waypoints, which
+      // apply_level_changes() redraws along with the lift. The lift is
+      // on the other levels too, so their cached scenes are stale.
+      drop_cached_scenes();
+      building.invalidate_saved_yaml();
+      if (level_idx >= 0 &&
+        level_idx < static_cast<int>(building.levels.size()))
+        building.redraw_lift(scene, lift_idx, level_idx);
+      apply_level_changes();
+      lift_table->update(building);
+    });
 
   traffic_table = new TrafficTable;
   connect(
     traffic_table,
     &TableList::redraw,
-    [this]() { this->create_scene(); });
+    [this]()
+    {
+      // only the graph visibility changed; the lanes are already drawn
+      Level* level = active_level();
+      if (level)
+        level->update_visibility(rendering_options);
+    });
 
   connect(
     traffic_table,
@@ -193,16 +628,12 @@ Editor::Editor()
       traffic_table->update(rendering_options);
     });
 
-  crowd_sim_table = new CrowdSimEditorTable(building);
-  connect(
-    crowd_sim_table,
-    &QTableWidget::cellClicked,
-    [&]()
-    {
-      crowd_sim_table->update();
-      create_scene();
-    }
-  );
+  // the crowd_sim table is only built once its tab is first shown, but
+  // the building needs the configuration it edits from the start
+  if (building.crowd_sim_impl == nullptr)
+    building.crowd_sim_impl =
+      std::make_shared<crowd_sim::CrowdSimImplementation>();
+  crowd_sim_placeholder = new QWidget;
 
   right_tab_widget = new QTabWidget;
   right_tab_widget->setStyleSheet("QTabBar::tab { color: black; }");
@@ -210,7 +641,26 @@ Editor::Editor()
   right_tab_widget->addTab(layer_table, "layers");
   right_tab_widget->addTab(lift_table, "lifts");
   right_tab_widget->addTab(traffic_table, "traffic");
-  right_tab_widget->addTab(crowd_sim_table, "crowd_sim");
+  right_tab_widget->addTab(crowd_sim_placeholder, "crowd_sim");
+
+  issue_list = new QListWidget;
+  right_tab_widget->addTab(issue_list, "issues");
+  connect(
+    issue_list,
+    &QListWidget::currentRowChanged,
+    this,
+    &Editor::issue_list_clicked);
+  connect(
+    right_tab_widget,
+    &QTabWidget::currentChanged,
+    [this](int index)
+    {
+      // only the levels edited since the last check are checked again
+      if (right_tab_widget->widget(index) == issue_list)
+        update_issue_list();
+      else if (right_tab_widget->widget(index) == crowd_sim_placeholder)
+        create_crowd_sim_table();
+    });
 
   property_editor = new QTableWidget;
   property_editor->setStyleSheet(
@@ -287,6 +737,18 @@ Editor::Editor()
     &Editor::building_open,
     QKeySequence(Qt::CTRL + Qt::Key_O));
 
+  building_menu->addAction(
+    "Open in new &tab...",
+    this,
+    &Editor::building_open_tab,
+    QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_O));
+
+  building_menu->addAction(
+    "&Close tab",
+    this,
+    &Editor::building_close_tab,
+    QKeySequence(Qt::CTRL + Qt::Key_W));
+
   building_menu->addAction(
     "&Save",
     this,
@@ -299,6 +761,63 @@ Editor::Editor()
     &Editor::building_export_features,
     QKeySequence(Qt::CTRL + Qt::Key_E));
 
+  building_menu->addAction(
+    "Export layer alignment points for &all levels...",
+    this,
+    &Editor::building_export_all_features);
+
+  building_menu->addAction(
+    "Export crowd sim &navmeshes...",
+    this,
+    &Editor::building_export_navmeshes);
+
+  building_menu->addAction(
+    "Export nav &graphs...",
+    this,
+    &Editor::building_export_nav_graphs);
+
+  building_menu->addAction(
+    "Export &occupancy grids...",
+    this,
+    &Editor::building_export_occupancy_grids);
+
+  building_menu->addAction(
+    "Export level &image...",
+    this,
+    [this]() { building_export_images(false); });
+
+  building_menu->addAction(
+    "Export images of all le&vels...",
+    this,
+    [this]() { building_export_images(true); });
+
+  building_menu->addAction(
+    "&Merge building...",
+    this,
+    &Editor::building_merge);
+
+  building_menu->addAction(
+    "Con&vert coordinate system...",
+    this,
+    &Editor::building_convert_coordinates);
+
+  building_menu->addSeparator();
+
+  building_menu->addAction(
+    "S&hare editing...",
+    this,
+    &Editor::building_share_host);
+
+  building_menu->addAction(
+    "&Join shared editing...",
+    this,
+    &Editor::building_share_join);
+
+  building_menu->addAction(
+    "Stop sharing e&diting",
+    this,
+    &Editor::building_share_stop);
+
   building_menu->addSeparator();
 
   building_menu->addAction(
@@ -321,16 +840,78 @@ Editor::Editor()
     QKeySequence::Redo);
   edit_menu->addSeparator();
 
+  edit_menu->addAction(
+    "&Copy",
+    this,
+    &Editor::edit_copy,
+    QKeySequence::Copy);
+  edit_menu->addAction(
+    "&Paste",
+    this,
+    &Editor::edit_paste,
+    QKeySequence::Paste);
+  edit_menu->addAction(
+    "Paste in p&lace",
+    this,
+    &Editor::edit_paste_in_place,
+    QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_V));
+  edit_menu->addAction(
+    "&Duplicate level...",
+    this,
+    &Editor::edit_duplicate_level);
+  edit_menu->addSeparator();
+
   edit_menu->addAction(
     "&Building properties...",
     this,
     &Editor::edit_building_properties);
+  edit_menu->addAction(
+    "&Go to...",
+    this,
+    &Editor::edit_go_to,
+    QKeySequence(Qt::CTRL + Qt::Key_G));
+  edit_menu->addAction(
+    "&Find and replace params...",
+    this,
+    &Editor::edit_find_replace_params,
+    QKeySequence(Qt::CTRL + Qt::Key_H));
   edit_menu->addSeparator();
 
-  edit_menu->addAction(
-    "Rotate all models...",
+  QMenu* models_menu = edit_menu->addMenu("&Models");
+  models_menu->addAction(
+    "&Rotate...",
+    this,
+    &Editor::edit_rotate_models);
+  models_menu->addAction(
+    "&Move...",
+    this,
+    &Editor::edit_move_models);
+  models_menu->addAction(
+    "Change &model...",
+    this,
+    &Editor::edit_rename_models);
+  models_menu->addAction(
+    "Make &static or dynamic...",
+    this,
+    &Editor::edit_set_models_static);
+
+  QMenu* polygons_menu = edit_menu->addMenu("Pol&ygons");
+  polygons_menu->addAction(
+    "&Union",
+    this,
+    [this]() { edit_polygon_booleans(PolygonBooleans::UNION); });
+  polygons_menu->addAction(
+    "&Intersection",
+    this,
+    [this]() { edit_polygon_booleans(PolygonBooleans::INTERSECTION); });
+  polygons_menu->addAction(
+    "&Difference",
     this,
-    &Editor::edit_rotate_all_models);
+    [this]() { edit_polygon_booleans(PolygonBooleans::DIFFERENCE); });
+  polygons_menu->addAction(
+    "&Offset...",
+    this,
+    [this]() { edit_polygon_booleans(PolygonBooleans::OFFSET); });
   edit_menu->addSeparator();
 
   edit_menu->addAction(
@@ -338,6 +919,55 @@ Editor::Editor()
     this,
     &Editor::edit_optimize_layer_transforms,
     QKeySequence(Qt::CTRL + Qt::Key_T));
+  edit_menu->addAction(
+    "Optimize all transforms &jointly",
+    this,
+    &Editor::edit_optimize_all_transforms);
+  edit_joint_alignment_action = edit_menu->addAction("Align levels j&ointly");
+  edit_joint_alignment_action->setCheckable(true);
+  connect(
+    edit_joint_alignment_action,
+    &QAction::triggered,
+    this,
+    &Editor::edit_joint_alignment);
+  connect(
+    edit_menu,
+    &QMenu::aboutToShow,
+    this,
+    [this]()
+    {
+      edit_joint_alignment_action->setChecked(building.joint_alignment());
+    });
+#ifdef HAS_OPENCV
+  edit_menu->addAction(
+    "&Match layer features...",
+    this,
+    &Editor::edit_match_layer_features);
+#endif
+  edit_menu->addAction(
+    "&Register levels to the reference...",
+    this,
+    &Editor::edit_register_levels);
+  edit_menu->addAction(
+    "&Pair fiducials with the reference...",
+    this,
+    &Editor::edit_pair_fiducials);
+  edit_menu->addAction(
+    "Extract &walls from layer...",
+    this,
+    &Editor::edit_extract_walls);
+  edit_menu->addAction(
+    "Import &DXF...",
+    this,
+    &Editor::edit_import_dxf);
+  edit_menu->addAction(
+    "Remove vector &underlay",
+    this,
+    &Editor::edit_remove_vector_underlay);
+  edit_menu->addAction(
+    "Generate &lane grid in ROI...",
+    this,
+    &Editor::edit_generate_lane_grid);
   edit_menu->addSeparator();
 
   edit_menu->addAction(
@@ -345,6 +975,34 @@ Editor::Editor()
     this,
     &Editor::edit_align_colinear,
     QKeySequence(Qt::Key_Slash));
+  edit_menu->addAction(
+    "Align all colinear vertices...",
+    this,
+    &Editor::edit_align_all_colinear);
+  edit_menu->addAction(
+    "&Weld vertices and remove duplicate edges...",
+    this,
+    &Editor::edit_cleanup_geometry);
+  edit_menu->addAction(
+    "Simplify &walls and polygons...",
+    this,
+    &Editor::edit_simplify_geometry);
+  edit_menu->addAction(
+    "Rotate selection...",
+    this,
+    &Editor::edit_rotate_selection);
+  edit_menu->addAction(
+    "Scale selection...",
+    this,
+    &Editor::edit_scale_selection);
+  edit_snap_action = edit_menu->addAction("&Snap to vertices and edges");
+  edit_snap_action->setCheckable(true);
+  edit_snap_action->setChecked(true);
+  edit_menu->addSeparator();
+
+  // filled in by add_batch_edit()
+  batch_edit_menu = edit_menu->addMenu("Batch &edits");
+  batch_edit_menu->setEnabled(false);
   edit_menu->addSeparator();
 
   edit_menu->addAction("&Preferences...", this, &Editor::edit_preferences);
@@ -355,26 +1013,218 @@ Editor::Editor()
     view_menu->addAction("&Models", this, &Editor::view_models);
   view_models_action->setCheckable(true);
   view_models_action->setChecked(true);
-  view_menu->addSeparator();
-
-  view_menu->addAction("&Reset zoom level", this, &Editor::zoom_reset);
-
-  // HELP MENU
-  QMenu* help_menu = menuBar()->addMenu("&Help");
-
-  help_menu->addAction("&About", this, &Editor::help_about);
-  help_menu->addAction("About &Qt", &QApplication::aboutQt);
-
-  // TOOLBAR
-  toolbar = new QToolBar();
-
-  tool_button_group = new QButtonGroup(this);
-  tool_button_group->setExclusive(true);
-
-  create_tool_button(TOOL_SELECT, ":icons/select.svg", "Select (Esc)");
-  create_tool_button(TOOL_MOVE, ":icons/move.svg", "Move (M)");
-  create_tool_button(TOOL_ROTATE, ":icons/rotate.svg", "Rotate (R)");
-  create_tool_button(TOOL_ADD_VERTEX, ":icons/vertex.svg", "Add Vertex (V)");
+  view_floor_triangulation_action =
+    view_menu->addAction(
+      "&Floor triangulation",
+      this,
+      &Editor::view_floor_triangulation);
+  view_floor_triangulation_action->setCheckable(true);
+  view_floor_triangulation_action->setChecked(false);
+  view_batch_vertices_action =
+    view_menu->addAction(
+      "&Batch vertex rendering",
+      this,
+      &Editor::view_batch_vertices);
+  view_batch_vertices_action->setCheckable(true);
+  view_batch_vertices_action->setChecked(false);
+  view_batch_edges_action =
+    view_menu->addAction(
+      "Batch &edge rendering",
+      this,
+      &Editor::view_batch_edges);
+  view_batch_edges_action->setCheckable(true);
+  view_batch_edges_action->setChecked(false);
+  view_cull_to_viewport_action =
+    view_menu->addAction(
+      "&Cull to viewport",
+      this,
+      &Editor::view_cull_to_viewport);
+  view_cull_to_viewport_action->setCheckable(true);
+  view_cull_to_viewport_action->setChecked(false);
+  view_profiling_overlay_action =
+    view_menu->addAction(
+      "&Profiling overlay",
+      this,
+      &Editor::view_profiling_overlay);
+  view_profiling_overlay_action->setCheckable(true);
+  view_profiling_overlay_action->setChecked(false);
+  view_ghost_levels_action =
+    view_menu->addAction(
+      "&Ghost adjacent levels",
+      this,
+      &Editor::view_ghost_levels);
+  view_ghost_levels_action->setCheckable(true);
+  view_ghost_levels_action->setChecked(false);
+  view_navmesh_action =
+    view_menu->addAction(
+      "&Navmesh overlay",
+      this,
+      &Editor::view_navmesh);
+  view_navmesh_action->setCheckable(true);
+  view_navmesh_action->setChecked(false);
+  traffic_maps_menu = view_menu->addMenu("&Traffic maps");
+  connect(
+    traffic_maps_menu,
+    &QMenu::aboutToShow,
+    this,
+    &Editor::update_traffic_maps_menu);
+  view_lane_connectivity_action =
+    view_menu->addAction(
+      "&Lane graph connectivity",
+      this,
+      &Editor::view_lane_connectivity);
+  view_lane_connectivity_action->setCheckable(true);
+  view_lane_connectivity_action->setChecked(false);
+  view_lane_conflicts_action =
+    view_menu->addAction(
+      "Lane c&onflicts",
+      this,
+      &Editor::view_lane_conflicts);
+  view_lane_conflicts_action->setCheckable(true);
+  view_lane_conflicts_action->setChecked(false);
+  view_model_overlaps_action =
+    view_menu->addAction(
+      "Model o&verlaps",
+      this,
+      &Editor::view_model_overlaps);
+  view_model_overlaps_action->setCheckable(true);
+  view_model_overlaps_action->setChecked(false);
+  view_door_clearance_action =
+    view_menu->addAction(
+      "Door c&learance",
+      this,
+      &Editor::view_door_clearance);
+  view_door_clearance_action->setCheckable(true);
+  view_door_clearance_action->setChecked(false);
+  view_lane_clearance_action =
+    view_menu->addAction(
+      "Lane clearance for the &robot footprint",
+      this,
+      &Editor::view_lane_clearance);
+  view_lane_clearance_action->setCheckable(true);
+  view_lane_clearance_action->setChecked(false);
+  view_lane_usage_action =
+    view_menu->addAction(
+      "Lane &usage heatmap",
+      this,
+      &Editor::view_lane_usage);
+  view_lane_usage_action->setCheckable(true);
+  view_lane_usage_action->setChecked(false);
+  view_menu->addAction(
+    "Lane &route between selected vertices",
+    this,
+    &Editor::view_lane_route);
+  view_menu->addAction(
+    "&Traffic preview of missions...",
+    this,
+    &Editor::view_traffic_preview);
+  view_changes_action =
+    view_menu->addAction(
+      "Changes against &file...",
+      this,
+      &Editor::view_changes);
+  view_changes_action->setCheckable(true);
+  view_changes_action->setChecked(false);
+  view_crowd_preview_action =
+    view_menu->addAction(
+      "&Crowd preview",
+      this,
+      &Editor::view_crowd_preview);
+  view_crowd_preview_action->setCheckable(true);
+  view_crowd_preview_action->setChecked(false);
+  view_basemap_action =
+    view_menu->addAction(
+      "Basemap t&iles",
+      this,
+      &Editor::view_basemap);
+  view_basemap_action->setCheckable(true);
+  view_basemap_action->setChecked(true);
+  view_menu->addAction(
+    "&3D preview...",
+    this,
+    &Editor::view_world_preview);
+  QAction* view_minimap_action = minimap_dock->toggleViewAction();
+  view_minimap_action->setText("Mi&nimap");
+  view_menu->addAction(view_minimap_action);
+  QAction* view_statistics_action = statistics_dock->toggleViewAction();
+  view_statistics_action->setText("Building &statistics");
+  view_menu->addAction(view_statistics_action);
+  view_menu->addAction(
+    "To&wer overview...",
+    this,
+    &Editor::view_tower_overview);
+  view_menu->addAction(
+    "Load/save &timings...",
+    this,
+    &Editor::view_io_profile);
+  view_menu->addAction(
+    "&Simulation timings...",
+    this,
+    &Editor::view_simulation_timings);
+  view_menu->addAction(
+    "M&emory usage...",
+    this,
+    &Editor::view_memory_usage);
+  view_menu->addAction(
+    "&Runtime statistics...",
+    this,
+    &Editor::view_runtime_statistics);
+  view_menu->addAction("&Log...", this, &Editor::view_log);
+#ifdef TRAFFIC_EDITOR_TRACING
+  view_record_trace_action =
+    view_menu->addAction(
+      "Record &trace",
+      this,
+      &Editor::view_record_trace);
+  view_record_trace_action->setCheckable(true);
+  view_record_trace_action->setChecked(Trace::is_recording());
+#endif
+  view_record_interactions_action =
+    view_menu->addAction(
+      "Record &interactions",
+      this,
+      &Editor::view_record_interactions);
+  view_record_interactions_action->setCheckable(true);
+  view_menu->addSeparator();
+
+  view_menu->addAction(
+    "Open simulation &recording...",
+    this,
+    &Editor::view_open_recording);
+  view_menu->addAction(
+    "E&xport recording frames...",
+    this,
+    &Editor::view_export_recording_frames);
+  view_capture_frames_action = view_menu->addAction(
+    "Capture &frames...",
+    this,
+    &Editor::view_capture_frames);
+  view_capture_frames_action->setCheckable(true);
+  view_menu->addAction(
+    "&Close simulation recording",
+    this,
+    &Editor::view_close_recording);
+  view_menu->addSeparator();
+
+  view_menu->addAction("&Reset zoom level", this, &Editor::zoom_reset);
+  view_menu->addAction("Zoom to &fit level", this, &Editor::zoom_fit);
+
+  // HELP MENU
+  QMenu* help_menu = menuBar()->addMenu("&Help");
+
+  help_menu->addAction("&About", this, &Editor::help_about);
+  help_menu->addAction("About &Qt", &QApplication::aboutQt);
+
+  // TOOLBAR
+  toolbar = new QToolBar();
+
+  tool_button_group = new QButtonGroup(this);
+  tool_button_group->setExclusive(true);
+
+  create_tool_button(TOOL_SELECT, ":icons/select.svg", "Select (Esc)");
+  create_tool_button(TOOL_MOVE, ":icons/move.svg", "Move (M)");
+  create_tool_button(TOOL_ROTATE, ":icons/rotate.svg", "Rotate (R)");
+  create_tool_button(TOOL_ADD_VERTEX, ":icons/vertex.svg", "Add Vertex (V)");
   create_tool_button(TOOL_ADD_TAG, ":icons/signage.svg", "Add Tag (A)");
   create_tool_button(TOOL_ADD_FEATURE, ":icons/feature.svg", "Add Feature");
   create_tool_button(TOOL_ADD_CONSTRAINT,
@@ -410,6 +1260,61 @@ Editor::Editor()
     "QToolBar {background-color: #404040; border: none; spacing: 5px} QToolButton {background-color: #c0c0c0; color: blue; border: 1px solid black;} QToolButton:checked {background-color: #808080; color: red; border: 1px solid black;}");
   addToolBar(Qt::TopToolBarArea, toolbar);
 
+  // REPLAY TOOLBAR, shown while a simulation recording is open
+  replay_toolbar = new QToolBar("Replay");
+  replay_slider = new QSlider(Qt::Horizontal);
+  connect(
+    replay_slider,
+    &QSlider::valueChanged,
+    this,
+    &Editor::replay_seek);
+  replay_toolbar->addWidget(replay_slider);
+  replay_time_label = new QLabel;
+  replay_time_label->setMinimumWidth(120);
+  replay_toolbar->addWidget(replay_time_label);
+  addToolBar(Qt::BottomToolBarArea, replay_toolbar);
+  replay_toolbar->hide();
+
+  // TRAFFIC PREVIEW TOOLBAR, shown while the missions of a fleet are
+  // being played back
+  traffic_preview_toolbar = new QToolBar("Traffic preview");
+  traffic_preview_play_action = traffic_preview_toolbar->addAction("Play");
+  traffic_preview_play_action->setCheckable(true);
+  connect(
+    traffic_preview_play_action,
+    &QAction::toggled,
+    [this](const bool play)
+    {
+      if (play)
+        traffic_preview_timer->start();
+      else
+        traffic_preview_timer->stop();
+    });
+  traffic_preview_slider = new QSlider(Qt::Horizontal);
+  connect(
+    traffic_preview_slider,
+    &QSlider::valueChanged,
+    [this](const int value)
+    {
+      traffic_preview_seek(value / 10.0);
+    });
+  traffic_preview_toolbar->addWidget(traffic_preview_slider);
+  traffic_preview_time_label = new QLabel;
+  traffic_preview_time_label->setMinimumWidth(220);
+  traffic_preview_toolbar->addWidget(traffic_preview_time_label);
+  connect(
+    traffic_preview_toolbar->addAction("Next conflict"),
+    &QAction::triggered,
+    this,
+    &Editor::traffic_preview_next_conflict);
+  connect(
+    traffic_preview_toolbar->addAction("Close"),
+    &QAction::triggered,
+    this,
+    &Editor::close_traffic_preview);
+  addToolBar(Qt::BottomToolBarArea, traffic_preview_toolbar);
+  traffic_preview_toolbar->hide();
+
   ///////////////////////////////////////////////////////////
   // SET SIZE
   const int width =
@@ -444,6 +1349,11 @@ Editor::Editor()
 
 Editor::~Editor()
 {
+  // the delta of the last save is still to be written
+  change_delta_watcher->waitForFinished();
+
+  // free the recycled items while the application is still around
+  SceneItemPool::instance().clear();
 }
 
 void Editor::load_model_names()
@@ -486,28 +1396,129 @@ void Editor::load_model_names()
     settings.setValue(preferences_keys::thumbnail_path, thumbnail_path);
   }
 
-  QString model_list_path = QDir(thumbnail_path).filePath("model_list.yaml");
+  const QString model_list_path =
+    QDir(thumbnail_path).filePath("model_list.yaml");
 
-  YAML::Node y;
-  std::string filename(model_list_path.toStdString());
-  try
+  // parsing the YAML takes most of the startup; it's cached until it changes
+  double model_meters_per_pixel = 1.0;
+  std::vector<std::string> model_names;
+  if (!ModelCatalogCache::load(
+      model_list_path,
+      model_meters_per_pixel,
+      model_names))
+    return;
+
+  // On a reload, the entries which are the same as before keep their
+  // decoded pixmaps; only the models whose entry was added, removed or
+  // changed are drawn again.
+  const bool same_thumbnails = thumbnail_path == editor_models_thumbnail_path;
+  std::unordered_map<std::string, std::size_t> previous_indices;
+  for (std::size_t i = 0; i < editor_models.size(); i++)
+    previous_indices.emplace(editor_models[i].name, i);
+
+  std::vector<EditorModel> reloaded;
+  reloaded.reserve(model_names.size());
+  std::vector<bool> kept(editor_models.size(), false);
+  std::set<std::string> changed;
+  for (const std::string& model_name : model_names)
+  {
+    auto it = previous_indices.find(model_name);
+    if (same_thumbnails &&
+      it != previous_indices.end() &&
+      !kept[it->second] &&
+      editor_models[it->second].meters_per_pixel == model_meters_per_pixel)
+    {
+      kept[it->second] = true;
+      continue;
+    }
+    changed.insert(model_name);
+  }
+  for (std::size_t i = 0; i < editor_models.size(); i++)
+  {
+    if (!kept[i])
+      changed.insert(editor_models[i].name);
+  }
+  if (changed.empty() && editor_models.size() == model_names.size())
+    return;  // nothing to do, as after most changes of the preferences
+
+  const std::string hovered_model_name =
+    mouse_motion_editor_model ? mouse_motion_editor_model->name : "";
+  std::fill(kept.begin(), kept.end(), false);
+  for (const std::string& model_name : model_names)
+  {
+    auto it = previous_indices.find(model_name);
+    if (!changed.count(model_name) && !kept[it->second])
+    {
+      kept[it->second] = true;
+      reloaded.push_back(std::move(editor_models[it->second]));
+    }
+    else
+      reloaded.emplace_back(model_name, model_meters_per_pixel);
+  }
+
+  // the same vector, as the ThumbnailLoader holds on to it
+  editor_models.swap(reloaded);
+  editor_models_thumbnail_path = thumbnail_path;
+  editor_model_index.build(editor_models);
+  resolve_editor_models();
+  if (mouse_motion_editor_model)
   {
-    y = YAML::LoadFile(filename);
+    const int idx = editor_model_index.find(hovered_model_name);
+    mouse_motion_editor_model = idx < 0 ? nullptr : &editor_models[idx];
   }
-  catch (const std::exception& e)
+  refresh_models(changed);
+}
+
+void Editor::refresh_models(const std::set<std::string>& model_names)
+{
+  // the new thumbnails are decoded in the background, and swapped in by
+  // thumbnail_loaded(); meanwhile the models show the placeholder
+  prefetch_thumbnails();
+
+  std::vector<int> stale_levels;
+  for (const CachedScene& cached : cached_scenes)
   {
-    qWarning("couldn't parse %s: %s", filename.c_str(), e.what());
+    for (const Model& model : building.levels[cached.level_idx].models)
+    {
+      if (model_names.count(model.model_name))
+      {
+        stale_levels.push_back(cached.level_idx);
+        break;
+      }
+    }
+  }
+  for (const int idx : stale_levels)
+    drop_cached_scene(idx);
+
+  if (level_idx < 0 || level_idx >= static_cast<int>(building.levels.size()))
     return;
+  Level& level = building.levels[level_idx];
+  std::vector<Level::SelectedItem> undrawn;
+  for (std::size_t i = 0; i < level.models.size(); i++)
+  {
+    Model& model = level.models[i];
+    if (!model_names.count(model.model_name))
+      continue;
+    if (model.pixmap_item)
+      model.refresh_pixmap(editor_models, level.drawing_meters_per_pixel);
+    if (!model.pixmap_item)
+      undrawn.push_back(
+        Level::make_selected_item(Level::MODEL, static_cast<int>(i)));
+    level.mark_moved(Level::MODEL, static_cast<int>(i));
   }
-  qInfo("parsed %s successfully", filename.c_str());
 
-  const double model_meters_per_pixel = y["meters_per_pixel"].as<double>();
-  const YAML::Node ym = y["models"];
-  editor_models.reserve(y["models"].size());
-  for (YAML::const_iterator it = ym.begin(); it != ym.end(); ++it)
-    editor_models.emplace_back(
-      it->as<std::string>(),
-      model_meters_per_pixel);
+  // those which had no thumbnail before may have one now
+  if (!undrawn.empty() && scene)
+    update_scene(undrawn);
+}
+
+void Editor::resolve_editor_models()
+{
+  for (Level& level : building.levels)
+  {
+    for (Model& model : level.models)
+      model.resolve_editor_model(editor_models, &editor_model_index);
+  }
 }
 
 QToolButton* Editor::create_tool_button(
@@ -540,13 +1551,121 @@ Editor* Editor::get_instance()
   return instance;
 }
 
+namespace {
+
+/// How the preferences say a building is to be loaded
+void set_load_options(Building& building)
+{
+  QSettings settings;
+  building.use_cache =
+    settings.value(preferences_keys::building_cache, false).toBool();
+  building.lazy_images =
+    settings.value(preferences_keys::lazy_level_images, false).toBool();
+  building.stream_parser =
+    settings.value(preferences_keys::stream_yaml_parser, false).toBool();
+  building.drawing_preview_size =
+    settings.value(preferences_keys::drawing_preview_size, 2048).toInt();
+}
+
+}  // namespace
+
 bool Editor::load_building(const QString& filename)
 {
   const QString absolute_path = QFileInfo(filename).absoluteFilePath();
-  if (!building.load(absolute_path.toStdString()))
+  set_load_options(building);
+  reset_building_state();
+  const bool loaded = building.load(absolute_path.toStdString());
+  // the previous building and the YAML tree are gone
+  Heap::release_free_memory();
+  if (!loaded)
     return false;
+  show_loaded_building(absolute_path);
+  return true;
+}
+
+void Editor::load_building_async(
+  const QString& filename,
+  const bool restore_viewport)
+{
+  if (building_load_watcher->isRunning())
+    return;
+
+  loading_path = QFileInfo(filename).absoluteFilePath();
+  loading_restores_viewport = restore_viewport;
+  loading_building = std::make_shared<Building>();
+  set_load_options(*loading_building);
+
+  // no cancel button: Building::load() can't be interrupted
+  building_load_progress = new QProgressDialog(
+    QString("Loading %1...").arg(QFileInfo(loading_path).fileName()),
+    QString(),
+    0,
+    0,
+    this);
+  building_load_progress->setWindowModality(Qt::WindowModal);
+  building_load_progress->setMinimumDuration(250);
+
+  const std::shared_ptr<Building> target = loading_building;
+  const std::string path = loading_path.toStdString();
+  building_load_watcher->setFuture(
+    TaskPool::instance().run(
+      TaskPool::INTERACTIVE,
+      [target, path]() { return target->load(path); }));
+}
+
+void Editor::building_loaded()
+{
+  building_load_progress->deleteLater();
+  building_load_progress = nullptr;
+  std::shared_ptr<Building> loaded;
+  loaded.swap(loading_building);
+
+  if (!loaded || !building_load_watcher->result())
+  {
+    QMessageBox::critical(
+      this,
+      "Unable to open building",
+      QString("Unable to load %1").arg(loading_path));
+    if (loading_restores_viewport)
+      restore_previous_viewport();
+    return;
+  }
+
+  reset_building_state();
+
+  // the crowd_sim table edits the configuration object of the building,
+  // so keep that one, as a load() into this building would
+  if (building.crowd_sim_impl && loaded->crowd_sim_impl)
+  {
+    *building.crowd_sim_impl = *loaded->crowd_sim_impl;
+    loaded->crowd_sim_impl = building.crowd_sim_impl;
+  }
+
+  // nothing of the empty building may stay in the scene
+  drop_cached_scenes();
+  building.detach_cached_items(scene);
+  building.clear_scene();
+  building.swap(*loaded);
+
+  show_loaded_building(loading_path);
+  if (loading_restores_viewport)
+    restore_previous_viewport();
+}
+
+void Editor::show_loaded_building(const QString& absolute_path)
+{
+  QSettings settings;
+
+  // a building that is already split stays that way
+  if (settings.value(preferences_keys::split_building_files, false).toBool())
+    building.split_files = true;
 
   level_idx = 0;
+  level_snapshots.clear();
+  shown_levels.clear();
+  drawing_decode_failures.clear();
+  minimap_rasters.clear();
+  ++minimap_generation;
 
   if (!building.levels.empty())
   {
@@ -556,16 +1675,229 @@ bool Editor::load_building(const QString& filename)
     previous_mouse_point = QPointF(level.drawing_width, level.drawing_height);
   }
 
-  create_scene();
+  // the edits of an editor that crashed with the building open, before
+  // anything is drawn or indexed
+  EditJournal::Contents journal;
+  const bool recovered = recover_edit_journal(journal);
+
+  // look up every model once, rather than every time it is drawn
+  resolve_editor_models();
+
+  // start decoding the thumbnails while the first level is being prepared
+  prefetch_thumbnails();
+
+  create_scene_async();
+  decode_next_drawing();
 
   update_tables();
+  validator.clear();
+  update_issue_list();
+  name_index->clear();
+  name_index->update(building);  // in the background, ready for Go to
 
-  QSettings settings;
   settings.setValue(preferences_keys::previous_building_path, absolute_path);
 
+  setWindowModified(recovered);
+  update_document_tab();
+  watch_building_files();
+  if (!recovered)
+    remember_saved_building();  // as it was replayed onto, otherwise
+  snapshot_timer->start();
+  start_edit_journal(recovered ? &journal : nullptr);
+}
+
+void Editor::watch_building_files()
+{
+  if (QSettings().value(preferences_keys::watch_files, true).toBool())
+    file_watcher->watch(building);
+  else
+    file_watcher->clear();
+}
+
+void Editor::building_changed_on_disk()
+{
+  const QString path = QString::fromStdString(building.get_filename());
+  if (path.isEmpty())
+    return;
+
+  // come back once the building is no longer being worked on
+  if (building_load_watcher->isRunning() ||
+    layer_solve_watcher->isRunning() ||
+    joint_solve_watcher->isRunning())
+  {
+    QTimer::singleShot(1000, this, &Editor::building_changed_on_disk);
+    return;
+  }
+
+  if (isWindowModified() &&
+    QMessageBox::question(
+      this,
+      "Building changed on disk",
+      QString("%1 was changed by another program. Reload it, and lose the "
+      "edits made since it was saved?").arg(path)) != QMessageBox::Yes)
+    return;
+
+  TRACE_ZONE("Editor::building_changed_on_disk");
+  QElapsedTimer timer;
+  timer.start();
+
+  // no images are decoded by the load: those of the levels are taken from
+  // this building where their files are the same, or decoded when shown
+  Building reloaded;
+  set_load_options(reloaded);
+  const bool lazy_images = reloaded.lazy_images;
+  reloaded.lazy_images = true;
+  const QString current_dir = QDir::currentPath();
+  const bool loaded = reloaded.load(path.toStdString());
+  QDir::setCurrent(current_dir);  // the images are found relative to it
+  reloaded.lazy_images = lazy_images;
+  if (!loaded)
+  {
+    statusBar()->showMessage("Unable to reload " + path, 5000);
+    return;
+  }
+  if (reloaded.content_hash() == building.content_hash())
+  {
+    watch_building_files();  // it was written, but nothing changed
+    return;
+  }
+  reloaded.split_files = reloaded.split_files || building.split_files;
+
+  BuildingDiff diff;
+  diff.compute(building, reloaded);
+
+  const std::string active_level_name =
+    level_idx >= 0 && level_idx < static_cast<int>(building.levels.size()) ?
+    building.levels[level_idx].name : std::string();
+
+  // nothing may point into the previous version of the building
+  reset_building_state();
+  clear_current_tool_buffer();
+  remove_mouse_motion_item();
+  selected_polygon = nullptr;
+  clicked_idx = -1;
+  prev_clicked_idx = -1;
+  clear_property_editor();
+  undo_stack->clear();
+  undo_budget->reset();
+  drop_cached_scenes();
+  building.detach_cached_items(scene);
+  scene->clear();
+  building.clear_scene();
+
+  int num_kept = 0;
+  for (Level& level : reloaded.levels)
+  {
+    const int idx = building.find_level_idx(level.name);
+    if (idx < 0)
+      continue;
+    Level& previous = building.levels[idx];
+    if (previous.content_hashes().level == level.content_hashes().level)
+    {
+      std::swap(level, previous);
+      num_kept++;
+    }
+    else
+      level.take_images(previous);
+  }
+
+  // the crowd_sim table edits the configuration object of the building
+  if (building.crowd_sim_impl && reloaded.crowd_sim_impl)
+  {
+    *building.crowd_sim_impl = *reloaded.crowd_sim_impl;
+    reloaded.crowd_sim_impl = building.crowd_sim_impl;
+  }
+  building.swap(reloaded);
+  reloaded.clear();
+
+  level_idx = std::max(0, building.find_level_idx(active_level_name));
+  if (level_idx >= static_cast<int>(building.levels.size()))
+    level_idx = 0;
+  level_snapshots.clear();
+  shown_levels.clear();
+  drawing_decode_failures.clear();
+  minimap_rasters.clear();
+  ++minimap_generation;
+
+  resolve_editor_models();
+  prefetch_thumbnails();
+  create_scene();
+  decode_next_drawing();
+  update_tables();
+  level_table->setCurrentCell(level_idx, 0);
+  validator.clear();
+  update_issue_list();
+  name_index->update(building);
   setWindowModified(false);
+  watch_building_files();
+  remember_saved_building();  // another program's save is the new base
+  snapshot_timer->start();
+  start_edit_journal(nullptr);
+
+  int added = 0;
+  int removed = 0;
+  int moved = 0;
+  int changed = 0;
+  for (const BuildingDiff::LevelDiff& level : diff.levels)
+  {
+    added += level.count(BuildingDiff::ADDED);
+    removed += level.count(BuildingDiff::REMOVED);
+    moved += level.count(BuildingDiff::MOVED);
+    changed += level.count(BuildingDiff::CHANGED);
+  }
+  statusBar()->showMessage(
+    QString::asprintf(
+      "Reloaded %s in %lld ms: %d levels unchanged, %d entities added, "
+      "%d removed, %d moved and %d changed",
+      qUtf8Printable(QFileInfo(path).fileName()),
+      static_cast<long long>(timer.elapsed()),
+      num_kept,
+      added,
+      removed,
+      moved,
+      changed),
+    10000);
+}
 
-  return true;
+void Editor::image_changed_on_disk(
+  const QString& level_name,
+  const int image_layer_idx)
+{
+  const int idx = building.find_level_idx(level_name.toStdString());
+  if (idx < 0)
+    return;
+  Level& level = building.levels[idx];
+  if (image_layer_idx < 0)
+    drawing_decode_failures.erase(level.drawing_filename);
+  level.unload_image(image_layer_idx);
+
+  // the cached scene and the rasters of the level show the old image
+  drop_cached_scene(idx);
+  level_snapshots.erase(idx);
+  minimap_rasters.erase(idx);
+  ++minimap_generation;
+  if (idx == level_idx)
+    create_scene();
+
+  const std::string filename =
+    image_layer_idx < 0 ? level.drawing_filename :
+    image_layer_idx < static_cast<int>(level.layers.size()) ?
+    level.layers[image_layer_idx].filename : std::string();
+  statusBar()->showMessage(
+    QString("Reloaded %1").arg(QString::fromStdString(filename)),
+    5000);
+}
+
+void Editor::prefetch_thumbnails()
+{
+  // those decoded for another building are already in editor_models
+  std::set<std::string> model_names;
+  for (const Level& level : building.levels)
+  {
+    for (const Model& model : level.models)
+      model_names.insert(model.model_name);
+  }
+  thumbnail_loader->prefetch(model_names);
 }
 
 void Editor::restore_previous_viewport()
@@ -612,7 +1944,7 @@ void Editor::restore_previous_viewport()
   if (isnan(viewport_scale))
     viewport_scale = 1.0;
 
-  printf("restoring viewport: (%.1f, %.1f, %3f)\n",
+  qCDebug(lc_draw, "restoring viewport: (%.1f, %.1f, %3f)",
     viewport_center_x,
     viewport_center_y,
     viewport_scale);
@@ -623,22 +1955,20 @@ void Editor::restore_previous_viewport()
   t.scale(viewport_scale, y_flip * viewport_scale);
   map_view->setTransform(t);
   map_view->centerOn(QPointF(viewport_center_x, viewport_center_y));
+  map_view->update_level_of_detail();
 }
 
-bool Editor::load_previous_building()
+QString Editor::previous_building_path()
 {
-  QSettings settings;
-  const QString filename(
-    settings.value(preferences_keys::previous_building_path).toString());
-  if (!filename.isEmpty())
-    return load_building(filename);
-  return true;
+  return QSettings().value(
+    preferences_keys::previous_building_path).toString();
 }
 
 void Editor::building_new()
 {
   QFileDialog dialog(this, "New Building");
-  dialog.setNameFilter("*.building.yaml");
+  dialog.setNameFilter(
+    "*.building.yaml *.building.yaml.gz *.building.yaml.zst");
   dialog.setDefaultSuffix(".building.yaml");
   dialog.setAcceptMode(QFileDialog::AcceptMode::AcceptSave);
   dialog.setConfirmOverwrite(true);
@@ -649,6 +1979,7 @@ void Editor::building_new()
   QFileInfo file_info(dialog.selectedFiles().first());
   std::string fn = file_info.fileName().toStdString();
 
+  reset_building_state();
   building.clear();
   building.set_filename(file_info.absoluteFilePath().toStdString());
   QString dir_path = file_info.dir().path();
@@ -657,6 +1988,7 @@ void Editor::building_new()
   create_scene();
   building_save();
   update_tables();
+  update_document_tab();
 
   QSettings settings;
   settings.setValue(
@@ -664,14 +1996,15 @@ void Editor::building_new()
     QString::fromStdString(building.get_filename()));
 }
 
-void Editor::building_open()
+QString Editor::building_open_dialog()
 {
   QFileDialog file_dialog(this, "Open Building");
   file_dialog.setFileMode(QFileDialog::ExistingFile);
-  file_dialog.setNameFilter("*.building.yaml");
+  file_dialog.setNameFilter(
+    "*.building.yaml *.building.yaml.gz *.building.yaml.zst");
 
   if (file_dialog.exec() != QDialog::Accepted)
-    return;
+    return QString();
 
   QFileInfo file_info(file_dialog.selectedFiles().first());
   if (!file_info.exists())
@@ -680,125 +2013,6308 @@ void Editor::building_open()
       this,
       "File does not exist",
       "File does not exist. Cannot open file.");
-    return;
+    return QString();
   }
-  load_building(file_info.filePath());
+  return file_info.filePath();
 }
 
-bool Editor::building_save()
+void Editor::building_open()
 {
-  if (!building.save())
-  {
-    QMessageBox::critical(
-      this,
-      "Unable to save",
-      "Save failed! Maybe a bad path?");
-    return false;
-  }
-  setWindowModified(false);
-  return true;
+  const QString filename = building_open_dialog();
+  if (!filename.isEmpty())
+    load_building(filename);
 }
 
-bool Editor::building_export_features()
+void Editor::building_open_tab()
 {
-  QFileDialog dialog(this, "Export layer alignment points for level");
-  dialog.setNameFilter("*.yaml");
-  dialog.setDefaultSuffix(".yaml");
-  dialog.setAcceptMode(QFileDialog::AcceptMode::AcceptSave);
-  dialog.setConfirmOverwrite(true);
-
-  if (dialog.exec() != QDialog::Accepted)
-    return true;
+  const QString filename = building_open_dialog();
+  if (filename.isEmpty())
+    return;
 
-  QFileInfo file_info(dialog.selectedFiles().first());
-  auto result = building.export_features(
-    level_idx,
-    file_info.absoluteFilePath().toStdString());
-  setWindowModified(false);
-  return result;
-}
+  // a building which is already open is only brought to the front
+  const std::string path = QFileInfo(filename).absoluteFilePath().toStdString();
+  for (int i = 0; i < workspace.count(); i++)
+  {
+    const std::string open_path = i == workspace.active() ?
+      building.get_filename() : workspace.document(i).building.get_filename();
+    if (open_path == path)
+    {
+      switch_document(i);
+      return;
+    }
+  }
 
-void Editor::help_about()
-{
-  QMessageBox::about(this, "About", "Welcome to the Traffic Editor");
-}
+  // an empty, untitled tab is used rather than left behind
+  const int previous_idx = workspace.active();
+  if (!building.get_filename().empty() || !building.levels.empty())
+    switch_document(add_document());
 
-void Editor::edit_undo()
-{
-  undo_stack.undo();
-  if (
-    tool_id == TOOL_ADD_LANE
-    || tool_id == TOOL_ADD_WALL)
+  if (!load_building(filename) && workspace.active() != previous_idx)
   {
-    clicked_idx = -1;
-    prev_clicked_idx = -1;
+    const int failed_idx = workspace.active();
+    switch_document(previous_idx);
+    remove_document(failed_idx);
+    statusBar()->showMessage(
+      QString("Unable to open %1").arg(filename), 5000);
   }
-  create_scene();
-  update_property_editor();
-  setWindowModified(true);
 }
 
-void Editor::edit_redo()
+void Editor::building_close_tab()
 {
-  undo_stack.redo();
-  create_scene();
-  setWindowModified(true);
+  close_document(workspace.active());
 }
 
-void Editor::edit_preferences()
+int Editor::add_document()
 {
-  PreferencesDialog preferences_dialog(this);
+  const std::size_t undo_budget_bytes = static_cast<std::size_t>(
+    QSettings().value(preferences_keys::undo_memory_mb, 256).toInt()) *
+    1024 * 1024;
+  const int idx = workspace.add(undo_budget_bytes);
+
+  // edits only ever touch the active level, so only its raster is stale.
+  // Only the stack of the active document is ever pushed to, but the
+  // others still signal when they're cleared as their tab is closed.
+  QUndoStack* stack = &workspace.document(idx).undo_stack;
+  connect(
+    stack,
+    &QUndoStack::indexChanged,
+    this,
+    [this, stack]()
+    {
+      if (stack != undo_stack)
+        return;
+      level_snapshots.erase(level_idx);
+      drop_cached_scenes();
+
+      // converting the coordinate system (or undoing it) can turn the y
+      // axis over, and moves every level
+      const bool view_y_flipped = map_view->transform().m22() > 0.0;
+      if (view_y_flipped != building.coordinate_system.is_y_flipped())
+      {
+        map_view->scale(1.0, -1.0);
+        level_snapshots.clear();
+      }
+      invalidate_minimap();
+      if (level_idx < static_cast<int>(building.levels.size()))
+        building.levels[level_idx].invalidate_saved_yaml();
+      enforce_undo_budget();
+      snapshot_timer->start();
+      if (edit_sync)
+        edit_sync->send();
+      if (edit_journal().is_open())
+        edit_journal().record(
+          building,
+          snapshot_publisher.publish(building));
+    });
+
+  const QSignalBlocker blocker(workspace_tab_bar);
+  workspace_tab_bar->addTab(Workspace::title(std::string()));
+  workspace_tab_bar->setTabsClosable(workspace.count() > 1);
+  return idx;
+}
+
+void Editor::switch_document(const int idx)
+{
+  const int previous_idx = workspace.active();
+  if (idx == previous_idx || idx < 0 || idx >= workspace.count())
+    return;
+
+  // the result of an optimization applies to the levels it was started on
+  if (layer_solve_watcher->isRunning() || joint_solve_watcher->isRunning())
+  {
+    const QSignalBlocker blocker(workspace_tab_bar);
+    workspace_tab_bar->setCurrentIndex(previous_idx);
+    return;
+  }
+  TRACE_ZONE("Editor::switch_document");
+
+  // nothing that points into the building may outlive its tab
+  reset_building_state();
+  clear_current_tool_buffer();
+  remove_mouse_motion_item();
+  selected_polygon = nullptr;
+  clicked_idx = -1;
+  prev_clicked_idx = -1;
+  clear_property_editor();
+
+  if (previous_idx >= 0)
+  {
+    Workspace::Document& parked = workspace.document(previous_idx);
+    parked.modified = isWindowModified();
+    parked.level_idx = level_idx;
+    parked.layer_idx = layer_idx;
+    parked.has_view = true;
+    parked.view_transform = map_view->transform();
+    parked.view_center =
+      map_view->mapToScene(map_view->viewport()->rect().center());
+    parked.level_snapshots.swap(level_snapshots);
+    parked.shown_levels.swap(shown_levels);
+
+    // the cached graphics of the building go with it, out of the scene
+    drop_cached_scenes();
+    building.detach_cached_items(scene);
+    scene->clear();
+    building.clear_scene();
+    parked.building.swap(building);
+  }
+
+  Workspace::Document& document = workspace.document(idx);
+  building.swap(document.building);
+  workspace.set_active(idx);
+  undo_stack = &document.undo_stack;
+  undo_budget = &document.undo_budget;
+  level_snapshots.swap(document.level_snapshots);
+  shown_levels.swap(document.shown_levels);
+  minimap_rasters.clear();  // the level names of the other building
+  ++minimap_generation;
+  level_idx = document.level_idx;
+  if (level_idx >= static_cast<int>(building.levels.size()))
+    level_idx = 0;
+  layer_idx = document.layer_idx;
+
+  // the images of a building are found relative to its directory
+  if (!building.get_filename().empty())
+    QDir::setCurrent(
+      QFileInfo(QString::fromStdString(building.get_filename())).path());
+
+  {
+    const QSignalBlocker blocker(workspace_tab_bar);
+    workspace_tab_bar->setCurrentIndex(idx);
+  }
+
+  // its levels kept their images and graphics, so this is quick
+  if (!building.levels.empty())
+  {
+    const Level& level = building.levels[level_idx];
+    scene->setSceneRect(
+      QRectF(0, 0, level.drawing_width, level.drawing_height));
+  }
+  create_scene();
+  if (document.has_view)
+  {
+    map_view->setTransform(document.view_transform);
+    map_view->centerOn(document.view_center);
+    map_view->update_level_of_detail();
+  }
+
+  update_tables();
+  level_table->setCurrentCell(level_idx, 0);
+  validator.clear();
+  update_issue_list();
+  name_index->clear();
+  param_index.clear();
+  enforce_undo_budget();  // shows the memory used by this undo stack
+  setWindowModified(document.modified);
+
+  // in case they were canceled by a building opened in another tab
+  prefetch_thumbnails();
+  decode_next_drawing();
+  watch_building_files();
+  snapshot_timer->start();
+}
+
+bool Editor::close_document(const int idx)
+{
+  if (workspace.count() < 2 || idx < 0 || idx >= workspace.count())
+    return false;
+
+  switch_document(idx);
+  if (workspace.active() != idx || !maybe_save())
+    return false;
+
+  // don't let an autosave of the building write after it has gone
+  autosave_watcher->waitForFinished();
+
+  switch_document(idx + 1 < workspace.count() ? idx + 1 : idx - 1);
+  remove_document(idx);
+  return true;
+}
+
+void Editor::remove_document(const int idx)
+{
+  if (idx == workspace.active())
+    return;
+  workspace.remove(idx);
+  Heap::release_free_memory();
+
+  const QSignalBlocker blocker(workspace_tab_bar);
+  workspace_tab_bar->removeTab(idx);
+  workspace_tab_bar->setCurrentIndex(workspace.active());
+  workspace_tab_bar->setTabsClosable(workspace.count() > 1);
+}
+
+void Editor::update_document_tab()
+{
+  const QString filename = QString::fromStdString(building.get_filename());
+  workspace_tab_bar->setTabText(
+    workspace.active(),
+    Workspace::title(building.get_filename()));
+  workspace_tab_bar->setTabToolTip(workspace.active(), filename);
+}
+
+void Editor::set_modified()
+{
+  // edits are made on the active level, which will have to be serialized
+  // again, even if the edit didn't go through its mark_changed()
+  if (level_idx < static_cast<int>(building.levels.size()))
+    building.levels[level_idx].invalidate_saved_yaml();
+  drop_cached_scenes();  // the edit may show on the other levels too
+  invalidate_minimap();
+  setWindowModified(true);
+}
+
+bool Editor::building_save()
+{
+  // don't save the poses of a replay
+  view_close_recording();
+
+  if (!building.save())
+  {
+    QMessageBox::critical(
+      this,
+      "Unable to save",
+      "Save failed! Maybe a bad path?");
+    return false;
+  }
+  setWindowModified(false);
+  watch_building_files();  // so that this save isn't taken for another's
+  publish_change_delta();
+  start_edit_journal(nullptr);  // of the edits since this save
+
+  // don't let an autosave that is still running overwrite the cleanup
+  autosave_watcher->waitForFinished();
+  const QString autosave_path = autosave_filename();
+  if (!autosave_path.isEmpty())
+  {
+    QFile::remove(autosave_path);
+    QDir(Building::split_dir(autosave_path.toStdString())).removeRecursively();
+  }
+  return true;
+}
+
+QString Editor::autosave_filename()
+{
+  const std::string filename = building.get_filename();
+  if (filename.empty())
+    return QString();
+  return QString::fromStdString(filename) + ".autosave";
+}
+
+void Editor::autosave()
+{
+  if (!isWindowModified() || autosave_watcher->isRunning())
+    return;
+
+  const QString path = autosave_filename();
+  if (path.isEmpty())
+    return;
+
+  // only the levels edited since the last snapshot are copied on this
+  // thread; the copy to save, the serialization and the disk writes
+  // happen on a worker
+  std::shared_ptr<const BuildingSnapshot> snapshot =
+    snapshot_publisher.publish(building);
+  const std::string path_str = path.toStdString();
+  autosave_watcher->setFuture(
+    TaskPool::instance().run(
+      TaskPool::BACKGROUND,
+      [snapshot, path_str]()
+      {
+        return snapshot->to_building()->save_to(path_str);
+      }));
+}
+
+void Editor::remember_saved_building()
+{
+  Workspace::Document& document = workspace.document(workspace.active());
+  if (QSettings().value(preferences_keys::change_deltas, false).toBool())
+    document.saved_snapshot = snapshot_publisher.publish(building);
+  else
+    document.saved_snapshot.reset();
+}
+
+EditJournal& Editor::edit_journal()
+{
+  return workspace.document(workspace.active()).journal;
+}
+
+bool Editor::recover_edit_journal(EditJournal::Contents& contents)
+{
+  // a journal of this document is of a building whose edits were just
+  // discarded, even if it is this one opened again
+  edit_journal().close();
+
+  const QString path = EditJournal::filename(building.get_filename());
+  if (building.get_filename().empty() ||
+    !QSettings().value(preferences_keys::edit_journal, true).toBool() ||
+    !EditJournal::read(path, contents) ||
+    contents.records.empty())
+    return false;
+
+  if (QMessageBox::question(
+      this,
+      "Recover edits",
+      QString("The editor was closed with %1 unsaved edits to %2. Recover "
+      "them?").arg(contents.records.size()).arg(
+        QString::fromStdString(building.get_filename()))) !=
+    QMessageBox::Yes)
+    return false;
+
+  // the change delta of the next save is of the file, not of the recovery
+  remember_saved_building();
+  const int num_conflicts = EditJournal::replay(contents, building);
+  if (num_conflicts < 0)
+  {
+    QMessageBox::warning(
+      this,
+      "Recover edits",
+      "The building was changed since the edits were made, so they can't "
+      "be recovered.");
+    return false;
+  }
+
+  QString message = QString("Recovered %1 edits").arg(contents.records.size());
+  if (num_conflicts > 0)
+    message += QString(", except for %1 entities").arg(num_conflicts);
+  if (contents.num_unrecorded > 0)
+  {
+    message += QString(", without %1 changes to layers, lifts or "
+      "constraints").arg(contents.num_unrecorded);
+  }
+  statusBar()->showMessage(message, 10000);
+  qCInfo(lc_io, "%s", qUtf8Printable(message));
+  return true;
+}
+
+void Editor::start_edit_journal(const EditJournal::Contents* recovered)
+{
+  if (!QSettings().value(preferences_keys::edit_journal, true).toBool())
+  {
+    edit_journal().close();
+    return;
+  }
+  const std::shared_ptr<const BuildingSnapshot> snapshot =
+    snapshot_publisher.publish(building);
+  if (recovered)
+    edit_journal().resume(building, *recovered, snapshot);
+  else
+    edit_journal().start(building, snapshot);
+}
+
+void Editor::publish_change_delta()
+{
+  Workspace::Document& document = workspace.document(workspace.active());
+  std::shared_ptr<const BuildingSnapshot> before = document.saved_snapshot;
+  remember_saved_building();
+  const std::shared_ptr<const BuildingSnapshot> after =
+    document.saved_snapshot;
+  if (!before || !after || before->filename != after->filename)
+    return;  // nothing to compare with, or saved under another name
+
+  // deltas must reach the file and the socket in the order of the saves
+  change_delta_watcher->waitForFinished();
+
+  const std::uint64_t sequence = ++document.delta_sequence;
+  const QString path = ChangeDelta::filename(after->filename);
+  change_delta_watcher->setFuture(
+    TaskPool::instance().run(
+      TaskPool::BACKGROUND,
+      [before, after, sequence, path]()
+      {
+        const QByteArray json = QJsonDocument(
+          ChangeDelta::compute(*before, *after, sequence)).toJson(
+          QJsonDocument::Compact);
+        if (!ChangeDelta::save(path, json))
+          qCWarning(lc_io, "unable to write %s", qUtf8Printable(path));
+        return json;
+      }));
+}
+
+void Editor::change_delta_written()
+{
+  const QString name = QSettings().value(
+    preferences_keys::change_delta_socket,
+    QString()).toString();
+  if (!change_delta_server)
+  {
+    if (name.isEmpty())
+      return;
+    change_delta_server = std::make_unique<ChangeDelta::Server>(this);
+  }
+  if (change_delta_server->listen(name) && !name.isEmpty())
+    change_delta_server->send(change_delta_watcher->result());
+}
+
+void Editor::start_edit_sync()
+{
+  edit_sync = std::make_unique<EditSync>(this, building, snapshot_publisher);
+  edit_sync->set_status_callback(
+    [this](const QString& message)
+    {
+      statusBar()->showMessage(message);
+    });
+  edit_sync->set_changed_callback(
+    [this](const bool reset_undo)
+    {
+      // the commands on the stack find what they change by index
+      if (reset_undo)
+        undo_stack->clear();
+      drop_cached_scenes();
+      invalidate_minimap();
+      setWindowModified(true);
+      schedule_undo_redraw();
+      if (edit_journal().is_open())
+        edit_journal().record(
+          building,
+          snapshot_publisher.publish(building));
+    });
+}
+
+void Editor::building_share_host()
+{
+  QSettings settings;
+  bool ok = false;
+  const int port = QInputDialog::getInt(
+    this,
+    "Share editing",
+    "Let other editors join on port:",
+    settings.value(
+      preferences_keys::edit_sync_port,
+      EditSync::DEFAULT_PORT).toInt(),
+    1,
+    65535,
+    1,
+    &ok);
+  if (!ok)
+    return;
+  settings.setValue(preferences_keys::edit_sync_port, port);
+  start_edit_sync();
+  if (!edit_sync->host(port))
+    edit_sync.reset();
+}
+
+void Editor::building_share_join()
+{
+  QSettings settings;
+  bool ok = false;
+  const QString address = QInputDialog::getText(
+    this,
+    "Join shared editing",
+    "Address and port of the editor sharing this building:",
+    QLineEdit::Normal,
+    settings.value(
+      preferences_keys::edit_sync_address,
+      QString("localhost:%1").arg(EditSync::DEFAULT_PORT)).toString(),
+    &ok).trimmed();
+  if (!ok || address.isEmpty())
+    return;
+
+  const int colon = address.lastIndexOf(':');
+  const int port =
+    colon > 0 ? address.mid(colon + 1).toInt() : EditSync::DEFAULT_PORT;
+  if (port <= 0 || port > 65535)
+  {
+    QMessageBox::critical(
+      this,
+      "Join shared editing",
+      "Please give the address as host:port");
+    return;
+  }
+  settings.setValue(preferences_keys::edit_sync_address, address);
+  start_edit_sync();
+  edit_sync->join(colon > 0 ? address.left(colon) : address, port);
+}
+
+void Editor::building_share_stop()
+{
+  if (!edit_sync)
+    return;
+  edit_sync.reset();
+  statusBar()->showMessage("Stopped sharing editing");
+}
+
+void Editor::publish_snapshot()
+{
+  TRACE_ZONE("Editor::publish_snapshot");
+  const std::shared_ptr<const BuildingSnapshot> snapshot =
+    snapshot_publisher.publish(building);
+  qCDebug(lc_edit, "snapshot %llu: copied %d of %zu levels",
+    static_cast<unsigned long long>(snapshot->version),
+    snapshot_publisher.num_copied(),
+    snapshot->levels.size());
+  level_thumbnails->update(snapshot);
+}
+
+void Editor::autosave_finished()
+{
+  if (autosave_watcher->result())
+    statusBar()->showMessage(
+      QString("Autosaved to %1").arg(autosave_filename()), 5000);
+  else
+    statusBar()->showMessage("Autosave failed!", 5000);
+}
+
+bool Editor::building_export_features()
+{
+  QFileDialog dialog(this, "Export layer alignment points for level");
+  dialog.setNameFilters(QStringList() << "*.yaml" << "*.csv");
+  dialog.setDefaultSuffix(".yaml");
+  dialog.setAcceptMode(QFileDialog::AcceptMode::AcceptSave);
+  dialog.setConfirmOverwrite(true);
+
+  if (dialog.exec() != QDialog::Accepted)
+    return true;
+
+  QFileInfo file_info(dialog.selectedFiles().first());
+  if (!building.export_features(
+      level_idx,
+      file_info.absoluteFilePath().toStdString()))
+  {
+    QMessageBox::critical(
+      this,
+      "Unable to export",
+      "Unable to write " + file_info.absoluteFilePath());
+    return false;
+  }
+  return true;
+}
+
+void Editor::building_export_all_features()
+{
+  if (export_features_watcher->isRunning())
+  {
+    statusBar()->showMessage("The features are still being exported", 5000);
+    return;
+  }
+
+  const QString dir = QFileDialog::getExistingDirectory(
+    this,
+    "Export layer alignment points for all levels",
+    QFileInfo(QString::fromStdString(building.get_filename())).absolutePath());
+  if (dir.isEmpty())
+    return;
+
+  const QString prefix = QDir(dir).filePath(
+    QFileInfo(QString::fromStdString(building.get_filename())).baseName() +
+    "_");
+
+  // written from a snapshot, so that editing can go on in the meantime
+  const std::shared_ptr<const BuildingSnapshot> snapshot =
+    snapshot_publisher.publish(building);
+  const std::string prefix_str = prefix.toStdString();
+  auto written = std::make_shared<std::vector<std::string>>();
+  auto progress = TaskPool::instance().track(
+    "Exporting features",
+    static_cast<int>(snapshot->levels.size()));
+  export_features_dir = dir;
+  export_features_written = written;
+  export_features_progress = progress;
+  export_features_watcher->setFuture(
+    TaskPool::instance().run(
+      TaskPool::BACKGROUND,
+      [snapshot, prefix_str, written, progress]()
+      {
+        const bool ok = snapshot->to_building()->export_all_features(
+          prefix_str,
+          ".yaml",
+          written.get(),
+          progress.get());
+        progress->finish();
+        return ok;
+      }));
+  update_task_status();
+}
+
+void Editor::export_all_features_finished()
+{
+  const bool canceled = export_features_progress->canceled();
+  const std::size_t num_written = export_features_written->size();
+  export_features_progress.reset();
+  export_features_written.reset();
+  update_task_status();
+
+  if (canceled)
+  {
+    statusBar()->showMessage(
+      QString("Canceled exporting the features, after %1 file(s)")
+      .arg(num_written),
+      5000);
+    return;
+  }
+  if (!export_features_watcher->result())
+  {
+    QMessageBox::critical(
+      this,
+      "Unable to export",
+      QString("Unable to export the features of all levels to %1")
+      .arg(export_features_dir));
+    return;
+  }
+  statusBar()->showMessage(
+    QString("Wrote %1 feature file(s) to %2")
+    .arg(num_written)
+    .arg(export_features_dir),
+    5000);
+}
+
+void Editor::update_task_status()
+{
+  const auto tasks = TaskPool::instance().active();
+  if (tasks.empty())
+  {
+    task_timer->stop();
+    task_label->hide();
+    task_cancel_button->hide();
+    return;
+  }
+
+  QStringList parts;
+  bool canceling = false;
+  for (const auto& task : tasks)
+  {
+    canceling = canceling || task->canceled();
+    if (task->total() > 0)
+      parts.append(
+        QString("%1 %2/%3")
+        .arg(task->name())
+        .arg(task->done())
+        .arg(task->total()));
+    else
+      parts.append(task->name() + "...");
+  }
+  task_label->setText(parts.join(", "));
+  task_label->show();
+  task_cancel_button->setEnabled(!canceling);
+  task_cancel_button->show();
+  if (!task_timer->isActive())
+    task_timer->start();
+}
+
+void Editor::building_merge()
+{
+  const QString filename = building_open_dialog();
+  if (filename.isEmpty())
+    return;
+
+  bool ok = false;
+  const double tolerance = QInputDialog::getDouble(
+    this,
+    "Merge building",
+    "Merge vertices closer than (meters):",
+    BuildingMerger::Options().tolerance,
+    0.0,
+    10.0,
+    3,
+    &ok);
+  if (!ok)
+    return;
+
+  QElapsedTimer timer;
+  timer.start();
+
+  // Building::load() moves into the directory of the building it loads,
+  // and only the sizes of the drawings are needed to merge it
+  const QString current_dir = QDir::currentPath();
+  const QFileInfo file_info(filename);
+  Building source;
+  source.lazy_images = true;
+  const bool loaded = source.load(file_info.absoluteFilePath().toStdString());
+  QDir::setCurrent(current_dir);
+
+  BuildingMerger::Options options;
+  options.tolerance = tolerance;
+  BuildingMerger::Result result;
+  if (!loaded ||
+    !BuildingMerger(options).prepare(
+      building,
+      source,
+      file_info.absolutePath(),
+      result))
+  {
+    QMessageBox::critical(
+      this,
+      "Unable to merge",
+      QString("Unable to load a building with levels from %1").arg(filename));
+    return;
+  }
+
+  if (!result.levels.empty())
+    undo_stack->push(new MergeBuildingCommand(&building, result.levels));
+
+  // like Level > Add, adding a level can't be undone
+  for (Level& level : result.new_levels)
+    building.add_level(std::move(level));
+
+  qCInfo(lc_edit, "merged %s in %lld ms",
+    qUtf8Printable(filename),
+    static_cast<long long>(timer.elapsed()));
+
+  resolve_editor_models();
+  prefetch_thumbnails();
+  update_tables();
+  create_scene();
+  set_modified();
+
+  QMessageBox::information(this, "Merge building", result.summary());
+}
+
+void Editor::building_convert_coordinates()
+{
+  QDialog dialog(this);
+  dialog.setWindowTitle("Convert coordinate system");
+  QFormLayout* layout = new QFormLayout(&dialog);
+  layout->addRow(
+    new QLabel(
+      QString("Reproject every level, now in %1, into:")
+      .arg(QString::fromStdString(building.coordinate_system.to_string()))));
+  QComboBox* target_box = new QComboBox;
+  for (const CoordinateSystem::Value value :
+    {CoordinateSystem::ReferenceImage,
+      CoordinateSystem::CartesianMeters,
+      CoordinateSystem::WebMercator})
+  {
+    if (value != building.coordinate_system.value)
+      target_box->addItem(
+        QString::fromStdString(CoordinateSystem(value).to_string()),
+        static_cast<int>(value));
+  }
+  layout->addRow("Coordinate system:", target_box);
+
+  QDoubleSpinBox* mpp_box = new QDoubleSpinBox;
+  mpp_box->setRange(0.0001, 100.0);
+  mpp_box->setDecimals(4);
+  mpp_box->setValue(CoordinateConversion::Options().meters_per_pixel);
+  layout->addRow("Meters per pixel:", mpp_box);
+
+  // where the origin of the building goes on the map
+  QDoubleSpinBox* latitude_box = new QDoubleSpinBox;
+  latitude_box->setRange(-85.0, 85.0);
+  QDoubleSpinBox* longitude_box = new QDoubleSpinBox;
+  longitude_box->setRange(-180.0, 180.0);
+  for (QDoubleSpinBox* box : {latitude_box, longitude_box})
+    box->setDecimals(7);
+  layout->addRow("Origin latitude:", latitude_box);
+  layout->addRow("Origin longitude:", longitude_box);
+
+  const auto target_changed = [=]()
+    {
+      const int value = target_box->currentData().toInt();
+      mpp_box->setEnabled(value == CoordinateSystem::ReferenceImage);
+      latitude_box->setEnabled(value == CoordinateSystem::WebMercator);
+      longitude_box->setEnabled(value == CoordinateSystem::WebMercator);
+    };
+  connect(
+    target_box,
+    QOverload<int>::of(&QComboBox::currentIndexChanged),
+    &dialog,
+    target_changed);
+  target_changed();
+
+  QDialogButtonBox* buttons =
+    new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+  connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+  connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+  layout->addRow(buttons);
+  if (dialog.exec() != QDialog::Accepted)
+    return;
+
+  CoordinateConversion::Options options;
+  options.target = CoordinateSystem(
+    static_cast<CoordinateSystem::Value>(target_box->currentData().toInt()));
+  options.meters_per_pixel = mpp_box->value();
+  if (options.target.value == CoordinateSystem::WebMercator)
+  {
+    options.has_origin = true;
+    options.origin = CoordinateConversion::web_mercator(
+      latitude_box->value(),
+      longitude_box->value());
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+  CoordinateConversion::State converted;
+  std::string error;
+  if (!CoordinateConversion::convert(building, options, converted, error))
+  {
+    QMessageBox::critical(
+      this,
+      "Unable to convert",
+      QString::fromStdString("Unable to convert: " + error));
+    return;
+  }
+  undo_stack->push(new ConvertCoordinatesCommand(&building, converted));
+  qCInfo(lc_edit, "converted %d levels to %s in %lld ms",
+    static_cast<int>(building.levels.size()),
+    options.target.to_string().c_str(),
+    static_cast<long long>(timer.elapsed()));
+
+  level_snapshots.clear();
+  update_tables();
+  set_modified();
+  create_scene();
+  zoom_fit();
+}
+
+void Editor::building_export_navmeshes()
+{
+  const QString dir = QFileDialog::getExistingDirectory(
+    this,
+    "Export crowd sim navmeshes",
+    QFileInfo(QString::fromStdString(building.get_filename())).absolutePath());
+  if (dir.isEmpty())
+    return;
+
+  QElapsedTimer timer;
+  timer.start();
+  const int num_rebuilt = navmeshes.build(building);
+  qCInfo(lc_edit,
+    "built %d of %zu navmeshes and %zu lift links in %lld ms",
+    num_rebuilt,
+    building.levels.size(),
+    navmeshes.links().size(),
+    static_cast<long long>(timer.elapsed()));
+
+  int num_written = 0;
+  QStringList failed;
+  for (std::size_t i = 0; i < building.levels.size(); i++)
+  {
+    const NavmeshBuilder* builder = navmeshes.navmesh(static_cast<int>(i));
+    if (!builder)
+      continue;  // no human lanes on this level
+
+    const QString filename = QDir(dir).filePath(
+      QString::fromStdString(NavmeshSet::file_name(building.levels[i])));
+    if (builder->write(filename.toStdString()))
+      num_written++;
+    else
+      failed.append(filename);
+  }
+
+  // the crowd_sim config refers to the navmeshes of all the levels by
+  // name already; it also needs where they join
+  if (building.crowd_sim_impl)
+  {
+    const std::size_t revision = building.crowd_sim_impl->revision();
+    building.crowd_sim_impl->set_navmesh_links(
+      navmeshes.config_links(building));
+    if (building.crowd_sim_impl->revision() != revision)
+      set_modified();
+  }
+
+  if (!failed.isEmpty())
+  {
+    QMessageBox::critical(
+      this,
+      "Export crowd sim navmeshes",
+      "Couldn't write:\n" + failed.join("\n"));
+    return;
+  }
+  QString message =
+    QString("Wrote %1 navmesh file(s), linked at %2 lift stop(s), to %3")
+    .arg(num_written)
+    .arg(navmeshes.links().size())
+    .arg(dir);
+  if (navmeshes.num_unlinked() > 0)
+    message += QString("; %1 lift stop(s) are off the navmesh")
+      .arg(navmeshes.num_unlinked());
+  statusBar()->showMessage(message, 5000);
+}
+
+void Editor::building_export_nav_graphs()
+{
+  const QString dir = QFileDialog::getExistingDirectory(
+    this,
+    "Export nav graphs",
+    QFileInfo(QString::fromStdString(building.get_filename())).absolutePath());
+  if (dir.isEmpty())
+    return;
+
+  std::vector<std::string> written;
+  if (!building.export_nav_graphs(dir.toStdString(), &written))
+  {
+    QMessageBox::critical(
+      this,
+      "Export nav graphs",
+      QString("Couldn't export all of the nav graphs to %1. Web Mercator "
+      "buildings must be exported by the Python tools.").arg(dir));
+    return;
+  }
+  statusBar()->showMessage(
+    QString("Wrote %1 nav graph file(s) to %2").arg(written.size()).arg(dir),
+    5000);
+}
+
+void Editor::building_export_occupancy_grids()
+{
+  bool ok = false;
+  const double resolution = QInputDialog::getDouble(
+    this,
+    "Export occupancy grids",
+    "Size of a cell (meters):",
+    0.05,
+    0.005,
+    1.0,
+    3,
+    &ok);
+  if (!ok)
+    return;
+
+  const QString dir = QFileDialog::getExistingDirectory(
+    this,
+    "Export occupancy grids",
+    QFileInfo(QString::fromStdString(building.get_filename())).absolutePath());
+  if (dir.isEmpty())
+    return;
+
+  QElapsedTimer timer;
+  timer.start();
+  std::vector<std::string> written;
+  if (!building.export_occupancy_grids(dir.toStdString(), resolution, &written))
+  {
+    QMessageBox::critical(
+      this,
+      "Export occupancy grids",
+      QString("Couldn't export all of the occupancy grids to %1. Web "
+      "Mercator buildings must be exported by the Python tools.").arg(dir));
+    return;
+  }
+  qCInfo(lc_io, "exported %zu occupancy grid files in %lld ms",
+    written.size(),
+    static_cast<long long>(timer.elapsed()));
+  statusBar()->showMessage(
+    QString("Wrote %1 occupancy grid file(s) to %2")
+    .arg(written.size())
+    .arg(dir),
+    5000);
+}
+
+void Editor::building_export_images(const bool all_levels)
+{
+  if (!active_level())
+    return;
+
+  const QString building_path =
+    QFileInfo(QString::fromStdString(building.get_filename())).absolutePath();
+  std::vector<LevelImageExporter::Job> jobs;
+  QString destination;
+  if (all_levels)
+  {
+    destination = QFileDialog::getExistingDirectory(
+      this,
+      "Export images of all levels",
+      building_path);
+    if (destination.isEmpty())
+      return;
+    bool ok = false;
+    const QString suffix = QInputDialog::getItem(
+      this,
+      "Export images of all levels",
+      "Format:",
+      QStringList() << "png" << "svg" << "pdf",
+      0,
+      false,
+      &ok);
+    if (!ok)
+      return;
+    for (std::size_t i = 0; i < building.levels.size(); i++)
+    {
+      LevelImageExporter::Job job;
+      job.level_idx = static_cast<int>(i);
+      job.path = QDir(destination).filePath(
+        QString::fromStdString(building.levels[i].name) + "." + suffix);
+      LevelImageExporter::format_from_path(job.path, job.format);
+      jobs.push_back(job);
+    }
+  }
+  else
+  {
+    QFileDialog dialog(this, "Export level image");
+    dialog.setNameFilters(QStringList() << "*.png" << "*.svg" << "*.pdf");
+    dialog.setDefaultSuffix(".png");
+    dialog.setAcceptMode(QFileDialog::AcceptMode::AcceptSave);
+    dialog.setConfirmOverwrite(true);
+    if (dialog.exec() != QDialog::Accepted)
+      return;
+
+    LevelImageExporter::Job job;
+    job.level_idx = level_idx;
+    job.path = QFileInfo(dialog.selectedFiles().first()).absoluteFilePath();
+    if (!LevelImageExporter::format_from_path(job.path, job.format))
+    {
+      QMessageBox::critical(
+        this,
+        "Export level image",
+        "Images can be exported as .png, .svg or .pdf");
+      return;
+    }
+    destination = job.path;
+    jobs.push_back(job);
+  }
+
+  LevelImageExporter::Options options;
+  bool ok = false;
+  options.scale = QInputDialog::getDouble(
+    this,
+    "Export level image",
+    "Scale, 1 meter on paper to (meters):",
+    options.scale,
+    1.0,
+    100000.0,
+    1,
+    &ok);
+  if (!ok)
+    return;
+  options.dpi = QInputDialog::getDouble(
+    this,
+    "Export level image",
+    "Resolution (dots per inch):",
+    options.dpi,
+    10.0,
+    2400.0,
+    0,
+    &ok);
+  if (!ok)
+    return;
+
+  QElapsedTimer timer;
+  timer.start();
+  QStringList failed;
+  LevelImageExporter::export_levels(
+    building.levels,
+    jobs,
+    editor_models,
+    rendering_options,
+    building.graphs,
+    building.coordinate_system,
+    options,
+    &failed,
+    [this](int idx) { show_level_images(idx); });
+  qCInfo(lc_io, "exported %zu level images in %lld ms",
+    jobs.size(),
+    static_cast<long long>(timer.elapsed()));
+
+  // the exported levels forgot their scene items, the active one included
+  create_scene();
+  if (!failed.isEmpty())
+  {
+    QMessageBox::critical(
+      this,
+      "Export level image",
+      "Couldn't write:\n" + failed.join("\n"));
+    return;
+  }
+  statusBar()->showMessage(
+    QString("Wrote %1 level image(s) to %2")
+    .arg(jobs.size())
+    .arg(destination),
+    5000);
+}
+
+void Editor::view_record_trace()
+{
+  if (view_record_trace_action->isChecked())
+  {
+    Trace::start();
+    statusBar()->showMessage(
+      "Recording a trace; uncheck View > Record trace to save it.");
+    return;
+  }
+
+  const QString path = QFileDialog::getSaveFileName(
+    this,
+    "Save trace",
+    QString(),
+    "Chrome trace files (*.json)");
+  if (path.isEmpty())
+  {
+    // keep recording rather than throw the trace away
+    view_record_trace_action->setChecked(true);
+    return;
+  }
+  if (Trace::save(path.toStdString()))
+    statusBar()->showMessage("Saved the trace to " + path, 5000);
+  else
+    QMessageBox::critical(this, "Unable to save", "Unable to write " + path);
+}
+
+void Editor::view_record_interactions()
+{
+  if (view_record_interactions_action->isChecked())
+  {
+    interaction_recording = std::make_unique<InteractionRecording>();
+    interaction_recording->building_path = building.get_filename();
+    interaction_recording->level_idx = level_idx;
+    interaction_timer.start();
+    record_view_interaction();
+    statusBar()->showMessage(
+      "Recording interactions; uncheck View > Record interactions to save "
+      "them.");
+    return;
+  }
+  if (!interaction_recording)
+    return;
+
+  const QString path = QFileDialog::getSaveFileName(
+    this,
+    "Save interactions",
+    QString(),
+    "Interaction recordings (*.json)");
+  if (path.isEmpty())
+  {
+    // keep recording rather than throw the session away
+    view_record_interactions_action->setChecked(true);
+    return;
+  }
+  if (interaction_recording->save(path))
+  {
+    statusBar()->showMessage(
+      QString("Saved %1 events to %2")
+      .arg(interaction_recording->events.size())
+      .arg(path),
+      5000);
+    interaction_recording.reset();
+  }
+  else
+  {
+    view_record_interactions_action->setChecked(true);
+    QMessageBox::critical(this, "Unable to save", "Unable to write " + path);
+  }
+}
+
+void Editor::record_interaction(InteractionRecording::Event event)
+{
+  if (!interaction_recording || replaying_interactions)
+    return;
+  event.t_ms = interaction_timer.elapsed();
+  interaction_recording->events.push_back(event);
+}
+
+void Editor::record_view_interaction()
+{
+  if (!interaction_recording || replaying_interactions)
+    return;
+  const QPointF center = map_view->mapToScene(
+    QPoint(
+      map_view->viewport()->width() / 2,
+      map_view->viewport()->height() / 2));
+
+  InteractionRecording::Event event;
+  event.kind = InteractionRecording::VIEW;
+  event.x = center.x();
+  event.y = center.y();
+  event.transform = map_view->transform();
+
+  // a burst of scrolling only needs its final position
+  std::vector<InteractionRecording::Event>& events =
+    interaction_recording->events;
+  if (!events.empty() && events.back().kind == InteractionRecording::VIEW)
+    events.pop_back();
+  record_interaction(event);
+}
+
+bool Editor::replay_interactions(
+  const InteractionRecording& recording,
+  InteractionLatencies& latencies)
+{
+  if (recording.level_idx < 0 ||
+    recording.level_idx >= static_cast<int>(building.levels.size()))
+    return false;
+
+  replaying_interactions = true;
+  if (recording.level_idx != level_idx)
+  {
+    level_idx = recording.level_idx;
+    level_table->setCurrentCell(level_idx, 0);
+  }
+  // synchronously, so that the first events don't race the scene geometry
+  create_scene();
+  QCoreApplication::processEvents();
+
+  QElapsedTimer timer;
+  for (const InteractionRecording::Event& event : recording.events)
+  {
+    std::string category;
+    timer.start();
+    switch (event.kind)
+    {
+      case InteractionRecording::MOUSE_PRESS:
+      case InteractionRecording::MOUSE_RELEASE:
+      case InteractionRecording::MOUSE_MOVE:
+      {
+        // the inverse of is_mouse_event_in_map()
+        const QPoint p_map = map_view->mapFromScene(QPointF(event.x, event.y));
+        const QPoint p_editor = mapFromGlobal(map_view->mapToGlobal(p_map));
+
+        MouseType type = MOUSE_MOVE;
+        QEvent::Type event_type = QEvent::MouseMove;
+        if (event.kind == InteractionRecording::MOUSE_PRESS)
+        {
+          type = MOUSE_PRESS;
+          event_type = QEvent::MouseButtonPress;
+          switch (tool_id)
+          {
+            case TOOL_SELECT:
+            case TOOL_MOVE:
+            case TOOL_ROTATE:
+            case TOOL_EDIT_POLYGON:
+              category = "pick";
+              break;
+            case TOOL_ADD_LANE:
+            case TOOL_ADD_WALL:
+            case TOOL_ADD_MEAS:
+            case TOOL_ADD_DOOR:
+            case TOOL_ADD_HUMAN_LANE:
+              category = "add_edge";
+              break;
+            default:
+              category = "press";
+              break;
+          }
+        }
+        else if (event.kind == InteractionRecording::MOUSE_RELEASE)
+        {
+          type = MOUSE_RELEASE;
+          event_type = QEvent::MouseButtonRelease;
+          category = "release";
+        }
+        else
+          category = event.buttons ? "drag" : "hover";
+
+        QMouseEvent e(
+          event_type,
+          QPointF(p_editor),
+          static_cast<Qt::MouseButton>(event.button),
+          static_cast<Qt::MouseButtons>(event.buttons),
+          static_cast<Qt::KeyboardModifiers>(event.modifiers));
+        timer.start();
+        mouse_event(type, &e);
+        break;
+      }
+      case InteractionRecording::KEY:
+      {
+        QKeyEvent e(
+          QEvent::KeyPress,
+          event.key,
+          static_cast<Qt::KeyboardModifiers>(event.modifiers));
+        category = "key";
+        timer.start();
+        keyPressEvent(&e);
+        break;
+      }
+      case InteractionRecording::TOOL:
+      {
+        // the model tool would open its dialog and wait for a person
+        QAbstractButton* button = tool_button_group->button(event.tool);
+        if (event.tool == TOOL_ADD_MODEL || !button)
+          continue;
+        category = "tool";
+        timer.start();
+        button->click();
+        break;
+      }
+      case InteractionRecording::UNDO:
+        category = "undo";
+        edit_undo();
+        break;
+      case InteractionRecording::REDO:
+        category = "redo";
+        edit_redo();
+        break;
+      case InteractionRecording::VIEW:
+        category = "view";
+        map_view->setTransform(event.transform);
+        map_view->centerOn(QPointF(event.x, event.y));
+        map_view->update_level_of_detail();
+        break;
+    }
+    latencies.add(category, timer.nsecsElapsed() / 1e6);
+
+    // then whatever the event queued up (deferred redraws, streaming) and
+    // the repaint it caused, as the person would have waited for it
+    timer.start();
+    QCoreApplication::processEvents();
+    map_view->viewport()->repaint();
+    latencies.add("draw", timer.nsecsElapsed() / 1e6);
+  }
+  replaying_interactions = false;
+  return true;
+}
+
+void Editor::view_log()
+{
+  QDialog dialog(this);
+  dialog.setWindowTitle("Log");
+
+  QPlainTextEdit* text = new QPlainTextEdit(&dialog);
+  text->setReadOnly(true);
+  text->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+  text->setPlainText(Log::recent().join("\n"));
+  text->moveCursor(QTextCursor::End);
+
+  // e.g. "traffic_editor.draw.debug=true; traffic_editor.io=false"
+  QLineEdit* rules_line_edit = new QLineEdit(&dialog);
+  rules_line_edit->setPlaceholderText(
+    "Logging rules, e.g. traffic_editor.draw.debug=true");
+  QPushButton* apply_button = new QPushButton("Apply rules", &dialog);
+  connect(
+    apply_button,
+    &QPushButton::clicked,
+    [rules_line_edit]()
+    {
+      QLoggingCategory::setFilterRules(
+        rules_line_edit->text().replace(";", "\n"));
+    });
+
+  QPushButton* refresh_button = new QPushButton("Refresh", &dialog);
+  connect(
+    refresh_button,
+    &QPushButton::clicked,
+    [text]()
+    {
+      text->setPlainText(Log::recent().join("\n"));
+      text->moveCursor(QTextCursor::End);
+    });
+
+  QHBoxLayout* rules_layout = new QHBoxLayout;
+  rules_layout->addWidget(rules_line_edit, 1);
+  rules_layout->addWidget(apply_button);
+  rules_layout->addWidget(refresh_button);
+
+  QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Close);
+  connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+
+  QVBoxLayout* layout = new QVBoxLayout(&dialog);
+  layout->addWidget(text);
+  layout->addLayout(rules_layout);
+  layout->addWidget(buttons);
+  dialog.resize(800, 600);
+  dialog.exec();
+}
+
+void Editor::view_memory_usage()
+{
+  MemoryReport report;
+  report.measure(building);
+  report.editor_models = MemoryReport::editor_model_bytes(editor_models);
+  report.undo_stack = undo_budget->memory_usage();
+  report.undo_commands = undo_stack->count();
+
+  QDialog dialog(this);
+  dialog.setWindowTitle("Memory usage");
+
+  QPlainTextEdit* text = new QPlainTextEdit(&dialog);
+  text->setReadOnly(true);
+  text->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+  text->setPlainText(report.summary());
+
+  QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Close);
+  QPushButton* save_button =
+    buttons->addButton("Save JSON...", QDialogButtonBox::ActionRole);
+  connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+  connect(
+    save_button,
+    &QPushButton::clicked,
+    [this, &dialog, &report]()
+    {
+      const QString path = QFileDialog::getSaveFileName(
+        &dialog,
+        "Save memory usage",
+        QString(),
+        "JSON files (*.json)");
+      if (path.isEmpty())
+        return;
+      QJsonObject json = report.to_json();
+      json["file"] = QString::fromStdString(building.get_filename());
+      QFile file(path);
+      if (!file.open(QIODevice::WriteOnly) ||
+        file.write(QJsonDocument(json).toJson()) < 0)
+        QMessageBox::critical(
+          &dialog,
+          "Unable to save",
+          "Unable to write " + path);
+    });
+
+  QVBoxLayout* layout = new QVBoxLayout(&dialog);
+  layout->addWidget(text);
+  layout->addWidget(buttons);
+  dialog.resize(640, 640);
+  dialog.exec();
+}
+
+RuntimeStatistics Editor::runtime_statistics()
+{
+  RuntimeStatistics statistics;
+  MemoryReport report;
+  report.measure(building);
+  const MemoryReport::Usage usage = report.levels_total();
+
+  RuntimeStatistics::Cache decoded_images;
+  decoded_images.name = "decoded images";
+  decoded_images.hits = DecodedImageCache::hits();
+  decoded_images.misses = DecodedImageCache::misses();
+  statistics.caches.push_back(decoded_images);
+
+  // only kept within the budget while the images are loaded lazily
+  RuntimeStatistics::Cache level_images;
+  level_images.name = "level images";
+  level_images.bytes = usage.bytes[MemoryReport::FLOORPLAN] +
+    usage.bytes[MemoryReport::LAYER_IMAGES] +
+    usage.bytes[MemoryReport::COLORIZED_IMAGES];
+  if (building.lazy_images)
+    level_images.budget_bytes = static_cast<std::int64_t>(
+      QSettings().value(preferences_keys::level_image_memory_mb, 1024)
+      .toInt()) * 1024 * 1024;
+  statistics.caches.push_back(level_images);
+
+  const TileCache::Statistics tiles = tile_cache->statistics();
+  RuntimeStatistics::Cache basemap;
+  basemap.name = "basemap tiles";
+  basemap.hits = tiles.hits;
+  basemap.misses = tiles.misses;
+  basemap.bytes = tiles.memory_bytes;
+  basemap.budget_bytes = tiles.memory_budget_bytes;
+  statistics.caches.push_back(basemap);
+  RuntimeStatistics::Cache basemap_disk;
+  basemap_disk.name = "basemap tile disk";
+  basemap_disk.bytes = tiles.disk_bytes;
+  basemap_disk.budget_bytes = tiles.disk_budget_bytes;
+  statistics.caches.push_back(basemap_disk);
+
+  RuntimeStatistics::Cache undo;
+  undo.name = "undo history";
+  undo.bytes = undo_budget->memory_usage();
+  undo.budget_bytes = undo_budget->budget_bytes;
+  statistics.caches.push_back(undo);
+
+  TaskPool& pool = TaskPool::instance();
+  for (const TaskPool::Priority priority :
+    {TaskPool::INTERACTIVE, TaskPool::BACKGROUND})
+  {
+    RuntimeStatistics::Queue queue;
+    queue.name = priority == TaskPool::INTERACTIVE ?
+      "interactive pool" : "background pool";
+    queue.active = pool.pool(priority)->activeThreadCount();
+    queue.capacity = pool.pool(priority)->maxThreadCount();
+    queue.waiting = pool.waiting(priority);
+    statistics.queues.push_back(queue);
+  }
+  RuntimeStatistics::Queue tile_requests;
+  tile_requests.name = "basemap requests";
+  tile_requests.active = tiles.in_flight;
+  tile_requests.capacity = tiles.max_in_flight;
+  tile_requests.waiting = tiles.queued;
+  statistics.queues.push_back(tile_requests);
+
+  for (const std::shared_ptr<TaskProgress>& task : pool.active())
+  {
+    QString text = task->name();
+    if (task->total() > 0)
+      text += QString(" (%1 of %2)").arg(task->done()).arg(task->total());
+    statistics.tasks.push_back(text.toStdString());
+  }
+
+  for (int i = 0; i < MemoryReport::NUM_CATEGORIES; i++)
+  {
+    const MemoryReport::Category category =
+      static_cast<MemoryReport::Category>(i);
+    statistics.memory.push_back(
+      {MemoryReport::category_name(category), usage.bytes[i]});
+  }
+  statistics.memory.push_back(
+    {"editor models", MemoryReport::editor_model_bytes(editor_models)});
+  statistics.memory.push_back({"undo history", undo_budget->memory_usage()});
+  statistics.memory.push_back(
+    {"basemap tiles", static_cast<std::size_t>(tiles.memory_bytes)});
+
+  statistics.times.push_back({"scene build", last_draw_nsec});
+  statistics.times.push_back({"viewport paint", map_view->last_paint_nsec()});
+  statistics.times.push_back(
+    {"building load", building.load_profile.total_nsec()});
+  statistics.times.push_back(
+    {"building save", building.save_profile.total_nsec()});
+  return statistics;
+}
+
+void Editor::view_runtime_statistics()
+{
+  QDialog dialog(this);
+  dialog.setWindowTitle("Runtime statistics");
+
+  QPlainTextEdit* text = new QPlainTextEdit(&dialog);
+  text->setReadOnly(true);
+  text->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+  text->setPlainText(runtime_statistics().summary());
+
+  // the editor keeps running behind the dialog; refresh once a second
+  QTimer* timer = new QTimer(&dialog);
+  connect(
+    timer,
+    &QTimer::timeout,
+    [this, text]()
+    {
+      text->setPlainText(runtime_statistics().summary());
+    });
+  timer->start(1000);
+
+  QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Close);
+  connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+
+  QVBoxLayout* layout = new QVBoxLayout(&dialog);
+  layout->addWidget(text);
+  layout->addWidget(buttons);
+  dialog.resize(640, 640);
+  dialog.exec();
+}
+
+void Editor::view_io_profile()
+{
+  QDialog dialog(this);
+  dialog.setWindowTitle("Load/save timings");
+
+  QPlainTextEdit* text = new QPlainTextEdit(&dialog);
+  text->setReadOnly(true);
+  text->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+  text->setPlainText(
+    building.load_profile.summary("last load") + "\n" +
+    building.save_profile.summary("last save"));
+
+  QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Close);
+  QPushButton* save_button =
+    buttons->addButton("Save JSON...", QDialogButtonBox::ActionRole);
+  connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+  connect(
+    save_button,
+    &QPushButton::clicked,
+    [this, &dialog]()
+    {
+      const QString path = QFileDialog::getSaveFileName(
+        &dialog,
+        "Save timings",
+        QString(),
+        "JSON files (*.json)");
+      if (path.isEmpty())
+        return;
+      QJsonObject json;
+      json["file"] = QString::fromStdString(building.get_filename());
+      json["load"] = building.load_profile.to_json();
+      json["save"] = building.save_profile.to_json();
+      QFile file(path);
+      if (!file.open(QIODevice::WriteOnly) ||
+        file.write(QJsonDocument(json).toJson()) < 0)
+        QMessageBox::critical(
+          &dialog,
+          "Unable to save",
+          "Unable to write " + path);
+    });
+
+  QVBoxLayout* layout = new QVBoxLayout(&dialog);
+  layout->addWidget(text);
+  layout->addWidget(buttons);
+  dialog.resize(640, 480);
+  dialog.exec();
+}
+
+void Editor::view_simulation_timings()
+{
+  QDialog dialog(this);
+  dialog.setWindowTitle("Simulation timings");
+
+  TickProfileChart* chart = new TickProfileChart(&tick_profiler, &dialog);
+  chart->setMinimumHeight(100);
+
+  QDoubleSpinBox* period_spin_box = new QDoubleSpinBox(&dialog);
+  period_spin_box->setRange(0.0, 10000.0);
+  period_spin_box->setDecimals(1);
+  period_spin_box->setSuffix(" ms");
+  period_spin_box->setValue(tick_profiler.period_nsec() / 1e6);
+  connect(
+    period_spin_box,
+    QOverload<double>::of(&QDoubleSpinBox::valueChanged),
+    [this](double ms)
+    {
+      tick_profiler.set_period_nsec(static_cast<qint64>(ms * 1e6));
+    });
+  QFormLayout* period_layout = new QFormLayout;
+  period_layout->addRow("Period (0 = no budget):", period_spin_box);
+
+  QPlainTextEdit* text = new QPlainTextEdit(&dialog);
+  text->setReadOnly(true);
+  text->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+  text->setPlainText(tick_profiler.summary());
+
+  // the paint channel keeps filling while the dialog is open
+  QTimer* refresh_timer = new QTimer(&dialog);
+  connect(
+    refresh_timer,
+    &QTimer::timeout,
+    [this, chart, text]()
+    {
+      chart->update();
+      text->setPlainText(tick_profiler.summary());
+    });
+  refresh_timer->start(250);
+
+  QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Close);
+  QPushButton* reset_button =
+    buttons->addButton("Reset", QDialogButtonBox::ResetRole);
+  QPushButton* save_button =
+    buttons->addButton("Save JSON...", QDialogButtonBox::ActionRole);
+  connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+  connect(
+    reset_button,
+    &QPushButton::clicked,
+    [this]()
+    {
+      tick_profiler.clear();
+    });
+  connect(
+    save_button,
+    &QPushButton::clicked,
+    [this, &dialog]()
+    {
+      const QString path = QFileDialog::getSaveFileName(
+        &dialog,
+        "Save simulation timings",
+        QString(),
+        "JSON files (*.json)");
+      if (path.isEmpty())
+        return;
+      QFile file(path);
+      if (!file.open(QIODevice::WriteOnly) ||
+        file.write(QJsonDocument(tick_profiler.to_json()).toJson()) < 0)
+        QMessageBox::critical(
+          &dialog,
+          "Unable to save",
+          "Unable to write " + path);
+    });
+
+  QVBoxLayout* layout = new QVBoxLayout(&dialog);
+  layout->addWidget(chart);
+  layout->addLayout(period_layout);
+  layout->addWidget(text);
+  layout->addWidget(buttons);
+  dialog.resize(640, 480);
+  dialog.exec();
+}
+
+void Editor::view_open_recording()
+{
+  const QString path = QFileDialog::getOpenFileName(
+    this,
+    "Open simulation recording",
+    QString(),
+    "Simulation recordings (*.recording)");
+  if (path.isEmpty())
+    return;
+
+  close_replay();
+  if (!replay_recording.load(path.toStdString()))
+  {
+    QMessageBox::critical(
+      this,
+      "Unable to open recording",
+      "Unable to read a simulation recording from " + path);
+    return;
+  }
+
+  replay_saved_states.clear();
+  for (const Level& level : building.levels)
+  {
+    std::vector<ModelState> states;
+    for (const Model& model : level.models)
+      states.push_back(model.state);
+    replay_saved_states.push_back(states);
+  }
+
+  replay_tick = -1;
+  replay_slider->blockSignals(true);
+  replay_slider->setRange(0, std::max(0, replay_recording.num_ticks() - 1));
+  replay_slider->setValue(0);
+  replay_slider->blockSignals(false);
+  replay_toolbar->show();
+  replay_seek(0);
+}
+
+void Editor::close_replay()
+{
+  if (!replay_recording.is_loaded())
+    return;
+  replay_recording.clear();
+  for (std::size_t i = 0;
+    i < replay_saved_states.size() && i < building.levels.size(); i++)
+  {
+    std::vector<Model>& models = building.levels[i].models;
+    for (std::size_t j = 0;
+      j < replay_saved_states[i].size() && j < models.size(); j++)
+      models[j].state = replay_saved_states[i][j];
+  }
+  replay_saved_states.clear();
+  replay_toolbar->hide();
+}
+
+void Editor::reset_building_state()
+{
+  close_replay();
+  navmeshes.clear();
+  lane_graph_analyses.clear();
+  lane_conflict_checkers.clear();
+  model_overlap_checkers.clear();
+  door_clearance_checkers.clear();
+  lane_sweep_checkers.clear();
+  lane_usage_analyses.clear();
+  lane_usage_result = LaneUsageAnalysis::Result();
+  lane_usage_result_level_idx = -1;
+  lane_usage_run_level_idx = -1;  // drops the result of a running job
+  ++lane_usage_generation;
+  lane_path_planner.clear();
+  lane_route_from = LanePathPlanner::Stop();
+  lane_route_to = LanePathPlanner::Stop();
+  close_traffic_preview();
+  if (view_crowd_preview_action->isChecked())
+    view_crowd_preview_action->trigger();  // stops it
+  if (view_changes_action->isChecked())
+    view_changes_action->trigger();  // forgets the other version
+  name_index->clear();
+  param_index.clear();
+  snapshot_timer->stop();
+  edit_sync.reset();
+  snapshot_publisher.clear();
+}
+
+void Editor::view_close_recording()
+{
+  if (!replay_recording.is_loaded())
+    return;
+  close_replay();
+  create_scene();
+}
+
+void Editor::replay_seek(const int tick)
+{
+  if (!replay_recording.is_loaded() || tick == replay_tick)
+    return;
+  if (!replay_recording.seek(tick, building))
+  {
+    statusBar()->showMessage(
+      "The recording doesn't match the models of this building", 5000);
+    return;
+  }
+  replay_tick = tick;
+  replay_time_label->setText(
+    QString("t = %1 s").arg(tick * replay_recording.time_step(), 0, 'f', 2));
+
+  // only the poses have changed, so move the pixmaps rather than redraw
+  if (level_idx < static_cast<int>(building.levels.size()))
+  {
+    for (Model& model : building.levels[level_idx].models)
+      model.update_pose();
+  }
+}
+
+void Editor::view_export_recording_frames()
+{
+  if (!replay_recording.is_loaded())
+  {
+    QMessageBox::information(
+      this,
+      "Export recording frames",
+      "Open a simulation recording first.");
+    return;
+  }
+  if (frame_encoder.is_running())
+  {
+    QMessageBox::information(
+      this,
+      "Export recording frames",
+      "Stop capturing frames first.");
+    return;
+  }
+
+  bool ok = false;
+  const int fps = QInputDialog::getInt(
+    this,
+    "Export recording frames",
+    "Frames per second:",
+    30,
+    1,
+    240,
+    1,
+    &ok);
+  QSize size;
+  if (!ok || !ask_frame_size("Export recording frames", size))
+    return;
+
+  const QString dir = QFileDialog::getExistingDirectory(
+    this,
+    "Directory for the frames");
+  if (dir.isEmpty())
+    return;
+  if (!frame_encoder.start(dir, size, 4))
+  {
+    QMessageBox::critical(
+      this,
+      "Unable to export",
+      "Unable to write frames into " + dir);
+    return;
+  }
+
+  // frames are rendered from the recording, one seek each, while the
+  // encoder writes the previous ones; assemble them with a video encoder
+  // afterwards
+  const double time_step = replay_recording.time_step();
+  const int ticks_per_frame = time_step > 0.0 ?
+    std::max(1, static_cast<int>(std::round(1.0 / (fps * time_step)))) : 1;
+  const int num_frames =
+    (replay_recording.num_ticks() + ticks_per_frame - 1) / ticks_per_frame;
+  const int start_tick = replay_tick;
+
+  QProgressDialog progress(
+    "Exporting frames...",
+    "Cancel",
+    0,
+    num_frames,
+    this);
+  progress.setWindowModality(Qt::WindowModal);
+  for (int frame = 0; frame < num_frames && !progress.wasCanceled(); frame++)
+  {
+    progress.setValue(frame);
+    replay_seek(frame * ticks_per_frame);
+
+    // nothing is dropped here: this waits for the encoder to catch up
+    QImage* image = frame_encoder.acquire(true);
+    render_frame(*image);
+    frame_encoder.submit(image);
+    if (frame_encoder.stats().failed)
+      break;
+  }
+  progress.setValue(num_frames);
+  replay_seek(start_tick);
+
+  if (!frame_encoder.finish())
+    QMessageBox::critical(
+      this,
+      "Unable to export",
+      "Unable to write " + frame_encoder.error());
+}
+
+void Editor::view_capture_frames()
+{
+  if (!view_capture_frames_action->isChecked())
+  {
+    if (frame_capture_timer)
+      frame_capture_timer->stop();
+    const bool ok = frame_encoder.finish();
+    const FrameEncoder::Stats stats = frame_encoder.stats();
+    const QString message = QString::asprintf(
+      "Wrote %d frames into %s; %d were dropped.",
+      stats.written,
+      qUtf8Printable(frame_encoder.dir()),
+      stats.dropped);
+    if (ok)
+      QMessageBox::information(this, "Capture frames", message);
+    else
+      QMessageBox::critical(
+        this,
+        "Capture frames",
+        message + "\nUnable to write " + frame_encoder.error());
+    statusBar()->clearMessage();
+    return;
+  }
+
+  bool ok = false;
+  const int fps = QInputDialog::getInt(
+    this,
+    "Capture frames",
+    "Frames per second:",
+    30,
+    1,
+    120,
+    1,
+    &ok);
+  QSize size;
+  QString dir;
+  if (ok && ask_frame_size("Capture frames", size))
+    dir = QFileDialog::getExistingDirectory(
+      this,
+      "Directory for the frames");
+  if (dir.isEmpty())
+  {
+    view_capture_frames_action->setChecked(false);
+    return;
+  }
+  if (!frame_encoder.start(dir, size))
+  {
+    QMessageBox::critical(
+      this,
+      "Capture frames",
+      "Unable to write frames into " + dir);
+    view_capture_frames_action->setChecked(false);
+    return;
+  }
+
+  if (!frame_capture_timer)
+  {
+    frame_capture_timer = new QTimer(this);
+    frame_capture_timer->setTimerType(Qt::PreciseTimer);
+    connect(
+      frame_capture_timer,
+      &QTimer::timeout,
+      this,
+      &Editor::capture_frame);
+  }
+  frame_capture_timer->start(1000 / fps);
+}
+
+void Editor::capture_frame()
+{
+  // the encoder has fallen behind if every buffer is still queued
+  QImage* frame = frame_encoder.acquire(false);
+  if (frame)
+  {
+    render_frame(*frame);
+    frame_encoder.submit(frame);
+  }
+
+  const FrameEncoder::Stats stats = frame_encoder.stats();
+  statusBar()->showMessage(
+    QString::asprintf(
+      "capturing frames: %d written, %d queued, %d dropped, %d failed",
+      stats.written,
+      stats.captured - stats.written - stats.failed,
+      stats.dropped,
+      stats.failed));
+}
+
+bool Editor::ask_frame_size(const QString& title, QSize& size)
+{
+  QSettings settings;
+  bool ok = false;
+  const QString text = QInputDialog::getText(
+    this,
+    title,
+    "Frame size (width x height), whatever the size of the window:",
+    QLineEdit::Normal,
+    settings.value(preferences_keys::capture_frame_size, "1920x1080")
+    .toString(),
+    &ok);
+  if (!ok)
+    return false;
+
+  const QStringList numbers = text.toLower().split('x');
+  size = numbers.size() == 2 ?
+    QSize(numbers[0].trimmed().toInt(), numbers[1].trimmed().toInt()) :
+    QSize();
+  if (size.width() < 16 || size.height() < 16 ||
+    size.width() > 4096 || size.height() > 4096)
+  {
+    QMessageBox::critical(
+      this,
+      title,
+      "The frame size must be two numbers from 16 to 4096, e.g. 1920x1080.");
+    return false;
+  }
+  settings.setValue(preferences_keys::capture_frame_size, text.trimmed());
+  return true;
+}
+
+void Editor::render_frame(QImage& frame) const
+{
+  // show more of the scene, rather than bars, when the aspect ratios of
+  // the view and the frame differ
+  QRectF source =
+    map_view->mapToScene(map_view->viewport()->rect()).boundingRect();
+  const double aspect = frame.width() / static_cast<double>(frame.height());
+  const QPointF center = source.center();
+  if (source.width() < source.height() * aspect)
+    source.setWidth(source.height() * aspect);
+  else
+    source.setHeight(source.width() / aspect);
+  source.moveCenter(center);
+
+  frame.fill(Qt::white);
+  QPainter painter(&frame);
+  painter.setRenderHint(QPainter::Antialiasing);
+  scene->render(&painter, QRectF(frame.rect()), source);
+}
+
+void Editor::help_about()
+{
+  QMessageBox::about(this, "About", "Welcome to the Traffic Editor");
+}
+
+void Editor::enforce_undo_budget()
+{
+  // the undo view can jump anywhere; never back into retired history
+  if (undo_stack->index() < undo_budget->retired())
+  {
+    undo_stack->setIndex(undo_budget->retired());
+    return;  // which comes back here through indexChanged
+  }
+
+  undo_budget->enforce(*undo_stack);
+  undo_memory_label->setText(
+    QString("undo: %1 MB").arg(
+      undo_budget->memory_usage() / (1024.0 * 1024.0), 0, 'f', 1));
+}
+
+void Editor::edit_undo()
+{
+  TRACE_ZONE("Editor::edit_undo");
+  if (interaction_recording)
+  {
+    InteractionRecording::Event event;
+    event.kind = InteractionRecording::UNDO;
+    record_interaction(event);
+  }
+  if (undo_budget->retired() > 0 &&
+    undo_stack->index() <= undo_budget->retired())
+  {
+    statusBar()->showMessage(
+      "Older edits were discarded to keep the undo history within "
+      "its memory budget.",
+      5000);
+    return;
+  }
+  undo_stack->undo();
+  if (
+    tool_id == TOOL_ADD_LANE
+    || tool_id == TOOL_ADD_WALL)
+  {
+    clicked_idx = -1;
+    prev_clicked_idx = -1;
+  }
+  schedule_undo_redraw();
+  set_modified_after_undo();
+}
+
+void Editor::edit_redo()
+{
+  TRACE_ZONE("Editor::edit_redo");
+  if (interaction_recording)
+  {
+    InteractionRecording::Event event;
+    event.kind = InteractionRecording::REDO;
+    record_interaction(event);
+  }
+  undo_stack->redo();
+  schedule_undo_redraw();
+  set_modified_after_undo();
+}
+
+void Editor::set_modified_after_undo()
+{
+  set_modified();
+  if (building.saved_content_hash() != 0 &&
+    building.content_hash() == building.saved_content_hash())
+    setWindowModified(false);
+}
+
+void Editor::schedule_undo_redraw()
+{
+  // let a burst of undos or redos (e.g. from holding Ctrl+Z) all apply
+  // before a single repaint
+  if (undo_redraw_pending)
+    return;
+  undo_redraw_pending = true;
+  QTimer::singleShot(
+    0,
+    this,
+    [this]()
+    {
+      undo_redraw_pending = false;
+      apply_undo_changes();
+    });
+}
+
+void Editor::apply_undo_changes()
+{
+  TRACE_ZONE("Editor::apply_undo_changes");
+  bool reported = false;
+  for (const Level& level : building.levels)
+    reported = reported || level.has_changes();
+  if (!reported)
+  {
+    // the command didn't say what it changed, so assume anything did
+    create_scene();
+    update_property_editor();
+    return;
+  }
+
+  const Level* level = active_level();
+  const bool selection_changed = level && level->changes_touch_selection();
+  apply_level_changes();
+  if (selection_changed)
+    update_property_editor();
+}
+
+void Editor::edit_preferences()
+{
+  PreferencesDialog preferences_dialog(this);
+
+  if (preferences_dialog.exec() == QDialog::Accepted)
+  {
+    load_model_names();
+    QSettings settings;
+    map_view->set_opengl_viewport(
+      settings.value(preferences_keys::opengl_viewport).toBool());
+    update_scene_index();
+    apply_performance_preferences();
+    enforce_undo_budget();
+  }
+}
+
+void Editor::apply_performance_preferences()
+{
+  QSettings settings;
+  TaskPool::instance().set_worker_threads(
+    settings.value(preferences_keys::worker_threads, 0).toInt());
+
+  LevelOfDetail::set_scales(
+    settings.value(
+      preferences_keys::lod_medium_scale,
+      LevelOfDetail::DEFAULT_MEDIUM_SCALE).toDouble(),
+    settings.value(
+      preferences_keys::lod_fine_scale,
+      LevelOfDetail::DEFAULT_FINE_SCALE).toDouble());
+  map_view->update_level_of_detail();
+
+  tile_cache->set_memory_budget_mb(
+    settings.value(preferences_keys::basemap_memory_mb, 128).toInt());
+  tile_cache->set_disk_budget_mb(
+    settings.value(preferences_keys::basemap_disk_mb, 512).toInt());
+
+  // the budget of the parked documents too, for when they are back
+  const std::size_t undo_budget_bytes = static_cast<std::size_t>(
+    settings.value(preferences_keys::undo_memory_mb, 256).toInt()) *
+    1024 * 1024;
+  for (int i = 0; i < workspace.count(); i++)
+    workspace.document(i).undo_budget.budget_bytes = undo_budget_bytes;
+}
+
+void Editor::edit_building_properties()
+{
+  BuildingDialog building_dialog(building);
+  if (building_dialog.exec() == QDialog::Accepted)
+    set_modified();
+}
+
+void Editor::edit_go_to()
+{
+  // only the levels edited since the last time are indexed again
+  name_index->update(building);
+  name_index->wait();
+
+  QDialog dialog(this);
+  dialog.setWindowTitle("Go to");
+  QLineEdit* name_edit = new QLineEdit;
+  name_edit->setPlaceholderText(
+    "Name of a vertex, model, door, lift, polygon, fiducial or feature");
+  QListWidget* match_list = new QListWidget;
+  QLabel* stats_label = new QLabel;
+  QVBoxLayout* layout = new QVBoxLayout(&dialog);
+  layout->addWidget(name_edit);
+  layout->addWidget(match_list);
+  layout->addWidget(stats_label);
+  dialog.resize(500, 400);
+
+  std::vector<NameIndex::Match> matches;
+  auto search = [&]()
+    {
+      QElapsedTimer timer;
+      timer.start();
+      matches = name_index->search(name_edit->text().toStdString(), 100);
+      const double search_ms = timer.nsecsElapsed() / 1e6;
+
+      match_list->clear();
+      for (const NameIndex::Match& match : matches)
+      {
+        const NameIndex::Entry& entry = match.entry;
+        match_list->addItem(
+          QString("%1    (%2 on %3)").arg(
+            QString::fromStdString(entry.name),
+            NameIndex::kind_name(entry.kind),
+            QString::fromStdString(building.levels[entry.level_idx].name)));
+      }
+      if (!matches.empty())
+        match_list->setCurrentRow(0);
+      stats_label->setText(
+        QString::asprintf(
+          "%d matches of %d names, %.2f ms",
+          static_cast<int>(matches.size()),
+          static_cast<int>(name_index->size()),
+          search_ms));
+    };
+  connect(name_edit, &QLineEdit::textChanged, search);
+  connect(name_edit, &QLineEdit::returnPressed, &dialog, &QDialog::accept);
+  connect(
+    match_list,
+    &QListWidget::itemActivated,
+    &dialog,
+    &QDialog::accept);
+  search();
+
+  if (dialog.exec() != QDialog::Accepted)
+    return;
+  const int row = match_list->currentRow();
+  if (row >= 0 && row < static_cast<int>(matches.size()))
+    go_to(matches[row].entry);
+}
+
+void Editor::go_to(const NameIndex::Entry& entry)
+{
+  if (entry.level_idx < 0 ||
+    entry.level_idx >= static_cast<int>(building.levels.size()))
+    return;
+
+  // switching first keeps the cached scene of the level, which a change
+  // of its selection made beforehand would drop
+  if (entry.level_idx != level_idx)
+  {
+    switch_level(entry.level_idx);
+    level_table->setCurrentCell(level_idx, 0);
+  }
+
+  std::vector<Level::SelectedItem> previous_selection;
+  building.get_selected_items(level_idx, previous_selection);
+  Level& level = building.levels[level_idx];
+  level.clear_selection();
+  if (entry.kind != NameIndex::LIFT)
+    level.select(entry.item);
+  selected_polygon = building.get_selected_polygon(level_idx);
+
+  // a scene still waiting for its geometry is drawn with the selection
+  if (geometry_generation != scene_generation)
+    update_scene_selection(previous_selection);
+  update_property_editor();
+  map_view->centerOn(QPointF(entry.x, entry.y));
+}
+
+void Editor::edit_find_replace_params()
+{
+  // only the levels edited since the last time are indexed again
+  QElapsedTimer timer;
+  timer.start();
+  param_index.update(building);
+  const double index_ms = timer.nsecsElapsed() / 1e6;
+
+  QDialog dialog(this);
+  dialog.setWindowTitle("Find and replace params");
+  QVBoxLayout* layout = new QVBoxLayout(&dialog);
+  QFormLayout* form = new QFormLayout;
+  QComboBox* key_box = new QComboBox;
+  key_box->addItem("(any)");
+  for (const std::string& key : param_index.keys())
+    key_box->addItem(QString::fromStdString(key));
+  QLineEdit* find_edit = new QLineEdit;
+  QLineEdit* replace_edit = new QLineEdit;
+  QCheckBox* regex_box = new QCheckBox("Regular expression (\\1 in the "
+      "replacement is the first capture)");
+  QCheckBox* whole_box = new QCheckBox("Whole values only");
+  QCheckBox* case_box = new QCheckBox("Match case");
+  case_box->setChecked(true);
+  form->addRow("Param:", key_box);
+  form->addRow("Find:", find_edit);
+  form->addRow("Replace with:", replace_edit);
+  form->addRow(regex_box);
+  form->addRow(whole_box);
+  form->addRow(case_box);
+  layout->addLayout(form);
+  QListWidget* match_list = new QListWidget;
+  QLabel* stats_label = new QLabel;
+  layout->addWidget(match_list);
+  layout->addWidget(stats_label);
+  QDialogButtonBox* buttons =
+    new QDialogButtonBox(QDialogButtonBox::Cancel);
+  QPushButton* replace_button =
+    buttons->addButton("Replace all", QDialogButtonBox::AcceptRole);
+  connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+  connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+  layout->addWidget(buttons);
+  dialog.resize(600, 500);
+
+  ParamIndex::Result result;
+  auto search = [&]()
+    {
+      ParamIndex::Query query;
+      if (key_box->currentIndex() > 0)
+        query.key = key_box->currentText().toStdString();
+      query.find = find_edit->text();
+      query.replacement = replace_edit->text();
+      query.regex = regex_box->isChecked();
+      query.whole_value = whole_box->isChecked();
+      query.case_sensitive = case_box->isChecked();
+
+      timer.start();
+      result = param_index.find(query);
+      const double find_ms = timer.nsecsElapsed() / 1e6;
+
+      // the preview is only a sample of what a large replacement does
+      const std::size_t max_rows = 1000;
+      match_list->clear();
+      for (std::size_t i = 0;
+        i < result.matches.size() && i < max_rows; i++)
+      {
+        const ParamIndex::Match& match = result.matches[i];
+        match_list->addItem(
+          QString("%1 %2 on %3:  %4: %5  ->  %6")
+          .arg(ParamIndex::kind_name(match.kind))
+          .arg(match.idx)
+          .arg(QString::fromStdString(building.levels[match.level_idx].name))
+          .arg(QString::fromStdString(*match.key))
+          .arg(QString::fromStdString(match.before))
+          .arg(QString::fromStdString(match.after)));
+      }
+
+      QString stats;
+      if (!result.error.isEmpty())
+        stats = "Invalid regular expression: " + result.error;
+      else
+      {
+        stats = QString::asprintf(
+          "%d matches of %d params, %.2f ms (indexed in %.2f ms)",
+          static_cast<int>(result.matches.size()),
+          static_cast<int>(param_index.size()),
+          find_ms,
+          index_ms);
+        if (result.num_invalid)
+          stats += QString("\n%1 left out: the replacement isn't a valid "
+              "value of their type").arg(
+            static_cast<int>(result.num_invalid));
+      }
+      stats_label->setText(stats);
+      replace_button->setEnabled(!result.matches.empty());
+    };
+  connect(find_edit, &QLineEdit::textChanged, search);
+  connect(replace_edit, &QLineEdit::textChanged, search);
+  connect(
+    key_box,
+    QOverload<int>::of(&QComboBox::currentIndexChanged),
+    search);
+  for (QCheckBox* box : {regex_box, whole_box, case_box})
+    connect(box, &QCheckBox::toggled, search);
+  search();
+
+  if (dialog.exec() != QDialog::Accepted || result.matches.empty())
+    return;
+
+  timer.start();
+  ReplaceParamsCommand* command =
+    new ReplaceParamsCommand(&building, result.matches);
+  if (command->size() == 0)
+  {
+    delete command;
+    return;
+  }
+  undo_stack->push(command);
+  qCInfo(
+    lc_edit,
+    "%s in %lld ms",
+    qUtf8Printable(command->text()),
+    static_cast<long long>(timer.elapsed()));
+  set_modified();
+  update_property_editor();
+  apply_level_changes();
+}
+
+namespace {
+
+/// "the 3 selected models" or "all 120 models", for the dialogs
+QString bulk_models_text(
+  const std::vector<std::vector<int>>& targets,
+  const Building& building)
+{
+  std::size_t count = 0;
+  if (targets.empty())
+  {
+    for (const Level& level : building.levels)
+      count += level.models.size();
+    return QString("all %1 models").arg(static_cast<int>(count));
+  }
+  for (const std::vector<int>& idxs : targets)
+    count += idxs.size();
+  return QString("the %1 selected models").arg(static_cast<int>(count));
+}
+
+}  // anonymous namespace
+
+std::vector<std::vector<int>> Editor::bulk_model_targets() const
+{
+  std::vector<std::vector<int>> targets;
+  if (level_idx < 0 || level_idx >= static_cast<int>(building.levels.size()))
+    return targets;
+
+  const Level& level = building.levels[level_idx];
+  std::vector<int> selected;
+  for (std::size_t i = 0; i < level.models.size(); i++)
+  {
+    if (level.models[i].selected)
+      selected.push_back(static_cast<int>(i));
+  }
+  if (selected.empty())
+    return targets;
+  targets.resize(level_idx + 1);
+  targets[level_idx] = std::move(selected);
+  return targets;
+}
+
+bool Editor::push_bulk_models(const BulkModelsCommand::Operation& operation)
+{
+  QElapsedTimer timer;
+  timer.start();
+  BulkModelsCommand* command =
+    new BulkModelsCommand(&building, operation, bulk_model_targets());
+  if (command->size() == 0)
+  {
+    delete command;
+    statusBar()->showMessage("No models were changed", 3000);
+    return false;
+  }
+  undo_stack->push(command);
+  qCInfo(
+    lc_edit,
+    "%s: %zu models in %lld ms",
+    qUtf8Printable(command->text()),
+    command->size(),
+    static_cast<long long>(timer.elapsed()));
+  set_modified();
+  update_property_editor();
+  apply_level_changes();
+  return true;
+}
+
+void Editor::edit_rotate_models()
+{
+  const std::vector<std::vector<int>> targets = bulk_model_targets();
+
+  QDialog dialog(this);
+  dialog.setWindowTitle("Rotate models");
+  QFormLayout* layout = new QFormLayout(&dialog);
+  QDoubleSpinBox* degrees_box = new QDoubleSpinBox;
+  degrees_box->setRange(-360.0, 360.0);
+  degrees_box->setDecimals(2);
+  degrees_box->setValue(90.0);
+  layout->addRow(
+    QString("Rotate %1 counter-clockwise by (degrees):")
+    .arg(bulk_models_text(targets, building)),
+    degrees_box);
+  QCheckBox* about_center_box =
+    new QCheckBox("Also turn their positions about their center");
+  layout->addRow(about_center_box);
+  QDialogButtonBox* buttons =
+    new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+  connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+  connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+  layout->addRow(buttons);
+  if (dialog.exec() != QDialog::Accepted)
+    return;
+
+  BulkModelsCommand::Operation operation;
+  operation.kind = BulkModelsCommand::Operation::ROTATE;
+  operation.rotation = degrees_box->value() * M_PI / 180.0;
+  operation.about_center = about_center_box->isChecked();
+  if (operation.rotation != 0.0)
+    push_bulk_models(operation);
+}
+
+void Editor::edit_move_models()
+{
+  const std::vector<std::vector<int>> targets = bulk_model_targets();
+
+  QDialog dialog(this);
+  dialog.setWindowTitle("Move models");
+  QFormLayout* layout = new QFormLayout(&dialog);
+  layout->addRow(
+    new QLabel(
+      QString("Move %1 by (meters, y up):")
+      .arg(bulk_models_text(targets, building))));
+  QDoubleSpinBox* x_box = new QDoubleSpinBox;
+  QDoubleSpinBox* y_box = new QDoubleSpinBox;
+  for (QDoubleSpinBox* box : {x_box, y_box})
+  {
+    box->setRange(-10000.0, 10000.0);
+    box->setDecimals(3);
+  }
+  layout->addRow("x:", x_box);
+  layout->addRow("y:", y_box);
+  QDialogButtonBox* buttons =
+    new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+  connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+  connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+  layout->addRow(buttons);
+  if (dialog.exec() != QDialog::Accepted)
+    return;
+
+  BulkModelsCommand::Operation operation;
+  operation.kind = BulkModelsCommand::Operation::TRANSLATE;
+  operation.offset = QPointF(x_box->value(), y_box->value());
+  if (!operation.offset.isNull())
+    push_bulk_models(operation);
+}
+
+void Editor::edit_rename_models()
+{
+  const std::vector<std::vector<int>> targets = bulk_model_targets();
+
+  // offer only the names that the targeted models actually show
+  std::set<std::string> used_names;
+  for (std::size_t i = 0; i < building.levels.size(); i++)
+  {
+    const std::vector<Model>& models = building.levels[i].models;
+    if (targets.empty())
+    {
+      for (const Model& model : models)
+        used_names.insert(model.model_name);
+    }
+    else if (i < targets.size())
+    {
+      for (const int idx : targets[i])
+        used_names.insert(models[idx].model_name);
+    }
+  }
+  if (used_names.empty())
+    return;
+
+  QStringList from_names;
+  if (used_names.size() > 1)
+    from_names.append("(any)");
+  for (const std::string& name : used_names)
+    from_names.append(QString::fromStdString(name));
+
+  bool ok = false;
+  const QString from_name = QInputDialog::getItem(
+    this,
+    "Change model",
+    QString("Change which of %1:").arg(bulk_models_text(targets, building)),
+    from_names,
+    0,
+    false,
+    &ok);
+  if (!ok)
+    return;
+
+  QStringList to_names;
+  for (const EditorModel& editor_model : editor_models)
+    to_names.append(QString::fromStdString(editor_model.name));
+  const QString to_name = QInputDialog::getItem(
+    this,
+    "Change model",
+    "To the model:",
+    to_names,
+    0,
+    true,
+    &ok);
+  if (!ok || to_name.isEmpty())
+    return;
+
+  BulkModelsCommand::Operation operation;
+  operation.kind = BulkModelsCommand::Operation::RENAME;
+  if (used_names.size() == 1 || from_name != from_names.first())
+    operation.from_name = from_name.toStdString();
+  operation.to_name = to_name.toStdString();
+  push_bulk_models(operation);
+}
+
+void Editor::edit_set_models_static()
+{
+  const std::vector<std::vector<int>> targets = bulk_model_targets();
+  const QStringList choices = {"Static", "Dynamic"};
+  bool ok = false;
+  const QString choice = QInputDialog::getItem(
+    this,
+    "Make models static or dynamic",
+    QString("Make %1:").arg(bulk_models_text(targets, building)),
+    choices,
+    0,
+    false,
+    &ok);
+  if (!ok)
+    return;
+
+  BulkModelsCommand::Operation operation;
+  operation.kind = BulkModelsCommand::Operation::SET_STATIC;
+  operation.is_static = choice == choices.first();
+  push_bulk_models(operation);
+}
+
+void Editor::edit_optimize_layer_transforms()
+{
+  qCDebug(lc_edit, "Editor::edit_optimize_layer_transforms()");
+  if (level_idx >= static_cast<int>(building.levels.size()))
+    return;
+  if (layer_solve_watcher->isRunning())
+    return;
+
+  const std::vector<Level::LayerProblem> problems =
+    building.levels[level_idx].layer_problems();
+  if (problems.empty())
+  {
+    QMessageBox::information(
+      this,
+      "Optimize layer transforms",
+      "This level has no layers to optimize.");
+    return;
+  }
+
+  // the layers are solved in parallel; spare cores go to each solve
+  const int num_threads = std::max(
+    1,
+    QThread::idealThreadCount() / static_cast<int>(problems.size()));
+
+  layer_solve_level_idx = level_idx;
+  layer_solve_cancel = std::make_shared<std::atomic<bool>>(false);
+  std::shared_ptr<std::atomic<bool>> cancel = layer_solve_cancel;
+  std::function<Level::LayerSolution(const Level::LayerProblem&)> solve =
+    [num_threads, cancel](const Level::LayerProblem& problem)
+    {
+      return Level::solve_layer_problem(problem, num_threads, cancel.get());
+    };
+
+  // window-modal, so that the level can't change under the solve
+  layer_solve_progress = new QProgressDialog(
+    "Optimizing layer transforms...",
+    "Cancel",
+    0,
+    static_cast<int>(problems.size()),
+    this);
+  layer_solve_progress->setWindowModality(Qt::WindowModal);
+  layer_solve_progress->setMinimumDuration(500);
+  layer_solve_progress->setAutoClose(false);
+  layer_solve_progress->setAutoReset(false);
+  connect(
+    layer_solve_progress,
+    &QProgressDialog::canceled,
+    this,
+    [this]()
+    {
+      layer_solve_cancel->store(true);
+      layer_solve_watcher->cancel();
+    });
+  connect(
+    layer_solve_watcher,
+    &QFutureWatcher<Level::LayerSolution>::progressValueChanged,
+    layer_solve_progress,
+    &QProgressDialog::setValue);
+
+  layer_solve_watcher->setFuture(QtConcurrent::mapped(problems, solve));
+}
+
+void Editor::layer_transforms_optimized()
+{
+  layer_solve_progress->deleteLater();
+  layer_solve_progress = nullptr;
+
+  if (layer_solve_watcher->isCanceled() || layer_solve_cancel->load())
+  {
+    qCInfo(lc_transform, "layer transform optimization was canceled");
+    return;
+  }
+  if (layer_solve_level_idx >= static_cast<int>(building.levels.size()))
+    return;
+  Level& level = building.levels[layer_solve_level_idx];
+
+  SetLayerTransformsCommand* command =
+    new SetLayerTransformsCommand(&building, layer_solve_level_idx);
+  QString report;
+  const QList<Level::LayerSolution> solutions =
+    layer_solve_watcher->future().results();
+  for (const Level::LayerSolution& solution : solutions)
+  {
+    if (solution.layer_idx >= static_cast<int>(level.layers.size()))
+      continue;
+    const std::string& layer_name = level.layers[solution.layer_idx].name;
+    qCDebug(lc_transform,
+      "layer %s: %s", layer_name.c_str(), solution.summary.c_str());
+    report += QString("%1: %2\n").arg(
+      QString::fromStdString(layer_name),
+      QString::fromStdString(solution.summary));
+    if (solution.solved)
+      command->set_transform(solution.layer_idx, solution.transform);
+  }
+
+  if (command->is_empty())
+    delete command;
+  else
+  {
+    undo_stack->push(command);
+    set_modified();
+    apply_level_changes();
+  }
+
+  QMessageBox::information(this, "Optimize layer transforms", report);
+}
+
+void Editor::edit_optimize_all_transforms()
+{
+  qCDebug(lc_edit, "Editor::edit_optimize_all_transforms()");
+  if (building.levels.empty() ||
+    layer_solve_watcher->isRunning() ||
+    joint_solve_watcher->isRunning())
+    return;
+
+  // each level starts from where it is now
+  std::vector<Building::Transform> initial(building.levels.size());
+  joint_solve_level_names.clear();
+  for (std::size_t i = 0; i < building.levels.size(); i++)
+  {
+    initial[i] = building.get_transform_to_reference(static_cast<int>(i));
+    joint_solve_level_names.push_back(building.levels[i].name);
+  }
+  const JointAlignment::Problem problem =
+    JointAlignment::make_problem(building, initial, true);
+
+  joint_solve_cancel = std::make_shared<std::atomic<bool>>(false);
+  std::shared_ptr<std::atomic<bool>> cancel = joint_solve_cancel;
+  const int num_threads = QThread::idealThreadCount();
+
+  // window-modal, so that the building can't change under the solve
+  joint_solve_progress = new QProgressDialog(
+    "Optimizing all transforms...",
+    "Cancel",
+    0,
+    0,
+    this);
+  joint_solve_progress->setWindowModality(Qt::WindowModal);
+  joint_solve_progress->setMinimumDuration(500);
+  joint_solve_progress->setAutoClose(false);
+  joint_solve_progress->setAutoReset(false);
+  connect(
+    joint_solve_progress,
+    &QProgressDialog::canceled,
+    this,
+    [this]() { joint_solve_cancel->store(true); });
+
+  joint_solve_watcher->setFuture(
+    TaskPool::instance().run(
+      TaskPool::INTERACTIVE,
+      [problem, num_threads, cancel]()
+      {
+        return JointAlignment::solve(problem, num_threads, cancel.get());
+      }));
+}
+
+void Editor::all_transforms_optimized()
+{
+  joint_solve_progress->deleteLater();
+  joint_solve_progress = nullptr;
+
+  if (joint_solve_cancel->load())
+  {
+    qCInfo(lc_transform, "joint transform optimization was canceled");
+    return;
+  }
+  bool same_levels = joint_solve_level_names.size() == building.levels.size();
+  for (std::size_t i = 0; same_levels && i < building.levels.size(); i++)
+    same_levels = joint_solve_level_names[i] == building.levels[i].name;
+  if (!same_levels)
+    return;
+
+  const JointAlignment::Solution solution = joint_solve_watcher->result();
+  qCInfo(lc_transform, "joint alignment: %s", solution.summary.c_str());
+  if (!solution.solved)
+  {
+    QMessageBox::information(
+      this,
+      "Optimize all transforms",
+      QString::fromStdString(solution.summary));
+    return;
+  }
+
+  // the level transforms follow from the fiducials once the joint fit is
+  // on, so it is the layers which are set
+  QUndoCommand* command = new QUndoCommand("Optimize all transforms");
+  for (std::size_t i = 0; i < solution.layer_solutions.size(); i++)
+  {
+    const Level& level = building.levels[i];
+    SetLayerTransformsCommand* level_command = nullptr;
+    for (const Level::LayerSolution& layer : solution.layer_solutions[i])
+    {
+      if (!layer.solved ||
+        layer.layer_idx >= static_cast<int>(level.layers.size()))
+        continue;
+      if (!level_command)
+        level_command = new SetLayerTransformsCommand(
+          &building,
+          static_cast<int>(i),
+          command);
+      level_command->set_transform(layer.layer_idx, layer.transform);
+    }
+  }
+  if (!building.joint_alignment())
+    new SetJointAlignmentCommand(&building, true, command);
+  if (command->childCount() == 0)
+    delete command;
+  else
+  {
+    undo_stack->push(command);
+    set_modified();
+    create_scene();
+  }
+
+  // the worst constraints first
+  std::vector<JointAlignment::Residual> residuals = solution.residuals;
+  std::sort(
+    residuals.begin(),
+    residuals.end(),
+    [](const JointAlignment::Residual& a, const JointAlignment::Residual& b)
+    {
+      return a.meters > b.meters;
+    });
+  QString details;
+  double sum_squares = 0.0;
+  for (const JointAlignment::Residual& residual : residuals)
+  {
+    sum_squares += residual.meters * residual.meters;
+    const QString level_name =
+      QString::fromStdString(building.levels[residual.level_idx].name);
+    if (residual.kind == JointAlignment::FIDUCIAL)
+      details += QString("%1 m: fiducial %2 between %3 and %4\n")
+        .arg(residual.meters, 0, 'f', 3)
+        .arg(QString::fromStdString(residual.name))
+        .arg(level_name)
+        .arg(QString::fromStdString(
+          building.levels[residual.other_idx].name));
+    else
+      details += QString("%1 m: feature constraint of layer %2 on %3\n")
+        .arg(residual.meters, 0, 'f', 3)
+        .arg(QString::fromStdString(residual.name))
+        .arg(level_name);
+  }
+
+  QMessageBox box(this);
+  box.setWindowTitle("Optimize all transforms");
+  box.setText(
+    QString("%1\n\n%2 constraints, rms %3 m, worst %4 m")
+    .arg(QString::fromStdString(solution.summary))
+    .arg(residuals.size())
+    .arg(
+      residuals.empty() ? 0.0 : std::sqrt(sum_squares / residuals.size()),
+      0, 'f', 3)
+    .arg(residuals.empty() ? 0.0 : residuals.front().meters, 0, 'f', 3));
+  box.setDetailedText(details);
+  box.exec();
+}
+
+void Editor::edit_joint_alignment(bool enabled)
+{
+  if (enabled == building.joint_alignment())
+    return;
+  undo_stack->push(new SetJointAlignmentCommand(&building, enabled));
+  set_modified();
+  create_scene();
+}
+
+void Editor::edit_match_layer_features()
+{
+  if (level_idx >= static_cast<int>(building.levels.size()))
+    return;
+  if (feature_match_watcher->isRunning())
+  {
+    statusBar()->showMessage("Still matching the features of a layer", 5000);
+    return;
+  }
+
+  Level& level = building.levels[level_idx];
+  if (level.layers.empty() || level.drawing_filename.empty())
+  {
+    QMessageBox::information(
+      this,
+      "Match layer features",
+      "This level needs a floorplan and a layer to match to it.");
+    return;
+  }
+
+  const int match_layer_idx = choose_layer(
+    "Match layer features",
+    "Find features of this layer on the floorplan:");
+  if (match_layer_idx < 0)
+    return;
+
+  show_level_images(level_idx);
+  const Layer& layer = level.layers[match_layer_idx];
+  if (!layer.image_loaded())
+  {
+    QMessageBox::critical(
+      this,
+      "Match layer features",
+      QString("Unable to load the image of layer %1")
+      .arg(QString::fromStdString(layer.name)));
+    return;
+  }
+
+  // QImages are implicitly shared, so this is only a copy if it's packed
+  const QImage layer_image =
+    layer.packed_image.is_null() ? layer.image : layer.packed_image.to_image();
+  const QString drawing_filename =
+    QString::fromStdString(level.drawing_filename);
+  const double initial_scale =
+    layer.transform.scale() / level.drawing_meters_per_pixel;
+
+  auto progress = TaskPool::instance().track(
+    QString("Matching features of %1")
+    .arg(QString::fromStdString(layer.name)),
+    0);
+  feature_match_level_idx = level_idx;
+  feature_match_layer_idx = match_layer_idx;
+  feature_match_layer_name = layer.name;
+  feature_match_progress = progress;
+  feature_match_watcher->setFuture(
+    TaskPool::instance().run(
+      TaskPool::INTERACTIVE,
+      [drawing_filename, layer_image, initial_scale, progress]()
+      {
+        // the full resolution drawing, not the preview that may be shown
+        QString error_string;
+        const QImage floorplan = DecodedImageCache::load(
+          drawing_filename,
+          QImage::Format_Grayscale8,
+          &error_string);
+        FeatureMatcher::Result result;
+        if (floorplan.isNull())
+          result.summary = QString("unable to read %1: %2")
+          .arg(drawing_filename, error_string)
+          .toStdString();
+        else
+          result = FeatureMatcher::match(
+            floorplan,
+            layer_image,
+            initial_scale,
+            FeatureMatcher::Options(),
+            progress.get());
+        progress->finish();
+        return result;
+      }));
+  update_task_status();
+}
+
+void Editor::layer_features_matched()
+{
+  const bool canceled = feature_match_progress->canceled();
+  feature_match_progress.reset();
+  update_task_status();
+  if (canceled)
+    return;
+
+  const FeatureMatcher::Result result = feature_match_watcher->result();
+  const QString layer_name = QString::fromStdString(feature_match_layer_name);
+  if (!result.found)
+  {
+    QMessageBox::information(
+      this,
+      "Match layer features",
+      QString("No features of layer %1 were found on the floorplan: %2")
+      .arg(layer_name, QString::fromStdString(result.summary)));
+    return;
+  }
+
+  // the building may have been edited while the images were searched
+  const int match_level_idx = feature_match_level_idx;
+  const int match_layer_idx = feature_match_layer_idx;
+  if (match_level_idx >= static_cast<int>(building.levels.size()) ||
+    match_layer_idx >=
+    static_cast<int>(building.levels[match_level_idx].layers.size()) ||
+    building.levels[match_level_idx].layers[match_layer_idx].name !=
+    feature_match_layer_name)
+    return;
+  const double mpp = building.levels[match_level_idx].drawing_meters_per_pixel;
+
+  QDialog dialog(this);
+  dialog.setWindowTitle("Match layer features");
+  QLabel* label = new QLabel(
+    QString(
+      "%1 (%2).\nThey agree on %3 m per pixel of layer %4, rotated by "
+      "%5 degrees. Check the pairs to add as features and constraints:")
+    .arg(QString::fromStdString(result.summary))
+    .arg(result.pairs.size())
+    .arg(result.scale * mpp, 0, 'g', 4)
+    .arg(layer_name)
+    .arg(result.rotation * 180.0 / M_PI, 0, 'f', 2),
+    &dialog);
+  label->setWordWrap(true);
+
+  QListWidget* list = new QListWidget(&dialog);
+  for (const FeatureMatcher::Pair& pair : result.pairs)
+  {
+    QListWidgetItem* item = new QListWidgetItem(
+      QString("floorplan (%1, %2)  layer (%3, %4)  off by %5 px")
+      .arg(pair.floorplan.x(), 0, 'f', 1)
+      .arg(pair.floorplan.y(), 0, 'f', 1)
+      .arg(pair.layer.x(), 0, 'f', 1)
+      .arg(pair.layer.y(), 0, 'f', 1)
+      .arg(pair.residual, 0, 'f', 2),
+      list);
+    item->setFlags(item->flags() | Qt::ItemIsUserCheckable);
+    item->setCheckState(Qt::Checked);
+  }
+  // show where a pair is, if it's on the level being edited
+  connect(
+    list,
+    &QListWidget::currentRowChanged,
+    [this, &result, match_level_idx](int row)
+    {
+      if (row >= 0 && match_level_idx == level_idx)
+        map_view->centerOn(result.pairs[row].floorplan);
+    });
+
+  QDialogButtonBox* buttons = new QDialogButtonBox(
+    QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+  connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+  connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+
+  QVBoxLayout* layout = new QVBoxLayout(&dialog);
+  layout->addWidget(label);
+  layout->addWidget(list);
+  layout->addWidget(buttons);
+  dialog.resize(600, 400);
+  if (dialog.exec() != QDialog::Accepted)
+    return;
+
+  std::vector<std::pair<QPointF, QPointF>> points;
+  for (int i = 0; i < list->count(); i++)
+  {
+    if (list->item(i)->checkState() == Qt::Checked)
+      points.push_back({result.pairs[i].floorplan, result.pairs[i].layer});
+  }
+  if (points.empty())
+    return;
+
+  undo_stack->beginMacro("Match layer features");
+  undo_stack->push(
+    new AddFeatureMatchesCommand(
+      &building,
+      match_level_idx,
+      match_layer_idx,
+      points));
+  if (match_level_idx == level_idx)
+    reoptimize_layers({match_layer_idx});
+  undo_stack->endMacro();
+  set_modified();
+  create_scene();
+}
+
+void Editor::edit_register_levels()
+{
+  if (level_registration_watcher->isRunning())
+  {
+    statusBar()->showMessage("Still registering the levels", 5000);
+    return;
+  }
+
+  const int ref_idx = building.get_reference_level_idx();
+  if (ref_idx < 0 || ref_idx >= static_cast<int>(building.levels.size()))
+    return;
+  const Level& ref_level = building.levels[ref_idx];
+  std::vector<int> level_idxs;
+  std::vector<std::string> level_names;
+  std::vector<QString> filenames;
+  std::vector<double> initial_scales;
+  for (std::size_t i = 0; i < building.levels.size(); i++)
+  {
+    const Level& level = building.levels[i];
+    if (static_cast<int>(i) == ref_idx ||
+      level.drawing_filename.empty() ||
+      level.drawing_meters_per_pixel <= 0.0)
+      continue;
+    level_idxs.push_back(i);
+    level_names.push_back(level.name);
+    filenames.push_back(QString::fromStdString(level.drawing_filename));
+    initial_scales.push_back(
+      level.drawing_meters_per_pixel / ref_level.drawing_meters_per_pixel);
+  }
+  if (ref_level.drawing_filename.empty() ||
+    ref_level.drawing_meters_per_pixel <= 0.0 ||
+    level_idxs.empty())
+  {
+    QMessageBox::information(
+      this,
+      "Register levels",
+      "The reference level and at least one other level need floorplans.");
+    return;
+  }
+
+  const QString ref_filename =
+    QString::fromStdString(ref_level.drawing_filename);
+  auto progress = TaskPool::instance().track(
+    "Registering levels",
+    static_cast<int>(level_idxs.size()));
+  level_registration_reference_name = ref_level.name;
+  level_registration_level_idxs = level_idxs;
+  level_registration_level_names = level_names;
+  level_registration_progress = progress;
+  level_registration_watcher->setFuture(
+    TaskPool::instance().run(
+      TaskPool::INTERACTIVE,
+      [ref_filename, filenames, initial_scales, progress]()
+      {
+        std::vector<LevelRegistration::Result> results(filenames.size());
+        QString error_string;
+        const QImage reference = DecodedImageCache::load(
+          ref_filename,
+          QImage::Format_Grayscale8,
+          &error_string);
+        for (std::size_t i = 0; i < filenames.size(); i++)
+        {
+          if (progress->canceled())
+            break;
+          // one level at a time, as each one fans out over the pool
+          const QImage image = reference.isNull() ? QImage() :
+          DecodedImageCache::load(
+            filenames[i],
+            QImage::Format_Grayscale8,
+            &error_string);
+          if (reference.isNull() || image.isNull())
+            results[i].summary = QString("unable to read %1: %2")
+            .arg(reference.isNull() ? ref_filename : filenames[i])
+            .arg(error_string)
+            .toStdString();
+          else
+            results[i] = LevelRegistration::register_level(
+              reference,
+              image,
+              initial_scales[i],
+              LevelRegistration::Options(),
+              progress.get());
+          progress->advance();
+        }
+        progress->finish();
+        return results;
+      }));
+  update_task_status();
+}
+
+void Editor::levels_registered()
+{
+  const bool canceled = level_registration_progress->canceled();
+  level_registration_progress.reset();
+  update_task_status();
+  if (canceled)
+    return;
+
+  // the building may have been edited while the drawings were registered
+  const std::vector<LevelRegistration::Result> results =
+    level_registration_watcher->result();
+  const int ref_idx = building.get_reference_level_idx();
+  if (ref_idx < 0 ||
+    ref_idx >= static_cast<int>(building.levels.size()) ||
+    building.levels[ref_idx].name != level_registration_reference_name)
+    return;
+  const double ref_mpp = building.levels[ref_idx].drawing_meters_per_pixel;
+  auto still_there = [this](const int idx, const std::string& name)
+    {
+      return idx < static_cast<int>(building.levels.size()) &&
+        building.levels[idx].name == name;
+    };
+
+  QDialog dialog(this);
+  dialog.setWindowTitle("Register levels");
+  QLabel* label = new QLabel(
+    QString(
+      "The floorplans were lined up with that of %1. Check the levels to "
+      "add four fiducials to, at the positions found, on both them and "
+      "%1. The editor aligns levels by scale and shift only, so a level "
+      "that is turned is left turned.")
+    .arg(QString::fromStdString(level_registration_reference_name)),
+    &dialog);
+  label->setWordWrap(true);
+
+  QListWidget* list = new QListWidget(&dialog);
+  for (std::size_t i = 0; i < results.size(); i++)
+  {
+    const LevelRegistration::Result& result = results[i];
+    const QString name =
+      QString::fromStdString(level_registration_level_names[i]);
+    QString text;
+    if (result.found)
+      text =
+        QString("%1: scale %2, turned %3 degrees, shifted by (%4, %5) m, "
+        "peak %6")
+        .arg(name)
+        .arg(result.scale, 0, 'g', 4)
+        .arg(result.yaw * 180.0 / M_PI, 0, 'f', 2)
+        .arg(result.dx * ref_mpp, 0, 'f', 2)
+        .arg(result.dy * ref_mpp, 0, 'f', 2)
+        .arg(result.peak, 0, 'f', 3);
+    else
+      text = QString("%1: not found (%2)")
+        .arg(name, QString::fromStdString(result.summary));
+    QListWidgetItem* item = new QListWidgetItem(text, list);
+    item->setFlags(item->flags() | Qt::ItemIsUserCheckable);
+    item->setCheckState(result.found ? Qt::Checked : Qt::Unchecked);
+  }
+
+  QDialogButtonBox* buttons = new QDialogButtonBox(
+    QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+  connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+  connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+
+  QVBoxLayout* layout = new QVBoxLayout(&dialog);
+  layout->addWidget(label);
+  layout->addWidget(list);
+  layout->addWidget(buttons);
+  dialog.resize(600, 300);
+  if (dialog.exec() != QDialog::Accepted)
+    return;
+
+  // registering a level again replaces the fiducials it added before
+  SetFiducialsCommand* command =
+    new SetFiducialsCommand(&building, "Register levels");
+  std::vector<Fiducial> ref_fiducials = building.levels[ref_idx].fiducials;
+  for (std::size_t i = 0; i < results.size(); i++)
+  {
+    const int idx = level_registration_level_idxs[i];
+    if (list->item(i)->checkState() != Qt::Checked ||
+      !still_there(idx, level_registration_level_names[i]))
+      continue;
+    const Level& level = building.levels[idx];
+    if (level.drawing_width <= 0 || level.drawing_height <= 0)
+      continue;
+
+    const std::string prefix = level.name + "_registration_";
+    auto is_registration = [&prefix](const Fiducial& fiducial)
+      {
+        return fiducial.name.compare(0, prefix.size(), prefix) == 0;
+      };
+    std::vector<Fiducial> fiducials;
+    std::copy_if(
+      level.fiducials.begin(),
+      level.fiducials.end(),
+      std::back_inserter(fiducials),
+      [&](const Fiducial& fiducial) { return !is_registration(fiducial); });
+    ref_fiducials.erase(
+      std::remove_if(
+        ref_fiducials.begin(),
+        ref_fiducials.end(),
+        is_registration),
+      ref_fiducials.end());
+
+    const std::vector<QPointF> points = LevelRegistration::fiducial_points(
+      QSize(level.drawing_width, level.drawing_height));
+    for (std::size_t j = 0; j < points.size(); j++)
+    {
+      const std::string name = prefix + std::to_string(j);
+      const QPointF on_reference = results[i].apply(points[j]);
+      fiducials.push_back(Fiducial(points[j].x(), points[j].y(), name));
+      ref_fiducials.push_back(
+        Fiducial(on_reference.x(), on_reference.y(), name));
+    }
+    command->set_fiducials(idx, fiducials);
+  }
+  if (command->is_empty())
+  {
+    delete command;
+    return;
+  }
+  command->set_fiducials(ref_idx, ref_fiducials);
+  undo_stack->push(command);
+  set_modified();
+  create_scene();
+}
+
+void Editor::edit_pair_fiducials()
+{
+  const int ref_idx = building.get_reference_level_idx();
+  if (ref_idx < 0 || ref_idx >= static_cast<int>(building.levels.size()))
+    return;
+  std::vector<int> level_idxs;
+  for (std::size_t i = 0; i < building.levels.size(); i++)
+  {
+    if (static_cast<int>(i) != ref_idx &&
+      !building.levels[i].fiducials.empty())
+      level_idxs.push_back(i);
+  }
+  if (level_idxs.empty())
+  {
+    QMessageBox::information(
+      this,
+      "Pair fiducials",
+      "No level other than the reference has fiducials.");
+    return;
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+  const std::vector<FiducialPairing::Result> results =
+    FiducialPairing::pair_levels(
+      building.levels,
+      ref_idx,
+      level_idxs,
+      FiducialPairing::Options());
+  qCInfo(lc_edit, "paired the fiducials of %d levels in %lld ms",
+    static_cast<int>(level_idxs.size()),
+    static_cast<long long>(timer.elapsed()));
+
+  const Level& ref_level = building.levels[ref_idx];
+  QDialog dialog(this);
+  dialog.setWindowTitle("Pair fiducials");
+  QLabel* label = new QLabel(
+    QString(
+      "The fiducials of each level were matched to those of %1 by their "
+      "layout, whatever their names. Check the levels whose fiducials "
+      "should be named after the ones of %1 they were paired with.")
+    .arg(QString::fromStdString(ref_level.name)),
+    &dialog);
+  label->setWordWrap(true);
+
+  QListWidget* list = new QListWidget(&dialog);
+  for (std::size_t i = 0; i < results.size(); i++)
+  {
+    const FiducialPairing::Result& result = results[i];
+    const QString name =
+      QString::fromStdString(building.levels[level_idxs[i]].name);
+    QString text;
+    if (result.found)
+      text = QString("%1: %2, scale %3, shifted by (%4, %5) m")
+        .arg(name, QString::fromStdString(result.summary))
+        .arg(result.scale, 0, 'g', 4)
+        .arg(result.dx * ref_level.drawing_meters_per_pixel, 0, 'f', 2)
+        .arg(result.dy * ref_level.drawing_meters_per_pixel, 0, 'f', 2);
+    else
+      text = QString("%1: not found (%2)")
+        .arg(name, QString::fromStdString(result.summary));
+    QListWidgetItem* item = new QListWidgetItem(text, list);
+    item->setFlags(item->flags() | Qt::ItemIsUserCheckable);
+    item->setCheckState(result.found ? Qt::Checked : Qt::Unchecked);
+  }
+
+  QDialogButtonBox* buttons = new QDialogButtonBox(
+    QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+  connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+  connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+
+  QVBoxLayout* layout = new QVBoxLayout(&dialog);
+  layout->addWidget(label);
+  layout->addWidget(list);
+  layout->addWidget(buttons);
+  dialog.resize(600, 300);
+  if (dialog.exec() != QDialog::Accepted)
+    return;
+
+  std::vector<int> checked_idxs;
+  std::vector<FiducialPairing::Result> checked_results;
+  for (std::size_t i = 0; i < results.size(); i++)
+  {
+    if (list->item(i)->checkState() != Qt::Checked)
+      continue;
+    checked_idxs.push_back(level_idxs[i]);
+    checked_results.push_back(results[i]);
+  }
+  const std::map<int, std::vector<Fiducial>> named =
+    FiducialPairing::named_fiducials(
+      building.levels,
+      ref_idx,
+      checked_idxs,
+      checked_results);
+  if (named.empty())
+  {
+    statusBar()->showMessage("The fiducials were already named alike", 5000);
+    return;
+  }
+
+  SetFiducialsCommand* command =
+    new SetFiducialsCommand(&building, "Pair fiducials");
+  for (const auto& level_fiducials : named)
+    command->set_fiducials(level_fiducials.first, level_fiducials.second);
+  undo_stack->push(command);
+  level_snapshots.clear();
+  set_modified();
+  create_scene();
+}
+
+int Editor::choose_layer(const QString& title, const QString& label)
+{
+  const Level& level = building.levels[level_idx];
+  if (level.layers.size() == 1)
+    return 0;
+
+  QStringList names;
+  for (const Layer& layer : level.layers)
+    names.append(QString::fromStdString(layer.name));
+  bool ok = false;
+  const QString name =
+    QInputDialog::getItem(this, title, label, names, 0, false, &ok);
+  return ok ? names.indexOf(name) : -1;
+}
+
+void Editor::edit_extract_walls()
+{
+  if (level_idx >= static_cast<int>(building.levels.size()))
+    return;
+  if (wall_extract_watcher->isRunning())
+  {
+    statusBar()->showMessage("Still extracting the walls of a layer", 5000);
+    return;
+  }
+
+  Level& level = building.levels[level_idx];
+  if (level.layers.empty())
+  {
+    QMessageBox::information(
+      this,
+      "Extract walls",
+      "This level has no layers to extract walls from.");
+    return;
+  }
+  const int extract_layer_idx = choose_layer(
+    "Extract walls",
+    "Add walls along the occupied pixels of this layer:");
+  if (extract_layer_idx < 0)
+    return;
+
+  WallExtractor::Options options;
+  bool ok = false;
+  options.threshold = QInputDialog::getInt(
+    this,
+    "Extract walls",
+    "Pixels darker than this are walls (0 to 255):",
+    options.threshold,
+    1,
+    255,
+    1,
+    &ok);
+  if (!ok)
+    return;
+
+  show_level_images(level_idx);
+  const Layer& layer = level.layers[extract_layer_idx];
+  if (!layer.image_loaded())
+  {
+    QMessageBox::critical(
+      this,
+      "Extract walls",
+      QString("Unable to load the image of layer %1")
+      .arg(QString::fromStdString(layer.name)));
+    return;
+  }
+  const QImage image =
+    layer.packed_image.is_null() ? layer.image : layer.packed_image.to_image();
+
+  auto progress = TaskPool::instance().track(
+    QString("Extracting walls of %1")
+    .arg(QString::fromStdString(layer.name)),
+    0);
+  wall_extract_level_idx = level_idx;
+  wall_extract_layer_idx = extract_layer_idx;
+  wall_extract_layer_name = layer.name;
+  wall_extract_progress = progress;
+  wall_extract_watcher->setFuture(
+    TaskPool::instance().run(
+      TaskPool::INTERACTIVE,
+      [image, options, progress]()
+      {
+        std::vector<std::vector<QPointF>> polylines =
+          WallExtractor::extract(image, options, progress.get());
+        progress->finish();
+        return polylines;
+      }));
+  update_task_status();
+}
+
+void Editor::walls_extracted()
+{
+  const bool canceled = wall_extract_progress->canceled();
+  wall_extract_progress.reset();
+  update_task_status();
+  if (canceled)
+    return;
+
+  // the building may have been edited while the image was traced
+  const int extract_level_idx = wall_extract_level_idx;
+  const int extract_layer_idx = wall_extract_layer_idx;
+  if (extract_level_idx >= static_cast<int>(building.levels.size()) ||
+    extract_layer_idx >=
+    static_cast<int>(building.levels[extract_level_idx].layers.size()) ||
+    building.levels[extract_level_idx].layers[extract_layer_idx].name !=
+    wall_extract_layer_name)
+    return;
+
+  const QString layer_name = QString::fromStdString(wall_extract_layer_name);
+  const std::vector<std::vector<QPointF>> polylines =
+    wall_extract_watcher->result();
+  if (polylines.empty())
+  {
+    statusBar()->showMessage(
+      QString("Found no walls in layer %1").arg(layer_name),
+      5000);
+    return;
+  }
+
+  std::unique_ptr<BatchEditTransaction> transaction(
+    new BatchEditTransaction(building));
+  const Level& level = building.levels[extract_level_idx];
+  const Transform& transform = level.layers[extract_layer_idx].transform;
+  const double mpp = level.drawing_meters_per_pixel;
+  BatchEditTransaction::Lists lists = transaction->lists(extract_level_idx);
+  const std::size_t first_vertex = lists.vertices.size();
+  const std::size_t first_edge = lists.edges.size();
+  for (const std::vector<QPointF>& polyline : polylines)
+  {
+    int prev = -1;
+    for (const QPointF& layer_point : polyline)
+    {
+      const QPointF p = transform.forwards(layer_point) / mpp;
+      const int idx = static_cast<int>(lists.vertices.size());
+      lists.vertices.push_back(Vertex(p.x(), p.y()));
+      if (prev >= 0)
+        lists.edges.push_back(Edge(prev, idx, Edge::WALL));
+      prev = idx;
+    }
+  }
+
+  // the ends of paths meeting at a junction of the skeleton are a pixel
+  // or two apart, and walls drawn by hand may already be there
+  const double tolerance = std::max(0.05, 2.0 * transform.scale()) / mpp;
+  const GeometryCleanup::Report report = GeometryCleanup::run(
+    lists.vertices,
+    lists.edges,
+    lists.polygons,
+    tolerance,
+    first_vertex,
+    first_edge);
+  const std::size_t num_vertices = lists.vertices.size() - first_vertex;
+  const std::size_t num_edges = lists.edges.size() - first_edge;
+  qCInfo(lc_edit,
+    "extracted %zu walls (%d duplicates dropped) and %zu vertices "
+    "(%d welded) from layer %s",
+    num_edges,
+    report.duplicate_edges,
+    num_vertices,
+    report.welded_vertices,
+    wall_extract_layer_name.c_str());
+  if (num_edges == 0)
+  {
+    transaction->undo();
+    apply_level_changes();
+    statusBar()->showMessage(
+      QString("Layer %1 has no walls that aren't drawn already")
+      .arg(layer_name),
+      5000);
+    return;
+  }
+  transaction->finish();
+
+  undo_stack->push(
+    new BatchEditCommand("Extract walls", std::move(transaction)));
+  set_modified();
+  update_property_editor();
+  apply_level_changes();
+  statusBar()->showMessage(
+    QString("Added %1 walls and %2 vertices from layer %3")
+    .arg(num_edges)
+    .arg(num_vertices)
+    .arg(layer_name),
+    5000);
+}
+
+void Editor::edit_import_dxf()
+{
+  if (level_idx >= static_cast<int>(building.levels.size()))
+    return;
+  if (dxf_import_watcher->isRunning())
+  {
+    statusBar()->showMessage("Still importing a DXF drawing", 5000);
+    return;
+  }
+
+  const QString path = QFileDialog::getOpenFileName(
+    this,
+    "Import DXF",
+    QString(),
+    "DXF drawings (*.dxf *.DXF)");
+  if (path.isEmpty())
+    return;
+
+  // only the layers and the extents, without keeping any of the geometry
+  statusBar()->showMessage(QString("Reading the layers of %1").arg(path));
+  DxfImporter::Scan scan;
+  QString error;
+  if (!DxfImporter::scan(path, scan, error))
+  {
+    statusBar()->clearMessage();
+    QMessageBox::critical(this, "Import DXF", error);
+    return;
+  }
+  statusBar()->clearMessage();
+
+  // the same drawing imported again lines up with what it imported before
+  const Level& level = building.levels[level_idx];
+  const QString building_dir =
+    QFileInfo(QString::fromStdString(building.get_filename())).absolutePath();
+  const std::string filename = building.get_filename().empty() ?
+    path.toStdString() :
+    QDir(building_dir).relativeFilePath(path).toStdString();
+  const bool same_drawing = level.vector_underlay.filename == filename;
+
+  QDialog dialog(this);
+  dialog.setWindowTitle("Import DXF");
+  QVBoxLayout* layout = new QVBoxLayout(&dialog);
+  QTableWidget* table =
+    new QTableWidget(static_cast<int>(scan.layers.size()), 3);
+  table->setHorizontalHeaderLabels({"Layer", "Entities", "Import as"});
+  table->verticalHeader()->setVisible(false);
+  table->horizontalHeader()->setStretchLastSection(true);
+  std::vector<QComboBox*> target_boxes;
+  for (std::size_t i = 0; i < scan.layers.size(); i++)
+  {
+    const DxfImporter::LayerInfo& info = scan.layers[i];
+    const int row = static_cast<int>(i);
+    QTableWidgetItem* name_item =
+      new QTableWidgetItem(QString::fromStdString(info.name));
+    name_item->setFlags(Qt::ItemIsEnabled);
+    table->setItem(row, 0, name_item);
+    QTableWidgetItem* count_item =
+      new QTableWidgetItem(QString::number(info.num_entities));
+    count_item->setFlags(Qt::ItemIsEnabled);
+    table->setItem(row, 1, count_item);
+
+    QComboBox* box = new QComboBox;
+    for (int t = 0; t < DxfImporter::NUM_TARGETS; t++)
+    {
+      box->addItem(
+        DxfImporter::target_name(static_cast<DxfImporter::Target>(t)));
+    }
+    box->setCurrentIndex(DxfImporter::guess_target(info.name));
+    table->setCellWidget(row, 2, box);
+    target_boxes.push_back(box);
+  }
+  layout->addWidget(table);
+
+  QFormLayout* form = new QFormLayout;
+  QDoubleSpinBox* units_box = new QDoubleSpinBox;
+  units_box->setDecimals(6);
+  units_box->setRange(1e-6, 1e6);
+  double meters_per_unit = scan.meters_per_unit;
+  if (same_drawing)
+    meters_per_unit = level.vector_underlay.meters_per_unit;
+  else if (meters_per_unit <= 0.0)
+  {
+    // unitless drawings of buildings are in millimeters, or in meters
+    const double size =
+      std::max(scan.x_max - scan.x_min, scan.y_max - scan.y_min);
+    meters_per_unit = size > 2000.0 ? 0.001 : 1.0;
+  }
+  units_box->setValue(meters_per_unit);
+  form->addRow("Meters per drawing unit:", units_box);
+  QDoubleSpinBox* weld_box = new QDoubleSpinBox;
+  weld_box->setDecimals(3);
+  weld_box->setRange(0.0, 1.0);
+  weld_box->setSingleStep(0.005);
+  weld_box->setValue(DxfImporter::Options().weld_tolerance);
+  form->addRow("Join points closer than (meters):", weld_box);
+  layout->addLayout(form);
+
+  if (!scan.unsupported.empty())
+  {
+    QStringList skipped;
+    for (const auto& it : scan.unsupported)
+    {
+      skipped.append(
+        QString("%1 %2").arg(it.second).arg(QString::fromStdString(it.first)));
+    }
+    QLabel* skipped_label =
+      new QLabel("Not imported: " + skipped.join(", "));
+    skipped_label->setWordWrap(true);
+    layout->addWidget(skipped_label);
+  }
+
+  QDialogButtonBox* buttons = new QDialogButtonBox(
+    QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+  connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+  connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+  layout->addWidget(buttons);
+  dialog.resize(480, 480);
+  if (dialog.exec() != QDialog::Accepted)
+    return;
+
+  DxfImporter::Options options;
+  dxf_import_underlay = VectorUnderlay();
+  for (std::size_t i = 0; i < scan.layers.size(); i++)
+  {
+    const DxfImporter::Target target =
+      static_cast<DxfImporter::Target>(target_boxes[i]->currentIndex());
+    options.targets[scan.layers[i].name] = target;
+    if (target == DxfImporter::UNDERLAY)
+      dxf_import_underlay.layers.push_back(scan.layers[i].name);
+  }
+  options.meters_per_unit = units_box->value();
+  options.origin_x = same_drawing ?
+    level.vector_underlay.origin_x : scan.x_min;
+  options.origin_y = same_drawing ?
+    level.vector_underlay.origin_y : scan.y_max;
+  options.meters_per_pixel = level.drawing_meters_per_pixel;
+  options.weld_tolerance = weld_box->value();
+  dxf_import_tolerance = options.weld_tolerance;
+  dxf_import_underlay.filename = filename;
+  dxf_import_underlay.meters_per_unit = options.meters_per_unit;
+  dxf_import_underlay.origin_x = options.origin_x;
+  dxf_import_underlay.origin_y = options.origin_y;
+  dxf_import_width =
+    (scan.x_max - options.origin_x) * options.meters_per_unit;
+  dxf_import_height =
+    (options.origin_y - scan.y_min) * options.meters_per_unit;
+
+  auto progress = TaskPool::instance().track(
+    QString("Importing %1").arg(QFileInfo(path).fileName()),
+    0);
+  dxf_import_level_name = level.name;
+  dxf_import_progress = progress;
+  dxf_import_watcher->setFuture(
+    TaskPool::instance().run(
+      TaskPool::INTERACTIVE,
+      [path, options, progress]()
+      {
+        DxfImporter::Result result =
+          DxfImporter::import(path, options, progress.get());
+        progress->finish();
+        return result;
+      }));
+  update_task_status();
+}
+
+void Editor::dxf_imported()
+{
+  const bool canceled = dxf_import_progress->canceled();
+  dxf_import_progress.reset();
+  update_task_status();
+  if (canceled)
+    return;
+
+  // the level may have been removed or renamed while the file was read
+  int import_level_idx = -1;
+  for (std::size_t i = 0; i < building.levels.size(); i++)
+  {
+    if (building.levels[i].name == dxf_import_level_name)
+      import_level_idx = static_cast<int>(i);
+  }
+  if (import_level_idx < 0)
+    return;
+
+  DxfImporter::Result result = dxf_import_watcher->result();
+  if (!result.error.isEmpty())
+  {
+    QMessageBox::critical(this, "Import DXF", result.error);
+    return;
+  }
+
+  std::unique_ptr<BatchEditTransaction> transaction(
+    new BatchEditTransaction(building));
+  BatchEditTransaction::Lists lists = transaction->lists(import_level_idx);
+  const std::size_t first_vertex = lists.vertices.size();
+  const std::size_t first_edge = lists.edges.size();
+  const int offset = static_cast<int>(first_vertex);
+  lists.vertices.insert(
+    lists.vertices.end(),
+    result.vertices.begin(),
+    result.vertices.end());
+  for (Edge& edge : result.edges)
+  {
+    edge.start_idx += offset;
+    edge.end_idx += offset;
+    lists.edges.push_back(edge);
+  }
+  for (Polygon& polygon : result.polygons)
+  {
+    for (int& idx : polygon.vertices)
+      idx += offset;
+    lists.polygons.push_back(polygon);
+  }
+
+  // the points were joined as they were read; this joins them to what the
+  // level already had, and drops the walls drawn twice in the drawing
+  Level& level = building.levels[import_level_idx];
+  const GeometryCleanup::Report report = GeometryCleanup::run(
+    lists.vertices,
+    lists.edges,
+    lists.polygons,
+    dxf_import_tolerance / level.drawing_meters_per_pixel,
+    first_vertex,
+    first_edge);
+  const std::size_t num_vertices = lists.vertices.size() - first_vertex;
+  const std::size_t num_edges = lists.edges.size() - first_edge;
+  const std::size_t num_polygons = result.polygons.size();
+  qCInfo(lc_edit,
+    "imported %zu edges (%d duplicates dropped), %zu vertices and %zu "
+    "polygons from %s",
+    num_edges,
+    report.duplicate_edges,
+    num_vertices,
+    num_polygons,
+    dxf_import_underlay.filename.c_str());
+
+  if (num_vertices || num_edges || num_polygons)
+  {
+    transaction->finish();
+    undo_stack->push(
+      new BatchEditCommand("Import DXF", std::move(transaction)));
+  }
+  else
+    transaction->undo();
+
+  // the underlay isn't part of the undo step, like the drawing of a level
+  const std::size_t num_lines =
+    result.underlay ? result.underlay->num_segments() : 0;
+  if (num_lines > 0)
+  {
+    level.vector_underlay = dxf_import_underlay;
+    level.vector_underlay.lines = result.underlay;
+    if (level.drawing_filename.empty())
+    {
+      // the level is as large as the drawing, at least
+      level.x_meters = std::max(level.x_meters, dxf_import_width);
+      level.y_meters = std::max(level.y_meters, dxf_import_height);
+      level.drawing_width = level.x_meters / level.drawing_meters_per_pixel;
+      level.drawing_height = level.y_meters / level.drawing_meters_per_pixel;
+    }
+    level.mark_all_changed();
+  }
+
+  set_modified();
+  update_property_editor();
+  if (num_lines > 0)
+  {
+    drop_cached_scenes();
+    create_scene();
+  }
+  else
+    apply_level_changes();
+  statusBar()->showMessage(
+    QString("Imported %1 edges, %2 vertices, %3 polygons and %4 underlay "
+    "lines from %5")
+    .arg(num_edges)
+    .arg(num_vertices)
+    .arg(num_polygons)
+    .arg(num_lines)
+    .arg(QString::fromStdString(dxf_import_underlay.filename)),
+    10000);
+}
+
+void Editor::edit_remove_vector_underlay()
+{
+  if (level_idx >= static_cast<int>(building.levels.size()))
+    return;
+  Level& level = building.levels[level_idx];
+  if (level.vector_underlay.empty())
+  {
+    statusBar()->showMessage("This level has no vector underlay", 5000);
+    return;
+  }
+  level.vector_underlay = VectorUnderlay();
+  level.mark_all_changed();
+  set_modified();
+  drop_cached_scenes();
+  create_scene();
+}
+
+void Editor::reoptimize_layers(const std::set<int>& layer_idxs)
+{
+  QSettings settings;
+  if (layer_idxs.empty() ||
+    !settings.value(preferences_keys::reoptimize_layers, true).toBool())
+    return;
+  if (level_idx >= static_cast<int>(building.levels.size()))
+    return;
+
+  const std::vector<Level::LayerProblem> problems =
+    building.levels[level_idx].layer_problems();
+  SetLayerTransformsCommand* command =
+    new SetLayerTransformsCommand(&building, level_idx);
+  for (const int idx : layer_idxs)
+  {
+    if (idx < 0 || idx >= static_cast<int>(problems.size()))
+      continue;
+    const Level::LayerProblem& problem = problems[idx];
+    if (problem.points.size() < 2)
+      continue;  // not enough to pin down yaw, scale and translation
+
+    QElapsedTimer timer;
+    timer.start();
+    const Level::LayerSolution solution = Level::solve_layer_problem(problem);
+    qCDebug(lc_transform, "re-optimized layer %s in %.1f ms: %s",
+      problem.layer_name.c_str(),
+      timer.nsecsElapsed() / 1.0e6,
+      solution.summary.c_str());
+    if (solution.solved)
+      command->set_transform(idx, solution.transform);
+  }
+
+  if (command->is_empty())
+    delete command;
+  else
+    undo_stack->push(command);
+}
+
+void Editor::edit_align_colinear()
+{
+  qCDebug(lc_edit, "Editor::edit_align_colinear()");
+  Level* level = active_level();
+  if (!level)
+    return;
+  level->align_colinear();
+  create_scene();
+}
+
+void Editor::edit_align_all_colinear()
+{
+  qCDebug(lc_edit, "Editor::edit_align_all_colinear()");
+  Level* level = active_level();
+  if (!level)
+    return;
+
+  bool ok = false;
+  const double tolerance = QInputDialog::getDouble(
+    this,
+    "Align all colinear vertices",
+    "Straighten every line of edges which is within (meters):",
+    0.05,
+    0.001,
+    1.0,
+    3,
+    &ok);
+  if (!ok)
+    return;
+
+  const std::vector<ColinearAlignment::Move> moves =
+    level->colinear_alignment(tolerance, 2.0 * M_PI / 180.0);
+  qCDebug(lc_edit, "aligning %zu of %zu vertices",
+    moves.size(),
+    level->vertices.size());
+  if (moves.empty())
+    return;
+
+  undo_stack->push(new MoveVerticesCommand(&building, level_idx, moves));
+  set_modified();
+  create_scene();
+}
+
+void Editor::edit_generate_lane_grid()
+{
+  Level* level = active_level();
+  if (!level)
+    return;
+  int polygon_idx = -1;
+  for (std::size_t i = 0; i < level->polygons.size(); i++)
+  {
+    if (level->polygons[i].selected &&
+      level->polygons[i].type == Polygon::ROI)
+      polygon_idx = static_cast<int>(i);
+  }
+  if (polygon_idx < 0)
+  {
+    QMessageBox::information(
+      this,
+      "Generate lane grid",
+      "Select an ROI polygon to fill with lanes.");
+    return;
+  }
+
+  LaneGridGenerator::Options options;
+  options.orientation =
+    LaneGridGenerator::longest_side_orientation(*level, polygon_idx);
+  options.graph_idx = rendering_options.active_traffic_map_idx;
+
+  QDialog dialog(this);
+  dialog.setWindowTitle("Generate lane grid");
+  QFormLayout* form = new QFormLayout(&dialog);
+  auto add_meters = [form](const QString& label, const double value)
+    {
+      QDoubleSpinBox* box = new QDoubleSpinBox;
+      box->setDecimals(2);
+      box->setRange(0.0, 1000.0);
+      box->setSuffix(" m");
+      box->setValue(value);
+      form->addRow(label, box);
+      return box;
+    };
+  auto add_direction = [form](const QString& label)
+    {
+      QComboBox* box = new QComboBox;
+      for (int i = 0; i < LaneGridGenerator::NUM_DIRECTIONS; i++)
+        box->addItem(
+          LaneGridGenerator::direction_name(
+            static_cast<LaneGridGenerator::Direction>(i)));
+      form->addRow(label, box);
+      return box;
+    };
+  QDoubleSpinBox* aisle_box =
+    add_meters("Aisle spacing:", options.aisle_spacing);
+  QDoubleSpinBox* cross_box =
+    add_meters("Cross aisle spacing:", options.cross_spacing);
+  QDoubleSpinBox* orientation_box = new QDoubleSpinBox;
+  orientation_box->setDecimals(1);
+  orientation_box->setRange(-180.0, 180.0);
+  orientation_box->setSuffix(" deg");
+  orientation_box->setValue(options.orientation);
+  form->addRow("Aisle orientation:", orientation_box);
+  QComboBox* aisle_direction_box = add_direction("Aisles:");
+  QComboBox* cross_direction_box = add_direction("Cross aisles:");
+  QSpinBox* graph_box = new QSpinBox;
+  graph_box->setRange(0, RenderingOptions::NUM_BUILDING_LANES - 1);
+  graph_box->setValue(options.graph_idx);
+  form->addRow("Graph:", graph_box);
+  QDoubleSpinBox* clearance_box =
+    add_meters("Clearance from walls:", options.clearance);
+  QDialogButtonBox* buttons =
+    new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+  connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+  connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+  form->addRow(buttons);
+  if (dialog.exec() != QDialog::Accepted)
+    return;
+
+  options.aisle_spacing = aisle_box->value();
+  options.cross_spacing = cross_box->value();
+  options.orientation = orientation_box->value();
+  options.aisle_direction = static_cast<LaneGridGenerator::Direction>(
+    aisle_direction_box->currentIndex());
+  options.cross_direction = static_cast<LaneGridGenerator::Direction>(
+    cross_direction_box->currentIndex());
+  options.graph_idx = graph_box->value();
+  options.clearance = clearance_box->value();
+
+  QElapsedTimer timer;
+  timer.start();
+  const LaneGridGenerator::Result result =
+    LaneGridGenerator::generate(*level, polygon_idx, options);
+  if (!result.error.isEmpty())
+  {
+    QMessageBox::critical(this, "Generate lane grid", result.error);
+    return;
+  }
+  if (result.edges.empty())
+  {
+    statusBar()->showMessage("No lanes fit in the ROI", 5000);
+    return;
+  }
+
+  std::unique_ptr<BatchEditTransaction> transaction(
+    new BatchEditTransaction(building));
+  BatchEditTransaction::Lists lists = transaction->lists(level_idx);
+  const std::size_t first_vertex = lists.vertices.size();
+  const std::size_t first_edge = lists.edges.size();
+  const int offset = static_cast<int>(first_vertex);
+  lists.vertices.insert(
+    lists.vertices.end(),
+    result.vertices.begin(),
+    result.vertices.end());
+  lists.edges.reserve(lists.edges.size() + result.edges.size());
+  for (const Edge& edge : result.edges)
+  {
+    lists.edges.push_back(edge);
+    lists.edges.back().start_idx += offset;
+    lists.edges.back().end_idx += offset;
+  }
+
+  // joins the grid to the vertices already on it, such as the ends of
+  // lanes drawn up to the region, and drops the lanes it already has
+  const double meters_per_pixel = level->drawing_meters_per_pixel;
+  const GeometryCleanup::Report report = GeometryCleanup::run(
+    lists.vertices,
+    lists.edges,
+    lists.polygons,
+    meters_per_pixel > 0.0 ? 0.01 / meters_per_pixel : 0.01,
+    first_vertex,
+    first_edge);
+  const std::size_t num_vertices = lists.vertices.size() - first_vertex;
+  const std::size_t num_lanes = lists.edges.size() - first_edge;
+  transaction->finish();
+  qCInfo(lc_edit,
+    "generated %zu lanes and %zu vertices (%d blocked, %d welded) in %lld "
+    "ms",
+    num_lanes,
+    num_vertices,
+    result.num_blocked,
+    report.welded_vertices,
+    static_cast<long long>(timer.elapsed()));
+
+  undo_stack->push(
+    new BatchEditCommand("Generate lane grid", std::move(transaction)));
+  set_modified();
+  update_property_editor();
+  apply_level_changes();
+  statusBar()->showMessage(
+    QString("Generated %1 lanes and %2 vertices; %3 lanes were blocked")
+    .arg(num_lanes)
+    .arg(num_vertices)
+    .arg(result.num_blocked),
+    10000);
+}
+
+void Editor::edit_cleanup_geometry()
+{
+  qCDebug(lc_edit, "Editor::edit_cleanup_geometry()");
+  if (!active_level())
+    return;
+
+  bool ok = false;
+  const double tolerance = QInputDialog::getDouble(
+    this,
+    "Weld vertices and remove duplicate edges",
+    "Weld the vertices which are within (meters):",
+    0.01,
+    0.0,
+    1.0,
+    3,
+    &ok);
+  if (!ok)
+    return;
+
+  QElapsedTimer timer;
+  timer.start();
+  std::unique_ptr<BatchEditTransaction> transaction(
+    new BatchEditTransaction(building));
+  const double meters_per_pixel =
+    building.levels[level_idx].drawing_meters_per_pixel;
+  BatchEditTransaction::Lists lists = transaction->lists(level_idx);
+  const GeometryCleanup::Report report = GeometryCleanup::run(
+    lists.vertices,
+    lists.edges,
+    lists.polygons,
+    meters_per_pixel > 0.0 ? tolerance / meters_per_pixel : tolerance);
+  qCInfo(lc_edit,
+    "welded %d vertices, removed %d zero-length and %d duplicate edges, "
+    "%d polygon vertices and %d polygons in %lld ms",
+    report.welded_vertices,
+    report.zero_length_edges,
+    report.duplicate_edges,
+    report.polygon_vertices,
+    report.degenerate_polygons,
+    static_cast<long long>(timer.elapsed()));
+  if (report.empty())
+  {
+    transaction->undo();
+    apply_level_changes();
+    statusBar()->showMessage("Nothing to weld or remove", 5000);
+    return;
+  }
+  transaction->finish();
+
+  undo_stack->push(
+    new BatchEditCommand("Weld vertices", std::move(transaction)));
+  set_modified();
+  update_property_editor();
+  apply_level_changes();
+  statusBar()->showMessage(
+    QString("Welded %1 vertices; removed %2 edges and %3 polygons")
+    .arg(report.welded_vertices)
+    .arg(report.zero_length_edges + report.duplicate_edges)
+    .arg(report.degenerate_polygons),
+    5000);
+}
+
+void Editor::edit_simplify_geometry()
+{
+  qCDebug(lc_edit, "Editor::edit_simplify_geometry()");
+  if (!active_level())
+    return;
+
+  bool ok = false;
+  const double tolerance = QInputDialog::getDouble(
+    this,
+    "Simplify walls and polygons",
+    "Remove the vertices of the selected walls and polygons, or of all of "
+    "them if none are selected,\nwhich are within (meters) of the "
+    "simplified outline:",
+    0.05,
+    0.0,
+    1.0,
+    3,
+    &ok);
+  if (!ok)
+    return;
+
+  QElapsedTimer timer;
+  timer.start();
+  std::unique_ptr<BatchEditTransaction> transaction(
+    new BatchEditTransaction(building));
+  const double meters_per_pixel =
+    building.levels[level_idx].drawing_meters_per_pixel;
+  BatchEditTransaction::Lists lists = transaction->lists(level_idx);
+  std::vector<int> wall_idxs;
+  std::vector<int> polygon_idxs;
+  for (std::size_t i = 0; i < lists.edges.size(); i++)
+  {
+    if (lists.edges[i].selected && lists.edges[i].type == Edge::WALL)
+      wall_idxs.push_back(static_cast<int>(i));
+  }
+  for (std::size_t i = 0; i < lists.polygons.size(); i++)
+  {
+    if (lists.polygons[i].selected)
+      polygon_idxs.push_back(static_cast<int>(i));
+  }
+  if (wall_idxs.empty() && polygon_idxs.empty())
+  {
+    for (std::size_t i = 0; i < lists.edges.size(); i++)
+    {
+      if (lists.edges[i].type == Edge::WALL)
+        wall_idxs.push_back(static_cast<int>(i));
+    }
+    for (std::size_t i = 0; i < lists.polygons.size(); i++)
+      polygon_idxs.push_back(static_cast<int>(i));
+  }
+  const GeometrySimplifier::Report report = GeometrySimplifier::run(
+    lists.vertices,
+    lists.edges,
+    lists.polygons,
+    wall_idxs,
+    polygon_idxs,
+    meters_per_pixel > 0.0 ? tolerance / meters_per_pixel : tolerance);
+  qCInfo(lc_edit,
+    "simplified %d wall chains and %d polygons, removing %d walls and "
+    "%d vertices, in %lld ms",
+    report.chains,
+    report.polygons,
+    report.walls,
+    report.vertices,
+    static_cast<long long>(timer.elapsed()));
+  if (report.empty())
+  {
+    transaction->undo();
+    apply_level_changes();
+    statusBar()->showMessage("Nothing to simplify", 5000);
+    return;
+  }
+  transaction->finish();
+
+  undo_stack->push(
+    new BatchEditCommand("Simplify", std::move(transaction)));
+  set_modified();
+  update_property_editor();
+  apply_level_changes();
+  statusBar()->showMessage(
+    QString("Removed %1 vertices from %2 wall chains and %3 polygons")
+    .arg(report.vertices)
+    .arg(report.chains)
+    .arg(report.polygons),
+    5000);
+}
+
+void Editor::edit_polygon_booleans(const PolygonBooleans::Operation operation)
+{
+  qCDebug(lc_edit, "Editor::edit_polygon_booleans(%d)",
+    static_cast<int>(operation));
+  if (!active_level())
+    return;
+  const double meters_per_pixel =
+    building.levels[level_idx].drawing_meters_per_pixel;
+  const double pixels_per_meter =
+    meters_per_pixel > 0.0 ? 1.0 / meters_per_pixel : 1.0;
+
+  double distance = 0.0;
+  if (operation == PolygonBooleans::OFFSET)
+  {
+    bool ok = false;
+    distance = QInputDialog::getDouble(
+      this,
+      "Offset polygons",
+      "Grow the selected polygons by (meters), or shrink them if negative:",
+      0.5,
+      -100.0,
+      100.0,
+      3,
+      &ok);
+    if (!ok)
+      return;
+    distance *= pixels_per_meter;
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+  std::unique_ptr<BatchEditTransaction> transaction(
+    new BatchEditTransaction(building));
+  BatchEditTransaction::Lists lists = transaction->lists(level_idx);
+  std::vector<int> polygon_idxs;
+  for (std::size_t i = 0; i < lists.polygons.size(); i++)
+  {
+    if (lists.polygons[i].selected)
+      polygon_idxs.push_back(static_cast<int>(i));
+  }
+  // outlines are snapped to millimeters
+  PolygonClipper::Options options;
+  options.resolution = 0.001 * pixels_per_meter;
+  const PolygonBooleans::Report report = PolygonBooleans::run(
+    operation,
+    lists.vertices,
+    lists.polygons,
+    polygon_idxs,
+    distance,
+    options);
+  qCInfo(lc_edit,
+    "replaced %d polygons by %d polygons and %d holes, dropping %d holes "
+    "and adding %d vertices, in %lld ms",
+    report.polygons,
+    report.results,
+    report.holes,
+    report.dropped_holes,
+    report.vertices,
+    static_cast<long long>(timer.elapsed()));
+  if (report.empty())
+  {
+    transaction->undo();
+    apply_level_changes();
+    statusBar()->showMessage(
+      operation == PolygonBooleans::OFFSET ?
+      "Select the polygons to offset" :
+      "Select at least two overlapping polygons",
+      5000);
+    return;
+  }
+  transaction->finish();
+
+  static const char* const names[] =
+  {
+    "Union polygons",
+    "Intersect polygons",
+    "Subtract polygons",
+    "Offset polygons"
+  };
+  undo_stack->push(
+    new BatchEditCommand(names[operation], std::move(transaction)));
+  set_modified();
+  update_property_editor();
+  apply_level_changes();
+  QString message = QString("Replaced %1 polygons by %2 polygons and %3 holes")
+    .arg(report.polygons)
+    .arg(report.results)
+    .arg(report.holes);
+  if (report.dropped_holes > 0)
+    message += QString("; dropped %1 holes of polygons which are not floors")
+      .arg(report.dropped_holes);
+  statusBar()->showMessage(message, 5000);
+}
+
+void Editor::edit_copy()
+{
+  Level* level = active_level();
+  if (!level)
+    return;
+
+  std::vector<Level::SelectedItem> items;
+  level->get_selected_items(items);
+  const SelectionClipboard clip =
+    SelectionClipboard::from_selection(*level, items);
+  if (clip.empty())
+    return;
+  clip.copy_to_clipboard();
+  qCInfo(lc_edit, "copied %zu entities", clip.size());
+}
+
+void Editor::edit_paste()
+{
+  paste_clipboard(false);
+}
+
+void Editor::edit_paste_in_place()
+{
+  paste_clipboard(true);
+}
+
+bool Editor::paste_clipboard(const bool in_place)
+{
+  Level* level = active_level();
+  if (!level)
+    return false;
+
+  QElapsedTimer timer;
+  timer.start();
+  SelectionClipboard clip;
+  if (!clip.paste_from_clipboard() || clip.empty())
+    return false;
+
+  // keep the size in meters if the levels are drawn at different scales
+  const double scale = level->drawing_meters_per_pixel > 0.0 ?
+    clip.meters_per_pixel / level->drawing_meters_per_pixel : 1.0;
+  if (in_place)
+    clip.transform(scale, 0.0, 0.0);
+  else
+  {
+    const QPoint p_view =
+      map_view->viewport()->mapFromGlobal(QCursor::pos());
+    const QPointF target = map_view->viewport()->rect().contains(p_view) ?
+      map_view->mapToScene(p_view) :
+      map_view->mapToScene(map_view->viewport()->rect().center());
+    const QPointF center = clip.center() * scale;
+    clip.transform(
+      scale,
+      target.x() - center.x(),
+      target.y() - center.y());
+  }
+
+  // the pasted entities become the selection
+  building.clear_selection(level_idx);
+  undo_stack->push(new PasteCommand(&building, level_idx, clip));
+  set_modified();
+  update_property_editor();
+  apply_level_changes();
+
+  qCInfo(lc_edit, "pasted %zu entities in %lld ms",
+    clip.size(),
+    static_cast<long long>(timer.elapsed()));
+  return true;
+}
+
+void Editor::edit_duplicate_level()
+{
+  const Level* level = active_level();
+  if (!level)
+    return;
+
+  // suggest the first free name
+  QString name = QString::fromStdString(level->name) + "_copy";
+  for (int i = 2; building.find_level_idx(name.toStdString()) >= 0; i++)
+    name = QString::fromStdString(level->name) + QString("_copy%1").arg(i);
+
+  bool ok = false;
+  name = QInputDialog::getText(
+    this,
+    "Duplicate level",
+    "Name of the new level:",
+    QLineEdit::Normal,
+    name,
+    &ok);
+  if (!ok || name.isEmpty())
+    return;
+
+  // like Level > Add, adding a level can't be undone
+  const int copy_idx = building.duplicate_level(level_idx, name.toStdString());
+  if (copy_idx < 0)
+  {
+    QMessageBox::critical(
+      this,
+      "Unable to duplicate level",
+      QString("There is already a level named %1").arg(name));
+    return;
+  }
+
+  level_idx = copy_idx;
+  set_modified();
+  update_tables();
+  create_scene();
+}
+
+void Editor::add_batch_edit(std::unique_ptr<BatchEdit> batch_edit)
+{
+  if (!batch_edit || batch_edit->api_version() != BatchEdit::API_VERSION)
+    return;
+  BatchEdit* edit = batch_edit.get();
+  batch_edits.push_back(std::move(batch_edit));
+  batch_edit_menu->addAction(
+    QString::fromStdString(edit->name()),
+    [this, edit]() { run_batch_edit(*edit); });
+  batch_edit_menu->setEnabled(true);
+}
+
+bool Editor::run_batch_edit(BatchEdit& batch_edit)
+{
+  QElapsedTimer timer;
+  timer.start();
+  std::unique_ptr<BatchEditTransaction> transaction(
+    new BatchEditTransaction(building));
+  const bool ok = batch_edit.run(*transaction);
+  if (!ok || transaction->empty())
+  {
+    transaction->undo();
+    apply_level_changes();
+    if (!ok)
+      QMessageBox::critical(
+        this,
+        "Batch edit failed",
+        QString("%1 failed; nothing was changed.").arg(
+          QString::fromStdString(batch_edit.name())));
+    return false;
+  }
+  transaction->finish();
+
+  qCInfo(lc_edit, "%s changed %zu entities in %lld ms",
+    batch_edit.name().c_str(),
+    transaction->num_changed(),
+    static_cast<long long>(timer.elapsed()));
+  undo_stack->push(
+    new BatchEditCommand(batch_edit.name(), std::move(transaction)));
+  set_modified();
+  update_property_editor();
+  apply_level_changes();
+  return true;
+}
+
+void Editor::edit_rotate_selection()
+{
+  bool ok = false;
+  const double degrees = QInputDialog::getDouble(
+    this,
+    "Rotate selection",
+    "Rotate the selection counter-clockwise about its center by (degrees):",
+    90.0,
+    -360.0,
+    360.0,
+    2,
+    &ok);
+  if (ok)
+    transform_selection(degrees * M_PI / 180.0, 1.0);
+}
+
+void Editor::edit_scale_selection()
+{
+  bool ok = false;
+  const double scale = QInputDialog::getDouble(
+    this,
+    "Scale selection",
+    "Scale the selection about its center by:",
+    1.0,
+    0.01,
+    100.0,
+    3,
+    &ok);
+  if (ok)
+    transform_selection(0.0, scale);
+}
+
+bool Editor::transform_selection(const double rotation, const double scale)
+{
+  Level* level = active_level();
+  if (!level)
+    return false;
+
+  std::vector<Level::SelectedItem> items;
+  level->get_selected_items(items);
+  TransformSelectionCommand* command =
+    new TransformSelectionCommand(&building, level_idx, items);
+  if (command->size() == 0)
+  {
+    delete command;
+    return false;
+  }
+  command->set_transform(
+    TransformSelectionCommand::Similarity::about(
+      command->centroid(),
+      rotation,
+      scale));
+  qCDebug(lc_edit, "transforming %zu entities", command->size());
+  undo_stack->push(command);
+  set_modified();
+  apply_level_changes();
+  return true;
+}
+
+void Editor::view_models()
+{
+  rendering_options.show_models = view_models_action->isChecked();
+  Level* level = active_level();
+  if (level)
+    level->update_visibility(rendering_options);
+}
+
+void Editor::view_floor_triangulation()
+{
+  rendering_options.show_floor_triangulation =
+    view_floor_triangulation_action->isChecked();
+  create_scene();
+}
+
+void Editor::view_world_preview()
+{
+  if (!world_preview_dialog)
+  {
+    // not modal, so that it follows the edits
+    world_preview_dialog = new QDialog(this);
+    world_preview_dialog->setWindowTitle("3D preview");
+    QLabel* note = new QLabel(
+      "Walls and floors only, as building_map_generator will extrude "
+      "them. Generate the world for the full result.",
+      world_preview_dialog);
+    note->setWordWrap(true);
+    QVBoxLayout* layout = new QVBoxLayout(world_preview_dialog);
+    layout->addWidget(note);
+    layout->addWidget(
+      new WorldPreviewView(world_preview, world_preview_dialog),
+      1);
+  }
+  world_preview_dialog->show();
+  world_preview_dialog->raise();
+  world_preview->update(building);
+}
+
+void Editor::update_world_preview()
+{
+  if (world_preview_dialog && world_preview_dialog->isVisible())
+    world_preview_timer->start();
+}
+
+void Editor::update_minimap()
+{
+  if (!minimap_dock->isVisible())
+    return;
+  minimap->set_view_rect(map_view->visible_scene_rect());
+  if (level_idx < 0 || level_idx >= static_cast<int>(building.levels.size()))
+  {
+    minimap->set_raster(Minimap::Raster());
+    return;
+  }
+
+  auto it = minimap_rasters.find(level_idx);
+  if (it != minimap_rasters.end() &&
+    it->second.level_name == building.levels[level_idx].name)
+  {
+    if (minimap->raster().image.cacheKey() != it->second.image.cacheKey())
+      minimap->set_raster(it->second);
+    return;
+  }
+  minimap_timer->start();
+}
+
+void Editor::update_statistics()
+{
+  if (statistics_dock->isVisible())
+    statistics_timer->start();
+}
+
+void Editor::refresh_statistics()
+{
+  BuildingStatistics statistics;
+  statistics.gather(building);
+  statistics_text->setPlainText(statistics.summary());
+}
+
+void Editor::view_tower_overview()
+{
+  if (!tower_overview_dialog)
+  {
+    tower_overview_dialog = new QDialog(this);
+    tower_overview_dialog->setWindowTitle("Tower overview");
+    tower_overview = new TowerOverview(tower_overview_dialog);
+    QComboBox* layout_box = new QComboBox;
+    layout_box->addItem("Isometric", TowerOverview::ISOMETRIC);
+    layout_box->addItem("Side by side", TowerOverview::SIDE_BY_SIDE);
+    connect(
+      layout_box,
+      QOverload<int>::of(&QComboBox::currentIndexChanged),
+      [this, layout_box](int index)
+      {
+        tower_overview->set_layout(
+          static_cast<TowerOverview::Layout>(
+            layout_box->itemData(index).toInt()));
+      });
+    QHBoxLayout* bar = new QHBoxLayout;
+    bar->addWidget(new QLabel("Layout:"));
+    bar->addWidget(layout_box);
+    bar->addStretch(1);
+    QVBoxLayout* layout = new QVBoxLayout(tower_overview_dialog);
+    layout->addLayout(bar);
+    layout->addWidget(tower_overview, 1);
+  }
+  tower_overview_dialog->show();
+  tower_overview_dialog->raise();
+  refresh_tower_overview();
+}
+
+void Editor::update_tower_overview()
+{
+  if (tower_overview_dialog && tower_overview_dialog->isVisible())
+    tower_overview_timer->start();
+}
+
+void Editor::refresh_tower_overview()
+{
+  std::vector<TowerOverview::Level> levels = TowerOverview::levels(building);
+  const bool y_flipped = building.coordinate_system.is_y_flipped();
+
+  // the rasters the minimap has already, and the rest rendered together
+  std::vector<Minimap::Input> inputs;
+  std::vector<TowerOverview::Level*> missing;
+  for (TowerOverview::Level& level : levels)
+  {
+    auto it = minimap_rasters.find(level.level_idx);
+    if (it != minimap_rasters.end() && it->second.level_name == level.name)
+    {
+      level.raster = it->second;
+      continue;
+    }
+    Minimap::Input input =
+      Minimap::input(building.levels[level.level_idx], y_flipped);
+    if (input.rect.isEmpty())
+      continue;
+    inputs.push_back(input);
+    missing.push_back(&level);
+  }
+  TaskPool::instance().parallel_for(
+    static_cast<int>(inputs.size()),
+    [&](int i) { missing[i]->raster = Minimap::render(inputs[i]); });
+  for (const TowerOverview::Level* level : missing)
+    minimap_rasters[level->level_idx] = level->raster;
+
+  const int ref_idx = building.get_reference_level_idx();
+  const double meters_per_pixel =
+    ref_idx >= 0 && ref_idx < static_cast<int>(building.levels.size()) ?
+    building.levels[ref_idx].drawing_meters_per_pixel : 0.05;
+  tower_overview->set_levels(levels, meters_per_pixel, y_flipped);
+}
+
+void Editor::invalidate_minimap()
+{
+  minimap_rasters.erase(level_idx);
+  ++minimap_generation;  // whatever is being rendered is stale too
+}
+
+void Editor::render_minimap()
+{
+  if (level_idx < 0 || level_idx >= static_cast<int>(building.levels.size()))
+    return;
+
+  // the worker only sees copies, so the level can't change underneath it
+  Minimap::Input input = Minimap::input(
+    building.levels[level_idx],
+    building.coordinate_system.is_y_flipped());
+  if (input.rect.isEmpty())
+    input.rect = scene->sceneRect();
+
+  minimap_render_generation = minimap_generation;
+  minimap_render_level_idx = level_idx;
+  minimap_watcher->setFuture(
+    QtConcurrent::run(
+      [input]()
+      {
+        return Minimap::render(input);
+      }));
+}
+
+void Editor::minimap_rendered()
+{
+  // edited or switched to another level in the meantime
+  if (minimap_render_generation != minimap_generation ||
+    minimap_render_level_idx != level_idx)
+  {
+    update_minimap();
+    return;
+  }
+
+  const Minimap::Raster raster = minimap_watcher->result();
+  minimap_rasters[level_idx] = raster;
+  minimap->set_raster(raster);
+}
+
+void Editor::view_batch_vertices()
+{
+  rendering_options.batch_vertices = view_batch_vertices_action->isChecked();
+  create_scene();
+}
+
+void Editor::view_batch_edges()
+{
+  rendering_options.batch_edges = view_batch_edges_action->isChecked();
+  create_scene();
+}
+
+void Editor::view_ghost_levels()
+{
+  const bool visible = view_ghost_levels_action->isChecked();
+  if (visible && ghost_items.isEmpty())
+    draw_ghost_levels();
+  for (QGraphicsItem* item : ghost_items)
+    item->setVisible(visible);
+}
+
+void Editor::view_navmesh()
+{
+  if (view_navmesh_action->isChecked())
+    draw_navmesh();
+  else
+  {
+    for (QGraphicsItem* item : navmesh_items)
+    {
+      scene->removeItem(item);
+      delete item;
+    }
+    navmesh_items.clear();
+  }
+}
+
+void Editor::draw_navmesh()
+{
+  for (QGraphicsItem* item : navmesh_items)
+  {
+    scene->removeItem(item);
+    delete item;
+  }
+  navmesh_items.clear();
+
+  if (level_idx < 0 || level_idx >= static_cast<int>(building.levels.size()))
+    return;
+
+  const NavmeshBuilder* builder = navmeshes.build_level(building, level_idx);
+  if (!builder)
+    return;
+
+  const std::vector<NavmeshBuilder::Point>& vertices = builder->vertices();
+  auto to_scene = [builder, &vertices](const int vertex_idx)
+    {
+      const NavmeshBuilder::Point p =
+        builder->to_pixels(vertices[vertex_idx]);
+      return QPointF(p.x, p.y);
+    };
+
+  const QBrush brush(QColor::fromRgbF(0.2, 0.8, 0.4, 0.25));
+  const QPen node_pen(QColor::fromRgbF(0.1, 0.5, 0.2, 0.6), 0);
+  for (const NavmeshBuilder::Node& node : builder->nodes())
+  {
+    QPolygonF polygon;
+    for (const int v : node.vertices)
+      polygon.append(to_scene(v));
+    QGraphicsPolygonItem* item = scene->addPolygon(polygon, node_pen, brush);
+    item->setZValue(5.0);  // above the floor, below lanes and vertices
+    navmesh_items.append(item);
+  }
+
+  // the walls the crowd simulation will see
+  const QPen obstacle_pen(QColor::fromRgbF(0.8, 0.1, 0.1, 0.8), 0);
+  for (const NavmeshBuilder::Obstacle& obstacle : builder->obstacles())
+  {
+    QGraphicsLineItem* item = scene->addLine(
+      QLineF(to_scene(obstacle.v0), to_scene(obstacle.v1)),
+      obstacle_pen);
+    item->setZValue(5.1);
+    navmesh_items.append(item);
+  }
+}
+
+void Editor::update_traffic_maps_menu()
+{
+  traffic_maps_menu->clear();
+  for (std::size_t i = 0; i < building.traffic_maps.size(); i++)
+  {
+    const TrafficMap& traffic_map = building.traffic_maps[i];
+    QAction* action = traffic_maps_menu->addAction(
+      QString::fromStdString(traffic_map.name));
+    action->setCheckable(true);
+    action->setChecked(traffic_map.visible);
+    action->setToolTip(QString::fromStdString(traffic_map.filename));
+    connect(
+      action,
+      &QAction::toggled,
+      [this, i](bool checked) { view_traffic_map(i, checked); });
+  }
+  if (!building.traffic_maps.empty())
+    traffic_maps_menu->addSeparator();
+  traffic_maps_menu->addAction(
+    "&Add traffic map...",
+    this,
+    &Editor::add_traffic_map);
+}
+
+void Editor::view_traffic_map(const std::size_t idx, const bool visible)
+{
+  if (idx >= building.traffic_maps.size())
+    return;
+  building.traffic_maps[idx].visible = visible;
+  if (idx < traffic_map_items.size() && traffic_map_items[idx])
+    traffic_map_items[idx]->setVisible(visible);
+  else if (visible)
+    draw_traffic_maps();
+}
+
+void Editor::add_traffic_map()
+{
+  TrafficMap traffic_map;
+  traffic_map.name =
+    "traffic_map_" + std::to_string(building.traffic_maps.size() + 1);
+  TrafficMapDialog dialog(traffic_map);
+  if (dialog.exec() != QDialog::Accepted)
+    return;
+  building.traffic_maps.push_back(traffic_map);
+  set_modified();
+  draw_traffic_maps();
+}
+
+void Editor::draw_traffic_maps()
+{
+  traffic_map_items.resize(building.traffic_maps.size(), nullptr);
+  if (level_idx < 0 || level_idx >= static_cast<int>(building.levels.size()))
+    return;
+
+  // only the visible maps that aren't drawn yet; the others are shown
+  // and hidden as they are
+  const std::string& level_name = building.levels[level_idx].name;
+  for (std::size_t i = 0; i < building.traffic_maps.size(); i++)
+  {
+    const TrafficMap& traffic_map = building.traffic_maps[i];
+    if (!traffic_map.visible || traffic_map_items[i])
+      continue;
+    traffic_map_items[i] = traffic_map.create_item(level_name);
+    if (traffic_map_items[i])
+      scene->addItem(traffic_map_items[i]);
+  }
+}
+
+void Editor::view_lane_connectivity()
+{
+  if (view_lane_connectivity_action->isChecked())
+    draw_lane_connectivity();
+  else
+  {
+    for (QGraphicsItem* item : lane_connectivity_items)
+    {
+      scene->removeItem(item);
+      delete item;
+    }
+    lane_connectivity_items.clear();
+  }
+}
+
+void Editor::draw_lane_connectivity()
+{
+  for (QGraphicsItem* item : lane_connectivity_items)
+  {
+    scene->removeItem(item);
+    delete item;
+  }
+  lane_connectivity_items.clear();
+
+  if (level_idx < 0 || level_idx >= static_cast<int>(building.levels.size()))
+    return;
+  const Level& level = building.levels[level_idx];
+  LaneGraphAnalysis& analysis = lane_graph_analyses[level_idx];
+  analysis.update(level);
+
+  // rings around the vertices, as wide as a robot would be
+  const double radius = 0.6 / level.drawing_meters_per_pixel;
+  int num_vertices = 0;
+  for (const LaneGraphAnalysis::Component& component : analysis.components())
+  {
+    QColor color;
+    switch (component.kind)
+    {
+      case LaneGraphAnalysis::SINK:
+        color = QColor(220, 0, 0);
+        break;
+      case LaneGraphAnalysis::SOURCE:
+        color = QColor(255, 140, 0);
+        break;
+      case LaneGraphAnalysis::ONE_WAY:
+        color = QColor(200, 0, 200);
+        break;
+      default:
+        color = QColor(230, 200, 0);
+        break;
+    }
+    const QPen pen(color, radius / 3.0);
+    for (const int v : component.vertices)
+    {
+      const Vertex& vertex = level.vertices[v];
+      QGraphicsEllipseItem* item = scene->addEllipse(
+        vertex.x - radius,
+        vertex.y - radius,
+        2.0 * radius,
+        2.0 * radius,
+        pen);
+      item->setZValue(15.0);  // over the lanes
+      lane_connectivity_items.append(item);
+      num_vertices++;
+    }
+  }
+
+  statusBar()->showMessage(
+    QString::asprintf(
+      "%d lane graph components outside the main ones (%d vertices): "
+      "red can't be left, orange can't be reached, purple is one-way, "
+      "yellow is unconnected",
+      static_cast<int>(analysis.components().size()),
+      num_vertices),
+    10000);
+}
+
+void Editor::view_lane_conflicts()
+{
+  if (view_lane_conflicts_action->isChecked())
+    draw_lane_conflicts();
+  else
+  {
+    for (QGraphicsItem* item : lane_conflict_items)
+    {
+      scene->removeItem(item);
+      delete item;
+    }
+    lane_conflict_items.clear();
+  }
+}
+
+void Editor::draw_lane_conflicts()
+{
+  for (QGraphicsItem* item : lane_conflict_items)
+  {
+    scene->removeItem(item);
+    delete item;
+  }
+  lane_conflict_items.clear();
+
+  if (level_idx < 0 || level_idx >= static_cast<int>(building.levels.size()))
+    return;
+  const Level& level = building.levels[level_idx];
+  LaneConflictChecker& checker = lane_conflict_checkers[level_idx];
+  checker.update(level);
+
+  // crosses where lanes cross something, rings where they are too close
+  const double radius = 0.4 / level.drawing_meters_per_pixel;
+  int num_crossings = 0;
+  int num_too_close = 0;
+  for (const LaneConflictChecker::Conflict& conflict : checker.conflicts())
+  {
+    if (conflict.kind == LaneConflictChecker::CLEARANCE)
+    {
+      QGraphicsEllipseItem* item = scene->addEllipse(
+        conflict.x - radius,
+        conflict.y - radius,
+        2.0 * radius,
+        2.0 * radius,
+        QPen(QColor(255, 140, 0), radius / 3.0));
+      item->setZValue(15.0);
+      lane_conflict_items.append(item);
+      num_too_close++;
+      continue;
+    }
+
+    const QPen pen(
+      conflict.kind == LaneConflictChecker::LANE_WALL ?
+      QColor(220, 0, 0) : QColor(200, 0, 200),
+      radius / 3.0);
+    for (const double sign : {1.0, -1.0})
+    {
+      QGraphicsLineItem* item = scene->addLine(
+        conflict.x - radius,
+        conflict.y - sign * radius,
+        conflict.x + radius,
+        conflict.y + sign * radius,
+        pen);
+      item->setZValue(15.0);
+      lane_conflict_items.append(item);
+    }
+    num_crossings++;
+  }
+
+  statusBar()->showMessage(
+    QString::asprintf(
+      "%d lane crossings (red: walls, purple: lanes without a vertex) and "
+      "%d human lanes too close to walls (orange); %d lanes checked",
+      num_crossings,
+      num_too_close,
+      checker.num_checked()));
+}
+
+void Editor::view_model_overlaps()
+{
+  if (view_model_overlaps_action->isChecked())
+    draw_model_overlaps();
+  else
+  {
+    for (QGraphicsItem* item : model_overlap_items)
+    {
+      scene->removeItem(item);
+      delete item;
+    }
+    model_overlap_items.clear();
+  }
+}
+
+void Editor::draw_model_overlaps()
+{
+  for (QGraphicsItem* item : model_overlap_items)
+  {
+    scene->removeItem(item);
+    delete item;
+  }
+  model_overlap_items.clear();
+
+  if (level_idx < 0 || level_idx >= static_cast<int>(building.levels.size()))
+    return;
+  const Level& level = building.levels[level_idx];
+  ModelOverlapChecker& checker = model_overlap_checkers[level_idx];
+  checker.update(level, editor_models);
+
+  // outlines of the overlapping models, and crosses where lanes cross one
+  const double radius = 0.4 / level.drawing_meters_per_pixel;
+  const QPen model_pen(QColor(220, 0, 0), radius / 3.0);
+  std::set<int> outlined;
+  int num_overlaps = 0;
+  int num_on_lanes = 0;
+  for (const ModelOverlapChecker::Conflict& conflict : checker.conflicts())
+  {
+    if (conflict.kind == ModelOverlapChecker::MODEL_LANE)
+    {
+      const QPen pen(QColor(255, 140, 0), radius / 3.0);
+      for (const double sign : {1.0, -1.0})
+      {
+        QGraphicsLineItem* item = scene->addLine(
+          conflict.x - radius,
+          conflict.y - sign * radius,
+          conflict.x + radius,
+          conflict.y + sign * radius,
+          pen);
+        item->setZValue(150.0);  // above the models
+        model_overlap_items.append(item);
+      }
+      num_on_lanes++;
+      continue;
+    }
+
+    for (const int idx : {conflict.model_idx, conflict.other_idx})
+    {
+      if (!outlined.insert(idx).second)
+        continue;
+      double xs[4];
+      double ys[4];
+      checker.footprints()[idx].corners(xs, ys);
+      QPolygonF outline;
+      for (int i = 0; i < 4; i++)
+        outline.append(QPointF(xs[i], ys[i]));
+      QGraphicsPolygonItem* item = scene->addPolygon(outline, model_pen);
+      item->setZValue(150.0);
+      model_overlap_items.append(item);
+    }
+    num_overlaps++;
+  }
+
+  statusBar()->showMessage(
+    QString::asprintf(
+      "%d model overlaps (red) and %d models on lanes (orange); "
+      "%d models checked, %d without a thumbnail",
+      num_overlaps,
+      num_on_lanes,
+      checker.num_checked(),
+      checker.num_unknown()));
+}
+
+void Editor::view_door_clearance()
+{
+  if (view_door_clearance_action->isChecked())
+    draw_door_clearance();
+  else
+  {
+    for (QGraphicsItem* item : door_clearance_items)
+    {
+      scene->removeItem(item);
+      delete item;
+    }
+    door_clearance_items.clear();
+  }
+}
+
+void Editor::draw_door_clearance()
+{
+  for (QGraphicsItem* item : door_clearance_items)
+  {
+    scene->removeItem(item);
+    delete item;
+  }
+  door_clearance_items.clear();
+
+  if (level_idx < 0 || level_idx >= static_cast<int>(building.levels.size()))
+    return;
+  const Level& level = building.levels[level_idx];
+  DoorClearanceChecker& checker = door_clearance_checkers[level_idx];
+  checker.update(level, editor_models);
+
+  // the blocked envelopes filled in red, and a cross on each obstacle
+  const double radius = 0.4 / level.drawing_meters_per_pixel;
+  const QPen pen(QColor(220, 0, 0), radius / 3.0);
+  const QBrush brush(QColor(220, 0, 0, 80));
+  std::set<int> filled;
+  int num_counts[4] = {0, 0, 0, 0};
+  for (const DoorClearanceChecker::Violation& violation :
+    checker.violations())
+  {
+    if (filled.insert(violation.door_idx).second)
+    {
+      for (const QPolygonF& envelope :
+        checker.envelopes()[violation.door_idx])
+      {
+        QGraphicsPolygonItem* item =
+          scene->addPolygon(envelope, QPen(Qt::NoPen), brush);
+        item->setZValue(15.0);
+        door_clearance_items.append(item);
+      }
+    }
+    for (const double sign : {1.0, -1.0})
+    {
+      QGraphicsLineItem* item = scene->addLine(
+        violation.x - radius,
+        violation.y - sign * radius,
+        violation.x + radius,
+        violation.y + sign * radius,
+        pen);
+      item->setZValue(150.0);  // above the models
+      door_clearance_items.append(item);
+    }
+    num_counts[violation.kind]++;
+  }
+
+  statusBar()->showMessage(
+    QString::asprintf(
+      "%zu of %d doors blocked: %d by walls, %d by other doors, "
+      "%d by models and %d by parked robots",
+      filled.size(),
+      checker.num_doors(),
+      num_counts[DoorClearanceChecker::WALL],
+      num_counts[DoorClearanceChecker::DOOR],
+      num_counts[DoorClearanceChecker::MODEL],
+      num_counts[DoorClearanceChecker::ROBOT]));
+}
+
+void Editor::view_lane_clearance()
+{
+  if (view_lane_clearance_action->isChecked())
+    draw_lane_clearance();
+  else
+  {
+    for (QGraphicsItem* item : lane_sweep_items)
+    {
+      scene->removeItem(item);
+      delete item;
+    }
+    lane_sweep_items.clear();
+  }
+}
+
+void Editor::draw_lane_clearance()
+{
+  for (QGraphicsItem* item : lane_sweep_items)
+  {
+    scene->removeItem(item);
+    delete item;
+  }
+  lane_sweep_items.clear();
+
+  if (level_idx < 0 || level_idx >= static_cast<int>(building.levels.size()))
+    return;
+  const Level& level = building.levels[level_idx];
+  const QString footprint_text = QSettings().value(
+    preferences_keys::robot_footprint,
+    QString()).toString();
+  LaneSweepChecker::Outline footprint =
+    LaneSweepChecker::parse_footprint(footprint_text);
+  if (footprint.empty())
+  {
+    if (!footprint_text.isEmpty())
+      qCWarning(
+        lc_edit,
+        "unable to parse robot footprint [%s]",
+        qUtf8Printable(footprint_text));
+    footprint = LaneSweepChecker::default_footprint();
+  }
+  LaneSweepChecker& checker = lane_sweep_checkers[level_idx];
+  checker.set_footprint(footprint);
+  checker.update(level, editor_models);
+
+  auto to_polygon = [](const LaneSweepChecker::Outline& outline)
+    {
+      QPolygonF polygon;
+      for (const QPointF& p : outline)
+        polygon.append(p);
+      return polygon;
+    };
+
+  // the lanes the robot fits along in green, the sweeps of the others
+  // filled in red, and the turns it can't make outlined in orange
+  const double width = 0.1 / level.drawing_meters_per_pixel;
+  const QPen clear_pen(QColor(0, 160, 0, 160), width);
+  for (const int edge_idx : checker.clear_lanes())
+  {
+    const Edge& edge = level.edges[edge_idx];
+    QGraphicsLineItem* item = scene->addLine(
+      level.vertices[edge.start_idx].x,
+      level.vertices[edge.start_idx].y,
+      level.vertices[edge.end_idx].x,
+      level.vertices[edge.end_idx].y,
+      clear_pen);
+    item->setZValue(15.0);
+    lane_sweep_items.append(item);
+  }
+  const QBrush blocked_brush(QColor(220, 0, 0, 80));
+  for (const int edge_idx : checker.blocked_lanes())
+  {
+    QGraphicsPolygonItem* item = scene->addPolygon(
+      to_polygon(checker.lane_sweep(edge_idx)),
+      QPen(Qt::NoPen),
+      blocked_brush);
+    item->setZValue(15.0);
+    lane_sweep_items.append(item);
+  }
+  const QPen turn_pen(QColor(255, 128, 0), width);
+  for (const int vertex_idx : checker.blocked_turns())
+  {
+    for (const LaneSweepChecker::Outline& sweep :
+      checker.blocked_turn_sweeps(vertex_idx))
+    {
+      QGraphicsPolygonItem* item =
+        scene->addPolygon(to_polygon(sweep), turn_pen);
+      item->setZValue(150.0);  // above the models
+      lane_sweep_items.append(item);
+    }
+  }
+
+  statusBar()->showMessage(
+    QString::asprintf(
+      "%zu of %zu lanes too narrow for the robot (red), and %zu vertices "
+      "where it can't turn (orange); %d checked",
+      checker.blocked_lanes().size(),
+      checker.blocked_lanes().size() + checker.clear_lanes().size(),
+      checker.blocked_turns().size(),
+      checker.num_checked()));
+}
+
+void Editor::view_lane_usage()
+{
+  if (view_lane_usage_action->isChecked())
+    update_lane_usage();
+  else
+  {
+    lane_usage_timer->stop();
+    for (QGraphicsItem* item : lane_usage_items)
+    {
+      scene->removeItem(item);
+      delete item;
+    }
+    lane_usage_items.clear();
+  }
+}
+
+void Editor::update_lane_usage()
+{
+  ++lane_usage_generation;
+  draw_lane_usage();  // the last result, along the lanes as they are now
+  lane_usage_timer->start();
+}
+
+void Editor::compute_lane_usage()
+{
+  if (!view_lane_usage_action->isChecked() ||
+    level_idx < 0 || level_idx >= static_cast<int>(building.levels.size()))
+    return;
+  if (lane_usage_watcher->isRunning())
+    return;  // lane_usage_computed() starts again
+
+  // the job reads a copy which is never edited, and gets the analysis to
+  // itself until it finishes
+  const std::shared_ptr<const BuildingSnapshot> snapshot =
+    snapshot_publisher.publish(building);
+  const std::shared_ptr<const Level> level = snapshot->levels[level_idx];
+  std::shared_ptr<LaneUsageAnalysis>& analysis =
+    lane_usage_analyses[level_idx];
+  if (!analysis)
+    analysis = std::make_shared<LaneUsageAnalysis>();
+  const std::shared_ptr<LaneUsageAnalysis> job = analysis;
+
+  lane_usage_run_generation = lane_usage_generation;
+  lane_usage_run_level_idx = level_idx;
+  lane_usage_watcher->setFuture(
+    TaskPool::instance().run(
+      TaskPool::INTERACTIVE,
+      [job, level]()
+      {
+        return job->update(*level);
+      }));
+}
+
+void Editor::lane_usage_computed()
+{
+  if (!view_lane_usage_action->isChecked())
+    return;
+  const bool current = lane_usage_run_generation == lane_usage_generation;
+  if (lane_usage_run_level_idx == level_idx)
+  {
+    lane_usage_result = lane_usage_watcher->result();
+    lane_usage_result_level_idx = level_idx;
+    draw_lane_usage();
+  }
+  if (!current || lane_usage_run_level_idx != level_idx)
+  {
+    compute_lane_usage();  // edited or switched level in the meantime
+    return;
+  }
+
+  const LaneUsageAnalysis::Result& result = lane_usage_result;
+  statusBar()->showMessage(
+    QString::asprintf(
+      "Lane usage: the busiest lane is on the quickest routes of %.0f "
+      "pairs of vertices (red); %d of %d connected parts searched%s, "
+      "in %.0f ms",
+      result.max_usage,
+      result.num_computed,
+      result.num_parts,
+      result.sampled ? ", some from a sample" : "",
+      result.ms),
+    10000);
+}
+
+void Editor::draw_lane_usage()
+{
+  for (QGraphicsItem* item : lane_usage_items)
+  {
+    scene->removeItem(item);
+    delete item;
+  }
+  lane_usage_items.clear();
+
+  if (lane_usage_result_level_idx != level_idx ||
+    lane_usage_result.max_usage <= 0.0)
+    return;
+  const Level& level = building.levels[level_idx];
+
+  // the result may be of the level before the last edits: the lanes
+  // which are gone, or aren't lanes any more, are skipped
+  const int num_vertices = static_cast<int>(level.vertices.size());
+  const double width = 0.4 / level.drawing_meters_per_pixel;
+  const std::vector<double>& usage = lane_usage_result.usage;
+  for (std::size_t i = 0; i < usage.size() && i < level.edges.size(); i++)
+  {
+    const Edge& edge = level.edges[i];
+    if (edge.type != Edge::LANE ||
+      edge.start_idx < 0 || edge.start_idx >= num_vertices ||
+      edge.end_idx < 0 || edge.end_idx >= num_vertices)
+      continue;
+
+    // from blue for the quiet lanes to red for the busiest, as the crowd
+    // preview heatmap
+    const double t = std::min(1.0, usage[i] / lane_usage_result.max_usage);
+    QPen pen(
+      QColor(
+        static_cast<int>(255 * t),
+        static_cast<int>(64 * (1.0 - t)),
+        static_cast<int>(255 * (1.0 - t)),
+        180),
+      width);
+    pen.setCapStyle(Qt::RoundCap);
+    QGraphicsLineItem* item = scene->addLine(
+      level.vertices[edge.start_idx].x,
+      level.vertices[edge.start_idx].y,
+      level.vertices[edge.end_idx].x,
+      level.vertices[edge.end_idx].y,
+      pen);
+    item->setZValue(15.0);
+    lane_usage_items.append(item);
+  }
+}
+
+void Editor::view_lane_route()
+{
+  if (level_idx < 0 || level_idx >= static_cast<int>(building.levels.size()))
+    return;
+  const Level& level = building.levels[level_idx];
+  std::vector<int> selected;
+  for (std::size_t i = 0; i < level.vertices.size(); i++)
+  {
+    if (level.vertices[i].selected)
+      selected.push_back(static_cast<int>(i));
+  }
+
+  LanePathPlanner::Stop stop;
+  stop.level_idx = level_idx;
+  if (selected.size() == 2)
+  {
+    // from the vertex clicked first, if that is known
+    const bool reversed = clicked_idx == selected[0];
+    lane_route_from.level_idx = level_idx;
+    lane_route_from.vertex_idx = selected[reversed ? 1 : 0];
+    lane_route_to.level_idx = level_idx;
+    lane_route_to.vertex_idx = selected[reversed ? 0 : 1];
+  }
+  else if (selected.size() == 1 &&
+    lane_route_from.level_idx >= 0 && lane_route_to.level_idx < 0)
+  {
+    // the destination of the start chosen before, maybe on another level
+    lane_route_to.level_idx = level_idx;
+    lane_route_to.vertex_idx = selected[0];
+  }
+  else if (selected.size() == 1)
+  {
+    lane_route_from.level_idx = level_idx;
+    lane_route_from.vertex_idx = selected[0];
+    lane_route_to = LanePathPlanner::Stop();
+    draw_lane_route();  // removes any previous route
+    statusBar()->showMessage(
+      "Route start set: select the destination vertex, on any level, "
+      "and choose View > Lane route again");
+    return;
+  }
+  else
+  {
+    lane_route_from = LanePathPlanner::Stop();
+    lane_route_to = LanePathPlanner::Stop();
+    draw_lane_route();
+    statusBar()->showMessage(
+      "Select two vertices, or one as the start and then another as the "
+      "destination, to see the quickest lane route between them");
+    return;
+  }
+  draw_lane_route();
+}
+
+void Editor::draw_lane_route()
+{
+  for (QGraphicsItem* item : lane_route_items)
+  {
+    scene->removeItem(item);
+    delete item;
+  }
+  lane_route_items.clear();
+
+  if (lane_route_from.level_idx < 0 || lane_route_to.level_idx < 0)
+    return;
+  if (lane_route_from.level_idx >= static_cast<int>(building.levels.size()) ||
+    lane_route_to.level_idx >= static_cast<int>(building.levels.size()))
+  {
+    lane_route_from = LanePathPlanner::Stop();
+    lane_route_to = LanePathPlanner::Stop();
+    return;
+  }
+
+  lane_path_planner.update(building);
+  const LanePathPlanner::Route route =
+    lane_path_planner.plan(lane_route_from, lane_route_to);
+  if (!route.found)
+  {
+    statusBar()->showMessage(
+      QString::asprintf(
+        "No lane route from vertex %d to vertex %d "
+        "(%d vertices searched in %.3f ms)",
+        lane_route_from.vertex_idx,
+        lane_route_to.vertex_idx,
+        route.num_expanded,
+        route.query_ms));
+    return;
+  }
+
+  // the legs of the route that are on the active level
+  const Level& level = building.levels[level_idx];
+  const QPen pen(
+    QColor(0, 160, 255, 200),
+    0.3 / level.drawing_meters_per_pixel,
+    Qt::SolidLine,
+    Qt::RoundCap);
+  for (std::size_t i = 1; i < route.stops.size(); i++)
+  {
+    const LanePathPlanner::Stop& a = route.stops[i - 1];
+    const LanePathPlanner::Stop& b = route.stops[i];
+    if (a.level_idx != level_idx || b.level_idx != level_idx)
+      continue;
+    const Vertex& va = level.vertices[a.vertex_idx];
+    const Vertex& vb = level.vertices[b.vertex_idx];
+    QGraphicsLineItem* item = scene->addLine(va.x, va.y, vb.x, vb.y, pen);
+    item->setZValue(14.0);  // over the lanes, under the connectivity rings
+    lane_route_items.append(item);
+  }
+
+  statusBar()->showMessage(
+    QString::asprintf(
+      "Lane route: %.1f m, %.1f s, %d lift rides, %d stops "
+      "(%d vertices searched in %.3f ms)",
+      route.length,
+      route.time,
+      route.num_lift_rides,
+      static_cast<int>(route.stops.size()),
+      route.num_expanded,
+      route.query_ms));
+}
+
+void Editor::view_traffic_preview()
+{
+  if (traffic_preview_watcher->isRunning())
+  {
+    statusBar()->showMessage("Still planning the last missions", 5000);
+    return;
+  }
+  const QString filename = QFileDialog::getOpenFileName(
+    this,
+    "Open missions",
+    QString(),
+    "Missions (*.yaml)");
+  if (filename.isEmpty())
+    return;
+
+  TrafficPreview::Missions missions;
+  std::string error;
+  try
+  {
+    const YAML::Node node = YAML::LoadFile(filename.toStdString());
+    TrafficPreview::parse_missions(node, missions, error);
+  }
+  catch (const YAML::Exception& e)
+  {
+    error = e.what();
+  }
+  if (!error.empty())
+  {
+    QMessageBox::critical(
+      this,
+      "Unable to open missions",
+      QString("Unable to read %1: %2").arg(
+        filename,
+        QString::fromStdString(error)));
+    return;
+  }
+
+  // planned on a copy, so editing can go on meanwhile
+  const std::shared_ptr<const BuildingSnapshot> snapshot =
+    snapshot_publisher.publish(building);
+  statusBar()->showMessage(
+    QString("Planning the missions of %1 robots...").arg(
+      missions.robots.size()));
+  traffic_preview_watcher->setFuture(
+    TaskPool::instance().run(
+      TaskPool::INTERACTIVE,
+      [snapshot, missions]()
+      {
+        const std::shared_ptr<Building> copy = snapshot->to_building();
+        return TrafficPreview::run(*copy, missions);
+      }));
+}
+
+void Editor::traffic_preview_planned()
+{
+  close_traffic_preview();
+  traffic_preview_result = traffic_preview_watcher->result();
+  const TrafficPreview::Result& result = traffic_preview_result;
 
-  if (preferences_dialog.exec() == QDialog::Accepted)
-    load_model_names();
+  traffic_preview_slider->blockSignals(true);
+  traffic_preview_slider->setRange(
+    0,
+    static_cast<int>(std::ceil(result.end_time * 10.0)));
+  traffic_preview_slider->setValue(0);
+  traffic_preview_slider->blockSignals(false);
+  traffic_preview_toolbar->show();
+  draw_traffic_preview();
+
+  QString failed;
+  for (const TrafficPreview::Plan& plan : result.plans)
+  {
+    if (plan.error.empty())
+      continue;
+    failed = QString(" (%1 incomplete, e.g. %2: %3)").arg(
+      QString::number(result.num_failed),
+      QString::fromStdString(plan.name),
+      QString::fromStdString(plan.error));
+    break;
+  }
+  statusBar()->showMessage(
+    QString::asprintf(
+      "%d robots planned in %.0f ms",
+      static_cast<int>(result.plans.size()),
+      result.plan_ms) + failed +
+    QString::asprintf(
+      "; %zu conflicts (%zu at vertices, %zu head-on, %zu at doors) "
+      "among %zu intervals, checked in %.0f ms",
+      result.num_conflicts,
+      result.num_by_kind[TrafficPreview::VERTEX],
+      result.num_by_kind[TrafficPreview::HEAD_ON],
+      result.num_by_kind[TrafficPreview::DOOR],
+      result.num_intervals,
+      result.check_ms));
 }
 
-void Editor::edit_building_properties()
+void Editor::close_traffic_preview()
 {
-  BuildingDialog building_dialog(building);
-  if (building_dialog.exec() == QDialog::Accepted)
-    setWindowModified(true);
+  traffic_preview_play_action->setChecked(false);
+  traffic_preview_toolbar->hide();
+  traffic_preview_result = TrafficPreview::Result();
+  traffic_preview_time = 0.0;
+  for (QGraphicsItem* item : traffic_preview_items)
+  {
+    scene->removeItem(item);
+    delete item;
+  }
+  traffic_preview_items.clear();
+  traffic_preview_robots.clear();
 }
 
-void Editor::edit_rotate_all_models()
+void Editor::draw_traffic_preview()
 {
-  QDialog dialog;
-  Ui::TransformDialog dialog_ui;
-  dialog_ui.setupUi(&dialog);
-  if (dialog.exec() != QDialog::Accepted)
+  for (QGraphicsItem* item : traffic_preview_items)
+  {
+    scene->removeItem(item);
+    delete item;
+  }
+  traffic_preview_items.clear();
+  traffic_preview_robots.clear();
+  if (level_idx < 0 || level_idx >= static_cast<int>(building.levels.size()))
     return;
+  const Level& level = building.levels[level_idx];
+  const TrafficPreview::Result& result = traffic_preview_result;
+
+  // one mark for each place of this level where robots conflict; the
+  // level may have been edited since, so what is gone is skipped
+  const int num_vertices = static_cast<int>(level.vertices.size());
+  const double radius = 0.5 / level.drawing_meters_per_pixel;
+  const QPen pen(QColor(220, 0, 0, 160), radius / 2.0);
+  std::set<std::tuple<int, int, int, int>> marked;
+  for (const TrafficPreview::Conflict& conflict : result.conflicts)
+  {
+    if (conflict.level_idx != level_idx ||
+      !marked.insert(
+        std::make_tuple(
+          conflict.kind,
+          conflict.vertex_idx,
+          conflict.other_vertex_idx,
+          conflict.edge_idx)).second)
+      continue;
+    int a = conflict.vertex_idx;
+    int b = conflict.other_vertex_idx;
+    if (conflict.kind == TrafficPreview::DOOR)
+    {
+      if (conflict.edge_idx >= static_cast<int>(level.edges.size()))
+        continue;
+      a = level.edges[conflict.edge_idx].start_idx;
+      b = level.edges[conflict.edge_idx].end_idx;
+    }
+    if (a < 0 || a >= num_vertices || b >= num_vertices)
+      continue;
 
-  const double rotation =
-    dialog_ui.rotate_all_models_line_edit->text().toDouble();
-  building.rotate_all_models(rotation);
-  create_scene();
-  setWindowModified(true);
+    QGraphicsItem* item = nullptr;
+    if (b < 0)
+      item = scene->addEllipse(
+        level.vertices[a].x - radius,
+        level.vertices[a].y - radius,
+        2.0 * radius,
+        2.0 * radius,
+        pen);
+    else
+      item = scene->addLine(
+        level.vertices[a].x,
+        level.vertices[a].y,
+        level.vertices[b].x,
+        level.vertices[b].y,
+        pen);
+    item->setZValue(15.0);
+    traffic_preview_items.append(item);
+  }
+
+  const QPen robot_pen(Qt::black, 0);
+  for (const TrafficPreview::Plan& plan : result.plans)
+  {
+    QGraphicsEllipseItem* item = scene->addEllipse(
+      -radius,
+      -radius,
+      2.0 * radius,
+      2.0 * radius,
+      robot_pen);
+    item->setToolTip(QString::fromStdString(plan.name));
+    item->setZValue(160.0);  // above the models
+    traffic_preview_items.append(item);
+    traffic_preview_robots.push_back(item);
+  }
+  traffic_preview_seek(traffic_preview_time);
 }
 
-void Editor::edit_optimize_layer_transforms()
+void Editor::traffic_preview_seek(const double time)
 {
-  printf("Editor::edit_optimize_layer_transforms()\n");
-  if (level_idx < static_cast<int>(building.levels.size()))
-    building.levels[level_idx].optimize_layer_transforms();
-  create_scene();
+  traffic_preview_time = time;
+  const TrafficPreview::Result& result = traffic_preview_result;
+
+  // the robots in a conflict by then are drawn in red
+  std::vector<char> conflicting(result.plans.size(), 0);
+  int num_conflicts = 0;
+  for (const TrafficPreview::Conflict& conflict : result.conflicts)
+  {
+    if (conflict.start > time)
+      break;  // they are in order of their start
+    if (conflict.end < time)
+      continue;
+    conflicting[conflict.robot_a] = 1;
+    conflicting[conflict.robot_b] = 1;
+    num_conflicts++;
+  }
+
+  const QBrush moving_brush(QColor(0, 120, 255));
+  const QBrush conflict_brush(QColor(255, 0, 0));
+  for (std::size_t i = 0; i < traffic_preview_robots.size(); i++)
+  {
+    QGraphicsEllipseItem* item = traffic_preview_robots[i];
+    int robot_level_idx = -1;
+    double x = 0.0;
+    double y = 0.0;
+    if (!TrafficPreview::position(
+        result.plans[i], time, robot_level_idx, x, y) ||
+      robot_level_idx != level_idx)
+    {
+      item->setVisible(false);
+      continue;
+    }
+    item->setPos(x, y);
+    item->setBrush(conflicting[i] ? conflict_brush : moving_brush);
+    item->setVisible(true);
+  }
+
+  traffic_preview_time_label->setText(
+    QString::asprintf(
+      "%.1f / %.1f s, %d conflicts",
+      time,
+      result.end_time,
+      num_conflicts));
 }
 
-void Editor::edit_align_colinear()
+void Editor::traffic_preview_next_conflict()
 {
-  printf("Editor::edit_align_colinear()\n");
-  Level* level = active_level();
-  if (!level)
+  const std::vector<TrafficPreview::Conflict>& conflicts =
+    traffic_preview_result.conflicts;
+  if (conflicts.empty())
     return;
-  level->align_colinear();
+  auto it = std::upper_bound(
+    conflicts.begin(),
+    conflicts.end(),
+    traffic_preview_time + 0.05,
+    [](const double time, const TrafficPreview::Conflict& conflict)
+    {
+      return time < conflict.start;
+    });
+  if (it == conflicts.end())
+    it = conflicts.begin();  // round again
+  const TrafficPreview::Conflict& conflict = *it;
+  if (conflict.level_idx < 0 ||
+    conflict.level_idx >= static_cast<int>(building.levels.size()))
+    return;
+
+  if (conflict.level_idx != level_idx)
+  {
+    switch_level(conflict.level_idx);
+    level_table->setCurrentCell(level_idx, 0);
+  }
+  traffic_preview_slider->setValue(
+    static_cast<int>(std::ceil(std::max(conflict.start, 0.0) * 10.0)));
+
+  // the first robot is where the robots meet
+  int robot_level_idx = -1;
+  double x = 0.0;
+  double y = 0.0;
+  if (TrafficPreview::position(
+      traffic_preview_result.plans[conflict.robot_a],
+      traffic_preview_time,
+      robot_level_idx,
+      x,
+      y))
+    map_view->centerOn(QPointF(x, y));
+  statusBar()->showMessage(
+    QString("%1 conflict of %2 and %3 from %4 to %5 s")
+    .arg(TrafficPreview::conflict_kind_name(conflict.kind))
+    .arg(
+      QString::fromStdString(
+        traffic_preview_result.plans[conflict.robot_a].name))
+    .arg(
+      QString::fromStdString(
+        traffic_preview_result.plans[conflict.robot_b].name))
+    .arg(conflict.start, 0, 'f', 1)
+    .arg(conflict.end, 0, 'f', 1),
+    10000);
+}
+
+void Editor::view_changes()
+{
+  if (!view_changes_action->isChecked())
+  {
+    for (QGraphicsItem* item : diff_items)
+    {
+      scene->removeItem(item);
+      delete item;
+    }
+    diff_items.clear();
+    diff_base.reset();
+    return;
+  }
+
+  const QString path = QFileDialog::getOpenFileName(
+    this,
+    "Compare with building",
+    QString::fromStdString(building.get_filename()),
+    "Building files (*.building.yaml *.building.yaml.gz "
+    "*.building.yaml.zst);;All files (*)");
+  std::unique_ptr<Building> base(new Building);
+  base->lazy_images = true;  // only its entities are compared
+
+  // Building::load() changes into the directory of the file, which the
+  // images of this building are loaded relative to
+  const QString current_dir = QDir::currentPath();
+  const bool loaded = !path.isEmpty() && base->load(path.toStdString());
+  QDir::setCurrent(current_dir);
+  if (!loaded)
+  {
+    if (!path.isEmpty())
+      QMessageBox::critical(
+        this,
+        "Unable to compare",
+        "Unable to load a building from " + path);
+    view_changes_action->setChecked(false);
+    return;
+  }
+  diff_base = std::move(base);
+  draw_changes();
+}
+
+void Editor::draw_changes()
+{
+  for (QGraphicsItem* item : diff_items)
+  {
+    scene->removeItem(item);
+    delete item;
+  }
+  diff_items.clear();
+
+  if (!diff_base ||
+    level_idx < 0 || level_idx >= static_cast<int>(building.levels.size()))
+    return;
+  const Level& level = building.levels[level_idx];
+  const int before_idx = diff_base->find_level_idx(level.name);
+  if (before_idx < 0)
+  {
+    statusBar()->showMessage(
+      QString::asprintf(
+        "Level [%s] is not in %s",
+        level.name.c_str(),
+        diff_base->get_filename().c_str()));
+    return;
+  }
+
+  BuildingDiff::LevelDiff diff;
+  BuildingDiff::diff_level(diff_base->levels[before_idx], level, diff);
+
+  // rings where entities were added (green) or changed (orange), crosses
+  // where they were removed (red), and lines from where they moved from
+  // (blue)
+  const double radius = 0.3 / level.drawing_meters_per_pixel;
+  auto add = [this](QGraphicsItem* item)
+    {
+      item->setZValue(15.0);
+      diff_items.append(item);
+    };
+  auto ring = [&](const double x, const double y, const QColor& color)
+    {
+      add(scene->addEllipse(
+          x - radius,
+          y - radius,
+          2.0 * radius,
+          2.0 * radius,
+          QPen(color, radius / 3.0)));
+    };
+  for (const BuildingDiff::Entry& entry : diff.entries)
+  {
+    if (entry.kind == BuildingDiff::LAYER)
+      continue;  // nowhere in particular
+    if (entry.changes & BuildingDiff::REMOVED)
+    {
+      const QPen pen(QColor(220, 0, 0), radius / 3.0);
+      for (const double sign : {1.0, -1.0})
+        add(scene->addLine(
+            entry.before_x - radius,
+            entry.before_y - sign * radius,
+            entry.before_x + radius,
+            entry.before_y + sign * radius,
+            pen));
+      continue;
+    }
+    if (entry.changes & BuildingDiff::ADDED)
+      ring(entry.after_x, entry.after_y, QColor(0, 180, 0));
+    if (entry.changes & BuildingDiff::MOVED)
+    {
+      add(scene->addLine(
+          entry.before_x,
+          entry.before_y,
+          entry.after_x,
+          entry.after_y,
+          QPen(QColor(0, 90, 255), radius / 3.0)));
+      ring(entry.after_x, entry.after_y, QColor(0, 90, 255));
+    }
+    if (entry.changes & BuildingDiff::CHANGED)
+      ring(entry.after_x, entry.after_y, QColor(255, 140, 0));
+  }
+
+  statusBar()->showMessage(
+    QString::asprintf(
+      "%d added (green), %d removed (red), %d moved (blue) and %d changed "
+      "(orange) since %s",
+      diff.count(BuildingDiff::ADDED),
+      diff.count(BuildingDiff::REMOVED),
+      diff.count(BuildingDiff::MOVED),
+      diff.count(BuildingDiff::CHANGED),
+      diff_base->get_filename().c_str()));
+}
+
+void Editor::view_crowd_preview()
+{
+  if (!view_crowd_preview_action->isChecked())
+  {
+    if (crowd_preview_timer)
+      crowd_preview_timer->stop();
+    if (crowd_preview_item)
+    {
+      scene->removeItem(crowd_preview_item);
+      delete crowd_preview_item;
+      crowd_preview_item = nullptr;
+    }
+    crowd_preview.clear();
+    return;
+  }
+
+  bool ok = false;
+  CrowdPreview::Options options;
+  options.agents_per_group = QInputDialog::getInt(
+    this,
+    "Crowd preview",
+    "Agents per group (0 for the spawn numbers of the groups):",
+    0,
+    0,
+    100000,
+    1,
+    &ok);
+  if (!ok || !crowd_preview.reset(building, level_idx, options))
+  {
+    if (ok)
+      QMessageBox::information(
+        this,
+        "Crowd preview",
+        "There are no crowd_sim agent groups with an initial state to "
+        "spawn.");
+    view_crowd_preview_action->setChecked(false);
+    return;
+  }
+
+  if (!crowd_preview_timer)
+  {
+    crowd_preview_timer = new QTimer(this);
+    connect(
+      crowd_preview_timer,
+      &QTimer::timeout,
+      this,
+      &Editor::crowd_preview_step);
+  }
+  double time_step = building.crowd_sim_impl->get_update_time_step();
+  if (time_step <= 0.0)
+    time_step = 0.1;
+  crowd_preview_timer->start(static_cast<int>(time_step * 1000.0));
+  draw_crowd_preview();
+}
+
+void Editor::crowd_preview_step()
+{
+  double time_step = building.crowd_sim_impl->get_update_time_step();
+  if (time_step <= 0.0)
+    time_step = 0.1;
+  crowd_preview.step(time_step);
+  draw_crowd_preview();
+
+  const CrowdPreview::Stats& stats = crowd_preview.stats();
+  statusBar()->showMessage(
+    QString::asprintf(
+      "crowd preview: %.1f s, %d agents, %d finished, %d stuck, "
+      "step %.2f ms",
+      stats.time,
+      stats.num_agents,
+      stats.num_finished,
+      stats.num_stuck,
+      stats.step_ms));
+}
+
+void Editor::draw_crowd_preview()
+{
+  if (crowd_preview_item)
+  {
+    scene->removeItem(crowd_preview_item);
+    delete crowd_preview_item;
+    crowd_preview_item = nullptr;
+  }
+  if (crowd_preview.empty() || crowd_preview.level_idx() != level_idx)
+    return;
+
+  CrowdPreview::Density density;
+  crowd_preview.density(0.5, density);
+  if (density.values.empty() || density.max_value <= 0.0f)
+    return;
+
+  // transparent where nobody is, then blue to red up to 4 agents/m^2,
+  // which is about as dense as a crowd still moves
+  QImage image(density.width, density.height, QImage::Format_ARGB32);
+  for (int row = 0; row < density.height; row++)
+  {
+    QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(row));
+    for (int col = 0; col < density.width; col++)
+    {
+      const float value = density.values[
+        static_cast<std::size_t>(row) * density.width + col];
+      if (value <= 0.0f)
+      {
+        line[col] = qRgba(0, 0, 0, 0);
+        continue;
+      }
+      const double t = std::min(1.0, value / 4.0);
+      line[col] = qRgba(
+        static_cast<int>(255 * t),
+        static_cast<int>(64 * (1.0 - t)),
+        static_cast<int>(255 * (1.0 - t)),
+        160);
+    }
+  }
+
+  double x = 0.0;
+  double y = 0.0;
+  double x_end = 0.0;
+  double y_end = 0.0;
+  crowd_preview.to_pixels(density.x_min, density.y_max, x, y);
+  crowd_preview.to_pixels(
+    density.x_min + density.cell_size,
+    density.y_max - density.cell_size,
+    x_end,
+    y_end);
+
+  crowd_preview_item = scene->addPixmap(QPixmap::fromImage(image));
+  crowd_preview_item->setPos(x, y);
+  crowd_preview_item->setScale(x_end - x);
+  crowd_preview_item->setZValue(8.0);  // over the floor and the navmesh
+}
+
+void Editor::draw_ghost_levels()
+{
+  if (level_idx < 0 || level_idx >= static_cast<int>(building.levels.size()))
+    return;
+
+  // the closest level below and the closest level above, by elevation
+  const double elevation = building.levels[level_idx].elevation;
+  int below_idx = -1;
+  int above_idx = -1;
+  for (std::size_t i = 0; i < building.levels.size(); i++)
+  {
+    const int idx = static_cast<int>(i);
+    const double e = building.levels[i].elevation;
+    if (idx == level_idx)
+      continue;
+    if (e <= elevation &&
+      (below_idx < 0 || e > building.levels[below_idx].elevation))
+      below_idx = idx;
+    else if (e > elevation &&
+      (above_idx < 0 || e < building.levels[above_idx].elevation))
+      above_idx = idx;
+  }
+
+  for (const int ghost_idx : {below_idx, above_idx})
+  {
+    if (ghost_idx < 0)
+      continue;
+
+    LevelSnapshot& snapshot = level_snapshots[ghost_idx];
+    if (!snapshot.is_valid())
+      show_level_images(ghost_idx);
+    if (!snapshot.is_valid())
+      snapshot = LevelSnapshot::render(
+        building.levels[ghost_idx],
+        editor_models,
+        rendering_options,
+        building.graphs,
+        building.coordinate_system);
+    if (!snapshot.is_valid())
+      continue;
+
+    const Building::Transform t = building.get_transform(ghost_idx, level_idx);
+    LevelGhostItem* item = new LevelGhostItem(snapshot, t.scale, t.dx, t.dy);
+    item->setOpacity(0.35);
+    item->setZValue(-9.0);  // above our floorplan, below everything else
+    scene->addItem(item);
+    ghost_items.append(item);
+  }
+}
+
+void Editor::view_basemap()
+{
   create_scene();
 }
 
-void Editor::view_models()
+void Editor::draw_basemap()
 {
-  rendering_options.show_models = view_models_action->isChecked();
+  BasemapItem* item = new BasemapItem(tile_cache);
+  item->setZValue(-20.0);  // under the floorplan, if there is one
+  scene->addItem(item);
+}
+
+void Editor::view_profiling_overlay()
+{
+  if (!view_profiling_overlay_action->isChecked())
+  {
+    rendering_options.profile = nullptr;
+    if (profiling_overlay_timer)
+      profiling_overlay_timer->stop();
+    map_view->set_overlay_text(QString());
+    return;
+  }
+
+  rendering_options.profile = &draw_profile;
+  if (!profiling_overlay_timer)
+  {
+    // paint times change all the time; refresh them twice a second
+    profiling_overlay_timer = new QTimer(this);
+    connect(
+      profiling_overlay_timer,
+      &QTimer::timeout,
+      this,
+      &Editor::update_profiling_overlay);
+  }
+  profiling_overlay_timer->start(500);
+  create_scene();  // to have something to show
+}
+
+void Editor::update_profiling_overlay()
+{
+  if (!rendering_options.profile)
+    return;
+  draw_profile.set_paint_time(map_view->last_paint_nsec());
+  map_view->set_overlay_text(draw_profile.summary());
+}
+
+void Editor::view_cull_to_viewport()
+{
+  rendering_options.cull_to_viewport =
+    view_cull_to_viewport_action->isChecked();
   create_scene();
 }
 
+bool Editor::update_cull_rect()
+{
+  QRectF cull_rect;
+  if (rendering_options.cull_to_viewport)
+  {
+    // instantiate an extra half-view on every side, so that small pans
+    // don't need to stream anything in
+    const QRectF visible = map_view->visible_scene_rect();
+    const double margin = 0.5 * std::max(visible.width(), visible.height());
+    cull_rect = visible.adjusted(-margin, -margin, margin, margin);
+  }
+  if (cull_rect == rendering_options.cull_rect)
+    return false;
+  rendering_options.cull_rect = cull_rect;
+  return true;
+}
+
+void Editor::map_view_changed()
+{
+  record_view_interaction();
+
+  if (minimap_dock->isVisible())
+    minimap->set_view_rect(map_view->visible_scene_rect());
+
+  if (!rendering_options.cull_to_viewport)
+    return;
+  if (rendering_options.cull_rect.contains(map_view->visible_scene_rect()))
+  {
+    // still inside what's been instantiated; but if we've zoomed far in,
+    // shrink the cull rect to drop what is now far away
+    const QRectF visible = map_view->visible_scene_rect();
+    if (visible.width() * visible.height() * 16.0 >
+      rendering_options.cull_rect.width() * rendering_options.cull_rect.height())
+      return;
+  }
+  if (!update_cull_rect())
+    return;
+
+  if (!building.stream_items(
+      scene,
+      level_idx,
+      editor_models,
+      rendering_options))
+    create_scene();
+}
+
+void Editor::zoom_fit()
+{
+  map_view->zoom_fit(building, level_idx);
+}
+
 void Editor::zoom_reset()
 {
   const double viewport_scale = 1.0;
@@ -807,6 +8323,7 @@ void Editor::zoom_reset()
   QTransform t;
   t.scale(viewport_scale, y_flip * viewport_scale);
   map_view->setTransform(t);
+  map_view->update_level_of_detail();
 
   // compute center of all vertices on the active level
   Level* level = active_level();
@@ -823,7 +8340,7 @@ void Editor::zoom_reset()
       }
       const double xc = x_sum / n_vertex;
       const double yc = y_sum / n_vertex;
-      printf("center: (%.3f, %.3f)\n", xc, yc);
+      qCDebug(lc_edit, "center: (%.3f, %.3f)", xc, yc);
       map_view->centerOn(QPointF(xc, yc));
     }
   }
@@ -831,12 +8348,23 @@ void Editor::zoom_reset()
 
 void Editor::mouse_event(const MouseType t, QMouseEvent* e)
 {
+  TRACE_ZONE(
+    t == MOUSE_PRESS ? "Editor::mouse_event press" :
+    t == MOUSE_RELEASE ? "Editor::mouse_event release" :
+    "Editor::mouse_event move");
   QPointF p;
   if (!is_mouse_event_in_map(e, p))
   {
     e->ignore();
     return;
   }
+
+  // what is clicked must be where the property editor last put it
+  if (property_redraw_timer->isActive())
+  {
+    property_redraw_timer->stop();
+    apply_level_changes();
+  }
   if (level_idx >= static_cast<int>(building.levels.size()))
   {
     if (t == MOUSE_RELEASE)
@@ -858,6 +8386,20 @@ void Editor::mouse_event(const MouseType t, QMouseEvent* e)
     }
     return;
   }
+  if (interaction_recording && !replaying_interactions)
+  {
+    InteractionRecording::Event event;
+    event.kind =
+      t == MOUSE_PRESS ? InteractionRecording::MOUSE_PRESS :
+      t == MOUSE_RELEASE ? InteractionRecording::MOUSE_RELEASE :
+      InteractionRecording::MOUSE_MOVE;
+    event.x = p.x();
+    event.y = p.y();
+    event.button = e->button();
+    event.buttons = e->buttons();
+    event.modifiers = e->modifiers();
+    record_interaction(event);
+  }
   // dispatch to individual mouse handler functions to save indenting...
   switch (tool_id)
   {
@@ -887,17 +8429,47 @@ void Editor::mouse_event(const MouseType t, QMouseEvent* e)
 
 void Editor::mousePressEvent(QMouseEvent* e)
 {
+  handle_pending_mouse_move();
   mouse_event(MOUSE_PRESS, e);
 }
 
 void Editor::mouseReleaseEvent(QMouseEvent* e)
 {
+  handle_pending_mouse_move();
   mouse_event(MOUSE_RELEASE, e);
 }
 
 void Editor::mouseMoveEvent(QMouseEvent* e)
 {
-  mouse_event(MOUSE_MOVE, e);
+  pending_mouse_move.reset(new QMouseEvent(*e));
+  if (mouse_move_timer->isActive())
+    return;  // there is one this frame already
+
+  const int interval = frame_interval_ms();
+  const qint64 since_last =
+    mouse_move_clock.isValid() ? mouse_move_clock.elapsed() : interval;
+  if (since_last >= interval)
+    handle_pending_mouse_move();
+  else
+    mouse_move_timer->start(static_cast<int>(interval - since_last));
+}
+
+void Editor::handle_pending_mouse_move()
+{
+  mouse_move_timer->stop();
+  if (!pending_mouse_move)
+    return;
+  // the handlers may start another move, by processing events
+  std::unique_ptr<QMouseEvent> e = std::move(pending_mouse_move);
+  mouse_move_clock.start();
+  mouse_event(MOUSE_MOVE, e.get());
+}
+
+int Editor::frame_interval_ms()
+{
+  const QScreen* screen = QGuiApplication::primaryScreen();
+  const double rate = screen ? screen->refreshRate() : 0.0;
+  return rate >= 1.0 ? std::max(1, static_cast<int>(1000.0 / rate)) : 16;
 }
 
 bool Editor::is_mouse_event_in_map(QMouseEvent* e, QPointF& p_scene)
@@ -914,12 +8486,20 @@ bool Editor::is_mouse_event_in_map(QMouseEvent* e, QPointF& p_scene)
 
 void Editor::keyPressEvent(QKeyEvent* e)
 {
+  if (interaction_recording && !replaying_interactions)
+  {
+    InteractionRecording::Event event;
+    event.kind = InteractionRecording::KEY;
+    event.key = e->key();
+    event.modifiers = e->modifiers();
+    record_interaction(event);
+  }
   switch (e->key())
   {
     case Qt::Key_Delete:
       if (building.can_delete_current_selection(level_idx))
       {
-        undo_stack.push(new DeleteCommand(&building, level_idx));
+        undo_stack->push(new DeleteCommand(&building, level_idx));
         create_scene();
       }
       else
@@ -936,12 +8516,16 @@ void Editor::keyPressEvent(QKeyEvent* e)
       break;
     case Qt::Key_S:
     case Qt::Key_Escape:
+    {
+      std::vector<Level::SelectedItem> previous_selection;
+      building.get_selected_items(level_idx, previous_selection);
       building.clear_selection(level_idx);
       clear_current_tool_buffer();
       tool_button_group->button(TOOL_SELECT)->click();
       update_property_editor();
-      create_scene();
+      update_scene_selection(previous_selection);
       break;
+    }
     case Qt::Key_V:
       clear_current_tool_buffer();
       tool_button_group->button(TOOL_ADD_VERTEX)->click();
@@ -980,6 +8564,7 @@ void Editor::keyPressEvent(QKeyEvent* e)
       tool_button_group->button(TOOL_ADD_DOOR)->click();
       break;
     case Qt::Key_B:
+    {
       for (auto& edge : building.levels[level_idx].edges)
       {
         if (edge.type == Edge::LANE && edge.selected)
@@ -987,10 +8572,14 @@ void Editor::keyPressEvent(QKeyEvent* e)
           // toggle bidirectional flag
           edge.set_param("bidirectional",
             edge.is_bidirectional() ? "false" : "true");
-          create_scene();
+          building.levels[level_idx].mark_changed(
+            Level::EDGE,
+            &edge - &building.levels[level_idx].edges[0]);
         }
       }
+      apply_level_changes();
       break;
+    }
     case Qt::Key_0: number_key_pressed(0); break;
     case Qt::Key_1: number_key_pressed(1); break;
     case Qt::Key_2: number_key_pressed(2); break;
@@ -1039,6 +8628,14 @@ void Editor::tool_toggled(int id, bool checked)
 
   tool_id = static_cast<ToolId>(id);
 
+  if (interaction_recording)
+  {
+    InteractionRecording::Event event;
+    event.kind = InteractionRecording::TOOL;
+    event.tool = id;
+    record_interaction(event);
+  }
+
 #if 0
   // TODO: need to improve logic to set back to "normal" cursor...
   // set the cursor
@@ -1079,27 +8676,24 @@ void Editor::tool_toggled(int id, bool checked)
   if (tool_id == TOOL_ADD_MODEL)
   {
     Model model;
-    ModelDialog dialog(this, model, editor_models);
+    ModelDialog dialog(this, model, editor_models, editor_model_index);
     if (dialog.exec() == QDialog::Accepted)
     {
       // find the EditorModel with the requested name
-      for (auto& em : editor_models)
+      const int editor_model_idx = editor_model_index.find(model.model_name);
+      if (editor_model_idx >= 0)
       {
-        if (em.name == model.model_name)
-        {
-          mouse_motion_editor_model = &em;
-          const QPixmap pixmap(mouse_motion_editor_model->get_pixmap());
-          mouse_motion_model = scene->addPixmap(pixmap);
-          mouse_motion_model->setOffset(-pixmap.width()/2, -pixmap.height()/2);
-          mouse_motion_model->setScale(
-            mouse_motion_editor_model->meters_per_pixel /
-            building.levels[level_idx].drawing_meters_per_pixel);
-          mouse_motion_model->setPos(
-            previous_mouse_point.x(),
-            previous_mouse_point.y());
-          statusBar()->showMessage("Left-click to instantiate this model.");
-          break;
-        }
+        mouse_motion_editor_model = &editor_models[editor_model_idx];
+        const QPixmap pixmap(mouse_motion_editor_model->get_pixmap());
+        mouse_motion_model = scene->addPixmap(pixmap);
+        mouse_motion_model->setOffset(-pixmap.width()/2, -pixmap.height()/2);
+        mouse_motion_model->setScale(
+          mouse_motion_editor_model->meters_per_pixel /
+          building.levels[level_idx].drawing_meters_per_pixel);
+        mouse_motion_model->setPos(
+          previous_mouse_point.x(),
+          previous_mouse_point.y());
+        statusBar()->showMessage("Left-click to instantiate this model.");
       }
     }
     else
@@ -1111,10 +8705,25 @@ void Editor::update_property_editor()
 {
   add_param_button->setEnabled(false);
   delete_param_button->setEnabled(false);
+  property_editor_items.clear();
 
   if (building.levels.empty())
     return;
 
+  std::vector<Level::SelectedItem> selected;
+  building.levels[level_idx].get_selected_items(selected);
+  std::vector<Level::SelectedItem> with_params;
+  for (const Level::SelectedItem& item : selected)
+  {
+    if (SetParamsCommand::params_of(building.levels[level_idx], item))
+      with_params.push_back(item);
+  }
+  if (with_params.size() > 1)
+  {
+    populate_property_editor(with_params);
+    return;
+  }
+
   for (const auto& p : building.levels[level_idx].polygons)
   {
     if (p.selected)
@@ -1254,11 +8863,11 @@ void Editor::add_param_button_clicked()
 {
   const string object_type =
     add_param_button->property("object_type").toString().toStdString();
-  printf("add param object type: %s\n", object_type.c_str());
+  qCDebug(lc_edit, "add param object type: %s", object_type.c_str());
 
   if (object_type == "vertex")
   {
-    AddParamDialog dialog(this, Vertex::allowed_params);
+    AddParamDialog dialog(this, param_schemas::vertex);
     if (dialog.exec() != QDialog::Accepted)
       return;
 
@@ -1270,17 +8879,17 @@ void Editor::add_param_button_clicked()
       false
     );
 
-    undo_stack.push(cmd);
+    undo_stack->push(cmd);
     auto updated_id = cmd->get_vertex_updated();
     populate_property_editor(
       building.levels[level_idx].vertices[updated_id],
       updated_id);
-    setWindowModified(true);
+    set_modified();
   }
 
   if (object_type == "tag")
   {
-    AddParamDialog dialog(this, Tag::allowed_params);
+    AddParamDialog dialog(this, param_schemas::tag);
     if (dialog.exec() != QDialog::Accepted)
       return;
 
@@ -1291,13 +8900,13 @@ void Editor::add_param_button_clicked()
       level_idx,
       true
     );
-    printf("AddPropertyCommand");
-    undo_stack.push(cmd);
+    qCDebug(lc_edit, "AddPropertyCommand");
+    undo_stack->push(cmd);
     auto updated_id = cmd->get_tag_updated();
     populate_property_editor(
       building.levels[level_idx].tags[updated_id],
       updated_id);
-    setWindowModified(true);
+    set_modified();
   }
 }
 
@@ -1311,7 +8920,7 @@ void Editor::delete_param_button_clicked()
 
 void Editor::layer_edit_button_clicked(const int row_idx)
 {
-  printf("layer row clicked: [%d]\n", row_idx);
+  qCDebug(lc_edit, "layer row clicked: [%d]", row_idx);
   if (level_idx >= static_cast<int>(building.levels.size()))
     return;
 
@@ -1329,10 +8938,26 @@ void Editor::layer_edit_button_clicked(const int row_idx)
   dialog->show();
   dialog->raise();
   dialog->activateWindow();
+  // while it is open, the layer is moved live; its image is only reloaded
+  // (if it was changed) when the dialog is accepted
+  const int dialog_level_idx = level_idx;
   connect(
     dialog,
     &LayerDialog::redraw,
     [=]()
+    {
+      if (dialog_level_idx >= static_cast<int>(building.levels.size()))
+        return;
+      building.levels[dialog_level_idx].mark_layer_transform_changed(
+        row_idx - 1);
+      layer_table->update(building, level_idx, layer_idx);
+      apply_level_changes();
+    }
+  );
+  connect(
+    dialog,
+    &QDialog::accepted,
+    [=]()
     {
       layer_table->update(building, level_idx, layer_idx);
       create_scene();
@@ -1343,18 +8968,89 @@ void Editor::layer_edit_button_clicked(const int row_idx)
 void Editor::sanity_check()
 {
   // do some checks on the building and pop up errors if we find them
-  for (std::size_t i = 0; i < building.levels.size(); i++)
+  update_issue_list();
+  if (validator.num_errors() == 0)
+    return;
+
+  QString text =
+    "Please correct the following to avoid data loss after save/load.\n";
+  for (const BuildingValidator::Issue& issue : validator.issues())
+  {
+    if (issue.severity == BuildingValidator::ERROR)
+      text += "\n" + QString::fromStdString(issue.message);
+  }
+  QMessageBox::critical(this, "Building problems", text);
+}
+
+void Editor::update_issue_list()
+{
+  const std::vector<BuildingValidator::Issue>& issues = validator.run(building);
+
+  const QSignalBlocker blocker(issue_list);
+  issue_list->clear();
+  for (std::size_t i = 0; i < issues.size(); i++)
+  {
+    const BuildingValidator::Issue& issue = issues[i];
+    QListWidgetItem* item = new QListWidgetItem(
+      QString::fromStdString(issue.message),
+      issue_list);
+    if (issue.severity == BuildingValidator::ERROR)
+      item->setForeground(QBrush(Qt::red));
+    item->setData(Qt::UserRole, static_cast<int>(i));
+  }
+
+  const int tab_idx = right_tab_widget->indexOf(issue_list);
+  if (issues.empty())
+    right_tab_widget->setTabText(tab_idx, "issues");
+  else
+    right_tab_widget->setTabText(
+      tab_idx,
+      QString("issues (%1)").arg(static_cast<int>(issues.size())));
+}
+
+void Editor::issue_list_clicked(const int row)
+{
+  if (row < 0)
+    return;
+  const int issue_idx = issue_list->item(row)->data(Qt::UserRole).toInt();
+  if (issue_idx >= static_cast<int>(validator.issues().size()))
+    return;
+  const BuildingValidator::Issue& issue = validator.issues()[issue_idx];
+  if (issue.level_idx < 0 ||
+    issue.level_idx >= static_cast<int>(building.levels.size()))
+    return;
+
+  if (issue.level_idx != level_idx)
+  {
+    level_idx = issue.level_idx;
+    level_table->setCurrentCell(level_idx, 0);
+  }
+
+  Level& level = building.levels[level_idx];
+  level.clear_selection();
+  QPointF center;
+  bool has_center = false;
+  if (issue.item.vertex_idx >= 0 &&
+    issue.item.vertex_idx < static_cast<int>(level.vertices.size()))
   {
-    if (!building.levels[i].are_layer_names_unique())
-    {
-      QMessageBox::critical(
-        this,
-        "Duplicate layer name",
-        "Layers must have unique names within a level. "
-        "There is a duplicate layer name. Please correct this "
-        "to avoid data loss after save/load.");
-    }
+    const Vertex& v = level.vertices[issue.item.vertex_idx];
+    center = QPointF(v.x, v.y);
+    has_center = true;
   }
+  else if (issue.item.fiducial_idx >= 0 &&
+    issue.item.fiducial_idx < static_cast<int>(level.fiducials.size()))
+  {
+    const Fiducial& f = level.fiducials[issue.item.fiducial_idx];
+    center = QPointF(f.x, f.y);
+    has_center = true;
+  }
+  if (has_center)
+    level.select(issue.item);
+
+  create_scene();
+  update_property_editor();
+  if (has_center)
+    map_view->centerOn(center);
 }
 
 void Editor::layer_add_button_clicked()
@@ -1366,14 +9062,14 @@ void Editor::layer_add_button_clicked()
   LayerDialog layer_dialog(this, layer);
   if (layer_dialog.exec() != QDialog::Accepted)
     return;
-  printf("added a layer: [%s]\n", layer.name.c_str());
+  qCDebug(lc_edit, "added a layer: [%s]", layer.name.c_str());
   layer.color = Layer::default_color(level.layers.size());
   layer.load_image();
-  level.layers.push_back(layer);
+  level.layers.push_back(std::move(layer));
   layer_table->update(building, level_idx, layer_idx);
   create_scene();
   sanity_check();
-  setWindowModified(true);
+  set_modified();
 }
 
 void Editor::populate_property_editor(const Edge& edge)
@@ -1515,6 +9211,27 @@ void Editor::populate_property_editor(const Fiducial& fiducial)
     QString::fromStdString(fiducial.name),
     true);  // true means that this cell value is editable
 
+  // how far the alignment to the reference level leaves this fiducial
+  const Building::AlignmentReport& report =
+    building.get_alignment_report(level_idx);
+  for (const Building::AlignmentReport::Residual& residual : report.residuals)
+  {
+    if (residual.name != fiducial.name)
+      continue;
+    property_editor->setRowCount(4);
+    property_editor_set_row(1, "residual (m)", residual.meters, 3);
+    property_editor_set_row(
+      2,
+      "alignment",
+      residual.inlier ? QString("inlier") : QString("outlier (ignored)"));
+    property_editor_set_row(
+      3,
+      "level rotation (deg)",
+      report.yaw * 180.0 / M_PI,
+      2);
+    break;
+  }
+
   property_editor->blockSignals(false);
 }
 
@@ -1548,122 +9265,884 @@ void Editor::populate_property_editor(const Model& model)
     model.is_static ? QString("true") : QString("false"),
     true);
 
-  property_editor->blockSignals(false);  // re-enable callbacks
+  property_editor->blockSignals(false);  // re-enable callbacks
+}
+
+void Editor::populate_property_editor(const Polygon& polygon)
+{
+  qCDebug(lc_edit, "populate_property_editor(polygon)");
+  property_editor->blockSignals(true);  // otherwise we get tons of callbacks
+
+  Level& level = building.levels[level_idx];
+  const double scale = level.drawing_meters_per_pixel;
+  const PolygonGeometry& geometry =
+    level.polygon_geometry(&polygon - level.polygons.data());
+
+  property_editor->setRowCount(polygon.params.size() + 3);
+
+  int row = 0;
+  for (const auto& param : polygon.params)
+  {
+    property_editor_set_row(
+      row,
+      QString::fromStdString(param.first),
+      param.second.to_qstring(),
+      true);
+    row++;
+  }
+  property_editor_set_row(
+    row++,
+    "area (m^2)",
+    geometry.area * scale * scale,
+    5);
+  property_editor_set_row(
+    row++,
+    "perimeter (m)",
+    geometry.perimeter * scale,
+    5);
+  property_editor_set_row(
+    row++,
+    "triangles",
+    static_cast<int>(geometry.num_triangles()));
+
+  property_editor->blockSignals(false);  // re-enable callbacks
+}
+
+void Editor::populate_property_editor(const Layer& layer)
+{
+  property_editor_items.clear();
+  Level* level = active_level();
+  if (level == nullptr)
+    return;
+  level->compute_layer_transforms();
+  layer.populate_property_editor(property_editor);
+}
+
+void Editor::populate_property_editor(
+  const std::vector<Level::SelectedItem>& items)
+{
+  Level& level = building.levels[level_idx];
+  int num_vertices = 0;
+  int num_edges = 0;
+  int num_polygons = 0;
+  int num_tags = 0;
+  for (const Level::SelectedItem& item : items)
+  {
+    if (item.vertex_idx >= 0)
+      num_vertices++;
+    else if (item.edge_idx >= 0)
+      num_edges++;
+    else if (item.polygon_idx >= 0)
+      num_polygons++;
+    else
+      num_tags++;
+  }
+
+  // the parameters every one of them has, and whether they agree on it
+  struct Common
+  {
+    std::string name;
+    QString value;
+    bool mixed = false;
+  };
+  std::vector<Common> common;
+  for (const auto& param : *SetParamsCommand::params_of(level, items[0]))
+  {
+    Common c;
+    c.name = param.first;
+    c.value = param.second.to_qstring();
+    common.push_back(c);
+  }
+  for (std::size_t i = 1; i < items.size() && !common.empty(); i++)
+  {
+    const ParamMap& params = *SetParamsCommand::params_of(level, items[i]);
+    std::size_t num_kept = 0;
+    for (Common& c : common)
+    {
+      auto it = params.find(c.name);
+      if (it == params.end())
+        continue;
+      if (!c.mixed && it->second.to_qstring() != c.value)
+        c.mixed = true;
+      common[num_kept++] = c;
+    }
+    common.resize(num_kept);
+  }
+
+  property_editor->blockSignals(true);  // otherwise we get tons of callbacks
+  property_editor->setRowCount(1 + common.size());
+  property_editor_set_row(
+    0,
+    "selected",
+    QString::asprintf(
+      "%d vertices, %d edges, %d polygons, %d tags",
+      num_vertices,
+      num_edges,
+      num_polygons,
+      num_tags));
+
+  int row = 1;
+  for (const Common& c : common)
+  {
+    property_editor_set_row(
+      row,
+      QString::fromStdString(c.name),
+      c.mixed ? QString() : c.value,
+      true);
+    if (c.mixed)
+      property_editor->item(row, 1)->setToolTip(
+        "The selected entities have different values");
+    row++;
+  }
+
+  property_editor->blockSignals(false);  // re-enable callbacks
+  property_editor_items = items;
+}
+
+void Editor::clear_property_editor()
+{
+  property_editor_items.clear();
+  property_editor->setRowCount(0);
+  add_param_button->setEnabled(false);
+  delete_param_button->setEnabled(false);
+}
+
+void Editor::property_editor_cell_changed(int row, int column)
+{
+  std::string name = property_editor->item(row, 0)->text().toStdString();
+  std::string value = property_editor->item(row, 1)->text().toStdString();
+  qCDebug(lc_edit, "property_editor_cell_changed(%d, %d) = param %s",
+    row, column, name.c_str());
+
+  if (property_editor_items.size() > 1)
+  {
+    // redo() sets it on all of them and marks them for redrawing
+    SetParamsCommand* cmd = new SetParamsCommand(
+      &building,
+      level_idx,
+      property_editor_items,
+      name,
+      value);
+    qCDebug(lc_edit, "setting %s on %d entities",
+      name.c_str(),
+      static_cast<int>(cmd->size()));
+    undo_stack->push(cmd);
+    schedule_property_redraw();
+    set_modified();
+    return;
+  }
+
+  for (auto& v : building.levels[level_idx].vertices)
+  {
+    if (!v.selected)
+      continue;
+    if (name == "name")
+      v.name = value;
+    else if (name == "x (pixels)")
+      v.x = stof(value);
+    else if (name == "y (pixels)")
+      v.y = stof(value);
+    else
+      v.set_param(name, value);
+    building.levels[level_idx].mark_changed(
+      Level::VERTEX,
+      &v - &building.levels[level_idx].vertices[0]);
+    schedule_property_redraw();
+    set_modified();
+    return;  // stop after finding the first one
+  }
+
+  for (auto& e : building.levels[level_idx].edges)
+  {
+    if (!e.selected)
+      continue;
+    e.set_param(name, value);
+    building.levels[level_idx].mark_changed(
+      Level::EDGE,
+      &e - &building.levels[level_idx].edges[0]);
+    schedule_property_redraw();
+    set_modified();
+    return;  // stop after finding the first one
+  }
+
+  for (auto& f : building.levels[level_idx].fiducials)
+  {
+    if (!f.selected)
+      continue;
+    if (name == "name")
+      f.name = value;
+    building.levels[level_idx].mark_changed(
+      Level::FIDUCIAL,
+      &f - &building.levels[level_idx].fiducials[0]);
+    schedule_property_redraw();
+    set_modified();
+    return;  // stop after finding the first one
+  }
+
+  for (auto& p : building.levels[level_idx].polygons)
+  {
+    if (!p.selected)
+      continue;
+    p.set_param(name, value);
+    building.levels[level_idx].mark_changed(
+      Level::POLYGON,
+      &p - &building.levels[level_idx].polygons[0]);
+    schedule_property_redraw();
+    set_modified();
+    return;  // stop after finding the first one
+  }
+
+  for (auto& m : building.levels[level_idx].models)
+  {
+    if (!m.selected)
+      continue;
+    m.set_param(name, value);
+    building.levels[level_idx].mark_changed(
+      Level::MODEL,
+      &m - &building.levels[level_idx].models[0]);
+    schedule_property_redraw();
+    set_modified();
+    return; // stop after finding the first one
+  }
+}
+
+void Editor::schedule_property_redraw()
+{
+  // restarted by every edit, so a burst of them is redrawn once at its end
+  property_redraw_timer->start();
+}
+
+bool Editor::create_scene()
+{
+  // the levels may have been renumbered, or the view options changed,
+  // since any of the cached scenes was drawn
+  drop_cached_scenes();
+  building.detach_cached_items(scene);
+  scene->clear();
+  building.clear_scene();
+  return draw_scene();
+}
+
+bool Editor::draw_scene()
+{
+  TRACE_ZONE("Editor::draw_scene");
+  // changing the scene rect can scroll the view; don't try to stream
+  // items into the level while it's being drawn
+  const QSignalBlocker map_view_blocker(map_view);
+  ++scene_generation;  // supersedes any geometry still being computed
+
+  building.detach_cached_items(scene);  // keep them for the next draw
+  scene->clear();  // destroys the mouse_motion_* items if they are there
+  building.clear_scene(level_idx);  // forget the pointers to its items
+  update_cull_rect();
+  mouse_motion_line = nullptr;
+  mouse_motion_model = nullptr;
+  mouse_motion_ellipse = nullptr;
+  mouse_motion_polygon = nullptr;
+  snap_hint = nullptr;
+
+  show_level_images(level_idx);
+
+  // all deleted by scene->clear()
+  ghost_items.clear();
+  navmesh_items.clear();
+  traffic_map_items.clear();
+  lane_connectivity_items.clear();
+  lane_conflict_items.clear();
+  model_overlap_items.clear();
+  door_clearance_items.clear();
+  lane_sweep_items.clear();
+  lane_usage_items.clear();
+  lane_route_items.clear();
+  traffic_preview_items.clear();
+  traffic_preview_robots.clear();
+  diff_items.clear();
+  crowd_preview_item = nullptr;
+  draw_overlay_items();
+
+  if (view_basemap_action->isChecked() &&
+    building.coordinate_system.value == CoordinateSystem::WebMercator)
+    draw_basemap();
+
+  update_world_preview();
+  update_minimap();
+  update_statistics();
+  update_tower_overview();
+
+  QElapsedTimer draw_timer;
+  draw_timer.start();
+  if (rendering_options.profile)
+  {
+    draw_profile.clear();
+    building.draw(scene, level_idx, editor_models, rendering_options);
+    draw_profile.add_phase_time("total", draw_timer.nsecsElapsed());
+    draw_profile.set_item_count("all", scene->items().size());
+    update_profiling_overlay();
+  }
+  else
+    building.draw(scene, level_idx, editor_models, rendering_options);
+  last_draw_nsec = draw_timer.nsecsElapsed();
+
+  update_scene_index();
+  return true;
+}
+
+void Editor::remove_overlay_items()
+{
+  remove_mouse_motion_item();
+
+  auto remove = [this](QList<QGraphicsItem*>& items)
+    {
+      for (QGraphicsItem* item : items)
+      {
+        scene->removeItem(item);
+        delete item;
+      }
+      items.clear();
+    };
+  remove(ghost_items);
+  remove(navmesh_items);
+  for (QGraphicsPathItem* item : traffic_map_items)
+  {
+    if (!item)
+      continue;
+    scene->removeItem(item);
+    delete item;
+  }
+  traffic_map_items.clear();
+  remove(lane_connectivity_items);
+  remove(lane_conflict_items);
+  remove(model_overlap_items);
+  remove(door_clearance_items);
+  remove(lane_sweep_items);
+  remove(lane_usage_items);
+  remove(lane_route_items);
+  remove(traffic_preview_items);
+  traffic_preview_robots.clear();
+  remove(diff_items);
+
+  if (crowd_preview_item)
+  {
+    scene->removeItem(crowd_preview_item);
+    delete crowd_preview_item;
+    crowd_preview_item = nullptr;
+  }
+}
+
+void Editor::draw_overlay_items()
+{
+  draw_traffic_maps();
+  if (view_ghost_levels_action->isChecked())
+    draw_ghost_levels();
+  if (view_navmesh_action->isChecked())
+    draw_navmesh();
+  if (view_lane_connectivity_action->isChecked())
+    draw_lane_connectivity();
+  if (view_lane_conflicts_action->isChecked())
+    draw_lane_conflicts();
+  if (view_model_overlaps_action->isChecked())
+    draw_model_overlaps();
+  if (view_door_clearance_action->isChecked())
+    draw_door_clearance();
+  if (view_lane_clearance_action->isChecked())
+    draw_lane_clearance();
+  if (view_lane_usage_action->isChecked())
+    update_lane_usage();
+  if (lane_route_to.level_idx >= 0)
+    draw_lane_route();
+  if (!traffic_preview_result.plans.empty())
+    draw_traffic_preview();
+  if (view_changes_action->isChecked())
+    draw_changes();
+  if (view_crowd_preview_action->isChecked())
+    draw_crowd_preview();
+}
+
+void Editor::drop_cached_scenes()
+{
+  while (!cached_scenes.empty())
+    drop_cached_scene(cached_scenes.back().level_idx);
+}
+
+void Editor::drop_cached_scene(const int idx)
+{
+  for (auto it = cached_scenes.begin(); it != cached_scenes.end(); ++it)
+  {
+    if (it->level_idx != idx)
+      continue;
+    building.detach_cached_items(it->scene);
+    delete it->scene;
+    building.clear_scene(idx);
+    cached_scenes.erase(it);
+    return;
+  }
+}
+
+void Editor::switch_level(const int idx)
+{
+  TRACE_ZONE("Editor::switch_level");
+  const int num_levels = static_cast<int>(building.levels.size());
+  const int max_cached_scenes =
+    QSettings().value(preferences_keys::cached_level_scenes, 4).toInt();
+  if (max_cached_scenes <= 0 ||
+    level_idx < 0 || level_idx >= num_levels ||
+    idx < 0 || idx >= num_levels ||
+    idx == level_idx)
+  {
+    level_idx = idx;
+    create_scene_async();
+    return;
+  }
+
+  // a scene still waiting for its geometry has nothing worth keeping
+  QGraphicsScene* empty_scene = nullptr;
+  if (geometry_generation == scene_generation)
+  {
+    remove_overlay_items();
+    empty_scene = scene;
+  }
+  else
+  {
+    // the scene of this level must be up to date when it's put away
+    apply_level_changes();
+    remove_overlay_items();
+    cached_scenes.push_back({level_idx, scene});
+  }
+
+  auto it = std::find_if(
+    cached_scenes.begin(),
+    cached_scenes.end(),
+    [idx](const CachedScene& cached) { return cached.level_idx == idx; });
+  level_idx = idx;
+  if (it == cached_scenes.end())
+  {
+    if (!empty_scene)
+    {
+      scene = new QGraphicsScene(this);
+      map_view->setScene(scene);
+    }
+    start_scene_geometry();
+  }
+  else
+  {
+    scene = it->scene;
+    cached_scenes.erase(it);
+    map_view->setScene(scene);
+    delete empty_scene;
+    ++scene_generation;  // the geometry of another level is moot now
+    qCDebug(lc_draw, "reused the cached scene of level [%s]",
+      building.levels[level_idx].name.c_str());
+
+    // the view options may have been toggled while it was put away
+    building.levels[level_idx].update_visibility(rendering_options);
+
+    show_level_images(level_idx);
+    update_cull_rect();
+    LevelOfDetail::apply(scene, rendering_options.lod_tier);
+    draw_overlay_items();
+    update_world_preview();
+    update_minimap();
+    update_statistics();
+    update_tower_overview();
+  }
+
+  while (static_cast<int>(cached_scenes.size()) > max_cached_scenes)
+    drop_cached_scene(cached_scenes.front().level_idx);
+}
+
+void Editor::show_level_images(const int idx)
+{
+  if (idx < 0 || idx >= static_cast<int>(building.levels.size()))
+    return;
+
+  Level& level = building.levels[idx];
+  if (!level.images_loaded())
+  {
+    QElapsedTimer timer;
+    timer.start();
+    level.load_images(
+      building.drawing_preview_size,
+      &building.load_profile);
+    qCDebug(lc_io, "decoded the images of level [%s] in %lld ms",
+      level.name.c_str(),
+      static_cast<long long>(timer.elapsed()));
+    decode_next_drawing();
+  }
+
+  if (!shown_levels.empty() && shown_levels.back() == idx)
+    return;  // nothing has changed since the last redraw
+
+  shown_levels.erase(
+    std::remove(shown_levels.begin(), shown_levels.end(), idx),
+    shown_levels.end());
+  shown_levels.push_back(idx);
+  evict_level_images();
+
+  if (building.lazy_images && idx == level_idx)
+  {
+    prefetch_level_images(idx - 1);
+    prefetch_level_images(idx + 1);
+  }
+}
+
+void Editor::evict_level_images()
+{
+  if (!building.lazy_images)
+    return;
+
+  const std::size_t budget =
+    static_cast<std::size_t>(
+    QSettings().value(preferences_keys::level_image_memory_mb, 1024).toInt())
+    * 1024 * 1024;
+
+  std::size_t total = 0;
+  for (const Level& level : building.levels)
+    total += level.image_bytes();
+
+  // the oldest first, but never the active level or the one just shown
+  for (std::size_t i = 0; i + 1 < shown_levels.size() && total > budget; )
+  {
+    const int idx = shown_levels[i];
+    if (idx == level_idx || idx >= static_cast<int>(building.levels.size()))
+    {
+      i++;
+      continue;
+    }
+    Level& level = building.levels[idx];
+    total -= std::min(total, level.image_bytes());
+    drop_cached_scene(idx);  // which would keep the images alive
+    level.unload_images();
+    qCInfo(lc_io, "released the images of level [%s]", level.name.c_str());
+    shown_levels.erase(shown_levels.begin() + i);
+  }
+}
+
+void Editor::prefetch_level_images(const int idx)
+{
+  if (idx < 0 || idx >= static_cast<int>(building.levels.size()))
+    return;
+  const Level& level = building.levels[idx];
+  if (level.images_loaded())
+    return;
+
+  QStringList filenames;
+  if (!level.drawing_filename.empty())
+    filenames.append(QString::fromStdString(level.drawing_filename));
+  for (const Layer& layer : level.layers)
+    filenames.append(QString::fromStdString(layer.filename));
+
+  // the decoded images are thrown away; only the cache entries are kept
+  TaskPool::instance().run(
+    TaskPool::BACKGROUND,
+    [filenames]()
+    {
+      for (const QString& filename : filenames)
+        DecodedImageCache::load(filename, QImage::Format_Grayscale8);
+    });
+}
+
+void Editor::decode_next_drawing()
+{
+  if (drawing_watcher->isRunning())
+    return;  // drawing_decoded() will come back here
+
+  // the active level first, then any other
+  int idx = -1;
+  for (int i = -1; idx < 0 && i < static_cast<int>(building.levels.size());
+    i++)
+  {
+    const int candidate = i < 0 ? level_idx : i;
+    if (candidate < 0 ||
+      candidate >= static_cast<int>(building.levels.size()))
+      continue;
+    const Level& level = building.levels[candidate];
+    if (level.drawing_is_preview() &&
+      !drawing_decode_failures.count(level.drawing_filename))
+      idx = candidate;
+  }
+  if (idx < 0)
+    return;
+
+  drawing_watcher_level_idx = idx;
+  drawing_watcher_filename = building.levels[idx].drawing_filename;
+  const QString filename = QString::fromStdString(drawing_watcher_filename);
+  drawing_watcher->setFuture(
+    QtConcurrent::run(
+      [filename]()
+      {
+        return DecodedImageCache::load(filename, QImage::Format_Grayscale8);
+      }));
 }
 
-void Editor::populate_property_editor(const Polygon& polygon)
+void Editor::drawing_decoded()
 {
-  printf("populate_property_editor(polygon)\n");
-  property_editor->blockSignals(true);  // otherwise we get tons of callbacks
+  const int idx = drawing_watcher_level_idx;
+  const QImage image = drawing_watcher->result();
+
+  // the level may have been deleted, given another drawing or unloaded
+  if (idx >= 0 &&
+    idx < static_cast<int>(building.levels.size()) &&
+    building.levels[idx].drawing_filename == drawing_watcher_filename &&
+    building.levels[idx].drawing_is_preview() &&
+    !image.isNull())
+  {
+    Level& level = building.levels[idx];
+    level.set_drawing_image(image);
+    qCDebug(lc_io, "swapped in the full drawing of level [%s]",
+      level.name.c_str());
+    level_snapshots.erase(idx);
+    if (idx == level_idx || view_ghost_levels_action->isChecked())
+      create_scene();  // it is shown, perhaps as one of the ghosts
+  }
+  else if (image.isNull())
+  {
+    qCWarning(lc_io, "unable to decode the full drawing %s",
+      drawing_watcher_filename.c_str());
+    drawing_decode_failures.insert(drawing_watcher_filename);
+  }
 
-  property_editor->setRowCount(polygon.params.size());
+  decode_next_drawing();
+}
 
-  int row = 0;
-  for (const auto& param : polygon.params)
+void Editor::update_scene_index()
+{
+  QSettings settings;
+  const QString method =
+    settings.value(preferences_keys::scene_index, "auto").toString();
+
+  bool use_bsp_tree = true;
+  if (method == "none")
+    use_bsp_tree = false;
+  else if (method != "bsp")
+    use_bsp_tree = !scene_bulk_update &&
+      scene->items().size() >= AUTO_SCENE_INDEX_MIN_ITEMS;
+
+  const QGraphicsScene::ItemIndexMethod index_method = use_bsp_tree ?
+    QGraphicsScene::BspTreeIndex : QGraphicsScene::NoIndex;
+  if (scene->itemIndexMethod() == index_method)
+    return;
+
+  // a depth of 0 lets Qt size the tree from the number of items
+  scene->setItemIndexMethod(index_method);
+  if (use_bsp_tree)
+    scene->setBspTreeDepth(0);
+}
+
+void Editor::set_scene_bulk_update(const bool bulk_update)
+{
+  if (bulk_update == scene_bulk_update)
+    return;
+  scene_bulk_update = bulk_update;
+  update_scene_index();
+}
+
+void Editor::create_scene_async()
+{
+  if (level_idx < 0 || level_idx >= static_cast<int>(building.levels.size()))
   {
-    property_editor_set_row(
-      row,
-      QString::fromStdString(param.first),
-      param.second.to_qstring(),
-      true);
-    row++;
+    create_scene();
+    return;
   }
 
-  property_editor->blockSignals(false);  // re-enable callbacks
+  // show an empty level until the geometry is ready, so nothing can be
+  // clicked in the scene of another level meanwhile
+  drop_cached_scenes();
+  building.detach_cached_items(scene);
+  scene->clear();
+  building.clear_scene();
+  ghost_items.clear();
+  navmesh_items.clear();
+  traffic_map_items.clear();
+  lane_connectivity_items.clear();
+  lane_conflict_items.clear();
+  model_overlap_items.clear();
+  door_clearance_items.clear();
+  lane_sweep_items.clear();
+  lane_usage_items.clear();
+  lane_route_items.clear();
+  traffic_preview_items.clear();
+  traffic_preview_robots.clear();
+  diff_items.clear();
+  crowd_preview_item = nullptr;
+  mouse_motion_line = nullptr;
+  mouse_motion_model = nullptr;
+  mouse_motion_ellipse = nullptr;
+  mouse_motion_polygon = nullptr;
+  snap_hint = nullptr;
+
+  start_scene_geometry();
 }
 
-void Editor::populate_property_editor(const Layer& layer)
+void Editor::start_scene_geometry()
 {
-  Level* level = active_level();
-  if (level == nullptr)
-    return;
-  level->compute_layer_transforms();
-  layer.populate_property_editor(property_editor);
+  // the worker only sees copies, so the level can't change underneath it
+  const Level& level = building.levels[level_idx];
+  SceneGeometry::Input input;
+  input.vertices = level.vertices;
+  input.edges = level.edges;
+  input.polygons = level.polygons;
+  input.graphs = building.graphs;
+  input.meters_per_pixel = level.drawing_meters_per_pixel;
+
+  geometry_generation = ++scene_generation;
+  geometry_level_idx = level_idx;
+  geometry_watcher->setFuture(
+    QtConcurrent::run(
+      [input]()
+      {
+        return SceneGeometry::compute(input);
+      }));
 }
 
-void Editor::clear_property_editor()
+void Editor::scene_geometry_ready()
 {
-  property_editor->setRowCount(0);
-  add_param_button->setEnabled(false);
-  delete_param_button->setEnabled(false);
+  // a synchronous redraw, edit or level change happened in the meantime
+  if (geometry_generation != scene_generation ||
+    geometry_level_idx != level_idx)
+    return;
+
+  const QPoint p_center_window(
+    map_view->viewport()->width() / 2,
+    map_view->viewport()->height() / 2);
+  const QPointF p_center_scene = map_view->mapToScene(p_center_window);
+
+  building.levels[level_idx].set_precomputed_geometry(
+    std::make_shared<const SceneGeometry>(geometry_watcher->result()));
+  draw_scene();
+
+  // the scene rect of the level may have grown; stay where we were
+  map_view->centerOn(p_center_scene);
 }
 
-void Editor::property_editor_cell_changed(int row, int column)
+void Editor::thumbnail_loaded(const QString& model_name)
 {
-  std::string name = property_editor->item(row, 0)->text().toStdString();
-  std::string value = property_editor->item(row, 1)->text().toStdString();
-  printf("property_editor_cell_changed(%d, %d) = param %s\n",
-    row, column, name.c_str());
+  if (level_idx < 0 || level_idx >= static_cast<int>(building.levels.size()))
+    return;
 
-  for (auto& v : building.levels[level_idx].vertices)
+  const std::string name = model_name.toStdString();
+
+  // the cached scenes of other levels still show the placeholder
+  std::vector<int> stale_levels;
+  for (const CachedScene& cached : cached_scenes)
   {
-    if (!v.selected)
-      continue;
-    if (name == "name")
-      v.name = value;
-    else if (name == "x (pixels)")
-      v.x = stof(value);
-    else if (name == "y (pixels)")
-      v.y = stof(value);
-    else
-      v.set_param(name, value);
-    create_scene();
-    setWindowModified(true);
-    return;  // stop after finding the first one
+    for (const Model& model : building.levels[cached.level_idx].models)
+    {
+      if (model.model_name == name)
+      {
+        stale_levels.push_back(cached.level_idx);
+        break;
+      }
+    }
   }
+  for (const int idx : stale_levels)
+    drop_cached_scene(idx);
 
-  for (auto& e : building.levels[level_idx].edges)
+  Level& level = building.levels[level_idx];
+  for (std::size_t i = 0; i < level.models.size(); i++)
   {
-    if (!e.selected)
+    Model& model = level.models[i];
+    if (model.model_name != name)
       continue;
-    e.set_param(name, value);
+    model.redraw_thumbnail(
+      editor_models,
+      level.drawing_meters_per_pixel);
+    level.mark_moved(Level::MODEL, i);  // its footprint may have grown
+  }
+}
+
+void Editor::update_scene(const std::vector<Level::SelectedItem>& items)
+{
+  TRACE_ZONE("Editor::update_scene");
+  ++scene_generation;
+  if (!building.redraw_items(
+      scene,
+      level_idx,
+      items,
+      editor_models,
+      rendering_options))
+  {
     create_scene();
-    setWindowModified(true);
-    return;  // stop after finding the first one
+    return;
   }
 
-  for (auto& f : building.levels[level_idx].fiducials)
+  // lanes may have moved; the builder only redoes the ones that did
+  if (view_navmesh_action->isChecked())
+    draw_navmesh();
+  if (view_lane_connectivity_action->isChecked())
+    draw_lane_connectivity();
+  if (view_lane_conflicts_action->isChecked())
+    draw_lane_conflicts();
+  if (view_model_overlaps_action->isChecked())
+    draw_model_overlaps();
+  if (view_door_clearance_action->isChecked())
+    draw_door_clearance();
+  if (view_lane_clearance_action->isChecked())
+    draw_lane_clearance();
+  if (view_lane_usage_action->isChecked())
+    update_lane_usage();
+  if (lane_route_to.level_idx >= 0)
+    draw_lane_route();
+  if (view_changes_action->isChecked())
+    draw_changes();
+}
+
+void Editor::apply_level_changes()
+{
+  TRACE_ZONE("Editor::apply_level_changes");
+  // only the current level is in the scene; others will be drawn from
+  // scratch when they are selected, so their cached scenes are dropped
+  // rather than brought up to date
+  bool redraw_all = false;
+  std::vector<Level::SelectedItem> items;
+  std::vector<int> layer_transforms;
+  for (std::size_t i = 0; i < building.levels.size(); i++)
   {
-    if (!f.selected)
+    Level::ChangeSet changes = building.levels[i].take_changes();
+    if (static_cast<int>(i) != level_idx)
+    {
+      if (!changes.empty())
+        drop_cached_scene(i);
       continue;
-    if (name == "name")
-      f.name = value;
+    }
+    redraw_all = changes.all;
+    items = std::move(changes.items);
+    layer_transforms = std::move(changes.layer_transforms);
+  }
+
+  if (redraw_all)
+  {
     create_scene();
-    setWindowModified(true);
-    return;  // stop after finding the first one
+    return;
   }
 
-  for (auto& p : building.levels[level_idx].polygons)
+  // moving a layer only sets the transform of its items
+  for (const int i : layer_transforms)
   {
-    if (!p.selected)
-      continue;
-    p.set_param(name, value);
-    setWindowModified(true);
-    return;  // stop after finding the first one
+    if (!building.levels[level_idx].update_layer_transform(scene, i))
+    {
+      create_scene();
+      return;
+    }
   }
 
-  for (auto& m : building.levels[level_idx].models)
+  if (!items.empty())
   {
-    if (!m.selected)
-      continue;
-    m.set_param(name, value);
-    setWindowModified(true);
-    return; // stop after finding the first one
+    update_scene(items);
+    update_world_preview();
+    update_minimap();
+    update_statistics();
+    update_tower_overview();
   }
 }
 
-bool Editor::create_scene()
+void Editor::update_scene_selection(
+  const std::vector<Level::SelectedItem>& previous_selection)
 {
-  scene->clear();  // destroys the mouse_motion_* items if they are there
-  building.clear_scene();  // forget all pointers to the graphics items
-  mouse_motion_line = nullptr;
-  mouse_motion_model = nullptr;
-  mouse_motion_ellipse = nullptr;
-  mouse_motion_polygon = nullptr;
-
-  building.draw(scene, level_idx, editor_models, rendering_options);
-
-  return true;
+  std::vector<Level::SelectedItem> items(previous_selection);
+  building.get_selected_items(level_idx, items);
+  for (const Level::SelectedItem& item : items)
+    building.levels[level_idx].mark_changed(item);
+  apply_level_changes();
 }
 
 void Editor::draw_mouse_motion_line_item(
@@ -1726,6 +10205,7 @@ void Editor::remove_mouse_motion_item()
     mouse_motion_polygon = nullptr;
   }
   mouse_motion_editor_model = nullptr;
+  remove_snap_hint();
 
   mouse_vertex_idx = -1;
   mouse_tag_idx = -1;
@@ -1743,12 +10223,70 @@ void Editor::mouse_select(
   QMouseEvent* e,
   const QPointF& p)
 {
+  if (type == MOUSE_MOVE)
+  {
+    if (!mouse_selecting_region || !(e->buttons() & Qt::LeftButton))
+      return;
+
+    if (e->modifiers() & Qt::AltModifier)
+      mouse_selection_region.append(p);  // lasso
+    else
+    {
+      const QPointF start = mouse_selection_region.first();
+      mouse_selection_region.clear();
+      mouse_selection_region.append(start);
+      mouse_selection_region.append(QPointF(p.x(), start.y()));
+      mouse_selection_region.append(p);
+      mouse_selection_region.append(QPointF(start.x(), p.y()));
+    }
+
+    if (mouse_motion_polygon == nullptr)
+    {
+      QPen pen(QBrush(QColor::fromRgbF(0.2, 0.4, 1.0, 0.8)), 0);
+      pen.setStyle(Qt::DashLine);
+      mouse_motion_polygon = scene->addPolygon(
+        mouse_selection_region,
+        pen,
+        QBrush(QColor::fromRgbF(0.2, 0.4, 1.0, 0.1)));
+      mouse_motion_polygon->setZValue(1000);
+    }
+    else
+      mouse_motion_polygon->setPolygon(mouse_selection_region);
+    return;
+  }
+
+  if (type == MOUSE_RELEASE)
+  {
+    if (!mouse_selecting_region)
+      return;
+    mouse_selecting_region = false;
+    remove_mouse_motion_item();
+
+    const QRectF bounds = mouse_selection_region.boundingRect();
+    if (mouse_selection_region.size() < 3 ||
+      (bounds.width() < 1.0 && bounds.height() < 1.0))
+      return;  // it was just a click
+
+    std::vector<Level::SelectedItem> previous_selection;
+    building.get_selected_items(level_idx, previous_selection);
+    building.levels[level_idx].select_within(
+      mouse_selection_region,
+      rendering_options);
+    selected_polygon = building.get_selected_polygon(level_idx);
+    update_scene_selection(previous_selection);
+    update_property_editor();
+    return;
+  }
+
   if (type != MOUSE_PRESS)
     return;
   const QPoint p_global = mapToGlobal(e->pos());
   const QPoint p_map = map_view->mapFromGlobal(p_global);
   QGraphicsItem* item = map_view->itemAt(p_map);
 
+  std::vector<Level::SelectedItem> previous_selection;
+  building.get_selected_items(level_idx, previous_selection);
+
   building.levels[level_idx].mouse_select_press(
     p.x(),
     p.y(),
@@ -1759,10 +10297,20 @@ void Editor::mouse_select(
   // todo: figure out something smarter than this abomination
   selected_polygon = building.get_selected_polygon(level_idx);
 
-  // todo: be smarter and go find the actual GraphicsItem to avoid
-  // a full repaint here?
-  create_scene();
+  update_scene_selection(previous_selection);
   update_property_editor();
+
+  // dragging from a click that didn't select anything sweeps out a region
+  std::vector<Level::SelectedItem> selection;
+  building.get_selected_items(level_idx, selection);
+  const std::size_t n_kept =
+    (e->modifiers() & Qt::ShiftModifier) ? previous_selection.size() : 0;
+  if ((e->buttons() & Qt::LeftButton) && selection.size() <= n_kept)
+  {
+    mouse_selecting_region = true;
+    mouse_selection_region.clear();
+    mouse_selection_region.append(p);
+  }
 }
 
 void Editor::mouse_add_vertex(
@@ -1772,14 +10320,14 @@ void Editor::mouse_add_vertex(
 {
   if (t == MOUSE_PRESS)
   {
-    undo_stack.push(
+    undo_stack->push(
       new AddVertexCommand(
         &building,
         level_idx,
         p.x(),
         p.y()));
-    setWindowModified(true);
-    create_scene();
+    set_modified();
+    apply_level_changes();
   }
 }
 
@@ -1790,14 +10338,14 @@ void Editor::mouse_add_tag(
 {
   if (t == MOUSE_PRESS)
   {
-    undo_stack.push(
+    undo_stack->push(
       new AddTagCommand(
         &building,
         level_idx,
         p.x(),
         p.y()));
-    setWindowModified(true);
-    create_scene();
+    set_modified();
+    apply_level_changes();
   }
 }
 
@@ -1808,14 +10356,14 @@ void Editor::mouse_add_feature(
 {
   if (t == MOUSE_PRESS)
   {
-    undo_stack.push(
+    undo_stack->push(
       new AddFeatureCommand(
         &building,
         level_idx,
         layer_idx,
         p.x(),
         p.y()));
-    setWindowModified(true);
+    set_modified();
     create_scene();
   }
 }
@@ -1832,9 +10380,9 @@ void Editor::mouse_add_fiducial(
       level_idx,
       p.x(),
       p.y());
-    undo_stack.push(command);
-    setWindowModified(true);
-    create_scene();
+    undo_stack->push(command);
+    set_modified();
+    apply_level_changes();
   }
 }
 
@@ -1848,26 +10396,25 @@ void Editor::mouse_move(
     Level::NearestItem ni =
       building.levels[level_idx].nearest_items(p.x(), p.y());
 
-    printf(
-      "mouse press (%.3f, %.3f) feature_dist = %.3f, feature_idx = %d, feature_layer_idx = %d\n",
+    qCDebug(lc_edit,
+      "mouse press (%.3f, %.3f) feature_dist = %.3f, feature_idx = %d, "
+      "feature_layer_idx = %d",
       p.x(),
       p.y(),
       ni.feature_dist,
       ni.feature_idx,
       ni.feature_layer_idx);
 
-    // todo: use QGraphics stuff to see if we clicked a model pixmap...
     const double model_dist_thresh = 0.5 /
       building.levels[level_idx].drawing_meters_per_pixel;
+    const int model_idx =
+      building.levels[level_idx].model_at(p.x(), p.y(), model_dist_thresh);
 
-    if (ni.model_idx >= 0 && ni.model_dist < model_dist_thresh)
+    if (model_idx >= 0)
     {
-      // Now we need to find the pixmap item for this model.
-      const Model& model =
-        building.levels[level_idx].models[ni.model_idx];
-      mouse_motion_model = get_closest_pixmap_item(
-        QPointF(model.state.x, model.state.y));
-      mouse_model_idx = ni.model_idx;
+      mouse_motion_model =
+        building.levels[level_idx].models[model_idx].pixmap_item;
+      mouse_model_idx = model_idx;
       latest_move_model = new MoveModelCommand(
         &building,
         level_idx,
@@ -1886,7 +10433,7 @@ void Editor::mouse_move(
     {
       mouse_tag_idx = ni.tag_idx;
 
-      latest_move_vertex = new MoveVertexCommand(
+      latest_move_tag = new MoveTagCommand(
         &building,
         level_idx,
         mouse_tag_idx);
@@ -1913,14 +10460,80 @@ void Editor::mouse_move(
         level_idx,
         mouse_fiducial_idx);
     }
+
+    // grabbing one entity of a larger selection drags all of it
+    const Level& level = building.levels[level_idx];
+    bool grabbed_selected =
+      (mouse_model_idx >= 0 && level.models[mouse_model_idx].selected) ||
+      (mouse_vertex_idx >= 0 && level.vertices[mouse_vertex_idx].selected) ||
+      (mouse_tag_idx >= 0 && level.tags[mouse_tag_idx].selected) ||
+      (mouse_fiducial_idx >= 0 &&
+      level.fiducials[mouse_fiducial_idx].selected);
+    if (mouse_feature_idx >= 0)
+      grabbed_selected = mouse_feature_layer_idx == 0 ?
+        level.floorplan_features[mouse_feature_idx].selected() :
+        level.layers[mouse_feature_layer_idx - 1].
+        features[mouse_feature_idx].selected();
+    if (grabbed_selected)
+    {
+      std::vector<Level::SelectedItem> items;
+      building.get_selected_items(level_idx, items);
+      latest_transform_selection =
+        new TransformSelectionCommand(&building, level_idx, items);
+      if (latest_transform_selection->size() > 1)
+      {
+        // drop the single-entity command made above; older ones belong to
+        // the undo stack
+        if (mouse_model_idx >= 0)
+          delete latest_move_model;
+        else if (mouse_vertex_idx >= 0)
+          delete latest_move_vertex;
+        else if (mouse_tag_idx >= 0)
+          delete latest_move_tag;
+        else if (mouse_feature_idx >= 0)
+          delete latest_move_feature;
+        else if (mouse_fiducial_idx >= 0)
+          delete latest_move_fiducial;
+        mouse_model_idx = -1;
+        mouse_vertex_idx = -1;
+        mouse_tag_idx = -1;
+        mouse_feature_idx = -1;
+        mouse_feature_layer_idx = -1;
+        mouse_fiducial_idx = -1;
+        mouse_motion_model = nullptr;
+        mouse_group_anchor = p;
+      }
+      else
+      {
+        delete latest_transform_selection;
+        latest_transform_selection = nullptr;
+      }
+    }
+
+    set_scene_bulk_update(
+      latest_transform_selection != nullptr ||
+      mouse_model_idx >= 0 ||
+      mouse_vertex_idx >= 0 ||
+      mouse_tag_idx >= 0 ||
+      mouse_feature_idx >= 0 ||
+      mouse_fiducial_idx >= 0);
   }
   else if (t == MOUSE_RELEASE)
   {
+    if (latest_transform_selection)
+    {
+      if (latest_transform_selection->transform().offset != QPointF())
+        undo_stack->push(latest_transform_selection);
+      else
+        delete latest_transform_selection;
+      latest_transform_selection = nullptr;
+    }
+
     if (mouse_vertex_idx >= 0) //Add mouse move vertex.
     {
       if (latest_move_vertex->has_moved)
       {
-        undo_stack.push(latest_move_vertex);
+        undo_stack->push(latest_move_vertex);
       }
       else
       {
@@ -1933,7 +10546,7 @@ void Editor::mouse_move(
     {
       if (latest_move_tag->has_moved)
       {
-        undo_stack.push(latest_move_tag);
+        undo_stack->push(latest_move_tag);
       }
       else
       {
@@ -1946,7 +10559,7 @@ void Editor::mouse_move(
     {
       if (latest_move_model->has_moved)
       {
-        undo_stack.push(latest_move_model);
+        undo_stack->push(latest_move_model);
       }
       else
       {
@@ -1959,7 +10572,24 @@ void Editor::mouse_move(
     {
       if (latest_move_feature->has_moved)
       {
-        undo_stack.push(latest_move_feature);
+        const Level& level = building.levels[level_idx];
+        const Feature& feature = mouse_feature_layer_idx == 0 ?
+          level.floorplan_features[mouse_feature_idx] :
+          level.layers[mouse_feature_layer_idx - 1].features[mouse_feature_idx];
+        const std::vector<int> layer_idxs =
+          level.constrained_layers(feature.id());
+
+        if (layer_idxs.empty())
+          undo_stack->push(latest_move_feature);  // may merge with the last
+        else
+        {
+          undo_stack->beginMacro("Move feature");
+          undo_stack->push(latest_move_feature);
+          reoptimize_layers(
+            std::set<int>(layer_idxs.begin(), layer_idxs.end()));
+          undo_stack->endMacro();
+        }
+        create_scene();
       }
       else
       {
@@ -1972,7 +10602,7 @@ void Editor::mouse_move(
     {
       if (latest_move_fiducial->has_moved)
       {
-        undo_stack.push(latest_move_fiducial);
+        undo_stack->push(latest_move_fiducial);
       }
       else
       {
@@ -1980,13 +10610,17 @@ void Editor::mouse_move(
         latest_move_fiducial = NULL;
       }
     }
+    // everything was already re-rendered while dragging
+    mouse_model_idx = -1;
     mouse_vertex_idx = -1;
     mouse_tag_idx = -1;
     mouse_feature_idx = -1;
     mouse_feature_layer_idx = -1;
     mouse_fiducial_idx = -1;
-    create_scene();  // this will free mouse_motion_model
-    setWindowModified(true);
+    mouse_motion_model = nullptr;  // the model keeps its pixmap item
+    remove_snap_hint();
+    set_scene_bulk_update(false);
+    set_modified();
   }
   else if (t == MOUSE_MOVE)
   {
@@ -2002,7 +10636,16 @@ void Editor::mouse_move(
       mouse_feature_layer_idx,
       mouse_fiducial_idx);
     */
-    if (mouse_motion_model != nullptr)
+    if (latest_transform_selection)
+    {
+      // the stored positions are from the press, so this doesn't drift
+      latest_transform_selection->set_transform(
+        TransformSelectionCommand::Similarity::translation(
+          p - mouse_group_anchor));
+      latest_transform_selection->redo();
+      apply_level_changes();
+    }
+    else if (mouse_motion_model != nullptr)
     {
       // we're dragging a model
       // update both the nav_model data and the pixmap in the scene
@@ -2012,16 +10655,21 @@ void Editor::mouse_move(
       model.state.y = p.y();
       mouse_motion_model->setPos(p);
       latest_move_model->set_final_destination(p.x(), p.y());
+      building.levels[level_idx].mark_moved(Level::MODEL, mouse_model_idx);
     }
     else if (mouse_vertex_idx >= 0)
     {
       // we're dragging a vertex
+      const QPointF p_snapped = snap_point(p, mouse_vertex_idx);
       Vertex& pt =
         building.levels[level_idx].vertices[mouse_vertex_idx];
-      pt.x = p.x();
-      pt.y = p.y();
-      latest_move_vertex->set_final_destination(p.x(), p.y());
-      create_scene();
+      pt.x = p_snapped.x();
+      pt.y = p_snapped.y();
+      latest_move_vertex->set_final_destination(pt.x, pt.y);
+      building.levels[level_idx].mark_changed(
+        Level::VERTEX,
+        mouse_vertex_idx);
+      apply_level_changes();
     }
     else if (mouse_feature_idx >= 0 && mouse_feature_layer_idx >= 0)
     {
@@ -2044,7 +10692,7 @@ void Editor::mouse_move(
       feature->set_y(q.y());
       latest_move_feature->set_final_destination(q.x(), q.y());
 
-      printf("moved feature %d on layer %d to (%.1f, %.1f)\n",
+      qCDebug(lc_edit, "moved feature %d on layer %d to (%.1f, %.1f)",
         mouse_feature_idx,
         mouse_feature_layer_idx,
         feature->x(),
@@ -2058,11 +10706,14 @@ void Editor::mouse_move(
       f.x = p.x();
       f.y = p.y();
       latest_move_fiducial->set_final_destination(p.x(), p.y());
-      printf("moved fiducial %d to (%.1f, %.1f)\n",
+      qCDebug(lc_edit, "moved fiducial %d to (%.1f, %.1f)",
         mouse_fiducial_idx,
         f.x,
         f.y);
-      create_scene();
+      building.levels[level_idx].mark_changed(
+        Level::FIDUCIAL,
+        mouse_fiducial_idx);
+      apply_level_changes();
     }
   }
 }
@@ -2080,6 +10731,9 @@ void Editor::mouse_add_edge(
       building.levels[level_idx].vertices[clicked_idx];
     align_point(QPointF(start.x, start.y), p_aligned);
   }
+  else if ((t == MOUSE_PRESS && (e->buttons() & Qt::LeftButton)) ||
+    t == MOUSE_MOVE)
+    p_aligned = snap_point(p);
 
   if (t == MOUSE_PRESS)
   {
@@ -2110,7 +10764,7 @@ void Editor::mouse_add_edge(
       latest_add_edge->set_edge_type(edge_type);
       prev_clicked_idx = clicked_idx;
       create_scene();
-      setWindowModified(true);
+      set_modified();
       return; // no previous vertex click happened; nothing else to do
     }
 
@@ -2122,7 +10776,7 @@ void Editor::mouse_add_edge(
       remove_mouse_motion_item();
       return;
     }
-    undo_stack.push(latest_add_edge);
+    undo_stack->push(latest_add_edge);
 
     if (edge_type == Edge::DOOR || edge_type == Edge::MEAS)
     {
@@ -2141,7 +10795,7 @@ void Editor::mouse_add_edge(
     }
     prev_clicked_idx = clicked_idx;
     create_scene();
-    setWindowModified(true);
+    set_modified();
   }
   else if (t == MOUSE_MOVE)
   {
@@ -2167,18 +10821,19 @@ void Editor::mouse_add_constraint(
     const Feature* f = level->find_feature(p.x(), p.y());
     if (!f)
     {
-      printf("no feature near (%.3f, %.3f)\n", p.x(), p.y());
+      qCDebug(lc_edit, "no feature near (%.3f, %.3f)", p.x(), p.y());
       clicked_feature_id = QUuid();
       remove_mouse_motion_item();
       return;
     }
 
-    printf("found feature %s\n", f->id().toString().toStdString().c_str());
+    qCDebug(lc_edit,
+      "found feature %s", f->id().toString().toStdString().c_str());
 
     if (!clicked_feature_id.isNull())
     {
       // create an edge between this feature and the previously clicked one
-      printf("creating constraint between %s and %s\n",
+      qCDebug(lc_edit, "creating constraint between %s and %s",
         clicked_feature_id.toString().toStdString().c_str(),
         f->id().toString().toStdString().c_str());
       AddConstraintCommand* command = new AddConstraintCommand(
@@ -2186,10 +10841,20 @@ void Editor::mouse_add_constraint(
         level_idx,
         clicked_feature_id,
         f->id());
-      undo_stack.push(command);
+      std::set<int> layer_idxs;
+      for (const QUuid& id : {clicked_feature_id, f->id()})
+      {
+        for (const int idx : level->constrained_layers(id))
+          layer_idxs.insert(idx);
+      }
+
+      undo_stack->beginMacro("Add constraint");
+      undo_stack->push(command);
+      reoptimize_layers(layer_idxs);
+      undo_stack->endMacro();
 
       clicked_feature_id = QUuid();
-      setWindowModified(true);
+      set_modified();
       create_scene();
     }
     else
@@ -2269,8 +10934,8 @@ void Editor::mouse_add_model(
       p.y(),
       mouse_motion_editor_model->name
     );
-    undo_stack.push(cmd);
-    setWindowModified(true);
+    undo_stack->push(cmd);
+    set_modified();
     create_scene();
   }
   else if (t == MOUSE_MOVE)
@@ -2304,17 +10969,75 @@ void Editor::align_point(const QPointF& start, QPointF& end)
     end.setY(start.y());
 }
 
+QPointF Editor::snap_point(const QPointF& p, const int exclude_vertex_idx)
+{
+  if (!edit_snap_action->isChecked())
+  {
+    remove_snap_hint();
+    return p;
+  }
+
+  // snap within a fixed distance on screen, whatever the zoom level
+  const double scale = map_view->transform().m11();
+  const double threshold = SNAP_DISTANCE_PIXELS / (scale > 0.0 ? scale : 1.0);
+  const Level::SnapTarget target =
+    building.levels[level_idx].snap_target(
+    p.x(),
+    p.y(),
+    threshold,
+    exclude_vertex_idx);
+
+  if (target.kind == Level::SnapTarget::NONE)
+  {
+    remove_snap_hint();
+    return p;
+  }
+
+  QColor color;
+  switch (target.kind)
+  {
+    case Level::SnapTarget::VERTEX:
+      color = QColor::fromRgbF(0.0, 0.8, 0.0);
+      break;
+    case Level::SnapTarget::EDGE_MIDPOINT:
+      color = QColor::fromRgbF(1.0, 0.6, 0.0);
+      break;
+    default:
+      color = QColor::fromRgbF(1.0, 0.0, 1.0);
+      break;
+  }
+
+  if (snap_hint == nullptr)
+  {
+    snap_hint = scene->addEllipse(
+      -SNAP_DISTANCE_PIXELS,
+      -SNAP_DISTANCE_PIXELS,
+      2 * SNAP_DISTANCE_PIXELS,
+      2 * SNAP_DISTANCE_PIXELS);
+    snap_hint->setFlag(QGraphicsItem::ItemIgnoresTransformations);
+    snap_hint->setZValue(1000);
+  }
+  snap_hint->setPen(QPen(QBrush(color), 2));
+  snap_hint->setPos(target.point);
+  return target.point;
+}
+
+void Editor::remove_snap_hint()
+{
+  if (snap_hint)
+  {
+    scene->removeItem(snap_hint);
+    delete snap_hint;
+    snap_hint = nullptr;
+  }
+}
+
 void Editor::mouse_rotate(
   const MouseType t, QMouseEvent* mouse_event, const QPointF& p)
 {
   if (t == MOUSE_PRESS)
   {
-    clicked_idx = building.nearest_item_index_if_within_distance(
-      level_idx,
-      p.x(),
-      p.y(),
-      50.0,
-      Level::MODEL);
+    clicked_idx = building.levels[level_idx].model_at(p.x(), p.y(), 50.0);
     if (clicked_idx < 0)
       return;// nothing to do. click wasn't on a model.
 
@@ -2323,8 +11046,7 @@ void Editor::mouse_rotate(
       level_idx,
       clicked_idx);
     const Model& model = building.levels[level_idx].models[clicked_idx];
-    mouse_motion_model = get_closest_pixmap_item(
-      QPointF(model.state.x, model.state.y));
+    mouse_motion_model = model.pixmap_item;
     QPen pen(Qt::red);
     pen.setWidth(4);
     const double r = static_cast<double>(ROTATION_INDICATOR_RADIUS);
@@ -2353,9 +11075,9 @@ void Editor::mouse_rotate(
     if (mouse_event->modifiers() & Qt::ShiftModifier)
       mouse_yaw = discretize_angle(mouse_yaw);
     latest_rotate_model->set_final_destination(mouse_yaw);
-    undo_stack.push(latest_rotate_model);
+    undo_stack->push(latest_rotate_model);
     clicked_idx = -1;  // we're done rotating it now
-    setWindowModified(true);
+    set_modified();
     // now re-render the whole scene (could optimize in the future...)
     create_scene();
   }
@@ -2384,31 +11106,6 @@ void Editor::mouse_rotate(
   }
 }
 
-QGraphicsPixmapItem* Editor::get_closest_pixmap_item(const QPointF& p)
-{
-  // todo: use fancier calls if the scene graph gets so big that a linear
-  // search becomes intolerably slow
-  const QList<QGraphicsItem*> items = scene->items();
-  QGraphicsPixmapItem* pixmap_item = nullptr;
-  double min_dist = 1.0e9;
-  for (const auto item : items)
-  {
-    if (item->type() != QGraphicsPixmapItem::Type)
-      continue;// ignore anything other than the pixmaps (models)
-    const double model_click_distance = QLineF(p, item->pos()).length();
-    const double width = item->boundingRect().width();
-    const double height = item->boundingRect().height();
-    printf("model_click_distance = %.2f bounds = (%.1f, %.1f)\n",
-      model_click_distance, width, height);
-    if (model_click_distance < min_dist)
-    {
-      min_dist = model_click_distance;
-      pixmap_item = qgraphicsitem_cast<QGraphicsPixmapItem*>(item);
-    }
-  }
-  return pixmap_item;
-}
-
 void Editor::mouse_add_polygon(
   const MouseType t,
   QMouseEvent* e,
@@ -2426,7 +11123,8 @@ void Editor::mouse_add_polygon(
         return;// nothing to do. click wasn't on a vertex.
 
       Vertex* v = &building.levels[level_idx].vertices[clicked_idx];
-      v->selected = true;  // todo: colorize it?
+      building.levels[level_idx].select(
+        Level::make_selected_item(Level::VERTEX, clicked_idx));
 
       if (mouse_motion_polygon == nullptr)
       {
@@ -2466,13 +11164,13 @@ void Editor::mouse_add_polygon(
           polygon,
           level_idx);
 
-        undo_stack.push(command);
+        undo_stack->push(command);
       }
       scene->removeItem(mouse_motion_polygon);
       delete mouse_motion_polygon;
       mouse_motion_polygon = nullptr;
 
-      setWindowModified(true);
+      set_modified();
       building.clear_selection(level_idx);
       create_scene();
     }
@@ -2537,17 +11235,18 @@ void Editor::mouse_edit_polygon(
         p.y());
       if (ni.vertex_dist > 10.0)
       {
-        printf("right-click wasn't near a vertex: %.1f\n", ni.vertex_dist);
+        qCDebug(lc_edit,
+          "right-click wasn't near a vertex: %.1f", ni.vertex_dist);
         return;  // click wasn't near a vertex
       }
       else
       {
-        printf("removing vertex %d\n", ni.vertex_idx);
+        qCDebug(lc_edit, "removing vertex %d", ni.vertex_idx);
       }
       PolygonRemoveVertCommand* command = new PolygonRemoveVertCommand(
-        selected_polygon, ni.vertex_idx);
-      undo_stack.push(command);
-      setWindowModified(true);
+        &building.levels[level_idx], selected_polygon, ni.vertex_idx);
+      undo_stack->push(command);
+      set_modified();
       create_scene();
     }
     else if (e->buttons() & Qt::LeftButton)
@@ -2580,7 +11279,7 @@ void Editor::mouse_edit_polygon(
       qInfo("woah! edit_polygon_release() with null mouse_motion_polygon!");
       return;
     }
-    printf("replacing vertices of polygon...\n");
+    qCDebug(lc_edit, "replacing vertices of polygon...");
     scene->removeItem(mouse_motion_polygon);
     delete mouse_motion_polygon;
     mouse_motion_polygon = nullptr;
@@ -2601,13 +11300,14 @@ void Editor::mouse_edit_polygon(
       return;// Release vertex is already in the polygon. Don't do anything.
 
     PolygonAddVertCommand* command = new PolygonAddVertCommand(
+      &building.levels[level_idx],
       selected_polygon,
       mouse_edge_drag_polygon.movable_vertex,
       release_vertex_idx);
 
-    undo_stack.push(command);
+    undo_stack->push(command);
 
-    setWindowModified(true);
+    set_modified();
     create_scene();
   }
   else if (t == MOUSE_MOVE)
@@ -2629,17 +11329,23 @@ void Editor::mouse_edit_polygon(
 void Editor::number_key_pressed(const int n)
 {
   bool found_edge = false;
-  for (auto& edge : building.levels[level_idx].edges)
+  Level& level = building.levels[level_idx];
+  for (std::size_t i = 0; i < level.edges.size(); i++)
   {
-    if (edge.selected && edge.type == Edge::LANE)
+    Edge& edge = level.edges[i];
+    if (edge.selected && edge.type == Edge::LANE &&
+      edge.get_graph_idx() != n)
     {
       edge.set_graph_idx(n);
+      level.mark_changed(Level::EDGE, static_cast<int>(i));
       found_edge = true;
     }
   }
   if (found_edge)
   {
-    create_scene();
+    // only the moved lanes, and the arrows of their old and new graphs
+    set_modified();
+    apply_level_changes();
     update_property_editor();
   }
 
@@ -2689,7 +11395,7 @@ void Editor::closeEvent(QCloseEvent* event)
     map_view->viewport()->height() / 2);
   const QPointF p_center_scene = map_view->mapToScene(p_center_window);
 
-  printf("closeEvent:  (%d, %d) -> (%.1f, %.1f)\n",
+  qCDebug(lc_edit, "closeEvent:  (%d, %d) -> (%.1f, %.1f)",
     p_center_window.x(),
     p_center_window.y(),
     p_center_scene.x(),
@@ -2705,10 +11411,23 @@ void Editor::closeEvent(QCloseEvent* event)
       preferences_keys::level_name,
       QString::fromStdString(building.levels[level_idx].name));
 
-  if (maybe_save())
-    event->accept();
-  else
-    event->ignore();
+  // let a running autosave finish before its snapshot goes away
+  autosave_watcher->waitForFinished();
+
+  // each tab with unsaved changes is shown while it is asked about
+  const int active_idx = workspace.active();
+  for (int i = 0; i < workspace.count(); i++)
+  {
+    if (i != active_idx && !workspace.document(i).modified)
+      continue;
+    switch_document(i);
+    if (!maybe_save())
+    {
+      event->ignore();
+      return;
+    }
+  }
+  event->accept();
 }
 
 #if 0
@@ -2718,7 +11437,7 @@ void Editor::set_tool_visibility(const ToolId id, const bool visible)
   if (a)
     a->setVisible(visible);
   else
-    printf("unable to find tool action %d\n", static_cast<int>(id));
+    qCWarning(lc_edit, "unable to find tool action %d", static_cast<int>(id));
 }
 
 void Editor::set_mode(const EditorModeId _mode, const QString& mode_string)
@@ -2760,12 +11479,40 @@ void Editor::set_mode(const EditorModeId _mode, const QString& mode_string)
 void Editor::update_tables()
 {
   level_table->update(building);
+  level_table->set_thumbnails(building, *level_thumbnails);
   lift_table->update(building);
   traffic_table->update(rendering_options);
-  crowd_sim_table->update();
+  if (crowd_sim_table)
+    crowd_sim_table->update();
   layer_table->update(building, level_idx, layer_idx);
 }
 
+void Editor::create_crowd_sim_table()
+{
+  if (crowd_sim_table)
+    return;
+  crowd_sim_table = new CrowdSimEditorTable(building);
+  connect(
+    crowd_sim_table,
+    &QTableWidget::cellClicked,
+    [&]()
+    {
+      crowd_sim_table->update();
+      create_scene();
+    }
+  );
+  crowd_sim_table->update();
+
+  // swap it in for the placeholder, without this being called again
+  const QSignalBlocker blocker(right_tab_widget);
+  const int tab_idx = right_tab_widget->indexOf(crowd_sim_placeholder);
+  right_tab_widget->removeTab(tab_idx);
+  right_tab_widget->insertTab(tab_idx, crowd_sim_table, "crowd_sim");
+  right_tab_widget->setCurrentIndex(tab_idx);
+  crowd_sim_placeholder->deleteLater();
+  crowd_sim_placeholder = nullptr;
+}
+
 void Editor::clear_current_tool_buffer()
 {
   if (
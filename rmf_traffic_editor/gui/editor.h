@@ -18,10 +18,14 @@
 #ifndef EDITOR_H
 #define EDITOR_H
 
+#include <atomic>
 #include <map>
+#include <memory>
+#include <set>
 #include <string>
 #include <vector>
 
+#include <QElapsedTimer>
 #include <QGraphicsItem>
 #include <QGraphicsEllipseItem>
 #include <QGraphicsPixmapItem>
@@ -29,6 +33,7 @@
 #include <QGraphicsScene>
 #include <QMainWindow>
 #include <QSettings>
+#include <QFutureWatcher>
 #include <QUndoStack>
 
 #include "actions/add_edge.h"
@@ -38,16 +43,62 @@
 #include "actions/move_vertex.h"
 #include "actions/move_tag.h"
 #include "actions/rotate_model.h"
+#include "actions/bulk_models.hpp"
+#include "actions/transform_selection.hpp"
 #include "building.h"
+#include "building_snapshot.hpp"
+#include "building_validator.hpp"
+#include "change_delta.hpp"
+#include "crowd_preview.hpp"
+#include "draw_profile.hpp"
+#include "dxf_importer.hpp"
 #include "editor_model.h"
+#include "door_clearance_checker.hpp"
+#include "edit_journal.hpp"
+#include "edit_sync.hpp"
+#include "editor_model_index.hpp"
+#include "feature_matcher.hpp"
+#include "file_watcher.hpp"
+#include "frame_encoder.hpp"
+#include "interaction_recording.hpp"
+#include "joint_alignment.hpp"
+#include "lane_conflict_checker.hpp"
+#include "lane_graph_analysis.hpp"
+#include "lane_path_planner.hpp"
+#include "lane_sweep_checker.hpp"
+#include "lane_usage_analysis.hpp"
+#include "level_registration.hpp"
+#include "level_snapshot.hpp"
+#include "level_thumbnails.hpp"
+#include "minimap.hpp"
+#include "model_overlap_checker.hpp"
+#include "name_index.hpp"
+#include "navmesh_set.hpp"
+#include "param_index.hpp"
+#include "polygon_booleans.hpp"
 #include "rendering_options.h"
+#include "runtime_statistics.hpp"
+#include "scene_geometry.hpp"
+#include "simulation_recording.hpp"
+#include "task_pool.hpp"
+#include "tick_profiler.hpp"
+#include "traffic_preview.hpp"
+#include "undo_budget.hpp"
+#include "wall_extractor.hpp"
+#include "workspace.hpp"
 
 #include "crowd_sim/crowd_sim_editor_table.h"
 
+class BasemapItem;
+class BatchEdit;
 class BuildingTable;
 class LayerTable;
 class LevelTable;
 class MapView;
+class ThumbnailLoader;
+class TileCache;
+class TowerOverview;
+class WorldPreview;
 class Level;
 class LiftTable;
 class TrafficTable;
@@ -57,6 +108,8 @@ QT_BEGIN_NAMESPACE
 class QAction;
 class QButtonGroup;
 class QComboBox;
+class QDialog;
+class QDockWidget;
 class QGraphicsView;
 class QHBoxLayout;
 class QLabel;
@@ -64,7 +117,11 @@ class QLineEdit;
 class QListWidget;
 class QMenu;
 class QMouseEvent;
+class QPlainTextEdit;
+class QProgressDialog;
 class QPushButton;
+class QSlider;
+class QTabBar;
 class QTableWidget;
 class QTableWidgetItem;
 class QTabWidget;
@@ -86,13 +143,33 @@ public:
   /// Load a building, replacing the current building being edited
   bool load_building(const QString& filename);
 
-  /// Attempt to load the most recently saved project, just for convenience
-  /// when starting the application since often we want to 'resume' editing.
-  bool load_previous_building();
+  /// Like load_building(), but the building is read on a worker thread
+  /// behind a progress dialog, so that the window can be shown first. The
+  /// previous viewport is restored once it's loaded, if restore_viewport.
+  void load_building_async(
+    const QString& filename,
+    const bool restore_viewport);
+
+  /// The most recently saved building, just for convenience when starting
+  /// the application since often we want to 'resume' editing; or empty.
+  static QString previous_building_path();
 
   /// Attempt to restore the previous viewport scale and center point
   void restore_previous_viewport();
 
+  /// Make a batch edit plugin available in Edit > Batch edits. Each run
+  /// of it is one undo step.
+  void add_batch_edit(std::unique_ptr<BatchEdit> batch_edit);
+
+  /// Feed a recorded session to the editor as fast as it will take it,
+  /// timing each event and the repaint after it, into categories "pick",
+  /// "drag", "add_edge", "undo", "draw", etc. The building must already be
+  /// loaded and the window shown. Returns false if the recording is for a
+  /// level which this building doesn't have.
+  bool replay_interactions(
+    const InteractionRecording& recording,
+    InteractionLatencies& latencies);
+
 protected:
   void mousePressEvent(QMouseEvent* e);
   void mouseReleaseEvent(QMouseEvent* e);
@@ -103,7 +180,40 @@ protected:
 
 private:
 
-  QUndoStack undo_stack;
+  /// The buildings open in tabs; see Workspace. The building being
+  /// edited is always in `building`, and undo_stack and undo_budget are
+  /// those of its document.
+  Workspace workspace;
+  QTabBar* workspace_tab_bar = nullptr;
+
+  /// Add a tab for an empty document, without activating it
+  int add_document();
+
+  /// Park the active building in its document and edit this one instead
+  void switch_document(const int idx);
+
+  /// Ask to save the building of this tab if needed, then close the tab.
+  /// The last tab stays open.
+  bool close_document(const int idx);
+
+  /// Forget a document which is not the active one, and close its tab
+  void remove_document(const int idx);
+
+  /// Show the file name of the active building in its tab
+  void update_document_tab();
+
+  QUndoStack* undo_stack = nullptr;
+
+  /// Compacts and retires old undo history; see UndoBudget
+  UndoBudget* undo_budget = nullptr;
+  QLabel* undo_memory_label = nullptr;
+  void enforce_undo_budget();
+
+  /// Undo and redo redraw only what their commands reported changing
+  /// through Level::mark_changed(), once the burst of them is over
+  bool undo_redraw_pending = false;
+  void schedule_undo_redraw();
+  void apply_undo_changes();
 
   enum ToolId
   {
@@ -134,18 +244,98 @@ private:
   // MENU ACTIONS
   void building_new();
   void building_open();
+  void building_open_tab();
+  void building_close_tab();
+
+  /// Ask for a building file to open; empty if canceled
+  QString building_open_dialog();
   bool building_save();
   bool building_export_features();
+  void building_export_all_features();
+
+  /// Import the levels, lanes and models of another building; see
+  /// BuildingMerger
+  void building_merge();
+
+  /// Reproject the whole building into another coordinate system; see
+  /// CoordinateConversion
+  void building_convert_coordinates();
+
+  /// Edit the building together with other editors; see EditSync
+  void building_share_host();
+  void building_share_join();
+  void building_share_stop();
+  void building_export_navmeshes();
+  void building_export_nav_graphs();
+  void building_export_occupancy_grids();
+
+  /// Print the active level, or all of them, to PNG, SVG or PDF files at
+  /// a scale and DPI; see LevelImageExporter
+  void building_export_images(const bool all_levels);
 
   bool maybe_save();
+
+  /// setWindowModified(true), after an edit of the active level
+  void set_modified();
+
+  /// set_modified(), unless an undo or redo has brought the building back
+  /// to what was last loaded or saved (see Building::content_hash())
+  void set_modified_after_undo();
   void edit_undo();
   void edit_redo();
+  void edit_copy();
+  void edit_paste();
+  void edit_paste_in_place();
+  void edit_duplicate_level();
+
+  /// Paste the clip on the clipboard into the active level as one undo
+  /// step, centered on the mouse or (in_place) where it was copied from.
+  /// Returns false if there is nothing to paste.
+  bool paste_clipboard(const bool in_place);
   void edit_preferences();
   void edit_building_properties();
+  void edit_go_to();
+  void edit_find_replace_params();
   void edit_project_properties();
-  void edit_rotate_all_models();
+  void edit_rotate_models();
+  void edit_move_models();
+  void edit_rename_models();
+  void edit_set_models_static();
+
+  /// The selected models of the active level, in the form taken by
+  /// BulkModelsCommand; empty (meaning all models) if none are selected
+  std::vector<std::vector<int>> bulk_model_targets() const;
+
+  /// Push a BulkModelsCommand for bulk_model_targets(); returns false
+  /// if it wouldn't change anything
+  bool push_bulk_models(const BulkModelsCommand::Operation& operation);
   void edit_optimize_layer_transforms();
+
+  /// Solve every layer and level transform together (see JointAlignment),
+  /// which also turns on the joint fit of the levels
+  void edit_optimize_all_transforms();
+  void edit_joint_alignment(bool enabled);
   void edit_align_colinear();
+  void edit_align_all_colinear();
+
+  /// Weld the coincident vertices of the active level and drop the edges
+  /// and polygons this leaves empty or repeated; see GeometryCleanup
+  void edit_cleanup_geometry();
+
+  /// Thin out the nearly collinear vertices of the selected walls (and the
+  /// chains they are on) and polygons; see GeometrySimplifier
+  void edit_simplify_geometry();
+
+  /// Replace the selected polygons of the active level by their union,
+  /// intersection, difference or offset, in one undoable batch edit; see
+  /// PolygonBooleans
+  void edit_polygon_booleans(const PolygonBooleans::Operation operation);
+  void edit_rotate_selection();
+  void edit_scale_selection();
+
+  /// Push a transform of the selection of the active level, about its
+  /// centroid; returns false if nothing is selected
+  bool transform_selection(const double rotation, const double scale);
 
   void level_add();
   void level_edit();
@@ -155,7 +345,38 @@ private:
   void layer_table_update_slot();
 
   void zoom_reset();
+  void zoom_fit();
   void view_models();
+  void view_floor_triangulation();
+  void view_world_preview();
+  void view_batch_vertices();
+  void view_batch_edges();
+  void view_cull_to_viewport();
+  void view_profiling_overlay();
+  void view_ghost_levels();
+  void view_navmesh();
+  void view_lane_connectivity();
+  void view_lane_conflicts();
+  void view_model_overlaps();
+  void view_door_clearance();
+  void view_lane_clearance();
+  void view_lane_usage();
+  void view_traffic_preview();
+  void view_lane_route();
+  void view_changes();
+  void view_crowd_preview();
+  void view_basemap();
+  void view_io_profile();
+  void view_record_trace();
+  void view_record_interactions();
+  void view_memory_usage();
+  void view_runtime_statistics();
+  void view_log();
+  void view_simulation_timings();
+  void view_open_recording();
+  void view_close_recording();
+  void view_export_recording_frames();
+  void view_capture_frames();
 
   void help_about();
 
@@ -186,10 +407,415 @@ private:
   Level* active_level();
   Layer* active_layer();
 
+  /// The scene of the active level, in the map view
   QGraphicsScene* scene = nullptr;
   MapView* map_view = nullptr;
 
+  /// The scenes of levels that were shown recently, kept as they were
+  /// drawn so that switching back to one is only a MapView::setScene().
+  /// The least recently shown is first. Every edit and full redraw drops
+  /// them, as does a change of a level that isn't shown.
+  struct CachedScene
+  {
+    int level_idx = -1;
+    QGraphicsScene* scene = nullptr;
+  };
+  std::vector<CachedScene> cached_scenes;
+  void drop_cached_scenes();
+  void drop_cached_scene(const int idx);
+
+  /// Show another level, from its cached scene if there is one. Otherwise
+  /// the scene of this level is cached and the new one drawn in a fresh
+  /// scene, as create_scene_async() would.
+  void switch_level(const int idx);
+
+  /// Remove the overlays (ghost levels, navmesh, lane analyses, crowd
+  /// preview and mouse motion items) from the scene, or redraw those that
+  /// are turned on. They belong to the active level, not its cached scene.
+  void remove_overlay_items();
+  void draw_overlay_items();
+
+  QAction* edit_snap_action = nullptr;
+
+  std::vector<std::unique_ptr<BatchEdit>> batch_edits;
+  QMenu* batch_edit_menu = nullptr;
+
+  /// Run a plugin on the building, push its undo step and redraw what it
+  /// touched. Returns false if it failed or changed nothing.
+  bool run_batch_edit(BatchEdit& batch_edit);
   QAction* view_models_action = nullptr;
+  QAction* view_floor_triangulation_action = nullptr;
+  QAction* view_batch_vertices_action = nullptr;
+  QAction* view_batch_edges_action = nullptr;
+  QAction* view_cull_to_viewport_action = nullptr;
+  QAction* view_profiling_overlay_action = nullptr;
+  QAction* view_ghost_levels_action = nullptr;
+  QAction* view_navmesh_action = nullptr;
+  QAction* view_lane_connectivity_action = nullptr;
+  QAction* view_lane_conflicts_action = nullptr;
+  QAction* view_model_overlaps_action = nullptr;
+  QAction* view_door_clearance_action = nullptr;
+  QAction* view_lane_clearance_action = nullptr;
+  QAction* view_lane_usage_action = nullptr;
+  QAction* view_changes_action = nullptr;
+  QAction* view_crowd_preview_action = nullptr;
+  QAction* view_basemap_action = nullptr;
+  QAction* view_record_trace_action = nullptr;
+  QAction* view_record_interactions_action = nullptr;
+
+  /// While View > Record interactions is on, the input of the session is
+  /// appended here; see InteractionRecording.
+  std::unique_ptr<InteractionRecording> interaction_recording;
+  QElapsedTimer interaction_timer;
+  bool replaying_interactions = false;
+  void record_interaction(InteractionRecording::Event event);
+  void record_view_interaction();
+
+  /// Rasters of other levels, shown under the active level while
+  /// View > Ghost adjacent levels is on. Rendered when first needed and
+  /// dropped when the level is edited.
+  std::map<int, LevelSnapshot> level_snapshots;
+
+  /// The ghost items in the scene; borrowed pointers owned by the scene
+  QList<QGraphicsItem*> ghost_items;
+
+  /// Add the levels just above and below the active one to the scene
+  void draw_ghost_levels();
+
+  /// Crowd simulation navmeshes of the levels, from their human lanes,
+  /// and their links at the lifts. Rebuilt in part as the lanes are
+  /// edited.
+  NavmeshSet navmeshes;
+
+  /// The navmesh overlay items in the scene; borrowed, like ghost_items
+  QList<QGraphicsItem*> navmesh_items;
+
+  /// Bring the navmesh of the active level up to date and show it
+  void draw_navmesh();
+
+  /// View > Traffic maps, listing the traffic_maps of the building each
+  /// time it opens, to show or hide each overlay
+  QMenu* traffic_maps_menu = nullptr;
+  void update_traffic_maps_menu();
+  void view_traffic_map(const std::size_t idx, const bool visible);
+  void add_traffic_map();
+
+  /// The overlay of each traffic map on the active level, by index into
+  /// traffic_maps, or nullptr if it wasn't shown since the scene was
+  /// cleared (so the hidden maps are never parsed); borrowed
+  std::vector<QGraphicsPathItem*> traffic_map_items;
+  void draw_traffic_maps();
+
+  /// Extruded walls and floors of every level, rebuilt on the worker pool
+  /// for the levels that were edited while View > 3D preview is open. The
+  /// timer batches the edits of a drag into one rebuild.
+  WorldPreview* world_preview = nullptr;
+  QDialog* world_preview_dialog = nullptr;
+  QTimer* world_preview_timer = nullptr;
+  void update_world_preview();
+
+  /// View > Minimap: an overview of the active level in a dock. Its
+  /// rasters are rendered on a worker thread, kept per level and dropped
+  /// when the level is edited; the timer batches the edits of a drag.
+  Minimap* minimap = nullptr;
+  QDockWidget* minimap_dock = nullptr;
+  QTimer* minimap_timer = nullptr;
+  QFutureWatcher<Minimap::Raster>* minimap_watcher = nullptr;
+  std::map<int, Minimap::Raster> minimap_rasters;
+  int minimap_generation = 0;
+  int minimap_render_generation = -1;
+  int minimap_render_level_idx = -1;
+  void update_minimap();
+  void invalidate_minimap();
+  void render_minimap();
+  void minimap_rendered();
+
+  /// View > Building statistics: the figures of BuildingStatistics in a
+  /// dock, gathered again shortly after each redraw. Only the entities
+  /// edited since are counted again; the timer batches a drag.
+  QDockWidget* statistics_dock = nullptr;
+  QPlainTextEdit* statistics_text = nullptr;
+  QTimer* statistics_timer = nullptr;
+  void update_statistics();
+  void refresh_statistics();
+
+  /// View > Tower overview: all levels stacked in the reference frame,
+  /// from the minimap rasters (the missing ones are rendered alongside,
+  /// on the worker pool) and with the lift cabins drawn on top. Not
+  /// modal; the timer batches the edits of a drag.
+  QDialog* tower_overview_dialog = nullptr;
+  TowerOverview* tower_overview = nullptr;
+  QTimer* tower_overview_timer = nullptr;
+  void view_tower_overview();
+  void update_tower_overview();
+  void refresh_tower_overview();
+
+  /// Pictures of the levels beside their names in the level table,
+  /// rendered in the background from the published snapshots
+  LevelThumbnails* level_thumbnails = nullptr;
+
+  /// Strongly connected components of the lane graphs of each level, kept
+  /// up to date as lanes are edited while View > Lane graph connectivity
+  /// is on, which marks the vertices outside the main component of their
+  /// graph
+  std::map<int, LaneGraphAnalysis> lane_graph_analyses;
+  QList<QGraphicsItem*> lane_connectivity_items;  // borrowed, like above
+  void draw_lane_connectivity();
+
+  /// Lanes crossing walls or each other, or too close to walls, on each
+  /// level, kept up to date while View > Lane conflicts is on
+  std::map<int, LaneConflictChecker> lane_conflict_checkers;
+  QList<QGraphicsItem*> lane_conflict_items;  // borrowed, like above
+  void draw_lane_conflicts();
+
+  /// Models overlapping each other or lanes on each level, kept up to
+  /// date while View > Model overlaps is on
+  std::map<int, ModelOverlapChecker> model_overlap_checkers;
+  QList<QGraphicsItem*> model_overlap_items;  // borrowed, like above
+  void draw_model_overlaps();
+
+  /// Doors whose swing or slide is blocked on each level, kept up to date
+  /// while View > Door clearance is on
+  std::map<int, DoorClearanceChecker> door_clearance_checkers;
+  QList<QGraphicsItem*> door_clearance_items;  // borrowed, like above
+  void draw_door_clearance();
+
+  /// The robot footprint swept along the lanes of each level, kept up to
+  /// date while View > Lane clearance is on
+  std::map<int, LaneSweepChecker> lane_sweep_checkers;
+  QList<QGraphicsItem*> lane_sweep_items;  // borrowed, like above
+  void draw_lane_clearance();
+
+  /// How many of the quickest routes between the vertices of each graph
+  /// run along each lane (see LaneUsageAnalysis), shown as a heatmap while
+  /// View > Lane usage heatmap is on. It is worked out on the task pool
+  /// from the published snapshot of the level, so editing goes on
+  /// meanwhile; the timer batches the edits of a drag into one update, and
+  /// the heatmap is drawn from the last result until the next one is in.
+  /// The analyses are shared with the job running them.
+  std::map<int, std::shared_ptr<LaneUsageAnalysis>> lane_usage_analyses;
+  QTimer* lane_usage_timer = nullptr;
+  QFutureWatcher<LaneUsageAnalysis::Result>* lane_usage_watcher = nullptr;
+  LaneUsageAnalysis::Result lane_usage_result;
+  int lane_usage_result_level_idx = -1;
+  int lane_usage_generation = 0;
+  int lane_usage_run_generation = -1;
+  int lane_usage_run_level_idx = -1;
+  QList<QGraphicsItem*> lane_usage_items;  // borrowed, like above
+  void update_lane_usage();
+  void compute_lane_usage();
+  void lane_usage_computed();
+  void draw_lane_usage();
+
+  /// Another version of the building, chosen with View > Changes against
+  /// file, which the active level is diffed against (see BuildingDiff)
+  /// whenever it is redrawn
+  std::unique_ptr<Building> diff_base;
+  QList<QGraphicsItem*> diff_items;  // borrowed, like above
+  void draw_changes();
+
+  /// The quickest route along the lanes between two vertices, possibly on
+  /// different levels, chosen with View > Lane route. It is planned again
+  /// whenever the scene is redrawn, so it follows the lanes as they are
+  /// edited.
+  LanePathPlanner lane_path_planner;
+  LanePathPlanner::Stop lane_route_from;
+  LanePathPlanner::Stop lane_route_to;
+  QList<QGraphicsItem*> lane_route_items;  // borrowed, like above
+  void draw_lane_route();
+
+  /// The missions of a fleet, chosen with View > Traffic preview, planned
+  /// and checked for conflicts (see TrafficPreview) on the task pool from
+  /// the published snapshot, then played back on the scene from the
+  /// toolbar at the bottom, with the conflicts of the level marked. The
+  /// robot items are among the traffic preview items, by robot.
+  QFutureWatcher<TrafficPreview::Result>* traffic_preview_watcher = nullptr;
+  TrafficPreview::Result traffic_preview_result;
+  double traffic_preview_time = 0.0;
+  QTimer* traffic_preview_timer = nullptr;
+  QToolBar* traffic_preview_toolbar = nullptr;
+  QAction* traffic_preview_play_action = nullptr;
+  QSlider* traffic_preview_slider = nullptr;  // in tenths of a second
+  QLabel* traffic_preview_time_label = nullptr;
+  QList<QGraphicsItem*> traffic_preview_items;  // borrowed, like above
+  std::vector<QGraphicsEllipseItem*> traffic_preview_robots;
+  void traffic_preview_planned();
+  void traffic_preview_seek(const double time);
+  void traffic_preview_next_conflict();
+  void close_traffic_preview();
+  void draw_traffic_preview();
+
+  /// The crowd_sim agent groups walking the active level, stepped by
+  /// crowd_preview_timer at the update_time_step of the configuration and
+  /// shown as a density heatmap while View > Crowd preview is on
+  CrowdPreview crowd_preview;
+  QTimer* crowd_preview_timer = nullptr;
+  QGraphicsPixmapItem* crowd_preview_item = nullptr;  // owned by the scene
+  void crowd_preview_step();
+  void draw_crowd_preview();
+
+  /// Slippy-map tiles under the levels of WebMercator buildings, while
+  /// View > Basemap tiles is on. The cache is shared by all the tabs.
+  TileCache* tile_cache = nullptr;
+  void draw_basemap();
+
+  /// Times of simulation ticks, scene updates and paints of the map view,
+  /// against the simulation period
+  TickProfiler tick_profiler;
+
+  /// A simulation recording being replayed. The model poses of the
+  /// building are overwritten while scrubbing, so they are kept in
+  /// replay_saved_states and put back when the replay is closed.
+  SimulationRecording replay_recording;
+  std::vector<std::vector<ModelState>> replay_saved_states;
+  int replay_tick = 0;
+  QToolBar* replay_toolbar = nullptr;
+  QSlider* replay_slider = nullptr;
+  QLabel* replay_time_label = nullptr;
+  void replay_seek(const int tick);
+
+  /// Put the model poses back and forget the recording, without redrawing
+  void close_replay();
+
+  /// The names of the entities of the building, for Edit > Go to
+  NameIndex* name_index = nullptr;
+
+  /// Show the level of the entry, select it and center the view on it
+  void go_to(const NameIndex::Entry& entry);
+
+  /// The params of the entities of the building, for Edit > Find and
+  /// replace params
+  ParamIndex param_index;
+
+  /// Snapshots of the active building for the jobs which read it on the
+  /// worker pool (see BuildingSnapshot), published once each command has
+  /// been applied
+  SnapshotPublisher snapshot_publisher;
+  QTimer* snapshot_timer = nullptr;
+  void publish_snapshot();
+
+  /// The tasks tracked by TaskPool, shown in the status bar while they
+  /// run, with a button that cancels them
+  QLabel* task_label = nullptr;
+  QToolButton* task_cancel_button = nullptr;
+  QTimer* task_timer = nullptr;
+  void update_task_status();
+
+  /// Building > Export all features runs on a snapshot in the background
+  QFutureWatcher<bool>* export_features_watcher = nullptr;
+  std::shared_ptr<TaskProgress> export_features_progress;
+  QString export_features_dir;
+  std::shared_ptr<std::vector<std::string>> export_features_written;
+  void export_all_features_finished();
+
+  /// Edit > Match layer features searches the floorplan and a layer image
+  /// on the task pool, then offers the pairs it found for review
+  QFutureWatcher<FeatureMatcher::Result>* feature_match_watcher = nullptr;
+  std::shared_ptr<TaskProgress> feature_match_progress;
+  int feature_match_level_idx = -1;
+  int feature_match_layer_idx = -1;
+  std::string feature_match_layer_name;
+  void edit_match_layer_features();
+  void layer_features_matched();
+
+  /// Edit > Register levels to the reference lines up the drawing of each
+  /// level with that of the reference level on the task pool, then offers
+  /// fiducials at the positions it found
+  QFutureWatcher<std::vector<LevelRegistration::Result>>*
+  level_registration_watcher = nullptr;
+  std::shared_ptr<TaskProgress> level_registration_progress;
+  std::string level_registration_reference_name;
+  std::vector<int> level_registration_level_idxs;
+  std::vector<std::string> level_registration_level_names;
+  void edit_register_levels();
+  void levels_registered();
+
+  /// Edit > Pair fiducials with the reference names the fiducials of each
+  /// level after those of the reference which they are found to be, in
+  /// one undo step; see FiducialPairing
+  void edit_pair_fiducials();
+
+  /// Edit > Extract walls from layer traces a layer image on the task pool
+  /// and adds what it found as walls, in one undo step
+  QFutureWatcher<std::vector<std::vector<QPointF>>>* wall_extract_watcher =
+    nullptr;
+  std::shared_ptr<TaskProgress> wall_extract_progress;
+  int wall_extract_level_idx = -1;
+  int wall_extract_layer_idx = -1;
+  std::string wall_extract_layer_name;
+  void edit_extract_walls();
+  void walls_extracted();
+
+  /// Edit > Import DXF reads the layers of a CAD drawing, asks what each
+  /// one is, and imports it on the task pool: the walls, doors, floors
+  /// etc. in one undo step, and the lines of the others as the vector
+  /// underlay of the level
+  QFutureWatcher<DxfImporter::Result>* dxf_import_watcher = nullptr;
+  std::shared_ptr<TaskProgress> dxf_import_progress;
+  std::string dxf_import_level_name;
+  VectorUnderlay dxf_import_underlay;  // without its lines
+  double dxf_import_width = 0.0;  // of the drawing, meters
+  double dxf_import_height = 0.0;
+  double dxf_import_tolerance = 0.0;  // meters
+  void edit_import_dxf();
+  void dxf_imported();
+  void edit_remove_vector_underlay();
+
+  /// Fill the selected ROI polygon of the active level with lanes
+  void edit_generate_lane_grid();
+
+  /// Ask which layer of the active level to use, if it has more than one.
+  /// Returns -1 if that was canceled.
+  int choose_layer(const QString& title, const QString& label);
+
+  /// The building file and the images of the active building, watched
+  /// for changes made by other programs unless editor/watch_files is off
+  FileWatcher* file_watcher = nullptr;
+  void watch_building_files();
+
+  /// Load the building again, keeping the levels which didn't change as
+  /// they are, with their images and drawn items, and the decoded images
+  /// of those which did where their files are the same
+  void building_changed_on_disk();
+
+  /// Decode the image again and redraw the level if it is shown
+  void image_changed_on_disk(
+    const QString& level_name,
+    const int image_layer_idx);
+
+  /// View > Capture frames, and the export of recording frames, render
+  /// into the buffers of this at a fixed size and leave the PNG encoding
+  /// to its thread. A live capture drops the frames it has no buffer for.
+  FrameEncoder frame_encoder;
+  QAction* view_capture_frames_action = nullptr;
+  QTimer* frame_capture_timer = nullptr;
+  void capture_frame();
+
+  /// Ask for the size of the frames to capture, remembered in the settings
+  bool ask_frame_size(const QString& title, QSize& size);
+
+  /// Render what the map view shows into the frame, scaled to fit it and
+  /// centered, whatever the size of the window
+  void render_frame(QImage& frame) const;
+
+  /// Stop and forget everything derived from the building, before it is
+  /// replaced by another one
+  void reset_building_state();
+
+  /// Filled in by create_scene() while the profiling overlay is shown
+  DrawProfile draw_profile;
+
+  /// How long the last building.draw() of create_scene() took
+  qint64 last_draw_nsec = 0;
+
+  /// What the runtime statistics window shows, as of now
+  RuntimeStatistics runtime_statistics();
+
+  /// Hand the worker threads, level of detail and budgets set in the
+  /// preferences to the pool, the view and the caches
+  void apply_performance_preferences();
+  QTimer* profiling_overlay_timer = nullptr;
+  void update_profiling_overlay();
 
   const QString tool_id_to_string(const int id);
   QButtonGroup* tool_button_group = nullptr;
@@ -213,6 +839,17 @@ private:
   TrafficTable* traffic_table = nullptr;
   CrowdSimEditorTable* crowd_sim_table = nullptr;
 
+  /// Stands in the crowd_sim tab until it's first shown, when
+  /// create_crowd_sim_table() builds the table
+  QWidget* crowd_sim_placeholder = nullptr;
+  void create_crowd_sim_table();
+
+  /// Warnings and errors of the building; see BuildingValidator
+  QListWidget* issue_list = nullptr;
+  BuildingValidator validator;
+  void update_issue_list();
+  void issue_list_clicked(const int row);
+
   QTableWidget* property_editor = nullptr;
   void update_property_editor();
   void clear_property_editor();
@@ -225,9 +862,21 @@ private:
   void populate_property_editor(const Polygon& polygon);
   void populate_property_editor(const Layer& layer);
 
+  /// Several entities with parameters are selected: show the parameters
+  /// they all have, so that an edit sets it on every one of them
+  void populate_property_editor(const std::vector<Level::SelectedItem>& items);
+  std::vector<Level::SelectedItem> property_editor_items;
+
   QTableWidgetItem* create_table_item(const QString& str,
     bool editable = false);
   void property_editor_cell_changed(int row, int column);
+
+  /// Edits typed into the property editor are made to the entities at
+  /// once, and marked for redrawing, but the scene is only brought up to
+  /// date by apply_level_changes() once they stop coming for a moment, so
+  /// that a run of edits to the same cells redraws them once
+  QTimer* property_redraw_timer = nullptr;
+  void schedule_property_redraw();
   void property_editor_set_row(
     const int row_idx,
     const QString& label,
@@ -273,11 +922,171 @@ private:
 #endif
 
   std::vector<EditorModel> editor_models;
+  EditorModelIndex editor_model_index;
   EditorModel* mouse_motion_editor_model = nullptr;
+  QString editor_models_thumbnail_path;  // which editor_models came from
   void load_model_names();
 
+  /// After the model list was reloaded, show the current pixmaps of the
+  /// models with these names, in place
+  void refresh_models(const std::set<std::string>& model_names);
+
+  /// Point every model of the building at its entry in editor_models
+  void resolve_editor_models();
+
+  /// Start decoding the thumbnails of the models of the building which
+  /// haven't been decoded yet
+  void prefetch_thumbnails();
+
+  ThumbnailLoader* thumbnail_loader = nullptr;
+
+  /// Swap a freshly loaded thumbnail in for the placeholders of the level
+  void thumbnail_loaded(const QString& model_name);
+
+  /// Draw the active level from scratch, after dropping the cached scenes
   bool create_scene();
 
+  /// Draw the active level into its scene, leaving the cached scenes of
+  /// the other levels alone
+  bool draw_scene();
+
+  /// Like create_scene(), but the level geometry (door motion, lane arrows,
+  /// polygons) is computed on a worker thread first, and the scene is
+  /// drawn in scene_geometry_ready(). Used when a whole level is shown
+  /// for the first time, which is where big levels spend the most time.
+  void create_scene_async();
+  void scene_geometry_ready();
+  void start_scene_geometry();
+
+  QFutureWatcher<SceneGeometry>* geometry_watcher = nullptr;
+
+  /// The building being read by load_building_async(), which replaces the
+  /// one being edited when it's done
+  QFutureWatcher<bool>* building_load_watcher = nullptr;
+  QProgressDialog* building_load_progress = nullptr;
+  std::shared_ptr<Building> loading_building;
+  QString loading_path;
+  bool loading_restores_viewport = false;
+  void building_loaded();
+
+  /// What load_building() does once the building has been read
+  void show_loaded_building(const QString& absolute_path);
+
+  /// While the building has unsaved changes, a snapshot of it is written
+  /// beside it (see autosave_filename()) every so often on a worker thread
+  QTimer* autosave_timer = nullptr;
+  QFutureWatcher<bool>* autosave_watcher = nullptr;
+  QString autosave_filename();
+  void autosave();
+  void autosave_finished();
+
+  /// With preferences_keys::change_deltas, every save also writes what it
+  /// changed since the previous one beside the building (see ChangeDelta),
+  /// and sends it to the local socket named in the preferences, if any.
+  /// The delta is computed from snapshots on a worker thread.
+  QFutureWatcher<QByteArray>* change_delta_watcher = nullptr;
+  std::unique_ptr<ChangeDelta::Server> change_delta_server;
+  void remember_saved_building();
+  void publish_change_delta();
+  void change_delta_written();
+
+  /// Sends each command to the other editors sharing the building, and
+  /// applies theirs, while Building > Share editing is on
+  std::unique_ptr<EditSync> edit_sync;
+  void start_edit_sync();
+
+  /// Each command, undo and redo is appended to the journal of the active
+  /// document as it is made (see EditJournal), and the journal left by an
+  /// editor that crashed is offered for recovery as the building is opened
+  EditJournal& edit_journal();
+  bool recover_edit_journal(EditJournal::Contents& contents);
+  void start_edit_journal(const EditJournal::Contents* recovered);
+
+  /// Levels whose images were decoded by show_level_images(), the most
+  /// recently shown last. With Building::lazy_images, the images of the
+  /// least recently shown are dropped when they exceed the memory budget.
+  std::vector<int> shown_levels;
+
+  /// Decode the images of this level if needed, before it is drawn
+  void show_level_images(const int idx);
+  void evict_level_images();
+
+  /// Warm the DecodedImageCache for this level on a worker thread, so that
+  /// showing it next doesn't have to decode its PNGs
+  void prefetch_level_images(const int idx);
+
+  /// Decodes, one at a time on a worker thread, the full-resolution
+  /// drawings of the levels which were loaded with a preview (see
+  /// Level::load_drawing()), the active level first
+  QFutureWatcher<QImage>* drawing_watcher = nullptr;
+  int drawing_watcher_level_idx = -1;
+  std::string drawing_watcher_filename;
+  std::set<std::string> drawing_decode_failures;  // don't retry these
+  void decode_next_drawing();
+  void drawing_decoded();
+
+  /// Optimizes the layer transforms of a level on a worker pool, one
+  /// layer per task, behind a progress dialog which can cancel it. The
+  /// results are applied together as one undoable command.
+  QFutureWatcher<Level::LayerSolution>* layer_solve_watcher = nullptr;
+  QProgressDialog* layer_solve_progress = nullptr;
+  std::shared_ptr<std::atomic<bool>> layer_solve_cancel;
+  int layer_solve_level_idx = -1;
+  void layer_transforms_optimized();
+
+  /// The same for the joint solve of the whole building, in one task which
+  /// Ceres spreads over the cores; the level names are kept to check that
+  /// the levels are still the ones it solved
+  QFutureWatcher<JointAlignment::Solution>* joint_solve_watcher = nullptr;
+  QProgressDialog* joint_solve_progress = nullptr;
+  std::shared_ptr<std::atomic<bool>> joint_solve_cancel;
+  std::vector<std::string> joint_solve_level_names;
+  QAction* edit_joint_alignment_action = nullptr;
+  void all_transforms_optimized();
+
+  /// Re-solve these layers of the active level right away, on the GUI
+  /// thread, after a constraint or a constrained feature has changed. The
+  /// caller wraps this and its edit in one undo macro.
+  void reoptimize_layers(const std::set<int>& layer_idxs);
+
+  /// Bumped by every redraw, so that a stale geometry result is dropped
+  int scene_generation = 0;
+  int geometry_generation = -1;
+  int geometry_level_idx = -1;
+
+  /// Pick the QGraphicsScene index method from the preferences, the
+  /// number of items and whether many items are being moved right now
+  void update_scene_index();
+
+  /// While set, items move on every mouse event. Keeping a BSP tree up to
+  /// date costs more than it saves then, so the automatic index is off.
+  void set_scene_bulk_update(const bool bulk_update);
+  bool scene_bulk_update = false;
+
+  /// Below this many items, searching all of them is as fast as the index
+  static const int AUTO_SCENE_INDEX_MIN_ITEMS = 2000;
+
+  /// Re-render only these items of the active level, falling back on a
+  /// full create_scene() if the level can't update them in place.
+  void update_scene(const std::vector<Level::SelectedItem>& items);
+
+  /// Recompute RenderingOptions::cull_rect from the view, with a margin.
+  /// Returns true if it changed.
+  bool update_cull_rect();
+
+  /// Stream in (and out) the entities around the view when it has moved
+  /// near the edge of what has been instantiated so far.
+  void map_view_changed();
+
+  /// Push the changes recorded by the levels to the scene: a full rebuild
+  /// if a level asked for one, otherwise only the touched items.
+  void apply_level_changes();
+
+  /// Re-render everything whose selection state may have changed, given
+  /// the selection before the change.
+  void update_scene_selection(
+    const std::vector<Level::SelectedItem>& previous_selection);
+
   const static int ROTATION_INDICATOR_RADIUS = 50;
   QGraphicsLineItem* mouse_motion_line = nullptr;
   QGraphicsEllipseItem* mouse_motion_ellipse = nullptr;
@@ -291,6 +1100,11 @@ private:
   int mouse_feature_layer_idx = -1;
   int mouse_fiducial_idx = -1;
   std::vector<int> mouse_motion_polygon_vertices;
+
+  /// Rubber band (or lasso, with Alt held) being dragged by the select
+  /// tool; drawn with mouse_motion_polygon
+  bool mouse_selecting_region = false;
+  QPolygonF mouse_selection_region;
   //int mouse_motion_polygon_vertex_idx = -1;
   Polygon::EdgeDragPolygon mouse_edge_drag_polygon;
 
@@ -324,10 +1138,18 @@ private:
     const QPointF& p,
     const Polygon::Type& polygon_type);
 
-  QGraphicsPixmapItem* get_closest_pixmap_item(const QPointF& p);
   double discretize_angle(const double& angle);
   void align_point(const QPointF& start, QPointF& end);
 
+  /// If snapping is enabled, move p onto a nearby vertex, edge midpoint or
+  /// edge and show a hint there. The excluded vertex (and its edges) are
+  /// not snapped to, e.g. when it's the one being dragged.
+  QPointF snap_point(const QPointF& p, const int exclude_vertex_idx = -1);
+  void remove_snap_hint();
+
+  const static int SNAP_DISTANCE_PIXELS = 8;  // on screen
+  QGraphicsEllipseItem* snap_hint = nullptr;
+
   void mouse_select(const MouseType t, QMouseEvent* e, const QPointF& p);
   void mouse_move(const MouseType t, QMouseEvent* e, const QPointF& p);
   void mouse_rotate(const MouseType t, QMouseEvent* e, const QPointF& p);
@@ -356,6 +1178,17 @@ private:
 
   QPointF previous_mouse_point;
 
+  /// Mice report moves far more often than the screen refreshes, and a
+  /// move can drag, snap and redraw, so mouseMoveEvent() only keeps the
+  /// latest one. It is handled at once if none was in the last frame, and
+  /// otherwise when mouse_move_timer gets to the start of the next one. A
+  /// press or release handles the move pending before it first.
+  std::unique_ptr<QMouseEvent> pending_mouse_move;
+  QTimer* mouse_move_timer = nullptr;
+  QElapsedTimer mouse_move_clock;  // since the last move was handled
+  void handle_pending_mouse_move();
+  static int frame_interval_ms();
+
   // For undo related support
   AddEdgeCommand* latest_add_edge = nullptr;
   MoveFeatureCommand* latest_move_feature = nullptr;
@@ -365,6 +1198,11 @@ private:
   MoveTagCommand* latest_move_tag = nullptr;
   RotateModelCommand* latest_rotate_model = nullptr;
 
+  /// Set while the move tool drags the whole selection along with the
+  /// selected entity that was grabbed, from mouse_group_anchor
+  TransformSelectionCommand* latest_transform_selection = nullptr;
+  QPointF mouse_group_anchor;
+
   void sanity_check();
 };
 
@@ -16,13 +16,17 @@
 */
 
 #include <algorithm>
+#include <memory>
 
+#include <QBuffer>
+#include <QColor>
 #include <QDir>
 #include <QImage>
 #include <QImageReader>
 #include <QSettings>
 
 #include "editor_model.h"
+#include "thumbnail_bundle.hpp"
 
 using std::string;
 
@@ -40,10 +44,6 @@ EditorModel::EditorModel(const string _name, const double _meters_per_pixel)
     [](unsigned char c) { return std::tolower(c); });
 }
 
-EditorModel::~EditorModel()
-{
-}
-
 QPixmap EditorModel::get_pixmap()
 {
   if (!pixmap.isNull())
@@ -51,26 +51,106 @@ QPixmap EditorModel::get_pixmap()
 
   // if we get here, we have to load the image from disk and generate pixmap
 
-  const QString THUMBNAIL_PATH_KEY("editor/thumbnail_path");
-  QSettings settings;
-  QString thumbnail_path(settings.value(THUMBNAIL_PATH_KEY).toString());
-
-  string filename =
-    thumbnail_path.toStdString() +
-    "/images/cropped/" +
-    name +
-    string(".png");
-  // qInfo("loading: [%s]", filename.c_str());
-  QImageReader image_reader(QString::fromStdString(filename));
-  image_reader.setAutoTransform(true);  // not sure what this does
-  QImage image = image_reader.read();
+  QString error_string;
+  const QImage image =
+    read_thumbnail(thumbnail_path(), name, QSize(), &error_string);
   if (image.isNull())
   {
     qWarning("unable to read %s: %s",
-      filename.c_str(),
-      qUtf8Printable(image_reader.errorString()));
+      qUtf8Printable(thumbnail_filename()),
+      qUtf8Printable(error_string));
     return QPixmap();
   }
   pixmap = QPixmap::fromImage(image);
   return pixmap;
 }
+
+QString EditorModel::thumbnail_filename() const
+{
+  return thumbnail_filename(thumbnail_path(), name);
+}
+
+QString EditorModel::thumbnail_path()
+{
+  const QString THUMBNAIL_PATH_KEY("editor/thumbnail_path");
+  QSettings settings;
+  return settings.value(THUMBNAIL_PATH_KEY).toString();
+}
+
+QString EditorModel::thumbnail_filename(
+  const QString& thumbnail_path,
+  const std::string& model_name)
+{
+  return thumbnail_path +
+    "/images/cropped/" +
+    QString::fromStdString(model_name) +
+    ".png";
+}
+
+QImage EditorModel::read_thumbnail(
+  const QString& thumbnail_path,
+  const std::string& model_name,
+  const QSize& max_size,
+  QString* error_string)
+{
+  // the bundle saves a file open per thumbnail; anything it lacks, such
+  // as a thumbnail added since it was packed, is read from its own file
+  QByteArray bytes;
+  const std::shared_ptr<const ThumbnailBundle> bundle =
+    ThumbnailBundle::find(thumbnail_path);
+  if (bundle)
+    bytes = bundle->data(model_name);
+  QBuffer buffer(&bytes);
+  QImageReader image_reader;
+  if (!bytes.isEmpty())
+  {
+    buffer.open(QIODevice::ReadOnly);
+    image_reader.setDevice(&buffer);
+  }
+  else
+    image_reader.setFileName(thumbnail_filename(thumbnail_path, model_name));
+
+  image_reader.setAutoTransform(true);
+  const QSize size = image_reader.size();
+  if (max_size.isValid() && size.isValid())
+    image_reader.setScaledSize(size.scaled(max_size, Qt::KeepAspectRatio));
+  const QImage image = image_reader.read();
+  if (image.isNull() && error_string)
+    *error_string = image_reader.errorString();
+  return image;
+}
+
+QPixmap EditorModel::get_selected_pixmap()
+{
+  const QPixmap plain = get_pixmap();
+  if (plain.isNull())
+    return plain;
+  if (selected_pixmap.isNull() || selected_pixmap_key != plain.cacheKey())
+  {
+    selected_pixmap = tinted(plain);
+    selected_pixmap_key = plain.cacheKey();
+  }
+  return selected_pixmap;
+}
+
+QPixmap EditorModel::tinted(const QPixmap& pixmap)
+{
+  // like a QGraphicsColorizeEffect at full strength: the luminance,
+  // screened with the highlight color
+  const QColor color = QColor::fromRgbF(1.0, 0.2, 0.0, 1.0);
+  QImage image = pixmap.toImage().convertToFormat(QImage::Format_ARGB32);
+  for (int y = 0; y < image.height(); y++)
+  {
+    QRgb* row = reinterpret_cast<QRgb*>(image.scanLine(y));
+    for (int x = 0; x < image.width(); x++)
+    {
+      const int gray = qGray(row[x]);
+      row[x] = qRgba(
+        255 - (255 - gray) * (255 - color.red()) / 255,
+        255 - (255 - gray) * (255 - color.green()) / 255,
+        255 - (255 - gray) * (255 - color.blue()) / 255,
+        qAlpha(row[x]));
+    }
+  }
+  return QPixmap::fromImage(image);
+}
@@ -23,19 +23,55 @@
  */
 
 #include <string>
+#include <QImage>
 #include <QPixmap>
+#include <QSize>
+#include <QString>
 
 class EditorModel
 {
 public:
   EditorModel(const std::string _name, const double _meters_per_pixel);
-  ~EditorModel();
 
   std::string name, name_lowercase;
   QPixmap pixmap;
   double meters_per_pixel;
 
+  /// Set while a ThumbnailLoader is decoding the pixmap in the background
+  bool thumbnail_pending = false;
+
   QPixmap get_pixmap();  // will load if needed
+  QString thumbnail_filename() const;
+
+  /// The thumbnail directory of the preferences
+  static QString thumbnail_path();
+
+  static QString thumbnail_filename(
+    const QString& thumbnail_path,
+    const std::string& model_name);
+
+  /// Decode the thumbnail of a model out of the ThumbnailBundle of the
+  /// thumbnail directory if it has one for the model, otherwise from its
+  /// file in images/cropped/. If max_size is valid the image is decoded
+  /// scaled down to fit in it. A null image if it can't be read, and then
+  /// error_string (if given) says why. This may be called from any thread.
+  static QImage read_thumbnail(
+    const QString& thumbnail_path,
+    const std::string& model_name,
+    const QSize& max_size = QSize(),
+    QString* error_string = nullptr);
+
+  /// The pixmap tinted the way selected models are shown. It is made once
+  /// and kept until the pixmap changes, so that selecting a model only
+  /// swaps the pixmap of its item.
+  QPixmap get_selected_pixmap();
+
+  /// Orange-tinted grayscale copy of a pixmap, keeping its alpha
+  static QPixmap tinted(const QPixmap& pixmap);
+
+private:
+  QPixmap selected_pixmap;
+  qint64 selected_pixmap_key = 0;  // cacheKey() of the pixmap it is from
 };
 
 #endif
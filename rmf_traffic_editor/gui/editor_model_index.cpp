@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cctype>
+
+#include "editor_model_index.hpp"
+
+
+void EditorModelIndex::build(const std::vector<EditorModel>& editor_models)
+{
+  clear();
+  _by_name.reserve(editor_models.size());
+  _by_lowercase_ending_token.reserve(editor_models.size());
+  for (std::size_t i = 0; i < editor_models.size(); i++)
+  {
+    // emplace() keeps the first entry, like the linear searches did
+    const std::string& name = editor_models[i].name;
+    _by_name.emplace(name, static_cast<int>(i));
+    _by_lowercase_ending_token.emplace(
+      lowercase(ending_token(name)),
+      static_cast<int>(i));
+  }
+
+  std::vector<std::string> tokens(editor_models.size());
+  for (std::size_t i = 0; i < editor_models.size(); i++)
+    tokens[i] = lowercase(ending_token(editor_models[i].name));
+  _sorted.resize(editor_models.size());
+  for (std::size_t i = 0; i < _sorted.size(); i++)
+    _sorted[i] = static_cast<int>(i);
+  std::stable_sort(
+    _sorted.begin(),
+    _sorted.end(),
+    [&tokens](const int a, const int b) { return tokens[a] < tokens[b]; });
+
+  _sorted_tokens.resize(_sorted.size());
+  for (std::size_t position = 0; position < _sorted.size(); position++)
+  {
+    _sorted_tokens[position] = std::move(tokens[_sorted[position]]);
+    const std::string& token = _sorted_tokens[position];
+    for (std::size_t i = 0; i + 3 <= token.size(); i++)
+    {
+      std::vector<int>& positions = _trigrams[trigram(token, i)];
+      if (positions.empty() || positions.back() != static_cast<int>(position))
+        positions.push_back(static_cast<int>(position));
+    }
+  }
+}
+
+void EditorModelIndex::clear()
+{
+  _by_name.clear();
+  _by_lowercase_ending_token.clear();
+  _sorted.clear();
+  _sorted_tokens.clear();
+  _trigrams.clear();
+}
+
+int EditorModelIndex::find(const std::string& name) const
+{
+  const auto it = _by_name.find(name);
+  return it == _by_name.end() ? -1 : it->second;
+}
+
+int EditorModelIndex::find_ending_token(const std::string& name) const
+{
+  const auto it = _by_lowercase_ending_token.find(lowercase(name));
+  return it == _by_lowercase_ending_token.end() ? -1 : it->second;
+}
+
+std::string EditorModelIndex::ending_token(const std::string& name)
+{
+  const std::size_t delimiter_index = name.find("/");
+  if (delimiter_index == std::string::npos)
+    return name;
+  return name.substr(delimiter_index + 1);
+}
+
+std::string EditorModelIndex::lowercase(std::string s)
+{
+  std::transform(
+    s.begin(),
+    s.end(),
+    s.begin(),
+    [](unsigned char c) { return std::tolower(c); });
+  return s;
+}
+
+uint32_t EditorModelIndex::trigram(const std::string& s, const std::size_t i)
+{
+  return static_cast<uint32_t>(static_cast<unsigned char>(s[i])) << 16 |
+    static_cast<uint32_t>(static_cast<unsigned char>(s[i + 1])) << 8 |
+    static_cast<uint32_t>(static_cast<unsigned char>(s[i + 2]));
+}
+
+void EditorModelIndex::prefix_range(
+  const std::string& prefix,
+  std::size_t& begin,
+  std::size_t& end) const
+{
+  const std::string key = lowercase(prefix);
+  const auto first = std::lower_bound(
+    _sorted_tokens.begin(),
+    _sorted_tokens.end(),
+    key);
+  auto last = first;
+  while (last != _sorted_tokens.end() && last->compare(0, key.size(), key) == 0)
+    ++last;
+  begin = first - _sorted_tokens.begin();
+  end = last - _sorted_tokens.begin();
+}
+
+void EditorModelIndex::containing(
+  const std::string& text,
+  std::vector<int>& positions) const
+{
+  const std::string key = lowercase(text);
+  if (key.empty())
+    return;
+  auto accept = [&](const int position)
+    {
+      const std::string& token = _sorted_tokens[position];
+      const std::size_t found = token.find(key);
+      if (found != std::string::npos && found != 0)
+        positions.push_back(position);
+    };
+
+  if (key.size() < 3)
+  {
+    // too short to have a trigram; these are quick to scan anyway
+    for (std::size_t position = 0; position < _sorted_tokens.size(); position++)
+      accept(static_cast<int>(position));
+    return;
+  }
+
+  // only the tokens with the rarest trigram of the text can contain it
+  const std::vector<int>* rarest = nullptr;
+  for (std::size_t i = 0; i + 3 <= key.size(); i++)
+  {
+    const auto it = _trigrams.find(trigram(key, i));
+    if (it == _trigrams.end())
+      return;
+    if (rarest == nullptr || it->second.size() < rarest->size())
+      rarest = &it->second;
+  }
+  for (const int position : *rarest)
+    accept(position);
+}
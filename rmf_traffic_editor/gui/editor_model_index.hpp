@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__EDITOR_MODEL_INDEX_HPP
+#define TRAFFIC_EDITOR__EDITOR_MODEL_INDEX_HPP
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "editor_model.h"
+
+//=============================================================================
+/// Hash lookups into the model catalog, which can have thousands of
+/// entries. Results are indices into the EditorModel vector it was built
+/// from, which stay valid until that vector is reloaded.
+///
+/// For searching as the user types, the models are also kept sorted by
+/// their lowercase ending token, so that the ones starting with some text
+/// are a range found by binary search, along with an index of the
+/// trigrams of the tokens for finding the ones which contain it.
+class EditorModelIndex
+{
+public:
+  void build(const std::vector<EditorModel>& editor_models);
+  void clear();
+
+  /// Index of the model with exactly this name, or -1
+  int find(const std::string& name) const;
+
+  /// Index of the first model whose name, without its namespace, matches
+  /// this name case-insensitively, or -1. This is how (old) maps that refer
+  /// to models without their namespace are resolved.
+  int find_ending_token(const std::string& name) const;
+
+  static std::string ending_token(const std::string& name);
+
+  /// Model indices, in order of their lowercase ending tokens
+  const std::vector<int>& sorted() const { return _sorted; }
+
+  /// The range [begin, end) of positions in sorted() of the models whose
+  /// ending token starts with this text, case-insensitively
+  void prefix_range(
+    const std::string& prefix,
+    std::size_t& begin,
+    std::size_t& end) const;
+
+  /// Append the positions in sorted(), ascending, of the models whose
+  /// ending token contains this text (case-insensitively) but doesn't
+  /// start with it
+  void containing(const std::string& text, std::vector<int>& positions) const;
+
+private:
+  std::unordered_map<std::string, int> _by_name;
+  std::unordered_map<std::string, int> _by_lowercase_ending_token;
+
+  std::vector<int> _sorted;
+  std::vector<std::string> _sorted_tokens;  // lowercase, like the keys
+
+  /// Positions in sorted() of the tokens with each trigram, ascending
+  std::unordered_map<uint32_t, std::vector<int>> _trigrams;
+
+  static uint32_t trigram(const std::string& s, const std::size_t i);
+
+  static std::string lowercase(std::string s);
+};
+
+#endif
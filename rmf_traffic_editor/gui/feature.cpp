@@ -68,44 +68,53 @@ void Feature::draw(
   const QColor color,
   const Transform& layer_transform,
   const double meters_per_pixel) const
+{
+  QPointF p = layer_transform.forwards(QPointF(_x, _y));  // to meters
+  p /= meters_per_pixel;  // now to parent level's pixels
+
+  draw_marker(
+    scene,
+    color,
+    p,
+    radius_meters / meters_per_pixel,
+    0.025 / meters_per_pixel);
+}
+
+QList<QGraphicsItem*> Feature::draw_marker(
+  QGraphicsScene* scene,
+  const QColor color,
+  const QPointF& p,
+  const double radius,
+  const double pen_width) const
 {
   const QColor selected_color = QColor::fromRgbF(1.0, 0.0, 0.0, 0.5);
 
-  const double pen_width = 0.025 / meters_per_pixel;
   QPen pen(
     QBrush(_selected ? selected_color : color),
     pen_width,
     Qt::SolidLine,
     Qt::FlatCap);
 
-  QPointF p = layer_transform.forwards(QPointF(_x, _y));  // to meters
-  p /= meters_per_pixel;  // now to parent level's pixels
-
-  const double radius = radius_meters / meters_per_pixel;
-
+  QList<QGraphicsItem*> items;
   QGraphicsEllipseItem* circle = scene->addEllipse(
-    p.x() - radius,
-    p.y() - radius,
+    -radius,
+    -radius,
     2 * radius,
     2 * radius,
     pen,
     QBrush(QColor::fromRgbF(1, 1, 1, 0.5)));
-  circle->setZValue(200.0);
+  items.append(circle);
 
   const double line_radius = (radius - pen_width / 2.0) / sqrt(2.0);
-  QGraphicsLineItem* line_1 = scene->addLine(
-    p.x() - line_radius,
-    p.y() - line_radius,
-    p.x() + line_radius,
-    p.y() + line_radius,
-    pen);
-  line_1->setZValue(200.0);
-
-  QGraphicsLineItem* line_2 = scene->addLine(
-    p.x() - line_radius,
-    p.y() + line_radius,
-    p.x() + line_radius,
-    p.y() - line_radius,
-    pen);
-  line_2->setZValue(200.0);
+  items.append(
+    scene->addLine(-line_radius, -line_radius, line_radius, line_radius, pen));
+  items.append(
+    scene->addLine(-line_radius, line_radius, line_radius, -line_radius, pen));
+
+  for (QGraphicsItem* item : items)
+  {
+    item->setPos(p);
+    item->setZValue(200.0);
+  }
+  return items;
 }
@@ -20,12 +20,15 @@
 
 #include <string>
 
+#include <QList>
 #include <QPointF>
 #include <QUuid>
 #include <yaml-cpp/yaml.h>
 
 #include "transform.hpp"
 
+class QColor;
+class QGraphicsItem;
 class QGraphicsScene;
 
 //=============================================================================
@@ -68,6 +71,17 @@ public:
     const Transform& layer_transform,
     const double render_scale) const;
 
+  /// The marker of this feature at a point, in whatever coordinates the
+  /// items end up in (the scene's, or those of a layer's item group). Each
+  /// item is positioned at the point and drawn around its own origin, so
+  /// that scaling an item leaves it where it is.
+  QList<QGraphicsItem*> draw_marker(
+    QGraphicsScene* scene,
+    const QColor color,
+    const QPointF& p,
+    const double radius,
+    const double pen_width) const;
+
   static constexpr double radius_meters = 0.1;
 
 private:
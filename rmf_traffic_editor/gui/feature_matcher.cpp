@@ -0,0 +1,328 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#ifdef HAS_OPENCV
+#include <opencv2/calib3d.hpp>
+#include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
+#include <opencv2/imgproc.hpp>
+#endif
+
+#include "feature_matcher.hpp"
+#include "task_pool.hpp"
+
+#ifdef HAS_OPENCV
+
+namespace {
+
+struct Keypoints
+{
+  std::vector<cv::Point2f> points;
+  cv::Mat descriptors;  // one row per point
+};
+
+cv::Mat wrap(const QImage& image)
+{
+  return cv::Mat(
+    image.height(),
+    image.width(),
+    CV_8UC1,
+    const_cast<uchar*>(image.constBits()),
+    image.bytesPerLine());
+}
+
+/// ORB keypoints of every tile of the image, in image pixels. A tile is
+/// searched with a margin of its neighbours around it, since ORB skips
+/// keypoints near the edge of what it is given, but only the keypoints in
+/// the tile itself are kept, so that none is found twice.
+Keypoints detect(
+  const cv::Mat& image,
+  const FeatureMatcher::Options& options,
+  TaskProgress* progress)
+{
+  const int tile_size = std::max(64, options.tile_size);
+  const int num_x = (image.cols + tile_size - 1) / tile_size;
+  const int num_y = (image.rows + tile_size - 1) / tile_size;
+  std::vector<Keypoints> tiles(num_x * num_y);
+
+  TaskPool::instance().parallel_for(
+    static_cast<int>(tiles.size()),
+    [&](const int i)
+    {
+      const cv::Rect core(
+        (i % num_x) * tile_size,
+        (i / num_x) * tile_size,
+        tile_size,
+        tile_size);
+      const int overlap = options.tile_overlap;
+      const cv::Rect search = cv::Rect(
+        core.x - overlap,
+        core.y - overlap,
+        core.width + 2 * overlap,
+        core.height + 2 * overlap) & cv::Rect(0, 0, image.cols, image.rows);
+
+      cv::Ptr<cv::ORB> orb = cv::ORB::create(options.keypoints_per_tile);
+      std::vector<cv::KeyPoint> keypoints;
+      cv::Mat descriptors;
+      orb->detectAndCompute(
+        image(search),
+        cv::noArray(),
+        keypoints,
+        descriptors);
+
+      Keypoints& tile = tiles[i];
+      for (std::size_t k = 0; k < keypoints.size(); k++)
+      {
+        const cv::Point2f p = keypoints[k].pt +
+          cv::Point2f(static_cast<float>(search.x),
+            static_cast<float>(search.y));
+        const cv::Point pixel(static_cast<int>(p.x), static_cast<int>(p.y));
+        if (!core.contains(pixel))
+          continue;
+        tile.points.push_back(p);
+        tile.descriptors.push_back(descriptors.row(static_cast<int>(k)));
+      }
+    },
+    TaskPool::INHERIT,
+    progress);
+
+  Keypoints all;
+  for (const Keypoints& tile : tiles)
+  {
+    all.points.insert(all.points.end(), tile.points.begin(), tile.points.end());
+    if (!tile.descriptors.empty())
+      all.descriptors.push_back(tile.descriptors);
+  }
+  return all;
+}
+
+}  // namespace
+
+bool FeatureMatcher::available()
+{
+  return true;
+}
+
+FeatureMatcher::Result FeatureMatcher::match(
+  const QImage& floorplan,
+  const QImage& layer,
+  const double initial_scale,
+  const Options& options,
+  TaskProgress* progress)
+{
+  Result result;
+  if (floorplan.isNull() || layer.isNull())
+  {
+    result.summary = "an image is not loaded";
+    return result;
+  }
+
+  // ORB copes with up to a few times of scale difference; bring the layer
+  // close to the floorplan's scale first
+  double scale = initial_scale;
+  if (!std::isfinite(scale) || scale <= 0.0)
+    scale = 1.0;
+  scale = std::min(16.0, std::max(1.0 / 16.0, scale));
+
+  const cv::Mat floorplan_mat = wrap(floorplan);
+  cv::Mat layer_mat = wrap(layer);
+  if (std::abs(scale - 1.0) > 0.05)
+  {
+    cv::Mat scaled;
+    cv::resize(
+      layer_mat,
+      scaled,
+      cv::Size(),
+      scale,
+      scale,
+      scale < 1.0 ? cv::INTER_AREA : cv::INTER_LINEAR);
+    layer_mat = scaled;
+  }
+
+  const int tile_size = std::max(64, options.tile_size);
+  auto num_tiles = [tile_size](const cv::Mat& m)
+    {
+      return ((m.cols + tile_size - 1) / tile_size) *
+        ((m.rows + tile_size - 1) / tile_size);
+    };
+  if (progress)
+    progress->set_total(num_tiles(floorplan_mat) + num_tiles(layer_mat));
+
+  const Keypoints floorplan_keypoints =
+    detect(floorplan_mat, options, progress);
+  const Keypoints layer_keypoints = detect(layer_mat, options, progress);
+  if (progress && progress->canceled())
+  {
+    result.summary = "canceled";
+    return result;
+  }
+  result.floorplan_keypoints =
+    static_cast<int>(floorplan_keypoints.points.size());
+  result.layer_keypoints = static_cast<int>(layer_keypoints.points.size());
+  if (result.floorplan_keypoints < 3 || result.layer_keypoints < 3)
+  {
+    result.summary = "not enough keypoints in the images";
+    return result;
+  }
+
+  // two nearest floorplan descriptors of each layer descriptor, in
+  // chunks of layer keypoints on the pool
+  const int chunk_size = 256;
+  const int num_layer = result.layer_keypoints;
+  const int num_chunks = (num_layer + chunk_size - 1) / chunk_size;
+  std::vector<std::vector<cv::DMatch>> chunk_matches(num_chunks);
+  TaskPool::instance().parallel_for(
+    num_chunks,
+    [&](const int c)
+    {
+      const int begin = c * chunk_size;
+      const int end = std::min(num_layer, begin + chunk_size);
+      cv::BFMatcher matcher(cv::NORM_HAMMING);
+      std::vector<std::vector<cv::DMatch>> knn;
+      matcher.knnMatch(
+        layer_keypoints.descriptors.rowRange(begin, end),
+        floorplan_keypoints.descriptors,
+        knn,
+        2);
+      for (const std::vector<cv::DMatch>& m : knn)
+      {
+        if (m.size() < 2 || m[0].distance >= options.ratio * m[1].distance)
+          continue;
+        cv::DMatch kept = m[0];
+        kept.queryIdx += begin;
+        chunk_matches[c].push_back(kept);
+      }
+    });
+
+  std::vector<cv::Point2f> from, to;
+  for (const std::vector<cv::DMatch>& matches : chunk_matches)
+  {
+    for (const cv::DMatch& m : matches)
+    {
+      from.push_back(layer_keypoints.points[m.queryIdx] * (1.0 / scale));
+      to.push_back(floorplan_keypoints.points[m.trainIdx]);
+    }
+  }
+  result.matches = static_cast<int>(from.size());
+  if (result.matches < 3)
+  {
+    result.summary = "not enough matches between the images";
+    return result;
+  }
+
+  std::vector<uchar> inlier_mask;
+  const cv::Mat m = cv::estimateAffinePartial2D(
+    from,
+    to,
+    inlier_mask,
+    cv::RANSAC,
+    options.inlier_threshold,
+    5000,
+    0.995);
+  if (m.empty())
+  {
+    result.summary = "no consistent transform between the matches";
+    return result;
+  }
+
+  const double a = m.at<double>(0, 0);
+  const double b = m.at<double>(1, 0);
+  result.scale = std::sqrt(a * a + b * b);
+  result.rotation = std::atan2(b, a);
+
+  std::vector<Pair> inliers;
+  for (std::size_t i = 0; i < from.size(); i++)
+  {
+    if (!inlier_mask[i])
+      continue;
+    const double x = a * from[i].x - b * from[i].y + m.at<double>(0, 2);
+    const double y = b * from[i].x + a * from[i].y + m.at<double>(1, 2);
+    Pair pair;
+    pair.layer = QPointF(from[i].x, from[i].y);
+    pair.floorplan = QPointF(to[i].x, to[i].y);
+    pair.residual = std::hypot(x - to[i].x, y - to[i].y);
+    inliers.push_back(pair);
+  }
+  result.inliers = static_cast<int>(inliers.size());
+  if (result.inliers < 3)
+  {
+    result.summary = "too few matches agree on a transform";
+    return result;
+  }
+
+  // farthest point sampling, starting from the best fit, so that the
+  // proposed constraints span the image rather than bunch up in a corner
+  std::vector<double> min_distance(
+    inliers.size(),
+    std::numeric_limits<double>::max());
+  std::size_t next = 0;
+  for (std::size_t i = 1; i < inliers.size(); i++)
+  {
+    if (inliers[i].residual < inliers[next].residual)
+      next = i;
+  }
+  const int max_pairs = std::min(options.max_pairs, result.inliers);
+  while (static_cast<int>(result.pairs.size()) < max_pairs)
+  {
+    result.pairs.push_back(inliers[next]);
+    const QPointF chosen = inliers[next].floorplan;
+    std::size_t farthest = 0;
+    for (std::size_t i = 0; i < inliers.size(); i++)
+    {
+      const QPointF d = inliers[i].floorplan - chosen;
+      min_distance[i] = std::min(min_distance[i], std::hypot(d.x(), d.y()));
+      if (min_distance[i] > min_distance[farthest])
+        farthest = i;
+    }
+    if (min_distance[farthest] <= 0.0)
+      break;  // the rest are on top of the ones chosen
+    next = farthest;
+  }
+
+  result.found = true;
+  result.summary =
+    std::to_string(result.floorplan_keypoints) + " and " +
+    std::to_string(result.layer_keypoints) + " keypoints, " +
+    std::to_string(result.matches) + " matches, " +
+    std::to_string(result.inliers) + " consistent";
+  return result;
+}
+
+#else
+
+bool FeatureMatcher::available()
+{
+  return false;
+}
+
+FeatureMatcher::Result FeatureMatcher::match(
+  const QImage&,
+  const QImage&,
+  const double,
+  const Options&,
+  TaskProgress*)
+{
+  Result result;
+  result.summary = "traffic-editor was built without OpenCV";
+  return result;
+}
+
+#endif
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__FEATURE_MATCHER_HPP
+#define TRAFFIC_EDITOR__FEATURE_MATCHER_HPP
+
+#include <string>
+#include <vector>
+
+#include <QImage>
+#include <QPointF>
+
+class TaskProgress;
+
+//=============================================================================
+/// Finds points which are the same place in the floorplan and in a layer
+/// image (say, a lidar map), to propose as Feature pairs joined by
+/// Constraints, so that a layer can be aligned without placing them by
+/// hand. Keypoints are detected and described (ORB) tile by tile on the
+/// task pool, matched by their descriptors and filtered through a RANSAC
+/// fit of a similarity transform, which is what a layer transform is.
+/// The inliers are thinned out to a few well spread pairs.
+///
+/// Needs OpenCV: without HAS_OPENCV, match() finds nothing and says so.
+class FeatureMatcher
+{
+public:
+  struct Options
+  {
+    /// Images are cut into tiles of this size, which overlap by
+    /// tile_overlap pixels, and each tile is searched on its own
+    int tile_size = 1024;
+    int tile_overlap = 32;
+    int keypoints_per_tile = 500;
+
+    /// A match is kept if its descriptor distance is below this fraction
+    /// of that of the second best (Lowe's ratio test)
+    double ratio = 0.8;
+
+    /// RANSAC inlier threshold, in floorplan pixels
+    double inlier_threshold = 4.0;
+
+    /// At most this many pairs are proposed
+    int max_pairs = 12;
+  };
+
+  struct Pair
+  {
+    QPointF floorplan;  // floorplan pixels
+    QPointF layer;  // layer image pixels
+    double residual = 0.0;  // floorplan pixels, from the fitted transform
+  };
+
+  struct Result
+  {
+    bool found = false;
+    int floorplan_keypoints = 0;
+    int layer_keypoints = 0;
+    int matches = 0;
+    int inliers = 0;
+
+    /// The fitted layer-to-floorplan similarity: floorplan pixels per
+    /// layer pixel, and rotation in radians
+    double scale = 1.0;
+    double rotation = 0.0;
+
+    std::vector<Pair> pairs;
+    std::string summary;
+  };
+
+  static bool available();
+
+  /// The images are Format_Grayscale8. initial_scale is a guess of the
+  /// floorplan pixels per layer pixel, from the layer's current transform;
+  /// the layer is resampled by it before detection, since ORB only covers
+  /// a limited range of scales. Thread-safe; stops early, with nothing
+  /// found, if progress is canceled.
+  static Result match(
+    const QImage& floorplan,
+    const QImage& layer,
+    const double initial_scale,
+    const Options& options,
+    TaskProgress* progress = nullptr);
+};
+
+#endif
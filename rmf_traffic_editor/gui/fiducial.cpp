@@ -21,6 +21,7 @@
 #include <QGraphicsSimpleTextItem>
 
 #include "fiducial.h"
+#include "scene_item_pool.hpp"
 using std::string;
 
 Fiducial::Fiducial()
@@ -54,10 +55,12 @@ YAML::Node Fiducial::to_yaml() const
   return node;
 }
 
-void Fiducial::draw(
+QList<QGraphicsItem*> Fiducial::draw(
   QGraphicsScene* scene,
   const double meters_per_pixel) const
 {
+  QList<QGraphicsItem*> items;
+
   const double a = 0.5;
   const QColor color = QColor::fromRgbF(0.0, 0.0, 1.0, a);
   const QColor selected_color = QColor::fromRgbF(1.0, 0.0, 0.0, a);
@@ -66,25 +69,32 @@ void Fiducial::draw(
   pen.setWidth(0.2 / meters_per_pixel);
   const double radius = 0.5 / meters_per_pixel;
 
-  scene->addEllipse(
-    x - radius,
-    y - radius,
-    2 * radius,
-    2 * radius,
-    pen);
-  scene->addLine(x, y - 2 * radius, x, y + 2 * radius, pen);
-  scene->addLine(x - 2 * radius, y, x + 2 * radius, y, pen);
+  SceneItemPool& pool = SceneItemPool::instance();
+  items.append(
+    pool.ellipse(
+      scene,
+      QRectF(x - radius, y - radius, 2 * radius, 2 * radius),
+      pen));
+  items.append(
+    pool.line(scene, QLineF(x, y - 2 * radius, x, y + 2 * radius), pen));
+  items.append(
+    pool.line(scene, QLineF(x - 2 * radius, y, x + 2 * radius, y), pen));
 
   if (!name.empty())
   {
-    QGraphicsSimpleTextItem* item = scene->addSimpleText(
-      QString::fromStdString(name));
+    QGraphicsSimpleTextItem* item = pool.simple_text(
+      scene,
+      QString::fromStdString(name),
+      QFont());
     item->setBrush(QColor(0, 0, 255, 255));
     item->setPos(x, y + radius);
+    items.append(item);
   }
+
+  return items;
 }
 
-double Fiducial::distance(const Fiducial& f)
+double Fiducial::distance(const Fiducial& f) const
 {
   const double dx = f.x - x;
   const double dy = f.y - y;
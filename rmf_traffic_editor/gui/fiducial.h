@@ -23,7 +23,9 @@
 #include <vector>
 #include <yaml-cpp/yaml.h>
 #include <quuid.h>
+#include <QList>
 
+class QGraphicsItem;
 class QGraphicsScene;
 
 
@@ -43,9 +45,11 @@ public:
   void from_yaml(const YAML::Node& data);
   YAML::Node to_yaml() const;
 
-  void draw(QGraphicsScene*, const double meters_per_pixel) const;
+  QList<QGraphicsItem*> draw(
+    QGraphicsScene*,
+    const double meters_per_pixel) const;
 
-  double distance(const Fiducial& f);
+  double distance(const Fiducial& f) const;
 };
 
 #endif
@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include <cmath>
+
+#include "fiducial_alignment.hpp"
+
+
+QPointF FiducialAlignment::Fit::apply(const QPointF& p) const
+{
+  const double c = std::cos(yaw);
+  const double s = std::sin(yaw);
+  return QPointF(
+    scale * (c * p.x() - s * p.y()) + dx,
+    scale * (s * p.x() + c * p.y()) + dy);
+}
+
+FiducialAlignment::Fit FiducialAlignment::fit(
+  const std::vector<QPointF>& from,
+  const std::vector<QPointF>& to,
+  const bool with_yaw)
+{
+  Fit result = fit_subset(
+    from,
+    to,
+    std::vector<bool>(from.size(), true),
+    with_yaw);
+  compute_residuals(from, to, result);
+  return result;
+}
+
+FiducialAlignment::Fit FiducialAlignment::fit_subset(
+  const std::vector<QPointF>& from,
+  const std::vector<QPointF>& to,
+  const std::vector<bool>& use,
+  const bool with_yaw)
+{
+  Fit result;
+  result.inliers = use;
+
+  QPointF from_mean, to_mean;
+  int n = 0;
+  for (std::size_t i = 0; i < from.size(); i++)
+  {
+    if (!use[i])
+      continue;
+    from_mean += from[i];
+    to_mean += to[i];
+    n++;
+  }
+  result.num_inliers = n;
+  if (n < 2)
+    return result;
+  from_mean /= n;
+  to_mean /= n;
+
+  // Umeyama: with a and b the centered points, the rotation comes from
+  // the sums of their dot and cross products, and the scale is the
+  // projection of b onto the rotated a. Without yaw the scale is still
+  // that of the rotated fit: projecting onto the unrotated a would give
+  // scale * cos(yaw) of a level drawn turned.
+  double dot = 0.0;
+  double cross = 0.0;
+  double from_var = 0.0;
+  for (std::size_t i = 0; i < from.size(); i++)
+  {
+    if (!use[i])
+      continue;
+    const QPointF a = from[i] - from_mean;
+    const QPointF b = to[i] - to_mean;
+    dot += a.x() * b.x() + a.y() * b.y();
+    cross += a.x() * b.y() - a.y() * b.x();
+    from_var += a.x() * a.x() + a.y() * a.y();
+  }
+  if (from_var <= 0.0)
+    return result;  // all the points are on top of each other
+
+  if (with_yaw)
+    result.yaw = std::atan2(cross, dot);
+  result.scale = std::sqrt(dot * dot + cross * cross) / from_var;
+
+  if (result.scale <= 0.0)
+    return result;  // it's hopeless
+
+  const double c = std::cos(result.yaw);
+  const double s = std::sin(result.yaw);
+  result.dx =
+    to_mean.x() - result.scale * (c * from_mean.x() - s * from_mean.y());
+  result.dy =
+    to_mean.y() - result.scale * (s * from_mean.x() + c * from_mean.y());
+  result.valid = true;
+  return result;
+}
+
+void FiducialAlignment::compute_residuals(
+  const std::vector<QPointF>& from,
+  const std::vector<QPointF>& to,
+  Fit& fit)
+{
+  fit.residuals.resize(from.size());
+  for (std::size_t i = 0; i < from.size(); i++)
+  {
+    const QPointF d = fit.apply(from[i]) - to[i];
+    fit.residuals[i] = std::sqrt(d.x() * d.x() + d.y() * d.y());
+  }
+}
+
+FiducialAlignment::Fit FiducialAlignment::fit_robust(
+  const std::vector<QPointF>& from,
+  const std::vector<QPointF>& to,
+  const bool with_yaw,
+  const double inlier_threshold)
+{
+  // with two pairs there is nothing to vote with
+  if (from.size() < 3)
+    return fit(from, to, with_yaw);
+
+  std::vector<bool> best_inliers;
+  int best_count = 0;
+  double best_error = 0.0;
+  std::vector<bool> sample(from.size(), false);
+  for (std::size_t i = 0; i < from.size(); i++)
+  {
+    for (std::size_t j = i + 1; j < from.size(); j++)
+    {
+      sample[i] = sample[j] = true;
+      Fit hypothesis = fit_subset(from, to, sample, with_yaw);
+      sample[i] = sample[j] = false;
+      if (!hypothesis.valid)
+        continue;
+
+      compute_residuals(from, to, hypothesis);
+      std::vector<bool> inliers(from.size(), false);
+      int count = 0;
+      double error = 0.0;
+      for (std::size_t k = 0; k < from.size(); k++)
+      {
+        if (hypothesis.residuals[k] < inlier_threshold)
+        {
+          inliers[k] = true;
+          count++;
+          error += hypothesis.residuals[k];
+        }
+      }
+      if (count > best_count || (count == best_count && error < best_error))
+      {
+        best_inliers = inliers;
+        best_count = count;
+        best_error = error;
+      }
+    }
+  }
+
+  // nothing agrees with anything else, so there is nothing to reject
+  if (best_count < 2)
+    return fit(from, to, with_yaw);
+
+  Fit result = fit_subset(from, to, best_inliers, with_yaw);
+  if (!result.valid)
+    return fit(from, to, with_yaw);
+  compute_residuals(from, to, result);
+  return result;
+}
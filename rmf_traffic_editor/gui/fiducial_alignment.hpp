@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef TRAFFIC_EDITOR__FIDUCIAL_ALIGNMENT_HPP
+#define TRAFFIC_EDITOR__FIDUCIAL_ALIGNMENT_HPP
+
+#include <vector>
+
+#include <QPointF>
+
+//=============================================================================
+/// Closed-form fits of the similarity transform which maps one set of
+/// points onto another, to align levels by their fiducials:
+///
+///   to[i] ~= scale * R(yaw) * from[i] + (dx, dy)
+///
+/// fit() is the least-squares (Umeyama) solution. fit_robust() first looks
+/// for the largest set of pairs which agree with each other, so that a
+/// single mis-placed fiducial doesn't skew the result.
+class FiducialAlignment
+{
+public:
+  struct Fit
+  {
+    bool valid = false;
+    double scale = 1.0;
+    double yaw = 0.0;
+    double dx = 0.0;
+    double dy = 0.0;
+
+    /// Distance of each mapped point from its target, in target units
+    std::vector<double> residuals;
+
+    /// Whether each pair was used for the fit
+    std::vector<bool> inliers;
+    int num_inliers = 0;
+
+    QPointF apply(const QPointF& p) const;
+  };
+
+  /// Least-squares fit to all the pairs. With with_yaw false, the rotation
+  /// is held at zero, but the scale is the same as with it, so that it
+  /// doesn't depend on how the drawing is turned. Not valid if there are
+  /// less than two distinct points.
+  static Fit fit(
+    const std::vector<QPointF>& from,
+    const std::vector<QPointF>& to,
+    const bool with_yaw);
+
+  /// Fit to the largest consensus set: every pair of pairs is tried as a
+  /// minimal fit, the one with the most other pairs within
+  /// inlier_threshold (in target units) wins, and the least-squares fit to
+  /// those inliers is returned. There are only ever a few dozen
+  /// fiducials, so the search is exhaustive rather than random.
+  static Fit fit_robust(
+    const std::vector<QPointF>& from,
+    const std::vector<QPointF>& to,
+    const bool with_yaw,
+    const double inlier_threshold);
+
+private:
+  static Fit fit_subset(
+    const std::vector<QPointF>& from,
+    const std::vector<QPointF>& to,
+    const std::vector<bool>& use,
+    const bool with_yaw);
+
+  static void compute_residuals(
+    const std::vector<QPointF>& from,
+    const std::vector<QPointF>& to,
+    Fit& fit);
+};
+
+#endif
@@ -0,0 +1,424 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+
+#include "fiducial_alignment.hpp"
+#include "fiducial_pairing.hpp"
+#include "level.h"
+#include "task_pool.hpp"
+
+namespace {
+
+/// Cell coordinates are offset by this to pack them into a key
+const std::int64_t CELL_OFFSET = 1 << 20;
+
+/// Pairs each mapped point with the nearest reference point within
+/// tolerance, the closest first, so that no point is paired twice
+std::vector<FiducialPairing::Pair> pair_nearest(
+  const std::vector<QPointF>& points,
+  const std::vector<QPointF>& reference,
+  const double scale,
+  const double dx,
+  const double dy,
+  const double tolerance)
+{
+  std::vector<FiducialPairing::Pair> candidates;
+  for (std::size_t i = 0; i < points.size(); i++)
+  {
+    const QPointF p(scale * points[i].x() + dx, scale * points[i].y() + dy);
+    for (std::size_t j = 0; j < reference.size(); j++)
+    {
+      const double distance = std::hypot(
+        p.x() - reference[j].x(),
+        p.y() - reference[j].y());
+      if (distance > tolerance)
+        continue;
+      FiducialPairing::Pair pair;
+      pair.fiducial = static_cast<int>(i);
+      pair.reference = static_cast<int>(j);
+      pair.residual = distance;
+      candidates.push_back(pair);
+    }
+  }
+  std::sort(
+    candidates.begin(),
+    candidates.end(),
+    [](const FiducialPairing::Pair& a, const FiducialPairing::Pair& b)
+    {
+      return a.residual < b.residual;
+    });
+
+  std::vector<bool> point_used(points.size(), false);
+  std::vector<bool> reference_used(reference.size(), false);
+  std::vector<FiducialPairing::Pair> pairs;
+  for (const FiducialPairing::Pair& pair : candidates)
+  {
+    if (point_used[pair.fiducial] || reference_used[pair.reference])
+      continue;
+    point_used[pair.fiducial] = true;
+    reference_used[pair.reference] = true;
+    pairs.push_back(pair);
+  }
+  std::sort(
+    pairs.begin(),
+    pairs.end(),
+    [](const FiducialPairing::Pair& a, const FiducialPairing::Pair& b)
+    {
+      return a.fiducial < b.fiducial;
+    });
+  return pairs;
+}
+
+double rms(const std::vector<FiducialPairing::Pair>& pairs)
+{
+  double sum = 0.0;
+  for (const FiducialPairing::Pair& pair : pairs)
+    sum += pair.residual * pair.residual;
+  return pairs.empty() ? 0.0 : std::sqrt(sum / pairs.size());
+}
+
+double angle_difference(const double a, const double b)
+{
+  return std::abs(std::remainder(a - b, 2.0 * M_PI));
+}
+
+std::vector<QPointF> fiducial_points(const Level& level)
+{
+  std::vector<QPointF> points;
+  points.reserve(level.fiducials.size());
+  for (const Fiducial& fiducial : level.fiducials)
+    points.push_back(QPointF(fiducial.x, fiducial.y));
+  return points;
+}
+
+}  // namespace
+
+//=============================================================================
+FiducialPairing::Table::Table(
+  const std::vector<QPointF>& reference,
+  const Options& options)
+: _options(options),
+  _reference(reference)
+{
+  const int n = static_cast<int>(_reference.size());
+  if (n >= 3)
+    _entries.reserve(static_cast<std::size_t>(n) * (n - 1) * (n - 2));
+  for (int i = 0; i < n; i++)
+  {
+    for (int j = 0; j < n; j++)
+    {
+      const QPointF d = _reference[j] - _reference[i];
+      const double length = std::hypot(d.x(), d.y());
+      if (i == j || length <= 0.0)
+        continue;
+      const float angle = static_cast<float>(std::atan2(d.y(), d.x()));
+      for (int k = 0; k < n; k++)
+      {
+        if (k == i || k == j)
+          continue;
+        const QPointF u = (_reference[k] - _reference[i]) / length;
+        Entry entry;
+        entry.key = key(
+          static_cast<int>(std::floor(u.x() / _options.cell)),
+          static_cast<int>(std::floor(u.y() / _options.cell)));
+        entry.basis = i * n + j;
+        entry.angle = angle;
+        _entries.push_back(entry);
+      }
+    }
+  }
+  std::sort(
+    _entries.begin(),
+    _entries.end(),
+    [](const Entry& a, const Entry& b) { return a.key < b.key; });
+}
+
+std::uint64_t FiducialPairing::Table::key(const int ix, const int iy)
+{
+  const std::int64_t x = std::max<std::int64_t>(
+    0, std::min<std::int64_t>(2 * CELL_OFFSET - 1, ix + CELL_OFFSET));
+  const std::int64_t y = std::max<std::int64_t>(
+    0, std::min<std::int64_t>(2 * CELL_OFFSET - 1, iy + CELL_OFFSET));
+  return (static_cast<std::uint64_t>(x) << 32) | static_cast<std::uint64_t>(y);
+}
+
+FiducialPairing::Result FiducialPairing::Table::pair(
+  const std::vector<QPointF>& points,
+  const double initial_scale,
+  const double tolerance) const
+{
+  Result result;
+  const int n = static_cast<int>(points.size());
+  const int n_ref = static_cast<int>(_reference.size());
+  const int min_pairs = std::max(2, _options.min_pairs);
+  if (n < min_pairs || n_ref < min_pairs)
+  {
+    result.summary = "too few fiducials";
+    return result;
+  }
+  const double min_scale = initial_scale / _options.max_scale_ratio;
+  const double max_scale = initial_scale * _options.max_scale_ratio;
+
+  // the votes of each reference basis for the current level basis, each
+  // counted once per fiducial of the level
+  std::vector<int> votes(static_cast<std::size_t>(n_ref) * n_ref, 0);
+  std::vector<int> voted_by(votes.size(), -1);
+  std::vector<int> touched;
+  std::vector<Pair> best;
+  double best_scale = 1.0;
+  double best_dx = 0.0;
+  double best_dy = 0.0;
+  const std::size_t most_pairs = std::min(n, n_ref);
+
+  for (int a = 0; a < n && best.size() < most_pairs; a++)
+  {
+    for (int b = 0; b < n && best.size() < most_pairs; b++)
+    {
+      const QPointF d = points[b] - points[a];
+      const double length = std::hypot(d.x(), d.y());
+      if (a == b || length <= 0.0)
+        continue;
+      const double angle = std::atan2(d.y(), d.x());
+
+      for (int c = 0; c < n; c++)
+      {
+        if (c == a || c == b)
+          continue;
+        const QPointF u = (points[c] - points[a]) / length;
+        const int ix = static_cast<int>(std::floor(u.x() / _options.cell));
+        const int iy = static_cast<int>(std::floor(u.y() / _options.cell));
+        for (int cx = ix - 1; cx <= ix + 1; cx++)
+        {
+          for (int cy = iy - 1; cy <= iy + 1; cy++)
+          {
+            Entry probe;
+            probe.key = key(cx, cy);
+            auto range = std::equal_range(
+              _entries.begin(),
+              _entries.end(),
+              probe,
+              [](const Entry& e1, const Entry& e2) { return e1.key < e2.key; });
+            for (auto it = range.first; it != range.second; ++it)
+            {
+              if (voted_by[it->basis] == c ||
+                angle_difference(it->angle, angle) > _options.angle_tolerance)
+                continue;
+              voted_by[it->basis] = c;
+              if (votes[it->basis]++ == 0)
+                touched.push_back(it->basis);
+            }
+          }
+        }
+      }
+
+      // the reference basis this one agrees with most is a hypothesis
+      int winner = -1;
+      for (const int basis : touched)
+      {
+        if (winner < 0 || votes[basis] > votes[winner])
+          winner = basis;
+      }
+      const int winner_votes = winner >= 0 ? votes[winner] : 0;
+      for (const int basis : touched)
+      {
+        votes[basis] = 0;
+        voted_by[basis] = -1;
+      }
+      touched.clear();
+      if (winner_votes + 2 < min_pairs)
+        continue;
+
+      const QPointF& r0 = _reference[winner / n_ref];
+      const QPointF& r1 = _reference[winner % n_ref];
+      const double scale = std::hypot(r1.x() - r0.x(), r1.y() - r0.y()) /
+        length;
+      if (scale < min_scale || scale > max_scale)
+        continue;
+      const double dx = r0.x() - scale * points[a].x();
+      const double dy = r0.y() - scale * points[a].y();
+      std::vector<Pair> pairs =
+        pair_nearest(points, _reference, scale, dx, dy, tolerance);
+      if (pairs.size() > best.size() ||
+        (pairs.size() == best.size() && rms(pairs) < rms(best)))
+      {
+        best = std::move(pairs);
+        best_scale = scale;
+        best_dx = dx;
+        best_dy = dy;
+      }
+    }
+  }
+
+  if (static_cast<int>(best.size()) < min_pairs)
+  {
+    result.summary = "no constellation in common";
+    return result;
+  }
+
+  // refine by least squares to the pairs, and pair again with that
+  std::vector<QPointF> from;
+  std::vector<QPointF> to;
+  for (const Pair& pair : best)
+  {
+    from.push_back(points[pair.fiducial]);
+    to.push_back(_reference[pair.reference]);
+  }
+  const FiducialAlignment::Fit fit = FiducialAlignment::fit(from, to, false);
+  if (fit.valid)
+  {
+    std::vector<Pair> refined =
+      pair_nearest(points, _reference, fit.scale, fit.dx, fit.dy, tolerance);
+    if (refined.size() >= best.size())
+    {
+      best = std::move(refined);
+      best_scale = fit.scale;
+      best_dx = fit.dx;
+      best_dy = fit.dy;
+    }
+  }
+
+  result.found = true;
+  result.scale = best_scale;
+  result.dx = best_dx;
+  result.dy = best_dy;
+  result.pairs = std::move(best);
+  result.summary =
+    std::to_string(result.pairs.size()) + " of " + std::to_string(n) +
+    " fiducials paired";
+  return result;
+}
+
+std::vector<FiducialPairing::Result> FiducialPairing::pair_levels(
+  const std::vector<Level>& levels,
+  const int ref_idx,
+  const std::vector<int>& level_idxs,
+  const Options& options)
+{
+  std::vector<Result> results(level_idxs.size());
+  if (ref_idx < 0 || ref_idx >= static_cast<int>(levels.size()))
+    return results;
+  const Level& ref_level = levels[ref_idx];
+  const double ref_mpp = ref_level.drawing_meters_per_pixel > 0.0 ?
+    ref_level.drawing_meters_per_pixel : 1.0;
+  const Table table(fiducial_points(ref_level), options);
+
+  TaskPool::instance().parallel_for(
+    static_cast<int>(level_idxs.size()),
+    [&](const int i)
+    {
+      const Level& level = levels[level_idxs[i]];
+      const double initial_scale = level.drawing_meters_per_pixel > 0.0 ?
+        level.drawing_meters_per_pixel / ref_mpp : 1.0;
+      results[i] = table.pair(
+        fiducial_points(level),
+        initial_scale,
+        options.tolerance_meters / ref_mpp);
+    });
+  return results;
+}
+
+std::map<int, std::vector<Fiducial>> FiducialPairing::named_fiducials(
+  const std::vector<Level>& levels,
+  const int ref_idx,
+  const std::vector<int>& level_idxs,
+  const std::vector<Result>& results)
+{
+  std::map<int, std::vector<Fiducial>> named;
+  if (ref_idx < 0 || ref_idx >= static_cast<int>(levels.size()))
+    return named;
+
+  std::set<std::string> taken;
+  for (const Level& level : levels)
+  {
+    for (const Fiducial& fiducial : level.fiducials)
+      taken.insert(fiducial.name);
+  }
+  int next_name = 0;
+  auto new_name = [&taken, &next_name]()
+    {
+      std::string name;
+      do
+      {
+        name = "fiducial_" + std::to_string(next_name++);
+      } while (taken.count(name));
+      taken.insert(name);
+      return name;
+    };
+
+  // only the first reference fiducial of each name is matched by name
+  std::vector<Fiducial> ref_fiducials = levels[ref_idx].fiducials;
+  std::vector<bool> ref_usable(ref_fiducials.size(), false);
+  std::set<std::string> ref_names;
+  for (std::size_t i = 0; i < ref_fiducials.size(); i++)
+  {
+    const std::string& name = ref_fiducials[i].name;
+    ref_usable[i] = !name.empty() && ref_names.insert(name).second;
+  }
+
+  bool ref_renamed = false;
+  for (std::size_t i = 0; i < results.size() && i < level_idxs.size(); i++)
+  {
+    const int idx = level_idxs[i];
+    if (!results[i].found || idx == ref_idx ||
+      idx < 0 || idx >= static_cast<int>(levels.size()))
+      continue;
+    std::vector<Fiducial> fiducials = levels[idx].fiducials;
+    std::set<std::string> given;
+    std::vector<bool> paired(fiducials.size(), false);
+    for (const Pair& pair : results[i].pairs)
+    {
+      if (pair.fiducial < 0 ||
+        pair.fiducial >= static_cast<int>(fiducials.size()) ||
+        pair.reference < 0 ||
+        pair.reference >= static_cast<int>(ref_fiducials.size()))
+        continue;
+      if (!ref_usable[pair.reference])
+      {
+        ref_fiducials[pair.reference].name = new_name();
+        ref_usable[pair.reference] = true;
+        ref_renamed = true;
+      }
+      fiducials[pair.fiducial].name = ref_fiducials[pair.reference].name;
+      given.insert(fiducials[pair.fiducial].name);
+      paired[pair.fiducial] = true;
+    }
+
+    // no other fiducial of the level may be taken for the same one
+    for (std::size_t j = 0; j < fiducials.size(); j++)
+    {
+      if (!paired[j] && given.count(fiducials[j].name))
+        fiducials[j].name.clear();
+    }
+
+    const std::vector<Fiducial>& original = levels[idx].fiducials;
+    for (std::size_t j = 0; j < fiducials.size(); j++)
+    {
+      if (fiducials[j].name != original[j].name)
+      {
+        named[idx] = fiducials;
+        break;
+      }
+    }
+  }
+  if (ref_renamed)
+    named[ref_idx] = ref_fiducials;
+  return named;
+}
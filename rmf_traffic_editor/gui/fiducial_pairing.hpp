@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef TRAFFIC_EDITOR__FIDUCIAL_PAIRING_HPP
+#define TRAFFIC_EDITOR__FIDUCIAL_PAIRING_HPP
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <QPointF>
+
+#include "fiducial.h"
+
+class Level;
+
+//=============================================================================
+/// Finds which fiducials of a level are which of the reference level,
+/// whatever they are named, so that levels imported with unnamed or
+/// differently named fiducials can still be aligned by name. It is
+/// geometric hashing: every ordered pair of reference fiducials is a basis,
+/// in which the others have coordinates that stay the same under the scale
+/// and shift between levels, and those are put into a hash table of
+/// cells. Each basis of the level then looks its own constellation up, and
+/// the reference basis it agrees with most gives a transform, which is
+/// kept if it maps the most fiducials onto reference ones. As the levels
+/// are aligned by scale and shift only, a basis only matches one which
+/// points the same way.
+///
+/// A table is of one reference constellation, and only read once built,
+/// so the levels are paired with it in parallel.
+class FiducialPairing
+{
+public:
+  struct Options
+  {
+    /// Side of the hash cells, relative to the length of the basis
+    double cell = 0.05;
+
+    /// How far the directions of two bases may differ, in radians
+    double angle_tolerance = 0.05;
+
+    /// A mapped fiducial this close to a reference one (in meters) is
+    /// paired with it
+    double tolerance_meters = 0.5;
+
+    /// The scale found between levels is within this factor of that of
+    /// their meters per pixel
+    double max_scale_ratio = 4.0;
+
+    /// Less than this many pairs is not a match
+    int min_pairs = 4;
+  };
+
+  struct Pair
+  {
+    int fiducial = -1;  // of the level
+    int reference = -1;  // of the reference level
+    double residual = 0.0;  // reference units
+  };
+
+  struct Result
+  {
+    bool found = false;
+
+    /// reference ~= scale * level + (dx, dy)
+    double scale = 1.0;
+    double dx = 0.0;
+    double dy = 0.0;
+
+    std::vector<Pair> pairs;
+    std::string summary;
+  };
+
+  class Table
+  {
+  public:
+    Table(const std::vector<QPointF>& reference, const Options& options);
+
+    /// Pair these points with the reference. initial_scale is a guess of
+    /// the reference units per level unit, and tolerance is in reference
+    /// units. Thread-safe.
+    Result pair(
+      const std::vector<QPointF>& points,
+      const double initial_scale,
+      const double tolerance) const;
+
+  private:
+    struct Entry
+    {
+      std::uint64_t key = 0;
+      int basis = 0;  // first * size + second
+      float angle = 0.0f;  // of the basis
+    };
+
+    Options _options;
+    std::vector<QPointF> _reference;
+    std::vector<Entry> _entries;  // sorted by key
+
+    static std::uint64_t key(const int ix, const int iy);
+  };
+
+  /// The pairing of each of these levels with the reference level, in
+  /// parallel, in the order of level_idxs
+  static std::vector<Result> pair_levels(
+    const std::vector<Level>& levels,
+    const int ref_idx,
+    const std::vector<int>& level_idxs,
+    const Options& options);
+
+  /// The fiducials of every level whose names change if the pairs are
+  /// named alike: a level fiducial takes the name of its reference one,
+  /// reference fiducials which are unnamed, or not the first of their
+  /// name, are given new names, and other fiducials of a level which had
+  /// a name now given to one of its pairs lose it.
+  static std::map<int, std::vector<Fiducial>> named_fiducials(
+    const std::vector<Level>& levels,
+    const int ref_idx,
+    const std::vector<int>& level_idxs,
+    const std::vector<Result>& results);
+};
+
+#endif
@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+
+#include "building.h"
+#include "file_watcher.hpp"
+
+
+FileWatcher::FileWatcher(QObject* parent)
+: QObject(parent)
+{
+  _watcher = new QFileSystemWatcher(this);
+  connect(
+    _watcher,
+    &QFileSystemWatcher::fileChanged,
+    this,
+    &FileWatcher::file_changed);
+
+  _timer = new QTimer(this);
+  _timer->setSingleShot(true);
+  _timer->setInterval(500);
+  connect(_timer, &QTimer::timeout, this, &FileWatcher::report);
+}
+
+void FileWatcher::watch(const Building& building)
+{
+  clear();
+  const std::string filename = building.get_filename();
+  if (filename.empty())
+    return;
+
+  const QString building_path =
+    QFileInfo(QString::fromStdString(filename)).absoluteFilePath();
+  _files[building_path].is_building = true;
+  if (building.split_files)
+  {
+    const QDir split_dir(Building::split_dir(filename));
+    for (const QString& name : split_dir.entryList(
+        QStringList() << "*.yaml",
+        QDir::Files))
+      _files[split_dir.absoluteFilePath(name)].is_building = true;
+  }
+
+  // the images are named relative to the building
+  const QDir dir(QFileInfo(building_path).absolutePath());
+  for (const Level& level : building.levels)
+  {
+    const QString level_name = QString::fromStdString(level.name);
+    if (!level.drawing_filename.empty())
+      _files[dir.absoluteFilePath(
+          QString::fromStdString(level.drawing_filename))]
+      .images.emplace_back(level_name, -1);
+    for (std::size_t i = 0; i < level.layers.size(); i++)
+    {
+      if (!level.layers[i].filename.empty())
+        _files[dir.absoluteFilePath(
+            QString::fromStdString(level.layers[i].filename))]
+        .images.emplace_back(level_name, static_cast<int>(i));
+    }
+  }
+
+  QStringList paths;
+  for (auto& it : _files)
+  {
+    stamp(it.first, it.second);
+    paths.append(it.first);
+  }
+  _watcher->addPaths(paths);
+}
+
+void FileWatcher::clear()
+{
+  const QStringList paths = _watcher->files();
+  if (!paths.isEmpty())
+    _watcher->removePaths(paths);
+  _files.clear();
+  _pending.clear();
+  _missing.clear();
+  _timer->stop();
+}
+
+void FileWatcher::stamp(const QString& path, File& file)
+{
+  const QFileInfo info(path);
+  file.modified = info.exists() ? info.lastModified().toMSecsSinceEpoch() : 0;
+  file.size = info.exists() ? info.size() : -1;
+}
+
+void FileWatcher::file_changed(const QString& path)
+{
+  if (!_files.count(path))
+    return;
+  _pending.insert(path);
+  _timer->start();  // again, while the writes keep coming
+}
+
+void FileWatcher::report()
+{
+  bool building_changed_on_disk = false;
+  std::vector<std::pair<QString, int>> changed_images;
+  std::set<QString> still_missing;
+  for (const QString& path : _pending)
+  {
+    auto it = _files.find(path);
+    if (it == _files.end())
+      continue;
+
+    // a file replaced by renaming another over it (as QSaveFile does) is
+    // no longer watched, and may be missing for a moment; one which is
+    // still missing the next time was deleted
+    if (!QFileInfo::exists(path))
+    {
+      if (_missing.insert(path).second)
+        still_missing.insert(path);
+      continue;
+    }
+    _missing.erase(path);
+    if (!_watcher->files().contains(path))
+      _watcher->addPath(path);
+
+    File& file = it->second;
+    const qint64 modified = file.modified;
+    const qint64 size = file.size;
+    stamp(path, file);
+    if (file.modified == modified && file.size == size)
+      continue;
+
+    building_changed_on_disk = building_changed_on_disk || file.is_building;
+    changed_images.insert(
+      changed_images.end(),
+      file.images.begin(),
+      file.images.end());
+  }
+  _pending.swap(still_missing);
+  if (!_pending.empty())
+    _timer->start();
+
+  // a new building file names its images anew
+  if (building_changed_on_disk)
+  {
+    emit building_changed();
+    return;
+  }
+  for (const auto& image : changed_images)
+    emit image_changed(image.first, image.second);
+}
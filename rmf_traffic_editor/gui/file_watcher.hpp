@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__FILE_WATCHER_HPP
+#define TRAFFIC_EDITOR__FILE_WATCHER_HPP
+
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include <QFileSystemWatcher>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+class Building;
+
+//=============================================================================
+/// Watches the file of a building (and the level files of a split one) and
+/// the drawings and layer images of its levels, for changes made by other
+/// programs. Changes are reported once the files have been quiet for a
+/// moment, so a file being written in several steps is reported once, and
+/// only if its size or modification time differ from when it was watched,
+/// so that watching the building again after saving it keeps its own
+/// writes from being reported.
+class FileWatcher : public QObject
+{
+  Q_OBJECT
+
+public:
+  explicit FileWatcher(QObject* parent = nullptr);
+
+  /// Watch the files of this building, in place of those watched before
+  void watch(const Building& building);
+
+  void clear();
+
+signals:
+  /// The building file or one of its level files changed
+  void building_changed();
+
+  /// The drawing of the level of this name (layer_idx < 0) or the image of
+  /// one of its layers changed
+  void image_changed(const QString& level_name, const int layer_idx);
+
+private:
+  struct File
+  {
+    qint64 modified = 0;  // msecs since the epoch
+    qint64 size = -1;
+    bool is_building = false;
+    std::vector<std::pair<QString, int>> images;  // (level name, layer)
+  };
+
+  QFileSystemWatcher* _watcher = nullptr;
+  QTimer* _timer = nullptr;
+  std::map<QString, File> _files;
+  std::set<QString> _pending;
+  std::set<QString> _missing;  // when last looked at
+
+  static void stamp(const QString& path, File& file);
+  void file_changed(const QString& path);
+  void report();
+};
+
+#endif
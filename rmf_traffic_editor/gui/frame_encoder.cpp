@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <QDir>
+
+#include "frame_encoder.hpp"
+
+
+FrameEncoder::~FrameEncoder()
+{
+  finish();
+}
+
+bool FrameEncoder::start(
+  const QString& dir,
+  const QSize& size,
+  const int num_buffers)
+{
+  finish();
+  if (size.isEmpty() || num_buffers < 1 || !QDir().mkpath(dir))
+    return false;
+
+  _dir = dir;
+  _size = size;
+  _buffers.clear();
+  _buffers.reserve(num_buffers);  // so that the pointers stay valid
+  _free.clear();
+  for (int i = 0; i < num_buffers; i++)
+  {
+    _buffers.emplace_back(size, QImage::Format_RGB32);
+    if (_buffers.back().isNull())
+      return false;
+    _free.push_back(&_buffers.back());
+  }
+  _queue.clear();
+  _stopping = false;
+  _stats = Stats();
+  _error.clear();
+  _thread = std::thread(&FrameEncoder::run, this);
+  return true;
+}
+
+bool FrameEncoder::finish()
+{
+  if (!_thread.joinable())
+    return _stats.failed == 0;
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stopping = true;
+  }
+  _changed.notify_all();
+  _thread.join();
+  _buffers.clear();
+  _free.clear();
+  return _stats.failed == 0;
+}
+
+QImage* FrameEncoder::acquire(const bool wait)
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  if (wait)
+    _changed.wait(lock, [this]() { return !_free.empty(); });
+  if (_free.empty())
+  {
+    _stats.dropped++;
+    return nullptr;
+  }
+  QImage* frame = _free.back();
+  _free.pop_back();
+  return frame;
+}
+
+void FrameEncoder::submit(QImage* frame)
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _queue.push_back(Job{frame, _stats.captured++});
+  }
+  _changed.notify_all();
+}
+
+void FrameEncoder::release(QImage* frame)
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _free.push_back(frame);
+  }
+  _changed.notify_all();
+}
+
+FrameEncoder::Stats FrameEncoder::stats() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _stats;
+}
+
+QString FrameEncoder::error() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _error;
+}
+
+void FrameEncoder::run()
+{
+  const QDir dir(_dir);
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (true)
+  {
+    _changed.wait(lock, [this]() { return _stopping || !_queue.empty(); });
+    if (_queue.empty())
+      return;  // stopping, and everything was written
+    const Job job = _queue.front();
+    _queue.pop_front();
+    lock.unlock();
+
+    const QString filename =
+      dir.filePath(QString("frame_%1.png").arg(job.number, 6, 10, QChar('0')));
+    const bool ok = job.frame->save(filename);
+
+    lock.lock();
+    if (ok)
+      _stats.written++;
+    else
+    {
+      if (_stats.failed++ == 0)
+        _error = filename;
+    }
+    _free.push_back(job.frame);
+    _changed.notify_all();
+  }
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__FRAME_ENCODER_HPP
+#define TRAFFIC_EDITOR__FRAME_ENCODER_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <QImage>
+#include <QSize>
+#include <QString>
+
+//=============================================================================
+/// Writes captured frames into numbered PNG files (frame_000000.png, ...)
+/// on a thread of its own, so that compressing them doesn't hold up the
+/// thread which renders them. Frames are rendered into a fixed number of
+/// buffers of one size, which are reused once written: when the encoder
+/// falls behind, a capture which can't wait finds no free buffer and its
+/// frame is dropped, rather than the queue growing without bound.
+class FrameEncoder
+{
+public:
+  struct Stats
+  {
+    int captured = 0;  // submitted for writing
+    int written = 0;
+    int dropped = 0;  // no buffer was free
+    int failed = 0;  // couldn't be written
+  };
+
+  ~FrameEncoder();
+
+  /// Start writing frames of this size into dir, with num_buffers frames
+  /// in flight at most
+  bool start(const QString& dir, const QSize& size, const int num_buffers = 8);
+
+  /// Write every frame still queued and stop the thread. Returns false if
+  /// any frame couldn't be written.
+  bool finish();
+
+  bool is_running() const { return _thread.joinable(); }
+  QSize frame_size() const { return _size; }
+  QString dir() const { return _dir; }
+
+  /// A free buffer (RGB32, of frame_size()) to render the next frame into,
+  /// to be handed back with submit() or release(). If all of them are
+  /// queued, waits for one if wait is set, else counts the frame as
+  /// dropped and returns nullptr.
+  QImage* acquire(const bool wait);
+
+  /// Queue an acquired buffer as the next frame
+  void submit(QImage* frame);
+
+  /// Hand back an acquired buffer without writing it
+  void release(QImage* frame);
+
+  Stats stats() const;
+
+  /// The file of the first frame which couldn't be written, if any
+  QString error() const;
+
+private:
+  struct Job
+  {
+    QImage* frame;
+    int number;
+  };
+
+  QString _dir;
+  QSize _size;
+  std::vector<QImage> _buffers;
+  std::thread _thread;
+
+  mutable std::mutex _mutex;
+  std::condition_variable _changed;
+  std::vector<QImage*> _free;
+  std::deque<Job> _queue;
+  bool _stopping = false;
+  Stats _stats;
+  QString _error;
+
+  void run();
+};
+
+#endif
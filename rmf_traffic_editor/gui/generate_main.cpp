@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdio>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include "building.h"
+#include "building_generator.hpp"
+#include "logging.hpp"
+
+// Generates a synthetic building of a chosen size and saves it, for
+// stress-testing the editor and the tools which read building files.
+// Writes a JSON object describing what was generated to stdout.
+
+namespace {
+
+QJsonObject describe(const Building& building, const qint64 elapsed_ms)
+{
+  int vertices = 0, lanes = 0, walls = 0, doors = 0, polygons = 0;
+  int models = 0, layers = 0, features = 0, constraints = 0, fiducials = 0;
+  for (const Level& level : building.levels)
+  {
+    vertices += static_cast<int>(level.vertices.size());
+    for (const Edge& edge : level.edges)
+    {
+      lanes += edge.type == Edge::LANE;
+      walls += edge.type == Edge::WALL;
+      doors += edge.type == Edge::DOOR;
+    }
+    polygons += static_cast<int>(level.polygons.size());
+    models += static_cast<int>(level.models.size());
+    layers += static_cast<int>(level.layers.size());
+    features += static_cast<int>(level.floorplan_features.size());
+    for (const Layer& layer : level.layers)
+      features += static_cast<int>(layer.features.size());
+    constraints += static_cast<int>(level.constraints.size());
+    fiducials += static_cast<int>(level.fiducials.size());
+  }
+
+  QJsonObject result;
+  result["levels"] = static_cast<int>(building.levels.size());
+  result["lifts"] = static_cast<int>(building.lifts.size());
+  result["vertices"] = vertices;
+  result["lanes"] = lanes;
+  result["walls"] = walls;
+  result["doors"] = doors;
+  result["polygons"] = polygons;
+  result["models"] = models;
+  result["layers"] = layers;
+  result["features"] = features;
+  result["constraints"] = constraints;
+  result["fiducials"] = fiducials;
+  result["total_ms"] = elapsed_ms;
+  return result;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  QCoreApplication app(argc, argv);
+  app.setOrganizationName("open-robotics");
+  app.setOrganizationDomain("openrobotics.org");
+  app.setApplicationName("traffic-editor-generate");
+
+  const BuildingGenerator::Options defaults;
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+    "Generate a synthetic building of a chosen size, for stress tests. "
+    "Prints a JSON object describing what was generated.");
+  parser.addHelpOption();
+  parser.addPositionalArgument(
+    "building",
+    "Building YAML file to write",
+    "<building>");
+
+  auto number_option = [&parser](
+    const QString& name,
+    const QString& description,
+    const double default_value)
+    {
+      const QCommandLineOption option(
+        name,
+        description + " (default: " + QString::number(default_value) + ")",
+        "n",
+        QString::number(default_value));
+      parser.addOption(option);
+      return option;
+    };
+
+  const QCommandLineOption levels_option = number_option(
+    "levels", "Number of levels", defaults.num_levels);
+  const QCommandLineOption width_option = number_option(
+    "width", "Width of each level in meters", defaults.width);
+  const QCommandLineOption depth_option = number_option(
+    "depth", "Depth of each level in meters", defaults.depth);
+  const QCommandLineOption room_option = number_option(
+    "room-size", "Size of the rooms in meters", defaults.room_size);
+  const QCommandLineOption spacing_option = number_option(
+    "lane-spacing",
+    "Distance between lane vertices in meters",
+    defaults.lane_spacing);
+  const QCommandLineOption graphs_option = number_option(
+    "graphs", "Number of lane graphs", defaults.num_graphs);
+  const QCommandLineOption lane_fraction_option = number_option(
+    "lane-fraction",
+    "Fraction of the lane grid used by each graph",
+    defaults.lane_fraction);
+  const QCommandLineOption wall_fraction_option = number_option(
+    "wall-fraction",
+    "Fraction of the borders between rooms which are walls",
+    defaults.wall_fraction);
+  const QCommandLineOption door_fraction_option = number_option(
+    "door-fraction",
+    "Fraction of the walls between rooms which have a door",
+    defaults.door_fraction);
+  const QCommandLineOption floors_option = number_option(
+    "floor-polygons",
+    "Rooms with a floor polygon on each level, -1 for all",
+    defaults.num_floor_polygons);
+  const QCommandLineOption models_option = number_option(
+    "models", "Models on each level", defaults.num_models);
+  const QCommandLineOption lifts_option = number_option(
+    "lifts", "Number of lifts", defaults.num_lifts);
+  const QCommandLineOption fiducials_option = number_option(
+    "fiducials", "Fiducials on each level", defaults.num_fiducials);
+  const QCommandLineOption layers_option = number_option(
+    "layers", "Layers on each level, with --images", defaults.num_layers);
+  const QCommandLineOption features_option = number_option(
+    "features-per-layer",
+    "Constrained feature pairs of each layer",
+    defaults.features_per_layer);
+  const QCommandLineOption scale_option = number_option(
+    "meters-per-pixel",
+    "Scale of the floorplans",
+    defaults.meters_per_pixel);
+  const QCommandLineOption seed_option = number_option(
+    "seed", "Seed of the random choices", defaults.seed);
+
+  const QCommandLineOption models_names_option(
+    "model-names",
+    "Comma-separated model names to place",
+    "names");
+  parser.addOption(models_names_option);
+
+  const QCommandLineOption images_option(
+    "images",
+    "Write floorplan and layer images beside the building");
+  parser.addOption(images_option);
+
+  const QCommandLineOption verbose_option(
+    QStringList() << "v" << "verbose",
+    "Pass the log of generating and saving through to stderr");
+  parser.addOption(verbose_option);
+
+  parser.process(app);
+
+  const QStringList paths = parser.positionalArguments();
+  if (paths.size() != 1)
+    parser.showHelp(1);
+  const QFileInfo file_info(paths.first());
+
+  BuildingGenerator::Options options;
+  options.name = file_info.baseName().toStdString();
+  options.num_levels = parser.value(levels_option).toInt();
+  options.width = parser.value(width_option).toDouble();
+  options.depth = parser.value(depth_option).toDouble();
+  options.room_size = parser.value(room_option).toDouble();
+  options.lane_spacing = parser.value(spacing_option).toDouble();
+  options.num_graphs = parser.value(graphs_option).toInt();
+  options.lane_fraction = parser.value(lane_fraction_option).toDouble();
+  options.wall_fraction = parser.value(wall_fraction_option).toDouble();
+  options.door_fraction = parser.value(door_fraction_option).toDouble();
+  options.num_floor_polygons = parser.value(floors_option).toInt();
+  options.num_models = parser.value(models_option).toInt();
+  options.num_lifts = parser.value(lifts_option).toInt();
+  options.num_fiducials = parser.value(fiducials_option).toInt();
+  options.num_layers = parser.value(layers_option).toInt();
+  options.features_per_layer = parser.value(features_option).toInt();
+  options.meters_per_pixel = parser.value(scale_option).toDouble();
+  options.seed = parser.value(seed_option).toUInt();
+  for (const QString& name : parser.value(models_names_option).split(","))
+  {
+    if (!name.trimmed().isEmpty())
+      options.model_names.push_back(name.trimmed().toStdString());
+  }
+  if (parser.isSet(images_option))
+    options.image_dir = file_info.absolutePath().toStdString();
+
+  if (options.meters_per_pixel <= 0.0 || options.room_size <= 0.0 ||
+    options.lane_spacing <= 0.0)
+  {
+    fprintf(stderr, "the scale, room size and lane spacing must be > 0\n");
+    return 1;
+  }
+  if (!QDir().mkpath(file_info.absolutePath()))
+  {
+    fprintf(stderr, "unable to create %s\n",
+      qUtf8Printable(file_info.absolutePath()));
+    return 1;
+  }
+
+  if (!parser.isSet(verbose_option))
+    QLoggingCategory::setFilterRules("traffic_editor.*=false");
+
+  // the building and its images log to stdout, which is for the report
+  FILE* report = fdopen(dup(STDOUT_FILENO), "w");
+  const int log_fd = parser.isSet(verbose_option) ?
+    STDERR_FILENO : open("/dev/null", O_WRONLY);
+  dup2(log_fd, STDOUT_FILENO);
+
+  QElapsedTimer timer;
+  timer.start();
+  Building building;
+  BuildingGenerator generator(options);
+  bool ok = generator.generate(building);
+  const std::string path = file_info.absoluteFilePath().toStdString();
+  building.set_filename(path);
+  ok = building.save_to(path) && ok;
+
+  QJsonObject result = describe(building, timer.elapsed());
+  result["path"] = QString::fromStdString(path);
+  result["ok"] = ok;
+  fflush(stdout);
+  fprintf(report, "%s\n",
+    QJsonDocument(result).toJson(QJsonDocument::Compact).constData());
+  fclose(report);
+  return ok ? 0 : 1;
+}
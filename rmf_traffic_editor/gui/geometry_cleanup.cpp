@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <algorithm>
+#include <cstdint>
+#include <unordered_set>
+
+#include "geometry_cleanup.hpp"
+#include "spatial_grid.hpp"
+
+namespace {
+
+struct EdgeKey
+{
+  int a = 0;
+  int b = 0;
+  int type = 0;
+  int graph = 0;
+
+  bool operator==(const EdgeKey& other) const
+  {
+    return a == other.a && b == other.b && type == other.type &&
+      graph == other.graph;
+  }
+};
+
+struct EdgeKeyHash
+{
+  std::size_t operator()(const EdgeKey& key) const
+  {
+    std::uint64_t h = static_cast<std::uint32_t>(key.a);
+    h = (h << 32) | static_cast<std::uint32_t>(key.b);
+    h ^= (static_cast<std::uint64_t>(key.type) << 8 | key.graph) *
+      0x9e3779b97f4a7c15ULL;
+    h ^= h >> 29;
+    return static_cast<std::size_t>(h * 0xbf58476d1ce4e5b9ULL);
+  }
+};
+
+EdgeKey edge_key(const Edge& edge)
+{
+  EdgeKey key;
+  const bool directed =
+    (edge.type == Edge::LANE || edge.type == Edge::HUMAN_LANE) &&
+    !edge.is_bidirectional();
+  key.a = directed ? edge.start_idx : std::min(edge.start_idx, edge.end_idx);
+  key.b = directed ? edge.end_idx : std::max(edge.start_idx, edge.end_idx);
+  key.type = static_cast<int>(edge.type);
+  key.graph = edge.get_graph_idx();
+  return key;
+}
+
+}  // namespace
+
+std::vector<int> GeometryCleanup::weld(
+  std::vector<Vertex>& vertices,
+  const double tolerance,
+  const std::size_t first_new_vertex)
+{
+  const int num_vertices = static_cast<int>(vertices.size());
+  std::vector<int> target(num_vertices);
+  for (int i = 0; i < num_vertices; i++)
+    target[i] = i;
+  if (tolerance <= 0.0)
+    return target;
+
+  // only the kept vertices are in the grid, so welds don't chain along a
+  // line of vertices each within the tolerance of the next
+  SpatialGrid grid(tolerance);
+  std::vector<int> nearby;
+  const double tolerance_squared = tolerance * tolerance;
+  for (int i = 0; i < num_vertices; i++)
+  {
+    const Vertex& v = vertices[i];
+    if (static_cast<std::size_t>(i) < first_new_vertex)
+    {
+      grid.set(i, v.x, v.y);
+      continue;
+    }
+    nearby.clear();
+    grid.within(
+      v.x - tolerance,
+      v.y - tolerance,
+      v.x + tolerance,
+      v.y + tolerance,
+      nearby);
+
+    int best = -1;
+    double best_distance_squared = tolerance_squared;
+    for (const int j : nearby)
+    {
+      const Vertex& kept = vertices[j];
+      if (!v.name.empty() && !kept.name.empty() && v.name != kept.name)
+        continue;
+      const double dx = kept.x - v.x;
+      const double dy = kept.y - v.y;
+      const double distance_squared = dx * dx + dy * dy;
+      if (distance_squared <= best_distance_squared)
+      {
+        best = j;
+        best_distance_squared = distance_squared;
+      }
+    }
+
+    if (best < 0)
+    {
+      grid.set(i, v.x, v.y);
+      continue;
+    }
+    target[i] = best;
+    Vertex& kept = vertices[best];
+    if (kept.name.empty())
+      kept.name = v.name;
+    if (kept.params.empty())
+      kept.params = v.params;
+  }
+  return target;
+}
+
+GeometryCleanup::Report GeometryCleanup::run(
+  std::vector<Vertex>& vertices,
+  std::vector<Edge>& edges,
+  std::vector<Polygon>& polygons,
+  const double tolerance,
+  const std::size_t first_new_vertex,
+  const std::size_t first_new_edge)
+{
+  Report report;
+  const std::vector<int> target =
+    weld(vertices, tolerance, first_new_vertex);
+
+  // compose the welds with the compaction of the vertices, so that the
+  // edges and polygons are only remapped once
+  const int num_vertices = static_cast<int>(vertices.size());
+  std::vector<int> new_idx(num_vertices, -1);
+  int num_kept = 0;
+  for (int i = 0; i < num_vertices; i++)
+  {
+    if (target[i] != i)
+      continue;
+    new_idx[i] = num_kept;
+    if (num_kept != i)
+      vertices[num_kept] = std::move(vertices[i]);
+    num_kept++;
+  }
+  for (int i = 0; i < num_vertices; i++)
+    new_idx[i] = new_idx[target[i]];
+  report.welded_vertices = num_vertices - num_kept;
+  vertices.resize(num_kept);
+
+  auto remap = [&new_idx, num_vertices](const int idx)
+    {
+      return idx >= 0 && idx < num_vertices ? new_idx[idx] : idx;
+    };
+
+  std::unordered_set<EdgeKey, EdgeKeyHash> seen;
+  seen.reserve(edges.size());
+  std::size_t num_edges = 0;
+  for (std::size_t i = 0; i < edges.size(); i++)
+  {
+    Edge& edge = edges[i];
+    edge.start_idx = remap(edge.start_idx);
+    edge.end_idx = remap(edge.end_idx);
+    // the edges from before are kept, but the new ones can repeat them
+    const bool is_new = i >= first_new_edge;
+    if (is_new && edge.start_idx == edge.end_idx)
+    {
+      report.zero_length_edges++;
+      continue;
+    }
+    if (!seen.insert(edge_key(edge)).second && is_new)
+    {
+      report.duplicate_edges++;
+      continue;
+    }
+    if (num_edges != i)
+      edges[num_edges] = std::move(edge);
+    num_edges++;
+  }
+  edges.resize(num_edges);
+
+  std::size_t num_polygons = 0;
+  for (std::size_t i = 0; i < polygons.size(); i++)
+  {
+    Polygon& polygon = polygons[i];
+    std::size_t n = 0;
+    for (const int idx : polygon.vertices)
+    {
+      const int mapped = remap(idx);
+      if (n > 0 && polygon.vertices[n - 1] == mapped)
+        continue;
+      polygon.vertices[n++] = mapped;
+    }
+    // around the end, back to the start
+    while (n > 1 && polygon.vertices[n - 1] == polygon.vertices[0])
+      n--;
+    report.polygon_vertices +=
+      static_cast<int>(polygon.vertices.size() - n);
+    polygon.vertices.resize(n);
+    if (n < 3)
+    {
+      report.degenerate_polygons++;
+      continue;
+    }
+    if (num_polygons != i)
+      polygons[num_polygons] = std::move(polygon);
+    num_polygons++;
+  }
+  polygons.resize(num_polygons);
+
+  return report;
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef TRAFFIC_EDITOR__GEOMETRY_CLEANUP_HPP
+#define TRAFFIC_EDITOR__GEOMETRY_CLEANUP_HPP
+
+#include <vector>
+
+#include "edge.h"
+#include "polygon.h"
+#include "vertex.h"
+
+//=============================================================================
+/// Tidies the lists of a level after an import or a merge, which leave
+/// coincident vertices, zero-length edges and the same lane or wall drawn
+/// twice between a pair of vertices.
+///
+/// Each vertex is welded to the first earlier vertex within the tolerance,
+/// found with a SpatialGrid, unless both are named and the names differ.
+/// The vertex that is kept takes the name and params of a welded one if it
+/// has none. The edges and polygons are then remapped in a single pass,
+/// dropping the edges which now start and end at the same vertex and
+/// those which repeat an earlier edge of the same type and graph between
+/// the same vertices (in the same direction, for one-way lanes). Polygons
+/// lose the vertices repeated around them, and go if less than three
+/// remain. All of this is linear in the size of the level.
+class GeometryCleanup
+{
+public:
+  struct Report
+  {
+    int welded_vertices = 0;
+    int zero_length_edges = 0;
+    int duplicate_edges = 0;
+    int polygon_vertices = 0;  // repeats removed from polygons
+    int degenerate_polygons = 0;
+
+    bool empty() const
+    {
+      return welded_vertices == 0 && zero_length_edges == 0 &&
+        duplicate_edges == 0 && polygon_vertices == 0 &&
+        degenerate_polygons == 0;
+    }
+  };
+
+  /// The tolerance is in the units of the vertex coordinates. To tidy
+  /// only what was just appended to the lists, pass the sizes they had
+  /// before as first_new_vertex and first_new_edge: the earlier vertices
+  /// and edges are then all kept (though the new ones may weld to them).
+  static Report run(
+    std::vector<Vertex>& vertices,
+    std::vector<Edge>& edges,
+    std::vector<Polygon>& polygons,
+    const double tolerance,
+    const std::size_t first_new_vertex = 0,
+    const std::size_t first_new_edge = 0);
+
+private:
+  /// For every vertex, the index of the vertex it is welded to (itself if
+  /// it is kept)
+  static std::vector<int> weld(
+    std::vector<Vertex>& vertices,
+    const double tolerance,
+    const std::size_t first_new_vertex);
+};
+
+#endif
@@ -0,0 +1,373 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include <algorithm>
+#include <utility>
+
+#include "geometry_simplifier.hpp"
+#include "task_pool.hpp"
+
+namespace {
+
+bool same_params(const ParamMap& a, const ParamMap& b)
+{
+  if (a.size() != b.size())
+    return false;
+  // both are sorted by key
+  ParamMap::const_iterator it = b.begin();
+  for (const auto& param : a)
+  {
+    const auto other = *it;
+    ++it;
+    if (param.first != other.first ||
+      param.second.type != other.second.type ||
+      param.second.to_qstring() != other.second.to_qstring())
+      return false;
+  }
+  return true;
+}
+
+double segment_distance_squared(
+  const Vertex& p,
+  const Vertex& a,
+  const Vertex& b)
+{
+  const double dx = b.x - a.x;
+  const double dy = b.y - a.y;
+  const double length_squared = dx * dx + dy * dy;
+  double t = 0.0;
+  if (length_squared > 0.0)
+  {
+    t = ((p.x - a.x) * dx + (p.y - a.y) * dy) / length_squared;
+    t = std::min(1.0, std::max(0.0, t));
+  }
+  const double ex = a.x + t * dx - p.x;
+  const double ey = a.y + t * dy - p.y;
+  return ex * ex + ey * ey;
+}
+
+int other_end(const Edge& edge, const int vertex_idx)
+{
+  return edge.start_idx == vertex_idx ? edge.end_idx : edge.start_idx;
+}
+
+}  // namespace
+
+void GeometrySimplifier::simplify(
+  const std::vector<Vertex>& vertices,
+  Path& path,
+  const double tolerance_squared)
+{
+  const std::size_t n = path.vertices.size();
+  if (n < 3)
+    return;
+  path.keep.front() = 1;
+  path.keep.back() = 1;
+
+  // a closed path needs a second anchor for the ends of its two halves:
+  // the vertex furthest from the first
+  const bool closed = path.vertices.front() == path.vertices.back();
+  if (closed && std::count(path.keep.begin(), path.keep.end(), 1) == 2)
+  {
+    const Vertex& first = vertices[path.vertices.front()];
+    std::size_t furthest = 1;
+    double furthest_squared = -1.0;
+    for (std::size_t i = 1; i + 1 < n; i++)
+    {
+      const Vertex& v = vertices[path.vertices[i]];
+      const double dx = v.x - first.x;
+      const double dy = v.y - first.y;
+      if (dx * dx + dy * dy > furthest_squared)
+      {
+        furthest = i;
+        furthest_squared = dx * dx + dy * dy;
+      }
+    }
+    path.keep[furthest] = 1;
+  }
+
+  // every span between two kept vertices, split at its furthest vertex
+  // until all of them are within the tolerance of the span
+  std::vector<std::pair<std::size_t, std::size_t>> spans;
+  std::size_t prev = 0;
+  for (std::size_t i = 1; i < n; i++)
+  {
+    if (!path.keep[i])
+      continue;
+    if (i - prev > 1)
+      spans.push_back(std::make_pair(prev, i));
+    prev = i;
+  }
+  while (!spans.empty())
+  {
+    const std::size_t first = spans.back().first;
+    const std::size_t last = spans.back().second;
+    spans.pop_back();
+    const Vertex& a = vertices[path.vertices[first]];
+    const Vertex& b = vertices[path.vertices[last]];
+    std::size_t furthest = first;
+    double furthest_squared = tolerance_squared;
+    for (std::size_t i = first + 1; i < last; i++)
+    {
+      const double d = segment_distance_squared(
+        vertices[path.vertices[i]], a, b);
+      if (d > furthest_squared)
+      {
+        furthest = i;
+        furthest_squared = d;
+      }
+    }
+    if (furthest == first)
+      continue;
+    path.keep[furthest] = 1;
+    if (furthest - first > 1)
+      spans.push_back(std::make_pair(first, furthest));
+    if (last - furthest > 1)
+      spans.push_back(std::make_pair(furthest, last));
+  }
+
+  // a closed path left as two vertices would fold onto itself
+  if (closed && std::count(path.keep.begin(), path.keep.end(), 1) < 4)
+    std::fill(path.keep.begin(), path.keep.end(), 1);
+}
+
+GeometrySimplifier::Report GeometrySimplifier::run(
+  std::vector<Vertex>& vertices,
+  std::vector<Edge>& edges,
+  std::vector<Polygon>& polygons,
+  const std::vector<int>& wall_idxs,
+  const std::vector<int>& polygon_idxs,
+  const double tolerance)
+{
+  Report report;
+  const int num_vertices = static_cast<int>(vertices.size());
+  const int num_edges = static_cast<int>(edges.size());
+  auto valid = [num_vertices](const int idx)
+    {
+      return idx >= 0 && idx < num_vertices;
+    };
+
+  // the edges at each vertex, and how many times polygons use it
+  std::vector<std::vector<int>> vertex_edges(num_vertices);
+  for (int i = 0; i < num_edges; i++)
+  {
+    const Edge& edge = edges[i];
+    if (valid(edge.start_idx))
+      vertex_edges[edge.start_idx].push_back(i);
+    if (valid(edge.end_idx) && edge.end_idx != edge.start_idx)
+      vertex_edges[edge.end_idx].push_back(i);
+  }
+  std::vector<int> polygon_uses(num_vertices, 0);
+  for (const Polygon& polygon : polygons)
+  {
+    for (const int idx : polygon.vertices)
+    {
+      if (valid(idx))
+        polygon_uses[idx]++;
+    }
+  }
+
+  std::vector<char> pinned(num_vertices, 0);
+  for (int i = 0; i < num_vertices; i++)
+  {
+    const Vertex& v = vertices[i];
+    const std::vector<int>& attached = vertex_edges[i];
+    if (attached.size() != 2 || polygon_uses[i] > 0 || !v.name.empty() ||
+      !v.params.empty())
+    {
+      pinned[i] = 1;
+      continue;
+    }
+    const Edge& a = edges[attached[0]];
+    const Edge& b = edges[attached[1]];
+    pinned[i] = a.type != Edge::WALL || b.type != Edge::WALL ||
+      other_end(a, i) == other_end(b, i) || !same_params(a.params, b.params);
+  }
+
+  std::vector<Path> paths;
+  std::vector<char> visited(num_edges, 0);
+  for (const int wall_idx : wall_idxs)
+  {
+    if (wall_idx < 0 || wall_idx >= num_edges || visited[wall_idx])
+      continue;
+    const Edge& wall = edges[wall_idx];
+    if (wall.type != Edge::WALL || !valid(wall.start_idx) ||
+      !valid(wall.end_idx))
+      continue;
+
+    // back up to the start of the chain, or all the way round a loop
+    int edge_idx = wall_idx;
+    int start = wall.start_idx;
+    while (!pinned[start])
+    {
+      const std::vector<int>& attached = vertex_edges[start];
+      const int next = attached[0] == edge_idx ? attached[1] : attached[0];
+      if (next == wall_idx)
+        break;
+      edge_idx = next;
+      start = other_end(edges[next], start);
+    }
+
+    Path path;
+    path.vertices.push_back(start);
+    int v = start;
+    while (true)
+    {
+      visited[edge_idx] = 1;
+      path.edges.push_back(edge_idx);
+      v = other_end(edges[edge_idx], v);
+      path.vertices.push_back(v);
+      if (v == start || pinned[v])
+        break;
+      const std::vector<int>& attached = vertex_edges[v];
+      edge_idx = attached[0] == edge_idx ? attached[1] : attached[0];
+    }
+    if (path.edges.size() < 2)
+      continue;
+    path.keep.assign(path.vertices.size(), 0);
+    paths.push_back(std::move(path));
+  }
+
+  for (const int polygon_idx : polygon_idxs)
+  {
+    if (polygon_idx < 0 || polygon_idx >= static_cast<int>(polygons.size()))
+      continue;
+    const std::vector<int>& outline = polygons[polygon_idx].vertices;
+    if (outline.size() < 4 ||
+      !std::all_of(outline.begin(), outline.end(), valid))
+      continue;
+
+    // start the closed path at a vertex which stays, if there is one
+    const std::size_t n = outline.size();
+    std::size_t first = 0;
+    for (std::size_t i = 0; i < n; i++)
+    {
+      const int idx = outline[i];
+      if (!vertex_edges[idx].empty() || polygon_uses[idx] > 1 ||
+        !vertices[idx].name.empty() || !vertices[idx].params.empty())
+      {
+        first = i;
+        break;
+      }
+    }
+    Path path;
+    path.polygon_idx = polygon_idx;
+    for (std::size_t i = 0; i <= n; i++)
+    {
+      const int idx = outline[(first + i) % n];
+      path.vertices.push_back(idx);
+      path.keep.push_back(
+        !vertex_edges[idx].empty() || polygon_uses[idx] > 1 ||
+        !vertices[idx].name.empty() || !vertices[idx].params.empty());
+    }
+    paths.push_back(std::move(path));
+  }
+
+  const double tolerance_squared = tolerance * tolerance;
+  TaskPool::instance().parallel_for(
+    static_cast<int>(paths.size()),
+    [&vertices, &paths, tolerance_squared](const int i)
+    {
+      simplify(vertices, paths[i], tolerance_squared);
+    });
+
+  // rejoin the walls between the vertices kept along each chain and cut
+  // the others out of the outlines
+  std::vector<char> removed_vertex(num_vertices, 0);
+  std::vector<char> removed_edge(num_edges, 0);
+  for (const Path& path : paths)
+  {
+    const std::size_t n = path.vertices.size();
+    if (std::count(path.keep.begin(), path.keep.end(), 1) ==
+      static_cast<std::ptrdiff_t>(n))
+      continue;
+    if (path.polygon_idx >= 0)
+    {
+      std::vector<int> outline;
+      for (std::size_t i = 0; i + 1 < n; i++)
+      {
+        if (path.keep[i])
+          outline.push_back(path.vertices[i]);
+        else
+          removed_vertex[path.vertices[i]] = 1;
+      }
+      polygons[path.polygon_idx].vertices = std::move(outline);
+      report.polygons++;
+      continue;
+    }
+
+    std::size_t run_start = 0;
+    for (std::size_t i = 1; i < n; i++)
+    {
+      if (!path.keep[i])
+      {
+        removed_vertex[path.vertices[i]] = 1;
+        removed_edge[path.edges[i]] = 1;
+        continue;
+      }
+      Edge& wall = edges[path.edges[run_start]];
+      wall.start_idx = path.vertices[run_start];
+      wall.end_idx = path.vertices[i];
+      run_start = i;
+    }
+    report.chains++;
+  }
+  if (report.chains == 0 && report.polygons == 0)
+    return report;
+
+  std::vector<int> new_idx(num_vertices, -1);
+  int num_kept = 0;
+  for (int i = 0; i < num_vertices; i++)
+  {
+    if (removed_vertex[i])
+      continue;
+    new_idx[i] = num_kept;
+    if (num_kept != i)
+      vertices[num_kept] = std::move(vertices[i]);
+    num_kept++;
+  }
+  report.vertices = num_vertices - num_kept;
+  vertices.resize(num_kept);
+
+  auto remap = [&new_idx, &valid](const int idx)
+    {
+      return valid(idx) ? new_idx[idx] : idx;
+    };
+
+  int num_edges_kept = 0;
+  for (int i = 0; i < num_edges; i++)
+  {
+    if (removed_edge[i])
+      continue;
+    Edge& edge = edges[i];
+    edge.start_idx = remap(edge.start_idx);
+    edge.end_idx = remap(edge.end_idx);
+    if (num_edges_kept != i)
+      edges[num_edges_kept] = std::move(edge);
+    num_edges_kept++;
+  }
+  report.walls = num_edges - num_edges_kept;
+  edges.resize(num_edges_kept);
+
+  for (Polygon& polygon : polygons)
+  {
+    for (int& idx : polygon.vertices)
+      idx = remap(idx);
+  }
+  return report;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef TRAFFIC_EDITOR__GEOMETRY_SIMPLIFIER_HPP
+#define TRAFFIC_EDITOR__GEOMETRY_SIMPLIFIER_HPP
+
+#include <vector>
+
+#include "edge.h"
+#include "polygon.h"
+#include "vertex.h"
+
+//=============================================================================
+/// Thins out the nearly collinear vertices of walls and polygons traced
+/// from scans or imported from CAD, with the Douglas-Peucker algorithm.
+///
+/// Walls are simplified as chains: from each given wall, the chain is
+/// followed in both directions through the vertices that join exactly two
+/// walls, up to the first vertex that has to stay. Those are the vertices
+/// of any other degree, or touched by a door, lane or any other edge, or
+/// used by a polygon, or with a name or params, or between two walls with
+/// different params. Polygon outlines keep the vertices they share with
+/// edges or other polygons. So the topology of the level is the same
+/// afterwards; only the vertices between those which stay are removed,
+/// and the walls of a chain are rejoined between the vertices kept along
+/// it, with the params of the first wall of each run.
+///
+/// The chains are found with an index of the edges at each vertex, and
+/// simplified in parallel; the removed vertices are then compacted out of
+/// the list and the edges and polygons remapped in one pass.
+class GeometrySimplifier
+{
+public:
+  struct Report
+  {
+    int chains = 0;  // of walls which lost vertices
+    int walls = 0;  // removed
+    int polygons = 0;  // which lost vertices
+    int vertices = 0;  // removed
+
+    bool empty() const
+    {
+      return vertices == 0;
+    }
+  };
+
+  /// The tolerance is in the units of the vertex coordinates: no removed
+  /// vertex is further than it from the simplified wall or outline. Only
+  /// the walls and polygons whose indices are given (and the chains those
+  /// walls are on) are simplified.
+  static Report run(
+    std::vector<Vertex>& vertices,
+    std::vector<Edge>& edges,
+    std::vector<Polygon>& polygons,
+    const std::vector<int>& wall_idxs,
+    const std::vector<int>& polygon_idxs,
+    const double tolerance);
+
+private:
+  /// A polyline of vertex indices, closed if it ends where it started,
+  /// with the positions along it which have to be kept marked
+  struct Path
+  {
+    std::vector<int> vertices;
+    std::vector<int> edges;  // edges[i] joins vertices[i] and [i + 1]
+    std::vector<char> keep;
+    int polygon_idx = -1;
+  };
+
+  static void simplify(
+    const std::vector<Vertex>& vertices,
+    Path& path,
+    const double tolerance_squared);
+};
+
+#endif
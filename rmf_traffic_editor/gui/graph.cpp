@@ -22,10 +22,6 @@ Graph::Graph()
 {
 }
 
-Graph::~Graph()
-{
-}
-
 bool Graph::from_yaml(const int _idx, const YAML::Node& data)
 {
   if (!data.IsMap())
@@ -26,7 +26,6 @@ class Graph
 {
 public:
   Graph();
-  ~Graph();
 
   int idx = 0;
   std::string name;
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__HEAP_HPP
+#define TRAFFIC_EDITOR__HEAP_HPP
+
+#include <cstddef>
+
+//=============================================================================
+/// What the C library's allocator holds. Loading a building makes
+/// millions of small allocations, many of them (the YAML tree) freed again
+/// at the end, in between the entities which stay. When the building is
+/// closed, the pages of the freed blocks stay with the allocator, spread
+/// over one arena per loading thread, unless they are handed back.
+class Heap
+{
+public:
+  struct Usage
+  {
+    std::size_t in_use = 0;  // allocated and not freed
+    std::size_t free = 0;  // freed, but still held by the allocator
+  };
+
+  /// False if the C library can't tell (it isn't glibc 2.33 or newer)
+  static bool usage(Usage& result);
+
+  /// Return the whole free pages of every arena to the system. Takes a few
+  /// milliseconds on a big heap, so call it when a lot was just freed:
+  /// after a load, and when a building is cleared or closed.
+  static void release_free_memory();
+};
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <map>
+#include <utility>
+
+#include <QIcon>
+
+#include "icon_cache.hpp"
+
+// pixmaps may only be used from the GUI thread, so no locking is needed
+static std::map<std::pair<QString, int>, QPixmap>& icon_pixmaps()
+{
+  static std::map<std::pair<QString, int>, QPixmap> pixmaps;
+  return pixmaps;
+}
+
+QPixmap IconCache::pixmap(const QString& filename, const int size)
+{
+  auto& pixmaps = icon_pixmaps();
+  const std::pair<QString, int> key(filename, size);
+  auto it = pixmaps.find(key);
+  if (it != pixmaps.end())
+    return it->second;
+
+  QIcon icon(filename);
+  QPixmap pixmap(icon.pixmap(icon.actualSize(QSize(size, size))));
+  pixmaps[key] = pixmap;
+  return pixmap;
+}
+
+void IconCache::clear()
+{
+  icon_pixmaps().clear();
+}
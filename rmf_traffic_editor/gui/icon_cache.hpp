@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__ICON_CACHE_HPP
+#define TRAFFIC_EDITOR__ICON_CACHE_HPP
+
+#include <QPixmap>
+#include <QString>
+
+//=============================================================================
+/// Process-wide cache of rasterized icons. Rendering an SVG is expensive,
+/// so each (icon, pixel size) pair is only rasterized the first time it is
+/// requested; later requests return an implicitly-shared copy.
+class IconCache
+{
+public:
+  /// Returns the icon rasterized to fit in a size x size pixel square
+  static QPixmap pixmap(const QString& filename, const int size = 128);
+
+  static void clear();
+};
+
+#endif
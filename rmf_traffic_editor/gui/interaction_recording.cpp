@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+
+#include "interaction_recording.hpp"
+
+namespace {
+
+const int FORMAT_VERSION = 1;
+
+}  // namespace
+
+const char* InteractionRecording::kind_name(const Kind kind)
+{
+  switch (kind)
+  {
+    case MOUSE_PRESS: return "press";
+    case MOUSE_RELEASE: return "release";
+    case MOUSE_MOVE: return "move";
+    case KEY: return "key";
+    case TOOL: return "tool";
+    case UNDO: return "undo";
+    case REDO: return "redo";
+    case VIEW: return "view";
+    default: return "unknown";
+  }
+}
+
+void InteractionRecording::clear()
+{
+  building_path.clear();
+  level_idx = 0;
+  events.clear();
+}
+
+qint64 InteractionRecording::duration_ms() const
+{
+  return events.empty() ? 0 : events.back().t_ms;
+}
+
+bool InteractionRecording::save(const QString& filename) const
+{
+  QJsonArray json_events;
+  for (const Event& e : events)
+  {
+    QJsonObject o;
+    o["t"] = static_cast<double>(e.t_ms);
+    o["kind"] = kind_name(e.kind);
+    switch (e.kind)
+    {
+      case MOUSE_PRESS:
+      case MOUSE_RELEASE:
+      case MOUSE_MOVE:
+        o["x"] = e.x;
+        o["y"] = e.y;
+        o["button"] = e.button;
+        o["buttons"] = e.buttons;
+        o["modifiers"] = e.modifiers;
+        break;
+      case KEY:
+        o["key"] = e.key;
+        o["modifiers"] = e.modifiers;
+        break;
+      case TOOL:
+        o["tool"] = e.tool;
+        break;
+      case VIEW:
+        o["x"] = e.x;
+        o["y"] = e.y;
+        o["transform"] = QJsonArray {
+          e.transform.m11(), e.transform.m12(),
+          e.transform.m21(), e.transform.m22(),
+          e.transform.dx(), e.transform.dy()};
+        break;
+      default:
+        break;
+    }
+    json_events.append(o);
+  }
+
+  QJsonObject json;
+  json["version"] = FORMAT_VERSION;
+  json["building"] = QString::fromStdString(building_path);
+  json["level"] = level_idx;
+  json["events"] = json_events;
+
+  QSaveFile file(filename);
+  if (!file.open(QIODevice::WriteOnly))
+    return false;
+  file.write(QJsonDocument(json).toJson(QJsonDocument::Compact));
+  return file.commit();
+}
+
+bool InteractionRecording::load(const QString& filename)
+{
+  clear();
+  QFile file(filename);
+  if (!file.open(QIODevice::ReadOnly))
+    return false;
+  const QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
+  if (!doc.isObject())
+    return false;
+  const QJsonObject json = doc.object();
+  if (json.value("version").toInt() != FORMAT_VERSION)
+    return false;
+
+  building_path = json.value("building").toString().toStdString();
+  level_idx = json.value("level").toInt();
+
+  const QJsonArray json_events = json.value("events").toArray();
+  events.reserve(json_events.size());
+  for (int i = 0; i < json_events.size(); i++)
+  {
+    const QJsonObject o = json_events.at(i).toObject();
+    const QString kind = o.value("kind").toString();
+
+    Event e;
+    e.t_ms = static_cast<qint64>(o.value("t").toDouble());
+    bool found = false;
+    for (int k = MOUSE_PRESS; k <= VIEW; k++)
+    {
+      if (kind == kind_name(static_cast<Kind>(k)))
+      {
+        e.kind = static_cast<Kind>(k);
+        found = true;
+        break;
+      }
+    }
+    if (!found)
+      continue;  // from a newer version; skip rather than fail
+
+    e.x = o.value("x").toDouble();
+    e.y = o.value("y").toDouble();
+    e.button = o.value("button").toInt();
+    e.buttons = o.value("buttons").toInt();
+    e.modifiers = o.value("modifiers").toInt();
+    e.key = o.value("key").toInt();
+    e.tool = o.value("tool").toInt();
+    if (e.kind == VIEW)
+    {
+      const QJsonArray t = o.value("transform").toArray();
+      if (t.size() != 6)
+        return false;
+      e.transform = QTransform(
+        t.at(0).toDouble(), t.at(1).toDouble(),
+        t.at(2).toDouble(), t.at(3).toDouble(),
+        t.at(4).toDouble(), t.at(5).toDouble());
+    }
+    events.push_back(e);
+  }
+  return true;
+}
+
+//=============================================================================
+void InteractionLatencies::add(const std::string& category, const double ms)
+{
+  _samples[category].push_back(ms);
+}
+
+int InteractionLatencies::count(const std::string& category) const
+{
+  const auto it = _samples.find(category);
+  return it == _samples.end() ? 0 : static_cast<int>(it->second.size());
+}
+
+double InteractionLatencies::percentile(
+  const std::string& category,
+  const double fraction) const
+{
+  const auto it = _samples.find(category);
+  if (it == _samples.end() || it->second.empty())
+    return 0.0;
+
+  std::vector<double> sorted = it->second;
+  // nearest-rank
+  const double rank = std::ceil(fraction * sorted.size());
+  const std::size_t idx = std::min(
+    sorted.size() - 1,
+    static_cast<std::size_t>(std::max(rank, 1.0)) - 1);
+  std::nth_element(sorted.begin(), sorted.begin() + idx, sorted.end());
+  return sorted[idx];
+}
+
+QString InteractionLatencies::summary() const
+{
+  QString s;
+  for (const auto& it : _samples)
+  {
+    const std::string& category = it.first;
+    s += QString::asprintf(
+      "  %-10s %6d x  p50 %8.3f ms  p90 %8.3f ms  p99 %8.3f ms  "
+      "max %8.3f ms\n",
+      category.c_str(),
+      count(category),
+      percentile(category, 0.5),
+      percentile(category, 0.9),
+      percentile(category, 0.99),
+      percentile(category, 1.0));
+  }
+  return s;
+}
+
+QJsonObject InteractionLatencies::to_json() const
+{
+  QJsonObject json;
+  for (const auto& it : _samples)
+  {
+    const std::string& category = it.first;
+    double total = 0.0;
+    for (const double ms : it.second)
+      total += ms;
+
+    QJsonObject o;
+    o["count"] = count(category);
+    o["mean_ms"] = it.second.empty() ? 0.0 : total / it.second.size();
+    o["p50_ms"] = percentile(category, 0.5);
+    o["p90_ms"] = percentile(category, 0.9);
+    o["p99_ms"] = percentile(category, 0.99);
+    o["max_ms"] = percentile(category, 1.0);
+    json[QString::fromStdString(category)] = o;
+  }
+  return json;
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__INTERACTION_RECORDING_HPP
+#define TRAFFIC_EDITOR__INTERACTION_RECORDING_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <QJsonObject>
+#include <QString>
+#include <QTransform>
+
+//=============================================================================
+/// A timestamped stream of the input of an editing session: mouse events
+/// as they reach Editor::mouse_event(), key presses, tool switches,
+/// undo/redo and changes of the view. Mouse positions are stored in scene
+/// coordinates and the view transform is recorded along with them, so a
+/// session can be replayed against a window of a different size or
+/// position. Saved as JSON (see save()).
+class InteractionRecording
+{
+public:
+  enum Kind
+  {
+    MOUSE_PRESS = 0,
+    MOUSE_RELEASE,
+    MOUSE_MOVE,
+    KEY,
+    TOOL,
+    UNDO,
+    REDO,
+    VIEW
+  };
+
+  struct Event
+  {
+    qint64 t_ms = 0;  // since the start of the recording
+    Kind kind = MOUSE_MOVE;
+
+    // MOUSE_*: the point in scene coordinates. VIEW: the scene point in
+    // the center of the view.
+    double x = 0.0;
+    double y = 0.0;
+    int button = 0;
+    int buttons = 0;
+    int modifiers = 0;
+
+    int key = 0;  // KEY
+    int tool = 0;  // TOOL
+
+    QTransform transform;  // VIEW: of the map view
+  };
+
+  std::string building_path;
+  int level_idx = 0;
+  std::vector<Event> events;
+
+  void clear();
+
+  bool save(const QString& filename) const;
+  bool load(const QString& filename);
+
+  /// Duration of the recording, ms
+  qint64 duration_ms() const;
+
+  static const char* kind_name(const Kind kind);
+};
+
+//=============================================================================
+/// Latencies measured while replaying an InteractionRecording, grouped in
+/// categories such as "pick", "drag", "add_edge", "undo" and "draw".
+class InteractionLatencies
+{
+public:
+  void clear() { _samples.clear(); }
+
+  void add(const std::string& category, const double ms);
+
+  int count(const std::string& category) const;
+
+  /// The sample at this fraction of the sorted samples, ms; 0 if none
+  double percentile(const std::string& category, const double fraction)
+  const;
+
+  /// One line per category: count, p50, p90, p99 and max
+  QString summary() const;
+
+  /// {category: {"count", "mean_ms", "p50_ms", "p90_ms", "p99_ms",
+  /// "max_ms"}}
+  QJsonObject to_json() const;
+
+private:
+  std::map<std::string, std::vector<double>> _samples;
+};
+
+#endif
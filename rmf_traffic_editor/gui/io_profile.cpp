@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include <QJsonArray>
+
+#include "io_profile.hpp"
+#include "trace.hpp"
+
+namespace {
+
+void add_to(
+  std::vector<std::pair<std::string, qint64>>& entries,
+  const std::string& name,
+  const qint64 n)
+{
+  // there are only a dozen or so entries; a linear search is plenty
+  for (auto& it : entries)
+  {
+    if (it.first == name)
+    {
+      it.second += n;
+      return;
+    }
+  }
+  entries.push_back(std::make_pair(name, n));
+}
+
+}  // namespace
+
+
+IoProfile::IoProfile(const IoProfile& other)
+{
+  *this = other;
+}
+
+IoProfile& IoProfile::operator=(const IoProfile& other)
+{
+  if (this == &other)
+    return *this;
+  std::lock(_mutex, other._mutex);
+  std::lock_guard<std::mutex> lock(_mutex, std::adopt_lock);
+  std::lock_guard<std::mutex> other_lock(other._mutex, std::adopt_lock);
+  _phases = other._phases;
+  _counts = other._counts;
+  _images = other._images;
+  return *this;
+}
+
+void IoProfile::clear()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _phases.clear();
+  _counts.clear();
+  _images.clear();
+}
+
+void IoProfile::add_phase_time(const std::string& phase, const qint64 nsec)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  add_to(_phases, phase, nsec);
+}
+
+void IoProfile::add_count(const std::string& counter, const qint64 n)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  add_to(_counts, counter, n);
+}
+
+void IoProfile::add_image(
+  const std::string& filename,
+  const int width,
+  const int height,
+  const qint64 nsec)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _images.push_back(Image{filename, width, height, nsec});
+}
+
+qint64 IoProfile::total_nsec() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  qint64 total = 0;
+  for (const auto& it : _phases)
+    total += it.second;
+  return total;
+}
+
+QString IoProfile::summary(const QString& title) const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  QString s(title + ":\n");
+  for (const auto& it : _phases)
+    s += QString::asprintf(
+      "  %-28s %10.2f ms\n",
+      it.first.c_str(),
+      it.second / 1e6);
+
+  s += "counts:\n";
+  for (const auto& it : _counts)
+    s += QString::asprintf(
+      "  %-28s %10lld\n",
+      it.first.c_str(),
+      static_cast<long long>(it.second));
+
+  s += "images:\n";
+  for (const Image& image : _images)
+    s += QString::asprintf(
+      "  %5dx%-5d %10.2f ms  %s\n",
+      image.width,
+      image.height,
+      image.nsec / 1e6,
+      image.filename.c_str());
+  return s;
+}
+
+QJsonObject IoProfile::to_json() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  QJsonObject phases;
+  for (const auto& it : _phases)
+    phases[QString::fromStdString(it.first)] = it.second / 1e6;
+
+  QJsonObject counts;
+  for (const auto& it : _counts)
+    counts[QString::fromStdString(it.first)] = it.second;
+
+  QJsonArray images;
+  for (const Image& image : _images)
+  {
+    QJsonObject o;
+    o["file"] = QString::fromStdString(image.filename);
+    o["width"] = image.width;
+    o["height"] = image.height;
+    o["ms"] = image.nsec / 1e6;
+    images.append(o);
+  }
+
+  QJsonObject json;
+  json["phases_ms"] = phases;
+  json["counts"] = counts;
+  json["images"] = images;
+  return json;
+}
+
+IoProfile::PhaseTimer::PhaseTimer(IoProfile* profile)
+: _profile(profile)
+{
+}
+
+IoProfile::PhaseTimer::~PhaseTimer()
+{
+  stop();
+}
+
+void IoProfile::PhaseTimer::start(const char* phase)
+{
+  stop();
+#ifdef TRAFFIC_EDITOR_TRACING
+  if (Trace::is_recording())
+  {
+    _phase = phase;
+    _trace_begin = Trace::now();
+  }
+#endif
+  if (!_profile)
+    return;
+  _phase = phase;
+  _timer.start();
+}
+
+void IoProfile::PhaseTimer::stop()
+{
+#ifdef TRAFFIC_EDITOR_TRACING
+  if (_phase && _trace_begin >= 0)
+    Trace::add_zone(_phase, _trace_begin);
+  _trace_begin = -1;
+#endif
+  if (_profile && _phase)
+    _profile->add_phase_time(_phase, _timer.nsecsElapsed());
+  _phase = nullptr;
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef TRAFFIC_EDITOR__IO_PROFILE_HPP
+#define TRAFFIC_EDITOR__IO_PROFILE_HPP
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QString>
+
+//=============================================================================
+/// Phase timings and counters of the last Building::load() or save_to(),
+/// such as bytes read, entities parsed and images decoded, for tracking
+/// where the time goes in a map pipeline. Unlike DrawProfile, it is
+/// recorded into from the worker threads that parse levels and decode
+/// images too, so every method takes a lock.
+class IoProfile
+{
+public:
+  IoProfile() = default;
+  IoProfile(const IoProfile& other);
+  IoProfile& operator=(const IoProfile& other);
+
+  void clear();
+
+  /// Add to the time of a phase; phases are listed in first-recorded order
+  void add_phase_time(const std::string& phase, const qint64 nsec);
+
+  /// Add to a counter; counters are listed in first-recorded order
+  void add_count(const std::string& counter, const qint64 n);
+
+  void add_image(
+    const std::string& filename,
+    const int width,
+    const int height,
+    const qint64 nsec);
+
+  /// The sum of the phases
+  qint64 total_nsec() const;
+
+  /// Human-readable table of everything recorded, one line per entry
+  QString summary(const QString& title) const;
+
+  /// Everything recorded, as {"phases_ms": {...}, "counts": {...},
+  /// "images": [{"file", "width", "height", "ms"}, ...]}
+  QJsonObject to_json() const;
+
+  /// Times consecutive phases, if profile isn't nullptr. Each start()
+  /// ends the current phase; so does going out of scope.
+  class PhaseTimer
+  {
+  public:
+    PhaseTimer(IoProfile* profile);
+    ~PhaseTimer();
+
+    void start(const char* phase);
+    void stop();
+
+  private:
+    IoProfile* _profile;
+    const char* _phase = nullptr;
+    QElapsedTimer _timer;
+    int64_t _trace_begin = -1;  // the phase is also a zone of the Trace
+  };
+
+private:
+  struct Image
+  {
+    std::string filename;
+    int width;
+    int height;
+    qint64 nsec;
+  };
+
+  mutable std::mutex _mutex;
+  std::vector<std::pair<std::string, qint64>> _phases;
+  std::vector<std::pair<std::string, qint64>> _counts;
+  std::vector<Image> _images;
+};
+
+#endif
@@ -0,0 +1,396 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <set>
+
+#include "ceres/ceres.h"
+
+#include "joint_alignment.hpp"
+#include "transform_cost.hpp"
+
+using std::vector;
+
+namespace {
+
+/// The distance, in meters of the reference level, between where two
+/// levels put their fiducials of the same name. Parameters are the scale
+/// and translation of each level to the reference level's pixels.
+class FiducialPairCost : public ceres::SizedCostFunction<2, 3, 3>
+{
+public:
+  FiducialPairCost(
+    const QPointF& a,
+    const QPointF& b,
+    const double reference_meters_per_pixel)
+  : _a(a),
+    _b(b),
+    _k(reference_meters_per_pixel)
+  {
+  }
+
+  bool Evaluate(
+    double const* const* parameters,
+    double* residuals,
+    double** jacobians) const override
+  {
+    const double* ta = parameters[0];
+    const double* tb = parameters[1];
+    residuals[0] =
+      _k * (ta[0] * _a.x() + ta[1] - (tb[0] * _b.x() + tb[1]));
+    residuals[1] =
+      _k * (ta[0] * _a.y() + ta[2] - (tb[0] * _b.y() + tb[2]));
+
+    if (!jacobians)
+      return true;
+
+    if (jacobians[0])
+    {
+      jacobians[0][0] = _k * _a.x();
+      jacobians[0][1] = _k;
+      jacobians[0][2] = 0.0;
+      jacobians[0][3] = _k * _a.y();
+      jacobians[0][4] = 0.0;
+      jacobians[0][5] = _k;
+    }
+    if (jacobians[1])
+    {
+      jacobians[1][0] = -_k * _b.x();
+      jacobians[1][1] = -_k;
+      jacobians[1][2] = 0.0;
+      jacobians[1][3] = -_k * _b.y();
+      jacobians[1][4] = 0.0;
+      jacobians[1][5] = -_k;
+    }
+    return true;
+  }
+
+private:
+  QPointF _a;
+  QPointF _b;
+  double _k;
+};
+
+struct LayerParameters
+{
+  double yaw;
+  double scale;
+  double translation[2];
+};
+
+/// Levels are joined when they have two fiducial names in common, which
+/// is the least that fixes their relative scale
+int find_root(vector<int>& parents, int i)
+{
+  while (parents[i] != i)
+  {
+    parents[i] = parents[parents[i]];
+    i = parents[i];
+  }
+  return i;
+}
+
+QPointF apply(const double* t, const QPointF& p)
+{
+  return QPointF(t[0] * p.x() + t[1], t[0] * p.y() + t[2]);
+}
+
+}  // anonymous namespace
+
+//=============================================================================
+JointAlignment::Problem JointAlignment::make_problem(
+  Building& building,
+  const vector<Building::Transform>& initial,
+  const bool with_layers)
+{
+  Problem problem;
+  if (building.levels.empty())
+    return problem;
+  problem.reference_level_idx = building.get_reference_level_idx();
+  problem.reference_meters_per_pixel =
+    building.levels[problem.reference_level_idx].drawing_meters_per_pixel;
+  if (problem.reference_meters_per_pixel <= 0.0)
+    problem.reference_meters_per_pixel = 1.0;
+
+  problem.levels.resize(building.levels.size());
+  for (std::size_t i = 0; i < building.levels.size(); i++)
+  {
+    const Level& level = building.levels[i];
+    LevelProblem& level_problem = problem.levels[i];
+    level_problem.name = level.name;
+    if (i < initial.size())
+      level_problem.initial = initial[i];
+    std::set<std::string> names;
+    for (const Fiducial& f : level.fiducials)
+    {
+      if (!f.name.empty() && names.insert(f.name).second)
+        level_problem.fiducials.emplace_back(f.name, QPointF(f.x, f.y));
+    }
+    if (with_layers)
+      problem.layers.push_back(level.layer_problems());
+  }
+  return problem;
+}
+
+JointAlignment::Solution JointAlignment::solve(
+  const Problem& problem,
+  const int num_threads,
+  const std::atomic<bool>* cancel)
+{
+  Solution solution;
+  const int num_levels = static_cast<int>(problem.levels.size());
+  const int ref_idx = problem.reference_level_idx;
+  solution.level_transforms.resize(num_levels);
+  for (int i = 0; i < num_levels; i++)
+  {
+    if (i != ref_idx)
+      solution.level_transforms[i] = problem.levels[i].initial;
+  }
+  solution.layer_solutions.resize(problem.layers.size());
+  for (std::size_t i = 0; i < problem.layers.size(); i++)
+  {
+    for (const Level::LayerProblem& layer : problem.layers[i])
+    {
+      Level::LayerSolution layer_solution;
+      layer_solution.layer_idx = layer.layer_idx;
+      layer_solution.transform = layer.initial;
+      layer_solution.summary = "no constraints";
+      solution.layer_solutions[i].push_back(layer_solution);
+    }
+  }
+
+  // the levels each fiducial name is on, and which levels that joins
+  std::map<std::string, vector<std::pair<int, QPointF>>> fiducials;
+  for (int i = 0; i < num_levels; i++)
+  {
+    for (const auto& fiducial : problem.levels[i].fiducials)
+      fiducials[fiducial.first].emplace_back(i, fiducial.second);
+  }
+  std::map<std::pair<int, int>, int> num_shared;
+  for (const auto& name : fiducials)
+  {
+    const auto& on = name.second;
+    for (std::size_t a = 0; a < on.size(); a++)
+    {
+      for (std::size_t b = a + 1; b < on.size(); b++)
+        num_shared[std::make_pair(on[a].first, on[b].first)]++;
+    }
+  }
+  vector<int> parents(num_levels);
+  for (int i = 0; i < num_levels; i++)
+    parents[i] = i;
+  for (const auto& shared : num_shared)
+  {
+    if (shared.second >= 2)
+      parents[find_root(parents, shared.first.first)] =
+        find_root(parents, shared.first.second);
+  }
+  vector<bool> aligned(num_levels, false);
+  for (int i = 0; i < num_levels; i++)
+  {
+    aligned[i] = ref_idx < num_levels &&
+      find_root(parents, i) == find_root(parents, ref_idx);
+  }
+
+  ceres::Problem ceres_problem;
+  int num_constraints = 0;
+
+  vector<std::array<double, 3>> level_parameters(num_levels);
+  for (int i = 0; i < num_levels; i++)
+  {
+    const Building::Transform& t = solution.level_transforms[i];
+    level_parameters[i] = {{t.scale, t.dx, t.dy}};
+  }
+  for (const auto& name : fiducials)
+  {
+    const auto& on = name.second;
+    for (std::size_t a = 0; a < on.size(); a++)
+    {
+      for (std::size_t b = a + 1; b < on.size(); b++)
+      {
+        const int level_a = on[a].first;
+        const int level_b = on[b].first;
+        if (!aligned[level_a] || !aligned[level_b])
+          continue;
+        ceres_problem.AddResidualBlock(
+          new FiducialPairCost(
+            on[a].second,
+            on[b].second,
+            problem.reference_meters_per_pixel),
+          new ceres::HuberLoss(problem.inlier_meters),
+          level_parameters[level_a].data(),
+          level_parameters[level_b].data());
+        num_constraints++;
+      }
+    }
+  }
+  for (int i = 0; i < num_levels; i++)
+  {
+    double* parameters = level_parameters[i].data();
+    if (!ceres_problem.HasParameterBlock(parameters))
+      continue;
+    if (i == ref_idx)
+      ceres_problem.SetParameterBlockConstant(parameters);
+    else
+      ceres_problem.SetParameterLowerBound(parameters, 0, 0.01);
+  }
+
+  // the layers don't share parameters with anything else, which the
+  // Schur ordering finds for itself
+  vector<vector<LayerParameters>> layer_parameters(problem.layers.size());
+  for (std::size_t i = 0; i < problem.layers.size(); i++)
+  {
+    layer_parameters[i].resize(problem.layers[i].size());
+    for (std::size_t j = 0; j < problem.layers[i].size(); j++)
+    {
+      const Level::LayerProblem& layer = problem.layers[i][j];
+      LayerParameters& p = layer_parameters[i][j];
+      p.yaw = layer.initial.yaw();
+      p.scale = layer.initial.scale();
+      p.translation[0] = layer.initial.translation().x();
+      p.translation[1] = layer.initial.translation().y();
+      for (const auto& points : layer.points)
+      {
+        ceres_problem.AddResidualBlock(
+          new TransformCost(
+            points.first.x(),
+            points.first.y(),
+            layer.meters_per_pixel,
+            points.second.x(),
+            points.second.y()),
+          nullptr,
+          &p.yaw,
+          &p.scale,
+          &p.translation[0]);
+        num_constraints++;
+      }
+      if (!layer.points.empty())
+        ceres_problem.SetParameterLowerBound(&p.scale, 0, 0.01);
+    }
+  }
+
+  if (num_constraints == 0)
+  {
+    solution.summary = "no constraints";
+    return solution;
+  }
+
+  CancelCallback cancel_callback(cancel);
+  ceres::Solver::Options options;
+  options.linear_solver_type = ceres::SPARSE_SCHUR;
+  if (ceres::IsSparseLinearAlgebraLibraryTypeAvailable(ceres::SUITE_SPARSE))
+    options.sparse_linear_algebra_library_type = ceres::SUITE_SPARSE;
+  else if (ceres::IsSparseLinearAlgebraLibraryTypeAvailable(
+      ceres::EIGEN_SPARSE))
+    options.sparse_linear_algebra_library_type = ceres::EIGEN_SPARSE;
+  else
+    options.linear_solver_type = ceres::DENSE_SCHUR;
+  options.num_threads = std::max(1, num_threads);
+  options.max_num_iterations = 100;
+  options.callbacks.push_back(&cancel_callback);
+  ceres::Solver::Summary summary;
+  ceres::Solve(options, &ceres_problem, &summary);
+
+  solution.summary = summary.BriefReport();
+  if (summary.termination_type == ceres::USER_FAILURE ||
+    !summary.IsSolutionUsable())
+    return solution;
+  solution.solved = true;
+
+  for (int i = 0; i < num_levels; i++)
+  {
+    if (i == ref_idx || !aligned[i])
+      continue;
+    Building::Transform& t = solution.level_transforms[i];
+    t.scale = level_parameters[i][0];
+    t.dx = level_parameters[i][1];
+    t.dy = level_parameters[i][2];
+  }
+  for (const auto& name : fiducials)
+  {
+    const auto& on = name.second;
+    for (std::size_t a = 0; a < on.size(); a++)
+    {
+      for (std::size_t b = a + 1; b < on.size(); b++)
+      {
+        if (!aligned[on[a].first] || !aligned[on[b].first])
+          continue;
+        const QPointF d =
+          apply(level_parameters[on[a].first].data(), on[a].second) -
+          apply(level_parameters[on[b].first].data(), on[b].second);
+        Residual residual;
+        residual.kind = FIDUCIAL;
+        residual.level_idx = on[a].first;
+        residual.other_idx = on[b].first;
+        residual.name = name.first;
+        residual.meters = problem.reference_meters_per_pixel *
+          std::hypot(d.x(), d.y());
+        solution.residuals.push_back(residual);
+      }
+    }
+  }
+
+  for (std::size_t i = 0; i < problem.layers.size(); i++)
+  {
+    for (std::size_t j = 0; j < problem.layers[i].size(); j++)
+    {
+      const Level::LayerProblem& layer = problem.layers[i][j];
+      if (layer.points.empty())
+        continue;
+      const LayerParameters& p = layer_parameters[i][j];
+      const double* parameters[3] = {&p.yaw, &p.scale, p.translation};
+      double sum_squares = 0.0;
+      for (const auto& points : layer.points)
+      {
+        const TransformCost cost(
+          points.first.x(),
+          points.first.y(),
+          layer.meters_per_pixel,
+          points.second.x(),
+          points.second.y());
+        double r[2];
+        cost.Evaluate(parameters, r, nullptr);
+        Residual residual;
+        residual.kind = FEATURE;
+        residual.level_idx = static_cast<int>(i);
+        residual.other_idx = layer.layer_idx;
+        residual.name = layer.layer_name;
+        residual.meters = layer.meters_per_pixel * std::hypot(r[0], r[1]);
+        sum_squares += residual.meters * residual.meters;
+        solution.residuals.push_back(residual);
+      }
+
+      Level::LayerSolution& layer_solution = solution.layer_solutions[i][j];
+      layer_solution.solved = true;
+      layer_solution.transform.setYaw(p.yaw);
+      layer_solution.transform.setScale(p.scale);
+      layer_solution.transform.setTranslation(
+        QPointF(p.translation[0], p.translation[1]));
+      char rms[80];
+      std::snprintf(rms, sizeof(rms), "%zu constraints, rms %.3f m",
+        layer.points.size(),
+        std::sqrt(sum_squares / layer.points.size()));
+      layer_solution.summary = rms;
+    }
+  }
+  return solution;
+}
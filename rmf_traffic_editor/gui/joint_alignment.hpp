@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef TRAFFIC_EDITOR__JOINT_ALIGNMENT_HPP
+#define TRAFFIC_EDITOR__JOINT_ALIGNMENT_HPP
+
+#include <atomic>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <QPointF>
+
+#include "building.h"
+
+//=============================================================================
+/// One least-squares problem over the transforms of a whole building: the
+/// transform of each level to the reference level, from the fiducials of
+/// the same name on any two levels (not only those on the reference
+/// level), and the transform of each layer to its floorplan, from the
+/// feature constraints. Fitted one by one, each level only agrees with the
+/// reference level, and a level which only shares fiducials with its
+/// neighbours isn't aligned at all; solved together, the errors are spread
+/// consistently over the tower.
+///
+/// Each residual touches at most two levels, or one layer, so the problem
+/// is sparse, and Ceres solves it with its sparse Schur solver (on CHOLMOD
+/// where Ceres has SuiteSparse), in as many threads as it is given; that
+/// keeps hundreds of layers and levels quick. Fiducials are matched with a
+/// Huber loss, so that one which is misplaced has little pull.
+class JointAlignment
+{
+public:
+  struct LevelProblem
+  {
+    std::string name;
+    Building::Transform initial;  // warm start, to reference level pixels
+    /// The first fiducial of each name, in level pixels
+    std::vector<std::pair<std::string, QPointF>> fiducials;
+  };
+
+  struct Problem
+  {
+    int reference_level_idx = 0;
+    double reference_meters_per_pixel = 1.0;
+    double inlier_meters = 0.5;  // past this fiducials are down-weighted
+    std::vector<LevelProblem> levels;
+
+    /// The layer problems of each level, or empty to leave the layers be
+    std::vector<std::vector<Level::LayerProblem>> layers;
+  };
+
+  enum ConstraintKind
+  {
+    FIDUCIAL = 0,
+    FEATURE
+  };
+
+  /// How far apart the solution leaves the two ends of a constraint
+  struct Residual
+  {
+    ConstraintKind kind = FIDUCIAL;
+    int level_idx = 0;
+    int other_idx = 0;  // the other level of a fiducial, or the layer
+    std::string name;  // of the fiducial, or of the layer
+    double meters = 0.0;
+  };
+
+  struct Solution
+  {
+    bool solved = false;
+    std::vector<Building::Transform> level_transforms;  // by level
+
+    /// As Problem::layers; only those with constraints are solved
+    std::vector<std::vector<Level::LayerSolution>> layer_solutions;
+
+    std::vector<Residual> residuals;
+    std::string summary;
+  };
+
+  /// Copy the constraints out of the building, so that solve() can run off
+  /// the GUI thread. The levels start from initial, which is by level.
+  static Problem make_problem(
+    Building& building,
+    const std::vector<Building::Transform>& initial,
+    const bool with_layers);
+
+  /// Thread-safe. The solve stops early, unsolved, once *cancel is set.
+  /// Levels which don't share two fiducials with the reference level, or
+  /// with a level which does, keep their initial transforms.
+  static Solution solve(
+    const Problem& problem,
+    const int num_threads = 1,
+    const std::atomic<bool>* cancel = nullptr);
+};
+
+#endif
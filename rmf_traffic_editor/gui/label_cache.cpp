@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <utility>
+
+#include "label_cache.hpp"
+
+// a level of 40k named vertices fits many times over; past this, the
+// names of levels that were closed or renamed are let go all at once
+static const std::size_t MAX_TEXTS = 500000;
+
+// fonts and layouts may only be used from the GUI thread, so no locking
+static std::map<int, QFont>& label_fonts()
+{
+  static std::map<int, QFont> fonts;
+  return fonts;
+}
+
+static std::map<std::pair<QString, int>, QStaticText>& label_texts()
+{
+  static std::map<std::pair<QString, int>, QStaticText> texts;
+  return texts;
+}
+
+static int size_tier(const double point_size)
+{
+  return std::max(1, static_cast<int>(std::lround(point_size * 4.0)));
+}
+
+QFont LabelCache::font(const double point_size)
+{
+  auto& fonts = label_fonts();
+  const int tier = size_tier(point_size);
+  auto it = fonts.find(tier);
+  if (it != fonts.end())
+    return it->second;
+
+  QFont font("Helvetica");
+  font.setPointSizeF(tier / 4.0);
+  fonts[tier] = font;
+  return font;
+}
+
+QStaticText LabelCache::text(const QString& text, const QFont& font)
+{
+  auto& texts = label_texts();
+  const std::pair<QString, int> key(text, size_tier(font.pointSizeF()));
+  auto it = texts.find(key);
+  if (it != texts.end())
+    return it->second;
+
+  if (texts.size() >= MAX_TEXTS)
+    texts.clear();
+
+  QStaticText static_text(text);
+  static_text.setTextFormat(Qt::PlainText);  // names aren't markup
+  static_text.setPerformanceHint(QStaticText::AggressiveCaching);
+  static_text.prepare(QTransform(), font);
+  texts[key] = static_text;
+  return static_text;
+}
+
+void LabelCache::clear()
+{
+  label_fonts().clear();
+  label_texts().clear();
+}
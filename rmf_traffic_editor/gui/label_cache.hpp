@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__LABEL_CACHE_HPP
+#define TRAFFIC_EDITOR__LABEL_CACHE_HPP
+
+#include <QFont>
+#include <QStaticText>
+#include <QString>
+
+//=============================================================================
+/// Process-wide cache of the fonts and laid-out text of entity names.
+/// Fonts are kept per size tier (a quarter of a point), and each (name,
+/// tier) pair is laid out into a QStaticText only the first time it is
+/// requested; later requests return an implicitly-shared copy.
+class LabelCache
+{
+public:
+  /// The label font, at the size tier nearest to point_size
+  static QFont font(const double point_size);
+
+  /// The text of a label, laid out in the given font
+  static QStaticText text(const QString& text, const QFont& font);
+
+  static void clear();
+};
+
+#endif
@@ -0,0 +1,375 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "lane_conflict_checker.hpp"
+#include "level.h"
+
+using std::vector;
+typedef SegmentRTree::Segment Segment;
+
+namespace {
+
+double cross(
+  const double ax,
+  const double ay,
+  const double bx,
+  const double by,
+  const double cx,
+  const double cy)
+{
+  return (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+}
+
+/// Whether (x, y), known to be in line with the segment, lies on it
+bool on_segment(const Segment& s, const double x, const double y)
+{
+  const double eps = 1e-9;
+  return x >= std::min(s.x0, s.x1) - eps && x <= std::max(s.x0, s.x1) + eps &&
+    y >= std::min(s.y0, s.y1) - eps && y <= std::max(s.y0, s.y1) + eps;
+}
+
+/// Whether the segments touch or cross, and a point they have in common
+bool intersection(const Segment& a, const Segment& b, double& x, double& y)
+{
+  const double d0 = cross(a.x0, a.y0, a.x1, a.y1, b.x0, b.y0);
+  const double d1 = cross(a.x0, a.y0, a.x1, a.y1, b.x1, b.y1);
+  const double d2 = cross(b.x0, b.y0, b.x1, b.y1, a.x0, a.y0);
+  const double d3 = cross(b.x0, b.y0, b.x1, b.y1, a.x1, a.y1);
+
+  if (((d0 > 0 && d1 < 0) || (d0 < 0 && d1 > 0)) &&
+    ((d2 > 0 && d3 < 0) || (d2 < 0 && d3 > 0)))
+  {
+    const double t = d2 / (d2 - d3);
+    x = a.x0 + t * (a.x1 - a.x0);
+    y = a.y0 + t * (a.y1 - a.y0);
+    return true;
+  }
+
+  // an end of one on the other
+  if (d0 == 0 && on_segment(a, b.x0, b.y0))
+  {
+    x = b.x0;
+    y = b.y0;
+    return true;
+  }
+  if (d1 == 0 && on_segment(a, b.x1, b.y1))
+  {
+    x = b.x1;
+    y = b.y1;
+    return true;
+  }
+  if (d2 == 0 && on_segment(b, a.x0, a.y0))
+  {
+    x = a.x0;
+    y = a.y0;
+    return true;
+  }
+  if (d3 == 0 && on_segment(b, a.x1, a.y1))
+  {
+    x = a.x1;
+    y = a.y1;
+    return true;
+  }
+  return false;
+}
+
+/// Closest point of the segment to (x, y)
+void closest_point(
+  const Segment& s,
+  const double x,
+  const double y,
+  double& cx,
+  double& cy)
+{
+  const double dx = s.x1 - s.x0;
+  const double dy = s.y1 - s.y0;
+  const double length_squared = dx * dx + dy * dy;
+  double t = 0.0;
+  if (length_squared > 0.0)
+    t = std::max(0.0, std::min(1.0,
+      ((x - s.x0) * dx + (y - s.y0) * dy) / length_squared));
+  cx = s.x0 + t * dx;
+  cy = s.y0 + t * dy;
+}
+
+/// Distance between segments which don't intersect, and the point of
+/// the first which is closest to the second
+double segment_distance(
+  const Segment& a,
+  const Segment& b,
+  double& x,
+  double& y)
+{
+  // the closest pair has an end of one of the segments in it
+  double best = 1e100;
+  auto consider = [&](
+    const double px,
+    const double py,
+    const Segment& s,
+    const bool on_a)
+    {
+      double cx = 0.0;
+      double cy = 0.0;
+      closest_point(s, px, py, cx, cy);
+      const double d = std::hypot(px - cx, py - cy);
+      if (d < best)
+      {
+        best = d;
+        x = on_a ? px : cx;
+        y = on_a ? py : cy;
+      }
+    };
+  consider(a.x0, a.y0, b, true);
+  consider(a.x1, a.y1, b, true);
+  consider(b.x0, b.y0, a, false);
+  consider(b.x1, b.y1, a, false);
+  return best;
+}
+
+bool shares_vertex(
+  const int a_start,
+  const int a_end,
+  const int b_start,
+  const int b_end)
+{
+  return a_start == b_start || a_start == b_end ||
+    a_end == b_start || a_end == b_end;
+}
+
+}  // anonymous namespace
+
+//=============================================================================
+bool LaneConflictChecker::IndexedEdge::operator==(
+  const IndexedEdge& other) const
+{
+  return role == other.role &&
+    graph_idx == other.graph_idx &&
+    start_idx == other.start_idx &&
+    end_idx == other.end_idx &&
+    segment.x0 == other.segment.x0 &&
+    segment.y0 == other.segment.y0 &&
+    segment.x1 == other.segment.x1 &&
+    segment.y1 == other.segment.y1 &&
+    clearance == other.clearance;
+}
+
+//=============================================================================
+void LaneConflictChecker::clear()
+{
+  _valid = false;
+  _edges.clear();
+  _lane_tree.clear();
+  _wall_tree.clear();
+  _lane_conflicts.clear();
+  _conflicts.clear();
+  _max_clearance = 0.0;
+  _num_checked = 0;
+}
+
+void LaneConflictChecker::update(const Level& level)
+{
+  _num_checked = 0;
+  if (_valid && _revision == level.revision())
+    return;
+  if (_meters_per_pixel != level.drawing_meters_per_pixel)
+    clear();  // every clearance is different
+  _meters_per_pixel = level.drawing_meters_per_pixel;
+
+  const int num_vertices = static_cast<int>(level.vertices.size());
+  vector<IndexedEdge> edges(level.edges.size());
+  double max_clearance = 0.0;
+  for (std::size_t i = 0; i < level.edges.size(); i++)
+  {
+    const Edge& edge = level.edges[i];
+    IndexedEdge& indexed = edges[i];
+    if (edge.start_idx < 0 || edge.start_idx >= num_vertices ||
+      edge.end_idx < 0 || edge.end_idx >= num_vertices ||
+      edge.start_idx == edge.end_idx)
+      continue;
+    if (edge.type == Edge::LANE)
+    {
+      indexed.role = LANE;
+      indexed.graph_idx = edge.get_graph_idx();
+    }
+    else if (edge.type == Edge::HUMAN_LANE)
+    {
+      indexed.role = HUMAN_LANE;
+      if (edge.get_width() > 0.0 && _meters_per_pixel > 0.0)
+        indexed.clearance = 0.5 * edge.get_width() / _meters_per_pixel;
+    }
+    else if (edge.type == Edge::WALL)
+      indexed.role = WALL;
+    else
+      continue;
+    indexed.start_idx = edge.start_idx;
+    indexed.end_idx = edge.end_idx;
+    const Vertex& start = level.vertices[edge.start_idx];
+    const Vertex& end = level.vertices[edge.end_idx];
+    indexed.segment.x0 = start.x;
+    indexed.segment.y0 = start.y;
+    indexed.segment.x1 = end.x;
+    indexed.segment.y1 = end.y;
+    max_clearance = std::max(max_clearance, indexed.clearance);
+  }
+  _max_clearance = max_clearance;
+
+  // move the edges that changed, remembering where they were and are
+  vector<Segment> moved;
+  const std::size_t num_edges = std::max(edges.size(), _edges.size());
+  vector<char> dirty(edges.size(), 0);
+  for (std::size_t i = 0; i < num_edges; i++)
+  {
+    const IndexedEdge none;
+    const IndexedEdge& before = i < _edges.size() ? _edges[i] : none;
+    const IndexedEdge& after = i < edges.size() ? edges[i] : none;
+    if (_valid && before == after)
+      continue;
+    const int id = static_cast<int>(i);
+    if (before.role != NONE)
+    {
+      moved.push_back(before.segment);
+      if (before.role == WALL)
+        _wall_tree.remove(id);
+      else
+        _lane_tree.remove(id);
+    }
+    if (after.role != NONE)
+    {
+      moved.push_back(after.segment);
+      if (after.role == WALL)
+        _wall_tree.insert(id, after.segment);
+      else
+      {
+        _lane_tree.insert(id, after.segment);
+        dirty[i] = 1;
+      }
+    }
+  }
+  _edges = std::move(edges);
+  _lane_conflicts.resize(_edges.size());
+
+  // and the lanes near enough to them to have had or have a conflict
+  vector<int> ids;
+  for (const Segment& s : moved)
+  {
+    ids.clear();
+    _lane_tree.intersecting(
+      std::min(s.x0, s.x1) - _max_clearance,
+      std::min(s.y0, s.y1) - _max_clearance,
+      std::max(s.x0, s.x1) + _max_clearance,
+      std::max(s.y0, s.y1) + _max_clearance,
+      ids);
+    for (const int id : ids)
+      dirty[id] = 1;
+  }
+
+  for (std::size_t i = 0; i < _edges.size(); i++)
+  {
+    if (_edges[i].role != LANE && _edges[i].role != HUMAN_LANE)
+      _lane_conflicts[i].clear();
+    else if (dirty[i])
+    {
+      _lane_conflicts[i].clear();
+      check_lane(static_cast<int>(i), _lane_conflicts[i]);
+      _num_checked++;
+    }
+  }
+
+  _conflicts.clear();
+  for (const vector<Conflict>& lane_conflicts : _lane_conflicts)
+  {
+    for (const Conflict& conflict : lane_conflicts)
+    {
+      if (conflict.kind != LANE_LANE || conflict.edge_idx < conflict.other_idx)
+        _conflicts.push_back(conflict);
+    }
+  }
+
+  _revision = level.revision();
+  _valid = true;
+}
+
+void LaneConflictChecker::check_lane(
+  const int edge_idx,
+  vector<Conflict>& conflicts) const
+{
+  const IndexedEdge& lane = _edges[edge_idx];
+  const Segment& s = lane.segment;
+  const double margin = lane.clearance;
+  vector<int> ids;
+
+  _wall_tree.intersecting(
+    std::min(s.x0, s.x1) - margin,
+    std::min(s.y0, s.y1) - margin,
+    std::max(s.x0, s.x1) + margin,
+    std::max(s.y0, s.y1) + margin,
+    ids);
+  for (const int wall_idx : ids)
+  {
+    const IndexedEdge& wall = _edges[wall_idx];
+    Conflict conflict;
+    conflict.edge_idx = edge_idx;
+    conflict.other_idx = wall_idx;
+    if (!shares_vertex(
+        lane.start_idx, lane.end_idx, wall.start_idx, wall.end_idx) &&
+      intersection(s, wall.segment, conflict.x, conflict.y))
+    {
+      conflict.kind = LANE_WALL;
+      conflicts.push_back(conflict);
+    }
+    else if (margin > 0.0)
+    {
+      const double d =
+        segment_distance(s, wall.segment, conflict.x, conflict.y);
+      if (d < margin)
+      {
+        conflict.kind = CLEARANCE;
+        conflict.distance = d * _meters_per_pixel;
+        conflicts.push_back(conflict);
+      }
+    }
+  }
+
+  ids.clear();
+  _lane_tree.intersecting(
+    std::min(s.x0, s.x1),
+    std::min(s.y0, s.y1),
+    std::max(s.x0, s.x1),
+    std::max(s.y0, s.y1),
+    ids);
+  for (const int other_idx : ids)
+  {
+    const IndexedEdge& other = _edges[other_idx];
+    // robots of different fleets, and people, are free to cross
+    if (other_idx == edge_idx ||
+      other.role != lane.role ||
+      other.graph_idx != lane.graph_idx ||
+      shares_vertex(
+        lane.start_idx, lane.end_idx, other.start_idx, other.end_idx))
+      continue;
+    Conflict conflict;
+    conflict.kind = LANE_LANE;
+    conflict.edge_idx = edge_idx;
+    conflict.other_idx = other_idx;
+    if (intersection(s, other.segment, conflict.x, conflict.y))
+      conflicts.push_back(conflict);
+  }
+}
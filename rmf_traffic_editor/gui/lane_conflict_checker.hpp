@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__LANE_CONFLICT_CHECKER_HPP
+#define TRAFFIC_EDITOR__LANE_CONFLICT_CHECKER_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include "segment_rtree.hpp"
+
+class Level;
+
+//=============================================================================
+/// Finds the lanes of a level which can't be driven (or walked) as drawn:
+/// lanes crossing walls, lanes of the same graph crossing each other
+/// without a vertex where they meet, and human lanes which come closer to
+/// a wall than half their width (see Edge::get_width()).
+///
+/// The lanes and walls are kept in R-trees between updates. An update
+/// compares each edge with what it was last time, moves only the ones
+/// that changed in the trees, and checks again only the lanes near them,
+/// so the check can stay on while the level is edited.
+class LaneConflictChecker
+{
+public:
+  enum Kind
+  {
+    LANE_WALL = 0,
+    LANE_LANE,
+    CLEARANCE
+  };
+
+  struct Conflict
+  {
+    Kind kind = LANE_WALL;
+    int edge_idx = -1;  // the lane
+    int other_idx = -1;  // the wall, or the other lane
+    double x = 0.0;  // where, in scene pixels
+    double y = 0.0;
+    double distance = 0.0;  // meters to the wall, for CLEARANCE
+  };
+
+  /// Bring the conflicts up to date with the edges of the level
+  void update(const Level& level);
+
+  void clear();
+
+  /// Every conflict; a pair of crossing lanes is reported once
+  const std::vector<Conflict>& conflicts() const { return _conflicts; }
+
+  /// Number of lanes the last update() checked again
+  int num_checked() const { return _num_checked; }
+
+private:
+  enum Role
+  {
+    NONE = 0,
+    LANE,
+    HUMAN_LANE,
+    WALL
+  };
+
+  /// What an edge was checked as when it was last seen
+  struct IndexedEdge
+  {
+    Role role = NONE;
+    int graph_idx = 0;
+    int start_idx = -1;
+    int end_idx = -1;
+    SegmentRTree::Segment segment;
+    double clearance = 0.0;  // scene pixels
+
+    bool operator==(const IndexedEdge& other) const;
+    bool operator!=(const IndexedEdge& other) const
+    {
+      return !(*this == other);
+    }
+  };
+
+  bool _valid = false;
+  std::size_t _revision = 0;
+  double _meters_per_pixel = 0.0;
+  double _max_clearance = 0.0;
+  int _num_checked = 0;
+
+  std::vector<IndexedEdge> _edges;
+  SegmentRTree _lane_tree;
+  SegmentRTree _wall_tree;
+
+  /// The conflicts of each lane, by edge index. Crossing lanes are in
+  /// the lists of both.
+  std::vector<std::vector<Conflict>> _lane_conflicts;
+  std::vector<Conflict> _conflicts;
+
+  void check_lane(const int edge_idx, std::vector<Conflict>& conflicts) const;
+};
+
+#endif
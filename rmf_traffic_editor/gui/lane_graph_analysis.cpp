@@ -0,0 +1,412 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <set>
+
+#include "lane_graph_analysis.hpp"
+#include "level.h"
+#include "logging.hpp"
+
+using std::vector;
+
+//=============================================================================
+bool LaneGraphAnalysis::EdgeArcs::operator==(const EdgeArcs& other) const
+{
+  if (lane != other.lane)
+    return false;
+  return !lane || (graph_idx == other.graph_idx &&
+    start_idx == other.start_idx && end_idx == other.end_idx &&
+    bidirectional == other.bidirectional);
+}
+
+//=============================================================================
+void LaneGraphAnalysis::clear()
+{
+  _num_vertices = 0;
+  _edge_arcs.clear();
+  _graphs.clear();
+  _components.clear();
+  _num_searched = 0;
+}
+
+LaneGraphAnalysis::Graph& LaneGraphAnalysis::graph(const int graph_idx)
+{
+  auto it = _graphs.find(graph_idx);
+  if (it != _graphs.end())
+    return it->second;
+
+  Graph& g = _graphs[graph_idx];
+  g.out.resize(_num_vertices);
+  g.in.resize(_num_vertices);
+  g.component.assign(_num_vertices, -1);
+  g.index.assign(_num_vertices, -1);
+  g.low.assign(_num_vertices, 0);
+  g.mark.assign(_num_vertices, 0);
+  g.back_mark.assign(_num_vertices, 0);
+  return g;
+}
+
+void LaneGraphAnalysis::add_arc(Graph& g, const int u, const int v)
+{
+  g.out[u].push_back(v);
+  g.in[v].push_back(u);
+  for (const int w : {u, v})
+  {
+    if (g.component[w] >= 0)
+      continue;
+    g.component[w] = g.next_component;
+    g.members[g.next_component].push_back(w);
+    g.next_component++;
+  }
+}
+
+void LaneGraphAnalysis::remove_arc(Graph& g, const int u, const int v)
+{
+  auto out_it = std::find(g.out[u].begin(), g.out[u].end(), v);
+  if (out_it != g.out[u].end())
+    g.out[u].erase(out_it);
+  auto in_it = std::find(g.in[v].begin(), g.in[v].end(), u);
+  if (in_it != g.in[v].end())
+    g.in[v].erase(in_it);
+}
+
+void LaneGraphAnalysis::update(const Level& level)
+{
+  _num_searched = 0;
+  if (level.vertices.size() != _num_vertices)
+  {
+    // vertex indices have moved, so nothing kept can be trusted
+    clear();
+    _num_vertices = level.vertices.size();
+  }
+
+  vector<EdgeArcs> edge_arcs(level.edges.size());
+  const int num_vertices = static_cast<int>(_num_vertices);
+  for (std::size_t i = 0; i < level.edges.size(); i++)
+  {
+    const Edge& edge = level.edges[i];
+    if (edge.type != Edge::LANE ||
+      edge.start_idx < 0 || edge.start_idx >= num_vertices ||
+      edge.end_idx < 0 || edge.end_idx >= num_vertices ||
+      edge.start_idx == edge.end_idx)
+      continue;
+    EdgeArcs& arcs = edge_arcs[i];
+    arcs.lane = true;
+    arcs.graph_idx = edge.get_graph_idx();
+    arcs.start_idx = edge.start_idx;
+    arcs.end_idx = edge.end_idx;
+    arcs.bidirectional = edge.is_bidirectional();
+  }
+
+  struct Arc
+  {
+    int graph_idx;
+    int u, v;
+  };
+  vector<Arc> removed;
+  vector<Arc> added;
+  auto add_arcs = [](vector<Arc>& arcs, const EdgeArcs& edge)
+    {
+      arcs.push_back({edge.graph_idx, edge.start_idx, edge.end_idx});
+      if (edge.bidirectional)
+        arcs.push_back({edge.graph_idx, edge.end_idx, edge.start_idx});
+    };
+  const std::size_t num_edges = std::max(edge_arcs.size(), _edge_arcs.size());
+  for (std::size_t i = 0; i < num_edges; i++)
+  {
+    const EdgeArcs before =
+      i < _edge_arcs.size() ? _edge_arcs[i] : EdgeArcs();
+    const EdgeArcs now = i < edge_arcs.size() ? edge_arcs[i] : EdgeArcs();
+    if (before == now)
+      continue;
+    if (before.lane)
+      add_arcs(removed, before);
+    if (now.lane)
+      add_arcs(added, now);
+  }
+  _edge_arcs = std::move(edge_arcs);
+  if (removed.empty() && added.empty())
+    return;
+
+  for (const Arc& arc : removed)
+    remove_arc(graph(arc.graph_idx), arc.u, arc.v);
+  for (const Arc& arc : added)
+    add_arc(graph(arc.graph_idx), arc.u, arc.v);
+
+  // a lane removed from inside a component may have split it
+  std::map<int, std::set<int>> split;
+  for (const Arc& arc : removed)
+  {
+    const Graph& g = graph(arc.graph_idx);
+    if (g.component[arc.u] == g.component[arc.v])
+      split[arc.graph_idx].insert(g.component[arc.u]);
+  }
+  for (const auto& graph_split : split)
+  {
+    Graph& g = graph(graph_split.first);
+    for (const int c : graph_split.second)
+    {
+      auto it = g.members.find(c);
+      if (it == g.members.end())
+        continue;
+      const vector<int> vertices = std::move(it->second);
+      g.members.erase(it);
+      search(g, vertices);
+    }
+  }
+
+  // vertices without lanes left leave the graph; they are in components
+  // of their own by now, having been split off
+  for (const Arc& arc : removed)
+  {
+    Graph& g = graph(arc.graph_idx);
+    for (const int w : {arc.u, arc.v})
+    {
+      const int c = g.component[w];
+      if (c < 0 || !g.out[w].empty() || !g.in[w].empty())
+        continue;
+      g.members.erase(c);
+      g.component[w] = -1;
+    }
+  }
+
+  // a lane added between components joins all those on a cycle through it
+  for (const Arc& arc : added)
+  {
+    Graph& g = graph(arc.graph_idx);
+    if (g.component[arc.u] != g.component[arc.v])
+      merge_through(g, arc.u, arc.v);
+  }
+
+  classify();
+  qCDebug(lc_edit,
+    "lane graph analysis: %d arcs removed, %d added, %d vertices searched, "
+    "%d components outside the main ones",
+    static_cast<int>(removed.size()),
+    static_cast<int>(added.size()),
+    _num_searched,
+    static_cast<int>(_components.size()));
+}
+
+void LaneGraphAnalysis::search(Graph& g, const vector<int>& vertices)
+{
+  // Tarjan's algorithm, without recursion, within the given vertices only
+  _num_searched += static_cast<int>(vertices.size());
+  const int stamp = ++g.stamp;
+  for (const int v : vertices)
+  {
+    g.mark[v] = stamp;
+    g.index[v] = -1;
+  }
+
+  struct Frame
+  {
+    int v;
+    std::size_t next;
+  };
+  vector<Frame> frames;
+  vector<int> stack;
+  vector<char> on_stack(_num_vertices, 0);
+  int counter = 0;
+  for (const int root : vertices)
+  {
+    if (g.index[root] >= 0)
+      continue;
+    g.index[root] = g.low[root] = counter++;
+    stack.push_back(root);
+    on_stack[root] = 1;
+    frames.push_back({root, 0});
+
+    while (!frames.empty())
+    {
+      Frame& frame = frames.back();
+      const int u = frame.v;
+      if (frame.next < g.out[u].size())
+      {
+        const int w = g.out[u][frame.next++];
+        if (g.mark[w] != stamp)
+          continue;
+        if (g.index[w] < 0)
+        {
+          g.index[w] = g.low[w] = counter++;
+          stack.push_back(w);
+          on_stack[w] = 1;
+          frames.push_back({w, 0});  // invalidates frame
+        }
+        else if (on_stack[w])
+          g.low[u] = std::min(g.low[u], g.index[w]);
+        continue;
+      }
+
+      frames.pop_back();
+      if (!frames.empty())
+      {
+        const int parent = frames.back().v;
+        g.low[parent] = std::min(g.low[parent], g.low[u]);
+      }
+      if (g.low[u] != g.index[u])
+        continue;
+
+      const int c = g.next_component++;
+      vector<int>& members = g.members[c];
+      int w = -1;
+      do
+      {
+        w = stack.back();
+        stack.pop_back();
+        on_stack[w] = 0;
+        g.component[w] = c;
+        members.push_back(w);
+      } while (w != u);
+    }
+  }
+}
+
+void LaneGraphAnalysis::merge_through(Graph& g, const int u, const int v)
+{
+  // everything reachable from v...
+  const int forward = ++g.stamp;
+  vector<int> queue(1, v);
+  g.mark[v] = forward;
+  for (std::size_t i = 0; i < queue.size(); i++)
+  {
+    for (const int w : g.out[queue[i]])
+    {
+      if (g.mark[w] == forward)
+        continue;
+      g.mark[w] = forward;
+      queue.push_back(w);
+    }
+  }
+  _num_searched += static_cast<int>(queue.size());
+  if (g.mark[u] != forward)
+    return;  // no cycle; the lane only links two components one way
+
+  // ...that can also reach u is on a cycle through the new lane
+  const int backward = ++g.stamp;
+  std::set<int> merged;
+  queue.assign(1, u);
+  g.back_mark[u] = backward;
+  for (std::size_t i = 0; i < queue.size(); i++)
+  {
+    merged.insert(g.component[queue[i]]);
+    for (const int w : g.in[queue[i]])
+    {
+      if (g.mark[w] != forward || g.back_mark[w] == backward)
+        continue;
+      g.back_mark[w] = backward;
+      queue.push_back(w);
+    }
+  }
+
+  const int target = g.component[u];
+  vector<int>& target_members = g.members[target];
+  for (const int c : merged)
+  {
+    if (c == target)
+      continue;
+    auto it = g.members.find(c);
+    if (it == g.members.end())
+      continue;
+    for (const int w : it->second)
+    {
+      g.component[w] = target;
+      target_members.push_back(w);
+    }
+    g.members.erase(it);
+  }
+}
+
+void LaneGraphAnalysis::classify()
+{
+  _components.clear();
+  for (const auto& graph_it : _graphs)
+  {
+    const Graph& g = graph_it.second;
+    if (g.members.size() <= 1)
+      continue;
+
+    // the biggest, or of those the one with the lowest vertex, so that
+    // the choice doesn't depend on how the components came about
+    int main_component = -1;
+    std::size_t main_size = 0;
+    int main_vertex = 0;
+    for (const auto& members : g.members)
+    {
+      const int first_vertex =
+        *std::min_element(members.second.begin(), members.second.end());
+      if (members.second.size() > main_size ||
+        (members.second.size() == main_size && first_vertex < main_vertex))
+      {
+        main_component = members.first;
+        main_size = members.second.size();
+        main_vertex = first_vertex;
+      }
+    }
+
+    std::set<int> has_in;
+    std::set<int> has_out;
+    for (std::size_t u = 0; u < g.out.size(); u++)
+    {
+      const int cu = g.component[u];
+      if (cu < 0)
+        continue;
+      for (const int w : g.out[u])
+      {
+        const int cw = g.component[w];
+        if (cw == cu)
+          continue;
+        has_out.insert(cu);
+        has_in.insert(cw);
+      }
+    }
+
+    for (const auto& members : g.members)
+    {
+      const int c = members.first;
+      if (c == main_component)
+        continue;
+      Component component;
+      component.graph_idx = graph_it.first;
+      const bool in = has_in.count(c) > 0;
+      const bool out = has_out.count(c) > 0;
+      if (in && out)
+        component.kind = ONE_WAY;
+      else if (in)
+        component.kind = SINK;
+      else if (out)
+        component.kind = SOURCE;
+      else
+        component.kind = ISLAND;
+      component.vertices = members.second;
+      std::sort(component.vertices.begin(), component.vertices.end());
+      _components.push_back(component);
+    }
+  }
+
+  std::sort(
+    _components.begin(),
+    _components.end(),
+    [](const Component& a, const Component& b)
+    {
+      if (a.graph_idx != b.graph_idx)
+        return a.graph_idx < b.graph_idx;
+      return a.vertices.front() < b.vertices.front();
+    });
+}
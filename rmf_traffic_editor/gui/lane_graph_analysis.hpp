@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__LANE_GRAPH_ANALYSIS_HPP
+#define TRAFFIC_EDITOR__LANE_GRAPH_ANALYSIS_HPP
+
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+class Level;
+
+//=============================================================================
+/// Finds the parts of the lane graphs of a level which robots can't get
+/// around: the strongly connected components of each graph (by
+/// Edge::get_graph_idx()), with one-way lanes followed only one way. The
+/// biggest component of a graph is taken to be the graph proper, and
+/// every other component is reported as a sink (robots can drive in but
+/// not out), a source (they can drive out but never come back), one-way
+/// (they can drive through, but not back) or an island (not connected to
+/// anything).
+///
+/// The components are kept between updates. Lanes that were added merge
+/// the components on the cycles they close, found by searching from the
+/// lane, and lanes that were removed only split the component they were
+/// in, which is searched again on its own. Deleting a vertex renumbers
+/// the ones after it, so that means starting from scratch.
+class LaneGraphAnalysis
+{
+public:
+  enum Kind
+  {
+    MAIN = 0,
+    SINK,
+    SOURCE,
+    ONE_WAY,
+    ISLAND
+  };
+
+  struct Component
+  {
+    int graph_idx = 0;
+    Kind kind = MAIN;
+    std::vector<int> vertices;
+  };
+
+  /// Bring the components up to date with the lanes of the level
+  void update(const Level& level);
+
+  void clear();
+
+  /// The components which aren't the main one of their graph
+  const std::vector<Component>& components() const { return _components; }
+
+  /// Number of vertices whose component was searched for again by the
+  /// last update()
+  int num_searched() const { return _num_searched; }
+
+private:
+  /// What an edge contributed to its graph when it was last seen
+  struct EdgeArcs
+  {
+    bool lane = false;
+    int graph_idx = 0;
+    int start_idx = -1;
+    int end_idx = -1;
+    bool bidirectional = false;
+
+    bool operator==(const EdgeArcs& other) const;
+    bool operator!=(const EdgeArcs& other) const { return !(*this == other); }
+  };
+
+  struct Graph
+  {
+    std::vector<std::vector<int>> out;  // with repeats for repeated lanes
+    std::vector<std::vector<int>> in;
+    std::vector<int> component;  // -1 for vertices without lanes
+    std::unordered_map<int, std::vector<int>> members;
+    int next_component = 0;
+
+    // scratch space of the searches, by vertex
+    std::vector<int> index;
+    std::vector<int> low;
+    std::vector<int> mark;
+    std::vector<int> back_mark;
+    int stamp = 0;
+  };
+
+  std::size_t _num_vertices = 0;
+  std::vector<EdgeArcs> _edge_arcs;
+  std::map<int, Graph> _graphs;
+  std::vector<Component> _components;
+  int _num_searched = 0;
+
+  Graph& graph(const int graph_idx);
+  static void add_arc(Graph& g, const int u, const int v);
+  static void remove_arc(Graph& g, const int u, const int v);
+  void search(Graph& g, const std::vector<int>& vertices);
+  void merge_through(Graph& g, const int u, const int v);
+  void classify();
+};
+
+#endif
@@ -0,0 +1,397 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+#include <QPointF>
+#include <QPolygonF>
+#include <QRectF>
+
+#include "lane_grid_generator.hpp"
+#include "level.h"
+#include "segment_rtree.hpp"
+#include "task_pool.hpp"
+
+namespace {
+
+typedef SegmentRTree::Segment Segment;
+
+/// Whether the closed segments touch or cross
+bool segments_touch(const Segment& a, const Segment& b)
+{
+  const double ax = a.x1 - a.x0;
+  const double ay = a.y1 - a.y0;
+  const double bx = b.x1 - b.x0;
+  const double by = b.y1 - b.y0;
+  const double denominator = ax * by - ay * bx;
+  if (denominator == 0.0)
+    return false;  // parallel; overlaps are caught by the end distances
+  const double dx = b.x0 - a.x0;
+  const double dy = b.y0 - a.y0;
+  const double t = (dx * by - dy * bx) / denominator;
+  const double u = (dx * ay - dy * ax) / denominator;
+  return t >= 0.0 && t <= 1.0 && u >= 0.0 && u <= 1.0;
+}
+
+double segment_distance(const Segment& a, const Segment& b)
+{
+  if (segments_touch(a, b))
+    return 0.0;
+  return std::min(
+    std::min(
+      SegmentRTree::distance_to_segment(a.x0, a.y0, b),
+      SegmentRTree::distance_to_segment(a.x1, a.y1, b)),
+    std::min(
+      SegmentRTree::distance_to_segment(b.x0, b.y0, a),
+      SegmentRTree::distance_to_segment(b.x1, b.y1, a)));
+}
+
+/// The outline of a polygon, by the positions of its vertices
+QPolygonF outline(const Level& level, const Polygon& polygon)
+{
+  QPolygonF points;
+  for (const int idx : polygon.vertices)
+  {
+    if (idx >= 0 && idx < static_cast<int>(level.vertices.size()))
+      points.append(QPointF(level.vertices[idx].x, level.vertices[idx].y));
+  }
+  return points;
+}
+
+void add_ring(const QPolygonF& ring, std::vector<Segment>& segments)
+{
+  for (int i = 0; i < ring.size(); i++)
+  {
+    const QPointF& a = ring[i];
+    const QPointF& b = ring[(i + 1) % ring.size()];
+    Segment segment;
+    segment.x0 = a.x();
+    segment.y0 = a.y();
+    segment.x1 = b.x();
+    segment.y1 = b.y();
+    segments.push_back(segment);
+  }
+}
+
+void build_tree(const std::vector<Segment>& segments, SegmentRTree& tree)
+{
+  std::vector<std::pair<int, Segment>> entries;
+  entries.reserve(segments.size());
+  for (std::size_t i = 0; i < segments.size(); i++)
+    entries.emplace_back(static_cast<int>(i), segments[i]);
+  tree.build(entries);
+}
+
+}  // namespace
+
+const char* LaneGridGenerator::direction_name(const Direction direction)
+{
+  switch (direction)
+  {
+    case BIDIRECTIONAL: return "bidirectional";
+    case ONE_WAY: return "one way";
+    case ALTERNATING: return "alternating";
+    default: return "unknown";
+  }
+}
+
+double LaneGridGenerator::longest_side_orientation(
+  const Level& level,
+  const int polygon_idx)
+{
+  if (polygon_idx < 0 || polygon_idx >= static_cast<int>(level.polygons.size()))
+    return 0.0;
+  const QPolygonF ring = outline(level, level.polygons[polygon_idx]);
+  double longest = 0.0;
+  double degrees = 0.0;
+  for (int i = 0; i < ring.size(); i++)
+  {
+    const QPointF d = ring[(i + 1) % ring.size()] - ring[i];
+    const double length = std::hypot(d.x(), d.y());
+    if (length > longest)
+    {
+      longest = length;
+      degrees = std::atan2(-d.y(), d.x()) * 180.0 / M_PI;  // y is down
+    }
+  }
+  if (degrees > 90.0)
+    degrees -= 180.0;
+  else if (degrees <= -90.0)
+    degrees += 180.0;
+  return degrees;
+}
+
+LaneGridGenerator::Result LaneGridGenerator::generate(
+  const Level& level,
+  const int polygon_idx,
+  const Options& options)
+{
+  Result result;
+  if (polygon_idx < 0 ||
+    polygon_idx >= static_cast<int>(level.polygons.size()) ||
+    level.polygons[polygon_idx].type != Polygon::ROI)
+  {
+    result.error = "Select an ROI polygon to fill with lanes.";
+    return result;
+  }
+  const QPolygonF roi = outline(level, level.polygons[polygon_idx]);
+  if (roi.size() < 3)
+  {
+    result.error = "The ROI polygon has fewer than three vertices.";
+    return result;
+  }
+
+  const double meters_per_pixel = level.drawing_meters_per_pixel > 0.0 ?
+    level.drawing_meters_per_pixel : 1.0;
+  const double aisle_spacing =
+    std::max(0.05, options.aisle_spacing) / meters_per_pixel;
+  const double cross_spacing =
+    std::max(0.05, options.cross_spacing) / meters_per_pixel;
+  const double clearance = std::max(0.0, options.clearance) / meters_per_pixel;
+
+  // u runs along the aisles and v across them, to their left as shown
+  const double radians = options.orientation * M_PI / 180.0;
+  const QPointF u_axis(std::cos(radians), -std::sin(radians));
+  const QPointF v_axis(-std::sin(radians), -std::cos(radians));
+  auto dot = [](const QPointF& a, const QPointF& b)
+    {
+      return a.x() * b.x() + a.y() * b.y();
+    };
+  double u_min = 1e100, u_max = -1e100, v_min = 1e100, v_max = -1e100;
+  for (const QPointF& p : roi)
+  {
+    u_min = std::min(u_min, dot(p, u_axis));
+    u_max = std::max(u_max, dot(p, u_axis));
+    v_min = std::min(v_min, dot(p, v_axis));
+    v_max = std::max(v_max, dot(p, v_axis));
+  }
+
+  // stations along each aisle, and aisles, centered in the extent, so the
+  // outermost are at least half a spacing in from its sides
+  const std::int64_t num_stations = std::max<std::int64_t>(
+    1, static_cast<std::int64_t>((u_max - u_min) / cross_spacing));
+  const std::int64_t num_aisles = std::max<std::int64_t>(
+    1, static_cast<std::int64_t>((v_max - v_min) / aisle_spacing));
+  if (num_stations * num_aisles > MAX_GRID_VERTICES)
+  {
+    result.error = QString(
+      "A grid of %1 by %2 vertices is too large; use wider spacings.")
+      .arg(num_stations).arg(num_aisles);
+    return result;
+  }
+  const int stations = static_cast<int>(num_stations);
+  const int aisles = static_cast<int>(num_aisles);
+  const double u0 =
+    u_min + 0.5 * ((u_max - u_min) - (stations - 1) * cross_spacing);
+  const double v0 =
+    v_min + 0.5 * ((v_max - v_min) - (aisles - 1) * aisle_spacing);
+  auto position = [&](const int station, const int aisle)
+    {
+      return u_axis * (u0 + station * cross_spacing) +
+             v_axis * (v0 + aisle * aisle_spacing);
+    };
+
+  // what the lanes keep clear of, and what they mustn't leave
+  std::vector<Segment> obstacles;
+  for (const Edge& edge : level.edges)
+  {
+    const int num_vertices = static_cast<int>(level.vertices.size());
+    if (edge.type != Edge::WALL ||
+      edge.start_idx < 0 || edge.start_idx >= num_vertices ||
+      edge.end_idx < 0 || edge.end_idx >= num_vertices)
+      continue;
+    Segment segment;
+    segment.x0 = level.vertices[edge.start_idx].x;
+    segment.y0 = level.vertices[edge.start_idx].y;
+    segment.x1 = level.vertices[edge.end_idx].x;
+    segment.y1 = level.vertices[edge.end_idx].y;
+    obstacles.push_back(segment);
+  }
+  std::vector<std::pair<QPolygonF, QRectF>> holes;
+  for (const Polygon& polygon : level.polygons)
+  {
+    if (polygon.type != Polygon::HOLE)
+      continue;
+    const QPolygonF hole = outline(level, polygon);
+    if (hole.size() < 3)
+      continue;
+    holes.emplace_back(hole, hole.boundingRect());
+    add_ring(hole, obstacles);
+  }
+  std::vector<Segment> boundary;
+  add_ring(roi, boundary);
+  SegmentRTree obstacle_tree;
+  build_tree(obstacles, obstacle_tree);
+  SegmentRTree boundary_tree;
+  build_tree(boundary, boundary_tree);
+
+  auto blocked = [&](const Segment& s, std::vector<int>& ids)
+    {
+      ids.clear();
+      boundary_tree.intersecting(
+        std::min(s.x0, s.x1), std::min(s.y0, s.y1),
+        std::max(s.x0, s.x1), std::max(s.y0, s.y1),
+        ids);
+      for (const int id : ids)
+      {
+        if (segments_touch(s, boundary[id]))
+          return true;
+      }
+      ids.clear();
+      obstacle_tree.intersecting(
+        std::min(s.x0, s.x1) - clearance, std::min(s.y0, s.y1) - clearance,
+        std::max(s.x0, s.x1) + clearance, std::max(s.y0, s.y1) + clearance,
+        ids);
+      for (const int id : ids)
+      {
+        if (segment_distance(s, obstacles[id]) <= clearance)
+          return true;
+      }
+      return false;
+    };
+
+  // which vertices of the grid are kept, an aisle at a time
+  std::vector<char> kept(static_cast<std::size_t>(stations) * aisles, 0);
+  TaskPool::instance().parallel_for(
+    aisles,
+    [&](const int aisle)
+    {
+      std::vector<int> ids;
+      for (int station = 0; station < stations; station++)
+      {
+        const QPointF p = position(station, aisle);
+        if (!roi.containsPoint(p, Qt::OddEvenFill))
+          continue;
+        bool in_hole = false;
+        for (const auto& hole : holes)
+        {
+          if (hole.second.contains(p) &&
+            hole.first.containsPoint(p, Qt::OddEvenFill))
+          {
+            in_hole = true;
+            break;
+          }
+        }
+        if (in_hole)
+          continue;
+        Segment point;
+        point.x0 = point.x1 = p.x();
+        point.y0 = point.y1 = p.y();
+        if (clearance > 0.0 && blocked(point, ids))
+          continue;
+        kept[static_cast<std::size_t>(aisle) * stations + station] = 1;
+      }
+    });
+
+  // the lanes along each aisle, and across from it to the next, as pairs
+  // of grid vertices from start to end
+  struct Lane
+  {
+    int start = 0;
+    int end = 0;
+    bool bidirectional = false;
+  };
+  std::vector<std::vector<Lane>> aisle_lanes(aisles);
+  std::vector<int> aisle_blocked(aisles, 0);
+  TaskPool::instance().parallel_for(
+    aisles,
+    [&](const int aisle)
+    {
+      std::vector<int> ids;
+      auto try_lane = [&](
+        const int a_station, const int a_aisle,
+        const int b_station, const int b_aisle,
+        const bool forward, const bool bidirectional)
+        {
+          const int a = a_aisle * stations + a_station;
+          const int b = b_aisle * stations + b_station;
+          if (!kept[a] || !kept[b])
+            return;
+          const QPointF pa = position(a_station, a_aisle);
+          const QPointF pb = position(b_station, b_aisle);
+          Segment segment;
+          segment.x0 = pa.x();
+          segment.y0 = pa.y();
+          segment.x1 = pb.x();
+          segment.y1 = pb.y();
+          if (blocked(segment, ids))
+          {
+            aisle_blocked[aisle]++;
+            return;
+          }
+          Lane lane;
+          lane.start = forward ? a : b;
+          lane.end = forward ? b : a;
+          lane.bidirectional = bidirectional;
+          aisle_lanes[aisle].push_back(lane);
+        };
+
+      const bool aisle_forward =
+        options.aisle_direction != ALTERNATING || aisle % 2 == 0;
+      for (int station = 0; station + 1 < stations; station++)
+        try_lane(
+          station, aisle, station + 1, aisle,
+          aisle_forward,
+          options.aisle_direction == BIDIRECTIONAL);
+      if (aisle + 1 >= aisles)
+        return;
+      for (int station = 0; station < stations; station++)
+        try_lane(
+          station, aisle, station, aisle + 1,
+          options.cross_direction != ALTERNATING || station % 2 == 0,
+          options.cross_direction == BIDIRECTIONAL);
+    });
+
+  // number the grid vertices which have lanes, in grid order
+  std::vector<int> vertex_idx(kept.size(), -1);
+  for (const std::vector<Lane>& lanes : aisle_lanes)
+  {
+    for (const Lane& lane : lanes)
+    {
+      vertex_idx[lane.start] = 0;
+      vertex_idx[lane.end] = 0;
+    }
+  }
+  for (std::size_t i = 0; i < vertex_idx.size(); i++)
+  {
+    if (vertex_idx[i] < 0)
+      continue;
+    vertex_idx[i] = static_cast<int>(result.vertices.size());
+    const QPointF p = position(
+      static_cast<int>(i % stations),
+      static_cast<int>(i / stations));
+    result.vertices.emplace_back(p.x(), p.y());
+  }
+
+  Edge one_way(0, 0, Edge::LANE);
+  one_way.set_graph_idx(options.graph_idx);
+  Edge bidirectional(one_way);
+  bidirectional.params["bidirectional"] = Param(true);
+  for (int aisle = 0; aisle < aisles; aisle++)
+  {
+    result.num_blocked += aisle_blocked[aisle];
+    for (const Lane& lane : aisle_lanes[aisle])
+    {
+      result.edges.push_back(lane.bidirectional ? bidirectional : one_way);
+      result.edges.back().start_idx = vertex_idx[lane.start];
+      result.edges.back().end_idx = vertex_idx[lane.end];
+    }
+  }
+  return result;
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef TRAFFIC_EDITOR__LANE_GRID_GENERATOR_HPP
+#define TRAFFIC_EDITOR__LANE_GRID_GENERATOR_HPP
+
+#include <vector>
+
+#include <QString>
+
+#include "edge.h"
+#include "vertex.h"
+
+class Level;
+
+//=============================================================================
+/// Fills a region of interest polygon with a regular grid of lanes, as for
+/// the rack aisles of a warehouse: aisles at a spacing, turned to an
+/// orientation, joined by cross aisles at another spacing along them. The
+/// grid is centered in the extent of the polygon, half a spacing in from
+/// its sides.
+///
+/// A vertex of the grid is kept if it is inside the polygon, outside every
+/// hole polygon and at least the clearance from every wall and hole
+/// outline; a lane between two kept vertices is kept if it crosses neither
+/// the polygon outline nor a wall or hole outline, and keeps the clearance
+/// from them too. Walls and outlines are found with a SegmentRTree, and the
+/// aisles are checked in parallel on the TaskPool, so tens of thousands of
+/// lanes take a fraction of a second.
+class LaneGridGenerator
+{
+public:
+  enum Direction
+  {
+    BIDIRECTIONAL = 0,
+    ONE_WAY,  // all along the orientation (or across it, to its left)
+    ALTERNATING,  // neighbouring aisles, or cross aisles, run opposite ways
+    NUM_DIRECTIONS
+  };
+
+  static const char* direction_name(const Direction direction);
+
+  struct Options
+  {
+    double aisle_spacing = 3.0;  // meters between neighbouring aisles
+    double cross_spacing = 3.0;  // meters between cross aisles
+
+    /// Of the aisles from the x axis of the level, counterclockwise as
+    /// shown, in degrees
+    double orientation = 0.0;
+
+    Direction aisle_direction = BIDIRECTIONAL;
+    Direction cross_direction = BIDIRECTIONAL;
+    int graph_idx = 0;
+
+    /// Meters the lanes and vertices keep from walls and holes
+    double clearance = 0.3;
+  };
+
+  struct Result
+  {
+    QString error;  // why nothing could be generated, if it couldn't
+
+    /// In the pixels of the level; the edges refer to these vertices,
+    /// counting from 0
+    std::vector<Vertex> vertices;
+    std::vector<Edge> edges;
+
+    int num_blocked = 0;  // lanes between kept vertices which were dropped
+  };
+
+  /// Most vertices a grid may have, kept or not
+  static const int MAX_GRID_VERTICES = 4000000;
+
+  /// Fill polygon polygon_idx of the level, which must be an ROI
+  static Result generate(
+    const Level& level,
+    const int polygon_idx,
+    const Options& options);
+
+  /// The direction of the longest side of the polygon, in degrees as in
+  /// Options::orientation, to line the aisles up with the room by default
+  static double longest_side_orientation(
+    const Level& level,
+    const int polygon_idx);
+};
+
+#endif
@@ -0,0 +1,509 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <map>
+
+#include "lane_path_planner.hpp"
+
+using std::vector;
+
+namespace {
+
+/// The heuristic is shrunk a little, so that it stays below the true cost
+/// where a level's scale or lift position disagrees slightly with the
+/// reference level
+const float HEURISTIC_SLACK = 0.95f;
+
+}  // anonymous namespace
+
+//=============================================================================
+bool LanePathPlanner::LaneKey::operator==(const LaneKey& other) const
+{
+  return start_idx == other.start_idx && end_idx == other.end_idx &&
+    bidirectional == other.bidirectional && speed_limit == other.speed_limit;
+}
+
+//=============================================================================
+void LanePathPlanner::set_options(const Options& options)
+{
+  _options = options;
+  clear();
+}
+
+void LanePathPlanner::clear()
+{
+  _levels.clear();
+  _node_level.clear();
+  _hx.clear();
+  _hy.clear();
+  _lift_arcs.clear();
+  _cost.clear();
+  _parent.clear();
+  _visited.clear();
+  _query = 0;
+  _hierarchy.clear();
+  _costs_revision++;
+}
+
+std::size_t LanePathPlanner::num_arcs() const
+{
+  std::size_t count = 0;
+  for (const LevelGraph& graph : _levels)
+    count += graph.targets.size();
+  for (const auto& arcs : _lift_arcs)
+    count += arcs.second.size();
+  return count;
+}
+
+void LanePathPlanner::update(Building& building)
+{
+  _num_levels_rebuilt = 0;
+  _num_levels_refreshed = 0;
+  _max_speed = static_cast<float>(std::max(_options.speed, 1e-3));
+
+  if (building.levels.size() != _levels.size())
+    _levels.assign(building.levels.size(), LevelGraph());
+
+  // nodes are numbered level after level
+  uint32_t num_nodes = 0;
+  for (std::size_t i = 0; i < building.levels.size(); i++)
+  {
+    LevelGraph& graph = _levels[i];
+    const std::size_t num_vertices = building.levels[i].vertices.size();
+    if (graph.first_node != num_nodes || graph.x.size() != num_vertices)
+      graph.valid = false;
+    graph.first_node = num_nodes;
+    num_nodes += static_cast<uint32_t>(num_vertices);
+  }
+  if (_node_level.size() != num_nodes)
+  {
+    _node_level.resize(num_nodes);
+    _hx.resize(num_nodes);
+    _hy.resize(num_nodes);
+    _cost.resize(num_nodes);
+    _parent.resize(num_nodes);
+    _visited.assign(num_nodes, 0);
+    _query = 0;
+  }
+
+  const int ref_idx = building.get_reference_level_idx();
+  const double ref_meters_per_pixel =
+    building.levels.empty() ?
+    1.0 : building.levels[ref_idx].drawing_meters_per_pixel;
+
+  bool changed = false;
+  for (std::size_t i = 0; i < building.levels.size(); i++)
+  {
+    const Level& level = building.levels[i];
+    LevelGraph& graph = _levels[i];
+    Building::Transform transform =
+      building.get_transform_to_reference(static_cast<int>(i));
+    transform.scale *= ref_meters_per_pixel;  // straight to meters
+    transform.dx *= ref_meters_per_pixel;
+    transform.dy *= ref_meters_per_pixel;
+    if (graph.valid &&
+      graph.revision == level.revision() &&
+      graph.meters_per_pixel == level.drawing_meters_per_pixel &&
+      graph.elevation == level.elevation &&
+      graph.transform.scale == transform.scale &&
+      graph.transform.dx == transform.dx &&
+      graph.transform.dy == transform.dy)
+      continue;
+    changed = true;
+
+    std::fill(
+      _node_level.begin() + graph.first_node,
+      _node_level.begin() + graph.first_node + level.vertices.size(),
+      static_cast<uint16_t>(i));
+
+    vector<LaneKey> lanes;
+    const int num_vertices = static_cast<int>(level.vertices.size());
+    for (const Edge& edge : level.edges)
+    {
+      if (edge.type != Edge::LANE ||
+        edge.start_idx < 0 || edge.start_idx >= num_vertices ||
+        edge.end_idx < 0 || edge.end_idx >= num_vertices ||
+        edge.start_idx == edge.end_idx)
+        continue;
+      if (_options.graph_idx >= 0 && edge.get_graph_idx() != _options.graph_idx)
+        continue;
+      LaneKey key;
+      key.start_idx = edge.start_idx;
+      key.end_idx = edge.end_idx;
+      key.bidirectional = edge.is_bidirectional();
+      key.speed_limit = edge.get_speed_limit();
+      lanes.push_back(key);
+    }
+    vector<std::pair<int, std::string>> cabins;
+    for (std::size_t v = 0; v < level.vertices.size(); v++)
+    {
+      const std::string lift_name = level.vertices[v].lift_cabin();
+      if (!lift_name.empty())
+        cabins.emplace_back(static_cast<int>(v), lift_name);
+    }
+
+    graph.x.resize(level.vertices.size());
+    graph.y.resize(level.vertices.size());
+    for (std::size_t v = 0; v < level.vertices.size(); v++)
+    {
+      graph.x[v] = level.vertices[v].x;
+      graph.y[v] = level.vertices[v].y;
+    }
+    graph.meters_per_pixel = level.drawing_meters_per_pixel;
+    graph.elevation = level.elevation;
+    graph.transform = transform;
+
+    // moving vertices doesn't change which arcs there are
+    if (!graph.valid || lanes != graph.lanes || cabins != graph.cabins)
+    {
+      graph.lanes = std::move(lanes);
+      graph.cabins = std::move(cabins);
+      build_level(level, graph);
+      _num_levels_rebuilt++;
+    }
+    else
+      _num_levels_refreshed++;
+    cost_level(graph);
+    place_level(graph);
+    graph.revision = level.revision();
+    graph.valid = true;
+  }
+
+  if (changed || building.lifts_revision() != _lifts_revision)
+  {
+    build_lift_arcs();
+    _costs_revision++;
+  }
+  _lifts_revision = building.lifts_revision();
+}
+
+void LanePathPlanner::build_level(const Level& level, LevelGraph& graph)
+{
+  const std::size_t num_vertices = level.vertices.size();
+  graph.offsets.assign(num_vertices + 1, 0);
+  for (const LaneKey& lane : graph.lanes)
+  {
+    graph.offsets[lane.start_idx + 1]++;
+    if (lane.bidirectional)
+      graph.offsets[lane.end_idx + 1]++;
+  }
+  for (std::size_t v = 0; v < num_vertices; v++)
+    graph.offsets[v + 1] += graph.offsets[v];
+
+  const std::size_t num_arcs = graph.offsets[num_vertices];
+  graph.targets.resize(num_arcs);
+  graph.speeds.resize(num_arcs);
+  graph.lengths.resize(num_arcs);
+  graph.times.resize(num_arcs);
+
+  vector<uint32_t> next(graph.offsets.begin(), graph.offsets.end() - 1);
+  auto add = [&](const int u, const int v, const double speed_limit)
+    {
+      const uint32_t a = next[u]++;
+      graph.targets[a] = static_cast<uint32_t>(v);
+      double speed = _options.speed;
+      if (speed_limit > 0.0)
+        speed = std::min(speed, speed_limit);
+      graph.speeds[a] = static_cast<float>(std::max(speed, 1e-3));
+    };
+  for (const LaneKey& lane : graph.lanes)
+  {
+    add(lane.start_idx, lane.end_idx, lane.speed_limit);
+    if (lane.bidirectional)
+      add(lane.end_idx, lane.start_idx, lane.speed_limit);
+  }
+}
+
+void LanePathPlanner::cost_level(LevelGraph& graph)
+{
+  const std::size_t num_vertices = graph.x.size();
+  for (std::size_t u = 0; u < num_vertices; u++)
+  {
+    for (uint32_t a = graph.offsets[u]; a < graph.offsets[u + 1]; a++)
+    {
+      const uint32_t v = graph.targets[a];
+      const double length = graph.meters_per_pixel *
+        std::hypot(graph.x[v] - graph.x[u], graph.y[v] - graph.y[u]);
+      graph.lengths[a] = static_cast<float>(length);
+      graph.times[a] = static_cast<float>(length / graph.speeds[a]);
+    }
+  }
+}
+
+void LanePathPlanner::place_level(const LevelGraph& graph)
+{
+  const Building::Transform& t = graph.transform;
+  for (std::size_t v = 0; v < graph.x.size(); v++)
+  {
+    _hx[graph.first_node + v] = static_cast<float>(t.scale * graph.x[v] + t.dx);
+    _hy[graph.first_node + v] = static_cast<float>(t.scale * graph.y[v] + t.dy);
+  }
+}
+
+void LanePathPlanner::build_lift_arcs()
+{
+  // the cabin vertices of each lift, on every level it has them
+  struct CabinNode
+  {
+    uint32_t node;
+    std::size_t level_idx;
+    double elevation;
+  };
+  std::map<std::string, vector<CabinNode>> lift_nodes;
+  for (std::size_t i = 0; i < _levels.size(); i++)
+  {
+    const LevelGraph& graph = _levels[i];
+    for (const auto& cabin : graph.cabins)
+    {
+      CabinNode cabin_node;
+      cabin_node.node = graph.first_node + static_cast<uint32_t>(cabin.first);
+      cabin_node.level_idx = i;
+      cabin_node.elevation = graph.elevation;
+      lift_nodes[cabin.second].push_back(cabin_node);
+    }
+  }
+
+  _lift_arcs.clear();
+  const double lift_speed = std::max(_options.lift_speed, 1e-3);
+  for (const auto& lift : lift_nodes)
+  {
+    const auto& nodes = lift.second;
+    for (const auto& from : nodes)
+    {
+      for (const auto& to : nodes)
+      {
+        if (from.level_idx == to.level_idx)
+          continue;
+        LiftArc arc;
+        arc.to = to.node;
+        arc.time = static_cast<float>(
+          _options.lift_wait +
+          std::abs(to.elevation - from.elevation) / lift_speed);
+        _lift_arcs[from.node].push_back(arc);
+      }
+    }
+  }
+}
+
+LanePathPlanner::Route LanePathPlanner::plan(const Stop& from, const Stop& to)
+{
+  const auto start_time = std::chrono::steady_clock::now();
+  Route route;
+  const int64_t source_node = node(from);
+  const int64_t target_node = node(to);
+  if (source_node < 0 || target_node < 0)
+    return route;
+  const uint32_t source = static_cast<uint32_t>(source_node);
+  const uint32_t target = static_cast<uint32_t>(target_node);
+
+  if (++_query == 0)
+  {
+    // wrapped around; nothing can be trusted to be stale any more
+    std::fill(_visited.begin(), _visited.end(), 0);
+    _query = 1;
+  }
+
+  const float tx = _hx[target];
+  const float ty = _hy[target];
+  const float scale = HEURISTIC_SLACK / _max_speed;
+  auto heuristic = [&](const uint32_t n)
+    {
+      return scale * std::hypot(_hx[n] - tx, _hy[n] - ty);
+    };
+
+  typedef std::pair<float, uint32_t> Entry;
+  vector<Entry> heap;
+  auto reach = [&](const uint32_t n, const uint32_t parent, const float cost)
+    {
+      if (_visited[n] == _query && _cost[n] <= cost)
+        return;
+      _visited[n] = _query;
+      _cost[n] = cost;
+      _parent[n] = parent;
+      heap.emplace_back(cost + heuristic(n), n);
+      std::push_heap(heap.begin(), heap.end(), std::greater<Entry>());
+    };
+  reach(source, source, 0.0f);
+
+  bool found = false;
+  while (!heap.empty())
+  {
+    std::pop_heap(heap.begin(), heap.end(), std::greater<Entry>());
+    const Entry entry = heap.back();
+    heap.pop_back();
+    const uint32_t n = entry.second;
+    const float cost = _cost[n];
+    if (entry.first > cost + heuristic(n) + 1e-4f)
+      continue;  // superseded by a cheaper way here
+    route.num_expanded++;
+    if (n == target)
+    {
+      found = true;
+      break;
+    }
+
+    const LevelGraph& graph = _levels[_node_level[n]];
+    const uint32_t u = n - graph.first_node;
+    for (uint32_t a = graph.offsets[u]; a < graph.offsets[u + 1]; a++)
+      reach(graph.first_node + graph.targets[a], n, cost + graph.times[a]);
+
+    auto lift_it = _lift_arcs.find(n);
+    if (lift_it != _lift_arcs.end())
+    {
+      for (const LiftArc& arc : lift_it->second)
+        reach(arc.to, n, cost + arc.time);
+    }
+  }
+
+  if (found)
+  {
+    route.found = true;
+    route.time = _cost[target];
+    vector<uint32_t> nodes(1, target);
+    while (nodes.back() != source)
+      nodes.push_back(_parent[nodes.back()]);
+    std::reverse(nodes.begin(), nodes.end());
+
+    for (std::size_t i = 0; i < nodes.size(); i++)
+    {
+      const int level_idx = _node_level[nodes[i]];
+      const LevelGraph& graph = _levels[level_idx];
+      Stop stop;
+      stop.level_idx = level_idx;
+      stop.vertex_idx = static_cast<int>(nodes[i] - graph.first_node);
+      if (i > 0)
+      {
+        const Stop& previous = route.stops.back();
+        if (previous.level_idx != stop.level_idx)
+          route.num_lift_rides++;
+        else
+        {
+          // the quickest of the lanes between them is the one taken
+          float best_time = -1.0f;
+          float length = 0.0f;
+          for (uint32_t a = graph.offsets[previous.vertex_idx];
+            a < graph.offsets[previous.vertex_idx + 1]; a++)
+          {
+            if (graph.targets[a] != static_cast<uint32_t>(stop.vertex_idx))
+              continue;
+            if (best_time < 0.0f || graph.times[a] < best_time)
+            {
+              best_time = graph.times[a];
+              length = graph.lengths[a];
+            }
+          }
+          route.length += length;
+        }
+      }
+      route.stops.push_back(stop);
+      route.times.push_back(_cost[nodes[i]]);
+    }
+  }
+
+  route.query_ms = std::chrono::duration<double, std::milli>(
+    std::chrono::steady_clock::now() - start_time).count();
+  return route;
+}
+
+int64_t LanePathPlanner::node(const Stop& stop) const
+{
+  if (stop.level_idx < 0 || stop.level_idx >= static_cast<int>(_levels.size()))
+    return -1;
+  const LevelGraph& graph = _levels[stop.level_idx];
+  if (!graph.valid || stop.vertex_idx < 0 ||
+    stop.vertex_idx >= static_cast<int>(graph.x.size()))
+    return -1;
+  return graph.first_node + stop.vertex_idx;
+}
+
+void LanePathPlanner::arcs(vector<RouteHierarchy::Arc>& arcs) const
+{
+  arcs.clear();
+  for (const LevelGraph& graph : _levels)
+  {
+    if (!graph.valid)
+      continue;
+    for (std::size_t u = 0; u + 1 < graph.offsets.size(); u++)
+    {
+      for (uint32_t a = graph.offsets[u]; a < graph.offsets[u + 1]; a++)
+      {
+        RouteHierarchy::Arc arc;
+        arc.from = graph.first_node + static_cast<uint32_t>(u);
+        arc.to = graph.first_node + graph.targets[a];
+        arc.time = graph.times[a];
+        arc.length = graph.lengths[a];
+        arcs.push_back(arc);
+      }
+    }
+  }
+
+  // the lift arcs are hashed by node, so they are sorted to keep the
+  // order, and with it customize(), independent of the map
+  const std::size_t first_lift_arc = arcs.size();
+  for (const auto& lift_arcs : _lift_arcs)
+  {
+    for (const LiftArc& lift_arc : lift_arcs.second)
+    {
+      RouteHierarchy::Arc arc;
+      arc.from = lift_arcs.first;
+      arc.to = lift_arc.to;
+      arc.time = lift_arc.time;
+      arcs.push_back(arc);
+    }
+  }
+  std::sort(
+    arcs.begin() + first_lift_arc,
+    arcs.end(),
+    [](const RouteHierarchy::Arc& a, const RouteHierarchy::Arc& b)
+    {
+      return a.from != b.from ? a.from < b.from : a.to < b.to;
+    });
+}
+
+vector<float> LanePathPlanner::travel_times(
+  const vector<Stop>& from,
+  const vector<Stop>& to)
+{
+  if (_hierarchy_revision != _costs_revision)
+  {
+    vector<RouteHierarchy::Arc> all_arcs;
+    arcs(all_arcs);
+    const uint32_t num_graph_nodes = static_cast<uint32_t>(num_nodes());
+    if (_hierarchy.num_nodes() != num_graph_nodes ||
+      !_hierarchy.customize(all_arcs))
+      _hierarchy.build(num_graph_nodes, all_arcs);
+    _hierarchy_revision = _costs_revision;
+  }
+
+  auto nodes = [this](const vector<Stop>& stops)
+    {
+      vector<uint32_t> stop_nodes;
+      stop_nodes.reserve(stops.size());
+      for (const Stop& stop : stops)
+      {
+        const int64_t n = node(stop);
+        stop_nodes.push_back(
+          n < 0 ? RouteHierarchy::NONE : static_cast<uint32_t>(n));
+      }
+      return stop_nodes;
+    };
+  return _hierarchy.travel_times(nodes(from), nodes(to));
+}
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__LANE_PATH_PLANNER_HPP
+#define TRAFFIC_EDITOR__LANE_PATH_PLANNER_HPP
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "building.h"
+#include "route_hierarchy.hpp"
+
+//=============================================================================
+/// Shortest (quickest) routes along the lanes of a building, from a vertex
+/// of one level to a vertex of any other, changing levels through the
+/// lift cabin vertices (see Vertex::lift_cabin()) of the same lift.
+///
+/// The lanes of each level are kept in a compressed sparse row graph,
+/// which update() rebuilds only for the levels that changed; if only
+/// vertices moved, just the arc costs are worked out again. Routes are
+/// found with A*, guided by the straight-line distance in the frame of the
+/// reference level, with each vertex's position in it cached alongside the
+/// graph. The search buffers are reused, and reset lazily, so a query
+/// only touches the vertices it explores.
+///
+/// For many routes at once, travel_times() keeps a RouteHierarchy of the
+/// same graph, contracted again (in the order it already has) when only
+/// the costs changed, and from scratch when the lanes did.
+class LanePathPlanner
+{
+public:
+  struct Options
+  {
+    double speed = 0.5;  // m/s, or the lane's speed_limit if that is lower
+    double lift_speed = 1.0;  // m/s between floors
+    double lift_wait = 10.0;  // seconds lost calling the lift and the doors
+    int graph_idx = -1;  // only the lanes of this graph, or -1 for all
+  };
+
+  struct Stop
+  {
+    int level_idx = -1;
+    int vertex_idx = -1;
+
+    bool operator==(const Stop& other) const
+    {
+      return level_idx == other.level_idx && vertex_idx == other.vertex_idx;
+    }
+  };
+
+  struct Route
+  {
+    bool found = false;
+    std::vector<Stop> stops;
+    std::vector<double> times;  // seconds from the start to each stop
+    double length = 0.0;  // meters along lanes, not counting lift rides
+    double time = 0.0;  // seconds
+    int num_lift_rides = 0;
+    int num_expanded = 0;  // vertices the search took off its queue
+    double query_ms = 0.0;
+  };
+
+  /// Changing the options rebuilds everything on the next update()
+  void set_options(const Options& options);
+  const Options& options() const { return _options; }
+
+  /// Bring the graph up to date with the building. Non-const only because
+  /// the level transforms are cached in the building.
+  void update(Building& building);
+
+  void clear();
+
+  /// Quickest route between two lane vertices; update() first
+  Route plan(const Stop& from, const Stop& to);
+
+  /// Seconds from each of from to each of to, row by row, or infinity
+  /// where there is no route (or a stop isn't a vertex); update() first
+  std::vector<float> travel_times(
+    const std::vector<Stop>& from,
+    const std::vector<Stop>& to);
+
+  const RouteHierarchy& hierarchy() const { return _hierarchy; }
+
+  std::size_t num_nodes() const { return _node_level.size(); }
+  std::size_t num_arcs() const;
+
+  /// Levels whose graph was rebuilt, or whose costs were refreshed, by the
+  /// last update()
+  int num_levels_rebuilt() const { return _num_levels_rebuilt; }
+  int num_levels_refreshed() const { return _num_levels_refreshed; }
+
+private:
+  /// What the arcs of a lane were built from
+  struct LaneKey
+  {
+    int start_idx = -1;
+    int end_idx = -1;
+    bool bidirectional = false;
+    double speed_limit = 0.0;
+
+    bool operator==(const LaneKey& other) const;
+    bool operator!=(const LaneKey& other) const { return !(*this == other); }
+  };
+
+  struct LevelGraph
+  {
+    bool valid = false;
+    std::size_t revision = 0;
+    uint32_t first_node = 0;
+    double meters_per_pixel = 0.05;
+    double elevation = 0.0;
+    Building::Transform transform;
+    std::vector<LaneKey> lanes;
+    std::vector<std::pair<int, std::string>> cabins;  // vertex, lift name
+    std::vector<double> x;  // pixels, as the arcs were costed
+    std::vector<double> y;
+
+    // compressed sparse rows of the local vertex indices
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> targets;
+    std::vector<float> speeds;
+    std::vector<float> lengths;  // meters
+    std::vector<float> times;  // seconds
+  };
+
+  struct LiftArc
+  {
+    uint32_t to;
+    float time;
+  };
+
+  Options _options;
+  std::vector<LevelGraph> _levels;
+  std::vector<uint16_t> _node_level;
+  std::vector<float> _hx;  // meters in the reference frame, by node
+  std::vector<float> _hy;
+  float _max_speed = 0.5f;
+  std::unordered_map<uint32_t, std::vector<LiftArc>> _lift_arcs;
+  std::size_t _lifts_revision = 0;
+  std::size_t _costs_revision = 1;  // bumped whenever an arc changes
+  std::size_t _hierarchy_revision = 0;  // the costs it was contracted with
+  RouteHierarchy _hierarchy;
+  int _num_levels_rebuilt = 0;
+  int _num_levels_refreshed = 0;
+
+  // A* state by node, valid where _visited equals _query
+  std::vector<float> _cost;
+  std::vector<uint32_t> _parent;
+  std::vector<uint32_t> _visited;
+  uint32_t _query = 0;
+
+  void build_level(const Level& level, LevelGraph& graph);
+  void cost_level(LevelGraph& graph);
+  void place_level(const LevelGraph& graph);
+  void build_lift_arcs();
+
+  /// The node of a stop, or -1 if it isn't a vertex of a valid level
+  int64_t node(const Stop& stop) const;
+
+  /// All arcs, in an order which only depends on the graph
+  void arcs(std::vector<RouteHierarchy::Arc>& arcs) const;
+};
+
+#endif
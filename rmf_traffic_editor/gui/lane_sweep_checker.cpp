@@ -0,0 +1,720 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+
+#include <QStringList>
+
+#include "editor_model.h"
+#include "lane_sweep_checker.hpp"
+#include "level.h"
+#include "task_pool.hpp"
+
+using std::vector;
+typedef SegmentRTree::Segment Segment;
+typedef ModelOverlapChecker::Footprint Footprint;
+typedef LaneSweepChecker::Outline Outline;
+
+namespace {
+
+/// The turning sweeps are sampled at least this often
+const double MAX_TURN_STEP = 10.0 * M_PI / 180.0;
+
+double cross(const QPointF& o, const QPointF& a, const QPointF& b)
+{
+  return (a.x() - o.x()) * (b.y() - o.y()) - (a.y() - o.y()) * (b.x() - o.x());
+}
+
+/// The bounding box of some points, as the (min, max) diagonal
+Segment bounds(const Outline& points)
+{
+  Segment box;
+  if (points.empty())
+    return box;
+  box.x0 = box.x1 = points[0].x();
+  box.y0 = box.y1 = points[0].y();
+  for (const QPointF& p : points)
+  {
+    box.x0 = std::min(box.x0, p.x());
+    box.y0 = std::min(box.y0, p.y());
+    box.x1 = std::max(box.x1, p.x());
+    box.y1 = std::max(box.y1, p.y());
+  }
+  return box;
+}
+
+Segment bounds(const Segment& s)
+{
+  Segment box;
+  box.x0 = std::min(s.x0, s.x1);
+  box.y0 = std::min(s.y0, s.y1);
+  box.x1 = std::max(s.x0, s.x1);
+  box.y1 = std::max(s.y0, s.y1);
+  return box;
+}
+
+void expand(Segment& box, const Segment& other)
+{
+  box.x0 = std::min(box.x0, other.x0);
+  box.y0 = std::min(box.y0, other.y0);
+  box.x1 = std::max(box.x1, other.x1);
+  box.y1 = std::max(box.y1, other.y1);
+}
+
+bool operator==(const Segment& a, const Segment& b)
+{
+  return a.x0 == b.x0 && a.y0 == b.y0 && a.x1 == b.x1 && a.y1 == b.y1;
+}
+
+/// Whether the projections of both onto some side of a are apart
+bool separated_by_side_of(const Outline& a, const Outline& b)
+{
+  const double eps = 1e-6;
+  for (std::size_t i = 0; i < a.size(); i++)
+  {
+    const QPointF& p = a[i];
+    const QPointF& q = a[(i + 1) % a.size()];
+    double nx = p.y() - q.y();
+    double ny = q.x() - p.x();
+    const double length = std::sqrt(nx * nx + ny * ny);
+    if (length <= 0.0)
+      continue;
+    nx /= length;
+    ny /= length;
+
+    double a_min = 1e100;
+    double a_max = -1e100;
+    for (const QPointF& v : a)
+    {
+      const double d = v.x() * nx + v.y() * ny;
+      a_min = std::min(a_min, d);
+      a_max = std::max(a_max, d);
+    }
+    double b_min = 1e100;
+    double b_max = -1e100;
+    for (const QPointF& v : b)
+    {
+      const double d = v.x() * nx + v.y() * ny;
+      b_min = std::min(b_min, d);
+      b_max = std::max(b_max, d);
+    }
+    if (a_max <= b_min + eps || b_max <= a_min + eps)
+      return true;
+  }
+  return false;
+}
+
+}  // anonymous namespace
+
+//=============================================================================
+bool LaneSweepChecker::Lane::operator==(const Lane& other) const
+{
+  return valid == other.valid &&
+    graph_idx == other.graph_idx &&
+    start_idx == other.start_idx &&
+    end_idx == other.end_idx &&
+    bidirectional == other.bidirectional &&
+    segment == other.segment;
+}
+
+//=============================================================================
+Outline LaneSweepChecker::parse_footprint(const QString& text)
+{
+  Outline points;
+  const QStringList tokens = text.simplified().split(' ');
+  for (const QString& token : tokens)
+  {
+    const QStringList xy = token.split(',');
+    bool x_ok = false;
+    bool y_ok = false;
+    if (xy.size() != 2)
+      return Outline();
+    const double x = xy[0].toDouble(&x_ok);
+    const double y = xy[1].toDouble(&y_ok);
+    if (!x_ok || !y_ok)
+      return Outline();
+    points.push_back(QPointF(x, y));
+  }
+  Outline hull = convex_hull(points);
+  if (hull.size() < 3)
+    return Outline();
+  return hull;
+}
+
+Outline LaneSweepChecker::default_footprint()
+{
+  return {
+    QPointF(-0.5, -0.3),
+    QPointF(0.5, -0.3),
+    QPointF(0.5, 0.3),
+    QPointF(-0.5, 0.3)
+  };
+}
+
+Outline LaneSweepChecker::convex_hull(Outline points)
+{
+  // Andrew's monotone chain
+  std::sort(
+    points.begin(),
+    points.end(),
+    [](const QPointF& a, const QPointF& b)
+    {
+      return a.x() < b.x() || (a.x() == b.x() && a.y() < b.y());
+    });
+  points.erase(std::unique(points.begin(), points.end()), points.end());
+  if (points.size() < 3)
+    return points;
+
+  Outline hull(2 * points.size());
+  std::size_t k = 0;
+  for (std::size_t i = 0; i < points.size(); i++)
+  {
+    while (k >= 2 && cross(hull[k - 2], hull[k - 1], points[i]) <= 0.0)
+      k--;
+    hull[k++] = points[i];
+  }
+  for (std::size_t i = points.size() - 1, lower = k + 1; i > 0; i--)
+  {
+    while (k >= lower && cross(hull[k - 2], hull[k - 1], points[i - 1]) <= 0.0)
+      k--;
+    hull[k++] = points[i - 1];
+  }
+  hull.resize(k - 1);
+  return hull;
+}
+
+bool LaneSweepChecker::convex_overlap(const Outline& a, const Outline& b)
+{
+  if (a.empty() || b.empty())
+    return false;
+  return !separated_by_side_of(a, b) && !separated_by_side_of(b, a);
+}
+
+//=============================================================================
+void LaneSweepChecker::set_footprint(const Outline& footprint)
+{
+  const Outline hull = convex_hull(footprint);
+  if (hull == _footprint)
+    return;
+  _footprint = hull;
+  clear();
+}
+
+void LaneSweepChecker::clear()
+{
+  _valid = false;
+  _num_unknown_models = 0;
+  _num_checked = 0;
+  _lanes.clear();
+  _lane_sweeps.clear();
+  _lane_blocked.clear();
+  _sweep_tree.clear();
+  _turns.clear();
+  _turn_tree.clear();
+  _is_wall.clear();
+  _walls.clear();
+  _wall_tree.clear();
+  _models.clear();
+  _model_tree.clear();
+  _blocked_lanes.clear();
+  _clear_lanes.clear();
+  _blocked_turns.clear();
+}
+
+const Outline& LaneSweepChecker::lane_sweep(const int edge_idx) const
+{
+  static const Outline none;
+  if (edge_idx < 0 || edge_idx >= static_cast<int>(_lane_sweeps.size()))
+    return none;
+  return _lane_sweeps[edge_idx];
+}
+
+vector<Outline> LaneSweepChecker::blocked_turn_sweeps(
+  const int vertex_idx) const
+{
+  vector<Outline> sweeps;
+  if (vertex_idx < 0 || vertex_idx >= static_cast<int>(_turns.size()))
+    return sweeps;
+  for (const Turn& turn : _turns[vertex_idx])
+  {
+    if (turn.blocked)
+      sweeps.push_back(turn.sweep);
+  }
+  return sweeps;
+}
+
+//=============================================================================
+Outline LaneSweepChecker::posed(
+  const double x,
+  const double y,
+  const double heading) const
+{
+  // the footprint is in meters, y up; the scene is in pixels, y down
+  const double c = std::cos(heading) / _meters_per_pixel;
+  const double s = std::sin(heading) / _meters_per_pixel;
+  Outline points;
+  points.reserve(_footprint.size());
+  for (const QPointF& p : _footprint)
+    points.push_back(
+      QPointF(
+        x + c * p.x() - s * p.y(),
+        y - s * p.x() - c * p.y()));
+  return points;
+}
+
+Outline LaneSweepChecker::sweep_lane(const Lane& lane) const
+{
+  const Segment& s = lane.segment;
+  const double heading = std::atan2(-(s.y1 - s.y0), s.x1 - s.x0);
+  Outline points = posed(s.x0, s.y0, heading);
+  const Outline end = posed(s.x1, s.y1, heading);
+  points.insert(points.end(), end.begin(), end.end());
+  if (lane.bidirectional)
+  {
+    const Outline back_start = posed(s.x0, s.y0, heading + M_PI);
+    const Outline back_end = posed(s.x1, s.y1, heading + M_PI);
+    points.insert(points.end(), back_start.begin(), back_start.end());
+    points.insert(points.end(), back_end.begin(), back_end.end());
+  }
+  return convex_hull(points);
+}
+
+vector<LaneSweepChecker::Turn> LaneSweepChecker::sweep_turns(
+  const int vertex_idx,
+  const vector<int>& lanes) const
+{
+  // the headings a robot arrives here with, and leaves with, by graph
+  struct Heading
+  {
+    int graph_idx;
+    double heading;
+  };
+  vector<Heading> arrivals;
+  vector<Heading> departures;
+  double x = 0.0;
+  double y = 0.0;
+  for (const int edge_idx : lanes)
+  {
+    const Lane& lane = _lanes[edge_idx];
+    const Segment& s = lane.segment;
+    const double heading = std::atan2(-(s.y1 - s.y0), s.x1 - s.x0);
+    const bool at_start = lane.start_idx == vertex_idx;
+    if (at_start)
+    {
+      x = s.x0;
+      y = s.y0;
+      departures.push_back({lane.graph_idx, heading});
+      if (lane.bidirectional)
+        arrivals.push_back({lane.graph_idx, heading + M_PI});
+    }
+    else
+    {
+      x = s.x1;
+      y = s.y1;
+      arrivals.push_back({lane.graph_idx, heading});
+      if (lane.bidirectional)
+        departures.push_back({lane.graph_idx, heading + M_PI});
+    }
+  }
+
+  vector<Turn> turns;
+  vector<double> swept;  // the arcs already swept, as (from, to) pairs
+  for (const Heading& from : arrivals)
+  {
+    for (const Heading& to : departures)
+    {
+      if (from.graph_idx != to.graph_idx)
+        continue;
+      // the short way round, in (-pi, pi]
+      double angle = std::remainder(to.heading - from.heading, 2.0 * M_PI);
+      if (std::abs(angle) < 1e-6)
+        continue;  // straight on, which the lane sweeps cover
+
+      // the same turn is often there both ways along bidirectional lanes
+      double start = std::remainder(from.heading, 2.0 * M_PI);
+      double end = start + angle;
+      if (angle < 0.0)
+        std::swap(start, end);
+      bool duplicate = false;
+      for (std::size_t i = 0; i + 1 < swept.size(); i += 2)
+      {
+        if (std::abs(std::remainder(swept[i] - start, 2.0 * M_PI)) < 1e-6 &&
+          std::abs(swept[i + 1] - swept[i] - (end - start)) < 1e-6)
+          duplicate = true;
+      }
+      if (duplicate)
+        continue;
+      swept.push_back(start);
+      swept.push_back(end);
+
+      const int steps =
+        std::max(1, static_cast<int>(std::ceil((end - start) / MAX_TURN_STEP)));
+      Outline points;
+      for (int i = 0; i <= steps; i++)
+      {
+        const Outline pose =
+          posed(x, y, start + (end - start) * i / steps);
+        points.insert(points.end(), pose.begin(), pose.end());
+      }
+      Turn turn;
+      turn.sweep = convex_hull(points);
+      turns.push_back(turn);
+    }
+  }
+  return turns;
+}
+
+bool LaneSweepChecker::is_blocked(const Outline& sweep) const
+{
+  if (sweep.empty())
+    return false;
+  const Segment box = bounds(sweep);
+  vector<int> ids;
+  _wall_tree.intersecting(box.x0, box.y0, box.x1, box.y1, ids);
+  for (const int edge_idx : ids)
+  {
+    const Segment& wall = _walls[edge_idx];
+    const Outline segment = {
+      QPointF(wall.x0, wall.y0),
+      QPointF(wall.x1, wall.y1)
+    };
+    if (convex_overlap(sweep, segment))
+      return true;
+  }
+
+  ids.clear();
+  _model_tree.intersecting(box.x0, box.y0, box.x1, box.y1, ids);
+  for (const int model_idx : ids)
+  {
+    double xs[4];
+    double ys[4];
+    _models[model_idx].corners(xs, ys);
+    Outline corners;
+    for (int i = 0; i < 4; i++)
+      corners.push_back(QPointF(xs[i], ys[i]));
+    if (convex_overlap(sweep, corners))
+      return true;
+  }
+  return false;
+}
+
+//=============================================================================
+void LaneSweepChecker::update(
+  const Level& level,
+  const vector<EditorModel>& editor_models)
+{
+  _num_checked = 0;
+  if (_footprint.empty())
+    _footprint = default_footprint();
+  // a thumbnail which has arrived since gives its model a footprint
+  if (_valid && _revision == level.revision() && _num_unknown_models == 0)
+    return;
+  if (level.drawing_meters_per_pixel <= 0.0)
+  {
+    clear();
+    return;
+  }
+  if (level.drawing_meters_per_pixel != _meters_per_pixel)
+  {
+    clear();  // every sweep is scaled differently
+    _meters_per_pixel = level.drawing_meters_per_pixel;
+  }
+
+  // read everything serially, as the edge attributes are parsed lazily
+  const int num_vertices = static_cast<int>(level.vertices.size());
+  const std::size_t num_edges = level.edges.size();
+  vector<Lane> lanes(num_edges);
+  vector<char> is_wall(num_edges, 0);
+  vector<Segment> walls(num_edges);
+  for (std::size_t i = 0; i < num_edges; i++)
+  {
+    const Edge& edge = level.edges[i];
+    if ((edge.type != Edge::LANE && edge.type != Edge::WALL) ||
+      edge.start_idx < 0 || edge.start_idx >= num_vertices ||
+      edge.end_idx < 0 || edge.end_idx >= num_vertices)
+      continue;
+    Segment s;
+    s.x0 = level.vertices[edge.start_idx].x;
+    s.y0 = level.vertices[edge.start_idx].y;
+    s.x1 = level.vertices[edge.end_idx].x;
+    s.y1 = level.vertices[edge.end_idx].y;
+    if (edge.type == Edge::WALL)
+    {
+      is_wall[i] = 1;
+      walls[i] = s;
+      continue;
+    }
+    if (s.x0 == s.x1 && s.y0 == s.y1)
+      continue;  // which way would it face?
+    Lane& lane = lanes[i];
+    lane.valid = true;
+    lane.graph_idx = edge.get_graph_idx();
+    lane.start_idx = edge.start_idx;
+    lane.end_idx = edge.end_idx;
+    lane.bidirectional = edge.is_bidirectional();
+    lane.segment = s;
+  }
+
+  vector<Footprint> models(level.models.size());
+  int num_unknown_models = 0;
+  for (std::size_t i = 0; i < level.models.size(); i++)
+  {
+    models[i] = ModelOverlapChecker::footprint(
+      level.models[i],
+      editor_models,
+      level.drawing_meters_per_pixel);
+    if (!models[i].valid)
+      num_unknown_models++;
+  }
+  _num_unknown_models = num_unknown_models;
+
+  // the lanes and vertices to sweep again, and the areas where a wall or
+  // model appeared or went, to check the sweeps near them again
+  vector<char> lane_dirty(num_edges, 0);
+  vector<char> vertex_dirty(num_vertices, 0);
+  vector<Segment> moved;
+  if (!_valid)
+  {
+    vector<std::pair<int, Segment>> segments;
+    for (std::size_t i = 0; i < num_edges; i++)
+    {
+      if (is_wall[i])
+        segments.emplace_back(static_cast<int>(i), walls[i]);
+      if (lanes[i].valid)
+      {
+        lane_dirty[i] = 1;
+        vertex_dirty[lanes[i].start_idx] = 1;
+        vertex_dirty[lanes[i].end_idx] = 1;
+      }
+    }
+    _wall_tree.build(segments);
+
+    vector<std::pair<int, Segment>> boxes;
+    for (std::size_t i = 0; i < models.size(); i++)
+    {
+      if (models[i].valid)
+        boxes.emplace_back(static_cast<int>(i), models[i].bounding_box());
+    }
+    _model_tree.build(boxes);
+    _sweep_tree.clear();
+    _turn_tree.clear();
+  }
+  else
+  {
+    const std::size_t num_any = std::max(num_edges, _lanes.size());
+    for (std::size_t i = 0; i < num_any; i++)
+    {
+      const int id = static_cast<int>(i);
+      const Lane no_lane;
+      const Lane& before = i < _lanes.size() ? _lanes[i] : no_lane;
+      const Lane& after = i < num_edges ? lanes[i] : no_lane;
+      if (before != after)
+      {
+        for (const Lane* lane : {&before, &after})
+        {
+          if (!lane->valid)
+            continue;
+          for (const int v : {lane->start_idx, lane->end_idx})
+          {
+            if (v < num_vertices)
+              vertex_dirty[v] = 1;
+          }
+        }
+        if (after.valid)
+          lane_dirty[i] = 1;
+        else
+          _sweep_tree.remove(id);
+      }
+
+      const bool was_wall = i < _is_wall.size() && _is_wall[i];
+      const bool wall = i < num_edges && is_wall[i];
+      if (was_wall == wall && (!wall || _walls[i] == walls[i]))
+        continue;
+      if (was_wall)
+      {
+        moved.push_back(bounds(_walls[i]));
+        _wall_tree.remove(id);
+      }
+      if (wall)
+      {
+        moved.push_back(bounds(walls[i]));
+        _wall_tree.insert(id, walls[i]);
+      }
+    }
+
+    const std::size_t num_models = std::max(models.size(), _models.size());
+    for (std::size_t i = 0; i < num_models; i++)
+    {
+      const Footprint none;
+      const Footprint& before = i < _models.size() ? _models[i] : none;
+      const Footprint& after = i < models.size() ? models[i] : none;
+      if (before == after)
+        continue;
+      const int id = static_cast<int>(i);
+      if (before.valid)
+      {
+        moved.push_back(before.bounding_box());
+        _model_tree.remove(id);
+      }
+      if (after.valid)
+      {
+        moved.push_back(after.bounding_box());
+        _model_tree.insert(id, after.bounding_box());
+      }
+    }
+
+    for (std::size_t i = num_vertices; i < _turns.size(); i++)
+      _turn_tree.remove(static_cast<int>(i));
+  }
+  _lanes = std::move(lanes);
+  _is_wall = std::move(is_wall);
+  _walls = std::move(walls);
+  _models = std::move(models);
+  _lane_sweeps.resize(num_edges);
+  _lane_blocked.resize(num_edges, 0);
+  _turns.resize(num_vertices);
+
+  // sweep again
+  vector<vector<int>> lanes_at(num_vertices);
+  for (std::size_t i = 0; i < num_edges; i++)
+  {
+    if (!_lanes[i].valid)
+    {
+      _lane_sweeps[i].clear();
+      _lane_blocked[i] = 0;
+      continue;
+    }
+    lanes_at[_lanes[i].start_idx].push_back(static_cast<int>(i));
+    lanes_at[_lanes[i].end_idx].push_back(static_cast<int>(i));
+  }
+  vector<int> dirty_lanes;
+  for (std::size_t i = 0; i < num_edges; i++)
+  {
+    if (lane_dirty[i])
+      dirty_lanes.push_back(static_cast<int>(i));
+  }
+  vector<int> dirty_vertices;
+  for (int i = 0; i < num_vertices; i++)
+  {
+    if (vertex_dirty[i])
+      dirty_vertices.push_back(i);
+  }
+  const int num_dirty_lanes = static_cast<int>(dirty_lanes.size());
+  TaskPool::instance().parallel_for(
+    num_dirty_lanes + static_cast<int>(dirty_vertices.size()),
+    [&](const int i)
+    {
+      if (i < num_dirty_lanes)
+      {
+        const int edge_idx = dirty_lanes[i];
+        _lane_sweeps[edge_idx] = sweep_lane(_lanes[edge_idx]);
+      }
+      else
+      {
+        const int vertex_idx = dirty_vertices[i - num_dirty_lanes];
+        _turns[vertex_idx] = sweep_turns(vertex_idx, lanes_at[vertex_idx]);
+      }
+    });
+
+  // the trees are updated serially, as they aren't safe to write to from
+  // several threads
+  for (const int edge_idx : dirty_lanes)
+    _sweep_tree.insert(edge_idx, bounds(_lane_sweeps[edge_idx]));
+  for (const int vertex_idx : dirty_vertices)
+  {
+    if (_turns[vertex_idx].empty())
+    {
+      _turn_tree.remove(vertex_idx);
+      continue;
+    }
+    Segment box = bounds(_turns[vertex_idx][0].sweep);
+    for (const Turn& turn : _turns[vertex_idx])
+      expand(box, bounds(turn.sweep));
+    _turn_tree.insert(vertex_idx, box);
+  }
+
+  // and check again what was swept again, or is near what moved
+  vector<int> ids;
+  for (const Segment& box : moved)
+  {
+    ids.clear();
+    _sweep_tree.intersecting(box.x0, box.y0, box.x1, box.y1, ids);
+    for (const int id : ids)
+      lane_dirty[id] = 1;
+    ids.clear();
+    _turn_tree.intersecting(box.x0, box.y0, box.x1, box.y1, ids);
+    for (const int id : ids)
+      vertex_dirty[id] = 1;
+  }
+  dirty_lanes.clear();
+  for (std::size_t i = 0; i < num_edges; i++)
+  {
+    if (lane_dirty[i])
+      dirty_lanes.push_back(static_cast<int>(i));
+  }
+  dirty_vertices.clear();
+  for (int i = 0; i < num_vertices; i++)
+  {
+    if (vertex_dirty[i])
+      dirty_vertices.push_back(i);
+  }
+  const int num_check_lanes = static_cast<int>(dirty_lanes.size());
+  const int num_check =
+    num_check_lanes + static_cast<int>(dirty_vertices.size());
+  TaskPool::instance().parallel_for(
+    num_check,
+    [&](const int i)
+    {
+      if (i < num_check_lanes)
+      {
+        const int edge_idx = dirty_lanes[i];
+        _lane_blocked[edge_idx] = is_blocked(_lane_sweeps[edge_idx]);
+        return;
+      }
+      for (Turn& turn : _turns[dirty_vertices[i - num_check_lanes]])
+        turn.blocked = is_blocked(turn.sweep);
+    });
+  _num_checked = num_check;
+
+  _blocked_lanes.clear();
+  _clear_lanes.clear();
+  for (std::size_t i = 0; i < num_edges; i++)
+  {
+    if (!_lanes[i].valid)
+      continue;
+    if (_lane_blocked[i])
+      _blocked_lanes.push_back(static_cast<int>(i));
+    else
+      _clear_lanes.push_back(static_cast<int>(i));
+  }
+  _blocked_turns.clear();
+  for (int i = 0; i < num_vertices; i++)
+  {
+    for (const Turn& turn : _turns[i])
+    {
+      if (turn.blocked)
+      {
+        _blocked_turns.push_back(i);
+        break;
+      }
+    }
+  }
+
+  _revision = level.revision();
+  _valid = true;
+}
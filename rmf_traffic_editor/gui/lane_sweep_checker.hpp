@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__LANE_SWEEP_CHECKER_HPP
+#define TRAFFIC_EDITOR__LANE_SWEEP_CHECKER_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include <QPointF>
+#include <QString>
+
+#include "model_overlap_checker.hpp"
+#include "segment_rtree.hpp"
+
+class EditorModel;
+class Level;
+
+//=============================================================================
+/// Checks that a robot fits along every lane of a level, and can turn in
+/// place at the vertices between them, without touching a wall or a model
+/// footprint (see ModelOverlapChecker).
+///
+/// The robot footprint is a polygon in meters, x forward and y to its
+/// left, of which the convex hull is swept: along a lane, facing along it,
+/// the sweep is the hull of the footprint at both ends (both ways for a
+/// bidirectional lane); at a vertex it is the footprint turned from the
+/// heading of each lane arriving there to that of each lane leaving it of
+/// the same graph, the short way, in steps of at most 10 degrees.
+///
+/// Walls, models and sweeps are kept in R-trees between updates. An update
+/// sweeps again only the lanes and turns whose geometry changed, checks
+/// again only those and the ones near a wall or model which moved, and
+/// spreads them over the TaskPool.
+class LaneSweepChecker
+{
+public:
+  typedef std::vector<QPointF> Outline;
+
+  /// Parse a footprint written as "x,y x,y x,y ...", in meters. Empty if
+  /// it isn't a polygon of at least three points.
+  static Outline parse_footprint(const QString& text);
+
+  /// 1 m long and 0.6 m wide, centered
+  static Outline default_footprint();
+
+  /// Sweep with this robot from now on
+  void set_footprint(const Outline& footprint);
+
+  /// Bring the results up to date with the level
+  void update(
+    const Level& level,
+    const std::vector<EditorModel>& editor_models);
+
+  void clear();
+
+  /// The lanes (by edge index) along which the robot would touch something
+  const std::vector<int>& blocked_lanes() const { return _blocked_lanes; }
+
+  /// The lanes along which it fits
+  const std::vector<int>& clear_lanes() const { return _clear_lanes; }
+
+  /// The vertices at which it can't turn from one of its lanes to another
+  const std::vector<int>& blocked_turns() const { return _blocked_turns; }
+
+  /// The area swept along a lane, in scene pixels; empty for other edges
+  const Outline& lane_sweep(const int edge_idx) const;
+
+  /// The areas swept by the blocked turns at a vertex
+  std::vector<Outline> blocked_turn_sweeps(const int vertex_idx) const;
+
+  /// Number of lanes and turning vertices the last update() checked again
+  int num_checked() const { return _num_checked; }
+
+  /// The convex hull of some points, counterclockwise in a y-up frame
+  static Outline convex_hull(Outline points);
+
+  /// Whether two convex polygons (a segment counts) overlap by more than
+  /// touching
+  static bool convex_overlap(const Outline& a, const Outline& b);
+
+private:
+  struct Lane
+  {
+    bool valid = false;
+    int graph_idx = 0;
+    int start_idx = -1;
+    int end_idx = -1;
+    bool bidirectional = false;
+    SegmentRTree::Segment segment;
+
+    bool operator==(const Lane& other) const;
+    bool operator!=(const Lane& other) const { return !(*this == other); }
+  };
+
+  struct Turn
+  {
+    Outline sweep;  // scene pixels
+    bool blocked = false;
+  };
+
+  Outline _footprint;  // the hull, in meters
+  double _meters_per_pixel = 0.0;
+  bool _valid = false;
+  std::size_t _revision = 0;
+  int _num_unknown_models = 0;
+  int _num_checked = 0;
+
+  std::vector<Lane> _lanes;  // by edge index
+  std::vector<Outline> _lane_sweeps;
+  std::vector<char> _lane_blocked;
+  SegmentRTree _sweep_tree;  // the bounding boxes of the lane sweeps
+
+  /// The turns at each vertex, by vertex index, and their bounding boxes
+  std::vector<std::vector<Turn>> _turns;
+  SegmentRTree _turn_tree;
+
+  std::vector<char> _is_wall;  // by edge index
+  std::vector<SegmentRTree::Segment> _walls;
+  SegmentRTree _wall_tree;
+  std::vector<ModelOverlapChecker::Footprint> _models;
+  SegmentRTree _model_tree;
+
+  std::vector<int> _blocked_lanes;
+  std::vector<int> _clear_lanes;
+  std::vector<int> _blocked_turns;
+
+  /// The footprint at a position and heading, in scene pixels
+  Outline posed(const double x, const double y, const double heading) const;
+
+  Outline sweep_lane(const Lane& lane) const;
+
+  /// The turns between the lanes (by edge index) at a vertex
+  std::vector<Turn> sweep_turns(
+    const int vertex_idx,
+    const std::vector<int>& lanes) const;
+
+  bool is_blocked(const Outline& sweep) const;
+};
+
+#endif
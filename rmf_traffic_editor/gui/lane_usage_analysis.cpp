@@ -0,0 +1,434 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <queue>
+#include <random>
+#include <unordered_set>
+
+#include <QThread>
+
+#include "content_hash.hpp"
+#include "lane_usage_analysis.hpp"
+#include "level.h"
+#include "task_pool.hpp"
+
+using std::vector;
+
+namespace {
+
+int find_root(vector<int>& parent, int v)
+{
+  while (parent[v] != v)
+  {
+    parent[v] = parent[parent[v]];
+    v = parent[v];
+  }
+  return v;
+}
+
+}  // namespace
+
+//=============================================================================
+void LaneUsageAnalysis::set_options(const Options& options)
+{
+  _options = options;
+  _kept.clear();
+}
+
+void LaneUsageAnalysis::clear()
+{
+  _kept.clear();
+}
+
+vector<LaneUsageAnalysis::Part> LaneUsageAnalysis::split_parts(
+  const Level& level) const
+{
+  // the robot lanes of each graph; the buckets also hold the human ones
+  const int num_vertices = static_cast<int>(level.vertices.size());
+  std::map<int, vector<int>> graph_lanes;
+  for (const auto& bucket : level.lane_buckets())
+  {
+    for (const int i : bucket.second)
+    {
+      const Edge& edge = level.edges[i];
+      if (edge.type != Edge::LANE ||
+        edge.start_idx < 0 || edge.start_idx >= num_vertices ||
+        edge.end_idx < 0 || edge.end_idx >= num_vertices ||
+        edge.start_idx == edge.end_idx)
+        continue;
+      graph_lanes[bucket.first].push_back(i);
+    }
+  }
+
+  vector<Part> parts;
+  vector<int> parent(num_vertices);
+  std::iota(parent.begin(), parent.end(), 0);
+  vector<int> part_of(num_vertices, -1);
+  vector<int> local(num_vertices, -1);
+  for (const auto& graph : graph_lanes)
+  {
+    // the lanes joined by their ends, then each set in the order of its
+    // first lane
+    for (const int e : graph.second)
+    {
+      const Edge& edge = level.edges[e];
+      const int a = find_root(parent, edge.start_idx);
+      const int b = find_root(parent, edge.end_idx);
+      if (a != b)
+        parent[std::max(a, b)] = std::min(a, b);
+    }
+    const std::size_t first_part = parts.size();
+    for (const int e : graph.second)
+    {
+      const Edge& edge = level.edges[e];
+      const int root = find_root(parent, edge.start_idx);
+      if (part_of[root] < 0)
+      {
+        part_of[root] = static_cast<int>(parts.size());
+        parts.emplace_back();
+      }
+      Part& part = parts[part_of[root]];
+      part.lanes.push_back(e);
+      for (const int v : {edge.start_idx, edge.end_idx})
+      {
+        if (local[v] >= 0)
+          continue;
+        local[v] = static_cast<int>(part.vertices.size());
+        part.vertices.push_back(v);
+      }
+    }
+
+    for (std::size_t p = first_part; p < parts.size(); p++)
+    {
+      Part& part = parts[p];
+      ContentHash::Builder hash;
+      hash.add(level.drawing_meters_per_pixel);
+      for (const int e : part.lanes)
+      {
+        const Edge& edge = level.edges[e];
+        hash.add(local[edge.start_idx]);
+        hash.add(local[edge.end_idx]);
+        hash.add(edge.is_bidirectional());
+        hash.add(edge.get_speed_limit());
+      }
+      for (const int v : part.vertices)
+      {
+        hash.add(level.vertices[v].x);
+        hash.add(level.vertices[v].y);
+      }
+      part.hash = hash.value();
+    }
+
+    // ready for the next graph, which may share vertices with this one
+    for (std::size_t p = first_part; p < parts.size(); p++)
+    {
+      for (const int v : parts[p].vertices)
+      {
+        parent[v] = v;
+        part_of[v] = -1;
+        local[v] = -1;
+      }
+    }
+  }
+  return parts;
+}
+
+void LaneUsageAnalysis::build_arcs(const Level& level, Part& part) const
+{
+  const int num_vertices = static_cast<int>(part.vertices.size());
+  std::unordered_map<int, int> local;
+  local.reserve(part.vertices.size());
+  for (int i = 0; i < num_vertices; i++)
+    local[part.vertices[i]] = i;
+
+  struct Arc
+  {
+    int from;
+    int to;
+    double time;
+    int lane;
+  };
+  vector<Arc> arcs;
+  arcs.reserve(2 * part.lanes.size());
+  for (std::size_t i = 0; i < part.lanes.size(); i++)
+  {
+    const Edge& edge = level.edges[part.lanes[i]];
+    const Vertex& start = level.vertices[edge.start_idx];
+    const Vertex& end = level.vertices[edge.end_idx];
+    const double length = level.drawing_meters_per_pixel *
+      std::hypot(end.x - start.x, end.y - start.y);
+    double speed = _options.speed;
+    if (edge.get_speed_limit() > 0.0)
+      speed = std::min(speed, edge.get_speed_limit());
+    // coincident vertices still take a moment, so that the quickest
+    // routes never go round in circles
+    const double time = std::max(length / std::max(speed, 1e-3), 1e-3);
+    const int a = local[edge.start_idx];
+    const int b = local[edge.end_idx];
+    arcs.push_back(Arc{a, b, time, static_cast<int>(i)});
+    if (edge.is_bidirectional())
+      arcs.push_back(Arc{b, a, time, static_cast<int>(i)});
+  }
+
+  part.in_offsets.assign(num_vertices + 1, 0);
+  part.out_offsets.assign(num_vertices + 1, 0);
+  for (const Arc& arc : arcs)
+  {
+    part.in_offsets[arc.to + 1]++;
+    part.out_offsets[arc.from + 1]++;
+  }
+  for (int v = 0; v < num_vertices; v++)
+  {
+    part.in_offsets[v + 1] += part.in_offsets[v];
+    part.out_offsets[v + 1] += part.out_offsets[v];
+  }
+  part.in_sources.resize(arcs.size());
+  part.in_times.resize(arcs.size());
+  part.in_lanes.resize(arcs.size());
+  part.out_targets.resize(arcs.size());
+  part.out_times.resize(arcs.size());
+  vector<int> next_in(part.in_offsets.begin(), part.in_offsets.end() - 1);
+  vector<int> next_out(part.out_offsets.begin(), part.out_offsets.end() - 1);
+  for (const Arc& arc : arcs)
+  {
+    const int i = next_in[arc.to]++;
+    part.in_sources[i] = arc.from;
+    part.in_times[i] = arc.time;
+    part.in_lanes[i] = arc.lane;
+    const int o = next_out[arc.from]++;
+    part.out_targets[o] = arc.to;
+    part.out_times[o] = arc.time;
+  }
+}
+
+void LaneUsageAnalysis::accumulate(
+  const Part& part,
+  const vector<int>& sources,
+  const int first,
+  const int last,
+  const double weight,
+  vector<double>& usage)
+{
+  const double infinity = std::numeric_limits<double>::infinity();
+  const std::size_t num_vertices = part.vertices.size();
+  vector<double> time(num_vertices, infinity);
+  vector<double> num_routes(num_vertices, 0.0);
+  vector<double> dependency(num_vertices, 0.0);
+  vector<char> settled(num_vertices, 0);
+  vector<int> order;
+  order.reserve(num_vertices);
+
+  typedef std::pair<double, int> QueueItem;
+  std::priority_queue<QueueItem, vector<QueueItem>, std::greater<QueueItem>>
+  queue;
+
+  // whether the arc into v is on a quickest route to it; the times of the
+  // routes which tie may differ in their last bits
+  auto tight = [&](const int arc, const int v)
+    {
+      const int u = part.in_sources[arc];
+      return settled[u] &&
+        time[u] + part.in_times[arc] <= time[v] * (1.0 + 1e-9) + 1e-12;
+    };
+
+  for (int i = first; i < last; i++)
+  {
+    const int s = sources[i];
+    time[s] = 0.0;
+    queue.push(QueueItem(0.0, s));
+    while (!queue.empty())
+    {
+      const QueueItem item = queue.top();
+      queue.pop();
+      const int u = item.second;
+      if (settled[u] || item.first > time[u])
+        continue;
+      settled[u] = 1;
+      order.push_back(u);
+      for (int a = part.out_offsets[u]; a < part.out_offsets[u + 1]; a++)
+      {
+        const int v = part.out_targets[a];
+        const double t = item.first + part.out_times[a];
+        if (t < time[v])
+        {
+          time[v] = t;
+          queue.push(QueueItem(t, v));
+        }
+      }
+    }
+
+    // the vertices come off the queue in order of time, so the routes to
+    // each are counted once those to the vertices before it are
+    num_routes[s] = 1.0;
+    for (std::size_t k = 1; k < order.size(); k++)
+    {
+      const int v = order[k];
+      for (int a = part.in_offsets[v]; a < part.in_offsets[v + 1]; a++)
+      {
+        if (tight(a, v))
+          num_routes[v] += num_routes[part.in_sources[a]];
+      }
+    }
+    for (std::size_t k = order.size(); k-- > 1; )
+    {
+      const int v = order[k];
+      for (int a = part.in_offsets[v]; a < part.in_offsets[v + 1]; a++)
+      {
+        if (!tight(a, v))
+          continue;
+        const int u = part.in_sources[a];
+        const double share =
+          num_routes[u] / num_routes[v] * (1.0 + dependency[v]);
+        usage[part.in_lanes[a]] += weight * share;
+        dependency[u] += share;
+      }
+    }
+
+    for (const int v : order)
+    {
+      time[v] = infinity;
+      num_routes[v] = 0.0;
+      dependency[v] = 0.0;
+      settled[v] = 0;
+    }
+    order.clear();
+  }
+}
+
+LaneUsageAnalysis::Result LaneUsageAnalysis::update(const Level& level)
+{
+  const auto start_time = std::chrono::steady_clock::now();
+  Result result;
+  result.usage.assign(level.edges.size(), 0.0);
+
+  vector<Part> parts = split_parts(level);
+  result.num_parts = static_cast<int>(parts.size());
+
+  // the parts which weren't kept, and the sources to search them from;
+  // parts alike (a graph copied into another) are searched once
+  vector<int> computed;
+  std::unordered_set<std::uint64_t> computing;
+  vector<vector<int>> sources(parts.size());
+  vector<double> weights(parts.size(), 1.0);
+  for (std::size_t p = 0; p < parts.size(); p++)
+  {
+    if (_kept.count(parts[p].hash) || !computing.insert(parts[p].hash).second)
+      continue;
+    computed.push_back(static_cast<int>(p));
+    const int num_vertices = static_cast<int>(parts[p].vertices.size());
+    vector<int>& part_sources = sources[p];
+    part_sources.resize(num_vertices);
+    std::iota(part_sources.begin(), part_sources.end(), 0);
+    if (_options.max_sources > 0 && num_vertices > _options.max_sources)
+    {
+      // the same sample for as long as the part stays the same
+      std::mt19937_64 random(parts[p].hash);
+      std::shuffle(part_sources.begin(), part_sources.end(), random);
+      part_sources.resize(_options.max_sources);
+      weights[p] = static_cast<double>(num_vertices) / _options.max_sources;
+      result.sampled = true;
+    }
+  }
+  result.num_computed = static_cast<int>(computed.size());
+
+  TaskPool& pool = TaskPool::instance();
+  pool.parallel_for(
+    static_cast<int>(computed.size()),
+    [&](const int i)
+    {
+      build_arcs(level, parts[computed[i]]);
+    });
+
+  // a few blocks of sources per part, each with usage of its own, so that
+  // the threads never write to the same place
+  struct Block
+  {
+    int part;
+    int first;
+    int last;
+    vector<double> usage;
+  };
+  vector<Block> blocks;
+  const int blocks_per_part = std::max(1, 2 * QThread::idealThreadCount());
+  for (const int p : computed)
+  {
+    const int num_sources = static_cast<int>(sources[p].size());
+    const int num_blocks = std::min(num_sources, blocks_per_part);
+    for (int b = 0; b < num_blocks; b++)
+    {
+      Block block;
+      block.part = p;
+      block.first = num_sources * b / num_blocks;
+      block.last = num_sources * (b + 1) / num_blocks;
+      blocks.push_back(std::move(block));
+    }
+  }
+  pool.parallel_for(
+    static_cast<int>(blocks.size()),
+    [&](const int i)
+    {
+      Block& block = blocks[i];
+      const Part& part = parts[block.part];
+      block.usage.assign(part.lanes.size(), 0.0);
+      accumulate(
+        part,
+        sources[block.part],
+        block.first,
+        block.last,
+        weights[block.part],
+        block.usage);
+    });
+
+  std::unordered_map<std::uint64_t, vector<double>> kept;
+  for (const Block& block : blocks)
+  {
+    vector<double>& usage = kept[parts[block.part].hash];
+    if (usage.empty())
+      usage.assign(block.usage.size(), 0.0);
+    for (std::size_t i = 0; i < usage.size(); i++)
+      usage[i] += block.usage[i];
+  }
+  for (const Part& part : parts)
+  {
+    auto it = _kept.find(part.hash);
+    if (it != _kept.end() && !kept.count(part.hash))
+      kept[part.hash] = std::move(it->second);
+    const vector<double>& usage = kept[part.hash];
+    for (std::size_t i = 0; i < part.lanes.size(); i++)
+    {
+      const double value = usage[i];
+      result.usage[part.lanes[i]] = value;
+      if (value > result.max_usage)
+      {
+        result.max_usage = value;
+        result.busiest_edge_idx = part.lanes[i];
+      }
+    }
+  }
+  _kept = std::move(kept);
+
+  result.ms = std::chrono::duration<double, std::milli>(
+    std::chrono::steady_clock::now() - start_time).count();
+  return result;
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__LANE_USAGE_ANALYSIS_HPP
+#define TRAFFIC_EDITOR__LANE_USAGE_ANALYSIS_HPP
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class Level;
+
+//=============================================================================
+/// How much traffic each lane of a level would carry if robots drove the
+/// quickest route between every pair of vertices of its graph (by
+/// Edge::get_graph_idx()): the edge betweenness centrality of the lanes,
+/// with each lane taking its length over the robot speed, or over its
+/// speed_limit if that is lower. Routes which tie share their pair.
+///
+/// Every lane belongs to the connected part of its graph that its ends
+/// are in, and the routes never leave it, so each part is worked out on
+/// its own, from every one of its vertices (Brandes' algorithm) or, past
+/// Options::max_sources of them, from a sample which is scaled up. The
+/// parts are hashed from their lanes and the positions of their vertices,
+/// numbered in the order of the lanes, and the results of the parts which
+/// hash the same as at the last update() are kept, so an edit only costs
+/// the parts it touched. The searches from the sources are spread over
+/// the TaskPool.
+///
+/// update() only reads the level, and may run on a worker thread with an
+/// immutable copy (see BuildingSnapshot) while the level goes on being
+/// edited, as long as no other thread is using the same analysis.
+class LaneUsageAnalysis
+{
+public:
+  struct Options
+  {
+    double speed = 0.5;  // m/s, or the lane's speed_limit if that is lower
+    int max_sources = 256;  // per connected part, or 0 for every vertex
+  };
+
+  struct Result
+  {
+    /// Pairs of vertices whose quickest route runs along each lane, by
+    /// edge index, both ways for bidirectional lanes; 0 for other edges
+    std::vector<double> usage;
+    double max_usage = 0.0;
+    int busiest_edge_idx = -1;
+
+    int num_parts = 0;
+    int num_computed = 0;  // parts searched again, rather than kept
+    bool sampled = false;  // some part had more than max_sources vertices
+    double ms = 0.0;
+  };
+
+  /// Changing the options forgets the kept results
+  void set_options(const Options& options);
+  const Options& options() const { return _options; }
+
+  Result update(const Level& level);
+
+  void clear();
+
+private:
+  /// One connected part of a graph, with its vertices numbered from 0 in
+  /// the order the lanes reach them
+  struct Part
+  {
+    std::uint64_t hash = 0;
+    std::vector<int> lanes;  // edge indices
+    std::vector<int> vertices;  // level vertex indices, by local index
+
+    // compressed sparse rows of the arcs into each local vertex
+    std::vector<int> in_offsets;
+    std::vector<int> in_sources;
+    std::vector<double> in_times;  // seconds
+    std::vector<int> in_lanes;  // index into lanes
+
+    // and of those out of it
+    std::vector<int> out_offsets;
+    std::vector<int> out_targets;
+    std::vector<double> out_times;
+  };
+
+  Options _options;
+
+  /// The usage of the lanes of each part kept from the last update(), by
+  /// hash, in the order of Part::lanes
+  std::unordered_map<std::uint64_t, std::vector<double>> _kept;
+
+  std::vector<Part> split_parts(const Level& level) const;
+  void build_arcs(const Level& level, Part& part) const;
+
+  /// The searches from sources [first, last) of a part, added into usage
+  static void accumulate(
+    const Part& part,
+    const std::vector<int>& sources,
+    const int first,
+    const int last,
+    const double weight,
+    std::vector<double>& usage);
+};
+
+#endif
@@ -15,13 +15,21 @@
  *
 */
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <vector>
 
 #include <QImageReader>
+#include <QGraphicsItemGroup>
 #include <QGraphicsPixmapItem>
 #include <QGraphicsScene>
 #include <QTableWidget>
+#include <QtConcurrent/QtConcurrent>
+#include "decoded_image_cache.hpp"
 #include "layer.h"
+#include "logging.hpp"
+#include "tiled_pixmap_item.hpp"
 using std::string;
 using std::vector;
 
@@ -29,11 +37,10 @@ Layer::Layer()
 {
 }
 
-Layer::~Layer()
-{
-}
-
-bool Layer::from_yaml(const std::string& _name, const YAML::Node& y)
+bool Layer::from_yaml(
+  const std::string& _name,
+  const YAML::Node& y,
+  const bool decode_image)
 {
   if (!y.IsMap())
     throw std::runtime_error("Layer::from_yaml() expected a map");
@@ -99,28 +106,77 @@ bool Layer::from_yaml(const std::string& _name, const YAML::Node& y)
     }
   }
 
-  return load_image();
+  return decode_image ? load_image() : true;
 }
 
 bool Layer::load_image()
 {
-  QImageReader image_reader(QString::fromStdString(filename));
-  image_reader.setAutoTransform(true);
-  image = image_reader.read();
-  if (image.isNull())
+  QString error_string;
+  const QImage decoded = DecodedImageCache::load(
+    QString::fromStdString(filename),
+    QImage::Format_Grayscale8,
+    &error_string);
+  if (decoded.isNull())
   {
     qWarning("unable to read %s: %s",
       qUtf8Printable(QString::fromStdString(filename)),
-      qUtf8Printable(image_reader.errorString()));
+      qUtf8Printable(error_string));
     return false;
   }
-  image = image.convertToFormat(QImage::Format_Grayscale8);
+
+  // occupancy grids have only a few gray values, so keep them packed
+  packed_image = PackedImage::pack(decoded);
+  image = packed_image.is_null() ? decoded : QImage();
   colorize_image();
-  printf("successfully opened %s\n", filename.c_str());
+  qCDebug(lc_io, "successfully opened %s", filename.c_str());
 
   return true;
 }
 
+void Layer::unload_image()
+{
+  image = QImage();
+  packed_image = PackedImage();
+  pixmap = QPixmap();
+  tiles.reset();
+}
+
+void Layer::take_image(Layer& other)
+{
+  std::swap(image, other.image);
+  std::swap(packed_image, other.packed_image);
+  other.unload_image();
+  colorize_image();
+}
+
+QSize Layer::image_size() const
+{
+  if (!packed_image.is_null())
+    return packed_image.size();
+  return image.isNull() ? QSize() : image.size();
+}
+
+std::size_t Layer::image_bytes() const
+{
+  return source_bytes() + drawn_bytes();
+}
+
+std::size_t Layer::source_bytes() const
+{
+  return static_cast<std::size_t>(image.bytesPerLine()) * image.height() +
+    packed_image.bytes();
+}
+
+std::size_t Layer::drawn_bytes() const
+{
+  // the tiles keep the indexed image, one byte per pixel
+  std::size_t bytes = static_cast<std::size_t>(pixmap.width()) *
+    pixmap.height() * pixmap.depth() / 8;
+  if (tiles)
+    bytes += static_cast<std::size_t>(tiles->width()) * tiles->height();
+  return bytes;
+}
+
 YAML::Node Layer::to_yaml() const
 {
   YAML::Node y;
@@ -146,54 +202,114 @@ void Layer::draw(
   const double level_meters_per_pixel,
   const CoordinateSystem& coordinate_system)
 {
-  if (!visible)
-    return;
+  clear_scene();
+
+  // everything is drawn in layer pixels; the groups take it to the level
+  _drawn_scale = transform.scale() > 0.0 ? transform.scale() : 1.0;
+  const double to_layer = 1.0 / _drawn_scale;
 
-  QGraphicsPixmapItem* item = scene->addPixmap(pixmap);
+  QGraphicsItem* item = nullptr;
+  if (tiles)
+  {
+    item = new TiledPixmapItem(tiles);
+    scene->addItem(item);
+  }
+  else
+    item = scene->addPixmap(pixmap);
 
   // Store for later use in getting coordinates back out
   scene_item = item;
 
-  item->setPos(
-    transform.translation().x() / level_meters_per_pixel,
-    transform.translation().y() / level_meters_per_pixel);
-
-  item->setScale(transform.scale() / level_meters_per_pixel);
-
-  item->setRotation(-1.0 * transform.yaw() * 180.0 / M_PI);
-
   if (!coordinate_system.is_y_flipped())
-    item->setTransform(item->transform().scale(1, -1));
+    item->setTransform(QTransform::fromScale(1, -1));
 
-  double origin_radius = 0.5 / level_meters_per_pixel;
+  double origin_radius = 0.5 * to_layer;
   QPen origin_pen(color, origin_radius / 4.0, Qt::SolidLine, Qt::RoundCap);
-  //origin_pen.setWidthF(origin_radius / 4);
 
   // for purposes of the origin mark, let's say the origin is the center
   // of the first pixel of the image
-  const QPointF origin(
-    transform.translation().x() / level_meters_per_pixel
-    + 0.5 * transform.scale() / level_meters_per_pixel *
-    cos(transform.yaw() - M_PI / 4),
-    transform.translation().y() / level_meters_per_pixel
-    - 0.5 * transform.scale() / level_meters_per_pixel *
-    sin(transform.yaw() - M_PI / 4));
-
-  scene->addEllipse(
-    origin.x() - origin_radius,
-    origin.y() - origin_radius,
+  const QPointF origin(0.5 * M_SQRT1_2, 0.5 * M_SQRT1_2);
+
+  QGraphicsEllipseItem* origin_item = scene->addEllipse(
+    -origin_radius,
+    -origin_radius,
     2 * origin_radius,
     2 * origin_radius,
     origin_pen);
+  QGraphicsLineItem* x_arrow_item = scene->addLine(
+    QLineF(QPointF(0, 0), QPointF(2.0 * origin_radius, 0)),
+    origin_pen);
+  origin_item->setPos(origin);
+  x_arrow_item->setPos(origin);
+  _marker_items.append(origin_item);
+  _marker_items.append(x_arrow_item);
+
+  scene_group = new QGraphicsItemGroup;
+  scene->addItem(scene_group);
+  scene_group->addToGroup(item);
+  scene_group->addToGroup(origin_item);
+  scene_group->addToGroup(x_arrow_item);
+
+  feature_group = new QGraphicsItemGroup;
+  scene->addItem(feature_group);
+  feature_group->setZValue(200.0);
+  for (const Feature& feature : features)
+  {
+    for (QGraphicsItem* marker_item : feature.draw_marker(
+        scene,
+        color,
+        feature.qpoint(),
+        Feature::radius_meters * to_layer,
+        0.025 * to_layer))
+    {
+      feature_group->addToGroup(marker_item);
+      _marker_items.append(marker_item);
+    }
+  }
+
+  update_scene_transform(level_meters_per_pixel);
+  update_visibility();
+}
 
-  QPointF x_arrow(
-    origin.x() + 2.0 * origin_radius * cos(transform.yaw()),
-    origin.y() - 2.0 * origin_radius * sin(transform.yaw()));
-  scene->addLine(QLineF(origin, x_arrow), origin_pen);
+void Layer::update_visibility()
+{
+  if (scene_group)
+    scene_group->setVisible(visible);
+  if (feature_group)
+    feature_group->setVisible(visible);
+}
+
+bool Layer::update_scene_transform(const double level_meters_per_pixel)
+{
+  if (!scene_group || !feature_group)
+    return false;
 
+  // Transform::forwards(), then to level pixels
+  const double k = transform.scale() / level_meters_per_pixel;
+  const double c = std::cos(transform.yaw());
+  const double s = std::sin(transform.yaw());
+  const QTransform to_level(
+    k * c, -k * s,
+    k * s, k * c,
+    transform.translation().x() / level_meters_per_pixel,
+    transform.translation().y() / level_meters_per_pixel);
+  scene_group->setTransform(to_level);
+  feature_group->setTransform(to_level);
+
+  // the marks keep their size in meters whatever the scale of the layer
+  const double marker_scale =
+    transform.scale() > 0.0 ? _drawn_scale / transform.scale() : 1.0;
+  for (QGraphicsItem* marker_item : _marker_items)
+    marker_item->setScale(marker_scale);
+  return true;
+}
 
-  for (Feature& feature : features)
-    feature.draw(scene, color, transform, level_meters_per_pixel);
+void Layer::clear_scene()
+{
+  scene_item = nullptr;
+  scene_group = nullptr;
+  feature_group = nullptr;
+  _marker_items.clear();
 }
 
 QColor Layer::default_color(const int layer_idx)
@@ -231,7 +347,7 @@ QUuid Layer::add_feature(
   const double y,
   const double level_meters_per_pixel)
 {
-  printf("Layer::add_feature(%s, %.3f, %.3f, %.3f)\n",
+  qCDebug(lc_edit, "Layer::add_feature(%s, %.3f, %.3f, %.3f)",
     name.c_str(),
     x,
     y,
@@ -241,7 +357,8 @@ QUuid Layer::add_feature(
   const double mpp = level_meters_per_pixel;
   QPointF layer_pixel = transform.backwards(QPointF(x * mpp, y * mpp));
 
-  printf("  transformed: (%.3f, %.3f)\n", layer_pixel.x(), layer_pixel.y());
+  qCDebug(lc_edit,
+    "  transformed: (%.3f, %.3f)", layer_pixel.x(), layer_pixel.y());
   features.push_back(Feature(layer_pixel));
 
   return features.rbegin()->id();
@@ -271,7 +388,8 @@ const Feature* Layer::find_feature(
     }
   }
 
-  printf("min_dist = %.3f   layer scale = %.3f\n", min_dist, transform.scale());
+  qCDebug(lc_edit,
+    "min_dist = %.3f   layer scale = %.3f", min_dist, transform.scale());
 
   if (min_dist * transform.scale() < Feature::radius_meters)
     return min_feature;
@@ -295,33 +413,87 @@ void Layer::clear_selection()
     feature.setSelected(false);
 }
 
-void Layer::colorize_image()
+void Layer::update_color_lut()
 {
+  // the grayscale value of each pixel is all it takes to find its color
   color.setAlphaF(0.5);
-  colorized_image = QImage(image.size(), QImage::Format_ARGB32);
-  for (int row_idx = 0; row_idx < image.height(); row_idx++)
+  const QRgb layer_rgba = color.rgba();
+  for (int i = 0; i < 256; i++)
   {
-    const uint8_t* const in_row = (uint8_t*)image.scanLine(row_idx);
-    QRgb* out_row = (QRgb*)colorized_image.scanLine(row_idx);
+    if (i < 100)
+      color_lut[i] = layer_rgba;
+    else if (i > 200)
+      color_lut[i] = qRgba(0, 0, 0, 0);
+    else
+      color_lut[i] = qRgba(i, i, i, 50);
+  }
+}
 
-    for (int col_idx = 0; col_idx < image.width(); col_idx++)
-    {
-      const uint8_t in = in_row[col_idx];
-      if (in < 100 || row_idx == 0 || row_idx == image.height() - 1)
-        out_row[col_idx] = color.rgba();
-      else if (in > 200)
-        out_row[col_idx] = qRgba(0, 0, 0, 0);
-      else
-        out_row[col_idx] = qRgba(in, in, in, 50);
-    }
+void Layer::colorize_image()
+{
+  update_color_lut();
+  if (!image_loaded())
+    return;
 
-    // draw bold first/last columns the requested color on the image,
-    // so it's easier to see what's going on with its transform
-    out_row[0] = color.rgba();
-    out_row[image.width()-1] = color.rgba();
+  // the colors are the color table of an indexed image, whose indices are
+  // the gray values, so filling it is a copy or expansion of the rows.
+  // Transparent layers still convert to a 32-bit pixmap for drawing, but
+  // the huge ones are only converted a tile at a time.
+  const QSize size = image_size();
+  const int width = size.width();
+  const int height = size.height();
+  QImage indexed(size, QImage::Format_Indexed8);
+  QVector<QRgb> color_table(256);
+  std::copy(color_lut, color_lut + 256, color_table.begin());
+  indexed.setColorTable(color_table);
+
+  // split the image into bands of rows, which are filled in parallel
+  const int rows_per_band = 64;
+  std::vector<int> band_start_rows;
+  for (int row_idx = 0; row_idx < height; row_idx += rows_per_band)
+    band_start_rows.push_back(row_idx);
+
+  const PackedImage* const packed =
+    packed_image.is_null() ? nullptr : &packed_image;
+  const uchar* const in_bits = image.isNull() ? nullptr : image.constBits();
+  const int in_stride = image.bytesPerLine();
+  uchar* const out_bits = indexed.bits();
+  const int out_stride = indexed.bytesPerLine();
+
+  QtConcurrent::blockingMap(
+    band_start_rows,
+    [=](const int band_start_row)
+    {
+      const int band_end_row = std::min(band_start_row + rows_per_band, height);
+      for (int row_idx = band_start_row; row_idx < band_end_row; row_idx++)
+      {
+        uint8_t* const out_row = out_bits + row_idx * out_stride;
+
+        // index 0 is the layer color: draw bold first/last rows and
+        // columns with it, so it's easier to see what's going on with
+        // the transform of the layer
+        if (row_idx == 0 || row_idx == height - 1)
+          std::memset(out_row, 0, width);
+        else if (packed)
+          packed->expand_row(row_idx, out_row);
+        else
+          std::memcpy(out_row, in_bits + row_idx * in_stride, width);
+
+        out_row[0] = 0;
+        out_row[width - 1] = 0;
+      }
+    });
+
+  if (static_cast<long long>(width) * height > TiledImage::PIXEL_THRESHOLD)
+  {
+    pixmap = QPixmap();
+    tiles = std::make_shared<TiledImage>(indexed);
+  }
+  else
+  {
+    tiles.reset();
+    pixmap = QPixmap::fromImage(indexed);
   }
-
-  pixmap = QPixmap::fromImage(colorized_image);
 }
 
 void Layer::populate_property_editor(QTableWidget* property_editor) const
@@ -18,16 +18,23 @@
 #ifndef LAYER_H
 #define LAYER_H
 
+#include <cstddef>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include <QList>
 #include <QPixmap>
 #include <yaml-cpp/yaml.h>
 
 #include "coordinate_system.h"
 #include "feature.hpp"
+#include "packed_image.hpp"
 #include "transform.hpp"
 
+class TiledImage;
+class QGraphicsItem;
+class QGraphicsItemGroup;
 class QGraphicsScene;
 class QGraphicsPixmapItem;
 class QTableWidget;
@@ -37,7 +44,6 @@ class Layer
 {
 public:
   Layer();
-  ~Layer();
 
   std::string name;
   std::string filename;
@@ -52,16 +58,62 @@ public:
 
   Transform transform;
 
-  QImage image, colorized_image;
+  /// The decoded grayscale image. An image of only a few gray values, such
+  /// as an occupancy grid, is kept in packed_image instead, and this one is
+  /// released.
+  QImage image;
+  PackedImage packed_image;
+
+  /// What is drawn: the colorized image as a pixmap, or for layers of more
+  /// than TiledImage::PIXEL_THRESHOLD pixels, as tiles which are uploaded
+  /// when they are first painted. The colorized copy itself isn't kept.
   QPixmap pixmap;
-  QGraphicsPixmapItem* scene_item = nullptr;  // Borrowed pointer, not owned, don't delete
+  std::shared_ptr<TiledImage> tiles;
+
+  QGraphicsItem* scene_item = nullptr;  // Borrowed pointer, not owned, don't delete
+
+  /// The drawn items of the layer, in layer pixels, with the transform to
+  /// level pixels as the groups' transform: the pixmap and origin mark in
+  /// one group, and the features, which go above everything else on the
+  /// level, in another. Borrowed, like scene_item.
+  QGraphicsItemGroup* scene_group = nullptr;
+  QGraphicsItemGroup* feature_group = nullptr;
 
   std::vector<Feature> features;
 
-  bool from_yaml(const std::string& name, const YAML::Node& data);
+  /// If decode_image is false the image is left for a later load_image()
+  bool from_yaml(
+    const std::string& name,
+    const YAML::Node& data,
+    const bool decode_image = true);
   YAML::Node to_yaml() const;
 
   bool load_image();
+  bool image_loaded() const
+  {
+    return !image.isNull() || !packed_image.is_null();
+  }
+
+  /// In pixels, or empty if the image isn't loaded
+  QSize image_size() const;
+
+  /// Release the decoded image and pixmap; load_image() brings them back
+  void unload_image();
+
+  /// Take the decoded image of another layer of the same file, colorized
+  /// in the color of this one
+  void take_image(Layer& other);
+
+  /// Approximate memory held by the decoded or packed image, and by what
+  /// is drawn: source_bytes() + drawn_bytes()
+  std::size_t image_bytes() const;
+  std::size_t source_bytes() const;
+  std::size_t drawn_bytes() const;
+
+  /// Rebuild pixmap or tiles from the grayscale image and the current
+  /// color. The rows are expanded into an indexed image whose color table
+  /// is a 256-entry table of the colors of the gray values, on the thread
+  /// pool, so this is cheap enough to call on every color edit.
   void colorize_image();
 
   void draw(
@@ -69,6 +121,19 @@ public:
     const double level_meters_per_pixel,
     const CoordinateSystem& coordinate_system);
 
+  /// Move the drawn layer to its current transform by setting the
+  /// transforms of its groups, which is cheap enough to do on every
+  /// keystroke or solver step, however big the image. Returns false if
+  /// the layer isn't drawn.
+  bool update_scene_transform(const double level_meters_per_pixel);
+
+  /// Show or hide the drawn items to match `visible`. The layer is drawn
+  /// whether or not it is visible, so toggling it is only this.
+  void update_visibility();
+
+  /// Forget the drawn items, after the scene was cleared
+  void clear_scene();
+
   QColor color;
 
   static QColor default_color(const int layer_idx);
@@ -93,6 +158,16 @@ public:
   void populate_property_editor(QTableWidget* property_editor) const;
 
   std::vector<std::pair<std::string, std::string>> transform_strings;
+
+private:
+  /// The origin mark and feature markers are drawn at this scale, in
+  /// layer pixels; at any other, they are scaled back to their own size
+  double _drawn_scale = 1.0;
+  QList<QGraphicsItem*> _marker_items;
+
+  /// Color of each grayscale value of the image, for colorize_image()
+  QRgb color_lut[256];
+  void update_color_lut();
 };
 
 #endif
@@ -36,11 +36,13 @@ void LayerTable::update(
 {
   if (level_idx >= static_cast<int>(building.levels.size()))
   {
+    _level = nullptr;
     clearContents();
     return;
   }
 
   Level& level = building.levels[level_idx];
+  _level = &level;
 
   blockSignals(true);  // otherwise we get tons of callbacks
   setRowCount(2 + level.layers.size());
@@ -66,92 +68,103 @@ void LayerTable::update(
 
   const int last_row_idx = static_cast<int>(level.layers.size()) + 1;
   // we'll use the last row for the "Add" button
-  setCellWidget(last_row_idx, 0, nullptr);
-  setCellWidget(last_row_idx, 1, nullptr);
-  setCellWidget(last_row_idx, 2, nullptr);
-  QPushButton* add_button = new QPushButton("Add...", this);
-  setCellWidget(last_row_idx, 3, add_button);
-  connect(
-    add_button,
-    &QAbstractButton::clicked,
-    [=]() { emit add_button_clicked(); });
+  set_cell_text(last_row_idx, 0, QString())->setFont(QFont());
+  clear_cell_widget(last_row_idx, 0);
+  clear_cell_widget(last_row_idx, 1);
+  clear_cell_widget(last_row_idx, 2);
+  bool created = false;
+  QPushButton* add_button = cell_button(last_row_idx, 3, "Add...", created);
+  if (created)
+  {
+    connect(
+      add_button,
+      &QAbstractButton::clicked,
+      [=]() { emit add_button_clicked(); });
+  }
 
   blockSignals(false);  // re-enable callbacks
 }
 
 void LayerTable::set_row(
-  Level& level,
+  Level& /*level*/,
   const int row_idx,
   const QString& label,
   const QColor& color,
   const bool checked,
   const bool is_active_layer)
 {
-  QTableWidgetItem* name_item = new QTableWidgetItem(label);
-  if (is_active_layer)
+  QTableWidgetItem* name_item = set_cell_text(row_idx, 0, label);
+  if (name_item->font().bold() != is_active_layer)
   {
     QFont font;
-    font.setBold(true);
+    font.setBold(is_active_layer);
     name_item->setFont(font);
   }
-  setItem(row_idx, 0, name_item);
-
-  QPushButton* color_button = new QPushButton("", this);
-
-  color_button->setStyleSheet(
-    QString::asprintf(
-      "background-color: rgb(%d, %d, %d)",
-      color.red(),
-      color.green(),
-      color.blue()));
 
-  setCellWidget(row_idx, 1, color_button);
-
-  if (row_idx > 0)
+  bool created = false;
+  QPushButton* color_button = cell_button(row_idx, 1, "", created);
+  const QString style = QString::asprintf(
+    "background-color: rgb(%d, %d, %d)",
+    color.red(),
+    color.green(),
+    color.blue());
+  if (color_button->styleSheet() != style)
+    color_button->setStyleSheet(style);
+  if (created)
   {
     connect(
       color_button,
       &QAbstractButton::clicked,
-      [this, &level, color_button, row_idx]()
+      [this, color_button]()
       {
+        const int row = row_of(color_button, 1);
+        if (_level == nullptr || row <= 0 ||
+          row > static_cast<int>(_level->layers.size()))
+          return;  // the floorplan has no color
         QColor selected_color = QColorDialog::getColor(
-          level.layers[row_idx - 1].color);
+          _level->layers[row - 1].color);
         if (selected_color.isValid())
         {
           selected_color.setAlphaF(0.5);
-          level.layers[row_idx - 1].color = selected_color;
-          level.layers[row_idx - 1].colorize_image();
+          _level->layers[row - 1].color = selected_color;
+          _level->layers[row - 1].colorize_image();
           emit redraw_scene();
         }
       }
     );
   }
 
-  QCheckBox* visible_checkbox = new QCheckBox();
-  visible_checkbox->setChecked(checked);
-  setCellWidget(row_idx, 2, visible_checkbox);
-
-  QPushButton* button = new QPushButton("Edit...", this);
-  setCellWidget(row_idx, 3, button);
-
-  connect(
-    visible_checkbox,
-    &QAbstractButton::clicked,
-    [this, &level, row_idx](bool box_checked)
-    {
-      if (row_idx == 0)
-      {
-        level.set_drawing_visible(box_checked);
-      }
-      else if (row_idx > 0)
+  QCheckBox* visible_checkbox = cell_check_box(row_idx, 2, created);
+  if (visible_checkbox->isChecked() != checked)
+    visible_checkbox->setChecked(checked);
+  if (created)
+  {
+    connect(
+      visible_checkbox,
+      &QAbstractButton::clicked,
+      [this, visible_checkbox](bool box_checked)
       {
-        level.layers[row_idx-1].visible = box_checked;
-      }
-      emit redraw_scene();
-    });
+        const int row = row_of(visible_checkbox, 2);
+        if (_level == nullptr)
+          return;
+        if (row == 0)
+        {
+          _level->set_drawing_visible(box_checked);
+        }
+        else if (row > 0 && row <= static_cast<int>(_level->layers.size()))
+        {
+          _level->layers[row-1].visible = box_checked;
+        }
+        emit visibility_changed();
+      });
+  }
 
-  connect(
-    button,
-    &QAbstractButton::clicked,
-    [=]() { emit edit_button_clicked(row_idx); });
+  QPushButton* button = cell_button(row_idx, 3, "Edit...", created);
+  if (created)
+  {
+    connect(
+      button,
+      &QAbstractButton::clicked,
+      [this, button]() { emit edit_button_clicked(row_of(button, 3)); });
+  }
 }
@@ -44,8 +44,15 @@ public:
 
 signals:
   void redraw_scene();
+
+  /// A visibility checkbox was toggled; the level doesn't need a redraw
+  void visibility_changed();
   void add_button_clicked();
   void edit_button_clicked(const int row_idx);
+
+private:
+  /// The level shown, which the buttons (connected once) act on
+  Level* _level = nullptr;
 };
 
 #endif
@@ -19,35 +19,58 @@
 #include <cmath>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <set>
+#include <tuple>
+#include <type_traits>
 
 #include "ceres/ceres.h"
+#include <QElapsedTimer>
 #include <QGraphicsOpacityEffect>
 #include <QGraphicsPixmapItem>
 #include <QGraphicsScene>
 #include <QImage>
 #include <QImageReader>
+#include <QSaveFile>
 
+#include "decoded_image_cache.hpp"
+#include "draw_profile.hpp"
+#include "io_profile.hpp"
+#include "label_cache.hpp"
 #include "level.h"
+#include "logging.hpp"
+#include "scene_geometry.hpp"
+#include "scene_item_pool.hpp"
+#include "trace.hpp"
+#include "transform_cost.hpp"
 #include "yaml_utils.h"
 
 using std::string;
 using std::vector;
 
+// The entity vectors are appended to as a level is loaded or edited. If
+// moving their elements could throw, every reallocation would copy them,
+// params and all, instead.
+static_assert(
+  std::is_nothrow_move_constructible<Vertex>::value &&
+  std::is_nothrow_move_constructible<Edge>::value &&
+  std::is_nothrow_move_constructible<Polygon>::value &&
+  std::is_nothrow_move_constructible<Model>::value &&
+  std::is_nothrow_move_constructible<Param>::value,
+  "the entities of a level should be moved, not copied, on reallocation");
 
-Level::Level()
-{
-}
 
-Level::~Level()
+Level::Level()
 {
 }
 
 bool Level::from_yaml(
   const std::string& _name,
   const YAML::Node& _data,
-  const CoordinateSystem& coordinate_system)
+  const CoordinateSystem& coordinate_system,
+  const bool decode_images)
 {
-  printf("parsing level [%s]\n", _name.c_str());
+  qCDebug(lc_io, "parsing level [%s]", _name.c_str());
   name = _name;
 
   if (!_data.IsMap())
@@ -81,6 +104,9 @@ bool Level::from_yaml(
     drawing_height = y_meters / drawing_meters_per_pixel;
   }
 
+  if (_data["vector_underlay"])
+    vector_underlay.from_yaml(_data["vector_underlay"]);
+
   parse_vertices(_data);
 
   if (_data["fiducials"] && _data["fiducials"].IsSequence())
@@ -90,7 +116,7 @@ bool Level::from_yaml(
     {
       Fiducial f;
       f.from_yaml(*it);
-      fiducials.push_back(f);
+      fiducials.push_back(std::move(f));
     }
   }
 
@@ -101,7 +127,7 @@ bool Level::from_yaml(
     {
       Feature f;
       f.from_yaml(*it);
-      floorplan_features.push_back(f);
+      floorplan_features.push_back(std::move(f));
     }
   }
 
@@ -112,7 +138,7 @@ bool Level::from_yaml(
     {
       Constraint c;
       c.from_yaml(*it);
-      constraints.push_back(c);
+      constraints.push_back(std::move(c));
     }
   }
 
@@ -134,7 +160,7 @@ bool Level::from_yaml(
     {
       Model m;
       m.from_yaml(*it, this->name);
-      models.push_back(m);
+      models.push_back(std::move(m));
     }
   }
 
@@ -145,7 +171,7 @@ bool Level::from_yaml(
     {
       Polygon p;
       p.from_yaml(*it, Polygon::FLOOR);
-      polygons.push_back(p);
+      polygons.push_back(std::move(p));
     }
   }
 
@@ -156,7 +182,7 @@ bool Level::from_yaml(
     {
       Polygon p;
       p.from_yaml(*it, Polygon::HOLE);
-      polygons.push_back(p);
+      polygons.push_back(std::move(p));
     }
   }
 
@@ -169,42 +195,384 @@ bool Level::from_yaml(
     for (YAML::const_iterator it = yl.begin(); it != yl.end(); ++it)
     {
       Layer layer;
-      layer.from_yaml(it->first.as<string>(), it->second);
-      layers.push_back(layer);
+      layer.from_yaml(it->first.as<string>(), it->second, decode_images);
+      layers.push_back(std::move(layer));
     }
   }
 
   return true;
 }
 
-bool Level::load_drawing()
+namespace {
+
+/// The size of the image behind this reader once its EXIF orientation is
+/// applied, which is what read() returns with setAutoTransform(true)
+QSize oriented_size(QImageReader& reader)
+{
+  const QSize size = reader.size();
+  if (size.isValid() &&
+    (reader.transformation() & QImageIOHandler::TransformationRotate90))
+    return size.transposed();
+  return size;
+}
+
+}  // namespace
+
+bool Level::load_drawing(const int preview_size)
 {
   if (drawing_filename.empty())
     return true;// nothing to load
 
-  printf("  level %s drawing: %s\n",
+  qCDebug(lc_io, "  level %s drawing: %s",
     name.c_str(),
     drawing_filename.c_str());
 
   QString qfilename = QString::fromStdString(drawing_filename);
 
-  QImageReader image_reader(qfilename);
-  image_reader.setAutoTransform(true);
-  QImage image = image_reader.read();
+  // a cached drawing is only a memory map away, so a preview won't help
+  if (preview_size > 0 &&
+    !DecodedImageCache::contains(qfilename, QImage::Format_Grayscale8) &&
+    load_drawing_preview(preview_size))
+    return true;
+
+  QString error_string;
+  const QImage image = DecodedImageCache::load(
+    qfilename,
+    QImage::Format_Grayscale8,
+    &error_string);
   if (image.isNull())
   {
     qWarning("unable to read %s: %s",
       qUtf8Printable(qfilename),
-      qUtf8Printable(image_reader.errorString()));
+      qUtf8Printable(error_string));
+    return false;
+  }
+  set_drawing_image(image);
+  return true;
+}
+
+bool Level::load_drawing_preview(const int preview_size)
+{
+  QImageReader reader(QString::fromStdString(drawing_filename));
+  reader.setAutoTransform(true);
+  const QSize stored_size = reader.size();
+  if (!stored_size.isValid() ||
+    std::max(stored_size.width(), stored_size.height()) <= preview_size)
+    return false;
+
+  // the scaled size is of the stored image, before it is rotated; readers
+  // which can (JPEG, some PNGs) decode straight to it, skipping most of
+  // the work of a full decode
+  const double scale = static_cast<double>(preview_size) /
+    std::max(stored_size.width(), stored_size.height());
+  reader.setScaledSize(
+    QSize(
+      std::max(1, qRound(stored_size.width() * scale)),
+      std::max(1, qRound(stored_size.height() * scale))));
+  const QSize full_size = oriented_size(reader);
+  const QImage preview = reader.read();
+  if (preview.isNull())
     return false;
+
+  // scene coordinates stay in pixels of the full drawing
+  drawing_width = full_size.width();
+  drawing_height = full_size.height();
+  floorplan_tiles.reset();
+  floorplan_pixmap = QPixmap::fromImage(
+    preview.convertToFormat(QImage::Format_Grayscale8));
+  _drawing_preview_scale =
+    static_cast<double>(drawing_width) / preview.width();
+  qCDebug(lc_io, "  decoded a %dx%d preview of the %dx%d drawing",
+    preview.width(),
+    preview.height(),
+    drawing_width,
+    drawing_height);
+  return true;
+}
+
+void Level::set_drawing_image(const QImage& image)
+{
+  drawing_width = image.width();
+  drawing_height = image.height();
+  _drawing_preview_scale = 1.0;
+
+  const long long num_pixels =
+    static_cast<long long>(drawing_width) * drawing_height;
+  if (num_pixels > TiledImage::PIXEL_THRESHOLD)
+  {
+    // too big for a single pixmap; only the visible tiles are uploaded
+    qCInfo(lc_io, "  drawing is %dx%d; using tiled rendering",
+      drawing_width,
+      drawing_height);
+    floorplan_pixmap = QPixmap();
+    floorplan_tiles = std::make_shared<TiledImage>(image);
+  }
+  else
+  {
+    floorplan_tiles.reset();
+    floorplan_pixmap = QPixmap::fromImage(image);
+  }
+}
+
+bool Level::read_drawing_size()
+{
+  if (drawing_filename.empty())
+    return true;
+
+  QImageReader reader(QString::fromStdString(drawing_filename));
+  reader.setAutoTransform(true);
+  QSize size = oriented_size(reader);
+  if (!size.isValid())
+  {
+    // this format doesn't say, so decode it just for the size (but not
+    // into a pixmap, which would need a QGuiApplication)
+    size = reader.read().size();
+    if (size.isEmpty())
+    {
+      qWarning("unable to read %s: %s",
+        drawing_filename.c_str(),
+        qUtf8Printable(reader.errorString()));
+      return false;
+    }
   }
-  image = image.convertToFormat(QImage::Format_Grayscale8);
-  floorplan_pixmap = QPixmap::fromImage(image);
-  drawing_width = floorplan_pixmap.width();
-  drawing_height = floorplan_pixmap.height();
+
+  drawing_width = size.width();
+  drawing_height = size.height();
   return true;
 }
 
+bool Level::load_images(const int preview_size, IoProfile* profile)
+{
+  if (_images_loaded)
+    return true;
+  _images_loaded = true;
+
+  bool ok = true;
+  QElapsedTimer timer;
+  if (floorplan_pixmap.isNull() && !floorplan_tiles &&
+    !drawing_filename.empty())
+  {
+    timer.start();
+    ok = load_drawing(preview_size) && ok;
+    if (profile)
+      profile->add_image(
+        drawing_filename,
+        drawing_is_preview() ? floorplan_pixmap.width() : drawing_width,
+        drawing_is_preview() ? floorplan_pixmap.height() : drawing_height,
+        timer.nsecsElapsed());
+  }
+
+  for (Layer& layer : layers)
+  {
+    if (layer.image_loaded())
+      continue;
+    timer.start();
+    ok = layer.load_image() && ok;
+    if (profile)
+      profile->add_image(
+        layer.filename,
+        layer.image_size().width(),
+        layer.image_size().height(),
+        timer.nsecsElapsed());
+  }
+  return ok;
+}
+
+void Level::unload_images()
+{
+  floorplan_pixmap = QPixmap();
+  floorplan_tiles.reset();
+  _drawing_preview_scale = 1.0;
+  for (Layer& layer : layers)
+    layer.unload_image();
+  _images_loaded = false;
+}
+
+void Level::unload_image(const int layer_idx)
+{
+  if (layer_idx < 0)
+  {
+    floorplan_pixmap = QPixmap();
+    floorplan_tiles.reset();
+    _drawing_preview_scale = 1.0;
+  }
+  else if (layer_idx < static_cast<int>(layers.size()))
+    layers[layer_idx].unload_image();
+  _images_loaded = false;
+}
+
+void Level::take_images(Level& other)
+{
+  if (other.drawing_filename == drawing_filename &&
+    (!other.floorplan_pixmap.isNull() || other.floorplan_tiles))
+  {
+    std::swap(floorplan_pixmap, other.floorplan_pixmap);
+    floorplan_tiles = std::move(other.floorplan_tiles);
+    _drawing_preview_scale = other._drawing_preview_scale;
+    drawing_width = other.drawing_width;
+    drawing_height = other.drawing_height;
+  }
+
+  // the lines don't need the file to be read again either
+  const VectorUnderlay& underlay = other.vector_underlay;
+  if (!vector_underlay.empty() && !vector_underlay.lines && underlay.lines &&
+    underlay.filename == vector_underlay.filename &&
+    underlay.layers == vector_underlay.layers &&
+    underlay.meters_per_unit == vector_underlay.meters_per_unit &&
+    underlay.origin_x == vector_underlay.origin_x &&
+    underlay.origin_y == vector_underlay.origin_y)
+    vector_underlay.lines = underlay.lines;
+
+  for (Layer& layer : layers)
+  {
+    for (Layer& other_layer : other.layers)
+    {
+      if (other_layer.name == layer.name &&
+        other_layer.filename == layer.filename &&
+        other_layer.image_loaded())
+      {
+        layer.take_image(other_layer);
+        break;
+      }
+    }
+  }
+  _images_loaded = false;  // load_images() skips those already decoded
+}
+
+std::size_t Level::image_bytes() const
+{
+  std::size_t bytes = 0;
+  if (floorplan_tiles)
+    bytes += static_cast<std::size_t>(drawing_width) * drawing_height;
+  else
+    bytes += static_cast<std::size_t>(floorplan_pixmap.width()) *
+      floorplan_pixmap.height() * floorplan_pixmap.depth() / 8;
+
+  for (const Layer& layer : layers)
+    bytes += layer.image_bytes();
+  return bytes;
+}
+
+QRectF Level::web_mercator_scroll_area()
+{
+  // the picking grids mirror the positions in packed arrays, which are
+  // much quicker to scan than the entities themselves
+  update_picking_index();
+  double x_min = std::numeric_limits<double>::max();
+  double y_min = std::numeric_limits<double>::max();
+  double x_max = std::numeric_limits<double>::lowest();
+  double y_max = std::numeric_limits<double>::lowest();
+  auto extend = [&](const SpatialGrid& grid)
+    {
+      double x0, y0, x1, y1;
+      if (!grid.bounds(x0, y0, x1, y1))
+        return;
+      x_min = std::min(x_min, x0);
+      y_min = std::min(y_min, y0);
+      x_max = std::max(x_max, x1);
+      y_max = std::max(y_max, y1);
+    };
+  extend(_vertex_grid);
+  extend(_model_grid);
+  if (x_max < x_min)
+  {
+    x_min = 0.0;
+    y_min = 0.0;
+    x_max = x_meters / drawing_meters_per_pixel;
+    y_max = y_meters / drawing_meters_per_pixel;
+  }
+
+  // as big again on each side, and at least a kilometer
+  const double margin = std::max(
+    1000.0 / drawing_meters_per_pixel,
+    std::max(x_max - x_min, y_max - y_min));
+  return QRectF(
+    x_min - margin,
+    y_min - margin,
+    x_max - x_min + 2 * margin,
+    y_max - y_min + 2 * margin);
+}
+
+MemoryReport::Usage Level::memory_usage() const
+{
+  MemoryReport::Usage usage;
+  std::size_t* bytes = usage.bytes;
+
+  if (floorplan_tiles)
+    bytes[MemoryReport::FLOORPLAN] +=
+      static_cast<std::size_t>(drawing_width) * drawing_height;
+  else
+    bytes[MemoryReport::FLOORPLAN] +=
+      MemoryReport::pixmap_bytes(floorplan_pixmap);
+
+  for (const Layer& layer : layers)
+  {
+    bytes[MemoryReport::LAYER_IMAGES] += layer.source_bytes();
+    bytes[MemoryReport::COLORIZED_IMAGES] += layer.drawn_bytes();
+    bytes[MemoryReport::CONSTRAINTS] +=
+      layer.features.capacity() * sizeof(Feature);
+    bytes[MemoryReport::OTHER] += MemoryReport::string_bytes(layer.name) +
+      MemoryReport::string_bytes(layer.filename);
+    if (layer.scene_item)
+      bytes[MemoryReport::SCENE_ITEMS] += MemoryReport::SCENE_ITEM_BYTES;
+  }
+  bytes[MemoryReport::OTHER] += layers.capacity() * sizeof(Layer);
+
+  bytes[MemoryReport::VERTICES] += vertices.capacity() * sizeof(Vertex);
+  for (const Vertex& v : vertices)
+    bytes[MemoryReport::VERTICES] +=
+      MemoryReport::string_bytes(v.name) + v.params.heap_bytes();
+
+  bytes[MemoryReport::EDGES] += edges.capacity() * sizeof(Edge);
+  for (const Edge& edge : edges)
+    bytes[MemoryReport::EDGES] += edge.params.heap_bytes();
+
+  bytes[MemoryReport::POLYGONS] += polygons.capacity() * sizeof(Polygon);
+  for (const Polygon& polygon : polygons)
+    bytes[MemoryReport::POLYGONS] +=
+      polygon.vertices.capacity() * sizeof(int) + polygon.params.heap_bytes();
+
+  // the thumbnails are shared with the editor models, and counted there
+  bytes[MemoryReport::MODELS] += models.capacity() * sizeof(Model);
+  for (const Model& model : models)
+  {
+    bytes[MemoryReport::MODELS] +=
+      MemoryReport::string_bytes(model.model_name) +
+      MemoryReport::string_bytes(model.instance_name) +
+      MemoryReport::string_bytes(model.starting_level);
+    if (model.pixmap_item)
+      bytes[MemoryReport::SCENE_ITEMS] += MemoryReport::SCENE_ITEM_BYTES;
+  }
+
+  bytes[MemoryReport::CONSTRAINTS] +=
+    constraints.capacity() * sizeof(Constraint) +
+    floorplan_features.capacity() * sizeof(Feature);
+
+  bytes[MemoryReport::OTHER] += tags.capacity() * sizeof(Tag) +
+    fiducials.capacity() * sizeof(Fiducial);
+  for (const Tag& tag : tags)
+    bytes[MemoryReport::OTHER] +=
+      MemoryReport::string_bytes(tag.name) + tag.params.heap_bytes();
+  for (const Fiducial& fiducial : fiducials)
+    bytes[MemoryReport::OTHER] += MemoryReport::string_bytes(fiducial.name);
+
+  std::size_t num_items = 0;
+  for (int kind = 0; kind < SceneItems::NUM_KINDS; kind++)
+    num_items +=
+      _scene_items.item_count(static_cast<SceneItems::Kind>(kind));
+  if (_vertex_layer)
+    num_items++;
+  for (const EdgeLayerItem* layer : _edge_layers)
+  {
+    if (layer)
+      num_items++;
+  }
+  bytes[MemoryReport::SCENE_ITEMS] +=
+    num_items * MemoryReport::SCENE_ITEM_BYTES;
+
+  return usage;
+}
+
 YAML::Node Level::to_yaml() const
 {
   YAML::Node y;
@@ -219,6 +587,8 @@ YAML::Node Level::to_yaml() const
     y["x_meters"] = x_meters;
     y["y_meters"] = y_meters;
   }
+  if (!vector_underlay.empty())
+    y["vector_underlay"] = vector_underlay.to_yaml();
   y["elevation"] = elevation;
   y["flattened_x_offset"] = flattened_x_offset;
   y["flattened_y_offset"] = flattened_y_offset;
@@ -260,7 +630,7 @@ YAML::Node Level::to_yaml() const
         dict_name = "human_lanes";
         break;
       default:
-        printf("tried to save unknown edge type: %d\n",
+        qCWarning(lc_io, "tried to save unknown edge type: %d",
           static_cast<int>(edge.type));
         break;
     }
@@ -281,7 +651,7 @@ YAML::Node Level::to_yaml() const
         y["holes"].push_back(polygon.to_yaml());
         break;
       default:
-        printf("tried to save an unknown polygon type: %d\n",
+        qCWarning(lc_io, "tried to save an unknown polygon type: %d",
           static_cast<int>(polygon.type));
         break;
     }
@@ -296,71 +666,46 @@ YAML::Node Level::to_yaml() const
 
 bool Level::can_delete_current_selection()
 {
-  // if a feature is selected, refuse to delete it if it's in a constraint
-  for (const Feature& feature : floorplan_features)
-  {
-    if (!feature.selected())
-      continue;
-    for (const Constraint& constraint : constraints)
-    {
-      if (constraint.includes_id(feature.id()))
-        return false;
-    }
-  }
+  vector<SelectedItem> selected_items;
+  get_selected_items(selected_items);
 
-  for (const Layer& layer : layers)
+  for (const SelectedItem& item : selected_items)
   {
-    for (const Feature& feature : layer.features)
+    // if a feature is selected, refuse to delete it if it's in a constraint
+    if (item.feature_idx >= 0)
     {
-      if (!feature.selected())
-        continue;
-
+      const Feature& feature = item.feature_layer_idx == 0 ?
+        floorplan_features[item.feature_idx] :
+        layers[item.feature_layer_idx - 1].features[item.feature_idx];
       for (const Constraint& constraint : constraints)
       {
         if (constraint.includes_id(feature.id()))
           return false;
       }
     }
-  }
 
-  int selected_vertex_idx = -1;
-  for (int i = 0; i < static_cast<int>(vertices.size()); i++)
-  {
-    if (vertices[i].selected)
+    if (item.vertex_idx < 0)
+      continue;
+
+    // a vertex can only go if every edge and polygon using it goes too
+    for (const int edge_idx : vertex_edges(item.vertex_idx))
     {
-      selected_vertex_idx = i;
-      break;  // just grab the index of the first selected vertex
+      if (!edges[edge_idx].selected)
+        return false;
     }
-  }
-
-  if (selected_vertex_idx < 0)
-    return true;
-
-  bool vertex_used = false;
-  for (const auto& edge : edges)
-  {
-    if (edge.start_idx == selected_vertex_idx ||
-      edge.end_idx == selected_vertex_idx)
-      vertex_used = true;
-  }
-  for (const auto& polygon : polygons)
-  {
-    for (const int& vertex_idx : polygon.vertices)
+    for (const int polygon_idx : vertex_polygons(item.vertex_idx))
     {
-      if (vertex_idx == selected_vertex_idx)
-        vertex_used = true;
+      if (!polygons[polygon_idx].selected)
+        return false;
     }
-  }
-  if (vertex_used)
-    return false;// don't try to delete a vertex used in a shape
 
-  /// check if this is a lift_cabin waypoint
-  const auto v = vertices[selected_vertex_idx];
-  auto it = v.params.find("lift_cabin");
-  if ((it != v.params.end()))
-  {
-    printf("This waypoint is used by a lift cabin!!");
-    return false;
+    /// check if this is a lift_cabin waypoint
+    const Vertex& v = vertices[item.vertex_idx];
+    if (v.params.find("lift_cabin") != v.params.end())
+    {
+      qCWarning(lc_edit, "this waypoint is used by a lift cabin");
+      return false;
+    }
   }
 
   return true;
@@ -368,6 +713,12 @@ bool Level::can_delete_current_selection()
 
 bool Level::delete_selected()
 {
+  // check everything up front, so that a refusal leaves the level intact
+  if (!can_delete_current_selection())
+    return false;
+
+  mark_all_changed();
+
   edges.erase(
     std::remove_if(
       edges.begin(),
@@ -382,6 +733,13 @@ bool Level::delete_selected()
       [](const auto& model) { return model.selected; }),
     models.end());
 
+  tags.erase(
+    std::remove_if(
+      tags.begin(),
+      tags.end(),
+      [](const Tag& tag) { return tag.selected; }),
+    tags.end());
+
   fiducials.erase(
     std::remove_if(
       fiducials.begin(),
@@ -403,104 +761,102 @@ bool Level::delete_selected()
       [](const Constraint& constraint) { return constraint.selected(); }),
     constraints.end());
 
-  // Vertices take a lot more care, because we have to check if a vertex
-  // is used in an edge or a polygon before deleting it, and update all
-  // higher-index vertex indices in the edges and polygon vertex lists.
-  // Since this is a potentially expensive operation, first we'll spin
-  // through the vertex list and see if any vertices are selected, and
-  // only then make a copy of the vertex list.
-  int selected_vertex_idx = -1;
-  for (int i = 0; i < static_cast<int>(vertices.size()); i++)
+  // Compact the vertex list in one pass, remembering where each surviving
+  // vertex went, then fix up the edges and polygons in a second pass.
+  // None of the remaining edges or polygons use a deleted vertex, since
+  // can_delete_current_selection() checked that.
+  vector<int> vertex_remap(vertices.size(), -1);
+  std::size_t num_vertices = 0;
+  for (std::size_t i = 0; i < vertices.size(); i++)
   {
     if (vertices[i].selected)
-    {
-      selected_vertex_idx = i;
-      break;  // just grab the index of the first selected vertex
-    }
+      continue;
+    vertex_remap[i] = static_cast<int>(num_vertices);
+    if (num_vertices != i)
+      vertices[num_vertices] = std::move(vertices[i]);
+    num_vertices++;
   }
-  if (selected_vertex_idx >= 0)
-  {
-    // See if this vertex is used in any edges/polygons.
-    bool vertex_used = false;
-    for (const auto& edge : edges)
-    {
-      if (edge.start_idx == selected_vertex_idx ||
-        edge.end_idx == selected_vertex_idx)
-        vertex_used = true;
-    }
-    for (const auto& polygon : polygons)
-    {
-      for (const int& vertex_idx : polygon.vertices)
-      {
-        if (vertex_idx == selected_vertex_idx)
-          vertex_used = true;
-      }
-    }
-    if (vertex_used)
-      return false;// don't try to delete a vertex used in a shape
 
-    // the vertex is not currently being used, so let's erase it
-    vertices.erase(vertices.begin() + selected_vertex_idx);
+  if (num_vertices != vertices.size())
+  {
+    vertices.resize(num_vertices);
 
-    // now go through all edges and polygons to decrement any larger indices
     for (Edge& edge : edges)
     {
-      if (edge.start_idx > selected_vertex_idx)
-        edge.start_idx--;
-      if (edge.end_idx > selected_vertex_idx)
-        edge.end_idx--;
+      edge.start_idx = vertex_remap[edge.start_idx];
+      edge.end_idx = vertex_remap[edge.end_idx];
     }
 
     for (Polygon& polygon : polygons)
     {
-      for (int i = 0; i < static_cast<int>(polygon.vertices.size()); i++)
-      {
-        if (polygon.vertices[i] > selected_vertex_idx)
-          polygon.vertices[i]--;
-      }
+      for (int& vertex_idx : polygon.vertices)
+        vertex_idx = vertex_remap[vertex_idx];
     }
   }
 
-  // if a feature is selected, refuse to delete it if it's in a constraint
-  for (std::size_t i = 0; i < floorplan_features.size(); i++)
+  auto feature_selected = [](const Feature& f) { return f.selected(); };
+  floorplan_features.erase(
+    std::remove_if(
+      floorplan_features.begin(),
+      floorplan_features.end(),
+      feature_selected),
+    floorplan_features.end());
+
+  for (Layer& layer : layers)
   {
-    if (!floorplan_features[i].selected())
-      continue;
+    layer.features.erase(
+      std::remove_if(
+        layer.features.begin(),
+        layer.features.end(),
+        feature_selected),
+      layer.features.end());
+  }
 
-    for (std::size_t j = 0; j < constraints.size(); j++)
-    {
-      if (constraints[j].includes_id(floorplan_features[i].id()))
-        return false;
-    }
+  return true;
+}
 
-    floorplan_features.erase(floorplan_features.begin() + i);
-    return true;
-  }
+void Level::restore_vertices(
+  const vector<int>& indices,
+  const vector<Vertex>& restored)
+{
+  if (restored.empty())
+    return;
 
-  for (std::size_t layer_idx = 0; layer_idx < layers.size(); layer_idx++)
-  {
-    Layer& layer = layers[layer_idx];
-    for (std::size_t i = 0; i < layer.features.size(); i++)
-    {
-      if (!layer.features[i].selected())
-        continue;
+  mark_all_changed();
 
-      for (std::size_t j = 0; j < constraints.size(); j++)
-      {
-        if (constraints[j].includes_id(layer.features[i].id()))
-          return false;
-      }
+  // Merge the restored vertices back into their original slots. The
+  // indices are ascending and refer to positions in the merged list.
+  vector<int> vertex_remap(vertices.size());
+  vector<Vertex> merged;
+  merged.reserve(vertices.size() + restored.size());
+  std::size_t next_restored = 0;
+  for (std::size_t i = 0; i < vertices.size(); i++)
+  {
+    while (next_restored < restored.size() &&
+      indices[next_restored] <= static_cast<int>(merged.size()))
+      merged.push_back(restored[next_restored++]);
+    vertex_remap[i] = static_cast<int>(merged.size());
+    merged.push_back(std::move(vertices[i]));
+  }
+  while (next_restored < restored.size())
+    merged.push_back(restored[next_restored++]);
+  vertices.swap(merged);
 
-      layer.features.erase(layer.features.begin() + i);
-      return true;
-    }
+  for (Edge& edge : edges)
+  {
+    edge.start_idx = vertex_remap[edge.start_idx];
+    edge.end_idx = vertex_remap[edge.end_idx];
   }
 
-  return true;
+  for (Polygon& polygon : polygons)
+  {
+    for (int& vertex_idx : polygon.vertices)
+      vertex_idx = vertex_remap[vertex_idx];
+  }
 }
 
-void Level::get_selected_items(
-  std::vector<Level::SelectedItem>& items)
+void Level::scan_selected_items(
+  std::vector<Level::SelectedItem>& items) const
 {
   for (std::size_t i = 0; i < edges.size(); i++)
   {
@@ -599,118 +955,437 @@ void Level::get_selected_items(
   }
 }
 
-void Level::calculate_scale(const CoordinateSystem& coordinate_system)
+bool Level::changes_touch_selection() const
 {
-  // for now, just calculate the mean of the scale estimates
-  double scale_sum = 0.0;
-  int scale_count = 0;
-
-  for (auto& edge : edges)
+  if (_changes.all)
+    return true;
+  for (const SelectedItem& item : _changes.items)
   {
-    if (edge.type == Edge::MEAS)
-    {
-      scale_count++;
-      const double dx = vertices[edge.start_idx].x - vertices[edge.end_idx].x;
-      const double dy = vertices[edge.start_idx].y - vertices[edge.end_idx].y;
-      const double distance_pixels = std::sqrt(dx*dx + dy*dy);
-      // todo: a clean, strongly-typed parameter API for edges
-      const double distance_meters =
-        edge.params[std::string("distance")].value_double;
-      scale_sum += distance_meters / distance_pixels;
-    }
+    if (is_selected(item))
+      return true;
   }
+  return false;
+}
 
-  if (scale_count > 0)
+bool Level::is_selected(const SelectedItem& item) const
+{
+  if (item.edge_idx >= 0)
+    return item.edge_idx < static_cast<int>(edges.size()) &&
+      edges[item.edge_idx].selected;
+  if (item.model_idx >= 0)
+    return item.model_idx < static_cast<int>(models.size()) &&
+      models[item.model_idx].selected;
+  if (item.vertex_idx >= 0)
+    return item.vertex_idx < static_cast<int>(vertices.size()) &&
+      vertices[item.vertex_idx].selected;
+  if (item.tag_idx >= 0)
+    return item.tag_idx < static_cast<int>(tags.size()) &&
+      tags[item.tag_idx].selected;
+  if (item.fiducial_idx >= 0)
+    return item.fiducial_idx < static_cast<int>(fiducials.size()) &&
+      fiducials[item.fiducial_idx].selected;
+  if (item.polygon_idx >= 0)
+    return item.polygon_idx < static_cast<int>(polygons.size()) &&
+      polygons[item.polygon_idx].selected;
+  if (item.feature_idx >= 0 && item.feature_layer_idx == 0)
+    return item.feature_idx < static_cast<int>(floorplan_features.size()) &&
+      floorplan_features[item.feature_idx].selected();
+  if (item.feature_idx >= 0 && item.feature_layer_idx > 0)
   {
-    drawing_meters_per_pixel = scale_sum / static_cast<double>(scale_count);
-    printf("used %d measurements to estimate meters/pixel as %.5f\n",
-      scale_count, drawing_meters_per_pixel);
+    if (item.feature_layer_idx > static_cast<int>(layers.size()))
+      return false;
+    const Layer& layer = layers[item.feature_layer_idx - 1];
+    return item.feature_idx < static_cast<int>(layer.features.size()) &&
+      layer.features[item.feature_idx].selected();
   }
-  else
-    drawing_meters_per_pixel = coordinate_system.default_scale();
+  if (item.constraint_idx >= 0)
+    return item.constraint_idx < static_cast<int>(constraints.size()) &&
+      constraints[item.constraint_idx].selected();
+  return false;
+}
 
-  if (drawing_width && drawing_height && drawing_meters_per_pixel > 0.0)
+void Level::set_selected_flag(const SelectedItem& item, const bool selected)
+{
+  if (item.edge_idx >= 0 && item.edge_idx < static_cast<int>(edges.size()))
+    edges[item.edge_idx].selected = selected;
+  else if (item.model_idx >= 0 &&
+    item.model_idx < static_cast<int>(models.size()))
+    models[item.model_idx].selected = selected;
+  else if (item.vertex_idx >= 0 &&
+    item.vertex_idx < static_cast<int>(vertices.size()))
+    vertices[item.vertex_idx].selected = selected;
+  else if (item.tag_idx >= 0 && item.tag_idx < static_cast<int>(tags.size()))
+    tags[item.tag_idx].selected = selected;
+  else if (item.fiducial_idx >= 0 &&
+    item.fiducial_idx < static_cast<int>(fiducials.size()))
+    fiducials[item.fiducial_idx].selected = selected;
+  else if (item.polygon_idx >= 0 &&
+    item.polygon_idx < static_cast<int>(polygons.size()))
+    polygons[item.polygon_idx].selected = selected;
+  else if (item.feature_idx >= 0 && item.feature_layer_idx == 0 &&
+    item.feature_idx < static_cast<int>(floorplan_features.size()))
+    floorplan_features[item.feature_idx].setSelected(selected);
+  else if (item.feature_idx >= 0 && item.feature_layer_idx > 0 &&
+    item.feature_layer_idx <= static_cast<int>(layers.size()))
   {
-    x_meters = drawing_width * drawing_meters_per_pixel;
-    y_meters = drawing_height * drawing_meters_per_pixel;
+    Layer& layer = layers[item.feature_layer_idx - 1];
+    if (item.feature_idx < static_cast<int>(layer.features.size()))
+      layer.features[item.feature_idx].setSelected(selected);
   }
+  else if (item.constraint_idx >= 0 &&
+    item.constraint_idx < static_cast<int>(constraints.size()))
+    constraints[item.constraint_idx].setSelected(selected);
 }
 
-// todo: migrate this to the TrafficMap class eventually
-void Level::draw_lane(
-  QGraphicsScene* scene,
-  const Edge& edge,
-  const RenderingOptions& opts,
-  const vector<Graph>& graphs) const
+const ContentHash::LevelHashes& Level::content_hashes() const
 {
-  const int graph_idx = edge.get_graph_idx();
-  if (graph_idx >= 0 &&
-    graph_idx < static_cast<int>(opts.show_building_lanes.size()) &&
-    !opts.show_building_lanes[graph_idx])
-    return;// don't render this lane
+  if (content_hashes_stale())
+    ContentHash::hash_level(*this, _content_hashes);
+  return _content_hashes;
+}
 
-  const auto& v_start = vertices[edge.start_idx];
-  const auto& v_end = vertices[edge.end_idx];
-  const double dx = v_end.x - v_start.x;
-  const double dy = v_end.y - v_start.y;
-  const double len = std::sqrt(dx*dx + dy*dy);
+const std::map<int, std::vector<int>>& Level::lane_buckets() const
+{
+  if (_lane_buckets.valid && _lane_buckets.revision == _revision &&
+    _lane_buckets.num_edges == edges.size())
+    return _lane_buckets.lanes;
 
-  // see if there is a default width for this graph_idx
-  double graph_default_width = -1.0;
-  for (const auto& graph : graphs)
+  _lane_buckets.lanes.clear();
+  for (std::size_t i = 0; i < edges.size(); i++)
   {
-    if (graph.idx == graph_idx)
-    {
-      graph_default_width = graph.default_lane_width;
-      break;
-    }
+    const Edge& edge = edges[i];
+    if (edge.type == Edge::LANE || edge.type == Edge::HUMAN_LANE)
+      _lane_buckets.lanes[edge.get_graph_idx()].push_back(
+        static_cast<int>(i));
   }
+  _lane_buckets.valid = true;
+  _lane_buckets.revision = _revision;
+  _lane_buckets.num_edges = edges.size();
+  return _lane_buckets.lanes;
+}
 
-  double lane_width_meters = 1.0;
-  if (edge.get_width() > 0)
-    lane_width_meters = edge.get_width();
-  else if (graph_default_width > 0)
-    lane_width_meters = graph_default_width;
+const std::vector<int>& Level::graph_lanes(const int graph_idx) const
+{
+  static const std::vector<int> none;
+  const std::map<int, std::vector<int>>& buckets = lane_buckets();
+  const auto it = buckets.find(graph_idx);
+  return it == buckets.end() ? none : it->second;
+}
 
-  const double lane_pen_width = lane_width_meters / drawing_meters_per_pixel;
-  const double norm_x = dx / len;
-  const double norm_y = dy / len;
+void Level::select(const SelectedItem& item)
+{
+  if (is_selected(item))
+    return;
+  set_selected_flag(item, true);
+  if (_selection_valid && is_selected(item))
+    _selection.push_back(item);
+}
 
-  // only draw arrows if it's a unidirectional lane. We used to draw
-  // arrows in both directions for bidirectional, but it was messy.
-  if (!edge.is_bidirectional())
+void Level::get_selected_items(std::vector<Level::SelectedItem>& items)
+{
+  if (!_selection_valid)
   {
-    const QPen arrow_pen(
-      QBrush(QColor::fromRgbF(0.0, 0.0, 0.0, 0.5)),
-      lane_pen_width / 8);
+    _selection.clear();
+    scan_selected_items(_selection);
+    _selection_valid = true;
+  }
+  else
+  {
+    _selection.erase(
+      std::remove_if(
+        _selection.begin(),
+        _selection.end(),
+        [this](const SelectedItem& item) { return !is_selected(item); }),
+      _selection.end());
+
+    // list items in the same order as a scan of the level would
+    auto sort_key = [](const SelectedItem& item)
+      {
+        if (item.edge_idx >= 0)
+          return std::make_tuple(0, 0, item.edge_idx);
+        if (item.model_idx >= 0)
+          return std::make_tuple(1, 0, item.model_idx);
+        if (item.vertex_idx >= 0)
+          return std::make_tuple(2, 0, item.vertex_idx);
+        if (item.tag_idx >= 0)
+          return std::make_tuple(3, 0, item.tag_idx);
+        if (item.fiducial_idx >= 0)
+          return std::make_tuple(4, 0, item.fiducial_idx);
+        if (item.polygon_idx >= 0)
+          return std::make_tuple(5, 0, item.polygon_idx);
+        if (item.feature_idx >= 0)
+          return std::make_tuple(6, item.feature_layer_idx, item.feature_idx);
+        return std::make_tuple(7, 0, item.constraint_idx);
+      };
+    std::sort(
+      _selection.begin(),
+      _selection.end(),
+      [&sort_key](const SelectedItem& a, const SelectedItem& b)
+      {
+        return sort_key(a) < sort_key(b);
+      });
+    _selection.erase(
+      std::unique(
+        _selection.begin(),
+        _selection.end(),
+        [&sort_key](const SelectedItem& a, const SelectedItem& b)
+        {
+          return sort_key(a) == sort_key(b);
+        }),
+      _selection.end());
+  }
+  items.insert(items.end(), _selection.begin(), _selection.end());
+}
 
-    // dimensions for the direction indicators along this path
-    const double arrow_w = lane_pen_width / 2.5;  // width of arrowheads
-    const double arrow_l = lane_pen_width / 2.5;  // length of arrowheads
-    const double arrow_spacing = lane_pen_width * 4.0;
+void Level::select_within(
+  const QPolygonF& region,
+  const RenderingOptions& rendering_options)
+{
+  if (region.size() < 3)
+    return;
+  update_picking_index();
 
-    for (double d = 0.0; d < len; d += arrow_spacing)
+  const QRectF bounds = region.boundingRect();
+  auto inside = [&region](const double x, const double y)
     {
-      // first calculate the center vertex of this arrowhead
-      const double cx = v_start.x + d * norm_x;
-      const double cy = v_start.y + d * norm_y;
-      // one edge vertex of arrowhead
-      const double e1x = cx - arrow_w * norm_y;
-      const double e1y = cy + arrow_w * norm_x;
-      // another edge vertex of arrowhead
-      const double e2x = cx + arrow_w * norm_y;
-      const double e2y = cy - arrow_w * norm_x;
-      // tip of arrowhead
-      const double tx = cx + arrow_l * norm_x;
-      const double ty = cy + arrow_l * norm_y;
-      // now add arrowhead lines
-      scene->addLine(e1x, e1y, tx, ty, arrow_pen);
-      scene->addLine(e2x, e2y, tx, ty, arrow_pen);
-    }
-  }
+      return region.containsPoint(QPointF(x, y), Qt::OddEvenFill);
+    };
 
-  QColor color;
-  switch (edge.get_graph_idx())
+  std::vector<int> ids;
+  _vertex_grid.within(
+    bounds.left(), bounds.top(), bounds.right(), bounds.bottom(), ids);
+  for (const int vertex_idx : ids)
+  {
+    if (inside(vertices[vertex_idx].x, vertices[vertex_idx].y))
+      select(make_selected_item(VERTEX, vertex_idx));
+  }
+
+  if (rendering_options.show_models)
+  {
+    ids.clear();
+    _model_grid.within(
+      bounds.left(), bounds.top(), bounds.right(), bounds.bottom(), ids);
+    for (const int model_idx : ids)
+    {
+      const Model& m = models[model_idx];
+      if (inside(m.state.x, m.state.y))
+        select(make_selected_item(MODEL, model_idx));
+    }
+  }
+
+  ids.clear();
+  for (const auto& type_tree : _edge_trees)
+  {
+    type_tree.second.intersecting(
+      bounds.left(), bounds.top(), bounds.right(), bounds.bottom(), ids);
+  }
+  for (const int edge_idx : ids)
+  {
+    const Edge& edge = edges[edge_idx];
+    if (edge.type == Edge::LANE &&
+      edge.get_graph_idx() != rendering_options.active_traffic_map_idx)
+      continue;
+    const Vertex& v_start = vertices[edge.start_idx];
+    const Vertex& v_end = vertices[edge.end_idx];
+    if (inside(v_start.x, v_start.y) && inside(v_end.x, v_end.y))
+      select(make_selected_item(EDGE, edge_idx));
+  }
+
+  ids.clear();
+  _polygon_tree.intersecting(
+    bounds.left(), bounds.top(), bounds.right(), bounds.bottom(), ids);
+  for (const int polygon_idx : ids)
+  {
+    const QPolygonF& shape = _indexed_polygons[polygon_idx].shape;
+    bool all_inside = true;
+    for (const QPointF& point : shape)
+    {
+      if (!inside(point.x(), point.y()))
+      {
+        all_inside = false;
+        break;
+      }
+    }
+    if (all_inside)
+      select(make_selected_item(POLYGON, polygon_idx));
+  }
+}
+
+void Level::calculate_scale(const CoordinateSystem& coordinate_system)
+{
+  // for now, just calculate the mean of the scale estimates
+  double scale_sum = 0.0;
+  int scale_count = 0;
+
+  const int n_vertices = static_cast<int>(vertices.size());
+  for (const auto& edge : edges)
+  {
+    if (edge.type != Edge::MEAS ||
+      edge.start_idx < 0 || edge.start_idx >= n_vertices ||
+      edge.end_idx < 0 || edge.end_idx >= n_vertices)
+      continue;
+    const double distance_meters = edge.get_distance();
+    const double dx = vertices[edge.start_idx].x - vertices[edge.end_idx].x;
+    const double dy = vertices[edge.start_idx].y - vertices[edge.end_idx].y;
+    const double distance_pixels = std::sqrt(dx*dx + dy*dy);
+    if (distance_meters < 0.0 || distance_pixels <= 0.0)
+      continue;  // no distance, or it can't be scaled
+    scale_count++;
+    scale_sum += distance_meters / distance_pixels;
+  }
+
+  if (scale_count > 0)
+  {
+    drawing_meters_per_pixel = scale_sum / static_cast<double>(scale_count);
+    qCDebug(lc_io, "used %d measurements to estimate meters/pixel as %.5f",
+      scale_count, drawing_meters_per_pixel);
+  }
+  else
+    drawing_meters_per_pixel = coordinate_system.default_scale();
+
+  if (drawing_width && drawing_height && drawing_meters_per_pixel > 0.0)
+  {
+    x_meters = drawing_width * drawing_meters_per_pixel;
+    y_meters = drawing_height * drawing_meters_per_pixel;
+  }
+}
+
+QGraphicsItem* Level::lane_graph_root(
+  QGraphicsScene* scene,
+  const int graph_idx,
+  const RenderingOptions& opts)
+{
+  LaneGraphItems& graph_items = _lane_graphs[graph_idx];
+  if (!graph_items.root)
+  {
+    // an empty path item: it only serves to show or hide a whole graph
+    graph_items.root = scene->addPath(QPainterPath());
+    graph_items.root->setZValue(graph_idx + 1.0);
+    graph_items.root->setVisible(is_lane_graph_visible(graph_idx, opts));
+  }
+  return graph_items.root;
+}
+
+bool Level::is_lane_graph_visible(
+  const int graph_idx,
+  const RenderingOptions& opts) const
+{
+  return graph_idx < 0 ||
+    graph_idx >= static_cast<int>(opts.show_building_lanes.size()) ||
+    opts.show_building_lanes[graph_idx];
+}
+
+void Level::draw_lane_arrows(
+  QGraphicsScene* scene,
+  const int graph_idx,
+  const RenderingOptions& opts,
+  const vector<Graph>& graphs)
+{
+  QGraphicsItem* root = lane_graph_root(scene, graph_idx, opts);
+  LaneGraphItems& graph_items = _lane_graphs[graph_idx];
+  SceneItemPool& pool = SceneItemPool::instance();
+  pool.recycle(graph_items.arrows);
+  graph_items.arrows.clear();
+
+  // the arrow pen scales with the lane width, so lanes of different widths
+  // need separate paths; usually all lanes of a graph share one width.
+  // Only unidirectional lanes get arrows. We used to draw arrows in both
+  // directions for bidirectional, but it was messy.
+  std::map<double, QPainterPath> arrow_paths;
+  const bool use_geometry = _geometry && opts.cull_rect.isEmpty();
+  if (use_geometry)
+  {
+    const auto geometry_it = _geometry->lane_arrow_paths.find(graph_idx);
+    if (geometry_it != _geometry->lane_arrow_paths.end())
+      arrow_paths = geometry_it->second;
+  }
+  static const std::vector<int> no_lanes;
+  const std::vector<int>& lanes =
+    use_geometry ? no_lanes : graph_lanes(graph_idx);
+  for (const int i : lanes)
+  {
+    const Edge& edge = edges[i];
+    if (edge.is_bidirectional() || is_culled(SceneItems::EDGE, i, opts))
+      continue;
+    const double pen_width = SceneGeometry::lane_pen_width(
+      edge, graphs, drawing_meters_per_pixel);
+    SceneGeometry::add_lane_arrows(
+      arrow_paths[pen_width],
+      vertices[edge.start_idx],
+      vertices[edge.end_idx],
+      pen_width);
+  }
+
+  for (const auto& it : arrow_paths)
+  {
+    const QPen arrow_pen(
+      QBrush(QColor::fromRgbF(0.0, 0.0, 0.0, 0.5)),
+      it.first / 8);
+    QGraphicsPathItem* arrow_item =
+      pool.path(scene, it.second, arrow_pen, QBrush(), root);
+    arrow_item->setZValue(-1.0);  // below the lanes of this graph
+    // arrows vanish when zoomed far out, so lanes collapse into lines
+    LevelOfDetail::tag(arrow_item, LevelOfDetail::MEDIUM, opts.lod_tier);
+    graph_items.arrows.append(arrow_item);
+  }
+}
+
+QGraphicsItem* Level::models_root(
+  QGraphicsScene* scene,
+  const RenderingOptions& opts)
+{
+  if (!_models_root)
+  {
+    _models_root = scene->addPath(QPainterPath());
+    _models_root->setZValue(100.0);  // just anything taller than 0
+    _models_root->setVisible(opts.show_models);
+  }
+  return _models_root;
+}
+
+void Level::update_visibility(const RenderingOptions& opts)
+{
+  for (auto& it : _lane_graphs)
+  {
+    if (it.second.root)
+      it.second.root->setVisible(is_lane_graph_visible(it.first, opts));
+  }
+  if (_models_root)
+    _models_root->setVisible(opts.show_models);
+  if (_floorplan_item)
+    _floorplan_item->setVisible(_drawing_visible);
+  if (_underlay_item)
+    _underlay_item->setVisible(_drawing_visible);
+  for (Layer& layer : layers)
+    layer.update_visibility();
+}
+
+// todo: migrate this to the TrafficMap class eventually
+QList<QGraphicsItem*> Level::draw_lane(
+  QGraphicsScene* scene,
+  const Edge& edge,
+  const RenderingOptions& opts,
+  const vector<Graph>& graphs)
+{
+  QList<QGraphicsItem*> items;
+
+  // the lane is parented to its graph so that toggling the graph in the
+  // traffic table doesn't need a redraw. The arrows are drawn for all
+  // lanes of the graph at once in draw_lane_arrows()
+  QGraphicsItem* root = lane_graph_root(scene, edge.get_graph_idx(), opts);
+
+  const auto& v_start = vertices[edge.start_idx];
+  const auto& v_end = vertices[edge.end_idx];
+  const double dx = v_end.x - v_start.x;
+  const double dy = v_end.y - v_start.y;
+  const double len = std::sqrt(dx*dx + dy*dy);
+  const double lane_pen_width = SceneGeometry::lane_pen_width(
+    edge, graphs, drawing_meters_per_pixel);
+  const double norm_x = dx / len;
+  const double norm_y = dy / len;
+
+  QColor color;
+  switch (edge.get_graph_idx())
   {
     case 0: color.setRgbF(0.0, 0.5, 0.0); break;
     case 1: color.setRgbF(0.0, 0.0, 0.5); break;
@@ -729,15 +1404,16 @@ void Level::draw_lane(
   // always draw lanes somewhat transparent
   color.setAlphaF(0.5);
 
-  QGraphicsLineItem* lane_item = scene->addLine(
-    v_start.x, v_start.y,
-    v_end.x, v_end.y,
-    QPen(QBrush(color), lane_pen_width, Qt::SolidLine, Qt::RoundCap));
-  lane_item->setZValue(edge.get_graph_idx() + 1.0);
+  SceneItemPool& pool = SceneItemPool::instance();
+  QGraphicsLineItem* lane_item = pool.line(
+    scene,
+    QLineF(v_start.x, v_start.y, v_end.x, v_end.y),
+    QPen(QBrush(color), lane_pen_width, Qt::SolidLine, Qt::RoundCap),
+    root);
+  items.append(lane_item);
 
   // draw the orientation icon, if specified
-  auto orientation_it = edge.params.find("orientation");
-  if (orientation_it != edge.params.end())
+  if (edge.has_orientation())
   {
     // draw robot-outline box midway down this lane
     const double mx = (v_start.x + v_end.x) / 2.0;
@@ -783,26 +1459,36 @@ void Level::draw_lane(
     pp.moveTo(QPointF(mx, my));
 
     QPen orientation_pen(Qt::white, 5.0);
-    if (orientation_it->second.value_string == "forward")
+    if (edge.get_orientation() == "forward")
     {
       const double hix = mx + 1.0 * cos(yaw) / drawing_meters_per_pixel;
       const double hiy = my + 1.0 * sin(yaw) / drawing_meters_per_pixel;
       pp.lineTo(QPointF(hix, hiy));
-      QGraphicsPathItem* pi = scene->addPath(pp, orientation_pen);
-      pi->setZValue(edge.get_graph_idx() + 1.1);
+      QGraphicsPathItem* pi =
+        pool.path(scene, pp, orientation_pen, QBrush(), root);
+      pi->setZValue(0.1);  // above the lanes of this graph
+      LevelOfDetail::tag(pi, LevelOfDetail::MEDIUM, opts.lod_tier);
+      items.append(pi);
     }
-    else if (orientation_it->second.value_string == "backward")
+    else if (edge.get_orientation() == "backward")
     {
       const double hix = mx - 1.0 * cos(yaw) / drawing_meters_per_pixel;
       const double hiy = my - 1.0 * sin(yaw) / drawing_meters_per_pixel;
       pp.lineTo(QPointF(hix, hiy));
-      QGraphicsPathItem* pi = scene->addPath(pp, orientation_pen);
-      pi->setZValue(edge.get_graph_idx() + 1.1);
+      QGraphicsPathItem* pi =
+        pool.path(scene, pp, orientation_pen, QBrush(), root);
+      pi->setZValue(0.1);  // above the lanes of this graph
+      LevelOfDetail::tag(pi, LevelOfDetail::MEDIUM, opts.lod_tier);
+      items.append(pi);
     }
   }
+
+  return items;
 }
 
-void Level::draw_wall(QGraphicsScene* scene, const Edge& edge) const
+QList<QGraphicsItem*> Level::draw_wall(
+  QGraphicsScene* scene,
+  const Edge& edge) const
 {
   const auto& v_start = vertices[edge.start_idx];
   const auto& v_end = vertices[edge.end_idx];
@@ -810,31 +1496,42 @@ void Level::draw_wall(QGraphicsScene* scene, const Edge& edge) const
   const double r = edge.selected ? 0.5 : 0.0;
   const double b = edge.selected ? 0.0 : 0.5;
 
-  scene->addLine(
-    v_start.x, v_start.y,
-    v_end.x, v_end.y,
-    QPen(
-      QBrush(QColor::fromRgbF(r, 0.0, b, 0.5)),
-      0.2 / drawing_meters_per_pixel,
-      Qt::SolidLine, Qt::RoundCap));
+  QList<QGraphicsItem*> items;
+  items.append(
+    SceneItemPool::instance().line(
+      scene,
+      QLineF(v_start.x, v_start.y, v_end.x, v_end.y),
+      QPen(
+        QBrush(QColor::fromRgbF(r, 0.0, b, 0.5)),
+        0.2 / drawing_meters_per_pixel,
+        Qt::SolidLine, Qt::RoundCap)));
+  return items;
 }
 
-void Level::draw_meas(QGraphicsScene* scene, const Edge& edge) const
+QList<QGraphicsItem*> Level::draw_meas(
+  QGraphicsScene* scene,
+  const Edge& edge) const
 {
   const auto& v_start = vertices[edge.start_idx];
   const auto& v_end = vertices[edge.end_idx];
   const double b = edge.selected ? 0.0 : 0.5;
 
-  scene->addLine(
-    v_start.x, v_start.y,
-    v_end.x, v_end.y,
-    QPen(
-      QBrush(QColor::fromRgbF(0.5, 0, b, 0.5)),
-      0.5 / drawing_meters_per_pixel,
-      Qt::SolidLine, Qt::RoundCap));
+  QList<QGraphicsItem*> items;
+  items.append(
+    SceneItemPool::instance().line(
+      scene,
+      QLineF(v_start.x, v_start.y, v_end.x, v_end.y),
+      QPen(
+        QBrush(QColor::fromRgbF(0.5, 0, b, 0.5)),
+        0.5 / drawing_meters_per_pixel,
+        Qt::SolidLine, Qt::RoundCap)));
+  return items;
 }
 
-void Level::draw_door(QGraphicsScene* scene, const Edge& edge) const
+QList<QGraphicsItem*> Level::draw_door(
+  QGraphicsScene* scene,
+  const Edge& edge,
+  const LevelOfDetail::Tier lod_tier) const
 {
   const auto& v_start = vertices[edge.start_idx];
   const auto& v_end = vertices[edge.end_idx];
@@ -842,226 +1539,149 @@ void Level::draw_door(QGraphicsScene* scene, const Edge& edge) const
   const double door_thickness = 0.2;  // meters
   const double door_motion_thickness = 0.05;  // meters
 
-  auto door_axis_it = edge.params.find("motion_axis");
-  std::string door_axis("start");
-  if (door_axis_it != edge.params.end())
-    door_axis = door_axis_it->second.value_string;
-
-  double motion_degrees = 90;
-  auto motion_degrees_it = edge.params.find("motion_degrees");
-  if (motion_degrees_it != edge.params.end())
-    motion_degrees = std::abs(motion_degrees_it->second.value_double);
-
-  int motion_dir = 1;
-  auto motion_dir_it = edge.params.find("motion_direction");
-  if (motion_dir_it != edge.params.end())
-    motion_dir = motion_dir_it->second.value_int;
-
-  double right_left_ratio = 1.0;
-  auto right_left_ratio_it = edge.params.find("right_left_ratio");
-  if (right_left_ratio_it != edge.params.end())
-    right_left_ratio = right_left_ratio_it->second.value_double;
-
-  QPainterPath door_motion_path;
-
-  const double door_dx = v_end.x - v_start.x;
-  const double door_dy = v_end.y - v_start.y;
-  const double door_length = std::sqrt(door_dx * door_dx + door_dy * door_dy);
-  const double door_angle = std::atan2(door_dy, door_dx);
-
-  auto door_type_it = edge.params.find("type");
-  if (door_type_it != edge.params.end())
-  {
-    const double DEG2RAD = M_PI / 180.0;
-
-    const std::string& door_type = door_type_it->second.value_string;
-    if (door_type == "hinged")
-    {
-      const double hinge_x = door_axis == "start" ? v_start.x : v_end.x;
-      const double hinge_y = door_axis == "start" ? v_start.y : v_end.y;
-      const double angle_offset = door_axis == "start" ? 0.0 : M_PI;
-
-      add_door_swing_path(
-        door_motion_path,
-        hinge_x,
-        hinge_y,
-        door_length,
-        door_angle + angle_offset,
-        door_angle + angle_offset + DEG2RAD * motion_dir * motion_degrees);
-    }
-    else if (door_type == "double_hinged")
-    {
-      // right door
-      add_door_swing_path(
-        door_motion_path,
-        v_start.x,
-        v_start.y,
-        (right_left_ratio / (1 + right_left_ratio)) * door_length,
-        door_angle,
-        door_angle + DEG2RAD * motion_dir * motion_degrees);
-
-      // left door
-      add_door_swing_path(
-        door_motion_path,
-        v_end.x,
-        v_end.y,
-        (1 / (1 + right_left_ratio)) * door_length,
-        door_angle + M_PI,
-        door_angle + M_PI - DEG2RAD * motion_dir * motion_degrees);
-    }
-    else if (door_type == "sliding")
-    {
-      add_door_slide_path(
-        door_motion_path,
-        v_start.x,
-        v_start.y,
-        door_length,
-        door_angle);
-    }
-    else if (door_type == "double_sliding")
-    {
-      // right door
-      add_door_slide_path(
-        door_motion_path,
-        v_start.x,
-        v_start.y,
-        (right_left_ratio / (1 + right_left_ratio)) * door_length,
-        door_angle);
-
-      // left door
-      add_door_slide_path(
-        door_motion_path,
-        v_end.x,
-        v_end.y,
-        (1 / (1 + right_left_ratio)) * door_length,
-        door_angle + M_PI);
-    }
-    else
-    {
-      printf("tried to draw unknown door type: [%s]\n", door_type.c_str());
-    }
-  }
-  scene->addPath(
-    door_motion_path,
+  SceneItemPool& pool = SceneItemPool::instance();
+  QList<QGraphicsItem*> items;
+  QGraphicsPathItem* motion_item = pool.path(
+    scene,
+    door_motion_path(&edge - edges.data()),
     QPen(Qt::black, door_motion_thickness / drawing_meters_per_pixel));
+  LevelOfDetail::tag(motion_item, LevelOfDetail::MEDIUM, lod_tier);
+  items.append(motion_item);
 
   // add the doorjamb last, so it sits on top of the Z stack of the travel arc
-  scene->addLine(
-    v_start.x, v_start.y,
-    v_end.x, v_end.y,
-    QPen(
-      QBrush(QColor::fromRgbF(1.0, g, 0.0, 0.5)),
-      door_thickness / drawing_meters_per_pixel,
-      Qt::SolidLine, Qt::RoundCap));
+  items.append(
+    pool.line(
+      scene,
+      QLineF(v_start.x, v_start.y, v_end.x, v_end.y),
+      QPen(
+        QBrush(QColor::fromRgbF(1.0, g, 0.0, 0.5)),
+        door_thickness / drawing_meters_per_pixel,
+        Qt::SolidLine, Qt::RoundCap)));
+  return items;
 }
 
-void Level::add_door_slide_path(
-  QPainterPath& path,
-  double hinge_x,
-  double hinge_y,
-  double door_length,
-  double door_angle) const
+QPainterPath Level::door_motion_path(const std::size_t edge_idx) const
 {
-  // first draw the door as a thin line
-  path.moveTo(hinge_x, hinge_y);
-  path.lineTo(
-    hinge_x + door_length * std::cos(door_angle),
-    hinge_y + door_length * std::sin(door_angle));
-
-  // now draw a box around where it slides (in the wall, usually)
-  const double th = door_angle;  // makes expressions below single-line...
-  const double pi_2 = M_PI / 2.0;
-  const double s = 0.15 / drawing_meters_per_pixel;  // sliding panel thickness
-
-  const QPointF p1(
-    hinge_x - s * std::cos(th + pi_2),
-    hinge_y - s * std::sin(th + pi_2));
-
-  const QPointF p2(
-    hinge_x - s * std::cos(th + pi_2) - door_length * std::cos(th),
-    hinge_y - s * std::sin(th + pi_2) - door_length * std::sin(th));
-
-  const QPointF p3(
-    hinge_x + s * std::cos(th + pi_2) - door_length * std::cos(th),
-    hinge_y + s * std::sin(th + pi_2) - door_length * std::sin(th));
-
-  const QPointF p4(
-    hinge_x + s * std::cos(th + pi_2),
-    hinge_y + s * std::sin(th + pi_2));
-
-
-  path.moveTo(p1);
-  path.lineTo(p2);
-  path.lineTo(p3);
-  path.lineTo(p4);
-  path.lineTo(p1);
+  if (_geometry)
+    return _geometry->door_motion_paths[edge_idx];
+  const Edge& edge = edges[edge_idx];
+  return SceneGeometry::door_motion_path(
+    edge,
+    vertices[edge.start_idx],
+    vertices[edge.end_idx],
+    drawing_meters_per_pixel);
 }
 
-void Level::add_door_swing_path(
-  QPainterPath& path,
-  double hinge_x,
-  double hinge_y,
-  double door_length,
-  double start_angle,
-  double end_angle) const
+EdgeLayerItem* Level::edge_layer(const Edge::Type type) const
 {
-  path.moveTo(hinge_x, hinge_y);
-  path.lineTo(
-    hinge_x + door_length * std::cos(start_angle),
-    hinge_y + door_length * std::sin(start_angle));
-
-  const int NUM_MOTION_STEPS = 10;
-  const double angle_inc = (end_angle - start_angle) / (NUM_MOTION_STEPS-1);
-  for (int i = 0; i < NUM_MOTION_STEPS; i++)
+  switch (type)
   {
-    // compute door opening angle at this motion step
-    const double a = start_angle + i * angle_inc;
-
-    path.lineTo(
-      hinge_x + door_length * std::cos(a),
-      hinge_y + door_length * std::sin(a));
+    case Edge::WALL:
+      return _edge_layers[EdgeLayerItem::WALLS];
+    case Edge::MEAS:
+      return _edge_layers[EdgeLayerItem::MEASUREMENTS];
+    case Edge::DOOR:
+      return _edge_layers[EdgeLayerItem::DOORS];
+    default:
+      return nullptr;
   }
+}
 
-  path.lineTo(hinge_x, hinge_y);
+bool Level::batch_edge(const std::size_t idx)
+{
+  const Edge& edge = edges[idx];
+  EdgeLayerItem* const layer = edge_layer(edge.type);
+  if (!layer)
+    return false;
+  const Vertex& v_start = vertices[edge.start_idx];
+  const Vertex& v_end = vertices[edge.end_idx];
+  layer->set_edge(
+    idx,
+    QLineF(v_start.x, v_start.y, v_end.x, v_end.y),
+    edge.selected,
+    edge.type == Edge::DOOR ? door_motion_path(idx) : QPainterPath());
+  return true;
 }
 
-void Level::draw_polygon(
+
+QList<QGraphicsItem*> Level::draw_polygon(
   QGraphicsScene* scene,
-  const QBrush& brush,
-  const Polygon& polygon) const
+  const Polygon& polygon,
+  const RenderingOptions& rendering_options)
 {
+  QList<QGraphicsItem*> items;
+
+  // only floors and holes are rendered on the level
+  QBrush brush;
+  if (polygon.type == Polygon::FLOOR)
+    brush = QBrush(QColor::fromRgbF(0.9, 0.9, 0.9, 0.8));
+  else if (polygon.type == Polygon::HOLE)
+    brush = QBrush(QColor::fromRgbF(0.3, 0.3, 0.3, 0.5));
+  else
+    return items;
+
   QBrush selected_brush(QColor::fromRgbF(1.0, 0.0, 0.0, 0.5));
 
-  QVector<QPointF> polygon_vertices;
-  for (const auto& vertex_idx: polygon.vertices)
+  QPolygonF polygon_vertices;
+  const std::size_t polygon_idx = &polygon - polygons.data();
+  if (_geometry)
+    polygon_vertices = _geometry->polygons[polygon_idx];
+  else
   {
-    const Vertex& v = vertices[vertex_idx];
-    polygon_vertices.append(QPointF(v.x, v.y));
+    for (const auto& vertex_idx: polygon.vertices)
+    {
+      const Vertex& v = vertices[vertex_idx];
+      polygon_vertices.append(QPointF(v.x, v.y));
+    }
   }
 
-  scene->addPolygon(
-    QPolygonF(polygon_vertices),
+  SceneItemPool& pool = SceneItemPool::instance();
+  QGraphicsPolygonItem* item = pool.polygon(
+    scene,
+    polygon_vertices,
     QPen(Qt::black),
     polygon.selected ? selected_brush : brush);
-}
 
-void Level::draw_polygons(QGraphicsScene* scene) const
-{
-  const QBrush floor_brush(QColor::fromRgbF(0.9, 0.9, 0.9, 0.8));
-  const QBrush hole_brush(QColor::fromRgbF(0.3, 0.3, 0.3, 0.5));
+  // explicit Z values keep the holes above the floors and both beneath
+  // everything else, even when a single polygon is re-rendered later
+  item->setZValue(polygon.type == Polygon::HOLE ? -2.0 : -3.0);
+  items.append(item);
 
-  // first draw the floor polygons
-  for (const auto& polygon : polygons)
+  // what the generator will build the floor mesh from
+  if (rendering_options.show_floor_triangulation &&
+    polygon.type == Polygon::FLOOR)
   {
-    if (polygon.type == Polygon::FLOOR)
-      draw_polygon(scene, floor_brush, polygon);
+    const PolygonGeometry& geometry = polygon_geometry(polygon_idx);
+    QPainterPath path;
+    for (std::size_t i = 0; i + 2 < geometry.triangles.size(); i += 3)
+    {
+      path.moveTo(geometry.triangles[i]);
+      path.lineTo(geometry.triangles[i + 1]);
+      path.lineTo(geometry.triangles[i + 2]);
+      path.closeSubpath();
+    }
+    QGraphicsPathItem* triangles_item = pool.path(
+      scene,
+      path,
+      QPen(QColor::fromRgbF(0.0, 0.5, 0.0, 0.6), 0));
+    triangles_item->setZValue(-2.5);
+    items.append(triangles_item);
   }
+  return items;
+}
 
-  // now draw the holes
-  for (const auto& polygon : polygons)
+void Level::draw_polygons(
+  QGraphicsScene* scene,
+  const RenderingOptions& rendering_options)
+{
+  // floors and holes are stacked by their Z values, so a single pass works
+  for (std::size_t i = 0; i < polygons.size(); i++)
   {
-    if (polygon.type == Polygon::HOLE)
-      draw_polygon(scene, hole_brush, polygon);
+    if (!is_culled(SceneItems::POLYGON, i, rendering_options))
+      _scene_items.set(
+        SceneItems::POLYGON,
+        i,
+        draw_polygon(scene, polygons[i], rendering_options));
   }
 
 #if 0
@@ -1084,32 +1704,15 @@ void Level::draw_polygons(QGraphicsScene* scene) const
 
 void Level::clear_selection()
 {
-  for (auto& vertex : vertices)
-    vertex.selected = false;
-
-  for (auto& tag : tags)
-    tag.selected = false;
-
-  for (auto& edge : edges)
-    edge.selected = false;
-
-  for (auto& model : models)
-    model.selected = false;
-
-  for (auto& polygon : polygons)
-    polygon.selected = false;
-
-  for (auto& fiducial : fiducials)
-    fiducial.selected = false;
-
-  for (auto& feature : floorplan_features)
-    feature.setSelected(false);
-
-  for (auto& layer : layers)
-    layer.clear_selection();
-
-  for (auto& constraint : constraints)
-    constraint.setSelected(false);
+  // everything that was selected needs to be re-rendered as unselected
+  vector<SelectedItem> selected_items;
+  get_selected_items(selected_items);
+  for (const SelectedItem& item : selected_items)
+  {
+    mark_changed(item);
+    set_selected_flag(item, false);
+  }
+  _selection.clear();
 }
 
 void Level::draw(
@@ -1119,8 +1722,33 @@ void Level::draw(
   const vector<Graph>& graphs,
   const CoordinateSystem& coordinate_system)
 {
-  printf("Level::draw()\n");
-  if (drawing_filename.size() && _drawing_visible)
+  TRACE_ZONE("Level::draw");
+  qCDebug(lc_draw, "Level::draw()");
+  if (_geometry && !_geometry->matches(edges, polygons))
+  {
+    qCDebug(lc_draw, "discarding stale precomputed level geometry");
+    _geometry.reset();
+  }
+  _scene_items.reset();
+  _vertex_layer = nullptr;
+  for (EdgeLayerItem*& layer : _edge_layers)
+    layer = nullptr;
+  _lane_graphs.clear();
+  _floorplan_item = nullptr;
+  _underlay_item = nullptr;
+  _models_root = nullptr;
+  _lane_buckets.valid = false;
+  _changes = ChangeSet();  // everything is about to be drawn
+  _picking_index_valid = false;  // and may have been edited untracked
+  _statistics_valid = false;
+  _selection_valid = false;
+  DrawProfile* const profile = rendering_options.profile;
+  DrawProfile::PhaseTimer phase(profile);
+  phase.start("background");
+
+  // the drawing is drawn even if it's hidden, so that showing it again
+  // is only a setVisible() in update_visibility()
+  if (drawing_filename.size())
   {
     const double extra_scroll_area_width = 1.0 * drawing_width;
     const double extra_scroll_area_height = 1.0 * drawing_height;
@@ -1130,100 +1758,846 @@ void Level::draw(
         -extra_scroll_area_height,
         drawing_width + 2 * extra_scroll_area_width,
         drawing_height + 2 * extra_scroll_area_height));
-    scene->addPixmap(floorplan_pixmap);
+    QGraphicsItem* floorplan_item = nullptr;
+    if (floorplan_tiles)
+    {
+      floorplan_item = new TiledPixmapItem(floorplan_tiles);
+      scene->addItem(floorplan_item);
+    }
+    else
+    {
+      QGraphicsPixmapItem* pixmap_item = scene->addPixmap(floorplan_pixmap);
+      if (drawing_is_preview())
+      {
+        pixmap_item->setTransformationMode(Qt::SmoothTransformation);
+        pixmap_item->setScale(_drawing_preview_scale);
+      }
+      floorplan_item = pixmap_item;
+    }
+    floorplan_item->setZValue(-10.0);
+    floorplan_item->setVisible(_drawing_visible);
+    _floorplan_item = floorplan_item;
+  }
+  else if (coordinate_system.value == CoordinateSystem::WebMercator)
+  {
+    // the basemap is the background, and the level can be anywhere on it
+    scene->setSceneRect(web_mercator_scroll_area());
   }
   else
   {
     const double w = x_meters / drawing_meters_per_pixel;
     const double h = y_meters / drawing_meters_per_pixel;
     scene->setSceneRect(QRectF(0, 0, w, h));
-    scene->addRect(0, 0, w, h, Qt::NoPen, Qt::white);
+    QGraphicsRectItem* background_item =
+      scene->addRect(0, 0, w, h, Qt::NoPen, Qt::white);
+    background_item->setZValue(-10.0);
   }
 
-  draw_polygons(scene);
+  // read from the file as the level is first drawn
+  if (!vector_underlay.empty())
+  {
+    if (!vector_underlay.lines)
+      vector_underlay.load();
+    _underlay_item = vector_underlay.draw(scene, drawing_meters_per_pixel);
+    if (_underlay_item)
+      _underlay_item->setVisible(_drawing_visible);
+  }
 
+  phase.start("polygons");
+  draw_polygons(scene, rendering_options);
+
+  phase.start("layers");
   for (auto& layer : layers)
     layer.draw(scene, drawing_meters_per_pixel, coordinate_system);
 
-  if (rendering_options.show_models)
+  phase.start("models");
+  for (Model& model : models)
+  {
+    model.draw(
+      scene,
+      editor_models,
+      drawing_meters_per_pixel,
+      models_root(scene, rendering_options));
+  }
+
+  if (rendering_options.batch_edges)
+  {
+    for (int kind = 0; kind < EdgeLayerItem::NUM_KINDS; kind++)
+    {
+      EdgeLayerItem* layer = new EdgeLayerItem(
+        static_cast<EdgeLayerItem::Kind>(kind),
+        drawing_meters_per_pixel);
+      layer->resize(edges.size());
+      scene->addItem(layer);
+      _edge_layers[kind] = layer;
+    }
+  }
+
+  // edges are timed one by one, to break their cost down by type
+  phase.stop();
+  QElapsedTimer edge_timer;
+  _lane_edge_graphs.assign(edges.size(), NO_LANE_GRAPH);
+  for (std::size_t i = 0; i < edges.size(); i++)
+  {
+    if (is_culled(SceneItems::EDGE, i, rendering_options))
+      continue;
+    if (profile)
+      edge_timer.start();
+    if (batch_edge(i))
+    {
+      if (profile)
+        profile->add_phase_time(
+          "edges: " + edges[i].type_to_string(),
+          edge_timer.nsecsElapsed());
+      continue;
+    }
+    _scene_items.set(
+      SceneItems::EDGE,
+      i,
+      draw_edge(scene, edges[i], rendering_options, graphs));
+    if (edges[i].type == Edge::LANE || edges[i].type == Edge::HUMAN_LANE)
+      _lane_edge_graphs[i] = edges[i].get_graph_idx();
+    if (profile)
+      profile->add_phase_time(
+        "edges: " + edges[i].type_to_string(),
+        edge_timer.nsecsElapsed());
+  }
+
+  for (EdgeLayerItem* layer : _edge_layers)
+  {
+    if (layer)
+      layer->flush();
+  }
+
+  phase.start("lane arrows");
+  for (auto& it : _lane_graphs)
+    draw_lane_arrows(scene, it.first, rendering_options, graphs);
+
+  phase.start("vertices");
+  const QFont font = vertex_name_font();
+
+  if (rendering_options.batch_vertices)
+  {
+    _vertex_layer = new VertexLayerItem(
+      vertex_radius / drawing_meters_per_pixel,
+      font,
+      coordinate_system.is_y_flipped());
+    _vertex_layer->set_vertices(vertices);
+    scene->addItem(_vertex_layer);
+  }
+  else
+  {
+    for (std::size_t i = 0; i < vertices.size(); i++)
+    {
+      if (is_culled(SceneItems::VERTEX, i, rendering_options))
+        continue;
+      _scene_items.set(
+        SceneItems::VERTEX,
+        i,
+        vertices[i].draw(
+          scene,
+          vertex_radius / drawing_meters_per_pixel,
+          font,
+          coordinate_system,
+          rendering_options.lod_tier));
+    }
+  }
+
+  phase.start("tags");
+  for (std::size_t i = 0; i < tags.size(); i++)
+  {
+    if (is_culled(SceneItems::TAG, i, rendering_options))
+      continue;
+    _scene_items.set(
+      SceneItems::TAG,
+      i,
+      tags[i].draw(
+        scene,
+        vertex_radius / drawing_meters_per_pixel,
+        font,
+        coordinate_system,
+        rendering_options.lod_tier));
+  }
+
+  phase.start("fiducials");
+  for (std::size_t i = 0; i < fiducials.size(); i++)
+  {
+    if (is_culled(SceneItems::FIDUCIAL, i, rendering_options))
+      continue;
+    _scene_items.set(
+      SceneItems::FIDUCIAL,
+      i,
+      fiducials[i].draw(scene, drawing_meters_per_pixel));
+  }
+
+  phase.start("features");
+  Transform level_scale;
+  level_scale.setScale(drawing_meters_per_pixel);
+  for (auto& feature : floorplan_features)
+  {
+    feature.draw(
+      scene,
+      QColor::fromRgbF(0, 0, 0, 0.5),
+      level_scale,
+      drawing_meters_per_pixel);
+  }
+
+  phase.start("constraints");
+  for (std::size_t i = 0; i < constraints.size(); i++)
+    _scene_items.set(
+      SceneItems::CONSTRAINT,
+      i,
+      draw_constraint(scene, constraints[i], i));
+  phase.stop();
+
+  if (profile)
+  {
+    profile->set_item_count(
+      "polygons", _scene_items.item_count(SceneItems::POLYGON));
+    profile->set_item_count(
+      "edges", _scene_items.item_count(SceneItems::EDGE));
+    profile->set_item_count(
+      "vertices", _scene_items.item_count(SceneItems::VERTEX));
+    profile->set_item_count(
+      "tags", _scene_items.item_count(SceneItems::TAG));
+    profile->set_item_count(
+      "fiducials", _scene_items.item_count(SceneItems::FIDUCIAL));
+    profile->set_item_count(
+      "constraints", _scene_items.item_count(SceneItems::CONSTRAINT));
+  }
+
+  // the precomputed geometry is only good for one draw; later edits
+  // re-render individual items from the live data
+  _geometry.reset();
+}
+
+void Level::set_precomputed_geometry(
+  std::shared_ptr<const SceneGeometry> geometry)
+{
+  _geometry = geometry;
+}
+
+bool Level::redraw_items(
+  QGraphicsScene* scene,
+  const vector<SelectedItem>& items,
+  vector<EditorModel>& editor_models,
+  const RenderingOptions& rendering_options,
+  const vector<Graph>& graphs,
+  const CoordinateSystem& coordinate_system)
+{
+  if (!_scene_items.is_valid())
+    return false;
+
+  // if anything was removed since the last full draw, the retained items
+  // no longer line up with the entity indices
+  if (_scene_items.size(SceneItems::VERTEX) > vertices.size() ||
+    _scene_items.size(SceneItems::EDGE) > edges.size() ||
+    _scene_items.size(SceneItems::POLYGON) > polygons.size() ||
+    _scene_items.size(SceneItems::TAG) > tags.size() ||
+    _scene_items.size(SceneItems::FIDUCIAL) > fiducials.size() ||
+    _scene_items.size(SceneItems::CONSTRAINT) > constraints.size())
+    return false;
+  for (const EdgeLayerItem* layer : _edge_layers)
+  {
+    if (layer && layer->size() > edges.size())
+      return false;
+  }
+
+  std::set<int> vertex_set, edge_set, polygon_set, tag_set;
+  std::set<int> fiducial_set, constraint_set, model_set;
+
+  for (const SelectedItem& item : items)
+  {
+    // features are drawn by their layers, which aren't retained (yet)
+    if (item.feature_idx >= 0 || item.feature_layer_idx >= 0)
+      return false;
+
+    if (item.vertex_idx >= static_cast<int>(vertices.size()) ||
+      item.edge_idx >= static_cast<int>(edges.size()) ||
+      item.polygon_idx >= static_cast<int>(polygons.size()) ||
+      item.tag_idx >= static_cast<int>(tags.size()) ||
+      item.fiducial_idx >= static_cast<int>(fiducials.size()) ||
+      item.constraint_idx >= static_cast<int>(constraints.size()) ||
+      item.model_idx >= static_cast<int>(models.size()))
+      return false;
+
+    if (item.vertex_idx >= 0)
+      vertex_set.insert(item.vertex_idx);
+    if (item.edge_idx >= 0)
+      edge_set.insert(item.edge_idx);
+    if (item.polygon_idx >= 0)
+      polygon_set.insert(item.polygon_idx);
+    if (item.tag_idx >= 0)
+      tag_set.insert(item.tag_idx);
+    if (item.fiducial_idx >= 0)
+      fiducial_set.insert(item.fiducial_idx);
+    if (item.constraint_idx >= 0)
+      constraint_set.insert(item.constraint_idx);
+    if (item.model_idx >= 0)
+      model_set.insert(item.model_idx);
+  }
+
+  // edges and polygons follow the vertices they are attached to
+  for (const int vertex_idx : vertex_set)
+  {
+    for (const int edge_idx : vertex_edges(vertex_idx))
+      edge_set.insert(edge_idx);
+    for (const int polygon_idx : vertex_polygons(vertex_idx))
+      polygon_set.insert(polygon_idx);
+  }
+
+  // a changed hole changes the triangulation of the floors around it
+  if (rendering_options.show_floor_triangulation)
+  {
+    const bool has_hole = std::any_of(
+      polygon_set.begin(),
+      polygon_set.end(),
+      [this](const int i) { return polygons[i].type == Polygon::HOLE; });
+    for (std::size_t i = 0; has_hole && i < polygons.size(); i++)
+    {
+      if (polygons[i].type == Polygon::FLOOR)
+        polygon_set.insert(i);
+    }
+  }
+
+  for (const int i : polygon_set)
+  {
+    _scene_items.remove(scene, SceneItems::POLYGON, i);
+    if (!is_culled(SceneItems::POLYGON, i, rendering_options))
+      _scene_items.set(
+        SceneItems::POLYGON,
+        i,
+        draw_polygon(scene, polygons[i], rendering_options));
+  }
+
+  // the arrows of a graph are one item, so redraw them for the graphs
+  // that the redrawn lanes belonged to and now belong to
+  std::set<int> arrow_graph_set;
+  if (_lane_edge_graphs.size() < edges.size())
+    _lane_edge_graphs.resize(edges.size(), NO_LANE_GRAPH);
+  for (const int i : edge_set)
+  {
+    _scene_items.remove(scene, SceneItems::EDGE, i);
+    for (EdgeLayerItem* layer : _edge_layers)
+    {
+      if (layer)
+        layer->remove_edge(i);
+    }
+
+    if (_lane_edge_graphs[i] != NO_LANE_GRAPH)
+      arrow_graph_set.insert(_lane_edge_graphs[i]);
+    _lane_edge_graphs[i] = NO_LANE_GRAPH;
+
+    if (is_culled(SceneItems::EDGE, i, rendering_options))
+      continue;
+    if (batch_edge(i))
+      continue;
+    _scene_items.set(
+      SceneItems::EDGE,
+      i,
+      draw_edge(scene, edges[i], rendering_options, graphs));
+    if (edges[i].type == Edge::LANE || edges[i].type == Edge::HUMAN_LANE)
+    {
+      _lane_edge_graphs[i] = edges[i].get_graph_idx();
+      arrow_graph_set.insert(_lane_edge_graphs[i]);
+    }
+  }
+  for (EdgeLayerItem* layer : _edge_layers)
+  {
+    if (layer)
+      layer->flush();
+  }
+  for (const int graph_idx : arrow_graph_set)
+    draw_lane_arrows(scene, graph_idx, rendering_options, graphs);
+
+  // models hold on to their own pixmap item; this just updates it
+  for (const int i : model_set)
+  {
+    models[i].draw(
+      scene,
+      editor_models,
+      drawing_meters_per_pixel,
+      models_root(scene, rendering_options));
+  }
+
+  const QFont font = vertex_name_font();
+
+  for (const int i : vertex_set)
+  {
+    if (_vertex_layer)
+    {
+      _vertex_layer->set_vertex(i, vertices[i]);
+      continue;
+    }
+    _scene_items.remove(scene, SceneItems::VERTEX, i);
+    if (is_culled(SceneItems::VERTEX, i, rendering_options))
+      continue;
+    _scene_items.set(
+      SceneItems::VERTEX,
+      i,
+      vertices[i].draw(
+        scene,
+        vertex_radius / drawing_meters_per_pixel,
+        font,
+        coordinate_system,
+        rendering_options.lod_tier));
+  }
+
+  for (const int i : tag_set)
+  {
+    _scene_items.remove(scene, SceneItems::TAG, i);
+    if (is_culled(SceneItems::TAG, i, rendering_options))
+      continue;
+    _scene_items.set(
+      SceneItems::TAG,
+      i,
+      tags[i].draw(
+        scene,
+        vertex_radius / drawing_meters_per_pixel,
+        font,
+        coordinate_system,
+        rendering_options.lod_tier));
+  }
+
+  for (const int i : fiducial_set)
+  {
+    _scene_items.remove(scene, SceneItems::FIDUCIAL, i);
+    if (is_culled(SceneItems::FIDUCIAL, i, rendering_options))
+      continue;
+    _scene_items.set(
+      SceneItems::FIDUCIAL,
+      i,
+      fiducials[i].draw(scene, drawing_meters_per_pixel));
+  }
+
+  for (const int i : constraint_set)
+  {
+    _scene_items.remove(scene, SceneItems::CONSTRAINT, i);
+    _scene_items.set(
+      SceneItems::CONSTRAINT,
+      i,
+      draw_constraint(scene, constraints[i], i));
+  }
+
+  return true;
+}
+
+QList<QGraphicsItem*> Level::draw_edge(
+  QGraphicsScene* scene,
+  const Edge& edge,
+  const RenderingOptions& rendering_options,
+  const vector<Graph>& graphs)
+{
+  switch (edge.type)
+  {
+    case Edge::LANE:
+      return draw_lane(scene, edge, rendering_options, graphs);
+    case Edge::WALL:
+      return draw_wall(scene, edge);
+    case Edge::MEAS:
+      return draw_meas(scene, edge);
+    case Edge::DOOR:
+      return draw_door(scene, edge, rendering_options.lod_tier);
+    case Edge::HUMAN_LANE:
+      return draw_lane(scene, edge, rendering_options, graphs);
+    default:
+      qCWarning(lc_draw, "tried to draw unknown edge type: %d",
+        static_cast<int>(edge.type));
+      break;
+  }
+  return QList<QGraphicsItem*>();
+}
+
+QFont Level::vertex_name_font() const
+{
+  double font_size = vertex_radius / drawing_meters_per_pixel * 1.5;
+  if (font_size < 1.0)
+    font_size = 1.0;
+  return LabelCache::font(font_size);
+}
+
+bool Level::is_culled(
+  const SceneItems::Kind kind,
+  const std::size_t idx,
+  const RenderingOptions& rendering_options) const
+{
+  const QRectF& r = rendering_options.cull_rect;
+  if (r.isEmpty())
+    return false;  // culling is disabled
+
+  switch (kind)
+  {
+    case SceneItems::VERTEX:
+      return !_vertex_layer && !r.contains(vertices[idx].x, vertices[idx].y);
+
+    case SceneItems::EDGE:
+    {
+      if (edge_layer(edges[idx].type))
+        return false;  // the layers paint only the exposed cells
+      const Vertex& v_start = vertices[edges[idx].start_idx];
+      const Vertex& v_end = vertices[edges[idx].end_idx];
+      // a perfectly horizontal/vertical edge has an empty bounding box,
+      // which never intersects anything, so give it some thickness
+      const QRectF bounds = QRectF(
+        QPointF(v_start.x, v_start.y),
+        QPointF(v_end.x, v_end.y)).normalized().adjusted(-1, -1, 1, 1);
+      return !r.intersects(bounds);
+    }
+
+    case SceneItems::POLYGON:
+    {
+      QRectF bounds;
+      for (const int vertex_idx : polygons[idx].vertices)
+      {
+        const Vertex& v = vertices[vertex_idx];
+        bounds |= QRectF(v.x - 1, v.y - 1, 2, 2);
+      }
+      return !r.intersects(bounds);
+    }
+
+    case SceneItems::TAG:
+      return !r.contains(tags[idx].x, tags[idx].y);
+
+    case SceneItems::FIDUCIAL:
+      return !r.contains(fiducials[idx].x, fiducials[idx].y);
+
+    default:
+      return false;  // constraints are few; always draw them
+  }
+}
+
+bool Level::stream_items(
+  QGraphicsScene* scene,
+  vector<EditorModel>& editor_models,
+  const RenderingOptions& rendering_options,
+  const vector<Graph>& graphs,
+  const CoordinateSystem& coordinate_system)
+{
+  if (!_scene_items.is_valid())
+    return false;
+
+  // find everything that entered or left the cull rect since it was drawn
+  vector<SelectedItem> items;
+  auto check = [&](const SceneItems::Kind kind, const std::size_t n,
+      int SelectedItem::* field)
+    {
+      for (std::size_t i = 0; i < n; i++)
+      {
+        // batched edges are never culled, so never enter or leave
+        if (kind == SceneItems::EDGE && edge_layer(edges[i].type))
+          continue;
+        const bool drawn = _scene_items.has_items(kind, i);
+        if (drawn == is_culled(kind, i, rendering_options))
+        {
+          SelectedItem item;
+          item.*field = static_cast<int>(i);
+          items.push_back(item);
+        }
+      }
+    };
+  if (!_vertex_layer)
+    check(SceneItems::VERTEX, vertices.size(), &SelectedItem::vertex_idx);
+  check(SceneItems::EDGE, edges.size(), &SelectedItem::edge_idx);
+  check(SceneItems::POLYGON, polygons.size(), &SelectedItem::polygon_idx);
+  check(SceneItems::TAG, tags.size(), &SelectedItem::tag_idx);
+  check(SceneItems::FIDUCIAL, fiducials.size(), &SelectedItem::fiducial_idx);
+
+  if (items.empty())
+    return true;
+  qCDebug(lc_draw,
+    "streaming %zu items on level %s", items.size(), name.c_str());
+  return redraw_items(
+    scene,
+    items,
+    editor_models,
+    rendering_options,
+    graphs,
+    coordinate_system);
+}
+
+Level::SelectedItem Level::make_selected_item(
+  const ItemType item_type,
+  const int idx)
+{
+  SelectedItem item;
+  switch (item_type)
+  {
+    case VERTEX: item.vertex_idx = idx; break;
+    case MODEL: item.model_idx = idx; break;
+    case FIDUCIAL: item.fiducial_idx = idx; break;
+    case EDGE: item.edge_idx = idx; break;
+    case POLYGON: item.polygon_idx = idx; break;
+    case TAG: item.tag_idx = idx; break;
+    case CONSTRAINT: item.constraint_idx = idx; break;
+    default: break;
+  }
+  return item;
+}
+
+void Level::mark_changed(const ItemType item_type, const int idx)
+{
+  mark_changed(make_selected_item(item_type, idx));
+}
+
+void Level::mark_changed(const SelectedItem& item)
+{
+  invalidate_saved_yaml();
+  if (item.fiducial_idx >= 0)
+    _fiducials_revision++;
+  _picking_index_moved.push_back(item);
+  mark_statistics_changed(item);
+  mark_journal_changed(item);
+  if (_changes.all)
+    return;  // no need to keep track; everything will be refreshed
+  _changes.items.push_back(item);
+}
+
+void Level::mark_all_changed()
+{
+  invalidate_saved_yaml();
+  _fiducials_revision++;
+  _changes.all = true;
+  _changes.items.clear();
+  _journal_changes.all = true;
+  _journal_changes.items.clear();
+  _journal_changes.layer_transforms.clear();
+  _picking_index_valid = false;
+  _selection_valid = false;
+  _statistics_valid = false;
+  _statistics_pending.clear();
+}
+
+void Level::mark_layer_transform_changed(const int layer_idx)
+{
+  invalidate_saved_yaml();
+  _feature_grid_valid = false;
+  std::vector<int>& journal_layers = _journal_changes.layer_transforms;
+  if (!_journal_changes.all &&
+    std::find(journal_layers.begin(), journal_layers.end(), layer_idx) ==
+    journal_layers.end())
+    journal_layers.push_back(layer_idx);
+  if (_changes.all)
+    return;
+  _changes.layer_transforms.push_back(layer_idx);
+}
+
+void Level::mark_moved(const ItemType item_type, const int idx)
+{
+  invalidate_saved_yaml();
+  if (item_type == FIDUCIAL)
+    _fiducials_revision++;
+  const SelectedItem item = make_selected_item(item_type, idx);
+  _picking_index_moved.push_back(item);
+  mark_statistics_changed(item);
+  mark_journal_changed(item);
+}
+
+void Level::mark_statistics_changed(const SelectedItem& item)
+{
+  if (!_statistics_valid)
+    return;  // it will be counted from scratch anyway
+
+  // if nobody looks at the statistics for long, recounting is cheaper
+  const std::size_t num_entities =
+    vertices.size() + edges.size() + polygons.size() + models.size();
+  if (_statistics_pending.size() > num_entities)
+  {
+    _statistics_valid = false;
+    _statistics_pending.clear();
+    return;
+  }
+  _statistics_pending.push_back(item);
+}
+
+void Level::mark_journal_changed(const SelectedItem& item)
+{
+  if (_journal_changes.all)
+    return;
+
+  // with no journal taking them, they would pile up without end; past
+  // this many, recording the whole level is as cheap
+  const std::size_t num_entities =
+    vertices.size() + edges.size() + polygons.size() + models.size();
+  if (_journal_changes.items.size() > num_entities)
+  {
+    _journal_changes.all = true;
+    _journal_changes.items.clear();
+    _journal_changes.layer_transforms.clear();
+    return;
+  }
+  _journal_changes.items.push_back(item);
+}
+
+const LevelStatistics& Level::statistics()
+{
+  // entities may have been removed (shifting indices) without being marked
+  if (!_statistics_valid ||
+    _statistics.vertex_count() > static_cast<int>(vertices.size()) ||
+    _statistics.edge_count() > edges.size() ||
+    _statistics.polygon_count() > polygons.size() ||
+    _statistics.model_count() > models.size())
+  {
+    rebuild_statistics();
+    return _statistics;
+  }
+
+  // which edges and polygons each moved vertex is part of
+  for (const SelectedItem& item : _statistics_pending)
   {
-    for (Model& model : models)
-      model.draw(scene, editor_models, drawing_meters_per_pixel);
+    if (item.vertex_idx >= 0)
+    {
+      update_picking_index();
+      break;
+    }
   }
 
-  for (const auto& edge : edges)
+  // entities appended since the last update
+  for (std::size_t i = _statistics.vertex_count(); i < vertices.size(); i++)
+    _statistics.set_vertex(i, vertices[i]);
+  for (std::size_t i = _statistics.edge_count(); i < edges.size(); i++)
+    _statistics.set_edge(i, edges[i], vertices);
+  for (std::size_t i = _statistics.polygon_count(); i < polygons.size(); i++)
+    _statistics.set_polygon(i, polygons[i], vertices);
+  for (std::size_t i = _statistics.model_count(); i < models.size(); i++)
+    _statistics.set_model(i, models[i]);
+
+  const int n_vertices = static_cast<int>(vertices.size());
+  const int n_edges = static_cast<int>(edges.size());
+  const int n_polygons = static_cast<int>(polygons.size());
+  const int n_models = static_cast<int>(models.size());
+  for (const SelectedItem& item : _statistics_pending)
   {
-    switch (edge.type)
+    if (item.vertex_idx >= 0 && item.vertex_idx < n_vertices)
     {
-      case Edge::LANE:
-        draw_lane(scene, edge, rendering_options, graphs);
-        break;
-      case Edge::WALL:
-        draw_wall(scene, edge);
-        break;
-      case Edge::MEAS:
-        draw_meas(scene, edge);
-        break;
-      case Edge::DOOR:
-        draw_door(scene, edge);
-        break;
-      case Edge::HUMAN_LANE:
-        draw_lane(scene, edge, rendering_options, graphs);
-        break;
-      default:
-        printf("tried to draw unknown edge type: %d\n",
-          static_cast<int>(edge.type));
-        break;
+      _statistics.set_vertex(item.vertex_idx, vertices[item.vertex_idx]);
+      if (item.vertex_idx < static_cast<int>(_vertex_edges.size()))
+      {
+        for (const int edge_idx : _vertex_edges[item.vertex_idx])
+          _statistics.set_edge(edge_idx, edges[edge_idx], vertices);
+      }
+      if (item.vertex_idx < static_cast<int>(_vertex_polygons.size()))
+      {
+        for (const int polygon_idx : _vertex_polygons[item.vertex_idx])
+          _statistics.set_polygon(
+            polygon_idx,
+            polygons[polygon_idx],
+            vertices);
+      }
     }
+    if (item.edge_idx >= 0 && item.edge_idx < n_edges)
+      _statistics.set_edge(item.edge_idx, edges[item.edge_idx], vertices);
+    if (item.polygon_idx >= 0 && item.polygon_idx < n_polygons)
+      _statistics.set_polygon(
+        item.polygon_idx,
+        polygons[item.polygon_idx],
+        vertices);
+    if (item.model_idx >= 0 && item.model_idx < n_models)
+      _statistics.set_model(item.model_idx, models[item.model_idx]);
   }
+  _statistics_pending.clear();
+  return _statistics;
+}
 
-  QFont vertex_name_font("Helvetica");
-  double vertex_name_font_size =
-    vertex_radius / drawing_meters_per_pixel * 1.5;
-  if (vertex_name_font_size < 1.0)
-    vertex_name_font_size = 1.0;
-  vertex_name_font.setPointSizeF(vertex_name_font_size);
+void Level::rebuild_statistics()
+{
+  _statistics.clear();
+  for (std::size_t i = 0; i < vertices.size(); i++)
+    _statistics.set_vertex(i, vertices[i]);
+  for (std::size_t i = 0; i < edges.size(); i++)
+    _statistics.set_edge(i, edges[i], vertices);
+  for (std::size_t i = 0; i < polygons.size(); i++)
+    _statistics.set_polygon(i, polygons[i], vertices);
+  for (std::size_t i = 0; i < models.size(); i++)
+    _statistics.set_model(i, models[i]);
+  _statistics_valid = true;
+  _statistics_pending.clear();
+}
 
-  for (const auto& v : vertices)
-    v.draw(
-      scene,
-      vertex_radius / drawing_meters_per_pixel,
-      vertex_name_font,
-      coordinate_system);
+Level::ChangeSet Level::take_changes()
+{
+  ChangeSet changes;
+  std::swap(changes, _changes);
+  return changes;
+}
 
-  for (const auto& t : tags)
-    t.draw(
-      scene,
-      vertex_radius / drawing_meters_per_pixel,
-      vertex_name_font,
-      coordinate_system);
+Level::ChangeSet Level::take_journal_changes()
+{
+  ChangeSet changes;
+  std::swap(changes, _journal_changes);
+  return changes;
+}
 
-  for (const auto& f : fiducials)
-    f.draw(scene, drawing_meters_per_pixel);
+void Level::clear_scene()
+{
+  _scene_items.invalidate();
+  _vertex_layer = nullptr;
+  for (EdgeLayerItem*& layer : _edge_layers)
+    layer = nullptr;
+  _lane_graphs.clear();
+  _floorplan_item = nullptr;
+  _underlay_item = nullptr;
+  _models_root = nullptr;
 
-  Transform level_scale;
-  level_scale.setScale(drawing_meters_per_pixel);
-  for (auto& feature : floorplan_features)
+  for (auto& model : models)
+    model.clear_scene();
+  for (Layer& layer : layers)
+    layer.clear_scene();
+}
+
+void Level::recycle_scene_items(QGraphicsScene* scene)
+{
+  _scene_items.recycle(scene);
+
+  SceneItemPool& pool = SceneItemPool::instance();
+  for (auto& it : _lane_graphs)
   {
-    feature.draw(
-      scene,
-      QColor::fromRgbF(0, 0, 0, 0.5),
-      level_scale,
-      drawing_meters_per_pixel);
+    LaneGraphItems& graph_items = it.second;
+    if (graph_items.root && graph_items.root->scene() == scene)
+    {
+      pool.recycle(graph_items.arrows);
+      graph_items.arrows.clear();
+    }
   }
-
-  for (std::size_t i = 0; i < constraints.size(); i++)
-    draw_constraint(scene, constraints[i], i);
 }
 
-void Level::clear_scene()
+bool Level::update_layer_transform(
+  QGraphicsScene* scene,
+  const int layer_idx)
 {
-  for (auto& model : models)
-    model.clear_scene();
+  if (!_scene_items.is_valid() ||
+    _scene_items.size(SceneItems::CONSTRAINT) > constraints.size() ||
+    layer_idx < 0 ||
+    layer_idx >= static_cast<int>(layers.size()))
+    return false;
+
+  Layer& layer = layers[layer_idx];
+  if (!layer.update_scene_transform(drawing_meters_per_pixel))
+    return false;
+
+  // the constraint lines are drawn between points on the level
+  std::set<QUuid> feature_ids;
+  for (const Feature& feature : layer.features)
+    feature_ids.insert(feature.id());
+  for (std::size_t i = 0; i < constraints.size(); i++)
+  {
+    bool touches_layer = false;
+    for (const QUuid& id : constraints[i].ids())
+      touches_layer = touches_layer || feature_ids.count(id) > 0;
+    if (!touches_layer)
+      continue;
+    _scene_items.remove(scene, SceneItems::CONSTRAINT, i);
+    _scene_items.set(
+      SceneItems::CONSTRAINT,
+      i,
+      draw_constraint(scene, constraints[i], i));
+  }
+  return true;
 }
 
 QUuid Level::add_feature(const int layer_idx, const double x, const double y)
 {
+  mark_all_changed();  // features are drawn with their layers
+
   if (layer_idx == 0)
   {
     floorplan_features.push_back(Feature(x, y));
@@ -1240,6 +2614,8 @@ QUuid Level::add_feature(const int layer_idx, const double x, const double y)
 
 void Level::remove_feature(const int layer_idx, QUuid feature_id)
 {
+  mark_all_changed();
+
   if (layer_idx == 0)
   {
     int index_to_remove = -1;
@@ -1264,123 +2640,292 @@ void Level::remove_feature(const int layer_idx, QUuid feature_id)
   }
 }
 
-bool Level::export_features(const std::string& /*filename*/) const
+namespace {
+
+/// Streams into a QSaveFile in large writes, so that the export of a big
+/// feature set is never held in memory as a whole
+class SaveFileStreamBuf : public std::streambuf
 {
+public:
+  explicit SaveFileStreamBuf(QSaveFile* file)
+  : _file(file), _buffer(1 << 16)
+  {
+    setp(_buffer.data(), _buffer.data() + _buffer.size());
+  }
+
+  bool failed() const { return _failed; }
+
+protected:
+  int_type overflow(int_type c) override
+  {
+    if (sync() != 0)
+      return traits_type::eof();
+    if (!traits_type::eq_int_type(c, traits_type::eof()))
+    {
+      *pptr() = traits_type::to_char_type(c);
+      pbump(1);
+    }
+    return traits_type::not_eof(c);
+  }
+
+  int sync() override
+  {
+    const qint64 n = pptr() - pbase();
+    if (n > 0 && _file->write(pbase(), n) != n)
+      _failed = true;
+    setp(_buffer.data(), _buffer.data() + _buffer.size());
+    return _failed ? -1 : 0;
+  }
+
+private:
+  QSaveFile* _file;
+  std::vector<char> _buffer;
+  bool _failed = false;
+};
+
+double round_mm(const double value)
+{
+  return std::round(value * 1000.0) / 1000.0;
+}
+
+/// Quoted if it has to be, as RFC 4180 has it
+string csv_field(const string& s)
+{
+  if (s.find_first_of(",\"\r\n") == string::npos)
+    return s;
+  string quoted("\"");
+  for (const char c : s)
+  {
+    if (c == '"')
+      quoted += '"';
+    quoted += c;
+  }
+  return quoted + '"';
+}
+
+}  // namespace
+
+/// The features of the floorplan and of each layer, with where the layer
+/// features land on the floorplan, the transforms of the layers and the
+/// constraints between features, for aligning this level against other
+/// maps. A filename ending in .csv gets the compact form instead: one row
+/// per feature, with its position on the floorplan and the ids of the
+/// features it is constrained to. Either way the file is streamed out as
+/// it is generated. This reads nothing but the level itself (not even its
+/// lookup caches), so different levels can be exported on different
+/// threads at once.
+bool Level::export_features(const std::string& filename) const
+{
+  QElapsedTimer timer;
+  timer.start();
+
+  // (layer, feature) of each feature id: floorplan features are layer 0
+  QHash<QUuid, std::pair<int, int>> locations;
+  auto features_of = [this](const int layer_idx) -> const vector<Feature>&
+    {
+      if (layer_idx == 0)
+        return floorplan_features;
+      return layers[layer_idx - 1].features;
+    };
+  for (int layer_idx = 0; layer_idx <= static_cast<int>(layers.size());
+    layer_idx++)
+  {
+    const vector<Feature>& features = features_of(layer_idx);
+    for (std::size_t i = 0; i < features.size(); i++)
+      locations.insert(
+        features[i].id(), std::make_pair(layer_idx, static_cast<int>(i)));
+  }
+
+  // in floorplan pixels
+  auto level_point = [this, &features_of](const std::pair<int, int>& at)
+    {
+      const Feature& feature = features_of(at.first)[at.second];
+      if (at.first == 0)
+        return feature.qpoint();
+      return layers[at.first - 1].transform.forwards(feature.qpoint()) /
+        drawing_meters_per_pixel;
+    };
+
+  QSaveFile file(QString::fromStdString(filename));
+  if (!file.open(QIODevice::WriteOnly))
+  {
+    qCWarning(lc_io, "unable to write %s: %s",
+      filename.c_str(),
+      qUtf8Printable(file.errorString()));
+    return false;
+  }
+  SaveFileStreamBuf buffer(&file);
+  std::ostream out(&buffer);
+
+  const bool csv = QString::fromStdString(filename).endsWith(
+    ".csv", Qt::CaseInsensitive);
+  if (csv)
+  {
+    // ids of the features constrained to each feature
+    QHash<QUuid, QStringList> constrained_to;
+    for (const Constraint& constraint : constraints)
+    {
+      const vector<QUuid>& ids = constraint.ids();
+      for (std::size_t i = 0; i < ids.size(); i++)
+      {
+        for (std::size_t j = 0; j < ids.size(); j++)
+        {
+          if (i != j)
+            constrained_to[ids[i]].append(ids[j].toString());
+        }
+      }
+    }
+
+    out.precision(10);
+    out << "layer,layer_name,id,name,x,y,level_x,level_y,constrained_to\n";
+    for (int layer_idx = 0; layer_idx <= static_cast<int>(layers.size());
+      layer_idx++)
+    {
+      const string& layer_name =
+        layer_idx == 0 ? drawing_filename : layers[layer_idx - 1].name;
+      const vector<Feature>& features = features_of(layer_idx);
+      for (std::size_t i = 0; i < features.size(); i++)
+      {
+        const Feature& feature = features[i];
+        const QPointF p =
+          level_point(std::make_pair(layer_idx, static_cast<int>(i)));
+        out << layer_idx << ','
+            << csv_field(layer_name) << ','
+            << feature.id().toString().toStdString() << ','
+            << csv_field(feature.name()) << ','
+            << feature.x() << ',' << feature.y() << ','
+            << p.x() << ',' << p.y() << ','
+            << constrained_to.value(feature.id()).join(" ").toStdString()
+            << '\n';
+      }
+    }
+  }
+  else
+  {
+    YAML::Emitter emitter(out);
+    emitter << YAML::BeginMap;
+    emitter << YAML::Key << "level" << YAML::Value << name;
+    emitter << YAML::Key << "meters_per_pixel"
+            << YAML::Value << drawing_meters_per_pixel;
+
+    auto emit_features = [&](const int layer_idx)
+      {
+        const vector<Feature>& features = features_of(layer_idx);
+        emitter << YAML::Key << "features" << YAML::Value << YAML::BeginSeq;
+        for (std::size_t i = 0; i < features.size(); i++)
+        {
+          const Feature& feature = features[i];
+          emitter << YAML::Flow << YAML::BeginMap
+                  << YAML::Key << "id"
+                  << YAML::Value << feature.id().toString().toStdString()
+                  << YAML::Key << "name" << YAML::Value << feature.name()
+                  << YAML::Key << "x" << YAML::Value << round_mm(feature.x())
+                  << YAML::Key << "y" << YAML::Value << round_mm(feature.y());
+          if (layer_idx > 0)
+          {
+            const QPointF p =
+              level_point(std::make_pair(layer_idx, static_cast<int>(i)));
+            emitter << YAML::Key << "level_x" << YAML::Value << round_mm(p.x())
+                    << YAML::Key << "level_y" << YAML::Value << round_mm(p.y());
+          }
+          emitter << YAML::EndMap;
+        }
+        emitter << YAML::EndSeq;
+      };
+
+    auto emit_size = [&](const int width, const int height)
+      {
+        emitter << YAML::Key << "size" << YAML::Value
+                << YAML::Flow << YAML::BeginSeq << width << height
+                << YAML::EndSeq;
+      };
+
+    emitter << YAML::Key << "floorplan" << YAML::Value << YAML::BeginMap;
+    emitter << YAML::Key << "image_file" << YAML::Value << drawing_filename;
+    emit_size(drawing_width, drawing_height);
+    emit_features(0);
+    emitter << YAML::EndMap;
+
+    emitter << YAML::Key << "layers" << YAML::Value << YAML::BeginSeq;
+    for (std::size_t i = 0; i < layers.size(); i++)
+    {
+      const Layer& layer = layers[i];
+      // the image may not be decoded; the header has the size
+      const QSize size = layer.image_loaded() ? layer.image_size() :
+        QImageReader(QString::fromStdString(layer.filename)).size();
+      emitter << YAML::BeginMap;
+      emitter << YAML::Key << "name" << YAML::Value << layer.name;
+      emitter << YAML::Key << "image_file" << YAML::Value << layer.filename;
+      emit_size(size.width(), size.height());
+      emitter << YAML::Key << "transform" << YAML::Value << YAML::Flow
+              << layer.transform.to_yaml();
+      emit_features(static_cast<int>(i) + 1);
+      emitter << YAML::EndMap;
+    }
+    emitter << YAML::EndSeq;
+
+    // each with both of its points on the floorplan, and how far apart
+    // the layer's transform leaves them
+    emitter << YAML::Key << "constraints" << YAML::Value << YAML::BeginSeq;
+    for (const Constraint& constraint : constraints)
+    {
+      const vector<QUuid>& ids = constraint.ids();
+      emitter << YAML::Flow << YAML::BeginMap;
+      emitter << YAML::Key << "ids" << YAML::Value << YAML::BeginSeq;
+      for (const QUuid& id : ids)
+        emitter << id.toString().toStdString();
+      emitter << YAML::EndSeq;
+
+      auto a = locations.constFind(ids.empty() ? QUuid() : ids[0]);
+      auto b = locations.constFind(ids.size() < 2 ? QUuid() : ids[1]);
+      if (ids.size() == 2 &&
+        a != locations.constEnd() && b != locations.constEnd())
+      {
+        const QPointF pa = level_point(a.value());
+        const QPointF pb = level_point(b.value());
+        const double residual = std::hypot(pa.x() - pb.x(), pa.y() - pb.y()) *
+          drawing_meters_per_pixel;
+        emitter << YAML::Key << "layers" << YAML::Value
+                << YAML::BeginSeq << a.value().first << b.value().first
+                << YAML::EndSeq
+                << YAML::Key << "level_points" << YAML::Value
+                << YAML::BeginSeq
+                << YAML::BeginSeq << round_mm(pa.x()) << round_mm(pa.y())
+                << YAML::EndSeq
+                << YAML::BeginSeq << round_mm(pb.x()) << round_mm(pb.y())
+                << YAML::EndSeq
+                << YAML::EndSeq
+                << YAML::Key << "residual"  // meters
+                << YAML::Value << round_mm(residual);
+      }
+      emitter << YAML::EndMap;
+    }
+    emitter << YAML::EndSeq;
+    emitter << YAML::EndMap;
+
+    if (!emitter.good())
+    {
+      qCWarning(lc_io, "couldn't emit the features of %s: %s",
+        name.c_str(),
+        emitter.GetLastError().c_str());
+      file.cancelWriting();
+      return false;
+    }
+    out << '\n';
+  }
+
+  out.flush();
+  if (buffer.failed() || !file.commit())
+  {
+    qCWarning(lc_io, "unable to write %s: %s",
+      filename.c_str(),
+      qUtf8Printable(file.errorString()));
+    return false;
+  }
+  qCDebug(lc_io, "exported the features of %s in %lld ms",
+    name.c_str(),
+    static_cast<long long>(timer.elapsed()));
   return true;
-#if 0
-  // TODO (MQ): revisit all of this...
-
-  YAML::Node level_features;
-
-  YAML::Node floorplan_yaml;
-  floorplan_yaml["name"] = "floorplan";
-  floorplan_yaml["image_file"] = drawing_filename;
-  floorplan_yaml["size"].push_back(drawing_width);
-  floorplan_yaml["size"].push_back(drawing_height);
-  floorplan_yaml["size"].SetStyle(YAML::EmitterStyle::Flow);
-  YAML::Node floorplan_cps;
-  for (const auto& feature : _feature_sets[0])
-  {
-    YAML::Node cp_yaml;
-    cp_yaml.SetStyle(YAML::EmitterStyle::Flow);
-    cp_yaml.push_back(feature.x());
-    cp_yaml.push_back(feature.y());
-    floorplan_cps.push_back(cp_yaml);
-  }
-  floorplan_yaml["correspondence_points"] = floorplan_cps;
-  level_features["ref_map"] = floorplan_yaml;
-
-  int layer_index = 1;
-  for (std::vector<Layer>::const_iterator layer = layers.begin();
-    layer != layers.end();
-    ++layer)
-  {
-    YAML::Node y;
-    y["name"] = layer->name;
-    y["image_file"] = layer->filename;
-
-    QPixmap layer_pixmap = QPixmap::fromImage(
-      QImageReader(QString::fromStdString(layer->filename)).read());
-    y["size"].push_back(layer_pixmap.width());
-    y["size"].push_back(layer_pixmap.height());
-    y["size"].SetStyle(YAML::EmitterStyle::Flow);
-
-    YAML::Node transform;
-    double scale = layer->meters_per_pixel / drawing_meters_per_pixel;
-    transform["scale"].push_back(scale);
-    transform["scale"].push_back(scale);
-    transform["scale"].SetStyle(YAML::EmitterStyle::Flow);
-    transform["rotation"] = layer->rotation;
-    transform["translation"].push_back(
-      (layer->translation_x / drawing_meters_per_pixel) / scale);
-    transform["translation"].push_back(
-      (layer->translation_y / drawing_meters_per_pixel) / scale);
-    transform["translation"].SetStyle(YAML::EmitterStyle::Flow);
-    y["transform"] = transform;
-
-    YAML::Node cps;
-    for (const auto& feature : _feature_sets[layer_index])
-    {
-      QPointF offset = layer->scene_item->offset();
-      QPointF mapped_point =
-        layer->scene_item->mapFromScene(QPointF(feature.x(), feature.y()));
-      YAML::Node cp_yaml;
-      cp_yaml.push_back(mapped_point.rx() - offset.rx());
-      cp_yaml.push_back(mapped_point.ry() - offset.ry());
-      cp_yaml.SetStyle(YAML::EmitterStyle::Flow);
-      cps.push_back(cp_yaml);
-
-      //printf("Offset is %f, %f\n", layer->scene_item->offset().rx(), layer->scene_item->offset().ry());
-      //QPointF mapped = layer->scene_item->mapFromScene(QPointF(cp.x(), cp.y()));
-      //printf("Mapped is %f, %f\n", mapped.rx(), mapped.ry());
-
-      //printf("==================\n");
-      //printf("Raw point: %f, %f\n", cp.x(), cp.y());
-      //printf("Floorplan scale: %f\n", drawing_meters_per_pixel);
-      //printf("Translation in metres: %f, %f\n", layer->translation_x, layer->translation_y);
-
-      //double scale = layer->meters_per_pixel / drawing_meters_per_pixel;
-      //double displayed_image_x = layer->pixmap.width() * scale;
-      //double displayed_image_y = layer->pixmap.height() * scale;
-      //printf("Image size: %f, %f\n", displayed_image_x, displayed_image_y);
-      //printf("------------------\n");
-      //double image_x = cp.x();
-      //double image_y = cp.y();
-
-      //double translate_x = (layer->translation_x / drawing_meters_per_pixel);
-      //double translate_y = (layer->translation_y / drawing_meters_per_pixel);
-      //image_x = image_x - translate_x;
-      //image_y = image_y + translate_y;
-      //printf("Translated x by %f to %f\n", translate_x, image_x);
-      //printf("Translated y by %f to %f\n", translate_y, image_y);
-
-      //double angle = -layer->rotation;
-      //image_x = image_x * std::cos(angle) - image_y * std::sin(angle);
-      //image_y = image_x * std::sin(angle) + image_y * std::cos(angle);
-      //printf("Rotated x by %f to %f\n", angle, image_x);
-      //printf("Rotated y by %f to %f\n", angle, image_y);
-
-      //image_x = image_x / scale;
-      //image_y = image_y / scale;
-      //printf("Scaled x by %f to %f\n", scale, image_x);
-      //printf("Scaled y by %f to %f\n", scale, image_y);
-
-      //printf("Offset is %f, %f\n", layer->scene_item->offset().rx(), layer->scene_item->offset().ry());
-      //QPointF mapped = layer->scene_item->mapFromScene(QPointF(cp.x(), cp.y()));
-      //printf("Mapped is %f, %f\n", mapped.rx(), mapped.ry());
-
-    }
-    y["correspondence_points"] = cps;
-    layer_index++;
-    level_features["robot_map"] = y;
-  }
-
-  YAML::Emitter emitter;
-  yaml_utils::write_node(level_features, emitter);
-  std::ofstream dest(filename);
-  dest << emitter.c_str();
-  return true;
-#endif
 }
 
 void Level::load_yaml_edge_sequence(
@@ -1392,11 +2937,12 @@ void Level::load_yaml_edge_sequence(
     return;
 
   const YAML::Node& yl = data[sequence_name];
+  edges.reserve(edges.size() + yl.size());
   for (YAML::const_iterator it = yl.begin(); it != yl.end(); ++it)
   {
     Edge e;
     e.from_yaml(*it, type);
-    edges.push_back(e);
+    edges.push_back(std::move(e));
   }
 }
 
@@ -1509,11 +3055,12 @@ bool Level::parse_vertices(const YAML::Node& _data)
   if (_data["vertices"] && _data["vertices"].IsSequence())
   {
     const YAML::Node& pts = _data["vertices"];
+    vertices.reserve(vertices.size() + pts.size());
     for (YAML::const_iterator it = pts.begin(); it != pts.end(); ++it)
     {
       Vertex v;
       v.from_yaml(*it);
-      vertices.push_back(v);
+      vertices.push_back(std::move(v));
     }
   }
   return true;
@@ -1522,18 +3069,13 @@ bool Level::parse_vertices(const YAML::Node& _data)
 void Level::add_vertex(const double x, const double y)
 {
   vertices.push_back(Vertex(x, y));
+  mark_changed(VERTEX, vertices.size() - 1);
 }
 
 std::size_t Level::get_vertex_by_id(QUuid vertex_id)
 {
-  for (std::size_t i = 0; i < vertices.size(); i++)
-  {
-    if (vertices[i].uuid == vertex_id)
-    {
-      return i;
-    }
-  }
-  return vertices.size()+1;
+  const int idx = find_vertex_index(vertex_id);
+  return idx >= 0 ? idx : vertices.size()+1;
 }
 // Vertices End
 
@@ -1556,22 +3098,123 @@ bool Level::parse_tags(const YAML::Node& _data)
 void Level::add_tag(const double x, const double y)
 {
   tags.push_back(Tag(x, y));
+  mark_changed(TAG, tags.size() - 1);
 }
 
 std::size_t Level::get_tag_by_id(QUuid tag_id)
 {
-  for (std::size_t i = 0; i < tags.size(); i++)
+  const int idx = find_tag_index(tag_id);
+  return idx >= 0 ? idx : tags.size()+1;
+}
+// Tags End
+
+namespace {
+
+/// Look up an index in a uuid hash, rebuilding the hash if the lookup
+/// misses or turns out to be stale. A miss costs one linear pass, which
+/// is what every lookup cost before the hashes existed.
+template<typename T, typename GetId>
+int find_by_uuid(
+  QHash<QUuid, int>& uuids,
+  const std::vector<T>& items,
+  const QUuid& id,
+  GetId get_id)
+{
+  auto it = uuids.constFind(id);
+  if (it != uuids.constEnd() &&
+    it.value() < static_cast<int>(items.size()) &&
+    get_id(items[it.value()]) == id)
+    return it.value();
+
+  uuids.clear();
+  uuids.reserve(items.size());
+  for (std::size_t i = 0; i < items.size(); i++)
+    uuids.insert(get_id(items[i]), static_cast<int>(i));
+
+  it = uuids.constFind(id);
+  return it != uuids.constEnd() ? it.value() : -1;
+}
+
+}  // namespace
+
+int Level::find_vertex_index(const QUuid& id) const
+{
+  return find_by_uuid(
+    _vertex_uuids, vertices, id, [](const Vertex& v) { return v.uuid; });
+}
+
+int Level::find_tag_index(const QUuid& id) const
+{
+  return find_by_uuid(
+    _tag_uuids, tags, id, [](const Tag& t) { return t.uuid; });
+}
+
+int Level::find_model_index(const QUuid& id) const
+{
+  return find_by_uuid(
+    _model_uuids, models, id, [](const Model& m) { return m.uuid; });
+}
+
+int Level::find_fiducial_index(const QUuid& id) const
+{
+  return find_by_uuid(
+    _fiducial_uuids, fiducials, id, [](const Fiducial& f) { return f.uuid; });
+}
+
+bool Level::find_feature_index(
+  const QUuid& id,
+  int& layer_idx,
+  int& feature_idx) const
+{
+  auto feature_at = [this](const std::pair<int, int>& location)
+    -> const Feature*
+    {
+      const std::vector<Feature>* features = &floorplan_features;
+      if (location.first > 0)
+      {
+        if (location.first > static_cast<int>(layers.size()))
+          return nullptr;
+        features = &layers[location.first - 1].features;
+      }
+      if (location.second < 0 ||
+        location.second >= static_cast<int>(features->size()))
+        return nullptr;
+      return &(*features)[location.second];
+    };
+
+  auto it = _feature_uuids.constFind(id);
+  if (it == _feature_uuids.constEnd() ||
+    feature_at(it.value()) == nullptr ||
+    feature_at(it.value())->id() != id)
   {
-    if (tags[i].uuid == tag_id)
+    _feature_uuids.clear();
+    for (std::size_t i = 0; i < floorplan_features.size(); i++)
     {
-      return i;
+      _feature_uuids.insert(
+        floorplan_features[i].id(),
+        std::make_pair(0, static_cast<int>(i)));
     }
+    for (std::size_t i = 0; i < layers.size(); i++)
+    {
+      for (std::size_t j = 0; j < layers[i].features.size(); j++)
+      {
+        _feature_uuids.insert(
+          layers[i].features[j].id(),
+          std::make_pair(static_cast<int>(i) + 1, static_cast<int>(j)));
+      }
+    }
+    it = _feature_uuids.constFind(id);
+    if (it == _feature_uuids.constEnd())
+      return false;
   }
-  return tags.size()+1;
+
+  layer_idx = it.value().first;
+  feature_idx = it.value().second;
+  return true;
 }
 // Tags End
 
-bool Level::are_layer_names_unique()
+bool Level::are_layer_names_unique() const
 {
   // Just do the trivial n^2 approach for now, if we ever have a zillion
   // layers, we can do something more sophisticated.
@@ -1582,7 +3225,7 @@ bool Level::are_layer_names_unique()
     {
       if (layers[i].name == layers[j].name)
       {
-        printf("layer %d (%s) is the same as layer %d (%s)\n",
+        qCWarning(lc_edit, "layer %d (%s) is the same as layer %d (%s)",
           static_cast<int>(i),
           layers[i].name.c_str(),
           static_cast<int>(j),
@@ -1598,20 +3241,13 @@ bool Level::are_layer_names_unique()
 
 const Feature* Level::find_feature(const QUuid& id) const
 {
-  for (std::size_t i = 0; i < floorplan_features.size(); i++)
-  {
-    if (floorplan_features[i].id() == id)
-      return &floorplan_features[i];
-  }
-  for (std::size_t layer_idx = 0; layer_idx < layers.size(); layer_idx++)
-  {
-    for (std::size_t i = 0; i < layers[layer_idx].features.size(); i++)
-    {
-      if (layers[layer_idx].features[i].id() == id)
-        return &layers[layer_idx].features[i];
-    }
-  }
-  return nullptr;
+  int layer_idx = -1;
+  int feature_idx = -1;
+  if (!find_feature_index(id, layer_idx, feature_idx))
+    return nullptr;
+  if (layer_idx == 0)
+    return &floorplan_features[feature_idx];
+  return &layers[layer_idx - 1].features[feature_idx];
 }
 
 const Feature* Level::find_feature(const double x, const double y) const
@@ -1651,12 +3287,13 @@ const Feature* Level::find_feature(const double x, const double y) const
 
 void Level::add_constraint(const QUuid& a, const QUuid& b)
 {
-  printf("Level::add_constraint(%s, %s)\n",
+  qCDebug(lc_edit, "Level::add_constraint(%s, %s)",
     a.toString().toStdString().c_str(),
     b.toString().toStdString().c_str());
   if (a == b)
     return;
   constraints.push_back(Constraint(a, b));
+  mark_changed(CONSTRAINT, constraints.size() - 1);
 }
 
 void Level::remove_constraint(const QUuid& a, const QUuid& b)
@@ -1677,46 +3314,41 @@ void Level::remove_constraint(const QUuid& a, const QUuid& b)
     return;
 
   constraints.erase(constraints.begin() + index_to_remove);
+  mark_all_changed();
 }
 
 bool Level::get_feature_point(const QUuid& id, QPointF& point) const
 {
-  for (std::size_t i = 0; i < floorplan_features.size(); i++)
-  {
-    if (floorplan_features[i].id() == id)
-    {
-      point = floorplan_features[i].qpoint();
-      return true;
-    }
-  }
-  for (std::size_t layer_idx = 0; layer_idx < layers.size(); layer_idx++)
+  int layer_idx = -1;
+  int feature_idx = -1;
+  if (!find_feature_index(id, layer_idx, feature_idx))
+    return false;
+
+  if (layer_idx == 0)
   {
-    for (std::size_t i = 0; i < layers[layer_idx].features.size(); i++)
-    {
-      const Layer& layer = layers[layer_idx];
-      if (layer.features[i].id() == id)
-      {
-        const Feature& feature = layers[layer_idx].features[i];
-        point = layer.transform.forwards(feature.qpoint());
-        point /= drawing_meters_per_pixel;
-        return true;
-      }
-    }
+    point = floorplan_features[feature_idx].qpoint();
+    return true;
   }
-  return false;
+
+  const Layer& layer = layers[layer_idx - 1];
+  point = layer.transform.forwards(layer.features[feature_idx].qpoint());
+  point /= drawing_meters_per_pixel;
+  return true;
 }
 
-void Level::draw_constraint(
+QList<QGraphicsItem*> Level::draw_constraint(
   QGraphicsScene* scene,
   const Constraint& constraint,
   int constraint_idx) const
 {
+  QList<QGraphicsItem*> items;
+
   const std::vector<QUuid>& feature_ids = constraint.ids();
   if (feature_ids.size() != 2)
   {
-    printf("WOAH! tried to draw a constraint with only %d ID's!\n",
+    qCWarning(lc_draw, "WOAH! tried to draw a constraint with only %d ID's!",
       static_cast<int>(feature_ids.size()));
-    return;
+    return items;
   }
 
   const QColor color = QColor::fromRgbF(0.7, 0.7, 0.2, 1.0);
@@ -1732,16 +3364,16 @@ void Level::draw_constraint(
   QPointF p1, p2;
   if (!get_feature_point(feature_ids[0], p1))
   {
-    printf("woah! couldn't find constraint feature ID %s\n",
+    qCWarning(lc_draw, "woah! couldn't find constraint feature ID %s",
       feature_ids[0].toString().toStdString().c_str());
-    return;
+    return items;
   }
 
   if (!get_feature_point(feature_ids[1], p2))
   {
-    printf("woah! couldn't find constraint feature ID %s\n",
+    qCWarning(lc_draw, "woah! couldn't find constraint feature ID %s",
       feature_ids[1].toString().toStdString().c_str());
-    return;
+    return items;
   }
 
   QGraphicsLineItem* line = scene->addLine(
@@ -1753,154 +3385,160 @@ void Level::draw_constraint(
   line->setZValue(199.0);
   line->setData(0, "constraint");
   line->setData(1, constraint_idx);
+  items.append(line);
+  return items;
 }
 
-class TransformResidual
+vector<Level::LayerProblem> Level::layer_problems() const
 {
-public:
-  TransformResidual(
-    double level_x,
-    double level_y,
-    double level_meters_per_pixel,
-    double layer_x,
-    double layer_y)
-  : _level_x(level_x),
-    _level_y(level_y),
-    _level_meters_per_pixel(level_meters_per_pixel),
-    _layer_x(layer_x),
-    _layer_y(layer_y)
-  {
-  }
-
-  template<typename T>
-  bool operator()(
-    const T* const yaw,
-    const T* const scale,
-    const T* const translation,
-    T* residual) const
-  {
-    const T qx =
-      (( cos(yaw[0]) * _layer_x + sin(yaw[0]) * _layer_y) * scale[0]
-      + translation[0]) / _level_meters_per_pixel;
-
-    const T qy =
-      ((-sin(yaw[0]) * _layer_x + cos(yaw[0]) * _layer_y) * scale[0]
-      + translation[1]) / _level_meters_per_pixel;
-
-    residual[0] = _level_x - qx;
-    residual[1] = _level_y - qy;
-
-    return true;
+  vector<LayerProblem> problems(layers.size());
+  for (std::size_t i = 0; i < layers.size(); i++)
+  {
+    problems[i].layer_idx = static_cast<int>(i);
+    problems[i].layer_name = layers[i].name;
+    problems[i].meters_per_pixel = drawing_meters_per_pixel;
+    problems[i].initial = layers[i].transform;  // warm start
   }
 
-private:
-  double _level_x, _level_y;
-  double _level_meters_per_pixel;
-  double _layer_x, _layer_y;
-};
+  // one pass over the constraints, looking each feature up by uuid
+  for (const Constraint& constraint : constraints)
+  {
+    const std::vector<QUuid>& feature_ids = constraint.ids();
+    if (feature_ids.size() != 2)
+      continue;
 
-void Level::optimize_layer_transforms()
-{
-  printf("level %s optimizing layer transforms...\n", name.c_str());
+    int layer_idx[2] = {-1, -1};
+    int feature_idx[2] = {-1, -1};
+    if (!find_feature_index(feature_ids[0], layer_idx[0], feature_idx[0]) ||
+      !find_feature_index(feature_ids[1], layer_idx[1], feature_idx[1]))
+    {
+      qCWarning(lc_transform,
+        "WOAH couldn't find a constraint feature! Ignoring it");
+      continue;
+    }
 
-  for (std::size_t i = 0; i < layers.size(); i++)
-  {
-    ceres::Problem problem;
+    // one end on the floorplan, the other on a layer
+    const int level_end = layer_idx[0] == 0 ? 0 : 1;
+    const int layer_end = 1 - level_end;
+    if (layer_idx[level_end] != 0 || layer_idx[layer_end] == 0)
+      continue;
 
-    double yaw = layers[i].transform.yaw();
-    double scale = layers[i].transform.scale();
-    double translation[2] = {
-      layers[i].transform.translation().x(),
-      layers[i].transform.translation().y()
-    };
+    const Feature& level_feature = floorplan_features[feature_idx[level_end]];
+    const Feature& layer_feature =
+      layers[layer_idx[layer_end] - 1].features[feature_idx[layer_end]];
+    problems[layer_idx[layer_end] - 1].points.push_back(
+      std::make_pair(level_feature.qpoint(), layer_feature.qpoint()));
+  }
+  return problems;
+}
 
-    for (const Constraint& constraint : constraints)
+vector<int> Level::constrained_layers(const QUuid& feature_id) const
+{
+  int feature_layer_idx = -1;
+  int feature_idx = -1;
+  if (!find_feature_index(feature_id, feature_layer_idx, feature_idx))
+    return vector<int>();
+  if (feature_layer_idx > 0)
+    return vector<int>(1, feature_layer_idx - 1);
+
+  // a floorplan feature moves the layers it is constrained to
+  std::set<int> layer_idxs;
+  for (const Constraint& constraint : constraints)
+  {
+    if (!constraint.includes_id(feature_id))
+      continue;
+    for (const QUuid& id : constraint.ids())
     {
-      const std::vector<QUuid>& feature_ids = constraint.ids();
-      if (feature_ids.size() != 2)
-        continue;
-
-      QPointF level_point, layer_point;
+      int layer_idx = -1;
+      if (find_feature_index(id, layer_idx, feature_idx) && layer_idx > 0)
+        layer_idxs.insert(layer_idx - 1);
+    }
+  }
+  return vector<int>(layer_idxs.begin(), layer_idxs.end());
+}
 
-      // find the level point
-      bool found_level_point = false;
-      for (const Feature& feature : floorplan_features)
-      {
-        if (feature_ids[0] == feature.id())
-        {
-          level_point = feature.qpoint();
-          found_level_point = true;
-          break;
-        }
-        else if (feature_ids[1] == feature.id())
-        {
-          level_point = feature.qpoint();
-          found_level_point = true;
-          break;
-        }
-      }
-      if (!found_level_point)
-      {
-        printf("WOAH couldn't find level point in constraint! Ignoring it\n");
-        continue;
-      }
+Level::LayerSolution Level::solve_layer_problem(
+  const LayerProblem& layer_problem,
+  const int num_threads,
+  const std::atomic<bool>* cancel)
+{
+  LayerSolution solution;
+  solution.layer_idx = layer_problem.layer_idx;
+  solution.transform = layer_problem.initial;
+  if (layer_problem.points.empty())
+  {
+    solution.summary = "no constraints";
+    return solution;
+  }
 
-      // find the layer point
-      bool found_layer_point = false;
-      for (const Feature& feature : layers[i].features)
-      {
-        if (feature_ids[0] == feature.id())
-        {
-          layer_point = feature.qpoint();
-          found_layer_point = true;
-          break;
-        }
-        else if (feature_ids[1] == feature.id())
-        {
-          layer_point = feature.qpoint();
-          found_layer_point = true;
-          break;
-        }
-      }
-      if (!found_layer_point)
-      {
-        printf("WOAH couldn't find layer point in constraint! Ignoring...\n");
-        continue;
-      }
+  ceres::Problem problem;
 
-      TransformResidual* tr = new TransformResidual(
-        level_point.x(),
-        level_point.y(),
-        drawing_meters_per_pixel,
-        layer_point.x(),
-        layer_point.y());
+  double yaw = layer_problem.initial.yaw();
+  double scale = layer_problem.initial.scale();
+  double translation[2] = {
+    layer_problem.initial.translation().x(),
+    layer_problem.initial.translation().y()
+  };
 
-      problem.AddResidualBlock(
-        new ceres::AutoDiffCostFunction<TransformResidual, 2, 1, 1, 2>(tr),
-        nullptr,
-        &yaw,
-        &scale,
-        &translation[0]);
+  for (const auto& points : layer_problem.points)
+  {
+    problem.AddResidualBlock(
+      new TransformCost(
+        points.first.x(),
+        points.first.y(),
+        layer_problem.meters_per_pixel,
+        points.second.x(),
+        points.second.y()),
+      nullptr,
+      &yaw,
+      &scale,
+      &translation[0]);
+  }
 
-    }
+  problem.SetParameterLowerBound(&scale, 0, 0.01);
+
+  CancelCallback cancel_callback(cancel);
+  ceres::Solver::Options options;
+  options.num_threads = std::max(1, num_threads);
+  options.callbacks.push_back(&cancel_callback);
+  ceres::Solver::Summary summary;
+  ceres::Solve(options, &problem, &summary);
+
+  solution.summary = summary.BriefReport();
+  if (summary.termination_type == ceres::USER_FAILURE ||
+    !summary.IsSolutionUsable())
+    return solution;
+
+  solution.solved = true;
+  solution.transform.setYaw(yaw);
+  solution.transform.setScale(scale);
+  solution.transform.setTranslation(QPointF(translation[0], translation[1]));
+  return solution;
+}
 
-    problem.SetParameterLowerBound(&scale, 0, 0.01);
+void Level::optimize_layer_transforms()
+{
+  TRACE_ZONE("Level::optimize_layer_transforms");
+  qCInfo(lc_transform, "level %s optimizing layer transforms...", name.c_str());
+  mark_all_changed();
 
-    ceres::Solver::Options options;
-    options.minimizer_progress_to_stdout = true;
-    ceres::Solver::Summary summary;
-    ceres::Solve(options, &problem, &summary);
+  for (const LayerProblem& problem : layer_problems())
+  {
+    const LayerSolution solution = solve_layer_problem(problem);
+    qCDebug(lc_transform, "%s", solution.summary.c_str());
+    if (!solution.solved)
+      continue;
 
-    std::cout << summary.BriefReport() << "\n";
-    printf("solution:\n");
-    printf("  yaw = %.3f\n", yaw);
-    printf("  scale = %.3f\n", scale);
-    printf("  translation = (%.3f, %.3f)\n", translation[0], translation[1]);
+    const Transform& t = solution.transform;
+    qCInfo(lc_transform,
+      "layer %s: yaw = %.3f scale = %.3f translation = (%.3f, %.3f)",
+      layers[solution.layer_idx].name.c_str(),
+      t.yaw(),
+      t.scale(),
+      t.translation().x(),
+      t.translation().y());
 
-    layers[i].transform.setYaw(yaw);
-    layers[i].transform.setScale(scale);
-    layers[i].transform.setTranslation(
-      QPointF(translation[0], translation[1]));
+    layers[solution.layer_idx].transform = t;
   }
 }
 
@@ -1911,7 +3549,7 @@ void Level::mouse_select_press(
   const RenderingOptions& rendering_options,
   const Qt::KeyboardModifiers& modifiers)
 {
-  printf("Level::mouse_select_press(%.3f, %.3f)\n", x, y);
+  qCDebug(lc_edit, "Level::mouse_select_press(%.3f, %.3f)", x, y);
 
   if (!(modifiers & Qt::ShiftModifier))
     clear_selection();
@@ -1923,37 +3561,34 @@ void Level::mouse_select_press(
   const double feature_dist_thresh =
     Feature::radius_meters / drawing_meters_per_pixel;
 
-  // todo: use QGraphics stuff to see if we clicked a model pixmap...
+  // models are hit anywhere on their pixmap, or near the center if they
+  // don't have one
   const double model_dist_thresh = 0.5 / drawing_meters_per_pixel;
+  const int model_idx = rendering_options.show_models ?
+    model_at(x, y, model_dist_thresh) : -1;
 
-  if (rendering_options.show_models &&
-    ni.model_idx >= 0 &&
-    ni.model_dist < model_dist_thresh)
-    models[ni.model_idx].selected = true;
+  if (model_idx >= 0)
+    select(make_selected_item(MODEL, model_idx));
   else if (ni.vertex_idx >= 0 && ni.vertex_dist < vertex_dist_thresh)
-    vertices[ni.vertex_idx].selected = true;
+    select(make_selected_item(VERTEX, ni.vertex_idx));
   else if (ni.tag_idx >= 0 && ni.tag_dist < vertex_dist_thresh)
-    tags[ni.tag_idx].selected = true;
+    select(make_selected_item(TAG, ni.tag_idx));
   else if (ni.feature_idx >= 0 && ni.feature_dist < feature_dist_thresh)
   {
     //levels[level_idx].feature_sets[
-    printf("feature_layer_idx = %d, feature_idx = %d, feature_dist = %.3f\n",
+    qCDebug(lc_edit,
+      "feature_layer_idx = %d, feature_idx = %d, feature_dist = %.3f",
       ni.feature_layer_idx,
       ni.feature_idx,
       ni.feature_dist);
 
-    if (ni.feature_layer_idx == 0)
-    {
-      floorplan_features[ni.feature_idx].setSelected(true);
-    }
-    else
-    {
-      layers[ni.feature_layer_idx-1].
-      features[ni.feature_idx].setSelected(true);
-    }
+    SelectedItem feature_item;
+    feature_item.feature_idx = ni.feature_idx;
+    feature_item.feature_layer_idx = ni.feature_layer_idx;
+    select(feature_item);
   }
   else if (ni.fiducial_idx >= 0 && ni.fiducial_dist < 10.0)
-    fiducials[ni.fiducial_idx].selected = true;
+    select(make_selected_item(FIDUCIAL, ni.fiducial_idx));
   else
   {
     // use the QGraphics stuff to see if it's an edge segment or polygon
@@ -1971,8 +3606,25 @@ void Level::mouse_select_press(
           set_selected_containing_polygon(x, y);
           break;
 
+        case EdgeLayerItem::Type:
+        {
+          // the layer only knows that an edge was hit, not which one
+          static const Edge::Type kind_types[EdgeLayerItem::NUM_KINDS] =
+          {Edge::WALL, Edge::MEAS, Edge::DOOR};
+          const EdgeLayerItem* layer =
+            static_cast<const EdgeLayerItem*>(graphics_item);
+          double distance = 0.0;
+          const int edge_idx = nearest_edge_index(
+            x, y, kind_types[layer->kind()], distance);
+          if (edge_idx >= 0)
+            select(make_selected_item(EDGE, edge_idx));
+          else
+            clear_selection();
+          break;
+        }
+
         default:
-          printf("clicked unhandled type: %d\n",
+          qCWarning(lc_edit, "clicked unhandled type: %d",
             static_cast<int>(graphics_item->type()));
           break;
       }
@@ -1980,99 +3632,433 @@ void Level::mouse_select_press(
   }
 }
 
-Level::NearestItem Level::nearest_items(const double x, const double y)
+namespace {
+
+/// Distance from the center of the model to the corners of its pixmap
+double model_footprint_radius(const Model& model)
 {
-  NearestItem ni;
+  if (!model.pixmap_item)
+    return 0.0;
+  const QRectF bounds = model.pixmap_item->boundingRect();
+  return 0.5 * std::hypot(bounds.width(), bounds.height()) *
+    model.pixmap_item->scale();
+}
 
-  for (std::size_t i = 0; i < vertices.size(); i++)
+}  // namespace
+
+double Level::picking_cell_size() const
+{
+  // a cell of about a meter holds a handful of entities on typical maps
+  return drawing_meters_per_pixel > 0.0 ? 1.0 / drawing_meters_per_pixel : 32.0;
+}
+
+void Level::rebuild_feature_grid()
+{
+  _feature_grid.clear(picking_cell_size());
+  _feature_grid_ids.clear();
+  for (std::size_t i = 0; i < floorplan_features.size(); i++)
+  {
+    const Feature& f = floorplan_features[i];
+    _feature_grid.set(_feature_grid_ids.size(), f.x(), f.y());
+    _feature_grid_ids.push_back(std::make_pair(0, static_cast<int>(i)));
+  }
+  std::vector<QPointF> points;
+  for (std::size_t layer_idx = 0; layer_idx < layers.size(); layer_idx++)
   {
-    const Vertex& p = vertices[i];
-    const double dx = x - p.x;
-    const double dy = y - p.y;
-    const double dist = sqrt(dx*dx + dy*dy);
-    if (dist < ni.vertex_dist)
+    // transform the points into parent level's pixel space, all at once
+    const Layer& layer = layers[layer_idx];
+    points.resize(layer.features.size());
+    for (std::size_t i = 0; i < layer.features.size(); i++)
+      points[i] = layer.features[i].qpoint();
+    layer.transform.forwards(
+      points.data(),
+      points.size(),
+      points.data(),
+      1.0 / drawing_meters_per_pixel);
+
+    for (std::size_t i = 0; i < layer.features.size(); i++)
     {
-      ni.vertex_dist = dist;
-      ni.vertex_idx = i;
+      const QPointF& p = points[i];
+      _feature_grid.set(_feature_grid_ids.size(), p.x(), p.y());
+      _feature_grid_ids.push_back(
+        std::make_pair(static_cast<int>(layer_idx) + 1, static_cast<int>(i)));
     }
   }
+  _feature_grid_valid = true;
+}
+
+void Level::rebuild_picking_index()
+{
+  const double cell_size = picking_cell_size();
+
+  _vertex_grid.clear(cell_size);
+  for (std::size_t i = 0; i < vertices.size(); i++)
+    _vertex_grid.set(i, vertices[i].x, vertices[i].y);
 
+  _tag_grid.clear(cell_size);
   for (std::size_t i = 0; i < tags.size(); i++)
+    _tag_grid.set(i, tags[i].x, tags[i].y);
+
+  _fiducial_grid.clear(cell_size);
+  for (std::size_t i = 0; i < fiducials.size(); i++)
+    _fiducial_grid.set(i, fiducials[i].x, fiducials[i].y);
+
+  _model_grid.clear(cell_size);
+  _model_footprint_radius = 0.0;
+  for (std::size_t i = 0; i < models.size(); i++)
+  {
+    _model_grid.set(i, models[i].state.x, models[i].state.y);
+    _model_footprint_radius = std::max(
+      _model_footprint_radius,
+      model_footprint_radius(models[i]));
+  }
+
+  rebuild_feature_grid();
+
+  std::vector<std::pair<int, SegmentRTree::Segment>> edge_segments[
+    Edge::HUMAN_LANE + 1];
+  _indexed_edges.assign(edges.size(), IndexedEdge());
+  _vertex_edges.assign(vertices.size(), std::vector<int>());
+  for (std::size_t i = 0; i < edges.size(); i++)
+  {
+    const Edge& edge = edges[i];
+    const int n_vertices = static_cast<int>(vertices.size());
+    if (edge.start_idx < 0 || edge.start_idx >= n_vertices ||
+      edge.end_idx < 0 || edge.end_idx >= n_vertices ||
+      edge.type < Edge::UNDEFINED || edge.type > Edge::HUMAN_LANE)
+      continue;
+
+    const Vertex& v_start = vertices[edge.start_idx];
+    const Vertex& v_end = vertices[edge.end_idx];
+    SegmentRTree::Segment segment;
+    segment.x0 = v_start.x;
+    segment.y0 = v_start.y;
+    segment.x1 = v_end.x;
+    segment.y1 = v_end.y;
+    edge_segments[edge.type].push_back(
+      std::make_pair(static_cast<int>(i), segment));
+
+    _indexed_edges[i].type = edge.type;
+    _indexed_edges[i].start_idx = edge.start_idx;
+    _indexed_edges[i].end_idx = edge.end_idx;
+    _vertex_edges[edge.start_idx].push_back(i);
+    if (edge.end_idx != edge.start_idx)
+      _vertex_edges[edge.end_idx].push_back(i);
+  }
+  _edge_trees.clear();
+  for (int type = Edge::UNDEFINED; type <= Edge::HUMAN_LANE; type++)
+  {
+    if (!edge_segments[type].empty())
+      _edge_trees[type].build(edge_segments[type]);
+  }
+
+  // keep the cached geometry; index_polygon() drops what has changed
+  for (std::size_t i = polygons.size(); i < _indexed_polygons.size(); i++)
+  {
+    if (_indexed_polygons[i].type == Polygon::HOLE)
+      _hole_revision++;
+  }
+  _indexed_polygons.resize(polygons.size());
+  for (IndexedPolygon& indexed : _indexed_polygons)
+    indexed.vertices.clear();
+  _vertex_polygons.assign(vertices.size(), std::vector<int>());
+  _polygon_tree.clear();
+  for (std::size_t i = 0; i < polygons.size(); i++)
+    index_polygon(i);
+
+  _picking_index_valid = true;
+  _picking_index_moved.clear();
+}
+
+void Level::index_polygon(const int polygon_idx)
+{
+  if (polygon_idx < 0 || polygon_idx >= static_cast<int>(polygons.size()))
+    return;
+  if (polygon_idx >= static_cast<int>(_indexed_polygons.size()))
+    _indexed_polygons.resize(polygon_idx + 1);
+  if (_vertex_polygons.size() < vertices.size())
+    _vertex_polygons.resize(vertices.size());
+
+  IndexedPolygon& indexed = _indexed_polygons[polygon_idx];
+  for (const int vertex_idx : indexed.vertices)
+  {
+    std::vector<int>& attached = _vertex_polygons[vertex_idx];
+    attached.erase(
+      std::remove(attached.begin(), attached.end(), polygon_idx),
+      attached.end());
+  }
+  indexed.vertices.clear();
+  _polygon_tree.remove(polygon_idx);
+
+  QPolygonF shape;
+  const int n_vertices = static_cast<int>(vertices.size());
+  for (const int vertex_idx : polygons[polygon_idx].vertices)
+  {
+    if (vertex_idx < 0 || vertex_idx >= n_vertices)
+      continue;
+    const Vertex& v = vertices[vertex_idx];
+    shape.append(QPointF(v.x, v.y));
+
+    // a vertex may appear more than once in a polygon
+    std::vector<int>& attached = _vertex_polygons[vertex_idx];
+    if (std::find(attached.begin(), attached.end(), polygon_idx) ==
+      attached.end())
+      attached.push_back(polygon_idx);
+    indexed.vertices.push_back(vertex_idx);
+  }
+
+  const int type = polygons[polygon_idx].type;
+  if (shape != indexed.shape || type != indexed.type)
   {
-    const Tag& p = tags[i];
-    const double dx = x - p.x;
-    const double dy = y - p.y;
-    const double dist = sqrt(dx*dx + dy*dy);
-    if (dist < ni.tag_dist)
+    if (type == Polygon::HOLE || indexed.type == Polygon::HOLE)
+      _hole_revision++;
+    indexed.shape = shape;
+    indexed.type = type;
+    indexed.geometry_valid = false;
+  }
+  if (indexed.shape.isEmpty())
+    return;
+
+  const QRectF bounds = indexed.shape.boundingRect();
+  SegmentRTree::Segment diagonal;
+  diagonal.x0 = bounds.left();
+  diagonal.y0 = bounds.top();
+  diagonal.x1 = bounds.right();
+  diagonal.y1 = bounds.bottom();
+  _polygon_tree.insert(polygon_idx, diagonal);
+}
+
+void Level::index_edge(const int edge_idx)
+{
+  if (edge_idx < 0 || edge_idx >= static_cast<int>(edges.size()))
+    return;
+  if (edge_idx >= static_cast<int>(_indexed_edges.size()))
+    _indexed_edges.resize(edge_idx + 1);
+
+  auto unlink = [this, edge_idx](const int vertex_idx)
     {
-      ni.tag_dist = dist;
-      ni.tag_idx = i;
-    }
+      if (vertex_idx < 0 ||
+        vertex_idx >= static_cast<int>(_vertex_edges.size()))
+        return;
+      std::vector<int>& attached = _vertex_edges[vertex_idx];
+      attached.erase(
+        std::remove(attached.begin(), attached.end(), edge_idx),
+        attached.end());
+    };
+
+  IndexedEdge& indexed = _indexed_edges[edge_idx];
+  if (indexed.type >= 0)
+  {
+    _edge_trees[indexed.type].remove(edge_idx);
+    unlink(indexed.start_idx);
+    unlink(indexed.end_idx);
+    indexed = IndexedEdge();
   }
 
-  // search the floorplan features
-  for (std::size_t i = 0; i < floorplan_features.size(); i++)
+  const Edge& edge = edges[edge_idx];
+  const int n_vertices = static_cast<int>(vertices.size());
+  if (edge.start_idx < 0 || edge.start_idx >= n_vertices ||
+    edge.end_idx < 0 || edge.end_idx >= n_vertices ||
+    edge.type < Edge::UNDEFINED || edge.type > Edge::HUMAN_LANE)
+    return;
+
+  const Vertex& v_start = vertices[edge.start_idx];
+  const Vertex& v_end = vertices[edge.end_idx];
+  SegmentRTree::Segment segment;
+  segment.x0 = v_start.x;
+  segment.y0 = v_start.y;
+  segment.x1 = v_end.x;
+  segment.y1 = v_end.y;
+  _edge_trees[edge.type].insert(edge_idx, segment);
+
+  indexed.type = edge.type;
+  indexed.start_idx = edge.start_idx;
+  indexed.end_idx = edge.end_idx;
+  if (_vertex_edges.size() < vertices.size())
+    _vertex_edges.resize(vertices.size());
+  _vertex_edges[edge.start_idx].push_back(edge_idx);
+  if (edge.end_idx != edge.start_idx)
+    _vertex_edges[edge.end_idx].push_back(edge_idx);
+}
+
+const vector<int>& Level::vertex_edges(const int vertex_idx)
+{
+  static const vector<int> none;
+  update_picking_index();
+  if (vertex_idx < 0 ||
+    vertex_idx >= static_cast<int>(_vertex_edges.size()))
+    return none;
+  return _vertex_edges[vertex_idx];
+}
+
+const vector<int>& Level::vertex_polygons(const int vertex_idx)
+{
+  static const vector<int> none;
+  update_picking_index();
+  if (vertex_idx < 0 ||
+    vertex_idx >= static_cast<int>(_vertex_polygons.size()))
+    return none;
+  return _vertex_polygons[vertex_idx];
+}
+
+const PolygonGeometry& Level::polygon_geometry(const int polygon_idx)
+{
+  static const PolygonGeometry none;
+  update_picking_index();
+  if (polygon_idx < 0 ||
+    polygon_idx >= static_cast<int>(_indexed_polygons.size()))
+    return none;
+
+  // vertex lists edited without a mark_changed() would leave it stale
+  if (_indexed_polygons[polygon_idx].vertices !=
+    polygons[polygon_idx].vertices)
+    index_polygon(polygon_idx);
+
+  IndexedPolygon& indexed = _indexed_polygons[polygon_idx];
+  const bool is_floor = indexed.type == Polygon::FLOOR;
+  if (indexed.geometry_valid &&
+    (!is_floor || indexed.geometry_hole_revision == _hole_revision))
+    return indexed.geometry;
+
+  std::vector<QPolygonF> holes;
+  if (is_floor)
   {
-    const Feature& f = floorplan_features[i];
-    const double dx = x - f.x();
-    const double dy = y - f.y();
-    const double dist = sqrt(dx*dx + dy*dy);
-    if (dist < ni.feature_dist)
+    const QRectF bounds = indexed.shape.boundingRect();
+    std::vector<int> candidates;
+    _polygon_tree.intersecting(
+      bounds.left(), bounds.top(), bounds.right(), bounds.bottom(),
+      candidates);
+    std::sort(candidates.begin(), candidates.end());
+    for (const int candidate_idx : candidates)
     {
-      ni.feature_layer_idx = 0;
-      ni.feature_dist = dist;
-      ni.feature_idx = i;
+      if (_indexed_polygons[candidate_idx].type == Polygon::HOLE)
+        holes.push_back(_indexed_polygons[candidate_idx].shape);
     }
   }
+  indexed.geometry = PolygonGeometry::compute(indexed.shape, holes);
+  indexed.geometry_valid = true;
+  indexed.geometry_hole_revision = _hole_revision;
+  return indexed.geometry;
+}
 
-  // now search all "other" layer features
-  for (std::size_t layer_idx = 0; layer_idx < layers.size(); layer_idx++)
+void Level::update_picking_index()
+{
+  std::size_t num_features = floorplan_features.size();
+  for (const Layer& layer : layers)
+    num_features += layer.features.size();
+
+  // entities may have been removed (shifting indices) without being marked
+  if (!_picking_index_valid ||
+    _vertex_grid.size() > vertices.size() ||
+    _tag_grid.size() > tags.size() ||
+    _fiducial_grid.size() > fiducials.size() ||
+    _model_grid.size() > models.size() ||
+    _indexed_edges.size() > edges.size() ||
+    _indexed_polygons.size() > polygons.size() ||
+    _feature_grid_ids.size() != num_features)
   {
-    const Layer& layer = layers[layer_idx];
-    for (std::size_t i = 0; i < layer.features.size(); i++)
-    {
-      const Feature& f = layer.features[i];
+    rebuild_picking_index();
+    return;
+  }
+
+  // layers which were moved
+  if (!_feature_grid_valid)
+    rebuild_feature_grid();
+
+  // entities appended since the last update
+  for (std::size_t i = _vertex_grid.size(); i < vertices.size(); i++)
+    _vertex_grid.set(i, vertices[i].x, vertices[i].y);
+  _vertex_edges.resize(vertices.size());
+  _vertex_polygons.resize(vertices.size());
+  for (std::size_t i = _tag_grid.size(); i < tags.size(); i++)
+    _tag_grid.set(i, tags[i].x, tags[i].y);
+  for (std::size_t i = _fiducial_grid.size(); i < fiducials.size(); i++)
+    _fiducial_grid.set(i, fiducials[i].x, fiducials[i].y);
+  for (std::size_t i = _model_grid.size(); i < models.size(); i++)
+  {
+    _model_grid.set(i, models[i].state.x, models[i].state.y);
+    _model_footprint_radius = std::max(
+      _model_footprint_radius,
+      model_footprint_radius(models[i]));
+  }
+  for (std::size_t i = _indexed_edges.size(); i < edges.size(); i++)
+    index_edge(i);
+  for (std::size_t i = _indexed_polygons.size(); i < polygons.size(); i++)
+    index_polygon(i);
+
+  const int n_vertices = static_cast<int>(vertices.size());
+  const int n_tags = static_cast<int>(tags.size());
+  const int n_fiducials = static_cast<int>(fiducials.size());
+  const int n_models = static_cast<int>(models.size());
 
-      // transform this point into parent level's pixel space
-      QPointF p(layer.transform.forwards(f.qpoint()));
-      p /= drawing_meters_per_pixel;
+  for (const SelectedItem& item : _picking_index_moved)
+  {
+    if (item.vertex_idx >= 0 && item.vertex_idx < n_vertices)
+    {
+      const Vertex& v = vertices[item.vertex_idx];
+      _vertex_grid.set(item.vertex_idx, v.x, v.y);
 
-      const double dx = x - p.x();
-      const double dy = y - p.y();
-      const double dist = sqrt(dx*dx + dy*dy);
-      if (dist < ni.feature_dist)
+      if (item.vertex_idx < static_cast<int>(_vertex_edges.size()))
       {
-        ni.feature_layer_idx = layer_idx + 1;
-        ni.feature_dist = dist;
-        ni.feature_idx = i;
+        // copy, since re-indexing an edge edits this list
+        const std::vector<int> attached = _vertex_edges[item.vertex_idx];
+        for (const int edge_idx : attached)
+          index_edge(edge_idx);
+      }
+      if (item.vertex_idx < static_cast<int>(_vertex_polygons.size()))
+      {
+        const std::vector<int> attached = _vertex_polygons[item.vertex_idx];
+        for (const int polygon_idx : attached)
+          index_polygon(polygon_idx);
       }
     }
-  }
-
-  for (std::size_t i = 0; i < fiducials.size(); i++)
-  {
-    const Fiducial& f = fiducials[i];
-    const double dx = x - f.x;
-    const double dy = y - f.y;
-    const double dist = sqrt(dx*dx + dy*dy);
-    if (dist < ni.fiducial_dist)
+    if (item.edge_idx >= 0)
+      index_edge(item.edge_idx);
+    if (item.polygon_idx >= 0)
+      index_polygon(item.polygon_idx);
+    if (item.tag_idx >= 0 && item.tag_idx < n_tags)
+    {
+      const Tag& t = tags[item.tag_idx];
+      _tag_grid.set(item.tag_idx, t.x, t.y);
+    }
+    if (item.fiducial_idx >= 0 && item.fiducial_idx < n_fiducials)
+    {
+      const Fiducial& f = fiducials[item.fiducial_idx];
+      _fiducial_grid.set(item.fiducial_idx, f.x, f.y);
+    }
+    if (item.model_idx >= 0 && item.model_idx < n_models)
+    {
+      const Model& m = models[item.model_idx];
+      _model_grid.set(item.model_idx, m.state.x, m.state.y);
+      _model_footprint_radius = std::max(
+        _model_footprint_radius,
+        model_footprint_radius(m));
+    }
+    if (item.feature_idx >= 0)
     {
-      ni.fiducial_dist = dist;
-      ni.fiducial_idx = i;
+      // features are rare; not worth mapping back to their grid ids
+      rebuild_picking_index();
+      return;
     }
   }
+  _picking_index_moved.clear();
+}
 
-  for (std::size_t i = 0; i < models.size(); i++)
+Level::NearestItem Level::nearest_items(const double x, const double y)
+{
+  update_picking_index();
+
+  NearestItem ni;
+  ni.vertex_idx = _vertex_grid.nearest(x, y, ni.vertex_dist);
+  ni.tag_idx = _tag_grid.nearest(x, y, ni.tag_dist);
+  ni.fiducial_idx = _fiducial_grid.nearest(x, y, ni.fiducial_dist);
+  ni.model_idx = _model_grid.nearest(x, y, ni.model_dist);
+
+  const int feature_id = _feature_grid.nearest(x, y, ni.feature_dist);
+  if (feature_id >= 0)
   {
-    const Model& m = models[i];
-    const double dx = x - m.state.x;
-    const double dy = y - m.state.y;
-    const double dist = sqrt(dx*dx + dy*dy);  // no need for sqrt each time
-    if (dist < ni.model_dist)
-    {
-      ni.model_dist = dist;
-      ni.model_idx = i;
-    }
+    ni.feature_layer_idx = _feature_grid_ids[feature_id].first;
+    ni.feature_idx = _feature_grid_ids[feature_id].second;
   }
 
   return ni;
@@ -2084,56 +4070,165 @@ int Level::nearest_item_index_if_within_distance(
   const double distance_threshold,
   const ItemType item_type)
 {
+  update_picking_index();
+
   double min_dist = 1e100;
   int min_index = -1;
   if (item_type == VERTEX)
+    min_index = _vertex_grid.nearest(x, y, min_dist);
+  else if (item_type == FIDUCIAL)
+    min_index = _fiducial_grid.nearest(x, y, min_dist);
+  else if (item_type == MODEL)
+    min_index = _model_grid.nearest(x, y, min_dist);
+
+  if (min_dist < distance_threshold)
+    return min_index;
+  return -1;
+}
+
+int Level::nearest_vertex_index(
+  const double x,
+  const double y,
+  double& distance)
+{
+  update_picking_index();
+  return _vertex_grid.nearest(x, y, distance);
+}
+
+int Level::model_at(const double x, const double y, const double fallback_dist)
+{
+  update_picking_index();
+
+  const double r = std::max(fallback_dist, _model_footprint_radius);
+  std::vector<int> candidates;
+  _model_grid.within(x - r, y - r, x + r, y + r, candidates);
+
+  int min_idx = -1;
+  double min_dist = 1e100;
+  for (const int model_idx : candidates)
   {
-    for (std::size_t i = 0; i < vertices.size(); i++)
+    const Model& model = models[model_idx];
+    const double dist = std::hypot(x - model.state.x, y - model.state.y);
+
+    bool hit = false;
+    if (model.pixmap_item)
     {
-      const Vertex& p = vertices[i];
-      const double dx = x - p.x;
-      const double dy = y - p.y;
-      const double dist2 = dx*dx + dy*dy;  // no need for sqrt each time
-      if (dist2 < min_dist)
-      {
-        min_dist = dist2;
-        min_index = i;
-      }
+      const QPolygonF footprint =
+        model.pixmap_item->mapToScene(model.pixmap_item->boundingRect());
+      hit = footprint.containsPoint(QPointF(x, y), Qt::OddEvenFill);
+    }
+    else
+      hit = dist < fallback_dist;
+
+    if (hit && dist < min_dist)
+    {
+      min_dist = dist;
+      min_idx = model_idx;
     }
   }
-  else if (item_type == FIDUCIAL)
+  return min_idx;
+}
+
+Level::SnapTarget Level::snap_target(
+  const double x,
+  const double y,
+  const double threshold,
+  const int exclude_vertex_idx)
+{
+  update_picking_index();
+  SnapTarget target;
+
+  std::vector<int> ids;
+  _vertex_grid.within(
+    x - threshold, y - threshold, x + threshold, y + threshold, ids);
+  double min_dist = threshold;
+  for (const int vertex_idx : ids)
   {
-    for (std::size_t i = 0; i < fiducials.size(); i++)
+    if (vertex_idx == exclude_vertex_idx)
+      continue;
+    const Vertex& v = vertices[vertex_idx];
+    const double dist = std::hypot(x - v.x, y - v.y);
+    if (dist < min_dist)
     {
-      const Fiducial& f = fiducials[i];
-      const double dx = x - f.x;
-      const double dy = y - f.y;
-      const double dist2 = dx*dx + dy*dy;
-      if (dist2 < min_dist)
-      {
-        min_dist = dist2;
-        min_index = i;
-      }
+      min_dist = dist;
+      target.kind = SnapTarget::VERTEX;
+      target.point = QPointF(v.x, v.y);
+      target.vertex_idx = vertex_idx;
     }
   }
-  else if (item_type == MODEL)
+  if (target.kind != SnapTarget::NONE)
+    return target;
+
+  auto accept = [this, exclude_vertex_idx](const int edge_idx)
+    {
+      const Edge& edge = edges[edge_idx];
+      return edge.start_idx != exclude_vertex_idx &&
+        edge.end_idx != exclude_vertex_idx;
+    };
+
+  int min_edge_idx = -1;
+  double min_edge_dist = threshold;
+  for (const auto& type_tree : _edge_trees)
   {
-    for (std::size_t i = 0; i < models.size(); i++)
+    double dist = 0.0;
+    const int edge_idx = type_tree.second.nearest(x, y, dist, accept);
+    if (edge_idx >= 0 && dist < min_edge_dist)
     {
-      const Model& m = models[i];
-      const double dx = x - m.state.x;
-      const double dy = y - m.state.y;
-      const double dist2 = dx*dx + dy*dy;  // no need for sqrt each time
-      if (dist2 < min_dist)
-      {
-        min_dist = dist2;
-        min_index = i;
-      }
+      min_edge_dist = dist;
+      min_edge_idx = edge_idx;
     }
   }
-  if (sqrt(min_dist) < distance_threshold)
-    return min_index;
-  return -1;
+  if (min_edge_idx < 0)
+    return target;
+
+  const Vertex& v_start = vertices[edges[min_edge_idx].start_idx];
+  const Vertex& v_end = vertices[edges[min_edge_idx].end_idx];
+  target.edge_idx = min_edge_idx;
+
+  const QPointF midpoint(
+    0.5 * (v_start.x + v_end.x),
+    0.5 * (v_start.y + v_end.y));
+  if (std::hypot(x - midpoint.x(), y - midpoint.y()) < threshold)
+  {
+    target.kind = SnapTarget::EDGE_MIDPOINT;
+    target.point = midpoint;
+    return target;
+  }
+
+  double x_proj = 0.0;
+  double y_proj = 0.0;
+  point_to_line_segment_distance(
+    x, y, v_start.x, v_start.y, v_end.x, v_end.y, x_proj, y_proj);
+  target.kind = SnapTarget::EDGE_PROJECTION;
+  target.point = QPointF(x_proj, y_proj);
+  return target;
+}
+
+int Level::nearest_edge_index(
+  const double x,
+  const double y,
+  const Edge::Type edge_type,
+  double& distance,
+  const int graph_idx)
+{
+  update_picking_index();
+
+  distance = 1e100;
+  const auto tree_it = _edge_trees.find(edge_type);
+  if (tree_it == _edge_trees.end())
+    return -1;
+
+  if (edge_type != Edge::LANE || graph_idx < 0)
+    return tree_it->second.nearest(x, y, distance);
+
+  return tree_it->second.nearest(
+    x,
+    y,
+    distance,
+    [this, graph_idx](const int edge_idx)
+    {
+      return edges[edge_idx].get_graph_idx() == graph_idx;
+    });
 }
 
 void Level::set_selected_line_item(
@@ -2150,11 +4245,24 @@ void Level::set_selected_line_item(
   const double x2 = line_item->line().x2();
   const double y2 = line_item->line().y2();
 
+  const double thresh = 10.0;  // should be really tiny if it matches
+
+  // only edges starting within the threshold of the line can match it
+  update_picking_index();
+  std::vector<int> candidates;
+  for (const auto& type_tree : _edge_trees)
+  {
+    type_tree.second.intersecting(
+      x1 - thresh, y1 - thresh, x1 + thresh, y1 + thresh, candidates);
+  }
+  std::sort(candidates.begin(), candidates.end());
+
   double min_edge_dist = 1e9;
   Edge* min_edge = nullptr;
   // find if any of our lanes match those vertices
-  for (auto& edge : edges)
+  for (const int edge_idx : candidates)
   {
+    Edge& edge = edges[edge_idx];
     if ((edge.type == Edge::LANE) &&
       (edge.get_graph_idx() != rendering_options.active_traffic_map_idx))
       continue;
@@ -2178,10 +4286,9 @@ void Level::set_selected_line_item(
     }
   }
 
-  const double thresh = 10.0;  // should be really tiny if it matches
   if (min_edge_dist < thresh && min_edge != nullptr)
   {
-    min_edge->selected = true;
+    select(make_selected_item(EDGE, min_edge - edges.data()));
     return;
   }
 
@@ -2191,11 +4298,11 @@ void Level::set_selected_line_item(
     if (line_item->data(1).isValid())
     {
       const int constraint_idx = line_item->data(1).toInt();
-      printf("constraint index: %d\n", constraint_idx);
+      qCDebug(lc_edit, "constraint index: %d", constraint_idx);
       if (constraint_idx >= 0 &&
         constraint_idx < static_cast<int>(constraints.size()))
       {
-        constraints[constraint_idx].setSelected(true);
+        select(make_selected_item(CONSTRAINT, constraint_idx));
       }
       return;
     }
@@ -2209,18 +4316,18 @@ void Level::set_selected_containing_polygon(
   // holes are "higher" in our Z-stack (to make them clickable), so first
   // we need to make a list of all polygons that contain this point.
   vector<Polygon*> containing_polygons;
-  for (std::size_t i = 0; i < polygons.size(); i++)
+  const QPoint point(x, y);
+
+  update_picking_index();
+  std::vector<int> candidates;
+  _polygon_tree.intersecting(
+    point.x(), point.y(), point.x(), point.y(), candidates);
+  std::sort(candidates.begin(), candidates.end());
+
+  for (const int polygon_idx : candidates)
   {
-    Polygon& polygon = polygons[i];
-    QVector<QPointF> polygon_vertices;
-    for (const auto& vertex_idx: polygon.vertices)
-    {
-      const Vertex& v = vertices[vertex_idx];
-      polygon_vertices.append(QPointF(v.x, v.y));
-    }
-    QPolygonF qpolygon(polygon_vertices);
-    if (qpolygon.containsPoint(QPoint(x, y), Qt::OddEvenFill))
-      containing_polygons.push_back(&polygons[i]);
+    if (polygon_geometry(polygon_idx).contains(point))
+      containing_polygons.push_back(&polygons[polygon_idx]);
   }
 
   // first search for holes
@@ -2228,7 +4335,7 @@ void Level::set_selected_containing_polygon(
   {
     if (p->type == Polygon::HOLE)
     {
-      p->selected = true;
+      select(make_selected_item(POLYGON, p - polygons.data()));
       return;
     }
   }
@@ -2236,23 +4343,26 @@ void Level::set_selected_containing_polygon(
   // if we get here, just return the first thing.
   for (Polygon* p : containing_polygons)
   {
-    p->selected = true;
+    select(make_selected_item(POLYGON, p - polygons.data()));
     return;
   }
 }
 
 void Level::compute_layer_transforms()
 {
-  printf("Level::compute_layer_transforms()\n");
+  qCDebug(lc_transform, "Level::compute_layer_transforms()");
   for (std::size_t i = 0; i < layers.size(); i++)
     compute_layer_transform(i);
 }
 
 void Level::compute_layer_transform(const std::size_t layer_idx)
 {
-  printf("Level::compute_layer_transform(%d)\n", static_cast<int>(layer_idx));
+  qCDebug(lc_transform,
+    "Level::compute_layer_transform(%d)",
+    static_cast<int>(layer_idx));
   if (layer_idx >= layers.size())
     return;
+  mark_all_changed();
   Layer& layer = layers[layer_idx];
 
   layer.transform_strings.clear();
@@ -2261,7 +4371,7 @@ void Level::compute_layer_transform(const std::size_t layer_idx)
   Transform ff_rmf;
   ff_rmf.setScale(ff_rmf_scale / layer.transform.scale());
 
-  const double ff_map_height = ff_rmf_scale * layer.image.height();
+  const double ff_map_height = ff_rmf_scale * layer.image_size().height();
 
   ff_rmf.setYaw(-(fmod(layer.transform.yaw() + M_PI, 2 * M_PI) - M_PI));
 
@@ -2284,7 +4394,7 @@ void Level::compute_layer_transform(const std::size_t layer_idx)
       cos(-yaw) * tx + sin(-yaw) * ty,
       -sin(-yaw) * tx + cos(-yaw) * ty));
 
-  printf("tx = %.5f ty = %.5f mh = %.5f sy = %.5f cy = %.5f\n",
+  qCDebug(lc_transform, "tx = %.5f ty = %.5f mh = %.5f sy = %.5f cy = %.5f",
     layer.transform.translation().x(),
     layer.transform.translation().y(),
     ff_map_height,
@@ -2301,10 +4411,12 @@ void Level::compute_layer_transform(const std::size_t layer_idx)
   gridcells_rmf.setYaw(fmod(layer.transform.yaw() + M_PI, 2 * M_PI) - M_PI);
   const double gx =
     (layer.transform.translation().x() +
-    layer.image.height() * gridcells_rmf.scale() * sin(gridcells_rmf.yaw()));
+    layer.image_size().height() * gridcells_rmf.scale() *
+    sin(gridcells_rmf.yaw()));
   const double gy =
     (layer.transform.translation().y() +
-    layer.image.height() * gridcells_rmf.scale() * cos(gridcells_rmf.yaw()));
+    layer.image_size().height() * gridcells_rmf.scale() *
+    cos(gridcells_rmf.yaw()));
   gridcells_rmf.setTranslation(QPointF(gx, gy));
 
   layer.transform_strings.push_back(
@@ -2337,7 +4449,7 @@ void Level::align_colinear()
       sv.index = i;
       sv.expanded = false;
 
-      for (size_t j = 0; j < edges.size(); j++)
+      for (const int j : vertex_edges(i))
       {
         const size_t start_idx = static_cast<size_t>(edges[j].start_idx);
         const size_t end_idx = static_cast<size_t>(edges[j].end_idx);
@@ -2351,18 +4463,22 @@ void Level::align_colinear()
     }
   }
 
-  printf("align_colinear() vertices:\n");
-  for (const SelectedVertex& sv : selected_vertices)
+  if (lc_edit().isDebugEnabled())
   {
-    printf("  %zu:", sv.index);
-    for (const size_t i : sv.connected_vertex_indices)
-      printf(" %zu", i);
-    printf("\n");
+    qCDebug(lc_edit, "align_colinear() vertices:");
+    for (const SelectedVertex& sv : selected_vertices)
+    {
+      QString connected;
+      for (const size_t i : sv.connected_vertex_indices)
+        connected += " " + QString::number(i);
+      qCDebug(lc_edit, "  %zu:%s", sv.index, qUtf8Printable(connected));
+    }
   }
 
   if (selected_vertices.size() < 3)
   {
-    printf("%zu vertices were selected; >= 3 required for colinear align!\n",
+    qCWarning(lc_edit,
+      "%zu vertices were selected; >= 3 required for colinear align!",
       selected_vertices.size());
     return;
   }
@@ -2380,7 +4496,8 @@ void Level::align_colinear()
 
   if (chain.empty())
   {
-    printf("could not find starting point of chain; I'll just make a guess\n");
+    qCDebug(lc_edit,
+      "could not find starting point of chain; I'll just make a guess");
     // for now, just use the element with the smallest horizontal coordinate
     // to be more fancy in the future, we could make a regression line and
     // choose the point closest to its end
@@ -2418,7 +4535,7 @@ void Level::align_colinear()
 
       if (!found)
       {
-        printf("  adding vertex %zu to chain\n", test_vertex_idx);
+        qCDebug(lc_edit, "  adding vertex %zu to chain", test_vertex_idx);
         for (size_t j = 0; j < selected_vertices.size(); j++)
         {
           if (selected_vertices[j].index == test_vertex_idx)
@@ -2432,10 +4549,14 @@ void Level::align_colinear()
       break;
   }
 
-  printf("  chain before sorting:");
-  for (const SelectedVertex& sv : chain)
-    printf(" %zu", sv.index);
-  printf("\n");
+  auto chain_string = [&chain]()
+    {
+      QString s;
+      for (const SelectedVertex& sv : chain)
+        s += " " + QString::number(sv.index);
+      return s;
+    };
+  qCDebug(lc_edit, "  chain before sorting:%s", qUtf8Printable(chain_string()));
 
   // sort the chain vertices by distance from the starting vertex
   const SelectedVertex starting_vertex = chain[0];
@@ -2458,14 +4579,11 @@ void Level::align_colinear()
       return dist_v1 < dist_v2;
     });
 
-  printf("  chain:");
-  for (const SelectedVertex& sv : chain)
-    printf(" %zu", sv.index);
-  printf("\n");
+  qCDebug(lc_edit, "  chain:%s", qUtf8Printable(chain_string()));
 
   if (chain.size() < 3)
   {
-    printf("could not find a connected chain of >= 3 vertices!\n");
+    qCWarning(lc_edit, "could not find a connected chain of >= 3 vertices!");
     return;
   }
 
@@ -2478,13 +4596,13 @@ void Level::align_colinear()
     sqrt((v2.x - v1.x) * (v2.x - v1.x) + (v2.y - v1.y) * (v2.y - v1.y));
   if (line_length < 0.001)
   {
-    printf("ill-defined line! bailing to avoid numerical blowups\n");
+    qCWarning(lc_edit, "ill-defined line! bailing to avoid numerical blowups");
     return;
   }
   const double ux = (v2.x - v1.x) / line_length;
   const double uy = (v2.y - v1.y) / line_length;
 
-  printf("line: (%.3f, %.3f), (%.3f, %.3f)  u = (%.3f, %.3f)\n",
+  qCDebug(lc_edit, "line: (%.3f, %.3f), (%.3f, %.3f)  u = (%.3f, %.3f)",
     v1.x, v1.y, v2.x, v2.y, ux, uy);
 
   // project intermediate vertices onto this line
@@ -2494,5 +4612,30 @@ void Level::align_colinear()
     const double t = ((v1.x - v.x) * ux) + ((v1.y - v.y) * uy);
     v.x = v1.x - t * ux;
     v.y = v1.y - t * uy;
+    mark_changed(VERTEX, chain[i].index);
+  }
+}
+
+vector<ColinearAlignment::Move> Level::colinear_alignment(
+  const double distance_tolerance,
+  const double angle_tolerance) const
+{
+  vector<QPointF> points;
+  points.reserve(vertices.size());
+  for (const Vertex& v : vertices)
+    points.push_back(QPointF(v.x, v.y));
+
+  vector<std::pair<int, int>> segments;
+  segments.reserve(edges.size());
+  for (const Edge& edge : edges)
+  {
+    if (edge.type != Edge::MEAS)
+      segments.push_back(std::make_pair(edge.start_idx, edge.end_idx));
   }
+
+  return ColinearAlignment::align(
+    points,
+    segments,
+    distance_tolerance / drawing_meters_per_pixel,
+    angle_tolerance);
 }
@@ -19,24 +19,46 @@
 #define LEVEL_H
 
 #include <yaml-cpp/yaml.h>
+#include <atomic>
+#include <map>
+#include <memory>
 #include <string>
+#include <utility>
 
+#include "colinear_alignment.hpp"
 #include "constraint.hpp"
+#include "content_hash.hpp"
 #include "coordinate_system.h"
 #include "edge.h"
+#include "edge_layer_item.hpp"
 #include "editor_model.h"
 #include "feature.hpp"
 #include "fiducial.h"
 #include "graph.h"
 #include "layer.h"
+#include "level_statistics.hpp"
+#include "memory_report.hpp"
 #include "model.h"
 #include "polygon.h"
+#include "polygon_geometry.hpp"
 #include "rendering_options.h"
+#include "scene_geometry.hpp"
+#include "scene_items.hpp"
+#include "segment_rtree.hpp"
+#include "spatial_grid.hpp"
 #include "vertex.h"
+#include "vertex_layer_item.hpp"
 #include "tag.h"
+#include "tiled_pixmap_item.hpp"
+#include "vector_underlay.hpp"
 
+#include <QByteArray>
+#include <QFont>
+#include <QHash>
 #include <QPixmap>
 #include <QPainterPath>
+#include <QPolygonF>
+class IoProfile;
 class QGraphicsScene;
 
 
@@ -44,7 +66,6 @@ class Level
 {
 public:
   Level();
-  ~Level();
 
   std::string name;
 
@@ -54,7 +75,7 @@ public:
   std::vector<Tag> tags;
 
   std::vector<Layer> layers;
-  bool are_layer_names_unique();
+  bool are_layer_names_unique() const;
 
   // temporary, just for debugging polygon edge projection...
   double polygon_edge_proj_x = 0.0;
@@ -71,16 +92,35 @@ public:
   void add_tag(const double x, const double y);
   std::size_t get_tag_by_id(QUuid tag_id);
 
+  /// Index of the entity with this uuid, or -1 if there is none. These are
+  /// hash lookups; the hashes re-synchronize themselves whenever a lookup
+  /// finds them stale, so adding, removing or reordering entities needs
+  /// no extra bookkeeping.
+  int find_vertex_index(const QUuid& id) const;
+  int find_tag_index(const QUuid& id) const;
+  int find_model_index(const QUuid& id) const;
+  int find_fiducial_index(const QUuid& id) const;
+
+  /// Look up a feature by uuid. The layer index is 0 for the floorplan
+  /// features, or the index into layers plus one.
+  bool find_feature_index(
+    const QUuid& id,
+    int& layer_idx,
+    int& feature_idx) const;
+
   std::string drawing_filename;
   int drawing_width = 0;
   int drawing_height = 0;
   double drawing_meters_per_pixel = 0.05;
   double elevation = 0.0;
-  const double vertex_radius = 0.1;  // meters
+  static constexpr double vertex_radius = 0.1;  // meters
 
   double x_meters = 10.0;  // manually specified if no drawing supplied
   double y_meters = 10.0;  // manually specified if no drawing supplied
 
+  /// CAD lines drawn under the level, shown and hidden with the drawing
+  VectorUnderlay vector_underlay;
+
   // when generating the building in "flattened" mode, the levels have
   // to be offset in the (x, y) plane to avoid clobbering each other.
   double flattened_x_offset = 0.0;
@@ -93,12 +133,61 @@ public:
 
   QPixmap floorplan_pixmap;
 
+  /// Used instead of floorplan_pixmap for very large drawings
+  std::shared_ptr<TiledImage> floorplan_tiles;
+
+  /// If decode_images is false the layer images are not decoded; call
+  /// load_images() before the level is drawn.
   bool from_yaml(
     const std::string& name,
     const YAML::Node& data,
-    const CoordinateSystem& coordinate_system);
+    const CoordinateSystem& coordinate_system,
+    const bool decode_images = true);
   YAML::Node to_yaml() const;
 
+  /// This level's section of the building file, as Building::save_to()
+  /// last wrote it: kept so that saving only re-serializes the levels that
+  /// changed. Anything that edits the level must invalidate it, which the
+  /// mark_changed() family does.
+  struct SavedYaml
+  {
+    bool valid = false;
+    std::string name;  // the key that the text was emitted with
+    std::string text;
+    QByteArray cache;  // BuildingCache encoding, if one was written
+    std::string file;  // where the text was written, in a split building
+  };
+  mutable SavedYaml saved_yaml;
+  void invalidate_saved_yaml()
+  {
+    saved_yaml.valid = false;
+    _revision++;
+  }
+
+  /// Bumped with every invalidate_saved_yaml(), i.e. whenever the level may
+  /// have been edited: a cheap way to tell whether results derived from it
+  /// (see BuildingValidator) are still current
+  std::size_t revision() const { return _revision; }
+
+  /// The content hashes of the level, its sections and its entities,
+  /// rehashed if the level was edited since (see revision())
+  const ContentHash::LevelHashes& content_hashes() const;
+
+  bool content_hashes_stale() const
+  {
+    return !_content_hashes.valid || _content_hashes.revision != _revision;
+  }
+
+  /// The lanes and human lanes of each graph (by Edge::get_graph_idx()), as
+  /// indices into edges in ascending order, so that what is done graph by
+  /// graph visits only the lanes of the graph. Rebuilt if the level was
+  /// edited since (see revision()); draw() rebuilds it regardless, as the
+  /// edits that it redraws may not have gone through mark_changed().
+  const std::map<int, std::vector<int>>& lane_buckets() const;
+
+  /// The lanes of one graph, as in lane_buckets()
+  const std::vector<int>& graph_lanes(const int graph_idx) const;
+
   const Feature* find_feature(const QUuid& id) const;
   const Feature* find_feature(const double x, const double y) const;
 
@@ -107,7 +196,7 @@ public:
   void add_constraint(const QUuid& a, const QUuid& b);
   void remove_constraint(const QUuid& a, const QUuid& b);
 
-  enum ItemType { VERTEX=1, MODEL, FIDUCIAL };
+  enum ItemType { VERTEX=1, MODEL, FIDUCIAL, EDGE, POLYGON, TAG, CONSTRAINT };
   struct NearestItem
   {
     double model_dist = 1e100;
@@ -137,6 +226,55 @@ public:
     const double distance_threshold,
     const ItemType item_type);
 
+  /// Index of the vertex closest to (x, y), or -1 if there are none
+  int nearest_vertex_index(const double x, const double y, double& distance);
+
+  /// Index of the model whose drawn (rotated) footprint contains (x, y),
+  /// preferring the one centered closest to it, or -1. Models that have no
+  /// pixmap are hit within the fallback distance of their center.
+  int model_at(const double x, const double y, const double fallback_dist);
+
+  /// Where a point being drawn or dragged should snap to
+  struct SnapTarget
+  {
+    enum Kind { NONE = 0, VERTEX, EDGE_MIDPOINT, EDGE_PROJECTION } kind = NONE;
+    QPointF point;
+    int vertex_idx = -1;
+    int edge_idx = -1;
+  };
+
+  /// The nearest vertex within the threshold of (x, y), or failing that
+  /// the midpoint of the nearest edge or the perpendicular projection onto
+  /// it, if they are within the threshold. The excluded vertex and its
+  /// edges are ignored, e.g. when it is the one being dragged.
+  SnapTarget snap_target(
+    const double x,
+    const double y,
+    const double threshold,
+    const int exclude_vertex_idx = -1);
+
+  /// Index of the edge of this type closest to (x, y), or -1 if there
+  /// are none. Lanes can be restricted to one graph with graph_idx >= 0.
+  int nearest_edge_index(
+    const double x,
+    const double y,
+    const Edge::Type edge_type,
+    double& distance,
+    const int graph_idx = -1);
+
+  /// Indices of the edges and polygons that use this vertex. These are
+  /// kept up to date incrementally as entities are marked changed, so
+  /// they are cheap to call repeatedly, but the references are only valid
+  /// until the level is next modified.
+  const std::vector<int>& vertex_edges(const int vertex_idx);
+  const std::vector<int>& vertex_polygons(const int vertex_idx);
+
+  /// Outline, area, perimeter and triangulation of a polygon. Floors have
+  /// the holes inside them cut out. This is cached, and only recomputed
+  /// after the polygon, its vertices or (for floors) a hole has changed;
+  /// the reference is valid until the level is next modified.
+  const PolygonGeometry& polygon_geometry(const int polygon_idx);
+
   void mouse_select_press(
     const double x,
     const double y,
@@ -157,13 +295,87 @@ public:
     int tag_idx = -1;
   };
 
+  /// Entities touched since the last draw() or take_changes(). If `all` is
+  /// set, something was added or removed in a way that shifted indices (or
+  /// that isn't tracked per-entity), and the whole level must be refreshed.
+  struct ChangeSet
+  {
+    bool all = false;
+    std::vector<SelectedItem> items;
+    std::vector<int> layer_transforms;  // indices into layers
+
+    bool empty() const
+    {
+      return !all && items.empty() && layer_transforms.empty();
+    }
+  };
+
+  static SelectedItem make_selected_item(
+    const ItemType item_type,
+    const int idx);
+
+  void mark_changed(const ItemType item_type, const int idx);
+  void mark_changed(const SelectedItem& item);
+  void mark_all_changed();
+
+  /// The transform of this layer (an index into layers) changed, and
+  /// nothing else about it; see update_layer_transform()
+  void mark_layer_transform_changed(const int layer_idx);
+
+  /// Like mark_changed(), for an entity that was moved in a way that
+  /// doesn't need a re-render (e.g. its scene item was moved directly),
+  /// so only the picking index must follow it.
+  void mark_moved(const ItemType item_type, const int idx);
+  bool has_changes() const { return !_changes.empty(); }
+  ChangeSet take_changes();
+
+  /// The same entities, touched since the last take_journal_changes(), for
+  /// EditJournal to record; unlike take_changes(), drawing leaves them be
+  ChangeSet take_journal_changes();
+
+  /// Counts and sums over the entities, for the statistics dashboard (see
+  /// LevelStatistics). Only the entities passed to mark_changed() and
+  /// mark_moved() since the last call are counted again, along with the
+  /// edges and polygons of the vertices among them, so keeping it up to
+  /// date costs in proportion to the edits rather than to the level.
+  const LevelStatistics& statistics();
+
+  /// Whether anything selected is among the pending changes, i.e. whether
+  /// the property editor might be showing something stale
+  bool changes_touch_selection() const;
+
+  /// Bumped whenever a fiducial may have changed (by mark_changed() and
+  /// friends), so that Building can refit only the levels whose fiducials
+  /// did
+  std::size_t fiducials_revision() const { return _fiducials_revision; }
+
   bool can_delete_current_selection();
+
+  /// Delete every selected entity, compacting each list and renumbering
+  /// the vertex indices of the remaining edges and polygons in one pass.
+  /// Refuses (and deletes nothing) if can_delete_current_selection() does.
   bool delete_selected();
+
+  /// Undo a delete_selected(): put vertices back at their original
+  /// (ascending) indices and renumber the existing edges and polygons.
+  void restore_vertices(
+    const std::vector<int>& indices,
+    const std::vector<Vertex>& restored);
   void calculate_scale(const CoordinateSystem& coordinate_system);
   void clear_selection();
 
   void get_selected_items(std::vector<SelectedItem>& selected_items);
 
+  /// Select one entity. The selection is also kept as a set of items, so
+  /// that listing or clearing it scales with its size, not the level's.
+  void select(const SelectedItem& item);
+
+  /// Add the vertices, models, edges and polygons lying entirely inside
+  /// the region (e.g. a rubber band or lasso) to the selection
+  void select_within(
+    const QPolygonF& region,
+    const RenderingOptions& rendering_options);
+
   void set_selected_line_item(
     QGraphicsLineItem* line_item,
     const RenderingOptions& rendering_options);
@@ -179,9 +391,104 @@ public:
     const std::vector<Graph>& graphs,
     const CoordinateSystem& coordinate_system);
 
+  /// Use geometry computed by SceneGeometry::compute() (typically on a
+  /// worker thread) in the next draw(), instead of computing it there.
+  /// It is ignored if the level was edited in the meantime.
+  void set_precomputed_geometry(
+    std::shared_ptr<const SceneGeometry> geometry);
+
+  /// Re-render only the given entities (and the edges and polygons attached
+  /// to any given vertex), replacing the items created for them by the last
+  /// draw(). Returns false if the scene must be rebuilt with draw() instead.
+  bool redraw_items(
+    QGraphicsScene* scene,
+    const std::vector<SelectedItem>& items,
+    std::vector<EditorModel>& editor_models,
+    const RenderingOptions& rendering_options,
+    const std::vector<Graph>& graphs,
+    const CoordinateSystem& coordinate_system);
+
+  /// After RenderingOptions::cull_rect has changed, add the items which
+  /// came into it and remove those which left it. Returns false if the
+  /// level needs a full draw() instead.
+  bool stream_items(
+    QGraphicsScene* scene,
+    std::vector<EditorModel>& editor_models,
+    const RenderingOptions& rendering_options,
+    const std::vector<Graph>& graphs,
+    const CoordinateSystem& coordinate_system);
+
+  /// Move a drawn layer to its current transform, and redraw only the
+  /// constraints to its features, instead of redrawing the level. Returns
+  /// false if the level must be drawn with draw() instead.
+  bool update_layer_transform(QGraphicsScene* scene, const int layer_idx);
+
   void clear_scene();
 
-  bool load_drawing();
+  /// Before the scene is cleared, hand the retained items of this level
+  /// over to the SceneItemPool, so that the next draw() reuses them rather
+  /// than allocating new ones. Does nothing if the level is in another
+  /// scene.
+  void recycle_scene_items(QGraphicsScene* scene);
+
+  /// Show or hide the drawn floorplan, layers, models and the lanes of
+  /// each graph according to their visible flags and rendering_options.
+  /// Each of those is drawn into its own item or group whether or not it
+  /// is visible, so this is a setVisible() per group, without a redraw.
+  void update_visibility(const RenderingOptions& rendering_options);
+
+  /// Decode the drawing. If preview_size is nonzero, a drawing larger than
+  /// that in either direction which isn't in the DecodedImageCache yet is
+  /// decoded downscaled to it instead, for a quick first paint; the full
+  /// image can be decoded on a worker thread and handed to
+  /// set_drawing_image(). Either way drawing_width and drawing_height are
+  /// of the full-resolution drawing.
+  bool load_drawing(const int preview_size = 0);
+
+  /// The drawing is a downscaled preview from load_drawing()
+  bool drawing_is_preview() const { return _drawing_preview_scale != 1.0; }
+
+  /// Use this full-resolution decode of the drawing
+  void set_drawing_image(const QImage& image);
+
+  /// Set drawing_width and drawing_height from the image header, without
+  /// decoding the drawing unless the format doesn't report its size. Needs
+  /// no QGuiApplication.
+  bool read_drawing_size();
+
+  /// Decode the drawing and the layer images, unless already done. See
+  /// load_drawing() for preview_size. Each decode is recorded in profile,
+  /// if it isn't nullptr.
+  bool load_images(
+    const int preview_size = 0,
+    IoProfile* profile = nullptr);
+
+  /// Drop the decoded drawing and layer images to save memory. The level is
+  /// still usable for everything except drawing it; load_images() restores
+  /// them.
+  void unload_images();
+
+  /// Drop only the drawing (if layer_idx < 0) or the image of one layer,
+  /// e.g. because its file changed, for load_images() to decode again
+  void unload_image(const int layer_idx);
+
+  /// Take the decoded drawing of another version of this level, if it is
+  /// of the same file, and the images of its layers of the same names and
+  /// files, leaving load_images() only those which differ to decode
+  void take_images(Level& other);
+
+  bool images_loaded() const { return _images_loaded; }
+
+  /// Approximate memory held by the decoded drawing and layer images
+  std::size_t image_bytes() const;
+
+  /// The area around the vertices and models of a level of a WebMercator
+  /// building without a drawing, with a margin to scroll into. Brings the
+  /// picking index up to date, since it is computed from there.
+  QRectF web_mercator_scroll_area();
+
+  /// Estimated memory held by everything in this level, by category
+  MemoryReport::Usage memory_usage() const;
 
   void set_drawing_visible(bool value) { _drawing_visible = value; }
   bool get_drawing_visible() const { return _drawing_visible; }
@@ -191,11 +498,55 @@ public:
   bool export_features(const std::string& filename) const;
   void optimize_layer_transforms();
 
+  /// The constraints between one layer and the floorplan, copied out of the
+  /// level so that the layer's transform can be solved off the GUI thread
+  struct LayerProblem
+  {
+    int layer_idx = 0;
+    std::string layer_name;
+    double meters_per_pixel = 1.0;
+    Transform initial;
+    /// (floorplan point, layer point) of each constraint
+    std::vector<std::pair<QPointF, QPointF>> points;
+  };
+
+  struct LayerSolution
+  {
+    int layer_idx = 0;
+    bool solved = false;
+    Transform transform;
+    std::string summary;
+  };
+
+  /// One problem per layer, for optimize_layer_transforms() or a worker pool.
+  /// Each starts from the layer's current transform, so re-solving after a
+  /// small edit takes only a few iterations.
+  std::vector<LayerProblem> layer_problems() const;
+
+  /// The layers whose transforms depend on where this feature is: its own,
+  /// or for a floorplan feature, those of the features constrained to it
+  std::vector<int> constrained_layers(const QUuid& feature_id) const;
+
+  /// Thread-safe. The solve stops early, unsolved, once *cancel is set.
+  static LayerSolution solve_layer_problem(
+    const LayerProblem& problem,
+    const int num_threads = 1,
+    const std::atomic<bool>* cancel = nullptr);
+
   void compute_layer_transforms();
   void compute_layer_transform(const std::size_t layer_idx);
 
   void align_colinear();
 
+  /// Bulk counterpart of align_colinear() for whole imported levels: where
+  /// every vertex which lies along a line of edges (other than
+  /// measurements) should move to be exactly on it. The tolerances are in
+  /// meters and radians. Nothing is moved, so the caller can make the
+  /// moves one undoable command.
+  std::vector<ColinearAlignment::Move> colinear_alignment(
+    const double distance_tolerance,
+    const double angle_tolerance) const;
+
 private:
   double point_to_line_segment_distance(
     const double x,
@@ -218,43 +569,214 @@ private:
 
   bool _drawing_visible = true;
 
-  void draw_lane(
+  /// load_images() has run since the last unload_images(). It is not reset
+  /// if an image failed to decode, so a missing file is only reported once.
+  bool _images_loaded = false;
+
+  /// Scene pixels per pixel of floorplan_pixmap, if it is a preview
+  double _drawing_preview_scale = 1.0;
+
+  bool load_drawing_preview(const int preview_size);
+
+  // graphics items of each entity, from the last draw() of this level
+  SceneItems _scene_items;
+
+  /// Set when drawing with RenderingOptions::batch_vertices. Borrowed
+  /// pointer owned by the scene, like the items in _scene_items.
+  VertexLayerItem* _vertex_layer = nullptr;
+
+  /// Set when drawing with RenderingOptions::batch_edges, indexed by
+  /// EdgeLayerItem::Kind. Borrowed pointers owned by the scene.
+  EdgeLayerItem* _edge_layers[EdgeLayerItem::NUM_KINDS] = {};
+
+  /// The layer which paints edges of this type, if they are batched
+  EdgeLayerItem* edge_layer(const Edge::Type type) const;
+
+  /// Hand an edge to its layer instead of drawing items for it. Returns
+  /// false if edges of its type aren't batched.
+  bool batch_edge(const std::size_t idx);
+
+  ChangeSet _changes;
+  ChangeSet _journal_changes;
+  std::size_t _fiducials_revision = 0;
+  std::size_t _revision = 0;
+  mutable ContentHash::LevelHashes _content_hashes;
+
+  /// Everything selected, if _selection_valid; otherwise the selected
+  /// flags were touched in bulk and must be rescanned
+  std::vector<SelectedItem> _selection;
+  bool _selection_valid = false;
+
+  bool is_selected(const SelectedItem& item) const;
+  void set_selected_flag(const SelectedItem& item, const bool selected);
+  void scan_selected_items(std::vector<SelectedItem>& items) const;
+
+  mutable QHash<QUuid, int> _vertex_uuids;
+  mutable QHash<QUuid, int> _tag_uuids;
+  mutable QHash<QUuid, int> _model_uuids;
+  mutable QHash<QUuid, int> _fiducial_uuids;
+  mutable QHash<QUuid, std::pair<int, int>> _feature_uuids;
+
+  /// Grids of entity positions for the nearest-item queries, in scene
+  /// pixels. They are rebuilt lazily on the first query after a draw() or
+  /// an untracked change, and otherwise follow the entities that were
+  /// passed to mark_changed() or mark_moved().
+  SpatialGrid _vertex_grid;
+  SpatialGrid _tag_grid;
+  SpatialGrid _fiducial_grid;
+  SpatialGrid _model_grid;
+  double _model_footprint_radius = 0.0;  // largest of any model
+  SpatialGrid _feature_grid;
+  std::vector<std::pair<int, int>> _feature_grid_ids;  // (layer, feature)
+
+  /// Edges, in one tree per Edge::Type, and what each was indexed with,
+  /// so that moving a vertex can update just the edges attached to it
+  std::map<int, SegmentRTree> _edge_trees;
+  struct IndexedEdge
+  {
+    int type = -1;
+    int start_idx = -1;
+    int end_idx = -1;
+  };
+  std::vector<IndexedEdge> _indexed_edges;
+  std::vector<std::vector<int>> _vertex_edges;
+
+  /// Outline of each polygon, with the vertex indices it was built from,
+  /// and a tree of their bounding boxes (each stored as its diagonal).
+  /// The geometry is computed lazily and survives re-indexing as long as
+  /// the outline and type stay the same.
+  struct IndexedPolygon
+  {
+    QPolygonF shape;
+    std::vector<int> vertices;
+    int type = -1;
+    PolygonGeometry geometry;
+    bool geometry_valid = false;
+    int geometry_hole_revision = -1;  // of the holes that were cut out
+  };
+  std::vector<IndexedPolygon> _indexed_polygons;
+  SegmentRTree _polygon_tree;
+  std::vector<std::vector<int>> _vertex_polygons;
+  int _hole_revision = 0;  // bumped whenever any hole changes shape
+
+  bool _picking_index_valid = false;
+  std::vector<SelectedItem> _picking_index_moved;
+
+  bool _feature_grid_valid = false;
+
+  LevelStatistics _statistics;
+  bool _statistics_valid = false;
+  std::vector<SelectedItem> _statistics_pending;
+  void rebuild_statistics();
+  void mark_statistics_changed(const SelectedItem& item);
+  void mark_journal_changed(const SelectedItem& item);
+
+  void update_picking_index();
+  void rebuild_picking_index();
+  void rebuild_feature_grid();
+  double picking_cell_size() const;
+  void index_edge(const int edge_idx);
+  void index_polygon(const int polygon_idx);
+
+  /// Geometry computed off the GUI thread for the next draw(), if any
+  std::shared_ptr<const SceneGeometry> _geometry;
+
+  /// Lanes are children of one (contentless) root item per graph, and the
+  /// arrows of all unidirectional lanes of a graph are batched into one
+  /// path item per lane width. Borrowed pointers owned by the scene.
+  struct LaneGraphItems
+  {
+    QGraphicsItem* root = nullptr;
+    QList<QGraphicsItem*> arrows;
+  };
+  std::map<int, LaneGraphItems> _lane_graphs;
+
+  /// The drawing, and a (contentless) parent of the model pixmaps.
+  /// Borrowed pointers owned by the scene, like the lane graph roots.
+  QGraphicsItem* _floorplan_item = nullptr;
+  QGraphicsItem* _underlay_item = nullptr;
+  QGraphicsItem* _models_root = nullptr;
+
+  struct LaneBuckets
+  {
+    bool valid = false;
+    std::size_t revision = 0;  // of the level
+    std::size_t num_edges = 0;
+    std::map<int, std::vector<int>> lanes;
+  };
+  mutable LaneBuckets _lane_buckets;
+
+  /// The graph each lane was last drawn in, to know which graphs'
+  /// arrows need to be redrawn when a lane changes
+  static const int NO_LANE_GRAPH = -1000;
+  std::vector<int> _lane_edge_graphs;
+
+  QList<QGraphicsItem*> draw_edge(
     QGraphicsScene* scene,
     const Edge& edge,
     const RenderingOptions& rendering_options,
-    const std::vector<Graph>& graphs) const;
+    const std::vector<Graph>& graphs);
 
-  void draw_wall(QGraphicsScene* scene, const Edge& edge) const;
-  void draw_meas(QGraphicsScene* scene, const Edge& edge) const;
-  void draw_door(QGraphicsScene* scene, const Edge& edge) const;
+  QList<QGraphicsItem*> draw_lane(
+    QGraphicsScene* scene,
+    const Edge& edge,
+    const RenderingOptions& rendering_options,
+    const std::vector<Graph>& graphs);
+
+  QGraphicsItem* lane_graph_root(
+    QGraphicsScene* scene,
+    const int graph_idx,
+    const RenderingOptions& rendering_options);
+
+  bool is_lane_graph_visible(
+    const int graph_idx,
+    const RenderingOptions& rendering_options) const;
+
+  QGraphicsItem* models_root(
+    QGraphicsScene* scene,
+    const RenderingOptions& rendering_options);
+
+  void draw_lane_arrows(
+    QGraphicsScene* scene,
+    const int graph_idx,
+    const RenderingOptions& rendering_options,
+    const std::vector<Graph>& graphs);
+
+  QList<QGraphicsItem*> draw_wall(
+    QGraphicsScene* scene,
+    const Edge& edge) const;
+  QList<QGraphicsItem*> draw_meas(
+    QGraphicsScene* scene,
+    const Edge& edge) const;
+  QList<QGraphicsItem*> draw_door(
+    QGraphicsScene* scene,
+    const Edge& edge,
+    const LevelOfDetail::Tier lod_tier) const;
+  QPainterPath door_motion_path(const std::size_t edge_idx) const;
   void draw_fiducials(QGraphicsScene* scene) const;
-  void draw_polygons(QGraphicsScene* scene) const;
+  void draw_polygons(
+    QGraphicsScene* scene,
+    const RenderingOptions& rendering_options);
+
+  /// True if the entity lies outside RenderingOptions::cull_rect and
+  /// so should not be instantiated in the scene
+  bool is_culled(
+    const SceneItems::Kind kind,
+    const std::size_t idx,
+    const RenderingOptions& rendering_options) const;
 
-  void draw_constraint(
+  QList<QGraphicsItem*> draw_constraint(
     QGraphicsScene* scene,
     const Constraint& constraint,
     int constraint_idx) const;
 
   // helper function
-  void draw_polygon(
+  QList<QGraphicsItem*> draw_polygon(
     QGraphicsScene* scene,
-    const QBrush& brush,
-    const Polygon& polygon) const;
-
-  void add_door_swing_path(
-    QPainterPath& path,
-    double hinge_x,
-    double hinge_y,
-    double door_length,
-    double start_angle,
-    double end_angle) const;
-
-  void add_door_slide_path(
-    QPainterPath& path,
-    double hinge_x,
-    double hinge_y,
-    double door_length,
-    double door_angle) const;
+    const Polygon& polygon,
+    const RenderingOptions& rendering_options);
+
+  QFont vertex_name_font() const;
 };
 
 #endif
@@ -0,0 +1,408 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+
+#include <QFileInfo>
+#include <QGraphicsScene>
+#include <QImage>
+#include <QMarginsF>
+#include <QPageSize>
+#include <QPainter>
+#include <QPdfWriter>
+#include <QSaveFile>
+#include <QSvgGenerator>
+
+#include <zlib.h>
+
+#include "level_image_exporter.hpp"
+#include "logging.hpp"
+#include "task_pool.hpp"
+
+namespace {
+
+/// An 8-bit RGB PNG written a few rows at a time, deflated as they come,
+/// so that neither the image nor its compressed data is ever held whole.
+/// Each row is filtered with the Sub filter, which suits flat drawings.
+class PngStream
+{
+public:
+  PngStream()
+  {
+    _z.zalloc = Z_NULL;
+    _z.zfree = Z_NULL;
+    _z.opaque = Z_NULL;
+  }
+
+  ~PngStream()
+  {
+    if (_deflating)
+      deflateEnd(&_z);
+  }
+
+  bool open(const QString& path, const int width, const int height)
+  {
+    _file.setFileName(path);
+    _width = width;
+    _ok = _file.open(QIODevice::WriteOnly) &&
+      deflateInit(&_z, Z_DEFAULT_COMPRESSION) == Z_OK;
+    _deflating = _ok;
+    if (!_ok)
+      return false;
+
+    static const unsigned char signature[8] =
+    {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    _ok = _file.write(reinterpret_cast<const char*>(signature), 8) == 8;
+
+    unsigned char header[13];
+    put_u32(header, static_cast<std::uint32_t>(width));
+    put_u32(header + 4, static_cast<std::uint32_t>(height));
+    header[8] = 8;  // bits per channel
+    header[9] = 2;  // RGB
+    header[10] = 0;  // deflate
+    header[11] = 0;  // adaptive filtering
+    header[12] = 0;  // not interlaced
+    _ok = _ok && write_chunk("IHDR", header, sizeof(header));
+    _row.resize(1 + static_cast<std::size_t>(width) * 3);
+    _out.resize(256 * 1024);
+    return _ok;
+  }
+
+  /// num_rows rows of width RGB pixels, one after another
+  bool write_rows(const unsigned char* rgb, const int num_rows)
+  {
+    const std::size_t row_bytes = static_cast<std::size_t>(_width) * 3;
+    for (int r = 0; _ok && r < num_rows; r++)
+    {
+      const unsigned char* row = rgb + r * row_bytes;
+      _row[0] = 1;  // Sub: each byte less the one a pixel to its left
+      std::copy(row, row + 3, _row.begin() + 1);
+      for (std::size_t i = 3; i < row_bytes; i++)
+        _row[1 + i] = static_cast<unsigned char>(row[i] - row[i - 3]);
+      _ok = deflate_input(_row.data(), _row.size(), Z_NO_FLUSH);
+    }
+    return _ok;
+  }
+
+  bool finish()
+  {
+    _ok = _ok && deflate_input(nullptr, 0, Z_FINISH) &&
+      write_chunk("IEND", nullptr, 0) && _file.commit();
+    if (!_ok)
+      _file.cancelWriting();
+    return _ok;
+  }
+
+private:
+  QSaveFile _file;
+  z_stream _z;
+  bool _deflating = false;
+  bool _ok = false;
+  int _width = 0;
+  std::vector<unsigned char> _row;
+  std::vector<unsigned char> _out;
+
+  static void put_u32(unsigned char* p, const std::uint32_t v)
+  {
+    p[0] = static_cast<unsigned char>(v >> 24);
+    p[1] = static_cast<unsigned char>(v >> 16);
+    p[2] = static_cast<unsigned char>(v >> 8);
+    p[3] = static_cast<unsigned char>(v);
+  }
+
+  bool write_chunk(
+    const char* type,
+    const unsigned char* data,
+    const std::size_t size)
+  {
+    unsigned char length[4];
+    put_u32(length, static_cast<std::uint32_t>(size));
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, reinterpret_cast<const Bytef*>(type), 4);
+    if (size > 0)
+      crc = crc32(crc, data, static_cast<uInt>(size));
+    unsigned char crc_bytes[4];
+    put_u32(crc_bytes, static_cast<std::uint32_t>(crc));
+    const qint64 n = static_cast<qint64>(size);
+    return _file.write(reinterpret_cast<const char*>(length), 4) == 4 &&
+      _file.write(type, 4) == 4 &&
+      (n == 0 || _file.write(reinterpret_cast<const char*>(data), n) == n) &&
+      _file.write(reinterpret_cast<const char*>(crc_bytes), 4) == 4;
+  }
+
+  bool deflate_input(
+    const unsigned char* data,
+    const std::size_t size,
+    const int flush)
+  {
+    _z.next_in = const_cast<Bytef*>(data);
+    _z.avail_in = static_cast<uInt>(size);
+    int result = Z_OK;
+    do
+    {
+      _z.next_out = _out.data();
+      _z.avail_out = static_cast<uInt>(_out.size());
+      result = deflate(&_z, flush);
+      if (result == Z_STREAM_ERROR)
+        return false;
+      const std::size_t have = _out.size() - _z.avail_out;
+      if (have > 0 && !write_chunk("IDAT", _out.data(), have))
+        return false;
+    } while (_z.avail_out == 0);
+    return flush != Z_FINISH || result == Z_STREAM_END;
+  }
+};
+
+void set_render_hints(QPainter& painter)
+{
+  painter.setRenderHint(QPainter::Antialiasing);
+  painter.setRenderHint(QPainter::SmoothPixmapTransform);
+  painter.setRenderHint(QPainter::TextAntialiasing);
+}
+
+/// Starts a PNG of the source rect of the scene; finished appends the
+/// future of its last band, which commits the file
+bool render_png(
+  QGraphicsScene& scene,
+  const QRectF& source,
+  const double pixels_per_unit,
+  const QString& path,
+  const LevelImageExporter::Options& options,
+  std::vector<QFuture<bool>>& finished)
+{
+  const int width = std::max(
+    1, static_cast<int>(std::ceil(source.width() * pixels_per_unit)));
+  const int height = std::max(
+    1, static_cast<int>(std::ceil(source.height() * pixels_per_unit)));
+  auto png = std::make_shared<PngStream>();
+  if (!png->open(path, width, height))
+    return false;
+
+  const int max_tile = std::max(16, options.max_tile_size);
+  const int tile_width = std::min(width, max_tile);
+  const std::size_t row_bytes = static_cast<std::size_t>(width) * 4;
+  const int band_rows = static_cast<int>(
+    std::max<std::size_t>(
+      1,
+      std::min<std::size_t>(max_tile, options.band_bytes / row_bytes)));
+  QImage tile(tile_width, band_rows, QImage::Format_RGB32);
+
+  QFuture<bool> previous;
+  for (int y0 = 0; y0 < height; y0 += band_rows)
+  {
+    const int rows = std::min(band_rows, height - y0);
+    auto band = std::make_shared<std::vector<unsigned char>>(
+      static_cast<std::size_t>(width) * 3 * rows);
+    for (int x0 = 0; x0 < width; x0 += tile_width)
+    {
+      const int cols = std::min(tile_width, width - x0);
+      tile.fill(Qt::white);
+      {
+        QPainter painter(&tile);
+        set_render_hints(painter);
+        scene.render(
+          &painter,
+          QRectF(0, 0, cols, rows),
+          QRectF(
+            source.x() + x0 / pixels_per_unit,
+            source.y() + y0 / pixels_per_unit,
+            cols / pixels_per_unit,
+            rows / pixels_per_unit),
+          Qt::IgnoreAspectRatio);
+      }
+      for (int r = 0; r < rows; r++)
+      {
+        const QRgb* pixels = reinterpret_cast<const QRgb*>(
+          tile.constScanLine(r));
+        unsigned char* out =
+          band->data() + (static_cast<std::size_t>(r) * width + x0) * 3;
+        for (int c = 0; c < cols; c++)
+        {
+          *out++ = static_cast<unsigned char>(qRed(pixels[c]));
+          *out++ = static_cast<unsigned char>(qGreen(pixels[c]));
+          *out++ = static_cast<unsigned char>(qBlue(pixels[c]));
+        }
+      }
+    }
+
+    // one band is compressed while the next is drawn, so that no more
+    // than two are held at once
+    previous.waitForFinished();
+    const bool last = y0 + rows >= height;
+    previous = TaskPool::instance().run(
+      TaskPool::BACKGROUND,
+      [png, band, rows, last]()
+      {
+        const bool ok = png->write_rows(band->data(), rows);
+        return last ? png->finish() : ok;
+      });
+  }
+  finished.push_back(previous);
+  return true;
+}
+
+bool render_vector(
+  QGraphicsScene& scene,
+  const QRectF& source,
+  const double pixels_per_unit,
+  const LevelImageExporter::Job& job,
+  const QString& title,
+  const LevelImageExporter::Options& options)
+{
+  const double width = source.width() * pixels_per_unit;
+  const double height = source.height() * pixels_per_unit;
+  const QRectF target(0, 0, width, height);
+  const int dpi = std::max(1, static_cast<int>(std::lround(options.dpi)));
+
+  QPainter painter;
+  QSvgGenerator svg;
+  std::unique_ptr<QPdfWriter> pdf;
+  if (job.format == LevelImageExporter::SVG)
+  {
+    svg.setFileName(job.path);
+    svg.setSize(QSize(
+      static_cast<int>(std::ceil(width)),
+      static_cast<int>(std::ceil(height))));
+    svg.setViewBox(target);
+    svg.setResolution(dpi);
+    svg.setTitle(title);
+    if (!painter.begin(&svg))
+      return false;
+  }
+  else
+  {
+    pdf.reset(new QPdfWriter(job.path));
+    pdf->setResolution(dpi);
+    pdf->setPageMargins(QMarginsF(0, 0, 0, 0));
+    pdf->setPageSize(QPageSize(QSizeF(width / dpi, height / dpi),
+      QPageSize::Inch));
+    pdf->setTitle(title);
+    if (!painter.begin(pdf.get()))
+      return false;
+  }
+  set_render_hints(painter);
+  scene.render(&painter, target, source, Qt::IgnoreAspectRatio);
+  return painter.end();
+}
+
+}  // namespace
+
+bool LevelImageExporter::format_from_path(const QString& path, Format& format)
+{
+  const QString suffix = QFileInfo(path).suffix().toLower();
+  if (suffix == "png")
+    format = PNG;
+  else if (suffix == "svg")
+    format = SVG;
+  else if (suffix == "pdf")
+    format = PDF;
+  else
+    return false;
+  return true;
+}
+
+bool LevelImageExporter::export_levels(
+  std::vector<Level>& levels,
+  const std::vector<Job>& jobs,
+  std::vector<EditorModel>& editor_models,
+  const RenderingOptions& rendering_options,
+  const std::vector<Graph>& graphs,
+  const CoordinateSystem& coordinate_system,
+  const Options& options,
+  QStringList* failed,
+  const std::function<void(int)>& before_draw)
+{
+  // everything at full detail, as LevelSnapshot::render() draws it
+  RenderingOptions export_options(rendering_options);
+  export_options.batch_vertices = true;
+  export_options.batch_edges = true;
+  export_options.cull_to_viewport = false;
+  export_options.cull_rect = QRectF();
+  export_options.lod_tier = LevelOfDetail::FINE;
+  export_options.profile = nullptr;
+
+  bool ok = true;
+  auto fail = [&ok, failed](const QString& path)
+    {
+      qCWarning(lc_io, "unable to export %s", qUtf8Printable(path));
+      ok = false;
+      if (failed)
+        failed->append(path);
+    };
+
+  std::vector<QFuture<bool>> pngs;
+  std::vector<QString> png_paths;
+  for (const Job& job : jobs)
+  {
+    if (job.level_idx < 0 ||
+      job.level_idx >= static_cast<int>(levels.size()))
+      continue;
+    if (before_draw)
+      before_draw(job.level_idx);
+    Level& level = levels[job.level_idx];
+
+    QGraphicsScene scene;
+    level.draw(
+      &scene,
+      editor_models,
+      export_options,
+      graphs,
+      coordinate_system);
+    const QRectF source = scene.itemsBoundingRect();
+
+    // meters on paper per meter of the level, in pixels per scene unit
+    const double meters_per_unit = level.drawing_meters_per_pixel > 0.0 ?
+      level.drawing_meters_per_pixel : 1.0;
+    const double pixels_per_unit =
+      options.dpi / 0.0254 / std::max(1e-9, options.scale) * meters_per_unit;
+
+    bool written = true;
+    if (source.isEmpty())
+      qCInfo(lc_io, "level [%s] has nothing to export", level.name.c_str());
+    else if (job.format == PNG)
+    {
+      const std::size_t num_pngs = pngs.size();
+      written = render_png(
+        scene, source, pixels_per_unit, job.path, options, pngs);
+      if (pngs.size() > num_pngs)
+        png_paths.push_back(job.path);
+    }
+    else
+      written = render_vector(
+        scene,
+        source,
+        pixels_per_unit,
+        job,
+        QString::fromStdString(level.name),
+        options);
+
+    // the scratch scene deletes its items when it goes out of scope
+    level.clear_scene();
+    if (!written)
+      fail(job.path);
+  }
+
+  for (std::size_t i = 0; i < pngs.size(); i++)
+  {
+    pngs[i].waitForFinished();
+    if (!pngs[i].result())
+      fail(png_paths[i]);
+  }
+  return ok;
+}
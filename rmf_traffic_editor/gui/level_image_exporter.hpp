@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef TRAFFIC_EDITOR__LEVEL_IMAGE_EXPORTER_HPP
+#define TRAFFIC_EDITOR__LEVEL_IMAGE_EXPORTER_HPP
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include <QString>
+#include <QStringList>
+
+#include "coordinate_system.h"
+#include "editor_model.h"
+#include "graph.h"
+#include "level.h"
+#include "rendering_options.h"
+
+//=============================================================================
+/// Prints levels to files, for sharing or plotting, at a map scale and DPI
+/// (1:100 at 300 DPI is about 118 pixels per meter). Each level is drawn
+/// by Level::draw() into a scratch scene, at full detail and without
+/// culling, like a LevelSnapshot, and rendered from there.
+///
+/// SVG and PDF are written as vectors in one pass. A PNG is rendered in
+/// bands of rows, each a row of tiles no bigger than max_tile_size, into
+/// images of bounded size, so that memory stays flat however big the PNG
+/// is. The finished bands are compressed and streamed to the file on the
+/// background pool while the next bands, or the next levels, are drawn.
+///
+/// Drawing uses QPixmaps and the level's scene registries, so this must be
+/// called on the GUI thread, and the levels forget their scene items (see
+/// LevelSnapshot::render()).
+class LevelImageExporter
+{
+public:
+  enum Format
+  {
+    PNG = 0,
+    SVG,
+    PDF
+  };
+
+  struct Options
+  {
+    double dpi = 300.0;
+    double scale = 100.0;  // 1:scale
+    int max_tile_size = 2048;  // pixels on a side
+    std::size_t band_bytes = 64 << 20;  // of pixels rendered at once
+  };
+
+  struct Job
+  {
+    int level_idx = -1;
+    QString path;
+    Format format = PNG;
+  };
+
+  /// From the suffix of the path; false if it is none of the formats
+  static bool format_from_path(const QString& path, Format& format);
+
+  /// Returns false if any of the files couldn't be written; their paths
+  /// are appended to failed, if given. before_draw, if given, is called
+  /// with the index of each level just before it is drawn, e.g. to load
+  /// its images.
+  static bool export_levels(
+    std::vector<Level>& levels,
+    const std::vector<Job>& jobs,
+    std::vector<EditorModel>& editor_models,
+    const RenderingOptions& rendering_options,
+    const std::vector<Graph>& graphs,
+    const CoordinateSystem& coordinate_system,
+    const Options& options,
+    QStringList* failed = nullptr,
+    const std::function<void(int)>& before_draw = nullptr);
+};
+
+#endif
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+
+#include <QGraphicsItem>
+#include <QGraphicsScene>
+
+#include "level_of_detail.hpp"
+
+// QGraphicsItem::data() keys holding the tier range of tagged items
+static const int MIN_TIER_KEY = 1000;
+static const int MAX_TIER_KEY = 1001;
+
+// view scales (screen pixels per scene pixel) at which the tiers start
+static double MEDIUM_SCALE = LevelOfDetail::DEFAULT_MEDIUM_SCALE;
+static double FINE_SCALE = LevelOfDetail::DEFAULT_FINE_SCALE;
+
+constexpr double LevelOfDetail::DEFAULT_MEDIUM_SCALE;
+constexpr double LevelOfDetail::DEFAULT_FINE_SCALE;
+
+
+LevelOfDetail::Tier LevelOfDetail::tier_for_scale(const double view_scale)
+{
+  if (view_scale >= FINE_SCALE)
+    return FINE;
+  if (view_scale >= MEDIUM_SCALE)
+    return MEDIUM;
+  return COARSE;
+}
+
+void LevelOfDetail::set_scales(
+  const double medium_scale,
+  const double fine_scale)
+{
+  if (medium_scale <= 0.0)
+    return;
+  MEDIUM_SCALE = medium_scale;
+  FINE_SCALE = std::max(medium_scale, fine_scale);
+}
+
+double LevelOfDetail::medium_scale()
+{
+  return MEDIUM_SCALE;
+}
+
+double LevelOfDetail::fine_scale()
+{
+  return FINE_SCALE;
+}
+
+void LevelOfDetail::tag(
+  QGraphicsItem* item,
+  const Tier min_tier,
+  const Tier max_tier,
+  const Tier current_tier)
+{
+  item->setData(MIN_TIER_KEY, static_cast<int>(min_tier));
+  item->setData(MAX_TIER_KEY, static_cast<int>(max_tier));
+  item->setVisible(current_tier >= min_tier && current_tier <= max_tier);
+}
+
+void LevelOfDetail::untag(QGraphicsItem* item)
+{
+  item->setData(MIN_TIER_KEY, QVariant());
+  item->setData(MAX_TIER_KEY, QVariant());
+}
+
+void LevelOfDetail::apply(QGraphicsScene* scene, const Tier tier)
+{
+  const int t = static_cast<int>(tier);
+  for (QGraphicsItem* item : scene->items())
+  {
+    const QVariant min_tier = item->data(MIN_TIER_KEY);
+    if (!min_tier.isValid())
+      continue;  // always visible
+    const int max_tier = item->data(MAX_TIER_KEY).toInt();
+    item->setVisible(t >= min_tier.toInt() && t <= max_tier);
+  }
+}
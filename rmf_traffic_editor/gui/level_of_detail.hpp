@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__LEVEL_OF_DETAIL_HPP
+#define TRAFFIC_EDITOR__LEVEL_OF_DETAIL_HPP
+
+class QGraphicsItem;
+class QGraphicsScene;
+
+//=============================================================================
+/// Detail tiers selected by the zoom of the MapView. Scene items which are
+/// only useful up close are tagged with the range of tiers in which they
+/// are visible, so that switching tiers only toggles item visibility
+/// instead of rebuilding the scene.
+class LevelOfDetail
+{
+public:
+  enum Tier
+  {
+    COARSE = 0,  // whole-building view: no arrows, vertices drawn as points
+    MEDIUM,      // no labels or icons
+    FINE         // everything
+  };
+
+  /// The tier to use for a view scale (screen pixels per scene pixel)
+  static Tier tier_for_scale(const double view_scale);
+
+  /// The view scales at which the MEDIUM and FINE tiers start, from the
+  /// preferences; fine_scale is kept at or above medium_scale
+  static void set_scales(const double medium_scale, const double fine_scale);
+  static double medium_scale();
+  static double fine_scale();
+
+  static constexpr double DEFAULT_MEDIUM_SCALE = 0.15;
+  static constexpr double DEFAULT_FINE_SCALE = 0.5;
+
+  /// Tag an item as visible only in tiers [min_tier, max_tier], and set
+  /// its visibility for the current tier.
+  static void tag(
+    QGraphicsItem* item,
+    const Tier min_tier,
+    const Tier max_tier,
+    const Tier current_tier);
+
+  /// Shorthand for items which are shown at min_tier and finer
+  static void tag(
+    QGraphicsItem* item,
+    const Tier min_tier,
+    const Tier current_tier)
+  {
+    tag(item, min_tier, FINE, current_tier);
+  }
+
+  /// Make a tagged item always visible again, e.g. before it is reused
+  static void untag(QGraphicsItem* item);
+
+  /// Update the visibility of all tagged items in the scene
+  static void apply(QGraphicsScene* scene, const Tier tier);
+};
+
+#endif
@@ -0,0 +1,416 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+
+#include "level_registration.hpp"
+#include "task_pool.hpp"
+
+using std::vector;
+
+namespace {
+
+typedef std::complex<double> Complex;
+
+/// n by n values, row by row
+struct Grid
+{
+  int n = 0;
+  vector<double> v;
+
+  explicit Grid(const int size = 0) : n(size), v(size * size, 0.0) {}
+  double& at(const int x, const int y) { return v[y * n + x]; }
+  double at(const int x, const int y) const { return v[y * n + x]; }
+
+  /// Bilinear, 0 outside
+  double sample(const double x, const double y) const
+  {
+    const int x0 = static_cast<int>(std::floor(x));
+    const int y0 = static_cast<int>(std::floor(y));
+    if (x0 < 0 || y0 < 0 || x0 + 1 >= n || y0 + 1 >= n)
+      return 0.0;
+    const double fx = x - x0;
+    const double fy = y - y0;
+    return (1 - fy) * ((1 - fx) * at(x0, y0) + fx * at(x0 + 1, y0)) +
+      fy * ((1 - fx) * at(x0, y0 + 1) + fx * at(x0 + 1, y0 + 1));
+  }
+};
+
+struct Peak
+{
+  double x = 0.0;  // wrapped to [-n/2, n/2)
+  double y = 0.0;
+  double height = 0.0;
+};
+
+/// In place, radix 2; the inverse is scaled by 1/n
+void fft(vector<Complex>& a, const bool inverse)
+{
+  const std::size_t n = a.size();
+  for (std::size_t i = 1, j = 0; i < n; i++)
+  {
+    std::size_t bit = n >> 1;
+    for (; j & bit; bit >>= 1)
+      j ^= bit;
+    j ^= bit;
+    if (i < j)
+      std::swap(a[i], a[j]);
+  }
+  for (std::size_t length = 2; length <= n; length <<= 1)
+  {
+    const double angle = (inverse ? 2.0 : -2.0) * M_PI / length;
+    const Complex step(std::cos(angle), std::sin(angle));
+    for (std::size_t i = 0; i < n; i += length)
+    {
+      Complex w(1.0, 0.0);
+      for (std::size_t j = 0; j < length / 2; j++)
+      {
+        const Complex u = a[i + j];
+        const Complex v = a[i + j + length / 2] * w;
+        a[i + j] = u + v;
+        a[i + j + length / 2] = u - v;
+        w *= step;
+      }
+    }
+  }
+  if (inverse)
+  {
+    for (Complex& x : a)
+      x /= static_cast<double>(n);
+  }
+}
+
+/// The rows, then the columns, of an n by n array
+void fft2(vector<Complex>& data, const int n, const bool inverse)
+{
+  TaskPool& pool = TaskPool::instance();
+  pool.parallel_for(
+    n,
+    [&](const int y)
+    {
+      vector<Complex> row(data.begin() + y * n, data.begin() + (y + 1) * n);
+      fft(row, inverse);
+      std::copy(row.begin(), row.end(), data.begin() + y * n);
+    });
+  pool.parallel_for(
+    n,
+    [&](const int x)
+    {
+      vector<Complex> column(n);
+      for (int y = 0; y < n; y++)
+        column[y] = data[y * n + x];
+      fft(column, inverse);
+      for (int y = 0; y < n; y++)
+        data[y * n + x] = column[y];
+    });
+}
+
+vector<Complex> spectrum(const Grid& grid)
+{
+  vector<Complex> data(grid.v.begin(), grid.v.end());
+  fft2(data, grid.n, false);
+  return data;
+}
+
+/// The ink of a drawing averaged onto a grid, with the center of the
+/// image at the center of the grid, at cells_per_pixel
+Grid downsample(const QImage& image, const double cells_per_pixel, const int n)
+{
+  Grid grid(n);
+  const double cx = 0.5 * image.width();
+  const double cy = 0.5 * image.height();
+  auto to_image_y = [&](const double gy)
+    {
+      return (gy - 0.5 * n) / cells_per_pixel + cy;
+    };
+  TaskPool::instance().parallel_for(
+    n,
+    [&](const int gy)
+    {
+      const int y0 = std::max(0, static_cast<int>(std::ceil(to_image_y(gy))));
+      const int y1 = std::min(
+        image.height(),
+        static_cast<int>(std::ceil(to_image_y(gy + 1))));
+      vector<double> sums(n, 0.0);
+      vector<int> counts(n, 0);
+      for (int y = y0; y < y1; y++)
+      {
+        const uchar* row = image.constScanLine(y);
+        for (int x = 0; x < image.width(); x++)
+        {
+          const int gx = static_cast<int>(
+            std::floor((x - cx) * cells_per_pixel + 0.5 * n));
+          if (gx < 0 || gx >= n)
+            continue;
+          sums[gx] += 255 - row[x];
+          counts[gx]++;
+        }
+      }
+      for (int gx = 0; gx < n; gx++)
+      {
+        if (counts[gx] > 0)
+        {
+          grid.at(gx, gy) = sums[gx] / counts[gx];
+          continue;
+        }
+        // cells smaller than a pixel take the nearest one
+        const int x = static_cast<int>(
+          std::floor((gx + 0.5 - 0.5 * n) / cells_per_pixel + cx));
+        const int y = static_cast<int>(std::floor(to_image_y(gy + 0.5)));
+        if (x >= 0 && y >= 0 && x < image.width() && y < image.height())
+          grid.at(gx, gy) = 255 - image.constScanLine(y)[x];
+      }
+    });
+  return grid;
+}
+
+/// Tapered to 0 at the sides (Hann), with the mean taken out first, so
+/// that the borders don't show up in the spectra
+Grid windowed(const Grid& grid)
+{
+  Grid result(grid.n);
+  double mean = 0.0;
+  for (const double value : grid.v)
+    mean += value;
+  mean /= grid.v.size();
+  vector<double> hann(grid.n);
+  for (int i = 0; i < grid.n; i++)
+    hann[i] = 0.5 - 0.5 * std::cos(2.0 * M_PI * i / (grid.n - 1));
+  for (int y = 0; y < grid.n; y++)
+  {
+    for (int x = 0; x < grid.n; x++)
+      result.at(x, y) = (grid.at(x, y) - mean) * hann[x] * hann[y];
+  }
+  return result;
+}
+
+/// The high-passed log magnitude of a spectrum, resampled with the angles
+/// of half a turn down the rows and the logarithm of the radius, from 1
+/// to n/2, along the columns
+Grid log_polar(const vector<Complex>& spectrum, const int n, const int m)
+{
+  auto magnitude = [&](const int fx, const int fy)
+    {
+      const int x = (fx % n + n) % n;
+      const int y = (fy % n + n) % n;
+      const double cx = std::cos(M_PI * fx / n);
+      const double cy = std::cos(M_PI * fy / n);
+      const double h = (1.0 - cx * cy) * (2.0 - cx * cy);
+      return std::log1p(h * std::abs(spectrum[y * n + x]));
+    };
+  const double log_step = std::log(0.5 * n) / m;
+  Grid result(m);
+  for (int i = 0; i < m; i++)
+  {
+    const double angle = M_PI * i / m;
+    for (int j = 0; j < m; j++)
+    {
+      const double r = std::exp(j * log_step);
+      const double fx = r * std::cos(angle);
+      const double fy = r * std::sin(angle);
+      const int x0 = static_cast<int>(std::floor(fx));
+      const int y0 = static_cast<int>(std::floor(fy));
+      const double tx = fx - x0;
+      const double ty = fy - y0;
+      result.at(j, i) =
+        (1 - ty) * ((1 - tx) * magnitude(x0, y0) + tx * magnitude(x0 + 1, y0)) +
+        ty * ((1 - tx) * magnitude(x0, y0 + 1) +
+        tx * magnitude(x0 + 1, y0 + 1));
+    }
+  }
+  return result;
+}
+
+/// Where b has to be shifted to to match a: a(x) ~= b(x - peak)
+Peak phase_correlate(const Grid& a, const Grid& b)
+{
+  const int n = a.n;
+  vector<Complex> fa = spectrum(a);
+  const vector<Complex> fb = spectrum(b);
+  for (std::size_t i = 0; i < fa.size(); i++)
+  {
+    const Complex cross = fa[i] * std::conj(fb[i]);
+    const double magnitude = std::abs(cross);
+    fa[i] = magnitude > 1e-12 ? cross / magnitude : Complex(0.0, 0.0);
+  }
+  fft2(fa, n, true);
+
+  int best = 0;
+  for (std::size_t i = 1; i < fa.size(); i++)
+  {
+    if (fa[i].real() > fa[best].real())
+      best = static_cast<int>(i);
+  }
+  const int bx = best % n;
+  const int by = best / n;
+  auto value = [&](const int x, const int y)
+    {
+      return fa[((y + n) % n) * n + (x + n) % n].real();
+    };
+  // a parabola through the peak and its neighbours, along each axis
+  auto refine = [](const double l, const double c, const double r)
+    {
+      const double d = l - 2.0 * c + r;
+      return std::abs(d) > 1e-12 ? 0.5 * (l - r) / d : 0.0;
+    };
+  Peak peak;
+  peak.height = value(bx, by);
+  peak.x = bx + refine(value(bx - 1, by), peak.height, value(bx + 1, by));
+  peak.y = by + refine(value(bx, by - 1), peak.height, value(bx, by + 1));
+  if (peak.x >= 0.5 * n)
+    peak.x -= n;
+  if (peak.y >= 0.5 * n)
+    peak.y -= n;
+  return peak;
+}
+
+/// b turned by yaw and scaled about the center of the grid
+Grid warp(const Grid& b, const double scale, const double yaw)
+{
+  Grid result(b.n);
+  const double c = 0.5 * b.n;
+  const double cos_yaw = std::cos(yaw) / scale;
+  const double sin_yaw = std::sin(yaw) / scale;
+  TaskPool::instance().parallel_for(
+    b.n,
+    [&](const int y)
+    {
+      for (int x = 0; x < b.n; x++)
+      {
+        const double ux = x - c;
+        const double uy = y - c;
+        result.at(x, y) = b.sample(
+          c + cos_yaw * ux + sin_yaw * uy,
+          c - sin_yaw * ux + cos_yaw * uy);
+      }
+    });
+  return result;
+}
+
+bool canceled(TaskProgress* progress)
+{
+  return progress && progress->canceled();
+}
+
+}  // namespace
+
+//=============================================================================
+QPointF LevelRegistration::Result::apply(const QPointF& p) const
+{
+  const double c = std::cos(yaw);
+  const double s = std::sin(yaw);
+  return QPointF(
+    scale * (c * p.x() - s * p.y()) + dx,
+    scale * (s * p.x() + c * p.y()) + dy);
+}
+
+LevelRegistration::Result LevelRegistration::register_level(
+  const QImage& reference,
+  const QImage& level,
+  const double initial_scale,
+  const Options& options,
+  TaskProgress* progress)
+{
+  Result result;
+  const int n = options.grid_size;
+  if (n < 64 || (n & (n - 1)) != 0)
+  {
+    result.summary = "the grid size isn't a power of two of at least 64";
+    return result;
+  }
+  if (reference.isNull() || level.isNull() || initial_scale <= 0.0)
+  {
+    result.summary = "no drawing";
+    return result;
+  }
+
+  // the drawings cover the middle half of the grid, so that the shift
+  // between them doesn't wrap around
+  const double extent = std::max(
+    static_cast<double>(std::max(reference.width(), reference.height())),
+    initial_scale * std::max(level.width(), level.height()));
+  const double pixels_per_cell = extent / (0.5 * n);
+  const Grid a = downsample(reference, 1.0 / pixels_per_cell, n);
+  const Grid b = downsample(level, initial_scale / pixels_per_cell, n);
+  if (canceled(progress))
+    return result;
+
+  // turning and scaling a drawing turns and scales its magnitude spectrum
+  // the same way, which the log-polar resampling makes a shift
+  const int m = n / 2;
+  const Grid la = log_polar(spectrum(windowed(a)), n, m);
+  const Grid lb = log_polar(spectrum(windowed(b)), n, m);
+  const Peak turn = phase_correlate(la, lb);
+  const double scale = std::exp(-turn.x * std::log(0.5 * n) / m);
+  const double yaw = turn.y * M_PI / m;
+  if (canceled(progress))
+    return result;
+
+  const Grid wa = windowed(a);
+  Peak shift;
+  double best_yaw = yaw;
+  for (const double candidate : {yaw, yaw + M_PI})
+  {
+    const Peak peak = phase_correlate(wa, windowed(warp(b, scale, candidate)));
+    if (peak.height > shift.height)
+    {
+      shift = peak;
+      best_yaw = candidate;
+    }
+  }
+
+  // reference = center + pixels_per_cell * (S R (cells of the level) + t)
+  result.scale = scale * initial_scale;
+  result.yaw = std::atan2(std::sin(best_yaw), std::cos(best_yaw));
+  result.peak = shift.height;
+  const QPointF level_center(0.5 * level.width(), 0.5 * level.height());
+  result.dx = 0.0;
+  result.dy = 0.0;
+  const QPointF turned = result.apply(level_center);
+  result.dx = 0.5 * reference.width() + pixels_per_cell * shift.x -
+    turned.x();
+  result.dy = 0.5 * reference.height() + pixels_per_cell * shift.y -
+    turned.y();
+  result.found = result.peak >= options.min_peak;
+
+  char summary[200];
+  snprintf(
+    summary,
+    sizeof(summary),
+    "scale %.4f, turned %.2f degrees, shifted by (%.1f, %.1f) px, "
+    "peak %.3f",
+    result.scale,
+    result.yaw * 180.0 / M_PI,
+    result.dx,
+    result.dy,
+    result.peak);
+  result.summary = summary;
+  return result;
+}
+
+std::vector<QPointF> LevelRegistration::fiducial_points(const QSize& size)
+{
+  std::vector<QPointF> points;
+  for (const double fy : {0.25, 0.75})
+  {
+    for (const double fx : {0.25, 0.75})
+      points.push_back(QPointF(fx * size.width(), fy * size.height()));
+  }
+  return points;
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__LEVEL_REGISTRATION_HPP
+#define TRAFFIC_EDITOR__LEVEL_REGISTRATION_HPP
+
+#include <string>
+#include <vector>
+
+#include <QImage>
+#include <QPointF>
+#include <QSize>
+
+class TaskProgress;
+
+//=============================================================================
+/// Finds the similarity transform between the floorplans of two levels
+/// which look alike, such as the floors of a tower, so that they can be
+/// aligned without placing fiducials on both by hand: the rotation and
+/// scale from the phase correlation of the magnitude spectra of the
+/// drawings resampled to log-polar coordinates (Reddy and Chatterji), and
+/// then the shift from the phase correlation of the reference with the
+/// level turned and scaled by those. The magnitude spectrum doesn't tell
+/// a half turn apart, so both are tried and the better peak wins.
+///
+/// Both drawings are first averaged down onto one square grid, at the
+/// level's guessed scale, and the FFTs of the grid rows and columns are
+/// spread over the TaskPool.
+class LevelRegistration
+{
+public:
+  struct Options
+  {
+    int grid_size = 512;  // a power of two; the drawings cover half of it
+
+    /// The height of the peak of the shift's phase correlation, from 0 to
+    /// 1, below which nothing is found
+    double min_peak = 0.1;
+  };
+
+  struct Result
+  {
+    bool found = false;
+
+    /// Level pixels to reference pixels:
+    ///   reference ~= scale * R(yaw) * level + (dx, dy)
+    double scale = 1.0;
+    double yaw = 0.0;  // radians
+    double dx = 0.0;
+    double dy = 0.0;
+
+    double peak = 0.0;
+    std::string summary;
+
+    QPointF apply(const QPointF& p) const;
+  };
+
+  /// The images are Format_Grayscale8 floorplans, dark lines on light.
+  /// initial_scale is a guess of the reference pixels per level pixel,
+  /// from the meters per pixel of the two; the rotation and scale are
+  /// found within a factor of a few of it. Thread-safe; stops early,
+  /// with nothing found, if progress is canceled.
+  static Result register_level(
+    const QImage& reference,
+    const QImage& level,
+    const double initial_scale,
+    const Options& options,
+    TaskProgress* progress = nullptr);
+
+  /// A few points spread over a drawing of this size, to propose as
+  /// fiducials on both levels
+  static std::vector<QPointF> fiducial_points(const QSize& size);
+};
+
+#endif
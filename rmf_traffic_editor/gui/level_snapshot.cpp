@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+
+#include <QGraphicsScene>
+#include <QImage>
+#include <QPainter>
+#include <QTransform>
+
+#include "level_snapshot.hpp"
+
+
+LevelSnapshot LevelSnapshot::render(
+  Level& level,
+  std::vector<EditorModel>& editor_models,
+  const RenderingOptions& rendering_options,
+  const std::vector<Graph>& graphs,
+  const CoordinateSystem& coordinate_system,
+  const int max_size)
+{
+  // everything at full detail, in as few items as possible
+  RenderingOptions snapshot_options(rendering_options);
+  snapshot_options.batch_vertices = true;
+  snapshot_options.batch_edges = true;
+  snapshot_options.cull_to_viewport = false;
+  snapshot_options.cull_rect = QRectF();
+  snapshot_options.lod_tier = LevelOfDetail::FINE;
+  snapshot_options.profile = nullptr;
+
+  QGraphicsScene scene;
+  level.draw(
+    &scene,
+    editor_models,
+    snapshot_options,
+    graphs,
+    coordinate_system);
+
+  LevelSnapshot snapshot;
+  snapshot.rect = scene.itemsBoundingRect();
+  if (snapshot.rect.isEmpty())
+  {
+    level.clear_scene();
+    return snapshot;
+  }
+
+  const double pixel_scale = std::min(
+    1.0,
+    max_size / std::max(snapshot.rect.width(), snapshot.rect.height()));
+  const int width = static_cast<int>(
+    std::ceil(snapshot.rect.width() * pixel_scale));
+  const int height = static_cast<int>(
+    std::ceil(snapshot.rect.height() * pixel_scale));
+  QImage image(
+    std::max(1, width),
+    std::max(1, height),
+    QImage::Format_ARGB32_Premultiplied);
+  image.fill(Qt::transparent);
+  {
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    scene.render(&painter, QRectF(image.rect()), snapshot.rect);
+  }
+  snapshot.pixmap = QPixmap::fromImage(image);
+
+  // the scratch scene deletes its items when it goes out of scope
+  level.clear_scene();
+  return snapshot;
+}
+
+LevelGhostItem::LevelGhostItem(
+  const LevelSnapshot& snapshot,
+  const double scale,
+  const double dx,
+  const double dy)
+: QGraphicsPixmapItem(snapshot.pixmap)
+{
+  setTransformationMode(Qt::SmoothTransformation);
+
+  // from snapshot pixels to the other level's coordinates, then to ours
+  const double pixels_per_unit =
+    snapshot.pixmap.width() / snapshot.rect.width();
+  QTransform t;
+  t.translate(dx, dy);
+  t.scale(scale, scale);
+  t.translate(snapshot.rect.x(), snapshot.rect.y());
+  t.scale(1.0 / pixels_per_unit, 1.0 / pixels_per_unit);
+  setTransform(t);
+}
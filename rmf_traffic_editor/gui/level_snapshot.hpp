@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__LEVEL_SNAPSHOT_HPP
+#define TRAFFIC_EDITOR__LEVEL_SNAPSHOT_HPP
+
+#include <vector>
+
+#include <QGraphicsPixmapItem>
+#include <QPixmap>
+#include <QRectF>
+
+#include "coordinate_system.h"
+#include "editor_model.h"
+#include "graph.h"
+#include "level.h"
+#include "rendering_options.h"
+
+//=============================================================================
+/// An offscreen raster of everything a level draws, used to show other
+/// levels under the active one without adding all of their items to the
+/// scene. It is rendered once and can then be shown as a single item.
+class LevelSnapshot
+{
+public:
+  QPixmap pixmap;
+
+  /// The area covered by the pixmap, in the level's scene coordinates
+  QRectF rect;
+
+  bool is_valid() const { return !pixmap.isNull(); }
+
+  /// Render the level at no more than max_size pixels on its long side.
+  /// This draws into a scratch scene, so it forgets the level's own scene
+  /// items: don't call it for the level that is currently shown.
+  static LevelSnapshot render(
+    Level& level,
+    std::vector<EditorModel>& editor_models,
+    const RenderingOptions& rendering_options,
+    const std::vector<Graph>& graphs,
+    const CoordinateSystem& coordinate_system,
+    const int max_size = 4096);
+};
+
+//=============================================================================
+/// A LevelSnapshot in the scene of another level, mapped through the
+/// transform between the two levels. It has its own item type so that it
+/// is never mistaken for a model pixmap.
+class LevelGhostItem : public QGraphicsPixmapItem
+{
+public:
+  enum { Type = UserType + 1 };
+
+  /// The transform maps the snapshot level's coordinates to the scene's:
+  /// scale first, then translate
+  LevelGhostItem(
+    const LevelSnapshot& snapshot,
+    const double scale,
+    const double dx,
+    const double dy);
+
+  int type() const { return Type; }
+};
+
+#endif
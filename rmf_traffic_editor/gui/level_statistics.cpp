@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include <cmath>
+
+#include "edge.h"
+#include "level_statistics.hpp"
+#include "model.h"
+#include "polygon.h"
+#include "vertex.h"
+
+namespace {
+
+void add_to(LevelStatistics::Sum& sum, const double length, const int sign)
+{
+  sum.count += sign;
+  sum.length += sign * length;
+  if (sum.count == 0)
+    sum.length = 0.0;  // rather than what the rounding left over
+}
+
+}  // namespace
+
+void LevelStatistics::clear()
+{
+  *this = LevelStatistics();
+}
+
+void LevelStatistics::set_vertex(const std::size_t idx, const Vertex& vertex)
+{
+  if (idx >= _vertices.size())
+    _vertices.resize(idx + 1, false);
+  const bool charger = vertex.is_charger();
+  if (_vertices[idx] != charger)
+  {
+    chargers += charger ? 1 : -1;
+    _vertices[idx] = charger;
+  }
+}
+
+void LevelStatistics::set_edge(
+  const std::size_t idx,
+  const Edge& edge,
+  const std::vector<Vertex>& vertices)
+{
+  if (idx >= _edges.size())
+    _edges.resize(idx + 1);
+
+  CountedEdge counted;
+  counted.type = edge.type;
+  if (edge.type == Edge::LANE)
+    counted.graph_idx = edge.get_graph_idx();
+  const int n = static_cast<int>(vertices.size());
+  if (edge.start_idx >= 0 && edge.start_idx < n &&
+    edge.end_idx >= 0 && edge.end_idx < n)
+  {
+    const Vertex& start = vertices[edge.start_idx];
+    const Vertex& end = vertices[edge.end_idx];
+    counted.length = std::hypot(end.x - start.x, end.y - start.y);
+  }
+
+  add(_edges[idx], -1);
+  _edges[idx] = counted;
+  add(counted, 1);
+}
+
+void LevelStatistics::set_polygon(
+  const std::size_t idx,
+  const Polygon& polygon,
+  const std::vector<Vertex>& vertices)
+{
+  if (idx >= _polygons.size())
+    _polygons.resize(idx + 1);
+
+  CountedPolygon counted;
+  counted.type = polygon.type;
+  if (polygon.type == Polygon::FLOOR || polygon.type == Polygon::HOLE)
+  {
+    // shoelace formula; the winding doesn't matter
+    const int n = static_cast<int>(vertices.size());
+    const std::size_t num_corners = polygon.vertices.size();
+    double twice_area = 0.0;
+    for (std::size_t i = 0; i < num_corners; i++)
+    {
+      const int a = polygon.vertices[i];
+      const int b = polygon.vertices[(i + 1) % num_corners];
+      if (a < 0 || a >= n || b < 0 || b >= n)
+        continue;
+      twice_area += vertices[a].x * vertices[b].y -
+        vertices[b].x * vertices[a].y;
+    }
+    counted.area = std::abs(twice_area) / 2.0;
+  }
+
+  add(_polygons[idx], -1);
+  _polygons[idx] = counted;
+  add(counted, 1);
+}
+
+void LevelStatistics::set_model(const std::size_t idx, const Model& model)
+{
+  if (idx < _models.size())
+  {
+    if (_models[idx] == model.model_name)
+      return;
+    auto it = models.find(_models[idx]);
+    if (it != models.end() && --it->second <= 0)
+      models.erase(it);
+  }
+  else
+    _models.resize(idx + 1);
+
+  _models[idx] = model.model_name;
+  models[model.model_name]++;
+}
+
+void LevelStatistics::add(const CountedEdge& edge, const int sign)
+{
+  switch (edge.type)
+  {
+    case Edge::LANE:
+    {
+      Sum& sum = lanes[edge.graph_idx];
+      add_to(sum, edge.length, sign);
+      if (sum.count == 0)
+        lanes.erase(edge.graph_idx);
+      break;
+    }
+    case Edge::HUMAN_LANE:
+      add_to(human_lanes, edge.length, sign);
+      break;
+    case Edge::WALL:
+      add_to(walls, edge.length, sign);
+      break;
+    case Edge::DOOR:
+      doors += sign;
+      break;
+    case Edge::MEAS:
+      measurements += sign;
+      break;
+    default:
+      break;  // not yet counted, or of no interest
+  }
+}
+
+void LevelStatistics::add(const CountedPolygon& polygon, const int sign)
+{
+  if (polygon.type == Polygon::FLOOR)
+    add_to(floors, polygon.area, sign);
+  else if (polygon.type == Polygon::HOLE)
+    add_to(holes, polygon.area, sign);
+}
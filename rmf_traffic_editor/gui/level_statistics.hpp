@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef TRAFFIC_EDITOR__LEVEL_STATISTICS_HPP
+#define TRAFFIC_EDITOR__LEVEL_STATISTICS_HPP
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+class Edge;
+class Model;
+class Polygon;
+class Vertex;
+
+//=============================================================================
+/// Counts and sums over the entities of one level, for the statistics
+/// dashboard. Each entity is remembered with what it was counted as, so an
+/// edit only takes its old contribution out of the totals and puts the new
+/// one in, instead of recounting the level. Lengths are in scene pixels
+/// and areas in square pixels, so that rescaling the drawing doesn't make
+/// them stale; BuildingStatistics converts them to meters.
+class LevelStatistics
+{
+public:
+  struct Sum
+  {
+    int count = 0;
+    double length = 0.0;  // or area
+  };
+
+  int chargers = 0;
+  std::map<int, Sum> lanes;  // by Edge::get_graph_idx()
+  Sum human_lanes;
+  Sum walls;
+  int doors = 0;
+  int measurements = 0;
+  Sum floors;
+  Sum holes;
+  std::map<std::string, int> models;  // by model_name
+
+  int vertex_count() const { return static_cast<int>(_vertices.size()); }
+  std::size_t edge_count() const { return _edges.size(); }
+  std::size_t polygon_count() const { return _polygons.size(); }
+  std::size_t model_count() const { return _models.size(); }
+
+  /// Forget everything, before counting the level from scratch
+  void clear();
+
+  /// Count the entity at this index as it is now, replacing whatever it
+  /// was counted as before. The edges and polygons must be counted again
+  /// when one of their vertices moves.
+  void set_vertex(const std::size_t idx, const Vertex& vertex);
+  void set_edge(
+    const std::size_t idx,
+    const Edge& edge,
+    const std::vector<Vertex>& vertices);
+  void set_polygon(
+    const std::size_t idx,
+    const Polygon& polygon,
+    const std::vector<Vertex>& vertices);
+  void set_model(const std::size_t idx, const Model& model);
+
+private:
+  struct CountedEdge
+  {
+    int type = -1;
+    int graph_idx = -1;
+    double length = 0.0;
+  };
+
+  struct CountedPolygon
+  {
+    int type = -1;
+    double area = 0.0;
+  };
+
+  void add(const CountedEdge& edge, const int sign);
+  void add(const CountedPolygon& polygon, const int sign);
+
+  std::vector<bool> _vertices;  // whether each is a charger
+  std::vector<CountedEdge> _edges;
+  std::vector<CountedPolygon> _polygons;
+  std::vector<std::string> _models;
+};
+
+#endif
@@ -17,6 +17,7 @@
 
 #include "level_table.h"
 #include "level_dialog.h"
+#include "level_thumbnails.hpp"
 #include <QtWidgets>
 
 LevelTable::LevelTable()
@@ -41,45 +42,42 @@ void LevelTable::update(Building& building)
   for (std::size_t i = 0; i < building.levels.size(); i++)
   {
     QTableWidgetItem* name_item =
-      new QTableWidgetItem(QString::fromStdString(building.levels[i].name));
-    setItem(i, 0, name_item);
+      set_cell_text(i, 0, QString::fromStdString(building.levels[i].name));
+    set_item_background(
+      name_item,
+      static_cast<int>(i) == reference_level_idx ?
+      QBrush(QColor("#e0ffe0")) : QBrush());
 
-    if (static_cast<int>(i) == reference_level_idx)
-      name_item->setBackground(QBrush(QColor("#e0ffe0")));
-
-    setItem(
+    set_cell_text(
       i,
       1,
-      new QTableWidgetItem(
-        QString::number(
-          building.levels[i].drawing_meters_per_pixel,
-          'f',
-          4)));
+      QString::number(building.levels[i].drawing_meters_per_pixel, 'f', 4));
 
     Building::Transform t = building.get_transform(reference_level_idx, i);
 
-    setItem(i, 2, new QTableWidgetItem(QString::number(t.dx, 'f', 1)));
-    setItem(i, 3, new QTableWidgetItem(QString::number(t.dy, 'f', 1)));
-
-    setItem(
-      i,
-      4,
-      new QTableWidgetItem(
-        QString::number(building.levels[i].elevation, 'f', 1)));
+    set_cell_text(i, 2, QString::number(t.dx, 'f', 1));
+    set_cell_text(i, 3, QString::number(t.dy, 'f', 1));
+    set_cell_text(i, 4, QString::number(building.levels[i].elevation, 'f', 1));
 
-    QPushButton* edit_button = new QPushButton("Edit...", this);
-    setCellWidget(i, 5, edit_button);
+    bool created = false;
+    QPushButton* edit_button = cell_button(i, 5, "Edit...", created);
+    if (!created)
+      continue;
     edit_button->setStyleSheet("QTableWidgetItem { background-color: red; }");
 
     connect(
       edit_button,
       &QAbstractButton::clicked,
-      [this, &building, i]()
+      [this, &building, edit_button]()
       {
-        LevelDialog level_dialog(building.levels[i], building);
+        const int row = row_of(edit_button, 5);
+        if (row < 0 || row >= static_cast<int>(building.levels.size()))
+          return;
+        LevelDialog level_dialog(building.levels[row], building);
         if (level_dialog.exec() == QDialog::Accepted)
         {
-          building.levels[i].load_drawing();
+          building.levels[row].load_drawing();
+          building.levels[row].invalidate_saved_yaml();
           setWindowModified(true);  // not sure why, but this doesn't work
         }
         update(building);
@@ -89,26 +87,65 @@ void LevelTable::update(Building& building)
   const int last_row_idx = static_cast<int>(building.levels.size());
   // we'll use the last row for the "Add" button
   for (int i = 0; i < 5; i++)
-    setItem(last_row_idx, i, new QTableWidgetItem(QString()));
-
-  QPushButton* add_button = new QPushButton("Add...", this);
-  setCellWidget(last_row_idx, 5, add_button);
-  connect(
-    add_button,
-    &QAbstractButton::clicked,
-    [this, &building]()
+  {
+    set_cell_text(last_row_idx, i, QString());
+    set_item_background(item(last_row_idx, i), QBrush());
+  }
+
+  bool created = false;
+  QPushButton* add_button = cell_button(last_row_idx, 5, "Add...", created);
+  if (created)
+  {
+    connect(
+      add_button,
+      &QAbstractButton::clicked,
+      [this, &building]()
+      {
+        Level level;
+        LevelDialog level_dialog(level, building);
+        if (level_dialog.exec() == QDialog::Accepted)
+        {
+          level.load_drawing();
+          building.add_level(std::move(level));
+          setWindowModified(true);
+          update(building);
+          emit redraw_scene();
+        }
+      });
+  }
+
+  blockSignals(false);
+}
+
+void LevelTable::set_thumbnails(
+  const Building& building,
+  const LevelThumbnails& thumbnails)
+{
+  const QSize size(thumbnails.size(), thumbnails.size());
+  if (iconSize() != size)
+    setIconSize(size);
+
+  blockSignals(true);
+  for (std::size_t i = 0; i < building.levels.size(); i++)
+  {
+    QTableWidgetItem* name_item = item(static_cast<int>(i), 0);
+    if (!name_item)
+      continue;
+    const QImage image = thumbnails.thumbnail(building.levels[i].name);
+    if (image.isNull())
     {
-      Level level;
-      LevelDialog level_dialog(level, building);
-      if (level_dialog.exec() == QDialog::Accepted)
+      if (!name_item->icon().isNull())
       {
-        level.load_drawing();
-        building.add_level(level);
-        setWindowModified(true);
-        update(building);
-        emit redraw_scene();
+        name_item->setIcon(QIcon());
+        name_item->setData(Qt::UserRole, QVariant());
       }
-    });
-
+      continue;
+    }
+    // a thumbnail is only rendered again when its level is edited
+    if (name_item->data(Qt::UserRole).toLongLong() == image.cacheKey())
+      continue;
+    name_item->setIcon(QIcon(QPixmap::fromImage(image)));
+    name_item->setData(Qt::UserRole, image.cacheKey());
+  }
   blockSignals(false);
 }
@@ -23,6 +23,8 @@
 #include "table_list.h"
 #include "building.h"
 
+class LevelThumbnails;
+
 class LevelTable : public TableList
 {
   Q_OBJECT
@@ -33,6 +35,11 @@ public:
 
   void update(Building& building);
 
+  /// Show the thumbnail of each level beside its name, if it has one yet
+  void set_thumbnails(
+    const Building& building,
+    const LevelThumbnails& thumbnails);
+
 signals:
   void redraw_scene();
   void edit_button_clicked(const int row_idx);
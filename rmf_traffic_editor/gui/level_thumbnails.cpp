@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "level_thumbnails.hpp"
+#include "minimap.hpp"
+#include "task_pool.hpp"
+
+namespace {
+
+/// Enough for the levels of a few buildings, open in tabs, and their edits
+const std::size_t max_cached = 256;
+
+}  // namespace
+
+LevelThumbnails::LevelThumbnails(QObject* parent, const int size)
+: QObject(parent),
+  _size(size)
+{
+  _watcher = new QFutureWatcher<std::vector<Job>>(this);
+  connect(
+    _watcher,
+    &QFutureWatcher<std::vector<Job>>::finished,
+    this,
+    &LevelThumbnails::finished);
+}
+
+void LevelThumbnails::update(
+  const std::shared_ptr<const BuildingSnapshot>& snapshot)
+{
+  if (!snapshot)
+    return;
+  if (_watcher->isRunning())
+  {
+    _queued = snapshot;  // finished() comes back for it
+    return;
+  }
+
+  // the hashes of the levels of a snapshot are already computed
+  const bool y_flipped = snapshot->coordinate_system.is_y_flipped();
+  bool changed = false;
+  std::map<std::string, QImage> shown;
+  std::vector<std::shared_ptr<const Level>> missing;
+  _wanted.clear();
+  for (const std::shared_ptr<const Level>& level : snapshot->levels)
+  {
+    const Key key(level->content_hashes().level, y_flipped);
+    _wanted[level->name] = key;
+    const auto it = _cache.find(key);
+    if (it == _cache.end())
+    {
+      missing.push_back(level);
+      // until it is rendered, show what it looked like before the edit
+      const auto shown_it = _shown.find(level->name);
+      if (shown_it != _shown.end())
+        shown[level->name] = shown_it->second;
+      continue;
+    }
+    const auto shown_it = _shown.find(level->name);
+    if (shown_it == _shown.end() ||
+      shown_it->second.cacheKey() != it->second.cacheKey())
+      changed = true;
+    shown[level->name] = it->second;
+  }
+  changed = changed || shown.size() != _shown.size();
+  _shown.swap(shown);
+  if (changed)
+    emit updated();
+
+  if (missing.empty())
+    return;
+  const int size = _size;
+  _watcher->setFuture(
+    TaskPool::instance().run(
+      TaskPool::BACKGROUND,
+      [missing, y_flipped, size]()
+      {
+        std::vector<Job> jobs;
+        for (const std::shared_ptr<const Level>& level : missing)
+        {
+          Job job;
+          job.level_name = level->name;
+          job.key = Key(level->content_hashes().level, y_flipped);
+          const Minimap::Input input = Minimap::input(*level, y_flipped);
+          if (!input.rect.isEmpty())
+            job.image = Minimap::render(input, size).image;
+          jobs.push_back(std::move(job));
+        }
+        return jobs;
+      }));
+}
+
+void LevelThumbnails::finished()
+{
+  bool changed = false;
+  for (Job& job : _watcher->result())
+  {
+    if (_cache.find(job.key) == _cache.end())
+    {
+      _cache[job.key] = job.image;
+      _cache_order.push_back(job.key);
+    }
+    const auto it = _wanted.find(job.level_name);
+    if (it != _wanted.end() && it->second == job.key)
+    {
+      _shown[job.level_name] = job.image;
+      changed = true;
+    }
+  }
+  while (_cache.size() > max_cached)
+  {
+    _cache.erase(_cache_order.front());
+    _cache_order.pop_front();
+  }
+  if (changed)
+    emit updated();
+
+  if (_queued)
+  {
+    std::shared_ptr<const BuildingSnapshot> snapshot;
+    snapshot.swap(_queued);
+    update(snapshot);
+  }
+}
+
+QImage LevelThumbnails::thumbnail(const std::string& level_name) const
+{
+  const auto it = _shown.find(level_name);
+  return it == _shown.end() ? QImage() : it->second;
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__LEVEL_THUMBNAILS_HPP
+#define TRAFFIC_EDITOR__LEVEL_THUMBNAILS_HPP
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <QFutureWatcher>
+#include <QImage>
+#include <QObject>
+
+#include "building_snapshot.hpp"
+
+//=============================================================================
+/// Small pictures of the levels, for the level table: their floorplans,
+/// walls and lanes as Minimap::render() draws them, rendered from building
+/// snapshots on the background pool. They are cached by the content hash
+/// of the level (see Level::content_hashes()), so only the levels which
+/// were edited are rendered again, and switching back to a building, or
+/// undoing an edit, finds them ready.
+class LevelThumbnails : public QObject
+{
+  Q_OBJECT
+
+public:
+  explicit LevelThumbnails(QObject* parent = nullptr, const int size = 40);
+
+  /// Render the levels of the snapshot which aren't cached yet. What was
+  /// already rendered for its levels is shown right away. If rendering is
+  /// already running, the latest snapshot given is rendered after it.
+  void update(const std::shared_ptr<const BuildingSnapshot>& snapshot);
+
+  /// The thumbnail of the level of this name, as of the latest snapshot
+  /// it was rendered for, or a null image if it hasn't been yet
+  QImage thumbnail(const std::string& level_name) const;
+
+  int size() const { return _size; }
+
+signals:
+  /// Some thumbnails changed
+  void updated();
+
+private:
+  using Key = std::pair<std::uint64_t, bool>;  // content hash, y flipped
+
+  struct Job
+  {
+    std::string level_name;
+    Key key;
+    QImage image;
+  };
+
+  int _size;
+  std::map<Key, QImage> _cache;
+  std::deque<Key> _cache_order;  // oldest first, for the eviction
+  std::map<std::string, Key> _wanted;  // of the levels of the latest update
+  std::map<std::string, QImage> _shown;
+
+  std::shared_ptr<const BuildingSnapshot> _queued;
+  QFutureWatcher<std::vector<Job>>* _watcher = nullptr;
+
+  void finished();
+};
+
+#endif
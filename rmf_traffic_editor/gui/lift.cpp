@@ -18,9 +18,11 @@
 #include <algorithm>
 #include <cmath>
 
+#include <QGraphicsItemGroup>
 #include <QGraphicsScene>
 #include <QGraphicsSimpleTextItem>
 
+#include "label_cache.hpp"
 #include "lift.h"
 using std::string;
 
@@ -134,13 +136,13 @@ YAML::Node Lift::to_yaml() const
   return n;
 }
 
-/// The level_name parameter is required in order to know how to draw the
+/// The level_idx parameter is required in order to know how to draw the
 /// doors, since many lifts have more than one set of doors, which open on
-/// some but not all floors. It's not being used (yet).
-void Lift::draw(
+/// some but not all floors.
+QGraphicsItemGroup* Lift::draw(
   QGraphicsScene* scene,
   const double meters_per_pixel,
-  const string& level_name,
+  const int level_idx,
   const double elevation,
   const bool apply_transformation,
   const double scale,
@@ -148,7 +150,7 @@ void Lift::draw(
   const double translate_y) const
 {
   if (elevation > highest_elevation || elevation < lowest_elevation)
-    return;
+    return nullptr;
   const double cabin_w = width / meters_per_pixel;
   const double cabin_d = depth / meters_per_pixel;
   QPen cabin_pen(Qt::black);
@@ -160,8 +162,8 @@ void Lift::draw(
     cabin_w,
     cabin_d);
   cabin_rect->setPen(cabin_pen);
-  auto it = level_doors.find(level_name);
-  if (it == level_doors.end())
+  const bool has_doors = has_doors_on_level(level_idx);
+  if (!has_doors)
     cabin_rect->setBrush(QBrush(QColor::fromRgbF(1.0, 0.3, 0.3, 0.3)));
   else
     cabin_rect->setBrush(QBrush(QColor::fromRgbF(0.5, 1.0, 0.5, 0.5)));
@@ -172,10 +174,9 @@ void Lift::draw(
 
   if (!name.empty())
   {
-    QFont font("Helvetica");
-    font.setPointSize(0.2 / meters_per_pixel);
     QGraphicsSimpleTextItem* text_item = scene->addSimpleText(
-      QString::fromStdString(name), font);
+      QString::fromStdString(name),
+      LabelCache::font(0.2 / meters_per_pixel));
     text_item->setBrush(QColor(255, 0, 0, 255));
     text_item->setPos(-cabin_w / 3.0, 0.0);
 
@@ -184,13 +185,13 @@ void Lift::draw(
     items.append(text_item);
   }
 
-  if (it != level_doors.end())
+  if (has_doors)
   {
-    for (const LiftDoor& door : doors)
+    for (std::size_t door_idx = 0; door_idx < doors.size(); door_idx++)
     {
-      if (find(it->second.begin(), it->second.end(), door.name)
-        == it->second.end())
+      if (!door_opens(door_idx, level_idx))
         continue;
+      const LiftDoor& door = doors[door_idx];
       const double door_x = door.x / meters_per_pixel;
       const double door_y = -door.y / meters_per_pixel;
       const double door_w = door.width / meters_per_pixel;
@@ -219,28 +220,78 @@ void Lift::draw(
     group->setRotation(-180.0 / 3.1415926 * yaw);
     group->setPos(x * scale + translate_x, y * scale + translate_y);
   }
+  return group;
 }
 
 bool Lift::level_door_opens(
   const std::string& level_name,
   const std::string& door_name,
-  const std::vector<Level>& levels) const
+  const double level_elevation) const
 {
   LevelDoorMap::const_iterator level_it = level_doors.find(level_name);
   if (level_it == level_doors.end())
     return false;
-  for (const auto& level : levels)
-  {
-    if (level.name == level_name)
-    {
-      if (level.elevation < lowest_elevation ||
-        level.elevation > highest_elevation)
-        return false;
-      break;
-    }
-  }
+  if (level_elevation < lowest_elevation ||
+    level_elevation > highest_elevation)
+    return false;
   const DoorNameList& names = level_it->second;
   if (std::find(names.begin(), names.end(), door_name) == names.end())
     return false;
   return true;
 }
+
+void Lift::compile(const std::vector<Level>& levels)
+{
+  const std::size_t num_levels = levels.size();
+  _reaches_level.assign(num_levels, false);
+  _has_doors_on_level.assign(num_levels, false);
+  _door_opens.assign(doors.size(), std::vector<bool>(num_levels, false));
+
+  std::map<std::string, std::size_t> door_idxs;
+  for (std::size_t i = 0; i < doors.size(); i++)
+    door_idxs.emplace(doors[i].name, i);
+
+  for (std::size_t level_idx = 0; level_idx < num_levels; level_idx++)
+  {
+    const Level& level = levels[level_idx];
+    const bool reaches =
+      level.elevation >= lowest_elevation &&
+      level.elevation <= highest_elevation;
+    _reaches_level[level_idx] = reaches;
+
+    LevelDoorMap::const_iterator level_it = level_doors.find(level.name);
+    if (level_it == level_doors.end())
+      continue;
+    _has_doors_on_level[level_idx] = true;
+    if (!reaches)
+      continue;
+    for (const std::string& door_name : level_it->second)
+    {
+      const auto door_it = door_idxs.find(door_name);
+      if (door_it != door_idxs.end())
+        _door_opens[door_it->second][level_idx] = true;
+    }
+  }
+}
+
+bool Lift::reaches_level(const int level_idx) const
+{
+  return level_idx >= 0 &&
+    level_idx < static_cast<int>(_reaches_level.size()) &&
+    _reaches_level[level_idx];
+}
+
+bool Lift::has_doors_on_level(const int level_idx) const
+{
+  return level_idx >= 0 &&
+    level_idx < static_cast<int>(_has_doors_on_level.size()) &&
+    _has_doors_on_level[level_idx];
+}
+
+bool Lift::door_opens(const std::size_t door_idx, const int level_idx) const
+{
+  return door_idx < _door_opens.size() &&
+    level_idx >= 0 &&
+    level_idx < static_cast<int>(_door_opens[door_idx].size()) &&
+    _door_opens[door_idx][level_idx];
+}
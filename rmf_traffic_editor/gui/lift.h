@@ -18,6 +18,7 @@
 #ifndef LIFT_H
 #define LIFT_H
 
+class QGraphicsItemGroup;
 class QGraphicsScene;
 class QGraphicsView;
 
@@ -39,6 +40,7 @@ class Lift
 public:
   std::string name;
   std::string reference_floor_name;
+  int reference_floor_idx = -1;  // see Building::find_level_idx()
   std::string initial_floor_name;
 
   // (x, y, yaw) of the cabin center, relative to reference_floor_name origin
@@ -84,20 +86,41 @@ public:
   void from_yaml(const std::string& _name, const YAML::Node& data,
     const std::vector<Level>& levels);
 
-  void draw(
+  /// Returns the group of items of the lift on this level, or nullptr if
+  /// the lift doesn't reach this elevation. The doors which open on the
+  /// level are looked up in the tables from compile(); with level_idx -1,
+  /// only the cabin is drawn.
+  QGraphicsItemGroup* draw(
     QGraphicsScene* scene,
     const double meters_per_pixel,
-    const std::string& level_name,
+    const int level_idx,
     const double elevation,
     const bool apply_transformation = true,
     const double scale = 1.0,
     const double translate_x = 0.0,
     const double translate_y = 0.0) const;
 
+  /// Whether the door opens on the level of this name and elevation. This
+  /// reads level_doors directly, for the lift dialog which is editing it.
   bool level_door_opens(
     const std::string& level_name,
     const std::string& door_name,
-    const std::vector<Level>& levels) const;
+    const double level_elevation) const;
+
+  /// Resolve level_doors and the elevation range against the levels of the
+  /// building, into dense tables by level index, so that drawing and
+  /// checking the lift need no name lookups. Building::compile_lifts()
+  /// calls this whenever the lifts or levels have changed.
+  void compile(const std::vector<Level>& levels);
+
+  bool reaches_level(const int level_idx) const;
+  bool has_doors_on_level(const int level_idx) const;
+  bool door_opens(const std::size_t door_idx, const int level_idx) const;
+
+private:
+  std::vector<bool> _reaches_level;
+  std::vector<bool> _has_doors_on_level;
+  std::vector<std::vector<bool>> _door_opens;  // by door, then level
 };
 
 #endif
@@ -16,6 +16,7 @@
 */
 
 #include "lift_dialog.h"
+#include "logging.hpp"
 #include <cfloat>
 #include <QtWidgets>
 using std::vector;
@@ -27,6 +28,12 @@ LiftDialog::LiftDialog(Lift& lift, Building& building)
   _building(building)
 {
   setWindowTitle("Lift Properties");
+  _redraw_timer = new QTimer(this);
+  _redraw_timer->setSingleShot(true);
+  _redraw_timer->setInterval(150);
+  connect(
+    _redraw_timer, &QTimer::timeout,
+    this, &LiftDialog::flush_redraw);
   for (const auto& level : building.levels)
     _level_names.push_back(QString::fromStdString(level.name));
 
@@ -55,8 +62,8 @@ LiftDialog::LiftDialog(Lift& lift, Building& building)
     [this](const QString& text)
     {
       _lift.name = text.toStdString();
-      update_lift_view();
-      emit redraw();
+      schedule_preview();
+      schedule_redraw();
     });
   name_hbox->addWidget(_name_line_edit);
 
@@ -73,7 +80,7 @@ LiftDialog::LiftDialog(Lift& lift, Building& building)
     [this](const QString& text)
     {
       _lift.reference_floor_name = text.toStdString();
-      emit redraw();
+      schedule_redraw();
     });
   ref_name_hbox->addWidget(_reference_floor_combo_box);
 
@@ -90,7 +97,7 @@ LiftDialog::LiftDialog(Lift& lift, Building& building)
     [this](const QString& text)
     {
       _lift.initial_floor_name = text.toStdString();
-      emit redraw();
+      schedule_redraw();
     });
   init_floor_hbox->addWidget(_initial_floor_combo_box);
 
@@ -122,7 +129,7 @@ LiftDialog::LiftDialog(Lift& lift, Building& building)
         }
       }
       update_level_table();
-      emit redraw();
+      schedule_redraw();
     });
   highest_name_hbox->addWidget(_highest_floor_combo_box);
 
@@ -154,7 +161,7 @@ LiftDialog::LiftDialog(Lift& lift, Building& building)
         }
       }
       update_level_table();
-      emit redraw();
+      schedule_redraw();
     });
   lowest_name_hbox->addWidget(_lowest_floor_combo_box);
 
@@ -196,8 +203,8 @@ LiftDialog::LiftDialog(Lift& lift, Building& building)
     [this](const QString& text)
     {
       _lift.yaw = text.toDouble();
-      update_lift_view();
-      emit redraw();
+      schedule_preview();
+      schedule_redraw();
     });
   yaw_hbox->addWidget(_yaw_line_edit);
 
@@ -211,8 +218,8 @@ LiftDialog::LiftDialog(Lift& lift, Building& building)
     [this](const QString& text)
     {
       _lift.width = text.toDouble();
-      update_lift_view();
-      emit redraw();
+      schedule_preview();
+      schedule_redraw();
     });
   width_hbox->addWidget(_width_line_edit);
 
@@ -226,8 +233,8 @@ LiftDialog::LiftDialog(Lift& lift, Building& building)
     [this](const QString& text)
     {
       _lift.depth = text.toDouble();
-      update_lift_view();
-      emit redraw();
+      schedule_preview();
+      schedule_redraw();
     });
   depth_hbox->addWidget(_depth_line_edit);
 
@@ -397,7 +404,7 @@ void LiftDialog::ok_button_clicked()
       if (checkbox)
       {
         const bool checked = checkbox->isChecked();
-        printf("level %s door %s: %d\n",
+        qCDebug(lc_edit, "level %s door %s: %d",
           level_name.c_str(),
           door_name.c_str(),
           checked ? 1 : 0);
@@ -406,17 +413,45 @@ void LiftDialog::ok_button_clicked()
       }
       else
       {
-        printf("level %s door %s: indeterminate state!\n",
+        qCWarning(lc_edit, "level %s door %s: indeterminate state",
           level_name.c_str(),
           door_name.c_str());
       }
     }
   }
-  update_lift_view();
-  emit redraw();
+  schedule_preview();
+  schedule_redraw();
+  flush_redraw();
   accept();
 }
 
+void LiftDialog::schedule_preview()
+{
+  _preview_pending = true;
+  _redraw_timer->start();
+}
+
+void LiftDialog::schedule_redraw()
+{
+  _redraw_pending = true;
+  _redraw_timer->start();
+}
+
+void LiftDialog::flush_redraw()
+{
+  _redraw_timer->stop();
+  if (_preview_pending)
+  {
+    _preview_pending = false;
+    update_lift_view();
+  }
+  if (_redraw_pending)
+  {
+    _redraw_pending = false;
+    emit redraw();
+  }
+}
+
 void LiftDialog::update_lift_wps()
 {
   const QPointF from_point = QPointF(_lift.x, _lift.y);
@@ -437,15 +472,20 @@ void LiftDialog::update_lift_wps()
         to_point);
       found = false;
 
-      for (auto& v : _building.levels[level_idx].vertices)
+      // the capability bits are cached, so this is no param lookup
+      Level& level = _building.levels[level_idx];
+      for (std::size_t i = 0; i < level.vertices.size(); i++)
       {
-        auto it = v.params.find("lift_cabin");
-        if ((it != v.params.end()) && (it->second.value_string == _lift.name))
-        {
-          v.x = to_point.x();
-          v.y = to_point.y();
-          found = true;
-        }
+        Vertex& v = level.vertices[i];
+        if (!(v.capabilities() & Vertex::LIFT_CABIN) ||
+          v.lift_cabin() != _lift.name)
+          continue;
+        found = true;
+        if (v.x == to_point.x() && v.y == to_point.y())
+          continue;
+        v.x = to_point.x();
+        v.y = to_point.y();
+        level.mark_changed(Level::VERTEX, i);
       }
       if (!found)
       {
@@ -455,7 +495,7 @@ void LiftDialog::update_lift_wps()
       }
     }
   }
-  emit redraw();
+  schedule_redraw();
 }
 
 void LiftDialog::update_door_table()
@@ -504,7 +544,7 @@ void LiftDialog::update_door_table()
       door.door_type = LiftDoor::DOUBLE_SLIDING;
       _lift.doors.push_back(door);
       update_door_table();
-      update_lift_view();
+      schedule_preview();
     });
 }
 
@@ -543,7 +583,7 @@ void LiftDialog::update_level_table()
       if (_lift.level_door_opens(
           level_name.toStdString(),
           _lift.doors[door_idx].name,
-          _building.levels))
+          _building.levels[level_idx].elevation))
         checkbox->setChecked(true);
       _level_table->setCellWidget(level_idx, door_idx + 1, checkbox);
     }
@@ -556,7 +596,7 @@ void LiftDialog::door_table_cell_changed(int row, int col)
   // printf("door_table_cell_changed(%d, %d)\n", row, col);
   if (row >= static_cast<int>(_lift.doors.size()))
   {
-    printf("invalid door row: %d\n", row);
+    qCWarning(lc_edit, "invalid door row: %d", row);
     return;  // let's not crash
   }
 
@@ -581,12 +621,12 @@ void LiftDialog::door_table_cell_changed(int row, int col)
   else if (col == 5) // width
     _lift.doors[row].width = _door_table->item(row, col)->text().toDouble();
 
-  update_lift_view();
-  emit redraw();
+  schedule_preview();
+  schedule_redraw();
 }
 
 void LiftDialog::update_lift_view()
 {
   _lift_scene->clear();
-  _lift.draw(_lift_scene, 0.01, std::string(), _lift.lowest_elevation, false);
+  _lift.draw(_lift_scene, 0.01, -1, _lift.lowest_elevation, false);
 }
@@ -31,6 +31,7 @@ class QLineEdit;
 class QLabel;
 class QTableWidget;
 class QComboBox;
+class QTimer;
 
 
 class LiftDialog : public QDialog
@@ -69,6 +70,15 @@ private:
   QPushButton* _ok_button, * _cancel_button;
   QPushButton* _add_wp_button;
 
+  /// Typing in a field or ticking a box changes the lift at every step, so
+  /// the preview and the main scene are redrawn once it settles down
+  QTimer* _redraw_timer;
+  bool _preview_pending = false;
+  bool _redraw_pending = false;
+  void schedule_preview();
+  void schedule_redraw();
+  void flush_redraw();
+
   void update_door_table();
   void set_door_cell(const int row, const int col, const QString& text);
   void door_table_cell_changed(int row, int col);
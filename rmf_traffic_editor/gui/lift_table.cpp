@@ -36,60 +36,60 @@ void LiftTable::update(Building& building)
   setRowCount(1 + building.lifts.size());
   for (std::size_t i = 0; i < building.lifts.size(); i++)
   {
-    setItem(
-      i,
-      0,
-      new QTableWidgetItem(
-        QString::fromStdString(building.lifts[i].name)));
+    set_cell_text(i, 0, QString::fromStdString(building.lifts[i].name));
 
-    QPushButton* edit_button = new QPushButton("Edit...", this);
-    setCellWidget(i, 1, edit_button);
+    bool created = false;
+    QPushButton* edit_button = cell_button(i, 1, "Edit...", created);
+    if (!created)
+      continue;
 
     connect(
       edit_button,
       &QAbstractButton::clicked,
-      [this, &building, i]()
+      [this, &building, edit_button]()
       {
+        const int row = row_of(edit_button, 1);
+        if (row < 0 || row >= static_cast<int>(building.lifts.size()))
+          return;
         /*
-        LiftDialog lift_dialog(building.lifts[i], building);
+        LiftDialog lift_dialog(building.lifts[row], building);
         lift_dialog.exec();
         update(building);
         emit redraw();
         */
-        LiftDialog* dialog = new LiftDialog(building.lifts[i], building);
+        LiftDialog* dialog = new LiftDialog(building.lifts[row], building);
         dialog->show();
         dialog->raise();
         dialog->activateWindow();
         connect(
           dialog,
           &LiftDialog::redraw,
-          [this]() { emit redraw(); });
+          [this, row]() { emit lift_changed(row); });
       });
   }
 
   // we'll use the last row for the "Add" button
   const int last_row_idx = static_cast<int>(building.lifts.size());
-  setCellWidget(last_row_idx, 0, nullptr);
-  setItem(
-    last_row_idx,
-    0,
-    new QTableWidgetItem(
-      QString::fromStdString("")));
-  QPushButton* add_button = new QPushButton("Add...", this);
-  setCellWidget(last_row_idx, 1, add_button);
-  connect(
-    add_button, &QAbstractButton::clicked,
-    [this, &building]()
-    {
-      Lift lift;
-      LiftDialog lift_dialog(lift, building);
-      if (lift_dialog.exec() == QDialog::Accepted)
+  clear_cell_widget(last_row_idx, 0);
+  set_cell_text(last_row_idx, 0, QString());
+  bool created = false;
+  QPushButton* add_button = cell_button(last_row_idx, 1, "Add...", created);
+  if (created)
+  {
+    connect(
+      add_button, &QAbstractButton::clicked,
+      [this, &building]()
       {
-        building.lifts.push_back(lift);
-        update(building);
-        emit redraw();
-      }
-    });
+        Lift lift;
+        LiftDialog lift_dialog(lift, building);
+        if (lift_dialog.exec() == QDialog::Accepted)
+        {
+          building.lifts.push_back(lift);
+          update(building);
+          emit redraw();
+        }
+      });
+  }
 
   blockSignals(false);
 }
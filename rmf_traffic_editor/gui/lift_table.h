@@ -25,11 +25,18 @@
 
 class LiftTable : public TableList
 {
+  Q_OBJECT
+
 public:
   LiftTable();
   ~LiftTable();
 
   void update(Building& building);
+
+signals:
+  /// An existing lift was edited; unlike redraw(), only its own graphics
+  /// (and cabin waypoints) need to be redrawn
+  void lift_changed(int lift_idx);
 };
 
 #endif
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include <deque>
+#include <mutex>
+
+#include <QFile>
+
+#include "logging.hpp"
+
+Q_LOGGING_CATEGORY(lc_io, "traffic_editor.io", QtInfoMsg)
+Q_LOGGING_CATEGORY(lc_draw, "traffic_editor.draw", QtInfoMsg)
+Q_LOGGING_CATEGORY(lc_edit, "traffic_editor.edit", QtInfoMsg)
+Q_LOGGING_CATEGORY(lc_transform, "traffic_editor.transform", QtInfoMsg)
+
+namespace {
+
+std::mutex log_mutex;
+std::deque<QString> ring;
+QFile* log_file = nullptr;
+bool installed = false;
+QtMessageHandler previous_handler = nullptr;
+
+const char* type_name(const QtMsgType type)
+{
+  switch (type)
+  {
+    case QtDebugMsg: return "debug";
+    case QtInfoMsg: return "info";
+    case QtWarningMsg: return "warning";
+    case QtCriticalMsg: return "critical";
+    case QtFatalMsg: return "fatal";
+    default: return "unknown";
+  }
+}
+
+void handle_message(
+  QtMsgType type,
+  const QMessageLogContext& context,
+  const QString& message)
+{
+  {
+    const QString line = QString("%1 %2: %3")
+      .arg(type_name(type))
+      .arg(context.category ? context.category : "default")
+      .arg(message);
+
+    std::lock_guard<std::mutex> lock(log_mutex);
+    ring.push_back(line);
+    if (ring.size() > static_cast<std::size_t>(Log::RING_SIZE))
+      ring.pop_front();
+    if (log_file)
+    {
+      log_file->write(line.toUtf8());
+      log_file->write("\n");
+      if (type != QtDebugMsg)
+        log_file->flush();
+    }
+  }
+
+  if (previous_handler)
+    previous_handler(type, context, message);
+}
+
+}  // namespace
+
+void Log::install()
+{
+  std::lock_guard<std::mutex> lock(log_mutex);
+  if (installed)
+    return;
+  previous_handler = qInstallMessageHandler(handle_message);
+  installed = true;
+}
+
+bool Log::set_file(const QString& path)
+{
+  std::lock_guard<std::mutex> lock(log_mutex);
+  delete log_file;
+  log_file = nullptr;
+  if (path.isEmpty())
+    return true;
+
+  log_file = new QFile(path);
+  if (!log_file->open(QIODevice::WriteOnly | QIODevice::Append))
+  {
+    delete log_file;
+    log_file = nullptr;
+    return false;
+  }
+  return true;
+}
+
+QStringList Log::recent()
+{
+  std::lock_guard<std::mutex> lock(log_mutex);
+  QStringList lines;
+  for (const QString& line : ring)
+    lines.append(line);
+  return lines;
+}
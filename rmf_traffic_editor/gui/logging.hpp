@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef TRAFFIC_EDITOR__LOGGING_HPP
+#define TRAFFIC_EDITOR__LOGGING_HPP
+
+#include <QLoggingCategory>
+#include <QString>
+#include <QStringList>
+
+// Log categories of the editor. Use them with the printf-style forms of
+// Qt's macros, e.g. qCDebug(lc_draw, "drew %d items", n). Debug messages
+// are off by default; enable them with rules such as
+// "traffic_editor.draw.debug=true", from --log-rules, the QT_LOGGING_RULES
+// environment variable or QLoggingCategory::setFilterRules(). A disabled
+// message costs a flag check: its arguments aren't even evaluated.
+Q_DECLARE_LOGGING_CATEGORY(lc_io)  // loading, saving and decoding images
+Q_DECLARE_LOGGING_CATEGORY(lc_draw)  // building the scene
+Q_DECLARE_LOGGING_CATEGORY(lc_edit)  // tools, commands and the side panels
+Q_DECLARE_LOGGING_CATEGORY(lc_transform)  // layer and level alignment
+
+//=============================================================================
+/// Routes the messages of every category into a ring buffer of the most
+/// recent ones (for View > Log) and optionally into a file, as well as to
+/// wherever they went before (normally stderr).
+class Log
+{
+public:
+  static const int RING_SIZE = 10000;
+
+  /// Install the message handler. Safe to call more than once.
+  static void install();
+
+  /// Also append every message to this file, or stop if path is empty
+  static bool set_file(const QString& path);
+
+  /// The most recent messages, oldest first
+  static QStringList recent();
+};
+
+#endif
@@ -23,7 +23,10 @@
 #include "glog/logging.h"
 
 #include "editor.h"
+#include "logging.hpp"
+#include "map_viewer.hpp"
 #include "preferences_keys.h"
+#include "trace.hpp"
 
 
 int main(int argc, char* argv[])
@@ -38,23 +41,88 @@ int main(int argc, char* argv[])
   QCommandLineParser parser;
   parser.addHelpOption();
   parser.addPositionalArgument("[building]", "Building YAML file to open");
+  const QCommandLineOption log_file_option(
+    "log-file",
+    "Append the log messages to this file",
+    "file");
+  parser.addOption(log_file_option);
+  const QCommandLineOption log_rules_option(
+    "log-rules",
+    "Logging rules separated by ';', "
+    "e.g. \"traffic_editor.draw.debug=true\"",
+    "rules");
+  parser.addOption(log_rules_option);
+  const QCommandLineOption view_option(
+    "view",
+    "Only view the building, in a window which needs a fraction of the "
+    "editor's memory and load time");
+  parser.addOption(view_option);
+#ifdef TRAFFIC_EDITOR_TRACING
+  const QCommandLineOption trace_option(
+    "trace",
+    "Record a Chrome trace from startup, saved to this file on exit",
+    "file");
+  parser.addOption(trace_option);
+#endif
   parser.process(QCoreApplication::arguments());
 
+  Log::install();
+  if (parser.isSet(log_rules_option))
+    QLoggingCategory::setFilterRules(
+      parser.value(log_rules_option).replace(";", "\n"));
+  if (parser.isSet(log_file_option) &&
+    !Log::set_file(parser.value(log_file_option)))
+    qCWarning(lc_io, "unable to open the log file %s",
+      qUtf8Printable(parser.value(log_file_option)));
+
+#ifdef TRAFFIC_EDITOR_TRACING
+  if (parser.isSet(trace_option))
+    Trace::start();
+#endif
+
+  // the viewer has none of the editor's tables, dialogs or undo history
+  if (parser.isSet(view_option))
+  {
+    MapViewer viewer;
+    viewer.show();
+    if (parser.positionalArguments().length() >= 1)
+      viewer.load(parser.positionalArguments().at(0));
+#ifdef TRAFFIC_EDITOR_TRACING
+    const int result = app.exec();
+    if (parser.isSet(trace_option) && Trace::is_recording())
+      Trace::save(parser.value(trace_option).toStdString());
+    return result;
+#else
+    return app.exec();
+#endif
+  }
+
   Editor editor;
   QSettings settings;
 
   const bool load_previous = settings.value(
     preferences_keys::open_previous_building, QVariant(true)).toBool();
 
-  if (load_previous && parser.positionalArguments().isEmpty())
-    editor.load_previous_building();
-
+  QString filename;
   if (parser.positionalArguments().length() >= 1)
-    editor.load_building(parser.positionalArguments().at(0));
+    filename = parser.positionalArguments().at(0);
+  else if (load_previous)
+    filename = Editor::previous_building_path();
 
+  // show the window right away; the building follows from a worker thread
   editor.show();
 
-  editor.restore_previous_viewport();
+  if (filename.isEmpty())
+    editor.restore_previous_viewport();
+  else
+    editor.load_building_async(filename, true);
 
+#ifdef TRAFFIC_EDITOR_TRACING
+  const int result = app.exec();
+  if (parser.isSet(trace_option) && Trace::is_recording())
+    Trace::save(parser.value(trace_option).toStdString());
+  return result;
+#else
   return app.exec();
+#endif
 }
@@ -15,8 +15,15 @@
  *
 */
 
+#include <cmath>
+
+#include "logging.hpp"
 #include "map_view.h"
+#include <QElapsedTimer>
+#include <QGraphicsScene>
+#include <QOpenGLWidget>
 #include <QScrollBar>
+#include <QSurfaceFormat>
 
 MapView::MapView(QWidget* parent)
 : QGraphicsView(parent),
@@ -29,6 +36,33 @@ MapView::MapView(QWidget* parent)
   setTransformationAnchor(QGraphicsView::NoAnchor);
 }
 
+void MapView::set_opengl_viewport(const bool enabled)
+{
+  if (enabled == is_opengl)
+    return;
+  is_opengl = enabled;
+
+  // setViewport() takes ownership and deletes the previous viewport
+  if (enabled)
+  {
+    QOpenGLWidget* gl_widget = new QOpenGLWidget;
+    QSurfaceFormat format = QSurfaceFormat::defaultFormat();
+    format.setSamples(4);  // antialias the lanes and walls
+    gl_widget->setFormat(format);
+    setViewport(gl_widget);
+    // partial updates don't pay off when the whole frame is re-rendered
+    setViewportUpdateMode(QGraphicsView::FullViewportUpdate);
+  }
+  else
+  {
+    setViewport(new QWidget);
+    setViewportUpdateMode(QGraphicsView::MinimalViewportUpdate);
+  }
+  viewport()->setMouseTracking(true);
+  qCInfo(lc_draw,
+    "map view is using %s rendering", enabled ? "OpenGL" : "raster");
+}
+
 void MapView::wheelEvent(QWheelEvent* e)
 {
   // calculate the map position before we scale things
@@ -54,6 +88,71 @@ void MapView::wheelEvent(QWheelEvent* e)
   // translate the map back so hopefully the mouse stays in the same spot
   const QPointF diff = p_end - p_start;
   translate(diff.x(), diff.y());
+
+  update_level_of_detail();
+}
+
+void MapView::scrollContentsBy(int dx, int dy)
+{
+  QGraphicsView::scrollContentsBy(dx, dy);
+  emit viewport_changed();
+}
+
+void MapView::resizeEvent(QResizeEvent* e)
+{
+  QGraphicsView::resizeEvent(e);
+  emit viewport_changed();
+}
+
+void MapView::paintEvent(QPaintEvent* e)
+{
+  QElapsedTimer timer;
+  timer.start();
+  QGraphicsView::paintEvent(e);
+  paint_nsec = timer.nsecsElapsed();
+  if (tick_profiler)
+    tick_profiler->record(TickProfiler::PAINT, paint_nsec);
+}
+
+void MapView::set_overlay_text(const QString& text)
+{
+  if (text.isEmpty())
+  {
+    if (overlay_label)
+      overlay_label->hide();
+    return;
+  }
+
+  if (!overlay_label)
+  {
+    // a child of the view rather than something painted in the scene, so
+    // it stays put while scrolling. It's opaque, so updating it doesn't
+    // require a repaint of the viewport underneath
+    overlay_label = new QLabel(this);
+    overlay_label->setAttribute(Qt::WA_TransparentForMouseEvents);
+    overlay_label->setAutoFillBackground(true);
+    overlay_label->setFont(QFont("Monospace", 8));
+    overlay_label->setMargin(4);
+    overlay_label->move(8, 8);
+  }
+  overlay_label->setText(text);
+  overlay_label->adjustSize();
+  overlay_label->show();
+}
+
+QRectF MapView::visible_scene_rect() const
+{
+  return mapToScene(viewport()->rect()).boundingRect();
+}
+
+void MapView::update_level_of_detail()
+{
+  const LevelOfDetail::Tier tier =
+    LevelOfDetail::tier_for_scale(std::abs(transform().m11()));
+  if (tier == lod_tier)
+    return;
+  lod_tier = tier;
+  emit level_of_detail_changed(tier);
 }
 
 void MapView::mousePressEvent(QMouseEvent* e)
@@ -99,16 +198,21 @@ void MapView::mouseMoveEvent(QMouseEvent* e)
 
 void MapView::zoom_fit(const Building& building, int level_index)
 {
-  if (building.levels.empty())
+  if (level_index < 0 ||
+    level_index >= static_cast<int>(building.levels.size()))
     return;
   const Level& level = building.levels[level_index];
-  const int w = level.drawing_width;
-  const int h = level.drawing_height;
-  const double cx = w / 2;
-  const double cy = h / 2;
-  // todo: this doesn't seem to work. not sure how to use this function.
-  ensureVisible(cx, cy, w, h);
-  //resetTransform();
-  //fitInView(cx, cy, w, h, Qt::KeepAspectRatio);
-  //centerOn(cx, cy);
+
+  // the drawing, if there is one, otherwise all there is to scroll to
+  QRectF rect(0, 0, level.drawing_width, level.drawing_height);
+  if (level.drawing_filename.empty() || rect.isEmpty())
+  {
+    if (!scene())
+      return;
+    rect = scene()->sceneRect();
+  }
+
+  // fitInView() keeps the sign of the scale, so the y axis stays flipped
+  fitInView(rect, Qt::KeepAspectRatio);
+  update_level_of_detail();
 }
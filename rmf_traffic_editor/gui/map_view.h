@@ -19,9 +19,12 @@
 #define MAP_VIEW_H
 
 #include <QGraphicsView>
+#include <QLabel>
 #include <QWheelEvent>
 
 #include "building.h"
+#include "level_of_detail.hpp"
+#include "tick_profiler.hpp"
 
 
 class MapView : public QGraphicsView
@@ -30,16 +33,56 @@ class MapView : public QGraphicsView
 
 public:
   MapView(QWidget* parent = nullptr);
+
+  /// Zoom and scroll so that the whole level is in view
   void zoom_fit(const Building& building, int level_index);
 
+  /// Switch between the default raster viewport and an OpenGL one. With
+  /// OpenGL, pixmaps are uploaded as textures the first time they are
+  /// painted and reused as long as the same (shared) QPixmap is drawn.
+  void set_opengl_viewport(const bool enabled);
+  bool is_opengl_viewport() const { return is_opengl; }
+
+  /// Re-evaluate the detail tier after the view transform has changed,
+  /// emitting level_of_detail_changed() if it is different.
+  void update_level_of_detail();
+
+  LevelOfDetail::Tier level_of_detail() const { return lod_tier; }
+
+  /// The visible part of the scene, in scene coordinates
+  QRectF visible_scene_rect() const;
+
+  /// Show this text in a box in the corner of the view; empty hides it
+  void set_overlay_text(const QString& text);
+
+  /// How long the last paint of the viewport took
+  qint64 last_paint_nsec() const { return paint_nsec; }
+
+  /// Also record the time of every paint here, if it isn't nullptr
+  void set_tick_profiler(TickProfiler* profiler) { tick_profiler = profiler; }
+
+signals:
+  void level_of_detail_changed(LevelOfDetail::Tier tier);
+
+  /// Emitted after scrolling, zooming or resizing
+  void viewport_changed();
+
 protected:
   void wheelEvent(QWheelEvent* event);
   void mouseMoveEvent(QMouseEvent* e);
   void mousePressEvent(QMouseEvent* e);
   void mouseReleaseEvent(QMouseEvent* e);
+  void scrollContentsBy(int dx, int dy);
+  void resizeEvent(QResizeEvent* e);
+  void paintEvent(QPaintEvent* e);
 
   bool is_panning;
   int pan_start_x, pan_start_y;
+  bool is_opengl = false;
+  LevelOfDetail::Tier lod_tier = LevelOfDetail::FINE;
+  QLabel* overlay_label = nullptr;
+  qint64 paint_nsec = 0;
+  TickProfiler* tick_profiler = nullptr;
 };
 
 #endif
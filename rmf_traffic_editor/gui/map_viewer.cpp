@@ -0,0 +1,352 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include <cmath>
+#include <map>
+#include <utility>
+
+#include <QtWidgets>
+
+#include "label_cache.hpp"
+#include "level.h"
+#include "logging.hpp"
+#include "map_view.h"
+#include "map_viewer.hpp"
+#include "vertex_layer_item.hpp"
+
+namespace {
+
+/// Paths drawn with one pen, split into square cells of the level, so that
+/// the view only strokes the cells which are exposed
+class PathBuckets
+{
+public:
+  explicit PathBuckets(const double cell_size)
+  : _cell_size(cell_size)
+  {
+  }
+
+  QPainterPath& path(const QPointF& p)
+  {
+    return _paths[std::make_pair(
+          static_cast<int>(std::floor(p.x() / _cell_size)),
+          static_cast<int>(std::floor(p.y() / _cell_size)))];
+  }
+
+  void add_line(const QPointF& a, const QPointF& b)
+  {
+    QPainterPath& p = path((a + b) / 2.0);
+    p.moveTo(a);
+    p.lineTo(b);
+  }
+
+  void add_to(
+    QGraphicsScene* scene,
+    const QPen& pen,
+    const QBrush& brush,
+    const double z) const
+  {
+    for (const auto& it : _paths)
+      scene->addPath(it.second, pen, brush)->setZValue(z);
+  }
+
+private:
+  double _cell_size;
+  std::map<std::pair<int, int>, QPainterPath> _paths;
+};
+
+/// The colors of Level::draw_lane()
+QColor lane_color(const int graph_idx)
+{
+  QColor color;
+  switch (graph_idx)
+  {
+    case 0: color.setRgbF(0.0, 0.5, 0.0); break;
+    case 1: color.setRgbF(0.0, 0.0, 0.5); break;
+    case 2: color.setRgbF(0.0, 0.5, 0.5); break;
+    case 3: color.setRgbF(0.5, 0.5, 0.0); break;
+    case 4: color.setRgbF(0.5, 0.0, 0.5); break;
+    case 5: color.setRgbF(0.8, 0.0, 0.0); break;
+    case 9: color.setRgbF(0.3, 0.3, 0.3); break;
+    default: break;
+  }
+  color.setAlphaF(0.5);
+  return color;
+}
+
+}  // namespace
+
+MapViewer::MapViewer(QWidget* parent)
+: QMainWindow(parent)
+{
+  setWindowTitle("traffic-editor viewer");
+
+  _scene = new QGraphicsScene(this);
+  _map_view = new MapView(this);
+  _map_view->setScene(_scene);
+  setCentralWidget(_map_view);
+
+  QToolBar* toolbar = addToolBar("View");
+  toolbar->setObjectName("viewer_toolbar");
+  toolbar->addWidget(new QLabel("Level: "));
+  _level_box = new QComboBox;
+  toolbar->addWidget(_level_box);
+  connect(
+    _level_box,
+    QOverload<int>::of(&QComboBox::currentIndexChanged),
+    [this](int index)
+    {
+      draw_level(index);
+      zoom_fit();
+    });
+  connect(
+    toolbar->addAction("Zoom to &fit"),
+    &QAction::triggered,
+    [this]() { zoom_fit(); });
+
+  QMenu* file_menu = menuBar()->addMenu("&File");
+  file_menu->addAction(
+    "&Open...",
+    this,
+    [this]()
+    {
+      const QString filename = QFileDialog::getOpenFileName(
+        this,
+        "Open building",
+        _dir.path(),
+        "Building files (*.building.yaml *.building.yaml.gz "
+        "*.building.yaml.zst)");
+      if (!filename.isEmpty())
+        load(filename);
+    },
+    QKeySequence(Qt::CTRL + Qt::Key_O));
+  file_menu->addAction(
+    "&Quit",
+    this,
+    &QWidget::close,
+    QKeySequence(Qt::CTRL + Qt::Key_Q));
+
+  resize(1200, 800);
+}
+
+bool MapViewer::load(const QString& filename)
+{
+  QElapsedTimer timer;
+  timer.start();
+  if (!_building.load(filename.toStdString()))
+  {
+    QMessageBox::critical(
+      this,
+      "Couldn't open the building",
+      "Couldn't read " + filename + ". The log has the details.");
+    return false;
+  }
+  _dir = QDir(QFileInfo(filename).absolutePath());
+  setWindowTitle(
+    QString("%1 - traffic-editor viewer")
+    .arg(QFileInfo(filename).fileName()));
+
+  const QSignalBlocker blocker(_level_box);
+  _level_box->clear();
+  std::size_t num_vertices = 0;
+  std::size_t num_edges = 0;
+  for (const CompactBuilding::Level& level : _building.levels)
+  {
+    _level_box->addItem(QString::fromStdString(level.name));
+    num_vertices += level.vertices.size();
+    num_edges += level.edges.size();
+  }
+  statusBar()->showMessage(
+    QString("%1 levels, %2 vertices and %3 edges in %4 MB, read in %5 ms")
+    .arg(_building.levels.size())
+    .arg(num_vertices)
+    .arg(num_edges)
+    .arg(_building.memory_usage() / 1e6, 0, 'f', 1)
+    .arg(timer.elapsed()));
+
+  QTransform t;
+  t.scale(1.0, _building.y_flipped ? 1.0 : -1.0);
+  _map_view->setTransform(t);
+  draw_level(0);
+  zoom_fit();
+  return true;
+}
+
+void MapViewer::draw_level(const int level_idx)
+{
+  _scene->clear();
+  if (level_idx < 0 ||
+    level_idx >= static_cast<int>(_building.levels.size()))
+    return;
+  const CompactBuilding::Level& level = _building.levels[level_idx];
+  const double mpp = level.meters_per_pixel;
+  QRectF rect = level.bounds;
+
+  if (!level.drawing_filename.empty())
+  {
+    const QString path =
+      _dir.filePath(QString::fromStdString(level.drawing_filename));
+    const QPixmap pixmap(path);
+    if (pixmap.isNull())
+      qCWarning(lc_io, "couldn't load the drawing %s", qUtf8Printable(path));
+    else
+      rect |= _scene->addPixmap(pixmap)->boundingRect();
+  }
+
+  auto point = [&level](const uint32_t idx)
+    {
+      const CompactBuilding::Point& p = level.vertices[idx];
+      return QPointF(p.x, p.y);
+    };
+  const double cell_size = 50.0 / mpp;
+
+  PathBuckets floors(cell_size);
+  PathBuckets holes(cell_size);
+  for (std::size_t i = 0; i < level.num_polygons(); i++)
+  {
+    QPolygonF polygon;
+    for (uint32_t j = level.polygon_starts[i];
+      j < level.polygon_starts[i + 1]; j++)
+      polygon.append(point(level.polygon_vertices[j]));
+    QPainterPath& path =
+      (i < level.num_floors ? floors : holes).path(polygon.first());
+    path.addPolygon(polygon);
+    path.closeSubpath();
+  }
+  floors.add_to(
+    _scene,
+    QPen(Qt::black),
+    QBrush(QColor::fromRgbF(0.9, 0.9, 0.9, 0.8)),
+    -0.5);
+  holes.add_to(
+    _scene,
+    QPen(Qt::black),
+    QBrush(QColor::fromRgbF(0.3, 0.3, 0.3, 0.5)),
+    -0.5);
+
+  // lanes by graph and width, and the rest by kind
+  std::map<std::pair<int, double>, PathBuckets> lanes;
+  std::vector<PathBuckets> others(
+    CompactBuilding::NUM_EDGE_KINDS,
+    PathBuckets(cell_size));
+  for (const CompactBuilding::Edge& edge : level.edges)
+  {
+    const QPointF a = point(edge.start);
+    const QPointF b = point(edge.end);
+    if (edge.kind != CompactBuilding::LANE &&
+      edge.kind != CompactBuilding::HUMAN_LANE)
+    {
+      others[edge.kind].add_line(a, b);
+      continue;
+    }
+
+    // as in SceneGeometry::lane_pen_width()
+    double width = 1.0;
+    const auto default_width =
+      _building.default_lane_widths.find(edge.graph_idx);
+    if (edge.width > 0.0f)
+      width = edge.width;
+    else if (default_width != _building.default_lane_widths.end() &&
+      default_width->second > 0.0)
+      width = default_width->second;
+    lanes.emplace(
+      std::make_pair(edge.graph_idx, width),
+      PathBuckets(cell_size)).first->second.add_line(a, b);
+  }
+  for (const auto& it : lanes)
+  {
+    it.second.add_to(
+      _scene,
+      QPen(
+        QBrush(lane_color(it.first.first)),
+        it.first.second / mpp,
+        Qt::SolidLine,
+        Qt::RoundCap),
+      QBrush(),
+      0.0);
+  }
+  others[CompactBuilding::WALL].add_to(
+    _scene,
+    QPen(
+      QBrush(QColor::fromRgbF(0.0, 0.0, 0.5, 0.5)),
+      0.2 / mpp,
+      Qt::SolidLine,
+      Qt::RoundCap),
+    QBrush(),
+    1.0);
+  others[CompactBuilding::MEASUREMENT].add_to(
+    _scene,
+    QPen(
+      QBrush(QColor::fromRgbF(0.5, 0.0, 0.5, 0.5)),
+      0.5 / mpp,
+      Qt::SolidLine,
+      Qt::RoundCap),
+    QBrush(),
+    1.0);
+  others[CompactBuilding::DOOR].add_to(
+    _scene,
+    QPen(QBrush(QColor::fromRgbF(1.0, 0.0, 0.0, 0.5)), 0.2 / mpp),
+    QBrush(),
+    1.0);
+
+  // the models only as where they are; their thumbnails are left out,
+  // as the model catalog is never loaded
+  PathBuckets models(cell_size);
+  const double model_radius = 0.3 / mpp;
+  for (const CompactBuilding::Model& model : level.models)
+  {
+    const QPointF p(model.position.x, model.position.y);
+    models.path(p).addEllipse(p, model_radius, model_radius);
+  }
+  models.add_to(
+    _scene,
+    QPen(Qt::NoPen),
+    QBrush(QColor::fromRgbF(0.0, 0.5, 1.0, 0.6)),
+    10.0);
+
+  const double radius = Level::vertex_radius / mpp;
+  VertexLayerItem* vertices = new VertexLayerItem(
+    radius,
+    LabelCache::font(std::max(1.0, radius * 1.5)),
+    _building.y_flipped);
+  vertices->set_vertices(level);
+  _scene->addItem(vertices);
+
+  _scene->setSceneRect(rect.adjusted(-cell_size, -cell_size,
+    cell_size, cell_size));
+}
+
+void MapViewer::zoom_fit()
+{
+  const int level_idx = _level_box->currentIndex();
+  if (level_idx < 0 ||
+    level_idx >= static_cast<int>(_building.levels.size()))
+    return;
+  QRectF rect = _building.levels[level_idx].bounds;
+  for (QGraphicsItem* item : _scene->items())
+  {
+    if (item->type() == QGraphicsPixmapItem::Type)
+      rect |= item->sceneBoundingRect();
+  }
+  if (rect.isEmpty())
+    rect = _scene->sceneRect();
+
+  // fitInView() keeps the sign of the scale, so the y axis stays flipped
+  _map_view->fitInView(rect, Qt::KeepAspectRatio);
+  _map_view->update_level_of_detail();
+}
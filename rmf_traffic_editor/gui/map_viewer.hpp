@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef TRAFFIC_EDITOR__MAP_VIEWER_HPP
+#define TRAFFIC_EDITOR__MAP_VIEWER_HPP
+
+#include <QDir>
+#include <QMainWindow>
+
+#include "compact_building.hpp"
+
+class MapView;
+class QComboBox;
+class QGraphicsScene;
+
+//=============================================================================
+/// The window of `traffic-editor --view`: shows the levels of a building
+/// without any way to edit them, for people who only look at maps. It
+/// keeps the building as a CompactBuilding and draws a level with a few
+/// batched items (one VertexLayerItem and one path per kind of edge and
+/// area of the map), so none of the editor's tables, dialogs, undo stack
+/// or per-entity scene items are created.
+class MapViewer : public QMainWindow
+{
+public:
+  MapViewer(QWidget* parent = nullptr);
+
+  /// Returns false, with a message box shown, if it can't be read
+  bool load(const QString& filename);
+
+private:
+  CompactBuilding _building;
+  QDir _dir;  // of the building file, which the drawings are relative to
+
+  QGraphicsScene* _scene = nullptr;
+  MapView* _map_view = nullptr;
+  QComboBox* _level_box = nullptr;
+
+  void draw_level(const int level_idx);
+  void zoom_fit();
+};
+
+#endif
@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include <QImage>
+#include <QJsonArray>
+#include <QPixmap>
+
+#include "building.h"
+#include "editor_model.h"
+#include "heap.hpp"
+#include "memory_report.hpp"
+
+namespace {
+
+QString format_bytes(const std::size_t bytes)
+{
+  if (bytes >= 1024 * 1024)
+    return QString::asprintf("%.1f MiB", bytes / (1024.0 * 1024.0));
+  return QString::asprintf("%.1f KiB", bytes / 1024.0);
+}
+
+}  // namespace
+
+const char* MemoryReport::category_name(const Category category)
+{
+  switch (category)
+  {
+    case FLOORPLAN: return "floorplan";
+    case LAYER_IMAGES: return "layer_images";
+    case COLORIZED_IMAGES: return "colorized_images";
+    case VERTICES: return "vertices";
+    case EDGES: return "edges";
+    case POLYGONS: return "polygons";
+    case MODELS: return "models";
+    case CONSTRAINTS: return "constraints";
+    case SCENE_ITEMS: return "scene_items";
+    case OTHER: return "other";
+    default: return "unknown";
+  }
+}
+
+std::size_t MemoryReport::Usage::total() const
+{
+  std::size_t sum = 0;
+  for (int i = 0; i < NUM_CATEGORIES; i++)
+    sum += bytes[i];
+  return sum;
+}
+
+MemoryReport::Usage& MemoryReport::Usage::operator+=(const Usage& other)
+{
+  for (int i = 0; i < NUM_CATEGORIES; i++)
+    bytes[i] += other.bytes[i];
+  return *this;
+}
+
+void MemoryReport::measure(const Building& building)
+{
+  levels.clear();
+  layers.clear();
+  for (const Level& level : building.levels)
+  {
+    levels.push_back(std::make_pair(level.name, level.memory_usage()));
+    for (const Layer& layer : level.layers)
+    {
+      if (!layer.image_loaded())
+        continue;
+      LayerUsage usage;
+      usage.level_name = level.name;
+      usage.layer_name = layer.name;
+      if (!layer.packed_image.is_null())
+        usage.bits_per_pixel = layer.packed_image.bits_per_pixel();
+      usage.source_bytes = layer.source_bytes();
+      usage.drawn_bytes = layer.drawn_bytes();
+      layers.push_back(usage);
+    }
+  }
+
+  Heap::Usage heap;
+  Heap::usage(heap);
+  heap_in_use = heap.in_use;
+  heap_free = heap.free;
+}
+
+MemoryReport::Usage MemoryReport::levels_total() const
+{
+  Usage usage;
+  for (const auto& level : levels)
+    usage += level.second;
+  return usage;
+}
+
+std::size_t MemoryReport::total() const
+{
+  return levels_total().total() + editor_models + undo_stack;
+}
+
+QString MemoryReport::summary() const
+{
+  QString s;
+  auto add_usage = [&s](const QString& title, const Usage& usage)
+    {
+      s += QString::asprintf("%-30s %12s\n",
+          qUtf8Printable(title),
+          qUtf8Printable(format_bytes(usage.total())));
+      for (int i = 0; i < NUM_CATEGORIES; i++)
+        s += QString::asprintf("  %-28s %12s\n",
+            category_name(static_cast<Category>(i)),
+            qUtf8Printable(format_bytes(usage.bytes[i])));
+    };
+
+  for (const auto& level : levels)
+    add_usage("level " + QString::fromStdString(level.first), level.second);
+  add_usage("all levels", levels_total());
+
+  for (const LayerUsage& layer : layers)
+  {
+    const QString title = QString::fromStdString(
+      "layer " + layer.level_name + "/" + layer.layer_name);
+    s += QString::asprintf("%-30s %12s  (%d bpp, %s drawn)\n",
+        qUtf8Printable(title),
+        qUtf8Printable(format_bytes(layer.source_bytes)),
+        layer.bits_per_pixel,
+        qUtf8Printable(format_bytes(layer.drawn_bytes)));
+  }
+
+  s += QString::asprintf("%-30s %12s\n",
+      "editor model thumbnails",
+      qUtf8Printable(format_bytes(editor_models)));
+  s += QString::asprintf("%-30s %12s  (%d commands)\n",
+      "undo history",
+      qUtf8Printable(format_bytes(undo_stack)),
+      undo_commands);
+  if (heap_in_use)
+    s += QString::asprintf("%-30s %12s  (%s free)\n",
+        "process heap",
+        qUtf8Printable(format_bytes(heap_in_use)),
+        qUtf8Printable(format_bytes(heap_free)));
+  s += QString::asprintf("%-30s %12s\n",
+      "total",
+      qUtf8Printable(format_bytes(total())));
+  return s;
+}
+
+QJsonObject MemoryReport::to_json() const
+{
+  auto usage_json = [](const Usage& usage)
+    {
+      QJsonObject o;
+      for (int i = 0; i < NUM_CATEGORIES; i++)
+        o[category_name(static_cast<Category>(i))] =
+          static_cast<double>(usage.bytes[i]);
+      o["total"] = static_cast<double>(usage.total());
+      return o;
+    };
+
+  QJsonArray levels_json;
+  for (const auto& level : levels)
+  {
+    QJsonObject o = usage_json(level.second);
+    o["name"] = QString::fromStdString(level.first);
+    levels_json.append(o);
+  }
+
+  QJsonArray layers_json;
+  for (const LayerUsage& layer : layers)
+  {
+    QJsonObject o;
+    o["level"] = QString::fromStdString(layer.level_name);
+    o["name"] = QString::fromStdString(layer.layer_name);
+    o["bits_per_pixel"] = layer.bits_per_pixel;
+    o["source"] = static_cast<double>(layer.source_bytes);
+    o["drawn"] = static_cast<double>(layer.drawn_bytes);
+    layers_json.append(o);
+  }
+
+  QJsonObject json;
+  json["levels"] = levels_json;
+  json["layers"] = layers_json;
+  json["editor_models"] = static_cast<double>(editor_models);
+  json["undo_stack"] = static_cast<double>(undo_stack);
+  json["undo_commands"] = undo_commands;
+  json["heap_in_use"] = static_cast<double>(heap_in_use);
+  json["heap_free"] = static_cast<double>(heap_free);
+  json["total"] = static_cast<double>(total());
+  return json;
+}
+
+std::size_t MemoryReport::string_bytes(const std::string& s)
+{
+  // short strings live inside the std::string itself
+  return s.capacity() > 15 ? s.capacity() + 1 : 0;
+}
+
+std::size_t MemoryReport::image_bytes(const QImage& image)
+{
+  return static_cast<std::size_t>(image.bytesPerLine()) * image.height();
+}
+
+std::size_t MemoryReport::pixmap_bytes(const QPixmap& pixmap)
+{
+  return static_cast<std::size_t>(pixmap.width()) * pixmap.height() *
+    pixmap.depth() / 8;
+}
+
+std::size_t MemoryReport::editor_model_bytes(
+  const std::vector<EditorModel>& editor_models)
+{
+  std::size_t bytes = editor_models.capacity() * sizeof(EditorModel);
+  for (const EditorModel& editor_model : editor_models)
+    bytes += pixmap_bytes(editor_model.pixmap) +
+      string_bytes(editor_model.name) +
+      string_bytes(editor_model.name_lowercase);
+  return bytes;
+}
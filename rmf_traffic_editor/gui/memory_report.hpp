@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef TRAFFIC_EDITOR__MEMORY_REPORT_HPP
+#define TRAFFIC_EDITOR__MEMORY_REPORT_HPP
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <QJsonObject>
+#include <QString>
+
+class Building;
+class EditorModel;
+class QImage;
+class QPixmap;
+
+//=============================================================================
+/// Estimated memory held by each level of a building, by kind of data,
+/// and by the editor model thumbnails and the undo history, for finding
+/// out what fills up the RAM when several big buildings are open. The
+/// figures are estimates: images count their pixels, entities their
+/// vectors and what their strings and parameters allocate, and scene
+/// items a typical QGraphicsItem each.
+class MemoryReport
+{
+public:
+  enum Category
+  {
+    FLOORPLAN = 0,
+    LAYER_IMAGES,
+    COLORIZED_IMAGES,
+    VERTICES,
+    EDGES,
+    POLYGONS,
+    MODELS,
+    CONSTRAINTS,  // and the features they join
+    SCENE_ITEMS,
+    OTHER,  // tags and fiducials
+    NUM_CATEGORIES
+  };
+
+  static const char* category_name(const Category category);
+
+  /// The bytes of one level, or of the whole building
+  struct Usage
+  {
+    std::size_t bytes[NUM_CATEGORIES] = {};
+
+    std::size_t total() const;
+    Usage& operator+=(const Usage& other);
+  };
+
+  /// The images of one loaded layer: the decoded image, which is packed
+  /// if bits_per_pixel is below 8, and the colorized pixmap or tiles
+  struct LayerUsage
+  {
+    std::string level_name;
+    std::string layer_name;
+    int bits_per_pixel = 8;
+    std::size_t source_bytes = 0;
+    std::size_t drawn_bytes = 0;
+  };
+
+  /// Measure every level of the building, replacing what was measured
+  void measure(const Building& building);
+
+  std::vector<std::pair<std::string, Usage>> levels;
+  std::vector<LayerUsage> layers;
+  std::size_t editor_models = 0;  // their thumbnails, shared by the models
+  std::size_t undo_stack = 0;
+  int undo_commands = 0;
+
+  /// What the C library's allocator holds for the whole process, all
+  /// buildings included, as of measure(); zero if it can't tell. A lot of
+  /// free heap after closing a building is fragmentation.
+  std::size_t heap_in_use = 0;
+  std::size_t heap_free = 0;
+
+  Usage levels_total() const;
+  std::size_t total() const;
+
+  /// Human-readable breakdown, one line per level and category
+  QString summary() const;
+
+  /// Everything, as {"levels": [{"name", "total", <category>...}, ...],
+  /// "layers": [{"level", "name", "bits_per_pixel", "source", "drawn"}],
+  /// "editor_models", "undo_stack", "undo_commands", "heap_in_use",
+  /// "heap_free", "total"}, in bytes
+  QJsonObject to_json() const;
+
+  static std::size_t string_bytes(const std::string& s);
+  static std::size_t image_bytes(const QImage& image);
+  static std::size_t pixmap_bytes(const QPixmap& pixmap);
+  static std::size_t editor_model_bytes(
+    const std::vector<EditorModel>& editor_models);
+
+  /// A QGraphicsItem with its pen, brush and shape, roughly
+  static const std::size_t SCENE_ITEM_BYTES = 256;
+};
+
+#endif
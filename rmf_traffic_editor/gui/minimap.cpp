@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+
+#include <QImageReader>
+#include <QMouseEvent>
+#include <QPainter>
+
+#include "level.h"
+#include "minimap.hpp"
+
+namespace {
+
+/// The lines which are long enough to show at this scale
+std::vector<QLineF> visible_lines(
+  const std::vector<QLineF>& lines,
+  const double scale)
+{
+  const double min_length = 0.5 / scale;
+  std::vector<QLineF> visible;
+  visible.reserve(lines.size());
+  for (const QLineF& line : lines)
+  {
+    if (std::abs(line.dx()) + std::abs(line.dy()) >= min_length)
+      visible.push_back(line);
+  }
+  return visible;
+}
+
+}  // namespace
+
+Minimap::Input Minimap::input(const Level& level, const bool y_flipped)
+{
+  Input input;
+  input.level_name = level.name;
+  input.y_flipped = y_flipped;
+  if (!level.drawing_filename.empty())
+  {
+    input.drawing_filename = QString::fromStdString(level.drawing_filename);
+    input.drawing_rect =
+      QRectF(0, 0, level.drawing_width, level.drawing_height);
+  }
+  for (const Edge& edge : level.edges)
+  {
+    if (edge.start_idx < 0 ||
+      edge.end_idx < 0 ||
+      edge.start_idx >= static_cast<int>(level.vertices.size()) ||
+      edge.end_idx >= static_cast<int>(level.vertices.size()))
+      continue;
+    const Vertex& v_start = level.vertices[edge.start_idx];
+    const Vertex& v_end = level.vertices[edge.end_idx];
+    const QLineF line(v_start.x, v_start.y, v_end.x, v_end.y);
+    if (edge.type == Edge::WALL)
+      input.walls.push_back(line);
+    else if (edge.type == Edge::LANE || edge.type == Edge::HUMAN_LANE)
+      input.lanes.push_back(line);
+  }
+
+  QRectF rect = input.drawing_rect;
+  if (!level.vertices.empty())
+  {
+    double x_min = level.vertices[0].x, x_max = x_min;
+    double y_min = level.vertices[0].y, y_max = y_min;
+    for (const Vertex& v : level.vertices)
+    {
+      x_min = std::min(x_min, v.x);
+      x_max = std::max(x_max, v.x);
+      y_min = std::min(y_min, v.y);
+      y_max = std::max(y_max, v.y);
+    }
+    rect |= QRectF(x_min, y_min, x_max - x_min, y_max - y_min);
+  }
+  input.rect = rect;
+  return input;
+}
+
+
+Minimap::Raster Minimap::render(const Input& input, const int max_size)
+{
+  Raster raster;
+  raster.level_name = input.level_name;
+  raster.rect = input.rect;
+  raster.y_flipped = input.y_flipped;
+  if (input.rect.width() <= 0.0 || input.rect.height() <= 0.0)
+    return raster;
+
+  const double scale =
+    max_size / std::max(input.rect.width(), input.rect.height());
+  const int width = std::max(1, qRound(input.rect.width() * scale));
+  const int height = std::max(1, qRound(input.rect.height() * scale));
+  raster.image = QImage(width, height, QImage::Format_RGB32);
+  raster.image.fill(Qt::white);
+
+  // scene to raster, flipped the way the map view flips it
+  QTransform transform;
+  if (input.y_flipped)
+  {
+    transform.scale(scale, scale);
+    transform.translate(-input.rect.left(), -input.rect.top());
+  }
+  else
+  {
+    transform.scale(scale, -scale);
+    transform.translate(-input.rect.left(), -input.rect.bottom());
+  }
+
+  QPainter painter(&raster.image);
+  painter.setRenderHint(QPainter::SmoothPixmapTransform);
+  painter.setTransform(transform);
+
+  if (!input.drawing_filename.isEmpty() && !input.drawing_rect.isEmpty())
+  {
+    // decode the drawing straight to about the size it is shown at
+    QImageReader reader(input.drawing_filename);
+    reader.setAutoTransform(true);
+    const int side = static_cast<int>(
+      std::ceil(
+        std::max(input.drawing_rect.width(), input.drawing_rect.height()) *
+        scale));
+    const QSize stored_size = reader.size();
+    if (stored_size.isValid() &&
+      std::max(stored_size.width(), stored_size.height()) > side)
+      reader.setScaledSize(
+        stored_size.scaled(QSize(side, side), Qt::KeepAspectRatio));
+    const QImage drawing = reader.read();
+    if (!drawing.isNull())
+      painter.drawImage(input.drawing_rect, drawing);
+  }
+
+  painter.setRenderHint(QPainter::Antialiasing);
+  QPen wall_pen(QColor(0, 0, 0), 2.0);
+  wall_pen.setCosmetic(true);
+  painter.setPen(wall_pen);
+  const std::vector<QLineF> walls = visible_lines(input.walls, scale);
+  if (!walls.empty())
+    painter.drawLines(walls.data(), static_cast<int>(walls.size()));
+
+  QPen lane_pen(QColor(0, 0, 255), 1.0);
+  lane_pen.setCosmetic(true);
+  painter.setPen(lane_pen);
+  const std::vector<QLineF> lanes = visible_lines(input.lanes, scale);
+  if (!lanes.empty())
+    painter.drawLines(lanes.data(), static_cast<int>(lanes.size()));
+
+  return raster;
+}
+
+Minimap::Minimap(QWidget* parent)
+: QWidget(parent)
+{
+  setMinimumSize(120, 120);
+  setCursor(Qt::PointingHandCursor);
+}
+
+void Minimap::set_raster(const Raster& raster)
+{
+  _raster = raster;
+  update();
+}
+
+void Minimap::set_view_rect(const QRectF& rect)
+{
+  if (rect == _view_rect)
+    return;
+  _view_rect = rect;
+  update();
+}
+
+QRectF Minimap::target_rect() const
+{
+  if (!_raster.is_valid())
+    return QRectF();
+  const QSizeF size = QSizeF(_raster.image.size()).scaled(
+    QSizeF(width(), height()),
+    Qt::KeepAspectRatio);
+  return QRectF(
+    (width() - size.width()) / 2.0,
+    (height() - size.height()) / 2.0,
+    size.width(),
+    size.height());
+}
+
+QPointF Minimap::to_widget(const QPointF& p) const
+{
+  const QRectF target = target_rect();
+  const QRectF& r = _raster.rect;
+  const double u = (p.x() - r.left()) / r.width();
+  const double v = _raster.y_flipped ?
+    (p.y() - r.top()) / r.height() :
+    (r.bottom() - p.y()) / r.height();
+  return QPointF(
+    target.left() + u * target.width(),
+    target.top() + v * target.height());
+}
+
+QPointF Minimap::to_scene(const QPointF& p) const
+{
+  const QRectF target = target_rect();
+  const QRectF& r = _raster.rect;
+  const double u = (p.x() - target.left()) / target.width();
+  const double v = (p.y() - target.top()) / target.height();
+  return QPointF(
+    r.left() + u * r.width(),
+    _raster.y_flipped ?
+    r.top() + v * r.height() :
+    r.bottom() - v * r.height());
+}
+
+void Minimap::paintEvent(QPaintEvent*)
+{
+  QPainter painter(this);
+  painter.fillRect(rect(), QColor(64, 64, 64));
+  if (!_raster.is_valid())
+    return;
+
+  painter.setRenderHint(QPainter::SmoothPixmapTransform);
+  painter.drawImage(target_rect(), _raster.image);
+
+  if (_view_rect.isEmpty())
+    return;
+  const QRectF outline =
+    QRectF(to_widget(_view_rect.topLeft()), to_widget(_view_rect.bottomRight()))
+    .normalized();
+  painter.setPen(QPen(QColor(255, 0, 0), 2.0));
+  painter.setBrush(Qt::NoBrush);
+  painter.drawRect(outline);
+}
+
+void Minimap::mousePressEvent(QMouseEvent* e)
+{
+  if (e->button() == Qt::LeftButton && _raster.is_valid())
+    emit recenter(to_scene(e->pos()));
+}
+
+void Minimap::mouseMoveEvent(QMouseEvent* e)
+{
+  if ((e->buttons() & Qt::LeftButton) && _raster.is_valid())
+    emit recenter(to_scene(e->pos()));
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__MINIMAP_HPP
+#define TRAFFIC_EDITOR__MINIMAP_HPP
+
+#include <string>
+#include <vector>
+
+#include <QImage>
+#include <QLineF>
+#include <QRectF>
+#include <QString>
+#include <QWidget>
+
+class Level;
+
+//=============================================================================
+/// An overview of the active level, from a low-resolution raster of its
+/// floorplan, walls and lanes, with the part in the map view outlined.
+/// Clicking or dragging in it emits recenter() with the point in scene
+/// coordinates. The raster is made by render(), which uses only its input
+/// and so can run on a worker thread.
+class Minimap : public QWidget
+{
+  Q_OBJECT
+
+public:
+  /// What render() needs of a level, copied out on the main thread
+  struct Input
+  {
+    std::string level_name;
+    QString drawing_filename;  // relative to the building, or empty
+    QRectF drawing_rect;  // where the drawing is, in scene coordinates
+    QRectF rect;  // the area to show, in scene coordinates
+    bool y_flipped = true;  // as the map view shows it
+    std::vector<QLineF> walls;
+    std::vector<QLineF> lanes;
+  };
+
+  struct Raster
+  {
+    std::string level_name;
+    QImage image;
+    QRectF rect;
+    bool y_flipped = true;
+
+    bool is_valid() const { return !image.isNull(); }
+  };
+
+  /// The input for a level: its drawing, walls and lanes, in the rect
+  /// around the drawing and the vertices (which is empty if it has
+  /// neither)
+  static Input input(const Level& level, const bool y_flipped);
+
+  /// Rasterize the level to no more than max_size pixels on its long side.
+  /// Walls and lanes shorter than half a pixel are left out.
+  static Raster render(const Input& input, const int max_size = 512);
+
+  Minimap(QWidget* parent = nullptr);
+
+  void set_raster(const Raster& raster);
+  const Raster& raster() const { return _raster; }
+
+  /// The part of the scene in the map view, to outline
+  void set_view_rect(const QRectF& rect);
+
+  QSize sizeHint() const override { return QSize(240, 240); }
+
+signals:
+  void recenter(const QPointF& scene_point);
+
+protected:
+  void paintEvent(QPaintEvent* e) override;
+  void mousePressEvent(QMouseEvent* e) override;
+  void mouseMoveEvent(QMouseEvent* e) override;
+
+private:
+  Raster _raster;
+  QRectF _view_rect;
+
+  /// Where the raster is drawn in the widget, keeping its aspect ratio
+  QRectF target_rect() const;
+
+  QPointF to_widget(const QPointF& scene_point) const;
+  QPointF to_scene(const QPointF& widget_point) const;
+};
+
+#endif
@@ -19,8 +19,9 @@
 
 #include <QtGlobal>
 #include <QGraphicsPixmapItem>
-#include <QGraphicsColorizeEffect>
+#include <QPainter>
 
+#include "logging.hpp"
 #include "model.h"
 using std::string;
 
@@ -122,106 +123,218 @@ void Model::set_param(const std::string& name, const std::string& value)
   }
   else
   {
-    printf("WARNING: setting unknown model parameter: [%s]\n", name.c_str());
+    qCWarning(lc_edit,
+      "setting unknown model parameter: [%s]", name.c_str());
   }
 }
 
 void Model::draw(
   QGraphicsScene* scene,
   std::vector<EditorModel>& editor_models,
-  const double drawing_meters_per_pixel)
+  const double drawing_meters_per_pixel,
+  QGraphicsItem* parent)
 {
   if (pixmap_item == nullptr)
   {
-    // find the pixmap we need for this model
-    QPixmap pixmap;
     double model_meters_per_pixel = 1.0;  // will get overridden
-    for (auto& editor_model : editor_models)
-    {
-      if (editor_model.name == model_name)
-      {
-        pixmap = editor_model.get_pixmap();
-        model_meters_per_pixel = editor_model.meters_per_pixel;
-        break;
-      }
-    }
+    const QPixmap pixmap =
+      find_pixmap(editor_models, selected, model_meters_per_pixel);
     if (pixmap.isNull())
     {
-      // BACKWARDS COMPATIBILITY PATCH: Try again, but...
-      // Use the first matching namespaced thumbnail for a
-      // specified non-namespaced model, with warnings.
-
-      // (Also modifies the model name inplace!)
-      for (auto& editor_model : editor_models)
-      {
-        // Get ending token
-        std::string ending_token;
-        std::size_t delimiter_index = editor_model.name.find("/");
-
-        if (delimiter_index != std::string::npos)
-        {
-          ending_token = editor_model.name
-            .substr(delimiter_index + 1, editor_model.name.length());
-        }
-        else
-        {
-          ending_token = editor_model.name;
-        }
-
-        // Check if namespaced model_name is the name we are looking for
-        // Match mismatched cases
-        if (iequals(ending_token, model_name))
-        {
-          // Skip rematches from previous for loop
-          if (model_name == editor_model.name)
-            continue;
-
-          pixmap = editor_model.get_pixmap();
-          model_meters_per_pixel = editor_model.meters_per_pixel;
-
-          printf("\n[WARNING] Thumbnail %1$s not found, "
-            "substituting %2$s instead!\n"
-            "(%1$s will be saved as %2$s)\n\n",
-            model_name.c_str(), editor_model.name.c_str());
-
-          // And reassign it!
-          model_name = editor_model.name;
-          break;
-        }
-      }
-
-      // Check again for pixmap find status
-      if (pixmap.isNull())
+      if (!error_printed)
       {
-        if (!error_printed)
-        {
-          printf("[ERROR] No thumbnail found: %s\n", model_name.c_str());
-          error_printed = true;
-        }
-        return;  // couldn't load the pixmap; ignore it.
+        qCWarning(lc_draw, "no thumbnail found: %s", model_name.c_str());
+        error_printed = true;
       }
+      return;  // couldn't load the pixmap; ignore it.
     }
 
-    pixmap_item = scene->addPixmap(pixmap);
+    if (parent)
+      pixmap_item = new QGraphicsPixmapItem(pixmap, parent);
+    else
+      pixmap_item = scene->addPixmap(pixmap);
     pixmap_item->setOffset(-pixmap.width()/2, -pixmap.height()/2);
     pixmap_item->setScale(model_meters_per_pixel / drawing_meters_per_pixel);
     pixmap_item->setZValue(100.0);  // just anything taller than 0
+    pixmap_selected = selected;
   }
 
-  pixmap_item->setPos(state.x, state.y);
-  pixmap_item->setRotation((-state.yaw + M_PI / 2.0) * 180.0 / M_PI);
+  update_pose();
+
+  // make the model "glow" if it is selected, by showing the tinted copy
+  // of its pixmap; a graphics effect would be rendered on every paint
+  if (selected != pixmap_selected)
+  {
+    double model_meters_per_pixel = 1.0;
+    const QPixmap pixmap =
+      find_pixmap(editor_models, selected, model_meters_per_pixel);
+    if (!pixmap.isNull())
+    {
+      // the thumbnail may have replaced the placeholder meanwhile
+      pixmap_item->setPixmap(pixmap);
+      pixmap_item->setOffset(-pixmap.width()/2, -pixmap.height()/2);
+      pixmap_item->setScale(
+        model_meters_per_pixel / drawing_meters_per_pixel);
+    }
+    pixmap_selected = selected;
+  }
+}
+
+QPixmap Model::find_pixmap(
+  std::vector<EditorModel>& editor_models,
+  const bool tinted,
+  double& meters_per_pixel)
+{
+  thumbnail_placeholder = false;
+  if (!resolve_editor_model(editor_models, nullptr))
+    return QPixmap();
+
+  EditorModel& editor_model = editor_models[editor_model_idx];
+  if (editor_model.pixmap.isNull() && editor_model.thumbnail_pending)
+  {
+    // still being loaded in the background; it will be swapped in
+    // by redraw_thumbnail() when it arrives
+    const QPixmap pixmap = placeholder_pixmap(tinted);
+    meters_per_pixel = PLACEHOLDER_SIZE / pixmap.width();
+    thumbnail_placeholder = true;
+    return pixmap;
+  }
+
+  meters_per_pixel = editor_model.meters_per_pixel;
+  return tinted ?
+    editor_model.get_selected_pixmap() : editor_model.get_pixmap();
+}
+
+bool Model::resolve_editor_model(
+  const std::vector<EditorModel>& editor_models,
+  const EditorModelIndex* index)
+{
+  if (editor_model_idx >= 0 &&
+    editor_model_idx < static_cast<int>(editor_models.size()) &&
+    editor_models[editor_model_idx].name == model_name)
+    return true;  // the usual case, once the model has been drawn
+
+  editor_model_idx = index ? index->find(model_name) : -1;
+  for (std::size_t i = 0; !index && i < editor_models.size(); i++)
+  {
+    if (editor_models[i].name == model_name)
+    {
+      editor_model_idx = static_cast<int>(i);
+      break;
+    }
+  }
+  if (editor_model_idx >= 0)
+    return true;
+
+  // BACKWARDS COMPATIBILITY PATCH: Try again, but...
+  // Use the first matching namespaced thumbnail for a
+  // specified non-namespaced model, with warnings.
 
-  // make the model "glow" if it is selected
-  if (selected)
+  // (Also modifies the model name inplace!)
+  if (index)
+    editor_model_idx = index->find_ending_token(model_name);
+  for (std::size_t i = 0; !index && i < editor_models.size(); i++)
   {
-    QGraphicsColorizeEffect* colorize = new QGraphicsColorizeEffect;
-    colorize->setColor(QColor::fromRgbF(1.0, 0.2, 0.0, 1.0));
-    colorize->setStrength(1.0);
-    pixmap_item->setGraphicsEffect(colorize);
+    // Check if namespaced model_name is the name we are looking for
+    // Match mismatched cases
+    const std::string ending_token =
+      EditorModelIndex::ending_token(editor_models[i].name);
+    if (iequals(ending_token, model_name))
+    {
+      editor_model_idx = static_cast<int>(i);
+      break;
+    }
+  }
+  if (editor_model_idx < 0)
+    return false;
+
+  const std::string& substitute_name = editor_models[editor_model_idx].name;
+  qCWarning(lc_draw,
+    "thumbnail %s not found, substituting %s instead; it will be saved as "
+    "%s",
+    model_name.c_str(),
+    substitute_name.c_str(),
+    substitute_name.c_str());
+
+  // And reassign it!
+  model_name = substitute_name;
+  return true;
+}
+
+void Model::redraw_thumbnail(
+  std::vector<EditorModel>& editor_models,
+  const double drawing_meters_per_pixel)
+{
+  if (!pixmap_item || !thumbnail_placeholder)
+    return;
+  refresh_pixmap(editor_models, drawing_meters_per_pixel);
+}
+
+bool Model::refresh_pixmap(
+  std::vector<EditorModel>& editor_models,
+  const double drawing_meters_per_pixel)
+{
+  if (!pixmap_item)
+    return false;
+
+  double model_meters_per_pixel = 1.0;
+  const QPixmap pixmap =
+    find_pixmap(editor_models, selected, model_meters_per_pixel);
+  if (pixmap.isNull())
+  {
+    clear_pixmap();
+    return false;
   }
+
+  // the item keeps its place in the scene, its parent and its pose
+  pixmap_item->setPixmap(pixmap);
+  pixmap_item->setOffset(-pixmap.width()/2, -pixmap.height()/2);
+  pixmap_item->setScale(model_meters_per_pixel / drawing_meters_per_pixel);
+  pixmap_selected = selected;
+  return true;
+}
+
+QPixmap Model::placeholder_pixmap(const bool tinted)
+{
+  static QPixmap pixmap;
+  static QPixmap tinted_pixmap;
+  if (pixmap.isNull())
+  {
+    pixmap = QPixmap(32, 32);
+    pixmap.fill(Qt::transparent);
+    QPainter painter(&pixmap);
+    painter.setPen(QPen(QColor::fromRgbF(0.3, 0.3, 0.3, 0.8), 2));
+    painter.setBrush(QColor::fromRgbF(0.6, 0.6, 0.6, 0.4));
+    painter.drawRect(1, 1, 30, 30);
+    painter.end();
+    tinted_pixmap = EditorModel::tinted(pixmap);
+  }
+  return tinted ? tinted_pixmap : pixmap;
 }
 
 void Model::clear_scene()
 {
   pixmap_item = nullptr;
 }
+
+void Model::clear_pixmap()
+{
+  if (pixmap_item)
+  {
+    if (pixmap_item->scene())
+      pixmap_item->scene()->removeItem(pixmap_item);
+    delete pixmap_item;
+    pixmap_item = nullptr;
+  }
+  thumbnail_placeholder = false;
+  error_printed = false;
+}
+
+bool Model::update_pose()
+{
+  if (pixmap_item == nullptr)
+    return false;
+  pixmap_item->setPos(state.x, state.y);
+  pixmap_item->setRotation((-state.yaw + M_PI / 2.0) * 180.0 / M_PI);
+  return true;
+}
@@ -26,6 +26,7 @@
  */
 
 #include "editor_model.h"
+#include "editor_model_index.hpp"
 #include "model_state.h"
 
 #include <string>
@@ -51,6 +52,9 @@ public:
   bool error_printed = false;
   std::string starting_level;  // used when resetting a test scenario
   QGraphicsPixmapItem* pixmap_item = nullptr;
+  bool thumbnail_placeholder = false;  // pixmap_item is a stand-in
+  bool pixmap_selected = false;  // pixmap_item shows the tinted pixmap
+  int editor_model_idx = -1;  // into the editor model list, once resolved
   QUuid uuid;
 
   Model();
@@ -60,12 +64,56 @@ public:
 
   void set_param(const std::string& name, const std::string& value);
 
+  /// The pixmap is made a child of parent, if one is given, so that all
+  /// models of a level can be hidden at once
   void draw(
     QGraphicsScene* scene,
+    std::vector<EditorModel>& editor_models,
+    const double meters_per_pixel,
+    QGraphicsItem* parent = nullptr);
+
+  /// Find (and remember) the entry of the model list for this model,
+  /// substituting a namespaced name for an old non-namespaced one. Uses
+  /// the hash index if one is given, otherwise searches the list.
+  bool resolve_editor_model(
+    const std::vector<EditorModel>& editor_models,
+    const EditorModelIndex* index);
+
+  /// If this model was drawn with a placeholder, show its thumbnail now
+  /// that it may have been loaded
+  void redraw_thumbnail(
+    std::vector<EditorModel>& editor_models,
+    const double meters_per_pixel);
+
+  /// Show the pixmap of its current entry in editor_models (or the
+  /// placeholder, while that is loading) in the item it was drawn with,
+  /// e.g. after the model list was reloaded. If it has no pixmap any more
+  /// the item is removed, and this returns false.
+  bool refresh_pixmap(
     std::vector<EditorModel>& editor_models,
     const double meters_per_pixel);
 
   void clear_scene();
+
+  /// Remove the drawn pixmap from the scene, e.g. because model_name has
+  /// changed, so that the next draw() looks up the right one
+  void clear_pixmap();
+
+  /// Move the already-drawn pixmap to the current state, without touching
+  /// anything else. Returns false if the model has not been drawn.
+  bool update_pose();
+
+private:
+  /// Edge length of the placeholder square, in meters
+  static constexpr double PLACEHOLDER_SIZE = 0.5;
+  static QPixmap placeholder_pixmap(const bool tinted);
+
+  /// The pixmap to draw this model with, or a null one if there is none.
+  /// Sets thumbnail_placeholder if it has to be the placeholder.
+  QPixmap find_pixmap(
+    std::vector<EditorModel>& editor_models,
+    const bool tinted,
+    double& meters_per_pixel);
 };
 
 #endif
@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include <cstring>
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <yaml-cpp/yaml.h>
+
+#include "logging.hpp"
+#include "model_catalog_cache.hpp"
+#include "string_table.hpp"
+
+static_assert(sizeof(ModelCatalogCache::Header) == 24, "header layout");
+
+QString ModelCatalogCache::cache_dir()
+{
+  return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+    "/model_catalog";
+}
+
+QString ModelCatalogCache::entry_path(const QString& model_list_path)
+{
+  const QFileInfo file_info(model_list_path);
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(file_info.absoluteFilePath().toUtf8());
+  hash.addData(QByteArray::number(file_info.size()));
+  hash.addData(
+    QByteArray::number(file_info.lastModified().toMSecsSinceEpoch()));
+  return cache_dir() + "/" + QString::fromLatin1(hash.result().toHex()) +
+    ".models";
+}
+
+bool ModelCatalogCache::load(
+  const QString& model_list_path,
+  double& meters_per_pixel,
+  std::vector<std::string>& names)
+{
+  if (!QFileInfo::exists(model_list_path))
+    return false;
+  const QString path = entry_path(model_list_path);
+  if (read_entry(path, meters_per_pixel, names))
+  {
+    qCDebug(lc_io, "read %zu model names from the catalog cache",
+      names.size());
+    return true;
+  }
+
+  names.clear();
+  try
+  {
+    const YAML::Node y = YAML::LoadFile(model_list_path.toStdString());
+    meters_per_pixel = y["meters_per_pixel"].as<double>();
+    const YAML::Node ym = y["models"];
+    names.reserve(ym.size());
+    for (YAML::const_iterator it = ym.begin(); it != ym.end(); ++it)
+      names.push_back(it->as<std::string>());
+  }
+  catch (const std::exception& e)
+  {
+    qCWarning(lc_io, "couldn't parse %s: %s",
+      qUtf8Printable(model_list_path),
+      e.what());
+    names.clear();
+    return false;
+  }
+  qCInfo(lc_io, "parsed %s successfully", qUtf8Printable(model_list_path));
+
+  write_entry(path, meters_per_pixel, names);
+  return true;
+}
+
+bool ModelCatalogCache::read_entry(
+  const QString& path,
+  double& meters_per_pixel,
+  std::vector<std::string>& names)
+{
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly))
+    return false;
+  const QByteArray data = file.readAll();
+  const char* bytes = data.constData();
+  const std::size_t size = static_cast<std::size_t>(data.size());
+
+  Header header;
+  if (size < sizeof(header))
+    return false;
+  std::memcpy(&header, bytes, sizeof(header));
+  const uint64_t strings_offset =
+    sizeof(header) + uint64_t(header.num_models) * sizeof(uint32_t);
+  if (header.magic != MAGIC ||
+    header.version != VERSION ||
+    strings_offset > size)
+    return false;
+
+  std::vector<uint32_t> indices(header.num_models);
+  std::memcpy(
+    indices.data(),
+    bytes + sizeof(header),
+    indices.size() * sizeof(uint32_t));
+  std::vector<std::string> strings;
+  if (!StringTable::parse(
+      bytes + strings_offset,
+      size - strings_offset,
+      header.num_strings,
+      strings))
+  {
+    qCWarning(lc_io, "ignoring corrupt model catalog cache entry %s",
+      qUtf8Printable(path));
+    return false;
+  }
+
+  names.clear();
+  names.reserve(indices.size());
+  for (const uint32_t idx : indices)
+  {
+    if (idx >= strings.size())
+    {
+      names.clear();
+      return false;
+    }
+    names.push_back(strings[idx]);
+  }
+  meters_per_pixel = header.meters_per_pixel;
+  return true;
+}
+
+void ModelCatalogCache::write_entry(
+  const QString& path,
+  const double meters_per_pixel,
+  const std::vector<std::string>& names)
+{
+  if (!QDir().mkpath(cache_dir()))
+    return;
+
+  StringTable strings;
+  std::vector<uint32_t> indices;
+  indices.reserve(names.size());
+  for (const std::string& name : names)
+    indices.push_back(strings.add(name));
+
+  Header header;
+  header.magic = MAGIC;
+  header.version = VERSION;
+  header.num_models = static_cast<uint32_t>(indices.size());
+  header.num_strings = strings.size();
+  header.meters_per_pixel = meters_per_pixel;
+
+  QByteArray data;
+  data.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  data.append(
+    reinterpret_cast<const char*>(indices.data()),
+    static_cast<int>(indices.size() * sizeof(uint32_t)));
+  strings.append_to(data);
+
+  // another editor starting at the same time never sees a partial entry
+  QSaveFile file(path);
+  if (!file.open(QIODevice::WriteOnly))
+    return;
+  file.write(data);
+  if (!file.commit())
+    qCWarning(lc_io, "unable to write model catalog cache entry %s",
+      qUtf8Printable(path));
+}
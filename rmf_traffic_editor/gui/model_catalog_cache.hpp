@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef TRAFFIC_EDITOR__MODEL_CATALOG_CACHE_HPP
+#define TRAFFIC_EDITOR__MODEL_CATALOG_CACHE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <QString>
+
+//=============================================================================
+/// On-disk cache of the parsed model_list.yaml of the thumbnails, which
+/// lists thousands of models and would otherwise be parsed with yaml-cpp
+/// on every start. The entry is named by a hash of the path, size and
+/// modification time of the YAML, as DecodedImageCache entries are, so an
+/// edited list is parsed again. It is a Header, the string index of each
+/// model name, and a string table (see StringTable).
+class ModelCatalogCache
+{
+public:
+  static const uint32_t MAGIC = 0x4c444f4d;  // "MODL" on disk
+  static const uint32_t VERSION = 1;
+
+  struct Header
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_models;
+    uint32_t num_strings;
+    double meters_per_pixel;  // of the thumbnails
+  };
+
+  /// The model names and the scale of their thumbnails, from the cache if
+  /// it matches the YAML, otherwise parsed from it (and then cached).
+  /// Returns false if the YAML can't be read.
+  static bool load(
+    const QString& model_list_path,
+    double& meters_per_pixel,
+    std::vector<std::string>& names);
+
+  static QString cache_dir();
+
+private:
+  static QString entry_path(const QString& model_list_path);
+
+  static bool read_entry(
+    const QString& path,
+    double& meters_per_pixel,
+    std::vector<std::string>& names);
+
+  static void write_entry(
+    const QString& path,
+    const double meters_per_pixel,
+    const std::vector<std::string>& names);
+};
+
+#endif
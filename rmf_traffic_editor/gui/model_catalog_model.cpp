@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <QImage>
+
+#include "model_catalog_model.hpp"
+
+namespace {
+
+const int ICON_SIZE = 48;
+const int MAX_CACHED_ICONS = 512;
+
+}  // anonymous namespace
+
+ModelCatalogModel::ModelCatalogModel(
+  const std::vector<EditorModel>& editor_models,
+  const EditorModelIndex& editor_model_index,
+  QObject* parent)
+: QAbstractListModel(parent),
+  _editor_models(editor_models),
+  _editor_model_index(editor_model_index),
+  _icons(MAX_CACHED_ICONS)
+{
+  set_filter(QString());
+}
+
+int ModelCatalogModel::rowCount(const QModelIndex& parent) const
+{
+  if (parent.isValid())
+    return 0;
+  return static_cast<int>(_rows.size());
+}
+
+QVariant ModelCatalogModel::data(const QModelIndex& index, int role) const
+{
+  const int idx = editor_model_idx(index.row());
+  if (idx < 0)
+    return QVariant();
+  const EditorModel& editor_model = _editor_models[idx];
+
+  if (role == Qt::DisplayRole)
+    return QString::fromStdString(editor_model.name);
+
+  if (role == Qt::DecorationRole)
+  {
+    QPixmap* cached = _icons.object(idx);
+    if (cached)
+      return *cached;
+
+    QPixmap* icon = new QPixmap;
+    if (!editor_model.pixmap.isNull())
+      *icon = editor_model.pixmap.scaled(
+        ICON_SIZE,
+        ICON_SIZE,
+        Qt::KeepAspectRatio,
+        Qt::SmoothTransformation);
+    else
+    {
+      // decode straight to icon size, without keeping the full image
+      const QImage image = EditorModel::read_thumbnail(
+        EditorModel::thumbnail_path(),
+        editor_model.name,
+        QSize(ICON_SIZE, ICON_SIZE));
+      if (!image.isNull())
+        *icon = QPixmap::fromImage(image);
+    }
+    const QPixmap result(*icon);
+    _icons.insert(idx, icon);  // even if null, so it isn't read again
+    return result;
+  }
+
+  return QVariant();
+}
+
+void ModelCatalogModel::set_filter(const QString& text)
+{
+  beginResetModel();
+  _rows.clear();
+  const std::vector<int>& sorted = _editor_model_index.sorted();
+  const std::string key = text.toStdString();
+  std::size_t begin = 0;
+  std::size_t end = sorted.size();
+  if (!key.empty())
+    _editor_model_index.prefix_range(key, begin, end);
+  for (std::size_t position = begin; position < end; position++)
+    _rows.push_back(sorted[position]);
+
+  if (!key.empty())
+  {
+    std::vector<int> positions;
+    _editor_model_index.containing(key, positions);
+    for (const int position : positions)
+      _rows.push_back(sorted[position]);
+  }
+  endResetModel();
+}
+
+int ModelCatalogModel::editor_model_idx(const int row) const
+{
+  if (row < 0 || row >= static_cast<int>(_rows.size()))
+    return -1;
+  return _rows[row];
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__MODEL_CATALOG_MODEL_HPP
+#define TRAFFIC_EDITOR__MODEL_CATALOG_MODEL_HPP
+
+#include <vector>
+
+#include <QAbstractListModel>
+#include <QCache>
+#include <QPixmap>
+
+#include "editor_model.h"
+#include "editor_model_index.hpp"
+
+//=============================================================================
+/// The model catalog as a list model, for a QListView, which only asks for
+/// the rows it shows. Filtering looks the rows up in the EditorModelIndex
+/// instead of going through the catalog, and the thumbnail icons are
+/// decoded (at icon size) when a row is first shown, and kept in a small
+/// cache. The EditorModel vector and its index are borrowed.
+class ModelCatalogModel : public QAbstractListModel
+{
+  Q_OBJECT
+
+public:
+  ModelCatalogModel(
+    const std::vector<EditorModel>& editor_models,
+    const EditorModelIndex& editor_model_index,
+    QObject* parent = nullptr);
+
+  int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+  QVariant data(const QModelIndex& index, int role) const override;
+
+  /// Show the models whose name (without its namespace) starts with this
+  /// text, followed by those which contain it, or all if it is empty
+  void set_filter(const QString& text);
+
+  /// Index into the EditorModel vector of the model in this row, or -1
+  int editor_model_idx(const int row) const;
+
+private:
+  const std::vector<EditorModel>& _editor_models;
+  const EditorModelIndex& _editor_model_index;
+  std::vector<int> _rows;  // editor model indices
+  mutable QCache<int, QPixmap> _icons;  // by editor model index
+};
+
+#endif
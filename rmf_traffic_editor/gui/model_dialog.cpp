@@ -16,7 +16,7 @@
 */
 
 #include "model_dialog.h"
-#include <algorithm>
+#include "model_catalog_model.hpp"
 #include <QtWidgets>
 using std::vector;
 using std::string;
@@ -25,7 +25,8 @@ using std::string;
 ModelDialog::ModelDialog(
   QWidget* parent,
   Model& model,
-  const vector<EditorModel>& editor_models)
+  vector<EditorModel>& editor_models,
+  const EditorModelIndex& editor_model_index)
 : QDialog(parent),
   _model(model),
   _editor_models(editor_models)
@@ -56,13 +57,19 @@ ModelDialog::ModelDialog(
     this,
     &ModelDialog::model_name_line_edited);
 
-  _model_name_list_widget = new QListWidget;
-  model_name_vbox_layout->addWidget(_model_name_list_widget);
+  // the view only asks the catalog for the rows it shows
+  _catalog = new ModelCatalogModel(_editor_models, editor_model_index, this);
+  _model_name_list_view = new QListView;
+  _model_name_list_view->setUniformItemSizes(true);
+  _model_name_list_view->setIconSize(QSize(48, 48));
+  _model_name_list_view->setModel(_catalog);
+  _model_name_list_view->setMinimumWidth(300);
+  model_name_vbox_layout->addWidget(_model_name_list_view);
   connect(
-    _model_name_list_widget,
-    &QListWidget::currentRowChanged,
+    _model_name_list_view->selectionModel(),
+    &QItemSelectionModel::currentRowChanged,
     this,
-    &ModelDialog::model_name_list_widget_changed);
+    &ModelDialog::model_name_list_view_changed);
 
   _model_preview_label = new QLabel;
   _model_preview_label->setMinimumSize(600, 600);
@@ -81,38 +88,8 @@ ModelDialog::ModelDialog(
 
   setLayout(vbox_layout);
 
-  for (const auto& em : _editor_models)
-  {
-    string::size_type token_start = em.name.find_first_of('/');
-    string token_string = em.name;
-    if (token_start != std::string::npos && em.name.size() > token_start)
-      token_string = em.name.substr(token_start + 1);
-
-    for (std::size_t i = 0; i < token_string.size(); i++)
-      token_string[i] = tolower(token_string[i]);
-
-    sorted_names.push_back(std::make_pair(token_string, em.name));
-  }
-
-  std::sort(
-    sorted_names.begin(),
-    sorted_names.end(),
-    [](std::pair<string, string> a, std::pair<string, string> b)
-    {
-      return a.first < b.first;
-    });
-
-  for (const auto& sorted_name : sorted_names)
-  {
-    _model_name_list_widget->addItem(
-      QString::fromStdString(sorted_name.second));
-  }
-  _model_name_list_widget->setMinimumWidth(
-    _model_name_list_widget->sizeHintForColumn(0) + 30);
-
-  if (!_editor_models.empty())
-    _model_name_list_widget->setCurrentItem(
-      _model_name_list_widget->item(0));
+  if (_catalog->rowCount() > 0)
+    _model_name_list_view->setCurrentIndex(_catalog->index(0));
 
   _model_name_line_edit->setFocus(Qt::OtherFocusReason);
 }
@@ -135,50 +112,36 @@ void ModelDialog::ok_button_clicked()
 void ModelDialog::model_name_line_edited(const QString& text)
 {
   // todo: render on parent if file exists?
-  if (_model_name_list_widget->count() == 0)
+  if (_editor_models.empty())
   {
-    qWarning("model name list widget is empty :(");
+    qWarning("model list is empty :(");
     return;  // nothing to do; there is no available model list
   }
 
-  // see if we can auto-complete with anything in the list box
-  // scroll the list box to the first thing
-  const std::string user_text_lower(text.toLower().toStdString());
-  // could become super fancy but for now let's just do linear search...
-  std::size_t closest_idx = 0;
-  for (std::size_t i = 0; i < sorted_names.size(); i++)
-  {
-    if (user_text_lower <= sorted_names[i].first)
-    {
-      closest_idx = i;
-      break;
-    }
-  }
-  QListWidgetItem* item = _model_name_list_widget->item(closest_idx);
-  _model_name_list_widget->setCurrentItem(item);
-  _model_name_list_widget->scrollToItem(
-    item,
-    QAbstractItemView::PositionAtTop);
+  // narrow the list to the models matching what was typed so far, those
+  // starting with it first, and pick the first
+  _catalog->set_filter(text);
+  if (_catalog->rowCount() == 0)
+    return;
+  const QModelIndex first = _catalog->index(0);
+  _model_name_list_view->setCurrentIndex(first);
+  _model_name_list_view->scrollTo(first, QAbstractItemView::PositionAtTop);
 }
 
-void ModelDialog::model_name_list_widget_changed(int row)
+void ModelDialog::model_name_list_view_changed(const QModelIndex& current)
 {
-  _model.model_name = sorted_names[row].second;
-
-  // look up the _editor_model instance that has this name
-  for (auto& em : _editor_models)
-  {
-    if (em.name == _model.model_name)
-    {
-      const QPixmap& model_pixmap = em.get_pixmap();
-      if (model_pixmap.isNull())
-        return;// we don't have a pixmap to draw :(
-      // scale the pixmap so it fits within the currently allotted space
-      const int w = _model_preview_label->width();
-      const int h = _model_preview_label->height();
-      _model_preview_label->setPixmap(
-        model_pixmap.scaled(w, h, Qt::KeepAspectRatio));
-      break;
-    }
-  }
+  const int editor_model_idx = _catalog->editor_model_idx(current.row());
+  if (editor_model_idx < 0)
+    return;
+  EditorModel& em = _editor_models[editor_model_idx];
+  _model.model_name = em.name;
+
+  const QPixmap& model_pixmap = em.get_pixmap();
+  if (model_pixmap.isNull())
+    return;// we don't have a pixmap to draw :(
+  // scale the pixmap so it fits within the currently allotted space
+  const int w = _model_preview_label->width();
+  const int h = _model_preview_label->height();
+  _model_preview_label->setPixmap(
+    model_pixmap.scaled(w, h, Qt::KeepAspectRatio));
 }
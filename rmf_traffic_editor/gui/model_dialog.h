@@ -22,12 +22,14 @@
 #include <QObject>
 #include "model.h"
 #include "editor_model.h"
+#include "editor_model_index.hpp"
 #include <vector>
 #include <string>
-#include <utility>
 class QLineEdit;
-class QListWidget;
+class QListView;
 class QLabel;
+class QModelIndex;
+class ModelCatalogModel;
 
 
 class ModelDialog : public QDialog
@@ -38,16 +40,17 @@ public:
   ModelDialog(
     QWidget* parent,
     Model& model,
-    const std::vector<EditorModel>& editor_models);
+    std::vector<EditorModel>& editor_models,
+    const EditorModelIndex& editor_model_index);
   ~ModelDialog();
 
 private:
   Model& _model;
-  std::vector<EditorModel> _editor_models;
-  std::vector<std::pair<std::string, std::string>> sorted_names;
+  std::vector<EditorModel>& _editor_models;  // borrowed from the Editor
+  ModelCatalogModel* _catalog;
 
   QLineEdit* _model_name_line_edit;
-  QListWidget* _model_name_list_widget;
+  QListView* _model_name_list_view;
   QLabel* _model_preview_label;
 
   QPushButton* _ok_button, * _cancel_button;
@@ -55,7 +58,7 @@ private:
 private slots:
   void ok_button_clicked();
   void model_name_line_edited(const QString& text);
-  void model_name_list_widget_changed(int row);
+  void model_name_list_view_changed(const QModelIndex& current);
 };
 
 #endif
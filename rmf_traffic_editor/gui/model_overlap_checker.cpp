@@ -0,0 +1,399 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+
+#include "editor_model.h"
+#include "level.h"
+#include "model_overlap_checker.hpp"
+
+using std::vector;
+typedef SegmentRTree::Segment Segment;
+typedef ModelOverlapChecker::Footprint Footprint;
+
+namespace {
+
+/// Half the extent of the footprint along a unit axis
+double projected_radius(const Footprint& f, const double ax, const double ay)
+{
+  return f.half_width * std::abs(ax * f.cos_angle + ay * f.sin_angle) +
+    f.half_height * std::abs(-ax * f.sin_angle + ay * f.cos_angle);
+}
+
+/// The bounding box of a segment, as the (min, max) diagonal
+Segment bounds(const Segment& s)
+{
+  Segment box;
+  box.x0 = std::min(s.x0, s.x1);
+  box.y0 = std::min(s.y0, s.y1);
+  box.x1 = std::max(s.x0, s.x1);
+  box.y1 = std::max(s.y0, s.y1);
+  return box;
+}
+
+bool operator==(const Segment& a, const Segment& b)
+{
+  return a.x0 == b.x0 && a.y0 == b.y0 && a.x1 == b.x1 && a.y1 == b.y1;
+}
+
+}  // anonymous namespace
+
+//=============================================================================
+bool Footprint::operator==(const Footprint& other) const
+{
+  return valid == other.valid &&
+    x == other.x &&
+    y == other.y &&
+    cos_angle == other.cos_angle &&
+    sin_angle == other.sin_angle &&
+    half_width == other.half_width &&
+    half_height == other.half_height;
+}
+
+void Footprint::corners(double xs[4], double ys[4]) const
+{
+  const double sx[4] = {-1.0, 1.0, 1.0, -1.0};
+  const double sy[4] = {-1.0, -1.0, 1.0, 1.0};
+  for (int i = 0; i < 4; i++)
+  {
+    const double px = sx[i] * half_width;
+    const double py = sy[i] * half_height;
+    xs[i] = x + cos_angle * px - sin_angle * py;
+    ys[i] = y + sin_angle * px + cos_angle * py;
+  }
+}
+
+Segment Footprint::bounding_box() const
+{
+  const double rx = projected_radius(*this, 1.0, 0.0);
+  const double ry = projected_radius(*this, 0.0, 1.0);
+  Segment box;
+  box.x0 = x - rx;
+  box.y0 = y - ry;
+  box.x1 = x + rx;
+  box.y1 = y + ry;
+  return box;
+}
+
+//=============================================================================
+Footprint ModelOverlapChecker::footprint(
+  const Model& model,
+  const vector<EditorModel>& editor_models,
+  const double drawing_meters_per_pixel)
+{
+  Footprint f;
+  if (model.editor_model_idx < 0 ||
+    model.editor_model_idx >= static_cast<int>(editor_models.size()) ||
+    drawing_meters_per_pixel <= 0.0)
+    return f;
+  const EditorModel& editor_model = editor_models[model.editor_model_idx];
+  if (editor_model.pixmap.isNull())
+    return f;
+
+  // as the pixmap item of the model is placed in Model::draw()
+  const double scale =
+    editor_model.meters_per_pixel / drawing_meters_per_pixel;
+  const double angle = -model.state.yaw + M_PI / 2.0;
+  f.valid = true;
+  f.x = model.state.x;
+  f.y = model.state.y;
+  f.cos_angle = std::cos(angle);
+  f.sin_angle = std::sin(angle);
+  f.half_width = 0.5 * editor_model.pixmap.width() * scale;
+  f.half_height = 0.5 * editor_model.pixmap.height() * scale;
+  return f;
+}
+
+bool ModelOverlapChecker::overlap(const Footprint& a, const Footprint& b)
+{
+  // separating axis test, on the sides of both rectangles; models placed
+  // side by side are within rounding of touching, which is fine
+  const double eps = 1e-6;
+  const double dx = b.x - a.x;
+  const double dy = b.y - a.y;
+  const double axes[4][2] = {
+    {a.cos_angle, a.sin_angle},
+    {-a.sin_angle, a.cos_angle},
+    {b.cos_angle, b.sin_angle},
+    {-b.sin_angle, b.cos_angle}
+  };
+  for (const auto& axis : axes)
+  {
+    const double d = std::abs(dx * axis[0] + dy * axis[1]);
+    if (d >= projected_radius(a, axis[0], axis[1]) +
+      projected_radius(b, axis[0], axis[1]) - eps)
+      return false;
+  }
+  return true;
+}
+
+bool ModelOverlapChecker::intersection(
+  const Footprint& f,
+  const Segment& s,
+  double& x,
+  double& y)
+{
+  // clip the segment, in the frame of the rectangle, to the rectangle
+  auto to_local = [&f](
+    const double px,
+    const double py,
+    double& lx,
+    double& ly)
+    {
+      const double dx = px - f.x;
+      const double dy = py - f.y;
+      lx = f.cos_angle * dx + f.sin_angle * dy;
+      ly = -f.sin_angle * dx + f.cos_angle * dy;
+    };
+  double x0 = 0.0;
+  double y0 = 0.0;
+  double x1 = 0.0;
+  double y1 = 0.0;
+  to_local(s.x0, s.y0, x0, y0);
+  to_local(s.x1, s.y1, x1, y1);
+
+  double t0 = 0.0;
+  double t1 = 1.0;
+  const double p[4] = {-(x1 - x0), x1 - x0, -(y1 - y0), y1 - y0};
+  const double q[4] = {
+    x0 + f.half_width,
+    f.half_width - x0,
+    y0 + f.half_height,
+    f.half_height - y0
+  };
+  for (int i = 0; i < 4; i++)
+  {
+    if (p[i] == 0.0)
+    {
+      if (q[i] <= 0.0)
+        return false;  // parallel to this side, and outside it
+      continue;
+    }
+    const double t = q[i] / p[i];
+    if (p[i] < 0.0)
+      t0 = std::max(t0, t);
+    else
+      t1 = std::min(t1, t);
+  }
+  if (t0 >= t1)
+    return false;
+
+  const double t = 0.5 * (t0 + t1);
+  x = s.x0 + t * (s.x1 - s.x0);
+  y = s.y0 + t * (s.y1 - s.y0);
+  return true;
+}
+
+//=============================================================================
+void ModelOverlapChecker::clear()
+{
+  _valid = false;
+  _footprints.clear();
+  _is_lane.clear();
+  _lanes.clear();
+  _model_tree.clear();
+  _lane_tree.clear();
+  _model_conflicts.clear();
+  _conflicts.clear();
+  _num_checked = 0;
+  _num_unknown = 0;
+}
+
+void ModelOverlapChecker::update(
+  const Level& level,
+  const vector<EditorModel>& editor_models)
+{
+  _num_checked = 0;
+  // a thumbnail which has arrived since gives its model a footprint
+  if (_valid && _revision == level.revision() && _num_unknown == 0)
+    return;
+
+  vector<Footprint> footprints(level.models.size());
+  int num_unknown = 0;
+  for (std::size_t i = 0; i < level.models.size(); i++)
+  {
+    footprints[i] = footprint(
+      level.models[i],
+      editor_models,
+      level.drawing_meters_per_pixel);
+    if (!footprints[i].valid)
+      num_unknown++;
+  }
+  _num_unknown = num_unknown;
+
+  const int num_vertices = static_cast<int>(level.vertices.size());
+  vector<char> is_lane(level.edges.size(), 0);
+  vector<Segment> lanes(level.edges.size());
+  for (std::size_t i = 0; i < level.edges.size(); i++)
+  {
+    const Edge& edge = level.edges[i];
+    if ((edge.type != Edge::LANE && edge.type != Edge::HUMAN_LANE) ||
+      edge.start_idx < 0 || edge.start_idx >= num_vertices ||
+      edge.end_idx < 0 || edge.end_idx >= num_vertices)
+      continue;
+    is_lane[i] = 1;
+    lanes[i].x0 = level.vertices[edge.start_idx].x;
+    lanes[i].y0 = level.vertices[edge.start_idx].y;
+    lanes[i].x1 = level.vertices[edge.end_idx].x;
+    lanes[i].y1 = level.vertices[edge.end_idx].y;
+  }
+
+  // a level just opened is bulk-loaded; edits move what changed
+  vector<char> dirty(footprints.size(), 0);
+  vector<Segment> moved;
+  if (!_valid)
+  {
+    vector<std::pair<int, Segment>> boxes;
+    for (std::size_t i = 0; i < footprints.size(); i++)
+    {
+      if (footprints[i].valid)
+        boxes.emplace_back(static_cast<int>(i), footprints[i].bounding_box());
+    }
+    _model_tree.build(boxes);
+
+    vector<std::pair<int, Segment>> segments;
+    for (std::size_t i = 0; i < lanes.size(); i++)
+    {
+      if (is_lane[i])
+        segments.emplace_back(static_cast<int>(i), lanes[i]);
+    }
+    _lane_tree.build(segments);
+    std::fill(dirty.begin(), dirty.end(), 1);
+  }
+  else
+  {
+    const std::size_t num_models =
+      std::max(footprints.size(), _footprints.size());
+    for (std::size_t i = 0; i < num_models; i++)
+    {
+      const Footprint none;
+      const Footprint& before = i < _footprints.size() ? _footprints[i] : none;
+      const Footprint& after = i < footprints.size() ? footprints[i] : none;
+      if (before == after)
+        continue;
+      const int id = static_cast<int>(i);
+      if (before.valid)
+      {
+        moved.push_back(before.bounding_box());
+        _model_tree.remove(id);
+      }
+      if (after.valid)
+      {
+        moved.push_back(after.bounding_box());
+        _model_tree.insert(id, after.bounding_box());
+        dirty[i] = 1;
+      }
+    }
+
+    const std::size_t num_edges = std::max(is_lane.size(), _is_lane.size());
+    for (std::size_t i = 0; i < num_edges; i++)
+    {
+      const bool was_lane = i < _is_lane.size() && _is_lane[i];
+      const bool lane = i < is_lane.size() && is_lane[i];
+      if (was_lane == lane && (!lane || _lanes[i] == lanes[i]))
+        continue;
+      const int id = static_cast<int>(i);
+      if (was_lane)
+      {
+        moved.push_back(bounds(_lanes[i]));
+        _lane_tree.remove(id);
+      }
+      if (lane)
+      {
+        moved.push_back(bounds(lanes[i]));
+        _lane_tree.insert(id, lanes[i]);
+      }
+    }
+  }
+  _footprints = std::move(footprints);
+  _is_lane = std::move(is_lane);
+  _lanes = std::move(lanes);
+  _model_conflicts.resize(_footprints.size());
+
+  // and the models near enough to them to have had or have a conflict
+  vector<int> ids;
+  for (const Segment& box : moved)
+  {
+    ids.clear();
+    _model_tree.intersecting(box.x0, box.y0, box.x1, box.y1, ids);
+    for (const int id : ids)
+      dirty[id] = 1;
+  }
+
+  for (std::size_t i = 0; i < _footprints.size(); i++)
+  {
+    if (!_footprints[i].valid)
+      _model_conflicts[i].clear();
+    else if (dirty[i])
+    {
+      _model_conflicts[i].clear();
+      check_model(static_cast<int>(i), _model_conflicts[i]);
+      _num_checked++;
+    }
+  }
+
+  _conflicts.clear();
+  for (const vector<Conflict>& model_conflicts : _model_conflicts)
+  {
+    for (const Conflict& conflict : model_conflicts)
+    {
+      if (conflict.kind != MODEL_MODEL ||
+        conflict.model_idx < conflict.other_idx)
+        _conflicts.push_back(conflict);
+    }
+  }
+
+  _revision = level.revision();
+  _valid = true;
+}
+
+void ModelOverlapChecker::check_model(
+  const int model_idx,
+  vector<Conflict>& conflicts) const
+{
+  const Footprint& f = _footprints[model_idx];
+  const Segment box = f.bounding_box();
+  vector<int> ids;
+
+  _model_tree.intersecting(box.x0, box.y0, box.x1, box.y1, ids);
+  for (const int other_idx : ids)
+  {
+    const Footprint& other = _footprints[other_idx];
+    if (other_idx == model_idx || !overlap(f, other))
+      continue;
+    Conflict conflict;
+    conflict.kind = MODEL_MODEL;
+    conflict.model_idx = model_idx;
+    conflict.other_idx = other_idx;
+    conflict.x = 0.5 * (f.x + other.x);
+    conflict.y = 0.5 * (f.y + other.y);
+    conflicts.push_back(conflict);
+  }
+
+  ids.clear();
+  _lane_tree.intersecting(box.x0, box.y0, box.x1, box.y1, ids);
+  for (const int edge_idx : ids)
+  {
+    Conflict conflict;
+    conflict.kind = MODEL_LANE;
+    conflict.model_idx = model_idx;
+    conflict.other_idx = edge_idx;
+    if (intersection(f, _lanes[edge_idx], conflict.x, conflict.y))
+      conflicts.push_back(conflict);
+  }
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__MODEL_OVERLAP_CHECKER_HPP
+#define TRAFFIC_EDITOR__MODEL_OVERLAP_CHECKER_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include "segment_rtree.hpp"
+
+class EditorModel;
+class Level;
+class Model;
+
+//=============================================================================
+/// Finds the models of a level which overlap each other or sit on a lane
+/// (or human lane), by their footprints: the rectangle their thumbnail
+/// covers, at EditorModel::meters_per_pixel, turned by their yaw. Models
+/// whose thumbnail isn't loaded yet have no footprint and aren't checked.
+///
+/// As in the LaneConflictChecker, the footprints and lanes are kept in
+/// R-trees between updates, and an update checks again only the models
+/// which moved, or are near something that did, so that the check can
+/// stay on while tens of thousands of models are edited.
+class ModelOverlapChecker
+{
+public:
+  enum Kind
+  {
+    MODEL_MODEL = 0,
+    MODEL_LANE
+  };
+
+  struct Conflict
+  {
+    Kind kind = MODEL_MODEL;
+    int model_idx = -1;
+    int other_idx = -1;  // the other model, or the edge of the lane
+    double x = 0.0;  // where, in scene pixels
+    double y = 0.0;
+  };
+
+  /// An oriented rectangle, in scene pixels
+  struct Footprint
+  {
+    bool valid = false;
+    double x = 0.0;  // of the center
+    double y = 0.0;
+    double cos_angle = 1.0;  // of the rotation of the pixmap item
+    double sin_angle = 0.0;
+    double half_width = 0.0;
+    double half_height = 0.0;
+
+    bool operator==(const Footprint& other) const;
+    bool operator!=(const Footprint& other) const
+    {
+      return !(*this == other);
+    }
+
+    /// Scene coordinates of the corners, counterclockwise from the first
+    void corners(double xs[4], double ys[4]) const;
+
+    /// The diagonal of the axis-aligned bounding box, which is how the
+    /// segment R-tree is made to index boxes
+    SegmentRTree::Segment bounding_box() const;
+  };
+
+  static Footprint footprint(
+    const Model& model,
+    const std::vector<EditorModel>& editor_models,
+    const double drawing_meters_per_pixel);
+
+  /// Whether the footprints overlap by more than touching
+  static bool overlap(const Footprint& a, const Footprint& b);
+
+  /// Whether the segment crosses the footprint, and the middle of the part
+  /// of it inside
+  static bool intersection(
+    const Footprint& footprint,
+    const SegmentRTree::Segment& segment,
+    double& x,
+    double& y);
+
+  /// Bring the conflicts up to date with the models and lanes of the level
+  void update(
+    const Level& level,
+    const std::vector<EditorModel>& editor_models);
+
+  void clear();
+
+  /// Every conflict; a pair of overlapping models is reported once
+  const std::vector<Conflict>& conflicts() const { return _conflicts; }
+
+  /// The footprint of each model, by model index, as last checked
+  const std::vector<Footprint>& footprints() const { return _footprints; }
+
+  /// Number of models the last update() checked again
+  int num_checked() const { return _num_checked; }
+
+  /// Number of models which have no footprint, for lack of a thumbnail
+  int num_unknown() const { return _num_unknown; }
+
+private:
+  bool _valid = false;
+  std::size_t _revision = 0;
+  int _num_checked = 0;
+  int _num_unknown = 0;
+
+  std::vector<Footprint> _footprints;
+  std::vector<char> _is_lane;  // by edge index
+  std::vector<SegmentRTree::Segment> _lanes;
+  SegmentRTree _model_tree;
+  SegmentRTree _lane_tree;
+
+  /// The conflicts of each model, by model index. Overlapping models are
+  /// in the lists of both.
+  std::vector<std::vector<Conflict>> _model_conflicts;
+  std::vector<Conflict> _conflicts;
+
+  void check_model(
+    const int model_idx,
+    std::vector<Conflict>& conflicts) const;
+};
+
+#endif
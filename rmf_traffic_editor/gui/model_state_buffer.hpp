@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__MODEL_STATE_BUFFER_HPP
+#define TRAFFIC_EDITOR__MODEL_STATE_BUFFER_HPP
+
+#include <atomic>
+#include <vector>
+
+#include "model_state.h"
+
+//=============================================================================
+/// Hands snapshots of the model states from one producer thread (the
+/// simulation) to one consumer thread (the GUI) without locks. It is
+/// triple-buffered: the producer fills back() and publish()es it by
+/// swapping it with the spare buffer, and the consumer's update() swaps
+/// the spare for front() if a newer snapshot is waiting. Neither side ever
+/// waits for the other, the consumer never sees a half-written snapshot,
+/// and snapshots published faster than they are read are skipped.
+class ModelStateBuffer
+{
+public:
+  using Snapshot = std::vector<ModelState>;
+
+  /// Producer: the buffer to write the next snapshot into. It holds a
+  /// snapshot from a while ago, so its vectors can be reused.
+  Snapshot& back() { return _buffers[_back]; }
+
+  /// Producer: make back() the latest snapshot
+  void publish()
+  {
+    const int spare = _spare.exchange(_back | FRESH, std::memory_order_acq_rel);
+    _back = spare & INDEX_MASK;
+  }
+
+  /// Consumer: bring front() up to the latest snapshot, if one was
+  /// published since the last update(). Returns whether there was one.
+  bool update()
+  {
+    if (!(_spare.load(std::memory_order_relaxed) & FRESH))
+      return false;
+    const int spare = _spare.exchange(_front, std::memory_order_acq_rel);
+    _front = spare & INDEX_MASK;
+    return true;
+  }
+
+  /// Consumer: the snapshot of the last update()
+  const Snapshot& front() const { return _buffers[_front]; }
+
+private:
+  static const int INDEX_MASK = 3;
+  static const int FRESH = 4;  // set on _spare when it was just published
+
+  Snapshot _buffers[3];
+  int _back = 0;  // only touched by the producer
+  int _front = 1;  // only touched by the consumer
+  std::atomic<int> _spare{2};
+};
+
+#endif
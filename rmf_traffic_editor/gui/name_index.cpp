@@ -0,0 +1,446 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <tuple>
+
+#include <QtConcurrent/QtConcurrent>
+
+#include "building.h"
+#include "name_index.hpp"
+
+namespace {
+
+std::string lowercase(const std::string& s)
+{
+  std::string result(s);
+  for (char& c : result)
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  return result;
+}
+
+/// How well the key matches the (lowercase) query, lower being better,
+/// or -1 if it doesn't
+int match_score(const char* key, const std::size_t size, const std::string& q)
+{
+  if (size < q.size())
+    return -1;
+  if (std::memcmp(key, q.data(), q.size()) == 0)
+    return size == q.size() ? 0 : 1;
+
+  const char* end = key + size;
+  const char* found = std::search(key, end, q.begin(), q.end());
+  if (found != end)
+  {
+    // a match at the start of a word beats one in the middle of it
+    const unsigned char before = static_cast<unsigned char>(found[-1]);
+    return std::isalnum(before) ? 3 : 2;
+  }
+
+  // the characters of the query in order, fewer skipped ones being better
+  const char* first = nullptr;
+  const char* p = key;
+  for (const char c : q)
+  {
+    p = static_cast<const char*>(std::memchr(p, c, end - p));
+    if (!p)
+      return -1;
+    if (!first)
+      first = p;
+    p++;
+  }
+  const std::size_t skipped = (p - first) - q.size();
+  return 4 + static_cast<int>(std::min<std::size_t>(skipped, 1000));
+}
+
+QPointF polygon_center(const Level& level, const Polygon& polygon)
+{
+  QPointF sum;
+  int count = 0;
+  for (const int vertex_idx : polygon.vertices)
+  {
+    if (vertex_idx < 0 ||
+      vertex_idx >= static_cast<int>(level.vertices.size()))
+      continue;
+    sum += QPointF(
+      level.vertices[vertex_idx].x,
+      level.vertices[vertex_idx].y);
+    count++;
+  }
+  return count ? sum / count : sum;
+}
+
+/// The string value of a param, or nothing
+std::string string_param(const ParamMap& params, const std::string& key)
+{
+  const auto it = params.find(key);
+  if (it == params.end() || it->second.type != Param::STRING)
+    return std::string();
+  return it->second.value_string;
+}
+
+}  // namespace
+
+const char* NameIndex::kind_name(const Kind kind)
+{
+  switch (kind)
+  {
+    case VERTEX: return "vertex";
+    case MODEL: return "model";
+    case DOOR: return "door";
+    case LIFT: return "lift";
+    case POLYGON: return "polygon";
+    case FIDUCIAL: return "fiducial";
+    case FEATURE: return "feature";
+  }
+  return "";
+}
+
+NameIndex::NameIndex(QObject* parent)
+: QObject(parent)
+{
+  _watcher = new QFutureWatcher<Section>(this);
+  connect(
+    _watcher,
+    &QFutureWatcher<Section>::finished,
+    this,
+    &NameIndex::finished);
+}
+
+NameIndex::Version NameIndex::level_version(const Level& level)
+{
+  Version version;
+  version.valid = true;
+  version.revision = level.revision();
+  version.level_name = level.name;
+  return version;
+}
+
+NameIndex::Version NameIndex::lifts_version(const Building& building)
+{
+  // the lifts are found on their reference levels, by name
+  Version version;
+  version.valid = true;
+  version.revision = building.lifts_revision();
+  for (const Level& level : building.levels)
+    version.level_name += level.name + "\n";
+  return version;
+}
+
+NameIndex::Section NameIndex::collect_level(
+  const Level& level,
+  const int level_idx)
+{
+  Section section;
+  section.level_idx = level_idx;
+  section.version = level_version(level);
+
+  auto add = [&](
+    const std::string& name,
+    const Kind kind,
+    const Level::SelectedItem& item,
+    const QPointF& p)
+    {
+      if (name.empty())
+        return;
+      Entry entry;
+      entry.name = name;
+      entry.kind = kind;
+      entry.level_idx = level_idx;
+      entry.item = item;
+      entry.x = p.x();
+      entry.y = p.y();
+      section.entries.push_back(std::move(entry));
+    };
+
+  for (std::size_t i = 0; i < level.vertices.size(); i++)
+  {
+    const Vertex& v = level.vertices[i];
+    Level::SelectedItem item;
+    item.vertex_idx = static_cast<int>(i);
+    add(v.name, VERTEX, item, QPointF(v.x, v.y));
+  }
+
+  for (std::size_t i = 0; i < level.models.size(); i++)
+  {
+    const Model& m = level.models[i];
+    Level::SelectedItem item;
+    item.model_idx = static_cast<int>(i);
+    add(m.instance_name, MODEL, item, QPointF(m.state.x, m.state.y));
+  }
+
+  const int num_vertices = static_cast<int>(level.vertices.size());
+  for (std::size_t i = 0; i < level.edges.size(); i++)
+  {
+    const Edge& e = level.edges[i];
+    if (e.type != Edge::DOOR ||
+      e.start_idx < 0 || e.start_idx >= num_vertices ||
+      e.end_idx < 0 || e.end_idx >= num_vertices)
+      continue;
+    const Vertex& start = level.vertices[e.start_idx];
+    const Vertex& end = level.vertices[e.end_idx];
+    Level::SelectedItem item;
+    item.edge_idx = static_cast<int>(i);
+    add(
+      string_param(e.params, "name"),
+      DOOR,
+      item,
+      QPointF((start.x + end.x) / 2.0, (start.y + end.y) / 2.0));
+  }
+
+  for (std::size_t i = 0; i < level.polygons.size(); i++)
+  {
+    const Polygon& polygon = level.polygons[i];
+    Level::SelectedItem item;
+    item.polygon_idx = static_cast<int>(i);
+    add(
+      string_param(polygon.params, "name"),
+      POLYGON,
+      item,
+      polygon_center(level, polygon));
+  }
+
+  for (std::size_t i = 0; i < level.fiducials.size(); i++)
+  {
+    const Fiducial& f = level.fiducials[i];
+    Level::SelectedItem item;
+    item.fiducial_idx = static_cast<int>(i);
+    add(f.name, FIDUCIAL, item, QPointF(f.x, f.y));
+  }
+
+  for (std::size_t i = 0; i < level.floorplan_features.size(); i++)
+  {
+    const Feature& feature = level.floorplan_features[i];
+    Level::SelectedItem item;
+    item.feature_idx = static_cast<int>(i);
+    item.feature_layer_idx = 0;
+    add(feature.name(), FEATURE, item, feature.qpoint());
+  }
+
+  for (std::size_t layer_idx = 0; layer_idx < level.layers.size();
+    layer_idx++)
+  {
+    const Layer& layer = level.layers[layer_idx];
+    for (std::size_t i = 0; i < layer.features.size(); i++)
+    {
+      const Feature& feature = layer.features[i];
+      Level::SelectedItem item;
+      item.feature_idx = static_cast<int>(i);
+      item.feature_layer_idx = static_cast<int>(layer_idx) + 1;
+      add(
+        feature.name(),
+        FEATURE,
+        item,
+        layer.transform.forwards(feature.qpoint()) /
+        level.drawing_meters_per_pixel);
+    }
+  }
+  return section;
+}
+
+NameIndex::Section NameIndex::collect_lifts(const Building& building)
+{
+  Section section;
+  section.version = lifts_version(building);
+  for (const Lift& lift : building.lifts)
+  {
+    if (lift.name.empty())
+      continue;
+    Entry entry;
+    entry.name = lift.name;
+    entry.kind = LIFT;
+    entry.level_idx = 0;
+    for (std::size_t i = 0; i < building.levels.size(); i++)
+    {
+      if (building.levels[i].name == lift.reference_floor_name)
+        entry.level_idx = static_cast<int>(i);
+    }
+    entry.x = lift.x;
+    entry.y = lift.y;
+    section.entries.push_back(std::move(entry));
+  }
+  return section;
+}
+
+NameIndex::Section NameIndex::build_keys(Section section)
+{
+  std::size_t total = 0;
+  for (const Entry& entry : section.entries)
+    total += entry.name.size();
+  section.keys.reserve(total);
+  section.offsets.reserve(section.entries.size() + 1);
+  section.offsets.push_back(0);
+  for (const Entry& entry : section.entries)
+  {
+    section.keys += lowercase(entry.name);
+    section.offsets.push_back(static_cast<std::uint32_t>(section.keys.size()));
+  }
+  return section;
+}
+
+void NameIndex::update(const Building& building)
+{
+  _latest.resize(building.levels.size());
+  for (std::size_t i = 0; i < building.levels.size(); i++)
+  {
+    const Version version = level_version(building.levels[i]);
+    if (version == _latest[i])
+      continue;
+    _latest[i] = version;
+    _queued.push_back(collect_level(building.levels[i], i));
+  }
+
+  const Version version = lifts_version(building);
+  if (version != _latest_lifts)
+  {
+    _latest_lifts = version;
+    _queued.push_back(collect_lifts(building));
+  }
+
+  if (!_watcher->isRunning())
+    start();
+  // otherwise finished() starts the queued ones
+}
+
+void NameIndex::start()
+{
+  // of a level queued twice, only its latest names count
+  std::vector<Section> sections;
+  for (Section& section : _queued)
+  {
+    auto it = std::find_if(
+      sections.begin(),
+      sections.end(),
+      [&section](const Section& other)
+      {
+        return other.level_idx == section.level_idx;
+      });
+    if (it == sections.end())
+      sections.push_back(std::move(section));
+    else
+      *it = std::move(section);
+  }
+  _queued.clear();
+
+  _sections.resize(_latest.size());
+  if (sections.empty())
+    return;
+  _running = std::move(sections);
+  _watcher->setFuture(QtConcurrent::mapped(_running, &NameIndex::build_keys));
+}
+
+void NameIndex::wait()
+{
+  while (_watcher->isRunning())
+  {
+    _watcher->waitForFinished();
+    finished();  // rather than when the signal is delivered
+  }
+}
+
+void NameIndex::finished()
+{
+  if (_running.empty() || _watcher->isRunning())
+    return;  // already collected by wait(), which started another
+
+  const QList<Section> results = _watcher->future().results();
+  _running.clear();
+  for (const Section& section : results)
+  {
+    if (section.level_idx < 0)
+      _lifts = section;
+    else if (section.level_idx < static_cast<int>(_sections.size()))
+      _sections[section.level_idx] = section;
+  }
+  _sections.resize(_latest.size());  // the building may have lost levels
+  emit updated();
+
+  start();  // for any update() that came in while this ran
+}
+
+void NameIndex::clear()
+{
+  _watcher->waitForFinished();
+  _running.clear();
+  _queued.clear();
+  _sections.clear();
+  _lifts = Section();
+  _latest.clear();
+  _latest_lifts = Version();
+}
+
+std::vector<NameIndex::Match> NameIndex::search(
+  const std::string& query,
+  const std::size_t max_matches) const
+{
+  std::vector<Match> matches;
+  const std::string q = lowercase(query);
+  if (q.empty() || max_matches == 0)
+    return matches;
+
+  struct Candidate
+  {
+    int score;
+    std::uint32_t size;
+    const Entry* entry;
+  };
+  std::vector<Candidate> candidates;
+  auto search_section = [&](const Section& section)
+    {
+      for (std::size_t i = 0; i < section.entries.size(); i++)
+      {
+        const std::uint32_t begin = section.offsets[i];
+        const std::uint32_t size = section.offsets[i + 1] - begin;
+        const int score = match_score(section.keys.data() + begin, size, q);
+        if (score >= 0)
+          candidates.push_back(Candidate{score, size, &section.entries[i]});
+      }
+    };
+  for (const Section& section : _sections)
+    search_section(section);
+  search_section(_lifts);
+
+  auto better = [](const Candidate& a, const Candidate& b)
+    {
+      return std::tie(a.score, a.size, a.entry->name, a.entry->level_idx) <
+        std::tie(b.score, b.size, b.entry->name, b.entry->level_idx);
+    };
+  const std::size_t n = std::min(max_matches, candidates.size());
+  std::partial_sort(
+    candidates.begin(),
+    candidates.begin() + n,
+    candidates.end(),
+    better);
+  for (std::size_t i = 0; i < n; i++)
+  {
+    Match match;
+    match.entry = *candidates[i].entry;
+    match.score = candidates[i].score;
+    matches.push_back(std::move(match));
+  }
+  return matches;
+}
+
+std::size_t NameIndex::size() const
+{
+  std::size_t n = _lifts.entries.size();
+  for (const Section& section : _sections)
+    n += section.entries.size();
+  return n;
+}
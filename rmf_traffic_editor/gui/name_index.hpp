@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__NAME_INDEX_HPP
+#define TRAFFIC_EDITOR__NAME_INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <QFutureWatcher>
+#include <QObject>
+
+#include "level.h"
+
+class Building;
+
+//=============================================================================
+/// The names of the vertices, models, doors, polygons, fiducials and
+/// features of every level, and of the lifts, for finding an entity by
+/// name across the building. The names of a level are collected on the
+/// calling thread, and only for the levels which changed since they were
+/// indexed (see Level::revision()); the search keys are then built on the
+/// worker pool. search() matches prefixes, substrings and, failing those,
+/// the characters of the query in order ("ch23" finds charger_23).
+class NameIndex : public QObject
+{
+  Q_OBJECT
+
+public:
+  enum Kind
+  {
+    VERTEX = 0,
+    MODEL,
+    DOOR,
+    LIFT,
+    POLYGON,
+    FIDUCIAL,
+    FEATURE
+  };
+
+  static const char* kind_name(const Kind kind);
+
+  struct Entry
+  {
+    std::string name;
+    Kind kind = VERTEX;
+    int level_idx = -1;
+    Level::SelectedItem item;  // what to select; nothing for a lift
+    double x = 0.0;  // in the pixels of the level
+    double y = 0.0;
+  };
+
+  struct Match
+  {
+    Entry entry;
+    int score = 0;  // 0 for the name itself; lower is better
+  };
+
+  explicit NameIndex(QObject* parent = nullptr);
+
+  /// Start indexing the levels (and lifts) which changed since they were
+  /// indexed. If that is already running, these are indexed after it.
+  void update(const Building& building);
+
+  bool is_busy() const { return _watcher->isRunning(); }
+
+  /// Until the indexing started by update() has finished
+  void wait();
+
+  /// Forget everything, e.g. because another building was loaded
+  void clear();
+
+  /// The best matches for the query, best first. Case is ignored.
+  std::vector<Match> search(
+    const std::string& query,
+    const std::size_t max_matches) const;
+
+  std::size_t size() const;
+
+signals:
+  /// Some levels were indexed
+  void updated();
+
+private:
+  /// What a level (or the lifts) was indexed from
+  struct Version
+  {
+    bool valid = false;
+    std::size_t revision = 0;
+    std::string level_name;
+
+    bool operator==(const Version& other) const
+    {
+      return valid == other.valid && revision == other.revision &&
+        level_name == other.level_name;
+    }
+    bool operator!=(const Version& other) const { return !(*this == other); }
+  };
+
+  /// The names of one level, or of the lifts, with their lowercase search
+  /// keys packed into one string: key i is keys[offsets[i], offsets[i+1])
+  struct Section
+  {
+    int level_idx = -1;  // -1 for the lifts
+    Version version;
+    std::vector<Entry> entries;
+    std::string keys;
+    std::vector<std::uint32_t> offsets;
+  };
+
+  std::vector<Section> _sections;  // by level
+  Section _lifts;
+  std::vector<Version> _latest;  // of the levels as of the last update()
+  Version _latest_lifts;
+  std::vector<Section> _queued;
+  std::vector<Section> _running;
+  QFutureWatcher<Section>* _watcher = nullptr;
+
+  static Section collect_level(const Level& level, const int level_idx);
+  static Section collect_lifts(const Building& building);
+  static Section build_keys(Section section);
+  static Version level_version(const Level& level);
+  static Version lifts_version(const Building& building);
+
+  void start();
+  void finished();
+};
+
+#endif
@@ -0,0 +1,591 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include <cmath>
+#include <map>
+#include <set>
+
+#include <QByteArray>
+#include <QDir>
+#include <QSaveFile>
+
+#include <yaml-cpp/yaml.h>
+
+#include "building.h"
+#include "lane_path_planner.hpp"
+#include "logging.hpp"
+#include "nav_graph_exporter.hpp"
+#include "route_hierarchy.hpp"
+#include "string_table.hpp"
+
+namespace {
+
+static_assert(sizeof(NavGraphExporter::FileHeader) == 64, "header layout");
+static_assert(sizeof(NavGraphExporter::LevelRecord) == 32, "level layout");
+static_assert(sizeof(NavGraphExporter::VertexRecord) == 48, "vertex layout");
+static_assert(sizeof(NavGraphExporter::LaneRecord) == 40, "lane layout");
+
+/// From the pixels of a level to meters in the frame of the nav graph
+struct LevelFrame
+{
+  double scale = 1.0;
+  double dx = 0.0;
+  double dy = 0.0;
+  double meters_per_pixel = 1.0;
+  bool y_flipped = false;
+
+  QPointF to_meters(const double x, const double y) const
+  {
+    const double mx = (x * scale + dx) * meters_per_pixel;
+    const double my = (y * scale + dy) * meters_per_pixel;
+    return QPointF(mx, y_flipped ? -my : my);
+  }
+};
+
+YAML::Node param_value(const Param& param)
+{
+  switch (param.type)
+  {
+    case Param::STRING: return YAML::Node(param.value_string);
+    case Param::INT: return YAML::Node(param.value_int);
+    case Param::DOUBLE: return YAML::Node(param.value_double);
+    case Param::BOOL: return YAML::Node(param.value_bool);
+    default: return YAML::Node();
+  }
+}
+
+double param_double(const Param& param)
+{
+  if (param.type == Param::INT)
+    return param.value_int;
+  return param.type == Param::DOUBLE ? param.value_double : 0.0;
+}
+
+std::string param_string(const ParamMap& params, const std::string& key)
+{
+  auto it = params.find(key);
+  if (it == params.end() || it->second.type != Param::STRING)
+    return std::string();
+  return it->second.value_string;
+}
+
+/// As segments_intersect() of building_map_tools, so that the same lanes
+/// get the door: nearly parallel segments never intersect
+bool segments_intersect(
+  const Vertex& v1,
+  const Vertex& v2,
+  const Vertex& v3,
+  const Vertex& v4)
+{
+  const double det =
+    (v1.x - v2.x) * (v3.y - v4.y) - (v1.y - v2.y) * (v3.x - v4.x);
+  if (std::abs(det) < 0.01)
+    return false;
+  const double t =
+    ((v1.x - v3.x) * (v3.y - v4.y) - (v1.y - v3.y) * (v3.x - v4.x)) / det;
+  const double u =
+    -((v1.x - v2.x) * (v1.y - v3.y) - (v1.y - v2.y) * (v1.x - v3.x)) / det;
+  return t >= 0.0 && t <= 1.0 && u >= 0.0 && u <= 1.0;
+}
+
+std::string reverse_orientation(const std::string& orientation)
+{
+  if (orientation == "forward")
+    return "backward";
+  if (orientation == "backward")
+    return "forward";
+  return std::string();
+}
+
+uint32_t orientation_flags(const std::string& orientation)
+{
+  if (orientation == "forward")
+    return NavGraphExporter::ORIENTATION_FORWARD;
+  if (orientation == "backward")
+    return NavGraphExporter::ORIENTATION_BACKWARD;
+  return 0;
+}
+
+/// The lift whose cabin contains this point, in meters, or nullptr
+const Lift* find_lift(
+  const Building& building,
+  const LevelFrame& reference_frame,
+  const int level_idx,
+  const QPointF& p)
+{
+  for (const Lift& lift : building.lifts)
+  {
+    if (!lift.reaches_level(level_idx))
+      continue;
+    const QPointF center = reference_frame.to_meters(lift.x, lift.y);
+    const double dx = p.x() - center.x();
+    const double dy = p.y() - center.y();
+    const double c = std::cos(lift.yaw);
+    const double s = std::sin(lift.yaw);
+    if (std::abs(c * dx + s * dy) <= lift.width / 2.0 &&
+      std::abs(-s * dx + c * dy) <= lift.depth / 2.0)
+      return &lift;
+  }
+  return nullptr;
+}
+
+/// The arcs of the lanes and lift rides of a graph, over its vertex
+/// records, costed as LanePathPlanner costs them
+std::vector<RouteHierarchy::Arc> route_arcs(
+  const std::vector<NavGraphExporter::LevelRecord>& levels,
+  const std::vector<NavGraphExporter::VertexRecord>& vertices,
+  const std::vector<NavGraphExporter::LaneRecord>& lanes)
+{
+  const LanePathPlanner::Options options;
+  std::vector<RouteHierarchy::Arc> arcs;
+  for (const NavGraphExporter::LaneRecord& lane : lanes)
+  {
+    const NavGraphExporter::VertexRecord& start = vertices[lane.start];
+    const NavGraphExporter::VertexRecord& end = vertices[lane.end];
+    double speed = options.speed;
+    if (lane.speed_limit > 0.0)
+      speed = std::min(speed, lane.speed_limit);
+    RouteHierarchy::Arc arc;
+    arc.from = lane.start;
+    arc.to = lane.end;
+    arc.length = static_cast<float>(
+      std::hypot(end.x - start.x, end.y - start.y));
+    arc.time = static_cast<float>(arc.length / std::max(speed, 1e-3));
+    arcs.push_back(arc);
+  }
+
+  // the strings are unique, so the vertices of a lift share its string
+  std::map<uint32_t, std::vector<uint32_t>> lift_vertices;
+  for (std::size_t i = 0; i < vertices.size(); i++)
+  {
+    if (vertices[i].lift)
+      lift_vertices[vertices[i].lift].push_back(static_cast<uint32_t>(i));
+  }
+  const double lift_speed = std::max(options.lift_speed, 1e-3);
+  for (const auto& lift : lift_vertices)
+  {
+    for (const uint32_t from : lift.second)
+    {
+      for (const uint32_t to : lift.second)
+      {
+        if (vertices[from].level == vertices[to].level)
+          continue;
+        RouteHierarchy::Arc arc;
+        arc.from = from;
+        arc.to = to;
+        arc.time = static_cast<float>(
+          options.lift_wait +
+          std::abs(
+            levels[vertices[to].level].elevation -
+            levels[vertices[from].level].elevation) / lift_speed);
+        arcs.push_back(arc);
+      }
+    }
+  }
+  return arcs;
+}
+
+bool write_file(const QString& path, const QByteArray& data)
+{
+  QSaveFile file(path);
+  if (!file.open(QIODevice::WriteOnly) ||
+    file.write(data) != data.size() ||
+    !file.commit())
+  {
+    qCWarning(lc_io, "unable to write %s", qUtf8Printable(path));
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+bool NavGraphExporter::export_graphs(
+  Building& building,
+  const std::string& dir,
+  std::vector<std::string>* written)
+{
+  const CoordinateSystem& crs = building.coordinate_system;
+  if (crs.value == CoordinateSystem::WebMercator)
+  {
+    qCWarning(lc_io,
+      "nav graphs of web Mercator buildings need a CRS projection");
+    return false;
+  }
+
+  // the frames come first: the transforms are computed non-const
+  const bool pixels = crs.value != CoordinateSystem::CartesianMeters;
+  std::vector<LevelFrame> frames(building.levels.size());
+  LevelFrame reference_frame;
+  if (pixels && !building.levels.empty())
+  {
+    const int reference_idx = building.get_reference_level_idx();
+    reference_frame.meters_per_pixel =
+      building.levels[reference_idx].drawing_meters_per_pixel;
+    reference_frame.y_flipped = crs.is_y_flipped();
+    for (std::size_t i = 0; i < frames.size(); i++)
+    {
+      const Building::Transform t =
+        building.get_transform_to_reference(static_cast<int>(i));
+      frames[i] = reference_frame;
+      frames[i].scale = t.scale;
+      frames[i].dx = t.dx;
+      frames[i].dy = t.dy;
+    }
+  }
+
+  const Building& b = building;
+  std::set<int> graph_indices;
+  for (const Level& level : b.levels)
+  {
+    for (const auto& bucket : level.lane_buckets())
+    {
+      for (const int edge_idx : bucket.second)
+      {
+        if (level.edges[edge_idx].type == Edge::LANE)
+        {
+          graph_indices.insert(bucket.first);
+          break;
+        }
+      }
+    }
+  }
+
+  bool ok = true;
+  for (const int graph_idx : graph_indices)
+  {
+    YAML::Node graph_node(YAML::NodeType::Map);
+    graph_node["building_name"] = b.name;
+    if (!pixels)
+    {
+      const std::string crs_name = param_string(b.params, "generate_crs");
+      if (!crs_name.empty())
+        graph_node["crs_name"] = crs_name;
+    }
+    YAML::Node levels_node(YAML::NodeType::Map);
+
+    StringTable strings;
+    std::vector<LevelRecord> level_records;
+    std::vector<VertexRecord> vertex_records;
+    std::vector<LaneRecord> lane_records;
+
+    for (std::size_t level_idx = 0; level_idx < b.levels.size(); level_idx++)
+    {
+      const Level& level = b.levels[level_idx];
+      const int n_vertices = static_cast<int>(level.vertices.size());
+      // only the lanes of this graph are visited, in the order of edges
+      const std::vector<int>& graph_lanes = level.graph_lanes(graph_idx);
+      auto in_graph = [n_vertices](const Edge& edge)
+        {
+          return edge.type == Edge::LANE &&
+            edge.start_idx >= 0 && edge.start_idx < n_vertices &&
+            edge.end_idx >= 0 && edge.end_idx < n_vertices;
+        };
+
+      LevelRecord level_record;
+      level_record.name = strings.add(level.name);
+      level_record.first_vertex =
+        static_cast<uint32_t>(vertex_records.size());
+      level_record.first_lane = static_cast<uint32_t>(lane_records.size());
+      level_record.reserved = 0;
+      level_record.elevation = level.elevation;
+
+      // only the vertices which the lanes use, in order of first use
+      std::vector<int> mapped(level.vertices.size(), -1);
+      std::vector<int> used;
+      for (const int edge_idx : graph_lanes)
+      {
+        const Edge& edge = level.edges[edge_idx];
+        if (!in_graph(edge))
+          continue;
+        for (const int vertex_idx : {edge.start_idx, edge.end_idx})
+        {
+          if (mapped[vertex_idx] < 0)
+          {
+            mapped[vertex_idx] = static_cast<int>(used.size());
+            used.push_back(vertex_idx);
+          }
+        }
+      }
+
+      YAML::Node vertices_node(YAML::NodeType::Sequence);
+      for (const int vertex_idx : used)
+      {
+        const Vertex& v = level.vertices[vertex_idx];
+        const QPointF p = frames[level_idx].to_meters(v.x, v.y);
+        const Lift* lift = find_lift(
+          b, reference_frame, static_cast<int>(level_idx), p);
+
+        YAML::Node params_node(YAML::NodeType::Map);
+        params_node["name"] = v.name;
+        for (const auto& param : v.params)
+          params_node[param.first] = param_value(param.second);
+        if (lift)
+          params_node["lift"] = lift->name;
+
+        YAML::Node vertex_node(YAML::NodeType::Sequence);
+        vertex_node.push_back(p.x());
+        vertex_node.push_back(p.y());
+        vertex_node.push_back(params_node);
+        vertex_node.SetStyle(YAML::EmitterStyle::Flow);
+        vertices_node.push_back(vertex_node);
+
+        VertexRecord record;
+        record.x = p.x();
+        record.y = p.y();
+        record.level = static_cast<uint32_t>(level_idx);
+        record.flags = v.capabilities() | (lift ? Vertex::LIFT_CABIN : 0);
+        record.name = strings.add(v.name);
+        record.lift = strings.add(lift ? lift->name : v.lift_cabin());
+        record.dock_name = strings.add(param_string(v.params, "dock_name"));
+        record.pickup_dispenser = strings.add(v.pickup_dispenser());
+        record.dropoff_ingestor = strings.add(v.dropoff_ingestor());
+        record.reserved = 0;
+        vertex_records.push_back(record);
+      }
+
+      YAML::Node lanes_node(YAML::NodeType::Sequence);
+      auto add_lane = [&](
+        const int start,
+        const int end,
+        const YAML::Node& params_node,
+        LaneRecord record)
+        {
+          YAML::Node lane_node(YAML::NodeType::Sequence);
+          lane_node.push_back(start);
+          lane_node.push_back(end);
+          lane_node.push_back(params_node);
+          lane_node.SetStyle(YAML::EmitterStyle::Flow);
+          lanes_node.push_back(lane_node);
+
+          record.start = level_record.first_vertex + start;
+          record.end = level_record.first_vertex + end;
+          lane_records.push_back(record);
+        };
+
+      for (const int edge_idx : graph_lanes)
+      {
+        const Edge& edge = level.edges[edge_idx];
+        if (!in_graph(edge))
+          continue;
+        const Vertex& v1 = level.vertices[edge.start_idx];
+        const Vertex& v2 = level.vertices[edge.end_idx];
+        const int start = mapped[edge.start_idx];
+        const int end = mapped[edge.end_idx];
+
+        YAML::Node p(YAML::NodeType::Map);
+        LaneRecord record = LaneRecord();
+
+        // the last door which it crosses, as in building_map_tools
+        std::string door_name;
+        for (const Edge& door : level.edges)
+        {
+          if (door.type != Edge::DOOR ||
+            door.start_idx < 0 || door.start_idx >= n_vertices ||
+            door.end_idx < 0 || door.end_idx >= n_vertices)
+            continue;
+          if (segments_intersect(
+              v1, v2,
+              level.vertices[door.start_idx],
+              level.vertices[door.end_idx]))
+            door_name = param_string(door.params, "name");
+        }
+        if (!door_name.empty())
+          p["door_name"] = door_name;
+        record.door = strings.add(door_name);
+
+        const std::string& orientation = edge.get_orientation();
+        if (!orientation.empty())
+          p["orientation_constraint"] = orientation;
+        record.flags = orientation_flags(orientation);
+
+        auto speed_it = edge.params.find("speed_limit");
+        if (speed_it != edge.params.end())
+        {
+          p["speed_limit"] = param_value(speed_it->second);
+          record.speed_limit = param_double(speed_it->second);
+        }
+
+        for (const char* key : {"demo_mock_floor_name", "demo_mock_lift_name"})
+        {
+          const std::string value = param_string(edge.params, key);
+          if (!value.empty())
+            p[key] = value;
+        }
+        record.demo_mock_floor_name =
+          strings.add(param_string(edge.params, "demo_mock_floor_name"));
+        record.demo_mock_lift_name =
+          strings.add(param_string(edge.params, "demo_mock_lift_name"));
+
+        // a lane ending at a dock docks into it, and one starting at a
+        // dock undocks from it
+        std::string dock_name = param_string(v2.params, "dock_name");
+        bool dock_at_end = true;
+        if (dock_name.empty())
+        {
+          dock_name = param_string(v1.params, "dock_name");
+          dock_at_end = false;
+        }
+        const uint32_t dock = strings.add(dock_name);
+
+        if (edge.is_bidirectional())
+        {
+          YAML::Node forward = YAML::Clone(p);
+          YAML::Node backward = YAML::Clone(p);
+          LaneRecord forward_record = record;
+          LaneRecord backward_record = record;
+          forward_record.flags |= BIDIRECTIONAL;
+          backward_record.flags = BIDIRECTIONAL |
+            orientation_flags(reverse_orientation(orientation));
+          if (!dock_name.empty())
+          {
+            forward[dock_at_end ? "dock_name" : "undock_name"] = dock_name;
+            backward[dock_at_end ? "undock_name" : "dock_name"] = dock_name;
+            if (dock_at_end)
+            {
+              forward_record.dock_name = dock;
+              backward_record.undock_name = dock;
+            }
+            else
+            {
+              forward_record.undock_name = dock;
+              backward_record.dock_name = dock;
+            }
+          }
+          if (!orientation.empty())
+            backward["orientation_constraint"] =
+              reverse_orientation(orientation);
+          add_lane(start, end, forward, forward_record);
+          add_lane(end, start, backward, backward_record);
+        }
+        else
+        {
+          p["is_bidirectional"] = false;
+          if (!dock_name.empty())
+          {
+            p["dock_name"] = dock_name;
+            record.dock_name = dock;
+          }
+          add_lane(start, end, p, record);
+        }
+      }
+
+      level_record.num_vertices =
+        static_cast<uint32_t>(vertex_records.size()) -
+        level_record.first_vertex;
+      level_record.num_lanes =
+        static_cast<uint32_t>(lane_records.size()) - level_record.first_lane;
+      level_records.push_back(level_record);
+
+      YAML::Node level_node(YAML::NodeType::Map);
+      level_node["lanes"] = lanes_node;
+      level_node["vertices"] = vertices_node;
+      levels_node[level.name] = level_node;
+    }
+
+    graph_node["levels"] = levels_node;
+    if (!pixels)
+    {
+      auto offset_x = b.params.find("offset_x");
+      auto offset_y = b.params.find("offset_y");
+      YAML::Node offset_node(YAML::NodeType::Sequence);
+      offset_node.push_back(
+        offset_x != b.params.end() ? param_double(offset_x->second) : 0.0);
+      offset_node.push_back(
+        offset_y != b.params.end() ? param_double(offset_y->second) : 0.0);
+      offset_node.SetStyle(YAML::EmitterStyle::Flow);
+      graph_node["offset"] = offset_node;
+    }
+
+    const QString base =
+      QDir(QString::fromStdString(dir)).filePath(QString::number(graph_idx));
+
+    YAML::Emitter emitter;
+    emitter << graph_node;
+    QByteArray text(emitter.c_str());
+    text.append('\n');
+    const QString yaml_path = base + ".yaml";
+    if (emitter.good() && write_file(yaml_path, text))
+    {
+      if (written)
+        written->push_back(yaml_path.toStdString());
+    }
+    else
+      ok = false;
+
+    FileHeader header;
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.graph_idx = graph_idx;
+    header.building_name = strings.add(b.name);
+    header.num_levels = static_cast<uint32_t>(level_records.size());
+    header.num_vertices = static_cast<uint32_t>(vertex_records.size());
+    header.num_lanes = static_cast<uint32_t>(lane_records.size());
+    header.num_strings = strings.size();
+    header.levels_offset = sizeof(FileHeader);
+    header.vertices_offset =
+      header.levels_offset + level_records.size() * sizeof(LevelRecord);
+    header.lanes_offset =
+      header.vertices_offset + vertex_records.size() * sizeof(VertexRecord);
+    header.strings_offset =
+      header.lanes_offset + lane_records.size() * sizeof(LaneRecord);
+
+    QByteArray data;
+    data.reserve(static_cast<int>(header.strings_offset));
+    data.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    data.append(
+      reinterpret_cast<const char*>(level_records.data()),
+      static_cast<int>(level_records.size() * sizeof(LevelRecord)));
+    data.append(
+      reinterpret_cast<const char*>(vertex_records.data()),
+      static_cast<int>(vertex_records.size() * sizeof(VertexRecord)));
+    data.append(
+      reinterpret_cast<const char*>(lane_records.data()),
+      static_cast<int>(lane_records.size() * sizeof(LaneRecord)));
+    strings.append_to(data);
+
+    const QString nav_path = base + ".navgraph";
+    if (write_file(nav_path, data))
+    {
+      if (written)
+        written->push_back(nav_path.toStdString());
+    }
+    else
+      ok = false;
+
+    RouteHierarchy hierarchy;
+    hierarchy.build(
+      header.num_vertices,
+      route_arcs(level_records, vertex_records, lane_records));
+    const QString routes_path = base + ".routes";
+    if (write_file(routes_path, hierarchy.to_binary(graph_idx)))
+    {
+      if (written)
+        written->push_back(routes_path.toStdString());
+    }
+    else
+      ok = false;
+
+    qCDebug(lc_io, "nav graph %d: %u vertices, %u lanes, %zu shortcuts",
+      graph_idx,
+      header.num_vertices,
+      header.num_lanes,
+      hierarchy.num_shortcuts());
+  }
+  return ok;
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef TRAFFIC_EDITOR__NAV_GRAPH_EXPORTER_HPP
+#define TRAFFIC_EDITOR__NAV_GRAPH_EXPORTER_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Building;
+
+//=============================================================================
+/// Writes the navigation graphs of a building, as the fleet adapters read
+/// them, straight from the editor's data. For each graph with lanes there
+/// is the standard YAML nav graph, <idx>.yaml, as generate_nav_graphs() of
+/// building_map_tools writes it, and the same graph in a compact binary
+/// file, <idx>.navgraph, which a reader can mmap and index without parsing.
+///
+/// The binary file is a FileHeader, then a LevelRecord for each level, a
+/// VertexRecord for each vertex which a lane of the graph uses (level by
+/// level), a LaneRecord for each directed lane (bidirectional lanes are
+/// split in two, as in the YAML) and a string table: num_strings + 1
+/// uint32 offsets into the NUL-terminated UTF-8 strings which follow. The
+/// records are in host byte order (little-endian on every platform the
+/// editor runs on) and 8-byte aligned. String 0 is the empty string, so a
+/// reference of 0 means none. Readers should check the magic and version.
+///
+/// With them goes <idx>.routes, a RouteHierarchy over the vertex records,
+/// with the lanes and lift rides costed at the LanePathPlanner defaults,
+/// so that a reader can answer route queries without contracting.
+class NavGraphExporter
+{
+public:
+  static const uint32_t MAGIC = 0x4e564752;  // "RGVN" on disk
+  static const uint32_t VERSION = 1;
+
+  struct FileHeader
+  {
+    uint32_t magic;
+    uint32_t version;
+    int32_t graph_idx;
+    uint32_t building_name;  // string
+    uint32_t num_levels;
+    uint32_t num_vertices;
+    uint32_t num_lanes;
+    uint32_t num_strings;
+    uint64_t levels_offset;  // bytes from the start of the file
+    uint64_t vertices_offset;
+    uint64_t lanes_offset;
+    uint64_t strings_offset;  // of the string offset table
+  };
+
+  struct LevelRecord
+  {
+    uint32_t name;  // string
+    uint32_t first_vertex;
+    uint32_t num_vertices;
+    uint32_t first_lane;
+    uint32_t num_lanes;
+    uint32_t reserved;
+    double elevation;  // meters
+  };
+
+  /// flags are the Vertex::Capability bits; LIFT_CABIN is also set for a
+  /// vertex inside the cabin of a lift which reaches its level
+  struct VertexRecord
+  {
+    double x;  // meters
+    double y;
+    uint32_t level;
+    uint32_t flags;
+    uint32_t name;  // string
+    uint32_t lift;  // string: the lift it is in
+    uint32_t dock_name;  // string
+    uint32_t pickup_dispenser;  // string
+    uint32_t dropoff_ingestor;  // string
+    uint32_t reserved;
+  };
+
+  enum LaneFlag
+  {
+    ORIENTATION_FORWARD = 1 << 0,
+    ORIENTATION_BACKWARD = 1 << 1,
+    BIDIRECTIONAL = 1 << 2,  // one half of a lane which was bidirectional
+  };
+
+  struct LaneRecord
+  {
+    uint32_t start;  // vertex
+    uint32_t end;
+    uint32_t flags;
+    uint32_t door;  // string: the name of a door the lane passes through
+    uint32_t dock_name;  // string
+    uint32_t undock_name;  // string
+    uint32_t demo_mock_floor_name;  // string
+    uint32_t demo_mock_lift_name;  // string
+    double speed_limit;  // m/s, 0 for none
+  };
+
+  /// Write the files of every graph with lanes into dir, which must exist.
+  /// Returns false, having written what it could, if a file couldn't be
+  /// written or the coordinate system can't be exported natively (web
+  /// Mercator needs a CRS projection, for which use the Python tools).
+  /// The paths written are appended to written, if given.
+  static bool export_graphs(
+    Building& building,
+    const std::string& dir,
+    std::vector<std::string>* written = nullptr);
+};
+
+#endif
@@ -0,0 +1,474 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "level.h"
+#include "navmesh_builder.hpp"
+
+using std::vector;
+
+namespace {
+
+typedef NavmeshBuilder::Point Point;
+
+Point to_meters(const Vertex& v, const double meters_per_pixel)
+{
+  Point p;
+  p.x = v.x * meters_per_pixel;
+  p.y = -v.y * meters_per_pixel;
+  return p;
+}
+
+double cross(const Point& o, const Point& a, const Point& b)
+{
+  return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+}
+
+/// Andrew's monotone chain, counter-clockwise
+vector<Point> convex_hull(vector<Point> points)
+{
+  std::sort(
+    points.begin(),
+    points.end(),
+    [](const Point& a, const Point& b)
+    {
+      return a.x < b.x || (a.x == b.x && a.y < b.y);
+    });
+  if (points.size() < 3)
+    return points;
+
+  vector<Point> hull(2 * points.size());
+  std::size_t k = 0;
+  for (std::size_t i = 0; i < points.size(); i++)
+  {
+    while (k >= 2 && cross(hull[k - 2], hull[k - 1], points[i]) <= 0)
+      k--;
+    hull[k++] = points[i];
+  }
+  for (std::size_t i = points.size() - 1, t = k + 1; i > 0; i--)
+  {
+    while (k >= t && cross(hull[k - 2], hull[k - 1], points[i - 1]) <= 0)
+      k--;
+    hull[k++] = points[i - 1];
+  }
+  hull.resize(k - 1);
+  return hull;
+}
+
+/// Vertices closer than a millimeter are merged, so that the sides which
+/// a lane and a junction share end up with the same vertex indices
+const double MERGE_DISTANCE = 0.001;
+
+}  // anonymous namespace
+
+//=============================================================================
+bool NavmeshBuilder::LaneKey::operator==(const LaneKey& other) const
+{
+  return start_idx == other.start_idx && end_idx == other.end_idx &&
+    x0 == other.x0 && y0 == other.y0 && x1 == other.x1 && y1 == other.y1 &&
+    half_width == other.half_width;
+}
+
+//=============================================================================
+void NavmeshBuilder::clear()
+{
+  _lanes.clear();
+  _junctions.clear();
+  _num_rebuilt = 0;
+  _vertices.clear();
+  _nodes.clear();
+  _edges.clear();
+  _obstacles.clear();
+}
+
+bool NavmeshBuilder::build(const Level& level)
+{
+  _num_rebuilt = 0;
+  if (level.drawing_meters_per_pixel != _meters_per_pixel)
+  {
+    // every cached position would be stale
+    clear();
+    _meters_per_pixel = level.drawing_meters_per_pixel;
+  }
+  _elevation = level.elevation;
+
+  // the lanes as they are now, and which of them meet at each vertex
+  std::map<int, LaneKey> keys;
+  std::map<int, vector<int>> vertex_lanes;
+  const int num_vertices = static_cast<int>(level.vertices.size());
+  for (std::size_t i = 0; i < level.edges.size(); i++)
+  {
+    const ::Edge& edge = level.edges[i];
+    if (edge.type != ::Edge::HUMAN_LANE ||
+      edge.start_idx < 0 || edge.start_idx >= num_vertices ||
+      edge.end_idx < 0 || edge.end_idx >= num_vertices ||
+      edge.start_idx == edge.end_idx)
+      continue;
+
+    const Point p0 =
+      to_meters(level.vertices[edge.start_idx], _meters_per_pixel);
+    const Point p1 =
+      to_meters(level.vertices[edge.end_idx], _meters_per_pixel);
+    LaneKey key;
+    key.start_idx = edge.start_idx;
+    key.end_idx = edge.end_idx;
+    key.x0 = p0.x;
+    key.y0 = p0.y;
+    key.x1 = p1.x;
+    key.y1 = p1.y;
+    key.half_width = edge.get_width() / 2.0;
+    keys[i] = key;
+    vertex_lanes[edge.start_idx].push_back(i);
+    vertex_lanes[edge.end_idx].push_back(i);
+  }
+
+  // drop whatever no longer exists
+  for (auto it = _lanes.begin(); it != _lanes.end(); )
+  {
+    if (keys.count(it->first))
+      ++it;
+    else
+      it = _lanes.erase(it);
+  }
+  for (auto it = _junctions.begin(); it != _junctions.end(); )
+  {
+    auto vit = vertex_lanes.find(it->first);
+    if (vit != vertex_lanes.end() && vit->second.size() >= 2)
+      ++it;
+    else
+      it = _junctions.erase(it);
+  }
+
+  // a lane needs rebuilding if it moved or if a junction at its end did
+  std::map<int, bool> lane_dirty;
+  for (const auto& k : keys)
+  {
+    auto it = _lanes.find(k.first);
+    lane_dirty[k.first] = it == _lanes.end() || !(it->second.key == k.second);
+  }
+
+  // the distance at which lanes stop short of each vertex
+  std::map<int, double> pull_backs;
+  for (const auto& vl : vertex_lanes)
+  {
+    const int vertex_idx = vl.first;
+    const vector<int>& lanes = vl.second;
+    if (lanes.size() < 2)
+      continue;
+
+    vector<LaneKey> lane_keys;
+    for (const int lane_idx : lanes)
+      lane_keys.push_back(keys[lane_idx]);
+
+    auto jit = _junctions.find(vertex_idx);
+    const bool dirty = jit == _junctions.end() ||
+      jit->second.lanes != lanes || jit->second.keys != lane_keys;
+
+    // lanes have to stop where their sides no longer overlap those of the
+    // lane next to them, which takes longer the narrower the angle is
+    double half_width = 0.0;
+    vector<double> angles;
+    for (const LaneKey& key : lane_keys)
+    {
+      half_width = std::max(half_width, key.half_width);
+      const bool at_start = key.start_idx == vertex_idx;
+      const double dx = at_start ? key.x1 - key.x0 : key.x0 - key.x1;
+      const double dy = at_start ? key.y1 - key.y0 : key.y0 - key.y1;
+      angles.push_back(std::atan2(dy, dx));
+    }
+    std::sort(angles.begin(), angles.end());
+    double min_angle = 2.0 * M_PI + angles.front() - angles.back();
+    for (std::size_t i = 1; i < angles.size(); i++)
+      min_angle = std::min(min_angle, angles[i] - angles[i - 1]);
+
+    double pull_back = half_width;
+    if (min_angle > 1e-6 && min_angle < M_PI)
+      pull_back = std::max(pull_back, half_width / std::tan(min_angle / 2.0));
+    pull_back = std::min(pull_back, 5.0 * half_width);
+    pull_backs[vertex_idx] = pull_back;
+
+    if (!dirty)
+      continue;
+    Junction& junction = _junctions[vertex_idx];
+    junction.lanes = lanes;
+    junction.keys = lane_keys;
+    junction.polygon.clear();
+    for (const int lane_idx : lanes)
+      lane_dirty[lane_idx] = true;
+    _num_rebuilt++;
+  }
+
+  for (const auto& ld : lane_dirty)
+  {
+    if (!ld.second)
+      continue;
+    const LaneKey& key = keys[ld.first];
+    Lane& lane = _lanes[ld.first];
+    lane.key = key;
+
+    auto p0 = pull_backs.find(key.start_idx);
+    auto p1 = pull_backs.find(key.end_idx);
+    lane.pull_back[0] = p0 == pull_backs.end() ? 0.0 : p0->second;
+    lane.pull_back[1] = p1 == pull_backs.end() ? 0.0 : p1->second;
+
+    const double dx = key.x1 - key.x0;
+    const double dy = key.y1 - key.y0;
+    const double length = std::sqrt(dx * dx + dy * dy);
+    lane.valid = length > lane.pull_back[0] + lane.pull_back[1] + 1e-6;
+    if (length < 1e-9)
+      continue;
+
+    const double ux = dx / length;
+    const double uy = dy / length;
+    // to the right of the lane direction
+    const double rx = uy * key.half_width;
+    const double ry = -ux * key.half_width;
+    const double sx = key.x0 + ux * lane.pull_back[0];
+    const double sy = key.y0 + uy * lane.pull_back[0];
+    const double ex = key.x1 - ux * lane.pull_back[1];
+    const double ey = key.y1 - uy * lane.pull_back[1];
+    lane.corners[0] = {sx + rx, sy + ry};
+    lane.corners[1] = {ex + rx, ey + ry};
+    lane.corners[2] = {ex - rx, ey - ry};
+    lane.corners[3] = {sx - rx, sy - ry};
+    _num_rebuilt++;
+  }
+
+  // the junctions join the ends of their lanes
+  for (auto& j : _junctions)
+  {
+    Junction& junction = j.second;
+    if (!junction.polygon.empty())
+      continue;
+    vector<Point> points;
+    for (const int lane_idx : junction.lanes)
+    {
+      const Lane& lane = _lanes[lane_idx];
+      if (lane.key.start_idx == j.first)
+      {
+        points.push_back(lane.corners[3]);
+        points.push_back(lane.corners[0]);
+      }
+      else
+      {
+        points.push_back(lane.corners[1]);
+        points.push_back(lane.corners[2]);
+      }
+    }
+    junction.polygon = convex_hull(points);
+  }
+
+  assemble();
+  printf(
+    "navmesh of level [%s]: %d nodes, %d obstacles, %d lanes and junctions "
+    "rebuilt\n",
+    level.name.c_str(),
+    static_cast<int>(_nodes.size()),
+    static_cast<int>(_obstacles.size()),
+    _num_rebuilt);
+  return !keys.empty();
+}
+
+void NavmeshBuilder::assemble()
+{
+  _vertices.clear();
+  _nodes.clear();
+  _edges.clear();
+  _obstacles.clear();
+
+  std::map<std::pair<long long, long long>, int> vertex_ids;
+  auto vertex_id = [&](const Point& p)
+    {
+      const std::pair<long long, long long> cell(
+        std::llround(p.x / MERGE_DISTANCE),
+        std::llround(p.y / MERGE_DISTANCE));
+      auto it = vertex_ids.find(cell);
+      if (it != vertex_ids.end())
+        return it->second;
+      const int id = static_cast<int>(_vertices.size());
+      vertex_ids[cell] = id;
+      _vertices.push_back(p);
+      return id;
+    };
+
+  auto add_node = [&](const Point* points, const std::size_t num_points)
+    {
+      Node node;
+      for (std::size_t i = 0; i < num_points; i++)
+      {
+        const int id = vertex_id(points[i]);
+        if (node.vertices.empty() || node.vertices.back() != id)
+          node.vertices.push_back(id);
+      }
+      while (node.vertices.size() > 1 &&
+        node.vertices.front() == node.vertices.back())
+        node.vertices.pop_back();
+      if (node.vertices.size() >= 3)
+        _nodes.push_back(node);
+    };
+
+  for (const auto& l : _lanes)
+  {
+    if (l.second.valid)
+      add_node(l.second.corners, 4);
+  }
+  for (const auto& j : _junctions)
+    add_node(j.second.polygon.data(), j.second.polygon.size());
+
+  // sides used by two nodes are edges, the others are obstacles
+  std::map<std::pair<int, int>, vector<std::pair<int, int>>> sides;
+  for (std::size_t n = 0; n < _nodes.size(); n++)
+  {
+    const vector<int>& v = _nodes[n].vertices;
+    for (std::size_t i = 0; i < v.size(); i++)
+    {
+      const int v0 = v[i];
+      const int v1 = v[(i + 1) % v.size()];
+      sides[std::make_pair(std::min(v0, v1), std::max(v0, v1))].push_back(
+        std::make_pair(static_cast<int>(n), v0));
+    }
+  }
+
+  std::map<int, int> obstacle_from;  // by starting vertex
+  for (const auto& s : sides)
+  {
+    const vector<std::pair<int, int>>& users = s.second;
+    const int first = s.first.first;
+    const int second = s.first.second;
+    if (users.size() >= 2)
+    {
+      Edge edge;
+      edge.v0 = first;
+      edge.v1 = second;
+      edge.node0 = users[0].first;
+      edge.node1 = users[1].first;
+      _nodes[edge.node0].edges.push_back(_edges.size());
+      _nodes[edge.node1].edges.push_back(_edges.size());
+      _edges.push_back(edge);
+    }
+    else
+    {
+      // keep the winding of the node it comes from
+      Obstacle obstacle;
+      obstacle.v0 = users[0].second;
+      obstacle.v1 = obstacle.v0 == first ? second : first;
+      obstacle.node = users[0].first;
+      obstacle.next = -1;
+      obstacle_from[obstacle.v0] = _obstacles.size();
+      _nodes[obstacle.node].obstacles.push_back(_obstacles.size());
+      _obstacles.push_back(obstacle);
+    }
+  }
+  for (Obstacle& obstacle : _obstacles)
+  {
+    auto it = obstacle_from.find(obstacle.v1);
+    if (it != obstacle_from.end())
+      obstacle.next = it->second;
+  }
+}
+
+bool NavmeshBuilder::write(const std::string& filename) const
+{
+  FILE* file = fopen(filename.c_str(), "w");
+  if (!file)
+  {
+    printf("couldn't open [%s] for writing\n", filename.c_str());
+    return false;
+  }
+
+  fprintf(file, "%d\n", static_cast<int>(_vertices.size()));
+  for (const Point& p : _vertices)
+    fprintf(file, "\t%.4f %.4f\n", p.x, p.y);
+
+  fprintf(file, "%d\n", static_cast<int>(_edges.size()));
+  for (const Edge& e : _edges)
+    fprintf(file, "\t%d %d %d %d\n", e.v0, e.v1, e.node0, e.node1);
+
+  fprintf(file, "%d\n", static_cast<int>(_obstacles.size()));
+  for (const Obstacle& o : _obstacles)
+    fprintf(file, "\t%d %d %d %d\n", o.v0, o.v1, o.node, o.next);
+
+  fprintf(file, "walkable\n%d\n", static_cast<int>(_nodes.size()));
+  for (const Node& node : _nodes)
+  {
+    Point centroid;
+    for (const int v : node.vertices)
+    {
+      centroid.x += _vertices[v].x;
+      centroid.y += _vertices[v].y;
+    }
+    centroid.x /= node.vertices.size();
+    centroid.y /= node.vertices.size();
+    fprintf(file, "\t%.4f %.4f\n", centroid.x, centroid.y);
+
+    fprintf(file, "\t%d", static_cast<int>(node.vertices.size()));
+    for (const int v : node.vertices)
+      fprintf(file, " %d", v);
+    fprintf(file, "\n\t0.0 0.0 %.4f\n", _elevation);
+
+    fprintf(file, "\t%d", static_cast<int>(node.edges.size()));
+    for (const int e : node.edges)
+      fprintf(file, " %d", e);
+    fprintf(file, "\n\t%d", static_cast<int>(node.obstacles.size()));
+    for (const int o : node.obstacles)
+      fprintf(file, " %d", o);
+    fprintf(file, "\n\n");
+  }
+
+  const bool ok = ferror(file) == 0;
+  fclose(file);
+  return ok;
+}
+
+NavmeshBuilder::Point NavmeshBuilder::to_pixels(const Point& p) const
+{
+  Point pixels;
+  pixels.x = p.x / _meters_per_pixel;
+  pixels.y = -p.y / _meters_per_pixel;
+  return pixels;
+}
+
+//=============================================================================
+NavmeshBuilder::Point NavmeshBuilder::from_pixels(const Point& pixels) const
+{
+  Point p;
+  p.x = pixels.x * _meters_per_pixel;
+  p.y = -pixels.y * _meters_per_pixel;
+  return p;
+}
+
+//=============================================================================
+int NavmeshBuilder::find_node(const Point& p) const
+{
+  for (std::size_t i = 0; i < _nodes.size(); i++)
+  {
+    const vector<int>& polygon = _nodes[i].vertices;
+    bool inside = polygon.size() >= 3;
+    for (std::size_t j = 0; inside && j < polygon.size(); j++)
+    {
+      const Point& a = _vertices[polygon[j]];
+      const Point& b = _vertices[polygon[(j + 1) % polygon.size()]];
+      inside = cross(a, b, p) >= 0.0;  // counter-clockwise
+    }
+    if (inside)
+      return static_cast<int>(i);
+  }
+  return -1;
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__NAVMESH_BUILDER_HPP
+#define TRAFFIC_EDITOR__NAVMESH_BUILDER_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+class Level;
+
+//=============================================================================
+/// Builds the crowd simulation navmesh of a level from its human lanes,
+/// in the Menge .nav format which the building_crowdsim tool writes. Each
+/// lane becomes a quad of its width, pulled back from its ends where it
+/// meets other lanes, and each vertex where two or more lanes meet becomes
+/// a convex junction polygon joining their ends. The geometry of a lane or
+/// junction is kept between builds and only worked out again when a lane
+/// touching it has changed.
+class NavmeshBuilder
+{
+public:
+  struct Point
+  {
+    double x = 0.0;
+    double y = 0.0;
+  };
+
+  /// A convex polygon of the mesh, counter-clockwise, in meters
+  struct Node
+  {
+    std::vector<int> vertices;  // into vertices()
+    std::vector<int> edges;  // into edges()
+    std::vector<int> obstacles;  // into obstacles()
+  };
+
+  /// A side shared by two nodes
+  struct Edge
+  {
+    int v0, v1;
+    int node0, node1;
+  };
+
+  /// A side belonging to one node only, which agents can't cross
+  struct Obstacle
+  {
+    int v0, v1;
+    int node;
+    int next;  // the obstacle starting at v1, or -1
+  };
+
+  /// Bring the mesh up to date with the human lanes of the level. Returns
+  /// false if the level has no human lanes.
+  bool build(const Level& level);
+
+  void clear();
+
+  const std::vector<Point>& vertices() const { return _vertices; }
+  const std::vector<Node>& nodes() const { return _nodes; }
+  const std::vector<Edge>& edges() const { return _edges; }
+  const std::vector<Obstacle>& obstacles() const { return _obstacles; }
+
+  /// Number of lanes and junctions worked out again by the last build()
+  int num_rebuilt() const { return _num_rebuilt; }
+
+  /// Write the mesh in the Menge navmesh format
+  bool write(const std::string& filename) const;
+
+  /// Convert a point of the mesh back to the pixel coordinates of the
+  /// level it was built from, and the other way
+  Point to_pixels(const Point& p) const;
+  Point from_pixels(const Point& pixels) const;
+
+  /// The node which has this point (in meters) inside it, or -1
+  int find_node(const Point& p) const;
+
+private:
+  struct LaneKey
+  {
+    int start_idx = -1, end_idx = -1;
+    double x0 = 0.0, y0 = 0.0, x1 = 0.0, y1 = 0.0;
+    double half_width = 0.0;  // meters
+
+    bool operator==(const LaneKey& other) const;
+  };
+
+  struct Lane
+  {
+    LaneKey key;
+    double pull_back[2] = {0.0, 0.0};  // at the start and the end
+    Point corners[4];  // start right, end right, end left, start left
+    bool valid = false;  // too short for its junctions if not
+  };
+
+  struct Junction
+  {
+    std::vector<int> lanes;  // edge indices of the lanes meeting here
+    std::vector<LaneKey> keys;  // of those lanes, when it was built
+    std::vector<Point> polygon;
+  };
+
+  double _meters_per_pixel = 0.05;
+  double _elevation = 0.0;
+  std::map<int, Lane> _lanes;  // by edge index
+  std::map<int, Junction> _junctions;  // by vertex index
+  int _num_rebuilt = 0;
+
+  std::vector<Point> _vertices;
+  std::vector<Node> _nodes;
+  std::vector<Edge> _edges;
+  std::vector<Obstacle> _obstacles;
+
+  void assemble();
+};
+
+#endif
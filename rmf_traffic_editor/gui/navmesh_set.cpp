@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include <algorithm>
+
+#include <QPointF>
+
+#include "building.h"
+#include "navmesh_set.hpp"
+#include "task_pool.hpp"
+
+//=============================================================================
+std::string NavmeshSet::file_name(const Level& level)
+{
+  return level.name + "_navmesh.nav";
+}
+
+//=============================================================================
+void NavmeshSet::clear()
+{
+  _levels.clear();
+  _links.clear();
+  _num_unlinked = 0;
+}
+
+//=============================================================================
+bool NavmeshSet::update(const Level& level, Entry& entry)
+{
+  const std::uint64_t hash = level.content_hashes().level;
+  if (entry.level_name != level.name)
+  {
+    // the levels were reordered or renamed; nothing cached is of this one
+    entry.builder.clear();
+    entry.level_name = level.name;
+    entry.built = false;
+  }
+  else if (entry.built && entry.hash == hash)
+    return false;
+
+  entry.has_mesh = entry.builder.build(level);
+  entry.hash = hash;
+  entry.built = true;
+  return true;
+}
+
+//=============================================================================
+const NavmeshBuilder* NavmeshSet::build_level(
+  const Building& building,
+  const int idx)
+{
+  if (idx < 0 || idx >= static_cast<int>(building.levels.size()))
+    return nullptr;
+  if (_levels.size() < building.levels.size())
+    _levels.resize(building.levels.size());
+  Entry& entry = _levels[idx];
+  update(building.levels[idx], entry);
+  return entry.has_mesh ? &entry.builder : nullptr;
+}
+
+//=============================================================================
+const NavmeshBuilder* NavmeshSet::navmesh(const int level_idx) const
+{
+  if (level_idx < 0 || level_idx >= static_cast<int>(_levels.size()))
+    return nullptr;
+  const Entry& entry = _levels[level_idx];
+  return entry.built && entry.has_mesh ? &entry.builder : nullptr;
+}
+
+//=============================================================================
+int NavmeshSet::build(Building& building)
+{
+  const std::vector<Level>& levels = building.levels;
+  _levels.resize(levels.size());
+  std::vector<char> rebuilt(levels.size(), 0);
+  TaskPool::instance().parallel_for(
+    static_cast<int>(levels.size()),
+    [this, &levels, &rebuilt](const int i)
+    {
+      rebuilt[i] = update(levels[i], _levels[i]);
+    });
+  find_links(building);
+  return static_cast<int>(std::count(rebuilt.begin(), rebuilt.end(), 1));
+}
+
+//=============================================================================
+void NavmeshSet::find_links(Building& building)
+{
+  _links.clear();
+  _num_unlinked = 0;
+  building.compile_lifts();
+
+  // the levels from the bottom up, so that a lift joins each level to the
+  // next one it stops at
+  std::vector<int> order;
+  for (std::size_t i = 0; i < building.levels.size(); i++)
+    order.push_back(static_cast<int>(i));
+  std::stable_sort(
+    order.begin(),
+    order.end(),
+    [&building](const int a, const int b)
+    {
+      return building.levels[a].elevation < building.levels[b].elevation;
+    });
+
+  for (std::size_t lift_idx = 0; lift_idx < building.lifts.size(); lift_idx++)
+  {
+    Lift& lift = building.lifts[lift_idx];
+    const int reference_idx = building.find_level_idx(
+      lift.reference_floor_name,
+      lift.reference_floor_idx);
+
+    Link link;
+    link.lift_idx = static_cast<int>(lift_idx);
+    bool have_lower = false;
+    for (const int level_idx : order)
+    {
+      const NavmeshBuilder* mesh = navmesh(level_idx);
+      if (!mesh || !lift.reaches_level(level_idx) ||
+        !lift.has_doors_on_level(level_idx))
+        continue;
+
+      QPointF pixels(lift.x, lift.y);
+      if (reference_idx >= 0)
+        building.transform_between_levels(
+          reference_idx,
+          QPointF(lift.x, lift.y),
+          level_idx,
+          pixels);
+      NavmeshBuilder::Point p;
+      p.x = pixels.x();
+      p.y = pixels.y();
+      p = mesh->from_pixels(p);
+      const int node = mesh->find_node(p);
+      if (node < 0)
+      {
+        // agents can't get into the cabin on this level, but still ride
+        // past it
+        _num_unlinked++;
+        continue;
+      }
+
+      link.level_idx[1] = level_idx;
+      link.point[1] = p;
+      link.node[1] = node;
+      if (have_lower)
+        _links.push_back(link);
+      link.level_idx[0] = level_idx;
+      link.point[0] = p;
+      link.node[0] = node;
+      have_lower = true;
+    }
+  }
+}
+
+//=============================================================================
+std::vector<crowd_sim::NavmeshLink> NavmeshSet::config_links(
+  const Building& building) const
+{
+  std::vector<crowd_sim::NavmeshLink> config;
+  for (const Link& link : _links)
+  {
+    crowd_sim::NavmeshLink c;
+    c.name = building.lifts[link.lift_idx].name;
+    c.from_file_name = file_name(building.levels[link.level_idx[0]]);
+    c.to_file_name = file_name(building.levels[link.level_idx[1]]);
+    c.from_x = link.point[0].x;
+    c.from_y = link.point[0].y;
+    c.to_x = link.point[1].x;
+    c.to_y = link.point[1].y;
+    config.push_back(c);
+  }
+  return config;
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef TRAFFIC_EDITOR__NAVMESH_SET_HPP
+#define TRAFFIC_EDITOR__NAVMESH_SET_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <traffic_editor/crowd_sim/crowd_sim_impl.h>
+
+#include "navmesh_builder.hpp"
+
+class Building;
+class Level;
+
+//=============================================================================
+/// The crowd simulation navmeshes of all the levels of a building, and the
+/// links between them at the lifts. Each level's mesh remembers the
+/// content hash of the level it was built from (see ContentHash), so only
+/// the levels edited since are built again, in parallel. A lift links the
+/// meshes of each pair of successive levels it opens its doors on, where
+/// its cabin is on the mesh of both.
+class NavmeshSet
+{
+public:
+  struct Link
+  {
+    int lift_idx = -1;
+    int level_idx[2] = {-1, -1};  // the lower level first
+    NavmeshBuilder::Point point[2];  // the cabin center, in meters
+    int node[2] = {-1, -1};
+  };
+
+  /// Bring every level's mesh and the links up to date. Returns the number
+  /// of levels whose mesh was built again.
+  int build(Building& building);
+
+  /// Bring the mesh of one level up to date, for the overlay; returns
+  /// nullptr if the level has no human lanes
+  const NavmeshBuilder* build_level(const Building& building, const int idx);
+
+  /// The mesh of a level as of the last build, or nullptr if it has none
+  const NavmeshBuilder* navmesh(const int level_idx) const;
+
+  const std::vector<Link>& links() const { return _links; }
+
+  /// The stops of lifts at levels with a mesh, where the cabin isn't on it
+  int num_unlinked() const { return _num_unlinked; }
+
+  /// The name of the navmesh file of a level, as the crowd_sim config has it
+  static std::string file_name(const Level& level);
+
+  /// The links, as the crowd_sim config records them
+  std::vector<crowd_sim::NavmeshLink> config_links(
+    const Building& building) const;
+
+  void clear();
+
+private:
+  struct Entry
+  {
+    std::string level_name;
+    std::uint64_t hash = 0;  // of the level the mesh was built from
+    bool built = false;
+    bool has_mesh = false;
+    NavmeshBuilder builder;
+  };
+  std::vector<Entry> _levels;
+  std::vector<Link> _links;
+  int _num_unlinked = 0;
+
+  /// Returns true if the mesh was built again
+  static bool update(const Level& level, Entry& entry);
+
+  void find_links(Building& building);
+};
+
+#endif
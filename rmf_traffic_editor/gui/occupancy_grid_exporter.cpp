@@ -0,0 +1,339 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <algorithm>
+#include <cmath>
+
+#include <QByteArray>
+#include <QDir>
+#include <QPointF>
+#include <QSaveFile>
+
+#include <yaml-cpp/yaml.h>
+
+#include "building.h"
+#include "logging.hpp"
+#include "occupancy_grid_exporter.hpp"
+#include "task_pool.hpp"
+
+namespace {
+
+/// A closed outline to fill, in cell coordinates: x to the right and y
+/// down from the top left corner of the grid, so that cell (c, r) has its
+/// center at (c + 0.5, r + 0.5)
+struct Shape
+{
+  std::vector<QPointF> points;
+  std::uint8_t value = OccupancyGridExporter::OCCUPIED;
+
+  // the cells it may cover, inclusive, clamped to the grid
+  int c0 = 0;
+  int c1 = -1;
+  int r0 = 0;
+  int r1 = -1;
+};
+
+/// Fill the cells of the shape whose centers are inside it (by the
+/// even-odd rule) within the given block of the grid
+void fill(
+  const Shape& shape,
+  OccupancyGridExporter::Grid& grid,
+  const int col0,
+  const int col1,
+  const int row0,
+  const int row1,
+  std::vector<double>& xs)
+{
+  const std::size_t n = shape.points.size();
+  const int first_row = std::max(row0, shape.r0);
+  const int last_row = std::min(row1, shape.r1);
+  for (int r = first_row; r <= last_row; r++)
+  {
+    const double yc = r + 0.5;
+    xs.clear();
+    for (std::size_t i = 0; i < n; i++)
+    {
+      const QPointF& a = shape.points[i];
+      const QPointF& b = shape.points[(i + 1) % n];
+      if ((a.y() <= yc) != (b.y() <= yc))
+        xs.push_back(a.x() + (yc - a.y()) * (b.x() - a.x()) / (b.y() - a.y()));
+    }
+    std::sort(xs.begin(), xs.end());
+
+    std::uint8_t* row = grid.cells.data() + static_cast<std::size_t>(r) *
+      grid.width;
+    for (std::size_t k = 0; k + 1 < xs.size(); k += 2)
+    {
+      const int begin =
+        std::max(col0, static_cast<int>(std::ceil(xs[k] - 0.5)));
+      const int end =
+        std::min(col1, static_cast<int>(std::floor(xs[k + 1] - 0.5)));
+      if (begin <= end)
+        std::fill(row + begin, row + end + 1, shape.value);
+    }
+  }
+}
+
+bool write_file(
+  const QString& path,
+  const QByteArray& header,
+  const char* data = nullptr,
+  const qint64 size = 0)
+{
+  QSaveFile file(path);
+  if (!file.open(QIODevice::WriteOnly) ||
+    file.write(header) != header.size() ||
+    file.write(data, size) != size ||
+    !file.commit())
+  {
+    qCWarning(lc_io, "unable to write %s", qUtf8Printable(path));
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+OccupancyGridExporter::Grid OccupancyGridExporter::rasterize(
+  Building& building,
+  const int level_idx,
+  const Options& options)
+{
+  Grid grid;
+  if (options.resolution <= 0.0 || options.tile_size <= 0)
+    return grid;
+
+  // the frame of the nav graphs, as in NavGraphExporter
+  const CoordinateSystem& crs = building.coordinate_system;
+  double scale = 1.0;
+  double dx = 0.0;
+  double dy = 0.0;
+  double meters_per_pixel = 1.0;
+  if (crs.value != CoordinateSystem::CartesianMeters)
+  {
+    const Building::Transform t =
+      building.get_transform_to_reference(level_idx);
+    scale = t.scale;
+    dx = t.dx;
+    dy = t.dy;
+    meters_per_pixel =
+      building.levels[building.get_reference_level_idx()]
+      .drawing_meters_per_pixel;
+  }
+  const bool y_flipped = crs.is_y_flipped();
+  const Level& level = building.levels[level_idx];
+  auto to_meters = [&](const int vertex_idx)
+    {
+      const Vertex& v = level.vertices[vertex_idx];
+      const double mx = (v.x * scale + dx) * meters_per_pixel;
+      const double my = (v.y * scale + dy) * meters_per_pixel;
+      return QPointF(mx, y_flipped ? -my : my);
+    };
+  const int num_vertices = static_cast<int>(level.vertices.size());
+  auto valid = [num_vertices](const int idx)
+    {
+      return idx >= 0 && idx < num_vertices;
+    };
+
+  // in the order they are painted: floors, then holes, then walls
+  std::vector<Shape> shapes;
+  bool has_floors = false;
+  for (const Polygon::Type type : {Polygon::FLOOR, Polygon::HOLE})
+  {
+    for (const Polygon& polygon : level.polygons)
+    {
+      if (polygon.type != type || polygon.vertices.size() < 3 ||
+        !std::all_of(polygon.vertices.begin(), polygon.vertices.end(), valid))
+        continue;
+      Shape shape;
+      shape.value = type == Polygon::FLOOR ? FREE : OCCUPIED;
+      for (const int idx : polygon.vertices)
+        shape.points.push_back(to_meters(idx));
+      shapes.push_back(std::move(shape));
+      has_floors = has_floors || type == Polygon::FLOOR;
+    }
+  }
+
+  // at least a cell wide, even along a diagonal
+  const double half_width =
+    std::max(0.5 * options.wall_thickness, 0.75 * options.resolution);
+  for (const Edge& edge : level.edges)
+  {
+    if ((edge.type != Edge::WALL && edge.type != Edge::DOOR) ||
+      !valid(edge.start_idx) || !valid(edge.end_idx))
+      continue;
+    const QPointF a = to_meters(edge.start_idx);
+    const QPointF b = to_meters(edge.end_idx);
+    const double length = std::hypot(b.x() - a.x(), b.y() - a.y());
+    if (length <= 0.0)
+      continue;
+    // square caps, so that walls meeting at a corner close it
+    const QPointF u = (b - a) * (half_width / length);
+    const QPointF n(-u.y(), u.x());
+    Shape shape;
+    shape.points = {a - u + n, b + u + n, b + u - n, a - u - n};
+    shapes.push_back(std::move(shape));
+  }
+  if (shapes.empty())
+    return grid;
+
+  double x_min = shapes[0].points[0].x();
+  double x_max = x_min;
+  double y_min = shapes[0].points[0].y();
+  double y_max = y_min;
+  for (const Shape& shape : shapes)
+  {
+    for (const QPointF& p : shape.points)
+    {
+      x_min = std::min(x_min, p.x());
+      x_max = std::max(x_max, p.x());
+      y_min = std::min(y_min, p.y());
+      y_max = std::max(y_max, p.y());
+    }
+  }
+  const double res = options.resolution;
+  grid.origin_x = x_min - options.margin;
+  grid.origin_y = y_min - options.margin;
+  grid.width = std::max(
+    1, static_cast<int>(std::ceil((x_max + options.margin - grid.origin_x) /
+    res)));
+  grid.height = std::max(
+    1, static_cast<int>(std::ceil((y_max + options.margin - grid.origin_y) /
+    res)));
+  const double top = grid.origin_y + grid.height * res;
+
+  // into cells, and binned by the tiles they overlap
+  const int tile = options.tile_size;
+  const int tiles_x = (grid.width + tile - 1) / tile;
+  const int tiles_y = (grid.height + tile - 1) / tile;
+  std::vector<std::vector<int>> bins(
+    static_cast<std::size_t>(tiles_x) * tiles_y);
+  for (std::size_t i = 0; i < shapes.size(); i++)
+  {
+    Shape& shape = shapes[i];
+    double u0 = grid.width;
+    double u1 = 0.0;
+    double v0 = grid.height;
+    double v1 = 0.0;
+    for (QPointF& p : shape.points)
+    {
+      p = QPointF((p.x() - grid.origin_x) / res, (top - p.y()) / res);
+      u0 = std::min(u0, p.x());
+      u1 = std::max(u1, p.x());
+      v0 = std::min(v0, p.y());
+      v1 = std::max(v1, p.y());
+    }
+    shape.c0 = std::max(0, static_cast<int>(std::floor(u0)));
+    shape.c1 = std::min(grid.width - 1, static_cast<int>(std::floor(u1)));
+    shape.r0 = std::max(0, static_cast<int>(std::floor(v0)));
+    shape.r1 = std::min(grid.height - 1, static_cast<int>(std::floor(v1)));
+    for (int ty = shape.r0 / tile; ty <= shape.r1 / tile; ty++)
+    {
+      for (int tx = shape.c0 / tile; tx <= shape.c1 / tile; tx++)
+        bins[static_cast<std::size_t>(ty) * tiles_x + tx].push_back(
+          static_cast<int>(i));
+    }
+  }
+
+  // each tile only writes its own cells, so they need no locking
+  grid.cells.assign(
+    static_cast<std::size_t>(grid.width) * grid.height,
+    has_floors ? UNKNOWN : FREE);
+  TaskPool::instance().parallel_for(
+    static_cast<int>(bins.size()),
+    [&](int t)
+    {
+      const int col0 = (t % tiles_x) * tile;
+      const int row0 = (t / tiles_x) * tile;
+      const int col1 = std::min(grid.width, col0 + tile) - 1;
+      const int row1 = std::min(grid.height, row0 + tile) - 1;
+      std::vector<double> xs;
+      for (const int i : bins[t])
+        fill(shapes[i], grid, col0, col1, row0, row1, xs);
+    });
+  return grid;
+}
+
+bool OccupancyGridExporter::export_grids(
+  Building& building,
+  const std::string& dir,
+  const Options& options,
+  std::vector<std::string>* written)
+{
+  if (building.coordinate_system.value == CoordinateSystem::WebMercator)
+  {
+    qCWarning(lc_io,
+      "occupancy grids of web Mercator buildings need a CRS projection");
+    return false;
+  }
+
+  bool ok = true;
+  for (std::size_t i = 0; i < building.levels.size(); i++)
+  {
+    const Grid grid = rasterize(building, static_cast<int>(i), options);
+    if (grid.cells.empty())
+      continue;
+
+    const QString name = QString::fromStdString(building.levels[i].name);
+    const QString base = QDir(QString::fromStdString(dir)).filePath(name);
+
+    const QByteArray header = QString("P5\n%1 %2\n255\n")
+      .arg(grid.width)
+      .arg(grid.height)
+      .toUtf8();
+    const QString pgm_path = base + ".pgm";
+    if (!write_file(
+        pgm_path,
+        header,
+        reinterpret_cast<const char*>(grid.cells.data()),
+        static_cast<qint64>(grid.cells.size())))
+    {
+      ok = false;
+      continue;
+    }
+    if (written)
+      written->push_back(pgm_path.toStdString());
+
+    // as map_saver writes them, so that 205 reads as unknown
+    YAML::Node node;
+    node["image"] = (name + ".pgm").toStdString();
+    node["mode"] = "trinary";
+    node["resolution"] = options.resolution;
+    YAML::Node origin;
+    origin.push_back(grid.origin_x);
+    origin.push_back(grid.origin_y);
+    origin.push_back(0.0);
+    origin.SetStyle(YAML::EmitterStyle::Flow);
+    node["origin"] = origin;
+    node["negate"] = 0;
+    node["occupied_thresh"] = 0.65;
+    node["free_thresh"] = 0.196;
+
+    YAML::Emitter emitter;
+    emitter << node;
+    QByteArray text(emitter.c_str());
+    text.append('\n');
+    const QString yaml_path = base + ".yaml";
+    if (emitter.good() && write_file(yaml_path, text))
+    {
+      if (written)
+        written->push_back(yaml_path.toStdString());
+    }
+    else
+      ok = false;
+  }
+  return ok;
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef TRAFFIC_EDITOR__OCCUPANCY_GRID_EXPORTER_HPP
+#define TRAFFIC_EDITOR__OCCUPANCY_GRID_EXPORTER_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Building;
+
+//=============================================================================
+/// Writes a 2D occupancy grid of each level for the navigation stacks of
+/// the robots, in the map_server format: <level>.pgm and <level>.yaml. The
+/// grid is in meters, in the frame of the nav graphs (see
+/// NavGraphExporter), and covers what is drawn on the level plus a margin.
+///
+/// Walls and doors (all of them drawn closed) are occupied, as are HOLE
+/// polygons. If a level has FLOOR polygons, the cells outside all of them
+/// are unknown, and the others free; without floors everything else is
+/// free. The grid is split into square tiles, each of which rasterizes the
+/// shapes that overlap it on its own thread, with scanlines sampled at
+/// the cell centers: a cell is either in a shape or not, with no
+/// anti-aliasing. Walls are at least a cell wide, so that they never have
+/// gaps a planner could slip through.
+class OccupancyGridExporter
+{
+public:
+  struct Options
+  {
+    double resolution = 0.05;  // meters per cell
+    double wall_thickness = 0.1;  // meters
+    double margin = 1.0;  // meters around the drawn shapes
+    int tile_size = 256;  // cells
+  };
+
+  /// The values of the cells in the PGM, as map_server reads them with
+  /// the thresholds written into the YAML
+  enum Cell : std::uint8_t
+  {
+    OCCUPIED = 0,
+    UNKNOWN = 205,
+    FREE = 254
+  };
+
+  struct Grid
+  {
+    int width = 0;
+    int height = 0;
+    double origin_x = 0.0;  // of the bottom left corner, in meters
+    double origin_y = 0.0;
+    std::vector<std::uint8_t> cells;  // row by row, from the top
+  };
+
+  /// The grid of one level; empty if it has nothing to rasterize
+  static Grid rasterize(
+    Building& building,
+    const int level_idx,
+    const Options& options);
+
+  /// Write the grids of every level with walls, doors or floors into dir,
+  /// which must exist. Returns false, having written what it could, if a
+  /// file couldn't be written or the building is in web Mercator. The
+  /// paths written are appended to written, if given.
+  static bool export_grids(
+    Building& building,
+    const std::string& dir,
+    const Options& options,
+    std::vector<std::string>* written = nullptr);
+};
+
+#endif
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cstring>
+
+#include "packed_image.hpp"
+
+
+PackedImage PackedImage::pack(const QImage& image)
+{
+  PackedImage packed;
+  if (image.isNull() || image.format() != QImage::Format_Grayscale8)
+    return packed;
+
+  // find the distinct values, giving up as soon as there are too many
+  int index[256];
+  std::fill(index, index + 256, -1);
+  std::vector<uint8_t> palette;
+  for (int row = 0; row < image.height(); row++)
+  {
+    const uint8_t* in = image.constScanLine(row);
+    for (int col = 0; col < image.width(); col++)
+    {
+      if (index[in[col]] >= 0)
+        continue;
+      if (static_cast<int>(palette.size()) == MAX_VALUES)
+        return packed;
+      index[in[col]] = static_cast<int>(palette.size());
+      palette.push_back(in[col]);
+    }
+  }
+
+  int bits = 1;
+  while ((1 << bits) < static_cast<int>(palette.size()))
+    bits *= 2;
+
+  packed._width = image.width();
+  packed._height = image.height();
+  packed._bits = bits;
+  packed._bytes_per_row = (packed._width * bits + 7) / 8;
+  packed._palette = palette;
+  packed._data.assign(
+    static_cast<std::size_t>(packed._bytes_per_row) * packed._height,
+    0);
+
+  const int per_byte = 8 / bits;
+  for (int row = 0; row < packed._height; row++)
+  {
+    const uint8_t* in = image.constScanLine(row);
+    uint8_t* out = packed._data.data() +
+      static_cast<std::size_t>(row) * packed._bytes_per_row;
+    for (int col = 0; col < packed._width; col++)
+      out[col / per_byte] |=
+        static_cast<uint8_t>(index[in[col]] << ((col % per_byte) * bits));
+  }
+  return packed;
+}
+
+void PackedImage::expand_row(const int row, uint8_t* out) const
+{
+  const uint8_t* in =
+    _data.data() + static_cast<std::size_t>(row) * _bytes_per_row;
+  const int per_byte = 8 / _bits;
+  const int mask = (1 << _bits) - 1;
+  for (int col = 0; col < _width; col++)
+    out[col] = _palette[(in[col / per_byte] >> ((col % per_byte) * _bits)) &
+        mask];
+}
+
+QImage PackedImage::to_image() const
+{
+  if (is_null())
+    return QImage();
+  QImage image(_width, _height, QImage::Format_Grayscale8);
+  for (int row = 0; row < _height; row++)
+    expand_row(row, image.scanLine(row));
+  return image;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__PACKED_IMAGE_HPP
+#define TRAFFIC_EDITOR__PACKED_IMAGE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <QImage>
+#include <QSize>
+
+//=============================================================================
+/// A grayscale image of only a few distinct values, such as a lidar
+/// occupancy grid (free, occupied and unknown), packed as indices into a
+/// palette of those values at 1, 2 or 4 bits per pixel instead of a byte.
+/// Rows are expanded back to gray values when they are needed.
+class PackedImage
+{
+public:
+  static const int MAX_VALUES = 16;
+
+  /// Pack a Format_Grayscale8 image. Returns a null PackedImage if it has
+  /// more than MAX_VALUES distinct gray values, or isn't grayscale.
+  static PackedImage pack(const QImage& image);
+
+  bool is_null() const { return _width <= 0 || _height <= 0; }
+  int width() const { return _width; }
+  int height() const { return _height; }
+  QSize size() const { return QSize(_width, _height); }
+  int bits_per_pixel() const { return _bits; }
+
+  /// Write the gray values of one row into out, which holds width() bytes
+  void expand_row(const int row, uint8_t* out) const;
+
+  /// The image unpacked into a Format_Grayscale8 QImage
+  QImage to_image() const;
+
+  std::size_t bytes() const { return _data.capacity(); }
+
+private:
+  int _width = 0;
+  int _height = 0;
+  int _bits = 0;
+  int _bytes_per_row = 0;
+  std::vector<uint8_t> _palette;  // gray value of each index
+  std::vector<uint8_t> _data;
+};
+
+#endif
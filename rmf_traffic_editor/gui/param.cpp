@@ -15,46 +15,45 @@
  *
 */
 
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <unordered_set>
+
 #include "param.h"
 using std::string;
 
 
 Param::Param()
-: type(UNDEFINED), value_int(0), value_double(0.0), value_bool(false)
+: type(UNDEFINED), value_double(0.0)
 {
 }
 
 Param::Param(const Type& t)
-: type(t), value_int(0), value_double(0.0), value_bool(false)
+: type(t), value_double(0.0)
 {
 }
 
 Param::Param(const std::string& s)
-: type(STRING),
-  value_int(0),
-  value_double(0.0),
-  value_string(s),
-  value_bool(false)
+: type(STRING), value_double(0.0), value_string(s)
 {
 }
 
 Param::Param(const int& i)
-: type(INT), value_int(i), value_double(0.0), value_bool(false)
+: type(INT), value_double(0.0)
 {
+  value_int = i;
 }
 
 Param::Param(const double& d)
-: type(DOUBLE), value_int(0), value_double(d), value_bool(false)
+: type(DOUBLE), value_double(d)
 {
 }
 
 Param::Param(const bool& b)
-: type(BOOL), value_int(0), value_double(0.0), value_bool(b)
-{
-}
-
-Param::~Param()
+: type(BOOL), value_double(0.0)
 {
+  value_bool = b;
 }
 
 void Param::from_yaml(const YAML::Node& data)
@@ -121,3 +120,90 @@ QString Param::to_qstring() const
   else
     return QString("unknown type!");
 }
+
+const std::string& ParamMap::intern(const std::string& key)
+{
+  // scene geometry is computed on worker threads, so guard the table
+  static std::mutex mutex;
+  static std::unordered_set<std::string> keys;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  // elements of an unordered_set never move, even when it rehashes
+  return *keys.insert(key).first;
+}
+
+int ParamMap::index_of(const std::string& key) const
+{
+  // these are so short that a linear search beats a binary one
+  for (std::size_t i = 0; i < _entries.size(); i++)
+  {
+    if (*_entries[i].key == key)
+      return static_cast<int>(i);
+  }
+  return -1;
+}
+
+void ParamMap::touch()
+{
+  // maps are loaded on worker threads too
+  static std::atomic<std::uint64_t> counter(0);
+  _revision = ++counter;
+}
+
+ParamMap::iterator ParamMap::find(const std::string& key)
+{
+  touch();
+  const int idx = index_of(key);
+  return idx < 0 ? end() : iterator(_entries.data() + idx);
+}
+
+ParamMap::const_iterator ParamMap::find(const std::string& key) const
+{
+  const int idx = index_of(key);
+  return idx < 0 ? end() : const_iterator(_entries.data() + idx);
+}
+
+std::size_t ParamMap::heap_bytes() const
+{
+  std::size_t bytes = _entries.capacity() * sizeof(Entry);
+  for (const Entry& entry : _entries)
+  {
+    if (entry.value.value_string.capacity() > 15)
+      bytes += entry.value.value_string.capacity() + 1;
+  }
+  return bytes;
+}
+
+std::size_t ParamMap::count(const std::string& key) const
+{
+  return index_of(key) < 0 ? 0 : 1;
+}
+
+Param& ParamMap::operator[](const std::string& key)
+{
+  touch();
+  const int idx = index_of(key);
+  if (idx >= 0)
+    return _entries[idx].value;
+
+  // keep the entries in key order, as a std::map would iterate them, so
+  // that the YAML output doesn't change
+  Entry entry;
+  entry.key = &intern(key);
+  const auto it = std::upper_bound(
+    _entries.begin(),
+    _entries.end(),
+    key,
+    [](const std::string& k, const Entry& e) { return k < *e.key; });
+  return _entries.insert(it, entry)->value;
+}
+
+std::size_t ParamMap::erase(const std::string& key)
+{
+  const int idx = index_of(key);
+  if (idx < 0)
+    return 0;
+  touch();
+  _entries.erase(_entries.begin() + idx);
+  return 1;
+}
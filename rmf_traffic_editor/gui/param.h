@@ -18,7 +18,10 @@
 #ifndef PARAM_H
 #define PARAM_H
 
+#include <cstdint>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <yaml-cpp/yaml.h>
 #include <QString>
@@ -37,7 +40,6 @@ public:
   } type;
 
   Param();
-  ~Param();
   Param(const std::string& s);
   Param(const int& i);
   Param(const double& d);
@@ -47,14 +49,112 @@ public:
   void from_yaml(const YAML::Node& data);
   YAML::Node to_yaml() const;
 
-  int value_int;
-  double value_double;
+  // only the member matching the type is meaningful
+  union
+  {
+    int value_int;
+    double value_double;
+    bool value_bool;
+  };
   std::string value_string;
-  bool value_bool;
 
   void set(const std::string& value);
 
   QString to_qstring() const;
 };
 
+/// The parameters of a vertex, edge, etc: a small vector of (key, value)
+/// pairs kept sorted by key, with the key strings interned so that every
+/// entity shares a single copy of each name. It has the subset of the
+/// std::map interface that the editor uses; dereferencing an iterator
+/// gives a pair of references, so `param.first` and `it->second` work as
+/// they would with a map.
+class ParamMap
+{
+public:
+  /// The shared copy of this key string. The reference stays valid (and
+  /// unique to the string) for the lifetime of the program.
+  static const std::string& intern(const std::string& key);
+
+  template<typename EntryT, typename ParamT>
+  class Iterator
+  {
+  public:
+    using value_type = std::pair<const std::string&, ParamT&>;
+
+    struct Arrow
+    {
+      value_type pair;
+      value_type* operator->() { return &pair; }
+    };
+
+    explicit Iterator(EntryT* entry = nullptr) : _entry(entry) {}
+
+    value_type operator*() const
+    {
+      return value_type(*_entry->key, _entry->value);
+    }
+    Arrow operator->() const { return Arrow{**this}; }
+    Iterator& operator++() { ++_entry; return *this; }
+    bool operator==(const Iterator& it) const { return _entry == it._entry; }
+    bool operator!=(const Iterator& it) const { return _entry != it._entry; }
+
+  private:
+    EntryT* _entry;
+  };
+
+  struct Entry
+  {
+    const std::string* key;
+    Param value;
+  };
+
+  using iterator = Iterator<Entry, Param>;
+  using const_iterator = Iterator<const Entry, const Param>;
+
+  iterator begin() { touch(); return iterator(_entries.data()); }
+  iterator end()
+  {
+    touch();
+    return iterator(_entries.data() + _entries.size());
+  }
+  const_iterator begin() const { return const_iterator(_entries.data()); }
+  const_iterator end() const
+  {
+    return const_iterator(_entries.data() + _entries.size());
+  }
+
+  iterator find(const std::string& key);
+  const_iterator find(const std::string& key) const;
+  std::size_t count(const std::string& key) const;
+
+  /// Insert a default (UNDEFINED) parameter if the key isn't present.
+  /// Like any insertion, this invalidates references to other values.
+  Param& operator[](const std::string& key);
+
+  std::size_t erase(const std::string& key);
+
+  std::size_t size() const { return _entries.size(); }
+  bool empty() const { return _entries.empty(); }
+  void clear() { touch(); _entries.clear(); }
+
+  /// Changes whenever the map may have been modified: by an insertion or
+  /// an erasure, or by handing out a mutable iterator or reference. The
+  /// numbers come from one counter for the whole program, so two maps
+  /// with the same revision (one copied from the other) hold the same
+  /// parameters. Lets the owner cache what it derives from them.
+  std::uint64_t revision() const { return _revision; }
+
+  /// Bytes allocated for the entries and their string values. The keys
+  /// are interned, so they aren't counted.
+  std::size_t heap_bytes() const;
+
+private:
+  std::vector<Entry> _entries;
+  std::uint64_t _revision = 0;
+
+  int index_of(const std::string& key) const;
+  void touch();
+};
+
 #endif
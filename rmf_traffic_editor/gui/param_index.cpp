@@ -0,0 +1,260 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <set>
+#include <unordered_map>
+
+#include <QRegularExpression>
+#include <QtConcurrent/QtConcurrent>
+
+#include "building.h"
+#include "param_index.hpp"
+
+namespace {
+
+/// The value as the property editor shows it
+std::string value_text(const Param& param)
+{
+  if (param.type == Param::STRING)
+    return param.value_string;
+  return param.to_qstring().toStdString();
+}
+
+/// Whether Param::set() can take this as a value of the type
+bool is_valid_value(const Param::Type type, const QString& value)
+{
+  bool ok = false;
+  switch (type)
+  {
+    case Param::STRING:
+      return true;
+    case Param::INT:
+      value.toInt(&ok);
+      return ok;
+    case Param::DOUBLE:
+      value.toDouble(&ok);
+      return ok;
+    case Param::BOOL:
+      return value == "true" || value == "True" ||
+        value == "false" || value == "False";
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+const char* ParamIndex::kind_name(const Kind kind)
+{
+  switch (kind)
+  {
+    case VERTEX: return "vertex";
+    case EDGE: return "edge";
+    case POLYGON: return "polygon";
+    case TAG: return "tag";
+  }
+  return "";
+}
+
+Level::SelectedItem ParamIndex::Match::item() const
+{
+  Level::SelectedItem item;
+  switch (kind)
+  {
+    case VERTEX: item.vertex_idx = idx; break;
+    case EDGE: item.edge_idx = idx; break;
+    case POLYGON: item.polygon_idx = idx; break;
+    case TAG: item.tag_idx = idx; break;
+  }
+  return item;
+}
+
+void ParamIndex::index_level(const Level& level, Section& section)
+{
+  section.valid = true;
+  section.revision = level.revision();
+  section.level_name = level.name;
+  section.postings.clear();
+  section.size = 0;
+
+  // the values of each key, with the type in front so that "1" the string
+  // and 1 the integer are told apart
+  std::unordered_map<const std::string*,
+    std::unordered_map<std::string, std::size_t>> postings;
+  auto add = [&](const ParamMap& params, const Kind kind, const std::size_t i)
+    {
+      for (const auto& param : params)
+      {
+        const std::string& key = param.first;  // interned
+        const Param& value = param.second;
+        std::string text = value_text(value);
+        text.insert(text.begin(), static_cast<char>('0' + value.type));
+        auto& values = postings[&key];
+        auto it = values.find(text);
+        if (it == values.end())
+        {
+          it = values.emplace(std::move(text), section.postings.size()).first;
+          Posting posting;
+          posting.key = &key;
+          posting.type = value.type;
+          posting.value = it->first.substr(1);
+          section.postings.push_back(std::move(posting));
+        }
+        section.postings[it->second].refs.push_back(
+          Ref{kind, static_cast<int>(i)});
+        section.size++;
+      }
+    };
+  for (std::size_t i = 0; i < level.vertices.size(); i++)
+    add(level.vertices[i].params, VERTEX, i);
+  for (std::size_t i = 0; i < level.edges.size(); i++)
+    add(level.edges[i].params, EDGE, i);
+  for (std::size_t i = 0; i < level.polygons.size(); i++)
+    add(level.polygons[i].params, POLYGON, i);
+  for (std::size_t i = 0; i < level.tags.size(); i++)
+    add(level.tags[i].params, TAG, i);
+
+  std::sort(
+    section.postings.begin(),
+    section.postings.end(),
+    [](const Posting& a, const Posting& b)
+    {
+      if (a.key != b.key)
+        return *a.key < *b.key;
+      return a.value < b.value;
+    });
+}
+
+void ParamIndex::update(const Building& building)
+{
+  _sections.resize(building.levels.size());
+  std::vector<int> stale;
+  for (std::size_t i = 0; i < building.levels.size(); i++)
+  {
+    const Level& level = building.levels[i];
+    const Section& section = _sections[i];
+    if (!section.valid || section.revision != level.revision() ||
+      section.level_name != level.name)
+      stale.push_back(static_cast<int>(i));
+  }
+  QtConcurrent::blockingMap(
+    stale,
+    [this, &building](const int i)
+    {
+      index_level(building.levels[i], _sections[i]);
+    });
+}
+
+void ParamIndex::clear()
+{
+  _sections.clear();
+}
+
+ParamIndex::Result ParamIndex::find(const Query& query) const
+{
+  Result result;
+  if (query.find.isEmpty() && !query.whole_value)
+    return result;  // it would be found everywhere
+
+  const Qt::CaseSensitivity cs =
+    query.case_sensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+  QRegularExpression re;
+  if (query.regex)
+  {
+    const QString pattern = query.whole_value ?
+      QString("\\A(?:%1)\\z").arg(query.find) : query.find;
+    re = QRegularExpression(
+      pattern,
+      query.case_sensitive ? QRegularExpression::NoPatternOption :
+      QRegularExpression::CaseInsensitiveOption);
+    if (!re.isValid())
+    {
+      result.error = re.errorString();
+      return result;
+    }
+  }
+
+  for (std::size_t level_idx = 0; level_idx < _sections.size(); level_idx++)
+  {
+    for (const Posting& posting : _sections[level_idx].postings)
+    {
+      if (!query.key.empty() && *posting.key != query.key)
+        continue;
+
+      QString value = QString::fromStdString(posting.value);
+      if (query.regex)
+      {
+        if (!re.match(value).hasMatch())
+          continue;
+        value.replace(re, query.replacement);
+      }
+      else if (query.whole_value)
+      {
+        if (value.compare(query.find, cs) != 0)
+          continue;
+        value = query.replacement;
+      }
+      else
+      {
+        if (!value.contains(query.find, cs))
+          continue;
+        value.replace(query.find, query.replacement, cs);
+      }
+
+      const std::string after = value.toStdString();
+      if (after == posting.value)
+        continue;
+      if (!is_valid_value(posting.type, value))
+      {
+        result.num_invalid += posting.refs.size();
+        continue;
+      }
+      for (const Ref& ref : posting.refs)
+      {
+        Match match;
+        match.level_idx = static_cast<int>(level_idx);
+        match.kind = ref.kind;
+        match.idx = ref.idx;
+        match.key = posting.key;
+        match.before = posting.value;
+        match.after = after;
+        result.matches.push_back(std::move(match));
+      }
+    }
+  }
+  return result;
+}
+
+std::vector<std::string> ParamIndex::keys() const
+{
+  std::set<std::string> keys;
+  for (const Section& section : _sections)
+  {
+    for (const Posting& posting : section.postings)
+      keys.insert(*posting.key);
+  }
+  return std::vector<std::string>(keys.begin(), keys.end());
+}
+
+std::size_t ParamIndex::size() const
+{
+  std::size_t size = 0;
+  for (const Section& section : _sections)
+    size += section.size;
+  return size;
+}
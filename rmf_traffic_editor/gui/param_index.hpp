@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__PARAM_INDEX_HPP
+#define TRAFFIC_EDITOR__PARAM_INDEX_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <QString>
+
+#include "level.h"
+#include "param.h"
+
+class Building;
+
+//=============================================================================
+/// An inverted index of the params of the vertices, edges, polygons and
+/// tags of every level: for each (key, value) pair, the entities which have
+/// it. A search tests each distinct value once, however many entities share
+/// it, which is what keeps finding and replacing "dock_name" or "dispenser"
+/// values across a large building fast. Only the levels which changed since
+/// they were indexed (see Level::revision()) are indexed again by update().
+class ParamIndex
+{
+public:
+  enum Kind
+  {
+    VERTEX = 0,
+    EDGE,
+    POLYGON,
+    TAG
+  };
+
+  static const char* kind_name(const Kind kind);
+
+  struct Query
+  {
+    /// Only the params of this name; all of them if empty
+    std::string key;
+
+    /// What to look for in the values: a substring, or with `regex` a
+    /// QRegularExpression, whose captures `replacement` can refer to as \1
+    QString find;
+    QString replacement;
+    bool regex = false;
+    bool whole_value = false;  // rather than every occurrence in the value
+    bool case_sensitive = true;
+  };
+
+  struct Match
+  {
+    int level_idx = -1;
+    Kind kind = VERTEX;
+    int idx = -1;
+    const std::string* key = nullptr;  // interned, see ParamMap::intern()
+    std::string before;
+    std::string after;
+
+    Level::SelectedItem item() const;
+  };
+
+  struct Result
+  {
+    std::vector<Match> matches;
+
+    /// Matches left out because the replacement isn't a valid value of
+    /// their type, e.g. letters for an integer param
+    std::size_t num_invalid = 0;
+
+    /// Why the regex can't be used, if it can't
+    QString error;
+  };
+
+  /// Index the levels which changed since they were indexed
+  void update(const Building& building);
+
+  void clear();
+
+  Result find(const Query& query) const;
+
+  /// The distinct param names of the building, sorted
+  std::vector<std::string> keys() const;
+
+  /// Number of (entity, param) pairs indexed
+  std::size_t size() const;
+
+private:
+  struct Ref
+  {
+    Kind kind;
+    int idx;
+  };
+
+  /// The entities of a level which have one value of one param
+  struct Posting
+  {
+    const std::string* key;
+    Param::Type type;
+    std::string value;
+    std::vector<Ref> refs;
+  };
+
+  struct Section
+  {
+    bool valid = false;
+    std::size_t revision = 0;
+    std::string level_name;
+    std::vector<Posting> postings;  // sorted by key, then value
+    std::size_t size = 0;
+  };
+
+  std::vector<Section> _sections;  // by level
+
+  static void index_level(const Level& level, Section& section);
+};
+
+#endif
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "param_schema.hpp"
+
+
+Param ParamSchema::default_value(const int idx) const
+{
+  const ParamField& f = _fields[idx];
+  switch (f.type)
+  {
+    case Param::STRING: return Param(std::string(f.text));
+    case Param::INT: return Param(static_cast<int>(f.number));
+    case Param::DOUBLE: return Param(f.number);
+    case Param::BOOL: return Param(f.number != 0.0);
+    default: return Param();
+  }
+}
+
+void ParamSchema::create_required(ParamMap& params) const
+{
+  for (int i = 0; i < _size; i++)
+  {
+    const ParamField& f = _fields[i];
+    if (!f.required)
+      continue;
+    auto it = params.find(f.name);
+    if (it == params.end() || it->second.type != f.type)
+      params[f.name] = default_value(i);
+  }
+}
+
+const char* ParamSchema::type_name(const Param::Type type)
+{
+  switch (type)
+  {
+    case Param::STRING: return "string";
+    case Param::INT: return "int";
+    case Param::DOUBLE: return "double";
+    case Param::BOOL: return "bool";
+    default: return "undefined";
+  }
+}
@@ -0,0 +1,260 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__PARAM_SCHEMA_HPP
+#define TRAFFIC_EDITOR__PARAM_SCHEMA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "param.h"
+
+/// A param that the editor knows, with its type and, for those which every
+/// entity of its kind has, the value it is created with
+struct ParamField
+{
+  const char* name = "";
+  Param::Type type = Param::UNDEFINED;
+  bool required = false;
+  double number = 0.0;  // the default of an INT, DOUBLE or BOOL param
+  const char* text = "";  // and of a STRING one
+};
+
+//=============================================================================
+/// The params of one kind of entity (vertices, walls, lanes, doors, ...) as
+/// a table built at compile time, with a perfect hash of their names: the
+/// constructor looks for a seed of the hash under which no two names share
+/// a slot, so find() is one hash, one slot and one string comparison, and
+/// is constexpr. A table for which no seed is found, or with too many
+/// params, doesn't compile.
+///
+/// The schemas themselves are in param_schemas below. Creating the params
+/// an entity must have, checking the types of those it has, and listing
+/// those which can be added to it all go through them.
+class ParamSchema
+{
+public:
+  static constexpr int MAX_FIELDS = 16;
+  static constexpr int NUM_SLOTS = 64;  // a power of two
+  static constexpr std::uint32_t MAX_SEED = 1u << 16;
+
+  template<std::size_t N>
+  constexpr ParamSchema(const char* kind, const ParamField (&fields)[N])
+  : _kind(kind), _size(static_cast<int>(N))
+  {
+    static_assert(N <= MAX_FIELDS, "too many params for a ParamSchema");
+    for (std::size_t i = 0; i < N; i++)
+      _fields[i] = fields[i];
+    _seed = find_seed();
+    for (int i = 0; i < _size; i++)
+      _slots[slot(_fields[i].name, length(_fields[i].name), _seed)] =
+        static_cast<signed char>(i + 1);
+  }
+
+  /// "vertex", "door", ...
+  constexpr const char* kind() const { return _kind; }
+
+  constexpr int size() const { return _size; }
+  constexpr const ParamField& field(const int idx) const
+  {
+    return _fields[idx];
+  }
+
+  /// Index of the field of this name, or -1
+  constexpr int find(const char* name, const std::size_t len) const
+  {
+    const int idx = _slots[slot(name, len, _seed)] - 1;
+    return idx >= 0 && equal(_fields[idx].name, name, len) ? idx : -1;
+  }
+
+  template<std::size_t N>
+  constexpr int find(const char (&name)[N]) const
+  {
+    return find(name, N - 1);
+  }
+
+  int find(const std::string& name) const
+  {
+    return find(name.data(), name.size());
+  }
+
+  /// nullptr if the param isn't in the schema
+  const ParamField* lookup(const std::string& name) const
+  {
+    const int idx = find(name);
+    return idx >= 0 ? &_fields[idx] : nullptr;
+  }
+
+  /// The value a param is created with
+  Param default_value(const int idx) const;
+
+  /// Add the required params which are missing, or of another type
+  void create_required(ParamMap& params) const;
+
+  static const char* type_name(const Param::Type type);
+
+private:
+  const char* _kind;
+  int _size;
+  ParamField _fields[MAX_FIELDS] = {};
+  signed char _slots[NUM_SLOTS] = {};  // index + 1 of the field, or 0
+  std::uint32_t _seed = 0;
+
+  static constexpr std::size_t length(const char* s)
+  {
+    std::size_t n = 0;
+    while (s[n])
+      n++;
+    return n;
+  }
+
+  static constexpr bool equal(
+    const char* a,
+    const char* b,
+    const std::size_t len)
+  {
+    for (std::size_t i = 0; i < len; i++)
+    {
+      if (a[i] != b[i])
+        return false;
+    }
+    return a[len] == '\0';
+  }
+
+  // FNV-1a, from a seeded offset
+  static constexpr int slot(
+    const char* s,
+    const std::size_t len,
+    const std::uint32_t seed)
+  {
+    std::uint32_t h = 2166136261u ^ (seed * 0x9e3779b9u);
+    for (std::size_t i = 0; i < len; i++)
+    {
+      h ^= static_cast<unsigned char>(s[i]);
+      h *= 16777619u;
+    }
+    return static_cast<int>((h ^ (h >> 16)) & (NUM_SLOTS - 1));
+  }
+
+  constexpr std::uint32_t find_seed() const
+  {
+    for (std::uint32_t seed = 0; seed < MAX_SEED; seed++)
+    {
+      bool used[NUM_SLOTS] = {};
+      bool collision = false;
+      for (int i = 0; i < _size && !collision; i++)
+      {
+        const int s = slot(_fields[i].name, length(_fields[i].name), seed);
+        collision = used[s];
+        used[s] = true;
+      }
+      if (!collision)
+        return seed;
+    }
+    throw "no perfect hash seed for this ParamSchema";
+  }
+};
+
+namespace param_schemas {
+
+// the params that can be added to a vertex
+constexpr ParamField VERTEX_FIELDS[] = {
+  {"is_parking_spot", Param::BOOL, false, 0.0, ""},
+  {"is_charger", Param::BOOL, false, 0.0, ""},
+  {"dock_name", Param::STRING, false, 0.0, ""},
+  {"is_cleaning_zone", Param::BOOL, false, 0.0, ""},
+  {"dropoff_ingestor", Param::STRING, false, 0.0, ""},
+  {"pickup_dispenser", Param::STRING, false, 0.0, ""},
+  {"spawn_robot_type", Param::STRING, false, 0.0, ""},
+  {"spawn_robot_name", Param::STRING, false, 0.0, ""},
+  {"is_holding_point", Param::BOOL, false, 0.0, ""},
+  {"is_passthrough_point", Param::BOOL, false, 0.0, ""},
+  {"human_goal_set_name", Param::STRING, false, 0.0, ""},
+};
+constexpr ParamSchema vertex("vertex", VERTEX_FIELDS);
+
+constexpr ParamField TAG_FIELDS[] = {
+  {"is_april_tag", Param::BOOL, false, 0.0, ""},
+  {"is_signage", Param::BOOL, false, 0.0, ""},
+  {"human_goal_set_name", Param::STRING, false, 0.0, ""},
+};
+constexpr ParamSchema tag("tag", TAG_FIELDS);
+
+constexpr ParamField WALL_FIELDS[] = {
+  {"texture_name", Param::STRING, true, 0.0, "default"},
+  {"alpha", Param::DOUBLE, true, 1.0, ""},
+  {"texture_height", Param::DOUBLE, true, 2.5, ""},
+  {"texture_width", Param::DOUBLE, true, 1.0, ""},
+  {"texture_scale", Param::DOUBLE, true, 1.0, ""},
+};
+constexpr ParamSchema wall("wall", WALL_FIELDS);
+
+constexpr ParamField MEASUREMENT_FIELDS[] = {
+  {"distance", Param::DOUBLE, true, 1.0, ""},
+};
+constexpr ParamSchema measurement("measurement", MEASUREMENT_FIELDS);
+
+constexpr ParamField LANE_FIELDS[] = {
+  {"bidirectional", Param::BOOL, true, 1.0, ""},
+  {"orientation", Param::STRING, true, 0.0, ""},
+  {"graph_idx", Param::INT, true, 0.0, ""},
+  {"demo_mock_floor_name", Param::STRING, true, 0.0, ""},
+  {"demo_mock_lift_name", Param::STRING, true, 0.0, ""},
+  {"speed_limit", Param::DOUBLE, true, 0.0, ""},
+};
+constexpr ParamSchema lane("lane", LANE_FIELDS);
+
+constexpr ParamField DOOR_FIELDS[] = {
+  {"name", Param::STRING, true, 0.0, "null"},
+  {"type", Param::STRING, true, 0.0, "hinged"},
+  {"motion_axis", Param::STRING, true, 0.0, "start"},
+  {"motion_direction", Param::INT, true, 1.0, ""},
+  {"motion_degrees", Param::DOUBLE, true, 90.0, ""},  // hinged
+  {"right_left_ratio", Param::DOUBLE, true, 1.0, ""},  // doubles
+  {"plugin", Param::STRING, true, 0.0, "normal"},
+};
+constexpr ParamSchema door("door", DOOR_FIELDS);
+
+constexpr ParamField HUMAN_LANE_FIELDS[] = {
+  {"width", Param::DOUBLE, true, 1.0, ""},
+  {"bidirectional", Param::BOOL, true, 1.0, ""},
+  {"orientation", Param::STRING, true, 0.0, ""},
+  {"graph_idx", Param::INT, true, 9.0, ""},
+  {"demo_mock_floor_name", Param::STRING, true, 0.0, ""},
+  {"demo_mock_lift_name", Param::STRING, true, 0.0, ""},
+};
+constexpr ParamSchema human_lane("human_lane", HUMAN_LANE_FIELDS);
+
+constexpr ParamField FLOOR_FIELDS[] = {
+  {"texture_name", Param::STRING, true, 0.0, "blue_linoleum"},
+  {"texture_scale", Param::DOUBLE, true, 1.0, ""},
+  {"texture_rotation", Param::DOUBLE, true, 0.0, ""},
+  {"indoor", Param::INT, true, 0.0, ""},
+  {"ceiling_texture", Param::STRING, true, 0.0, "blue_linoleum"},
+  {"ceiling_scale", Param::DOUBLE, true, 1.0, ""},
+};
+constexpr ParamSchema floor_polygon("floor", FLOOR_FIELDS);
+
+static_assert(vertex.find("is_charger") == 1, "perfect hash of vertex");
+static_assert(vertex.find("lift_cabin") == -1, "perfect hash of vertex");
+static_assert(door.find("motion_degrees") == 4, "perfect hash of door");
+static_assert(door.find("motion_degree") == -1, "perfect hash of door");
+
+}  // namespace param_schemas
+
+#endif
@@ -15,6 +15,7 @@
  *
 */
 
+#include "logging.hpp"
 #include "polygon.h"
 using std::string;
 using std::vector;
@@ -25,10 +26,6 @@ Polygon::Polygon()
   create_required_parameters();
 }
 
-Polygon::~Polygon()
-{
-}
-
 void Polygon::from_yaml(const YAML::Node& data, const Type polygon_type)
 {
   if (!data.IsMap())
@@ -83,10 +80,10 @@ void Polygon::remove_vertex(const int vertex_idx)
   }
   if (vertex_occurrence_idx < 0)
   {
-    printf("never found vertex %d\n", vertex_idx);
+    qCWarning(lc_edit, "never found vertex %d", vertex_idx);
     return;  // never found it. so sad.
   }
-  printf("found vertex %d at polygon vertices idx %d\n",
+  qCDebug(lc_edit, "found vertex %d at polygon vertices idx %d",
     vertex_idx,
     vertex_occurrence_idx);
 
@@ -102,7 +99,7 @@ void Polygon::set_param(const std::string& name, const std::string& value)
   auto it = params.find(name);
   if (it == params.end())
   {
-    printf("tried to set unknown parameter [%s]\n", name.c_str());
+    qCWarning(lc_edit, "tried to set unknown parameter [%s]", name.c_str());
     return;  // unknown parameter
   }
   it->second.set(value);
@@ -110,31 +107,12 @@ void Polygon::set_param(const std::string& name, const std::string& value)
 
 void Polygon::create_required_parameters()
 {
-  // create required parameters if they don't exist yet on this edge
-  if (type == FLOOR)
-  {
-    create_param_if_needed(
-      "texture_name",
-      Param::STRING,
-      std::string("blue_linoleum"));
-    create_param_if_needed("texture_scale", Param::DOUBLE, 1.0);
-    create_param_if_needed("texture_rotation", Param::DOUBLE, 0.0);
-    create_param_if_needed("indoor", Param::INT, 0);
-    create_param_if_needed(
-      "ceiling_texture",
-      Param::STRING,
-      std::string("blue_linoleum"));
-    create_param_if_needed("ceiling_scale", Param::DOUBLE, 1.0);
-  }
+  // create required parameters if they don't exist yet on this polygon
+  if (const ParamSchema* schema = param_schema(type))
+    schema->create_required(params);
 }
 
-template<typename T>
-void Polygon::create_param_if_needed(
-  const std::string& name,
-  const Param::Type& param_type,
-  const T& param_value)
+const ParamSchema* Polygon::param_schema(const Type type)
 {
-  auto it = params.find(name);
-  if (it == params.end() || it->second.type != param_type)
-    params[name] = param_value;
+  return type == FLOOR ? &param_schemas::floor_polygon : nullptr;
 }
@@ -26,6 +26,7 @@
 #include <QPolygonF>
 
 #include "param.h"
+#include "param_schema.hpp"
 
 
 class Polygon
@@ -34,7 +35,7 @@ public:
   std::vector<int> vertices;
   bool selected = false;
 
-  std::map<std::string, Param> params;
+  ParamMap params;
 
   enum Type
   {
@@ -46,7 +47,6 @@ public:
   } type = UNDEFINED;
 
   Polygon();
-  ~Polygon();
 
   void from_yaml(const YAML::Node& data, const Type polygon_type);
   YAML::Node to_yaml() const;
@@ -62,11 +62,8 @@ public:
   void set_param(const std::string& name, const std::string& value);
   void create_required_parameters();
 
-  template<typename T>
-  void create_param_if_needed(
-    const std::string& name,
-    const Param::Type& param_type,
-    const T& param_value);
+  /// The params of polygons of this type, nullptr if it has none
+  static const ParamSchema* param_schema(const Type type);
 };
 
 #endif
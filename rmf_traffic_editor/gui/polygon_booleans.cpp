@@ -0,0 +1,282 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <utility>
+
+#include "polygon_booleans.hpp"
+#include "polygon_geometry.hpp"
+#include "task_pool.hpp"
+
+namespace {
+
+/// One call of the clipper, and the polygons its results replace
+struct Job
+{
+  std::vector<int> sources;
+  int model = -1;  // whose type and params the results take
+  std::vector<QPolygonF> subject;
+  std::vector<QPolygonF> clip;
+  std::vector<QPolygonF> result;
+};
+
+QPolygonF outline(const std::vector<Vertex>& vertices, const Polygon& polygon)
+{
+  QPolygonF ring;
+  for (const int idx : polygon.vertices)
+    ring.push_back(QPointF(vertices[idx].x, vertices[idx].y));
+  return ring;
+}
+
+QRectF bounds(const std::vector<QPolygonF>& rings)
+{
+  QRectF r;
+  for (const QPolygonF& ring : rings)
+    r |= ring.boundingRect();
+  return r;
+}
+
+std::pair<qint64, qint64> grid_key(
+  const double x,
+  const double y,
+  const double resolution)
+{
+  return std::make_pair(
+    static_cast<qint64>(std::llround(x / resolution)),
+    static_cast<qint64>(std::llround(y / resolution)));
+}
+
+}  // namespace
+
+//=============================================================================
+PolygonBooleans::Report PolygonBooleans::run(
+  const Operation operation,
+  std::vector<Vertex>& vertices,
+  std::vector<Polygon>& polygons,
+  const std::vector<int>& polygon_idxs,
+  const double distance,
+  const PolygonClipper::Options& options)
+{
+  Report report;
+  std::vector<int> idxs;
+  for (const int idx : polygon_idxs)
+  {
+    if (idx >= 0 && idx < static_cast<int>(polygons.size()))
+      idxs.push_back(idx);
+  }
+  std::sort(idxs.begin(), idxs.end());
+  idxs.erase(std::unique(idxs.begin(), idxs.end()), idxs.end());
+
+  std::vector<Job> jobs;
+  std::vector<int> cutters;  // removed along with the jobs' sources
+  switch (operation)
+  {
+    case UNION:
+    {
+      std::map<int, Job> type_jobs;
+      for (const int idx : idxs)
+      {
+        Job& job = type_jobs[static_cast<int>(polygons[idx].type)];
+        if (job.model < 0)
+          job.model = idx;
+        job.sources.push_back(idx);
+        job.subject.push_back(outline(vertices, polygons[idx]));
+      }
+      for (auto& it : type_jobs)
+      {
+        if (it.second.sources.size() >= 2)
+          jobs.push_back(std::move(it.second));
+      }
+      break;
+    }
+
+    case INTERSECTION:
+    {
+      if (idxs.size() < 2)
+        break;
+      Job job;
+      job.model = idxs.front();
+      job.sources = idxs;
+      for (const int idx : idxs)
+        job.subject.push_back(outline(vertices, polygons[idx]));
+      jobs.push_back(std::move(job));
+      break;
+    }
+
+    case DIFFERENCE:
+    {
+      std::vector<int> subjects;
+      for (const int idx : idxs)
+      {
+        if (polygons[idx].type == Polygon::HOLE)
+          cutters.push_back(idx);
+        else
+          subjects.push_back(idx);
+      }
+      if (cutters.empty() || subjects.empty())
+      {
+        if (idxs.size() < 2)
+          break;
+        cutters.assign(1, idxs.back());
+        subjects.assign(idxs.begin(), idxs.end() - 1);
+      }
+      std::vector<QPolygonF> clip;
+      for (const int idx : cutters)
+        clip.push_back(outline(vertices, polygons[idx]));
+      const QRectF clip_bounds = bounds(clip);
+      for (const int idx : subjects)
+      {
+        Job job;
+        job.model = idx;
+        job.sources.push_back(idx);
+        job.subject.push_back(outline(vertices, polygons[idx]));
+        if (!bounds(job.subject).intersects(clip_bounds))
+          continue;  // nothing to cut
+        job.clip = clip;
+        jobs.push_back(std::move(job));
+      }
+      break;
+    }
+
+    case OFFSET:
+    {
+      if (distance == 0.0)
+        break;
+      for (const int idx : idxs)
+      {
+        Job job;
+        job.model = idx;
+        job.sources.push_back(idx);
+        job.subject.push_back(outline(vertices, polygons[idx]));
+        jobs.push_back(std::move(job));
+      }
+      break;
+    }
+  }
+  if (jobs.empty())
+    return report;
+
+  TaskPool::instance().parallel_for(
+    static_cast<int>(jobs.size()),
+    [&jobs, operation, distance, &options](const int i)
+    {
+      Job& job = jobs[i];
+      switch (operation)
+      {
+        case UNION:
+          job.result = PolygonClipper::clip(
+            PolygonClipper::UNION, job.subject, job.clip, options);
+          break;
+        case INTERSECTION:
+          job.result.assign(1, job.subject.front());
+          for (std::size_t k = 1; k < job.subject.size(); k++)
+          {
+            job.result = PolygonClipper::clip(
+              PolygonClipper::INTERSECTION,
+              job.result,
+              std::vector<QPolygonF>(1, job.subject[k]),
+              options);
+          }
+          break;
+        case DIFFERENCE:
+          job.result = PolygonClipper::clip(
+            PolygonClipper::DIFFERENCE, job.subject, job.clip, options);
+          break;
+        case OFFSET:
+          job.result = PolygonClipper::offset(job.subject, distance, options);
+          break;
+      }
+    });
+
+  // polygons which don't overlap at all are left alone, rather than all
+  // of them being removed
+  if (operation == INTERSECTION && jobs.front().result.empty())
+    return report;
+
+  // where the outlines come back to an existing vertex, it is reused
+  std::map<std::pair<qint64, qint64>, int> vertex_at;
+  for (std::size_t i = 0; i < vertices.size(); i++)
+  {
+    vertex_at.insert(
+      std::make_pair(
+        grid_key(vertices[i].x, vertices[i].y, options.resolution),
+        static_cast<int>(i)));
+  }
+
+  std::vector<char> removed(polygons.size(), 0);
+  std::vector<Polygon> added;
+  for (const Job& job : jobs)
+  {
+    for (const int idx : job.sources)
+      removed[idx] = 1;
+    const Polygon& model = polygons[job.model];
+    for (const QPolygonF& ring : job.result)
+    {
+      Polygon polygon;
+      if (PolygonGeometry::signed_area(ring) < 0.0)
+      {
+        if (model.type != Polygon::FLOOR)
+        {
+          report.dropped_holes++;
+          continue;
+        }
+        polygon.type = Polygon::HOLE;
+        polygon.create_required_parameters();
+        report.holes++;
+      }
+      else
+      {
+        polygon = model;
+        polygon.vertices.clear();
+        report.results++;
+      }
+      polygon.selected = true;
+      for (const QPointF& p : ring)
+      {
+        const auto key = grid_key(p.x(), p.y(), options.resolution);
+        auto it = vertex_at.find(key);
+        if (it == vertex_at.end())
+        {
+          it = vertex_at.insert(
+            std::make_pair(key, static_cast<int>(vertices.size()))).first;
+          vertices.push_back(Vertex(p.x(), p.y()));
+          report.vertices++;
+        }
+        polygon.vertices.push_back(it->second);
+      }
+      added.push_back(polygon);
+    }
+  }
+  for (const int idx : cutters)
+    removed[idx] = 1;
+
+  std::vector<Polygon> kept;
+  kept.reserve(polygons.size() + added.size());
+  for (std::size_t i = 0; i < polygons.size(); i++)
+  {
+    if (removed[i])
+      report.polygons++;
+    else
+      kept.push_back(std::move(polygons[i]));
+  }
+  kept.insert(kept.end(), added.begin(), added.end());
+  polygons.swap(kept);
+  return report;
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef TRAFFIC_EDITOR__POLYGON_BOOLEANS_HPP
+#define TRAFFIC_EDITOR__POLYGON_BOOLEANS_HPP
+
+#include <vector>
+
+#include "polygon.h"
+#include "polygon_clipper.hpp"
+#include "vertex.h"
+
+//=============================================================================
+/// Reshapes the selected polygons of a level with PolygonClipper, for
+/// merging adjacent rooms, cutting atriums out of floors and the like,
+/// instead of adding and removing their vertices one at a time.
+///
+/// - UNION merges the polygons of each type into as few as there can be.
+/// - INTERSECTION keeps only what all of the polygons cover.
+/// - DIFFERENCE cuts the selected holes out of the other polygons, or if
+///   there are none of those, the last polygon out of the others.
+/// - OFFSET grows (or shrinks) every polygon by the distance.
+///
+/// The polygons go, apart from holes which were not cut out, and the
+/// results take their place at the end of the list, each with the type
+/// and params of the polygon it came from, and selected. Holes in a
+/// floor become HOLE polygons, so that they are cut out again when the
+/// floor is triangulated (and by the generator); the other kinds of
+/// polygons can't have holes, so those are dropped. The outlines reuse
+/// the existing vertices where they snap to the same point of the grid,
+/// and otherwise add new ones. The groups of polygons are clipped in
+/// parallel.
+class PolygonBooleans
+{
+public:
+  enum Operation
+  {
+    UNION = 0,
+    INTERSECTION,
+    DIFFERENCE,
+    OFFSET
+  };
+
+  struct Report
+  {
+    int polygons = 0;  // replaced
+    int results = 0;  // polygons added
+    int holes = 0;  // HOLE polygons added
+    int dropped_holes = 0;  // which their polygons couldn't have
+    int vertices = 0;  // added
+
+    bool empty() const { return polygons == 0; }
+  };
+
+  /// The distance of OFFSET and the options are in the units of the
+  /// vertex coordinates.
+  static Report run(
+    const Operation operation,
+    std::vector<Vertex>& vertices,
+    std::vector<Polygon>& polygons,
+    const std::vector<int>& polygon_idxs,
+    const double distance,
+    const PolygonClipper::Options& options);
+};
+
+#endif
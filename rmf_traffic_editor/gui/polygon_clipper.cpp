@@ -0,0 +1,879 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+
+#include <QPointF>
+
+#include "polygon_clipper.hpp"
+
+namespace {
+
+typedef std::int64_t Int;
+
+/// A point of the snapping grid
+struct IPoint
+{
+  Int x = 0;
+  Int y = 0;
+
+  IPoint() {}
+  IPoint(const Int _x, const Int _y) : x(_x), y(_y) {}
+
+  bool operator==(const IPoint& o) const { return x == o.x && y == o.y; }
+  bool operator!=(const IPoint& o) const { return !(*this == o); }
+  bool operator<(const IPoint& o) const
+  {
+    return x < o.x || (x == o.x && y < o.y);
+  }
+
+  IPoint operator+(const IPoint& o) const { return IPoint(x + o.x, y + o.y); }
+  IPoint operator-(const IPoint& o) const { return IPoint(x - o.x, y - o.y); }
+};
+
+Int cross(const IPoint& u, const IPoint& v)
+{
+  return u.x * v.y - u.y * v.x;
+}
+
+Int dot(const IPoint& u, const IPoint& v)
+{
+  return u.x * v.x + u.y * v.y;
+}
+
+/// Positive if p is left of the line from a to b, negative if it's right
+int orient(const IPoint& a, const IPoint& b, const IPoint& p)
+{
+  const Int c = cross(b - a, p - a);
+  return (c > 0) - (c < 0);
+}
+
+/// Points are (i + origin) * resolution, so that the grid coordinates of
+/// everything being clipped start near zero
+struct Grid
+{
+  double resolution = 1.0;
+  Int origin_x = 0;
+  Int origin_y = 0;
+
+  IPoint snap(const QPointF& p) const
+  {
+    return IPoint(
+      static_cast<Int>(std::llround(p.x() / resolution)) - origin_x,
+      static_cast<Int>(std::llround(p.y() / resolution)) - origin_y);
+  }
+
+  QPointF unsnap(const IPoint& p) const
+  {
+    return QPointF(
+      static_cast<double>(p.x + origin_x) * resolution,
+      static_cast<double>(p.y + origin_y) * resolution);
+  }
+};
+
+Grid make_grid(
+  const std::vector<QPolygonF>& subject,
+  const std::vector<QPolygonF>& clip,
+  double resolution)
+{
+  double min_x = std::numeric_limits<double>::max();
+  double min_y = min_x;
+  double max_x = std::numeric_limits<double>::lowest();
+  double max_y = max_x;
+  for (const std::vector<QPolygonF>* rings : {&subject, &clip})
+  {
+    for (const QPolygonF& ring : *rings)
+    {
+      for (const QPointF& p : ring)
+      {
+        min_x = std::min(min_x, p.x());
+        min_y = std::min(min_y, p.y());
+        max_x = std::max(max_x, p.x());
+        max_y = std::max(max_y, p.y());
+      }
+    }
+  }
+
+  Grid grid;
+  if (min_x > max_x)
+    return grid;  // nothing to clip
+
+  // the products of two coordinates must fit in 64 bits, with room to
+  // double them for the midpoints in wind()
+  const double max_steps = 268435456.0;  // 2^28
+  const double extent = std::max(max_x - min_x, max_y - min_y);
+  if (!(resolution > 0.0))
+    resolution = 1.0;
+  if (extent / resolution > max_steps)
+    resolution = extent / max_steps;
+  grid.resolution = resolution;
+  grid.origin_x = static_cast<Int>(std::llround(min_x / resolution));
+  grid.origin_y = static_cast<Int>(std::llround(min_y / resolution));
+  return grid;
+}
+
+/// A directed piece of a ring of one of the operands
+struct Segment
+{
+  IPoint a;
+  IPoint b;
+  int operand = 0;
+};
+
+/// Snap the rings, turn them counterclockwise and break them into segments
+void add_rings(
+  const std::vector<QPolygonF>& rings,
+  const int operand,
+  const Grid& grid,
+  std::vector<Segment>& segments)
+{
+  for (const QPolygonF& ring : rings)
+  {
+    std::vector<IPoint> points;
+    points.reserve(ring.size());
+    for (const QPointF& p : ring)
+    {
+      const IPoint q = grid.snap(p);
+      if (points.empty() || q != points.back())
+        points.push_back(q);
+    }
+    while (points.size() > 1 && points.front() == points.back())
+      points.pop_back();
+    if (points.size() < 3)
+      continue;
+
+    // a ring which crosses itself is split like any other crossing, and
+    // the winding of each of its lobes is nonzero, whichever way it turns;
+    // one which doubles back on itself leaves nothing, as its pieces
+    // cancel out
+    long double area = 0.0;
+    for (std::size_t i = 0; i < points.size(); i++)
+      area += cross(points[i], points[(i + 1) % points.size()]);
+    if (area < 0.0)
+      std::reverse(points.begin(), points.end());
+
+    for (std::size_t i = 0; i < points.size(); i++)
+    {
+      Segment segment;
+      segment.a = points[i];
+      segment.b = points[(i + 1) % points.size()];
+      segment.operand = operand;
+      segments.push_back(segment);
+    }
+  }
+}
+
+/// If s and t cross properly, the grid point nearest to where they do
+bool crossing(const Segment& first, const Segment& second, IPoint& p)
+{
+  // round the same way whichever order they come in
+  const bool swap = second.a < first.a ||
+    (second.a == first.a && second.b < first.b);
+  const Segment& s = swap ? second : first;
+  const Segment& t = swap ? first : second;
+  if (orient(t.a, t.b, s.a) * orient(t.a, t.b, s.b) >= 0 ||
+    orient(s.a, s.b, t.a) * orient(s.a, s.b, t.b) >= 0)
+    return false;
+  const IPoint ds = s.b - s.a;
+  const IPoint dt = t.b - t.a;
+  const long double u =
+    static_cast<long double>(cross(t.a - s.a, dt)) /
+    static_cast<long double>(cross(ds, dt));
+  p = IPoint(
+    s.a.x + static_cast<Int>(std::llround(u * ds.x)),
+    s.a.y + static_cast<Int>(std::llround(u * ds.y)));
+  return true;
+}
+
+/// Add the points where the segments cross to hot, found with a sweep
+/// over x which holds the segments spanning the sweep line. Returns how
+/// many were found.
+std::size_t add_crossings(
+  const std::vector<Segment>& segments,
+  std::vector<IPoint>& hot)
+{
+  const std::size_t num_hot = hot.size();
+  std::vector<int> order(segments.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(
+    order.begin(),
+    order.end(),
+    [&segments](const int i, const int j)
+    {
+      return std::min(segments[i].a.x, segments[i].b.x) <
+      std::min(segments[j].a.x, segments[j].b.x);
+    });
+  std::vector<int> active;
+  for (const int i : order)
+  {
+    const Segment& s = segments[i];
+    const Int min_x = std::min(s.a.x, s.b.x);
+    const Int min_y = std::min(s.a.y, s.b.y);
+    const Int max_y = std::max(s.a.y, s.b.y);
+    std::size_t num_active = 0;
+    for (std::size_t k = 0; k < active.size(); k++)
+    {
+      const Segment& t = segments[active[k]];
+      if (std::max(t.a.x, t.b.x) < min_x)
+        continue;  // the sweep line has passed it
+      active[num_active++] = active[k];
+      if (std::max(t.a.y, t.b.y) < min_y || std::min(t.a.y, t.b.y) > max_y)
+        continue;
+      IPoint p;
+      if (crossing(s, t, p))
+        hot.push_back(p);
+    }
+    active.resize(num_active);
+    active.push_back(i);
+  }
+  return hot.size() - num_hot;
+}
+
+/// Whether the segment passes through the pixel of h, the unit square
+/// around it, with its lower and left sides but not the others, as
+/// std::llround() rounds the (positive) grid coordinates
+bool passes_through(const Segment& s, const IPoint& h)
+{
+  // in doubled coordinates, so that the corners are on the grid; the ends
+  // of the segment are then never on the sides of the square
+  const IPoint a = s.a + s.a;
+  const IPoint b = s.b + s.b;
+  const IPoint c = h + h;
+  if (std::max(a.x, b.x) < c.x - 1 || std::min(a.x, b.x) > c.x + 1 ||
+    std::max(a.y, b.y) < c.y - 1 || std::min(a.y, b.y) > c.y + 1)
+    return false;
+  const IPoint corners[4] =
+  {c + IPoint(-1, -1), c + IPoint(1, -1), c + IPoint(1, 1),
+    c + IPoint(-1, 1)};
+  int sides = 0;
+  int touched = -1;
+  for (int i = 0; i < 4; i++)
+  {
+    const int side = orient(a, b, corners[i]);
+    sides |= 1 << (side + 1);
+    if (side == 0)
+      touched = i;
+  }
+  if (sides == 1 || sides == 4)
+    return false;  // all on one side
+  if (sides == 3 || sides == 6)
+  {
+    // only touching a corner, which is in the pixel if it's the lower left
+    // one, and if the segment has passed no other corner
+    int num_touched = 0;
+    for (int i = 0; i < 4; i++)
+      num_touched += orient(a, b, corners[i]) == 0;
+    if (num_touched == 1)
+      return touched == 0;
+  }
+  return true;
+}
+
+/// Reroute every segment through the centers of the hot pixels (sorted
+/// and unique) it passes through, in the order it enters them
+std::vector<Segment> snap_round(
+  const std::vector<Segment>& segments,
+  const std::vector<IPoint>& hot)
+{
+  // bucket the hot pixels into square cells, about one per cell
+  Int min_x = hot.front().x;
+  Int max_x = hot.back().x;
+  Int min_y = std::numeric_limits<Int>::max();
+  Int max_y = std::numeric_limits<Int>::lowest();
+  for (const IPoint& h : hot)
+  {
+    min_y = std::min(min_y, h.y);
+    max_y = std::max(max_y, h.y);
+  }
+  const Int extent = std::max(max_x - min_x, max_y - min_y) + 1;
+  const Int cell_size = std::max<Int>(
+    2,
+    extent / (static_cast<Int>(std::sqrt(static_cast<double>(hot.size()))) +
+    1) + 1);
+  const Int num_x = (max_x - min_x) / cell_size + 1;
+  const Int num_y = (max_y - min_y) / cell_size + 1;
+  std::vector<std::vector<int>> cells(num_x * num_y);
+  for (std::size_t i = 0; i < hot.size(); i++)
+  {
+    cells[((hot[i].y - min_y) / cell_size) * num_x +
+      (hot[i].x - min_x) / cell_size].push_back(static_cast<int>(i));
+  }
+  auto cell_index = [cell_size](const Int c, const Int min, const Int num)
+    {
+      return std::max<Int>(0, std::min<Int>(num - 1, (c - min) / cell_size));
+    };
+
+  std::vector<Segment> pieces;
+  pieces.reserve(2 * segments.size());
+  struct Visit
+  {
+    long double enter;
+    Int along;
+    int idx;
+
+    bool operator<(const Visit& o) const
+    {
+      return enter < o.enter || (enter == o.enter && along < o.along);
+    }
+  };
+  std::vector<Visit> visits;
+  for (const Segment& s : segments)
+  {
+    // the cells of each column of cells that the segment crosses
+    visits.clear();
+    const IPoint d = s.b - s.a;
+    const Int x0 = std::min(s.a.x, s.b.x);
+    const Int x1 = std::max(s.a.x, s.b.x);
+    const Int cx0 = cell_index(x0 - 1, min_x, num_x);
+    const Int cx1 = cell_index(x1 + 1, min_x, num_x);
+    for (Int cx = cx0; cx <= cx1; cx++)
+    {
+      double y0 = std::min(s.a.y, s.b.y);
+      double y1 = std::max(s.a.y, s.b.y);
+      if (d.x != 0)
+      {
+        const double column_x0 = std::max<double>(
+          x0, static_cast<double>(min_x + cx * cell_size) - 1.0);
+        const double column_x1 = std::min<double>(
+          x1, static_cast<double>(min_x + (cx + 1) * cell_size) + 1.0);
+        const double slope = static_cast<double>(d.y) / d.x;
+        const double ya = s.a.y + (column_x0 - s.a.x) * slope;
+        const double yb = s.a.y + (column_x1 - s.a.x) * slope;
+        y0 = std::max(y0, std::min(ya, yb));
+        y1 = std::min(y1, std::max(ya, yb));
+      }
+      const Int cy0 = cell_index(
+        static_cast<Int>(std::floor(y0)) - 1, min_y, num_y);
+      const Int cy1 = cell_index(
+        static_cast<Int>(std::ceil(y1)) + 1, min_y, num_y);
+      for (Int cy = cy0; cy <= cy1; cy++)
+      {
+        for (const int idx : cells[cy * num_x + cx])
+        {
+          if (!passes_through(s, hot[idx]))
+            continue;
+
+          // where the segment enters the square
+          long double enter = 0.0;
+          for (int axis = 0; axis < 2; axis++)
+          {
+            const Int da = axis == 0 ? d.x : d.y;
+            if (da == 0)
+              continue;
+            const Int c = axis == 0 ? hot[idx].x : hot[idx].y;
+            const Int a = axis == 0 ? s.a.x : s.a.y;
+            const long double t0 = (c - 0.5L - a) / da;
+            const long double t1 = (c + 0.5L - a) / da;
+            enter = std::max(enter, std::min(t0, t1));
+          }
+          Visit visit;
+          visit.enter = enter;
+          visit.along = dot(hot[idx] - s.a, d);
+          visit.idx = idx;
+          visits.push_back(visit);
+        }
+      }
+    }
+    std::sort(visits.begin(), visits.end());
+
+    Segment piece = s;
+    for (const Visit& visit : visits)
+    {
+      const IPoint& h = hot[visit.idx];
+      if (h == piece.a || h == s.b)
+        continue;
+      piece.b = h;
+      pieces.push_back(piece);
+      piece.a = h;
+    }
+    piece.b = s.b;
+    if (piece.a != piece.b)
+      pieces.push_back(piece);
+  }
+  return pieces;
+}
+
+/// Snap round the segments, with the pixels of their ends and crossings
+/// hot. None of the pieces pass through the end of another, and where
+/// rounding made some of them cross after all (which segments meeting at
+/// a shallow angle can), those crossings are made hot too and the pieces
+/// rounded again, so that in the end they only meet at their ends, or
+/// coincide.
+void split_segments(std::vector<Segment>& segments)
+{
+  if (segments.empty())
+    return;
+  std::vector<IPoint> hot;
+  hot.reserve(segments.size());
+  for (const Segment& s : segments)
+    hot.push_back(s.a);
+  add_crossings(segments, hot);
+
+  for (int pass = 0; pass < 16; pass++)
+  {
+    std::sort(hot.begin(), hot.end());
+    hot.erase(std::unique(hot.begin(), hot.end()), hot.end());
+    segments = snap_round(segments, hot);
+    if (add_crossings(segments, hot) == 0)
+      break;
+  }
+}
+
+/// One edge of the arrangement, from its smaller end to its larger. The
+/// winding numbers of each operand on its left side are delta more than
+/// on its right.
+struct Piece
+{
+  IPoint p;
+  IPoint q;
+  int delta[2] = {0, 0};
+  int left[2] = {0, 0};
+};
+
+/// Merge the coincident segments into pieces, dropping those which the
+/// rings cross as often in one direction as in the other
+std::vector<Piece> make_pieces(const std::vector<Segment>& segments)
+{
+  std::vector<Piece> pieces;
+  pieces.reserve(segments.size());
+  for (const Segment& s : segments)
+  {
+    if (s.a == s.b)
+      continue;
+    const bool forwards = s.a < s.b;
+    Piece piece;
+    piece.p = forwards ? s.a : s.b;
+    piece.q = forwards ? s.b : s.a;
+    piece.delta[s.operand] = forwards ? 1 : -1;
+    pieces.push_back(piece);
+  }
+  std::sort(
+    pieces.begin(),
+    pieces.end(),
+    [](const Piece& a, const Piece& b)
+    {
+      return a.p < b.p || (a.p == b.p && a.q < b.q);
+    });
+
+  std::size_t num_merged = 0;
+  for (std::size_t i = 0; i < pieces.size(); )
+  {
+    Piece merged = pieces[i];
+    std::size_t j = i + 1;
+    for (; j < pieces.size() &&
+      pieces[j].p == merged.p && pieces[j].q == merged.q; j++)
+    {
+      merged.delta[0] += pieces[j].delta[0];
+      merged.delta[1] += pieces[j].delta[1];
+    }
+    if (merged.delta[0] != 0 || merged.delta[1] != 0)
+      pieces[num_merged++] = merged;
+    i = j;
+  }
+  pieces.resize(num_merged);
+  return pieces;
+}
+
+/// The pieces overlapping each strip of one axis of the grid
+class Strips
+{
+public:
+  Strips(const Int min, const Int max, const std::size_t num_strips)
+  : _min(min),
+    _width(std::max<Int>(1, (max - min) / static_cast<Int>(num_strips) + 1)),
+    _strips(num_strips)
+  {
+  }
+
+  void add(const int idx, const Int from, const Int to)
+  {
+    for (std::size_t i = strip(from); i <= strip(to); i++)
+      _strips[i].push_back(idx);
+  }
+
+  const std::vector<int>& at(const Int c) const { return _strips[strip(c)]; }
+
+private:
+  Int _min;
+  Int _width;
+  std::vector<std::vector<int>> _strips;
+
+  std::size_t strip(const Int c) const
+  {
+    const Int i = (c - _min) / _width;
+    return static_cast<std::size_t>(
+      std::max<Int>(0, std::min<Int>(i, _strips.size() - 1)));
+  }
+};
+
+/// Find the winding numbers on the left of every piece, by casting a ray
+/// from its midpoint to -y (or to -x, for the pieces along y) and adding
+/// up the deltas of the pieces it crosses. Coordinates are doubled so
+/// that the midpoints are on the grid.
+void wind(std::vector<Piece>& pieces)
+{
+  if (pieces.empty())
+    return;
+  Int min_x = pieces.front().p.x;
+  Int max_x = pieces.back().q.x;
+  Int min_y = std::numeric_limits<Int>::max();
+  Int max_y = std::numeric_limits<Int>::lowest();
+  for (const Piece& piece : pieces)
+  {
+    min_x = std::min(min_x, piece.p.x);
+    max_x = std::max(max_x, piece.q.x);
+    min_y = std::min(min_y, std::min(piece.p.y, piece.q.y));
+    max_y = std::max(max_y, std::max(piece.p.y, piece.q.y));
+  }
+  const std::size_t num_strips = static_cast<std::size_t>(
+    std::sqrt(static_cast<double>(pieces.size()))) + 1;
+  Strips x_strips(min_x, max_x, num_strips);
+  Strips y_strips(min_y, max_y, num_strips);
+  for (std::size_t i = 0; i < pieces.size(); i++)
+  {
+    const Piece& piece = pieces[i];
+    const int idx = static_cast<int>(i);
+    if (piece.p.x != piece.q.x)
+      x_strips.add(idx, piece.p.x, piece.q.x);
+    if (piece.p.y != piece.q.y)
+    {
+      y_strips.add(
+        idx,
+        std::min(piece.p.y, piece.q.y),
+        std::max(piece.p.y, piece.q.y));
+    }
+  }
+
+  for (Piece& piece : pieces)
+  {
+    const IPoint m = piece.p + piece.q;
+    int w[2] = {0, 0};
+    if (piece.p.x != piece.q.x)
+    {
+      // below the piece is its right side
+      for (const int idx : x_strips.at(m.x / 2))
+      {
+        const Piece& other = pieces[idx];
+        const IPoint a = other.p + other.p;
+        const IPoint b = other.q + other.q;
+        if (a.x <= m.x && m.x < b.x && orient(a, b, m) > 0)
+        {
+          w[0] += other.delta[0];
+          w[1] += other.delta[1];
+        }
+      }
+      for (int k = 0; k < 2; k++)
+        piece.left[k] = w[k] + piece.delta[k];
+    }
+    else
+    {
+      // the piece goes up, so its left side is to -x
+      for (const int idx : y_strips.at(m.y / 2))
+      {
+        const Piece& other = pieces[idx];
+        const bool up = other.p.y < other.q.y;
+        const IPoint a = up ? other.p + other.p : other.q + other.q;
+        const IPoint b = up ? other.q + other.q : other.p + other.p;
+        if (a.y <= m.y && m.y < b.y && orient(a, b, m) < 0)
+        {
+          w[0] += up ? -other.delta[0] : other.delta[0];
+          w[1] += up ? -other.delta[1] : other.delta[1];
+        }
+      }
+      for (int k = 0; k < 2; k++)
+        piece.left[k] = w[k];
+    }
+  }
+}
+
+bool is_inside(
+  const PolygonClipper::Operation operation,
+  const int subject_winding,
+  const int clip_winding)
+{
+  const bool in_subject = subject_winding != 0;
+  const bool in_clip = clip_winding != 0;
+  switch (operation)
+  {
+    case PolygonClipper::UNION:
+      return in_subject || in_clip;
+    case PolygonClipper::DIFFERENCE:
+      return in_subject && !in_clip;
+    case PolygonClipper::INTERSECTION:
+      return in_subject && in_clip;
+  }
+  return false;
+}
+
+/// A piece of the boundary of the result, with the result on its left
+struct Link
+{
+  IPoint from;
+  IPoint to;
+};
+
+/// Follow the links around each ring of the result
+std::vector<std::vector<IPoint>> stitch(std::vector<Link>& links)
+{
+  std::sort(
+    links.begin(),
+    links.end(),
+    [](const Link& a, const Link& b)
+    {
+      return a.from < b.from || (a.from == b.from && a.to < b.to);
+    });
+
+  std::vector<std::vector<IPoint>> rings;
+  std::vector<char> used(links.size(), 0);
+  const long double two_pi = 2.0L * std::acos(-1.0L);
+  for (std::size_t first = 0; first < links.size(); first++)
+  {
+    if (used[first])
+      continue;
+    std::vector<IPoint> ring;
+    std::size_t current = first;
+    bool closed = false;
+    for (std::size_t steps = 0; steps < links.size(); steps++)
+    {
+      used[current] = 1;
+      ring.push_back(links[current].from);
+      const IPoint at = links[current].to;
+      const IPoint back = links[current].from - at;
+
+      // where rings touch, take the first way out clockwise from the way
+      // back, which is the sharpest left turn and keeps them apart
+      Link key;
+      key.from = at;
+      key.to = IPoint(
+        std::numeric_limits<Int>::lowest(),
+        std::numeric_limits<Int>::lowest());
+      auto it = std::lower_bound(
+        links.begin(),
+        links.end(),
+        key,
+        [](const Link& a, const Link& b)
+        {
+          return a.from < b.from || (a.from == b.from && a.to < b.to);
+        });
+      std::size_t next = links.size();
+      long double next_angle = 0.0;
+      for (; it != links.end() && it->from == at; ++it)
+      {
+        const IPoint out = it->to - at;
+        long double angle = -std::atan2(
+          static_cast<long double>(cross(back, out)),
+          static_cast<long double>(dot(back, out)));
+        if (angle <= 0.0)
+          angle += two_pi;
+        if (next == links.size() || angle < next_angle)
+        {
+          next = static_cast<std::size_t>(it - links.begin());
+          next_angle = angle;
+        }
+      }
+      if (next == first)
+      {
+        closed = true;
+        break;
+      }
+      if (next == links.size() || used[next])
+        break;
+      current = next;
+    }
+    if (closed)
+      rings.push_back(ring);
+  }
+  return rings;
+}
+
+/// Drop the points which are in line with their neighbors, including the
+/// ends of spikes
+void remove_collinear(std::vector<IPoint>& ring)
+{
+  std::vector<IPoint> kept;
+  kept.reserve(ring.size());
+  for (const IPoint& p : ring)
+  {
+    while (kept.size() >= 2 &&
+      orient(kept[kept.size() - 2], kept.back(), p) == 0)
+      kept.pop_back();
+    kept.push_back(p);
+  }
+
+  // and where the ring closes
+  std::size_t begin = 0;
+  bool changed = true;
+  while (changed && kept.size() - begin >= 3)
+  {
+    changed = false;
+    if (orient(kept[kept.size() - 2], kept.back(), kept[begin]) == 0)
+    {
+      kept.pop_back();
+      changed = true;
+    }
+    else if (orient(kept.back(), kept[begin], kept[begin + 1]) == 0)
+    {
+      begin++;
+      changed = true;
+    }
+  }
+  ring.assign(kept.begin() + begin, kept.end());
+}
+
+/// Narrower on average than a step of the grid, like the slivers left
+/// where edges which were collinear before snapping meet
+bool is_sliver(const std::vector<IPoint>& ring)
+{
+  long double area = 0.0;
+  long double perimeter = 0.0;
+  for (std::size_t i = 0; i < ring.size(); i++)
+  {
+    const IPoint& a = ring[i];
+    const IPoint& b = ring[(i + 1) % ring.size()];
+    area += cross(a, b);
+    perimeter += std::hypot(
+      static_cast<long double>(b.x - a.x),
+      static_cast<long double>(b.y - a.y));
+  }
+  return std::abs(area) < perimeter;
+}
+
+/// The unit normal to the left of the direction from a to b
+QPointF left_normal(const QPointF& a, const QPointF& b)
+{
+  const QPointF d = b - a;
+  const double length = std::hypot(d.x(), d.y());
+  return QPointF(-d.y() / length, d.x() / length);
+}
+
+}  // namespace
+
+//=============================================================================
+std::vector<QPolygonF> PolygonClipper::clip(
+  const Operation operation,
+  const std::vector<QPolygonF>& subject,
+  const std::vector<QPolygonF>& clip,
+  const Options& options)
+{
+  const Grid grid = make_grid(subject, clip, options.resolution);
+  std::vector<Segment> segments;
+  add_rings(subject, 0, grid, segments);
+  add_rings(clip, 1, grid, segments);
+  split_segments(segments);
+  std::vector<Piece> pieces = make_pieces(segments);
+  wind(pieces);
+
+  std::vector<Link> links;
+  for (const Piece& piece : pieces)
+  {
+    const bool left = is_inside(operation, piece.left[0], piece.left[1]);
+    const bool right = is_inside(
+      operation,
+      piece.left[0] - piece.delta[0],
+      piece.left[1] - piece.delta[1]);
+    if (left == right)
+      continue;
+    Link link;
+    link.from = left ? piece.p : piece.q;
+    link.to = left ? piece.q : piece.p;
+    links.push_back(link);
+  }
+
+  std::vector<QPolygonF> result;
+  for (std::vector<IPoint>& ring : stitch(links))
+  {
+    remove_collinear(ring);
+    if (ring.size() < 3 || is_sliver(ring))
+      continue;
+    QPolygonF polygon;
+    polygon.reserve(static_cast<int>(ring.size()));
+    for (const IPoint& p : ring)
+      polygon.push_back(grid.unsnap(p));
+    result.push_back(polygon);
+  }
+  return result;
+}
+
+std::vector<QPolygonF> PolygonClipper::offset(
+  const std::vector<QPolygonF>& rings,
+  const double distance,
+  const Options& options)
+{
+  if (distance == 0.0)
+    return clip(UNION, rings, std::vector<QPolygonF>(), options);
+
+  // sweep every edge to both sides, and fill in the outside of each turn
+  const double d = std::abs(distance);
+  std::vector<QPolygonF> swept;
+  for (const QPolygonF& ring : rings)
+  {
+    std::vector<QPointF> points;
+    for (const QPointF& p : ring)
+    {
+      if (points.empty() || p != points.back())
+        points.push_back(p);
+    }
+    while (points.size() > 1 && points.front() == points.back())
+      points.pop_back();
+    const std::size_t n = points.size();
+    if (n < 3)
+      continue;
+
+    for (std::size_t i = 0; i < n; i++)
+    {
+      const QPointF& a = points[i];
+      const QPointF& b = points[(i + 1) % n];
+      const QPointF& c = points[(i + 2) % n];
+      const QPointF n1 = d * left_normal(a, b);
+      const QPointF n2 = d * left_normal(b, c);
+
+      QPolygonF quad;
+      quad << a + n1 << b + n1 << b - n1 << a - n1;
+      swept.push_back(quad);
+
+      const QPointF e1 = b - a;
+      const QPointF e2 = c - b;
+      const double turn = e1.x() * e2.y() - e1.y() * e2.x();
+      if (turn == 0.0)
+        continue;
+      const double side = turn > 0.0 ? -1.0 : 1.0;
+      const double cos_turn = (n1.x() * n2.x() + n1.y() * n2.y()) / (d * d);
+
+      // the miter is 1 / cos(half the turn) times the distance out
+      QPolygonF corner;
+      corner << b << b + side * n1;
+      if (2.0 / (1.0 + cos_turn) <=
+        options.miter_limit * options.miter_limit)
+        corner << b + side * (n1 + n2) / (1.0 + cos_turn);
+      corner << b + side * n2;
+      swept.push_back(corner);
+    }
+  }
+
+  if (distance > 0.0)
+  {
+    std::vector<QPolygonF> grown = rings;
+    grown.insert(grown.end(), swept.begin(), swept.end());
+    return clip(UNION, grown, std::vector<QPolygonF>(), options);
+  }
+  return clip(DIFFERENCE, rings, swept, options);
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef TRAFFIC_EDITOR__POLYGON_CLIPPER_HPP
+#define TRAFFIC_EDITOR__POLYGON_CLIPPER_HPP
+
+#include <vector>
+
+#include <QPolygonF>
+
+//=============================================================================
+/// Boolean operations and offsetting of sets of rings, in the units of the
+/// vertex coordinates, for reshaping the polygons of a level.
+///
+/// The points are first snapped to an integer grid of the given
+/// resolution, so that every predicate after that is exact. A sweep over x
+/// finds the segments which cross or touch, and splits them there, with
+/// the crossings rounded to the grid (and swept again, in case the
+/// rounding made new ones). Each piece of the resulting arrangement then
+/// knows the winding numbers of both operands on its two sides, from a ray
+/// cast against the pieces in the same strip of the level, and the pieces
+/// with the result inside on just one side are stitched into rings,
+/// turning as sharply left as possible where rings touch, so that every
+/// ring comes out simple.
+///
+/// The inputs are read with the nonzero rule after each ring has been
+/// turned counterclockwise, so overlapping rings of one operand are simply
+/// merged, and rings which cross themselves (a bowtie, say) are inside
+/// wherever they wind around. The outlines of the result are
+/// counterclockwise and its holes clockwise (in the sense of
+/// PolygonGeometry::signed_area()), with the collinear points removed.
+class PolygonClipper
+{
+public:
+  enum Operation
+  {
+    UNION = 0,
+    DIFFERENCE,
+    INTERSECTION
+  };
+
+  struct Options
+  {
+    /// Size of the snapping grid. It is made coarser if the rings span
+    /// more than 2^28 steps of it, to keep the arithmetic in 64 bits.
+    double resolution = 0.01;
+
+    /// A corner grown by offset() is mitered if the miter is at most this
+    /// many times the distance from the corner, and bevelled otherwise
+    double miter_limit = 2.0;
+  };
+
+  /// Subject union clip, subject minus clip, or subject intersected with
+  /// clip. Either operand may be empty.
+  static std::vector<QPolygonF> clip(
+    const Operation operation,
+    const std::vector<QPolygonF>& subject,
+    const std::vector<QPolygonF>& clip,
+    const Options& options);
+
+  /// Grow the rings by the distance, or shrink them if it is negative. The
+  /// edges are moved out in parallel, and the corners mitered. This is
+  /// the union (or difference) of the rings with the edges swept to both
+  /// sides, so anything narrower than twice a negative distance vanishes.
+  static std::vector<QPolygonF> offset(
+    const std::vector<QPolygonF>& rings,
+    const double distance,
+    const Options& options);
+};
+
+#endif
@@ -0,0 +1,349 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+
+#include "polygon_geometry.hpp"
+
+namespace {
+
+double cross(const QPointF& o, const QPointF& a, const QPointF& b)
+{
+  return (a.x() - o.x()) * (b.y() - o.y()) - (a.y() - o.y()) * (b.x() - o.x());
+}
+
+/// True when p lies on the segment a-b, other than at its ends
+bool on_segment(const QPointF& p, const QPointF& a, const QPointF& b)
+{
+  if (p == a || p == b || cross(a, b, p) != 0.0)
+    return false;
+  return std::min(a.x(), b.x()) <= p.x() && p.x() <= std::max(a.x(), b.x()) &&
+    std::min(a.y(), b.y()) <= p.y() && p.y() <= std::max(a.y(), b.y());
+}
+
+/// True when the open segments p1-p2 and q1-q2 properly cross
+bool segments_cross(
+  const QPointF& p1,
+  const QPointF& p2,
+  const QPointF& q1,
+  const QPointF& q2)
+{
+  const double d1 = cross(q1, q2, p1);
+  const double d2 = cross(q1, q2, p2);
+  const double d3 = cross(p1, p2, q1);
+  const double d4 = cross(p1, p2, q2);
+  return ((d1 > 0 && d2 < 0) || (d1 < 0 && d2 > 0)) &&
+    ((d3 > 0 && d4 < 0) || (d3 < 0 && d4 > 0));
+}
+
+bool segment_crosses_ring(
+  const QPointF& a,
+  const QPointF& b,
+  const std::vector<QPointF>& ring)
+{
+  for (std::size_t i = 0; i < ring.size(); i++)
+  {
+    const QPointF& c = ring[i];
+    const QPointF& d = ring[(i + 1) % ring.size()];
+    if (on_segment(c, a, b))
+      return true;
+    if (c == a || c == b || d == a || d == b)
+      continue;
+    if (segments_cross(a, b, c, d))
+      return true;
+  }
+  return false;
+}
+
+bool rings_cross(
+  const std::vector<QPointF>& a,
+  const std::vector<QPointF>& b)
+{
+  for (std::size_t i = 0; i < a.size(); i++)
+  {
+    if (segment_crosses_ring(a[i], a[(i + 1) % a.size()], b))
+      return true;
+  }
+  return false;
+}
+
+bool all_inside(const std::vector<QPointF>& points, const QPolygonF& region)
+{
+  for (const QPointF& p : points)
+  {
+    if (!region.containsPoint(p, Qt::OddEvenFill))
+      return false;
+  }
+  return true;
+}
+
+bool any_inside(const std::vector<QPointF>& points, const QPolygonF& region)
+{
+  for (const QPointF& p : points)
+  {
+    if (region.containsPoint(p, Qt::OddEvenFill))
+      return true;
+  }
+  return false;
+}
+
+std::vector<QPointF> ring_points(const QPolygonF& polygon, const bool ccw)
+{
+  std::vector<QPointF> ring(polygon.begin(), polygon.end());
+  if (ring.size() > 1 && ring.front() == ring.back())
+    ring.pop_back();
+  if ((PolygonGeometry::signed_area(polygon) > 0) != ccw)
+    std::reverse(ring.begin(), ring.end());
+  return ring;
+}
+
+/// Splice a hole into the outer ring through a bridge from its rightmost
+/// vertex to the nearest ring vertex it can see, turning the polygon with a
+/// hole into a single (weakly simple) ring that ear clipping can handle.
+bool bridge_hole(
+  std::vector<QPointF>& ring,
+  const std::vector<QPointF>& hole,
+  const std::vector<std::vector<QPointF>>& other_holes)
+{
+  QPolygonF hole_polygon;
+  for (const QPointF& p : hole)
+    hole_polygon.append(p);
+  std::size_t m = 0;
+  for (std::size_t i = 1; i < hole.size(); i++)
+  {
+    if (hole[i].x() > hole[m].x())
+      m = i;
+  }
+  const QPointF& hole_point = hole[m];
+
+  std::vector<std::size_t> candidates(ring.size());
+  for (std::size_t i = 0; i < ring.size(); i++)
+    candidates[i] = i;
+  auto distance2 = [&hole_point](const QPointF& p)
+    {
+      const QPointF d = p - hole_point;
+      return d.x() * d.x() + d.y() * d.y();
+    };
+  std::sort(
+    candidates.begin(),
+    candidates.end(),
+    [&ring, &distance2](const std::size_t a, const std::size_t b)
+    {
+      return distance2(ring[a]) < distance2(ring[b]);
+    });
+
+  for (const std::size_t v : candidates)
+  {
+    const QPointF& ring_point = ring[v];
+    if (segment_crosses_ring(hole_point, ring_point, ring) ||
+      segment_crosses_ring(hole_point, ring_point, hole))
+      continue;
+
+    // a concave hole may be left through its own interior
+    const QPointF midpoint = 0.5 * (hole_point + ring_point);
+    if (hole_polygon.containsPoint(midpoint, Qt::OddEvenFill))
+      continue;
+    bool blocked = false;
+    for (const std::vector<QPointF>& other : other_holes)
+    {
+      if (segment_crosses_ring(hole_point, ring_point, other))
+      {
+        blocked = true;
+        break;
+      }
+    }
+    if (blocked)
+      continue;
+
+    std::vector<QPointF> spliced;
+    spliced.reserve(ring.size() + hole.size() + 2);
+    spliced.insert(spliced.end(), ring.begin(), ring.begin() + v + 1);
+    for (std::size_t k = 0; k <= hole.size(); k++)
+      spliced.push_back(hole[(m + k) % hole.size()]);
+    spliced.push_back(ring_point);
+    spliced.insert(spliced.end(), ring.begin() + v + 1, ring.end());
+    ring.swap(spliced);
+    return true;
+  }
+  return false;
+}
+
+bool in_triangle(
+  const QPointF& p,
+  const QPointF& a,
+  const QPointF& b,
+  const QPointF& c)
+{
+  return cross(a, b, p) >= 0 && cross(b, c, p) >= 0 && cross(c, a, p) >= 0;
+}
+
+/// Ear clipping of a counterclockwise ring
+void triangulate(
+  const std::vector<QPointF>& points,
+  std::vector<QPointF>& triangles)
+{
+  std::vector<std::size_t> remaining(points.size());
+  for (std::size_t i = 0; i < points.size(); i++)
+    remaining[i] = i;
+
+  std::size_t i = 0;
+  std::size_t attempts = 0;  // since the last clipped ear
+  while (remaining.size() > 3 && attempts < remaining.size())
+  {
+    const std::size_t n = remaining.size();
+    i %= n;
+    const QPointF& a = points[remaining[(i + n - 1) % n]];
+    const QPointF& b = points[remaining[i]];
+    const QPointF& c = points[remaining[(i + 1) % n]];
+    const double turn = cross(a, b, c);
+
+    bool ear = turn > 0;
+    for (std::size_t j = 0; ear && j < n; j++)
+    {
+      const QPointF& p = points[remaining[j]];
+      // bridged holes repeat points, which never block their own ears
+      if (p == a || p == b || p == c)
+        continue;
+      if (in_triangle(p, a, b, c))
+        ear = false;
+    }
+
+    if (ear || turn == 0.0)
+    {
+      if (ear)
+      {
+        triangles.push_back(a);
+        triangles.push_back(b);
+        triangles.push_back(c);
+      }
+      remaining.erase(remaining.begin() + i);
+      attempts = 0;
+    }
+    else
+    {
+      i++;
+      attempts++;
+    }
+  }
+
+  if (remaining.size() == 3 &&
+    cross(points[remaining[0]], points[remaining[1]], points[remaining[2]]) > 0)
+  {
+    for (const std::size_t idx : remaining)
+      triangles.push_back(points[idx]);
+  }
+}
+
+}  // anonymous namespace
+
+PolygonGeometry PolygonGeometry::compute(
+  const QPolygonF& outline,
+  const std::vector<QPolygonF>& holes)
+{
+  PolygonGeometry geometry;
+  geometry.outline = outline;
+  if (outline.isEmpty())
+    return geometry;
+  geometry.bounds = outline.boundingRect();
+
+  for (int i = 0; i < outline.size(); i++)
+  {
+    const QPointF edge = outline[(i + 1) % outline.size()] - outline[i];
+    geometry.perimeter += std::hypot(edge.x(), edge.y());
+  }
+  geometry.area = std::abs(signed_area(outline));
+  if (outline.size() < 3)
+    return geometry;
+
+  std::vector<QPointF> ring = ring_points(outline, true);
+
+  // keep only the holes that lie inside, and apart from each other
+  std::vector<std::vector<QPointF>> cut;
+  std::vector<QPolygonF> cut_polygons;
+  for (const QPolygonF& hole : holes)
+  {
+    if (hole.size() < 3 || !geometry.bounds.contains(hole.boundingRect()))
+      continue;
+    std::vector<QPointF> hole_ring = ring_points(hole, false);
+    if (!all_inside(hole_ring, outline) || rings_cross(hole_ring, ring))
+      continue;
+
+    bool overlaps = false;
+    for (std::size_t i = 0; i < cut.size() && !overlaps; i++)
+    {
+      overlaps = any_inside(hole_ring, cut_polygons[i]) ||
+        any_inside(cut[i], hole) ||
+        rings_cross(hole_ring, cut[i]);
+    }
+    if (overlaps)
+      continue;
+    cut.push_back(hole_ring);
+    cut_polygons.push_back(hole);
+  }
+
+  // bridge the holes from right to left, so earlier bridges don't block
+  std::vector<std::size_t> order(cut.size());
+  for (std::size_t i = 0; i < cut.size(); i++)
+    order[i] = i;
+  auto max_x = [](const std::vector<QPointF>& points)
+    {
+      double x = points.front().x();
+      for (const QPointF& p : points)
+        x = std::max(x, p.x());
+      return x;
+    };
+  std::sort(
+    order.begin(),
+    order.end(),
+    [&cut, &max_x](const std::size_t a, const std::size_t b)
+    {
+      return max_x(cut[a]) > max_x(cut[b]);
+    });
+
+  for (std::size_t k = 0; k < order.size(); k++)
+  {
+    std::vector<std::vector<QPointF>> later;
+    for (std::size_t j = k + 1; j < order.size(); j++)
+      later.push_back(cut[order[j]]);
+    if (!bridge_hole(ring, cut[order[k]], later))
+      continue;
+    geometry.area -= std::abs(signed_area(cut_polygons[order[k]]));
+    geometry.num_holes++;
+  }
+
+  triangulate(ring, geometry.triangles);
+  return geometry;
+}
+
+bool PolygonGeometry::contains(const QPointF& point) const
+{
+  return bounds.contains(point) &&
+    outline.containsPoint(point, Qt::OddEvenFill);
+}
+
+double PolygonGeometry::signed_area(const QPolygonF& ring)
+{
+  double twice_area = 0.0;
+  for (int i = 0; i < ring.size(); i++)
+  {
+    const QPointF& a = ring[i];
+    const QPointF& b = ring[(i + 1) % ring.size()];
+    twice_area += a.x() * b.y() - b.x() * a.y();
+  }
+  return 0.5 * twice_area;
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__POLYGON_GEOMETRY_HPP
+#define TRAFFIC_EDITOR__POLYGON_GEOMETRY_HPP
+
+#include <vector>
+
+#include <QPointF>
+#include <QPolygonF>
+#include <QRectF>
+
+//=============================================================================
+/// Derived shape of one polygon of a level: its outline, bounds, area,
+/// perimeter and a triangulation with the holes inside it cut out, as the
+/// building generator does for floors. Everything is in scene units
+/// (pixels of the level drawing). Level caches one of these per polygon and
+/// recomputes it only when the polygon or its vertices change.
+class PolygonGeometry
+{
+public:
+  /// Vertex positions in order; the first point is not repeated at the end
+  QPolygonF outline;
+  QRectF bounds;
+
+  /// Enclosed area, less the area of the holes that were cut out
+  double area = 0.0;
+
+  /// Length of the closed outline, not counting the holes
+  double perimeter = 0.0;
+
+  /// Three points per triangle, covering the outline minus the holes
+  std::vector<QPointF> triangles;
+
+  /// How many of the holes passed to compute() lay inside and were cut out
+  int num_holes = 0;
+
+  /// Holes which are not entirely inside the outline, or which overlap an
+  /// earlier hole, are ignored. Self-intersecting outlines are only
+  /// partially triangulated.
+  static PolygonGeometry compute(
+    const QPolygonF& outline,
+    const std::vector<QPolygonF>& holes = std::vector<QPolygonF>());
+
+  std::size_t num_triangles() const { return triangles.size() / 3; }
+
+  /// Inside the outline (holes are separate polygons, with their own
+  /// geometry, so they are not excluded here)
+  bool contains(const QPointF& point) const;
+
+  /// Shoelace area; positive when counterclockwise in a y-up frame
+  static double signed_area(const QPolygonF& ring);
+};
+
+#endif
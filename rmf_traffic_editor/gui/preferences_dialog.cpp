@@ -15,10 +15,39 @@
  *
 */
 
+#include "level_of_detail.hpp"
 #include "preferences_dialog.h"
 #include "preferences_keys.h"
 #include <QtWidgets>
 
+namespace {
+
+QSpinBox* create_spin_box(
+  QWidget* parent,
+  const int minimum,
+  const int maximum,
+  const int value,
+  const QString& suffix = QString())
+{
+  QSpinBox* spin_box = new QSpinBox(parent);
+  spin_box->setRange(minimum, maximum);
+  spin_box->setValue(value);
+  spin_box->setSuffix(suffix);
+  return spin_box;
+}
+
+QDoubleSpinBox* create_scale_spin_box(QWidget* parent, const double value)
+{
+  QDoubleSpinBox* spin_box = new QDoubleSpinBox(parent);
+  spin_box->setRange(0.01, 10.0);
+  spin_box->setSingleStep(0.05);
+  spin_box->setDecimals(2);
+  spin_box->setValue(value);
+  return spin_box;
+}
+
+}  // namespace
+
 
 PreferencesDialog::PreferencesDialog(QWidget* parent)
 : QDialog(parent)
@@ -56,9 +85,30 @@ PreferencesDialog::PreferencesDialog(QWidget* parent)
   open_previous_building_checkbox->setChecked(
     settings.value(preferences_keys::open_previous_building).toBool());
 
+  opengl_viewport_checkbox = new QCheckBox(
+    "Use OpenGL for the map view (faster on large maps)", this);
+  opengl_viewport_checkbox->setChecked(
+    settings.value(preferences_keys::opengl_viewport).toBool());
+
+  QHBoxLayout* scene_index_layout = new QHBoxLayout;
+  scene_index_combo_box = new QComboBox(this);
+  scene_index_combo_box->addItem(
+    "Automatic (none while dragging or for small maps)", "auto");
+  scene_index_combo_box->addItem("BSP tree (faster painting)", "bsp");
+  scene_index_combo_box->addItem("None (faster moving of items)", "none");
+  const int scene_index_idx = scene_index_combo_box->findData(
+    settings.value(preferences_keys::scene_index, "auto").toString());
+  scene_index_combo_box->setCurrentIndex(
+    scene_index_idx >= 0 ? scene_index_idx : 0);
+  scene_index_layout->addWidget(new QLabel("scene index:"));
+  scene_index_layout->addWidget(scene_index_combo_box);
+
   QVBoxLayout* vbox_layout = new QVBoxLayout;
   vbox_layout->addWidget(open_previous_building_checkbox);
+  vbox_layout->addWidget(opengl_viewport_checkbox);
+  vbox_layout->addLayout(scene_index_layout);
   vbox_layout->addLayout(thumbnail_path_layout);
+  vbox_layout->addWidget(create_performance_group(settings));
   // todo: some sort of separator (?)
   vbox_layout->addLayout(bottom_buttons_layout);
 
@@ -69,6 +119,82 @@ PreferencesDialog::~PreferencesDialog()
 {
 }
 
+QWidget* PreferencesDialog::create_performance_group(QSettings& settings)
+{
+  // the defaults here are those the editor uses when nothing is set
+  QGroupBox* group_box = new QGroupBox("Performance", this);
+
+  worker_threads_spin_box = create_spin_box(
+    group_box, 0, 256,
+    settings.value(preferences_keys::worker_threads, 0).toInt());
+  worker_threads_spin_box->setSpecialValueText("one per core");
+
+  level_image_memory_spin_box = create_spin_box(
+    group_box, 16, 1024 * 1024,
+    settings.value(preferences_keys::level_image_memory_mb, 1024).toInt(),
+    " MB");
+  cached_level_scenes_spin_box = create_spin_box(
+    group_box, 0, 64,
+    settings.value(preferences_keys::cached_level_scenes, 4).toInt());
+  drawing_preview_size_spin_box = create_spin_box(
+    group_box, 0, 65536,
+    settings.value(preferences_keys::drawing_preview_size, 2048).toInt(),
+    " px");
+  drawing_preview_size_spin_box->setSpecialValueText("full size");
+  basemap_memory_spin_box = create_spin_box(
+    group_box, 1, 64 * 1024,
+    settings.value(preferences_keys::basemap_memory_mb, 128).toInt(),
+    " MB");
+  basemap_disk_spin_box = create_spin_box(
+    group_box, 0, 1024 * 1024,
+    settings.value(preferences_keys::basemap_disk_mb, 512).toInt(),
+    " MB");
+  undo_memory_spin_box = create_spin_box(
+    group_box, 1, 1024 * 1024,
+    settings.value(preferences_keys::undo_memory_mb, 256).toInt(),
+    " MB");
+
+  lod_medium_scale_spin_box = create_scale_spin_box(
+    group_box,
+    settings.value(
+      preferences_keys::lod_medium_scale,
+      LevelOfDetail::DEFAULT_MEDIUM_SCALE).toDouble());
+  lod_fine_scale_spin_box = create_scale_spin_box(
+    group_box,
+    settings.value(
+      preferences_keys::lod_fine_scale,
+      LevelOfDetail::DEFAULT_FINE_SCALE).toDouble());
+
+  lazy_level_images_checkbox = new QCheckBox(
+    "Load the images of a level when it is first shown", group_box);
+  lazy_level_images_checkbox->setChecked(
+    settings.value(preferences_keys::lazy_level_images, false).toBool());
+  building_cache_checkbox = new QCheckBox(
+    "Cache parsed buildings to reopen them faster", group_box);
+  building_cache_checkbox->setChecked(
+    settings.value(preferences_keys::building_cache, false).toBool());
+  stream_yaml_parser_checkbox = new QCheckBox(
+    "Parse building files as a stream (less memory)", group_box);
+  stream_yaml_parser_checkbox->setChecked(
+    settings.value(preferences_keys::stream_yaml_parser, false).toBool());
+
+  QFormLayout* form_layout = new QFormLayout(group_box);
+  form_layout->addRow("worker threads:", worker_threads_spin_box);
+  form_layout->addRow("level image memory:", level_image_memory_spin_box);
+  form_layout->addRow("cached level scenes:", cached_level_scenes_spin_box);
+  form_layout->addRow("drawing preview size:", drawing_preview_size_spin_box);
+  form_layout->addRow("basemap tile memory:", basemap_memory_spin_box);
+  form_layout->addRow("basemap tile disk cache:", basemap_disk_spin_box);
+  form_layout->addRow("undo history memory:", undo_memory_spin_box);
+  form_layout->addRow(
+    "medium detail from zoom:", lod_medium_scale_spin_box);
+  form_layout->addRow("full detail from zoom:", lod_fine_scale_spin_box);
+  form_layout->addRow(lazy_level_images_checkbox);
+  form_layout->addRow(building_cache_checkbox);
+  form_layout->addRow(stream_yaml_parser_checkbox);
+  return group_box;
+}
+
 void PreferencesDialog::thumbnail_path_button_clicked()
 {
   QFileDialog file_dialog(this, "Find Thumbnail Path");
@@ -114,5 +240,52 @@ void PreferencesDialog::ok_button_clicked()
     preferences_keys::open_previous_building,
     open_previous_building_checkbox->isChecked());
 
+  settings.setValue(
+    preferences_keys::opengl_viewport,
+    opengl_viewport_checkbox->isChecked());
+
+  settings.setValue(
+    preferences_keys::scene_index,
+    scene_index_combo_box->currentData().toString());
+
+  settings.setValue(
+    preferences_keys::worker_threads,
+    worker_threads_spin_box->value());
+  settings.setValue(
+    preferences_keys::level_image_memory_mb,
+    level_image_memory_spin_box->value());
+  settings.setValue(
+    preferences_keys::cached_level_scenes,
+    cached_level_scenes_spin_box->value());
+  settings.setValue(
+    preferences_keys::drawing_preview_size,
+    drawing_preview_size_spin_box->value());
+  settings.setValue(
+    preferences_keys::basemap_memory_mb,
+    basemap_memory_spin_box->value());
+  settings.setValue(
+    preferences_keys::basemap_disk_mb,
+    basemap_disk_spin_box->value());
+  settings.setValue(
+    preferences_keys::undo_memory_mb,
+    undo_memory_spin_box->value());
+  settings.setValue(
+    preferences_keys::lod_medium_scale,
+    lod_medium_scale_spin_box->value());
+  settings.setValue(
+    preferences_keys::lod_fine_scale,
+    std::max(
+      lod_medium_scale_spin_box->value(),
+      lod_fine_scale_spin_box->value()));
+  settings.setValue(
+    preferences_keys::lazy_level_images,
+    lazy_level_images_checkbox->isChecked());
+  settings.setValue(
+    preferences_keys::building_cache,
+    building_cache_checkbox->isChecked());
+  settings.setValue(
+    preferences_keys::stream_yaml_parser,
+    stream_yaml_parser_checkbox->isChecked());
+
   accept();
 }
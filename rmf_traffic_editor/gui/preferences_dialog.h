@@ -21,6 +21,10 @@
 #include <QDialog>
 class QLineEdit;
 class QCheckBox;
+class QComboBox;
+class QDoubleSpinBox;
+class QSettings;
+class QSpinBox;
 
 
 class PreferencesDialog : public QDialog
@@ -33,6 +37,23 @@ private:
   QLineEdit* thumbnail_path_line_edit;
   QPushButton* thumbnail_path_button;
   QCheckBox* open_previous_building_checkbox;
+  QCheckBox* opengl_viewport_checkbox;
+  QComboBox* scene_index_combo_box;
+
+  // performance
+  QSpinBox* worker_threads_spin_box;
+  QSpinBox* level_image_memory_spin_box;
+  QSpinBox* cached_level_scenes_spin_box;
+  QSpinBox* drawing_preview_size_spin_box;
+  QSpinBox* basemap_memory_spin_box;
+  QSpinBox* basemap_disk_spin_box;
+  QSpinBox* undo_memory_spin_box;
+  QDoubleSpinBox* lod_medium_scale_spin_box;
+  QDoubleSpinBox* lod_fine_scale_spin_box;
+  QCheckBox* lazy_level_images_checkbox;
+  QCheckBox* building_cache_checkbox;
+  QCheckBox* stream_yaml_parser_checkbox;
+  QWidget* create_performance_group(QSettings& settings);
   QPushButton* ok_button, * cancel_button;
 
 private slots:
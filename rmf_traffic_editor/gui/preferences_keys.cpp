@@ -18,3 +18,37 @@ const QString preferences_keys::viewport_center_x("editor/viewport_center_x");
 const QString preferences_keys::viewport_center_y("editor/viewport_center_y");
 const QString preferences_keys::viewport_scale("editor/viewport_scale");
 const QString preferences_keys::level_name("editor/level_name");
+const QString preferences_keys::opengl_viewport("editor/opengl_viewport");
+const QString preferences_keys::scene_index("editor/scene_index");
+const QString preferences_keys::autosave_seconds("editor/autosave_seconds");
+const QString preferences_keys::building_cache("editor/building_cache");
+const QString preferences_keys::lazy_level_images("editor/lazy_level_images");
+const QString preferences_keys::stream_yaml_parser(
+  "editor/stream_yaml_parser");
+const QString preferences_keys::level_image_memory_mb(
+  "editor/level_image_memory_mb");
+const QString preferences_keys::cached_level_scenes(
+  "editor/cached_level_scenes");
+const QString preferences_keys::drawing_preview_size(
+  "editor/drawing_preview_size");
+const QString preferences_keys::split_building_files(
+  "editor/split_building_files");
+const QString preferences_keys::reoptimize_layers(
+  "editor/reoptimize_layers_on_edit");
+const QString preferences_keys::undo_memory_mb("editor/undo_memory_mb");
+const QString preferences_keys::worker_threads("editor/worker_threads");
+const QString preferences_keys::lod_medium_scale("editor/lod_medium_scale");
+const QString preferences_keys::lod_fine_scale("editor/lod_fine_scale");
+const QString preferences_keys::basemap_url("editor/basemap_url");
+const QString preferences_keys::basemap_memory_mb("editor/basemap_memory_mb");
+const QString preferences_keys::basemap_disk_mb("editor/basemap_disk_mb");
+const QString preferences_keys::capture_frame_size(
+  "editor/capture_frame_size");
+const QString preferences_keys::watch_files("editor/watch_files");
+const QString preferences_keys::change_deltas("editor/change_deltas");
+const QString preferences_keys::change_delta_socket(
+  "editor/change_delta_socket");
+const QString preferences_keys::robot_footprint("editor/robot_footprint");
+const QString preferences_keys::edit_sync_port("editor/edit_sync_port");
+const QString preferences_keys::edit_sync_address("editor/edit_sync_address");
+const QString preferences_keys::edit_journal("editor/edit_journal");
@@ -16,6 +16,32 @@ extern const QString viewport_center_x;
 extern const QString viewport_center_y;
 extern const QString viewport_scale;
 extern const QString level_name;
+extern const QString opengl_viewport;
+extern const QString scene_index;
+extern const QString autosave_seconds;
+extern const QString building_cache;
+extern const QString lazy_level_images;
+extern const QString stream_yaml_parser;
+extern const QString level_image_memory_mb;
+extern const QString cached_level_scenes;
+extern const QString drawing_preview_size;
+extern const QString split_building_files;
+extern const QString reoptimize_layers;
+extern const QString undo_memory_mb;
+extern const QString worker_threads;
+extern const QString lod_medium_scale;
+extern const QString lod_fine_scale;
+extern const QString basemap_url;
+extern const QString basemap_memory_mb;
+extern const QString basemap_disk_mb;
+extern const QString capture_frame_size;
+extern const QString watch_files;
+extern const QString change_deltas;
+extern const QString change_delta_socket;
+extern const QString robot_footprint;
+extern const QString edit_sync_port;
+extern const QString edit_sync_address;
+extern const QString edit_journal;
 }
 
 #endif
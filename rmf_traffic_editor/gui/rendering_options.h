@@ -20,6 +20,12 @@
 
 #include <array>
 
+#include <QRectF>
+
+#include "level_of_detail.hpp"
+
+class DrawProfile;
+
 class RenderingOptions
 {
 public:
@@ -27,8 +33,31 @@ public:
   std::array<bool, NUM_BUILDING_LANES> show_building_lanes;
 
   bool show_models = true;
+
+  /// Outline the triangles that the floors will be meshed with
+  bool show_floor_triangulation = false;
+
+  /// Paint all vertices of a level with a single VertexLayerItem
+  bool batch_vertices = false;
+
+  /// Paint the walls, measurements and doors of a level with one
+  /// EdgeLayerItem each
+  bool batch_edges = false;
+
+  /// Only instantiate entities near the visible part of the map
+  bool cull_to_viewport = false;
+
+  /// In scene coordinates; empty means everything is drawn
+  QRectF cull_rect;
   int active_traffic_map_idx = 0;
 
+  /// Follows the zoom of the MapView
+  LevelOfDetail::Tier lod_tier = LevelOfDetail::FINE;
+
+  /// Where to record draw timings, while the profiling overlay is shown.
+  /// Borrowed pointer; nullptr disables profiling.
+  DrawProfile* profile = nullptr;
+
   RenderingOptions();
 };
 
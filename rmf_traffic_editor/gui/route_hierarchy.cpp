@@ -0,0 +1,762 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <queue>
+
+#include "route_hierarchy.hpp"
+#include "task_pool.hpp"
+
+using std::vector;
+
+namespace {
+
+static_assert(sizeof(RouteHierarchy::FileHeader) == 64, "header layout");
+static_assert(sizeof(RouteHierarchy::ArcRecord) == 16, "arc layout");
+
+const float INF = std::numeric_limits<float>::infinity();
+
+/// A witness search gives up after settling this many nodes, and the
+/// shortcut is added; that keeps contraction fast at the price of a few
+/// shortcuts which aren't needed
+const int WITNESS_SETTLED_LIMIT = 500;
+
+/// Sources (or targets) searched by one task of travel_times()
+const int SEARCHES_PER_TASK = 16;
+
+/// An arc between uncontracted nodes while contracting
+struct WorkArc
+{
+  uint32_t node;
+  uint32_t middle;
+  float time;
+  float length;
+};
+
+typedef std::pair<float, uint32_t> HeapEntry;
+
+/// Where contraction keeps the graph that remains, and the upward arcs of
+/// each node as it is contracted
+class Contractor
+{
+public:
+  vector<vector<WorkArc>> out;
+  vector<vector<WorkArc>> in;
+  vector<vector<RouteHierarchy::ArcRecord>> forward;
+  vector<vector<RouteHierarchy::ArcRecord>> backward;
+  vector<bool> contracted;
+  vector<int> deleted_neighbours;
+
+  Contractor(const uint32_t num_nodes)
+  : out(num_nodes),
+    in(num_nodes),
+    forward(num_nodes),
+    backward(num_nodes),
+    contracted(num_nodes, false),
+    deleted_neighbours(num_nodes, 0),
+    _cost(num_nodes, INF),
+    _stamp(num_nodes, 0)
+  {
+  }
+
+  /// Add u->w, or make the one there quicker
+  void add_arc(
+    const uint32_t u,
+    const uint32_t w,
+    const uint32_t middle,
+    const float time,
+    const float length)
+  {
+    for (WorkArc& arc : out[u])
+    {
+      if (arc.node != w)
+        continue;
+      if (time < arc.time)
+      {
+        arc = WorkArc{w, middle, time, length};
+        for (WorkArc& reverse : in[w])
+        {
+          if (reverse.node == u)
+            reverse = WorkArc{u, middle, time, length};
+        }
+      }
+      return;
+    }
+    out[u].push_back(WorkArc{w, middle, time, length});
+    in[w].push_back(WorkArc{u, middle, time, length});
+  }
+
+  int num_neighbours(const uint32_t v) const
+  {
+    int count = static_cast<int>(out[v].size());
+    for (const WorkArc& arc : in[v])
+    {
+      bool seen = false;
+      for (const WorkArc& other : out[v])
+        seen = seen || other.node == arc.node;
+      if (!seen)
+        count++;
+    }
+    return count;
+  }
+
+  /// Contract v, or with simulate just count the shortcuts it would need
+  int contract(const uint32_t v, const bool simulate)
+  {
+    int num_shortcuts = 0;
+    for (const WorkArc& in_arc : in[v])
+    {
+      const uint32_t u = in_arc.node;
+      float max_time = -1.0f;
+      for (const WorkArc& out_arc : out[v])
+      {
+        if (out_arc.node != u)
+          max_time = std::max(max_time, in_arc.time + out_arc.time);
+      }
+      if (max_time < 0.0f)
+        continue;  // nowhere to go but back
+      witness_search(u, v, max_time);
+
+      for (const WorkArc& out_arc : out[v])
+      {
+        const uint32_t w = out_arc.node;
+        if (w == u)
+          continue;
+        const float time = in_arc.time + out_arc.time;
+        if (_stamp[w] == _search && _cost[w] <= time)
+          continue;  // there is another way, as quick
+        num_shortcuts++;
+        if (!simulate)
+          add_arc(u, w, v, time, in_arc.length + out_arc.length);
+      }
+    }
+    if (simulate)
+      return num_shortcuts;
+
+    // what remains of v's arcs all go up the hierarchy
+    for (const WorkArc& arc : out[v])
+    {
+      forward[v].push_back(
+        RouteHierarchy::ArcRecord{arc.node, arc.middle, arc.time, arc.length});
+      remove(in[arc.node], v);
+      deleted_neighbours[arc.node]++;
+    }
+    for (const WorkArc& arc : in[v])
+    {
+      backward[v].push_back(
+        RouteHierarchy::ArcRecord{arc.node, arc.middle, arc.time, arc.length});
+      remove(out[arc.node], v);
+      deleted_neighbours[arc.node]++;
+    }
+    vector<WorkArc>().swap(out[v]);
+    vector<WorkArc>().swap(in[v]);
+    contracted[v] = true;
+    return num_shortcuts;
+  }
+
+  int priority(const uint32_t v)
+  {
+    const int num_shortcuts = contract(v, true);
+    return num_shortcuts -
+      static_cast<int>(out[v].size() + in[v].size()) +
+      deleted_neighbours[v];
+  }
+
+private:
+  vector<float> _cost;
+  vector<uint32_t> _stamp;
+  uint32_t _search = 0;
+  vector<HeapEntry> _heap;
+
+  static void remove(vector<WorkArc>& arcs, const uint32_t node)
+  {
+    arcs.erase(
+      std::remove_if(
+        arcs.begin(),
+        arcs.end(),
+        [node](const WorkArc& arc) { return arc.node == node; }),
+      arcs.end());
+  }
+
+  /// Bounded Dijkstra from u through the remaining graph without v
+  void witness_search(const uint32_t u, const uint32_t v, const float max_time)
+  {
+    if (++_search == 0)
+    {
+      std::fill(_stamp.begin(), _stamp.end(), 0);
+      _search = 1;
+    }
+    _heap.clear();
+    _stamp[u] = _search;
+    _cost[u] = 0.0f;
+    _heap.emplace_back(0.0f, u);
+
+    int num_settled = 0;
+    while (!_heap.empty() && num_settled < WITNESS_SETTLED_LIMIT)
+    {
+      std::pop_heap(_heap.begin(), _heap.end(), std::greater<HeapEntry>());
+      const HeapEntry entry = _heap.back();
+      _heap.pop_back();
+      const uint32_t n = entry.second;
+      if (entry.first > _cost[n])
+        continue;
+      if (entry.first > max_time)
+        break;
+      num_settled++;
+      for (const WorkArc& arc : out[n])
+      {
+        if (arc.node == v)
+          continue;
+        const float cost = entry.first + arc.time;
+        if (_stamp[arc.node] == _search && _cost[arc.node] <= cost)
+          continue;
+        _stamp[arc.node] = _search;
+        _cost[arc.node] = cost;
+        _heap.emplace_back(cost, arc.node);
+        std::push_heap(_heap.begin(), _heap.end(), std::greater<HeapEntry>());
+      }
+    }
+  }
+};
+
+void append_aligned(QByteArray& data, const void* bytes, const std::size_t size)
+{
+  data.append(static_cast<const char*>(bytes), static_cast<int>(size));
+  while (data.size() % 8)
+    data.append('\0');
+}
+
+uint64_t aligned(const uint64_t offset)
+{
+  return (offset + 7) & ~static_cast<uint64_t>(7);
+}
+
+}  // anonymous namespace
+
+const uint32_t RouteHierarchy::MAGIC;
+const uint32_t RouteHierarchy::VERSION;
+const uint32_t RouteHierarchy::NONE;
+
+//=============================================================================
+void RouteHierarchy::Search::start(const std::size_t num_nodes)
+{
+  if (stamp.size() != num_nodes)
+  {
+    cost.assign(num_nodes, INF);
+    parent_arc.assign(num_nodes, NONE);
+    stamp.assign(num_nodes, 0);
+    query = 0;
+  }
+  if (++query == 0)
+  {
+    std::fill(stamp.begin(), stamp.end(), 0);
+    query = 1;
+  }
+  settled.clear();
+}
+
+//=============================================================================
+void RouteHierarchy::clear()
+{
+  _arc_ends.clear();
+  _order.clear();
+  _ranks.clear();
+  _forward = UpwardGraph();
+  _backward = UpwardGraph();
+  _num_shortcuts = 0;
+  _num_chain_nodes = 0;
+  _build_ms = 0.0;
+}
+
+void RouteHierarchy::build(const uint32_t num_nodes, const vector<Arc>& arcs)
+{
+  clear();
+  _arc_ends.reserve(arcs.size());
+  for (const Arc& arc : arcs)
+    _arc_ends.emplace_back(arc.from, arc.to);
+  contract(num_nodes, arcs, false);
+}
+
+bool RouteHierarchy::customize(const vector<Arc>& arcs)
+{
+  if (arcs.size() != _arc_ends.size())
+    return false;
+  for (std::size_t i = 0; i < arcs.size(); i++)
+  {
+    if (arcs[i].from != _arc_ends[i].first || arcs[i].to != _arc_ends[i].second)
+      return false;
+  }
+  contract(num_nodes(), arcs, true);
+  return true;
+}
+
+void RouteHierarchy::contract(
+  const uint32_t num_nodes,
+  const vector<Arc>& arcs,
+  const bool keep_order)
+{
+  const auto start_time = std::chrono::steady_clock::now();
+  Contractor c(num_nodes);
+  for (const Arc& arc : arcs)
+  {
+    if (arc.from != arc.to && arc.from < num_nodes && arc.to < num_nodes)
+      c.add_arc(arc.from, arc.to, NONE, arc.time, arc.length);
+  }
+
+  if (keep_order)
+  {
+    for (const uint32_t v : _order)
+      c.contract(v, false);
+  }
+  else
+  {
+    _order.clear();
+    _order.reserve(num_nodes);
+
+    // chains first: this leaves the junctions, with a shortcut for each
+    // stretch of lane between them
+    for (uint32_t v = 0; v < num_nodes; v++)
+    {
+      if (c.num_neighbours(v) <= 2)
+      {
+        c.contract(v, false);
+        _order.push_back(v);
+      }
+    }
+    _num_chain_nodes = _order.size();
+
+    // then the rest, by edge difference, with lazy updates: a node whose
+    // priority went up since it was queued goes back in the queue
+    typedef std::pair<int, uint32_t> Entry;
+    std::priority_queue<Entry, vector<Entry>, std::greater<Entry>> queue;
+    for (uint32_t v = 0; v < num_nodes; v++)
+    {
+      if (!c.contracted[v])
+        queue.emplace(c.priority(v), v);
+    }
+    while (!queue.empty())
+    {
+      const uint32_t v = queue.top().second;
+      queue.pop();
+      if (c.contracted[v])
+        continue;
+      const int priority = c.priority(v);
+      if (!queue.empty() && priority > queue.top().first)
+      {
+        queue.emplace(priority, v);
+        continue;
+      }
+      c.contract(v, false);
+      _order.push_back(v);
+    }
+  }
+
+  _ranks.assign(num_nodes, 0);
+  for (std::size_t i = 0; i < _order.size(); i++)
+    _ranks[_order[i]] = static_cast<uint32_t>(i);
+
+  _num_shortcuts = 0;
+  auto pack = [this, num_nodes](
+    vector<vector<ArcRecord>>& rows,
+    UpwardGraph& graph)
+    {
+      graph.rows.assign(num_nodes + 1, 0);
+      graph.arcs.clear();
+      for (uint32_t v = 0; v < num_nodes; v++)
+      {
+        graph.rows[v] = static_cast<uint32_t>(graph.arcs.size());
+        for (const ArcRecord& arc : rows[v])
+        {
+          if (arc.middle != NONE)
+            _num_shortcuts++;
+          graph.arcs.push_back(arc);
+        }
+        vector<ArcRecord>().swap(rows[v]);
+      }
+      graph.rows[num_nodes] = static_cast<uint32_t>(graph.arcs.size());
+    };
+  pack(c.forward, _forward);
+  pack(c.backward, _backward);
+
+  _build_ms = std::chrono::duration<double, std::milli>(
+    std::chrono::steady_clock::now() - start_time).count();
+}
+
+//=============================================================================
+void RouteHierarchy::search(
+  const UpwardGraph& graph,
+  const uint32_t from,
+  Search& s) const
+{
+  s.start(num_nodes());
+  vector<HeapEntry> heap;
+  s.stamp[from] = s.query;
+  s.cost[from] = 0.0f;
+  s.parent_arc[from] = NONE;
+  heap.emplace_back(0.0f, from);
+  while (!heap.empty())
+  {
+    std::pop_heap(heap.begin(), heap.end(), std::greater<HeapEntry>());
+    const HeapEntry entry = heap.back();
+    heap.pop_back();
+    const uint32_t n = entry.second;
+    if (entry.first > s.cost[n])
+      continue;
+    s.settled.push_back(n);
+    for (uint32_t a = graph.rows[n]; a < graph.rows[n + 1]; a++)
+    {
+      const ArcRecord& arc = graph.arcs[a];
+      const float cost = entry.first + arc.time;
+      if (s.reached(arc.node) && s.cost[arc.node] <= cost)
+        continue;
+      s.stamp[arc.node] = s.query;
+      s.cost[arc.node] = cost;
+      s.parent_arc[arc.node] = a;
+      heap.emplace_back(cost, arc.node);
+      std::push_heap(heap.begin(), heap.end(), std::greater<HeapEntry>());
+    }
+  }
+}
+
+void RouteHierarchy::unpack(
+  const uint32_t a,
+  const uint32_t b,
+  const uint32_t middle,
+  vector<uint32_t>& nodes) const
+{
+  // a shortcut through a chain nests as deep as the chain is long, so
+  // this keeps its own stack
+  struct Step
+  {
+    uint32_t from;
+    uint32_t to;
+    uint32_t middle;
+  };
+  vector<Step> stack(1, Step{a, b, middle});
+  while (!stack.empty())
+  {
+    const Step step = stack.back();
+    stack.pop_back();
+    if (step.middle == NONE)
+    {
+      nodes.push_back(step.to);
+      continue;
+    }
+    // both halves were stored at the middle node when it was contracted
+    const uint32_t m = step.middle;
+    uint32_t first_middle = NONE;
+    uint32_t second_middle = NONE;
+    for (uint32_t i = _backward.rows[m]; i < _backward.rows[m + 1]; i++)
+    {
+      if (_backward.arcs[i].node == step.from)
+        first_middle = _backward.arcs[i].middle;
+    }
+    for (uint32_t i = _forward.rows[m]; i < _forward.rows[m + 1]; i++)
+    {
+      if (_forward.arcs[i].node == step.to)
+        second_middle = _forward.arcs[i].middle;
+    }
+    stack.push_back(Step{m, step.to, second_middle});
+    stack.push_back(Step{step.from, m, first_middle});
+  }
+}
+
+RouteHierarchy::Route RouteHierarchy::route(
+  const uint32_t from,
+  const uint32_t to) const
+{
+  Route r;
+  if (from >= num_nodes() || to >= num_nodes())
+    return r;
+
+  search(_forward, from, _forward_search);
+  search(_backward, to, _backward_search);
+
+  uint32_t meeting = NONE;
+  float best = INF;
+  for (const uint32_t n : _forward_search.settled)
+  {
+    if (!_backward_search.reached(n))
+      continue;
+    const float cost = _forward_search.cost[n] + _backward_search.cost[n];
+    if (cost < best)
+    {
+      best = cost;
+      meeting = n;
+    }
+  }
+  if (meeting == NONE)
+    return r;
+  r.found = true;
+  r.time = best;
+
+  // the upward arcs from the start to the meeting node, in order
+  vector<ArcRecord> up;
+  vector<uint32_t> up_from;
+  for (uint32_t n = meeting; n != from; )
+  {
+    const uint32_t a = _forward_search.parent_arc[n];
+    // the arc is in the row of its tail, which is found by its offset
+    const uint32_t tail = static_cast<uint32_t>(
+      std::upper_bound(_forward.rows.begin(), _forward.rows.end(), a) -
+      _forward.rows.begin() - 1);
+    up.push_back(_forward.arcs[a]);
+    up_from.push_back(tail);
+    n = tail;
+  }
+
+  r.nodes.push_back(from);
+  for (std::size_t i = up.size(); i-- > 0; )
+  {
+    unpack(up_from[i], up[i].node, up[i].middle, r.nodes);
+    r.length += up[i].length;
+  }
+  // and down from the meeting node to the end
+  for (uint32_t n = meeting; n != to; )
+  {
+    const uint32_t a = _backward_search.parent_arc[n];
+    const uint32_t head = static_cast<uint32_t>(
+      std::upper_bound(_backward.rows.begin(), _backward.rows.end(), a) -
+      _backward.rows.begin() - 1);
+    unpack(n, head, _backward.arcs[a].middle, r.nodes);
+    r.length += _backward.arcs[a].length;
+    n = head;
+  }
+  return r;
+}
+
+vector<float> RouteHierarchy::travel_times(
+  const vector<uint32_t>& sources,
+  const vector<uint32_t>& targets) const
+{
+  const std::size_t num_targets = targets.size();
+  vector<float> times(sources.size() * num_targets, INF);
+  if (times.empty() || _ranks.empty())
+    return times;
+
+  // the backward search from each target leaves its cost in a bucket at
+  // every node it settles
+  struct BucketEntry
+  {
+    uint32_t target;
+    float cost;
+  };
+  vector<vector<std::pair<uint32_t, float>>> settled(num_targets);
+  auto tasks = [](const std::size_t count)
+    {
+      return static_cast<int>(
+        (count + SEARCHES_PER_TASK - 1) / SEARCHES_PER_TASK);
+    };
+  TaskPool::instance().parallel_for(
+    tasks(num_targets),
+    [&](int task)
+    {
+      Search s;
+      const std::size_t end =
+        std::min(num_targets, (task + 1) * std::size_t(SEARCHES_PER_TASK));
+      for (std::size_t j = task * SEARCHES_PER_TASK; j < end; j++)
+      {
+        if (targets[j] >= num_nodes())
+          continue;
+        search(_backward, targets[j], s);
+        for (const uint32_t n : s.settled)
+          settled[j].emplace_back(n, s.cost[n]);
+      }
+    });
+
+  // into compressed rows by node
+  vector<uint32_t> bucket_rows(num_nodes() + 1, 0);
+  for (const auto& entries : settled)
+  {
+    for (const auto& entry : entries)
+      bucket_rows[entry.first + 1]++;
+  }
+  for (uint32_t n = 0; n < num_nodes(); n++)
+    bucket_rows[n + 1] += bucket_rows[n];
+  vector<BucketEntry> buckets(bucket_rows[num_nodes()]);
+  vector<uint32_t> next(bucket_rows.begin(), bucket_rows.end() - 1);
+  for (std::size_t j = 0; j < num_targets; j++)
+  {
+    for (const auto& entry : settled[j])
+    {
+      buckets[next[entry.first]++] =
+        BucketEntry{static_cast<uint32_t>(j), entry.second};
+    }
+    vector<std::pair<uint32_t, float>>().swap(settled[j]);
+  }
+
+  // then each forward search meets them; each task fills its own rows
+  TaskPool::instance().parallel_for(
+    tasks(sources.size()),
+    [&](int task)
+    {
+      Search s;
+      const std::size_t end =
+        std::min(sources.size(), (task + 1) * std::size_t(SEARCHES_PER_TASK));
+      for (std::size_t i = task * SEARCHES_PER_TASK; i < end; i++)
+      {
+        if (sources[i] >= num_nodes())
+          continue;
+        search(_forward, sources[i], s);
+        float* row = &times[i * num_targets];
+        for (const uint32_t n : s.settled)
+        {
+          for (uint32_t b = bucket_rows[n]; b < bucket_rows[n + 1]; b++)
+          {
+            const float cost = s.cost[n] + buckets[b].cost;
+            if (cost < row[buckets[b].target])
+              row[buckets[b].target] = cost;
+          }
+        }
+      }
+    });
+  return times;
+}
+
+//=============================================================================
+QByteArray RouteHierarchy::to_binary(const int32_t graph_idx) const
+{
+  FileHeader header;
+  header.magic = MAGIC;
+  header.version = VERSION;
+  header.graph_idx = graph_idx;
+  header.num_nodes = num_nodes();
+  header.num_forward_arcs = static_cast<uint32_t>(_forward.arcs.size());
+  header.num_backward_arcs = static_cast<uint32_t>(_backward.arcs.size());
+  const uint64_t rows_size = (header.num_nodes + 1) * sizeof(uint32_t);
+  header.ranks_offset = sizeof(FileHeader);
+  header.forward_rows_offset =
+    aligned(header.ranks_offset + header.num_nodes * sizeof(uint32_t));
+  header.forward_arcs_offset =
+    aligned(header.forward_rows_offset + rows_size);
+  header.backward_rows_offset = aligned(
+    header.forward_arcs_offset + _forward.arcs.size() * sizeof(ArcRecord));
+  header.backward_arcs_offset =
+    aligned(header.backward_rows_offset + rows_size);
+
+  QByteArray data;
+  data.reserve(static_cast<int>(
+    header.backward_arcs_offset + _backward.arcs.size() * sizeof(ArcRecord)));
+  append_aligned(data, &header, sizeof(header));
+  append_aligned(data, _ranks.data(), _ranks.size() * sizeof(uint32_t));
+  for (const UpwardGraph* graph : {&_forward, &_backward})
+  {
+    if (graph->rows.empty())
+    {
+      const vector<uint32_t> rows(header.num_nodes + 1, 0);
+      append_aligned(data, rows.data(), rows_size);
+    }
+    else
+      append_aligned(data, graph->rows.data(), rows_size);
+    append_aligned(
+      data,
+      graph->arcs.data(),
+      graph->arcs.size() * sizeof(ArcRecord));
+  }
+  return data;
+}
+
+bool RouteHierarchy::from_binary(const char* data, const std::size_t size)
+{
+  FileHeader header;
+  if (size < sizeof(header))
+    return false;
+  std::memcpy(&header, data, sizeof(header));
+  const uint64_t rows_size = (uint64_t(header.num_nodes) + 1) * 4;
+  if (header.magic != MAGIC || header.version != VERSION ||
+    header.ranks_offset + uint64_t(header.num_nodes) * 4 > size ||
+    header.forward_rows_offset + rows_size > size ||
+    header.backward_rows_offset + rows_size > size ||
+    header.forward_arcs_offset +
+    uint64_t(header.num_forward_arcs) * sizeof(ArcRecord) > size ||
+    header.backward_arcs_offset +
+    uint64_t(header.num_backward_arcs) * sizeof(ArcRecord) > size)
+    return false;
+
+  RouteHierarchy read;
+  read._ranks.resize(header.num_nodes);
+  std::memcpy(
+    read._ranks.data(),
+    data + header.ranks_offset,
+    header.num_nodes * sizeof(uint32_t));
+
+  auto read_graph = [&](
+    const uint64_t rows_offset,
+    const uint64_t arcs_offset,
+    const uint32_t num_arcs,
+    UpwardGraph& graph)
+    {
+      graph.rows.resize(header.num_nodes + 1);
+      std::memcpy(graph.rows.data(), data + rows_offset, rows_size);
+      graph.arcs.resize(num_arcs);
+      std::memcpy(
+        graph.arcs.data(),
+        data + arcs_offset,
+        num_arcs * sizeof(ArcRecord));
+      if (graph.rows.back() != num_arcs)
+        return false;
+      for (uint32_t v = 0; v < header.num_nodes; v++)
+      {
+        if (graph.rows[v] > graph.rows[v + 1])
+          return false;
+      }
+      for (const ArcRecord& arc : graph.arcs)
+      {
+        if (arc.node >= header.num_nodes ||
+          (arc.middle != NONE && arc.middle >= header.num_nodes))
+          return false;
+      }
+      return true;
+    };
+  if (!read_graph(
+      header.forward_rows_offset,
+      header.forward_arcs_offset,
+      header.num_forward_arcs,
+      read._forward) ||
+    !read_graph(
+      header.backward_rows_offset,
+      header.backward_arcs_offset,
+      header.num_backward_arcs,
+      read._backward))
+    return false;
+
+  read._order.assign(header.num_nodes, NONE);
+  for (uint32_t v = 0; v < header.num_nodes; v++)
+  {
+    const uint32_t rank = read._ranks[v];
+    if (rank >= header.num_nodes || read._order[rank] != NONE)
+      return false;
+    read._order[rank] = v;
+  }
+  for (const UpwardGraph* graph : {&read._forward, &read._backward})
+  {
+    for (const ArcRecord& arc : graph->arcs)
+    {
+      if (arc.middle != NONE)
+        read._num_shortcuts++;
+    }
+  }
+
+  // the arcs it was built from aren't stored, so only build() can follow
+  *this = std::move(read);
+  return true;
+}
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef TRAFFIC_EDITOR__ROUTE_HIERARCHY_HPP
+#define TRAFFIC_EDITOR__ROUTE_HIERARCHY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <QByteArray>
+
+//=============================================================================
+/// A contraction hierarchy over a directed graph of travel times, for
+/// analyses which need very many quickest routes (travel-time matrices,
+/// conflict previews). build() first collapses the chains of nodes with
+/// at most two neighbours, which most lanes between junctions are, then
+/// contracts the remaining nodes in the order of their edge difference,
+/// adding a shortcut wherever a bounded witness search finds no other way
+/// as quick. Queries only search upwards from both ends, so they touch a
+/// few hundred nodes where Dijkstra or A* would touch most of the graph.
+///
+/// Arcs are directed, so one-way lanes stay one-way, and lift rides are
+/// arcs like any other. When an edit only changed the costs, customize()
+/// contracts again in the order found by build(), which skips ordering.
+///
+/// The hierarchy can be written as a binary file: a FileHeader, then the
+/// rank of each node, and for the upward arcs of the forward and the
+/// backward search a CSR row offset table (num_nodes + 1 uint32) and its
+/// ArcRecords, each part 8-byte aligned and in host byte order.
+class RouteHierarchy
+{
+public:
+  static const uint32_t MAGIC = 0x48435452;  // "RTCH" on disk
+  static const uint32_t VERSION = 1;
+  static const uint32_t NONE = 0xffffffff;
+
+  struct Arc
+  {
+    uint32_t from = 0;
+    uint32_t to = 0;
+    float time = 0.0f;  // seconds
+    float length = 0.0f;  // meters, 0 for lift rides
+  };
+
+  struct FileHeader
+  {
+    uint32_t magic;
+    uint32_t version;
+    int32_t graph_idx;
+    uint32_t num_nodes;
+    uint32_t num_forward_arcs;
+    uint32_t num_backward_arcs;
+    uint64_t ranks_offset;  // bytes from the start of the file
+    uint64_t forward_rows_offset;
+    uint64_t forward_arcs_offset;
+    uint64_t backward_rows_offset;
+    uint64_t backward_arcs_offset;
+  };
+
+  /// An arc from a node to node, which is higher in the hierarchy (for the
+  /// forward search), or from node to the node it is stored at (for the
+  /// backward search). A shortcut stands for the way through middle,
+  /// which is lower than both ends; middle is NONE for an arc of the graph.
+  struct ArcRecord
+  {
+    uint32_t node;
+    uint32_t middle;
+    float time;
+    float length;
+  };
+
+  struct Route
+  {
+    bool found = false;
+    float time = 0.0f;
+    float length = 0.0f;
+    std::vector<uint32_t> nodes;  // from the start to the end
+  };
+
+  /// Contract a graph of num_nodes nodes from scratch. Parallel arcs are
+  /// merged into the quickest, and loops are ignored.
+  void build(const uint32_t num_nodes, const std::vector<Arc>& arcs);
+
+  /// Take new costs for the arcs which build() was given, in the same
+  /// order, keeping the contraction order. Returns false, changing
+  /// nothing, if the arcs join other nodes, so that build() is needed.
+  bool customize(const std::vector<Arc>& arcs);
+
+  void clear();
+
+  uint32_t num_nodes() const { return static_cast<uint32_t>(_ranks.size()); }
+  std::size_t num_arcs() const { return _arc_ends.size(); }
+  std::size_t num_shortcuts() const { return _num_shortcuts; }
+  std::size_t num_chain_nodes() const { return _num_chain_nodes; }
+  double build_ms() const { return _build_ms; }
+
+  /// Quickest route between two nodes
+  Route route(const uint32_t from, const uint32_t to) const;
+
+  /// Travel times from each source to each target, row by row, or
+  /// infinity where there is no route. The searches are spread over the
+  /// TaskPool, and each runs once per source or target rather than once
+  /// per pair.
+  std::vector<float> travel_times(
+    const std::vector<uint32_t>& sources,
+    const std::vector<uint32_t>& targets) const;
+
+  QByteArray to_binary(const int32_t graph_idx) const;
+
+  /// Read back what to_binary() wrote; false if it is not consistent
+  bool from_binary(const char* data, const std::size_t size);
+
+private:
+  /// Upward arcs in compressed sparse rows
+  struct UpwardGraph
+  {
+    std::vector<uint32_t> rows;
+    std::vector<ArcRecord> arcs;
+  };
+
+  /// The state of one upward search, reusable from query to query
+  struct Search
+  {
+    std::vector<float> cost;
+    std::vector<uint32_t> parent_arc;
+    std::vector<uint32_t> stamp;
+    uint32_t query = 0;
+    std::vector<uint32_t> settled;
+
+    void start(const std::size_t num_nodes);
+    bool reached(const uint32_t node) const { return stamp[node] == query; }
+  };
+
+  std::vector<std::pair<uint32_t, uint32_t>> _arc_ends;  // as built
+  std::vector<uint32_t> _order;  // nodes in the order they were contracted
+  std::vector<uint32_t> _ranks;  // position of each node in _order
+  UpwardGraph _forward;
+  UpwardGraph _backward;
+  std::size_t _num_shortcuts = 0;
+  std::size_t _num_chain_nodes = 0;
+  double _build_ms = 0.0;
+
+  // for route(); the searches of travel_times() have their own
+  mutable Search _forward_search;
+  mutable Search _backward_search;
+
+  void contract(
+    const uint32_t num_nodes,
+    const std::vector<Arc>& arcs,
+    const bool keep_order);
+
+  void search(
+    const UpwardGraph& graph,
+    const uint32_t from,
+    Search& s) const;
+
+  /// Append the nodes after a along the arc from a to b, unpacking any
+  /// shortcuts
+  void unpack(
+    const uint32_t a,
+    const uint32_t b,
+    const uint32_t middle,
+    std::vector<uint32_t>& nodes) const;
+};
+
+#endif
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "runtime_statistics.hpp"
+
+namespace {
+
+QString megabytes(const std::int64_t bytes)
+{
+  if (bytes < 0)
+    return "-";
+  return QString::asprintf("%.1f MB", bytes / (1024.0 * 1024.0));
+}
+
+}  // namespace
+
+double RuntimeStatistics::Cache::hit_rate() const
+{
+  const std::uint64_t lookups = hits + misses;
+  return lookups > 0 ? static_cast<double>(hits) / lookups : 0.0;
+}
+
+QString RuntimeStatistics::summary() const
+{
+  QString s = QString::asprintf(
+    "%-20s%10s %12s %10s %10s\n",
+    "caches:",
+    "hit rate",
+    "lookups",
+    "size",
+    "budget");
+  for (const Cache& cache : caches)
+  {
+    const std::uint64_t lookups = cache.hits + cache.misses;
+    s += QString::asprintf(
+      "  %-18s %10s %12s %10s %10s\n",
+      cache.name.c_str(),
+      lookups > 0 ?
+      qUtf8Printable(QString::asprintf("%.1f %%", 100.0 * cache.hit_rate())) :
+      "-",
+      lookups > 0 ? qUtf8Printable(QString::number(lookups)) : "-",
+      qUtf8Printable(megabytes(cache.bytes)),
+      qUtf8Printable(megabytes(cache.budget_bytes)));
+  }
+
+  s += QString::asprintf(
+    "%-20s %10s %10s %10s\n",
+    "queues:",
+    "active",
+    "capacity",
+    "waiting");
+  for (const Queue& queue : queues)
+    s += QString::asprintf(
+      "  %-18s %10d %10d %10d\n",
+      queue.name.c_str(),
+      queue.active,
+      queue.capacity,
+      queue.waiting);
+
+  s += "tasks:\n";
+  if (tasks.empty())
+    s += "  none\n";
+  for (const std::string& task : tasks)
+    s += QString::asprintf("  %s\n", task.c_str());
+
+  s += "memory:\n";
+  std::size_t total = 0;
+  for (const auto& it : memory)
+  {
+    s += QString::asprintf(
+      "  %-28s %10s\n",
+      it.first.c_str(),
+      qUtf8Printable(megabytes(static_cast<std::int64_t>(it.second))));
+    total += it.second;
+  }
+  s += QString::asprintf(
+    "  %-28s %10s\n",
+    "total",
+    qUtf8Printable(megabytes(static_cast<std::int64_t>(total))));
+
+  s += "times:\n";
+  for (const auto& it : times)
+    s += QString::asprintf(
+      "  %-28s %10.2f ms\n",
+      it.first.c_str(),
+      it.second / 1e6);
+  return s;
+}
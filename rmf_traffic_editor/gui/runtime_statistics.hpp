@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__RUNTIME_STATISTICS_HPP
+#define TRAFFIC_EDITOR__RUNTIME_STATISTICS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <QString>
+
+//=============================================================================
+/// A snapshot of how the caches, worker pools and budgets of the editor
+/// are doing, gathered by the editor every second while the statistics
+/// window is open, for tuning the performance preferences to a machine.
+class RuntimeStatistics
+{
+public:
+  struct Cache
+  {
+    std::string name;
+    std::uint64_t hits = 0;  // none of either if it isn't looked up
+    std::uint64_t misses = 0;
+    std::int64_t bytes = -1;  // -1 if the cache doesn't know
+    std::int64_t budget_bytes = -1;
+
+    /// Of all lookups, 0 if there were none
+    double hit_rate() const;
+  };
+
+  struct Queue
+  {
+    std::string name;
+    int active = 0;  // threads busy, or requests under way
+    int capacity = 0;
+    int waiting = 0;
+  };
+
+  std::vector<Cache> caches;
+  std::vector<Queue> queues;
+
+  /// The tracked tasks which aren't finished, with how far they got
+  std::vector<std::string> tasks;
+
+  /// Estimated bytes held, by subsystem
+  std::vector<std::pair<std::string, std::size_t>> memory;
+
+  /// The last scene build, paint, load, etc., in nanoseconds
+  std::vector<std::pair<std::string, std::int64_t>> times;
+
+  /// Human-readable table of everything, one line per entry
+  QString summary() const;
+};
+
+#endif
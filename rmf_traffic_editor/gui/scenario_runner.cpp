@@ -0,0 +1,330 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <QElapsedTimer>
+#include <QSaveFile>
+#include <QtConcurrent/QtConcurrent>
+#include <QtEndian>
+
+#include "scenario_runner.hpp"
+#include "simulation_recording.hpp"
+#include "trace.hpp"
+
+namespace {
+
+const uint32_t TRAJECTORY_MAGIC = 0x54455331;  // "TES1"
+
+void put_u32(QByteArray& buffer, const uint32_t value)
+{
+  const uint32_t le = qToLittleEndian(value);
+  buffer.append(reinterpret_cast<const char*>(&le), sizeof(le));
+}
+
+void put_u16(QByteArray& buffer, const uint16_t value)
+{
+  const uint16_t le = qToLittleEndian(value);
+  buffer.append(reinterpret_cast<const char*>(&le), sizeof(le));
+}
+
+void put_float(QByteArray& buffer, const float value)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  put_u32(buffer, bits);
+}
+
+bool write_file(const std::string& filename, const QByteArray& contents)
+{
+  QSaveFile file(QString::fromStdString(filename));
+  if (!file.open(QIODevice::WriteOnly) ||
+    file.write(contents) != contents.size() ||
+    !file.commit())
+  {
+    printf("unable to write %s\n", filename.c_str());
+    return false;
+  }
+  return true;
+}
+
+/// Last known state of every model of every level, for measuring how far
+/// they move between ticks
+std::vector<std::vector<ModelState>> model_states(const Building& building)
+{
+  std::vector<std::vector<ModelState>> states(building.levels.size());
+  for (std::size_t i = 0; i < building.levels.size(); i++)
+  {
+    for (const Model& model : building.levels[i].models)
+      states[i].push_back(model.state);
+  }
+  return states;
+}
+
+}  // namespace
+
+ScenarioRunner::ScenarioRunner(SimulationFactory factory)
+: _factory(factory)
+{
+}
+
+void ScenarioRunner::run(const Building& building, const Options& options)
+{
+  _options = options;
+  _results.clear();
+
+  _results.resize(std::max(0, options.num_seeds));
+  for (int i = 0; i < options.num_seeds; i++)
+    _results[i].seed = options.first_seed + i;
+
+  QElapsedTimer timer;
+  timer.start();
+  QtConcurrent::blockingMap(
+    _results,
+    [this, &building](RunResult& result)
+    {
+      result = run_seed(building, result.seed);
+    });
+
+  int total_ticks = 0;
+  for (const RunResult& result : _results)
+    total_ticks += result.ticks;
+  printf("ran %d scenario seeds, %d ticks in %lld ms\n",
+    options.num_seeds,
+    total_ticks,
+    static_cast<long long>(timer.elapsed()));
+}
+
+ScenarioRunner::RunResult ScenarioRunner::run_seed(
+  const Building& building,
+  const int seed) const
+{
+  RunResult result;
+  result.seed = seed;
+
+  QElapsedTimer timer;
+  timer.start();
+
+  // every run gets its own copy of the building, so nothing is shared
+  // between the threads but the (const) original
+  std::shared_ptr<Building> copy = building.snapshot();
+  std::unique_ptr<SimulationV2> simulation = _factory();
+  if (!simulation)
+  {
+    printf("no simulation plugin for seed %d\n", seed);
+    return result;
+  }
+
+  YAML::Node config = _options.config ?
+    YAML::Clone(_options.config) : YAML::Node(YAML::NodeType::Map);
+  config["seed"] = seed;
+  config["time_step"] = _options.time_step;
+  simulation->load(config);
+  simulation->reset(*copy);
+
+  std::vector<std::vector<ModelState>> states = model_states(*copy);
+  for (std::size_t i = 0; i < copy->levels.size(); i++)
+  {
+    const std::vector<Model>& models = copy->levels[i].models;
+    for (std::size_t j = 0; j < models.size(); j++)
+    {
+      ModelSummary summary;
+      summary.level_idx = static_cast<int>(i);
+      summary.model_idx = static_cast<int>(j);
+      summary.instance_name = models[j].instance_name;
+      result.models.push_back(summary);
+    }
+  }
+
+  // which models moved since the last trajectory sample
+  std::vector<std::vector<bool>> moved(states.size());
+  for (std::size_t i = 0; i < states.size(); i++)
+    moved[i].assign(states[i].size(), true);  // the first sample has all
+
+  auto summary_of = [&result](const int level_idx, const int model_idx)
+    -> ModelSummary*
+    {
+      for (ModelSummary& summary : result.models)
+      {
+        if (summary.level_idx == level_idx && summary.model_idx == model_idx)
+          return &summary;
+      }
+      return nullptr;
+    };
+
+  SimulationRecording::Writer recording;
+  if (!_options.recording_prefix.empty())
+    recording.open(
+      _options.recording_prefix + "_" + std::to_string(seed) + ".recording",
+      _options.time_step);
+
+  const int sample_every = std::max(1, _options.sample_every);
+  const int num_ticks = _options.time_step > 0.0 ?
+    static_cast<int>(std::ceil(_options.duration / _options.time_step)) : 0;
+  SimulationBatch batch;
+  for (int tick = 0; tick <= num_ticks; tick++)
+  {
+    if (tick % sample_every == 0)
+    {
+      for (std::size_t i = 0; i < states.size(); i++)
+      {
+        for (std::size_t j = 0; j < states[i].size(); j++)
+        {
+          if (!moved[i][j])
+            continue;
+          moved[i][j] = false;
+          Sample sample;
+          sample.tick = static_cast<uint32_t>(tick);
+          sample.level_idx = static_cast<uint16_t>(i);
+          sample.model_idx = static_cast<uint16_t>(j);
+          sample.x = static_cast<float>(states[i][j].x);
+          sample.y = static_cast<float>(states[i][j].y);
+          sample.yaw = static_cast<float>(states[i][j].yaw);
+          result.trajectory.push_back(sample);
+        }
+      }
+    }
+    if (recording.is_open())
+      recording.record(*copy);
+    if (tick == num_ticks)
+      break;
+
+    TRACE_ZONE("ScenarioRunner tick");
+    batch.clear();
+    simulation->tick(*copy, batch);
+    result.ticks++;
+
+    for (const SimulationBatch::Update& update : batch.updates)
+    {
+      if (update.level_idx < 0 ||
+        update.level_idx >= static_cast<int>(states.size()) ||
+        update.model_idx < 0 ||
+        update.model_idx >= static_cast<int>(states[update.level_idx].size()))
+        continue;
+      ModelState& last = states[update.level_idx][update.model_idx];
+      const double distance = std::hypot(
+        update.state.x - last.x,
+        update.state.y - last.y);
+      last = update.state;
+      moved[update.level_idx][update.model_idx] = true;
+
+      ModelSummary* summary =
+        summary_of(update.level_idx, update.model_idx);
+      if (summary)
+      {
+        summary->distance += distance;
+        summary->moving_ticks++;
+      }
+    }
+
+    result.spawned += static_cast<int>(batch.spawned.size());
+    result.despawned += static_cast<int>(batch.despawned.size());
+    if (batch.apply(*copy, -1))
+    {
+      // indices have shifted: start over from the new model lists, and
+      // give the next sample a full set of poses
+      states = model_states(*copy);
+      for (std::size_t i = 0; i < states.size(); i++)
+        moved[i].assign(states[i].size(), true);
+    }
+  }
+
+  if (recording.is_open())
+    recording.close();
+  result.wall_ms = timer.elapsed();
+  return result;
+}
+
+bool ScenarioRunner::write_trajectory_csv(const std::string& filename) const
+{
+  QByteArray csv("seed,tick,time,level,model,x,y,yaw\n");
+  char line[256];
+  for (const RunResult& result : _results)
+  {
+    for (const Sample& sample : result.trajectory)
+    {
+      snprintf(line, sizeof(line), "%d,%u,%.3f,%u,%u,%.3f,%.3f,%.4f\n",
+        result.seed,
+        sample.tick,
+        sample.tick * _options.time_step,
+        sample.level_idx,
+        sample.model_idx,
+        sample.x,
+        sample.y,
+        sample.yaw);
+      csv.append(line);
+    }
+  }
+  return write_file(filename, csv);
+}
+
+bool ScenarioRunner::write_trajectory_binary(
+  const std::string& filename) const
+{
+  QByteArray buffer;
+  put_u32(buffer, TRAJECTORY_MAGIC);
+  put_u32(buffer, static_cast<uint32_t>(_results.size()));
+  put_float(buffer, static_cast<float>(_options.time_step));
+  for (const RunResult& result : _results)
+  {
+    put_u32(buffer, static_cast<uint32_t>(result.seed));
+    put_u32(buffer, static_cast<uint32_t>(result.trajectory.size()));
+    for (const Sample& sample : result.trajectory)
+    {
+      put_u32(buffer, sample.tick);
+      put_u16(buffer, sample.level_idx);
+      put_u16(buffer, sample.model_idx);
+      put_float(buffer, sample.x);
+      put_float(buffer, sample.y);
+      put_float(buffer, sample.yaw);
+    }
+  }
+  return write_file(filename, buffer);
+}
+
+bool ScenarioRunner::write_summary_csv(const std::string& filename) const
+{
+  QByteArray csv(
+    "seed,ticks,wall_ms,realtime_factor,spawned,despawned,"
+    "level,model,instance_name,distance,moving_ticks\n");
+  char line[512];
+  for (const RunResult& result : _results)
+  {
+    const double realtime_factor = result.wall_ms > 0 ?
+      result.ticks * _options.time_step * 1000.0 / result.wall_ms : 0.0;
+    for (const ModelSummary& model : result.models)
+    {
+      snprintf(line, sizeof(line), "%d,%d,%lld,%.1f,%d,%d,%d,%d,%s,%.3f,%d\n",
+        result.seed,
+        result.ticks,
+        static_cast<long long>(result.wall_ms),
+        realtime_factor,
+        result.spawned,
+        result.despawned,
+        model.level_idx,
+        model.model_idx,
+        model.instance_name.c_str(),
+        model.distance,
+        model.moving_ticks);
+      csv.append(line);
+    }
+  }
+  return write_file(filename, csv);
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__SCENARIO_RUNNER_HPP
+#define TRAFFIC_EDITOR__SCENARIO_RUNNER_HPP
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <yaml-cpp/yaml.h>
+
+#include "building.h"
+#include "plugins/simulation.h"
+
+//=============================================================================
+/// Runs a simulation scenario without a display, as fast as the CPU allows:
+/// load(config), reset() and then tick() in a tight loop for a simulated
+/// duration. Several seeds can be run at once, each on its own snapshot of
+/// the building and its own plugin instance. Model trajectories are kept
+/// as samples of the models which moved, so that the log stays small.
+class ScenarioRunner
+{
+public:
+  /// Makes a fresh plugin for each run. Version 1 plugins can be wrapped
+  /// in a SimulationV1Adapter.
+  using SimulationFactory = std::function<std::unique_ptr<SimulationV2>()>;
+
+  struct Options
+  {
+    double time_step = 0.1;  // simulated seconds per tick
+    double duration = 3600.0;  // simulated seconds per run
+    int num_seeds = 1;
+    int first_seed = 0;
+    int sample_every = 10;  // ticks between trajectory samples
+    YAML::Node config;  // passed to load(), with "seed" and "time_step" set
+
+    /// If set, every run is also recorded to <prefix>_<seed>.recording,
+    /// for replay in the editor
+    std::string recording_prefix;
+  };
+
+  /// Pose of a model at a trajectory sample
+  struct Sample
+  {
+    uint32_t tick = 0;
+    uint16_t level_idx = 0;
+    uint16_t model_idx = 0;
+    float x = 0.0f;
+    float y = 0.0f;
+    float yaw = 0.0f;
+  };
+
+  struct ModelSummary
+  {
+    int level_idx = 0;
+    int model_idx = 0;
+    std::string instance_name;
+    double distance = 0.0;  // in the pixel coordinates of the level
+    int moving_ticks = 0;
+  };
+
+  struct RunResult
+  {
+    int seed = 0;
+    int ticks = 0;
+    int spawned = 0;
+    int despawned = 0;
+    int64_t wall_ms = 0;
+    std::vector<Sample> trajectory;
+    std::vector<ModelSummary> models;
+  };
+
+  explicit ScenarioRunner(SimulationFactory factory);
+
+  /// Run every seed, in parallel on the global thread pool.
+  void run(const Building& building, const Options& options);
+
+  const std::vector<RunResult>& results() const { return _results; }
+
+  /// One row per trajectory sample: seed,tick,time,level,model,x,y,yaw
+  bool write_trajectory_csv(const std::string& filename) const;
+
+  /// The same samples in a little-endian binary file: a header with the
+  /// number of runs, then for each run its seed, sample count and samples
+  bool write_trajectory_binary(const std::string& filename) const;
+
+  /// One row per model per run, with the distance travelled and the
+  /// number of ticks it moved in
+  bool write_summary_csv(const std::string& filename) const;
+
+private:
+  SimulationFactory _factory;
+  Options _options;
+  std::vector<RunResult> _results;
+
+  RunResult run_seed(const Building& building, const int seed) const;
+};
+
+#endif
@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <cmath>
+#include <mutex>
+
+#include <QTransform>
+
+#include "logging.hpp"
+#include "scene_geometry.hpp"
+using std::vector;
+
+
+SceneGeometry SceneGeometry::compute(const Input& input)
+{
+  SceneGeometry geometry;
+
+  geometry.door_motion_paths.resize(input.edges.size());
+  for (std::size_t i = 0; i < input.edges.size(); i++)
+  {
+    const Edge& edge = input.edges[i];
+    const Vertex& v_start = input.vertices[edge.start_idx];
+    const Vertex& v_end = input.vertices[edge.end_idx];
+
+    if (edge.type == Edge::DOOR)
+    {
+      geometry.door_motion_paths[i] =
+        door_motion_path(edge, v_start, v_end, input.meters_per_pixel);
+    }
+    else if ((edge.type == Edge::LANE || edge.type == Edge::HUMAN_LANE) &&
+      !edge.is_bidirectional())
+    {
+      const double pen_width =
+        lane_pen_width(edge, input.graphs, input.meters_per_pixel);
+      add_lane_arrows(
+        geometry.lane_arrow_paths[edge.get_graph_idx()][pen_width],
+        v_start,
+        v_end,
+        pen_width);
+    }
+  }
+
+  geometry.polygons.resize(input.polygons.size());
+  for (std::size_t i = 0; i < input.polygons.size(); i++)
+  {
+    for (const int vertex_idx : input.polygons[i].vertices)
+    {
+      const Vertex& v = input.vertices[vertex_idx];
+      geometry.polygons[i].append(QPointF(v.x, v.y));
+    }
+  }
+
+  return geometry;
+}
+
+bool SceneGeometry::matches(
+  const vector<Edge>& level_edges,
+  const vector<Polygon>& level_polygons) const
+{
+  return door_motion_paths.size() == level_edges.size() &&
+    polygons.size() == level_polygons.size();
+}
+
+double SceneGeometry::lane_pen_width(
+  const Edge& edge,
+  const vector<Graph>& graphs,
+  const double meters_per_pixel)
+{
+  const int graph_idx = edge.get_graph_idx();
+
+  // see if there is a default width for this graph_idx
+  double graph_default_width = -1.0;
+  for (const auto& graph : graphs)
+  {
+    if (graph.idx == graph_idx)
+    {
+      graph_default_width = graph.default_lane_width;
+      break;
+    }
+  }
+
+  double lane_width_meters = 1.0;
+  if (edge.get_width() > 0)
+    lane_width_meters = edge.get_width();
+  else if (graph_default_width > 0)
+    lane_width_meters = graph_default_width;
+
+  return lane_width_meters / meters_per_pixel;
+}
+
+void SceneGeometry::add_lane_arrows(
+  QPainterPath& path,
+  const Vertex& v_start,
+  const Vertex& v_end,
+  const double lane_pen_width)
+{
+  const double dx = v_end.x - v_start.x;
+  const double dy = v_end.y - v_start.y;
+  const double len = std::sqrt(dx*dx + dy*dy);
+  const double norm_x = dx / len;
+  const double norm_y = dy / len;
+
+  // dimensions for the direction indicators along this path
+  const double arrow_w = lane_pen_width / 2.5;  // width of arrowheads
+  const double arrow_l = lane_pen_width / 2.5;  // length of arrowheads
+  const double arrow_spacing = lane_pen_width * 4.0;
+
+  for (double d = 0.0; d < len; d += arrow_spacing)
+  {
+    // first calculate the center vertex of this arrowhead
+    const double cx = v_start.x + d * norm_x;
+    const double cy = v_start.y + d * norm_y;
+    // one edge vertex of arrowhead
+    const double e1x = cx - arrow_w * norm_y;
+    const double e1y = cy + arrow_w * norm_x;
+    // another edge vertex of arrowhead
+    const double e2x = cx + arrow_w * norm_y;
+    const double e2y = cy - arrow_w * norm_x;
+    // tip of arrowhead
+    const double tx = cx + arrow_l * norm_x;
+    const double ty = cy + arrow_l * norm_y;
+    // now add arrowhead lines
+    path.moveTo(e1x, e1y);
+    path.lineTo(tx, ty);
+    path.lineTo(e2x, e2y);
+  }
+}
+
+QPainterPath SceneGeometry::door_motion_path(
+  const Edge& edge,
+  const Vertex& v_start,
+  const Vertex& v_end,
+  const double meters_per_pixel)
+{
+  const bool about_start = edge.door_moves_about_start();
+  const double motion_degrees = std::abs(edge.get_motion_degrees());
+  const int motion_dir = edge.get_motion_direction();
+  const double right_left_ratio = edge.get_right_left_ratio();
+
+  QPainterPath door_motion_path;
+
+  const double door_dx = v_end.x - v_start.x;
+  const double door_dy = v_end.y - v_start.y;
+  const double door_length = std::sqrt(door_dx * door_dx + door_dy * door_dy);
+  const double door_angle = std::atan2(door_dy, door_dx);
+
+  const std::string& door_type = edge.get_door_type();
+  if (!door_type.empty())
+  {
+    const double DEG2RAD = M_PI / 180.0;
+
+    if (door_type == "hinged")
+    {
+      const double hinge_x = about_start ? v_start.x : v_end.x;
+      const double hinge_y = about_start ? v_start.y : v_end.y;
+      const double angle_offset = about_start ? 0.0 : M_PI;
+
+      add_door_swing_path(
+        door_motion_path,
+        hinge_x,
+        hinge_y,
+        door_length,
+        door_angle + angle_offset,
+        door_angle + angle_offset + DEG2RAD * motion_dir * motion_degrees);
+    }
+    else if (door_type == "double_hinged")
+    {
+      // right door
+      add_door_swing_path(
+        door_motion_path,
+        v_start.x,
+        v_start.y,
+        (right_left_ratio / (1 + right_left_ratio)) * door_length,
+        door_angle,
+        door_angle + DEG2RAD * motion_dir * motion_degrees);
+
+      // left door
+      add_door_swing_path(
+        door_motion_path,
+        v_end.x,
+        v_end.y,
+        (1 / (1 + right_left_ratio)) * door_length,
+        door_angle + M_PI,
+        door_angle + M_PI - DEG2RAD * motion_dir * motion_degrees);
+    }
+    else if (door_type == "sliding")
+    {
+      add_door_slide_path(
+        door_motion_path,
+        meters_per_pixel,
+        v_start.x,
+        v_start.y,
+        door_length,
+        door_angle);
+    }
+    else if (door_type == "double_sliding")
+    {
+      // right door
+      add_door_slide_path(
+        door_motion_path,
+        meters_per_pixel,
+        v_start.x,
+        v_start.y,
+        (right_left_ratio / (1 + right_left_ratio)) * door_length,
+        door_angle);
+
+      // left door
+      add_door_slide_path(
+        door_motion_path,
+        meters_per_pixel,
+        v_end.x,
+        v_end.y,
+        (1 / (1 + right_left_ratio)) * door_length,
+        door_angle + M_PI);
+    }
+    else
+    {
+      qCWarning(lc_draw,
+        "tried to draw unknown door type: [%s]", door_type.c_str());
+    }
+  }
+  return door_motion_path;
+}
+
+void SceneGeometry::add_door_slide_path(
+  QPainterPath& path,
+  const double meters_per_pixel,
+  double hinge_x,
+  double hinge_y,
+  double door_length,
+  double door_angle)
+{
+  // the door as a thin line along +x, and a box around where it slides
+  // (in the wall, usually) behind the hinge. The box is one unit thick on
+  // either side of the door, to be scaled to the sliding panel thickness.
+  static const QPainterPath unit_slide_path = []()
+    {
+      QPainterPath unit_path;
+      unit_path.moveTo(0.0, 0.0);
+      unit_path.lineTo(1.0, 0.0);
+      unit_path.moveTo(0.0, -1.0);
+      unit_path.lineTo(-1.0, -1.0);
+      unit_path.lineTo(-1.0, 1.0);
+      unit_path.lineTo(0.0, 1.0);
+      unit_path.lineTo(0.0, -1.0);
+      return unit_path;
+    }();
+
+  const double s = 0.15 / meters_per_pixel;  // sliding panel thickness
+
+  QTransform t;
+  t.translate(hinge_x, hinge_y);
+  t.rotateRadians(door_angle);
+  t.scale(door_length, s);
+  path.addPath(t.map(unit_slide_path));
+}
+
+const QPainterPath& SceneGeometry::unit_swing_path(const double sweep_angle)
+{
+  // doors of a map mostly share a handful of swing angles, so each one is
+  // sampled once; std::map never moves its elements, so the references
+  // handed out stay valid. Called from worker threads, hence the lock.
+  static std::mutex mutex;
+  static std::map<double, QPainterPath> paths;
+  std::lock_guard<std::mutex> lock(mutex);
+
+  auto it = paths.find(sweep_angle);
+  if (it != paths.end())
+    return it->second;
+
+  QPainterPath& path = paths[sweep_angle];
+  path.moveTo(0.0, 0.0);
+  path.lineTo(1.0, 0.0);
+
+  const int NUM_MOTION_STEPS = 10;
+  const double angle_inc = sweep_angle / (NUM_MOTION_STEPS-1);
+  for (int i = 0; i < NUM_MOTION_STEPS; i++)
+  {
+    // compute door opening angle at this motion step
+    const double a = i * angle_inc;
+    path.lineTo(std::cos(a), std::sin(a));
+  }
+
+  path.lineTo(0.0, 0.0);
+  return path;
+}
+
+void SceneGeometry::add_door_swing_path(
+  QPainterPath& path,
+  double hinge_x,
+  double hinge_y,
+  double door_length,
+  double start_angle,
+  double end_angle)
+{
+  // instance the unit swing of this sweep: no trigonometry per door
+  QTransform t;
+  t.translate(hinge_x, hinge_y);
+  t.rotateRadians(start_angle);
+  t.scale(door_length, door_length);
+  path.addPath(t.map(unit_swing_path(end_angle - start_angle)));
+}
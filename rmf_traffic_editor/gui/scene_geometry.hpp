@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__SCENE_GEOMETRY_HPP
+#define TRAFFIC_EDITOR__SCENE_GEOMETRY_HPP
+
+#include <map>
+#include <vector>
+
+#include <QPainterPath>
+#include <QPolygonF>
+
+#include "edge.h"
+#include "graph.h"
+#include "polygon.h"
+#include "vertex.h"
+
+//=============================================================================
+/// Render-ready geometry of a level: the paths and polygons which are
+/// expensive to compute for big levels. It is computed from copies of the
+/// level data and touches no QGraphicsItems, so compute() can run on a
+/// worker thread while the GUI thread only has to materialize the items.
+class SceneGeometry
+{
+public:
+  struct Input
+  {
+    std::vector<Vertex> vertices;
+    std::vector<Edge> edges;
+    std::vector<Polygon> polygons;
+    std::vector<Graph> graphs;
+    double meters_per_pixel = 0.05;
+  };
+
+  /// Door travel arcs and slide boxes, by edge index (empty for non-doors)
+  std::vector<QPainterPath> door_motion_paths;
+
+  /// Arrowheads of the unidirectional lanes, by graph and lane pen width
+  std::map<int, std::map<double, QPainterPath>> lane_arrow_paths;
+
+  /// Outline of each polygon, by polygon index
+  std::vector<QPolygonF> polygons;
+
+  static SceneGeometry compute(const Input& input);
+
+  /// Sanity check that this was computed from a level with these entities
+  bool matches(
+    const std::vector<Edge>& level_edges,
+    const std::vector<Polygon>& level_polygons) const;
+
+  static double lane_pen_width(
+    const Edge& edge,
+    const std::vector<Graph>& graphs,
+    const double meters_per_pixel);
+
+  static void add_lane_arrows(
+    QPainterPath& path,
+    const Vertex& v_start,
+    const Vertex& v_end,
+    const double lane_pen_width);
+
+  static QPainterPath door_motion_path(
+    const Edge& edge,
+    const Vertex& v_start,
+    const Vertex& v_end,
+    const double meters_per_pixel);
+
+private:
+  /// Door swing of unit length from angle 0 to sweep_angle, around the
+  /// origin; shared by every door with that sweep
+  static const QPainterPath& unit_swing_path(const double sweep_angle);
+
+  static void add_door_swing_path(
+    QPainterPath& path,
+    double hinge_x,
+    double hinge_y,
+    double door_length,
+    double start_angle,
+    double end_angle);
+
+  static void add_door_slide_path(
+    QPainterPath& path,
+    const double meters_per_pixel,
+    double hinge_x,
+    double hinge_y,
+    double door_length,
+    double door_angle);
+};
+
+#endif
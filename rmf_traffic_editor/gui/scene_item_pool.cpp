@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include <QGraphicsEllipseItem>
+#include <QGraphicsLineItem>
+#include <QGraphicsPathItem>
+#include <QGraphicsPixmapItem>
+#include <QGraphicsPolygonItem>
+#include <QGraphicsScene>
+#include <QGraphicsSimpleTextItem>
+
+#include "level_of_detail.hpp"
+#include "scene_item_pool.hpp"
+
+const std::size_t SceneItemPool::MAX_FREE_ITEMS;
+
+namespace {
+
+// QGraphicsItem::data() key marking the items created by the pool; items
+// of the same types created elsewhere may be subclasses, or carry data
+// which the pool does not know how to reset
+const int POOLED_KEY = 1100;
+
+void insert(
+  QGraphicsItem* item,
+  QGraphicsScene* scene,
+  QGraphicsItem* parent)
+{
+  if (parent)
+    item->setParentItem(parent);
+  else
+    scene->addItem(item);
+}
+
+}  // namespace
+
+SceneItemPool& SceneItemPool::instance()
+{
+  static SceneItemPool pool;
+  return pool;
+}
+
+SceneItemPool::~SceneItemPool()
+{
+  clear();
+}
+
+template<typename T>
+T* SceneItemPool::acquire(const Kind kind)
+{
+  T* item = nullptr;
+  std::vector<QGraphicsItem*>& free_items = _free[kind];
+  if (!free_items.empty())
+  {
+    item = static_cast<T*>(free_items.back());
+    free_items.pop_back();
+  }
+  else
+  {
+    item = new T();
+    item->setData(POOLED_KEY, true);
+  }
+  return item;
+}
+
+void SceneItemPool::recycle(const QList<QGraphicsItem*>& items)
+{
+  for (QGraphicsItem* item : items)
+  {
+    if (!item)
+      continue;
+
+    Kind kind = NUM_KINDS;
+    if (item->data(POOLED_KEY).isValid())
+    {
+      switch (item->type())
+      {
+        case QGraphicsLineItem::Type: kind = LINE; break;
+        case QGraphicsPathItem::Type: kind = PATH; break;
+        case QGraphicsEllipseItem::Type: kind = ELLIPSE; break;
+        case QGraphicsPolygonItem::Type: kind = POLYGON; break;
+        case QGraphicsSimpleTextItem::Type: kind = SIMPLE_TEXT; break;
+        case QGraphicsPixmapItem::Type: kind = PIXMAP; break;
+        default: break;
+      }
+    }
+
+    if (kind == NUM_KINDS ||
+      _free[kind].size() >= MAX_FREE_ITEMS ||
+      !item->childItems().isEmpty())
+    {
+      if (item->scene())
+        item->scene()->removeItem(item);
+      delete item;
+      continue;
+    }
+
+    if (item->parentItem())
+      item->setParentItem(nullptr);
+    if (item->scene())
+      item->scene()->removeItem(item);
+
+    item->setPos(0.0, 0.0);
+    item->setTransform(QTransform());
+    item->setScale(1.0);
+    item->setZValue(0.0);
+    item->setVisible(true);
+    item->setToolTip(QString());
+    LevelOfDetail::untag(item);
+    if (kind == PIXMAP)
+    {
+      // don't keep the image of a closed building alive
+      static_cast<QGraphicsPixmapItem*>(item)->setPixmap(QPixmap());
+    }
+    _free[kind].push_back(item);
+  }
+}
+
+QGraphicsLineItem* SceneItemPool::line(
+  QGraphicsScene* scene,
+  const QLineF& line,
+  const QPen& pen,
+  QGraphicsItem* parent)
+{
+  QGraphicsLineItem* item = acquire<QGraphicsLineItem>(LINE);
+  // the geometry is set before the item enters the scene, so that the
+  // scene index is only updated once
+  item->setLine(line);
+  item->setPen(pen);
+  insert(item, scene, parent);
+  return item;
+}
+
+QGraphicsPathItem* SceneItemPool::path(
+  QGraphicsScene* scene,
+  const QPainterPath& path,
+  const QPen& pen,
+  const QBrush& brush,
+  QGraphicsItem* parent)
+{
+  QGraphicsPathItem* item = acquire<QGraphicsPathItem>(PATH);
+  item->setPath(path);
+  item->setPen(pen);
+  item->setBrush(brush);
+  insert(item, scene, parent);
+  return item;
+}
+
+QGraphicsEllipseItem* SceneItemPool::ellipse(
+  QGraphicsScene* scene,
+  const QRectF& rect,
+  const QPen& pen,
+  const QBrush& brush)
+{
+  QGraphicsEllipseItem* item = acquire<QGraphicsEllipseItem>(ELLIPSE);
+  item->setRect(rect);
+  item->setPen(pen);
+  item->setBrush(brush);
+  insert(item, scene, nullptr);
+  return item;
+}
+
+QGraphicsPolygonItem* SceneItemPool::polygon(
+  QGraphicsScene* scene,
+  const QPolygonF& polygon,
+  const QPen& pen,
+  const QBrush& brush)
+{
+  QGraphicsPolygonItem* item = acquire<QGraphicsPolygonItem>(POLYGON);
+  item->setPolygon(polygon);
+  item->setPen(pen);
+  item->setBrush(brush);
+  insert(item, scene, nullptr);
+  return item;
+}
+
+QGraphicsSimpleTextItem* SceneItemPool::simple_text(
+  QGraphicsScene* scene,
+  const QString& text,
+  const QFont& font)
+{
+  QGraphicsSimpleTextItem* item =
+    acquire<QGraphicsSimpleTextItem>(SIMPLE_TEXT);
+  item->setText(text);
+  item->setFont(font);
+  item->setPen(QPen(Qt::NoPen));
+  item->setBrush(QBrush(Qt::black));
+  insert(item, scene, nullptr);
+  return item;
+}
+
+QGraphicsPixmapItem* SceneItemPool::pixmap(
+  QGraphicsScene* scene,
+  const QPixmap& pixmap)
+{
+  QGraphicsPixmapItem* item = acquire<QGraphicsPixmapItem>(PIXMAP);
+  item->setPixmap(pixmap);
+  item->setOffset(0.0, 0.0);
+  insert(item, scene, nullptr);
+  return item;
+}
+
+void SceneItemPool::clear()
+{
+  for (int i = 0; i < NUM_KINDS; i++)
+  {
+    for (QGraphicsItem* item : _free[i])
+      delete item;
+    _free[i].clear();
+  }
+}
+
+std::size_t SceneItemPool::size() const
+{
+  std::size_t n = 0;
+  for (int i = 0; i < NUM_KINDS; i++)
+    n += _free[i].size();
+  return n;
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef TRAFFIC_EDITOR__SCENE_ITEM_POOL_HPP
+#define TRAFFIC_EDITOR__SCENE_ITEM_POOL_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include <QBrush>
+#include <QList>
+#include <QPen>
+
+class QFont;
+class QGraphicsEllipseItem;
+class QGraphicsItem;
+class QGraphicsLineItem;
+class QGraphicsPathItem;
+class QGraphicsPixmapItem;
+class QGraphicsPolygonItem;
+class QGraphicsScene;
+class QGraphicsSimpleTextItem;
+class QLineF;
+class QPainterPath;
+class QPixmap;
+class QPolygonF;
+class QRectF;
+class QString;
+
+//=============================================================================
+/// Free lists of the plain graphics items which a full draw of a level
+/// creates by the hundred thousand, one list per item type. Before a scene
+/// is cleared, the items of the levels in it are recycled here instead of
+/// being deleted with it, and the next draw takes them back, setting their
+/// geometry and style again, rather than allocating new ones.
+///
+/// Only items handed out by the pool are recycled; anything else passed to
+/// recycle() is deleted. The recycled items get back the default position,
+/// transform, Z value, visibility, tooltip and level-of-detail tags, which
+/// is all that the drawing code changes on them after acquiring them. The
+/// pool lives in the GUI thread, like the scenes it serves.
+class SceneItemPool
+{
+public:
+  static SceneItemPool& instance();
+
+  ~SceneItemPool();
+
+  /// Take the items out of the scene and keep them for the next draw.
+  /// They must not be used by the caller afterwards.
+  void recycle(const QList<QGraphicsItem*>& items);
+
+  /// Each of these adds an item to the scene, or to the parent if there is
+  /// one, as the matching QGraphicsScene::add*() would
+  QGraphicsLineItem* line(
+    QGraphicsScene* scene,
+    const QLineF& line,
+    const QPen& pen,
+    QGraphicsItem* parent = nullptr);
+
+  QGraphicsPathItem* path(
+    QGraphicsScene* scene,
+    const QPainterPath& path,
+    const QPen& pen,
+    const QBrush& brush = QBrush(),
+    QGraphicsItem* parent = nullptr);
+
+  QGraphicsEllipseItem* ellipse(
+    QGraphicsScene* scene,
+    const QRectF& rect,
+    const QPen& pen,
+    const QBrush& brush = QBrush());
+
+  QGraphicsPolygonItem* polygon(
+    QGraphicsScene* scene,
+    const QPolygonF& polygon,
+    const QPen& pen,
+    const QBrush& brush = QBrush());
+
+  QGraphicsSimpleTextItem* simple_text(
+    QGraphicsScene* scene,
+    const QString& text,
+    const QFont& font);
+
+  QGraphicsPixmapItem* pixmap(QGraphicsScene* scene, const QPixmap& pixmap);
+
+  /// Delete all of the free items, e.g. after closing a large building
+  void clear();
+
+  /// Number of free items of all types
+  std::size_t size() const;
+
+  /// At most this many free items are kept per type; the rest are deleted
+  static const std::size_t MAX_FREE_ITEMS = 1 << 18;
+
+private:
+  enum Kind
+  {
+    LINE = 0,
+    PATH,
+    ELLIPSE,
+    POLYGON,
+    SIMPLE_TEXT,
+    PIXMAP,
+    NUM_KINDS
+  };
+
+  SceneItemPool() = default;
+
+  /// A free item of this kind, or a new one, not in any scene yet
+  template<typename T>
+  T* acquire(const Kind kind);
+
+  std::vector<QGraphicsItem*> _free[NUM_KINDS];
+};
+
+#endif
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <QGraphicsItem>
+#include <QGraphicsScene>
+
+#include "scene_item_pool.hpp"
+#include "scene_items.hpp"
+
+
+void SceneItems::reset()
+{
+  for (int i = 0; i < NUM_KINDS; i++)
+    _items[i].clear();
+  _valid = true;
+}
+
+void SceneItems::invalidate()
+{
+  for (int i = 0; i < NUM_KINDS; i++)
+    _items[i].clear();
+  _valid = false;
+}
+
+void SceneItems::set(
+  const Kind kind,
+  const std::size_t idx,
+  const QList<QGraphicsItem*>& items)
+{
+  if (idx >= _items[kind].size())
+    _items[kind].resize(idx + 1);
+  _items[kind][idx] = items;
+}
+
+void SceneItems::remove(
+  QGraphicsScene* scene,
+  const Kind kind,
+  const std::size_t idx)
+{
+  if (idx >= _items[kind].size())
+    return;
+
+  (void)scene;  // the items know their scene
+  SceneItemPool::instance().recycle(_items[kind][idx]);
+  _items[kind][idx].clear();
+}
+
+void SceneItems::recycle(QGraphicsScene* scene)
+{
+  if (!_valid)
+    return;
+
+  // all items of a level are in the same scene
+  QGraphicsScene* items_scene = nullptr;
+  for (int i = 0; i < NUM_KINDS && !items_scene; i++)
+  {
+    for (const QList<QGraphicsItem*>& items : _items[i])
+    {
+      if (!items.isEmpty())
+      {
+        items_scene = items.first()->scene();
+        break;
+      }
+    }
+  }
+  if (items_scene && items_scene != scene)
+    return;
+
+  SceneItemPool& pool = SceneItemPool::instance();
+  for (int i = 0; i < NUM_KINDS; i++)
+  {
+    for (const QList<QGraphicsItem*>& items : _items[i])
+      pool.recycle(items);
+  }
+  invalidate();
+}
+
+int SceneItems::item_count(const Kind kind) const
+{
+  int count = 0;
+  for (const QList<QGraphicsItem*>& items : _items[kind])
+    count += items.size();
+  return count;
+}
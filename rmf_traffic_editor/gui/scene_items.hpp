@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__SCENE_ITEMS_HPP
+#define TRAFFIC_EDITOR__SCENE_ITEMS_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include <QList>
+
+class QGraphicsItem;
+class QGraphicsScene;
+
+//=============================================================================
+/// Remembers which QGraphicsItems were created for each entity of a level,
+/// so that a single vertex, edge, etc. can be re-rendered without clearing
+/// and rebuilding the entire scene. The items are borrowed pointers: they
+/// are owned by the QGraphicsScene, which deletes them in scene->clear(),
+/// so invalidate() must be called whenever that happens, unless recycle()
+/// took them out of the scene before.
+class SceneItems
+{
+public:
+  enum Kind
+  {
+    VERTEX = 0,
+    EDGE,
+    POLYGON,
+    TAG,
+    FIDUCIAL,
+    CONSTRAINT,
+    NUM_KINDS
+  };
+
+  /// Forget all items and mark the registry as matching the scene. Called
+  /// at the start of a full draw of the level.
+  void reset();
+
+  /// The scene was cleared (or never drawn); the stored pointers are stale.
+  void invalidate();
+
+  bool is_valid() const { return _valid; }
+
+  void set(
+    const Kind kind,
+    const std::size_t idx,
+    const QList<QGraphicsItem*>& items);
+
+  /// Remove the items of one entity from the scene, passing them on to
+  /// the SceneItemPool for reuse.
+  void remove(QGraphicsScene* scene, const Kind kind, const std::size_t idx);
+
+  /// If the items are in this scene, which is about to be cleared, give
+  /// them all to the SceneItemPool and invalidate(). Items in another
+  /// scene are left alone.
+  void recycle(QGraphicsScene* scene);
+
+  std::size_t size(const Kind kind) const { return _items[kind].size(); }
+
+  /// Total number of items of all entities of this kind
+  int item_count(const Kind kind) const;
+
+  bool has_items(const Kind kind, const std::size_t idx) const
+  {
+    return idx < _items[kind].size() && !_items[kind][idx].isEmpty();
+  }
+
+private:
+  bool _valid = false;
+  std::vector<QList<QGraphicsItem*>> _items[NUM_KINDS];
+};
+
+#endif
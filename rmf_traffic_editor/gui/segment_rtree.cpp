@@ -0,0 +1,374 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <tuple>
+
+#include "segment_rtree.hpp"
+
+
+void SegmentRTree::Box::expand(const Box& b)
+{
+  x_min = std::min(x_min, b.x_min);
+  y_min = std::min(y_min, b.y_min);
+  x_max = std::max(x_max, b.x_max);
+  y_max = std::max(y_max, b.y_max);
+}
+
+double SegmentRTree::Box::area() const
+{
+  if (x_max < x_min || y_max < y_min)
+    return 0.0;
+  return (x_max - x_min) * (y_max - y_min);
+}
+
+double SegmentRTree::Box::enlargement(const Box& b) const
+{
+  Box expanded(*this);
+  expanded.expand(b);
+  return expanded.area() - area();
+}
+
+double SegmentRTree::Box::distance_squared(
+  const double x,
+  const double y) const
+{
+  const double dx = std::max({x_min - x, 0.0, x - x_max});
+  const double dy = std::max({y_min - y, 0.0, y - y_max});
+  return dx*dx + dy*dy;
+}
+
+SegmentRTree::Box SegmentRTree::segment_box(const Segment& s)
+{
+  Box b;
+  b.x_min = std::min(s.x0, s.x1);
+  b.y_min = std::min(s.y0, s.y1);
+  b.x_max = std::max(s.x0, s.x1);
+  b.y_max = std::max(s.y0, s.y1);
+  return b;
+}
+
+double SegmentRTree::distance_to_segment(
+  const double x,
+  const double y,
+  const Segment& s)
+{
+  const double dx = s.x1 - s.x0;
+  const double dy = s.y1 - s.y0;
+  const double length_squared = dx*dx + dy*dy;
+  double t = 0.0;
+  if (length_squared > 0.0)
+  {
+    t = ((x - s.x0) * dx + (y - s.y0) * dy) / length_squared;
+    t = std::max(0.0, std::min(1.0, t));
+  }
+  const double dx_proj = x - (s.x0 + t * dx);
+  const double dy_proj = y - (s.y0 + t * dy);
+  return std::sqrt(dx_proj*dx_proj + dy_proj*dy_proj);
+}
+
+void SegmentRTree::clear()
+{
+  _nodes.clear();
+  _root = -1;
+  _entries.clear();
+  _num_entries = 0;
+}
+
+void SegmentRTree::build(const std::vector<std::pair<int, Segment>>& segments)
+{
+  clear();
+  for (const auto& id_segment : segments)
+  {
+    const int id = id_segment.first;
+    if (id < 0)
+      continue;
+    if (static_cast<std::size_t>(id) >= _entries.size())
+      _entries.resize(id + 1);
+    Entry& entry = _entries[id];
+    if (entry.leaf < 0)
+      _num_entries++;
+    entry.segment = id_segment.second;
+    entry.box = segment_box(entry.segment);
+    entry.leaf = 0;  // placeholder until rebuild() packs it
+  }
+  rebuild();
+}
+
+void SegmentRTree::rebuild()
+{
+  _nodes.clear();
+  _root = -1;
+
+  std::vector<int> items;
+  for (std::size_t i = 0; i < _entries.size(); i++)
+  {
+    if (_entries[i].leaf >= 0)
+      items.push_back(static_cast<int>(i));
+  }
+  if (items.empty())
+    return;
+
+  // sort-tile-recursive packing, one tree level at a time
+  bool leaves = true;
+  do
+  {
+    pack(items, leaves);
+    leaves = false;
+  } while (items.size() > 1);
+  _root = items[0];
+}
+
+int SegmentRTree::pack(std::vector<int>& items, const bool leaves)
+{
+  auto box_of = [&](const int item) -> const Box&
+    {
+      return leaves ? _entries[item].box : _nodes[item].box;
+    };
+
+  const std::size_t num_groups =
+    (items.size() + MAX_CHILDREN - 1) / MAX_CHILDREN;
+  const std::size_t num_slices = static_cast<std::size_t>(
+    std::ceil(std::sqrt(static_cast<double>(num_groups))));
+  const std::size_t slice_size = num_slices * MAX_CHILDREN;
+
+  std::sort(
+    items.begin(),
+    items.end(),
+    [&](const int a, const int b)
+    {
+      return box_of(a).center_x() < box_of(b).center_x();
+    });
+
+  std::vector<int> parents;
+  for (std::size_t slice = 0; slice < items.size(); slice += slice_size)
+  {
+    const auto slice_begin = items.begin() + slice;
+    const auto slice_end =
+      items.begin() + std::min(slice + slice_size, items.size());
+    std::sort(
+      slice_begin,
+      slice_end,
+      [&](const int a, const int b)
+      {
+        return box_of(a).center_y() < box_of(b).center_y();
+      });
+
+    for (auto it = slice_begin; it < slice_end; it += MAX_CHILDREN)
+    {
+      const int node_idx = static_cast<int>(_nodes.size());
+      _nodes.push_back(Node());
+      Node& node = _nodes.back();
+      node.leaf = leaves;
+      const auto group_end =
+        slice_end - it > static_cast<int>(MAX_CHILDREN) ?
+        it + MAX_CHILDREN : slice_end;
+      for (auto child = it; child < group_end; ++child)
+      {
+        node.children.push_back(*child);
+        node.box.expand(box_of(*child));
+        if (leaves)
+          _entries[*child].leaf = node_idx;
+        else
+          _nodes[*child].parent = node_idx;
+      }
+      parents.push_back(node_idx);
+    }
+  }
+
+  items.swap(parents);
+  return static_cast<int>(items.size());
+}
+
+void SegmentRTree::refit(int node_idx)
+{
+  while (node_idx >= 0)
+  {
+    Node& node = _nodes[node_idx];
+    node.box = Box();
+    for (const int child : node.children)
+      node.box.expand(node.leaf ? _entries[child].box : _nodes[child].box);
+    node_idx = node.parent;
+  }
+}
+
+bool SegmentRTree::contains(const int id) const
+{
+  return id >= 0 &&
+    static_cast<std::size_t>(id) < _entries.size() &&
+    _entries[id].leaf >= 0;
+}
+
+void SegmentRTree::insert(const int id, const Segment& segment)
+{
+  if (id < 0)
+    return;
+  if (contains(id))
+    remove(id);
+  if (static_cast<std::size_t>(id) >= _entries.size())
+    _entries.resize(id + 1);
+
+  Entry& entry = _entries[id];
+  entry.segment = segment;
+  entry.box = segment_box(segment);
+
+  if (_root < 0)
+  {
+    _root = static_cast<int>(_nodes.size());
+    _nodes.push_back(Node());
+  }
+
+  // descend to the leaf whose box needs the least enlargement
+  int node_idx = _root;
+  while (!_nodes[node_idx].leaf)
+  {
+    const Node& node = _nodes[node_idx];
+    int best_child = node.children[0];
+    double best_enlargement = 1e100;
+    double best_area = 1e100;
+    for (const int child : node.children)
+    {
+      const Box& child_box = _nodes[child].box;
+      const double enlargement = child_box.enlargement(entry.box);
+      const double area = child_box.area();
+      if (enlargement < best_enlargement ||
+        (enlargement == best_enlargement && area < best_area))
+      {
+        best_child = child;
+        best_enlargement = enlargement;
+        best_area = area;
+      }
+    }
+    node_idx = best_child;
+  }
+
+  _nodes[node_idx].children.push_back(id);
+  entry.leaf = node_idx;
+  _num_entries++;
+
+  for (int n = node_idx; n >= 0; n = _nodes[n].parent)
+    _nodes[n].box.expand(entry.box);
+
+  // rather than splitting nodes, repack once a leaf grows far too big
+  if (_nodes[node_idx].children.size() > 2 * MAX_CHILDREN)
+    rebuild();
+}
+
+void SegmentRTree::remove(const int id)
+{
+  if (!contains(id))
+    return;
+
+  Entry& entry = _entries[id];
+  std::vector<int>& children = _nodes[entry.leaf].children;
+  children.erase(std::remove(children.begin(), children.end(), id),
+    children.end());
+  refit(entry.leaf);
+  entry.leaf = -1;
+  _num_entries--;
+
+  if (_num_entries == 0)
+  {
+    _nodes.clear();
+    _root = -1;
+  }
+}
+
+int SegmentRTree::nearest(
+  const double x,
+  const double y,
+  double& distance,
+  const std::function<bool(int)>& accept) const
+{
+  distance = 1e100;
+  if (_root < 0)
+    return -1;
+
+  // best-first search: (squared distance, is entry, node index or id)
+  using Candidate = std::tuple<double, bool, int>;
+  std::priority_queue<
+    Candidate,
+    std::vector<Candidate>,
+    std::greater<Candidate>> queue;
+  queue.push(Candidate(_nodes[_root].box.distance_squared(x, y), false, _root));
+
+  while (!queue.empty())
+  {
+    const Candidate candidate = queue.top();
+    queue.pop();
+    if (std::get<1>(candidate))
+    {
+      distance = std::sqrt(std::get<0>(candidate));
+      return std::get<2>(candidate);
+    }
+
+    const Node& node = _nodes[std::get<2>(candidate)];
+    for (const int child : node.children)
+    {
+      if (node.leaf)
+      {
+        if (accept && !accept(child))
+          continue;
+        const double d = distance_to_segment(x, y, _entries[child].segment);
+        queue.push(Candidate(d*d, true, child));
+      }
+      else
+      {
+        queue.push(
+          Candidate(_nodes[child].box.distance_squared(x, y), false, child));
+      }
+    }
+  }
+  return -1;
+}
+
+void SegmentRTree::intersecting(
+  const double x_min,
+  const double y_min,
+  const double x_max,
+  const double y_max,
+  std::vector<int>& ids) const
+{
+  if (_root < 0)
+    return;
+
+  auto intersects = [&](const Box& b)
+    {
+      return b.x_min <= x_max && b.x_max >= x_min &&
+        b.y_min <= y_max && b.y_max >= y_min;
+    };
+
+  std::vector<int> stack;
+  stack.push_back(_root);
+  while (!stack.empty())
+  {
+    const Node& node = _nodes[stack.back()];
+    stack.pop_back();
+    if (!intersects(node.box))
+      continue;
+    for (const int child : node.children)
+    {
+      if (!node.leaf)
+        stack.push_back(child);
+      else if (intersects(_entries[child].box))
+        ids.push_back(child);
+    }
+  }
+}
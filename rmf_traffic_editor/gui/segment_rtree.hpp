@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef TRAFFIC_EDITOR__SEGMENT_RTREE_HPP
+#define TRAFFIC_EDITOR__SEGMENT_RTREE_HPP
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+//=============================================================================
+/// R-tree of line segments, keyed by small dense integer ids (typically
+/// edge indices), for hit-testing and nearest-segment queries in
+/// logarithmic time. The tree is bulk-loaded by build() and then updated
+/// in place by insert() and remove(); it repacks itself if incremental
+/// inserts unbalance it too much.
+class SegmentRTree
+{
+public:
+  struct Segment
+  {
+    double x0 = 0.0;
+    double y0 = 0.0;
+    double x1 = 0.0;
+    double y1 = 0.0;
+  };
+
+  void clear();
+
+  /// Replace the contents with these (id, segment) pairs
+  void build(const std::vector<std::pair<int, Segment>>& segments);
+
+  /// Insert a segment, or move it if this id is already present
+  void insert(const int id, const Segment& segment);
+
+  void remove(const int id);
+
+  bool contains(const int id) const;
+
+  std::size_t size() const { return _num_entries; }
+
+  /// Id of the segment closest to (x, y) among those accepted by the
+  /// (optional) filter, or -1 if there are none
+  int nearest(
+    const double x,
+    const double y,
+    double& distance,
+    const std::function<bool(int)>& accept = nullptr) const;
+
+  /// Append the ids of all segments whose bounding box intersects the box
+  void intersecting(
+    const double x_min,
+    const double y_min,
+    const double x_max,
+    const double y_max,
+    std::vector<int>& ids) const;
+
+  static double distance_to_segment(
+    const double x,
+    const double y,
+    const Segment& segment);
+
+private:
+  static const std::size_t MAX_CHILDREN = 16;
+
+  struct Box
+  {
+    double x_min = 1e100;
+    double y_min = 1e100;
+    double x_max = -1e100;
+    double y_max = -1e100;
+
+    void expand(const Box& b);
+    double area() const;
+    double enlargement(const Box& b) const;
+    double distance_squared(const double x, const double y) const;
+    double center_x() const { return 0.5 * (x_min + x_max); }
+    double center_y() const { return 0.5 * (y_min + y_max); }
+  };
+
+  struct Node
+  {
+    Box box;
+    bool leaf = true;
+    int parent = -1;
+    std::vector<int> children;  // node indices, or entry ids in leaves
+  };
+
+  struct Entry
+  {
+    Segment segment;
+    Box box;
+    int leaf = -1;  // -1 if this id isn't in the tree
+  };
+
+  std::vector<Node> _nodes;
+  int _root = -1;
+  std::vector<Entry> _entries;
+  std::size_t _num_entries = 0;
+
+  static Box segment_box(const Segment& segment);
+  void rebuild();
+  int pack(std::vector<int>& items, const bool leaves);
+  void refit(int node_idx);
+};
+
+#endif
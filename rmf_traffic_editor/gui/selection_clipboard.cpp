@@ -0,0 +1,510 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include <QClipboard>
+#include <QGuiApplication>
+#include <QMimeData>
+
+#include "selection_clipboard.hpp"
+#include "string_table.hpp"
+
+namespace {
+
+static_assert(sizeof(SelectionClipboard::Header) == 48, "header layout");
+static_assert(
+  sizeof(SelectionClipboard::VertexRecord) == 32, "vertex layout");
+static_assert(sizeof(SelectionClipboard::EdgeRecord) == 20, "edge layout");
+static_assert(
+  sizeof(SelectionClipboard::PolygonRecord) == 20, "polygon layout");
+static_assert(sizeof(SelectionClipboard::ModelRecord) == 48, "model layout");
+static_assert(sizeof(SelectionClipboard::ParamRecord) == 24, "param layout");
+
+template<typename T>
+void append_records(QByteArray& data, const std::vector<T>& records)
+{
+  data.append(
+    reinterpret_cast<const char*>(records.data()),
+    static_cast<int>(records.size() * sizeof(T)));
+}
+
+/// Copy count records from data + offset, advancing the offset; the
+/// caller has checked that they fit
+template<typename T>
+void read_records(
+  const char* data,
+  std::size_t& offset,
+  const uint32_t count,
+  std::vector<T>& records)
+{
+  records.resize(count);
+  std::memcpy(records.data(), data + offset, count * sizeof(T));
+  offset += count * sizeof(T);
+}
+
+/// The params of every entity, one after another
+class ParamWriter
+{
+public:
+  explicit ParamWriter(StringTable& strings) : _strings(strings) {}
+
+  void add(const ParamMap& params, uint32_t& first, uint32_t& count)
+  {
+    first = static_cast<uint32_t>(records.size());
+    count = static_cast<uint32_t>(params.size());
+    for (const auto& param : params)
+    {
+      SelectionClipboard::ParamRecord record;
+      record.key = _strings.add(param.first);
+      record.type = static_cast<uint32_t>(param.second.type);
+      record.value_string = 0;
+      record.value_int = 0;
+      record.value_double = 0.0;
+      switch (param.second.type)
+      {
+        case Param::STRING:
+          record.value_string = _strings.add(param.second.value_string);
+          break;
+        case Param::INT:
+          record.value_int = param.second.value_int;
+          break;
+        case Param::DOUBLE:
+          record.value_double = param.second.value_double;
+          break;
+        case Param::BOOL:
+          record.value_int = param.second.value_bool ? 1 : 0;
+          break;
+        default:
+          break;
+      }
+      records.push_back(record);
+    }
+  }
+
+  std::vector<SelectionClipboard::ParamRecord> records;
+
+private:
+  StringTable& _strings;
+};
+
+Param make_param(
+  const SelectionClipboard::ParamRecord& record,
+  const std::vector<std::string>& strings)
+{
+  switch (record.type)
+  {
+    case Param::STRING:
+      return Param(strings[record.value_string]);
+    case Param::INT:
+      return Param(static_cast<int>(record.value_int));
+    case Param::DOUBLE:
+      return Param(record.value_double);
+    case Param::BOOL:
+      return Param(record.value_int != 0);
+    default:
+      return Param();
+  }
+}
+
+}  // namespace
+
+const char* SelectionClipboard::mime_type()
+{
+  return "application/x-traffic-editor-selection";
+}
+
+SelectionClipboard SelectionClipboard::from_selection(
+  const Level& level,
+  const std::vector<Level::SelectedItem>& items)
+{
+  SelectionClipboard clip;
+  clip.meters_per_pixel = level.drawing_meters_per_pixel;
+
+  // the index of each copied vertex of the level in the clip, or -1
+  std::vector<int> vertex_map(level.vertices.size(), -1);
+  auto copy_vertex = [&](const int idx)
+    {
+      if (idx < 0 || idx >= static_cast<int>(level.vertices.size()) ||
+        vertex_map[idx] >= 0)
+        return;
+      const Vertex& v = level.vertices[idx];
+      vertex_map[idx] = static_cast<int>(clip.vertices.size());
+      clip.vertices.push_back(Vertex(v.x, v.y, v.name));
+      clip.vertices.back().params = v.params;
+    };
+
+  for (const Level::SelectedItem& item : items)
+  {
+    if (item.vertex_idx >= 0)
+      copy_vertex(item.vertex_idx);
+    else if (item.edge_idx >= 0 &&
+      item.edge_idx < static_cast<int>(level.edges.size()))
+    {
+      const Edge& edge = level.edges[item.edge_idx];
+      copy_vertex(edge.start_idx);
+      copy_vertex(edge.end_idx);
+    }
+    else if (item.polygon_idx >= 0 &&
+      item.polygon_idx < static_cast<int>(level.polygons.size()))
+    {
+      for (const int v_idx : level.polygons[item.polygon_idx].vertices)
+        copy_vertex(v_idx);
+    }
+    else if (item.model_idx >= 0 &&
+      item.model_idx < static_cast<int>(level.models.size()))
+    {
+      const Model& source = level.models[item.model_idx];
+      Model model;
+      model.state = source.state;
+      model.model_name = source.model_name;
+      model.instance_name = source.instance_name;
+      model.is_static = source.is_static;
+      clip.models.push_back(model);
+    }
+  }
+
+  auto is_copied = [&](const int idx)
+    {
+      return idx >= 0 && idx < static_cast<int>(vertex_map.size()) &&
+        vertex_map[idx] >= 0;
+    };
+
+  // everything among the copied vertices comes along, in level order
+  for (std::size_t i = 0; i < level.edges.size(); i++)
+  {
+    const Edge& edge = level.edges[i];
+    if (!is_copied(edge.start_idx) || !is_copied(edge.end_idx))
+      continue;
+    clip.edges.push_back(
+      Edge(vertex_map[edge.start_idx], vertex_map[edge.end_idx], edge.type));
+    clip.edges.back().params = edge.params;
+  }
+
+  for (std::size_t i = 0; i < level.polygons.size(); i++)
+  {
+    const Polygon& polygon = level.polygons[i];
+    if (polygon.vertices.empty() ||
+      !std::all_of(
+        polygon.vertices.begin(),
+        polygon.vertices.end(),
+        is_copied))
+      continue;
+    Polygon copy;
+    copy.type = polygon.type;
+    copy.params = polygon.params;
+    copy.vertices.reserve(polygon.vertices.size());
+    for (const int v_idx : polygon.vertices)
+      copy.vertices.push_back(vertex_map[v_idx]);
+    clip.polygons.push_back(copy);
+  }
+
+  return clip;
+}
+
+std::size_t SelectionClipboard::size() const
+{
+  return vertices.size() + edges.size() + polygons.size() + models.size();
+}
+
+QPointF SelectionClipboard::center() const
+{
+  if (empty())
+    return QPointF();
+  double x_min = std::numeric_limits<double>::max();
+  double y_min = x_min;
+  double x_max = std::numeric_limits<double>::lowest();
+  double y_max = x_max;
+  auto extend = [&](const double x, const double y)
+    {
+      x_min = std::min(x_min, x);
+      x_max = std::max(x_max, x);
+      y_min = std::min(y_min, y);
+      y_max = std::max(y_max, y);
+    };
+  for (const Vertex& v : vertices)
+    extend(v.x, v.y);
+  for (const Model& m : models)
+    extend(m.state.x, m.state.y);
+  return QPointF((x_min + x_max) / 2, (y_min + y_max) / 2);
+}
+
+void SelectionClipboard::transform(
+  const double s,
+  const double dx,
+  const double dy)
+{
+  for (Vertex& v : vertices)
+  {
+    v.x = v.x * s + dx;
+    v.y = v.y * s + dy;
+  }
+  for (Model& m : models)
+  {
+    m.state.x = m.state.x * s + dx;
+    m.state.y = m.state.y * s + dy;
+  }
+}
+
+QByteArray SelectionClipboard::encode() const
+{
+  StringTable strings;
+  ParamWriter params(strings);
+
+  std::vector<VertexRecord> vertex_records(vertices.size());
+  for (std::size_t i = 0; i < vertices.size(); i++)
+  {
+    VertexRecord& record = vertex_records[i];
+    record.x = vertices[i].x;
+    record.y = vertices[i].y;
+    record.name = strings.add(vertices[i].name);
+    params.add(vertices[i].params, record.first_param, record.num_params);
+    record.reserved = 0;
+  }
+
+  std::vector<EdgeRecord> edge_records(edges.size());
+  for (std::size_t i = 0; i < edges.size(); i++)
+  {
+    EdgeRecord& record = edge_records[i];
+    record.start = static_cast<uint32_t>(edges[i].start_idx);
+    record.end = static_cast<uint32_t>(edges[i].end_idx);
+    record.type = static_cast<uint32_t>(edges[i].type);
+    params.add(edges[i].params, record.first_param, record.num_params);
+  }
+
+  std::vector<PolygonRecord> polygon_records(polygons.size());
+  std::vector<uint32_t> polygon_vertices;
+  for (std::size_t i = 0; i < polygons.size(); i++)
+  {
+    PolygonRecord& record = polygon_records[i];
+    record.type = static_cast<uint32_t>(polygons[i].type);
+    record.first_vertex = static_cast<uint32_t>(polygon_vertices.size());
+    record.num_vertices = static_cast<uint32_t>(polygons[i].vertices.size());
+    for (const int v_idx : polygons[i].vertices)
+      polygon_vertices.push_back(static_cast<uint32_t>(v_idx));
+    params.add(polygons[i].params, record.first_param, record.num_params);
+  }
+
+  std::vector<ModelRecord> model_records(models.size());
+  for (std::size_t i = 0; i < models.size(); i++)
+  {
+    ModelRecord& record = model_records[i];
+    record.x = models[i].state.x;
+    record.y = models[i].state.y;
+    record.z = models[i].state.z;
+    record.yaw = models[i].state.yaw;
+    record.model_name = strings.add(models[i].model_name);
+    record.instance_name = strings.add(models[i].instance_name);
+    record.is_static = models[i].is_static ? 1 : 0;
+    record.reserved = 0;
+  }
+
+  Header header;
+  header.magic = MAGIC;
+  header.version = VERSION;
+  header.meters_per_pixel = meters_per_pixel;
+  header.num_vertices = static_cast<uint32_t>(vertex_records.size());
+  header.num_edges = static_cast<uint32_t>(edge_records.size());
+  header.num_polygons = static_cast<uint32_t>(polygon_records.size());
+  header.num_polygon_vertices =
+    static_cast<uint32_t>(polygon_vertices.size());
+  header.num_models = static_cast<uint32_t>(model_records.size());
+  header.num_params = static_cast<uint32_t>(params.records.size());
+  header.num_strings = strings.size();
+  header.reserved = 0;
+
+  QByteArray data;
+  data.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  append_records(data, vertex_records);
+  append_records(data, edge_records);
+  append_records(data, polygon_records);
+  append_records(data, polygon_vertices);
+  append_records(data, model_records);
+  append_records(data, params.records);
+  strings.append_to(data);
+  return data;
+}
+
+bool SelectionClipboard::decode(const QByteArray& data)
+{
+  *this = SelectionClipboard();
+  const char* bytes = data.constData();
+  const std::size_t size = static_cast<std::size_t>(data.size());
+
+  Header header;
+  if (size < sizeof(header))
+    return false;
+  std::memcpy(&header, bytes, sizeof(header));
+  if (header.magic != MAGIC || header.version != VERSION)
+    return false;
+
+  const uint64_t records_size =
+    sizeof(Header) +
+    uint64_t(header.num_vertices) * sizeof(VertexRecord) +
+    uint64_t(header.num_edges) * sizeof(EdgeRecord) +
+    uint64_t(header.num_polygons) * sizeof(PolygonRecord) +
+    uint64_t(header.num_polygon_vertices) * sizeof(uint32_t) +
+    uint64_t(header.num_models) * sizeof(ModelRecord) +
+    uint64_t(header.num_params) * sizeof(ParamRecord);
+  if (records_size > size)
+    return false;
+
+  std::size_t offset = sizeof(Header);
+  std::vector<VertexRecord> vertex_records;
+  std::vector<EdgeRecord> edge_records;
+  std::vector<PolygonRecord> polygon_records;
+  std::vector<uint32_t> polygon_vertices;
+  std::vector<ModelRecord> model_records;
+  std::vector<ParamRecord> param_records;
+  read_records(bytes, offset, header.num_vertices, vertex_records);
+  read_records(bytes, offset, header.num_edges, edge_records);
+  read_records(bytes, offset, header.num_polygons, polygon_records);
+  read_records(bytes, offset, header.num_polygon_vertices, polygon_vertices);
+  read_records(bytes, offset, header.num_models, model_records);
+  read_records(bytes, offset, header.num_params, param_records);
+
+  std::vector<std::string> strings;
+  if (!StringTable::parse(
+      bytes + offset,
+      size - offset,
+      header.num_strings,
+      strings))
+    return false;
+
+  // check every reference before building anything
+  auto valid_string = [&](const uint32_t idx) { return idx < strings.size(); };
+  auto valid_params = [&](const uint32_t first, const uint32_t count)
+    {
+      return uint64_t(first) + count <= param_records.size();
+    };
+  for (const ParamRecord& record : param_records)
+  {
+    if (!valid_string(record.key) || !valid_string(record.value_string) ||
+      record.type > Param::BOOL)
+      return false;
+  }
+  for (const VertexRecord& record : vertex_records)
+  {
+    if (!valid_string(record.name) ||
+      !valid_params(record.first_param, record.num_params))
+      return false;
+  }
+  for (const EdgeRecord& record : edge_records)
+  {
+    if (record.start >= header.num_vertices ||
+      record.end >= header.num_vertices ||
+      record.type > Edge::HUMAN_LANE ||
+      !valid_params(record.first_param, record.num_params))
+      return false;
+  }
+  for (const PolygonRecord& record : polygon_records)
+  {
+    if (uint64_t(record.first_vertex) + record.num_vertices >
+      polygon_vertices.size() ||
+      record.type > Polygon::HOLE ||
+      !valid_params(record.first_param, record.num_params))
+      return false;
+  }
+  for (const uint32_t v_idx : polygon_vertices)
+  {
+    if (v_idx >= header.num_vertices)
+      return false;
+  }
+  for (const ModelRecord& record : model_records)
+  {
+    if (!valid_string(record.model_name) ||
+      !valid_string(record.instance_name))
+      return false;
+  }
+
+  auto read_params = [&](
+    const uint32_t first,
+    const uint32_t count,
+    ParamMap& params)
+    {
+      params.clear();
+      for (uint32_t i = first; i < first + count; i++)
+        params[strings[param_records[i].key]] =
+          make_param(param_records[i], strings);
+    };
+
+  meters_per_pixel = header.meters_per_pixel;
+  vertices.reserve(vertex_records.size());
+  for (const VertexRecord& record : vertex_records)
+  {
+    vertices.push_back(Vertex(record.x, record.y, strings[record.name]));
+    read_params(record.first_param, record.num_params, vertices.back().params);
+  }
+
+  edges.reserve(edge_records.size());
+  for (const EdgeRecord& record : edge_records)
+  {
+    edges.push_back(
+      Edge(
+        static_cast<int>(record.start),
+        static_cast<int>(record.end),
+        static_cast<Edge::Type>(record.type)));
+    read_params(record.first_param, record.num_params, edges.back().params);
+  }
+
+  polygons.resize(polygon_records.size());
+  for (std::size_t i = 0; i < polygon_records.size(); i++)
+  {
+    const PolygonRecord& record = polygon_records[i];
+    Polygon& polygon = polygons[i];
+    polygon.type = static_cast<Polygon::Type>(record.type);
+    polygon.vertices.assign(
+      polygon_vertices.begin() + record.first_vertex,
+      polygon_vertices.begin() + record.first_vertex + record.num_vertices);
+    read_params(record.first_param, record.num_params, polygon.params);
+  }
+
+  models.resize(model_records.size());
+  for (std::size_t i = 0; i < model_records.size(); i++)
+  {
+    const ModelRecord& record = model_records[i];
+    Model& model = models[i];
+    model.state.x = record.x;
+    model.state.y = record.y;
+    model.state.z = record.z;
+    model.state.yaw = record.yaw;
+    model.model_name = strings[record.model_name];
+    model.instance_name = strings[record.instance_name];
+    model.is_static = record.is_static != 0;
+  }
+
+  return true;
+}
+
+void SelectionClipboard::copy_to_clipboard() const
+{
+  QMimeData* mime_data = new QMimeData;
+  mime_data->setData(mime_type(), encode());
+  QGuiApplication::clipboard()->setMimeData(mime_data);
+}
+
+bool SelectionClipboard::paste_from_clipboard()
+{
+  *this = SelectionClipboard();
+  const QMimeData* mime_data = QGuiApplication::clipboard()->mimeData();
+  if (!mime_data || !mime_data->hasFormat(mime_type()))
+    return false;
+  return decode(mime_data->data(mime_type()));
+}
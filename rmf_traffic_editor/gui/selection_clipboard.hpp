@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef TRAFFIC_EDITOR__SELECTION_CLIPBOARD_HPP
+#define TRAFFIC_EDITOR__SELECTION_CLIPBOARD_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include <QByteArray>
+#include <QPointF>
+
+#include "edge.h"
+#include "level.h"
+#include "model.h"
+#include "polygon.h"
+#include "vertex.h"
+
+//=============================================================================
+/// A region of a level copied for pasting: vertices, the edges and
+/// polygons among them (renumbered into this vertex list) and models, in
+/// the pixels of the level they were copied from.
+///
+/// On the clipboard it is a compact binary blob, under mime_type(): a
+/// Header, then a VertexRecord for each vertex, EdgeRecords,
+/// PolygonRecords, the uint32 vertex indices of all polygons, ModelRecords,
+/// the ParamRecords of all entities, and a string table (num_strings + 1
+/// uint32 offsets into the NUL-terminated strings which follow, as in the
+/// .navgraph files). Strings and param keys are stored once however many
+/// entities use them. Records are in host byte order; the blob is only
+/// meant to travel between editors on one machine.
+class SelectionClipboard
+{
+public:
+  static const uint32_t MAGIC = 0x50494c43;  // "CLIP" on disk
+  static const uint32_t VERSION = 1;
+
+  struct Header
+  {
+    uint32_t magic;
+    uint32_t version;
+    double meters_per_pixel;  // of the level it was copied from
+    uint32_t num_vertices;
+    uint32_t num_edges;
+    uint32_t num_polygons;
+    uint32_t num_polygon_vertices;
+    uint32_t num_models;
+    uint32_t num_params;
+    uint32_t num_strings;
+    uint32_t reserved;
+  };
+
+  /// The params of each entity are num_params consecutive ParamRecords
+  /// starting at first_param
+  struct VertexRecord
+  {
+    double x;
+    double y;
+    uint32_t name;  // string
+    uint32_t first_param;
+    uint32_t num_params;
+    uint32_t reserved;
+  };
+
+  struct EdgeRecord
+  {
+    uint32_t start;  // into the vertices of the clip
+    uint32_t end;
+    uint32_t type;  // Edge::Type
+    uint32_t first_param;
+    uint32_t num_params;
+  };
+
+  struct PolygonRecord
+  {
+    uint32_t type;  // Polygon::Type
+    uint32_t first_vertex;  // into the polygon vertex indices
+    uint32_t num_vertices;
+    uint32_t first_param;
+    uint32_t num_params;
+  };
+
+  struct ModelRecord
+  {
+    double x;
+    double y;
+    double z;  // meters
+    double yaw;
+    uint32_t model_name;  // string
+    uint32_t instance_name;  // string
+    uint32_t is_static;
+    uint32_t reserved;
+  };
+
+  struct ParamRecord
+  {
+    uint32_t key;  // string
+    uint32_t type;  // Param::Type
+    uint32_t value_string;  // string
+    int32_t value_int;  // of an INT or BOOL
+    double value_double;
+  };
+
+  std::vector<Vertex> vertices;
+  std::vector<Edge> edges;
+  std::vector<Polygon> polygons;
+  std::vector<Model> models;
+  double meters_per_pixel = 1.0;
+
+  static const char* mime_type();
+
+  /// Copy the selected entities of a level, with every vertex which a
+  /// selected edge or polygon needs, and also the edges and polygons whose
+  /// vertices were all copied
+  static SelectionClipboard from_selection(
+    const Level& level,
+    const std::vector<Level::SelectedItem>& items);
+
+  bool empty() const { return vertices.empty() && models.empty(); }
+  std::size_t size() const;
+
+  /// Center of the bounding box of the vertices and models
+  QPointF center() const;
+
+  /// Scale by s about the origin, then move by (dx, dy)
+  void transform(const double s, const double dx, const double dy);
+
+  QByteArray encode() const;
+
+  /// Returns false, leaving this clip empty, if the data isn't a valid
+  /// clip of this version
+  bool decode(const QByteArray& data);
+
+  /// Put this clip on, or take a clip from, the system clipboard
+  void copy_to_clipboard() const;
+  bool paste_from_clipboard();
+};
+
+#endif
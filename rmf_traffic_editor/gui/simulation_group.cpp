@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cstdio>
+
+#include <QElapsedTimer>
+#include <QtConcurrent/QtConcurrent>
+
+#include "simulation_group.hpp"
+#include "trace.hpp"
+
+
+void SimulationGroup::add(
+  const std::string& name,
+  std::unique_ptr<SimulationV2> plugin)
+{
+  if (!plugin)
+    return;
+  Plugin entry;
+  entry.name = name;
+  entry.simulation = std::move(plugin);
+  _plugins.push_back(std::move(entry));
+  _stages_valid = false;
+}
+
+void SimulationGroup::clear()
+{
+  _plugins.clear();
+  _stages.clear();
+  _stages_valid = false;
+}
+
+unsigned int SimulationGroup::capabilities() const
+{
+  unsigned int all = DIRTY_MODEL_BATCHES | HEADLESS;
+  unsigned int any = 0;
+  for (const Plugin& plugin : _plugins)
+  {
+    all &= plugin.simulation->capabilities();
+    any |= plugin.simulation->capabilities();
+  }
+  return (all & (DIRTY_MODEL_BATCHES | HEADLESS)) | (any & SPAWN_DESPAWN);
+}
+
+unsigned int SimulationGroup::reads() const
+{
+  unsigned int resources = 0;
+  for (const Plugin& plugin : _plugins)
+    resources |= plugin.simulation->reads();
+  return resources;
+}
+
+unsigned int SimulationGroup::writes() const
+{
+  unsigned int resources = 0;
+  for (const Plugin& plugin : _plugins)
+    resources |= plugin.simulation->writes();
+  return resources;
+}
+
+void SimulationGroup::load(const YAML::Node& config)
+{
+  for (Plugin& plugin : _plugins)
+  {
+    if (config && config.IsMap() && config[plugin.name])
+      plugin.simulation->load(config[plugin.name]);
+    else
+      plugin.simulation->load(config);
+  }
+}
+
+void SimulationGroup::reset(Building& building)
+{
+  for (Plugin& plugin : _plugins)
+  {
+    plugin.simulation->reset(building);
+    plugin.stats = Stats();
+  }
+}
+
+void SimulationGroup::scene_clear()
+{
+  for (Plugin& plugin : _plugins)
+    plugin.simulation->scene_clear();
+}
+
+bool SimulationGroup::conflict(const SimulationV2& a, const SimulationV2& b)
+{
+  return (a.writes() & (b.reads() | b.writes())) != 0 ||
+    (b.writes() & a.reads()) != 0;
+}
+
+void SimulationGroup::compute_stages()
+{
+  // put each plugin in the stage after the last one holding a plugin it
+  // conflicts with, so conflicting plugins still tick in the order they
+  // were added
+  _stages.clear();
+  std::vector<std::size_t> stage_of(_plugins.size(), 0);
+  for (std::size_t i = 0; i < _plugins.size(); i++)
+  {
+    std::size_t stage = 0;
+    for (std::size_t j = 0; j < i; j++)
+    {
+      if (conflict(*_plugins[i].simulation, *_plugins[j].simulation))
+        stage = std::max(stage, stage_of[j] + 1);
+    }
+    stage_of[i] = stage;
+    if (stage >= _stages.size())
+      _stages.resize(stage + 1);
+    _stages[stage].push_back(i);
+  }
+  _stages_valid = true;
+
+  for (std::size_t i = 0; i < _stages.size(); i++)
+  {
+    printf("simulation stage %d:", static_cast<int>(i));
+    for (const std::size_t plugin_idx : _stages[i])
+      printf(" %s", _plugins[plugin_idx].name.c_str());
+    printf("\n");
+  }
+}
+
+void SimulationGroup::tick(Building& building, SimulationBatch& batch)
+{
+  TRACE_ZONE("SimulationGroup::tick");
+  if (!_stages_valid)
+    compute_stages();
+
+  auto tick_plugin = [&building](Plugin& plugin)
+    {
+      TRACE_ZONE(plugin.name);
+      QElapsedTimer timer;
+      timer.start();
+      plugin.batch.clear();
+      plugin.simulation->tick(building, plugin.batch);
+      const int64_t ns = timer.nsecsElapsed();
+      plugin.stats.ticks++;
+      plugin.stats.last_ns = ns;
+      plugin.stats.total_ns += ns;
+      plugin.stats.max_ns = std::max(plugin.stats.max_ns, ns);
+    };
+
+  std::vector<Plugin*> stage_plugins;
+  for (const std::vector<std::size_t>& stage : _stages)
+  {
+    if (stage.size() == 1)
+    {
+      tick_plugin(_plugins[stage.front()]);
+      continue;
+    }
+    stage_plugins.clear();
+    for (const std::size_t plugin_idx : stage)
+      stage_plugins.push_back(&_plugins[plugin_idx]);
+    // returns once the whole stage is done, which is the barrier between
+    // stages, and at the end between steps
+    QtConcurrent::blockingMap(
+      stage_plugins,
+      [&tick_plugin](Plugin* plugin)
+      {
+        tick_plugin(*plugin);
+      });
+  }
+
+  for (const Plugin& plugin : _plugins)
+  {
+    batch.updates.insert(
+      batch.updates.end(),
+      plugin.batch.updates.begin(),
+      plugin.batch.updates.end());
+    batch.spawned.insert(
+      batch.spawned.end(),
+      plugin.batch.spawned.begin(),
+      plugin.batch.spawned.end());
+    batch.despawned.insert(
+      batch.despawned.end(),
+      plugin.batch.despawned.begin(),
+      plugin.batch.despawned.end());
+  }
+}
+
+void SimulationGroup::print_stats() const
+{
+  for (const Plugin& plugin : _plugins)
+  {
+    printf("%-24s %8d ticks  last %8.3f ms  mean %8.3f ms  max %8.3f ms\n",
+      plugin.name.c_str(),
+      plugin.stats.ticks,
+      plugin.stats.last_ns / 1e6,
+      plugin.stats.mean_ms(),
+      plugin.stats.max_ns / 1e6);
+  }
+}
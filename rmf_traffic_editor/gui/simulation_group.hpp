@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__SIMULATION_GROUP_HPP
+#define TRAFFIC_EDITOR__SIMULATION_GROUP_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <yaml-cpp/yaml.h>
+
+#include "building.h"
+#include "plugins/simulation.h"
+
+//=============================================================================
+/// Several simulation plugins (crowds, robot fleets, doors and lifts...)
+/// stepped together. Each plugin declares which parts of the building it
+/// reads and writes; the plugins are put into stages of mutually
+/// non-conflicting plugins, and the plugins of a stage tick at the same
+/// time on the global thread pool. tick() returns once every plugin has
+/// finished the step, so all of them always see the same step. The group
+/// is itself a plugin, so it can be run wherever a single one can.
+class SimulationGroup : public SimulationV2
+{
+public:
+  struct Stats
+  {
+    int ticks = 0;
+    int64_t last_ns = 0;
+    int64_t max_ns = 0;
+    int64_t total_ns = 0;
+
+    double mean_ms() const
+    {
+      return ticks > 0 ? total_ns / 1e6 / ticks : 0.0;
+    }
+  };
+
+  /// Add a plugin; the stages are worked out again before the next tick
+  void add(const std::string& name, std::unique_ptr<SimulationV2> plugin);
+  void clear();
+
+  std::size_t size() const { return _plugins.size(); }
+  const std::string& name(const std::size_t idx) const
+  {
+    return _plugins[idx].name;
+  }
+  const Stats& stats(const std::size_t idx) const
+  {
+    return _plugins[idx].stats;
+  }
+
+  /// Number of stages per step, after the last tick(); 1 means every
+  /// plugin ran in parallel
+  std::size_t num_stages() const { return _stages.size(); }
+
+  /// What all of the plugins can do, and everything any of them touches
+  unsigned int capabilities() const override;
+  unsigned int reads() const override;
+  unsigned int writes() const override;
+
+  /// Each plugin gets the node under its own name, if there is one,
+  /// otherwise the whole config
+  void load(const YAML::Node& config) override;
+  void reset(Building& building) override;
+  void scene_clear() override;
+
+  /// Step every plugin once. The batches of the plugins are appended to
+  /// this one in the order the plugins were added.
+  void tick(Building& building, SimulationBatch& batch) override;
+
+  /// One line per plugin with its tick times
+  void print_stats() const;
+
+private:
+  struct Plugin
+  {
+    std::string name;
+    std::unique_ptr<SimulationV2> simulation;
+    SimulationBatch batch;
+    Stats stats;
+  };
+
+  std::vector<Plugin> _plugins;
+  std::vector<std::vector<std::size_t>> _stages;  // indices into _plugins
+  bool _stages_valid = false;
+
+  static bool conflict(const SimulationV2& a, const SimulationV2& b);
+  void compute_stages();
+};
+
+#endif
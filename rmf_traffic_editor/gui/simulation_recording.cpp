@@ -0,0 +1,450 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <QtEndian>
+
+#include "building.h"
+#include "simulation_recording.hpp"
+
+namespace {
+
+// bump this whenever the layout of the file changes
+const uint32_t RECORDING_MAGIC = 0x54455231;  // "TER1"
+const uint32_t INDEX_MAGIC = 0x54455249;  // "TERI"
+
+// magic, keyframe interval, time step
+const int HEADER_SIZE = 4 + 4 + 8;
+
+// index offset, number of ticks, index magic
+const int TRAILER_SIZE = 8 + 4 + 4;
+
+void put_u16(QByteArray& buffer, const uint16_t value)
+{
+  const uint16_t le = qToLittleEndian(value);
+  buffer.append(reinterpret_cast<const char*>(&le), sizeof(le));
+}
+
+void put_u32(QByteArray& buffer, const uint32_t value)
+{
+  const uint32_t le = qToLittleEndian(value);
+  buffer.append(reinterpret_cast<const char*>(&le), sizeof(le));
+}
+
+void put_u64(QByteArray& buffer, const uint64_t value)
+{
+  const uint64_t le = qToLittleEndian(value);
+  buffer.append(reinterpret_cast<const char*>(&le), sizeof(le));
+}
+
+void put_float(QByteArray& buffer, const float value)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  put_u32(buffer, bits);
+}
+
+/// Reads little-endian values from a buffer, failing (and then returning
+/// zeros) rather than reading past its end
+class Cursor
+{
+public:
+  Cursor(const char* data, const std::size_t size)
+  : _data(data), _size(size)
+  {
+  }
+
+  bool ok() const { return _ok; }
+
+  template<typename T>
+  T get()
+  {
+    T value = 0;
+    if (!_ok || _pos + sizeof(T) > _size)
+    {
+      _ok = false;
+      return value;
+    }
+    memcpy(&value, _data + _pos, sizeof(T));
+    _pos += sizeof(T);
+    return qFromLittleEndian(value);
+  }
+
+  float get_float()
+  {
+    const uint32_t bits = get<uint32_t>();
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+private:
+  const char* _data;
+  std::size_t _size;
+  std::size_t _pos = 0;
+  bool _ok = true;
+};
+
+}  // namespace
+
+//=============================================================================
+bool SimulationRecording::Writer::open(
+  const std::string& filename,
+  const double time_step,
+  const int keyframe_interval)
+{
+  _file.setFileName(QString::fromStdString(filename));
+  if (!_file.open(QIODevice::WriteOnly))
+  {
+    printf("unable to write %s\n", filename.c_str());
+    return false;
+  }
+  _keyframe_interval = std::max(1, keyframe_interval);
+  _num_ticks = 0;
+  _poses.clear();
+  _chunk.clear();
+  _chunk_num_ticks = 0;
+  _chunk_offsets.clear();
+  _chunk_first_ticks.clear();
+
+  uint64_t time_step_bits;
+  memcpy(&time_step_bits, &time_step, sizeof(time_step_bits));
+  QByteArray header;
+  put_u32(header, RECORDING_MAGIC);
+  put_u32(header, static_cast<uint32_t>(_keyframe_interval));
+  put_u64(header, time_step_bits);
+  _file.write(header);
+  return true;
+}
+
+void SimulationRecording::Writer::record(const Building& building)
+{
+  if (!_file.isOpen())
+    return;
+
+  bool same_models = _poses.size() == building.levels.size();
+  for (std::size_t i = 0; same_models && i < _poses.size(); i++)
+    same_models = _poses[i].size() == building.levels[i].models.size();
+
+  if (!same_models ||
+    _chunk_num_ticks == 0 ||
+    _num_ticks % _keyframe_interval == 0)
+  {
+    flush_chunk();
+    start_chunk(building);
+  }
+  else
+  {
+    // count the updates before writing them, since the count comes first
+    QByteArray updates;
+    uint32_t num_updates = 0;
+    for (std::size_t i = 0; i < building.levels.size(); i++)
+    {
+      const std::vector<Model>& models = building.levels[i].models;
+      for (std::size_t j = 0; j < models.size(); j++)
+      {
+        const ModelState& state = models[j].state;
+        const Pose pose = {
+          static_cast<float>(state.x),
+          static_cast<float>(state.y),
+          static_cast<float>(state.z),
+          static_cast<float>(state.yaw)};
+        Pose& previous = _poses[i][j];
+        if (memcmp(&pose, &previous, sizeof(Pose)) == 0)
+          continue;
+        previous = pose;
+        put_u16(updates, static_cast<uint16_t>(i));
+        put_u16(updates, static_cast<uint16_t>(j));
+        put_float(updates, pose.x);
+        put_float(updates, pose.y);
+        put_float(updates, pose.z);
+        put_float(updates, pose.yaw);
+        num_updates++;
+      }
+    }
+    put_u32(_chunk, num_updates);
+    _chunk.append(updates);
+    _chunk_num_ticks++;
+  }
+  _num_ticks++;
+}
+
+void SimulationRecording::Writer::start_chunk(const Building& building)
+{
+  _chunk_first_tick = static_cast<uint32_t>(_num_ticks);
+  _chunk_num_ticks = 1;
+
+  _poses.resize(building.levels.size());
+  put_u32(_chunk, static_cast<uint32_t>(building.levels.size()));
+  for (std::size_t i = 0; i < building.levels.size(); i++)
+  {
+    const std::vector<Model>& models = building.levels[i].models;
+    _poses[i].resize(models.size());
+    put_u32(_chunk, static_cast<uint32_t>(models.size()));
+    for (std::size_t j = 0; j < models.size(); j++)
+    {
+      const ModelState& state = models[j].state;
+      Pose& pose = _poses[i][j];
+      pose.x = static_cast<float>(state.x);
+      pose.y = static_cast<float>(state.y);
+      pose.z = static_cast<float>(state.z);
+      pose.yaw = static_cast<float>(state.yaw);
+      put_float(_chunk, pose.x);
+      put_float(_chunk, pose.y);
+      put_float(_chunk, pose.z);
+      put_float(_chunk, pose.yaw);
+    }
+  }
+}
+
+void SimulationRecording::Writer::flush_chunk()
+{
+  if (_chunk_num_ticks == 0)
+    return;
+
+  const QByteArray compressed = qCompress(_chunk);
+  _chunk_offsets.push_back(static_cast<uint64_t>(_file.pos()));
+  _chunk_first_ticks.push_back(_chunk_first_tick);
+
+  QByteArray header;
+  put_u32(header, _chunk_first_tick);
+  put_u32(header, _chunk_num_ticks);
+  put_u32(header, static_cast<uint32_t>(compressed.size()));
+  _file.write(header);
+  _file.write(compressed);
+
+  _chunk.clear();
+  _chunk_num_ticks = 0;
+}
+
+bool SimulationRecording::Writer::close()
+{
+  if (!_file.isOpen())
+    return false;
+  flush_chunk();
+
+  const uint64_t index_offset = static_cast<uint64_t>(_file.pos());
+  QByteArray index;
+  put_u32(index, static_cast<uint32_t>(_chunk_offsets.size()));
+  for (std::size_t i = 0; i < _chunk_offsets.size(); i++)
+  {
+    put_u64(index, _chunk_offsets[i]);
+    put_u32(index, _chunk_first_ticks[i]);
+  }
+  put_u64(index, index_offset);
+  put_u32(index, static_cast<uint32_t>(_num_ticks));
+  put_u32(index, INDEX_MAGIC);
+  _file.write(index);
+
+  if (!_file.commit())
+  {
+    printf("unable to write %s\n", qUtf8Printable(_file.fileName()));
+    return false;
+  }
+  printf("recorded %d ticks in %d chunks\n",
+    _num_ticks,
+    static_cast<int>(_chunk_offsets.size()));
+  return true;
+}
+
+//=============================================================================
+void SimulationRecording::clear()
+{
+  _file.close();
+  _time_step = 0.0;
+  _num_ticks = 0;
+  _index.clear();
+  _chunk = Chunk();
+}
+
+bool SimulationRecording::load(const std::string& filename)
+{
+  clear();
+  _file.setFileName(QString::fromStdString(filename));
+  if (!_file.open(QIODevice::ReadOnly) ||
+    _file.size() < HEADER_SIZE + TRAILER_SIZE)
+  {
+    printf("unable to read recording %s\n", filename.c_str());
+    clear();
+    return false;
+  }
+
+  const QByteArray header = _file.read(HEADER_SIZE);
+  Cursor header_cursor(header.constData(), header.size());
+  const uint32_t magic = header_cursor.get<uint32_t>();
+  header_cursor.get<uint32_t>();  // keyframe interval
+  const uint64_t time_step_bits = header_cursor.get<uint64_t>();
+  if (magic != RECORDING_MAGIC)
+  {
+    printf("%s is not a simulation recording\n", filename.c_str());
+    clear();
+    return false;
+  }
+  memcpy(&_time_step, &time_step_bits, sizeof(_time_step));
+
+  _file.seek(_file.size() - TRAILER_SIZE);
+  const QByteArray trailer = _file.read(TRAILER_SIZE);
+  Cursor trailer_cursor(trailer.constData(), trailer.size());
+  const uint64_t index_offset = trailer_cursor.get<uint64_t>();
+  _num_ticks = trailer_cursor.get<uint32_t>();
+  if (trailer_cursor.get<uint32_t>() != INDEX_MAGIC ||
+    index_offset >= static_cast<uint64_t>(_file.size()))
+  {
+    printf("recording %s is incomplete\n", filename.c_str());
+    clear();
+    return false;
+  }
+
+  _file.seek(static_cast<qint64>(index_offset));
+  const QByteArray index =
+    _file.read(_file.size() - TRAILER_SIZE - index_offset);
+  Cursor cursor(index.constData(), index.size());
+  const uint32_t num_chunks = cursor.get<uint32_t>();
+  for (uint32_t i = 0; i < num_chunks && cursor.ok(); i++)
+  {
+    ChunkInfo info;
+    info.offset = cursor.get<uint64_t>();
+    info.first_tick = cursor.get<uint32_t>();
+    _index.push_back(info);
+  }
+  if (!cursor.ok())
+  {
+    printf("recording %s has a corrupt index\n", filename.c_str());
+    clear();
+    return false;
+  }
+  return true;
+}
+
+int SimulationRecording::chunk_of(const int tick) const
+{
+  // the last chunk starting at or before the tick
+  auto it = std::upper_bound(
+    _index.begin(),
+    _index.end(),
+    static_cast<uint32_t>(tick),
+    [](const uint32_t t, const ChunkInfo& info)
+    {
+      return t < info.first_tick;
+    });
+  return static_cast<int>(it - _index.begin()) - 1;
+}
+
+bool SimulationRecording::decode_chunk(const int chunk_idx)
+{
+  if (_chunk.idx == chunk_idx)
+    return true;
+  _chunk = Chunk();
+
+  _file.seek(static_cast<qint64>(_index[chunk_idx].offset));
+  const QByteArray header = _file.read(12);
+  Cursor header_cursor(header.constData(), header.size());
+  const uint32_t first_tick = header_cursor.get<uint32_t>();
+  const uint32_t num_ticks = header_cursor.get<uint32_t>();
+  const uint32_t compressed_size = header_cursor.get<uint32_t>();
+  if (!header_cursor.ok() || num_ticks == 0)
+    return false;
+
+  const QByteArray data = qUncompress(_file.read(compressed_size));
+  Cursor cursor(data.constData(), data.size());
+
+  const uint32_t num_levels = cursor.get<uint32_t>();
+  for (uint32_t i = 0; i < num_levels && cursor.ok(); i++)
+  {
+    std::vector<Pose> poses(cursor.get<uint32_t>());
+    for (Pose& pose : poses)
+    {
+      pose.x = cursor.get_float();
+      pose.y = cursor.get_float();
+      pose.z = cursor.get_float();
+      pose.yaw = cursor.get_float();
+    }
+    _chunk.keyframe.push_back(std::move(poses));
+  }
+
+  _chunk.ticks.resize(num_ticks - 1);
+  for (std::vector<Update>& updates : _chunk.ticks)
+  {
+    updates.resize(cursor.get<uint32_t>());
+    for (Update& update : updates)
+    {
+      update.level_idx = cursor.get<uint16_t>();
+      update.model_idx = cursor.get<uint16_t>();
+      update.pose.x = cursor.get_float();
+      update.pose.y = cursor.get_float();
+      update.pose.z = cursor.get_float();
+      update.pose.yaw = cursor.get_float();
+    }
+  }
+
+  if (!cursor.ok())
+  {
+    printf("chunk %d of the recording is corrupt\n", chunk_idx);
+    _chunk = Chunk();
+    return false;
+  }
+  _chunk.idx = chunk_idx;
+  _chunk.first_tick = first_tick;
+  return true;
+}
+
+bool SimulationRecording::seek(const int tick, Building& building)
+{
+  if (tick < 0 || tick >= num_ticks())
+    return false;
+  const int chunk_idx = chunk_of(tick);
+  if (chunk_idx < 0 || !decode_chunk(chunk_idx))
+    return false;
+
+  std::vector<std::vector<Pose>> poses = _chunk.keyframe;
+  if (poses.size() != building.levels.size())
+    return false;
+  for (std::size_t i = 0; i < poses.size(); i++)
+  {
+    if (poses[i].size() != building.levels[i].models.size())
+      return false;
+  }
+
+  const int num_deltas = std::min(
+    tick - static_cast<int>(_chunk.first_tick),
+    static_cast<int>(_chunk.ticks.size()));
+  for (int t = 0; t < num_deltas; t++)
+  {
+    for (const Update& update : _chunk.ticks[t])
+    {
+      if (update.level_idx < poses.size() &&
+        update.model_idx < poses[update.level_idx].size())
+        poses[update.level_idx][update.model_idx] = update.pose;
+    }
+  }
+
+  for (std::size_t i = 0; i < poses.size(); i++)
+  {
+    std::vector<Model>& models = building.levels[i].models;
+    for (std::size_t j = 0; j < models.size(); j++)
+    {
+      models[j].state.x = poses[i][j].x;
+      models[j].state.y = poses[i][j].y;
+      models[j].state.z = poses[i][j].z;
+      models[j].state.yaw = poses[i][j].yaw;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__SIMULATION_RECORDING_HPP
+#define TRAFFIC_EDITOR__SIMULATION_RECORDING_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <QByteArray>
+#include <QFile>
+#include <QSaveFile>
+
+class Building;
+
+//=============================================================================
+/// A recording of the model poses of a simulation run, one entry per tick.
+/// The file is a sequence of compressed chunks, each starting with a
+/// keyframe that holds the pose of every model of every level, followed by
+/// the poses of only the models which moved in each later tick. An index
+/// of the chunks at the end of the file lets seek() jump to any tick by
+/// decoding a single chunk.
+class SimulationRecording
+{
+  struct Pose
+  {
+    float x, y, z, yaw;
+  };
+
+public:
+  /// Writes a recording tick by tick while the simulation runs
+  class Writer
+  {
+  public:
+    /// A keyframe is written every keyframe_interval ticks, and whenever
+    /// the number of models changes
+    bool open(
+      const std::string& filename,
+      const double time_step,
+      const int keyframe_interval = 100);
+
+    /// Append the current poses of all models as the next tick
+    void record(const Building& building);
+
+    /// Write the last chunk and the index. The file only appears once
+    /// this succeeds.
+    bool close();
+
+    bool is_open() const { return _file.isOpen(); }
+    int num_ticks() const { return _num_ticks; }
+
+  private:
+    QSaveFile _file;
+    int _keyframe_interval = 100;
+    int _num_ticks = 0;
+
+    std::vector<std::vector<Pose>> _poses;  // as of the latest tick
+    QByteArray _chunk;
+    uint32_t _chunk_first_tick = 0;
+    uint32_t _chunk_num_ticks = 0;
+    std::vector<uint64_t> _chunk_offsets;
+    std::vector<uint32_t> _chunk_first_ticks;
+
+    void start_chunk(const Building& building);
+    void flush_chunk();
+  };
+
+  /// Read the header and chunk index of a recording
+  bool load(const std::string& filename);
+  void clear();
+
+  bool is_loaded() const { return _file.isOpen(); }
+  int num_ticks() const { return static_cast<int>(_num_ticks); }
+  double time_step() const { return _time_step; }
+
+  /// Put every model of the building in its pose at this tick. Returns
+  /// false if the tick is out of range, or the building doesn't have the
+  /// number of models which was recorded at that point; models are only
+  /// matched by level and index.
+  bool seek(const int tick, Building& building);
+
+private:
+  struct Update
+  {
+    uint16_t level_idx;
+    uint16_t model_idx;
+    Pose pose;
+  };
+
+  struct ChunkInfo
+  {
+    uint64_t offset;
+    uint32_t first_tick;
+  };
+
+  /// A chunk, decoded
+  struct Chunk
+  {
+    int idx = -1;
+    uint32_t first_tick = 0;
+    std::vector<std::vector<Pose>> keyframe;
+    std::vector<std::vector<Update>> ticks;  // the ticks after the keyframe
+  };
+
+  QFile _file;
+  double _time_step = 0.0;
+  uint32_t _num_ticks = 0;
+  std::vector<ChunkInfo> _index;
+  Chunk _chunk;  // the one most recently decoded, for sequential playback
+
+  int chunk_of(const int tick) const;
+  bool decode_chunk(const int chunk_idx);
+};
+
+#endif
@@ -0,0 +1,303 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include <algorithm>
+#include <cmath>
+
+#include "spatial_grid.hpp"
+
+namespace {
+
+/// The coordinates of ids which were never set, far from any query, so
+/// that the scans need no branch to skip them
+constexpr double UNSET = 1e150;
+
+}  // anonymous namespace
+
+SpatialGrid::SpatialGrid(const double cell_size)
+: _cell_size(cell_size)
+{
+}
+
+void SpatialGrid::clear(const double cell_size)
+{
+  _cell_size = cell_size > 0.0 ? cell_size : 1.0;
+  _num_points = 0;
+  _xs.clear();
+  _ys.clear();
+  _keys.clear();
+  _valid.clear();
+  _cells.clear();
+  _min_cx = 0;
+  _max_cx = -1;
+  _min_cy = 0;
+  _max_cy = -1;
+}
+
+int SpatialGrid::cell_coord(const double v) const
+{
+  return static_cast<int>(std::floor(v / _cell_size));
+}
+
+int64_t SpatialGrid::cell_key(const int cx, const int cy)
+{
+  return (static_cast<int64_t>(cx) << 32) ^
+    static_cast<int64_t>(static_cast<uint32_t>(cy));
+}
+
+void SpatialGrid::remove_from_cell(const int id, const int64_t key)
+{
+  auto cell_it = _cells.find(key);
+  if (cell_it == _cells.end())
+    return;
+  std::vector<int>& ids = cell_it->second;
+  ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+  if (ids.empty())
+    _cells.erase(cell_it);
+}
+
+void SpatialGrid::set(const int id, const double x, const double y)
+{
+  if (id < 0)
+    return;
+  if (static_cast<std::size_t>(id) >= _xs.size())
+  {
+    _xs.resize(id + 1, UNSET);
+    _ys.resize(id + 1, UNSET);
+    _keys.resize(id + 1, 0);
+    _valid.resize(id + 1, 0);
+  }
+
+  const int cx = cell_coord(x);
+  const int cy = cell_coord(y);
+  const int64_t key = cell_key(cx, cy);
+
+  const bool valid = _valid[id] != 0;
+  if (valid && _keys[id] != key)
+    remove_from_cell(id, _keys[id]);
+  if (!valid || _keys[id] != key)
+    _cells[key].push_back(id);
+  if (!valid)
+    _num_points++;
+
+  _xs[id] = x;
+  _ys[id] = y;
+  _keys[id] = key;
+  _valid[id] = 1;
+
+  if (_min_cx > _max_cx)
+  {
+    _min_cx = _max_cx = cx;
+    _min_cy = _max_cy = cy;
+  }
+  else
+  {
+    _min_cx = std::min(_min_cx, cx);
+    _max_cx = std::max(_max_cx, cx);
+    _min_cy = std::min(_min_cy, cy);
+    _max_cy = std::max(_max_cy, cy);
+  }
+}
+
+int SpatialGrid::nearest(
+  const double x,
+  const double y,
+  double& distance) const
+{
+  distance = 1e100;
+  if (_num_points == 0)
+    return -1;
+
+  const int cx = cell_coord(x);
+  const int cy = cell_coord(y);
+
+  // rings closer than this lie entirely outside the occupied cells
+  const int r_start = std::max(
+    {0, _min_cx - cx, cx - _max_cx, _min_cy - cy, cy - _max_cy});
+
+  // past this many cell lookups, brute force is cheaper (sparse grid)
+  const std::size_t max_lookups = std::max<std::size_t>(64, _num_points);
+  std::size_t num_lookups = 0;
+
+  double min_dist2 = 1e100;
+  int min_id = -1;
+
+  auto visit = [&](const int ix, const int iy)
+    {
+      num_lookups++;
+      const auto cell_it = _cells.find(cell_key(ix, iy));
+      if (cell_it == _cells.end())
+        return;
+      for (const int id : cell_it->second)
+      {
+        const double dx = x - _xs[id];
+        const double dy = y - _ys[id];
+        const double dist2 = dx*dx + dy*dy;
+        if (dist2 < min_dist2)
+        {
+          min_dist2 = dist2;
+          min_id = id;
+        }
+      }
+    };
+
+  for (int r = r_start; ; r++)
+  {
+    // visit the ring of cells at Chebyshev distance r, clipped to the
+    // occupied bounds
+    const int x0 = std::max(cx - r, _min_cx);
+    const int x1 = std::min(cx + r, _max_cx);
+    const int y0 = std::max(cy - r, _min_cy);
+    const int y1 = std::min(cy + r, _max_cy);
+
+    if (cy - r >= _min_cy)
+      for (int ix = x0; ix <= x1; ix++)
+        visit(ix, cy - r);
+    if (r > 0 && cy + r <= _max_cy)
+      for (int ix = x0; ix <= x1; ix++)
+        visit(ix, cy + r);
+    if (cx - r >= _min_cx)
+      for (int iy = std::max(y0, cy - r + 1); iy <= std::min(y1, cy + r - 1);
+        iy++)
+        visit(cx - r, iy);
+    if (r > 0 && cx + r <= _max_cx)
+      for (int iy = std::max(y0, cy - r + 1); iy <= std::min(y1, cy + r - 1);
+        iy++)
+        visit(cx + r, iy);
+
+    // anything in a farther ring is at least r cells away
+    const double ring_dist = r * _cell_size;
+    if (min_id >= 0 && min_dist2 <= ring_dist * ring_dist)
+      break;
+
+    if (cx - r <= _min_cx && cx + r >= _max_cx &&
+      cy - r <= _min_cy && cy + r >= _max_cy)
+      break;  // every occupied cell has been visited
+
+    if (num_lookups > max_lookups)
+      return nearest_linear(x, y, distance);
+  }
+
+  distance = std::sqrt(min_dist2);
+  return min_id;
+}
+
+int SpatialGrid::nearest_linear(
+  const double x,
+  const double y,
+  double& distance) const
+{
+  // unset ids are UNSET, so they're never the nearest
+  const double* xs = _xs.data();
+  const double* ys = _ys.data();
+  const std::size_t n = _xs.size();
+  double min_dist2 = 1e100;
+  std::size_t min_i = n;
+  for (std::size_t i = 0; i < n; i++)
+  {
+    const double dx = x - xs[i];
+    const double dy = y - ys[i];
+    const double dist2 = dx*dx + dy*dy;
+    if (dist2 < min_dist2)
+    {
+      min_dist2 = dist2;
+      min_i = i;
+    }
+  }
+  distance = std::sqrt(min_dist2);
+  return min_i < n ? static_cast<int>(min_i) : -1;
+}
+
+bool SpatialGrid::bounds(
+  double& x_min,
+  double& y_min,
+  double& x_max,
+  double& y_max) const
+{
+  if (_num_points == 0)
+    return false;
+
+  // min and max pass over the arrays, with the unset ids masked out of
+  // the max (they are already too big to be the min)
+  const double* xs = _xs.data();
+  const double* ys = _ys.data();
+  const unsigned char* valid = _valid.data();
+  const std::size_t n = _xs.size();
+  double x0 = UNSET, y0 = UNSET, x1 = -UNSET, y1 = -UNSET;
+  for (std::size_t i = 0; i < n; i++)
+  {
+    x0 = std::min(x0, xs[i]);
+    y0 = std::min(y0, ys[i]);
+    x1 = std::max(x1, valid[i] ? xs[i] : -UNSET);
+    y1 = std::max(y1, valid[i] ? ys[i] : -UNSET);
+  }
+  x_min = x0;
+  y_min = y0;
+  x_max = x1;
+  y_max = y1;
+  return true;
+}
+
+void SpatialGrid::within(
+  const double x_min,
+  const double y_min,
+  const double x_max,
+  const double y_max,
+  std::vector<int>& ids) const
+{
+  if (_num_points == 0 || x_max < x_min || y_max < y_min)
+    return;
+
+  const int cx0 = std::max(cell_coord(x_min), _min_cx);
+  const int cx1 = std::min(cell_coord(x_max), _max_cx);
+  const int cy0 = std::max(cell_coord(y_min), _min_cy);
+  const int cy1 = std::min(cell_coord(y_max), _max_cy);
+  if (cx1 < cx0 || cy1 < cy0)
+    return;
+
+  auto add_if_inside = [&](const int id)
+    {
+      const double px = _xs[id];
+      const double py = _ys[id];
+      if (px >= x_min && px <= x_max && py >= y_min && py <= y_max)
+        ids.push_back(id);
+    };
+
+  // a box much bigger than the occupied cells is cheaper to scan linearly
+  const double num_cells =
+    static_cast<double>(cx1 - cx0 + 1) * static_cast<double>(cy1 - cy0 + 1);
+  if (num_cells > static_cast<double>(_num_points))
+  {
+    // unset ids are far outside any box
+    for (std::size_t i = 0; i < _xs.size(); i++)
+      add_if_inside(static_cast<int>(i));
+    return;
+  }
+
+  for (int cx = cx0; cx <= cx1; cx++)
+  {
+    for (int cy = cy0; cy <= cy1; cy++)
+    {
+      const auto cell_it = _cells.find(cell_key(cx, cy));
+      if (cell_it == _cells.end())
+        continue;
+      for (const int id : cell_it->second)
+        add_if_inside(id);
+    }
+  }
+}
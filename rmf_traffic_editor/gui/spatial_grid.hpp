@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef TRAFFIC_EDITOR__SPATIAL_GRID_HPP
+#define TRAFFIC_EDITOR__SPATIAL_GRID_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+//=============================================================================
+/// Uniform grid of points, bucketed by cell, for nearest-point picking.
+/// Points are identified by small dense integer ids (typically the index
+/// of the entity in its vector), and can be moved individually by calling
+/// set() again with the same id.
+///
+/// The coordinates are kept as a structure of arrays, apart from the
+/// entities they mirror, so that the linear scans (and bounds()) stream
+/// through two dense arrays of doubles, which the compiler can vectorize.
+class SpatialGrid
+{
+public:
+  explicit SpatialGrid(const double cell_size = 1.0);
+
+  /// Remove all points; the cell size only changes between uses
+  void clear(const double cell_size);
+
+  /// Insert the point with this id, or move it if it is already present
+  void set(const int id, const double x, const double y);
+
+  /// Number of ids that have been set since the last clear()
+  std::size_t size() const { return _num_points; }
+
+  /// Id of the point closest to (x, y), or -1 if the grid is empty
+  int nearest(const double x, const double y, double& distance) const;
+
+  /// Bounding box of all the points; false if there are none
+  bool bounds(
+    double& x_min,
+    double& y_min,
+    double& x_max,
+    double& y_max) const;
+
+  /// Append the ids of all points inside the (closed) box
+  void within(
+    const double x_min,
+    const double y_min,
+    const double x_max,
+    const double y_max,
+    std::vector<int>& ids) const;
+
+private:
+  double _cell_size;
+  std::size_t _num_points = 0;
+  std::vector<double> _xs;
+  std::vector<double> _ys;
+  std::vector<int64_t> _keys;
+  std::vector<unsigned char> _valid;
+  std::unordered_map<int64_t, std::vector<int>> _cells;
+
+  // bounds of every cell that has ever been occupied since clear()
+  int _min_cx = 0;
+  int _max_cx = -1;
+  int _min_cy = 0;
+  int _max_cy = -1;
+
+  int cell_coord(const double v) const;
+  static int64_t cell_key(const int cx, const int cy);
+  void remove_from_cell(const int id, const int64_t key);
+
+  int nearest_linear(const double x, const double y, double& distance) const;
+};
+
+#endif
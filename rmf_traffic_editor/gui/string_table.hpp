@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef TRAFFIC_EDITOR__STRING_TABLE_HPP
+#define TRAFFIC_EDITOR__STRING_TABLE_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <QByteArray>
+
+//=============================================================================
+/// The strings of one binary file or blob, each stored once. It is written
+/// as size() + 1 uint32 offsets (from the start of the table) into the
+/// NUL-terminated UTF-8 strings which follow. String 0 is the empty
+/// string, so a reference of 0 means none.
+class StringTable
+{
+public:
+  StringTable() { add(std::string()); }
+
+  uint32_t add(const std::string& s)
+  {
+    auto it = _indices.find(s);
+    if (it != _indices.end())
+      return it->second;
+    const uint32_t idx = static_cast<uint32_t>(_strings.size());
+    _strings.push_back(s);
+    _indices[s] = idx;
+    return idx;
+  }
+
+  uint32_t size() const { return static_cast<uint32_t>(_strings.size()); }
+
+  void append_to(QByteArray& data) const
+  {
+    uint32_t offset = (size() + 1) * sizeof(uint32_t);
+    for (const std::string& s : _strings)
+    {
+      data.append(reinterpret_cast<const char*>(&offset), sizeof(offset));
+      offset += static_cast<uint32_t>(s.size() + 1);
+    }
+    data.append(reinterpret_cast<const char*>(&offset), sizeof(offset));
+    for (const std::string& s : _strings)
+      data.append(s.c_str(), static_cast<int>(s.size() + 1));
+  }
+
+  /// Read back a table of count strings which append_to() wrote at data.
+  /// Returns false if it runs past size or its offsets are inconsistent.
+  static bool parse(
+    const char* data,
+    const std::size_t size,
+    const uint32_t count,
+    std::vector<std::string>& strings)
+  {
+    strings.clear();
+    const uint64_t table_size = (uint64_t(count) + 1) * sizeof(uint32_t);
+    if (count == 0 || table_size > size)
+      return false;
+    std::vector<uint32_t> offsets(count + 1);
+    std::memcpy(offsets.data(), data, table_size);
+    if (offsets[0] != table_size || offsets[count] > size)
+      return false;
+    strings.reserve(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+      if (offsets[i + 1] <= offsets[i] || data[offsets[i + 1] - 1] != '\0')
+      {
+        strings.clear();
+        return false;
+      }
+      strings.emplace_back(data + offsets[i], offsets[i + 1] - offsets[i] - 1);
+    }
+    return true;
+  }
+
+private:
+  std::vector<std::string> _strings;
+  std::map<std::string, uint32_t> _indices;
+};
+
+#endif
@@ -53,3 +53,74 @@ TableList::TableList(const int num_cols)
 TableList::~TableList()
 {
 }
+
+QTableWidgetItem* TableList::set_cell_text(
+  const int row,
+  const int column,
+  const QString& text)
+{
+  QTableWidgetItem* cell = item(row, column);
+  if (cell == nullptr)
+  {
+    cell = new QTableWidgetItem(text);
+    setItem(row, column, cell);
+  }
+  else if (cell->text() != text)
+    cell->setText(text);
+  return cell;
+}
+
+void TableList::set_item_background(
+  QTableWidgetItem* item,
+  const QBrush& brush)
+{
+  if (item->background() != brush)
+    item->setBackground(brush);
+}
+
+QPushButton* TableList::cell_button(
+  const int row,
+  const int column,
+  const QString& label,
+  bool& created)
+{
+  QPushButton* button = qobject_cast<QPushButton*>(cellWidget(row, column));
+  created = button == nullptr || button->text() != label;
+  if (created)
+  {
+    button = new QPushButton(label, this);
+    setCellWidget(row, column, button);  // deletes what was there
+  }
+  return button;
+}
+
+QCheckBox* TableList::cell_check_box(
+  const int row,
+  const int column,
+  bool& created)
+{
+  QCheckBox* check_box = qobject_cast<QCheckBox*>(cellWidget(row, column));
+  created = check_box == nullptr;
+  if (created)
+  {
+    check_box = new QCheckBox;
+    setCellWidget(row, column, check_box);
+  }
+  return check_box;
+}
+
+void TableList::clear_cell_widget(const int row, const int column)
+{
+  if (cellWidget(row, column) != nullptr)
+    removeCellWidget(row, column);
+}
+
+int TableList::row_of(const QWidget* widget, const int column) const
+{
+  for (int i = 0; i < rowCount(); i++)
+  {
+    if (cellWidget(i, column) == widget)
+      return i;
+  }
+  return -1;
+}
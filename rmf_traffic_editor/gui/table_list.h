@@ -20,6 +20,14 @@
 
 #include <QTableWidget>
 
+class QCheckBox;
+class QPushButton;
+
+/// Base of the small tables in the side panel. Their update() functions
+/// are called whenever anything might have changed, so they keep the
+/// items and cell widgets they already have, changing only what differs,
+/// and connect each button once, when it is created; the buttons look up
+/// their row when clicked.
 class TableList : public QTableWidget
 {
   Q_OBJECT
@@ -30,6 +38,33 @@ public:
 
 signals:
   void redraw();
+
+protected:
+  /// Set the text of a cell if it changed, creating its item if needed
+  QTableWidgetItem* set_cell_text(
+    const int row,
+    const int column,
+    const QString& text);
+
+  /// Set the background of an item if it changed
+  static void set_item_background(QTableWidgetItem* item, const QBrush& brush);
+
+  /// The button with this label in a cell, which is created (replacing
+  /// any other widget there) if the cell doesn't have it yet. `created`
+  /// says whether it was, so that it can be connected.
+  QPushButton* cell_button(
+    const int row,
+    const int column,
+    const QString& label,
+    bool& created);
+
+  QCheckBox* cell_check_box(const int row, const int column, bool& created);
+
+  /// Remove the widget of a cell, if it has one
+  void clear_cell_widget(const int row, const int column);
+
+  /// The row whose cell in this column holds the widget, or -1
+  int row_of(const QWidget* widget, const int column) const;
 };
 
 #endif
@@ -2,21 +2,14 @@
 
 #include <QGraphicsScene>
 #include <QGraphicsSimpleTextItem>
-#include <QIcon>
 
+#include "icon_cache.hpp"
+#include "logging.hpp"
 #include "tag.h"
 using std::string;
 using std::vector;
 using std::pair;
 
-const vector<pair<string, Param::Type>> Tag::allowed_params
-{
-  { "is_april_tag", Param::Type::BOOL },
-  { "is_signage", Param::Type::BOOL},
-  { "human_goal_set_name", Param::Type::STRING },
-};
-
-
 Tag::Tag()
 : x(0), y(0), selected(false)
 {
@@ -75,12 +68,15 @@ YAML::Node Tag::to_yaml() const
   return tag_node;
 }
 
-void Tag::draw(
+QList<QGraphicsItem*> Tag::draw(
   QGraphicsScene* scene,
   const double radius,
   const QFont& font,
-  const CoordinateSystem& coordinate_system) const
+  const CoordinateSystem& coordinate_system,
+  const LevelOfDetail::Tier lod_tier) const
 {
+  QList<QGraphicsItem*> items;
+
   QPen vertex_pen(Qt::black);
   vertex_pen.setWidthF(radius / 2.0);
 
@@ -103,6 +99,7 @@ void Tag::draw(
     vertex_pen,
     vertex_brush);
   ellipse_item->setZValue(20.0);  // above all lane/wall edges
+  items.append(ellipse_item);
 
   // add some icons depending on the superpowers of this vertex
   QPen annotation_pen(Qt::black);
@@ -113,8 +110,7 @@ void Tag::draw(
   if (is_april_tag())
   {
     const double icon_bearing = -135.0 * M_PI / 180.0;
-    QIcon icon(":icons/aprialtag.svg");
-    QPixmap pixmap(icon.pixmap(icon.actualSize(QSize(128, 128))));
+    const QPixmap pixmap = IconCache::pixmap(":icons/aprialtag.svg");
     QGraphicsPixmapItem* pixmap_item = scene->addPixmap(pixmap);
     pixmap_item->setOffset(
       -pixmap.width() / 2,
@@ -127,13 +123,14 @@ void Tag::draw(
     if (!coordinate_system.is_y_flipped())
       pixmap_item->setTransform(pixmap_item->transform().scale(1, -1));
     pixmap_item->setToolTip("This tag is a april tag");
+    LevelOfDetail::tag(pixmap_item, LevelOfDetail::FINE, lod_tier);
+    items.append(pixmap_item);
   }
 
   if (is_signage())
   {
     const double icon_bearing = -135.0 * M_PI / 180.0;
-    QIcon icon(":icons/signage.svg");
-    QPixmap pixmap(icon.pixmap(icon.actualSize(QSize(128, 128))));
+    const QPixmap pixmap = IconCache::pixmap(":icons/signage.svg");
     QGraphicsPixmapItem* pixmap_item = scene->addPixmap(pixmap);
     pixmap_item->setOffset(
       -pixmap.width() / 2,
@@ -146,6 +143,8 @@ void Tag::draw(
     if (!coordinate_system.is_y_flipped())
       pixmap_item->setTransform(pixmap_item->transform().scale(1, -1));
     pixmap_item->setToolTip("This tag is a signage");
+    LevelOfDetail::tag(pixmap_item, LevelOfDetail::FINE, lod_tier);
+    items.append(pixmap_item);
   }
 
   if (!name.empty())
@@ -154,6 +153,8 @@ void Tag::draw(
       QString::fromStdString(name),
       font);
     text_item->setBrush(selected ? selected_color : vertex_color);
+    LevelOfDetail::tag(text_item, LevelOfDetail::FINE, lod_tier);
+    items.append(text_item);
 
     if (coordinate_system.is_y_flipped())
     {
@@ -168,6 +169,8 @@ void Tag::draw(
       text_item->setPos(x, y + 1 + radius);
     }
   }
+
+  return items;
 }
 
 void Tag::set_param(const std::string& param_name, const std::string& value)
@@ -175,7 +178,8 @@ void Tag::set_param(const std::string& param_name, const std::string& value)
   auto it = params.find(param_name);
   if (it == params.end())
   {
-    printf("tried to set unknown parameter [%s]\n", param_name.c_str());
+    qCWarning(lc_edit,
+      "tried to set unknown parameter [%s]", param_name.c_str());
     return;  // unknown parameter
   }
   it->second.set(value);
@@ -8,10 +8,13 @@
 #include <yaml-cpp/yaml.h>
 
 #include <QColor>
+#include <QList>
 
 #include "coordinate_system.h"
+#include "level_of_detail.hpp"
 #include "param.h"
 
+class QGraphicsItem;
 class QGraphicsScene;
 
 
@@ -25,7 +28,7 @@ public:
   bool selected;
 
   QUuid uuid;
-  std::map<std::string, Param> params;
+  ParamMap params;
 
   Tag();
   Tag(double _x, double _y, const std::string& _name = std::string());
@@ -35,17 +38,15 @@ public:
 
   void set_param(const std::string& name, const std::string& value);
 
-  void draw(
+  QList<QGraphicsItem*> draw(
     QGraphicsScene* scene,
     const double radius,
     const QFont& font,
-    const CoordinateSystem& coordinate_system) const;
+    const CoordinateSystem& coordinate_system,
+    const LevelOfDetail::Tier lod_tier = LevelOfDetail::FINE) const;
 
   bool is_april_tag() const;
   bool is_signage() const;
-
-  ////////////////////////////////////////////////////////////
-  static const std::vector<std::pair<std::string, Param::Type>> allowed_params;
 };
 
 #endif // TAG_H
@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <algorithm>
+#include <condition_variable>
+
+#include <QRunnable>
+#include <QThread>
+
+#include "task_pool.hpp"
+
+
+namespace {
+
+/// What the threads of one parallel_for() share. The helpers keep it
+/// alive, as some may only be started after the call has returned;
+/// those see it is over and touch neither the function nor the progress.
+struct ParallelFor
+{
+  int count = 0;
+  int chunk = 1;
+  const std::function<void(int)>* f = nullptr;
+  TaskProgress* progress = nullptr;
+
+  std::atomic<int> next {0};
+  std::mutex mutex;
+  std::condition_variable idle;
+  int busy = 0;  // helpers which may still call f
+  bool over = false;
+
+  void work()
+  {
+    while (!progress || !progress->canceled())
+    {
+      const int begin = next.fetch_add(chunk);
+      if (begin >= count)
+        break;
+      const int end = std::min(begin + chunk, count);
+      for (int i = begin; i < end; i++)
+      {
+        if (progress && progress->canceled())
+          return;
+        (*f)(i);
+      }
+      if (progress)
+        progress->advance(end - begin);
+    }
+  }
+};
+
+class ParallelForHelper : public QRunnable
+{
+public:
+  ParallelForHelper(
+    const std::shared_ptr<ParallelFor>& shared,
+    const bool background)
+  : _shared(shared), _background(background)
+  {
+    setAutoDelete(true);
+  }
+
+  void run() override
+  {
+    if (_background)
+      TaskPool::enter_background();
+    {
+      // counted before claiming anything, so that the caller can't see
+      // the indices all claimed and return while this is still in f
+      std::lock_guard<std::mutex> lock(_shared->mutex);
+      if (_shared->over)
+        return;
+      _shared->busy++;
+    }
+    _shared->work();
+    std::lock_guard<std::mutex> lock(_shared->mutex);
+    _shared->busy--;
+    _shared->idle.notify_all();
+  }
+
+private:
+  std::shared_ptr<ParallelFor> _shared;
+  bool _background;
+};
+
+thread_local bool t_background = false;
+
+}  // namespace
+
+TaskPool& TaskPool::instance()
+{
+  static TaskPool task_pool;
+  return task_pool;
+}
+
+TaskPool::TaskPool()
+{
+  _background.setMaxThreadCount(
+    std::max(1, QThread::idealThreadCount() / 2));
+}
+
+void TaskPool::set_worker_threads(const int threads)
+{
+  const int count = threads > 0 ? threads : QThread::idealThreadCount();
+  QThreadPool::globalInstance()->setMaxThreadCount(count);
+  _background.setMaxThreadCount(std::max(1, count / 2));
+}
+
+QThreadPool* TaskPool::pool(Priority priority)
+{
+  if (priority == INHERIT)
+    priority = in_background() ? BACKGROUND : INTERACTIVE;
+  if (priority == BACKGROUND)
+    return &_background;
+  return QThreadPool::globalInstance();
+}
+
+void TaskPool::enter_background()
+{
+  if (t_background)
+    return;
+  t_background = true;
+  QThread::currentThread()->setPriority(QThread::LowPriority);
+}
+
+bool TaskPool::in_background()
+{
+  return t_background;
+}
+
+bool TaskPool::parallel_for(
+  const int count,
+  const std::function<void(int)>& f,
+  const Priority priority,
+  TaskProgress* progress)
+{
+  if (count <= 0)
+    return !progress || !progress->canceled();
+
+  QThreadPool* threads = pool(priority);
+  const int num_threads = std::max(1, threads->maxThreadCount());
+
+  auto shared = std::make_shared<ParallelFor>();
+  shared->count = count;
+  shared->f = &f;
+  shared->progress = progress;
+  // a few chunks per thread, so that a slow one can be made up for
+  shared->chunk = std::max(1, count / (num_threads * 4));
+
+  const int num_chunks = (count + shared->chunk - 1) / shared->chunk;
+  const int num_helpers = std::min(num_threads, num_chunks) - 1;
+  for (int i = 0; i < num_helpers; i++)
+  {
+    // QThreadPool runs the queued runnables of higher priority first
+    threads->start(
+      new ParallelForHelper(shared, threads == &_background),
+      threads == &_background ? BACKGROUND : INTERACTIVE);
+  }
+
+  shared->work();
+
+  std::unique_lock<std::mutex> lock(shared->mutex);
+  shared->idle.wait(lock, [&shared]() { return shared->busy == 0; });
+  shared->over = true;
+  return !progress || !progress->canceled();
+}
+
+std::shared_ptr<TaskProgress> TaskPool::track(
+  const QString& name,
+  const int total)
+{
+  auto progress = std::make_shared<TaskProgress>(name, total);
+  std::lock_guard<std::mutex> lock(_mutex);
+  _tracked.push_back(progress);
+  return progress;
+}
+
+std::vector<std::shared_ptr<TaskProgress>> TaskPool::active()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _tracked.erase(
+    std::remove_if(
+      _tracked.begin(),
+      _tracked.end(),
+      [](const std::shared_ptr<TaskProgress>& progress)
+      {
+        return progress->finished();
+      }),
+    _tracked.end());
+  return _tracked;
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef TRAFFIC_EDITOR__TASK_POOL_HPP
+#define TRAFFIC_EDITOR__TASK_POOL_HPP
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <QString>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrent>
+
+//=============================================================================
+/// How far one task has got, shared between the thread that started it,
+/// the workers running it and the status bar. Cancelling only asks: the
+/// task stops at the next item it checks canceled() before.
+class TaskProgress
+{
+public:
+  explicit TaskProgress(const QString& name, const int total = 0)
+  : _name(name), _total(total)
+  {}
+
+  const QString& name() const { return _name; }
+
+  /// 0 if the amount of work isn't known (a busy indicator is shown)
+  int total() const { return _total; }
+  void set_total(const int total) { _total = total; }
+
+  int done() const { return _done; }
+  void advance(const int n = 1) { _done += n; }
+
+  void cancel() { _canceled = true; }
+  bool canceled() const { return _canceled; }
+
+  /// Called by the task when it is over, canceled or not
+  void finish() { _finished = true; }
+  bool finished() const { return _finished; }
+
+private:
+  const QString _name;
+  std::atomic<int> _total;
+  std::atomic<int> _done {0};
+  std::atomic<bool> _canceled {false};
+  std::atomic<bool> _finished {false};
+};
+
+//=============================================================================
+/// The worker threads shared by all of the editor's jobs, so that loading,
+/// decoding, validating and exporting don't each start threads of their
+/// own and fight over the cores. INTERACTIVE work, which someone is
+/// waiting for, runs on the global pool that QtConcurrent also uses, at
+/// the front of its queue. BACKGROUND work (autosaves, prefetching,
+/// exports) runs on a smaller pool of low priority threads, so that it
+/// leaves cores free for the interactive work.
+class TaskPool
+{
+public:
+  enum Priority
+  {
+    BACKGROUND = 0,
+    INTERACTIVE,
+    INHERIT  // that of the task calling, INTERACTIVE outside of any
+  };
+
+  static TaskPool& instance();
+
+  QThreadPool* pool(Priority priority);
+
+  /// Limit the interactive pool to this many threads, and the background
+  /// one to half as many, as set in the preferences; 0 is one per core
+  void set_worker_threads(const int threads);
+
+  /// The jobs started by run() at this priority which haven't started yet
+  int waiting(const Priority priority) const
+  {
+    return _waiting[priority == BACKGROUND ? BACKGROUND : INTERACTIVE];
+  }
+
+  /// Calls f(i) for every i in [0, count). The calling thread takes part,
+  /// so this can be called from a worker without tying up the pool; each
+  /// thread claims the next few indices whenever it is done with its
+  /// last, so that items which take longer than others even out. If
+  /// progress is given, it is advanced for every item, and the indices not
+  /// started when it is canceled are skipped. Returns false if it was.
+  bool parallel_for(
+    const int count,
+    const std::function<void(int)>& f,
+    const Priority priority = INHERIT,
+    TaskProgress* progress = nullptr);
+
+  /// Starts f on a worker, for a QFutureWatcher to wait on
+  template<typename F>
+  auto run(const Priority priority, F f) -> QFuture<decltype(f())>
+  {
+    QThreadPool* threads = pool(priority);
+    const bool background = threads == &_background;
+    std::atomic<int>* waiting =
+      &_waiting[background ? BACKGROUND : INTERACTIVE];
+    waiting->fetch_add(1);
+    if (background)
+      return QtConcurrent::run(
+        threads,
+        [f, waiting]()
+        {
+          waiting->fetch_sub(1);
+          enter_background();
+          return f();
+        });
+    return QtConcurrent::run(
+      threads,
+      [f, waiting]()
+      {
+        waiting->fetch_sub(1);
+        return f();
+      });
+  }
+
+  /// Marks the calling thread, one of the background pool, as running
+  /// background work, and lowers its priority
+  static void enter_background();
+  static bool in_background();
+
+  /// A new task for the status bar to show until its finish() is called
+  std::shared_ptr<TaskProgress> track(const QString& name, const int total);
+
+  /// The tracked tasks which aren't finished yet, oldest first
+  std::vector<std::shared_ptr<TaskProgress>> active();
+
+private:
+  TaskPool();
+
+  QThreadPool _background;
+  std::atomic<int> _waiting[2] {};
+
+  std::mutex _mutex;
+  std::vector<std::shared_ptr<TaskProgress>> _tracked;
+};
+
+#endif
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include <QDir>
+
+#include "logging.hpp"
+#include "string_table.hpp"
+#include "thumbnail_bundle.hpp"
+
+static_assert(sizeof(ThumbnailBundle::Header) == 16, "header layout");
+static_assert(sizeof(ThumbnailBundle::Entry) == 16, "entry layout");
+
+std::shared_ptr<const ThumbnailBundle> ThumbnailBundle::find(
+  const QString& thumbnail_path)
+{
+  // a directory without a bundle is remembered too, so that it isn't
+  // looked for again for every thumbnail
+  static std::mutex mutex;
+  static std::map<QString, std::shared_ptr<const ThumbnailBundle>> bundles;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = bundles.find(thumbnail_path);
+  if (it != bundles.end())
+    return it->second;
+
+  std::shared_ptr<ThumbnailBundle> bundle;
+  const QString path = filename(thumbnail_path);
+  if (QFile::exists(path))
+  {
+    bundle = std::make_shared<ThumbnailBundle>();
+    if (bundle->open(path))
+      qCInfo(lc_io, "using %zu thumbnails of %s",
+        bundle->size(),
+        qUtf8Printable(path));
+    else
+    {
+      qCWarning(lc_io, "ignoring unreadable thumbnail bundle %s",
+        qUtf8Printable(path));
+      bundle.reset();
+    }
+  }
+  bundles[thumbnail_path] = bundle;
+  return bundle;
+}
+
+QString ThumbnailBundle::filename(const QString& thumbnail_path)
+{
+  return QDir(thumbnail_path).filePath("thumbnails.bundle");
+}
+
+bool ThumbnailBundle::open(const QString& path)
+{
+  _entries.clear();
+  _file.setFileName(path);
+  if (!_file.open(QIODevice::ReadOnly))
+    return false;
+  const uint64_t size = static_cast<uint64_t>(_file.size());
+  if (size < sizeof(Header))
+    return false;
+
+  // the mapping stays until the bundle is destroyed, with the file
+  _data = _file.map(0, _file.size());
+  if (!_data)
+    return false;
+
+  Header header;
+  std::memcpy(&header, _data, sizeof(header));
+  const uint64_t strings_offset =
+    sizeof(header) + uint64_t(header.num_thumbnails) * sizeof(Entry);
+  if (header.magic != MAGIC ||
+    header.version != VERSION ||
+    strings_offset > size)
+    return false;
+
+  std::vector<std::string> strings;
+  if (!StringTable::parse(
+      reinterpret_cast<const char*>(_data) + strings_offset,
+      size - strings_offset,
+      header.num_strings,
+      strings))
+    return false;
+
+  _entries.reserve(header.num_thumbnails);
+  for (uint32_t i = 0; i < header.num_thumbnails; i++)
+  {
+    Entry entry;
+    std::memcpy(
+      &entry,
+      _data + sizeof(header) + i * sizeof(Entry),
+      sizeof(entry));
+    if (entry.name == 0 ||
+      entry.name >= strings.size() ||
+      entry.offset > size ||
+      entry.size > size - entry.offset)
+    {
+      _entries.clear();
+      return false;
+    }
+    _entries[strings[entry.name]] = entry;
+  }
+  return true;
+}
+
+QByteArray ThumbnailBundle::data(const std::string& model_name) const
+{
+  auto it = _entries.find(model_name);
+  if (it == _entries.end())
+    return QByteArray();
+  return QByteArray::fromRawData(
+    reinterpret_cast<const char*>(_data + it->second.offset),
+    static_cast<int>(it->second.size));
+}
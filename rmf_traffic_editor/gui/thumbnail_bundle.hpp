@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__THUMBNAIL_BUNDLE_HPP
+#define TRAFFIC_EDITOR__THUMBNAIL_BUNDLE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+//=============================================================================
+/// The model thumbnails packed into one file, thumbnails.bundle next to
+/// model_list.yaml, by scripts/pack_thumbnails.py. Reading thousands of
+/// loose PNGs from images/cropped/ costs a file open each, which is slow
+/// on network home directories; the bundle is opened and memory-mapped
+/// once, and each thumbnail is decoded straight out of the mapping.
+///
+/// It is a Header, num_thumbnails Entries sorted by nothing in particular,
+/// a string table of the model names (see StringTable), and the encoded
+/// images, as they were in the PNG files, at the offsets of the Entries.
+/// Everything is little-endian.
+class ThumbnailBundle
+{
+public:
+  static const uint32_t MAGIC = 0x424d4854;  // "THMB" on disk
+  static const uint32_t VERSION = 1;
+
+  struct Header
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_thumbnails;
+    uint32_t num_strings;
+  };
+
+  struct Entry
+  {
+    uint32_t name;  // index into the string table
+    uint32_t size;  // of the encoded image, in bytes
+    uint64_t offset;  // of the encoded image, from the start of the file
+  };
+
+  /// The bundle of this thumbnail directory, opened on first use and kept
+  /// for the life of the program, or nullptr if the directory has none (in
+  /// which case the thumbnails are read from the loose files). This may be
+  /// called from any thread.
+  static std::shared_ptr<const ThumbnailBundle> find(
+    const QString& thumbnail_path);
+
+  static QString filename(const QString& thumbnail_path);
+
+  /// Map the bundle and read its index. Returns false if it can't be read
+  /// or isn't a bundle of this version.
+  bool open(const QString& path);
+
+  std::size_t size() const { return _entries.size(); }
+  bool contains(const std::string& model_name) const
+  {
+    return _entries.count(model_name) > 0;
+  }
+
+  /// The encoded image of a model, pointing into the mapping rather than
+  /// copied out of it, or an empty array if the bundle doesn't have it
+  QByteArray data(const std::string& model_name) const;
+
+private:
+  QFile _file;
+  const uchar* _data = nullptr;  // the mapping of _file
+  std::unordered_map<std::string, Entry> _entries;
+};
+
+#endif
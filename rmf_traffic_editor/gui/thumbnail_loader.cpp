@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <QPixmap>
+#include <QtConcurrent/QtConcurrent>
+
+#include "logging.hpp"
+#include "thumbnail_loader.hpp"
+
+
+ThumbnailLoader::ThumbnailLoader(
+  std::vector<EditorModel>& editor_models,
+  const EditorModelIndex& editor_model_index,
+  QObject* parent)
+: QObject(parent),
+  _editor_models(editor_models),
+  _editor_model_index(editor_model_index)
+{
+  _watcher = new QFutureWatcher<Result>(this);
+  connect(
+    _watcher,
+    &QFutureWatcher<Result>::resultReadyAt,
+    this,
+    &ThumbnailLoader::result_ready);
+  connect(
+    _watcher,
+    &QFutureWatcher<Result>::finished,
+    this,
+    &ThumbnailLoader::loading_finished);
+}
+
+ThumbnailLoader::~ThumbnailLoader()
+{
+  _watcher->cancel();
+  _watcher->waitForFinished();
+}
+
+void ThumbnailLoader::prefetch(const std::set<std::string>& model_names)
+{
+  if (_watcher->isRunning())
+  {
+    _watcher->cancel();
+    _watcher->waitForFinished();
+    loading_finished();
+  }
+
+  // QPixmaps can only be created on the GUI thread, so the workers only
+  // decode QImages; the conversion happens as each result arrives
+  const QString thumbnail_path = EditorModel::thumbnail_path();
+  QList<Result> requests;
+  for (const std::string& model_name : model_names)
+  {
+    EditorModel* editor_model = find_editor_model(model_name);
+    if (!editor_model || !editor_model->pixmap.isNull())
+      continue;
+    editor_model->thumbnail_pending = true;
+    Result request;
+    request.model_name = model_name;
+    request.thumbnail_path = thumbnail_path;
+    request.filename =
+      EditorModel::thumbnail_filename(thumbnail_path, model_name);
+    requests.append(request);
+  }
+
+  if (requests.isEmpty())
+    return;
+  qCDebug(lc_io, "prefetching %d model thumbnails", requests.size());
+  _watcher->setFuture(QtConcurrent::mapped(requests, &ThumbnailLoader::load));
+}
+
+ThumbnailLoader::Result ThumbnailLoader::load(Result request)
+{
+  request.image = EditorModel::read_thumbnail(
+    request.thumbnail_path,
+    request.model_name,
+    QSize(),
+    &request.error_string);
+  return request;
+}
+
+EditorModel* ThumbnailLoader::find_editor_model(const std::string& model_name)
+{
+  const int idx = _editor_model_index.find(model_name);
+  return idx < 0 ? nullptr : &_editor_models[idx];
+}
+
+void ThumbnailLoader::result_ready(int result_idx)
+{
+  const Result result = _watcher->resultAt(result_idx);
+  EditorModel* editor_model = find_editor_model(result.model_name);
+  if (!editor_model)
+    return;  // the model list was reloaded meanwhile
+  editor_model->thumbnail_pending = false;
+
+  if (result.image.isNull())
+  {
+    qWarning("unable to read %s: %s",
+      qUtf8Printable(result.filename),
+      qUtf8Printable(result.error_string));
+    return;
+  }
+
+  if (editor_model->pixmap.isNull())
+    editor_model->pixmap = QPixmap::fromImage(result.image);
+  emit thumbnail_loaded(QString::fromStdString(result.model_name));
+}
+
+void ThumbnailLoader::loading_finished()
+{
+  // anything still pending was canceled; let it load on demand instead
+  for (EditorModel& editor_model : _editor_models)
+    editor_model.thumbnail_pending = false;
+  emit finished();
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__THUMBNAIL_LOADER_HPP
+#define TRAFFIC_EDITOR__THUMBNAIL_LOADER_HPP
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include <QFutureWatcher>
+#include <QImage>
+#include <QObject>
+#include <QString>
+
+#include "editor_model.h"
+#include "editor_model_index.hpp"
+
+//=============================================================================
+/// Decodes model thumbnails on the thread pool, so that opening a level
+/// with many different models doesn't block on one disk read per model.
+/// Models drawn while their thumbnail is pending get a placeholder, and
+/// thumbnail_loaded() is emitted as each one arrives so it can be swapped
+/// in. The EditorModel vector and its index are borrowed from the Editor.
+class ThumbnailLoader : public QObject
+{
+  Q_OBJECT
+
+public:
+  ThumbnailLoader(
+    std::vector<EditorModel>& editor_models,
+    const EditorModelIndex& editor_model_index,
+    QObject* parent);
+  ~ThumbnailLoader();
+
+  /// Start loading the thumbnails of these models, unless they are loaded
+  /// already. Any prefetch still running is abandoned first.
+  void prefetch(const std::set<std::string>& model_names);
+
+  bool is_busy() const { return _watcher->isRunning(); }
+
+signals:
+  void thumbnail_loaded(const QString& model_name);
+
+  /// Every thumbnail of the last prefetch() was loaded (or failed)
+  void finished();
+
+private:
+  struct Result
+  {
+    std::string model_name;
+    QString thumbnail_path;
+    QString filename;
+    QImage image;
+    QString error_string;
+  };
+
+  std::vector<EditorModel>& _editor_models;
+  const EditorModelIndex& _editor_model_index;
+  QFutureWatcher<Result>* _watcher = nullptr;
+
+  static Result load(Result request);
+  EditorModel* find_editor_model(const std::string& model_name);
+  void result_ready(int result_idx);
+  void loading_finished();
+};
+
+#endif
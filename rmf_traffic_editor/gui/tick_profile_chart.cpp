@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+
+#include <QPainter>
+#include <QPainterPath>
+
+#include "tick_profile_chart.hpp"
+
+
+TickProfileChart::TickProfileChart(
+  const TickProfiler* profiler,
+  QWidget* parent)
+: QWidget(parent),
+  _profiler(profiler)
+{
+  setMinimumSize(120, 40);
+}
+
+void TickProfileChart::paintEvent(QPaintEvent*)
+{
+  QPainter painter(this);
+  painter.fillRect(rect(), QColor(32, 32, 32));
+  if (!_profiler)
+    return;
+
+  std::vector<qint64> times[TickProfiler::NUM_CHANNELS];
+  const qint64 period = _profiler->period_nsec();
+  qint64 top = period;
+  for (int i = 0; i < TickProfiler::NUM_CHANNELS; i++)
+  {
+    times[i] = _profiler->recent(static_cast<TickProfiler::Channel>(i));
+    for (const qint64 t : times[i])
+      top = std::max(top, t);
+  }
+  if (top <= 0)
+    return;
+  top += top / 10;  // some headroom above the highest sample
+
+  const double x_scale =
+    static_cast<double>(width()) / (TickProfiler::HISTORY - 1);
+  const double y_scale = static_cast<double>(height()) / top;
+
+  if (period > 0)
+  {
+    const double y = height() - period * y_scale;
+    painter.setPen(QPen(QColor(255, 64, 64), 1, Qt::DashLine));
+    painter.drawLine(QPointF(0, y), QPointF(width(), y));
+  }
+
+  const QColor colors[TickProfiler::NUM_CHANNELS] = {
+    QColor(96, 192, 255),  // tick
+    QColor(255, 192, 64),  // scene update
+    QColor(128, 255, 128)  // paint
+  };
+  painter.setRenderHint(QPainter::Antialiasing);
+  for (int i = 0; i < TickProfiler::NUM_CHANNELS; i++)
+  {
+    if (times[i].size() < 2)
+      continue;
+    // right-aligned, so the newest sample is always at the right edge
+    const double x0 =
+      (TickProfiler::HISTORY - static_cast<int>(times[i].size())) * x_scale;
+    QPainterPath path;
+    path.moveTo(x0, height() - times[i][0] * y_scale);
+    for (std::size_t j = 1; j < times[i].size(); j++)
+      path.lineTo(x0 + j * x_scale, height() - times[i][j] * y_scale);
+    painter.setPen(QPen(colors[i], 1));
+    painter.drawPath(path);
+  }
+}
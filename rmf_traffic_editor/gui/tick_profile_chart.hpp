@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__TICK_PROFILE_CHART_HPP
+#define TRAFFIC_EDITOR__TICK_PROFILE_CHART_HPP
+
+#include <QWidget>
+
+#include "tick_profiler.hpp"
+
+//=============================================================================
+/// A small strip chart of the recent times of a TickProfiler, one line per
+/// channel, with the period drawn across it. It doesn't poll; whoever owns
+/// it calls update() when it should be redrawn.
+class TickProfileChart : public QWidget
+{
+public:
+  TickProfileChart(const TickProfiler* profiler, QWidget* parent = nullptr);
+
+  QSize sizeHint() const override { return QSize(TickProfiler::HISTORY, 60); }
+
+protected:
+  void paintEvent(QPaintEvent* e) override;
+
+private:
+  const TickProfiler* _profiler;
+};
+
+#endif
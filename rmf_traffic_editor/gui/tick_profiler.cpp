@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cstdio>
+
+#include "simulation_group.hpp"
+#include "tick_profiler.hpp"
+
+namespace {
+
+int bucket_of(const qint64 nsec)
+{
+  qint64 usec = nsec / 1000;
+  int bucket = 0;
+  while (usec > 1 && bucket < TickProfiler::NUM_BUCKETS - 1)
+  {
+    usec >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+}  // namespace
+
+const char* TickProfiler::channel_name(const Channel channel)
+{
+  switch (channel)
+  {
+    case TICK: return "tick";
+    case SCENE_UPDATE: return "scene_update";
+    case PAINT: return "paint";
+    default: return "unknown";
+  }
+}
+
+void TickProfiler::clear()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (Stats& stats : _stats)
+    stats = Stats();
+}
+
+void TickProfiler::set_period_nsec(const qint64 nsec)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _period_nsec = nsec;
+}
+
+qint64 TickProfiler::period_nsec() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _period_nsec;
+}
+
+void TickProfiler::record(const Channel channel, const qint64 nsec)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  record_locked(channel, nsec);
+}
+
+void TickProfiler::record_locked(const Channel channel, const qint64 nsec)
+{
+  Stats& stats = _stats[channel];
+  stats.count++;
+  stats.total_nsec += nsec;
+  stats.max_nsec = std::max(stats.max_nsec, nsec);
+  stats.buckets[bucket_of(nsec)]++;
+  stats.history[stats.next] = nsec;
+  stats.next = (stats.next + 1) % HISTORY;
+  if (_period_nsec > 0 && nsec > _period_nsec)
+    stats.overruns++;
+}
+
+void TickProfiler::record_tick(
+  const qint64 nsec,
+  const SimulationGroup* group)
+{
+  qint64 period = 0;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    record_locked(TICK, nsec);
+    period = _period_nsec;
+  }
+  if (period <= 0 || nsec <= period)
+    return;
+
+  // find the culprit outside of the lock; printing is slow
+  std::string slowest = "?";
+  qint64 slowest_nsec = 0;
+  if (group)
+  {
+    for (std::size_t i = 0; i < group->size(); i++)
+    {
+      if (group->stats(i).last_ns > slowest_nsec)
+      {
+        slowest_nsec = group->stats(i).last_ns;
+        slowest = group->name(i);
+      }
+    }
+  }
+  printf(
+    "[WARNING] simulation tick took %.3f ms, period is %.3f ms; "
+    "slowest plugin: %s (%.3f ms)\n",
+    nsec / 1e6,
+    period / 1e6,
+    slowest.c_str(),
+    slowest_nsec / 1e6);
+}
+
+std::vector<qint64> TickProfiler::recent(const Channel channel) const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  const Stats& stats = _stats[channel];
+  const int n = static_cast<int>(std::min<qint64>(stats.count, HISTORY));
+  std::vector<qint64> times;
+  times.reserve(n);
+  for (int i = 0; i < n; i++)
+    times.push_back(stats.history[(stats.next - n + i + HISTORY) % HISTORY]);
+  return times;
+}
+
+qint64 TickProfiler::percentile_nsec(
+  const Channel channel,
+  const double fraction) const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return percentile_locked(channel, fraction);
+}
+
+qint64 TickProfiler::percentile_locked(
+  const Channel channel,
+  const double fraction) const
+{
+  const Stats& stats = _stats[channel];
+  if (stats.count == 0)
+    return 0;
+  const qint64 wanted = static_cast<qint64>(fraction * stats.count);
+  qint64 seen = 0;
+  for (int i = 0; i < NUM_BUCKETS; i++)
+  {
+    seen += stats.buckets[i];
+    if (seen > wanted)
+      return std::min((qint64(2) << i) * 1000, stats.max_nsec);
+  }
+  return stats.max_nsec;
+}
+
+QString TickProfiler::summary() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  QString s = QString::asprintf("period %.3f ms\n", _period_nsec / 1e6);
+  for (int i = 0; i < NUM_CHANNELS; i++)
+  {
+    const Channel channel = static_cast<Channel>(i);
+    const Stats& stats = _stats[i];
+    s += QString::asprintf(
+      "  %-13s %7lld x  mean %7.3f ms  p99 < %7.3f ms  max %7.3f ms  "
+      "%lld over\n",
+      channel_name(channel),
+      static_cast<long long>(stats.count),
+      stats.count ? stats.total_nsec / 1e6 / stats.count : 0.0,
+      percentile_locked(channel, 0.99) / 1e6,
+      stats.max_nsec / 1e6,
+      static_cast<long long>(stats.overruns));
+  }
+  return s;
+}
+
+QJsonObject TickProfiler::to_json() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  QJsonObject channels;
+  for (int i = 0; i < NUM_CHANNELS; i++)
+  {
+    const Channel channel = static_cast<Channel>(i);
+    const Stats& stats = _stats[i];
+
+    QJsonObject histogram;
+    for (int b = 0; b < NUM_BUCKETS; b++)
+    {
+      if (stats.buckets[b] > 0)
+        histogram[QString::number(qint64(1) << b)] =
+          static_cast<double>(stats.buckets[b]);
+    }
+
+    QJsonObject o;
+    o["count"] = static_cast<double>(stats.count);
+    o["overruns"] = static_cast<double>(stats.overruns);
+    o["mean_ms"] = stats.count ? stats.total_nsec / 1e6 / stats.count : 0.0;
+    o["max_ms"] = stats.max_nsec / 1e6;
+    o["p50_ms"] = percentile_locked(channel, 0.5) / 1e6;
+    o["p99_ms"] = percentile_locked(channel, 0.99) / 1e6;
+    o["histogram_us"] = histogram;
+    channels[channel_name(channel)] = o;
+  }
+
+  QJsonObject json;
+  json["period_ms"] = _period_nsec / 1e6;
+  json["channels"] = channels;
+  return json;
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__TICK_PROFILER_HPP
+#define TRAFFIC_EDITOR__TICK_PROFILER_HPP
+
+#include <array>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <QJsonObject>
+#include <QString>
+
+class SimulationGroup;
+
+//=============================================================================
+/// Timing histograms of the simulation loop: plugin ticks, scene updates
+/// and paints of the map view, each against the period of the simulation
+/// clock. The simulation thread and the GUI thread both record into it,
+/// so every method takes a lock.
+class TickProfiler
+{
+public:
+  enum Channel
+  {
+    TICK = 0,
+    SCENE_UPDATE,
+    PAINT,
+    NUM_CHANNELS
+  };
+
+  /// Bucket i of a histogram counts the times in [2^i, 2^(i+1)) us
+  static constexpr int NUM_BUCKETS = 24;
+
+  /// Number of recent times kept per channel, for the live chart
+  static constexpr int HISTORY = 240;
+
+  static const char* channel_name(const Channel channel);
+
+  void clear();
+
+  /// A time longer than this is an overrun; 0 disables overrun counting
+  void set_period_nsec(const qint64 nsec);
+  qint64 period_nsec() const;
+
+  void record(const Channel channel, const qint64 nsec);
+
+  /// Record a tick of a group of plugins. If it overran the period, log
+  /// which plugin took the longest in it.
+  void record_tick(const qint64 nsec, const SimulationGroup* group);
+
+  /// The most recent times of a channel, oldest first
+  std::vector<qint64> recent(const Channel channel) const;
+
+  /// Upper bound of the bucket holding this fraction of the samples
+  qint64 percentile_nsec(const Channel channel, const double fraction) const;
+
+  /// Human-readable table, one line per channel
+  QString summary() const;
+
+  /// {"period_ms", "channels": {name: {"count", "overruns", "mean_ms",
+  /// "max_ms", "p50_ms", "p99_ms", "histogram_us": {...}}}}
+  QJsonObject to_json() const;
+
+private:
+  struct Stats
+  {
+    qint64 count = 0;
+    qint64 overruns = 0;
+    qint64 total_nsec = 0;
+    qint64 max_nsec = 0;
+    std::array<qint64, NUM_BUCKETS> buckets {};
+    std::array<qint64, HISTORY> history {};
+    int next = 0;  // in history
+  };
+
+  mutable std::mutex _mutex;
+  qint64 _period_nsec = 0;
+  std::array<Stats, NUM_CHANNELS> _stats;
+
+  void record_locked(const Channel channel, const qint64 nsec);
+  qint64 percentile_locked(const Channel channel, const double fraction) const;
+};
+
+#endif
@@ -0,0 +1,757 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <algorithm>
+#include <cmath>
+
+#include <QBuffer>
+#include <QDir>
+#include <QFileInfo>
+#include <QGraphicsScene>
+#include <QHostAddress>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QPainter>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QUrl>
+
+#include "building_diff.hpp"
+#include "content_hash.hpp"
+#include "logging.hpp"
+#include "model_catalog_cache.hpp"
+#include "task_pool.hpp"
+#include "tile_server.hpp"
+
+namespace {
+
+/// Longest request head accepted; tile requests are a few hundred bytes
+const int MAX_REQUEST_BYTES = 16 * 1024;
+
+/// How far a model may reach from its position, in meters, since the size
+/// of its thumbnail isn't known without drawing it
+const double MODEL_RADIUS = 5.0;
+
+double meters_per_unit(const Level& level)
+{
+  return level.drawing_meters_per_pixel > 0.0 ?
+    level.drawing_meters_per_pixel : 1.0;
+}
+
+QByteArray status_text(const int status)
+{
+  switch (status)
+  {
+    case 200: return "OK";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 431: return "Request Header Fields Too Large";
+    default: return "Internal Server Error";
+  }
+}
+
+QByteArray encode_png(const QImage& image)
+{
+  QByteArray png;
+  QBuffer buffer(&png);
+  buffer.open(QIODevice::WriteOnly);
+  if (!image.save(&buffer, "PNG"))
+    return QByteArray();
+  return png;
+}
+
+QImage blank_image(const int size)
+{
+  QImage image(size, size, QImage::Format_RGB32);
+  image.fill(Qt::white);
+  return image;
+}
+
+QByteArray to_json(const QJsonObject& object)
+{
+  return QJsonDocument(object).toJson(QJsonDocument::Compact) + "\n";
+}
+
+/// The bounds of an edge, with the swing of a door
+bool edge_rect(const Level& level, const Edge& edge, QRectF& rect)
+{
+  const int num_vertices = static_cast<int>(level.vertices.size());
+  if (edge.start_idx < 0 || edge.start_idx >= num_vertices ||
+    edge.end_idx < 0 || edge.end_idx >= num_vertices)
+    return false;
+  const Vertex& start = level.vertices[edge.start_idx];
+  const Vertex& end = level.vertices[edge.end_idx];
+  rect = QRectF(QPointF(start.x, start.y), QPointF(end.x, end.y)).normalized();
+  if (edge.type == Edge::DOOR)
+  {
+    const double length = std::hypot(end.x - start.x, end.y - start.y);
+    rect.adjust(-length, -length, length, length);
+  }
+  return true;
+}
+
+bool polygon_rect(const Level& level, const Polygon& polygon, QRectF& rect)
+{
+  bool any = false;
+  for (const int idx : polygon.vertices)
+  {
+    if (idx < 0 || idx >= static_cast<int>(level.vertices.size()))
+      continue;
+    const QPointF p(level.vertices[idx].x, level.vertices[idx].y);
+    rect = any ? rect.united(QRectF(p, p)) : QRectF(p, p);
+    any = true;
+  }
+  return any;
+}
+
+std::uint64_t underlay_hash(const Level& level)
+{
+  return level.vector_underlay.empty() ?
+    0 : ContentHash::of(level.vector_underlay.to_yaml());
+}
+
+}  // namespace
+
+QJsonObject TileServer::Stats::to_json() const
+{
+  QJsonObject object;
+  object["hits"] = static_cast<double>(hits);
+  object["misses"] = static_cast<double>(misses);
+  object["not_modified"] = static_cast<double>(not_modified);
+  object["kept"] = static_cast<double>(kept);
+  object["dropped"] = static_cast<double>(dropped);
+  return object;
+}
+
+uint qHash(const TileServer::TileKey& key, uint seed)
+{
+  const std::uint64_t h = ContentHash::Builder()
+    .add(key.level)
+    .add(key.z)
+    .add(key.x)
+    .add(key.y)
+    .value();
+  return static_cast<uint>(h ^ (h >> 32)) ^ seed;
+}
+
+TileServer::TileServer(QObject* parent, const Options& options)
+: _options(options),
+  _parent(parent)
+{
+  _options.tile_size = std::max(16, std::min(4096, _options.tile_size));
+  _options.max_zoom = std::max(0, std::min(30, _options.max_zoom));
+  _cache.setMaxCost(std::max(1, _options.cache_mb) * 1024);
+  _blank_tile = encode_png(blank_image(_options.tile_size));
+
+  // everything at full detail, as LevelImageExporter draws it
+  _rendering_options.batch_vertices = true;
+  _rendering_options.batch_edges = true;
+  _rendering_options.cull_to_viewport = false;
+  _rendering_options.lod_tier = LevelOfDetail::FINE;
+
+  // the thumbnails of the models, from the editor's thumbnail directory
+  double model_meters_per_pixel = 1.0;
+  std::vector<std::string> model_names;
+  const QString thumbnail_path = EditorModel::thumbnail_path();
+  if (!thumbnail_path.isEmpty() &&
+    ModelCatalogCache::load(
+      QDir(thumbnail_path).filePath("model_list.yaml"),
+      model_meters_per_pixel,
+      model_names))
+  {
+    for (const std::string& model_name : model_names)
+      _editor_models.emplace_back(model_name, model_meters_per_pixel);
+  }
+}
+
+TileServer::~TileServer()
+{
+  for (QFutureWatcher<QByteArray>* watcher : _compressing)
+  {
+    QObject::disconnect(watcher, nullptr, nullptr, nullptr);
+    watcher->waitForFinished();
+    delete watcher;
+  }
+  for (auto& connection : _connections)
+  {
+    QObject::disconnect(connection.first, nullptr, nullptr, nullptr);
+    connection.first->abort();
+    connection.first->deleteLater();
+  }
+  if (_server)
+  {
+    _server->close();
+    delete _server;
+  }
+  for (std::size_t i = 0; i < _levels.size(); i++)
+    _building.levels[i].clear_scene();
+}
+
+bool TileServer::load(const QString& path)
+{
+  Building loaded;
+  loaded.lazy_images = true;  // decoded when a level is first drawn
+  if (!loaded.load(QFileInfo(path).absoluteFilePath().toStdString()))
+  {
+    qCWarning(lc_io, "unable to load %s", qUtf8Printable(path));
+    return false;
+  }
+
+  // the images which didn't change needn't be decoded again
+  for (Level& level : loaded.levels)
+  {
+    const int idx = _building.find_level_idx(level.name);
+    if (idx >= 0)
+      level.take_images(_building.levels[idx]);
+  }
+
+  const bool reloaded = !_levels.empty();
+  _building.swap(loaded);
+  reset_levels(reloaded ? &loaded : nullptr);
+  qCInfo(lc_io, "serving %zu levels of %s",
+    _building.levels.size(),
+    qUtf8Printable(path));
+  return true;
+}
+
+void TileServer::image_changed(const QString& level_name, const int layer_idx)
+{
+  const int idx = _building.find_level_idx(level_name.toStdString());
+  if (idx < 0 || idx >= static_cast<int>(_levels.size()))
+    return;
+  Level& level = _building.levels[idx];
+  level.clear_scene();
+  level.unload_image(layer_idx);
+
+  // the old tiles are left to age out of the cache
+  _image_generations[level.name]++;
+  _levels[idx].scene.reset();
+  _levels[idx].key = level_key(level);
+}
+
+bool TileServer::listen(const QHostAddress& address, const int port)
+{
+  _server = new QTcpServer(_parent);
+  if (!_server->listen(address, static_cast<quint16>(port)))
+  {
+    _error_string = _server->errorString();
+    delete _server;
+    _server = nullptr;
+    return false;
+  }
+  QObject::connect(
+    _server,
+    &QTcpServer::newConnection,
+    [this]()
+    {
+      while (_server->hasPendingConnections())
+        add_connection(_server->nextPendingConnection());
+    });
+  return true;
+}
+
+QString TileServer::error_string() const
+{
+  return _error_string;
+}
+
+QRectF TileServer::tile_rect(
+  const Level& level,
+  const Options& options,
+  const int z,
+  const int x,
+  const int y)
+{
+  const double span =
+    options.zoom0_meters / std::ldexp(1.0, z) / meters_per_unit(level);
+  return QRectF(x * span, y * span, span, span);
+}
+
+bool TileServer::changed_rects(
+  const Level& before,
+  const Level& after,
+  const double margin,
+  std::vector<QRectF>& rects)
+{
+  // what is drawn under the entities, or where everything is drawn
+  const ContentHash::LevelHashes& before_hashes = before.content_hashes();
+  const ContentHash::LevelHashes& after_hashes = after.content_hashes();
+  for (const ContentHash::Section section :
+    {ContentHash::FEATURES, ContentHash::CONSTRAINTS, ContentHash::LAYERS})
+  {
+    if (before_hashes.sections[section] != after_hashes.sections[section])
+      return false;
+  }
+  if (before.drawing_filename != after.drawing_filename ||
+    before.drawing_meters_per_pixel != after.drawing_meters_per_pixel ||
+    before.x_meters != after.x_meters ||
+    before.y_meters != after.y_meters ||
+    underlay_hash(before) != underlay_hash(after))
+    return false;
+
+  BuildingDiff::LevelDiff diff;
+  BuildingDiff::diff_level(before, after, diff);
+
+  const double grow = std::max(margin, 0.01) / meters_per_unit(after);
+  const double model_grow = grow + MODEL_RADIUS / meters_per_unit(after);
+  auto add = [&rects](const QRectF& rect, const double by)
+    {
+      rects.push_back(rect.adjusted(-by, -by, by, by));
+    };
+  auto add_point = [&add](const double x, const double y, const double by)
+    {
+      add(QRectF(x, y, 0.0, 0.0), by);
+    };
+
+  std::vector<bool> moved_before(before.vertices.size(), false);
+  std::vector<bool> moved_after(after.vertices.size(), false);
+  QRectF rect;
+  for (const BuildingDiff::Entry& entry : diff.entries)
+  {
+    const bool in_before = entry.before_idx >= 0;
+    const bool in_after = entry.after_idx >= 0;
+    if (entry.kind == BuildingDiff::VERTEX)
+    {
+      if (in_before &&
+        entry.before_idx < static_cast<int>(moved_before.size()))
+        moved_before[entry.before_idx] = true;
+      if (in_after && entry.after_idx < static_cast<int>(moved_after.size()))
+        moved_after[entry.after_idx] = true;
+    }
+
+    switch (entry.kind)
+    {
+      case BuildingDiff::VERTEX:
+      case BuildingDiff::FIDUCIAL:
+      case BuildingDiff::TAG:
+        if (in_before)
+          add_point(entry.before_x, entry.before_y, grow);
+        if (in_after)
+          add_point(entry.after_x, entry.after_y, grow);
+        break;
+
+      case BuildingDiff::MODEL:
+        if (in_before)
+          add_point(entry.before_x, entry.before_y, model_grow);
+        if (in_after)
+          add_point(entry.after_x, entry.after_y, model_grow);
+        break;
+
+      case BuildingDiff::EDGE:
+        if (in_before &&
+          entry.before_idx < static_cast<int>(before.edges.size()) &&
+          edge_rect(before, before.edges[entry.before_idx], rect))
+          add(rect, grow);
+        if (in_after &&
+          entry.after_idx < static_cast<int>(after.edges.size()) &&
+          edge_rect(after, after.edges[entry.after_idx], rect))
+          add(rect, grow);
+        break;
+
+      case BuildingDiff::POLYGON:
+        if (in_before &&
+          entry.before_idx < static_cast<int>(before.polygons.size()) &&
+          polygon_rect(before, before.polygons[entry.before_idx], rect))
+          add(rect, grow);
+        if (in_after &&
+          entry.after_idx < static_cast<int>(after.polygons.size()) &&
+          polygon_rect(after, after.polygons[entry.after_idx], rect))
+          add(rect, grow);
+        break;
+
+      default:
+        return false;
+    }
+  }
+
+  // the edges and polygons of moved vertices moved with them, though they
+  // match and so aren't in the diff
+  auto add_attached =
+    [&](const Level& level, const std::vector<bool>& moved)
+    {
+      auto is_moved = [&moved](const int idx)
+        {
+          return idx >= 0 && idx < static_cast<int>(moved.size()) &&
+                 moved[idx];
+        };
+      for (const Edge& edge : level.edges)
+      {
+        if ((is_moved(edge.start_idx) || is_moved(edge.end_idx)) &&
+          edge_rect(level, edge, rect))
+          add(rect, grow);
+      }
+      for (const Polygon& polygon : level.polygons)
+      {
+        if (std::any_of(polygon.vertices.begin(), polygon.vertices.end(),
+          is_moved) && polygon_rect(level, polygon, rect))
+          add(rect, grow);
+      }
+    };
+  add_attached(before, moved_before);
+  add_attached(after, moved_after);
+  return true;
+}
+
+std::uint64_t TileServer::level_key(const Level& level) const
+{
+  const auto it = _image_generations.find(level.name);
+  return ContentHash::Builder()
+    .add(level.content_hashes().level)
+    .add(it == _image_generations.end() ? 0 : it->second)
+    .value();
+}
+
+void TileServer::reset_levels(const Building* before)
+{
+  // the scenes of the previous levels are deleted with them
+  std::vector<LevelTiles> previous;
+  previous.swap(_levels);
+  _levels.resize(_building.levels.size());
+
+  const QList<TileKey> cached = _cache.keys();
+  for (std::size_t i = 0; i < _building.levels.size(); i++)
+  {
+    const Level& level = _building.levels[i];
+    _levels[i].key = level_key(level);
+
+    const int before_idx = before ? before->find_level_idx(level.name) : -1;
+    if (before_idx < 0 || before_idx >= static_cast<int>(previous.size()))
+      continue;
+    const std::uint64_t before_key = previous[before_idx].key;
+    if (before_key == _levels[i].key)
+      continue;  // its tiles are all still good
+
+    std::vector<QRectF> rects;
+    const bool keep = changed_rects(
+      before->levels[before_idx], level, _options.change_margin, rects);
+    for (const TileKey& key : cached)
+    {
+      if (key.level != before_key || !_cache.contains(key))
+        continue;
+      const QRectF tile = tile_rect(level, _options, key.z, key.x, key.y);
+      const bool affected = !keep ||
+        std::any_of(rects.begin(), rects.end(),
+          [&tile](const QRectF& rect) { return rect.intersects(tile); });
+      if (affected)
+      {
+        _stats.dropped++;
+        _cache.remove(key);
+        continue;
+      }
+      const QByteArray png = *_cache.object(key);
+      _cache.remove(key);
+      TileKey moved = key;
+      moved.level = _levels[i].key;
+      _cache.insert(moved, new QByteArray(png), std::max(1, png.size() / 1024));
+      _stats.kept++;
+    }
+  }
+}
+
+void TileServer::add_connection(QTcpSocket* socket)
+{
+  _connections[socket] = Connection();
+  QObject::connect(
+    socket,
+    &QTcpSocket::readyRead,
+    [this, socket]()
+    {
+      const auto it = _connections.find(socket);
+      if (it == _connections.end())
+        return;
+      it->second.buffer.append(socket->readAll());
+      handle_requests(socket);
+    });
+  QObject::connect(
+    socket,
+    &QTcpSocket::disconnected,
+    [this, socket]()
+    {
+      _connections.erase(socket);
+      QObject::disconnect(socket, nullptr, nullptr, nullptr);
+      socket->deleteLater();
+    });
+}
+
+void TileServer::handle_requests(QTcpSocket* socket)
+{
+  // requests are answered in order, one at a time
+  for (auto it = _connections.find(socket);
+    it != _connections.end() && !it->second.busy;
+    it = _connections.find(socket))
+  {
+    Connection& connection = it->second;
+    const int head_end = connection.buffer.indexOf("\r\n\r\n");
+    if (head_end < 0)
+    {
+      if (connection.buffer.size() > MAX_REQUEST_BYTES)
+      {
+        connection.busy = true;
+        connection.keep_alive = false;
+        respond(socket, 431, "text/plain", "request too large\n");
+      }
+      return;
+    }
+    const QList<QByteArray> lines =
+      connection.buffer.left(head_end).split('\n');
+    connection.buffer.remove(0, head_end + 4);
+
+    const QList<QByteArray> request = lines[0].trimmed().split(' ');
+    const bool http_1_0 = request.size() > 2 && request[2] == "HTTP/1.0";
+    connection.keep_alive = !http_1_0;
+    QByteArray if_none_match;
+    for (int i = 1; i < lines.size(); i++)
+    {
+      const int colon = lines[i].indexOf(':');
+      if (colon < 0)
+        continue;
+      const QByteArray name = lines[i].left(colon).trimmed().toLower();
+      const QByteArray value = lines[i].mid(colon + 1).trimmed();
+      if (name == "connection")
+        connection.keep_alive = http_1_0 ?
+          value.toLower() == "keep-alive" : value.toLower() != "close";
+      else if (name == "if-none-match")
+        if_none_match = value;
+    }
+
+    connection.busy = true;
+    if (request.size() < 3)
+      respond(socket, 400, "text/plain", "bad request\n");
+    else if (request[0] != "GET")
+      respond(socket, 405, "text/plain", "only GET is supported\n");
+    else
+      handle_get(socket, QString::fromUtf8(request[1]), if_none_match);
+  }
+}
+
+void TileServer::handle_get(
+  QTcpSocket* socket,
+  const QString& path,
+  const QByteArray& if_none_match)
+{
+  QStringList parts = path.section('?', 0, 0).split('/');
+  parts.removeAll(QString());
+
+  if (parts.size() == 1 && parts[0] == "levels")
+  {
+    QJsonArray levels;
+    for (std::size_t i = 0; i < _building.levels.size(); i++)
+    {
+      const Level& level = _building.levels[i];
+      const QString name = QString::fromStdString(level.name);
+      const bool has_drawing = level.drawing_width > 0;
+      QJsonObject object;
+      object["name"] = name;
+      object["elevation"] = level.elevation;
+      object["hash"] = ContentHash::to_hex(_levels[i].key);
+      object["width_meters"] = has_drawing ?
+        level.drawing_width * meters_per_unit(level) : level.x_meters;
+      object["height_meters"] = has_drawing ?
+        level.drawing_height * meters_per_unit(level) : level.y_meters;
+      object["tiles"] = "/levels/" +
+        QString::fromUtf8(QUrl::toPercentEncoding(name)) +
+        "/{z}/{x}/{y}.png";
+      levels.append(object);
+    }
+    QJsonObject object;
+    object["building"] = QString::fromStdString(_building.name);
+    object["tile_size"] = _options.tile_size;
+    object["zoom0_meters"] = _options.zoom0_meters;
+    object["max_zoom"] = _options.max_zoom;
+    object["levels"] = levels;
+    respond(socket, 200, "application/json", to_json(object));
+    return;
+  }
+
+  if (parts.size() == 1 && parts[0] == "stats")
+  {
+    QJsonObject object = _stats.to_json();
+    object["cached_tiles"] = _cache.size();
+    object["cached_kb"] = _cache.totalCost();
+    object["connections"] = static_cast<int>(_connections.size());
+    respond(socket, 200, "application/json", to_json(object));
+    return;
+  }
+
+  if (parts.size() == 5 && parts[0] == "levels" && parts[4].endsWith(".png"))
+  {
+    const std::string level_name =
+      QUrl::fromPercentEncoding(parts[1].toUtf8()).toStdString();
+    const int level_idx = _building.find_level_idx(level_name);
+    bool z_ok = false, x_ok = false, y_ok = false;
+    const int z = parts[2].toInt(&z_ok);
+    const int x = parts[3].toInt(&x_ok);
+    const int y = parts[4].left(parts[4].size() - 4).toInt(&y_ok);
+    const int num_tiles = z_ok && z >= 0 && z <= _options.max_zoom ?
+      1 << z : 0;
+    if (level_idx >= 0 && level_idx < static_cast<int>(_levels.size()) &&
+      x_ok && y_ok && x >= 0 && x < num_tiles && y >= 0 && y < num_tiles)
+    {
+      get_tile(socket, level_idx, z, x, y, if_none_match);
+      return;
+    }
+  }
+
+  respond(socket, 404, "text/plain", "not found\n");
+}
+
+void TileServer::get_tile(
+  QTcpSocket* socket,
+  const int level_idx,
+  const int z,
+  const int x,
+  const int y,
+  const QByteArray& if_none_match)
+{
+  LevelTiles& tiles = _levels[level_idx];
+  const QByteArray etag = '"' + ContentHash::to_hex(tiles.key).toLatin1() + '"';
+  if (if_none_match == etag)
+  {
+    _stats.not_modified++;
+    respond(socket, 304, "image/png", QByteArray(), etag);
+    return;
+  }
+
+  TileKey key;
+  key.level = tiles.key;
+  key.z = z;
+  key.x = x;
+  key.y = y;
+  if (const QByteArray* png = _cache.object(key))
+  {
+    _stats.hits++;
+    respond(socket, 200, "image/png", *png, etag);
+    return;
+  }
+  _stats.misses++;
+
+  // the same tile may be asked for again before it is compressed
+  if (_pending.contains(key))
+  {
+    _pending[key].push_back(socket);
+    return;
+  }
+
+  Level& level = _building.levels[level_idx];
+  if (!tiles.scene)
+  {
+    level.load_images();
+    tiles.scene.reset(new QGraphicsScene);
+    level.draw(
+      tiles.scene.get(),
+      _editor_models,
+      _rendering_options,
+      _building.graphs,
+      _building.coordinate_system);
+    tiles.bounds = tiles.scene->itemsBoundingRect();
+    qCDebug(lc_draw, "drew level [%s] to serve its tiles",
+      level.name.c_str());
+  }
+
+  const QRectF source = tile_rect(level, _options, z, x, y);
+  if (!source.intersects(tiles.bounds))
+  {
+    respond(socket, 200, "image/png", _blank_tile, etag);
+    return;
+  }
+
+  const int size = _options.tile_size;
+  QImage image = blank_image(size);
+  {
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    painter.setRenderHint(QPainter::TextAntialiasing);
+    tiles.scene->render(
+      &painter,
+      QRectF(0, 0, size, size),
+      source,
+      Qt::IgnoreAspectRatio);
+  }
+
+  _pending[key].push_back(socket);
+  QFutureWatcher<QByteArray>* watcher = new QFutureWatcher<QByteArray>;
+  _compressing.insert(watcher);
+  QObject::connect(
+    watcher,
+    &QFutureWatcher<QByteArray>::finished,
+    [this, watcher, key]()
+    {
+      _compressing.erase(watcher);
+      watcher->deleteLater();
+      tile_compressed(key, watcher->result());
+    });
+  watcher->setFuture(
+    TaskPool::instance().run(
+      TaskPool::INTERACTIVE,
+      [image]() { return encode_png(image); }));
+}
+
+void TileServer::tile_compressed(const TileKey& key, const QByteArray& png)
+{
+  if (!png.isEmpty())
+    _cache.insert(key, new QByteArray(png), std::max(1, png.size() / 1024));
+
+  const QByteArray etag = '"' + ContentHash::to_hex(key.level).toLatin1() +
+    '"';
+  for (const QPointer<QTcpSocket>& socket : _pending.take(key))
+  {
+    if (!socket || _connections.find(socket) == _connections.end())
+      continue;  // it went away meanwhile
+    if (png.isEmpty())
+      respond(socket, 500, "text/plain", "unable to compress the tile\n");
+    else
+      respond(socket, 200, "image/png", png, etag);
+    handle_requests(socket);
+  }
+}
+
+void TileServer::respond(
+  QTcpSocket* socket,
+  const int status,
+  const QByteArray& content_type,
+  const QByteArray& body,
+  const QByteArray& etag)
+{
+  const auto it = _connections.find(socket);
+  if (it == _connections.end())
+    return;
+  const bool keep_alive = it->second.keep_alive;
+  it->second.busy = false;
+
+  QByteArray head = "HTTP/1.1 " + QByteArray::number(status) + " " +
+    status_text(status) + "\r\n";
+  head += "Content-Type: " + content_type + "\r\n";
+  head += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+  head += "Access-Control-Allow-Origin: *\r\n";
+  if (!etag.isEmpty())
+  {
+    // cached by the browser, but asked for again with the tag, so that
+    // edits show up
+    head += "ETag: " + etag + "\r\n";
+    head += "Cache-Control: no-cache\r\n";
+  }
+  head += keep_alive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+  head += "\r\n";
+  socket->write(head);
+  if (status != 304)
+    socket->write(body);
+  if (!keep_alive)
+    socket->disconnectFromHost();
+}
@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef TRAFFIC_EDITOR__TILE_SERVER_HPP
+#define TRAFFIC_EDITOR__TILE_SERVER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <QByteArray>
+#include <QCache>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QJsonObject>
+#include <QPointer>
+#include <QRectF>
+#include <QString>
+
+#include "building.h"
+#include "editor_model.h"
+#include "rendering_options.h"
+
+class QGraphicsScene;
+class QHostAddress;
+class QObject;
+class QTcpServer;
+class QTcpSocket;
+
+//=============================================================================
+/// Serves the levels of a building, loaded once, as PNG map tiles over
+/// HTTP, for viewing in a browser with any XYZ ("slippy map") client:
+///
+///   GET /levels                       the levels, as JSON
+///   GET /levels/<level>/<z>/<x>/<y>.png
+///   GET /stats                        cache hits and misses, as JSON
+///
+/// The tiles of a level are drawn by Level::draw(), as in the editor, at
+/// full detail. Tile (0, 0) of zoom 0 spans zoom0_meters from the origin
+/// of the level's scene, with y down, and each zoom halves the span, so a
+/// tile covers the same ground whatever is drawn on the level.
+///
+/// Tiles are cached by the content hash of their level (see ContentHash)
+/// and tagged with it for the browser, so an unchanged tile is a cache
+/// hit here or a 304 there. When the building is reloaded, the tiles of
+/// the levels which didn't change are kept, and so are those of the
+/// levels which did, away from the entities which changed (see
+/// BuildingDiff), by taking them over to the new hash.
+///
+/// The scene items use QPixmaps, so tiles are painted on the GUI thread,
+/// from a scene per level which is drawn once; they are compressed on the
+/// interactive pool, which is most of the work of a tile.
+class TileServer
+{
+public:
+  static constexpr int DEFAULT_PORT = 47480;
+
+  struct Options
+  {
+    int tile_size = 256;  // pixels on a side
+    double zoom0_meters = 1024.0;  // the span of the one tile of zoom 0
+    int max_zoom = 24;
+    int cache_mb = 256;
+
+    /// Tiles within this far of what changed, in meters, are redrawn
+    /// after a reload, for labels, door swings and the like
+    double change_margin = 2.0;
+  };
+
+  struct Stats
+  {
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t not_modified = 0;  // answered with a 304
+    std::uint64_t kept = 0;  // taken over to a new hash by reloads
+    std::uint64_t dropped = 0;  // by reloads
+
+    QJsonObject to_json() const;
+  };
+
+  struct TileKey
+  {
+    std::uint64_t level = 0;  // see level_key()
+    int z = 0;
+    int x = 0;
+    int y = 0;
+
+    bool operator==(const TileKey& other) const
+    {
+      return level == other.level && z == other.z && x == other.x &&
+             y == other.y;
+    }
+  };
+
+  TileServer(QObject* parent, const Options& options);
+  ~TileServer();
+
+  /// Load the building, or load it again after its file changed. Returns
+  /// false, and keeps the building it had, if it couldn't be loaded.
+  bool load(const QString& path);
+
+  /// The drawing of this level (layer_idx < 0) or the image of one of its
+  /// layers changed on disk: decode it again and forget its tiles
+  void image_changed(const QString& level_name, const int layer_idx);
+
+  bool listen(const QHostAddress& address, const int port);
+  QString error_string() const;
+
+  const Building& building() const { return _building; }
+  const Stats& stats() const { return _stats; }
+
+  /// The area covered by a tile of a level, in its scene coordinates
+  static QRectF tile_rect(
+    const Level& level,
+    const Options& options,
+    const int z,
+    const int x,
+    const int y);
+
+  /// Where two versions of a level differ, in the scene coordinates of
+  /// after, grown by margin meters: a rect around each entity which was
+  /// added, removed, moved or changed, the edges and polygons of moved
+  /// vertices included. Returns false if the whole level may look
+  /// different, e.g. its drawing or layers changed.
+  static bool changed_rects(
+    const Level& before,
+    const Level& after,
+    const double margin,
+    std::vector<QRectF>& rects);
+
+private:
+  struct LevelTiles
+  {
+    std::uint64_t key = 0;
+    std::unique_ptr<QGraphicsScene> scene;  // drawn when first needed
+    QRectF bounds;  // of the items of the scene
+  };
+
+  struct Connection
+  {
+    QByteArray buffer;
+    bool busy = false;  // a response is being made
+    bool keep_alive = true;
+  };
+
+  Options _options;
+  QObject* _parent = nullptr;
+  Building _building;
+  std::vector<EditorModel> _editor_models;
+  RenderingOptions _rendering_options;
+  std::vector<LevelTiles> _levels;
+  std::map<std::string, int> _image_generations;  // by level name
+
+  QCache<TileKey, QByteArray> _cache;  // cost in KB
+  QByteArray _blank_tile;  // for those on which nothing is drawn
+  Stats _stats;
+
+  /// Sockets waiting for a tile being compressed
+  QHash<TileKey, std::vector<QPointer<QTcpSocket>>> _pending;
+
+  QTcpServer* _server = nullptr;
+  QString _error_string;
+  std::map<QTcpSocket*, Connection> _connections;
+  std::set<QFutureWatcher<QByteArray>*> _compressing;
+
+  std::uint64_t level_key(const Level& level) const;
+  void reset_levels(const Building* before);
+
+  void add_connection(QTcpSocket* socket);
+  void handle_requests(QTcpSocket* socket);
+  void handle_get(
+    QTcpSocket* socket,
+    const QString& path,
+    const QByteArray& if_none_match);
+  void get_tile(
+    QTcpSocket* socket,
+    const int level_idx,
+    const int z,
+    const int x,
+    const int y,
+    const QByteArray& if_none_match);
+  void tile_compressed(const TileKey& key, const QByteArray& png);
+
+  void respond(
+    QTcpSocket* socket,
+    const int status,
+    const QByteArray& content_type,
+    const QByteArray& body,
+    const QByteArray& etag = QByteArray());
+};
+
+uint qHash(const TileServer::TileKey& key, uint seed = 0);
+
+#endif
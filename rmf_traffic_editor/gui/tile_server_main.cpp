@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <cstdio>
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QFileInfo>
+#include <QHostAddress>
+#include <QLoggingCategory>
+
+#include "file_watcher.hpp"
+#include "logging.hpp"
+#include "tile_server.hpp"
+
+// Serves the levels of a building as map tiles over HTTP, for viewing in
+// a browser without the editor (see TileServer). The building is loaded
+// again whenever its file changes, keeping the tiles which still show it.
+
+
+int main(int argc, char* argv[])
+{
+  // drawing needs a QGuiApplication, but no display
+  if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+
+  QApplication app(argc, argv);
+  app.setOrganizationName("open-robotics");
+  app.setOrganizationDomain("openrobotics.org");
+  // for the thumbnail directory of the editor's preferences
+  app.setApplicationName("traffic-editor");
+
+  const TileServer::Options defaults;
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+    "Serve the levels of a building as PNG map tiles over HTTP, at "
+    "/levels/<level>/<z>/<x>/<y>.png, with the levels listed at /levels.");
+  parser.addHelpOption();
+  parser.addPositionalArgument("building", "Building YAML file to serve");
+
+  const QCommandLineOption port_option(
+    QStringList() << "p" << "port",
+    QString("Port to listen on (default: %1)").arg(TileServer::DEFAULT_PORT),
+    "port",
+    QString::number(TileServer::DEFAULT_PORT));
+  parser.addOption(port_option);
+
+  const QCommandLineOption address_option(
+    "address",
+    "Address to listen on (default: all of them)",
+    "address");
+  parser.addOption(address_option);
+
+  const QCommandLineOption tile_size_option(
+    "tile-size",
+    QString("Pixels on a side of a tile (default: %1)").arg(
+      defaults.tile_size),
+    "pixels",
+    QString::number(defaults.tile_size));
+  parser.addOption(tile_size_option);
+
+  const QCommandLineOption zoom0_option(
+    "zoom0-meters",
+    QString("Span of the one tile of zoom 0, in meters (default: %1)").arg(
+      defaults.zoom0_meters),
+    "meters",
+    QString::number(defaults.zoom0_meters));
+  parser.addOption(zoom0_option);
+
+  const QCommandLineOption max_zoom_option(
+    "max-zoom",
+    QString("Finest zoom served (default: %1)").arg(defaults.max_zoom),
+    "zoom",
+    QString::number(defaults.max_zoom));
+  parser.addOption(max_zoom_option);
+
+  const QCommandLineOption cache_option(
+    "cache-mb",
+    QString("Memory for compressed tiles (default: %1)").arg(
+      defaults.cache_mb),
+    "mb",
+    QString::number(defaults.cache_mb));
+  parser.addOption(cache_option);
+
+  const QCommandLineOption no_watch_option(
+    "no-watch",
+    "Don't load the building again when its files change");
+  parser.addOption(no_watch_option);
+
+  const QCommandLineOption verbose_option(
+    QStringList() << "v" << "verbose",
+    "Log loading and drawing to stderr");
+  parser.addOption(verbose_option);
+
+  parser.process(app);
+
+  const QStringList paths = parser.positionalArguments();
+  if (paths.size() != 1)
+    parser.showHelp(1);
+
+  TileServer::Options options;
+  options.tile_size = parser.value(tile_size_option).toInt();
+  options.zoom0_meters = parser.value(zoom0_option).toDouble();
+  options.max_zoom = parser.value(max_zoom_option).toInt();
+  options.cache_mb = parser.value(cache_option).toInt();
+  if (options.tile_size <= 0 || options.zoom0_meters <= 0.0 ||
+    options.cache_mb <= 0)
+  {
+    fprintf(stderr, "invalid tile size, zoom 0 span or cache size\n");
+    return 1;
+  }
+  if (!parser.isSet(verbose_option))
+    QLoggingCategory::setFilterRules("traffic_editor.*.info=false");
+
+  // Building::load() changes the working directory
+  const QString path = QFileInfo(paths[0]).absoluteFilePath();
+
+  TileServer server(&app, options);
+  if (!server.load(path))
+  {
+    fprintf(stderr, "unable to load %s\n", qUtf8Printable(path));
+    return 1;
+  }
+
+  const QHostAddress address = parser.isSet(address_option) ?
+    QHostAddress(parser.value(address_option)) :
+    QHostAddress(QHostAddress::Any);
+  const int port = parser.value(port_option).toInt();
+  if (!server.listen(address, port))
+  {
+    fprintf(stderr, "unable to listen on port %d: %s\n",
+      port,
+      qUtf8Printable(server.error_string()));
+    return 1;
+  }
+  fprintf(stderr, "serving %s on port %d\n", qUtf8Printable(path), port);
+
+  FileWatcher watcher(&app);
+  if (!parser.isSet(no_watch_option))
+  {
+    watcher.watch(server.building());
+    QObject::connect(
+      &watcher,
+      &FileWatcher::building_changed,
+      [&]()
+      {
+        if (server.load(path))
+          fprintf(stderr, "reloaded %s\n", qUtf8Printable(path));
+        watcher.watch(server.building());
+      });
+    QObject::connect(
+      &watcher,
+      &FileWatcher::image_changed,
+      [&server](const QString& level_name, const int layer_idx)
+      {
+        server.image_changed(level_name, layer_idx);
+      });
+  }
+
+  return app.exec();
+}
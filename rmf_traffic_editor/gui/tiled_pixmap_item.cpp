@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+
+#include "tiled_pixmap_item.hpp"
+
+// cache cost is measured in kilobytes of tile pixmaps
+static const int TILE_CACHE_KB = 128 * 1024;
+
+
+TiledImage::TiledImage(const QImage& image)
+: _tile_cache(TILE_CACHE_KB)
+{
+  // keep reducing until the whole image fits inside a single tile
+  int extent = std::max(image.width(), image.height());
+  while (extent > TILE_SIZE)
+  {
+    extent = (extent + 1) / 2;
+    _num_levels++;
+  }
+  _levels.resize(_num_levels);
+  _levels[0] = image;
+}
+
+int TiledImage::level_for_detail(const double level_of_detail) const
+{
+  if (level_of_detail <= 0.0)
+    return _num_levels - 1;
+  const int level = static_cast<int>(std::floor(-std::log2(level_of_detail)));
+  return std::max(0, std::min(level, _num_levels - 1));
+}
+
+const QImage& TiledImage::level_image(const int level)
+{
+  if (_levels[level].isNull())
+  {
+    // halve the next-finer level, which in turn may need to be generated
+    const QImage& finer = level_image(level - 1);
+    _levels[level] = finer.scaled(
+      std::max(1, finer.width() / 2),
+      std::max(1, finer.height() / 2),
+      Qt::IgnoreAspectRatio,
+      Qt::SmoothTransformation);
+  }
+  return _levels[level];
+}
+
+QPixmap TiledImage::tile(const int level, const int tile_x, const int tile_y)
+{
+  if (level < 0 || level >= _num_levels || tile_x < 0 || tile_y < 0)
+    return QPixmap();
+
+  const quint64 key =
+    (static_cast<quint64>(level) << 48) |
+    (static_cast<quint64>(tile_y) << 24) |
+    static_cast<quint64>(tile_x);
+
+  QPixmap* cached = _tile_cache.object(key);
+  if (cached)
+    return *cached;
+
+  const QImage& image = level_image(level);
+  const QRect rect(
+    tile_x * TILE_SIZE,
+    tile_y * TILE_SIZE,
+    TILE_SIZE,
+    TILE_SIZE);
+  if (!image.rect().intersects(rect))
+    return QPixmap();
+
+  QPixmap* pixmap = new QPixmap(
+    QPixmap::fromImage(image.copy(rect.intersected(image.rect()))));
+  const int cost_kb =
+    std::max(1, pixmap->width() * pixmap->height() * pixmap->depth() / 8192);
+  const QPixmap result(*pixmap);
+  _tile_cache.insert(key, pixmap, cost_kb);  // the cache now owns pixmap
+  return result;
+}
+
+//=============================================================================
+TiledPixmapItem::TiledPixmapItem(
+  std::shared_ptr<TiledImage> tiled_image,
+  QGraphicsItem* parent)
+: QGraphicsItem(parent),
+  _tiled_image(tiled_image)
+{
+  // we need option->exposedRect to know which tiles to paint
+  setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+}
+
+QRectF TiledPixmapItem::boundingRect() const
+{
+  return QRectF(0, 0, _tiled_image->width(), _tiled_image->height());
+}
+
+void TiledPixmapItem::paint(
+  QPainter* painter,
+  const QStyleOptionGraphicsItem* option,
+  QWidget*)
+{
+  const double lod =
+    QStyleOptionGraphicsItem::levelOfDetailFromTransform(
+      painter->worldTransform());
+  const int level = _tiled_image->level_for_detail(lod);
+  const int extent = _tiled_image->tile_extent(level);
+
+  const QRectF exposed = option->exposedRect.intersected(boundingRect());
+  if (exposed.isEmpty())
+    return;
+
+  const int x_min = static_cast<int>(exposed.left()) / extent;
+  const int x_max = static_cast<int>(exposed.right()) / extent;
+  const int y_min = static_cast<int>(exposed.top()) / extent;
+  const int y_max = static_cast<int>(exposed.bottom()) / extent;
+
+  painter->setRenderHint(QPainter::SmoothPixmapTransform, true);
+  for (int ty = y_min; ty <= y_max; ty++)
+  {
+    for (int tx = x_min; tx <= x_max; tx++)
+    {
+      const QPixmap pixmap = _tiled_image->tile(level, tx, ty);
+      if (pixmap.isNull())
+        continue;
+      // reduced tiles are stretched back over their full-resolution area
+      const double scale = static_cast<double>(1 << level);
+      painter->drawPixmap(
+        QRectF(
+          tx * extent,
+          ty * extent,
+          pixmap.width() * scale,
+          pixmap.height() * scale),
+        pixmap,
+        QRectF(0, 0, pixmap.width(), pixmap.height()));
+    }
+  }
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__TILED_PIXMAP_ITEM_HPP
+#define TRAFFIC_EDITOR__TILED_PIXMAP_ITEM_HPP
+
+#include <memory>
+#include <vector>
+
+#include <QCache>
+#include <QGraphicsItem>
+#include <QImage>
+#include <QPixmap>
+
+//=============================================================================
+/// An image pyramid for drawings too big to hold in a single QPixmap.
+/// The full-resolution image is kept as a (compact) QImage; the reduced
+/// levels are generated on first use, and the square tiles that are
+/// actually painted are converted to QPixmaps lazily and kept in an LRU
+/// cache of bounded size.
+class TiledImage
+{
+public:
+  static const int TILE_SIZE = 512;
+
+  /// Drawings with more pixels than this are rendered through a TiledImage
+  static const long long PIXEL_THRESHOLD = 4096LL * 4096LL;
+
+  explicit TiledImage(const QImage& image);
+
+  int width() const { return _levels[0].width(); }
+  int height() const { return _levels[0].height(); }
+
+  /// Number of pyramid levels. Level n is downsampled by 2^n.
+  int num_levels() const { return _num_levels; }
+
+  /// Pick the coarsest level which still has at least one image pixel
+  /// per screen pixel at this level of detail (screen pixels / image pixel)
+  int level_for_detail(const double level_of_detail) const;
+
+  /// Returns a null pixmap if the tile coordinates are out of range
+  QPixmap tile(const int level, const int tile_x, const int tile_y);
+
+  /// Full-resolution size of the image region covered by a tile of a level
+  int tile_extent(const int level) const { return TILE_SIZE << level; }
+
+private:
+  int _num_levels = 1;
+  std::vector<QImage> _levels;  // empty QImages are generated on demand
+  QCache<quint64, QPixmap> _tile_cache;
+
+  const QImage& level_image(const int level);
+};
+
+//=============================================================================
+/// Scene item that paints only the tiles of a TiledImage which are exposed,
+/// at a resolution matching the current zoom of the view.
+class TiledPixmapItem : public QGraphicsItem
+{
+public:
+  explicit TiledPixmapItem(
+    std::shared_ptr<TiledImage> tiled_image,
+    QGraphicsItem* parent = nullptr);
+
+  QRectF boundingRect() const override;
+
+  void paint(
+    QPainter* painter,
+    const QStyleOptionGraphicsItem* option,
+    QWidget* widget = nullptr) override;
+
+private:
+  std::shared_ptr<TiledImage> _tiled_image;
+};
+
+#endif
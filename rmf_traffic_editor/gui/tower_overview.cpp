@@ -0,0 +1,278 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+#include <QPainter>
+
+#include "building.h"
+#include "tower_overview.hpp"
+
+namespace {
+
+/// Reference level pixels to the plane the levels are shown in
+QTransform plane_flip(const bool y_flipped)
+{
+  return y_flipped ? QTransform() : QTransform::fromScale(1.0, -1.0);
+}
+
+}  // namespace
+
+std::vector<TowerOverview::Level> TowerOverview::levels(Building& building)
+{
+  std::vector<Level> result;
+  const int num_levels = static_cast<int>(building.levels.size());
+  if (num_levels == 0)
+    return result;
+
+  building.compile_lifts();
+  const int ref_idx = building.get_reference_level_idx();
+  const double ref_meters_per_pixel =
+    ref_idx >= 0 && ref_idx < num_levels ?
+    building.levels[ref_idx].drawing_meters_per_pixel :
+    building.levels[0].drawing_meters_per_pixel;
+
+  for (int i = 0; i < num_levels; i++)
+  {
+    const ::Level& level = building.levels[i];
+    Level l;
+    l.level_idx = i;
+    l.name = level.name;
+    l.elevation = level.elevation;
+    const Building::Transform t = building.get_transform_to_reference(i);
+    l.to_reference = QTransform(t.scale, 0.0, 0.0, t.scale, t.dx, t.dy);
+
+    for (Lift& lift : building.lifts)
+    {
+      if (!lift.reaches_level(i))
+        continue;
+      const int floor_idx = building.find_level_idx(
+        lift.reference_floor_name,
+        lift.reference_floor_idx);
+      if (floor_idx < 0)
+        continue;
+
+      // the cabin is placed on its reference floor, as in draw_lift()
+      const Building::Transform ft =
+        building.get_transform_to_reference(floor_idx);
+      const double w = lift.width / ref_meters_per_pixel;
+      const double d = lift.depth / ref_meters_per_pixel;
+      Cabin cabin;
+      cabin.lift_name = lift.name;
+      cabin.outline = QTransform()
+        .translate(ft.scale * lift.x + ft.dx, ft.scale * lift.y + ft.dy)
+        .rotateRadians(-lift.yaw)
+        .map(QPolygonF(QRectF(-w / 2.0, -d / 2.0, w, d)));
+      cabin.has_doors = lift.has_doors_on_level(i);
+      l.cabins.push_back(cabin);
+    }
+    result.push_back(l);
+  }
+
+  std::stable_sort(
+    result.begin(),
+    result.end(),
+    [](const Level& a, const Level& b)
+    {
+      return a.elevation < b.elevation;
+    });
+  return result;
+}
+
+TowerOverview::TowerOverview(QWidget* parent)
+: QWidget(parent)
+{
+}
+
+void TowerOverview::set_levels(
+  const std::vector<Level>& levels,
+  const double meters_per_pixel,
+  const bool y_flipped)
+{
+  _levels = levels;
+  _meters_per_pixel = meters_per_pixel > 0.0 ? meters_per_pixel : 0.05;
+  _y_flipped = y_flipped;
+  update();
+}
+
+void TowerOverview::set_layout(const Layout layout)
+{
+  _layout = layout;
+  update();
+}
+
+QRectF TowerOverview::plane_rect(const Level& level) const
+{
+  return plane_flip(_y_flipped).mapRect(
+    level.to_reference.mapRect(level.raster.rect));
+}
+
+QTransform TowerOverview::layout_transform(
+  const std::size_t idx,
+  const QRectF& bounds,
+  const double level_spacing) const
+{
+  const Level& level = _levels[idx];
+  if (_layout == ISOMETRIC)
+  {
+    // rotated and squashed about the middle, then raised by the elevation
+    const double height =
+      (level.elevation - _levels.front().elevation) / _meters_per_pixel;
+    const QPointF center = bounds.center();
+    return QTransform()
+      .translate(0.0, -height * level_spacing)
+      .scale(1.0, 0.5)
+      .rotate(45.0)
+      .translate(-center.x(), -center.y());
+  }
+
+  // side by side, in rows from the lowest level
+  const int columns = static_cast<int>(
+    std::ceil(std::sqrt(static_cast<double>(_levels.size()))));
+  const int column = static_cast<int>(idx) % columns;
+  const int row = static_cast<int>(idx) / columns;
+  const double gap = 0.1 * std::max(bounds.width(), bounds.height());
+  return QTransform()
+    .translate(
+      column * (bounds.width() + gap),
+      row * (bounds.height() + gap))
+    .translate(-bounds.left(), -bounds.top());
+}
+
+void TowerOverview::paintEvent(QPaintEvent*)
+{
+  QPainter painter(this);
+  painter.fillRect(rect(), QColor(64, 64, 64));
+  if (_levels.empty())
+    return;
+
+  // everything of every level, on the plane
+  const QTransform flip = plane_flip(_y_flipped);
+  QRectF bounds;
+  for (const Level& level : _levels)
+  {
+    bounds |= plane_rect(level);
+    for (const Cabin& cabin : level.cabins)
+      bounds |= flip.map(cabin.outline).boundingRect();
+  }
+  if (bounds.isEmpty())
+    return;
+
+  // the storeys are only a few meters tall, so the elevations are
+  // exaggerated until the levels are half the height of one apart
+  double level_spacing = 1.0;
+  const double elevation_range =
+    (_levels.back().elevation - _levels.front().elevation) /
+    _meters_per_pixel;
+  if (elevation_range > 0.0)
+  {
+    const double level_height =
+      QTransform().scale(1.0, 0.5).rotate(45.0).mapRect(bounds).height();
+    level_spacing = std::max(
+      1.0,
+      0.5 * level_height * (_levels.size() - 1) / elevation_range);
+  }
+
+  std::vector<QTransform> transforms;
+  QRectF extent;
+  for (std::size_t i = 0; i < _levels.size(); i++)
+  {
+    transforms.push_back(layout_transform(i, bounds, level_spacing));
+    extent |= transforms.back().mapRect(bounds);
+  }
+
+  // fit it all into the widget, keeping the aspect ratio
+  const double margin = 20.0;
+  const double scale = std::min(
+    (width() - 2.0 * margin) / extent.width(),
+    (height() - 2.0 * margin) / extent.height());
+  if (scale <= 0.0)
+    return;
+  const QTransform fit = QTransform()
+    .translate(
+      (width() - scale * extent.width()) / 2.0,
+      (height() - scale * extent.height()) / 2.0)
+    .scale(scale, scale)
+    .translate(-extent.left(), -extent.top());
+
+  painter.setRenderHint(QPainter::Antialiasing);
+  painter.setRenderHint(QPainter::SmoothPixmapTransform);
+  QPen outline_pen(QColor(200, 200, 200));
+  outline_pen.setCosmetic(true);
+  QPen cabin_pen(Qt::black);
+  cabin_pen.setCosmetic(true);
+  const QBrush doors_brush(QColor::fromRgbF(0.5, 1.0, 0.5, 0.8));
+  const QBrush no_doors_brush(QColor::fromRgbF(1.0, 0.3, 0.3, 0.8));
+
+  // lowest first, so that each level covers the ones below it
+  std::map<std::string, QPointF> last_cabin_centers;
+  std::vector<QLineF> shafts;
+  for (std::size_t i = 0; i < _levels.size(); i++)
+  {
+    const Level& level = _levels[i];
+    const QTransform t = transforms[i] * fit;
+    const QRectF r = plane_rect(level);
+    painter.setTransform(t);
+
+    if (level.raster.is_valid())
+    {
+      painter.setOpacity(0.85);
+      painter.drawImage(r, level.raster.image);
+      painter.setOpacity(1.0);
+    }
+    painter.setPen(outline_pen);
+    painter.setBrush(Qt::NoBrush);
+    painter.drawRect(r);
+
+    painter.setPen(cabin_pen);
+    for (const Cabin& cabin : level.cabins)
+    {
+      const QPolygonF outline = flip.map(cabin.outline);
+      painter.setBrush(cabin.has_doors ? doors_brush : no_doors_brush);
+      painter.drawPolygon(outline);
+
+      const QPointF center = t.map(outline.boundingRect().center());
+      auto it = last_cabin_centers.find(cabin.lift_name);
+      if (it != last_cabin_centers.end())
+        shafts.push_back(QLineF(it->second, center));
+      last_cabin_centers[cabin.lift_name] = center;
+    }
+
+    // the name beside the leftmost corner of the level
+    painter.resetTransform();
+    const QPolygonF corners = t.map(QPolygonF(r));
+    QPointF anchor = corners.isEmpty() ? QPointF() : corners[0];
+    for (const QPointF& p : corners)
+    {
+      if (p.x() < anchor.x())
+        anchor = p;
+    }
+    painter.setPen(QColor(Qt::white));
+    painter.drawText(
+      anchor + QPointF(4.0, -4.0),
+      QString::fromStdString(level.name));
+  }
+
+  QPen shaft_pen(QColor(255, 255, 0), 1.5, Qt::DashLine);
+  shaft_pen.setCosmetic(true);
+  painter.setPen(shaft_pen);
+  for (const QLineF& shaft : shafts)
+    painter.drawLine(shaft);
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef TRAFFIC_EDITOR__TOWER_OVERVIEW_HPP
+#define TRAFFIC_EDITOR__TOWER_OVERVIEW_HPP
+
+#include <string>
+#include <vector>
+
+#include <QPolygonF>
+#include <QTransform>
+#include <QWidget>
+
+#include "minimap.hpp"
+
+class Building;
+
+//=============================================================================
+/// All levels of a building at once, for checking that lifts and shafts
+/// line up through the floors: stacked at their elevations in an isometric
+/// view, or side by side. Each level is its minimap raster, placed on the
+/// reference level through the fiducial transform of the level, with the
+/// lift cabins outlined on it as vectors (green where the lift has doors)
+/// and joined from floor to floor. The whole tower is one paint of a few
+/// dozen small images.
+class TowerOverview : public QWidget
+{
+public:
+  enum Layout
+  {
+    ISOMETRIC = 0,
+    SIDE_BY_SIDE
+  };
+
+  struct Cabin
+  {
+    std::string lift_name;
+    QPolygonF outline;  // in pixels of the reference level
+    bool has_doors = false;
+  };
+
+  struct Level
+  {
+    int level_idx = -1;  // in Building::levels
+    std::string name;
+    double elevation = 0.0;
+    QTransform to_reference;  // from the pixels of the level
+    std::vector<Cabin> cabins;
+    Minimap::Raster raster;  // in the pixels of the level
+  };
+
+  /// Everything but the rasters, which the caller takes from its cache or
+  /// renders with Minimap::render(), sorted by elevation
+  static std::vector<Level> levels(Building& building);
+
+  TowerOverview(QWidget* parent = nullptr);
+
+  void set_levels(
+    const std::vector<Level>& levels,
+    const double meters_per_pixel,
+    const bool y_flipped);
+
+  void set_layout(const Layout layout);
+
+  QSize sizeHint() const override { return QSize(800, 800); }
+
+protected:
+  void paintEvent(QPaintEvent* e) override;
+
+private:
+  std::vector<Level> _levels;
+  double _meters_per_pixel = 0.05;  // of the reference level
+  bool _y_flipped = true;
+  Layout _layout = ISOMETRIC;
+
+  /// Where the raster of a level goes, in the reference level's pixels as
+  /// the map view shows them (so with +Y up unless it is y-flipped)
+  QRectF plane_rect(const Level& level) const;
+
+  /// From that plane to the overview, for one level of the layout
+  QTransform layout_transform(
+    const std::size_t idx,
+    const QRectF& bounds,
+    const double level_spacing) const;
+};
+
+#endif
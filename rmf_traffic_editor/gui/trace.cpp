@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <QCoreApplication>
+#include <QThread>
+
+#include "trace.hpp"
+
+namespace {
+
+struct Event
+{
+  const char* name;  // nullptr if the name is in dynamic_name
+  std::string dynamic_name;
+  int64_t begin;
+  int64_t end;
+};
+
+struct ThreadBuffer
+{
+  int tid = 0;
+  std::string name;
+  std::mutex mutex;  // only contended while saving
+  std::vector<Event> events;
+  std::size_t dropped = 0;
+};
+
+// a little under 64 MB per thread, which is hours of editing
+const std::size_t MAX_EVENTS_PER_THREAD = 1024 * 1024;
+
+std::atomic<bool> recording(false);
+std::atomic<int64_t> start_time(0);
+
+// buffers stay here after their thread exits, so its zones are kept
+std::mutex registry_mutex;
+std::vector<std::shared_ptr<ThreadBuffer>> registry;
+
+ThreadBuffer& this_thread_buffer()
+{
+  thread_local std::shared_ptr<ThreadBuffer> buffer;
+  if (!buffer)
+  {
+    buffer = std::make_shared<ThreadBuffer>();
+    QThread* thread = QThread::currentThread();
+    if (QCoreApplication::instance() &&
+      thread == QCoreApplication::instance()->thread())
+      buffer->name = "main";
+    else if (thread && !thread->objectName().isEmpty())
+      buffer->name = thread->objectName().toStdString();
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    buffer->tid = static_cast<int>(registry.size()) + 1;
+    if (buffer->name.empty())
+      buffer->name = "thread " + std::to_string(buffer->tid);
+    registry.push_back(buffer);
+  }
+  return *buffer;
+}
+
+void append(const char* name, const std::string* dynamic_name, int64_t begin)
+{
+  if (!recording)
+    return;
+  const int64_t end = Trace::now();
+  begin = std::max(begin, start_time.load());
+
+  ThreadBuffer& buffer = this_thread_buffer();
+  std::lock_guard<std::mutex> lock(buffer.mutex);
+  if (buffer.events.size() >= MAX_EVENTS_PER_THREAD)
+  {
+    buffer.dropped++;
+    return;
+  }
+  buffer.events.push_back(
+    Event{name, dynamic_name ? *dynamic_name : std::string(), begin, end});
+}
+
+void write_json_string(FILE* file, const char* s)
+{
+  fputc('"', file);
+  for (; *s; s++)
+  {
+    const unsigned char c = static_cast<unsigned char>(*s);
+    if (c == '"' || c == '\\')
+      fprintf(file, "\\%c", c);
+    else if (c < 0x20)
+      fprintf(file, "\\u%04x", c);
+    else
+      fputc(c, file);
+  }
+  fputc('"', file);
+}
+
+}  // namespace
+
+int64_t Trace::now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool Trace::is_recording()
+{
+  return recording;
+}
+
+void Trace::start()
+{
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  for (const std::shared_ptr<ThreadBuffer>& buffer : registry)
+  {
+    std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+    buffer->events.clear();
+    buffer->dropped = 0;
+  }
+  start_time = now();
+  recording = true;
+}
+
+bool Trace::save(const std::string& path)
+{
+  recording = false;
+
+  FILE* file = fopen(path.c_str(), "w");
+  if (!file)
+  {
+    printf("unable to write trace to %s\n", path.c_str());
+    return false;
+  }
+
+  const int64_t t0 = start_time;
+  std::size_t num_events = 0;
+  std::size_t num_dropped = 0;
+  bool first = true;
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  for (const std::shared_ptr<ThreadBuffer>& buffer : registry)
+  {
+    std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+    if (buffer->events.empty())
+      continue;
+
+    fprintf(file,
+      "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+      "\"args\":{\"name\":",
+      first ? "" : ",\n",
+      buffer->tid);
+    write_json_string(file, buffer->name.c_str());
+    fprintf(file, "}}");
+    first = false;
+
+    for (const Event& event : buffer->events)
+    {
+      fprintf(file, ",\n{\"name\":");
+      write_json_string(
+        file,
+        event.name ? event.name : event.dynamic_name.c_str());
+      fprintf(file,
+        ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+        buffer->tid,
+        (event.begin - t0) / 1e3,
+        (event.end - event.begin) / 1e3);
+    }
+    num_events += buffer->events.size();
+    num_dropped += buffer->dropped;
+  }
+  fprintf(file, "\n]}\n");
+
+  const bool ok = !ferror(file);
+  if (fclose(file) != 0 || !ok)
+  {
+    printf("unable to write trace to %s\n", path.c_str());
+    return false;
+  }
+  printf("wrote %d trace events to %s",
+    static_cast<int>(num_events),
+    path.c_str());
+  if (num_dropped)
+    printf(" (%d dropped, over the limit per thread)",
+      static_cast<int>(num_dropped));
+  printf("\n");
+  return true;
+}
+
+void Trace::add_zone(const char* name, const int64_t begin)
+{
+  append(name, nullptr, begin);
+}
+
+void Trace::add_zone(const std::string& name, const int64_t begin)
+{
+  append(nullptr, &name, begin);
+}
+
+Trace::Zone::Zone(const char* name)
+{
+  if (!recording)
+    return;
+  _name = name;
+  _begin = now();
+}
+
+Trace::Zone::Zone(const std::string& name)
+{
+  if (!recording)
+    return;
+  _dynamic_name = name;
+  _begin = now();
+}
+
+Trace::Zone::~Zone()
+{
+  if (_begin < 0)
+    return;
+  if (_name)
+    append(_name, nullptr, _begin);
+  else
+    append(nullptr, &_dynamic_name, _begin);
+}
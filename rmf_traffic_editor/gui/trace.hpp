@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef TRAFFIC_EDITOR__TRACE_HPP
+#define TRAFFIC_EDITOR__TRACE_HPP
+
+#include <cstdint>
+#include <string>
+
+//=============================================================================
+/// Records timed zones from any thread and writes them as a Chrome trace
+/// (JSON "traceEvents", which chrome://tracing and Perfetto open), to see
+/// exactly where an edit that feels slow spends its time. Zones are only
+/// recorded between start() and save(); each thread appends to its own
+/// buffer, so recording takes no shared lock.
+///
+/// The TRACE_ZONE() macro, which the hot paths use, only exists when
+/// building with -DTRAFFIC_EDITOR_TRACING=ON (see CMakeLists.txt), and
+/// compiles to nothing otherwise.
+class Trace
+{
+public:
+  /// Discard whatever was recorded and start recording
+  static void start();
+
+  /// Stop recording and write everything recorded to path
+  static bool save(const std::string& path);
+
+  static bool is_recording();
+
+  /// Nanoseconds on the clock of the trace
+  static int64_t now();
+
+  /// Add a zone which began at begin (from now()) and ends now
+  static void add_zone(const char* name, const int64_t begin);
+  static void add_zone(const std::string& name, const int64_t begin);
+
+  /// Records a zone from its construction to its destruction
+  class Zone
+  {
+  public:
+    explicit Zone(const char* name);
+    explicit Zone(const std::string& name);
+    ~Zone();
+
+    Zone(const Zone&) = delete;
+    Zone& operator=(const Zone&) = delete;
+
+  private:
+    const char* _name = nullptr;
+    std::string _dynamic_name;  // when the name can't outlive the zone
+    int64_t _begin = -1;  // -1 when not recording
+  };
+};
+
+#define TRACE_ZONE_CONCAT_(a, b) a ## b
+#define TRACE_ZONE_CONCAT(a, b) TRACE_ZONE_CONCAT_(a, b)
+
+#ifdef TRAFFIC_EDITOR_TRACING
+#define TRACE_ZONE(name) \
+  Trace::Zone TRACE_ZONE_CONCAT(trace_zone_, __LINE__)(name)
+#else
+#define TRACE_ZONE(name) static_cast<void>(0)
+#endif
+
+#endif
@@ -15,16 +15,96 @@
  *
 */
 
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <QGraphicsPathItem>
+#include <QPen>
+
+#include "logging.hpp"
 #include "traffic_map.h"
 #include <yaml-cpp/yaml.h>
 
 using std::string;
 
-TrafficMap::TrafficMap()
+namespace {
+
+/// The last parse of each file, by absolute path. Only used from the GUI
+/// thread.
+struct ParsedFile
+{
+  QDateTime modified;
+  qint64 size = -1;
+  std::shared_ptr<const TrafficMap::Geometry> geometry;
+};
+
+std::map<QString, ParsedFile>& parsed_files()
 {
+  static std::map<QString, ParsedFile> files;
+  return files;
 }
 
-TrafficMap::~TrafficMap()
+/// The lanes of the levels of a building-style file: each level has
+/// vertices of [x, y, ...] and lanes of [start, end, ...]
+std::shared_ptr<const TrafficMap::Geometry> parse(const string& filename)
+{
+  YAML::Node y;
+  try
+  {
+    y = YAML::LoadFile(filename.c_str());
+  }
+  catch (const std::exception& e)
+  {
+    qCWarning(lc_io, "couldn't parse %s: %s", filename.c_str(), e.what());
+    return nullptr;
+  }
+
+  auto geometry = std::make_shared<TrafficMap::Geometry>();
+  if (!y["levels"] || !y["levels"].IsMap())
+    return geometry;
+  try
+  {
+    for (YAML::const_iterator it = y["levels"].begin();
+      it != y["levels"].end(); ++it)
+    {
+      const YAML::Node& vertices = it->second["vertices"];
+      const YAML::Node& lanes = it->second["lanes"];
+      if (!vertices.IsSequence() || !lanes.IsSequence())
+        continue;
+
+      std::vector<QPointF> points;
+      points.reserve(vertices.size());
+      for (const YAML::Node& v : vertices)
+        points.push_back(QPointF(v[0].as<double>(), v[1].as<double>()));
+
+      QPainterPath& path = geometry->levels[it->first.as<string>()];
+      for (const YAML::Node& lane : lanes)
+      {
+        const std::size_t start = lane[0].as<std::size_t>();
+        const std::size_t end = lane[1].as<std::size_t>();
+        if (start >= points.size() || end >= points.size())
+          continue;
+        path.moveTo(points[start]);
+        path.lineTo(points[end]);
+        geometry->num_lanes++;
+      }
+    }
+  }
+  catch (const std::exception& e)
+  {
+    qCWarning(lc_io,
+      "couldn't read the lanes of %s: %s", filename.c_str(), e.what());
+    return nullptr;
+  }
+  qCDebug(lc_io, "parsed traffic-map file %s: %d lanes",
+    filename.c_str(),
+    geometry->num_lanes);
+  return geometry;
+}
+
+}  // anonymous namespace
+
+TrafficMap::TrafficMap()
 {
 }
 
@@ -38,32 +118,56 @@ bool TrafficMap::from_project_yaml(const string& _name, const YAML::Node& y)
     y_offset = y["offset"][1].as<double>();
   }
 
-  // todo: open 'filename' and load its contents
+  if (y["visible"])
+    visible = y["visible"].as<bool>();
+
+  // the file itself is parsed when the overlay is first shown
   if (y["filename"])
-  {
     filename = y["filename"].as<string>();
-    return load_file();
-  }
 
   return true;
 }
 
 bool TrafficMap::load_file()
 {
-  printf("Building::load_yaml_file(%s)\n", filename.c_str());
-  YAML::Node y;
-  try
-  {
-    y = YAML::LoadFile(filename.c_str());
-  }
-  catch (const std::exception& e)
+  return geometry() != nullptr;
+}
+
+std::shared_ptr<const TrafficMap::Geometry> TrafficMap::geometry() const
+{
+  if (filename.empty())
+    return nullptr;
+  const QFileInfo info(QString::fromStdString(filename));
+  if (!info.exists())
+    return nullptr;
+
+  ParsedFile& parsed = parsed_files()[info.absoluteFilePath()];
+  if (!parsed.geometry || parsed.modified != info.lastModified() ||
+    parsed.size != info.size())
   {
-    printf("couldn't parse %s: %s", filename.c_str(), e.what());
-    return false;
+    parsed.geometry = parse(info.absoluteFilePath().toStdString());
+    parsed.modified = info.lastModified();
+    parsed.size = info.size();
   }
-  printf("parsed traffic-map file %s\n", filename.c_str());
+  return parsed.geometry;
+}
 
-  return true;
+QGraphicsPathItem* TrafficMap::create_item(const string& level_name) const
+{
+  const std::shared_ptr<const Geometry> parsed = geometry();
+  if (!parsed)
+    return nullptr;
+  const auto it = parsed->levels.find(level_name);
+  if (it == parsed->levels.end() || it->second.isEmpty())
+    return nullptr;
+
+  QGraphicsPathItem* item = new QGraphicsPathItem(it->second);
+  QPen pen(QColor::fromRgbF(0.6, 0.2, 0.8, 0.7), 2.0);
+  pen.setCosmetic(true);  // readable at every zoom
+  item->setPen(pen);
+  item->setPos(x_offset, y_offset);
+  item->setZValue(9.0);  // over the lanes of the level
+  return item;
 }
 
 YAML::Node TrafficMap::to_project_yaml() const
@@ -73,5 +177,7 @@ YAML::Node TrafficMap::to_project_yaml() const
   y["offset"].push_back(x_offset);
   y["offset"].push_back(y_offset);
   y["offset"].SetStyle(YAML::EmitterStyle::Flow);
+  if (!visible)
+    y["visible"] = false;
   return y;
 }
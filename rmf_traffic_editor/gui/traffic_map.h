@@ -18,9 +18,19 @@
 #ifndef TRAFFIC_MAP_H
 #define TRAFFIC_MAP_H
 
+#include <map>
+#include <memory>
 #include <string>
 #include <yaml-cpp/yaml.h>
 
+#include <QPainterPath>
+
+class QGraphicsPathItem;
+
+/// An external traffic map, drawn over the levels of the same name as an
+/// overlay of its lanes. The file is only parsed when the overlay is
+/// first shown, and what was parsed is shared by every map of the file
+/// until the file is modified.
 class TrafficMap
 {
 public:
@@ -30,14 +40,30 @@ public:
   double y_offset = 0;
   bool visible = true;
 
+  /// The lanes of each level of a file, in pixels, one path per level
+  struct Geometry
+  {
+    std::map<std::string, QPainterPath> levels;
+    int num_lanes = 0;
+  };
+
   /////////////////////////////////
   TrafficMap();
-  ~TrafficMap();
 
   bool from_project_yaml(const std::string& name, const YAML::Node& data);
   YAML::Node to_project_yaml() const;
 
+  /// Parse the file now, if it wasn't already; returns false if it can't
   bool load_file();
+
+  /// What the file draws, parsed again only if its modification time or
+  /// size changed since it was last parsed; nullptr if it can't be read
+  std::shared_ptr<const Geometry> geometry() const;
+
+  /// The overlay of the lanes on a level, as one path item at the offset,
+  /// for the caller to add to the scene and then show and hide with
+  /// setVisible(); nullptr if the map has nothing on the level
+  QGraphicsPathItem* create_item(const std::string& level_name) const;
 };
 
 #endif
@@ -86,12 +86,13 @@ void TrafficMapDialog::ok_button_clicked()
     return;
   }
 
-  if (!path_line_edit->text().endsWith(".traffic_map.yaml"))
+  if (!path_line_edit->text().endsWith(".traffic_map.yaml") &&
+    !path_line_edit->text().endsWith(".building.yaml"))
   {
     QMessageBox::critical(
       this,
       "Bad filename",
-      "Filename must end in .traffic_map.yaml");
+      "Filename must end in .traffic_map.yaml or .building.yaml");
     return;
   }
 
@@ -104,7 +105,7 @@ void TrafficMapDialog::path_button_clicked()
 {
   QFileDialog file_dialog(this, "Traffic Map File");
   //file_dialog.setFileMode(QFileDialog::ExistingFile);
-  file_dialog.setNameFilter("*.traffic_map.yaml");
+  file_dialog.setNameFilter("*.traffic_map.yaml *.building.yaml");
   if (file_dialog.exec() != QDialog::Accepted)
     return;// user clicked 'cancel' in the QFileDialog
   const QString filename = file_dialog.selectedFiles().first();
@@ -22,6 +22,7 @@
 #include "traffic_map.h"
 class QLineEdit;
 class QComboBox;
+class QPushButton;
 
 
 class TrafficMapDialog : public QDialog
@@ -34,10 +35,12 @@ private:
   TrafficMap& traffic_map;
 
   QLineEdit* name_line_edit;
+  QLineEdit* path_line_edit;
   QPushButton* ok_button, * cancel_button;
 
 private slots:
   void ok_button_clicked();
+  void path_button_clicked();
 };
 
 #endif
@@ -0,0 +1,519 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <tuple>
+#include <unordered_map>
+
+#include <QThread>
+
+#include "building.h"
+#include "segment_rtree.hpp"
+#include "task_pool.hpp"
+#include "traffic_preview.hpp"
+
+using std::vector;
+
+namespace {
+
+/// Something robots take for a while: a vertex, a lane (by its ends, the
+/// lower first) or a door
+struct Resource
+{
+  int kind = 0;  // a TrafficPreview::ConflictKind
+  int level_idx = 0;
+  int a = 0;
+  int b = 0;
+
+  bool operator<(const Resource& other) const
+  {
+    return std::tie(kind, level_idx, a, b) <
+      std::tie(other.kind, other.level_idx, other.a, other.b);
+  }
+
+  bool operator==(const Resource& other) const
+  {
+    return kind == other.kind && level_idx == other.level_idx &&
+      a == other.a && b == other.b;
+  }
+};
+
+struct Interval
+{
+  Resource resource;
+  double start = 0.0;
+  double end = 0.0;
+  int robot = 0;
+  bool forward = true;  // along a lane from its lower vertex to the other
+
+  bool operator<(const Interval& other) const
+  {
+    if (resource == other.resource)
+      return start < other.start;
+    return resource < other.resource;
+  }
+};
+
+/// Where along the first segment it crosses the second, from 0 to 1
+bool crossing(
+  const SegmentRTree::Segment& s,
+  const SegmentRTree::Segment& t,
+  double& fraction)
+{
+  const double dx = s.x1 - s.x0;
+  const double dy = s.y1 - s.y0;
+  const double ex = t.x1 - t.x0;
+  const double ey = t.y1 - t.y0;
+  const double denominator = dx * ey - dy * ex;
+  if (std::abs(denominator) < 1e-12)
+    return false;  // parallel
+  const double fx = t.x0 - s.x0;
+  const double fy = t.y0 - s.y0;
+  const double u = (fx * ey - fy * ex) / denominator;
+  const double v = (fx * dy - fy * dx) / denominator;
+  if (u < 0.0 || u > 1.0 || v < 0.0 || v > 1.0)
+    return false;
+  fraction = u;
+  return true;
+}
+
+double elapsed_ms(const std::chrono::steady_clock::time_point& start)
+{
+  return std::chrono::duration<double, std::milli>(
+    std::chrono::steady_clock::now() - start).count();
+}
+
+}  // namespace
+
+//=============================================================================
+const char* TrafficPreview::conflict_kind_name(const ConflictKind kind)
+{
+  switch (kind)
+  {
+    case VERTEX:
+      return "vertex";
+    case HEAD_ON:
+      return "head-on";
+    case DOOR:
+      return "door";
+    default:
+      return "unknown";
+  }
+}
+
+bool TrafficPreview::parse_missions(
+  const YAML::Node& node,
+  Missions& missions,
+  std::string& error)
+{
+  missions = Missions();
+  try
+  {
+    if (!node.IsMap() || !node["robots"] || !node["robots"].IsSequence())
+    {
+      error = "expected a map with a list of robots";
+      return false;
+    }
+    if (node["speed"])
+      missions.planner.speed = node["speed"].as<double>();
+    if (node["graph"])
+      missions.planner.graph_idx = node["graph"].as<int>();
+    if (node["clearance"])
+      missions.options.clearance = node["clearance"].as<double>();
+    if (node["door_time"])
+      missions.options.door_time = node["door_time"].as<double>();
+    const double dwell =
+      node["dwell"] ? node["dwell"].as<double>() : Robot().dwell;
+
+    for (const YAML::Node& robot_node : node["robots"])
+    {
+      Robot robot;
+      robot.dwell = dwell;
+      robot.name = robot_node["name"] ?
+        robot_node["name"].as<std::string>() :
+        "robot " + std::to_string(missions.robots.size() + 1);
+      if (!robot_node["start"])
+      {
+        error = robot.name + " has no start";
+        return false;
+      }
+      robot.start = robot_node["start"].as<std::string>();
+      if (robot_node["start_time"])
+        robot.start_time = robot_node["start_time"].as<double>();
+      if (robot_node["dwell"])
+        robot.dwell = robot_node["dwell"].as<double>();
+      if (robot_node["stops"])
+      {
+        for (const YAML::Node& stop : robot_node["stops"])
+          robot.stops.push_back(stop.as<std::string>());
+      }
+      missions.robots.push_back(robot);
+    }
+  }
+  catch (const YAML::Exception& e)
+  {
+    error = e.what();
+    return false;
+  }
+  if (missions.planner.speed <= 0.0)
+  {
+    error = "the speed must be positive";
+    return false;
+  }
+  return true;
+}
+
+TrafficPreview::Result TrafficPreview::run(
+  Building& building,
+  const Missions& missions)
+{
+  Result result;
+  const auto plan_start_time = std::chrono::steady_clock::now();
+  const double infinity = std::numeric_limits<double>::infinity();
+  const Options& options = missions.options;
+
+  std::unordered_map<std::string, LanePathPlanner::Stop> names;
+  for (std::size_t i = 0; i < building.levels.size(); i++)
+  {
+    const Level& level = building.levels[i];
+    for (std::size_t j = 0; j < level.vertices.size(); j++)
+    {
+      if (level.vertices[j].name.empty())
+        continue;
+      LanePathPlanner::Stop stop;
+      stop.level_idx = static_cast<int>(i);
+      stop.vertex_idx = static_cast<int>(j);
+      names.emplace(level.vertices[j].name, stop);  // the first one wins
+    }
+  }
+
+  // the doors of each level, for the lanes through them
+  vector<vector<SegmentRTree::Segment>> doors(building.levels.size());
+  vector<SegmentRTree> door_trees(building.levels.size());
+  for (std::size_t i = 0; i < building.levels.size(); i++)
+  {
+    const Level& level = building.levels[i];
+    const int num_vertices = static_cast<int>(level.vertices.size());
+    doors[i].resize(level.edges.size());
+    vector<std::pair<int, SegmentRTree::Segment>> entries;
+    for (std::size_t j = 0; j < level.edges.size(); j++)
+    {
+      const Edge& edge = level.edges[j];
+      if (edge.type != Edge::DOOR ||
+        edge.start_idx < 0 || edge.start_idx >= num_vertices ||
+        edge.end_idx < 0 || edge.end_idx >= num_vertices)
+        continue;
+      SegmentRTree::Segment& door = doors[i][j];
+      door.x0 = level.vertices[edge.start_idx].x;
+      door.y0 = level.vertices[edge.start_idx].y;
+      door.x1 = level.vertices[edge.end_idx].x;
+      door.y1 = level.vertices[edge.end_idx].y;
+      entries.emplace_back(static_cast<int>(j), door);
+    }
+    door_trees[i].build(entries);
+  }
+
+  LanePathPlanner planner;
+  planner.set_options(missions.planner);
+  planner.update(building);
+
+  const int num_robots = static_cast<int>(missions.robots.size());
+  result.plans.resize(num_robots);
+  vector<vector<Interval>> robot_intervals(num_robots);
+
+  auto plan_robot = [&](LanePathPlanner& robot_planner, const int r)
+    {
+      const Robot& robot = missions.robots[r];
+      Plan& plan = result.plans[r];
+      plan.name = robot.name;
+      auto waypoint = [&building](const LanePathPlanner::Stop& stop)
+        {
+          const Vertex& vertex =
+            building.levels[stop.level_idx].vertices[stop.vertex_idx];
+          Waypoint w;
+          w.level_idx = stop.level_idx;
+          w.vertex_idx = stop.vertex_idx;
+          w.x = vertex.x;
+          w.y = vertex.y;
+          return w;
+        };
+
+      auto start_it = names.find(robot.start);
+      if (start_it == names.end())
+      {
+        plan.error = "no vertex named " + robot.start;
+        return;
+      }
+      LanePathPlanner::Stop at = start_it->second;
+      plan.waypoints.push_back(waypoint(at));
+      plan.waypoints.back().depart = robot.start_time;
+      for (const std::string& name : robot.stops)
+      {
+        auto it = names.find(name);
+        if (it == names.end())
+        {
+          plan.error = "no vertex named " + name;
+          break;
+        }
+        const LanePathPlanner::Stop& to = it->second;
+        if (!(to == at))
+        {
+          const LanePathPlanner::Route route = robot_planner.plan(at, to);
+          if (!route.found)
+          {
+            plan.error = "no route to " + name;
+            break;
+          }
+          const double t0 = plan.waypoints.back().depart;
+          for (std::size_t k = 1; k < route.stops.size(); k++)
+          {
+            Waypoint w = waypoint(route.stops[k]);
+            w.arrive = w.depart = t0 + route.times[k];
+            plan.waypoints.push_back(w);
+          }
+          at = to;
+        }
+        plan.waypoints.back().depart += robot.dwell;
+      }
+      plan.waypoints.back().depart = infinity;  // parked
+
+      vector<Interval>& intervals = robot_intervals[r];
+      for (std::size_t k = 0; k < plan.waypoints.size(); k++)
+      {
+        const Waypoint& w = plan.waypoints[k];
+        Interval vertex;
+        vertex.resource.kind = VERTEX;
+        vertex.resource.level_idx = w.level_idx;
+        vertex.resource.a = w.vertex_idx;
+        vertex.start = w.arrive - options.clearance;
+        vertex.end = w.depart + options.clearance;
+        vertex.robot = r;
+        intervals.push_back(vertex);
+        if (k + 1 == plan.waypoints.size())
+          break;
+
+        const Waypoint& next = plan.waypoints[k + 1];
+        if (next.level_idx != w.level_idx)
+          continue;  // a lift ride
+        Interval lane;
+        lane.resource.kind = HEAD_ON;
+        lane.resource.level_idx = w.level_idx;
+        lane.resource.a = std::min(w.vertex_idx, next.vertex_idx);
+        lane.resource.b = std::max(w.vertex_idx, next.vertex_idx);
+        lane.start = w.depart;
+        lane.end = next.arrive;
+        lane.robot = r;
+        lane.forward = w.vertex_idx < next.vertex_idx;
+        intervals.push_back(lane);
+
+        SegmentRTree::Segment hop;
+        hop.x0 = w.x;
+        hop.y0 = w.y;
+        hop.x1 = next.x;
+        hop.y1 = next.y;
+        vector<int> ids;
+        door_trees[w.level_idx].intersecting(
+          std::min(hop.x0, hop.x1),
+          std::min(hop.y0, hop.y1),
+          std::max(hop.x0, hop.x1),
+          std::max(hop.y0, hop.y1),
+          ids);
+        for (const int door_idx : ids)
+        {
+          double fraction = 0.0;
+          if (!crossing(hop, doors[w.level_idx][door_idx], fraction))
+            continue;
+          const double t = w.depart + fraction * (next.arrive - w.depart);
+          Interval door;
+          door.resource.kind = DOOR;
+          door.resource.level_idx = w.level_idx;
+          door.resource.a = door_idx;
+          door.start = t - options.door_time;
+          door.end = t + options.door_time;
+          door.robot = r;
+          intervals.push_back(door);
+        }
+      }
+    };
+
+  // a copy of the planner for each block of robots, as its searches keep
+  // their state in it
+  TaskPool& pool = TaskPool::instance();
+  const int num_blocks =
+    std::min(num_robots, std::max(1, 2 * QThread::idealThreadCount()));
+  pool.parallel_for(
+    num_blocks,
+    [&](const int b)
+    {
+      LanePathPlanner block_planner = planner;
+      for (int r = num_robots * b / num_blocks;
+        r < num_robots * (b + 1) / num_blocks; r++)
+        plan_robot(block_planner, r);
+    });
+
+  for (const Plan& plan : result.plans)
+  {
+    if (!plan.error.empty())
+      result.num_failed++;
+    if (!plan.waypoints.empty())
+      result.end_time = std::max(result.end_time, plan.waypoints.back().arrive);
+  }
+  result.plan_ms = elapsed_ms(plan_start_time);
+
+  const auto check_start_time = std::chrono::steady_clock::now();
+  vector<Interval> intervals;
+  for (vector<Interval>& robot : robot_intervals)
+  {
+    intervals.insert(intervals.end(), robot.begin(), robot.end());
+    vector<Interval>().swap(robot);
+  }
+  std::sort(intervals.begin(), intervals.end());
+  result.num_intervals = intervals.size();
+
+  vector<std::size_t> group_starts;
+  for (std::size_t i = 0; i < intervals.size(); i++)
+  {
+    if (i == 0 || !(intervals[i].resource == intervals[i - 1].resource))
+      group_starts.push_back(i);
+  }
+  group_starts.push_back(intervals.size());
+  const int num_groups = static_cast<int>(group_starts.size()) - 1;
+
+  // sweep the intervals of each resource in order of their start, keeping
+  // those which haven't ended yet
+  const int num_chunks =
+    std::min(num_groups, std::max(1, 8 * QThread::idealThreadCount()));
+  vector<vector<Conflict>> chunk_conflicts(num_chunks);
+  pool.parallel_for(
+    num_chunks,
+    [&](const int c)
+    {
+      vector<Conflict>& conflicts = chunk_conflicts[c];
+      vector<std::size_t> active;
+      for (int g = num_groups * c / num_chunks;
+        g < num_groups * (c + 1) / num_chunks; g++)
+      {
+        active.clear();
+        for (std::size_t i = group_starts[g]; i < group_starts[g + 1]; i++)
+        {
+          const Interval& interval = intervals[i];
+          active.erase(
+            std::remove_if(
+              active.begin(),
+              active.end(),
+              [&](const std::size_t j)
+              {
+                return intervals[j].end <= interval.start;
+              }),
+            active.end());
+          for (const std::size_t j : active)
+          {
+            const Interval& other = intervals[j];
+            if (other.robot == interval.robot)
+              continue;
+            if (interval.resource.kind == HEAD_ON &&
+              other.forward == interval.forward)
+              continue;  // following along the lane
+            Conflict conflict;
+            conflict.kind = static_cast<ConflictKind>(interval.resource.kind);
+            conflict.robot_a = std::min(other.robot, interval.robot);
+            conflict.robot_b = std::max(other.robot, interval.robot);
+            conflict.start = interval.start;
+            conflict.end = std::min(interval.end, other.end);
+            conflict.level_idx = interval.resource.level_idx;
+            if (conflict.kind == DOOR)
+              conflict.edge_idx = interval.resource.a;
+            else
+            {
+              conflict.vertex_idx = interval.resource.a;
+              if (conflict.kind == HEAD_ON)
+                conflict.other_vertex_idx = interval.resource.b;
+            }
+            conflicts.push_back(conflict);
+          }
+          active.push_back(i);
+        }
+      }
+    });
+
+  for (vector<Conflict>& conflicts : chunk_conflicts)
+  {
+    for (const Conflict& conflict : conflicts)
+      result.num_by_kind[conflict.kind]++;
+    result.conflicts.insert(
+      result.conflicts.end(), conflicts.begin(), conflicts.end());
+  }
+  result.num_conflicts = result.conflicts.size();
+  std::sort(
+    result.conflicts.begin(),
+    result.conflicts.end(),
+    [](const Conflict& a, const Conflict& b)
+    {
+      return a.start < b.start;
+    });
+  if (result.conflicts.size() > options.max_conflicts)
+    result.conflicts.resize(options.max_conflicts);
+  result.check_ms = elapsed_ms(check_start_time);
+  return result;
+}
+
+bool TrafficPreview::position(
+  const Plan& plan,
+  const double time,
+  int& level_idx,
+  double& x,
+  double& y)
+{
+  if (plan.waypoints.empty())
+    return false;
+
+  // the last waypoint reached by then, or the first
+  auto it = std::upper_bound(
+    plan.waypoints.begin(),
+    plan.waypoints.end(),
+    time,
+    [](const double t, const Waypoint& w)
+    {
+      return t < w.arrive;
+    });
+  if (it != plan.waypoints.begin())
+    --it;
+  const Waypoint& w = *it;
+  if (time <= w.depart || it + 1 == plan.waypoints.end())
+  {
+    level_idx = w.level_idx;
+    x = w.x;
+    y = w.y;
+    return true;
+  }
+
+  const Waypoint& next = *(it + 1);
+  level_idx = next.level_idx;
+  if (next.level_idx != w.level_idx || next.arrive <= w.depart)
+  {
+    x = next.x;  // in the lift
+    y = next.y;
+    return true;
+  }
+  const double f = (time - w.depart) / (next.arrive - w.depart);
+  x = w.x + f * (next.x - w.x);
+  y = w.y + f * (next.y - w.y);
+  return true;
+}
@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__TRAFFIC_PREVIEW_HPP
+#define TRAFFIC_EDITOR__TRAFFIC_PREVIEW_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <yaml-cpp/yaml.h>
+
+#include "lane_path_planner.hpp"
+
+class Building;
+
+//=============================================================================
+/// What a fleet would run into on the lanes if it drove a set of missions:
+/// each robot starts at a named vertex and visits named vertices in turn,
+/// taking the quickest route along the lanes to each (see LanePathPlanner)
+/// and waiting there for a while, then stays parked at the last one. The
+/// routes are timed by the lane speed limits, and robots conflict where
+/// two of them are at a vertex at once (give or take the clearance),
+/// drive along a lane towards each other, or pass through a door at once.
+///
+/// Each vertex, lane and door the robots use holds the intervals it is
+/// taken for, sorted by their start, which are swept for overlaps. The
+/// robots are planned, and the intervals swept, in parallel on the
+/// TaskPool, each thread with a copy of the planner.
+class TrafficPreview
+{
+public:
+  struct Options
+  {
+    double clearance = 1.0;  // seconds a vertex is kept free either side
+    double door_time = 2.0;  // seconds a door is taken either side
+    std::size_t max_conflicts = 10000;  // kept; the rest are only counted
+  };
+
+  struct Robot
+  {
+    std::string name;
+    std::string start;  // vertex name
+    double start_time = 0.0;  // seconds it waits at the start
+    double dwell = 10.0;  // seconds it waits at each stop
+    std::vector<std::string> stops;  // vertex names
+  };
+
+  struct Missions
+  {
+    LanePathPlanner::Options planner;
+    Options options;
+    std::vector<Robot> robots;
+  };
+
+  /// Read missions written as
+  ///   speed: 0.5  # optional, as are the next four
+  ///   graph: 0
+  ///   clearance: 1.0
+  ///   door_time: 2.0
+  ///   dwell: 10.0  # the default of every robot
+  ///   robots:
+  ///     - name: tinyRobot1
+  ///       start: parking_1
+  ///       start_time: 0.0  # optional, as is dwell
+  ///       stops: [dispenser_1, charger_1]
+  static bool parse_missions(
+    const YAML::Node& node,
+    Missions& missions,
+    std::string& error);
+
+  /// A vertex a robot reaches at one time and leaves at another, in the
+  /// pixel coordinates of its level. It drives along a lane to the next
+  /// one if that is on the same level, and rides a lift if it isn't.
+  struct Waypoint
+  {
+    int level_idx = -1;
+    int vertex_idx = -1;
+    double x = 0.0;
+    double y = 0.0;
+    double arrive = 0.0;
+    double depart = 0.0;  // infinity at the last one
+  };
+
+  struct Plan
+  {
+    std::string name;
+    std::vector<Waypoint> waypoints;
+    std::string error;  // why it stopped short of its missions, if it did
+  };
+
+  enum ConflictKind
+  {
+    VERTEX = 0,
+    HEAD_ON,
+    DOOR,
+    NUM_CONFLICT_KINDS
+  };
+
+  static const char* conflict_kind_name(const ConflictKind kind);
+
+  struct Conflict
+  {
+    ConflictKind kind = VERTEX;
+    int robot_a = -1;  // by index into the plans
+    int robot_b = -1;
+    double start = 0.0;  // seconds, of the overlap of their intervals
+    double end = 0.0;
+    int level_idx = -1;
+    int vertex_idx = -1;  // VERTEX, and the ends of the lane of HEAD_ON
+    int other_vertex_idx = -1;
+    int edge_idx = -1;  // the door of DOOR
+  };
+
+  struct Result
+  {
+    std::vector<Plan> plans;  // by robot, in order
+    int num_failed = 0;  // plans with an error
+    double end_time = 0.0;  // when the last robot arrives at its last stop
+
+    std::vector<Conflict> conflicts;  // by start, up to max_conflicts
+    std::size_t num_conflicts = 0;
+    std::size_t num_by_kind[NUM_CONFLICT_KINDS] = {0, 0, 0};
+    std::size_t num_intervals = 0;
+    double plan_ms = 0.0;
+    double check_ms = 0.0;
+  };
+
+  /// Non-const only because the planner caches the level transforms in
+  /// the building: give it a copy (see BuildingSnapshot::to_building())
+  static Result run(Building& building, const Missions& missions);
+
+  /// Where a robot is at a time. False before it has been planned at all.
+  static bool position(
+    const Plan& plan,
+    const double time,
+    int& level_idx,
+    double& x,
+    double& y);
+};
+
+#endif
@@ -44,26 +44,33 @@ void TrafficTable::update(RenderingOptions& opts)
 
   for (std::size_t i = 0; i < num_lanes; i++)
   {
-    QCheckBox* checkbox = new QCheckBox;
-    checkbox->setChecked(opts.show_building_lanes[i]);
-    setCellWidget(i, 0, checkbox);
-    connect(
-      checkbox,
-      &QAbstractButton::clicked,
-      [this, &opts, i](bool box_checked)
-      {
-        opts.show_building_lanes[i] = box_checked;
-        emit redraw();
-      });
-
+    // connected once, when created, rather than on every update
+    bool created = false;
+    QCheckBox* checkbox = cell_check_box(i, 0, created);
+    if (checkbox->isChecked() != opts.show_building_lanes[i])
+      checkbox->setChecked(opts.show_building_lanes[i]);
+    if (created)
+    {
+      connect(
+        checkbox,
+        &QAbstractButton::clicked,
+        [this, &opts, checkbox](bool box_checked)
+        {
+          const int row = row_of(checkbox, 0);
+          if (row < 0 ||
+            row >= static_cast<int>(opts.show_building_lanes.size()))
+            return;
+          opts.show_building_lanes[row] = box_checked;
+          emit redraw();
+        });
+    }
 
     QTableWidgetItem* name_item =
-      new QTableWidgetItem(QString("Graph %1").arg(i));
-
-    if (static_cast<int>(i) == opts.active_traffic_map_idx)
-      name_item->setBackground(QBrush(QColor("#e0ffe0")));
-
-    setItem(i, 1, name_item);
+      set_cell_text(i, 1, QString("Graph %1").arg(i));
+    set_item_background(
+      name_item,
+      static_cast<int>(i) == opts.active_traffic_map_idx ?
+      QBrush(QColor("#e0ffe0")) : QBrush());
   }
 
   blockSignals(false);
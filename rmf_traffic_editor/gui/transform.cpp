@@ -35,7 +35,7 @@ bool Transform::from_yaml(const YAML::Node& data)
     _translation.setY(data["translation_y"].as<double>());
 
   if (data["yaw"])
-    _yaw = data["yaw"].as<double>();
+    setYaw(data["yaw"].as<double>());
 
   if (data["scale"])
     _scale = data["scale"].as<double>();
@@ -53,27 +53,47 @@ YAML::Node Transform::to_yaml() const
   return y;
 }
 
-QPointF Transform::forwards(const QPointF& p) const
+void Transform::setYaw(const double next_yaw)
 {
-  const double qx =
-    ( cos(_yaw) * p.x() + sin(_yaw) * p.y()) * _scale + _translation.x();
-
-  const double qy =
-    (-sin(_yaw) * p.x() + cos(_yaw) * p.y()) * _scale + _translation.y();
+  _yaw = next_yaw;
+  _cos_yaw = cos(_yaw);
+  _sin_yaw = sin(_yaw);
+}
 
-  return QPointF(qx, qy);
+void Transform::forwards(
+  const QPointF* points,
+  const std::size_t count,
+  QPointF* out,
+  const double out_scale) const
+{
+  const double c = _cos_yaw * _scale * out_scale;
+  const double s = _sin_yaw * _scale * out_scale;
+  const double tx = _translation.x() * out_scale;
+  const double ty = _translation.y() * out_scale;
+  for (std::size_t i = 0; i < count; i++)
+  {
+    const double x = points[i].x();
+    const double y = points[i].y();
+    out[i] = QPointF(c * x + s * y + tx, -s * x + c * y + ty);
+  }
 }
 
-QPointF Transform::backwards(const QPointF& p) const
+void Transform::backwards(
+  const QPointF* points,
+  const std::size_t count,
+  QPointF* out,
+  const double in_scale) const
 {
-  // translate back and scale
-  const double tsx = (p.x() - _translation.x()) / _scale;
-  const double tsy = (p.y() - _translation.y()) / _scale;
-
-  // rotate back
-  const double rx = cos(-_yaw) * tsx + sin(-_yaw) * tsy;
-  const double ry = -sin(-_yaw) * tsx + cos(-_yaw) * tsy;
-  return QPointF(rx, ry);
+  const double c = _cos_yaw * in_scale / _scale;
+  const double s = _sin_yaw * in_scale / _scale;
+  const double tx = _translation.x() / in_scale;
+  const double ty = _translation.y() / in_scale;
+  for (std::size_t i = 0; i < count; i++)
+  {
+    const double x = points[i].x() - tx;
+    const double y = points[i].y() - ty;
+    out[i] = QPointF(c * x - s * y, s * x + c * y);
+  }
 }
 
 Transform Transform::inverse() const
@@ -84,8 +104,8 @@ Transform Transform::inverse() const
   inv.setTranslation(
     1.0 / _scale *
     QPointF(
-      cos(-_yaw) * translation().x() - sin(-_yaw) * translation().y(),
-      sin(-_yaw) * translation().x() + cos(-_yaw) * translation().y()));
+      _cos_yaw * _translation.x() + _sin_yaw * _translation.y(),
+      -_sin_yaw * _translation.x() + _cos_yaw * _translation.y()));
   return inv;
 }
 
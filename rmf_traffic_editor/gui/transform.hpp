@@ -18,6 +18,7 @@
 #ifndef TRAFFIC_EDITOR__TRANSFORM_HPP
 #define TRAFFIC_EDITOR__TRANSFORM_HPP
 
+#include <cstddef>
 #include <string>
 
 #include <yaml-cpp/yaml.h>
@@ -32,12 +33,8 @@ class Transform
 public:
   Transform();
 
-  double _yaw = 0.0;
-  double _scale = 1.0;
-  QPointF _translation;
-
   double yaw() const { return _yaw; }
-  void setYaw(const double next_yaw) { _yaw = next_yaw; }
+  void setYaw(const double next_yaw);
 
   double scale() const { return _scale; }
   void setScale(const double next_scale) { _scale = next_scale; }
@@ -48,8 +45,40 @@ public:
     _translation = next_translation;
   }
 
-  QPointF forwards(const QPointF& p) const;
-  QPointF backwards(const QPointF& p) const;
+  QPointF forwards(const QPointF& p) const
+  {
+    return QPointF(
+      (_cos_yaw * p.x() + _sin_yaw * p.y()) * _scale + _translation.x(),
+      (-_sin_yaw * p.x() + _cos_yaw * p.y()) * _scale + _translation.y());
+  }
+
+  QPointF backwards(const QPointF& p) const
+  {
+    // translate back and scale, then rotate back
+    const double tsx = (p.x() - _translation.x()) / _scale;
+    const double tsy = (p.y() - _translation.y()) / _scale;
+    return QPointF(
+      _cos_yaw * tsx - _sin_yaw * tsy,
+      _sin_yaw * tsx + _cos_yaw * tsy);
+  }
+
+  /// forwards() of `count` points, written to `out` (which may be
+  /// `points`) and multiplied by `out_scale`, e.g. 1 / meters_per_pixel to
+  /// land in the pixels of the level. The loop has no calls or branches,
+  /// so the compiler can vectorize it.
+  void forwards(
+    const QPointF* points,
+    const std::size_t count,
+    QPointF* out,
+    const double out_scale = 1.0) const;
+
+  /// backwards() of `count` points, which are first multiplied by
+  /// `in_scale`, e.g. meters_per_pixel to go from level pixels to meters
+  void backwards(
+    const QPointF* points,
+    const std::size_t count,
+    QPointF* out,
+    const double in_scale = 1.0) const;
 
   bool from_yaml(const YAML::Node& data);
   YAML::Node to_yaml() const;
@@ -57,6 +86,16 @@ public:
   Transform inverse() const;
 
   std::string to_string() const;
+
+private:
+  double _yaw = 0.0;
+  double _scale = 1.0;
+  QPointF _translation;
+
+  /// Of _yaw, kept up to date by setYaw(), so that transforming a point
+  /// is only multiplications and additions
+  double _cos_yaw = 1.0;
+  double _sin_yaw = 0.0;
 };
 
 #endif  // TRAFFIC_EDITOR__TRANSFORM_HPP
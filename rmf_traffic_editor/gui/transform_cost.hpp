@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef TRAFFIC_EDITOR__TRANSFORM_COST_HPP
+#define TRAFFIC_EDITOR__TRANSFORM_COST_HPP
+
+#include <atomic>
+#include <cmath>
+
+#include "ceres/ceres.h"
+
+//=============================================================================
+/// The distance, in level pixels, between a floorplan feature and where the
+/// layer transform puts the layer feature which is constrained to it.
+/// Parameters are yaw, scale and translation (meters).
+class TransformCost : public ceres::SizedCostFunction<2, 1, 1, 2>
+{
+public:
+  TransformCost(
+    double level_x,
+    double level_y,
+    double level_meters_per_pixel,
+    double layer_x,
+    double layer_y)
+  : _level_x(level_x),
+    _level_y(level_y),
+    _inverse_meters_per_pixel(1.0 / level_meters_per_pixel),
+    _layer_x(layer_x),
+    _layer_y(layer_y)
+  {
+  }
+
+  bool Evaluate(
+    double const* const* parameters,
+    double* residuals,
+    double** jacobians) const override
+  {
+    const double yaw = parameters[0][0];
+    const double scale = parameters[1][0];
+    const double* translation = parameters[2];
+    const double c = std::cos(yaw);
+    const double s = std::sin(yaw);
+    const double k = _inverse_meters_per_pixel;
+
+    // the layer point rotated, before scaling
+    const double rx = c * _layer_x + s * _layer_y;
+    const double ry = -s * _layer_x + c * _layer_y;
+
+    residuals[0] = _level_x - (rx * scale + translation[0]) * k;
+    residuals[1] = _level_y - (ry * scale + translation[1]) * k;
+
+    if (!jacobians)
+      return true;
+
+    if (jacobians[0])
+    {
+      // d(rx)/d(yaw) = ry and d(ry)/d(yaw) = -rx
+      jacobians[0][0] = -ry * scale * k;
+      jacobians[0][1] = rx * scale * k;
+    }
+    if (jacobians[1])
+    {
+      jacobians[1][0] = -rx * k;
+      jacobians[1][1] = -ry * k;
+    }
+    if (jacobians[2])
+    {
+      jacobians[2][0] = -k;
+      jacobians[2][1] = 0.0;
+      jacobians[2][2] = 0.0;
+      jacobians[2][3] = -k;
+    }
+    return true;
+  }
+
+private:
+  double _level_x, _level_y;
+  double _inverse_meters_per_pixel;
+  double _layer_x, _layer_y;
+};
+
+//=============================================================================
+/// Lets a cancel flag from the GUI thread stop a solve between iterations
+class CancelCallback : public ceres::IterationCallback
+{
+public:
+  explicit CancelCallback(const std::atomic<bool>* cancel)
+  : _cancel(cancel)
+  {
+  }
+
+  ceres::CallbackReturnType operator()(const ceres::IterationSummary&)
+  override
+  {
+    if (_cancel && _cancel->load())
+      return ceres::SOLVER_ABORT;
+    return ceres::SOLVER_CONTINUE;
+  }
+
+private:
+  const std::atomic<bool>* _cancel;
+};
+
+#endif
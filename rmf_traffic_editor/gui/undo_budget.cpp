@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <vector>
+
+#include <QUndoCommand>
+#include <QUndoStack>
+
+#include "actions/compactable_command.hpp"
+#include "undo_budget.hpp"
+
+
+std::size_t UndoBudget::visit(
+  const QUndoCommand* command,
+  const std::function<void(CompactableCommand*)>& f)
+{
+  std::size_t bytes = COMMAND_BYTES;
+  // the stack only hands out const commands, but it is ours to compact
+  CompactableCommand* compactable = dynamic_cast<CompactableCommand*>(
+    const_cast<QUndoCommand*>(command));
+  if (compactable)
+  {
+    if (f)
+      f(compactable);
+    bytes += compactable->memory_usage();
+  }
+  for (int i = 0; i < command->childCount(); i++)
+    bytes += visit(command->child(i), f);
+  return bytes;
+}
+
+void UndoBudget::enforce(QUndoStack& stack)
+{
+  if (stack.count() < _retired)
+    _retired = 0;  // the stack was cleared
+
+  const int num_old = stack.index() - NUM_RECENT;
+  std::vector<std::size_t> bytes(stack.count(), 0);
+  _memory_usage = 0;
+  for (int i = 0; i < stack.count(); i++)
+  {
+    if (i >= _retired && i < num_old)
+      bytes[i] = visit(
+        stack.command(i),
+        [](CompactableCommand* c) { c->compact(); });
+    else
+      bytes[i] = visit(stack.command(i), nullptr);
+    _memory_usage += bytes[i];
+  }
+
+  while (_memory_usage > budget_bytes && _retired < num_old)
+  {
+    _memory_usage -= bytes[_retired];
+    _memory_usage += visit(
+      stack.command(_retired),
+      [](CompactableCommand* c) { c->retire(); });
+    _retired++;
+  }
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__UNDO_BUDGET_HPP
+#define TRAFFIC_EDITOR__UNDO_BUDGET_HPP
+
+#include <cstddef>
+#include <functional>
+
+class CompactableCommand;
+class QUndoCommand;
+class QUndoStack;
+
+//=============================================================================
+/// Keeps the undo history of a QUndoStack within a memory budget. The
+/// commands which implement CompactableCommand report how much they hold;
+/// once they are a little way down the stack they are compacted, and if
+/// the history is still over budget the oldest commands are retired.
+///
+/// QUndoStack can't drop commands from the bottom, so retired commands
+/// stay on it as empty shells, and the owner of the stack must not undo
+/// past retired() (see Editor::edit_undo()).
+class UndoBudget
+{
+public:
+  /// The most recent commands are left as they are, since they are the
+  /// ones most likely to be undone
+  static const int NUM_RECENT = 20;
+
+  std::size_t budget_bytes = 256 * 1024 * 1024;
+
+  /// Measure the stack, compacting and retiring as needed. Called
+  /// whenever the stack changes.
+  void enforce(QUndoStack& stack);
+
+  /// The commands at indices below this have been retired
+  int retired() const { return _retired; }
+
+  /// Forget the history, after the stack was cleared
+  void reset()
+  {
+    _retired = 0;
+    _memory_usage = 0;
+  }
+
+  /// Bytes held by the history, as of the last enforce()
+  std::size_t memory_usage() const { return _memory_usage; }
+
+private:
+  int _retired = 0;
+  std::size_t _memory_usage = 0;
+
+  /// Bytes assumed for a command that doesn't report its size
+  static const std::size_t COMMAND_BYTES = 128;
+
+  /// Call f on the command and on all of its children (macros) which are
+  /// compactable; returns the bytes held by the whole tree
+  static std::size_t visit(
+    const QUndoCommand* command,
+    const std::function<void(CompactableCommand*)>& f);
+};
+
+#endif
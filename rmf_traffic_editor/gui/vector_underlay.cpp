@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+
+#include <QGraphicsPathItem>
+#include <QGraphicsScene>
+#include <QPainterPath>
+#include <QPen>
+
+#include "dxf_importer.hpp"
+#include "logging.hpp"
+#include "vector_underlay.hpp"
+
+
+void VectorUnderlay::from_yaml(const YAML::Node& data)
+{
+  if (!data.IsMap() || !data["filename"])
+    throw std::runtime_error("vector_underlay YAML invalid");
+  filename = data["filename"].as<std::string>();
+  layers.clear();
+  if (data["layers"] && data["layers"].IsSequence())
+  {
+    for (const YAML::Node& layer : data["layers"])
+      layers.push_back(layer.as<std::string>());
+  }
+  if (data["meters_per_unit"])
+    meters_per_unit = data["meters_per_unit"].as<double>();
+  if (data["origin"] && data["origin"].IsSequence() &&
+    data["origin"].size() == 2)
+  {
+    origin_x = data["origin"][0].as<double>();
+    origin_y = data["origin"][1].as<double>();
+  }
+  lines.reset();
+}
+
+YAML::Node VectorUnderlay::to_yaml() const
+{
+  YAML::Node y;
+  y["filename"] = filename;
+  y["layers"] = YAML::Node(YAML::NodeType::Sequence);
+  for (const std::string& layer : layers)
+    y["layers"].push_back(layer);
+  y["meters_per_unit"] = meters_per_unit;
+  y["origin"].push_back(origin_x);
+  y["origin"].push_back(origin_y);
+  y["origin"].SetStyle(YAML::EmitterStyle::Flow);
+  return y;
+}
+
+bool VectorUnderlay::load()
+{
+  DxfImporter::Options options;
+  for (const std::string& layer : layers)
+    options.targets[layer] = DxfImporter::UNDERLAY;
+  options.meters_per_unit = meters_per_unit;
+  options.origin_x = origin_x;
+  options.origin_y = origin_y;
+
+  // relative to the building, which is the current directory, as are the
+  // images of the levels
+  DxfImporter::Result result =
+    DxfImporter::import(QString::fromStdString(filename), options);
+  if (!result.error.isEmpty())
+  {
+    qCWarning(lc_io, "unable to read the vector underlay %s: %s",
+      filename.c_str(),
+      qUtf8Printable(result.error));
+    lines = std::make_shared<Lines>();  // and don't try again
+    return false;
+  }
+  lines = result.underlay;
+  return true;
+}
+
+QGraphicsItem* VectorUnderlay::draw(
+  QGraphicsScene* scene,
+  const double meters_per_pixel) const
+{
+  if (!lines || lines->coords.empty())
+    return nullptr;
+
+  // each segment goes in the cell of its first point
+  const double scale = 1.0 / meters_per_pixel;
+  std::unordered_map<std::uint64_t, QPainterPath> paths;
+  const std::vector<float>& c = lines->coords;
+  for (std::size_t i = 0; i + 3 < c.size(); i += 4)
+  {
+    const std::uint32_t cx = static_cast<std::uint32_t>(
+      static_cast<std::int32_t>(std::floor(c[i] / CELL_METERS)));
+    const std::uint32_t cy = static_cast<std::uint32_t>(
+      static_cast<std::int32_t>(std::floor(c[i + 1] / CELL_METERS)));
+    QPainterPath& path = paths[static_cast<std::uint64_t>(cx) << 32 | cy];
+    path.moveTo(c[i] * scale, c[i + 1] * scale);
+    path.lineTo(c[i + 2] * scale, c[i + 3] * scale);
+  }
+
+  QGraphicsItem* root = scene->addPath(QPainterPath());
+  root->setZValue(-9.5);  // over the floorplan, under everything else
+  QPen pen(QColor(64, 64, 64));
+  pen.setCosmetic(true);
+  pen.setWidth(0);
+  for (const auto& it : paths)
+  {
+    QGraphicsPathItem* item = new QGraphicsPathItem(it.second, root);
+    item->setPen(pen);
+  }
+  return root;
+}
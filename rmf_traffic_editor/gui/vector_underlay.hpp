@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__VECTOR_UNDERLAY_HPP
+#define TRAFFIC_EDITOR__VECTOR_UNDERLAY_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <yaml-cpp/yaml.h>
+
+class QGraphicsItem;
+class QGraphicsScene;
+
+//=============================================================================
+/// The lines of some layers of a CAD drawing (DXF), drawn under a level as
+/// they are, in place of a floorplan image rasterized from it or over one.
+/// Only the file and the layers are saved with the level: the lines are
+/// read from the file by DxfImporter as the level is first drawn.
+///
+/// The segments are bucketed into square cells of the level, and drawn as
+/// one path item per cell, so that a drawing of a million lines is a few
+/// hundred items which the scene can cull as a whole.
+class VectorUnderlay
+{
+public:
+  /// The segments in meters from the origin, x to the right and y down,
+  /// as x0, y0, x1, y1
+  struct Lines
+  {
+    std::vector<float> coords;
+
+    std::size_t num_segments() const { return coords.size() / 4; }
+  };
+
+  std::string filename;  // as saved, maybe relative to the building
+  std::vector<std::string> layers;
+  double meters_per_unit = 1.0;
+
+  /// The point of the drawing, in its own units, at the top-left corner
+  /// (0, 0) of the level
+  double origin_x = 0.0;
+  double origin_y = 0.0;
+
+  /// nullptr until load()ed, and no lines if that failed
+  std::shared_ptr<const Lines> lines;
+
+  static constexpr double CELL_METERS = 25.0;
+
+  bool empty() const { return filename.empty(); }
+
+  void from_yaml(const YAML::Node& data);
+  YAML::Node to_yaml() const;
+
+  /// Read the lines of the layers from the file
+  bool load();
+
+  /// A (contentless) parent of the path items, or nullptr if there are no
+  /// lines. The items are owned by the scene.
+  QGraphicsItem* draw(
+    QGraphicsScene* scene,
+    const double meters_per_pixel) const;
+};
+
+#endif
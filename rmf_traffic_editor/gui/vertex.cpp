@@ -19,29 +19,15 @@
 
 #include <QGraphicsScene>
 #include <QGraphicsSimpleTextItem>
-#include <QIcon>
 
+#include "icon_cache.hpp"
+#include "logging.hpp"
+#include "scene_item_pool.hpp"
 #include "vertex.h"
 using std::string;
 using std::vector;
 using std::pair;
 
-const vector<pair<string, Param::Type>> Vertex::allowed_params
-{
-  { "is_parking_spot", Param::Type::BOOL },
-  { "is_charger", Param::Type::BOOL},
-  { "dock_name", Param::Type::STRING},
-  { "is_cleaning_zone", Param::Type::BOOL},
-  { "dropoff_ingestor", Param::Type::STRING },
-  { "pickup_dispenser", Param::Type::STRING },
-  { "spawn_robot_type", Param::Type::STRING },
-  { "spawn_robot_name", Param::Type::STRING },
-  { "is_holding_point", Param::Type::BOOL },
-  { "is_passthrough_point", Param::Type::BOOL },
-  { "human_goal_set_name", Param::Type::STRING },
-};
-
-
 Vertex::Vertex()
 : x(0), y(0), selected(false)
 {
@@ -76,6 +62,7 @@ void Vertex::from_yaml(const YAML::Node& data)
       params[it->first.as<string>()] = p;
     }
   }
+  update_attributes();
 }
 
 YAML::Node Vertex::to_yaml() const
@@ -100,12 +87,15 @@ YAML::Node Vertex::to_yaml() const
   return vertex_node;
 }
 
-void Vertex::draw(
+QList<QGraphicsItem*> Vertex::draw(
   QGraphicsScene* scene,
   const double radius,
   const QFont& font,
-  const CoordinateSystem& coordinate_system) const
+  const CoordinateSystem& coordinate_system,
+  const LevelOfDetail::Tier lod_tier) const
 {
+  QList<QGraphicsItem*> items;
+
   QPen vertex_pen(Qt::black);
   vertex_pen.setWidthF(radius / 2.0);
 
@@ -120,14 +110,28 @@ void Vertex::draw(
   const QBrush vertex_brush =
     selected ? QBrush(selected_color) : QBrush(nonselected_color);
 
-  QGraphicsEllipseItem* ellipse_item = scene->addEllipse(
-    x - radius,
-    y - radius,
-    2 * radius,
-    2 * radius,
+  SceneItemPool& pool = SceneItemPool::instance();
+  QGraphicsEllipseItem* ellipse_item = pool.ellipse(
+    scene,
+    QRectF(x - radius, y - radius, 2 * radius, 2 * radius),
     vertex_pen,
     vertex_brush);
   ellipse_item->setZValue(20.0);  // above all lane/wall edges
+  LevelOfDetail::tag(ellipse_item, LevelOfDetail::MEDIUM, lod_tier);
+  items.append(ellipse_item);
+
+  // when zoomed far out, a few-screen-pixels dot replaces the ellipse
+  QPen point_pen(vertex_brush, 3.0, Qt::SolidLine, Qt::RoundCap);
+  point_pen.setCosmetic(true);
+  QGraphicsLineItem* point_item =
+    pool.line(scene, QLineF(x, y, x, y), point_pen);
+  point_item->setZValue(20.0);
+  LevelOfDetail::tag(
+    point_item,
+    LevelOfDetail::COARSE,
+    LevelOfDetail::COARSE,
+    lod_tier);
+  items.append(point_item);
 
   // add some icons depending on the superpowers of this vertex
   QPen annotation_pen(Qt::black);
@@ -138,9 +142,8 @@ void Vertex::draw(
   if (is_holding_point())
   {
     const double icon_bearing = -135.0 * M_PI / 180.0;
-    QIcon icon(":icons/stopwatch.svg");
-    QPixmap pixmap(icon.pixmap(icon.actualSize(QSize(128, 128))));
-    QGraphicsPixmapItem* pixmap_item = scene->addPixmap(pixmap);
+    const QPixmap pixmap = IconCache::pixmap(":icons/stopwatch.svg");
+    QGraphicsPixmapItem* pixmap_item = pool.pixmap(scene, pixmap);
     pixmap_item->setOffset(
       -pixmap.width() / 2,
       -pixmap.height() / 2);
@@ -152,14 +155,15 @@ void Vertex::draw(
     if (!coordinate_system.is_y_flipped())
       pixmap_item->setTransform(pixmap_item->transform().scale(1, -1));
     pixmap_item->setToolTip("This vertex is a holding point");
+    LevelOfDetail::tag(pixmap_item, LevelOfDetail::FINE, lod_tier);
+    items.append(pixmap_item);
   }
 
   if (is_parking_point())
   {
     const double icon_bearing = 45.0 * M_PI / 180.0;
-    QIcon icon(":icons/parking.svg");
-    QPixmap pixmap(icon.pixmap(icon.actualSize(QSize(128, 128))));
-    QGraphicsPixmapItem* pixmap_item = scene->addPixmap(pixmap);
+    const QPixmap pixmap = IconCache::pixmap(":icons/parking.svg");
+    QGraphicsPixmapItem* pixmap_item = pool.pixmap(scene, pixmap);
     pixmap_item->setOffset(
       -pixmap.width() / 2,
       -pixmap.height() / 2);
@@ -171,6 +175,8 @@ void Vertex::draw(
     if (!coordinate_system.is_y_flipped())
       pixmap_item->setTransform(pixmap_item->transform().scale(1, -1));
     pixmap_item->setToolTip("This vertex is a parking point");
+    LevelOfDetail::tag(pixmap_item, LevelOfDetail::FINE, lod_tier);
+    items.append(pixmap_item);
 
     /*
     // outline the vertex with another circle
@@ -199,9 +205,8 @@ void Vertex::draw(
       QBrush());  // default brush is transparent
     rect_item->setZValue(20.0);
     */
-    QIcon icon(":icons/battery.svg");
-    QPixmap pixmap(icon.pixmap(icon.actualSize(QSize(128, 128))));
-    QGraphicsPixmapItem* pixmap_item = scene->addPixmap(pixmap);
+    const QPixmap pixmap = IconCache::pixmap(":icons/battery.svg");
+    QGraphicsPixmapItem* pixmap_item = pool.pixmap(scene, pixmap);
     pixmap_item->setOffset(
       -pixmap.width() / 2,
       -pixmap.height() / 2);
@@ -213,6 +218,8 @@ void Vertex::draw(
     if (!coordinate_system.is_y_flipped())
       pixmap_item->setTransform(pixmap_item->transform().scale(1, -1));
     pixmap_item->setToolTip("This vertex is a charger");
+    LevelOfDetail::tag(pixmap_item, LevelOfDetail::FINE, lod_tier);
+    items.append(pixmap_item);
   }
 
   /// For now, we only show one of the icon below as there's limited
@@ -232,9 +239,9 @@ void Vertex::draw(
   {
     const double icon_bearing = -45.0 * M_PI / 180.0;
 
-    QIcon icon(icon_name.c_str());
-    QPixmap pixmap(icon.pixmap(icon.actualSize(QSize(128, 128))));
-    QGraphicsPixmapItem* pixmap_item = scene->addPixmap(pixmap);
+    const QPixmap pixmap =
+      IconCache::pixmap(QString::fromStdString(icon_name));
+    QGraphicsPixmapItem* pixmap_item = pool.pixmap(scene, pixmap);
     pixmap_item->setOffset(
       -pixmap.width() / 2,
       -pixmap.height() / 2);
@@ -246,14 +253,17 @@ void Vertex::draw(
     if (!coordinate_system.is_y_flipped())
       pixmap_item->setTransform(pixmap_item->transform().scale(1, -1));
     pixmap_item->setToolTip(("Vertex is " + icon_name).c_str());
+    LevelOfDetail::tag(pixmap_item, LevelOfDetail::FINE, lod_tier);
+    items.append(pixmap_item);
   }
 
   if (!name.empty())
   {
-    QGraphicsSimpleTextItem* text_item = scene->addSimpleText(
-      QString::fromStdString(name),
-      font);
+    QGraphicsSimpleTextItem* text_item =
+      pool.simple_text(scene, QString::fromStdString(name), font);
     text_item->setBrush(selected ? selected_color : vertex_color);
+    LevelOfDetail::tag(text_item, LevelOfDetail::FINE, lod_tier);
+    items.append(text_item);
 
     if (coordinate_system.is_y_flipped())
     {
@@ -268,6 +278,8 @@ void Vertex::draw(
       text_item->setPos(x, y + 1 + radius);
     }
   }
+
+  return items;
 }
 
 void Vertex::set_param(const std::string& param_name, const std::string& value)
@@ -275,75 +287,87 @@ void Vertex::set_param(const std::string& param_name, const std::string& value)
   auto it = params.find(param_name);
   if (it == params.end())
   {
-    printf("tried to set unknown parameter [%s]\n", param_name.c_str());
+    qCWarning(lc_edit,
+      "tried to set unknown parameter [%s]", param_name.c_str());
     return;  // unknown parameter
   }
   it->second.set(value);
+  update_attributes();
 }
 
-bool Vertex::is_parking_point() const
-{
-  const auto it = params.find("is_parking_spot");
-  if (it == params.end())
-    return false;
-
-  return it->second.value_bool;
-}
-
-bool Vertex::is_holding_point() const
+const std::string& Vertex::dropoff_ingestor() const
 {
-  const auto it = params.find("is_holding_point");
-  if (it == params.end())
-    return false;
-
-  return it->second.value_bool;
+  static const std::string none;
+  const std::string* value = attributes().dropoff_ingestor;
+  return value ? *value : none;
 }
 
-bool Vertex::is_charger() const
+const std::string& Vertex::pickup_dispenser() const
 {
-  const auto it = params.find("is_charger");
-  if (it == params.end())
-    return false;
-
-  return it->second.value_bool;
+  static const std::string none;
+  const std::string* value = attributes().pickup_dispenser;
+  return value ? *value : none;
 }
 
-bool Vertex::is_cleaning_zone() const
-{
-  const auto it = params.find("is_cleaning_zone");
-  if (it == params.end())
-    return false;
-
-  return it->second.value_bool;
-}
-
-std::string Vertex::dropoff_ingestor() const
-{
-  const auto it = params.find("dropoff_ingestor");
-  if (it == params.end())
-    return "";
-
-  return it->second.value_string;
-}
-
-std::string Vertex::pickup_dispenser() const
-{
-  const auto it = params.find("pickup_dispenser");
-  if (it == params.end())
-    return "";
-
-  return it->second.value_string;
-}
-
-std::string Vertex::lift_cabin() const
+const std::string& Vertex::lift_cabin() const
 {
   /// Note: currently lift_cabin vertex is auto-generated when adding
-  /// a lift on traffic editor. Therefore lift cabin param is part of the
-  /// 'allowed_params' above. For now, the param 'lift_cabin' doesn't
+  /// a lift on traffic editor. Therefore lift cabin param isn't one of
+  /// those of param_schemas::vertex. For now, the param 'lift_cabin' doesn't
   /// serve any purpose in rmf building map generation and rmf graph.
-  const auto it = params.find("lift_cabin");
-  if (it == params.end())
-    return "";
+  static const std::string none;
+  const std::string* value = attributes().lift_cabin;
+  return value ? *value : none;
+}
 
-  return it->second.value_string;
+void Vertex::update_attributes() const
+{
+  // the keys are interned, so they can be told apart by address
+  static const std::string* const parking_key =
+    &ParamMap::intern("is_parking_spot");
+  static const std::string* const holding_key =
+    &ParamMap::intern("is_holding_point");
+  static const std::string* const charger_key =
+    &ParamMap::intern("is_charger");
+  static const std::string* const cleaning_key =
+    &ParamMap::intern("is_cleaning_zone");
+  static const std::string* const dropoff_key =
+    &ParamMap::intern("dropoff_ingestor");
+  static const std::string* const pickup_key =
+    &ParamMap::intern("pickup_dispenser");
+  static const std::string* const lift_cabin_key =
+    &ParamMap::intern("lift_cabin");
+
+  Attributes attributes;
+  attributes.params_revision = params.revision();
+  auto interned = [](const std::string& value) -> const std::string*
+    {
+      return value.empty() ? nullptr : &ParamMap::intern(value);
+    };
+  for (const auto& param : params)
+  {
+    const std::string* key = &param.first;
+    const Param& value = param.second;
+    if (key == parking_key && value.value_bool)
+      attributes.capabilities |= PARKING_POINT;
+    else if (key == holding_key && value.value_bool)
+      attributes.capabilities |= HOLDING_POINT;
+    else if (key == charger_key && value.value_bool)
+      attributes.capabilities |= CHARGER;
+    else if (key == cleaning_key && value.value_bool)
+      attributes.capabilities |= CLEANING_ZONE;
+    else if (key == dropoff_key)
+      attributes.dropoff_ingestor = interned(value.value_string);
+    else if (key == pickup_key)
+      attributes.pickup_dispenser = interned(value.value_string);
+    else if (key == lift_cabin_key)
+      attributes.lift_cabin = interned(value.value_string);
+  }
+  if (attributes.dropoff_ingestor)
+    attributes.capabilities |= DROPOFF_INGESTOR;
+  if (attributes.pickup_dispenser)
+    attributes.capabilities |= PICKUP_DISPENSER;
+  if (attributes.lift_cabin)
+    attributes.capabilities |= LIFT_CABIN;
+  _attributes = attributes;
 }
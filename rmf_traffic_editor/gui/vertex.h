@@ -19,16 +19,20 @@
 #define VERTEX_H
 
 #include <QUuid>
+#include <cstdint>
 #include <map>
 #include <string>
 #include <vector>
 #include <yaml-cpp/yaml.h>
 
 #include <QColor>
+#include <QList>
 
 #include "coordinate_system.h"
+#include "level_of_detail.hpp"
 #include "param.h"
 
+class QGraphicsItem;
 class QGraphicsScene;
 
 
@@ -42,7 +46,7 @@ public:
   bool selected;
 
   QUuid uuid;
-  std::map<std::string, Param> params;
+  ParamMap params;
 
   Vertex();
   Vertex(double _x, double _y, const std::string& _name = std::string());
@@ -52,24 +56,62 @@ public:
 
   void set_param(const std::string& name, const std::string& value);
 
-  void draw(
+  QList<QGraphicsItem*> draw(
     QGraphicsScene* scene,
     const double radius,
     const QFont& font,
-    const CoordinateSystem& coordinate_system) const;
-
-  bool is_parking_point() const;
-  bool is_holding_point() const;
-  bool is_cleaning_zone() const;
-  bool is_charger() const;
-
-  std::string dropoff_ingestor() const;
-  std::string pickup_dispenser() const;
-  std::string lift_cabin() const;
-
-
-  ////////////////////////////////////////////////////////////
-  static const std::vector<std::pair<std::string, Param::Type>> allowed_params;
+    const CoordinateSystem& coordinate_system,
+    const LevelOfDetail::Tier lod_tier = LevelOfDetail::FINE) const;
+
+  /// What the params make of this vertex, as bit flags
+  enum Capability
+  {
+    PARKING_POINT = 1 << 0,
+    HOLDING_POINT = 1 << 1,
+    CHARGER = 1 << 2,
+    CLEANING_ZONE = 1 << 3,
+    DROPOFF_INGESTOR = 1 << 4,
+    PICKUP_DISPENSER = 1 << 5,
+    LIFT_CABIN = 1 << 6
+  };
+
+  /// Derived from the params when they change, so this and the accessors
+  /// below are a revision check and a read: drawing calls them for every
+  /// vertex.
+  unsigned int capabilities() const { return attributes().capabilities; }
+
+  bool is_parking_point() const { return capabilities() & PARKING_POINT; }
+  bool is_holding_point() const { return capabilities() & HOLDING_POINT; }
+  bool is_cleaning_zone() const { return capabilities() & CLEANING_ZONE; }
+  bool is_charger() const { return capabilities() & CHARGER; }
+
+  /// Interned (see ParamMap::intern), so the references stay valid even
+  /// after the params change; empty if the param isn't set
+  const std::string& dropoff_ingestor() const;
+  const std::string& pickup_dispenser() const;
+  const std::string& lift_cabin() const;
+
+
+private:
+  struct Attributes
+  {
+    std::uint64_t params_revision = 0;  // that these were derived from
+    unsigned int capabilities = 0;
+    const std::string* dropoff_ingestor = nullptr;
+    const std::string* pickup_dispenser = nullptr;
+    const std::string* lift_cabin = nullptr;
+  };
+  mutable Attributes _attributes;
+
+  /// Brought up to date by set_param() and from_yaml(), and lazily after
+  /// the params map was edited directly
+  const Attributes& attributes() const
+  {
+    if (_attributes.params_revision != params.revision())
+      update_attributes();
+    return _attributes;
+  }
+  void update_attributes() const;
 };
 
 #endif
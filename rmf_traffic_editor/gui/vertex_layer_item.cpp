@@ -0,0 +1,334 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_set>
+
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+
+#include "icon_cache.hpp"
+#include "label_cache.hpp"
+#include "level_of_detail.hpp"
+#include "vertex_layer_item.hpp"
+
+// same colors as Vertex::draw()
+static const QColor vertex_color = QColor::fromRgbF(0.0, 0.5, 0.0);
+static const QColor nonselected_color = QColor::fromRgbF(0.0, 0.5, 0.0, 0.5);
+static const QColor selected_color = QColor::fromRgbF(1.0, 0.0, 0.0, 0.5);
+
+
+VertexLayerItem::VertexLayerItem(
+  const double radius,
+  const QFont& font,
+  const bool y_flipped,
+  QGraphicsItem* parent)
+: QGraphicsItem(parent),
+  _radius(radius),
+  _font(font),
+  _y_flipped(y_flipped)
+{
+  setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+  setZValue(20.0);  // above all lane/wall edges
+}
+
+VertexLayerItem::Entry VertexLayerItem::make_entry(const Vertex& vertex) const
+{
+  Entry entry = make_entry(vertex.x, vertex.y, vertex.name);
+  if (vertex.selected)
+    entry.flags |= SELECTED;
+  if (vertex.is_holding_point())
+    entry.flags |= HOLDING_POINT;
+  if (vertex.is_parking_point())
+    entry.flags |= PARKING_POINT;
+  if (vertex.is_charger())
+    entry.flags |= CHARGER;
+
+  // same precedence as Vertex::draw()
+  if (!vertex.pickup_dispenser().empty())
+    entry.extra_icon = PICKUP;
+  else if (!vertex.dropoff_ingestor().empty())
+    entry.extra_icon = DROPOFF;
+  else if (vertex.is_cleaning_zone())
+    entry.extra_icon = CLEANING;
+  else if (!vertex.lift_cabin().empty())
+    entry.extra_icon = LIFT;
+  return entry;
+}
+
+VertexLayerItem::Entry VertexLayerItem::make_entry(
+  const double x,
+  const double y,
+  const std::string& name) const
+{
+  Entry entry;
+  entry.x = x;
+  entry.y = y;
+
+  // the icon ring extends to 3.5 radii from the center
+  const double r = 3.5 * _radius;
+  entry.extent = QRectF(entry.x - r, entry.y - r, 2 * r, 2 * r);
+  if (!name.empty())
+  {
+    entry.label = LabelCache::text(QString::fromStdString(name), _font);
+    const QSizeF size = entry.label.size();
+    const double text_y = _y_flipped ?
+      entry.y - 1 + _radius :
+      entry.y + 1 + _radius - size.height();
+    entry.label_rect = QRectF(QPointF(entry.x, text_y), size);
+    entry.extent |= entry.label_rect;
+  }
+  return entry;
+}
+
+void VertexLayerItem::update_bounds()
+{
+  QRectF bounds;
+  for (const Entry& entry : _entries)
+    bounds |= entry.extent;
+  if (bounds != _bounds)
+  {
+    prepareGeometryChange();
+    _bounds = bounds;
+  }
+  _shape_valid = false;
+}
+
+void VertexLayerItem::set_vertices(const std::vector<Vertex>& vertices)
+{
+  _entries.clear();
+  _entries.reserve(vertices.size());
+  for (const Vertex& vertex : vertices)
+    _entries.push_back(make_entry(vertex));
+  update_bounds();
+  update();
+}
+
+void VertexLayerItem::set_vertices(const CompactBuilding::Level& level)
+{
+  _entries.clear();
+  _entries.reserve(level.vertices.size());
+  for (std::size_t i = 0; i < level.vertices.size(); i++)
+  {
+    const CompactBuilding::Point& p = level.vertices[i];
+    const std::string& name = level.names[level.vertex_names[i]];
+    _entries.push_back(make_entry(p.x, p.y, name));
+  }
+  update_bounds();
+  update();
+}
+
+void VertexLayerItem::set_vertex(const std::size_t idx, const Vertex& vertex)
+{
+  if (idx >= _entries.size())
+    _entries.resize(idx + 1);
+  const QRectF previous_extent = _entries[idx].extent;
+  _entries[idx] = make_entry(vertex);
+
+  if (!_bounds.contains(_entries[idx].extent))
+    update_bounds();
+  else
+    _shape_valid = false;
+
+  update(previous_extent);
+  update(_entries[idx].extent);
+}
+
+int VertexLayerItem::vertex_at(const QPointF& p) const
+{
+  int nearest_idx = -1;
+  double nearest_dist = _radius;
+  for (std::size_t i = 0; i < _entries.size(); i++)
+  {
+    const double dx = _entries[i].x - p.x();
+    const double dy = _entries[i].y - p.y();
+    const double dist = std::sqrt(dx * dx + dy * dy);
+    if (dist <= nearest_dist)
+    {
+      nearest_dist = dist;
+      nearest_idx = static_cast<int>(i);
+    }
+  }
+  return nearest_idx;
+}
+
+QRectF VertexLayerItem::boundingRect() const
+{
+  return _bounds;
+}
+
+QPainterPath VertexLayerItem::shape() const
+{
+  if (!_shape_valid)
+  {
+    _shape = QPainterPath();
+    for (const Entry& entry : _entries)
+      _shape.addEllipse(QPointF(entry.x, entry.y), _radius, _radius);
+    _shape_valid = true;
+  }
+  return _shape;
+}
+
+bool VertexLayerItem::contains(const QPointF& p) const
+{
+  return vertex_at(p) >= 0;
+}
+
+void VertexLayerItem::paint_icon(
+  QPainter* painter,
+  const QString& filename,
+  const Entry& entry,
+  const double bearing_degrees) const
+{
+  const QPixmap pixmap = IconCache::pixmap(filename);
+  const double icon_ring_radius = _radius * 2.5;
+  const double icon_scale = 2.0 * _radius / 128.0;
+  const double bearing = bearing_degrees * M_PI / 180.0;
+
+  painter->save();
+  painter->translate(
+    entry.x + icon_ring_radius * std::cos(bearing),
+    entry.y - icon_ring_radius * std::sin(bearing));
+  painter->scale(icon_scale, _y_flipped ? icon_scale : -icon_scale);
+  painter->drawPixmap(
+    QPointF(-pixmap.width() / 2, -pixmap.height() / 2),
+    pixmap);
+  painter->restore();
+}
+
+void VertexLayerItem::paint(
+  QPainter* painter,
+  const QStyleOptionGraphicsItem* option,
+  QWidget*)
+{
+  const LevelOfDetail::Tier tier = LevelOfDetail::tier_for_scale(
+    QStyleOptionGraphicsItem::levelOfDetailFromTransform(
+      painter->worldTransform()));
+
+  QPen vertex_pen(Qt::black);
+  vertex_pen.setWidthF(_radius / 2.0);
+
+  QPen point_pen(Qt::black, 3.0, Qt::SolidLine, Qt::RoundCap);
+  point_pen.setCosmetic(true);
+
+  painter->setFont(_font);
+
+  // de-clutter the names: one is left out if the screen cells it covers,
+  // one name high, are taken by a name painted before it in this pass
+  const QTransform& world = painter->worldTransform();
+  std::unordered_set<qint64> label_cells;
+  auto claim_label_cells = [&world, &label_cells](
+    const QRectF& label_rect,
+    const bool always)
+    {
+      const QRectF r = world.mapRect(label_rect);
+      const double cell = std::max(1.0, r.height());
+      const qint64 x0 = static_cast<qint64>(std::floor(r.left() / cell));
+      const qint64 x1 = static_cast<qint64>(std::floor(r.right() / cell));
+      const qint64 y0 = static_cast<qint64>(std::floor(r.top() / cell));
+      const qint64 y1 = static_cast<qint64>(std::floor(r.bottom() / cell));
+      auto key = [](const qint64 x, const qint64 y)
+        {
+          return static_cast<qint64>(
+            (static_cast<quint64>(x) << 32) ^ static_cast<quint32>(y));
+        };
+      if (!always)
+      {
+        for (qint64 y = y0; y <= y1; y++)
+        {
+          for (qint64 x = x0; x <= x1; x++)
+          {
+            if (label_cells.count(key(x, y)))
+              return false;
+          }
+        }
+      }
+      for (qint64 y = y0; y <= y1; y++)
+      {
+        for (qint64 x = x0; x <= x1; x++)
+          label_cells.insert(key(x, y));
+      }
+      return true;
+    };
+
+  for (const Entry& entry : _entries)
+  {
+    if (!option->exposedRect.intersects(entry.extent))
+      continue;
+
+    const bool selected = entry.flags & SELECTED;
+    const QPointF center(entry.x, entry.y);
+
+    if (tier == LevelOfDetail::COARSE)
+    {
+      point_pen.setColor(selected ? selected_color : nonselected_color);
+      painter->setPen(point_pen);
+      painter->drawPoint(center);
+      continue;
+    }
+
+    painter->setPen(vertex_pen);
+    painter->setBrush(selected ? selected_color : nonselected_color);
+    painter->drawEllipse(center, _radius, _radius);
+
+    if (tier != LevelOfDetail::FINE)
+      continue;
+
+    if (entry.flags & HOLDING_POINT)
+      paint_icon(painter, ":icons/stopwatch.svg", entry, -135.0);
+    if (entry.flags & PARKING_POINT)
+      paint_icon(painter, ":icons/parking.svg", entry, 45.0);
+    if (entry.flags & CHARGER)
+      paint_icon(painter, ":icons/battery.svg", entry, 135.0);
+
+    switch (entry.extra_icon)
+    {
+      case PICKUP:
+        paint_icon(painter, ":icons/pickup.svg", entry, -45.0);
+        break;
+      case DROPOFF:
+        paint_icon(painter, ":icons/dropoff.svg", entry, -45.0);
+        break;
+      case CLEANING:
+        paint_icon(painter, ":icons/clean.svg", entry, -45.0);
+        break;
+      case LIFT:
+        paint_icon(painter, ":icons/lift.svg", entry, -45.0);
+        break;
+      default:
+        break;
+    }
+
+    if (!entry.label_rect.isEmpty() &&
+      claim_label_cells(entry.label_rect, selected))
+    {
+      painter->save();
+      painter->setPen(selected ? selected_color : vertex_color);
+      if (_y_flipped)
+        painter->translate(entry.x, entry.y - 1 + _radius);
+      else
+      {
+        // flip the text, as Vertex::draw() does for +Y=up maps
+        painter->translate(entry.x, entry.y + 1 + _radius);
+        painter->scale(1.0, -1.0);
+      }
+      painter->drawStaticText(QPointF(0, 0), entry.label);
+      painter->restore();
+    }
+  }
+}
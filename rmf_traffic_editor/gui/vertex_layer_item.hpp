@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__VERTEX_LAYER_ITEM_HPP
+#define TRAFFIC_EDITOR__VERTEX_LAYER_ITEM_HPP
+
+#include <string>
+#include <vector>
+
+#include <QFont>
+#include <QGraphicsItem>
+#include <QPainterPath>
+#include <QStaticText>
+
+#include "compact_building.hpp"
+#include "vertex.h"
+
+//=============================================================================
+/// Paints all vertices of a level in a single item, instead of creating an
+/// ellipse, a label and up to four icon items per vertex. It keeps a compact
+/// copy of what it needs from each Vertex, culls against the exposed rect
+/// while painting, and answers hit-tests itself so that clicks which miss
+/// every vertex fall through to the lanes and walls underneath. Names are
+/// laid out once, by LabelCache, and left out where they would overlap
+/// names already painted.
+class VertexLayerItem : public QGraphicsItem
+{
+public:
+  VertexLayerItem(
+    const double radius,
+    const QFont& font,
+    const bool y_flipped,
+    QGraphicsItem* parent = nullptr);
+
+  void set_vertices(const std::vector<Vertex>& vertices);
+
+  /// The vertices of a level of the read-only viewer, which only have
+  /// their positions and names, so they are painted without icons
+  void set_vertices(const CompactBuilding::Level& level);
+
+  /// Refresh one vertex (appending it if idx is past the end)
+  void set_vertex(const std::size_t idx, const Vertex& vertex);
+
+  /// Index of the vertex whose disc contains p, or -1
+  int vertex_at(const QPointF& p) const;
+
+  QRectF boundingRect() const override;
+  QPainterPath shape() const override;
+  bool contains(const QPointF& p) const override;
+
+  void paint(
+    QPainter* painter,
+    const QStyleOptionGraphicsItem* option,
+    QWidget* widget = nullptr) override;
+
+private:
+  enum Flags
+  {
+    SELECTED = 1 << 0,
+    HOLDING_POINT = 1 << 1,
+    PARKING_POINT = 1 << 2,
+    CHARGER = 1 << 3
+  };
+
+  enum ExtraIcon
+  {
+    NO_ICON = 0,
+    PICKUP,
+    DROPOFF,
+    CLEANING,
+    LIFT
+  };
+
+  struct Entry
+  {
+    double x = 0.0;
+    double y = 0.0;
+    unsigned char flags = 0;
+    unsigned char extra_icon = NO_ICON;
+    QStaticText label;  // of its name, if it has one
+    QRectF label_rect;
+    QRectF extent;  // everything that is painted for this vertex
+  };
+
+  double _radius;
+  QFont _font;
+  bool _y_flipped;
+
+  std::vector<Entry> _entries;
+  QRectF _bounds;
+  mutable QPainterPath _shape;
+  mutable bool _shape_valid = false;
+
+  Entry make_entry(const Vertex& vertex) const;
+  Entry make_entry(
+    const double x,
+    const double y,
+    const std::string& name) const;
+  void update_bounds();
+
+  void paint_icon(
+    QPainter* painter,
+    const QString& filename,
+    const Entry& entry,
+    const double bearing_degrees) const;
+};
+
+#endif
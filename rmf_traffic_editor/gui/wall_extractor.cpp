@@ -0,0 +1,354 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+#include "task_pool.hpp"
+#include "wall_extractor.hpp"
+
+namespace {
+
+/// Distance from p to the segment from a to b
+double segment_distance(const QPointF& p, const QPointF& a, const QPointF& b)
+{
+  const QPointF ab = b - a;
+  const double length_squared = ab.x() * ab.x() + ab.y() * ab.y();
+  double t = 0.0;
+  if (length_squared > 0.0)
+  {
+    t = ((p.x() - a.x()) * ab.x() + (p.y() - a.y()) * ab.y()) /
+      length_squared;
+    t = std::min(1.0, std::max(0.0, t));
+  }
+  const QPointF d = p - (a + t * ab);
+  return std::hypot(d.x(), d.y());
+}
+
+/// Douglas-Peucker, without recursion
+std::vector<QPointF> simplify(
+  const std::vector<QPointF>& points,
+  const double tolerance)
+{
+  if (points.size() < 3)
+    return points;
+
+  std::vector<char> keep(points.size(), 0);
+  keep.front() = keep.back() = 1;
+  std::vector<std::pair<std::size_t, std::size_t>> stack;
+  stack.push_back({0, points.size() - 1});
+  while (!stack.empty())
+  {
+    const std::size_t first = stack.back().first;
+    const std::size_t last = stack.back().second;
+    stack.pop_back();
+
+    std::size_t farthest = first;
+    double farthest_distance = tolerance;
+    for (std::size_t i = first + 1; i < last; i++)
+    {
+      const double d = segment_distance(points[i], points[first], points[last]);
+      if (d > farthest_distance)
+      {
+        farthest = i;
+        farthest_distance = d;
+      }
+    }
+    if (farthest == first)
+      continue;
+    keep[farthest] = 1;
+    stack.push_back({first, farthest});
+    stack.push_back({farthest, last});
+  }
+
+  std::vector<QPointF> simplified;
+  for (std::size_t i = 0; i < points.size(); i++)
+  {
+    if (keep[i])
+      simplified.push_back(points[i]);
+  }
+  return simplified;
+}
+
+}  // namespace
+
+std::vector<std::vector<QPointF>> WallExtractor::extract(
+  const QImage& image,
+  const Options& options,
+  TaskProgress* progress)
+{
+  std::vector<std::vector<QPointF>> polylines;
+  if (image.isNull() || image.format() != QImage::Format_Grayscale8)
+    return polylines;
+
+  // with a border of empty pixels, so that every pixel of the image has
+  // all eight neighbours
+  const int width = image.width() + 2;
+  const int height = image.height() + 2;
+  std::vector<std::uint8_t> mask(static_cast<std::size_t>(width) * height, 0);
+
+  // neighbours P2..P9 of Zhang-Suen: clockwise from the one above
+  const int offsets[8] =
+  {-width, -width + 1, 1, width + 1, width, width - 1, -1, -width - 1};
+
+  TaskPool& pool = TaskPool::instance();
+  const int band_rows = std::max(1, options.band_rows);
+  const int num_bands = (image.height() + band_rows - 1) / band_rows;
+  auto for_each_band = [&](const std::function<void(int, int)>& f)
+    {
+      pool.parallel_for(
+        num_bands,
+        [&](const int band)
+        {
+          // rows of the padded mask
+          const int begin = 1 + band * band_rows;
+          f(begin, std::min(height - 1, begin + band_rows));
+        });
+    };
+  auto canceled = [progress]()
+    {
+      return progress && progress->canceled();
+    };
+
+  for_each_band(
+    [&](const int begin, const int end)
+    {
+      for (int y = begin; y < end; y++)
+      {
+        const uchar* row = image.constScanLine(y - 1);
+        std::uint8_t* out = &mask[static_cast<std::size_t>(y) * width + 1];
+        for (int x = 0; x < image.width(); x++)
+          out[x] = row[x] < options.threshold ? 1 : 0;
+      }
+    });
+
+  // Zhang-Suen thinning. Each sub-iteration only reads the mask while
+  // marking, so the bands can be marked in parallel and then cleared.
+  std::vector<std::uint8_t> marked(mask.size(), 0);
+  bool changed = true;
+  while (changed)
+  {
+    if (canceled())
+      return polylines;
+    changed = false;
+    for (int step = 0; step < 2; step++)
+    {
+      std::atomic<bool> any_marked {false};
+      for_each_band(
+        [&](const int begin, const int end)
+        {
+          bool band_marked = false;
+          for (int y = begin; y < end; y++)
+          {
+            for (int x = 1; x < width - 1; x++)
+            {
+              const int i = y * width + x;
+              marked[i] = 0;
+              if (!mask[i])
+                continue;
+              int p[8];
+              int count = 0;
+              for (int k = 0; k < 8; k++)
+              {
+                p[k] = mask[i + offsets[k]];
+                count += p[k];
+              }
+              if (count < 2 || count > 6)
+                continue;
+              int transitions = 0;
+              for (int k = 0; k < 8; k++)
+                transitions += !p[k] && p[(k + 1) % 8];
+              if (transitions != 1)
+                continue;
+              // p[0] = P2 (up), p[2] = P4 (right), p[4] = P6 (down),
+              // p[6] = P8 (left)
+              if (step == 0 &&
+                ((p[0] && p[2] && p[4]) || (p[2] && p[4] && p[6])))
+                continue;
+              if (step == 1 &&
+                ((p[0] && p[2] && p[6]) || (p[0] && p[4] && p[6])))
+                continue;
+              marked[i] = 1;
+              band_marked = true;
+            }
+          }
+          if (band_marked)
+            any_marked = true;
+        });
+      if (!any_marked)
+        continue;
+      changed = true;
+      for_each_band(
+        [&](const int begin, const int end)
+        {
+          const std::size_t first = static_cast<std::size_t>(begin) * width;
+          const std::size_t last = static_cast<std::size_t>(end) * width;
+          for (std::size_t i = first; i < last; i++)
+            mask[i] &= !marked[i];
+        });
+    }
+  }
+  if (canceled())
+    return polylines;
+
+  // the paths of the skeleton run between nodes: its ends, its
+  // junctions, and pixels on their own
+  std::vector<std::uint8_t>& node = marked;
+  for_each_band(
+    [&](const int begin, const int end)
+    {
+      for (int y = begin; y < end; y++)
+      {
+        for (int x = 1; x < width - 1; x++)
+        {
+          const int i = y * width + x;
+          node[i] = 0;
+          if (!mask[i])
+            continue;
+          int count = 0;
+          int transitions = 0;
+          for (int k = 0; k < 8; k++)
+          {
+            count += mask[i + offsets[k]];
+            transitions +=
+              !mask[i + offsets[k]] && mask[i + offsets[(k + 1) % 8]];
+          }
+          node[i] = count <= 1 || transitions >= 3;
+        }
+      }
+    });
+
+  // the straight neighbours first, so that a path doesn't cut corners
+  const int order[8] = {2, 4, 6, 0, 1, 3, 5, 7};
+  std::vector<std::uint8_t> visited(mask.size(), 0);
+  std::vector<std::vector<int>> paths;
+  auto trace = [&](const int start, const int first)
+    {
+      std::vector<int> path {start};
+      int prev = start;
+      int current = first;
+      while (true)
+      {
+        path.push_back(current);
+        if (node[current])
+          break;
+        visited[current] = 1;
+
+        // a node ends the path, so it goes before any other neighbour
+        int next_node = -1;
+        int next_pixel = -1;
+        for (const int k : order)
+        {
+          const int q = current + offsets[k];
+          if (!mask[q] || q == prev)
+            continue;
+          if (node[q])
+          {
+            // not straight back to where it started
+            if (q == start && path.size() < 4)
+              continue;
+            if (next_node < 0)
+              next_node = q;
+          }
+          else if (!visited[q] && next_pixel < 0)
+            next_pixel = q;
+        }
+        const int next = next_node >= 0 ? next_node : next_pixel;
+        if (next < 0)
+          break;
+        prev = current;
+        current = next;
+      }
+      paths.push_back(std::move(path));
+    };
+
+  for (int i = width; i < width * (height - 1); i++)
+  {
+    if (!node[i])
+      continue;
+    for (int k = 0; k < 8; k++)
+    {
+      const int q = i + offsets[k];
+      if (!mask[q])
+        continue;
+      if (node[q])
+      {
+        if (i < q)
+          paths.push_back({i, q});
+      }
+      else if (!visited[q])
+        trace(i, q);
+    }
+  }
+  // what is left are closed loops; start each at any of its pixels
+  for (int i = width; i < width * (height - 1); i++)
+  {
+    if (!mask[i] || node[i] || visited[i])
+      continue;
+    node[i] = 1;
+    for (int k = 0; k < 8 && !visited[i]; k++)
+    {
+      const int q = i + offsets[k];
+      if (mask[q] && !node[q] && !visited[q])
+      {
+        trace(i, q);
+        break;
+      }
+    }
+    node[i] = 0;
+    visited[i] = 1;
+  }
+  if (canceled())
+    return polylines;
+
+  polylines.resize(paths.size());
+  pool.parallel_for(
+    static_cast<int>(paths.size()),
+    [&](const int p)
+    {
+      std::vector<QPointF> points;
+      points.reserve(paths[p].size());
+      double length = 0.0;
+      for (const int i : paths[p])
+      {
+        const QPointF point(i % width - 0.5, i / width - 0.5);
+        if (!points.empty())
+        {
+          const QPointF d = point - points.back();
+          length += std::hypot(d.x(), d.y());
+        }
+        points.push_back(point);
+      }
+      if (length >= options.min_length)
+        polylines[p] = simplify(points, options.tolerance);
+    });
+
+  polylines.erase(
+    std::remove_if(
+      polylines.begin(),
+      polylines.end(),
+      [](const std::vector<QPointF>& polyline)
+      {
+        return polyline.size() < 2;
+      }),
+    polylines.end());
+  return polylines;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__WALL_EXTRACTOR_HPP
+#define TRAFFIC_EDITOR__WALL_EXTRACTOR_HPP
+
+#include <vector>
+
+#include <QImage>
+#include <QPointF>
+
+class TaskProgress;
+
+//=============================================================================
+/// Traces the walls of an occupancy-grid image, such as a lidar layer, as
+/// polylines: the pixels darker than a threshold are thinned to a one
+/// pixel wide skeleton (Zhang-Suen), the skeleton is followed from its
+/// ends and junctions, and each path is simplified (Douglas-Peucker) to a
+/// few straight segments. Thresholding and each thinning pass run on
+/// bands of rows in parallel, and the paths are simplified in parallel.
+class WallExtractor
+{
+public:
+  struct Options
+  {
+    /// Pixels darker than this are walls. In occupancy grids 0 is
+    /// occupied, 205 unknown and 254 free.
+    int threshold = 100;
+
+    /// Most a segment may be off the pixels it replaces, in pixels
+    double tolerance = 1.0;
+
+    /// Paths shorter than this, in pixels, are dropped as noise
+    double min_length = 5.0;
+
+    int band_rows = 128;
+  };
+
+  /// The polylines, in pixels of the image (at the centers of the pixels).
+  /// The image is Format_Grayscale8. Stops early, returning nothing, if
+  /// progress is canceled.
+  static std::vector<std::vector<QPointF>> extract(
+    const QImage& image,
+    const Options& options,
+    TaskProgress* progress = nullptr);
+};
+
+#endif
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <QFileInfo>
+
+#include "compressed_stream.hpp"
+#include "workspace.hpp"
+
+
+int Workspace::add(const std::size_t undo_budget_bytes)
+{
+  _documents.push_back(std::make_unique<Document>());
+  _documents.back()->undo_budget.budget_bytes = undo_budget_bytes;
+  return count() - 1;
+}
+
+void Workspace::remove(const int idx)
+{
+  if (idx < 0 || idx >= count() || idx == _active)
+    return;
+  _documents.erase(_documents.begin() + idx);
+  if (_active > idx)
+    _active--;
+}
+
+QString Workspace::title(const std::string& filename)
+{
+  if (filename.empty())
+    return "untitled";
+  QString name = QFileInfo(
+    QString::fromStdString(
+      CompressedStream::without_extension(filename))).fileName();
+  const QString suffix(".building.yaml");
+  if (name.endsWith(suffix) && name.size() > suffix.size())
+    name.chop(suffix.size());
+  return name;
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__WORKSPACE_HPP
+#define TRAFFIC_EDITOR__WORKSPACE_HPP
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <QPointF>
+#include <QString>
+#include <QTransform>
+#include <QUndoStack>
+
+#include "building.h"
+#include "building_snapshot.hpp"
+#include "edit_journal.hpp"
+#include "level_snapshot.hpp"
+#include "undo_budget.hpp"
+
+//=============================================================================
+/// The buildings open in the tabs of the editor. Only one of them is edited
+/// at a time; the others are parked here with everything needed to show
+/// them again without reloading: their levels keep their decoded images
+/// and cached graphics, and their undo history is kept in its own stack.
+/// The EditorModel catalog, the DecodedImageCache and the worker pool
+/// belong to the editor, and are shared by all of them.
+class Workspace
+{
+public:
+  struct Document
+  {
+    /// Empty while the document is active: its contents are swapped into
+    /// the building of the editor, which the tables and the undo commands
+    /// point at, and back out when another tab is activated.
+    Building building;
+
+    QUndoStack undo_stack;
+    UndoBudget undo_budget;
+    bool modified = false;
+
+    int level_idx = 0;
+    int layer_idx = 0;
+
+    /// The view of the map when the document was parked
+    bool has_view = false;
+    QTransform view_transform;
+    QPointF view_center;
+
+    std::map<int, LevelSnapshot> level_snapshots;
+    std::vector<int> shown_levels;
+
+    /// The building as it was last loaded or saved, which the change delta
+    /// of the next save is computed against. Only kept while change deltas
+    /// are enabled in the preferences.
+    std::shared_ptr<const BuildingSnapshot> saved_snapshot;
+    std::uint64_t delta_sequence = 0;
+
+    /// The edits since the building was loaded or saved, for recovering
+    /// them after a crash. Removed as the document is closed.
+    EditJournal journal;
+  };
+
+  /// Add an empty document after the others and return its index. It is
+  /// not activated.
+  int add(const std::size_t undo_budget_bytes);
+
+  /// Forget the document; it must not be the active one
+  void remove(const int idx);
+
+  int count() const { return static_cast<int>(_documents.size()); }
+  Document& document(const int idx) { return *_documents[idx]; }
+
+  /// Index of the document being edited, or -1 before the first one
+  int active() const { return _active; }
+  void set_active(const int idx) { _active = idx; }
+
+  /// The label of the tab of a building file
+  static QString title(const std::string& filename);
+
+private:
+  std::vector<std::unique_ptr<Document>> _documents;
+  int _active = -1;
+};
+
+#endif
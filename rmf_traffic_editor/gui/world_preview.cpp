@@ -0,0 +1,264 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <cmath>
+
+#include <QtConcurrent/QtConcurrent>
+
+#include "building.h"
+#include "logging.hpp"
+#include "polygon_geometry.hpp"
+#include "world_preview.hpp"
+
+namespace {
+
+// as in wall.py
+const double WALL_HEIGHT = 2.5;  // meters
+const double WALL_THICKNESS = 0.1;  // meters
+
+double cross_z(
+  const WorldPreview::Point& a,
+  const WorldPreview::Point& b,
+  const WorldPreview::Point& c)
+{
+  return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+void add_triangle(
+  WorldPreview::LevelMesh& mesh,
+  const WorldPreview::Kind kind,
+  const WorldPreview::Point& a,
+  const WorldPreview::Point& b,
+  const WorldPreview::Point& c)
+{
+  WorldPreview::Triangle triangle;
+  triangle.v[0] = a;
+  triangle.v[1] = b;
+  triangle.v[2] = c;
+  triangle.kind = kind;
+  mesh.triangles.push_back(triangle);
+}
+
+WorldPreview::Point raised(WorldPreview::Point p, const double dz)
+{
+  p.z += dz;
+  return p;
+}
+
+}  // anonymous namespace
+
+bool WorldPreview::LevelInput::operator==(const LevelInput& other) const
+{
+  return meters_per_pixel == other.meters_per_pixel &&
+    scale == other.scale &&
+    dx == other.dx &&
+    dy == other.dy &&
+    elevation == other.elevation &&
+    walls == other.walls &&
+    floors == other.floors &&
+    holes == other.holes;
+}
+
+WorldPreview::WorldPreview(QObject* parent)
+: QObject(parent)
+{
+  _watcher = new QFutureWatcher<LevelMesh>(this);
+  connect(
+    _watcher,
+    &QFutureWatcher<LevelMesh>::finished,
+    this,
+    &WorldPreview::finished);
+}
+
+WorldPreview::LevelInput WorldPreview::input(
+  Building& building,
+  const int level_idx)
+{
+  LevelInput input;
+  const Level& level = building.levels[level_idx];
+  const int reference_idx = building.get_reference_level_idx();
+  input.meters_per_pixel =
+    reference_idx >= 0 &&
+    reference_idx < static_cast<int>(building.levels.size()) ?
+    building.levels[reference_idx].drawing_meters_per_pixel :
+    level.drawing_meters_per_pixel;
+  const Building::Transform t = building.get_transform_to_reference(level_idx);
+  input.scale = t.scale;
+  input.dx = t.dx;
+  input.dy = t.dy;
+  input.elevation = level.elevation;
+
+  const int n_vertices = static_cast<int>(level.vertices.size());
+  auto valid = [n_vertices](const int vertex_idx)
+    {
+      return vertex_idx >= 0 && vertex_idx < n_vertices;
+    };
+
+  for (const Edge& edge : level.edges)
+  {
+    if (edge.type != Edge::WALL ||
+      !valid(edge.start_idx) || !valid(edge.end_idx))
+      continue;
+    const Vertex& v_start = level.vertices[edge.start_idx];
+    const Vertex& v_end = level.vertices[edge.end_idx];
+    input.walls.push_back(QLineF(v_start.x, v_start.y, v_end.x, v_end.y));
+  }
+
+  for (const Polygon& polygon : level.polygons)
+  {
+    if (polygon.type != Polygon::FLOOR && polygon.type != Polygon::HOLE)
+      continue;
+    QPolygonF outline;
+    for (const int vertex_idx : polygon.vertices)
+    {
+      if (valid(vertex_idx))
+        outline.append(
+          QPointF(level.vertices[vertex_idx].x, level.vertices[vertex_idx].y));
+    }
+    if (outline.size() < 3)
+      continue;
+    if (polygon.type == Polygon::FLOOR)
+      input.floors.push_back(outline);
+    else
+      input.holes.push_back(outline);
+  }
+  return input;
+}
+
+WorldPreview::LevelMesh WorldPreview::build(const LevelInput& input)
+{
+  LevelMesh mesh;
+  auto to_meters = [&input](const QPointF& p)
+    {
+      Point m;
+      m.x = (p.x() * input.scale + input.dx) * input.meters_per_pixel;
+      m.y = -(p.y() * input.scale + input.dy) * input.meters_per_pixel;
+      m.z = input.elevation;
+      return m;
+    };
+
+  for (const QLineF& wall : input.walls)
+  {
+    const Point p0 = to_meters(wall.p1());
+    const Point p1 = to_meters(wall.p2());
+    const double length = std::hypot(p1.x - p0.x, p1.y - p0.y);
+    if (length < 1e-6)
+      continue;
+
+    // the footprint of the box, counterclockwise seen from above
+    const double nx = -(p1.y - p0.y) / length * 0.5 * WALL_THICKNESS;
+    const double ny = (p1.x - p0.x) / length * 0.5 * WALL_THICKNESS;
+    Point ring[4] = {p0, p0, p1, p1};
+    ring[0].x += nx;
+    ring[0].y += ny;
+    ring[1].x -= nx;
+    ring[1].y -= ny;
+    ring[2].x -= nx;
+    ring[2].y -= ny;
+    ring[3].x += nx;
+    ring[3].y += ny;
+
+    for (int i = 0; i < 4; i++)
+    {
+      const Point& a = ring[i];
+      const Point& b = ring[(i + 1) % 4];
+      add_triangle(mesh, WALL, a, b, raised(b, WALL_HEIGHT));
+      add_triangle(
+        mesh, WALL, a, raised(b, WALL_HEIGHT), raised(a, WALL_HEIGHT));
+    }
+    add_triangle(
+      mesh, WALL,
+      raised(ring[0], WALL_HEIGHT),
+      raised(ring[1], WALL_HEIGHT),
+      raised(ring[2], WALL_HEIGHT));
+    add_triangle(
+      mesh, WALL,
+      raised(ring[0], WALL_HEIGHT),
+      raised(ring[2], WALL_HEIGHT),
+      raised(ring[3], WALL_HEIGHT));
+    mesh.num_walls++;
+  }
+
+  for (const QPolygonF& floor : input.floors)
+  {
+    const PolygonGeometry geometry =
+      PolygonGeometry::compute(floor, input.holes);
+    for (std::size_t i = 0; i + 2 < geometry.triangles.size(); i += 3)
+    {
+      const Point a = to_meters(geometry.triangles[i]);
+      const Point b = to_meters(geometry.triangles[i + 1]);
+      const Point c = to_meters(geometry.triangles[i + 2]);
+      // flipping y to get meters also flips the winding
+      if (cross_z(a, b, c) >= 0)
+        add_triangle(mesh, FLOOR, a, b, c);
+      else
+        add_triangle(mesh, FLOOR, a, c, b);
+    }
+    mesh.num_floors++;
+  }
+  return mesh;
+}
+
+void WorldPreview::update(Building& building)
+{
+  _latest.clear();
+  for (std::size_t i = 0; i < building.levels.size(); i++)
+    _latest.push_back(input(building, i));
+  if (!_watcher->isRunning())
+    start();
+  // otherwise finished() picks up the latest inputs
+}
+
+void WorldPreview::start()
+{
+  _meshes.resize(_latest.size());
+  _inputs.resize(_latest.size());
+
+  _building_levels.clear();
+  _building_inputs.clear();
+  for (std::size_t i = 0; i < _latest.size(); i++)
+  {
+    if (_latest[i] == _inputs[i])
+      continue;
+    _building_levels.push_back(i);
+    _building_inputs.push_back(_latest[i]);
+  }
+  if (_building_inputs.empty())
+    return;
+
+  qCDebug(lc_draw, "rebuilding the 3D preview of %zu of %zu levels",
+    _building_inputs.size(), _latest.size());
+  _watcher->setFuture(
+    QtConcurrent::mapped(_building_inputs, &WorldPreview::build));
+}
+
+void WorldPreview::finished()
+{
+  const QList<LevelMesh> results = _watcher->future().results();
+  for (int i = 0; i < results.size(); i++)
+  {
+    const std::size_t level_idx = _building_levels[i];
+    if (level_idx >= _meshes.size())
+      continue;  // the level was deleted meanwhile
+    _meshes[level_idx] = results[i];
+    _inputs[level_idx] = _building_inputs[i];
+  }
+  _num_rebuilt = results.size();
+  emit updated();
+
+  start();  // for any update() that came in while this build ran
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__WORLD_PREVIEW_HPP
+#define TRAFFIC_EDITOR__WORLD_PREVIEW_HPP
+
+#include <string>
+#include <vector>
+
+#include <QFutureWatcher>
+#include <QLineF>
+#include <QObject>
+#include <QPolygonF>
+
+class Building;
+class Level;
+
+//=============================================================================
+/// A quick 3D preview of what building_map_generator will make of the walls
+/// and floors: each wall is extruded into a box and each floor is meshed
+/// with its holes cut out, with the dimensions the generator uses. The
+/// meshes are built per level on the worker pool, from copies of the
+/// level, and kept; update() rebuilds only the levels whose walls, floors,
+/// scale, alignment or elevation differ from what they were built from.
+/// The generator stays the source of truth: textures, doors, lifts and
+/// ceilings are left out.
+class WorldPreview : public QObject
+{
+  Q_OBJECT
+
+public:
+  /// In meters, in the frame of the reference level, with z up
+  struct Point
+  {
+    double x = 0.0;
+    double y = 0.0;
+    double z = 0.0;
+  };
+
+  enum Kind
+  {
+    WALL = 0,
+    FLOOR
+  };
+
+  struct Triangle
+  {
+    Point v[3];  // counterclockwise seen from outside
+    Kind kind = WALL;
+  };
+
+  /// What a level mesh is built from, copied out of the level so the
+  /// worker never touches the building
+  struct LevelInput
+  {
+    double meters_per_pixel = 0.05;  // of the reference level
+    double scale = 1.0;  // from this level's pixels to the reference's
+    double dx = 0.0;
+    double dy = 0.0;
+    double elevation = 0.0;
+    std::vector<QLineF> walls;  // in pixels
+    std::vector<QPolygonF> floors;
+    std::vector<QPolygonF> holes;
+
+    bool operator==(const LevelInput& other) const;
+    bool operator!=(const LevelInput& other) const
+    {
+      return !(*this == other);
+    }
+  };
+
+  struct LevelMesh
+  {
+    std::vector<Triangle> triangles;
+    int num_walls = 0;
+    int num_floors = 0;
+  };
+
+  explicit WorldPreview(QObject* parent = nullptr);
+
+  static LevelInput input(Building& building, const int level_idx);
+  static LevelMesh build(const LevelInput& input);
+
+  /// Start rebuilding the levels which changed since their meshes were
+  /// built. If a build is already running, this one is queued behind it.
+  void update(Building& building);
+
+  /// By level index; levels not built yet have empty meshes
+  const std::vector<LevelMesh>& meshes() const { return _meshes; }
+
+  bool is_building() const { return _watcher->isRunning(); }
+
+  /// Number of levels rebuilt by the last build that finished
+  int num_rebuilt() const { return _num_rebuilt; }
+
+signals:
+  /// Some meshes were rebuilt
+  void updated();
+
+private:
+  std::vector<LevelInput> _inputs;  // what each of _meshes was built from
+  std::vector<LevelMesh> _meshes;
+  std::vector<LevelInput> _latest;  // of the last update()
+  std::vector<int> _building_levels;  // of the running build
+  std::vector<LevelInput> _building_inputs;
+  QFutureWatcher<LevelMesh>* _watcher = nullptr;
+  int _num_rebuilt = 0;
+
+  void start();
+  void finished();
+};
+
+#endif
@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <QMouseEvent>
+#include <QPainter>
+#include <QWheelEvent>
+
+#include "world_preview_view.hpp"
+
+namespace {
+
+using Point = WorldPreview::Point;
+
+const double FIELD_OF_VIEW = 50.0 * M_PI / 180.0;
+const double NEAR_PLANE = 0.1;  // meters
+const double MIN_PITCH = 0.05;
+const double MAX_PITCH = 0.5 * M_PI - 0.05;
+
+Point operator-(const Point& a, const Point& b)
+{
+  Point p;
+  p.x = a.x - b.x;
+  p.y = a.y - b.y;
+  p.z = a.z - b.z;
+  return p;
+}
+
+double dot(const Point& a, const Point& b)
+{
+  return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+Point cross(const Point& a, const Point& b)
+{
+  Point p;
+  p.x = a.y * b.z - a.z * b.y;
+  p.y = a.z * b.x - a.x * b.z;
+  p.z = a.x * b.y - a.y * b.x;
+  return p;
+}
+
+Point normalized(const Point& a)
+{
+  const double length = std::sqrt(dot(a, a));
+  if (length <= 0.0)
+    return a;
+  Point p;
+  p.x = a.x / length;
+  p.y = a.y / length;
+  p.z = a.z / length;
+  return p;
+}
+
+struct Projected
+{
+  QPolygonF polygon;
+  QColor color;
+  double depth = 0.0;
+};
+
+}  // anonymous namespace
+
+WorldPreviewView::WorldPreviewView(
+  const WorldPreview* preview,
+  QWidget* parent)
+: QWidget(parent),
+  _preview(preview)
+{
+  connect(_preview, &WorldPreview::updated, this, [this]() { update(); });
+}
+
+void WorldPreviewView::fit()
+{
+  double min[3], max[3];
+  std::fill(min, min + 3, std::numeric_limits<double>::max());
+  std::fill(max, max + 3, std::numeric_limits<double>::lowest());
+  bool empty = true;
+  for (const WorldPreview::LevelMesh& mesh : _preview->meshes())
+  {
+    for (const WorldPreview::Triangle& triangle : mesh.triangles)
+    {
+      for (const Point& v : triangle.v)
+      {
+        const double c[3] = {v.x, v.y, v.z};
+        for (int i = 0; i < 3; i++)
+        {
+          min[i] = std::min(min[i], c[i]);
+          max[i] = std::max(max[i], c[i]);
+        }
+        empty = false;
+      }
+    }
+  }
+  if (empty)
+    return;
+
+  _target.x = 0.5 * (min[0] + max[0]);
+  _target.y = 0.5 * (min[1] + max[1]);
+  _target.z = 0.5 * (min[2] + max[2]);
+  const double diagonal = std::sqrt(
+    (max[0] - min[0]) * (max[0] - min[0]) +
+    (max[1] - min[1]) * (max[1] - min[1]) +
+    (max[2] - min[2]) * (max[2] - min[2]));
+  _distance = std::max(1.0, 0.5 * diagonal / std::tan(0.5 * FIELD_OF_VIEW));
+  _fitted = true;
+}
+
+void WorldPreviewView::paintEvent(QPaintEvent*)
+{
+  QPainter painter(this);
+  painter.fillRect(rect(), QColor(48, 52, 60));
+  painter.setRenderHint(QPainter::Antialiasing);
+
+  if (!_fitted)
+    fit();
+
+  Point eye = _target;
+  eye.x += _distance * std::cos(_pitch) * std::cos(_yaw);
+  eye.y += _distance * std::cos(_pitch) * std::sin(_yaw);
+  eye.z += _distance * std::sin(_pitch);
+  const Point forward = normalized(_target - eye);
+  Point z_up;
+  z_up.z = 1.0;
+  const Point right = normalized(cross(forward, z_up));
+  const Point up = cross(right, forward);
+
+  Point light;
+  light.x = 0.3;
+  light.y = 0.5;
+  light.z = 0.8;
+  light = normalized(light);
+
+  const double focal = 0.5 * height() / std::tan(0.5 * FIELD_OF_VIEW);
+  const QPointF center(0.5 * width(), 0.5 * height());
+
+  std::vector<Projected> projected;
+  int num_walls = 0, num_floors = 0;
+  std::size_t num_triangles = 0;
+  for (const WorldPreview::LevelMesh& mesh : _preview->meshes())
+  {
+    num_walls += mesh.num_walls;
+    num_floors += mesh.num_floors;
+    num_triangles += mesh.triangles.size();
+    for (const WorldPreview::Triangle& triangle : mesh.triangles)
+    {
+      const Point normal = normalized(
+        cross(triangle.v[1] - triangle.v[0], triangle.v[2] - triangle.v[0]));
+      if (dot(normal, eye - triangle.v[0]) <= 0.0)
+        continue;  // facing away
+
+      Projected p;
+      bool visible = true;
+      for (const Point& v : triangle.v)
+      {
+        const Point d = v - eye;
+        const double depth = dot(d, forward);
+        if (depth < NEAR_PLANE)
+        {
+          visible = false;
+          break;
+        }
+        p.polygon.append(
+          center + QPointF(
+            focal * dot(d, right) / depth,
+            -focal * dot(d, up) / depth));
+        p.depth += depth / 3.0;
+      }
+      if (!visible)
+        continue;
+
+      const double shade = 0.35 + 0.65 * std::max(0.0, dot(normal, light));
+      const QColor base = triangle.kind == WorldPreview::WALL ?
+        QColor(205, 205, 215) : QColor(175, 165, 145);
+      p.color = QColor::fromRgbF(
+        base.redF() * shade, base.greenF() * shade, base.blueF() * shade);
+      projected.push_back(p);
+    }
+  }
+
+  // painter's algorithm: the farthest first
+  std::sort(
+    projected.begin(),
+    projected.end(),
+    [](const Projected& a, const Projected& b)
+    {
+      return a.depth > b.depth;
+    });
+  for (const Projected& p : projected)
+  {
+    painter.setPen(QPen(p.color.darker(115), 0));
+    painter.setBrush(p.color);
+    painter.drawPolygon(p.polygon);
+  }
+
+  QString status = QString("%1 walls, %2 floors, %3 triangles").arg(
+    QString::number(num_walls),
+    QString::number(num_floors),
+    QString::number(num_triangles));
+  if (_preview->is_building())
+    status += " (rebuilding...)";
+  painter.setPen(QColor(Qt::white));
+  painter.drawText(QPointF(8, 16), status);
+}
+
+void WorldPreviewView::mousePressEvent(QMouseEvent* e)
+{
+  _last_mouse_pos = e->pos();
+}
+
+void WorldPreviewView::mouseMoveEvent(QMouseEvent* e)
+{
+  const QPoint delta = e->pos() - _last_mouse_pos;
+  _last_mouse_pos = e->pos();
+
+  if (e->buttons() & Qt::LeftButton)
+  {
+    _yaw -= 0.01 * delta.x();
+    _pitch = std::max(
+      MIN_PITCH,
+      std::min(MAX_PITCH, _pitch + 0.01 * delta.y()));
+  }
+  else if (e->buttons() & (Qt::RightButton | Qt::MiddleButton))
+  {
+    // move the target across the screen, as far as the pointer moved
+    const double meters_per_pixel =
+      _distance * std::tan(0.5 * FIELD_OF_VIEW) / (0.5 * height());
+    const double sx = -delta.x() * meters_per_pixel;
+    const double sy = delta.y() * meters_per_pixel;
+    _target.x += sx * -std::sin(_yaw) - sy * std::cos(_yaw);
+    _target.y += sx * std::cos(_yaw) - sy * std::sin(_yaw);
+  }
+  else
+    return;
+  update();
+}
+
+void WorldPreviewView::mouseDoubleClickEvent(QMouseEvent*)
+{
+  _fitted = false;
+  update();
+}
+
+void WorldPreviewView::wheelEvent(QWheelEvent* e)
+{
+  _distance = std::max(1.0, _distance * std::pow(0.999, e->angleDelta().y()));
+  update();
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRAFFIC_EDITOR__WORLD_PREVIEW_VIEW_HPP
+#define TRAFFIC_EDITOR__WORLD_PREVIEW_VIEW_HPP
+
+#include <QPoint>
+#include <QWidget>
+
+#include "world_preview.hpp"
+
+//=============================================================================
+/// Draws the meshes of a WorldPreview in perspective with QPainter, sorted
+/// back to front and flat shaded, which is plenty for a few thousand
+/// triangles and needs no OpenGL. Drag to orbit, drag with the right or
+/// middle button to pan, scroll to zoom and double click to fit it all in
+/// view again. It repaints whenever the preview is updated.
+class WorldPreviewView : public QWidget
+{
+public:
+  WorldPreviewView(const WorldPreview* preview, QWidget* parent = nullptr);
+
+  QSize sizeHint() const override { return QSize(640, 480); }
+
+protected:
+  void paintEvent(QPaintEvent* e) override;
+  void mousePressEvent(QMouseEvent* e) override;
+  void mouseMoveEvent(QMouseEvent* e) override;
+  void mouseDoubleClickEvent(QMouseEvent* e) override;
+  void wheelEvent(QWheelEvent* e) override;
+
+private:
+  const WorldPreview* _preview;
+
+  // an orbit camera around a target point, in radians and meters
+  double _yaw = -0.8;
+  double _pitch = 0.6;
+  double _distance = 50.0;
+  WorldPreview::Point _target;
+  bool _fitted = false;  // the camera was aimed at the meshes
+
+  QPoint _last_mouse_pos;
+
+  void fit();
+};
+
+#endif
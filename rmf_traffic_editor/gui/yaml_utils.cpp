@@ -54,16 +54,32 @@ void yaml_utils::write_node(
     case YAML::NodeType::Map:
     {
       emitter << YAML::BeginMap;
-      // the keys are stored in random order, so we need to collect and sort
+      // the keys are stored in random order, so we need to collect and sort.
+      // Keep the value nodes too, since looking a key up is a linear search.
+      // Sort indices, because assigning a YAML::Node overwrites its target
       std::vector<string> keys;
+      std::vector<YAML::Node> values;
       keys.reserve(node.size());
+      values.reserve(node.size());
       for (YAML::const_iterator it = node.begin(); it != node.end(); ++it)
+      {
         keys.push_back(it->first.as<string>());
-      std::sort(keys.begin(), keys.end());
-      for (std::size_t i = 0; i < keys.size(); i++)
+        values.push_back(it->second);
+      }
+      std::vector<std::size_t> order(keys.size());
+      for (std::size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+      std::stable_sort(
+        order.begin(),
+        order.end(),
+        [&keys](const std::size_t a, const std::size_t b)
+        {
+          return keys[a] < keys[b];
+        });
+      for (const std::size_t i : order)
       {
         emitter << YAML::Key << keys[i] << YAML::Value;
-        write_node(node[keys[i]], emitter);
+        write_node(values[i], emitter);
       }
       emitter << YAML::EndMap;
       break;
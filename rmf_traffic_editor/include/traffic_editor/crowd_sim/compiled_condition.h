@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef CROWD_SIM_COMPILED_CONDITION__H
+#define CROWD_SIM_COMPILED_CONDITION__H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <yaml-cpp/yaml.h>
+
+#include <traffic_editor/crowd_sim/condition.h>
+
+namespace crowd_sim {
+
+/*
+ * CompiledCondition class. A Condition tree flattened into postfix
+ * bytecode, for evaluating the transition of many agents at once. Each
+ * leaf reads its threshold from a value slot, so thresholds can be tuned
+ * without compiling again. Batches are evaluated one instruction at a
+ * time over a block of agents, which keeps the inner loops free of
+ * branches and virtual calls.
+ */
+class CompiledCondition
+{
+public:
+  enum OpCode : uint8_t
+  {
+    GOAL = 0,  // goal distance <= value
+    TIMER,     // time in the current state >= value
+    AND,
+    OR,
+    NOT
+  };
+
+  struct Op
+  {
+    OpCode code;
+    uint16_t slot;  // value slot of a leaf
+  };
+
+  /// Agents are evaluated in blocks of this many
+  static constexpr std::size_t BLOCK_SIZE = 256;
+
+  /// Deepest evaluation stack a condition may need
+  static constexpr std::size_t MAX_DEPTH = 32;
+
+  /// Flatten a condition tree. Returns false, leaving this empty, if the
+  /// tree is invalid (an unset or incomplete condition) or too deep.
+  bool compile(const ConditionPtr& condition);
+
+  /// Flatten the "condition" node of a transition directly, without
+  /// building the tree first
+  bool compile(const YAML::Node& condition_node);
+
+  void clear();
+  bool empty() const { return _ops.empty(); }
+
+  const std::vector<Op>& ops() const { return _ops; }
+  std::size_t num_slots() const { return _values.size(); }
+  double value(const std::size_t slot) const { return _values[slot]; }
+  void set_value(const std::size_t slot, const double value);
+
+  /// Evaluate for one agent
+  bool evaluate(const float goal_distance, const float state_time) const;
+
+  /// Evaluate for n agents; result[i] is 1 if the condition holds for
+  /// agent i, otherwise 0
+  void evaluate(
+    const float* goal_distance,
+    const float* state_time,
+    const std::size_t n,
+    uint8_t* result) const;
+
+  /// Rebuild the tree, and its YAML, from the bytecode
+  ConditionPtr to_condition() const;
+  YAML::Node to_yaml() const;
+
+private:
+  std::vector<Op> _ops;
+  std::vector<double> _values;
+  std::vector<float> _thresholds;  // _values, to compare with agent states
+
+  bool compile_node(const ConditionPtr& condition);
+  bool compile_yaml(const YAML::Node& node);
+  void add_leaf(const OpCode code, const double value);
+
+  /// Check the stack never gets deeper than MAX_DEPTH
+  bool check_depth() const;
+};
+
+} //namespace crowd_sim
+
+#endif
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef CROWD_SIM_CONFIG_VALIDATOR__H
+#define CROWD_SIM_CONFIG_VALIDATOR__H
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <traffic_editor/crowd_sim/crowd_sim_impl.h>
+
+namespace crowd_sim {
+
+/*
+ * ConfigValidator class. Checks the names by which the parts of a crowd
+ * simulation configuration refer to each other: the goal sets of states,
+ * the states of transitions, the profiles and initial states of agent
+ * groups, and the model types of the profiles. It also follows the
+ * transitions from the initial states of the agent groups, to find the
+ * states which no agent can reach and those it can never leave. Each
+ * check only runs again when a part it reads has a new revision, and the
+ * name to index maps of the parts are rebuilt the same way, so updating
+ * after an edit of one table only rechecks what depends on it.
+ */
+class ConfigValidator
+{
+public:
+  using Part = CrowdSimImplementation::Part;
+
+  struct Problem
+  {
+    Part part;  // the one to edit to fix it
+    std::string message;
+  };
+
+  /// Recheck whatever changed since the last call. Returns true if any
+  /// check ran again.
+  bool update(const CrowdSimImplementation& impl);
+
+  /// The problems to fix in one part
+  std::vector<std::string> problems(const Part part) const;
+  std::size_t num_problems() const;
+
+private:
+  enum Check
+  {
+    STATE_CHECK = 0,
+    GOAL_SET_CHECK,
+    TRANSITION_CHECK,
+    AGENT_PROFILE_CHECK,
+    AGENT_GROUP_CHECK,
+    MODEL_TYPE_CHECK,
+    REACHABILITY_CHECK,
+    NUM_CHECKS
+  };
+
+  struct CheckResult
+  {
+    std::vector<std::size_t> revisions;  // of the parts it read
+    bool done = false;
+    std::vector<Problem> problems;
+  };
+  CheckResult _checks[NUM_CHECKS];
+
+  /// Name to index, of the first entry with each name; goal sets are
+  /// keyed by their id and goal areas map to their position in the list
+  struct Index
+  {
+    std::unordered_map<std::string, std::size_t> names;
+    std::size_t revision = 0;
+    bool built = false;
+  };
+  Index _indices[CrowdSimImplementation::NUM_PARTS];
+
+  const Index& _index(const CrowdSimImplementation& impl, const Part part);
+
+  void _check_states(
+    const CrowdSimImplementation& impl,
+    std::vector<Problem>& problems);
+  void _check_goal_sets(
+    const CrowdSimImplementation& impl,
+    std::vector<Problem>& problems);
+  void _check_transitions(
+    const CrowdSimImplementation& impl,
+    std::vector<Problem>& problems);
+  void _check_agent_profiles(
+    const CrowdSimImplementation& impl,
+    std::vector<Problem>& problems);
+  void _check_agent_groups(
+    const CrowdSimImplementation& impl,
+    std::vector<Problem>& problems);
+  void _check_model_types(
+    const CrowdSimImplementation& impl,
+    std::vector<Problem>& problems);
+  void _check_reachability(
+    const CrowdSimImplementation& impl,
+    std::vector<Problem>& problems);
+};
+
+} //namespace crowd_sim
+
+#endif
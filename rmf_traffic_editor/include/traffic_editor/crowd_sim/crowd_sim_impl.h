@@ -21,6 +21,7 @@
 #include <string>
 #include <set>
 #include <memory>
+#include <vector>
 
 #include <yaml-cpp/yaml.h>
 
@@ -33,9 +34,48 @@
 
 namespace crowd_sim {
 
+/// Where agents can go between the navmeshes of two levels: the lift of
+/// this name, at the center of its cabin on each, in the coordinates of
+/// that level's navmesh
+struct NavmeshLink
+{
+  std::string name;
+  std::string from_file_name;
+  std::string to_file_name;
+  double from_x = 0.0;
+  double from_y = 0.0;
+  double to_x = 0.0;
+  double to_y = 0.0;
+
+  bool operator==(const NavmeshLink& other) const
+  {
+    return name == other.name && from_file_name == other.from_file_name &&
+      to_file_name == other.to_file_name && from_x == other.from_x &&
+      from_y == other.from_y && to_x == other.to_x && to_y == other.to_y;
+  }
+
+  YAML::Node to_yaml() const;
+  void from_yaml(const YAML::Node& input);
+};
+
 class CrowdSimImplementation
 {
 public:
+  /// The parts of the configuration which have their own revision number,
+  /// so that a view of one of them can tell whether it has to be rebuilt
+  enum Part
+  {
+    SETTINGS = 0,  // enable_crowd_sim, update_time_step, navmeshes, links
+    GOAL_AREAS,
+    STATES,
+    GOAL_SETS,
+    TRANSITIONS,
+    AGENT_PROFILES,
+    AGENT_GROUPS,
+    MODEL_TYPES,
+    NUM_PARTS
+  };
+
   CrowdSimImplementation()
   : _enable_crowd_sim(false),
     _update_time_step(0.1)
@@ -45,63 +85,103 @@ public:
   ~CrowdSimImplementation() {}
 
 
-  YAML::Node to_yaml();
+  YAML::Node to_yaml() const;
   bool from_yaml(const YAML::Node& input);
   void clear();
   void init_default_configure();
 
+  /// Bumped whenever a part is replaced, or anything at all, respectively
+  std::size_t revision(const Part part) const { return _revisions[part]; }
+  std::size_t revision() const { return _revision; }
+
   void set_navmesh_file_name(std::vector<std::string> navmesh_filename)
   {
-    _navmesh_filename_list = navmesh_filename;
+    if (navmesh_filename == _navmesh_filename_list)
+      return;
+    _navmesh_filename_list = std::move(navmesh_filename);
+    _changed(SETTINGS);
   }
-  std::vector<std::string> get_navmesh_file_name() const
+  const std::vector<std::string>& get_navmesh_file_name() const
   {
     return _navmesh_filename_list;
   }
 
-  void set_enable_crowd_sim(bool is_enable) { _enable_crowd_sim = is_enable; }
+  /// The links between the navmeshes of the levels, at the lifts
+  void set_navmesh_links(std::vector<NavmeshLink> links)
+  {
+    if (links == _navmesh_links)
+      return;
+    _navmesh_links = std::move(links);
+    _changed(SETTINGS);
+  }
+  const std::vector<NavmeshLink>& get_navmesh_links() const
+  {
+    return _navmesh_links;
+  }
+
+  void set_enable_crowd_sim(bool is_enable)
+  {
+    if (is_enable == _enable_crowd_sim)
+      return;
+    _enable_crowd_sim = is_enable;
+    _changed(SETTINGS);
+  }
   bool get_enable_crowd_sim() const { return _enable_crowd_sim; }
 
   void set_update_time_step(double update_time_step)
   {
+    if (update_time_step == _update_time_step)
+      return;
     _update_time_step = update_time_step;
+    _changed(SETTINGS);
   }
   double get_update_time_step() const { return _update_time_step; }
 
-  void set_goal_areas(std::set<std::string> goal_areas)
-  {
-    _goal_areas = goal_areas;
-  }
-  std::vector<std::string> get_goal_areas() const
+  void set_goal_areas(std::set<std::string> goal_areas);
+  const std::vector<std::string>& get_goal_areas() const
   {
-    return std::vector<std::string>(_goal_areas.begin(), _goal_areas.end());
+    return _goal_area_list;
   }
 
-  void save_goal_sets(const std::vector<GoalSet>& goal_sets);
-  std::vector<GoalSet> get_goal_sets() const { return _goal_sets; }
+  // The save_*() functions take their argument by value, so that a caller
+  // which is done with its copy can move it in
 
-  void save_states(const std::vector<State>& states);
-  std::vector<State> get_states() const { return _states; }
+  void save_goal_sets(std::vector<GoalSet> goal_sets);
+  const std::vector<GoalSet>& get_goal_sets() const { return _goal_sets; }
 
-  void save_transitions(const std::vector<Transition>& transitions);
-  std::vector<Transition> get_transitions() const { return _transitions; }
+  void save_states(std::vector<State> states);
+  const std::vector<State>& get_states() const { return _states; }
 
-  void save_agent_profiles(const std::vector<AgentProfile>& agent_profiles);
-  std::vector<AgentProfile> get_agent_profiles() const
+  void save_transitions(std::vector<Transition> transitions);
+  const std::vector<Transition>& get_transitions() const
+  {
+    return _transitions;
+  }
+
+  void save_agent_profiles(std::vector<AgentProfile> agent_profiles);
+  const std::vector<AgentProfile>& get_agent_profiles() const
   {
     return _agent_profiles;
   }
 
-  void save_agent_groups(const std::vector<AgentGroup>& agent_groups);
-  std::vector<AgentGroup> get_agent_groups() const { return _agent_groups; }
+  void save_agent_groups(std::vector<AgentGroup> agent_groups);
+  const std::vector<AgentGroup>& get_agent_groups() const
+  {
+    return _agent_groups;
+  }
 
-  void save_model_types(const std::vector<ModelType>& model_types);
-  std::vector<ModelType> get_model_types() const { return _model_types; }
+  void save_model_types(std::vector<ModelType> model_types);
+  const std::vector<ModelType>& get_model_types() const
+  {
+    return _model_types;
+  }
 
 private:
   // update from project.building in crowd_sim_table
   std::set<std::string> _goal_areas;
+  std::vector<std::string> _goal_area_list;  // _goal_areas, in order
   std::vector<std::string> _navmesh_filename_list;
+  std::vector<NavmeshLink> _navmesh_links;
 
   // real configurations
   bool _enable_crowd_sim;
@@ -113,6 +193,16 @@ private:
   std::vector<AgentGroup> _agent_groups;
   std::vector<ModelType> _model_types;
 
+  std::size_t _revisions[NUM_PARTS] = {};
+  std::size_t _revision = 0;
+
+  void _changed(const Part part)
+  {
+    _revisions[part]++;
+    _revision++;
+  }
+  void _changed_all();
+
   void _initialize_state();
   void _initialize_agent_profile();
   void _initialize_agent_group();
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+
+#ifndef PLUGINS_BATCH_EDIT_H
+#define PLUGINS_BATCH_EDIT_H
+
+#include <string>
+
+#include <yaml-cpp/yaml.h>
+
+#include "batch_edit_transaction.hpp"
+
+//=============================================================================
+/// A scripted bulk edit of a building: renaming a series of vertices,
+/// retagging the params of chargers, regenerating the lanes of a graph...
+/// The plugin doesn't get the building itself but a BatchEditTransaction,
+/// which keeps track of what it touched, so that the editor redraws only
+/// that and undoes the whole run in one step.
+class BatchEdit
+{
+public:
+  static constexpr int API_VERSION = 1;
+
+  virtual ~BatchEdit() = default;
+
+  virtual int api_version() const { return API_VERSION; }
+
+  /// Shown in the menu and the undo history
+  virtual std::string name() const = 0;
+
+  virtual void load(const YAML::Node& config_data) = 0;
+
+  /// Make the edit, possibly on several levels at once with
+  /// for_each_level(). Returning false discards it: whatever had been
+  /// changed is put back.
+  virtual bool run(BatchEditTransaction& transaction) = 0;
+};
+
+#endif
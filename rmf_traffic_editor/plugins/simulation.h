@@ -18,7 +18,11 @@
 #ifndef PLUGINS_SIMULATION_H
 #define PLUGINS_SIMULATION_H
 
-#include "traffic_editor/building.h"
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "building.h"
 
 class QGraphicsScene;
 
@@ -39,4 +43,240 @@ public:
   virtual void scene_clear() = 0;
 };
 
+//=============================================================================
+/// What changed during one tick of a SimulationV2 plugin. Instead of
+/// walking the scene itself, the plugin only reports the models it moved
+/// (by level and model index) and the models it created or removed, and
+/// the editor repositions just those pixmaps.
+struct SimulationBatch
+{
+  struct Update
+  {
+    int level_idx = 0;
+    int model_idx = 0;
+    ModelState state;
+  };
+
+  struct Spawn
+  {
+    int level_idx = 0;
+    Model model;
+  };
+
+  struct Despawn
+  {
+    int level_idx = 0;
+    QUuid uuid;
+  };
+
+  std::vector<Update> updates;
+  std::vector<Spawn> spawned;
+  std::vector<Despawn> despawned;
+
+  void clear()
+  {
+    updates.clear();
+    spawned.clear();
+    despawned.clear();
+  }
+
+  bool empty() const
+  {
+    return updates.empty() && spawned.empty() && despawned.empty();
+  }
+
+  /// Write the batch into the building: updates first (their indices refer
+  /// to the model lists as they were during the tick), then despawns and
+  /// spawns. Pixmaps of updated models on the given level are moved in
+  /// place. Returns true if models were added or removed, in which case
+  /// the level has to be redrawn.
+  bool apply(Building& building, const int drawn_level_idx) const
+  {
+    const int num_levels = static_cast<int>(building.levels.size());
+    for (const Update& update : updates)
+    {
+      if (update.level_idx < 0 || update.level_idx >= num_levels)
+        continue;
+      std::vector<Model>& models = building.levels[update.level_idx].models;
+      if (update.model_idx < 0 ||
+        update.model_idx >= static_cast<int>(models.size()))
+        continue;
+      Model& model = models[update.model_idx];
+      model.state = update.state;
+      if (update.level_idx == drawn_level_idx)
+        model.update_pose();
+    }
+
+    bool structure_changed = false;
+    for (const Despawn& despawn : despawned)
+    {
+      if (despawn.level_idx < 0 || despawn.level_idx >= num_levels)
+        continue;
+      Level& level = building.levels[despawn.level_idx];
+      const int model_idx = level.find_model_index(despawn.uuid);
+      if (model_idx < 0)
+        continue;
+      level.models.erase(level.models.begin() + model_idx);
+      level.mark_all_changed();
+      structure_changed = true;
+    }
+    for (const Spawn& spawn : spawned)
+    {
+      if (spawn.level_idx < 0 || spawn.level_idx >= num_levels)
+        continue;
+      Level& level = building.levels[spawn.level_idx];
+      level.models.push_back(spawn.model);
+      level.models.back().clear_scene();
+      level.mark_all_changed();
+      structure_changed = true;
+    }
+    return structure_changed;
+  }
+};
+
+//=============================================================================
+/// Version 2 of the simulation plugin interface. Plugins report what they
+/// changed in a SimulationBatch rather than updating the scene themselves.
+class SimulationV2
+{
+public:
+  static constexpr int API_VERSION = 2;
+
+  enum Capability
+  {
+    /// tick() only reports the models that actually moved
+    DIRTY_MODEL_BATCHES = 1 << 0,
+    /// tick() may spawn and despawn models
+    SPAWN_DESPAWN = 1 << 1,
+    /// the plugin never needs the scene and can run without a window
+    HEADLESS = 1 << 2
+  };
+
+  /// Parts of the building a plugin reads or writes during tick(), so that
+  /// plugins which don't conflict can be ticked at the same time
+  enum Resource
+  {
+    MODELS = 1 << 0,
+    DOORS = 1 << 1,
+    LIFTS = 1 << 2,
+    CROWD_SIM = 1 << 3,
+    GRAPHS = 1 << 4,
+    GEOMETRY = 1 << 5,  // vertices, edges and polygons other than doors
+    ALL_RESOURCES = (1 << 6) - 1
+  };
+
+  virtual ~SimulationV2() = default;
+
+  virtual int api_version() const { return API_VERSION; }
+
+  /// By default a plugin may touch everything, and so never runs alongside
+  /// another one
+  virtual unsigned int reads() const { return ALL_RESOURCES; }
+  virtual unsigned int writes() const { return ALL_RESOURCES; }
+  virtual unsigned int capabilities() const = 0;
+
+  bool has_capability(const Capability capability) const
+  {
+    return (capabilities() & capability) != 0;
+  }
+
+  virtual void load(const YAML::Node& config_data) = 0;
+
+  /// Advance the simulation by one step. The batch is cleared by the
+  /// caller; the plugin appends to it.
+  virtual void tick(Building& building, SimulationBatch& batch) = 0;
+
+  virtual void reset(Building& building) = 0;
+  virtual void scene_clear() = 0;
+};
+
+//=============================================================================
+/// Runs a version 1 plugin behind the version 2 interface. The pose of
+/// every model is remembered before the tick and compared afterwards, so
+/// the editor still only moves what changed, at the cost of one pass over
+/// the models per tick. Version 1 plugins can't spawn or despawn models.
+class SimulationV1Adapter : public SimulationV2
+{
+public:
+  /// A version 1 plugin can't declare what it touches, so the caller may
+  /// do it on its behalf
+  explicit SimulationV1Adapter(
+    std::unique_ptr<Simulation> simulation,
+    const unsigned int reads = ALL_RESOURCES,
+    const unsigned int writes = ALL_RESOURCES)
+  : _simulation(std::move(simulation)),
+    _reads(reads),
+    _writes(writes)
+  {
+  }
+
+  // the before/after comparison in tick() reads every model
+  unsigned int reads() const override { return _reads | MODELS; }
+  unsigned int writes() const override { return _writes; }
+
+  unsigned int capabilities() const override
+  {
+    return DIRTY_MODEL_BATCHES;
+  }
+
+  void load(const YAML::Node& config_data) override
+  {
+    _simulation->load(config_data);
+  }
+
+  void tick(Building& building, SimulationBatch& batch) override
+  {
+    _previous.resize(building.levels.size());
+    for (std::size_t i = 0; i < building.levels.size(); i++)
+    {
+      const std::vector<Model>& models = building.levels[i].models;
+      _previous[i].resize(models.size());
+      for (std::size_t j = 0; j < models.size(); j++)
+        _previous[i][j] = models[j].state;
+    }
+
+    _simulation->tick(building);
+
+    for (std::size_t i = 0; i < building.levels.size(); i++)
+    {
+      const std::vector<Model>& models = building.levels[i].models;
+      const std::size_t num_models =
+        std::min(models.size(), _previous[i].size());
+      for (std::size_t j = 0; j < num_models; j++)
+      {
+        const ModelState& before = _previous[i][j];
+        const ModelState& after = models[j].state;
+        if (after.x == before.x && after.y == before.y &&
+          after.z == before.z && after.yaw == before.yaw &&
+          after.level_name == before.level_name)
+          continue;
+        SimulationBatch::Update update;
+        update.level_idx = static_cast<int>(i);
+        update.model_idx = static_cast<int>(j);
+        update.state = after;
+        batch.updates.push_back(update);
+      }
+    }
+  }
+
+  void reset(Building& building) override
+  {
+    _simulation->reset(building);
+  }
+
+  void scene_clear() override
+  {
+    _simulation->scene_clear();
+  }
+
+  /// The wrapped plugin, for callers that still draw through scene_update()
+  Simulation* simulation() { return _simulation.get(); }
+
+private:
+  std::unique_ptr<Simulation> _simulation;
+  unsigned int _reads;
+  unsigned int _writes;
+  std::vector<std::vector<ModelState>> _previous;
+};
+
 #endif
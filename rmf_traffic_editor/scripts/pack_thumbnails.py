@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+
+# Copyright 2021 Open Source Robotics Foundation, Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Packs the thumbnails of the models of model_list.yaml into a single
+# thumbnails.bundle beside it, which the editor memory-maps instead of
+# opening every images/cropped/*.png. See gui/thumbnail_bundle.hpp for
+# the layout.
+
+import os
+import struct
+import sys
+import yaml
+import argparse
+
+MAGIC = 0x424d4854  # "THMB"
+VERSION = 1
+
+
+def string_table(strings):
+    offset = (len(strings) + 1) * 4
+    offsets = []
+    for s in strings:
+        offsets.append(offset)
+        offset += len(s) + 1
+    offsets.append(offset)
+    return struct.pack('<{}I'.format(len(offsets)), *offsets) + \
+        b''.join(s + b'\0' for s in strings)
+
+
+def pack(thumbnail_dir, output_path):
+    with open(os.path.join(thumbnail_dir, 'model_list.yaml')) as f:
+        model_list = yaml.safe_load(f)
+
+    images = []
+    for model_name in model_list['models']:
+        png_path = os.path.join(
+            thumbnail_dir, 'images', 'cropped', model_name + '.png')
+        if not os.path.exists(png_path):
+            print(' Warn!! {} has no thumbnail, skip!'.format(model_name))
+            continue
+        with open(png_path, 'rb') as f:
+            images.append((model_name.encode('utf-8'), f.read()))
+
+    # string 0 is the empty string, as in the editor's StringTable
+    strings = string_table([b''] + [name for name, _ in images])
+    offset = 16 + 16 * len(images) + len(strings)
+    entries = b''
+    for i, (_, data) in enumerate(images):
+        entries += struct.pack('<IIQ', i + 1, len(data), offset)
+        offset += len(data)
+
+    header = struct.pack('<IIII', MAGIC, VERSION, len(images), len(images) + 1)
+    # write it aside, so that a running editor never maps a partial bundle
+    tmp_path = output_path + '.tmp'
+    with open(tmp_path, 'wb') as f:
+        f.write(header)
+        f.write(entries)
+        f.write(strings)
+        for _, data in images:
+            f.write(data)
+    os.replace(tmp_path, output_path)
+    print('packed {} thumbnails into {}'.format(len(images), output_path))
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser()
+    parser.add_argument(
+        'thumbnail_dir',
+        help='Thumbnail directory, with model_list.yaml and images/cropped/'
+    )
+    parser.add_argument(
+        '-o', '--output', default='',
+        help='Output bundle (default: thumbnails.bundle in thumbnail_dir)'
+    )
+    args = parser.parse_args(sys.argv[1:])
+
+    output_path = args.output
+    if output_path == '':
+        output_path = os.path.join(args.thumbnail_dir, 'thumbnails.bundle')
+    pack(args.thumbnail_dir, output_path)
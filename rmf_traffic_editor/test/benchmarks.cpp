@@ -0,0 +1,973 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include <QtWidgets>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include "../gui/building.h"
+#include "../gui/building_diff.hpp"
+#include "../gui/building_snapshot.hpp"
+#include "../gui/building_statistics.hpp"
+#include "../gui/compact_building.hpp"
+#include "../gui/coordinate_conversion.hpp"
+#include "../gui/dxf_importer.hpp"
+#include "../gui/edit_journal.hpp"
+#include "../gui/edit_sync.hpp"
+#include "../gui/editor_model.h"
+#include "../gui/fiducial_pairing.hpp"
+#include "../gui/geometry_cleanup.hpp"
+#include "../gui/geometry_simplifier.hpp"
+#include "../gui/joint_alignment.hpp"
+#include "../gui/lane_grid_generator.hpp"
+#include "../gui/lane_path_planner.hpp"
+#include "../gui/lane_sweep_checker.hpp"
+#include "../gui/lane_usage_analysis.hpp"
+#include "../gui/level_registration.hpp"
+#include "../gui/model_overlap_checker.hpp"
+#include "../gui/param_index.hpp"
+#include "../gui/polygon_booleans.hpp"
+#include "../gui/rendering_options.h"
+#include "../gui/tile_server.hpp"
+#include "../gui/traffic_preview.hpp"
+#include "../gui/wall_extractor.hpp"
+
+// Timings of the operations that slow down on big maps, each run at a few
+// sizes. Run it by hand, before and after a change, e.g.
+//   QT_QPA_PLATFORM=offscreen ./benchmarks -minimumvalue 100
+// ctest runs it once at the smallest sizes only, with
+// TRAFFIC_EDITOR_BENCHMARK_SMOKE set, for the checks in each benchmark.
+class Benchmarks : public QObject
+{
+  Q_OBJECT
+
+private:
+  /// A building of identical levels, each a square grid of about this many
+  /// vertices joined by lanes, with walls around every other cell and
+  /// fiducials at the corners
+  static void make_building(
+    Building& building,
+    const int num_vertices,
+    const int num_levels = 1)
+  {
+    const int side = std::max(2, static_cast<int>(std::sqrt(num_vertices)));
+    const double spacing = 40.0;
+    for (int level_idx = 0; level_idx < num_levels; level_idx++)
+    {
+      Level level;
+      level.name = "L" + std::to_string(level_idx + 1);
+      level.drawing_meters_per_pixel = 0.05;
+      level.elevation = 5.0 * level_idx;
+      level.x_meters = side * spacing * level.drawing_meters_per_pixel;
+      level.y_meters = level.x_meters;
+      building.add_level(level);
+
+      for (int row = 0; row < side; row++)
+      {
+        for (int col = 0; col < side; col++)
+          building.add_vertex(level_idx, col * spacing, row * spacing);
+      }
+      for (int row = 0; row < side; row++)
+      {
+        for (int col = 0; col < side; col++)
+        {
+          const int v = row * side + col;
+          if (col + 1 < side)
+            building.add_edge(level_idx, v, v + 1, Edge::LANE);
+          if (row + 1 < side)
+            building.add_edge(
+              level_idx,
+              v,
+              v + side,
+              (row + col) % 2 ? Edge::WALL : Edge::LANE);
+        }
+      }
+
+      const double far = (side - 1) * spacing;
+      const double corners[4][2] = {{0, 0}, {far, 0}, {0, far}, {far, far}};
+      for (int i = 0; i < 4; i++)
+      {
+        building.levels[level_idx].fiducials.push_back(
+          Fiducial(corners[i][0], corners[i][1], "f" + std::to_string(i)));
+      }
+    }
+  }
+
+  static void add_count_rows(const std::vector<int>& counts)
+  {
+    QTest::addColumn<int>("count");
+    const bool smoke =
+      qEnvironmentVariableIsSet("TRAFFIC_EDITOR_BENCHMARK_SMOKE");
+    for (const int count : counts)
+    {
+      QTest::newRow(std::to_string(count).c_str()) << count;
+      if (smoke)
+        break;
+    }
+  }
+
+private slots:
+  void save_data() { add_count_rows({1000, 10000, 100000}); }
+  void save()
+  {
+    QFETCH(int, count);
+    Building building;
+    make_building(building, count);
+    QTemporaryDir dir;
+    const std::string path =
+      dir.filePath("benchmark.building.yaml").toStdString();
+    QBENCHMARK {
+      building.invalidate_saved_yaml();  // or it would just be copied out
+      QVERIFY(building.save_to(path));
+    }
+  }
+
+  void load_data() { add_count_rows({1000, 10000, 50000, 100000}); }
+  void load()
+  {
+    QFETCH(int, count);
+    QTemporaryDir dir;
+    const std::string path =
+      dir.filePath("benchmark.building.yaml").toStdString();
+    {
+      Building building;
+      make_building(building, count);
+      QVERIFY(building.save_to(path));
+    }
+    QBENCHMARK {
+      Building building;
+      QVERIFY(building.load(path));
+    }
+  }
+
+  void stream_load_data() { add_count_rows({1000, 10000, 50000, 100000}); }
+  void stream_load()
+  {
+    QFETCH(int, count);
+    QTemporaryDir dir;
+    const std::string path =
+      dir.filePath("benchmark.building.yaml").toStdString();
+    Building saved;
+    make_building(saved, count);
+    QVERIFY(saved.save_to(path));
+    QBENCHMARK {
+      Building building;
+      building.stream_parser = true;
+      QVERIFY(building.load(path));
+      QCOMPARE(
+        building.levels[0].vertices.size(),
+        saved.levels[0].vertices.size());
+      QCOMPARE(building.levels[0].edges.size(), saved.levels[0].edges.size());
+    }
+  }
+
+  void view_load_data() { add_count_rows({1000, 10000, 50000, 100000}); }
+  void view_load()
+  {
+    QFETCH(int, count);
+    QTemporaryDir dir;
+    const std::string path =
+      dir.filePath("benchmark.building.yaml").toStdString();
+    Building saved;
+    make_building(saved, count);
+    QVERIFY(saved.save_to(path));
+    QBENCHMARK {
+      CompactBuilding building;
+      QVERIFY(building.load(path));
+      QCOMPARE(
+        building.levels[0].vertices.size(),
+        saved.levels[0].vertices.size());
+    }
+  }
+
+  void diff_data() { add_count_rows({1000, 10000, 100000}); }
+  void diff()
+  {
+    QFETCH(int, count);
+    Building before;
+    make_building(before, count);
+    Building after;
+    make_building(after, count);  // so nothing can be matched by uuid
+    std::vector<Vertex>& vertices = after.levels[0].vertices;
+    int num_moved = 0;
+    for (std::size_t i = 0; i < vertices.size(); i += 100, num_moved++)
+      vertices[i].x += 2.0;
+    after.levels[0].invalidate_saved_yaml();
+
+    QBENCHMARK {
+      BuildingDiff diff;
+      diff.compute(before, after);
+      QCOMPARE(diff.levels.size(), static_cast<std::size_t>(1));
+      QCOMPARE(diff.levels[0].count(BuildingDiff::MOVED), num_moved);
+    }
+  }
+
+  void cleanup_geometry_data() { add_count_rows({1000, 10000, 100000}); }
+  void cleanup_geometry()
+  {
+    // the level drawn twice over, as merging a map into itself would
+    QFETCH(int, count);
+    Building building;
+    make_building(building, count);
+    const Level& level = building.levels[0];
+    std::vector<Vertex> vertices = level.vertices;
+    std::vector<Edge> edges = level.edges;
+    const int num_vertices = static_cast<int>(vertices.size());
+    const int num_edges = static_cast<int>(edges.size());
+    for (int i = 0; i < num_vertices; i++)
+    {
+      vertices.push_back(vertices[i]);
+      vertices.back().x += 0.01;
+    }
+    for (int i = 0; i < num_edges; i++)
+    {
+      edges.push_back(edges[i]);
+      edges.back().start_idx += num_vertices;
+      edges.back().end_idx += num_vertices;
+    }
+    std::vector<Polygon> polygons;
+
+    QBENCHMARK {
+      std::vector<Vertex> v = vertices;
+      std::vector<Edge> e = edges;
+      const GeometryCleanup::Report report =
+        GeometryCleanup::run(v, e, polygons, 0.1);
+      QCOMPARE(report.welded_vertices, num_vertices);
+      QCOMPARE(report.duplicate_edges, num_edges);
+    }
+  }
+
+  void simplify_geometry_data() { add_count_rows({10000, 100000, 1000000}); }
+  void simplify_geometry()
+  {
+    // traced walls: rows of a thousand vertices a pixel apart, each off the
+    // line by a little
+    QFETCH(int, count);
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> noise(-0.2, 0.2);
+    std::vector<Vertex> vertices;
+    std::vector<Edge> edges;
+    const int row_length = 1000;
+    for (int i = 0; i < count; i++)
+    {
+      vertices.push_back(
+        Vertex(i % row_length, 100.0 * (i / row_length) + noise(rng)));
+      if (i % row_length != 0)
+        edges.push_back(Edge(i - 1, i, Edge::WALL));
+    }
+    std::vector<int> wall_idxs(edges.size());
+    for (std::size_t i = 0; i < wall_idxs.size(); i++)
+      wall_idxs[i] = static_cast<int>(i);
+    std::vector<Polygon> polygons;
+
+    QBENCHMARK {
+      std::vector<Vertex> v = vertices;
+      std::vector<Edge> e = edges;
+      const GeometrySimplifier::Report report =
+        GeometrySimplifier::run(v, e, polygons, wall_idxs, {}, 1.0);
+      QCOMPARE(report.chains, count / row_length);
+    }
+  }
+
+  void union_polygons_data() { add_count_rows({100, 1000, 4000}); }
+  void union_polygons()
+  {
+    // a square grid of overlapping floor tiles, which merge into one
+    QFETCH(int, count);
+    const int columns = static_cast<int>(std::ceil(std::sqrt(count)));
+    std::vector<Vertex> vertices;
+    std::vector<Polygon> polygons;
+    std::vector<int> polygon_idxs;
+    for (int i = 0; i < count; i++)
+    {
+      const double x = 10.0 * (i % columns);
+      const double y = 10.0 * (i / columns);
+      Polygon polygon;
+      polygon.type = Polygon::FLOOR;
+      const double corners[4][2] = {{0, 0}, {12, 0}, {12, 12}, {0, 12}};
+      for (const auto& corner : corners)
+      {
+        polygon.vertices.push_back(static_cast<int>(vertices.size()));
+        vertices.push_back(Vertex(x + corner[0], y + corner[1]));
+      }
+      polygons.push_back(polygon);
+      polygon_idxs.push_back(i);
+    }
+
+    QBENCHMARK {
+      std::vector<Vertex> v = vertices;
+      std::vector<Polygon> p = polygons;
+      const PolygonBooleans::Report report = PolygonBooleans::run(
+        PolygonBooleans::UNION, v, p, polygon_idxs, 0.0, {});
+      QCOMPARE(report.results, 1);
+      QCOMPARE(report.holes, 0);
+    }
+  }
+
+  void append_edges_data() { add_count_rows({1000, 10000, 50000}); }
+  void append_edges()
+  {
+    // as the loaders do: each reallocation of the vector should move the
+    // edges (and their params) it already has, rather than copy them
+    QFETCH(int, count);
+    Building building;
+    make_building(building, count);
+    const std::vector<Edge>& source = building.levels[0].edges;
+    QBENCHMARK {
+      std::vector<Edge> edges;
+      for (const Edge& edge : source)
+      {
+        Edge copy(edge);
+        edges.push_back(std::move(copy));
+      }
+    }
+  }
+
+  void draw_data() { add_count_rows({1000, 10000, 100000}); }
+  void draw()
+  {
+    QFETCH(int, count);
+    Building building;
+    make_building(building, count);
+    std::vector<EditorModel> editor_models;
+    RenderingOptions rendering_options;
+    QGraphicsScene scene;
+    QBENCHMARK {
+      building.detach_cached_items(&scene);
+      scene.clear();
+      building.clear_scene();
+      building.levels[0].mark_all_changed();  // a full redraw
+      building.draw(&scene, 0, editor_models, rendering_options);
+    }
+  }
+
+  void draw_batched_edges_data() { add_count_rows({1000, 10000, 100000}); }
+  void draw_batched_edges()
+  {
+    QFETCH(int, count);
+    Building building;
+    make_building(building, count);
+    std::vector<EditorModel> editor_models;
+    RenderingOptions rendering_options;
+    rendering_options.batch_edges = true;
+    QGraphicsScene scene;
+    QBENCHMARK {
+      building.detach_cached_items(&scene);
+      scene.clear();
+      building.clear_scene();
+      building.levels[0].mark_all_changed();
+      building.draw(&scene, 0, editor_models, rendering_options);
+    }
+    QVERIFY(!scene.items().isEmpty());
+  }
+
+  void nearest_items_data() { add_count_rows({1000, 10000, 100000}); }
+  void nearest_items()
+  {
+    QFETCH(int, count);
+    Building building;
+    make_building(building, count);
+    Level& level = building.levels[0];
+    const double size = level.x_meters / level.drawing_meters_per_pixel;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> uniform(0.0, size);
+    std::vector<QPointF> points;
+    for (int i = 0; i < 1000; i++)
+      points.push_back(QPointF(uniform(rng), uniform(rng)));
+
+    level.nearest_items(0.0, 0.0);  // the first query builds the indices
+    const Level::NearestItem nearest = level.nearest_items(41.0, 39.0);
+    QVERIFY(nearest.vertex_idx >= 0);
+    QCOMPARE(level.vertices[nearest.vertex_idx].x, 40.0);
+    QCOMPARE(level.vertices[nearest.vertex_idx].y, 40.0);
+    QBENCHMARK {
+      for (const QPointF& p : points)
+        level.nearest_items(p.x(), p.y());
+    }
+  }
+
+  void delete_selected_data() { add_count_rows({1000, 10000, 100000}); }
+  void delete_selected()
+  {
+    QFETCH(int, count);
+    Building building;
+    make_building(building, count);
+    Level& level = building.levels[0];
+    QBENCHMARK {
+      // one edge from the middle, so that the ones after it are renumbered
+      if (!level.edges.empty())
+      {
+        level.select(
+          Level::make_selected_item(Level::EDGE, level.edges.size() / 2));
+        QVERIFY(building.delete_selected(0));
+      }
+    }
+  }
+
+  void statistics_after_edit_data() { add_count_rows({1000, 10000, 100000}); }
+  void statistics_after_edit()
+  {
+    QFETCH(int, count);
+    Building building;
+    make_building(building, count);
+    BuildingStatistics statistics;
+    statistics.gather(building);  // the first one counts everything
+    Level& level = building.levels[0];
+    QBENCHMARK {
+      // should take the same time on any size of level
+      level.vertices[0].x += 0.01;
+      level.mark_changed(Level::VERTEX, 0);
+      statistics.gather(building);
+    }
+    QVERIFY(!statistics.levels.empty());
+  }
+
+  void calculate_all_transforms_data() { add_count_rows({2, 10, 50}); }
+  void calculate_all_transforms()
+  {
+    QFETCH(int, count);  // levels this time
+    Building building;
+    make_building(building, 100, count);
+    QBENCHMARK {
+      // move a fiducial of each level, so that nothing is cached
+      for (Level& level : building.levels)
+      {
+        level.fiducials[0].x += 0.01;
+        level.mark_changed(Level::FIDUCIAL, 0);
+      }
+      building.calculate_all_transforms();
+    }
+  }
+
+  void optimize_layer_transforms_data() { add_count_rows({10, 100, 1000}); }
+  void optimize_layer_transforms()
+  {
+    QFETCH(int, count);  // constraints this time
+    Building building;
+    make_building(building, 100);
+    Level& level = building.levels[0];
+    Layer layer;
+    layer.name = "scan";
+    level.layers.push_back(layer);
+
+    // features of a layer that is the floorplan turned, scaled and moved
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<double> uniform(0.0, 1000.0);
+    for (int i = 0; i < count; i++)
+    {
+      const double x = uniform(rng);
+      const double y = uniform(rng);
+      const double c = std::cos(0.1);
+      const double s = std::sin(0.1);
+      const QUuid a = level.add_feature(0, x, y);
+      const QUuid b = level.add_feature(
+        1,
+        0.9 * (c * x - s * y) + 20.0,
+        0.9 * (s * x + c * y) - 10.0);
+      level.add_constraint(a, b);
+    }
+
+    QBENCHMARK {
+      level.layers[0].transform = Transform();  // no warm start
+      level.optimize_layer_transforms();
+    }
+  }
+
+  void optimize_all_transforms_data() { add_count_rows({10, 100, 500}); }
+  void optimize_all_transforms()
+  {
+    // count layers of 20 constraints each, spread over 10 levels which
+    // have the fiducials of make_building() in common
+    QFETCH(int, count);
+    Building building;
+    make_building(building, 100, 10);
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<double> uniform(0.0, 1000.0);
+    for (int i = 0; i < count; i++)
+    {
+      Level& level = building.levels[i % building.levels.size()];
+      Layer layer;
+      layer.name = "scan_" + std::to_string(i);
+      level.layers.push_back(layer);
+      const int layer_idx = static_cast<int>(level.layers.size());
+      for (int j = 0; j < 20; j++)
+      {
+        const double x = uniform(rng);
+        const double y = uniform(rng);
+        const QUuid a = level.add_feature(0, x, y);
+        const QUuid b = level.add_feature(layer_idx, 0.9 * x + 5.0, y - 3.0);
+        level.add_constraint(a, b);
+      }
+    }
+    const std::vector<Building::Transform> initial(building.levels.size());
+    const JointAlignment::Problem problem =
+      JointAlignment::make_problem(building, initial, true);
+
+    QBENCHMARK {
+      const JointAlignment::Solution solution = JointAlignment::solve(
+        problem,
+        QThread::idealThreadCount());
+      QVERIFY(solution.solved);
+    }
+  }
+
+  void convert_coordinates_data() { add_count_rows({100, 300, 1000}); }
+  void convert_coordinates()
+  {
+    // a ReferenceImage building of 10 levels, to CartesianMeters and back
+    QFETCH(int, count);
+    Building building;
+    make_building(building, count, 10);
+    building.coordinate_system = CoordinateSystem::ReferenceImage;
+    CoordinateConversion::Options to_meters;
+    CoordinateConversion::Options to_pixels;
+    to_pixels.target = CoordinateSystem::ReferenceImage;
+
+    QBENCHMARK {
+      CoordinateConversion::State state;
+      std::string error;
+      QVERIFY(
+        CoordinateConversion::convert(building, to_meters, state, error));
+      CoordinateConversion::apply(building, state);
+      QVERIFY(
+        CoordinateConversion::convert(building, to_pixels, state, error));
+      CoordinateConversion::apply(building, state);
+    }
+  }
+
+  void pair_fiducials_data() { add_count_rows({10, 30, 60}); }
+  void pair_fiducials()
+  {
+    // count fiducials on each of 10 levels, unnamed, scaled and shifted
+    // from those of the reference
+    QFETCH(int, count);
+    Building building;
+    make_building(building, 100, 10);
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<double> uniform(0.0, 1000.0);
+    std::vector<Fiducial> reference;
+    for (int i = 0; i < count; i++)
+      reference.push_back(
+        Fiducial(uniform(rng), uniform(rng), "f" + std::to_string(i)));
+    building.levels[0].fiducials = reference;
+    std::vector<int> level_idxs;
+    for (std::size_t i = 1; i < building.levels.size(); i++)
+    {
+      std::vector<Fiducial> fiducials;
+      for (const Fiducial& f : reference)
+        fiducials.push_back(Fiducial(0.5 * f.x + 20.0, 0.5 * f.y - 10.0));
+      std::shuffle(fiducials.begin(), fiducials.end(), rng);
+      building.levels[i].fiducials = fiducials;
+      level_idxs.push_back(static_cast<int>(i));
+    }
+
+    QBENCHMARK {
+      const std::vector<FiducialPairing::Result> results =
+        FiducialPairing::pair_levels(
+          building.levels,
+          0,
+          level_idxs,
+          FiducialPairing::Options());
+      QVERIFY(results.back().found);
+    }
+  }
+
+  void colorize_image_data() { add_count_rows({1000, 2000, 4000}); }
+  void colorize_image()
+  {
+    QFETCH(int, count);  // pixels along each side this time
+    Layer layer;
+    layer.image = QImage(count, count, QImage::Format_Grayscale8);
+    for (int row = 0; row < count; row++)
+    {
+      uchar* line = layer.image.scanLine(row);
+      for (int col = 0; col < count; col++)
+        line[col] = static_cast<uchar>((row ^ col) & 0xff);
+    }
+    layer.color = Layer::default_color(0);
+    QBENCHMARK {
+      layer.colorize_image();
+    }
+  }
+
+  void extract_walls_data() { add_count_rows({1000, 2000, 4000}); }
+  void extract_walls()
+  {
+    // a grid of rooms with 3 pixel thick walls, as in a lidar map
+    QFETCH(int, count);  // pixels along each side
+    QImage image(count, count, QImage::Format_Grayscale8);
+    for (int row = 0; row < count; row++)
+    {
+      uchar* line = image.scanLine(row);
+      for (int col = 0; col < count; col++)
+        line[col] = (row % 100 < 3 || col % 100 < 3) ? 0 : 254;
+    }
+    QBENCHMARK {
+      const std::vector<std::vector<QPointF>> walls =
+        WallExtractor::extract(image, WallExtractor::Options());
+      QVERIFY(!walls.empty());
+    }
+  }
+
+  void register_level_data() { add_count_rows({1000, 2000, 4000}); }
+  void register_level()
+  {
+    // walls strewn over a floorplan, and a part of it off to one side
+    QFETCH(int, count);  // pixels along each side of the floorplan
+    QImage reference(count, count, QImage::Format_Grayscale8);
+    reference.fill(254);
+    std::mt19937 rng(3);
+    for (int i = 0; i < 200; i++)
+    {
+      const int x = rng() % count;
+      const int y = rng() % count;
+      const int length = count / 20 + rng() % (count / 4);
+      const bool across = rng() % 2;
+      for (int t = 0; t < length; t++)
+      {
+        for (int w = 0; w < 3; w++)
+        {
+          const int col = across ? x + t : x + w;
+          const int row = across ? y + w : y + t;
+          if (col < count && row < count)
+            reference.scanLine(row)[col] = 0;
+        }
+      }
+    }
+    const QImage level =
+      reference.copy(count / 10, count / 20, 4 * count / 5, 4 * count / 5);
+    QBENCHMARK {
+      const LevelRegistration::Result result =
+        LevelRegistration::register_level(
+          reference,
+          level,
+          1.0,
+          LevelRegistration::Options());
+      QVERIFY(result.found);
+    }
+  }
+
+  void check_model_overlaps_data() { add_count_rows({1000, 10000, 20000}); }
+  void check_model_overlaps()
+  {
+    // racks of 1 x 0.5 m strewn over the map, one of which is dragged
+    QFETCH(int, count);
+    Building building;
+    make_building(building, count);
+    Level& level = building.levels[0];
+    std::vector<EditorModel> editor_models;
+    editor_models.emplace_back("rack", 0.01);
+    editor_models[0].pixmap = QPixmap(100, 50);
+    const double size = level.x_meters / level.drawing_meters_per_pixel;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> uniform(0.0, size);
+    for (int i = 0; i < count; i++)
+    {
+      Model model;
+      model.model_name = "rack";
+      model.editor_model_idx = 0;
+      model.state.x = uniform(rng);
+      model.state.y = uniform(rng);
+      model.state.yaw = uniform(rng);
+      level.models.push_back(model);
+    }
+
+    ModelOverlapChecker checker;
+    checker.update(level, editor_models);
+    QVERIFY(!checker.conflicts().empty());
+    QBENCHMARK {
+      level.models[0].state.x = uniform(rng);
+      level.mark_moved(Level::MODEL, 0);
+      checker.update(level, editor_models);
+      QVERIFY(checker.num_checked() < count);
+    }
+  }
+
+  void sweep_lanes_data() { add_count_rows({1000, 10000, 20000}); }
+  void sweep_lanes()
+  {
+    // the default footprint along the lanes of the grid, one vertex of
+    // which is dragged
+    QFETCH(int, count);
+    Building building;
+    make_building(building, count);
+    Level& level = building.levels[0];
+    const std::vector<EditorModel> editor_models;
+    LaneSweepChecker checker;
+    checker.update(level, editor_models);
+    QVERIFY(!checker.clear_lanes().empty());
+    const double x = level.vertices[count / 2].x;
+    int i = 0;
+    QBENCHMARK {
+      level.vertices[count / 2].x = x + (++i % 2 ? 5.0 : 0.0);
+      level.mark_moved(Level::VERTEX, count / 2);
+      checker.update(level, editor_models);
+      QVERIFY(checker.num_checked() < count);
+    }
+  }
+
+  void lane_usage_data() { add_count_rows({1000, 10000, 50000}); }
+  void lane_usage()
+  {
+    // the whole grid from scratch, sampled past 256 vertices
+    QFETCH(int, count);
+    Building building;
+    make_building(building, count);
+    const Level& level = building.levels[0];
+    LaneUsageAnalysis analysis;
+    QBENCHMARK {
+      analysis.clear();
+      const LaneUsageAnalysis::Result result = analysis.update(level);
+      QVERIFY(result.max_usage > 0.0);
+      QCOMPARE(result.num_computed, result.num_parts);
+    }
+  }
+
+  void travel_times_data() { add_count_rows({10, 100, 1000}); }
+  void travel_times()
+  {
+    // a count x count matrix between random vertices of a grid of 10000,
+    // contracted once beforehand
+    QFETCH(int, count);
+    Building building;
+    make_building(building, 10000);
+    LanePathPlanner planner;
+    planner.update(building);
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> vertex(
+      0, static_cast<int>(building.levels[0].vertices.size()) - 1);
+    std::vector<LanePathPlanner::Stop> stops(count);
+    for (LanePathPlanner::Stop& stop : stops)
+    {
+      stop.level_idx = 0;
+      stop.vertex_idx = vertex(rng);
+    }
+    planner.travel_times(stops, stops);
+    QBENCHMARK {
+      const std::vector<float> times = planner.travel_times(stops, stops);
+      QCOMPARE(static_cast<int>(times.size()), count * count);
+      QVERIFY(std::isfinite(times.back()));
+    }
+  }
+
+  void traffic_preview_data() { add_count_rows({20, 200}); }
+  void traffic_preview()
+  {
+    // robots visiting 50 random named vertices each, on a grid of 10000
+    QFETCH(int, count);
+    Building building;
+    make_building(building, 10000);
+    Level& level = building.levels[0];
+    for (std::size_t i = 0; i < level.vertices.size(); i += 7)
+      level.vertices[i].name = "v" + std::to_string(i);
+    for (Edge& edge : level.edges)
+    {
+      if (edge.type == Edge::LANE)
+        edge.set_param("bidirectional", "true");
+    }
+
+    TrafficPreview::Missions missions;
+    std::mt19937 random(1);
+    std::uniform_int_distribution<std::size_t> vertex(
+      0, (level.vertices.size() - 1) / 7);
+    for (int r = 0; r < count; r++)
+    {
+      TrafficPreview::Robot robot;
+      robot.name = "robot" + std::to_string(r);
+      robot.start = "v" + std::to_string(7 * vertex(random));
+      for (int i = 0; i < 50; i++)
+        robot.stops.push_back("v" + std::to_string(7 * vertex(random)));
+      missions.robots.push_back(robot);
+    }
+    QBENCHMARK {
+      const TrafficPreview::Result result =
+        TrafficPreview::run(building, missions);
+      QCOMPARE(result.num_failed, 0);
+      QVERIFY(result.num_conflicts > 0);
+    }
+  }
+
+  void apply_shared_edit_data() { add_count_rows({10000, 100000}); }
+  void apply_shared_edit()
+  {
+    // a vertex dragged in another editor, and back
+    QFETCH(int, count);
+    Building building;
+    make_building(building, count);
+    const Level before = building.levels[0];
+    Level after = before;
+    after.vertices[count / 2].x += 5.0;
+    const QJsonArray there = EditSync::operation(before, after);
+    const QJsonArray back = EditSync::operation(after, before);
+    QCOMPARE(there.size(), 1);
+
+    Level& level = building.levels[0];
+    int i = 0;
+    QBENCHMARK {
+      const EditSync::Applied applied =
+        EditSync::apply(level, ++i % 2 ? there : back, false);
+      QCOMPARE(applied.num_applied, 1);
+      level.take_changes();
+    }
+  }
+
+  void record_edit_journal_data() { add_count_rows({10000, 100000}); }
+  void record_edit_journal()
+  {
+    // a vertex dragged across the level, one journaled command at a time
+    QFETCH(int, count);
+    Building building;
+    make_building(building, count);
+    QTemporaryDir dir;
+    QVERIFY(building.set_filename(
+        dir.filePath("benchmark.building.yaml").toStdString()));
+    SnapshotPublisher publisher;
+    EditJournal journal;
+    QVERIFY(journal.start(building, publisher.publish(building)));
+
+    Level& level = building.levels[0];
+    QBENCHMARK {
+      level.vertices[count / 2].x += 1.0;
+      level.mark_changed(Level::VERTEX, count / 2);
+      journal.record(building, publisher.publish(building));
+    }
+    QVERIFY(journal.num_records() > 0);
+  }
+
+  void import_dxf_data() { add_count_rows({10000, 100000, 1000000}); }
+  void import_dxf()
+  {
+    // a grid of wall lines, each end shared by four of them
+    QFETCH(int, count);
+    QTemporaryDir dir;
+    const QString path = dir.filePath("benchmark.dxf");
+    {
+      QFile file(path);
+      QVERIFY(file.open(QIODevice::WriteOnly));
+      QTextStream out(&file);
+      out << "0\nSECTION\n2\nENTITIES\n";
+      const int side = static_cast<int>(std::sqrt(count / 2.0)) + 1;
+      for (int i = 0; i < count; i++)
+      {
+        const int x = (i / 2) % side;
+        const int y = (i / 2) / side;
+        out << "0\nLINE\n8\nA-WALL\n10\n" << x << "\n20\n" << y
+            << "\n11\n" << (i % 2 ? x : x + 1) << "\n21\n"
+            << (i % 2 ? y + 1 : y) << "\n";
+      }
+      out << "0\nENDSEC\n0\nEOF\n";
+    }
+
+    DxfImporter::Options options;
+    options.targets["A-WALL"] = DxfImporter::WALL;
+    QBENCHMARK {
+      const DxfImporter::Result result = DxfImporter::import(path, options);
+      QCOMPARE(static_cast<int>(result.edges.size()), count);
+    }
+  }
+
+  void find_params_data() { add_count_rows({10000, 100000, 200000}); }
+  void find_params()
+  {
+    QFETCH(int, count);
+    Building building;
+    make_building(building, count);
+    ParamIndex::Query query;
+    query.key = "graph_idx";
+    query.find = "0";
+    query.replacement = "1";
+    query.whole_value = true;
+    QBENCHMARK {
+      ParamIndex index;  // built from scratch, as for a building just opened
+      index.update(building);
+      QVERIFY(!index.find(query).matches.empty());
+    }
+  }
+
+  void generate_lane_grid_data() { add_count_rows({10000, 50000, 200000}); }
+  void generate_lane_grid()
+  {
+    QFETCH(int, count);
+    Building building;
+    Level level;
+    level.name = "L1";
+    level.drawing_meters_per_pixel = 0.05;
+    building.add_level(level);
+
+    // a square hall of about count grid vertices a meter apart, with a
+    // wall across the middle of it and a hole in a corner
+    const double side = std::sqrt(static_cast<double>(count)) / 0.05;
+    const double corners[4][2] = {{0, 0}, {side, 0}, {side, side}, {0, side}};
+    Polygon roi;
+    roi.type = Polygon::ROI;
+    for (int i = 0; i < 4; i++)
+    {
+      building.add_vertex(0, corners[i][0], corners[i][1]);
+      roi.vertices.push_back(i);
+    }
+    building.levels[0].polygons.push_back(roi);
+    building.add_vertex(0, 0.25 * side, 0.5 * side);
+    building.add_vertex(0, 0.75 * side, 0.5 * side);
+    building.add_edge(0, 4, 5, Edge::WALL);
+    Polygon hole;
+    hole.type = Polygon::HOLE;
+    for (int i = 0; i < 4; i++)
+    {
+      building.add_vertex(0, 0.1 * corners[i][0], 0.1 * corners[i][1]);
+      hole.vertices.push_back(6 + i);
+    }
+    building.levels[0].polygons.push_back(hole);
+
+    LaneGridGenerator::Options options;
+    options.aisle_spacing = 1.0;
+    options.cross_spacing = 1.0;
+    options.aisle_direction = LaneGridGenerator::ALTERNATING;
+    QBENCHMARK {
+      const LaneGridGenerator::Result result =
+        LaneGridGenerator::generate(building.levels[0], 0, options);
+      QVERIFY(result.num_blocked > 0);
+      QVERIFY(static_cast<int>(result.edges.size()) > count);
+    }
+  }
+
+  void changed_tiles_data() { add_count_rows({10000, 100000, 200000}); }
+  void changed_tiles()
+  {
+    QFETCH(int, count);
+    Building before;
+    make_building(before, count);
+    Building after;
+    make_building(after, count);
+    after.levels[0].vertices[count / 2].x += 2.0;
+    after.levels[0].invalidate_saved_yaml();
+
+    // how many of the tiles of zoom 8 a reload of the server keeps
+    const TileServer::Options options;
+    const int side = 1 << 8;
+    QBENCHMARK {
+      std::vector<QRectF> rects;
+      QVERIFY(
+        TileServer::changed_rects(
+          before.levels[0],
+          after.levels[0],
+          options.change_margin,
+          rects));
+      int num_affected = 0;
+      for (int y = 0; y < side; y++)
+      {
+        for (int x = 0; x < side; x++)
+        {
+          const QRectF tile =
+            TileServer::tile_rect(after.levels[0], options, 8, x, y);
+          num_affected += std::any_of(rects.begin(), rects.end(),
+            [&tile](const QRectF& rect) { return rect.intersects(tile); });
+        }
+      }
+      QVERIFY(num_affected > 0 && num_affected < 16);
+    }
+  }
+};
+
+QTEST_MAIN(Benchmarks)
+#include "benchmarks.moc"
@@ -1,7 +1,15 @@
+#include <cmath>
+
 #include <QtWidgets>
 #include <QTest>
 
+#include "../gui/actions/delete.h"
+#include "../gui/building_snapshot.hpp"
+#include "../gui/edit_journal.hpp"
 #include "../gui/editor.h"
+#include "../gui/interaction_recording.hpp"
+#include "../gui/polygon_booleans.hpp"
+#include "../gui/polygon_geometry.hpp"
 
 class TestGui : public QObject
 {
@@ -10,6 +18,186 @@ class TestGui : public QObject
 private:
   Editor* editor = nullptr;
 
+  /// Add an axis-aligned rectangle polygon, and its vertices
+  static void add_rectangle(
+    std::vector<Vertex>& vertices,
+    std::vector<Polygon>& polygons,
+    const Polygon::Type type,
+    const double x0,
+    const double y0,
+    const double x1,
+    const double y1)
+  {
+    Polygon polygon;
+    polygon.type = type;
+    const double corners[4][2] = {{x0, y0}, {x1, y0}, {x1, y1}, {x0, y1}};
+    for (const auto& corner : corners)
+    {
+      polygon.vertices.push_back(static_cast<int>(vertices.size()));
+      vertices.push_back(Vertex(corner[0], corner[1]));
+    }
+    polygons.push_back(polygon);
+  }
+
+  static QPolygonF outline(
+    const std::vector<Vertex>& vertices,
+    const Polygon& polygon)
+  {
+    QPolygonF ring;
+    for (const int idx : polygon.vertices)
+      ring.push_back(QPointF(vertices[idx].x, vertices[idx].y));
+    return ring;
+  }
+
+  static QString emitted(const YAML::Node& node)
+  {
+    YAML::Emitter emitter;
+    emitter << node;
+    return QString::fromUtf8(emitter.c_str());
+  }
+
+  static qint64 levels_streamed(const Building& building)
+  {
+    const QJsonObject counts =
+      building.load_profile.to_json()["counts"].toObject();
+    return static_cast<qint64>(counts["levels streamed"].toDouble());
+  }
+
+  /// Load a building with the stream parser or yaml-cpp, restoring the
+  /// directory which Building::load() changes to that of the file
+  static bool load_building(
+    const QString& path,
+    const bool stream_parser,
+    Building& building)
+  {
+    const QString cwd = QDir::currentPath();
+    building.stream_parser = stream_parser;
+    building.lazy_images = true;
+    const bool ok = building.load(path.toStdString());
+    QDir::setCurrent(cwd);
+    return ok;
+  }
+
+  static void compare_params(const ParamMap& streamed, const ParamMap& parsed)
+  {
+    QCOMPARE(streamed.size(), parsed.size());
+    for (const auto& param : parsed)
+    {
+      const auto it = streamed.find(param.first);
+      QVERIFY2(it != streamed.end(), param.first.c_str());
+      const Param& a = it->second;
+      const Param& b = param.second;
+      QCOMPARE(a.type, b.type);
+      switch (b.type)
+      {
+        case Param::STRING:
+          QCOMPARE(a.value_string, b.value_string);
+          break;
+        case Param::INT:
+          QCOMPARE(a.value_int, b.value_int);
+          break;
+        case Param::DOUBLE:
+          QVERIFY(a.value_double == b.value_double);
+          break;
+        case Param::BOOL:
+          QCOMPARE(a.value_bool, b.value_bool);
+          break;
+        default:
+          break;
+      }
+    }
+  }
+
+  /// Every field of the levels, lifts, graphs and params of two loads of
+  /// the same building, one of them by BuildingStreamParser
+  static void compare_buildings(
+    const Building& streamed,
+    const Building& parsed)
+  {
+    QCOMPARE(streamed.name, parsed.name);
+    QCOMPARE(streamed.reference_level_name, parsed.reference_level_name);
+    compare_params(streamed.params, parsed.params);
+    if (QTest::currentTestFailed())
+      return;
+
+    QCOMPARE(streamed.levels.size(), parsed.levels.size());
+    for (std::size_t i = 0; i < parsed.levels.size(); i++)
+    {
+      const Level& a = streamed.levels[i];
+      const Level& b = parsed.levels[i];
+      QCOMPARE(a.name, b.name);
+
+      QCOMPARE(a.vertices.size(), b.vertices.size());
+      for (std::size_t j = 0; j < b.vertices.size(); j++)
+      {
+        const Vertex& va = a.vertices[j];
+        const Vertex& vb = b.vertices[j];
+        QVERIFY(va.x == vb.x);
+        QVERIFY(va.y == vb.y);
+        QCOMPARE(va.name, vb.name);
+        QCOMPARE(va.capabilities(), vb.capabilities());
+        compare_params(va.params, vb.params);
+        if (QTest::currentTestFailed())
+          return;
+      }
+
+      QCOMPARE(a.edges.size(), b.edges.size());
+      for (std::size_t j = 0; j < b.edges.size(); j++)
+      {
+        const Edge& ea = a.edges[j];
+        const Edge& eb = b.edges[j];
+        QCOMPARE(ea.start_idx, eb.start_idx);
+        QCOMPARE(ea.end_idx, eb.end_idx);
+        QCOMPARE(ea.type, eb.type);
+        QCOMPARE(ea.is_bidirectional(), eb.is_bidirectional());
+        QCOMPARE(ea.get_graph_idx(), eb.get_graph_idx());
+        QVERIFY(ea.get_width() == eb.get_width());
+        QVERIFY(ea.get_distance() == eb.get_distance());
+        QVERIFY(ea.get_speed_limit() == eb.get_speed_limit());
+        QCOMPARE(ea.has_orientation(), eb.has_orientation());
+        QCOMPARE(ea.get_orientation(), eb.get_orientation());
+        QCOMPARE(ea.get_door_type(), eb.get_door_type());
+        compare_params(ea.params, eb.params);
+        if (QTest::currentTestFailed())
+          return;
+      }
+
+      QCOMPARE(a.polygons.size(), b.polygons.size());
+      for (std::size_t j = 0; j < b.polygons.size(); j++)
+      {
+        const Polygon& pa = a.polygons[j];
+        const Polygon& pb = b.polygons[j];
+        QCOMPARE(pa.type, pb.type);
+        QVERIFY(pa.vertices == pb.vertices);
+        compare_params(pa.params, pb.params);
+        if (QTest::currentTestFailed())
+          return;
+      }
+
+      QCOMPARE(a.models.size(), b.models.size());
+      for (std::size_t j = 0; j < b.models.size(); j++)
+        QCOMPARE(
+          emitted(a.models[j].to_yaml()),
+          emitted(b.models[j].to_yaml()));
+
+      // and whatever else the level has, as it would be saved
+      QCOMPARE(emitted(a.to_yaml()), emitted(b.to_yaml()));
+    }
+
+    QCOMPARE(streamed.lifts.size(), parsed.lifts.size());
+    for (std::size_t i = 0; i < parsed.lifts.size(); i++)
+      QCOMPARE(emitted(streamed.lifts[i].to_yaml()),
+        emitted(parsed.lifts[i].to_yaml()));
+
+    QCOMPARE(streamed.graphs.size(), parsed.graphs.size());
+    for (std::size_t i = 0; i < parsed.graphs.size(); i++)
+    {
+      QCOMPARE(streamed.graphs[i].idx, parsed.graphs[i].idx);
+      QCOMPARE(emitted(streamed.graphs[i].to_yaml()),
+        emitted(parsed.graphs[i].to_yaml()));
+    }
+  }
+
 private slots:
   void initTestCase()
   {
@@ -20,6 +208,482 @@ private slots:
   {
     //QCOMPARE("a", "b");
   }
+
+  /// The scale of a level comes from the distances between its fiducials
+  /// and those of the reference level, however its drawing is turned
+  void rotated_fiducials_scale()
+  {
+    Building building;
+    Level reference;
+    reference.name = "L1";
+    reference.drawing_meters_per_pixel = 0.05;
+    building.add_level(reference);
+    Level rotated;
+    rotated.name = "L2";
+    building.add_level(rotated);
+
+    // the second drawing is at twice the resolution, turned 90 degrees
+    const double points[4][2] = {{0, 0}, {100, 0}, {100, 50}, {0, 80}};
+    for (int i = 0; i < 4; i++)
+    {
+      const std::string name = "f" + std::to_string(i);
+      const double x = points[i][0];
+      const double y = points[i][1];
+      building.levels[0].fiducials.push_back(Fiducial(x, y, name));
+      building.levels[1].fiducials.push_back(
+        Fiducial(300.0 - 2.0 * y, 200.0 + 2.0 * x, name));
+    }
+    building.calculate_all_transforms();
+    QVERIFY(std::abs(building.levels[1].drawing_meters_per_pixel - 0.025) <
+      1e-9);
+  }
+
+  /// Replay a session recorded with View > Record interactions and print
+  /// the latency percentiles of each kind of event. Set
+  /// TRAFFIC_EDITOR_REPLAY to the recording, and optionally
+  /// TRAFFIC_EDITOR_REPLAY_BUILDING to replay it against another building
+  /// and TRAFFIC_EDITOR_REPLAY_REPORT to also write the percentiles as
+  /// JSON. With QT_QPA_PLATFORM=offscreen this runs without a display.
+  void replay()
+  {
+    const QString recording_path =
+      qEnvironmentVariable("TRAFFIC_EDITOR_REPLAY");
+    if (recording_path.isEmpty())
+      QSKIP("TRAFFIC_EDITOR_REPLAY is not set");
+
+    InteractionRecording recording;
+    QVERIFY2(recording.load(recording_path), "unable to load the recording");
+
+    QString building_path =
+      qEnvironmentVariable("TRAFFIC_EDITOR_REPLAY_BUILDING");
+    if (building_path.isEmpty())
+      building_path = QString::fromStdString(recording.building_path);
+    QVERIFY2(editor->load_building(building_path), "unable to load building");
+
+    editor->resize(1600, 1000);
+    editor->show();
+    QVERIFY(QTest::qWaitForWindowExposed(editor));
+
+    InteractionLatencies latencies;
+    QVERIFY(editor->replay_interactions(recording, latencies));
+    printf(
+      "replayed %d events (%.1f s recorded) against %s\n%s",
+      static_cast<int>(recording.events.size()),
+      recording.duration_ms() / 1000.0,
+      qPrintable(building_path),
+      qPrintable(latencies.summary()));
+
+    const QString report_path =
+      qEnvironmentVariable("TRAFFIC_EDITOR_REPLAY_REPORT");
+    if (!report_path.isEmpty())
+    {
+      QFile file(report_path);
+      QVERIFY(file.open(QIODevice::WriteOnly));
+      file.write(QJsonDocument(latencies.to_json()).toJson());
+    }
+  }
+  /// A deletion which was compacted, as old undo steps are, deletes the
+  /// same entities again when it is undone and redone, even though the
+  /// selection changed in between
+  void compacted_delete_undo_redo()
+  {
+    Building building;
+    Level level;
+    level.name = "L1";
+    building.add_level(level);
+    for (int i = 0; i < 6; i++)
+      building.add_vertex(0, 10.0 * i, 0.0);
+    building.levels[0].vertices[4].name = "deleted";
+    building.levels[0].vertices[5].name = "kept";
+    Polygon polygon;
+    polygon.type = Polygon::FLOOR;
+    polygon.vertices = {0, 1, 2, 3};
+    building.levels[0].polygons.push_back(polygon);
+
+    Level::SelectedItem polygon_item;
+    polygon_item.polygon_idx = 0;
+    Level::SelectedItem vertex_item;
+    vertex_item.vertex_idx = 4;
+    building.levels[0].select(polygon_item);
+    building.levels[0].select(vertex_item);
+
+    QUndoStack undo_stack;
+    DeleteCommand* command = new DeleteCommand(&building, 0);
+    undo_stack.push(command);
+    QCOMPARE(building.levels[0].vertices.size(), std::size_t(5));
+    QVERIFY(building.levels[0].polygons.empty());
+
+    command->compact();
+    undo_stack.undo();
+    QCOMPARE(building.levels[0].vertices.size(), std::size_t(6));
+    QCOMPARE(building.levels[0].polygons.size(), std::size_t(1));
+    QCOMPARE(building.levels[0].vertices[4].name, std::string("deleted"));
+    QVERIFY(building.levels[0].polygons[0].selected);
+
+    // the user has since selected something else
+    building.levels[0].clear_selection();
+    Level::SelectedItem other_item;
+    other_item.vertex_idx = 5;
+    building.levels[0].select(other_item);
+
+    undo_stack.redo();
+    QCOMPARE(building.levels[0].vertices.size(), std::size_t(5));
+    QVERIFY(building.levels[0].polygons.empty());
+    QCOMPARE(building.levels[0].vertices[4].name, std::string("kept"));
+
+    undo_stack.undo();
+    QCOMPARE(building.levels[0].vertices.size(), std::size_t(6));
+    QCOMPARE(building.levels[0].polygons.size(), std::size_t(1));
+  }
+
+  /// Edits which say what they touched are journaled as those entities
+  /// alone, the others by diffing the level, and replaying the journal
+  /// onto the building as it started gives the building as it ended
+  void edit_journal_replay()
+  {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    Building building;
+    QVERIFY(building.set_filename(
+        dir.filePath("journal.building.yaml").toStdString()));
+    Level level;
+    level.name = "L1";
+    building.add_level(level);
+    for (int i = 0; i < 100; i++)
+      building.add_vertex(0, 10.0 * i, 0.0);
+    building.levels[0].edges.push_back(Edge(0, 1, Edge::WALL));
+    building.levels[0].edges.push_back(Edge(1, 2, Edge::LANE));
+    const std::shared_ptr<Building> original = building.snapshot();
+
+    SnapshotPublisher publisher;
+    EditJournal journal;
+    QVERIFY(journal.start(building, publisher.publish(building)));
+    Level& edited = building.levels[0];
+
+    // reported
+    edited.vertices[50].x += 1.0;
+    edited.mark_changed(Level::VERTEX, 50);
+    journal.record(building, publisher.publish(building));
+    edited.vertices.push_back(Vertex(5.0, 5.0, "appended"));
+    edited.mark_changed(Level::VERTEX, 100);
+    edited.edges[1].set_param("bidirectional", "true");
+    edited.mark_changed(Level::EDGE, 1);
+    journal.record(building, publisher.publish(building));
+
+    // not reported, and removed
+    edited.edges.push_back(Edge(2, 100, Edge::WALL));
+    edited.invalidate_saved_yaml();
+    journal.record(building, publisher.publish(building));
+    edited.edges.erase(edited.edges.begin());
+    edited.mark_all_changed();
+    journal.record(building, publisher.publish(building));
+    QCOMPARE(journal.num_records(), 4);
+
+    EditJournal::Contents contents;
+    QVERIFY(EditJournal::read(
+        EditJournal::filename(building.get_filename()), contents));
+    QCOMPARE(contents.records.size(), std::size_t(4));
+    const int num_entities[] = {1, 2, 1, 1};
+    for (std::size_t i = 0; i < contents.records.size(); i++)
+    {
+      const QJsonArray levels = contents.records[i]["levels"].toArray();
+      QCOMPARE(levels.size(), 1);
+      QCOMPARE(
+        levels[0].toObject()["entities"].toArray().size(),
+        num_entities[i]);
+    }
+
+    QCOMPARE(EditJournal::replay(contents, *original), 0);
+    QCOMPARE(original->content_hash(), building.content_hash());
+    QVERIFY(original->levels[0].vertices.back().uuid ==
+      edited.vertices.back().uuid);
+    journal.close();
+  }
+
+  void polygon_booleans_data()
+  {
+    QTest::addColumn<int>("operation");
+    QTest::addColumn<double>("area");
+    QTest::newRow("union") << static_cast<int>(PolygonBooleans::UNION) << 150.0;
+    QTest::newRow("intersection") <<
+      static_cast<int>(PolygonBooleans::INTERSECTION) << 50.0;
+    QTest::newRow("difference") <<
+      static_cast<int>(PolygonBooleans::DIFFERENCE) << 50.0;
+  }
+  void polygon_booleans()
+  {
+    QFETCH(int, operation);
+    QFETCH(double, area);
+    std::vector<Vertex> vertices;
+    std::vector<Polygon> polygons;
+    add_rectangle(vertices, polygons, Polygon::FLOOR, 0, 0, 10, 10);
+    add_rectangle(vertices, polygons, Polygon::FLOOR, 5, 0, 15, 10);
+    const PolygonBooleans::Report report = PolygonBooleans::run(
+      static_cast<PolygonBooleans::Operation>(operation),
+      vertices,
+      polygons,
+      {0, 1},
+      0.0,
+      PolygonClipper::Options());
+    QCOMPARE(report.polygons, 2);
+    QCOMPARE(report.results, 1);
+    QCOMPARE(report.holes, 0);
+    QCOMPARE(polygons.size(), std::size_t(1));
+    QCOMPARE(polygons[0].type, Polygon::FLOOR);
+    QVERIFY(polygons[0].selected);
+    const QPolygonF ring = outline(vertices, polygons[0]);
+    QVERIFY(
+      std::abs(PolygonGeometry::signed_area(ring) - area) < 1e-9);
+    const bool in_left = ring.containsPoint(QPointF(2, 5), Qt::OddEvenFill);
+    const bool in_right = ring.containsPoint(QPointF(13, 5), Qt::OddEvenFill);
+    QCOMPARE(in_left, operation != PolygonBooleans::INTERSECTION);
+    QCOMPARE(in_right, operation == PolygonBooleans::UNION);
+  }
+
+  /// Cutting a hole out of a floor leaves a hole polygon on the vertices of
+  /// the one which cut it; the hole is dropped from other kinds of polygon
+  void polygon_difference_holes()
+  {
+    std::vector<Vertex> vertices;
+    std::vector<Polygon> polygons;
+    add_rectangle(vertices, polygons, Polygon::FLOOR, 0, 0, 10, 10);
+    add_rectangle(vertices, polygons, Polygon::ZONE, 20, 0, 30, 10);
+    add_rectangle(vertices, polygons, Polygon::HOLE, 3, 3, 7, 7);
+    add_rectangle(vertices, polygons, Polygon::HOLE, 23, 3, 27, 7);
+    const PolygonBooleans::Report report = PolygonBooleans::run(
+      PolygonBooleans::DIFFERENCE,
+      vertices,
+      polygons,
+      {0, 1, 2, 3},
+      0.0,
+      PolygonClipper::Options());
+    QCOMPARE(report.polygons, 4);
+    QCOMPARE(report.results, 2);
+    QCOMPARE(report.holes, 1);
+    QCOMPARE(report.dropped_holes, 1);
+    QCOMPARE(report.vertices, 0);
+    QCOMPARE(polygons.size(), std::size_t(3));
+
+    int floors = 0;
+    int holes = 0;
+    for (const Polygon& polygon : polygons)
+    {
+      const QPolygonF ring = outline(vertices, polygon);
+      const double area = PolygonGeometry::signed_area(ring);
+      if (polygon.type == Polygon::HOLE)
+      {
+        holes++;
+        QVERIFY(std::abs(area + 16.0) < 1e-9);
+        QVERIFY(ring.containsPoint(QPointF(5, 5), Qt::OddEvenFill));
+      }
+      else
+      {
+        floors += polygon.type == Polygon::FLOOR;
+        QVERIFY(std::abs(area - 100.0) < 1e-9);
+      }
+    }
+    QCOMPARE(floors, 1);
+    QCOMPARE(holes, 1);
+  }
+
+  void polygon_offset_data()
+  {
+    QTest::addColumn<double>("distance");
+    QTest::addColumn<double>("area");
+    QTest::newRow("grow") << 1.0 << 144.0;
+    QTest::newRow("shrink") << -1.0 << 64.0;
+    QTest::newRow("vanish") << -6.0 << 0.0;
+  }
+  void polygon_offset()
+  {
+    QFETCH(double, distance);
+    QFETCH(double, area);
+    std::vector<Vertex> vertices;
+    std::vector<Polygon> polygons;
+    add_rectangle(vertices, polygons, Polygon::FLOOR, 0, 0, 10, 10);
+    const PolygonBooleans::Report report = PolygonBooleans::run(
+      PolygonBooleans::OFFSET,
+      vertices,
+      polygons,
+      {0},
+      distance,
+      PolygonClipper::Options());
+    QCOMPARE(report.polygons, 1);
+    QCOMPARE(polygons.size(), std::size_t(area > 0.0 ? 1 : 0));
+    if (area > 0.0)
+    {
+      const QPolygonF ring = outline(vertices, polygons[0]);
+      QVERIFY(std::abs(PolygonGeometry::signed_area(ring) - area) < 1e-9);
+      QVERIFY(ring.containsPoint(QPointF(5, 5), Qt::OddEvenFill));
+    }
+  }
+
+  /// Each map of rmf_traffic_editor_test_maps, and some written here: the
+  /// text to write, if any, whether BuildingStreamParser should parse
+  /// every level of it rather than fall back to yaml-cpp, and whether it
+  /// should load at all
+  void stream_parser_conformance_data()
+  {
+    QTest::addColumn<QString>("path");
+    QTest::addColumn<QByteArray>("text");
+    QTest::addColumn<bool>("streams");
+    QTest::addColumn<bool>("loads");
+
+    const QDir maps_dir(TEST_MAPS_DIR);
+    QDirIterator it(
+      maps_dir.absolutePath(),
+      {"*.building.yaml"},
+      QDir::Files,
+      QDirIterator::Subdirectories);
+    while (it.hasNext())
+    {
+      const QString path = it.next();
+      QTest::newRow(qPrintable(maps_dir.relativeFilePath(path))) <<
+        path << QByteArray() << true << true;
+    }
+
+    QTest::newRow("params, lanes, lifts and graphs") << QString() <<
+      QByteArray(R"(coordinate_system: reference_image
+graphs:
+  0: {default_lane_width: 0.75, name: main}
+levels:
+  L1:
+    elevation: 0
+    lanes:
+      - [0, 1, {bidirectional: [4, true], speed_limit: [3, 0.5]}]
+      - [1, 2, {graph_idx: [2, 1], orientation: [1, ""]}]
+      - [2, 0, {bidirectional: [4, false], graph_idx: [2, 0]}]
+    vertices:
+      - [1.5, 2.25, 0, a, {is_charger: [4, true]}]
+      - [3, -4e2, 0, "b c", {is_parking_spot: [4, true]}]
+      - [5.125, 6, 0, '', {dock_name: [1, "x: y"]}]
+    walls:
+      - [0, 2, {texture_name: [1, default]}]
+    floors:
+      - parameters: {indoor: [2, 1]}
+        vertices: [0, 1, 2]
+  L2:
+    elevation: 3.5
+    vertices:
+      - [0, 0, 0, "tab\there é"]  # a comment
+      - [1e-3, .5, 0, 'it''s']
+      - [1, 0, 0, lift_b]
+    lanes:
+      - [0, 1, {}]
+lifts:
+  LA:
+    depth: 1
+    highest_floor: L2
+    lowest_floor: L1
+    reference_floor_name: L1
+    width: 1
+    x: 0.5
+    y: 0
+    yaw: 0
+name: written
+parameters:
+  generate_crs: [1, "EPSG:3857"]
+)") << true << true;
+
+    QTest::newRow("multi-line flow sequence") << QString() <<
+      QByteArray(R"(levels:
+  L1:
+    elevation: 0
+    vertices:
+      - [1, 2, 0,
+         a]
+      - [3, 4, 0, b]
+name: multi-line
+)") << true << true;
+
+    // yaml-cpp reads these, but the stream parser doesn't
+    QTest::newRow("anchor and alias") << QString() <<
+      QByteArray(R"(levels:
+  L1:
+    elevation: 0
+    vertices:
+      - &v0 [1, 2, 0, a]
+      - *v0
+name: anchor
+)") << false << true;
+    QTest::newRow("tag") << QString() <<
+      QByteArray(R"(levels:
+  L1:
+    elevation: 0
+    vertices:
+      - [!!float 1, 2, 0, a]
+name: tag
+)") << false << true;
+
+    // neither reads these
+    QTest::newRow("hexadecimal coordinate") << QString() <<
+      QByteArray(R"(levels:
+  L1:
+    elevation: 0
+    vertices:
+      - [0x1A, 2, 0, a]
+name: hex
+)") << false << false;
+    QTest::newRow("unterminated flow sequence") << QString() <<
+      QByteArray(R"(levels:
+  L1:
+    elevation: 0
+    vertices:
+      - [1, 2, 0, a
+name: broken
+)") << false << false;
+  }
+
+  /// BuildingStreamParser builds the same building as yaml-cpp, both from
+  /// the building file and from the level files of it saved split
+  void stream_parser_conformance()
+  {
+    QFETCH(QString, path);
+    QFETCH(QByteArray, text);
+    QFETCH(bool, streams);
+    QFETCH(bool, loads);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    if (path.isEmpty())
+    {
+      path = dir.filePath("written.building.yaml");
+      QFile file(path);
+      QVERIFY(file.open(QIODevice::WriteOnly));
+      QCOMPARE(file.write(text), static_cast<qint64>(text.size()));
+    }
+
+    Building streamed;
+    Building parsed;
+    QCOMPARE(load_building(path, true, streamed), loads);
+    QCOMPARE(load_building(path, false, parsed), loads);
+    if (!loads)
+      return;
+    QCOMPARE(levels_streamed(parsed), qint64(0));
+    QCOMPARE(
+      levels_streamed(streamed),
+      streams ? static_cast<qint64>(streamed.levels.size()) : qint64(0));
+    compare_buildings(streamed, parsed);
+    if (QTest::currentTestFailed())
+      return;
+
+    const QString split_path = dir.filePath("split.building.yaml");
+    parsed.split_files = true;
+    QVERIFY(parsed.save_to(split_path.toStdString()));
+    Building split_streamed;
+    Building split_parsed;
+    QVERIFY(load_building(split_path, true, split_streamed));
+    QVERIFY(load_building(split_path, false, split_parsed));
+    QVERIFY(split_streamed.split_files);
+    QCOMPARE(
+      levels_streamed(split_streamed),
+      static_cast<qint64>(split_streamed.levels.size()));
+    compare_buildings(split_streamed, split_parsed);
+    if (QTest::currentTestFailed())
+      return;
+    compare_buildings(split_parsed, parsed);
+  }
+
   void cleanupTestCase()
   {
     printf("cleanupTestCase()\n");